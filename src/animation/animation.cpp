@@ -1,11 +1,14 @@
 #include "animation/animation.h"
+#include "animation/animation_sampling.h"
 #include "core/fs/file_system.h"
 #include "core/fs/ifile.h"
 #include "core/log.h"
+#include "core/math_utils.h"
 #include "core/matrix.h"
 #include "core/profiler.h"
 #include "core/quat.h"
 #include "core/resource_manager.h"
+#include "core/string.h"
 #include "core/vec.h"
 #include "renderer/model.h"
 #include "renderer/pose.h"
@@ -29,79 +32,407 @@ void AnimationManager::destroyResource(Resource& resource)
 
 Animation::Animation(const Path& path, ResourceManager& resource_manager, IAllocator& allocator)
 	: Resource(path, resource_manager, allocator)
+	, m_allocator(allocator)
+	, m_bone_remaps(allocator)
+	, m_bone_remaps_mutex(false)
 {
-	m_rotations = nullptr;
-	m_positions = nullptr;
+	m_frames = nullptr;
+	m_tracks = nullptr;
+	m_track_data = nullptr;
 	m_bones = nullptr;
 	m_frame_count = 0;
+	m_bone_count = 0;
 	m_fps = 30;
 }
 
 
 Animation::~Animation()
 {
-	IAllocator& allocator = getAllocator();
-	allocator.deallocate(m_positions);
-	allocator.deallocate(m_rotations);
-	allocator.deallocate(m_bones);
+	clearBoneRemaps();
+	clear();
 }
 
 
-void Animation::getPose(float time, Pose& pose, Model& model) const
+// called from animation jobs in parallel, tables are never freed while the animation is loaded
+const int* Animation::getBoneRemap(Model& model, bool skip_leaf_bones) const
 {
-	PROFILE_FUNCTION();
-	if(model.isReady())
+	MT::SpinLock lock(m_bone_remaps_mutex);
+	BoneRemap* remap = nullptr;
+	for (BoneRemap& iter : m_bone_remaps)
 	{
-		int frame = (int)(time * m_fps);
-		frame = frame >= m_frame_count ? m_frame_count - 1 : frame;
-		Vec3* pos = pose.getPositions();
-		Quat* rot = pose.getRotations();
-		int off = frame * m_bone_count;
-		int off2 = off + m_bone_count;
-		float t = (time - frame / (float)m_fps) / (1.0f / m_fps);
-
-		if(frame < m_frame_count - 1)
+		if (iter.model == &model)
 		{
-			for(int i = 0; i < m_bone_count; ++i)
+			if (iter.bones_id == model.getBonesID())
 			{
-				Model::BoneMap::iterator iter = model.getBoneIndex(m_bones[i]);
-				if (iter.isValid())
-				{
-					int model_bone_index = iter.value();
-					lerp(m_positions[off + i], m_positions[off2 + i], &pos[model_bone_index], t);
-					nlerp(m_rotations[off + i], m_rotations[off2 + i], &rot[model_bone_index], t);
-				}
+				return skip_leaf_bones ? iter.indices + m_bone_count : iter.indices;
 			}
+			remap = &iter;
+			break;
 		}
-		else
+	}
+
+	if (!remap)
+	{
+		remap = &m_bone_remaps.emplace();
+		remap->model = &model;
+		remap->indices = static_cast<int*>(m_allocator.allocate(sizeof(int) * m_bone_count * 2));
+	}
+	remap->bones_id = model.getBonesID();
+
+	Array<bool> is_parent(m_allocator);
+	is_parent.resize(model.getBoneCount());
+	for (int i = 0; i < is_parent.size(); ++i) is_parent[i] = false;
+	for (int i = 0; i < is_parent.size(); ++i)
+	{
+		int parent = model.getBone(i).parent_idx;
+		if (parent >= 0) is_parent[parent] = true;
+	}
+
+	int* lod_indices = remap->indices + m_bone_count;
+	for (int i = 0; i < m_bone_count; ++i)
+	{
+		Model::BoneMap::iterator iter = model.getBoneIndex(m_bones[i]);
+		remap->indices[i] = iter.isValid() ? iter.value() : -1;
+		lod_indices[i] = iter.isValid() && is_parent[iter.value()] ? iter.value() : -1;
+	}
+	return skip_leaf_bones ? lod_indices : remap->indices;
+}
+
+
+void Animation::clearBoneRemaps()
+{
+	for (BoneRemap& remap : m_bone_remaps)
+	{
+		m_allocator.deallocate(remap.indices);
+	}
+	m_bone_remaps.clear();
+}
+
+
+static void setPose4(int bone,
+	int bone_count,
+	const float sampled[AnimationSampling::ROW_COUNT][4],
+	Vec3* pos,
+	Quat* rot,
+	const int* remap)
+{
+	for (int j = 0, c = Math::minValue(4, bone_count - bone); j < c; ++j)
+	{
+		int model_bone_index = remap[bone + j];
+		if (model_bone_index < 0) continue;
+		pos[model_bone_index].set(sampled[AnimationSampling::POSITION_X][j],
+			sampled[AnimationSampling::POSITION_Y][j],
+			sampled[AnimationSampling::POSITION_Z][j]);
+		rot[model_bone_index].set(sampled[AnimationSampling::ROTATION_X][j],
+			sampled[AnimationSampling::ROTATION_Y][j],
+			sampled[AnimationSampling::ROTATION_Z][j],
+			sampled[AnimationSampling::ROTATION_W][j]);
+	}
+}
+
+
+void Animation::getUncompressedPose(float time, Vec3* pos, Quat* rot, const int* remap) const
+{
+	int frame = (int)(time * m_fps);
+	frame = frame >= m_frame_count ? m_frame_count - 1 : frame;
+	int stride = AnimationSampling::getStride(m_bone_count);
+	int frame_size = AnimationSampling::getFrameSize(m_bone_count);
+	const float* frame0 = m_frames + frame * frame_size;
+	const float* frame1 = frame0;
+	float t = 0;
+	if (frame < m_frame_count - 1)
+	{
+		frame1 = frame0 + frame_size;
+		t = (time - frame / (float)m_fps) / (1.0f / m_fps);
+	}
+
+	float sampled[AnimationSampling::ROW_COUNT][4];
+	for (int i = 0; i < m_bone_count; i += 4)
+	{
+		AnimationSampling::sample4(frame0, frame1, stride, i, t, sampled);
+		setPose4(i, m_bone_count, sampled, pos, rot, remap);
+	}
+}
+
+
+static float getKeyT(const uint16* frames, int count, float frame, int* key)
+{
+	*key = AnimationCompression::findKey(frames, count, frame);
+	if (*key + 1 >= count) return 0;
+	float from = frames[*key];
+	return Math::clamp((frame - from) / (frames[*key + 1] - from), 0.0f, 1.0f);
+}
+
+
+// decodes only the two keys around the time for each track
+void Animation::getCompressedPose(float time, Vec3* pos, Quat* rot, const int* remap) const
+{
+	float frame = Math::clamp(time * m_fps, 0.0f, float(m_frame_count - 1));
+	float a[AnimationSampling::ROW_COUNT][4];
+	float b[AnimationSampling::ROW_COUNT][4];
+	float t_position[4];
+	float t_rotation[4];
+	float sampled[AnimationSampling::ROW_COUNT][4];
+	for (int i = 0; i < m_bone_count; i += 4)
+	{
+		setMemory(a, 0, sizeof(a));
+		setMemory(b, 0, sizeof(b));
+		setMemory(t_position, 0, sizeof(t_position));
+		setMemory(t_rotation, 0, sizeof(t_rotation));
+		for (int j = 0, c = Math::minValue(4, m_bone_count - i); j < c; ++j)
 		{
-			for(int i = 0; i < m_bone_count; ++i)
+			if (remap[i + j] < 0) continue;
+
+			const Track& track = m_tracks[i + j];
+			const AnimationCompression::TrackHeader& header = *track.header;
+			float values[4];
+			int key;
+			t_position[j] =
+				getKeyT(track.position_frames, header.position_key_count, frame, &key);
+			int next = Math::minValue(key + 1, header.position_key_count - 1);
+			for (int k = 0; k < 2; ++k)
+			{
+				float (*rows)[4] = k == 0 ? a : b;
+				AnimationCompression::unpackPosition(track.positions[k == 0 ? key : next],
+					header.position_min,
+					header.position_scale,
+					values);
+				rows[AnimationSampling::POSITION_X][j] = values[0];
+				rows[AnimationSampling::POSITION_Y][j] = values[1];
+				rows[AnimationSampling::POSITION_Z][j] = values[2];
+			}
+
+			t_rotation[j] =
+				getKeyT(track.rotation_frames, header.rotation_key_count, frame, &key);
+			next = Math::minValue(key + 1, header.rotation_key_count - 1);
+			for (int k = 0; k < 2; ++k)
 			{
-				Model::BoneMap::iterator iter = model.getBoneIndex(m_bones[i]);
-				if (iter.isValid())
-				{
-					int model_bone_index = iter.value();
-					pos[model_bone_index] = m_positions[off + i];
-					rot[model_bone_index] = m_rotations[off + i];
-				}
+				float (*rows)[4] = k == 0 ? a : b;
+				AnimationCompression::unpackQuat(track.rotations[k == 0 ? key : next], values);
+				rows[AnimationSampling::ROTATION_X][j] = values[0];
+				rows[AnimationSampling::ROTATION_Y][j] = values[1];
+				rows[AnimationSampling::ROTATION_Z][j] = values[2];
+				rows[AnimationSampling::ROTATION_W][j] = values[3];
 			}
 		}
+
+		__m128 a4[AnimationSampling::ROW_COUNT];
+		__m128 b4[AnimationSampling::ROW_COUNT];
+		for (int row = 0; row < AnimationSampling::ROW_COUNT; ++row)
+		{
+			a4[row] = _mm_loadu_ps(a[row]);
+			b4[row] = _mm_loadu_ps(b[row]);
+		}
+		AnimationSampling::interpolate4(
+			a4, b4, _mm_loadu_ps(t_position), _mm_loadu_ps(t_rotation), sampled);
+		setPose4(i, m_bone_count, sampled, pos, rot, remap);
+	}
+}
+
+
+void Animation::getPose(float time, Pose& pose, Model& model, bool skip_leaf_bones) const
+{
+	PROFILE_FUNCTION();
+	if(model.isReady() && m_frame_count > 0)
+	{
+		getRelativePose(time, pose.getPositions(), pose.getRotations(), model, skip_leaf_bones);
 		pose.setIsRelative();
 		pose.computeAbsolute(model);
 	}
 }
 
 
-bool Animation::load(FS::IFile& file)
+void Animation::getRelativePose(float time,
+	Vec3* pos,
+	Quat* rot,
+	Model& model,
+	bool skip_leaf_bones) const
+{
+	if (!model.isReady() || m_frame_count == 0) return;
+
+	const int* remap = getBoneRemap(model, skip_leaf_bones);
+	if (m_tracks)
+	{
+		getCompressedPose(time, pos, rot, remap);
+	}
+	else
+	{
+		getUncompressedPose(time, pos, rot, remap);
+	}
+}
+
+
+// frame points to the bone's column of the frame
+static void readBone(const float* frame, int stride, Vec3* pos, Quat* rot)
+{
+	pos->set(frame[AnimationSampling::POSITION_X * stride],
+		frame[AnimationSampling::POSITION_Y * stride],
+		frame[AnimationSampling::POSITION_Z * stride]);
+	rot->set(frame[AnimationSampling::ROTATION_X * stride],
+		frame[AnimationSampling::ROTATION_Y * stride],
+		frame[AnimationSampling::ROTATION_Z * stride],
+		frame[AnimationSampling::ROTATION_W * stride]);
+}
+
+
+int Animation::getBoneIndex(uint32 bone_hash) const
+{
+	for (int i = 0; i < m_bone_count; ++i)
+	{
+		if (m_bones[i] == bone_hash) return i;
+	}
+	return -1;
+}
+
+
+void Animation::getRelativeBone(float time, int bone, Vec3* pos, Quat* rot) const
+{
+	ASSERT(bone >= 0 && bone < m_bone_count);
+	if (m_frame_count == 0) return;
+
+	if (m_tracks)
+	{
+		float frame = Math::clamp(time * m_fps, 0.0f, float(m_frame_count - 1));
+		const Track& track = m_tracks[bone];
+		const AnimationCompression::TrackHeader& header = *track.header;
+		float a[4];
+		float b[4];
+		int key;
+		float t = getKeyT(track.position_frames, header.position_key_count, frame, &key);
+		int next = Math::minValue(key + 1, header.position_key_count - 1);
+		AnimationCompression::unpackPosition(
+			track.positions[key], header.position_min, header.position_scale, a);
+		AnimationCompression::unpackPosition(
+			track.positions[next], header.position_min, header.position_scale, b);
+		lerp(Vec3(a[0], a[1], a[2]), Vec3(b[0], b[1], b[2]), pos, t);
+
+		t = getKeyT(track.rotation_frames, header.rotation_key_count, frame, &key);
+		next = Math::minValue(key + 1, header.rotation_key_count - 1);
+		AnimationCompression::unpackQuat(track.rotations[key], a);
+		AnimationCompression::unpackQuat(track.rotations[next], b);
+		nlerp(Quat(a[0], a[1], a[2], a[3]), Quat(b[0], b[1], b[2], b[3]), rot, t);
+		return;
+	}
+
+	int frame = (int)(time * m_fps);
+	frame = frame >= m_frame_count ? m_frame_count - 1 : frame;
+	int stride = AnimationSampling::getStride(m_bone_count);
+	int frame_size = AnimationSampling::getFrameSize(m_bone_count);
+	const float* frame0 = m_frames + frame * frame_size + bone;
+	const float* frame1 = frame0;
+	float t = 0;
+	if (frame < m_frame_count - 1)
+	{
+		frame1 = frame0 + frame_size;
+		t = (time - frame / (float)m_fps) / (1.0f / m_fps);
+	}
+	Vec3 pos0, pos1;
+	Quat rot0, rot1;
+	readBone(frame0, stride, &pos0, &rot0);
+	readBone(frame1, stride, &pos1, &rot1);
+	lerp(pos0, pos1, pos, t);
+	nlerp(rot0, rot1, rot, t);
+}
+
+
+void Animation::clear()
 {
 	IAllocator& allocator = getAllocator();
-	allocator.deallocate(m_positions);
-	allocator.deallocate(m_rotations);
+	allocator.deallocate(m_frames);
+	allocator.deallocate(m_tracks);
+	allocator.deallocate(m_track_data);
 	allocator.deallocate(m_bones);
-	m_positions = nullptr;
-	m_rotations = nullptr;
-	m_bones = 0;
+	m_frames = nullptr;
+	m_tracks = nullptr;
+	m_track_data = nullptr;
+	m_bones = nullptr;
 	m_frame_count = m_bone_count = 0;
+}
+
+
+bool Animation::loadUncompressed(FS::IFile& file)
+{
+	IAllocator& allocator = getAllocator();
+	int key_count = m_frame_count * m_bone_count;
+	Vec3* positions = static_cast<Vec3*>(allocator.allocate(sizeof(Vec3) * key_count));
+	Quat* rotations = static_cast<Quat*>(allocator.allocate(sizeof(Quat) * key_count));
+	m_bones = static_cast<uint32*>(allocator.allocate(sizeof(uint32) * m_bone_count));
+	file.read(positions, sizeof(Vec3) * key_count);
+	file.read(rotations, sizeof(Quat) * key_count);
+	file.read(m_bones, sizeof(m_bones[0]) * m_bone_count);
+
+	// the file has an array of keys per frame, transpose them
+	int stride = AnimationSampling::getStride(m_bone_count);
+	int frame_size = AnimationSampling::getFrameSize(m_bone_count);
+	m_frames = static_cast<float*>(allocator.allocate(sizeof(float) * frame_size * m_frame_count));
+	setMemory(m_frames, 0, sizeof(float) * frame_size * m_frame_count);
+	for (int frame = 0; frame < m_frame_count; ++frame)
+	{
+		float* rows = m_frames + frame * frame_size;
+		for (int i = 0; i < m_bone_count; ++i)
+		{
+			const Vec3& pos = positions[frame * m_bone_count + i];
+			const Quat& rot = rotations[frame * m_bone_count + i];
+			rows[AnimationSampling::POSITION_X * stride + i] = pos.x;
+			rows[AnimationSampling::POSITION_Y * stride + i] = pos.y;
+			rows[AnimationSampling::POSITION_Z * stride + i] = pos.z;
+			rows[AnimationSampling::ROTATION_X * stride + i] = rot.x;
+			rows[AnimationSampling::ROTATION_Y * stride + i] = rot.y;
+			rows[AnimationSampling::ROTATION_Z * stride + i] = rot.z;
+			rows[AnimationSampling::ROTATION_W * stride + i] = rot.w;
+		}
+	}
+	allocator.deallocate(positions);
+	allocator.deallocate(rotations);
+	return true;
+}
+
+
+bool Animation::loadCompressed(FS::IFile& file)
+{
+	IAllocator& allocator = getAllocator();
+	m_bones = static_cast<uint32*>(allocator.allocate(sizeof(uint32) * m_bone_count));
+	file.read(m_bones, sizeof(m_bones[0]) * m_bone_count);
+
+	// tracks are used right from the file data, they have sizes in multiples of four bytes
+	size_t data_size = file.size() - file.pos();
+	m_track_data = static_cast<uint8*>(allocator.allocate(data_size));
+	file.read(m_track_data, data_size);
+	m_tracks = static_cast<Track*>(allocator.allocate(sizeof(Track) * m_bone_count));
+
+	const uint8* data = m_track_data;
+	const uint8* data_end = m_track_data + data_size;
+	for (int i = 0; i < m_bone_count; ++i)
+	{
+		Track& track = m_tracks[i];
+		if (data + sizeof(AnimationCompression::TrackHeader) > data_end) return false;
+		track.header = (const AnimationCompression::TrackHeader*)data;
+		data += sizeof(AnimationCompression::TrackHeader);
+
+		int position_count = track.header->position_key_count;
+		int rotation_count = track.header->rotation_key_count;
+		if (position_count == 0 || rotation_count == 0) return false;
+		size_t keys_size = (position_count + rotation_count) * sizeof(uint16) +
+						   position_count * sizeof(AnimationCompression::PackedPosition) +
+						   rotation_count * sizeof(AnimationCompression::PackedQuat);
+		if (data + keys_size > data_end) return false;
+
+		track.position_frames = (const uint16*)data;
+		data += position_count * sizeof(uint16);
+		track.positions = (const AnimationCompression::PackedPosition*)data;
+		data += position_count * sizeof(AnimationCompression::PackedPosition);
+		track.rotation_frames = (const uint16*)data;
+		data += rotation_count * sizeof(uint16);
+		track.rotations = (const AnimationCompression::PackedQuat*)data;
+		data += rotation_count * sizeof(AnimationCompression::PackedQuat);
+	}
+	return true;
+}
+
+
+bool Animation::load(FS::IFile& file)
+{
+	clear();
 	Header header;
 	file.read(&header, sizeof(header));
 	if (header.magic != HEADER_MAGIC)
@@ -109,7 +440,7 @@ bool Animation::load(FS::IFile& file)
 		g_log_error.log("Animation") << getPath() << " is not an animation file";
 		return false;
 	}
-	if (header.version > 1)
+	if (header.version > AnimationCompression::VERSION)
 	{
 		g_log_error.log("Animation") << "Unsupported animation version " << header.version << " ("
 									 << getPath() << ")";
@@ -119,13 +450,15 @@ bool Animation::load(FS::IFile& file)
 	file.read(&m_frame_count, sizeof(m_frame_count));
 	file.read(&m_bone_count, sizeof(m_bone_count));
 
-	m_positions = static_cast<Vec3*>(allocator.allocate(sizeof(Vec3) * m_frame_count * m_bone_count));
-	m_rotations = static_cast<Quat*>(allocator.allocate(sizeof(Quat) * m_frame_count * m_bone_count));
-	m_bones = static_cast<uint32*>(allocator.allocate(sizeof(uint32) * m_bone_count));
-	file.read(&m_positions[0], sizeof(Vec3)* m_bone_count * m_frame_count);
-	file.read(&m_rotations[0], sizeof(Quat)* m_bone_count * m_frame_count);
-	file.read(m_bones, sizeof(m_bones[0]) * m_bone_count);
-		
+	bool success = header.version < AnimationCompression::VERSION ? loadUncompressed(file)
+																	: loadCompressed(file);
+	if (!success)
+	{
+		g_log_error.log("Animation") << "Invalid animation file " << getPath();
+		clear();
+		return false;
+	}
+
 	m_size = file.size();
 	return true;
 }
@@ -139,14 +472,8 @@ IAllocator& Animation::getAllocator()
 
 void Animation::unload(void)
 {
-	IAllocator& allocator = getAllocator();
-	allocator.deallocate(m_positions);
-	allocator.deallocate(m_rotations);
-	allocator.deallocate(m_bones);
-	m_rotations = nullptr;
-	m_positions = nullptr;
-	m_bones = nullptr;
-	m_frame_count = 0;
+	clearBoneRemaps();
+	clear();
 }
 
 
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "animation/animation_compression.h"
+#include "core/array.h"
+#include "core/mt/sync.h"
 #include "core/resource.h"
 #include "core/resource_manager_base.h"
 
@@ -54,13 +57,53 @@ class LUMIX_ANIMATION_API Animation : public Resource
 		Animation(const Path& path, ResourceManager& resource_manager, IAllocator& allocator);
 		~Animation();
 
-		void getPose(float time, Pose& pose, Model& model) const;
+		// leaf bones keep the values they have in the pose if skip_leaf_bones is true, it's used
+		// for distant models
+		void getPose(float time, Pose& pose, Model& model, bool skip_leaf_bones = false) const;
+		// writes bone transformations relative to their parents, pos and rot have model's bone
+		// count elements, bones which are not in the animation are not changed
+		void getRelativePose(float time,
+			Vec3* pos,
+			Quat* rot,
+			Model& model,
+			bool skip_leaf_bones = false) const;
+		// index of the animated bone, -1 if the animation does not have the bone
+		int getBoneIndex(uint32 bone_hash) const;
+		// samples a single bone relative to its parent, bone is an index from getBoneIndex
+		void getRelativeBone(float time, int bone, Vec3* pos, Quat* rot) const;
 		int getFrameCount() const { return m_frame_count; }
 		float getLength() const { return m_frame_count / (float)m_fps; }
 		int getFPS() const { return m_fps; }
 
+	private:
+		// index of the model's bone for each bone of the animation, -1 if the model does not have it,
+		// indices are followed by the same table with -1 for leaf bones
+		struct BoneRemap
+		{
+			const Model* model;
+			uint32 bones_id;
+			int* indices;
+		};
+
+		// compressed data of a bone, points to m_track_data
+		struct Track
+		{
+			const AnimationCompression::TrackHeader* header;
+			const uint16* position_frames;
+			const AnimationCompression::PackedPosition* positions;
+			const uint16* rotation_frames;
+			const AnimationCompression::PackedQuat* rotations;
+		};
+
 	private:
 		IAllocator& getAllocator();
+		const int* getBoneRemap(Model& model, bool skip_leaf_bones) const;
+		void clearBoneRemaps();
+		void clear();
+		bool loadUncompressed(FS::IFile& file);
+		bool loadCompressed(FS::IFile& file);
+		void getUncompressedPose(float time, Vec3* pos, Quat* rot, const int* remap) const;
+		void getCompressedPose(float time, Vec3* pos, Quat* rot, const int* remap) const;
 
 		void unload() override;
 		bool load(FS::IFile& file) override;
@@ -68,10 +111,16 @@ class LUMIX_ANIMATION_API Animation : public Resource
 	private:
 		int	m_frame_count;
 		int	m_bone_count;
-		Vec3* m_positions;
-		Quat* m_rotations;
+		// version 1 files, see AnimationSampling for the layout
+		float* m_frames;
+		// version 2 files, one track per bone
+		Track* m_tracks;
+		uint8* m_track_data;
 		uint32* m_bones;
 		int m_fps;
+		IAllocator& m_allocator;
+		mutable Array<BoneRemap> m_bone_remaps;
+		mutable MT::SpinMutex m_bone_remaps_mutex;
 };
 
 
@@ -0,0 +1,232 @@
+#pragma once
+
+
+#include "lumix.h"
+#include "core/array.h"
+#include "core/quat.h"
+#include "core/vec.h"
+#include <cmath>
+
+
+namespace Lumix
+{
+
+
+// Animation file version 2. Every bone has its own position and rotation track, a track keeps
+// only the keys which can not be linearly interpolated from their neighbours. Rotations are
+// stored as the smallest three components, positions are quantized to the range of the track.
+// Header only, so the importer can write the format without linking the animation plugin.
+namespace AnimationCompression
+{
+
+
+static const uint32 VERSION = 2;
+static const int MAX_FRAME_COUNT = 0xffff;
+// longer segments are split, so reduceKeys is not too slow on long linear tracks
+static const int MAX_SEGMENT_LENGTH = 128;
+
+
+// followed by position_key_count frame indices, position_key_count quantized positions,
+// rotation_key_count frame indices and rotation_key_count packed rotations, all uint16
+struct TrackHeader
+{
+	Vec3 position_min;
+	Vec3 position_scale;
+	uint16 position_key_count;
+	uint16 rotation_key_count;
+};
+
+
+struct PackedQuat
+{
+	uint16 values[3];
+};
+
+
+struct PackedPosition
+{
+	uint16 values[3];
+};
+
+
+static const float SQRT_2 = 1.41421356f;
+static const uint16 QUAT_COMPONENT_MAX = 0x7fff;
+
+
+inline uint16 packQuatComponent(float value)
+{
+	float normalized = (value * SQRT_2 + 1) * 0.5f;
+	normalized = normalized < 0 ? 0 : (normalized > 1 ? 1 : normalized);
+	return uint16(normalized * QUAT_COMPONENT_MAX + 0.5f);
+}
+
+
+inline float unpackQuatComponent(uint16 value)
+{
+	return ((value & QUAT_COMPONENT_MAX) * (2.0f / QUAT_COMPONENT_MAX) - 1) * (1 / SQRT_2);
+}
+
+
+// the largest component is dropped, its index is in the top bits of the first two values
+inline PackedQuat packQuat(const Quat& rot)
+{
+	float q[4] = {rot.x, rot.y, rot.z, rot.w};
+	int largest = 0;
+	for (int i = 1; i < 4; ++i)
+	{
+		if (fabsf(q[i]) > fabsf(q[largest])) largest = i;
+	}
+	float sign = q[largest] < 0 ? -1.0f : 1.0f;
+
+	PackedQuat packed;
+	for (int i = 0, j = 0; i < 4; ++i)
+	{
+		if (i == largest) continue;
+		packed.values[j] = packQuatComponent(q[i] * sign);
+		++j;
+	}
+	packed.values[0] |= (largest & 1) << 15;
+	packed.values[1] |= (largest >> 1) << 15;
+	return packed;
+}
+
+
+inline void unpackQuat(const PackedQuat& packed, float out[4])
+{
+	int largest = (packed.values[0] >> 15) | ((packed.values[1] >> 15) << 1);
+	float sum_sq = 0;
+	for (int i = 0, j = 0; i < 4; ++i)
+	{
+		if (i == largest) continue;
+		out[i] = unpackQuatComponent(packed.values[j]);
+		sum_sq += out[i] * out[i];
+		++j;
+	}
+	out[largest] = sum_sq < 1 ? sqrtf(1 - sum_sq) : 0;
+}
+
+
+inline PackedPosition packPosition(const Vec3& pos, const Vec3& min, const Vec3& scale)
+{
+	float values[3] = {pos.x - min.x, pos.y - min.y, pos.z - min.z};
+	float scales[3] = {scale.x, scale.y, scale.z};
+	PackedPosition packed;
+	for (int i = 0; i < 3; ++i)
+	{
+		float q = scales[i] > 0 ? values[i] / scales[i] + 0.5f : 0;
+		packed.values[i] = uint16(q < 0 ? 0 : (q > 0xffff ? 0xffff : q));
+	}
+	return packed;
+}
+
+
+inline void unpackPosition(const PackedPosition& packed,
+	const Vec3& min,
+	const Vec3& scale,
+	float out[3])
+{
+	out[0] = min.x + packed.values[0] * scale.x;
+	out[1] = min.y + packed.values[1] * scale.y;
+	out[2] = min.z + packed.values[2] * scale.z;
+}
+
+
+// scale of a track with keys in [min, max], maps the range to the whole uint16
+inline Vec3 getPositionScale(const Vec3& min, const Vec3& max)
+{
+	return (max - min) * (1.0f / 0xffff);
+}
+
+
+// tolerance is a distance
+inline bool isClose(const Vec3& a, const Vec3& b, float tolerance)
+{
+	return (a - b).squaredLength() <= tolerance * tolerance;
+}
+
+
+// tolerance is 1 - |cos(angle / 2)| of the angle between the rotations
+inline bool isClose(const Quat& a, const Quat& b, float tolerance)
+{
+	float dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+	return 1 - fabsf(dot) <= tolerance;
+}
+
+
+inline void interpolate(const Vec3& a, const Vec3& b, Vec3* out, float t)
+{
+	lerp(a, b, out, t);
+}
+
+
+inline void interpolate(const Quat& a, const Quat& b, Quat* out, float t)
+{
+	nlerp(a, b, out, t);
+}
+
+
+// Fills frames with the indices of keys which must be kept, so that all other keys can be
+// interpolated from them within the tolerance. A constant track keeps only its first key.
+template <typename T>
+void reduceKeys(const T* keys, int count, float tolerance, Array<uint16>& frames)
+{
+	frames.clear();
+	if (count <= 0) return;
+	frames.push(0);
+
+	bool is_constant = true;
+	for (int i = 1; i < count && is_constant; ++i)
+	{
+		is_constant = isClose(keys[0], keys[i], tolerance);
+	}
+	if (is_constant) return;
+
+	int from = 0;
+	while (from < count - 1)
+	{
+		// extend the segment while the keys inside it are close to the interpolation
+		int to = from + 1;
+		while (to + 1 < count && to + 1 - from <= MAX_SEGMENT_LENGTH)
+		{
+			bool can_skip = true;
+			for (int i = from + 1; i <= to && can_skip; ++i)
+			{
+				T interpolated;
+				float t = (i - from) / float(to + 1 - from);
+				interpolate(keys[from], keys[to + 1], &interpolated, t);
+				can_skip = isClose(interpolated, keys[i], tolerance);
+			}
+			if (!can_skip) break;
+			++to;
+		}
+		frames.push((uint16)to);
+		from = to;
+	}
+}
+
+
+// Index of the last key not after the frame, frames are sorted.
+inline int findKey(const uint16* frames, int count, float frame)
+{
+	int from = 0;
+	int to = count;
+	while (to - from > 1)
+	{
+		int mid = (from + to) >> 1;
+		if (frames[mid] <= frame)
+		{
+			from = mid;
+		}
+		else
+		{
+			to = mid;
+		}
+	}
+	return from;
+}
+
+
+} // namespace AnimationCompression
+
+
+} // namespace Lumix
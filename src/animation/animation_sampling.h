@@ -0,0 +1,115 @@
+#pragma once
+
+
+#include "lumix.h"
+#include <xmmintrin.h>
+
+
+namespace Lumix
+{
+
+
+// Keyframes are stored as structure of arrays, one frame after another. A frame has seven rows
+// (position x, y, z, rotation x, y, z, w), each row has getStride() floats, one per bone,
+// padded with zeros to a multiple of four, so four bones are sampled at once.
+namespace AnimationSampling
+{
+
+
+enum Row
+{
+	POSITION_X,
+	POSITION_Y,
+	POSITION_Z,
+	ROTATION_X,
+	ROTATION_Y,
+	ROTATION_Z,
+	ROTATION_W,
+
+	ROW_COUNT
+};
+
+
+inline int getStride(int bone_count)
+{
+	return (bone_count + 3) & ~3;
+}
+
+
+inline int getFrameSize(int bone_count)
+{
+	return getStride(bone_count) * ROW_COUNT;
+}
+
+
+// Interpolates four bones, positions linearly, rotations with nlerp through the shorter path.
+// Each bone has its own t, rows of a and b are in the order of Row.
+inline void interpolate4(const __m128* LUMIX_RESTRICT a,
+	const __m128* LUMIX_RESTRICT b,
+	__m128 t_position,
+	__m128 t_rotation,
+	float out[ROW_COUNT][4])
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1);
+
+	__m128 inv = _mm_sub_ps(one, t_position);
+	for (int row = POSITION_X; row <= POSITION_Z; ++row)
+	{
+		__m128 weighted_b = _mm_mul_ps(b[row], t_position);
+		_mm_storeu_ps(out[row], _mm_add_ps(_mm_mul_ps(a[row], inv), weighted_b));
+	}
+
+	__m128 dot = zero;
+	for (int row = ROTATION_X; row <= ROTATION_W; ++row)
+	{
+		dot = _mm_add_ps(dot, _mm_mul_ps(a[row], b[row]));
+	}
+	inv = _mm_sub_ps(one, t_rotation);
+	// negate t where the quaternions are in the opposite hemispheres
+	__m128 sign = _mm_and_ps(_mm_cmplt_ps(dot, zero), _mm_set1_ps(-0.0f));
+	t_rotation = _mm_xor_ps(t_rotation, sign);
+
+	__m128 r[4];
+	__m128 length_sq = zero;
+	for (int i = 0; i < 4; ++i)
+	{
+		__m128 weighted_b = _mm_mul_ps(b[ROTATION_X + i], t_rotation);
+		r[i] = _mm_add_ps(_mm_mul_ps(a[ROTATION_X + i], inv), weighted_b);
+		length_sq = _mm_add_ps(length_sq, _mm_mul_ps(r[i], r[i]));
+	}
+	// padding bones are all zeros, keep them zero instead of dividing by zero
+	__m128 is_valid = _mm_cmpgt_ps(length_sq, zero);
+	length_sq = _mm_max_ps(length_sq, _mm_set1_ps(1e-30f));
+	__m128 inv_length = _mm_and_ps(_mm_div_ps(one, _mm_sqrt_ps(length_sq)), is_valid);
+	for (int i = 0; i < 4; ++i)
+	{
+		_mm_storeu_ps(out[ROTATION_X + i], _mm_mul_ps(r[i], inv_length));
+	}
+}
+
+
+// Interpolates bones [bone, bone + 4) between two frames. bone must be a multiple of four.
+inline void sample4(const float* LUMIX_RESTRICT frame0,
+	const float* LUMIX_RESTRICT frame1,
+	int stride,
+	int bone,
+	float t,
+	float out[ROW_COUNT][4])
+{
+	__m128 a[ROW_COUNT];
+	__m128 b[ROW_COUNT];
+	for (int row = 0; row < ROW_COUNT; ++row)
+	{
+		a[row] = _mm_loadu_ps(frame0 + row * stride + bone);
+		b[row] = _mm_loadu_ps(frame1 + row * stride + bone);
+	}
+	__m128 t4 = _mm_set1_ps(t);
+	interpolate4(a, b, t4, t4, out);
+}
+
+
+} // namespace AnimationSampling
+
+
+} // namespace Lumix
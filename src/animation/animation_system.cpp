@@ -3,7 +3,13 @@
 #include "core/base_proxy_allocator.h"
 #include "core/blob.h"
 #include "core/crc32.h"
+#include "core/frame_allocator.h"
+#include "core/hash_map.h"
 #include "core/json_serializer.h"
+#include "core/log.h"
+#include "core/lua_wrapper.h"
+#include "core/math_utils.h"
+#include "core/mtjd/parallel_for.h"
 #include "core/profiler.h"
 #include "core/resource_manager.h"
 #include "editor/asset_browser.h"
@@ -14,6 +20,7 @@
 #include "engine.h"
 #include "engine/property_descriptor.h"
 #include "engine/property_register.h"
+#include "lua_script/lua_script_system.h"
 #include "renderer/model.h"
 #include "renderer/pose.h"
 #include "renderer/render_scene.h"
@@ -25,6 +32,23 @@ namespace Lumix
 
 	static const uint32 RENDERABLE_HASH = crc32("renderable");
 	static const uint32 ANIMABLE_HASH = crc32("animable");
+	static const int ANIMABLES_PER_JOB = 16;
+	// animation LOD, animables are sampled every n-th frame according to the LOD of their
+	// renderable, from SKIP_LEAF_BONES_LOD on without leaf bones, hidden ones are not sampled
+	static const int LOD_UPDATE_PERIODS[] = {1, 2, 4, 4};
+	static const int SKIP_LEAF_BONES_LOD = 2;
+	// animables with shared pose sample at times rounded down to this rate
+	static const float SHARED_POSE_FPS = 30;
+	// getBoneTransform evaluates at most this many bones from the root
+	static const int MAX_BONE_CHAIN_LENGTH = 64;
+
+
+	enum class AnimationSceneVersion : int
+	{
+		SHARED_POSE,
+
+		LAST
+	};
 
 	namespace FS
 	{
@@ -37,15 +61,130 @@ namespace Lumix
 	class Universe;
 
 
-	struct AnimationSceneImpl : public IScene
+	static bool isReady(const Animation* animation)
+	{
+		return animation && animation->isReady();
+	}
+
+
+	static float advanceTime(const Animation* animation, float time, float time_delta)
+	{
+		if (!isReady(animation)) return time;
+
+		float t = time + time_delta;
+		float l = animation->getLength();
+		while (t > l)
+		{
+			t -= l;
+		}
+		return t;
+	}
+
+
+	// mask is null or has true for every bone the layer affects
+	static void blendBones(Vec3* LUMIX_RESTRICT pos,
+		Quat* LUMIX_RESTRICT rot,
+		const Vec3* LUMIX_RESTRICT src_pos,
+		const Quat* LUMIX_RESTRICT src_rot,
+		int count,
+		float weight,
+		const bool* mask)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			if (mask && !mask[i]) continue;
+			lerp(pos[i], src_pos[i], &pos[i], weight);
+			nlerp(rot[i], src_rot[i], &rot[i], weight);
+		}
+	}
+
+
+	// adds the difference between the sampled and the reference pose
+	static void addBones(Vec3* LUMIX_RESTRICT pos,
+		Quat* LUMIX_RESTRICT rot,
+		const Vec3* LUMIX_RESTRICT sampled_pos,
+		const Quat* LUMIX_RESTRICT sampled_rot,
+		const Vec3* LUMIX_RESTRICT ref_pos,
+		const Quat* LUMIX_RESTRICT ref_rot,
+		int count,
+		float weight,
+		const bool* mask)
+	{
+		const Quat identity(0, 0, 0, 1);
+		for (int i = 0; i < count; ++i)
+		{
+			if (mask && !mask[i]) continue;
+			pos[i] += (sampled_pos[i] - ref_pos[i]) * weight;
+			Quat delta = -ref_rot[i] * sampled_rot[i];
+			nlerp(identity, delta, &delta, weight);
+			rot[i] = rot[i] * delta;
+		}
+	}
+
+
+	struct AnimationSceneImpl : public AnimationScene
 	{
+		struct Layer
+		{
+			Animation* animation;
+			float time;
+			// the animation played before, faded out over fade_duration
+			Animation* previous;
+			float previous_time;
+			float fade_time;
+			float fade_duration;
+			float weight;
+			bool is_additive;
+			// hash of the root bone of the mask, 0 for all bones
+			uint32 mask_bone;
+		};
+
+
 		struct Animable
 		{
 			bool m_is_free;
+			bool m_is_pose_shared;
 			ComponentIndex m_renderable;
-			float m_time;
-			class Animation* m_animation;
 			Entity m_entity;
+			// the first layer is the animation set in the editor
+			Layer m_layers[MAX_LAYERS];
+			// set every frame, the animable with the same shared pose which samples it
+			ComponentIndex m_pose_source;
+			// times of the first layer before and after the last update, for root motion
+			float m_root_motion_from;
+			float m_root_motion_to;
+		};
+
+
+		enum class Sampling
+		{
+			NONE,
+			ALL_BONES,
+			SKIP_LEAF_BONES
+		};
+
+
+		struct SharedPoseKey
+		{
+			const Animation* animation;
+			const Model* model;
+			int frame;
+			Sampling sampling;
+		};
+
+
+		struct SharedPose
+		{
+			SharedPoseKey key;
+			ComponentIndex source;
+		};
+
+
+		// scratch bone transformations of a single evaluation
+		struct BonesBuffer
+		{
+			Vec3* positions;
+			Quat* rotations;
 		};
 
 
@@ -54,8 +193,11 @@ namespace Lumix
 			, m_engine(engine)
 			, m_anim_system(anim_system)
 			, m_animables(allocator)
+			, m_shared_poses(allocator)
+			, m_shared_pose_map(allocator)
 		{
 			m_is_game_running = false;
+			m_frame = 0;
 			m_render_scene = nullptr;
 			uint32 hash = crc32("renderer");
 			for (auto* scene : ctx.getScenes())
@@ -66,7 +208,9 @@ namespace Lumix
 					break;
 				}
 			}
-			ASSERT(m_render_scene);
+			// without the renderer, e.g. on a dedicated server, animables have no renderable and
+			// are not sampled
+			if (!m_render_scene) return;
 			m_render_scene->renderableCreated()
 				.bind<AnimationSceneImpl, &AnimationSceneImpl::onRenderableCreated>(this);
 			m_render_scene->renderableDestroyed()
@@ -79,7 +223,7 @@ namespace Lumix
 			for (auto& animable : m_animables)
 			{
 				if (animable.m_is_free) continue;
-				unloadAnimation(animable.m_animation);
+				unloadLayers(animable);
 			}
 
 			m_render_scene = static_cast<RenderScene*>(m_universe.getScene(crc32("renderer")));
@@ -147,11 +291,23 @@ namespace Lumix
 		}
 
 
+		void unloadLayers(Animable& animable)
+		{
+			for (auto& layer : animable.m_layers)
+			{
+				unloadAnimation(layer.animation);
+				unloadAnimation(layer.previous);
+				layer.animation = nullptr;
+				layer.previous = nullptr;
+			}
+		}
+
+
 		void destroyComponent(ComponentIndex component, uint32 type) override
 		{
 			if (type == ANIMABLE_HASH)
 			{
-				unloadAnimation(m_animables[component].m_animation);
+				unloadLayers(m_animables[component]);
 				m_animables[component].m_is_free = true;
 				m_universe.destroyComponent(m_animables[component].m_entity, type, this, component);
 			}
@@ -164,15 +320,20 @@ namespace Lumix
 			for (int i = 0; i < m_animables.size(); ++i)
 			{
 				serializer.write(m_animables[i].m_entity);
-				serializer.write(m_animables[i].m_time);
+				// other layers are set by the game, only the first one is saved
+				const Layer& layer = m_animables[i].m_layers[0];
+				serializer.write(layer.time);
 				serializer.write(m_animables[i].m_is_free);
-				serializer.writeString(
-					m_animables[i].m_animation ? m_animables[i].m_animation->getPath().c_str() : "");
+				serializer.writeString(layer.animation ? layer.animation->getPath().c_str() : "");
+				serializer.write(m_animables[i].m_is_pose_shared);
 			}
 		}
 
 
-		void deserialize(InputBlob& serializer, int) override
+		int getVersion() const override { return (int)AnimationSceneVersion::LAST; }
+
+
+		void deserialize(InputBlob& serializer, int version) override
 		{
 			int32 count;
 			serializer.read(count);
@@ -180,17 +341,17 @@ namespace Lumix
 			for (int i = 0; i < count; ++i)
 			{
 				serializer.read(m_animables[i].m_entity);
-				ComponentIndex renderable =
-					m_render_scene->getRenderableComponent(m_animables[i].m_entity);
-				if (renderable >= 0)
-				{
-					m_animables[i].m_renderable = renderable;
-				}
-				serializer.read(m_animables[i].m_time);
+				initAnimable(m_animables[i], m_animables[i].m_entity);
+				Layer& layer = m_animables[i].m_layers[0];
+				serializer.read(layer.time);
 				serializer.read(m_animables[i].m_is_free);
 				char path[MAX_PATH_LENGTH];
 				serializer.readString(path, sizeof(path));
-				m_animables[i].m_animation = path[0] == '\0' ? nullptr : loadAnimation(Path(path));
+				layer.animation = path[0] == '\0' ? nullptr : loadAnimation(Path(path));
+				if (version > (int)AnimationSceneVersion::SHARED_POSE)
+				{
+					serializer.read(m_animables[i].m_is_pose_shared);
+				}
 				m_universe.addComponent(m_animables[i].m_entity, ANIMABLE_HASH, this, i);
 			}
 		}
@@ -198,25 +359,562 @@ namespace Lumix
 
 		Path getAnimation(ComponentIndex cmp)
 		{
-			return m_animables[cmp].m_animation
-				? m_animables[cmp].m_animation->getPath()
-				: Path("");
+			Animation* animation = m_animables[cmp].m_layers[0].animation;
+			return animation ? animation->getPath() : Path("");
 		}
 
 
 		void setAnimation(ComponentIndex cmp, const Path& path)
 		{
-			unloadAnimation(m_animables[cmp].m_animation);
-			m_animables[cmp].m_animation = loadAnimation(path);
-			m_animables[cmp].m_time = 0;
+			Layer& layer = m_animables[cmp].m_layers[0];
+			unloadAnimation(layer.animation);
+			layer.animation = loadAnimation(path);
+			layer.time = 0;
+		}
+
+
+		ComponentIndex getAnimableComponent(Entity entity) override
+		{
+			return getComponent(entity, ANIMABLE_HASH);
 		}
 
 
-		void updateAnimable(ComponentIndex cmp, float time_delta)
+		Layer* getLayer(ComponentIndex cmp, int layer)
+		{
+			if (cmp < 0 || cmp >= m_animables.size() || m_animables[cmp].m_is_free) return nullptr;
+			if (layer < 0 || layer >= MAX_LAYERS)
+			{
+				g_log_warning.log("animation") << "Invalid animation layer " << layer;
+				return nullptr;
+			}
+			return &m_animables[cmp].m_layers[layer];
+		}
+
+
+		void playAnimation(ComponentIndex cmp,
+			int layer_index,
+			const char* path,
+			float fade_duration) override
+		{
+			Layer* layer = getLayer(cmp, layer_index);
+			if (!layer) return;
+
+			unloadAnimation(layer->previous);
+			layer->previous = nullptr;
+			if (fade_duration > 0 && layer->animation)
+			{
+				layer->previous = layer->animation;
+				layer->previous_time = layer->time;
+			}
+			else
+			{
+				unloadAnimation(layer->animation);
+			}
+			layer->animation = path[0] == '\0' ? nullptr : loadAnimation(Path(path));
+			layer->time = 0;
+			layer->fade_time = 0;
+			layer->fade_duration = fade_duration;
+		}
+
+
+		void setLayerWeight(ComponentIndex cmp, int layer_index, float weight) override
+		{
+			Layer* layer = getLayer(cmp, layer_index);
+			if (layer) layer->weight = Math::clamp(weight, 0.0f, 1.0f);
+		}
+
+
+		void setLayerAdditive(ComponentIndex cmp, int layer_index, bool is_additive) override
+		{
+			Layer* layer = getLayer(cmp, layer_index);
+			if (layer) layer->is_additive = is_additive;
+		}
+
+
+		void setLayerMask(ComponentIndex cmp, int layer_index, const char* bone_name) override
+		{
+			Layer* layer = getLayer(cmp, layer_index);
+			if (layer) layer->mask_bone = bone_name[0] == '\0' ? 0 : crc32(bone_name);
+		}
+
+
+		bool isPoseShared(ComponentIndex cmp) override
+		{
+			return m_animables[cmp].m_is_pose_shared;
+		}
+
+
+		void setPoseShared(ComponentIndex cmp, bool is_shared) override
+		{
+			m_animables[cmp].m_is_pose_shared = is_shared;
+		}
+
+
+		// bind pose of the bone relative to its parent
+		static void getRelativeBindBone(Model& model, int bone, Vec3* pos, Quat* rot)
+		{
+			const Model::Bone& bind = model.getBone(bone);
+			*pos = bind.position;
+			*rot = bind.rotation;
+			if (bind.parent_idx < 0) return;
+
+			const Model::Bone& parent = model.getBone(bind.parent_idx);
+			*pos = -parent.rotation * (bind.position - parent.position);
+			*rot = bind.rotation * -parent.rotation;
+		}
+
+
+		// does not change pos and rot if the animation does not have the bone
+		static void sampleBone(const Animation* animation,
+			float time,
+			uint32 bone_hash,
+			Vec3* pos,
+			Quat* rot)
+		{
+			int index = animation->getBoneIndex(bone_hash);
+			if (index >= 0) animation->getRelativeBone(time, index, pos, rot);
+		}
+
+
+		// the same as sampleLayer for a single bone
+		static void sampleLayerBone(const Layer& layer,
+			float time,
+			uint32 bone_hash,
+			Vec3* pos,
+			Quat* rot)
+		{
+			sampleBone(layer.animation, time, bone_hash, pos, rot);
+			if (!isReady(layer.previous) || layer.fade_time >= layer.fade_duration) return;
+
+			Vec3 previous_pos = *pos;
+			Quat previous_rot = *rot;
+			sampleBone(layer.previous, layer.previous_time, bone_hash, &previous_pos, &previous_rot);
+			float weight = 1 - layer.fade_time / layer.fade_duration;
+			blendBones(pos, rot, &previous_pos, &previous_rot, 1, weight, nullptr);
+		}
+
+
+		// the same as evaluateLayers for a single bone, in_mask tells for each layer whether
+		// the bone is in its mask
+		void evaluateBone(const Animable& animable,
+			Model& model,
+			int bone,
+			const bool* in_mask,
+			Vec3* pos,
+			Quat* rot)
+		{
+			uint32 hash = crc32(model.getBone(bone).name.c_str());
+			getRelativeBindBone(model, bone, pos, rot);
+			const Layer& base = animable.m_layers[0];
+			bool is_shared = canSharePose(animable);
+			sampleLayerBone(base, is_shared ? quantizeTime(base.time) : base.time, hash, pos, rot);
+			for (int i = 1; i < MAX_LAYERS; ++i)
+			{
+				const Layer& layer = animable.m_layers[i];
+				if (layer.weight <= 0 || !isReady(layer.animation) || !in_mask[i]) continue;
+
+				Vec3 sampled_pos = *pos;
+				Quat sampled_rot = *rot;
+				sampleLayerBone(layer, layer.time, hash, &sampled_pos, &sampled_rot);
+				if (layer.is_additive)
+				{
+					Vec3 ref_pos = *pos;
+					Quat ref_rot = *rot;
+					sampleBone(layer.animation, 0, hash, &ref_pos, &ref_rot);
+					addBones(pos,
+						rot,
+						&sampled_pos,
+						&sampled_rot,
+						&ref_pos,
+						&ref_rot,
+						1,
+						layer.weight,
+						nullptr);
+				}
+				else
+				{
+					blendBones(pos, rot, &sampled_pos, &sampled_rot, 1, layer.weight, nullptr);
+				}
+			}
+		}
+
+
+		bool getBoneTransform(ComponentIndex cmp, uint32 bone_hash, Vec3* pos, Quat* rot) override
+		{
+			const Animable& animable = m_animables[cmp];
+			if (animable.m_renderable == INVALID_COMPONENT) return false;
+			Model* model = m_render_scene->getRenderableModel(animable.m_renderable);
+			if (!model || !model->isReady()) return false;
+			auto iter = model->getBoneIndex(bone_hash);
+			if (!iter.isValid()) return false;
+
+			int chain[MAX_BONE_CHAIN_LENGTH];
+			int chain_length = 0;
+			for (int bone = iter.value(); bone >= 0; bone = model->getBone(bone).parent_idx)
+			{
+				if (chain_length == lengthOf(chain)) return false;
+				chain[chain_length] = bone;
+				++chain_length;
+			}
+
+			bool in_mask[MAX_LAYERS];
+			for (int i = 0; i < MAX_LAYERS; ++i)
+			{
+				in_mask[i] = animable.m_layers[i].mask_bone == 0;
+			}
+			bool has_animation = isReady(animable.m_layers[0].animation);
+			for (int i = chain_length - 1; i >= 0; --i)
+			{
+				const Model::Bone& bone = model->getBone(chain[i]);
+				for (int j = 0; j < MAX_LAYERS; ++j)
+				{
+					if (animable.m_layers[j].mask_bone == crc32(bone.name.c_str()))
+					{
+						in_mask[j] = true;
+					}
+				}
+
+				Vec3 bone_pos;
+				Quat bone_rot;
+				if (has_animation)
+				{
+					evaluateBone(animable, *model, chain[i], in_mask, &bone_pos, &bone_rot);
+				}
+				else
+				{
+					getRelativeBindBone(*model, chain[i], &bone_pos, &bone_rot);
+				}
+
+				if (i == chain_length - 1)
+				{
+					*pos = bone_pos;
+					*rot = bone_rot;
+				}
+				else
+				{
+					*pos = *rot * bone_pos + *pos;
+					*rot = bone_rot * *rot;
+				}
+			}
+			return true;
+		}
+
+
+		void getRootMotion(ComponentIndex cmp, Vec3* delta_pos, Quat* delta_rot) override
+		{
+			delta_pos->set(0, 0, 0);
+			delta_rot->set(0, 0, 0, 1);
+			const Animable& animable = m_animables[cmp];
+			const Animation* animation = animable.m_layers[0].animation;
+			if (!isReady(animation) || animable.m_renderable == INVALID_COMPONENT) return;
+			Model* model = m_render_scene->getRenderableModel(animable.m_renderable);
+			if (!model || !model->isReady() || model->getBoneCount() == 0) return;
+
+			uint32 root_hash = crc32(model->getBone(0).name.c_str());
+			float from = animable.m_root_motion_from;
+			float to = animable.m_root_motion_to;
+			// the animation looped, the motion is from -> end and start -> to
+			float times[4] = {from, to, 0, 0};
+			int count = 2;
+			if (to < from)
+			{
+				times[1] = animation->getLength();
+				times[2] = 0;
+				times[3] = to;
+				count = 4;
+			}
+			for (int i = 0; i < count; i += 2)
+			{
+				Vec3 pos0 = model->getBone(0).position;
+				Quat rot0 = model->getBone(0).rotation;
+				Vec3 pos1 = pos0;
+				Quat rot1 = rot0;
+				sampleBone(animation, times[i], root_hash, &pos0, &rot0);
+				sampleBone(animation, times[i + 1], root_hash, &pos1, &rot1);
+				*delta_pos += pos1 - pos0;
+				*delta_rot = *delta_rot * (-rot0 * rot1);
+			}
+		}
+
+
+		void sendMessage(uint32 type, void*) override
+		{
+			static const uint32 register_hash = crc32("registerLuaAPI");
+			if (type == register_hash)
+			{
+				registerLuaAPI();
+			}
+		}
+
+
+		void registerLuaAPI()
+		{
+			auto* scene = m_universe.getScene(crc32("lua_script"));
+			if (!scene) return;
+
+			auto* script_scene = static_cast<LuaScriptScene*>(scene);
+			lua_State* L = script_scene->getGlobalState();
+
+			#define REGISTER_FUNCTION(F) \
+				do { \
+				auto f = &LuaWrapper::wrapMethod<AnimationSceneImpl, \
+					decltype(&AnimationSceneImpl::F), \
+					&AnimationSceneImpl::F>; \
+				LuaWrapper::createSystemFunction(L, "Animation", #F, f); \
+				} while(false) \
+
+			REGISTER_FUNCTION(getAnimableComponent);
+			REGISTER_FUNCTION(playAnimation);
+			REGISTER_FUNCTION(setLayerWeight);
+			REGISTER_FUNCTION(setLayerAdditive);
+			REGISTER_FUNCTION(setLayerMask);
+			REGISTER_FUNCTION(setPoseShared);
+
+			#undef REGISTER_FUNCTION
+		}
+
+
+		BonesBuffer allocateBones(int count)
+		{
+			// jobs of the update allocate in parallel, the frame allocator handles it
+			auto& allocator = m_engine.getFrameAllocator();
+			BonesBuffer buffer;
+			buffer.positions = (Vec3*)allocator.allocate(sizeof(Vec3) * count);
+			buffer.rotations = (Quat*)allocator.allocate(sizeof(Quat) * count);
+			return buffer;
+		}
+
+
+		static void copyBones(BonesBuffer& dst, const Vec3* pos, const Quat* rot, int count)
+		{
+			copyMemory(dst.positions, pos, sizeof(dst.positions[0]) * count);
+			copyMemory(dst.rotations, rot, sizeof(dst.rotations[0]) * count);
+		}
+
+
+		// true for the mask bone and its children, bones are sorted so that parents go first
+		const bool* getMask(const Layer& layer, Model& model)
+		{
+			if (layer.mask_bone == 0) return nullptr;
+
+			int count = model.getBoneCount();
+			bool* mask = (bool*)m_engine.getFrameAllocator().allocate(sizeof(bool) * count);
+			auto iter = model.getBoneIndex(layer.mask_bone);
+			int root = iter.isValid() ? iter.value() : -1;
+			for (int i = 0; i < count; ++i)
+			{
+				int parent = model.getBone(i).parent_idx;
+				mask[i] = i == root || (parent >= 0 && parent < i && mask[parent]);
+			}
+			return mask;
+		}
+
+
+		// samples the layer's animation, crossfaded from the previous one
+		void sampleLayer(const Layer& layer,
+			Model& model,
+			Vec3* pos,
+			Quat* rot,
+			bool skip_leaf_bones)
+		{
+			layer.animation->getRelativePose(layer.time, pos, rot, model, skip_leaf_bones);
+			if (!isReady(layer.previous) || layer.fade_time >= layer.fade_duration) return;
+
+			int count = model.getBoneCount();
+			BonesBuffer previous = allocateBones(count);
+			copyBones(previous, pos, rot, count);
+			layer.previous->getRelativePose(layer.previous_time,
+				previous.positions,
+				previous.rotations,
+				model,
+				skip_leaf_bones);
+			float weight = 1 - layer.fade_time / layer.fade_duration;
+			blendBones(pos, rot, previous.positions, previous.rotations, count, weight, nullptr);
+		}
+
+
+		void evaluateLayers(Animable& animable, Pose& pose, Model& model, bool skip_leaf_bones)
+		{
+			int count = model.getBoneCount();
+			Vec3* pos = pose.getPositions();
+			Quat* rot = pose.getRotations();
+			model.getPose(pose);
+			pose.computeRelative(model);
+
+			sampleLayer(animable.m_layers[0], model, pos, rot, skip_leaf_bones);
+			for (int i = 1; i < MAX_LAYERS; ++i)
+			{
+				const Layer& layer = animable.m_layers[i];
+				if (layer.weight <= 0 || !isReady(layer.animation)) continue;
+
+				// bones out of the animation are copied, so blending does not change them
+				BonesBuffer sampled = allocateBones(count);
+				copyBones(sampled, pos, rot, count);
+				sampleLayer(layer, model, sampled.positions, sampled.rotations, skip_leaf_bones);
+				const bool* mask = getMask(layer, model);
+				if (layer.is_additive)
+				{
+					BonesBuffer ref = allocateBones(count);
+					copyBones(ref, pos, rot, count);
+					layer.animation->getRelativePose(
+						0, ref.positions, ref.rotations, model, skip_leaf_bones);
+					addBones(pos,
+						rot,
+						sampled.positions,
+						sampled.rotations,
+						ref.positions,
+						ref.rotations,
+						count,
+						layer.weight,
+						mask);
+				}
+				else
+				{
+					blendBones(
+						pos, rot, sampled.positions, sampled.rotations, count, layer.weight, mask);
+				}
+			}
+			pose.setIsRelative();
+			pose.computeAbsolute(model);
+		}
+
+
+		// shared poses are sampled at quantized times, so more animables have the same one
+		void samplePose(const Layer& layer, Pose& pose, Model& model, bool skip_leaf_bones)
+		{
+			model.getPose(pose);
+			pose.computeRelative(model);
+			layer.animation->getRelativePose(quantizeTime(layer.time),
+				pose.getPositions(),
+				pose.getRotations(),
+				model,
+				skip_leaf_bones);
+			pose.setIsRelative();
+			pose.computeAbsolute(model);
+		}
+
+
+		static void advanceLayer(Layer& layer, float time_delta)
+		{
+			layer.time = advanceTime(layer.animation, layer.time, time_delta);
+			if (!layer.previous) return;
+			layer.previous_time = advanceTime(layer.previous, layer.previous_time, time_delta);
+			layer.fade_time += time_delta;
+		}
+
+
+		// only the first layer can be shared, other layers and fades are per animable
+		static bool canSharePose(const Animable& animable)
+		{
+			if (!animable.m_is_pose_shared || animable.m_layers[0].previous) return false;
+			for (int i = 1; i < MAX_LAYERS; ++i)
+			{
+				const Layer& layer = animable.m_layers[i];
+				if (layer.weight > 0 && isReady(layer.animation)) return false;
+			}
+			return true;
+		}
+
+
+		static float quantizeTime(float time)
+		{
+			return Math::floor(time * SHARED_POSE_FPS) / SHARED_POSE_FPS;
+		}
+
+
+		Sampling getSampling(ComponentIndex cmp, bool force_sample)
+		{
+			if (force_sample) return Sampling::ALL_BONES;
+
+			int lod = m_render_scene->getRenderableVisibleLOD(m_animables[cmp].m_renderable);
+			int max_lod = lengthOf(LOD_UPDATE_PERIODS) - 1;
+			int period = lod < 0 ? 0 : LOD_UPDATE_PERIODS[Math::minValue(lod, max_lod)];
+			// spread animables with the same period over frames
+			if (period == 0 || (m_frame + cmp) % period != 0) return Sampling::NONE;
+			return lod >= SKIP_LEAF_BONES_LOD ? Sampling::SKIP_LEAF_BONES : Sampling::ALL_BONES;
+		}
+
+
+		// the first animable sampling a shared pose in this frame is its source, the others copy
+		// the pose from it after it's sampled
+		void assignPoseSources()
+		{
+			PROFILE_FUNCTION();
+			m_shared_poses.clear();
+			m_shared_pose_map.clear();
+			for (int i = 0, c = m_animables.size(); i < c; ++i)
+			{
+				Animable& animable = m_animables[i];
+				animable.m_pose_source = INVALID_COMPONENT;
+				if (animable.m_is_free || animable.m_renderable == INVALID_COMPONENT) continue;
+				if (!canSharePose(animable) || !isReady(animable.m_layers[0].animation)) continue;
+				Model* model = m_render_scene->getRenderableModel(animable.m_renderable);
+				if (!m_render_scene->getPose(animable.m_renderable) || !model->isReady()) continue;
+				Sampling sampling = getSampling(i, false);
+				if (sampling == Sampling::NONE) continue;
+
+				SharedPoseKey key;
+				key.animation = animable.m_layers[0].animation;
+				key.model = model;
+				key.frame = int(animable.m_layers[0].time * SHARED_POSE_FPS);
+				key.sampling = sampling;
+				uint32 hash = crc32(&key, sizeof(key));
+				auto iter = m_shared_pose_map.find(hash);
+				if (!iter.isValid())
+				{
+					m_shared_pose_map.insert(hash, m_shared_poses.size());
+					SharedPose& shared = m_shared_poses.emplace();
+					shared.key = key;
+					shared.source = i;
+					continue;
+				}
+				const SharedPose& shared = m_shared_poses[iter.value()];
+				// crc collision
+				if (shared.key.animation != key.animation || shared.key.model != key.model ||
+					shared.key.frame != key.frame || shared.key.sampling != key.sampling)
+				{
+					continue;
+				}
+				animable.m_pose_source = shared.source;
+			}
+		}
+
+
+		void copySharedPose(ComponentIndex cmp)
+		{
+			const Animable& animable = m_animables[cmp];
+			if (animable.m_pose_source == INVALID_COMPONENT) return;
+
+			ComponentIndex source = m_animables[animable.m_pose_source].m_renderable;
+			m_render_scene->getPose(animable.m_renderable)->copy(*m_render_scene->getPose(source));
+		}
+
+
+		// done after the jobs, unloading resources is not thread safe
+		void releaseFinishedFades()
+		{
+			for (auto& animable : m_animables)
+			{
+				if (animable.m_is_free) continue;
+				for (auto& layer : animable.m_layers)
+				{
+					if (layer.previous && layer.fade_time >= layer.fade_duration)
+					{
+						unloadAnimation(layer.previous);
+						layer.previous = nullptr;
+					}
+				}
+			}
+		}
+
+
+		// touches only the animable and the pose of its renderable, so animables can be updated
+		// in parallel; force_sample ignores the animation LOD, the editor preview uses it
+		void updateAnimable(ComponentIndex cmp, float time_delta, bool force_sample)
 		{
 			Animable& animable = m_animables[cmp];
-			if (!animable.m_is_free && animable.m_animation &&
-				animable.m_animation->isReady() && animable.m_renderable != INVALID_COMPONENT)
+			if (!animable.m_is_free && isReady(animable.m_layers[0].animation) &&
+				animable.m_renderable != INVALID_COMPONENT)
 			{
 				auto* pose = m_render_scene->getPose(animable.m_renderable);
 				auto* model = m_render_scene->getRenderableModel(animable.m_renderable);
@@ -224,20 +922,30 @@ namespace Lumix
 				if (!pose) return;
 				if (!model->isReady()) return;
 
-				model->getPose(*pose);
-				pose->computeRelative(*model);
-				animable.m_animation->getPose(
-					animable.m_time,
-					*pose,
-					*model);
+				Sampling sampling = getSampling(cmp, force_sample);
+				// the pose is copied from its source after all animables are sampled
+				bool is_copied = !force_sample && animable.m_pose_source != INVALID_COMPONENT;
+				if (sampling != Sampling::NONE && !is_copied)
+				{
+					bool skip_leaf_bones = sampling == Sampling::SKIP_LEAF_BONES;
+					if (!force_sample && canSharePose(animable))
+					{
+						samplePose(animable.m_layers[0], *pose, *model, skip_leaf_bones);
+					}
+					else
+					{
+						evaluateLayers(animable, *pose, *model, skip_leaf_bones);
+					}
+					// here in the job instead of in every draw of the pose
+					pose->computeSkinningMatrices(*model);
+				}
 
-				float t = animable.m_time + time_delta;
-				float l = animable.m_animation->getLength();
-				while (t > l)
+				animable.m_root_motion_from = animable.m_layers[0].time;
+				for (auto& layer : animable.m_layers)
 				{
-					t -= l;
+					advanceLayer(layer, time_delta);
 				}
-				animable.m_time = t;
+				animable.m_root_motion_to = animable.m_layers[0].time;
 			}
 		}
 
@@ -248,10 +956,34 @@ namespace Lumix
 			if (m_animables.empty()) return;
 			if (!m_is_game_running) return;
 
-			for (int i = 0, c = m_animables.size(); i < c; ++i)
+			++m_frame;
+			assignPoseSources();
+			MTJD::parallelFor(m_engine.getMTJDManager(),
+				0,
+				m_animables.size(),
+				ANIMABLES_PER_JOB,
+				[this, time_delta](int from, int to)
+				{
+					for (int i = from; i < to; ++i)
+					{
+						updateAnimable(i, time_delta, false);
+					}
+				});
+			if (!m_shared_poses.empty())
 			{
-				updateAnimable(i, time_delta);
+				MTJD::parallelFor(m_engine.getMTJDManager(),
+					0,
+					m_animables.size(),
+					ANIMABLES_PER_JOB,
+					[this](int from, int to)
+					{
+						for (int i = from; i < to; ++i)
+						{
+							copySharedPose(i);
+						}
+					});
 			}
+			releaseFinishedFades();
 		}
 
 
@@ -304,32 +1036,55 @@ namespace Lumix
 				}
 			}
 			Animable& animable = src ? *src : m_animables.emplace();
-			animable.m_time = 0;
+			initAnimable(animable, entity);
+
+			m_universe.addComponent(entity, ANIMABLE_HASH, this, cmp);
+			return cmp;
+		}
+
+
+		void initAnimable(Animable& animable, Entity entity)
+		{
 			animable.m_is_free = false;
-			animable.m_renderable = INVALID_COMPONENT;
-			animable.m_animation = nullptr;
+			animable.m_is_pose_shared = false;
+			animable.m_pose_source = INVALID_COMPONENT;
+			animable.m_root_motion_from = 0;
+			animable.m_root_motion_to = 0;
 			animable.m_entity = entity;
-
-			ComponentIndex renderable = m_render_scene->getRenderableComponent(entity);
-			if (renderable >= 0)
+			animable.m_renderable =
+				m_render_scene ? m_render_scene->getRenderableComponent(entity) : INVALID_COMPONENT;
+			for (auto& layer : animable.m_layers)
 			{
-				animable.m_renderable = renderable;
+				layer.animation = nullptr;
+				layer.time = 0;
+				layer.previous = nullptr;
+				layer.previous_time = 0;
+				layer.fade_time = 0;
+				layer.fade_duration = 0;
+				layer.weight = 1;
+				layer.is_additive = false;
+				layer.mask_bone = 0;
 			}
-
-			m_universe.addComponent(entity, ANIMABLE_HASH, this, cmp);
-			return cmp;
 		}
 
 
 		IPlugin& getPlugin() const override { return m_anim_system; }
+		uint32 getUpdateReads() const override { return SceneData::ANIMATION | SceneData::RENDER; }
+		uint32 getUpdateWrites() const override { return SceneData::ANIMATION | SceneData::RENDER; }
+		// reads the renderables, which are deserialized before it
+		bool isDeserializedInParallel() const override { return true; }
 
 
 		Universe& m_universe;
 		IPlugin& m_anim_system;
 		Engine& m_engine;
 		Array<Animable> m_animables;
+		Array<SharedPose> m_shared_poses;
+		// crc32 of SharedPoseKey to the index in m_shared_poses
+		HashMap<uint32, int> m_shared_pose_map;
 		RenderScene* m_render_scene;
 		bool m_is_game_running;
+		uint32 m_frame;
 	};
 
 
@@ -349,6 +1104,11 @@ namespace Lumix
 				"Animation (*.ani)",
 				ResourceManager::ANIMATION,
 				m_allocator));
+			PropertyRegister::add("animable",
+				LUMIX_NEW(m_allocator, BoolPropertyDescriptor<AnimationSceneImpl>)("Share pose",
+					&AnimationSceneImpl::isPoseShared,
+					&AnimationSceneImpl::setPoseShared,
+					m_allocator));
 		}
 
 		IScene* createScene(Universe& ctx) override
@@ -375,6 +1135,7 @@ namespace Lumix
 		}
 
 
+		bool isCreatedInParallel() const override { return true; }
 		void destroy() override {}
 
 		Lumix::IAllocator& m_allocator;
@@ -453,14 +1214,13 @@ namespace Lumix
 			if (cmp.type != ANIMABLE_HASH) return;
 
 			auto* scene = static_cast<AnimationSceneImpl*>(cmp.scene);
-			auto& animable = scene->m_animables[cmp.index];
-			if (!animable.m_animation) return;
-			if (!animable.m_animation->isReady()) return;
+			auto& layer = scene->m_animables[cmp.index].m_layers[0];
+			if (!isReady(layer.animation)) return;
 
 			ImGui::Checkbox("Play", &m_is_playing);
-			if (ImGui::SliderFloat("Time", &animable.m_time, 0, animable.m_animation->getLength()))
+			if (ImGui::SliderFloat("Time", &layer.time, 0, layer.animation->getLength()))
 			{
-				scene->updateAnimable(cmp.index, 0);
+				scene->updateAnimable(cmp.index, 0, true);
 			}
 
 			if (m_is_playing)
@@ -468,7 +1228,7 @@ namespace Lumix
 				ImGui::InputFloat("Time scale", &m_time_scale, 0.1f, 1.0f);
 				m_time_scale = Math::maxValue(0.0f, m_time_scale);
 				float time_delta = m_app.getWorldEditor()->getEngine().getLastTimeDelta();
-				scene->updateAnimable(cmp.index, time_delta * m_time_scale);
+				scene->updateAnimable(cmp.index, time_delta * m_time_scale, true);
 			}
 		}
 
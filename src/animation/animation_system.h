@@ -8,6 +8,44 @@
 namespace Lumix
 {
 
+
+struct Quat;
+struct Vec3;
+
+
+// Animables have layers evaluated in order. The first one replaces the bind pose, the others
+// blend over the result with their weight, or are added to it as a difference from their first
+// frame. A mask limits a layer to a bone and its children. Playing a new animation on a layer
+// crossfades from the old one.
+class AnimationScene : public IScene
+{
+public:
+	static const int MAX_LAYERS = 4;
+
+public:
+	virtual ComponentIndex getAnimableComponent(Entity entity) = 0;
+	virtual void playAnimation(ComponentIndex cmp,
+		int layer,
+		const char* path,
+		float fade_duration) = 0;
+	virtual void setLayerWeight(ComponentIndex cmp, int layer, float weight) = 0;
+	virtual void setLayerAdditive(ComponentIndex cmp, int layer, bool is_additive) = 0;
+	// empty bone_name removes the mask
+	virtual void setLayerMask(ComponentIndex cmp, int layer, const char* bone_name) = 0;
+	// animables with shared pose which play only their first layer sample at quantized times,
+	// those with the same animation, model and time in a frame are sampled once
+	virtual bool isPoseShared(ComponentIndex cmp) = 0;
+	virtual void setPoseShared(ComponentIndex cmp, bool is_shared) = 0;
+
+	// Transformation of the bone in the model space, only the bones from the root to it are
+	// evaluated. False if the model is not ready or does not have the bone. Changes nothing, so
+	// it can be called from worker threads while the scene is not updating.
+	virtual bool getBoneTransform(ComponentIndex cmp, uint32 bone_hash, Vec3* pos, Quat* rot) = 0;
+	// motion of the root bone made by the first layer in the last update, in the model space
+	virtual void getRootMotion(ComponentIndex cmp, Vec3* delta_pos, Quat* delta_rot) = 0;
+};
+
+
 extern "C" {
 LUMIX_ANIMATION_API IPlugin* createPlugin(Engine& engine);
 }
@@ -28,6 +28,21 @@ public:
 	typedef int BufferHandle;
 	static const BufferHandle INVALID_BUFFER_HANDLE;
 
+	// PCM of a buffer, read on the audio thread while the buffer plays
+	class IStream
+	{
+	public:
+		virtual ~IStream() {}
+		// writes at most size bytes starting at pos bytes, returns how many were written
+		virtual int read(int pos, void* data, int size) = 0;
+		// PCM which does not change while the stream lives, nullptr for decoded streams;
+		// devices can share one copy of it by all streams with the same shared data
+		virtual const void* getSharedData() const { return nullptr; }
+		// called by the device, possibly on the audio thread, once the buffer does not need
+		// the stream
+		virtual void destroy() = 0;
+	};
+
 public:
 	virtual ~AudioDevice() {}
 
@@ -35,6 +50,12 @@ public:
 	static void destroy(AudioDevice& device);
 
 	virtual BufferHandle createBuffer(const void* data, int size_bytes, int channels, int sample_rate, int flags) = 0;
+	// the device owns the stream, also if it fails; size_bytes is the size of the whole PCM
+	virtual BufferHandle createBuffer(IStream& stream,
+		int size_bytes,
+		int channels,
+		int sample_rate,
+		int flags) = 0;
 	virtual void setEcho(BufferHandle handle,
 		float wet_dry_mix,
 		float feedback,
@@ -4,15 +4,19 @@
 #include "clip_manager.h"
 #include "core/blob.h"
 #include "core/crc32.h"
+#include "core/hash_map.h"
 #include "core/iallocator.h"
 #include "core/lua_wrapper.h"
 #include "core/matrix.h"
+#include "core/radix_sort.h"
 #include "core/resource_manager.h"
 #include "core/resource_manager_base.h"
 #include "editor/world_editor.h"
 #include "engine/engine.h"
 #include "lua_script/lua_script_system.h"
 #include "universe/universe.h"
+#include <cmath>
+#include <cstdlib>
 
 
 namespace Lumix
@@ -22,6 +26,7 @@ namespace Lumix
 enum class AudioSceneVersion : int
 {
 	ECHO_ZONES,
+	CLIP_PRIORITY,
 
 	LAST
 };
@@ -31,6 +36,13 @@ static const uint32 LISTENER_HASH = crc32("audio_listener");
 static const uint32 AMBIENT_SOUND_HASH = crc32("ambient_sound");
 static const uint32 ECHO_ZONE_HASH = crc32("echo_zone");
 static const uint32 CLIP_RESOURCE_HASH = crc32("CLIP");
+static const int MAX_SOUNDS = 1024;
+static const int DEFAULT_VOICE_LIMIT = 32;
+static const int DEFAULT_CLIP_PRIORITY = 0;
+static const float DEFAULT_CLIP_MAX_DISTANCE = 100.0f;
+static const float ECHO_ZONE_CELL_SIZE = 16.0f;
+// zones spanning more cells are checked for every query instead of filling the grid
+static const int MAX_ECHO_ZONE_CELLS = 8;
 
 
 struct Listener
@@ -60,13 +72,60 @@ struct AmbientSound
 
 struct PlayingSound
 {
+	// INVALID_BUFFER_HANDLE while the sound is virtual
 	AudioDevice::BufferHandle buffer_id;
 	Entity entity;
 	float time;
+	float volume;
+	float echo[4];
+	float audibility;
 	AudioScene::ClipInfo* clip;
+	bool is_active;
+	bool is_3d;
+	bool has_echo;
+};
+
+
+// zone overlapping a cell of the echo zone grid
+struct EchoZoneCell
+{
+	uint32 key;
+	int zone;
 };
 
 
+static int getEchoZoneCellCoord(float value)
+{
+	return int(floorf(value / ECHO_ZONE_CELL_SIZE));
+}
+
+
+// 10 bits per axis, cells 1024 cells apart share keys, so zones found in a cell
+// are still tested against the position
+static uint32 getEchoZoneCellKey(int x, int y, int z)
+{
+	return (uint32(x) & 0x3ff) | ((uint32(y) & 0x3ff) << 10) | ((uint32(z) & 0x3ff) << 20);
+}
+
+
+struct VoiceCandidate
+{
+	int priority;
+	float audibility;
+	int sound;
+};
+
+
+static int compareVoiceCandidates(const void* a, const void* b)
+{
+	auto* x = static_cast<const VoiceCandidate*>(a);
+	auto* y = static_cast<const VoiceCandidate*>(b);
+	if (x->priority != y->priority) return x->priority > y->priority ? -1 : 1;
+	if (x->audibility != y->audibility) return x->audibility > y->audibility ? -1 : 1;
+	return x->sound - y->sound;
+}
+
+
 struct AudioSceneImpl : public AudioScene
 {
 	AudioSceneImpl(AudioSystem& system, Universe& context, IAllocator& allocator)
@@ -77,7 +136,17 @@ struct AudioSceneImpl : public AudioScene
 		, m_device(system.getDevice())
 		, m_ambient_sounds(allocator)
 		, m_echo_zones(allocator)
+		, m_voice_candidates(allocator)
+		, m_echo_zone_cells(allocator)
+		, m_echo_zone_grid(allocator)
+		, m_big_echo_zones(allocator)
+		, m_echo_zone_entities(allocator)
 	{
+		m_echo_zones_dirty = true;
+		m_listener_echo_zone = -1;
+		m_transform_reader = m_universe.getTransformEvents().addReader();
+		m_voice_limit = DEFAULT_VOICE_LIMIT;
+		m_voice_count = 0;
 		m_last_echo_zone_id = 0;
 		m_last_ambient_sound_id = 0;
 		m_listener.entity = INVALID_ENTITY;
@@ -85,16 +154,144 @@ struct AudioSceneImpl : public AudioScene
 		{
 			i.entity = INVALID_ENTITY;
 			i.buffer_id = AudioDevice::INVALID_BUFFER_HANDLE;
+			i.is_active = false;
 		}
 	}
 
 
 	~AudioSceneImpl()
 	{
+		m_universe.getTransformEvents().removeReader(m_transform_reader);
 		clearClips();
 	}
 
 
+	// only few entities are echo zones, their moves are pulled instead of checking every move
+	void readTransformEvents()
+	{
+		const Universe::TransformEvents::Event* events;
+		int count = m_universe.getTransformEvents().read(m_transform_reader, events);
+		if (m_echo_zones_dirty || m_echo_zone_entities.empty()) return;
+		for (int i = 0; i < count; ++i)
+		{
+			if ((events[i].data & Universe::POSITION) == 0) continue;
+			if (!m_echo_zone_entities.find(events[i].entity).isValid()) continue;
+			m_echo_zones_dirty = true;
+			return;
+		}
+	}
+
+
+	void rebuildEchoZoneGrid()
+	{
+		m_echo_zones_dirty = false;
+		m_echo_zone_cells.clear();
+		m_echo_zone_grid.clear();
+		m_big_echo_zones.clear();
+		for (int i = 0; i < m_echo_zones.size(); ++i)
+		{
+			auto& zone = m_echo_zones[i];
+			auto pos = m_universe.getPosition(zone.entity);
+			int from_x = getEchoZoneCellCoord(pos.x - zone.radius);
+			int from_y = getEchoZoneCellCoord(pos.y - zone.radius);
+			int from_z = getEchoZoneCellCoord(pos.z - zone.radius);
+			int to_x = getEchoZoneCellCoord(pos.x + zone.radius);
+			int to_y = getEchoZoneCellCoord(pos.y + zone.radius);
+			int to_z = getEchoZoneCellCoord(pos.z + zone.radius);
+			if (to_x - from_x >= MAX_ECHO_ZONE_CELLS || to_y - from_y >= MAX_ECHO_ZONE_CELLS ||
+				to_z - from_z >= MAX_ECHO_ZONE_CELLS)
+			{
+				m_big_echo_zones.push(i);
+				continue;
+			}
+
+			for (int z = from_z; z <= to_z; ++z)
+			{
+				for (int y = from_y; y <= to_y; ++y)
+				{
+					for (int x = from_x; x <= to_x; ++x)
+					{
+						auto& cell = m_echo_zone_cells.emplace();
+						cell.key = getEchoZoneCellKey(x, y, z);
+						cell.zone = i;
+					}
+				}
+			}
+		}
+		if (m_echo_zone_cells.empty()) return;
+
+		// stable, the zones of a cell stay sorted by index
+		Array<EchoZoneCell> tmp(m_allocator);
+		tmp.resize(m_echo_zone_cells.size());
+		radixSort(&m_echo_zone_cells[0],
+			&tmp[0],
+			m_echo_zone_cells.size(),
+			[](const EchoZoneCell& cell) { return (uint64)cell.key; });
+		for (int i = 0; i < m_echo_zone_cells.size(); ++i)
+		{
+			uint32 key = m_echo_zone_cells[i].key;
+			if (i == 0 || m_echo_zone_cells[i - 1].key != key) m_echo_zone_grid.insert(key, i);
+		}
+	}
+
+
+	bool isInEchoZone(int zone_idx, const Vec3& pos)
+	{
+		auto& zone = m_echo_zones[zone_idx];
+		float dist2 = (pos - m_universe.getPosition(zone.entity)).squaredLength();
+		return dist2 <= zone.radius * zone.radius;
+	}
+
+
+	// cached in update, zones changed since then invalidate it
+	int getListenerEchoZone()
+	{
+		if (m_listener.entity == INVALID_ENTITY) return -1;
+		readTransformEvents();
+		if (m_echo_zones_dirty)
+		{
+			m_listener_echo_zone = getEchoZone(m_universe.getPosition(m_listener.entity));
+		}
+		return m_listener_echo_zone;
+	}
+
+
+	// the first zone containing pos, -1 if there is none
+	int getEchoZone(const Vec3& pos)
+	{
+		readTransformEvents();
+		if (m_echo_zones_dirty) rebuildEchoZoneGrid();
+
+		int result = -1;
+		for (int zone : m_big_echo_zones)
+		{
+			if (isInEchoZone(zone, pos))
+			{
+				result = zone;
+				break;
+			}
+		}
+
+		uint32 key = getEchoZoneCellKey(getEchoZoneCellCoord(pos.x),
+			getEchoZoneCellCoord(pos.y),
+			getEchoZoneCellCoord(pos.z));
+		auto iter = m_echo_zone_grid.find(key);
+		if (!iter.isValid()) return result;
+
+		for (int i = iter.value(); i < m_echo_zone_cells.size(); ++i)
+		{
+			auto& cell = m_echo_zone_cells[i];
+			if (cell.key != key || (result >= 0 && cell.zone > result)) break;
+			if (isInEchoZone(cell.zone, pos))
+			{
+				result = cell.zone;
+				break;
+			}
+		}
+		return result;
+	}
+
+
 	int playSound(int entity, const char* clip_name, bool is_3d)
 	{
 		auto* clip = getClipInfo(clip_name);
@@ -138,6 +335,7 @@ struct AudioSceneImpl : public AudioScene
 
 	void update(float time_delta, bool paused) override
 	{
+		readTransformEvents();
 		if (m_listener.entity != INVALID_ENTITY)
 		{
 			auto pos = m_universe.getPosition(m_listener.entity);
@@ -147,28 +345,134 @@ struct AudioSceneImpl : public AudioScene
 			auto front = orientation.getZVector();
 			auto up = orientation.getYVector();
 			m_device.setListenerOrientation(front.x, front.y, front.z, up.x, up.y, up.z);
+			m_listener_echo_zone = getEchoZone(pos);
+		}
+		else
+		{
+			m_listener_echo_zone = -1;
 		}
 
 		for (int i = 0; i < lengthOf(m_playing_sounds); ++i)
 		{
 			auto& sound = m_playing_sounds[i];
-			if (sound.buffer_id == AudioDevice::INVALID_BUFFER_HANDLE) continue;
+			if (!sound.is_active) continue;
 
-			auto pos = m_universe.getPosition(sound.entity);
-			m_device.setSourcePosition(sound.buffer_id, pos.x, pos.y, pos.z);
 			sound.time += time_delta;
-
 			auto* clip_info = sound.clip;
 			if (!clip_info->looped && sound.time > clip_info->clip->getLengthSeconds())
 			{
-				m_device.stop(sound.buffer_id);
-				m_playing_sounds[i].buffer_id = AudioDevice::INVALID_BUFFER_HANDLE;
+				stopSound(sound);
+				continue;
+			}
+
+			auto pos = m_universe.getPosition(sound.entity);
+			sound.audibility = getAudibility(sound, pos);
+			if (sound.buffer_id != AudioDevice::INVALID_BUFFER_HANDLE)
+			{
+				m_device.setSourcePosition(sound.buffer_id, pos.x, pos.y, pos.z);
 			}
 		}
+		updateVoices();
 		m_device.update(time_delta);
 	}
 
 
+	float getAudibility(const PlayingSound& sound, const Vec3& pos) const
+	{
+		if (!sound.is_3d || m_listener.entity == INVALID_ENTITY) return sound.volume;
+
+		float max_distance = sound.clip->max_distance;
+		float dist = (pos - m_universe.getPosition(m_listener.entity)).length();
+		if (dist >= max_distance) return 0;
+		return sound.volume * (1 - dist / max_distance);
+	}
+
+
+	// gives device voices to the audible sounds with the highest priority, the rest are virtual
+	void updateVoices()
+	{
+		m_voice_candidates.clear();
+		for (int i = 0; i < lengthOf(m_playing_sounds); ++i)
+		{
+			auto& sound = m_playing_sounds[i];
+			if (!sound.is_active) continue;
+
+			auto& candidate = m_voice_candidates.emplace();
+			candidate.priority = sound.clip->priority;
+			candidate.audibility = sound.audibility;
+			candidate.sound = i;
+		}
+		if (m_voice_candidates.empty()) return;
+
+		qsort(&m_voice_candidates[0],
+			m_voice_candidates.size(),
+			sizeof(m_voice_candidates[0]),
+			compareVoiceCandidates);
+
+		// free the voices first, so the promoted sounds have them
+		for (int i = 0; i < m_voice_candidates.size(); ++i)
+		{
+			auto& sound = m_playing_sounds[m_voice_candidates[i].sound];
+			bool is_audible = i < m_voice_limit && sound.audibility > 0;
+			if (!is_audible && sound.buffer_id != AudioDevice::INVALID_BUFFER_HANDLE)
+			{
+				destroyVoice(sound);
+			}
+		}
+		for (int i = 0; i < m_voice_candidates.size() && i < m_voice_limit; ++i)
+		{
+			auto& sound = m_playing_sounds[m_voice_candidates[i].sound];
+			if (sound.audibility > 0 && sound.buffer_id == AudioDevice::INVALID_BUFFER_HANDLE)
+			{
+				createVoice(sound);
+			}
+		}
+	}
+
+
+	bool createVoice(PlayingSound& sound)
+	{
+		auto* clip = sound.clip->clip;
+		int flags = sound.is_3d ? (int)AudioDevice::BufferFlags::IS3D : 0;
+		// the stream keeps the data alive while the audio thread reads it, also after
+		// the clip is unloaded
+		AudioDevice::IStream* stream = clip->createStream();
+		if (!stream) return false;
+		auto buffer = m_device.createBuffer(*stream,
+			clip->getSize(),
+			clip->getChannels(),
+			clip->getSampleRate(),
+			flags);
+		if (buffer == AudioDevice::INVALID_BUFFER_HANDLE) return false;
+
+		// a virtual sound continues where it would be if it played all the time
+		float length = clip->getLengthSeconds();
+		if (sound.time > 0 && length > 0)
+		{
+			m_device.setCurrentTime(buffer, sound.time - length * int(sound.time / length));
+		}
+		auto pos = m_universe.getPosition(sound.entity);
+		m_device.setSourcePosition(buffer, pos.x, pos.y, pos.z);
+		m_device.setVolume(buffer, sound.volume);
+		if (sound.has_echo)
+		{
+			m_device.setEcho(buffer, sound.echo[0], sound.echo[1], sound.echo[2], sound.echo[3]);
+		}
+		m_device.play(buffer, sound.clip->looped);
+		sound.buffer_id = buffer;
+		++m_voice_count;
+		return true;
+	}
+
+
+	void destroyVoice(PlayingSound& sound)
+	{
+		m_device.stop(sound.buffer_id);
+		sound.buffer_id = AudioDevice::INVALID_BUFFER_HANDLE;
+		--m_voice_count;
+	}
+
+
 	bool isAmbientSound3D(ComponentIndex cmp) override
 	{
 		return m_ambient_sounds[getAmbientSoundIdx(cmp)].is_3d;
@@ -194,11 +498,7 @@ struct AudioSceneImpl : public AudioScene
 	{
 		for (auto& i : m_playing_sounds)
 		{
-			if (i.buffer_id != AudioDevice::INVALID_BUFFER_HANDLE)
-			{
-				m_device.stop(i.buffer_id);
-				i.buffer_id = AudioDevice::INVALID_BUFFER_HANDLE;
-			}
+			if (i.is_active) stopSound(i);
 		}
 
 		for (auto& i : m_ambient_sounds)
@@ -263,6 +563,8 @@ struct AudioSceneImpl : public AudioScene
 		zone.component = ++m_last_echo_zone_id;
 		zone.delay = 500.0f;
 		zone.radius = 10;
+		m_echo_zone_entities.insert(entity, zone.component);
+		m_echo_zones_dirty = true;
 		m_universe.addComponent(entity, ECHO_ZONE_HASH, this, zone.component);
 		return zone.component;
 	}
@@ -289,6 +591,7 @@ struct AudioSceneImpl : public AudioScene
 	void setEchoZoneRadius(ComponentIndex cmp, float radius) override
 	{
 		m_echo_zones[getEchoZoneIdx(cmp)].radius = radius;
+		m_echo_zones_dirty = true;
 	}
 
 
@@ -307,6 +610,8 @@ struct AudioSceneImpl : public AudioScene
 		int idx = getEchoZoneIdx(component);
 		auto entity = m_echo_zones[idx].entity;
 		m_echo_zones.eraseFast(idx);
+		m_echo_zone_entities.erase(entity);
+		m_echo_zones_dirty = true;
 		m_universe.destroyComponent(entity, ECHO_ZONE_HASH, this, component);
 
 	}
@@ -368,6 +673,8 @@ struct AudioSceneImpl : public AudioScene
 			if (!clip) continue;
 
 			serializer.write(clip->looped);
+			serializer.write(clip->priority);
+			serializer.write(clip->max_distance);
 			serializer.writeString(clip->name);
 			serializer.writeString(clip->clip->getPath().c_str());
 		}
@@ -393,6 +700,7 @@ struct AudioSceneImpl : public AudioScene
 	{
 		for (auto* clip : m_clips)
 		{
+			stopClipSounds(clip);
 			clip->clip->getResourceManager().get(CLIP_RESOURCE_HASH)->unload(*clip->clip);
 			LUMIX_DELETE(m_allocator, clip);
 		}
@@ -427,6 +735,13 @@ struct AudioSceneImpl : public AudioScene
 			m_clips[i] = clip;
 
 			serializer.read(clip->looped);
+			clip->priority = DEFAULT_CLIP_PRIORITY;
+			clip->max_distance = DEFAULT_CLIP_MAX_DISTANCE;
+			if (version > (int)AudioSceneVersion::CLIP_PRIORITY)
+			{
+				serializer.read(clip->priority);
+				serializer.read(clip->max_distance);
+			}
 			serializer.readString(clip->name, lengthOf(clip->name));
 			clip->name_hash = crc32(clip->name);
 			char path[MAX_PATH_LENGTH];
@@ -455,17 +770,23 @@ struct AudioSceneImpl : public AudioScene
 		{
 			serializer.read(count);
 			m_echo_zones.resize(count);
+			m_echo_zone_entities.clear();
 
 			for (auto& i : m_echo_zones)
 			{
 				serializer.read(i);
+				m_echo_zone_entities.insert(i.entity, i.component);
 				m_universe.addComponent(i.entity, ECHO_ZONE_HASH, this, i.component);
 			}
 		}
+		m_echo_zones_dirty = true;
 	}
 
 
 	int getVersion() const override { return (int)AudioSceneVersion::LAST; }
+	uint32 getUpdateReads() const override { return SceneData::TRANSFORMS | SceneData::AUDIO; }
+	uint32 getUpdateWrites() const override { return SceneData::AUDIO; }
+	bool isDeserializedInParallel() const override { return true; }
 
 
 	bool ownComponentType(uint32 type) const override
@@ -499,20 +820,31 @@ struct AudioSceneImpl : public AudioScene
 		clip->name_hash = crc32(name);
 		clip->clip = static_cast<Clip*>(m_system.getClipManager().load(path));
 		clip->looped = false;
+		clip->priority = DEFAULT_CLIP_PRIORITY;
+		clip->max_distance = DEFAULT_CLIP_MAX_DISTANCE;
 		m_clips.push(clip);
 	}
 
 
-	void removeClip(ClipInfo* info) override
+	void stopSound(PlayingSound& sound)
+	{
+		if (sound.buffer_id != AudioDevice::INVALID_BUFFER_HANDLE) destroyVoice(sound);
+		sound.is_active = false;
+	}
+
+
+	void stopClipSounds(ClipInfo* info)
 	{
 		for (auto& i : m_playing_sounds)
 		{
-			if (i.clip == info && i.buffer_id != AudioDevice::INVALID_BUFFER_HANDLE)
-			{
-				m_device.stop(i.buffer_id);
-				i.buffer_id = AudioDevice::INVALID_BUFFER_HANDLE;
-			}
+			if (i.clip == info && i.is_active) stopSound(i);
 		}
+	}
+
+
+	void removeClip(ClipInfo* info) override
+	{
+		stopClipSounds(info);
 
 		for (auto& i : m_ambient_sounds)
 		{
@@ -553,6 +885,7 @@ struct AudioSceneImpl : public AudioScene
 
 	void setClip(int clip_id, const Path& path) override
 	{
+		stopClipSounds(m_clips[clip_id]);
 		auto* clip = m_clips[clip_id]->clip;
 		if (clip)
 		{
@@ -567,40 +900,41 @@ struct AudioSceneImpl : public AudioScene
 	{
 		for (int i = 0; i < lengthOf(m_playing_sounds); ++i)
 		{
-			if (m_playing_sounds[i].buffer_id == AudioDevice::INVALID_BUFFER_HANDLE)
+			if (!m_playing_sounds[i].is_active)
 			{
 				auto* clip = clip_info->clip;
 				if (!clip->isReady()) return -1;
 
-				int flags = is_3d ? (int)AudioDevice::BufferFlags::IS3D : 0;
-				auto buffer = m_device.createBuffer(clip->getData(),
-					clip->getSize(),
-					clip->getChannels(),
-					clip->getSampleRate(),
-					flags);
-				if (buffer == AudioDevice::INVALID_BUFFER_HANDLE) return -1;
-				m_device.play(buffer, clip_info->looped);
-
 				auto pos = m_universe.getPosition(entity);
-				m_device.setSourcePosition(buffer, pos.x, pos.y, pos.z);
-
 				auto& sound = m_playing_sounds[i];
-				sound.buffer_id = buffer;
+				sound.buffer_id = AudioDevice::INVALID_BUFFER_HANDLE;
 				sound.entity = entity;
 				sound.time = 0;
+				sound.volume = 1;
 				sound.clip = clip_info;
-				
-				for (auto& zone : m_echo_zones)
-				{
-					float dist2 = (pos - m_universe.getPosition(zone.entity)).squaredLength();
-					float r2 = zone.radius * zone.radius;
-					if (dist2 > r2) continue;
+				sound.is_3d = is_3d;
+				sound.has_echo = false;
+				sound.is_active = true;
 
-					float w = dist2 / r2;
-					m_device.setEcho(buffer, 1, 1 - w, zone.delay, zone.delay);
-					break;
+				// 2D sounds are heard where the listener is
+				int zone_idx = is_3d ? getEchoZone(pos) : getListenerEchoZone();
+				if (zone_idx >= 0)
+				{
+					auto& zone = m_echo_zones[zone_idx];
+					Vec3 echo_pos = is_3d ? pos : m_universe.getPosition(m_listener.entity);
+					Vec3 zone_pos = m_universe.getPosition(zone.entity);
+					float dist2 = (echo_pos - zone_pos).squaredLength();
+					float w = zone.radius > 0 ? dist2 / (zone.radius * zone.radius) : 0;
+					sound.has_echo = true;
+					sound.echo[0] = 1;
+					sound.echo[1] = 1 - w;
+					sound.echo[2] = zone.delay;
+					sound.echo[3] = zone.delay;
 				}
 
+				// the sounds are ranked in update, until then a free voice is taken right away
+				sound.audibility = getAudibility(sound, pos);
+				if (m_voice_count < m_voice_limit && sound.audibility > 0) createVoice(sound);
 				return i;
 			}
 		}
@@ -612,8 +946,7 @@ struct AudioSceneImpl : public AudioScene
 	void stop(SoundHandle sound_id) override
 	{
 		ASSERT(sound_id >= 0 && sound_id < lengthOf(m_playing_sounds));
-		m_device.stop(m_playing_sounds[sound_id].buffer_id);
-		m_playing_sounds[sound_id].buffer_id = AudioDevice::INVALID_BUFFER_HANDLE;
+		if (m_playing_sounds[sound_id].is_active) stopSound(m_playing_sounds[sound_id]);
 	}
 
 
@@ -621,7 +954,29 @@ struct AudioSceneImpl : public AudioScene
 	{
 		if (sound_id == AudioScene::INVALID_SOUND_HANDLE) return;
 		ASSERT(sound_id >= 0 && sound_id < lengthOf(m_playing_sounds));
-		m_device.setVolume(m_playing_sounds[sound_id].buffer_id, volume);
+		auto& sound = m_playing_sounds[sound_id];
+		sound.volume = volume;
+		if (sound.buffer_id != AudioDevice::INVALID_BUFFER_HANDLE)
+		{
+			m_device.setVolume(sound.buffer_id, volume);
+		}
+	}
+
+
+	bool isVirtual(SoundHandle sound_id) override
+	{
+		ASSERT(sound_id >= 0 && sound_id < lengthOf(m_playing_sounds));
+		return m_playing_sounds[sound_id].buffer_id == AudioDevice::INVALID_BUFFER_HANDLE;
+	}
+
+
+	int getVoiceLimit() const override { return m_voice_limit; }
+
+
+	void setVoiceLimit(int count) override
+	{
+		ASSERT(count >= 0 && count <= AudioDevice::MAX_PLAYING_SOUNDS);
+		m_voice_limit = count;
 	}
 
 
@@ -632,7 +987,16 @@ struct AudioSceneImpl : public AudioScene
 		float right_delay)
 	{
 		ASSERT(sound_id >= 0 && sound_id < lengthOf(m_playing_sounds));
-		m_device.setEcho(m_playing_sounds[sound_id].buffer_id, wet_dry_mix, feedback, left_delay, right_delay);
+		auto& sound = m_playing_sounds[sound_id];
+		sound.has_echo = true;
+		sound.echo[0] = wet_dry_mix;
+		sound.echo[1] = feedback;
+		sound.echo[2] = left_delay;
+		sound.echo[3] = right_delay;
+		if (sound.buffer_id != AudioDevice::INVALID_BUFFER_HANDLE)
+		{
+			m_device.setEcho(sound.buffer_id, wet_dry_mix, feedback, left_delay, right_delay);
+		}
 	}
 
 	Universe& getUniverse() override { return m_universe; }
@@ -642,13 +1006,24 @@ struct AudioSceneImpl : public AudioScene
 	Array<AmbientSound> m_ambient_sounds;
 	Array<EchoZone> m_echo_zones;
 	int m_last_echo_zone_id;
+	int m_transform_reader;
 	AudioDevice& m_device;
 	Listener m_listener;
 	IAllocator& m_allocator;
 	Universe& m_universe;
 	Array<ClipInfo*> m_clips;
 	AudioSystem& m_system;
-	PlayingSound m_playing_sounds[AudioDevice::MAX_PLAYING_SOUNDS];
+	PlayingSound m_playing_sounds[MAX_SOUNDS];
+	Array<VoiceCandidate> m_voice_candidates;
+	// sorted by key, m_echo_zone_grid maps keys to the first cell
+	Array<EchoZoneCell> m_echo_zone_cells;
+	HashMap<uint32, int> m_echo_zone_grid;
+	Array<int> m_big_echo_zones;
+	HashMap<Entity, ComponentIndex> m_echo_zone_entities;
+	bool m_echo_zones_dirty;
+	int m_listener_echo_zone;
+	int m_voice_limit;
+	int m_voice_count;
 };
 
 
@@ -26,6 +26,10 @@ public:
 		char name[30];
 		uint32 name_hash;
 		bool looped;
+		// sounds with higher priority get device voices first
+		int priority;
+		// 3D sounds further from the listener are inaudible and do not take voices
+		float max_distance;
 	};
 
 public:
@@ -55,9 +59,14 @@ public:
 	virtual bool isAmbientSound3D(ComponentIndex cmp) = 0;
 	virtual void setAmbientSound3D(ComponentIndex cmp, bool is_3d) = 0;
 
+	// only the most important audible sounds play on the device, the rest are virtual: their
+	// time runs and they start playing from it once they get a voice
 	virtual SoundHandle play(Entity entity, ClipInfo* clip, bool is_3d) = 0;
 	virtual void stop(SoundHandle sound_id) = 0;
 	virtual void setVolume(SoundHandle sound_id, float volume) = 0;
+	virtual bool isVirtual(SoundHandle sound_id) = 0;
+	virtual int getVoiceLimit() const = 0;
+	virtual void setVoiceLimit(int count) = 0;
 
 	virtual void setEcho(SoundHandle sound_id,
 		float wet_dry_mix,
@@ -175,11 +175,14 @@ namespace {
 			{
 				stopAudio();
 
-				auto handle = device.createBuffer(clip->getData(),
+				auto* stream = clip->createStream();
+				if (!stream) return true;
+				auto handle = device.createBuffer(*stream,
 					clip->getSize(),
 					clip->getChannels(),
 					clip->getSampleRate(),
 					0);
+				if (handle == AudioDevice::INVALID_BUFFER_HANDLE) return true;
 				device.play(handle, false);
 				m_playing_clip = handle;
 			}
@@ -237,6 +240,8 @@ namespace {
 
 				auto* audio_scene =
 					static_cast<Lumix::AudioScene*>(m_app.getWorldEditor()->getScene(Lumix::crc32("audio")));
+				// clips are edited directly, not by editor commands
+				bool changed = false;
 				int clip_count = audio_scene->getClipCount();
 				for (int clip_id = 0; clip_id < clip_count; ++clip_id)
 				{
@@ -255,6 +260,7 @@ namespace {
 						{
 							Lumix::copyString(clip_info->name, buf);
 							clip_info->name_hash = Lumix::crc32(buf);
+							changed = true;
 						}
 						auto* clip = audio_scene->getClipInfo(clip_id)->clip;
 						char path[Lumix::MAX_PATH_LENGTH];
@@ -263,16 +269,22 @@ namespace {
 							"Clip", "", path, Lumix::lengthOf(path), CLIP_HASH))
 						{
 							audio_scene->setClip(clip_id, Lumix::Path(path));
+							changed = true;
 						}
 						bool looped = audio_scene->getClipInfo(clip_id)->looped;
 						if (ImGui::Checkbox("Looped", &looped))
 						{
 							clip_info->looped = looped;
+							changed = true;
 						}
+						changed |= ImGui::DragInt("Priority", &clip_info->priority);
+						changed |= ImGui::DragFloat(
+							"Max distance", &clip_info->max_distance, 1, 0, FLT_MAX);
 						if (ImGui::Button("Remove"))
 						{
 							audio_scene->removeClip(clip_info);
 							--clip_count;
+							changed = true;
 						}
 						ImGui::TreePop();
 					}
@@ -281,7 +293,9 @@ namespace {
 				if (ImGui::Button("Add"))
 				{
 					audio_scene->addClip("test", Lumix::Path("test.ogg"));
+					changed = true;
 				}
+				if (changed) m_app.getWorldEditor()->markSceneDirty(audio_scene);
 			}
 			ImGui::EndDock();
 		}
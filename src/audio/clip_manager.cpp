@@ -1,38 +1,216 @@
 #include "clip_manager.h"
 #include "core/iallocator.h"
 #include "core/fs/ifile.h"
+#include "core/math_utils.h"
+#include "core/mt/atomic.h"
 #include "core/resource.h"
 #include "lumix.h"
 #define STB_VORBIS_HEADER_ONLY
 #include "stb_vorbis.c"
-#include <cstdlib>
 
 
 namespace Lumix
 {
 
 
+struct Clip::Data
+{
+	explicit Data(IAllocator& allocator)
+		: allocator(allocator)
+		, pcm(allocator)
+		, compressed(allocator)
+		, ref_count(1)
+	{
+	}
+
+
+	void addRef() { MT::atomicIncrement(&ref_count); }
+
+
+	// streams release it on the audio thread
+	void release()
+	{
+		if (MT::atomicDecrement(&ref_count) == 0) LUMIX_DELETE(allocator, this);
+	}
+
+
+	IAllocator& allocator;
+	Array<uint16> pcm;
+	Array<uint8> compressed;
+	volatile int32 ref_count;
+};
+
+
+struct PCMStream : public AudioDevice::IStream
+{
+	explicit PCMStream(Clip::Data& data)
+		: data(data)
+	{
+		data.addRef();
+	}
+
+
+	int read(int pos, void* dest, int size) override
+	{
+		int data_size = data.pcm.size() * sizeof(data.pcm[0]);
+		size = Math::minValue(size, data_size - pos);
+		if (size <= 0) return 0;
+
+		copyMemory(dest, (const uint8*)&data.pcm[0] + pos, size);
+		return size;
+	}
+
+
+	const void* getSharedData() const override { return &data.pcm[0]; }
+
+
+	void destroy() override
+	{
+		Clip::Data& clip_data = data;
+		LUMIX_DELETE(clip_data.allocator, this);
+		clip_data.release();
+	}
+
+
+	Clip::Data& data;
+};
+
+
+struct VorbisStream : public AudioDevice::IStream
+{
+	VorbisStream(Clip::Data& data, stb_vorbis* vorbis, int channels)
+		: data(data)
+		, vorbis(vorbis)
+		, channels(channels)
+		, position(0)
+	{
+		data.addRef();
+	}
+
+
+	~VorbisStream()
+	{
+		stb_vorbis_close(vorbis);
+	}
+
+
+	int read(int pos, void* dest, int size) override
+	{
+		int frame_size = channels * sizeof(short);
+		if (pos != position)
+		{
+			// seeking decodes from the closest page, only loops and setCurrentTime need it
+			stb_vorbis_seek(vorbis, pos / frame_size);
+			position = pos - pos % frame_size;
+		}
+		int frames = stb_vorbis_get_samples_short_interleaved(
+			vorbis, channels, (short*)dest, size / sizeof(short));
+		position += frames * frame_size;
+		return frames * frame_size;
+	}
+
+
+	void destroy() override
+	{
+		Clip::Data& clip_data = data;
+		LUMIX_DELETE(clip_data.allocator, this);
+		clip_data.release();
+	}
+
+
+	Clip::Data& data;
+	stb_vorbis* vorbis;
+	int channels;
+	// in bytes of the decoded PCM
+	int position;
+};
+
+
+Clip::~Clip()
+{
+	if (m_data) m_data->release();
+}
+
+
 void Clip::unload()
 {
-	m_data.clear();
+	if (m_data) m_data->release();
+	m_data = nullptr;
+	m_length = 0;
+}
+
+
+uint16* Clip::getData()
+{
+	if (!m_data || m_data->pcm.empty()) return nullptr;
+	return &m_data->pcm[0];
+}
+
+
+bool Clip::isStreamed() const
+{
+	return m_data && !m_data->compressed.empty();
 }
 
 
 bool Clip::load(FS::IFile& file)
 {
-	short* output = nullptr;
-	auto res = stb_vorbis_decode_memory(
-		(unsigned char*)file.getBuffer(), (int)file.size(), &m_channels, &m_sample_rate, &output);
-	if (res <= 0) return false;
+	int error;
+	auto* vorbis = stb_vorbis_open_memory(
+		(const unsigned char*)file.getBuffer(), (int)file.size(), &error, nullptr);
+	if (!vorbis) return false;
+
+	stb_vorbis_info info = stb_vorbis_get_info(vorbis);
+	m_channels = info.channels;
+	m_sample_rate = info.sample_rate;
+	m_length = (int)stb_vorbis_stream_length_in_samples(vorbis);
+	if (m_length <= 0)
+	{
+		stb_vorbis_close(vorbis);
+		return false;
+	}
+
+	m_data = LUMIX_NEW(m_allocator, Data)(m_allocator);
+	if (getSize() > STREAMING_THRESHOLD)
+	{
+		stb_vorbis_close(vorbis);
+		m_data->compressed.resize((int)file.size());
+		copyMemory(&m_data->compressed[0], file.getBuffer(), file.size());
+		return true;
+	}
 
-	m_data.resize(res * m_channels);
-	copyMemory(&m_data[0], output, res * m_channels * sizeof(m_data[0]));
-	free(output);
+	auto& pcm = m_data->pcm;
+	pcm.resize(m_length * m_channels);
+	int frames = stb_vorbis_get_samples_short_interleaved(
+		vorbis, m_channels, (short*)&pcm[0], pcm.size());
+	stb_vorbis_close(vorbis);
+	if (frames <= 0)
+	{
+		unload();
+		return false;
+	}
 
+	// the length in the header is not exact
+	m_length = frames;
+	pcm.resize(frames * m_channels);
 	return true;
 }
 
 
+AudioDevice::IStream* Clip::createStream()
+{
+	if (!m_data) return nullptr;
+	if (!isStreamed()) return LUMIX_NEW(m_allocator, PCMStream)(*m_data);
+
+	int error;
+	auto& compressed = m_data->compressed;
+	auto* vorbis = stb_vorbis_open_memory(&compressed[0], compressed.size(), &error, nullptr);
+	if (!vorbis) return nullptr;
+
+	return LUMIX_NEW(m_allocator, VorbisStream)(*m_data, vorbis, m_channels);
+}
+
+
 Resource* ClipManager::createResource(const Path& path)
 {
 	return LUMIX_NEW(m_allocator, Clip)(path, getOwner(), m_allocator);
@@ -45,4 +223,4 @@ void ClipManager::destroyResource(Resource& resource)
 }
 
 
-} // namespace Lumix
\ No newline at end of file
+} // namespace Lumix
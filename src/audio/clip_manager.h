@@ -1,6 +1,7 @@
 #pragma once
 
 
+#include "audio_device.h"
 #include "core/array.h"
 #include "core/resource.h"
 #include "core/resource_manager_base.h"
@@ -12,25 +13,44 @@ namespace Lumix
 
 class LUMIX_AUDIO_API Clip : public Resource
 {
+public:
+	// clips with more decoded PCM keep only the compressed data and are decoded while they play
+	static const int STREAMING_THRESHOLD = 1024 * 1024;
+
+	// decoded PCM or compressed data, shared by the clip and its streams
+	struct Data;
+
 public:
 	Clip(const Path& path, ResourceManager& manager, IAllocator& allocator)
 		: Resource(path, manager, allocator)
-		, m_data(allocator)
+		, m_allocator(allocator)
+		, m_data(nullptr)
+		, m_length(0)
 	{
 	}
+	~Clip();
 
 	void unload(void) override;
 	bool load(FS::IFile& file) override;
 	int getChannels() const { return m_channels; }
 	int getSampleRate() const { return m_sample_rate; }
-	int getSize() const { return m_data.size() * sizeof(m_data[0]); }
-	uint16* getData() { return &m_data[0]; }
-	float getLengthSeconds() const { return m_data.size() / float(m_channels * m_sample_rate); }
+	// of the decoded PCM, also for streamed clips
+	int getSize() const { return m_length * m_channels * sizeof(uint16); }
+	// nullptr for streamed clips
+	uint16* getData();
+	float getLengthSeconds() const { return m_length / float(m_sample_rate); }
+	bool isStreamed() const;
+	// PCM for AudioDevice::createBuffer, every playing sound needs its own stream; the stream
+	// keeps the data alive, so the clip can be unloaded while the audio thread still reads it
+	AudioDevice::IStream* createStream();
 
 private:
+	IAllocator& m_allocator;
 	int m_channels;
 	int m_sample_rate;
-	Array<uint16> m_data;
+	// in samples per channel
+	int m_length;
+	Data* m_data;
 };
 
 
@@ -1,8 +1,16 @@
 #include "audio_device.h"
 #include "clip_manager.h"
+#include "core/command_line_parser.h"
 #include "core/log.h"
+#include "core/math_utils.h"
+#include "core/mt/lock_free_fixed_queue.h"
+#include "core/mt/task.h"
+#include "core/mt/thread.h"
+#include "core/profiler.h"
+#include "core/system.h"
 #include "engine/engine.h"
 #include "engine/iplugin.h"
+#include "software_audio_device.h"
 #include <dsound.h>
 
 
@@ -10,6 +18,188 @@ namespace Lumix
 {
 
 
+static bool createDirectSound(Engine& engine, HMODULE* library, LPDIRECTSOUND8* direct_sound)
+{
+	auto coinitialize_result = CoInitialize(nullptr);
+	if (!SUCCEEDED(coinitialize_result))
+	{
+		g_log_error.log("Audio") << "CoInitialize failed. Error code: " << coinitialize_result;
+		ASSERT(false);
+		return false;
+	}
+
+	*library = LoadLibrary("dsound.dll");
+	if (!*library)
+	{
+		g_log_error.log("Audio") << "Failed to load dsound.dll.";
+		return false;
+	}
+	auto* dsoundCreate =
+		(decltype(DirectSoundCreate8)*)GetProcAddress(*library, "DirectSoundCreate8");
+	if (!dsoundCreate)
+	{
+		g_log_error.log("Audio") << "Failed to get DirectSoundCreate8 from dsound.dll.";
+		ASSERT(false);
+		FreeLibrary(*library);
+		*library = nullptr;
+		return false;
+	}
+
+	auto create_result = dsoundCreate(0, direct_sound, nullptr);
+	if (!SUCCEEDED(create_result))
+	{
+		g_log_error.log("Audio") << "Failed to create DirectSound. Error code: " << create_result;
+		ASSERT(false);
+		FreeLibrary(*library);
+		*library = nullptr;
+		*direct_sound = nullptr;
+		return false;
+	}
+
+	HWND hwnd = (HWND)engine.getPlatformData().window_handle;
+	if (!SUCCEEDED((*direct_sound)->SetCooperativeLevel(hwnd, DSSCL_PRIORITY)))
+	{
+		g_log_error.log("Audio") << "Failed to set the cooperative level.";
+		ASSERT(false);
+		(*direct_sound)->Release();
+		FreeLibrary(*library);
+		*library = nullptr;
+		*direct_sound = nullptr;
+		return false;
+	}
+	return true;
+}
+
+
+// one looping buffer the software mixed device writes to, ahead of the play cursor
+class DirectSoundOutput : public AudioOutput
+{
+public:
+	static const int SAMPLE_RATE = 44100;
+	static const int BUFFER_FRAMES = 8192;
+	static const int LATENCY_FRAMES = 2048;
+	static const int FRAME_SIZE = 2 * sizeof(int16);
+
+
+	explicit DirectSoundOutput(Engine& engine)
+		: m_engine(engine)
+		, m_library(nullptr)
+		, m_direct_sound(nullptr)
+		, m_buffer(nullptr)
+		, m_write_pos(0)
+	{
+	}
+
+
+	~DirectSoundOutput()
+	{
+		if (m_buffer) m_buffer->Release();
+		if (m_direct_sound) m_direct_sound->Release();
+		if (m_library) FreeLibrary(m_library);
+	}
+
+
+	bool init()
+	{
+		if (!createDirectSound(m_engine, &m_library, &m_direct_sound)) return false;
+
+		WAVEFORMATEX wave_format = {};
+		wave_format.cbSize = 0;
+		wave_format.nChannels = 2;
+		wave_format.nSamplesPerSec = SAMPLE_RATE;
+		wave_format.wBitsPerSample = 16;
+		wave_format.nBlockAlign = FRAME_SIZE;
+		wave_format.nAvgBytesPerSec = wave_format.nSamplesPerSec * wave_format.nBlockAlign;
+		wave_format.wFormatTag = WAVE_FORMAT_PCM;
+
+		DSBUFFERDESC desc = {};
+		desc.dwSize = sizeof(desc);
+		desc.dwFlags = DSBCAPS_GETCURRENTPOSITION2 | DSBCAPS_GLOBALFOCUS;
+		desc.dwBufferBytes = BUFFER_FRAMES * FRAME_SIZE;
+		desc.lpwfxFormat = &wave_format;
+		if (FAILED(m_direct_sound->CreateSoundBuffer(&desc, &m_buffer, nullptr)))
+		{
+			m_buffer = nullptr;
+			return false;
+		}
+
+		void* p1;
+		void* p2;
+		DWORD s1, s2;
+		if (FAILED(m_buffer->Lock(0, desc.dwBufferBytes, &p1, &s1, &p2, &s2, 0))) return false;
+		ZeroMemory(p1, s1);
+		m_buffer->Unlock(p1, s1, p2, s2);
+		return SUCCEEDED(m_buffer->Play(0, 0, DSBPLAY_LOOPING));
+	}
+
+
+	int getSampleRate() const override { return SAMPLE_RATE; }
+
+
+	int getWritableFrames() override
+	{
+		static const DWORD BUFFER_SIZE = BUFFER_FRAMES * FRAME_SIZE;
+		DWORD play_pos, write_pos;
+		if (FAILED(m_buffer->GetCurrentPosition(&play_pos, &write_pos))) return 0;
+
+		DWORD queued = (m_write_pos + BUFFER_SIZE - play_pos) % BUFFER_SIZE;
+		// never more than the latency is queued, the play cursor passed what was written
+		if (queued > LATENCY_FRAMES * FRAME_SIZE)
+		{
+			m_write_pos = write_pos;
+			queued = (write_pos + BUFFER_SIZE - play_pos) % BUFFER_SIZE;
+		}
+		int queued_frames = int(queued / FRAME_SIZE);
+		return queued_frames < LATENCY_FRAMES ? LATENCY_FRAMES - queued_frames : 0;
+	}
+
+
+	void write(const int16* frames, int count) override
+	{
+		static const DWORD BUFFER_SIZE = BUFFER_FRAMES * FRAME_SIZE;
+		void* p1;
+		void* p2;
+		DWORD s1, s2;
+		DWORD size = count * FRAME_SIZE;
+		if (FAILED(m_buffer->Lock(m_write_pos, size, &p1, &s1, &p2, &s2, 0))) return;
+
+		memcpy(p1, frames, s1);
+		if (p2) memcpy(p2, (const uint8*)frames + s1, s2);
+		m_buffer->Unlock(p1, s1, p2, s2);
+		m_write_pos = (m_write_pos + size) % BUFFER_SIZE;
+	}
+
+
+	Engine& m_engine;
+	HMODULE m_library;
+	LPDIRECTSOUND8 m_direct_sound;
+	LPDIRECTSOUNDBUFFER m_buffer;
+	DWORD m_write_pos;
+};
+
+
+struct AudioDeviceImpl;
+
+
+// executes the commands of the main thread and refills streamed buffers, so audio does not
+// stutter when a frame takes longer than half of STREAM_SIZE
+class AudioTask : public MT::Task
+{
+public:
+	AudioTask(AudioDeviceImpl& device, IAllocator& allocator)
+		: MT::Task(allocator)
+		, m_device(device)
+	{
+	}
+
+
+	int task() override;
+
+
+	AudioDeviceImpl& m_device;
+};
+
+
 struct AudioDeviceImpl : public AudioDevice
 {
 	struct Buffer
@@ -18,22 +208,77 @@ struct AudioDeviceImpl : public AudioDevice
 		LPDIRECTSOUND3DBUFFER8 handle_3d;
 		IDirectSoundBuffer8* handle8;
 		const void* data;
+		// reads the data while the buffer plays, data is nullptr then
+		IStream* stream;
 		DWORD data_size;
+		// to the sound buffer, the position in it is written % STREAM_SIZE
 		DWORD written;
-		int sparse_idx;
+		// next byte of data to write, the main thread reads it in getCurrentTime
+		volatile DWORD data_pos;
+		bool looped;
+		// duplicate of a cached buffer, it has no effects
+		bool is_shared;
+	};
+
+
+	// the PCM of non streamed buffers with the same shared data is created once, the played
+	// buffers are its duplicates
+	struct SharedBuffer
+	{
+		const void* key;
+		LPDIRECTSOUNDBUFFER buffer;
+		// keeps the key alive
+		IStream* owner;
+		uint32 last_used;
+		bool is_3d;
+	};
+
+
+	struct Command
+	{
+		enum Type : uint8
+		{
+			ADD_BUFFER,
+			PLAY,
+			STOP,
+			PAUSE,
+			SET_VOLUME,
+			SET_FREQUENCY,
+			SET_CURRENT_TIME,
+			SET_SOURCE_POSITION,
+			SET_LISTENER_POSITION,
+			SET_LISTENER_ORIENTATION,
+			SET_ECHO
+		};
+
+		Type type;
+		BufferHandle handle;
 		bool looped;
+		float values[6];
+		Buffer buffer;
 	};
 
+
+	static const int STREAM_SIZE = 32768;
+	static const int COMMAND_QUEUE_SIZE = 1024;
+	static const int AUDIO_THREAD_PERIOD_MS = 5;
+	static const int MAX_SHARED_BUFFERS = 64;
+
 	Engine* m_engine;
 	HMODULE m_library;
 	LPDIRECTSOUND8 m_direct_sound;
 	LPDIRECTSOUNDBUFFER m_primary_buffer;
 	LPDIRECTSOUND3DLISTENER8 m_listener;
+	// indexed by handles, touched only by the audio thread
 	Buffer m_buffers[MAX_PLAYING_SOUNDS];
-	int m_buffer_map[MAX_PLAYING_SOUNDS];
-	int m_buffer_count;
-
-	static const int STREAM_SIZE = 32768;
+	// the main thread's copies of the handles, for queries; nullptr for free handles
+	LPDIRECTSOUNDBUFFER m_main_handles[MAX_PLAYING_SOUNDS];
+	bool m_main_is_streamed[MAX_PLAYING_SOUNDS];
+	SharedBuffer m_shared_buffers[MAX_SHARED_BUFFERS];
+	uint32 m_shared_buffer_counter;
+	MT::LockFreeFixedQueue<Command, COMMAND_QUEUE_SIZE> m_commands;
+	AudioTask* m_task;
+	volatile bool m_is_quitting;
 
 	AudioDeviceImpl()
 	{
@@ -42,11 +287,16 @@ struct AudioDeviceImpl : public AudioDevice
 		m_direct_sound = nullptr;
 		m_primary_buffer = nullptr;
 		m_listener = nullptr;
-		m_buffer_count = 0;
-		for (auto& i : m_buffer_map)
+		m_task = nullptr;
+		m_is_quitting = false;
+		setMemory(m_buffers, 0, sizeof(m_buffers));
+		for (auto& i : m_main_handles)
 		{
-			i = INVALID_BUFFER_HANDLE;
+			i = nullptr;
 		}
+		setMemory(m_main_is_streamed, 0, sizeof(m_main_is_streamed));
+		setMemory(m_shared_buffers, 0, sizeof(m_shared_buffers));
+		m_shared_buffer_counter = 0;
 	}
 
 
@@ -89,56 +339,40 @@ struct AudioDeviceImpl : public AudioDevice
 	{
 		m_engine = &engine;
 
-		auto coinitialize_result = CoInitialize(nullptr);
-		if (!SUCCEEDED(coinitialize_result))
-		{
-			g_log_error.log("Audio") << "CoInitialize failed. Error code: " << coinitialize_result;
-			ASSERT(false);
-			return false;
-		}
-
-		m_library = LoadLibrary("dsound.dll");
-		if (!m_library)
-		{
-			g_log_error.log("Audio") << "Failed to load dsound.dll.";
-			return false;
-		}
-		auto* dsoundCreate =
-			(decltype(DirectSoundCreate8)*)GetProcAddress(m_library, "DirectSoundCreate8");
-		if (!dsoundCreate)
-		{
-			g_log_error.log("Audio") << "Failed to get DirectSoundCreate8 from dsound.dll.";
-			ASSERT(false);
-			FreeLibrary(m_library);
-			return false;
-		}
-
-		auto create_result = dsoundCreate(0, &m_direct_sound, nullptr);
-		if (!SUCCEEDED(create_result))
-		{
-			g_log_error.log("Audio") << "Failed to create DirectSound. Error code: " << create_result;
-			ASSERT(false);
-			FreeLibrary(m_library);
-			return false;
-		}
-
-		HWND hwnd = (HWND)engine.getPlatformData().window_handle;
-		auto result = SUCCEEDED(m_direct_sound->SetCooperativeLevel(hwnd, DSSCL_PRIORITY));
-		if (!result || !initPrimaryBuffer())
+		if (!createDirectSound(engine, &m_library, &m_direct_sound)) return false;
+		if (!initPrimaryBuffer())
 		{
 			g_log_error.log("Audio") << "Failed to initialize the primary buffer.";
 			ASSERT(false);
-			m_direct_sound->Release();
-			FreeLibrary(m_library);
 			return false;
 		}
 
+		m_task = LUMIX_NEW(engine.getAllocator(), AudioTask)(*this, engine.getAllocator());
+		m_task->create("AudioTask");
+		m_task->setPriority(THREAD_PRIORITY_TIME_CRITICAL);
+		m_task->run();
+
 		return true;
 	}
 
 
 	~AudioDeviceImpl()
 	{
+		if (m_task)
+		{
+			m_is_quitting = true;
+			m_task->destroy();
+			LUMIX_DELETE(m_engine->getAllocator(), m_task);
+			executeCommands();
+			for (auto& buffer : m_buffers)
+			{
+				if (buffer.handle) releaseBuffer(buffer);
+			}
+		}
+		for (auto& shared : m_shared_buffers)
+		{
+			if (shared.buffer) releaseSharedBuffer(shared);
+		}
 		if (m_listener) m_listener->Release();
 		if (m_primary_buffer) m_primary_buffer->Release();
 		if (m_direct_sound) m_direct_sound->Release();
@@ -146,24 +380,160 @@ struct AudioDeviceImpl : public AudioDevice
 	}
 
 
+	Command& beginCommand(Command::Type type, BufferHandle handle)
+	{
+		// waits for the audio thread if the queue is full
+		Command* cmd = m_commands.alloc(true);
+		cmd->type = type;
+		cmd->handle = handle;
+		return *cmd;
+	}
+
+
+	void endCommand(Command& cmd) { m_commands.push(&cmd, true); }
+
+
+	void pushCommand(Command::Type type, BufferHandle handle, float value)
+	{
+		Command& cmd = beginCommand(type, handle);
+		cmd.values[0] = value;
+		endCommand(cmd);
+	}
+
+
+	void pushCommand(Command::Type type, BufferHandle handle, float x, float y, float z)
+	{
+		Command& cmd = beginCommand(type, handle);
+		cmd.values[0] = x;
+		cmd.values[1] = y;
+		cmd.values[2] = z;
+		endCommand(cmd);
+	}
+
+
+	static DWORD readData(const void* data, IStream* stream, DWORD pos, void* dest, DWORD size)
+	{
+		if (stream) return (DWORD)stream->read(pos, dest, size);
+
+		memcpy(dest, (const uint8*)data + pos, size);
+		return size;
+	}
+
+
 	BufferHandle createBuffer(const void* data,
 		int data_size,
 		int channels,
 		int sample_rate,
 		int flags) override
 	{
-		if (m_buffer_count == MAX_PLAYING_SOUNDS) return INVALID_BUFFER_HANDLE;
+		return createBuffer(data, nullptr, data_size, channels, sample_rate, flags);
+	}
+
+
+	BufferHandle createBuffer(IStream& stream,
+		int data_size,
+		int channels,
+		int sample_rate,
+		int flags) override
+	{
+		return createBuffer(nullptr, &stream, data_size, channels, sample_rate, flags);
+	}
+
+
+	BufferHandle createBuffer(const void* data,
+		IStream* stream,
+		int data_size,
+		int channels,
+		int sample_rate,
+		int flags)
+	{
+		BufferHandle handle = INVALID_BUFFER_HANDLE;
+		for (int i = 0; i < lengthOf(m_main_handles); ++i)
+		{
+			if (!m_main_handles[i])
+			{
+				handle = i;
+				break;
+			}
+		}
+		if (handle == INVALID_BUFFER_HANDLE)
+		{
+			if (stream) stream->destroy();
+			return INVALID_BUFFER_HANDLE;
+		}
 
 		int buffer_size = data_size > STREAM_SIZE ? STREAM_SIZE : data_size;
-		DSBUFFERDESC desc = {};
-		LPDIRECTSOUNDBUFFER buffer;
-		desc.dwSize = sizeof(desc);
-		desc.dwFlags = DSBCAPS_CTRLVOLUME | DSBCAPS_GETCURRENTPOSITION2 | DSBCAPS_CTRLFREQUENCY |
-					   DSBCAPS_CTRLFX;
 		bool is_3d = (flags & (int)BufferFlags::IS3D) != 0;
-		if (is_3d) desc.dwFlags |= DSBCAPS_CTRL3D;
-		desc.dwBufferBytes = buffer_size;
+		LPDIRECTSOUNDBUFFER buffer = nullptr;
+		bool is_shared = false;
+		if (stream && data_size <= STREAM_SIZE && stream->getSharedData())
+		{
+			buffer = duplicateSharedBuffer(stream, data_size, channels, sample_rate, is_3d);
+			is_shared = buffer != nullptr;
+			// the cache took the stream
+			if (!buffer && !stream) return INVALID_BUFFER_HANDLE;
+		}
+		if (!buffer)
+		{
+			buffer = createFilledBuffer(
+				data, stream, buffer_size, channels, sample_rate, getBufferFlags(is_3d, true));
+		}
+		// the buffer holds all the data, nothing is streamed
+		if (stream && (!buffer || data_size <= STREAM_SIZE))
+		{
+			stream->destroy();
+			stream = nullptr;
+		}
+		if (!buffer) return INVALID_BUFFER_HANDLE;
+
+		LPDIRECTSOUND3DBUFFER8 source = nullptr;
+		if (is_3d)
+		{
+			if (SUCCEEDED(buffer->QueryInterface(IID_IDirectSound3DBuffer8, (void**)&source)))
+			{
+				source->SetMaxDistance(10000, DS3D_DEFERRED);
+				source->SetMinDistance(2, DS3D_DEFERRED);
+				source->SetMode(DS3DMODE_NORMAL, DS3D_DEFERRED);
+			}
+		}
+
+		m_main_handles[handle] = buffer;
+		m_main_is_streamed[handle] = data_size > STREAM_SIZE;
+		Command& cmd = beginCommand(Command::ADD_BUFFER, handle);
+		cmd.buffer.handle = buffer;
+		cmd.buffer.data = data;
+		cmd.buffer.stream = stream;
+		cmd.buffer.data_size = data_size;
+		cmd.buffer.written = buffer_size;
+		cmd.buffer.data_pos = buffer_size;
+		cmd.buffer.handle_3d = source;
+		cmd.buffer.handle8 = nullptr;
+		cmd.buffer.looped = false;
+		cmd.buffer.is_shared = is_shared;
+		buffer->QueryInterface(IID_IDirectSoundBuffer8, (void**)&cmd.buffer.handle8);
+		endCommand(cmd);
+		return handle;
+	}
 
+
+	static DWORD getBufferFlags(bool is_3d, bool has_fx)
+	{
+		DWORD flags = DSBCAPS_CTRLVOLUME | DSBCAPS_GETCURRENTPOSITION2 | DSBCAPS_CTRLFREQUENCY;
+		if (is_3d) flags |= DSBCAPS_CTRL3D;
+		// duplicates of buffers with effects can not be created
+		if (has_fx) flags |= DSBCAPS_CTRLFX;
+		return flags;
+	}
+
+
+	// nullptr if it fails, the stream is only read
+	LPDIRECTSOUNDBUFFER createFilledBuffer(const void* data,
+		IStream* stream,
+		int buffer_size,
+		int channels,
+		int sample_rate,
+		DWORD flags)
+	{
 		WAVEFORMATEX wave_format = {};
 		wave_format.cbSize = 0;
 		wave_format.nChannels = channels;
@@ -173,66 +543,147 @@ struct AudioDeviceImpl : public AudioDevice
 		wave_format.nAvgBytesPerSec = wave_format.nSamplesPerSec * wave_format.nBlockAlign;
 		wave_format.wFormatTag = WAVE_FORMAT_PCM;
 
+		DSBUFFERDESC desc = {};
+		desc.dwSize = sizeof(desc);
+		desc.dwFlags = flags;
+		desc.dwBufferBytes = buffer_size;
 		desc.lpwfxFormat = &wave_format;
-		auto result = SUCCEEDED(m_direct_sound->CreateSoundBuffer(&desc, &buffer, nullptr));
-		if (!result) return INVALID_BUFFER_HANDLE;
+		LPDIRECTSOUNDBUFFER buffer;
+		if (FAILED(m_direct_sound->CreateSoundBuffer(&desc, &buffer, nullptr))) return nullptr;
 
 		void* p1;
 		void* p2;
 		DWORD s1, s2;
-		result = SUCCEEDED(buffer->Lock(0, buffer_size, &p1, &s1, &p2, &s2, 0));
-		if (!result)
+		bool result = SUCCEEDED(buffer->Lock(0, buffer_size, &p1, &s1, &p2, &s2, 0));
+		if (result)
 		{
-			buffer->Release();
-			return INVALID_BUFFER_HANDLE;
+			DWORD read = readData(data, stream, 0, p1, s1);
+			if (read < s1) ZeroMemory((uint8*)p1 + read, s1 - read);
+			result = SUCCEEDED(buffer->Unlock(p1, s1, p2, s2));
 		}
-		memcpy(p1, data, s1);
-		result = SUCCEEDED(buffer->Unlock(p1, s1, p2, s2));
+		result = result && SUCCEEDED(buffer->SetCurrentPosition(0));
 		if (!result)
 		{
 			buffer->Release();
-			return INVALID_BUFFER_HANDLE;
+			return nullptr;
 		}
-		result = SUCCEEDED(buffer->SetCurrentPosition(0));
-		if (!result)
+		return buffer;
+	}
+
+
+	void releaseSharedBuffer(SharedBuffer& shared)
+	{
+		// duplicates keep the PCM alive
+		shared.buffer->Release();
+		shared.owner->destroy();
+		setMemory(&shared, 0, sizeof(shared));
+	}
+
+
+	// the cache takes the stream if it creates a new shared buffer, stream is nullptr then
+	LPDIRECTSOUNDBUFFER duplicateSharedBuffer(IStream*& stream,
+		int data_size,
+		int channels,
+		int sample_rate,
+		bool is_3d)
+	{
+		const void* key = stream->getSharedData();
+		SharedBuffer* shared = nullptr;
+		SharedBuffer* lru = &m_shared_buffers[0];
+		for (auto& i : m_shared_buffers)
+		{
+			if (i.buffer && i.key == key && i.is_3d == is_3d)
+			{
+				shared = &i;
+				break;
+			}
+			if (!lru->buffer) continue;
+			if (!i.buffer || i.last_used < lru->last_used) lru = &i;
+		}
+
+		if (!shared)
+		{
+			auto* master = createFilledBuffer(
+				nullptr, stream, data_size, channels, sample_rate, getBufferFlags(is_3d, false));
+			if (!master) return nullptr;
+
+			if (lru->buffer) releaseSharedBuffer(*lru);
+			shared = lru;
+			shared->key = key;
+			shared->buffer = master;
+			shared->owner = stream;
+			shared->is_3d = is_3d;
+			stream = nullptr;
+		}
+
+		shared->last_used = ++m_shared_buffer_counter;
+		LPDIRECTSOUNDBUFFER buffer;
+		if (FAILED(m_direct_sound->DuplicateSoundBuffer(shared->buffer, &buffer))) return nullptr;
+		if (FAILED(buffer->SetCurrentPosition(0)))
 		{
 			buffer->Release();
-			return INVALID_BUFFER_HANDLE;
+			return nullptr;
 		}
+		return buffer;
+	}
 
-		LPDIRECTSOUND3DBUFFER8 source = nullptr;
-		if (is_3d)
+
+	// replaces a duplicate with its own copy of the PCM, which can have effects
+	bool unshareBuffer(Buffer& buffer)
+	{
+		WAVEFORMATEX format;
+		DWORD status, play_pos, write_pos, frequency;
+		LONG volume;
+		if (FAILED(buffer.handle->GetFormat(&format, sizeof(format), nullptr))) return false;
+		if (FAILED(buffer.handle->GetStatus(&status))) return false;
+		buffer.handle->GetCurrentPosition(&play_pos, &write_pos);
+		buffer.handle->GetVolume(&volume);
+		buffer.handle->GetFrequency(&frequency);
+		D3DVECTOR position = {};
+		if (buffer.handle_3d) buffer.handle_3d->GetPosition(&position);
+
+		void* p1;
+		void* p2;
+		DWORD s1, s2;
+		if (FAILED(buffer.handle->Lock(0, 0, &p1, &s1, &p2, &s2, DSBLOCK_ENTIREBUFFER)))
 		{
-			if (SUCCEEDED(buffer->QueryInterface(IID_IDirectSound3DBuffer8, (void**)&source)))
-			{
-				source->SetMaxDistance(10000, DS3D_DEFERRED);
-				source->SetMinDistance(2, DS3D_DEFERRED);
-				source->SetMode(DS3DMODE_NORMAL, DS3D_DEFERRED);
-			}
+			return false;
 		}
+		auto* copy = createFilledBuffer(p1,
+			nullptr,
+			s1,
+			format.nChannels,
+			format.nSamplesPerSec,
+			getBufferFlags(buffer.handle_3d != nullptr, true));
+		buffer.handle->Unlock(p1, s1, p2, s2);
+		if (!copy) return false;
 
-		for (int i = 0; i < lengthOf(m_buffer_map); ++i)
+		buffer.handle->Stop();
+		if (buffer.handle_3d) buffer.handle_3d->Release();
+		if (buffer.handle8) buffer.handle8->Release();
+		buffer.handle->Release();
+
+		buffer.handle = copy;
+		buffer.handle8 = nullptr;
+		buffer.is_shared = false;
+		copy->QueryInterface(IID_IDirectSoundBuffer8, (void**)&buffer.handle8);
+		copy->SetVolume(volume);
+		copy->SetFrequency(frequency);
+		copy->SetCurrentPosition(play_pos);
+		if (buffer.handle_3d)
 		{
-			if (m_buffer_map[i] == INVALID_BUFFER_HANDLE)
+			auto** handle_3d = (void**)&buffer.handle_3d;
+			buffer.handle_3d = nullptr;
+			if (SUCCEEDED(copy->QueryInterface(IID_IDirectSound3DBuffer8, handle_3d)))
 			{
-				m_buffer_map[i] = m_buffer_count;
-				m_buffers[m_buffer_count].handle = buffer;
-				m_buffers[m_buffer_count].data = data;
-				m_buffers[m_buffer_count].data_size = data_size;
-				m_buffers[m_buffer_count].written = buffer_size;
-				m_buffers[m_buffer_count].sparse_idx = i;
-				m_buffers[m_buffer_count].handle_3d = source;
-				m_buffers[m_buffer_count].handle8 = nullptr;
-				buffer->QueryInterface(
-					IID_IDirectSoundBuffer8, (void**)&m_buffers[m_buffer_count].handle8);
-				++m_buffer_count;
-				return i;
+				buffer.handle_3d->SetMaxDistance(10000, DS3D_DEFERRED);
+				buffer.handle_3d->SetMinDistance(2, DS3D_DEFERRED);
+				buffer.handle_3d->SetMode(DS3DMODE_NORMAL, DS3D_DEFERRED);
+				buffer.handle_3d->SetPosition(position.x, position.y, position.z, DS3D_DEFERRED);
 			}
 		}
-
-		ASSERT(false);
-		buffer->Release();
-		return INVALID_BUFFER_HANDLE;
+		if (status & DSBSTATUS_PLAYING) copy->Play(0, 0, DSBPLAY_LOOPING);
+		return true;
 	}
 
 
@@ -242,10 +693,25 @@ struct AudioDeviceImpl : public AudioDevice
 		float left_delay,
 		float right_delay) override
 	{
-		auto buffer = m_buffers[m_buffer_map[handle]];
+		Command& cmd = beginCommand(Command::SET_ECHO, handle);
+		cmd.values[0] = wet_dry_mix;
+		cmd.values[1] = feedback;
+		cmd.values[2] = left_delay;
+		cmd.values[3] = right_delay;
+		endCommand(cmd);
+	}
+
+
+	void executeSetEcho(Buffer& buffer,
+		float wet_dry_mix,
+		float feedback,
+		float left_delay,
+		float right_delay)
+	{
 		DSEFFECTDESC echo_effect = {};
 		echo_effect.dwSize = sizeof(DSEFFECTDESC);
 		echo_effect.guidDSFXClass = GUID_DSFX_STANDARD_ECHO;
+		if (buffer.is_shared && !unshareBuffer(buffer)) return;
 		if (!buffer.handle8) return;
 
 		DWORD buffer_status;
@@ -296,7 +762,7 @@ struct AudioDeviceImpl : public AudioDevice
 	
 	bool isPlaying(BufferHandle handle) override
 	{
-		auto buffer = m_buffers[m_buffer_map[handle]].handle;
+		auto buffer = m_main_handles[handle];
 		DWORD status;
 		if (FAILED(buffer->GetStatus(&status))) return false;
 
@@ -306,74 +772,80 @@ struct AudioDeviceImpl : public AudioDevice
 
 	void play(BufferHandle handle, bool looped) override
 	{
-		auto& buffer = m_buffers[m_buffer_map[handle]];
-		buffer.looped = looped;
-		buffer.handle->Play(0, 0, DSBPLAY_LOOPING);
+		Command& cmd = beginCommand(Command::PLAY, handle);
+		cmd.looped = looped;
+		endCommand(cmd);
 	}
 
 
 	void stop(BufferHandle handle) override
 	{
-		--m_buffer_count;
-		int dense_idx = m_buffer_map[handle];
+		// the audio thread releases the buffer, the handle can be reused right away because
+		// commands are executed in order
+		m_main_handles[handle] = nullptr;
+		endCommand(beginCommand(Command::STOP, handle));
+	}
+
 
-		auto& buffer = m_buffers[dense_idx];
+	void releaseBuffer(Buffer& buffer)
+	{
 		buffer.handle->Stop();
 		if (buffer.handle_3d) buffer.handle_3d->Release();
 		if (buffer.handle8) buffer.handle8->Release();
 		buffer.handle->Release();
-
-		m_buffers[dense_idx] = m_buffers[m_buffer_count];
-		m_buffers[m_buffer_count].handle = nullptr;
-		
-		m_buffer_map[m_buffers[dense_idx].sparse_idx] = dense_idx;
-		m_buffer_map[handle] = -1;
+		if (buffer.stream) buffer.stream->destroy();
+		setMemory(&buffer, 0, sizeof(buffer));
 	}
 
 
-	void pause(BufferHandle handle) override { m_buffers[m_buffer_map[handle]].handle->Stop(); }
+	void pause(BufferHandle handle) override { endCommand(beginCommand(Command::PAUSE, handle)); }
 
 
 	void setVolume(BufferHandle handle, float volume) override
 	{
-		m_buffers[m_buffer_map[handle]].handle->SetVolume(
-			DSBVOLUME_MIN + LONG(volume * (DSBVOLUME_MAX - DSBVOLUME_MIN)));
+		pushCommand(Command::SET_VOLUME, handle, volume);
 	}
 
 
 	void setFrequency(BufferHandle handle, float frequency) override
 	{
-		m_buffers[m_buffer_map[handle]].handle->SetFrequency(
-			DSBFREQUENCY_MIN + DWORD(frequency * (DSBFREQUENCY_MAX - DSBFREQUENCY_MIN)));
+		pushCommand(Command::SET_FREQUENCY, handle, frequency);
 	}
 
 
 	float getCurrentTime(BufferHandle handle) override
 	{
-		auto& buffer = m_buffers[m_buffer_map[handle]];
+		auto* handle_ptr = m_main_handles[handle];
 
 		WAVEFORMATEX format;
-		if (SUCCEEDED(buffer.handle->GetFormat(&format, sizeof(format), nullptr)))
+		if (SUCCEEDED(handle_ptr->GetFormat(&format, sizeof(format), nullptr)))
 		{
-			if (buffer.data_size <= STREAM_SIZE)
+			if (!m_main_is_streamed[handle])
 			{
 				DWORD pc, wc;
-				buffer.handle->GetCurrentPosition(&pc, &wc);
+				handle_ptr->GetCurrentPosition(&pc, &wc);
 				return pc / (float)format.nAvgBytesPerSec;
 			}
-			return buffer.written / (float)format.nAvgBytesPerSec;
+			// written by the audio thread, an older value only makes the time a bit behind
+			return m_buffers[handle].data_pos / (float)format.nAvgBytesPerSec;
 		}
 		return 0;
 	}
-	
+
 
 	void setCurrentTime(BufferHandle handle, float time_seconds) override
 	{
-		auto& buffer = m_buffers[m_buffer_map[handle]];
+		pushCommand(Command::SET_CURRENT_TIME, handle, time_seconds);
+	}
+
+
+	void executeSetCurrentTime(Buffer& buffer, float time_seconds)
+	{
 		WAVEFORMATEX format;
 		if (SUCCEEDED(buffer.handle->GetFormat(&format, sizeof(format), nullptr)))
 		{
 			DWORD pos = DWORD(format.nAvgBytesPerSec * time_seconds);
+			pos -= pos % format.nBlockAlign;
 			if (pos >= buffer.data_size) pos = 0;
 			if (buffer.data_size <= STREAM_SIZE)
 			{
@@ -381,76 +853,124 @@ struct AudioDeviceImpl : public AudioDevice
 			}
 			else
 			{
-				buffer.written = pos;
+				buffer.data_pos = pos;
 			}
 		}
 	}
 
 
-	void updateStreamData(Buffer& buffer, DWORD update_size)
+	void executeCommand(const Command& cmd)
 	{
-		DWORD s1, s2;
-		void* p1;
-		void* p2;
-		if (FAILED(buffer.handle->Lock(buffer.written % STREAM_SIZE, update_size, &p1, &s1, &p2, &s2, 0)))
-		{
-			return;
-		}
-		if (buffer.written + s1 > buffer.data_size)
+		Buffer& buffer = m_buffers[cmd.handle >= 0 ? cmd.handle : 0];
+		switch (cmd.type)
 		{
-			memcpy(p1, (uint8*)buffer.data + buffer.written, buffer.data_size - buffer.written);
-			void* p1_2 = (uint8*)p1 + (buffer.data_size - buffer.written);
-			DWORD s1_2 = s1 - (buffer.data_size - buffer.written);
-			if (buffer.looped)
-			{
-				memcpy(p1_2, buffer.data, s1_2);
-			}
-			else
-			{
-				ZeroMemory(p1_2, s1_2);
-			}
+			case Command::ADD_BUFFER: buffer = cmd.buffer; break;
+			case Command::PLAY:
+				buffer.looped = cmd.looped;
+				buffer.handle->Play(0, 0, DSBPLAY_LOOPING);
+				break;
+			case Command::STOP: releaseBuffer(buffer); break;
+			case Command::PAUSE: buffer.handle->Stop(); break;
+			case Command::SET_VOLUME:
+				buffer.handle->SetVolume(
+					DSBVOLUME_MIN + LONG(cmd.values[0] * (DSBVOLUME_MAX - DSBVOLUME_MIN)));
+				break;
+			case Command::SET_FREQUENCY:
+				buffer.handle->SetFrequency(
+					DSBFREQUENCY_MIN + DWORD(cmd.values[0] * (DSBFREQUENCY_MAX - DSBFREQUENCY_MIN)));
+				break;
+			case Command::SET_CURRENT_TIME: executeSetCurrentTime(buffer, cmd.values[0]); break;
+			case Command::SET_SOURCE_POSITION:
+				if (buffer.handle_3d)
+				{
+					buffer.handle_3d->SetPosition(
+						cmd.values[0], cmd.values[1], cmd.values[2], DS3D_DEFERRED);
+				}
+				break;
+			case Command::SET_LISTENER_POSITION:
+				m_listener->SetPosition(cmd.values[0], cmd.values[1], cmd.values[2], DS3D_DEFERRED);
+				break;
+			case Command::SET_LISTENER_ORIENTATION:
+				m_listener->SetOrientation(cmd.values[0],
+					cmd.values[1],
+					cmd.values[2],
+					cmd.values[3],
+					cmd.values[4],
+					cmd.values[5],
+					DS3D_DEFERRED);
+				break;
+			case Command::SET_ECHO:
+				executeSetEcho(buffer, cmd.values[0], cmd.values[1], cmd.values[2], cmd.values[3]);
+				break;
+			default: ASSERT(false); break;
 		}
-		else
+	}
+
+
+	void executeCommands()
+	{
+		while (!m_commands.isEmpty())
 		{
-			memcpy(p1, (uint8*)buffer.data + buffer.written, s1);
+			Command* cmd = m_commands.pop(false);
+			if (!cmd) break;
+
+			executeCommand(*cmd);
+			m_commands.dealoc(cmd);
 		}
-		buffer.written += s1;
-		if (p2)
+	}
+
+
+	// wraps around to the beginning of looped data, the rest is silence
+	void fillStreamData(Buffer& buffer, void* dest, DWORD size)
+	{
+		uint8* out = (uint8*)dest;
+		while (size > 0)
 		{
-			if (buffer.written + s2 > buffer.data_size)
+			if (buffer.data_pos >= buffer.data_size)
 			{
-				memcpy(p2, (uint8*)buffer.data + buffer.written, buffer.data_size - buffer.written);
-				void* p2_2 = (uint8*)p2 + (buffer.data_size - buffer.written);
-				DWORD s2_2 = s2 - (buffer.data_size - buffer.written);
-				if (buffer.looped)
+				if (!buffer.looped)
 				{
-					memcpy(p2_2, buffer.data, s2_2);
+					ZeroMemory(out, size);
+					buffer.written += size;
+					return;
 				}
-				else
-				{
-					ZeroMemory(p2_2, s2_2);
-				}
-			}
-			else
-			{
-				memcpy(p2, (uint8*)buffer.data + buffer.written, s2);
+				buffer.data_pos = 0;
 			}
-			buffer.written += s2;
+
+			DWORD chunk = Math::minValue(size, buffer.data_size - buffer.data_pos);
+			DWORD read = readData(buffer.data, buffer.stream, buffer.data_pos, out, chunk);
+			// the stream is shorter than its header says
+			if (read < chunk) ZeroMemory(out + read, chunk - read);
+			buffer.data_pos += chunk;
+			buffer.written += chunk;
+			out += chunk;
+			size -= chunk;
 		}
-		if (buffer.written > buffer.data_size) buffer.written = buffer.written % buffer.data_size;
-		if (FAILED(buffer.handle->Unlock(p1, s1, p2, s2)))
+	}
+
+
+	void updateStreamData(Buffer& buffer, DWORD update_size)
+	{
+		DWORD s1, s2;
+		void* p1;
+		void* p2;
+		if (FAILED(buffer.handle->Lock(buffer.written % STREAM_SIZE, update_size, &p1, &s1, &p2, &s2, 0)))
 		{
 			return;
 		}
+		fillStreamData(buffer, p1, s1);
+		if (p2) fillStreamData(buffer, p2, s2);
+		buffer.handle->Unlock(p1, s1, p2, s2);
 	}
 
 
-	void update(float) override 
+	// on the audio thread
+	void updateStreams()
 	{
-		for (int i = 0; i < m_buffer_count; ++i)
+		PROFILE_FUNCTION();
+		for (auto& buffer : m_buffers)
 		{
-			auto& buffer = m_buffers[i];
-			if (buffer.data_size <= STREAM_SIZE) continue;
+			if (!buffer.handle || buffer.data_size <= STREAM_SIZE) continue;
 
 			DWORD rel_pc, rel_wc;
 			buffer.handle->GetCurrentPosition(&rel_pc, &rel_wc);
@@ -468,10 +988,13 @@ struct AudioDeviceImpl : public AudioDevice
 	}
 
 
+	// the audio thread does the work
+	void update(float) override {}
+
+
 	void setSourcePosition(BufferHandle handle, float x, float y, float z) override
 	{
-		auto buffer = m_buffers[m_buffer_map[handle]].handle_3d;
-		if (buffer) buffer->SetPosition(x, y, z, DS3D_DEFERRED);
+		pushCommand(Command::SET_SOURCE_POSITION, handle, x, y, z);
 	}
 
 
@@ -482,17 +1005,36 @@ struct AudioDeviceImpl : public AudioDevice
 		float up_y,
 		float up_z) override
 	{
-		m_listener->SetOrientation(front_x, front_y, front_z, up_x, up_y, up_z, DS3D_DEFERRED);
+		Command& cmd = beginCommand(Command::SET_LISTENER_ORIENTATION, INVALID_BUFFER_HANDLE);
+		cmd.values[0] = front_x;
+		cmd.values[1] = front_y;
+		cmd.values[2] = front_z;
+		cmd.values[3] = up_x;
+		cmd.values[4] = up_y;
+		cmd.values[5] = up_z;
+		endCommand(cmd);
 	}
 
 
 	void setListenerPosition(float x, float y, float z) override
 	{
-		m_listener->SetPosition(x, y, z, DS3D_DEFERRED);
+		pushCommand(Command::SET_LISTENER_POSITION, INVALID_BUFFER_HANDLE, x, y, z);
 	}
 };
 
 
+int AudioTask::task()
+{
+	while (!m_device.m_is_quitting)
+	{
+		m_device.executeCommands();
+		m_device.updateStreams();
+		MT::sleep(AudioDeviceImpl::AUDIO_THREAD_PERIOD_MS);
+	}
+	return 0;
+}
+
+
 class NullAudioDevice : public AudioDevice
 {
 public:
@@ -504,6 +1046,15 @@ public:
 	{
 		return INVALID_BUFFER_HANDLE;
 	}
+	BufferHandle createBuffer(IStream& stream,
+		int size_bytes,
+		int channels,
+		int sample_rate,
+		int flags) override
+	{
+		stream.destroy();
+		return INVALID_BUFFER_HANDLE;
+	}
 	void setEcho(BufferHandle handle,
 		float wet_dry_mix,
 		float feedback,
@@ -530,10 +1081,37 @@ public:
 
 
 static NullAudioDevice g_null_device;
+static SoftwareAudioDevice* g_software_device = nullptr;
+
+
+static bool isSoftwareAudioRequested()
+{
+	char cmd_line[2048];
+	getCommandLine(cmd_line, lengthOf(cmd_line));
+
+	CommandLineParser parser(cmd_line);
+	while (parser.next())
+	{
+		if (parser.currentEquals("-software_audio")) return true;
+	}
+	return false;
+}
 
 
 AudioDevice* AudioDevice::create(Engine& engine)
 {
+	if (isSoftwareAudioRequested())
+	{
+		auto* output = LUMIX_NEW(engine.getAllocator(), DirectSoundOutput)(engine);
+		if (output->init())
+		{
+			g_software_device = SoftwareAudioDevice::create(engine.getAllocator(), *output);
+			return g_software_device;
+		}
+		LUMIX_DELETE(engine.getAllocator(), output);
+		g_log_warning.log("Audio") << "Failed to create the software mixed device";
+	}
+
 	auto* device = LUMIX_NEW(engine.getAllocator(), AudioDeviceImpl);
 	if (!device->init(engine))
 	{
@@ -548,6 +1126,14 @@ AudioDevice* AudioDevice::create(Engine& engine)
 void AudioDevice::destroy(AudioDevice& device)
 {
 	if (&device == &g_null_device) return;
+	if (&device == g_software_device)
+	{
+		auto& output = static_cast<DirectSoundOutput&>(g_software_device->getOutput());
+		SoftwareAudioDevice::destroy(*g_software_device);
+		LUMIX_DELETE(output.m_engine.getAllocator(), &output);
+		g_software_device = nullptr;
+		return;
+	}
 	LUMIX_DELETE(static_cast<AudioDeviceImpl&>(device).m_engine->getAllocator(), &device);
 }
 
@@ -0,0 +1,708 @@
+#include "software_audio_device.h"
+#include "core/iallocator.h"
+#include "core/math_utils.h"
+#include "core/mt/sync.h"
+#include "core/mt/task.h"
+#include "core/mt/thread.h"
+#include "core/profiler.h"
+#include "core/string.h"
+#include "core/vec.h"
+#include <cmath>
+#include <emmintrin.h>
+
+
+namespace Lumix
+{
+
+
+static const int MIX_BLOCK_FRAMES = 256; // multiple of 4, the SSE loops do 4 frames at once
+static const float MAX_STEP = 4; // source frames per output frame
+static const int SOURCE_FRAMES = int(MIX_BLOCK_FRAMES * MAX_STEP) + 8;
+static const int MIX_PERIOD_MS = 5;
+static const float MIN_FREQUENCY = 100;
+static const float MAX_FREQUENCY = 200000;
+static const float MIN_DISTANCE = 2;
+static const float MAX_DISTANCE = 10000;
+static const float MAX_ECHO_FEEDBACK = 0.99f;
+
+
+// a buffer as the main thread sees it, guarded by the mutex
+struct VoiceParams
+{
+	const void* data;
+	// until the mixer takes it
+	AudioDevice::IStream* stream;
+	// changes with every buffer created in the slot
+	uint32 generation;
+	int frame_count;
+	int channels;
+	int sample_rate;
+	float volume;
+	// Hz, 0 is the sample rate of the data
+	float frequency;
+	Vec3 position;
+	float echo[4];
+	int seek_frame;
+	bool has_echo;
+	bool is_used;
+	bool is_3d;
+	bool is_playing;
+	bool looped;
+
+	// written by the mixer
+	int frame;
+	bool is_finished;
+};
+
+
+// a buffer as the mixer sees it
+struct Voice
+{
+	VoiceParams params;
+	AudioDevice::IStream* stream;
+	uint32 generation;
+	// next frame of the data to read into the window
+	int next_frame;
+	// frame of the data in source[0]
+	int window_frame;
+	int window_count;
+	// where not looped data ended in the window, -1 if it did not
+	int window_end;
+	// position in the window
+	float cursor;
+	bool is_finished;
+
+	float echo[4];
+	float* echo_line;
+	int echo_size;
+	int echo_pos;
+
+	// stereo, mono data is duplicated
+	int16 source[SOURCE_FRAMES * 2];
+};
+
+
+struct SoftwareAudioDeviceImpl;
+
+
+class MixerTask : public MT::Task
+{
+public:
+	MixerTask(SoftwareAudioDeviceImpl& device, IAllocator& allocator)
+		: MT::Task(allocator)
+		, m_device(device)
+	{
+	}
+
+
+	int task() override;
+
+
+	SoftwareAudioDeviceImpl& m_device;
+};
+
+
+struct SoftwareAudioDeviceImpl : public SoftwareAudioDevice
+{
+	struct Listener
+	{
+		Vec3 position;
+		Vec3 front;
+		Vec3 up;
+	};
+
+
+	SoftwareAudioDeviceImpl(IAllocator& allocator, AudioOutput& output)
+		: m_allocator(allocator)
+		, m_output(output)
+		, m_mutex(false)
+		, m_task(*this, allocator)
+		, m_is_quitting(false)
+	{
+		m_output_sample_rate = m_output.getSampleRate();
+		m_listener.position.set(0, 0, 0);
+		m_listener.front.set(0, 0, 1);
+		m_listener.up.set(0, 1, 0);
+		m_mix_listener = m_listener;
+		m_voices = (Voice*)m_allocator.allocate(sizeof(Voice) * MAX_PLAYING_SOUNDS);
+		setMemory(m_voices, 0, sizeof(Voice) * MAX_PLAYING_SOUNDS);
+		setMemory(m_params, 0, sizeof(m_params));
+
+		m_task.create("MixerTask");
+		m_task.run();
+	}
+
+
+	~SoftwareAudioDeviceImpl()
+	{
+		m_is_quitting = true;
+		m_task.destroy();
+		for (int i = 0; i < MAX_PLAYING_SOUNDS; ++i)
+		{
+			Voice& voice = m_voices[i];
+			if (voice.stream) voice.stream->destroy();
+			if (voice.echo_line) m_allocator.deallocate(voice.echo_line);
+			if (m_params[i].stream) m_params[i].stream->destroy();
+		}
+		m_allocator.deallocate(m_voices);
+	}
+
+
+	AudioOutput& getOutput() override { return m_output; }
+
+
+	BufferHandle createBuffer(const void* data,
+		int data_size,
+		int channels,
+		int sample_rate,
+		int flags) override
+	{
+		return createBuffer(data, nullptr, data_size, channels, sample_rate, flags);
+	}
+
+
+	BufferHandle createBuffer(IStream& stream,
+		int data_size,
+		int channels,
+		int sample_rate,
+		int flags) override
+	{
+		return createBuffer(nullptr, &stream, data_size, channels, sample_rate, flags);
+	}
+
+
+	BufferHandle createBuffer(const void* data,
+		IStream* stream,
+		int data_size,
+		int channels,
+		int sample_rate,
+		int flags)
+	{
+		if (channels < 1 || channels > 2 || sample_rate <= 0)
+		{
+			if (stream) stream->destroy();
+			return INVALID_BUFFER_HANDLE;
+		}
+
+		MT::SpinLock lock(m_mutex);
+		for (int i = 0; i < MAX_PLAYING_SOUNDS; ++i)
+		{
+			VoiceParams& params = m_params[i];
+			if (params.is_used) continue;
+
+			uint32 generation = params.generation + 1;
+			setMemory(&params, 0, sizeof(params));
+			params.generation = generation;
+			params.data = data;
+			params.stream = stream;
+			params.frame_count = data_size / (channels * (int)sizeof(int16));
+			params.channels = channels;
+			params.sample_rate = sample_rate;
+			params.volume = 1;
+			params.seek_frame = -1;
+			params.is_used = true;
+			params.is_3d = (flags & (int)BufferFlags::IS3D) != 0;
+			params.looped = (flags & (int)BufferFlags::LOOPED) != 0;
+			return i;
+		}
+
+		if (stream) stream->destroy();
+		return INVALID_BUFFER_HANDLE;
+	}
+
+
+	void setEcho(BufferHandle handle,
+		float wet_dry_mix,
+		float feedback,
+		float left_delay,
+		float right_delay) override
+	{
+		MT::SpinLock lock(m_mutex);
+		VoiceParams& params = m_params[handle];
+		params.has_echo = true;
+		params.echo[0] = wet_dry_mix;
+		params.echo[1] = feedback;
+		params.echo[2] = left_delay;
+		params.echo[3] = right_delay;
+	}
+
+
+	void play(BufferHandle handle, bool looped) override
+	{
+		MT::SpinLock lock(m_mutex);
+		m_params[handle].is_playing = true;
+		m_params[handle].looped = looped;
+	}
+
+
+	bool isPlaying(BufferHandle handle) override
+	{
+		MT::SpinLock lock(m_mutex);
+		const VoiceParams& params = m_params[handle];
+		return params.is_used && params.is_playing && !params.is_finished;
+	}
+
+
+	void stop(BufferHandle handle) override
+	{
+		IStream* stream;
+		{
+			MT::SpinLock lock(m_mutex);
+			VoiceParams& params = m_params[handle];
+			// the mixer did not take the stream yet
+			stream = params.stream;
+			params.stream = nullptr;
+			params.is_used = false;
+			params.is_playing = false;
+			++params.generation;
+		}
+		if (stream) stream->destroy();
+	}
+
+
+	void pause(BufferHandle handle) override
+	{
+		MT::SpinLock lock(m_mutex);
+		m_params[handle].is_playing = false;
+	}
+
+
+	void setVolume(BufferHandle handle, float volume) override
+	{
+		MT::SpinLock lock(m_mutex);
+		m_params[handle].volume = volume;
+	}
+
+
+	void setFrequency(BufferHandle handle, float frequency) override
+	{
+		MT::SpinLock lock(m_mutex);
+		m_params[handle].frequency = MIN_FREQUENCY + frequency * (MAX_FREQUENCY - MIN_FREQUENCY);
+	}
+
+
+	void setCurrentTime(BufferHandle handle, float time_seconds) override
+	{
+		MT::SpinLock lock(m_mutex);
+		VoiceParams& params = m_params[handle];
+		int frame = int(time_seconds * params.sample_rate);
+		params.seek_frame = frame >= 0 && frame < params.frame_count ? frame : 0;
+		params.is_finished = false;
+	}
+
+
+	float getCurrentTime(BufferHandle handle) override
+	{
+		MT::SpinLock lock(m_mutex);
+		const VoiceParams& params = m_params[handle];
+		int frame = params.seek_frame >= 0 ? params.seek_frame : params.frame;
+		return frame / (float)params.sample_rate;
+	}
+
+
+	void setListenerPosition(float x, float y, float z) override
+	{
+		MT::SpinLock lock(m_mutex);
+		m_listener.position.set(x, y, z);
+	}
+
+
+	void setListenerOrientation(float front_x,
+		float front_y,
+		float front_z,
+		float up_x,
+		float up_y,
+		float up_z) override
+	{
+		MT::SpinLock lock(m_mutex);
+		m_listener.front.set(front_x, front_y, front_z);
+		m_listener.up.set(up_x, up_y, up_z);
+	}
+
+
+	void setSourcePosition(BufferHandle handle, float x, float y, float z) override
+	{
+		MT::SpinLock lock(m_mutex);
+		m_params[handle].position.set(x, y, z);
+	}
+
+
+	// the mixer thread does the work
+	void update(float) override {}
+
+
+	// copies what the main thread changed and publishes the playing positions
+	void syncVoices()
+	{
+		int destroyed_count = 0;
+		m_mutex.lock();
+		m_mix_listener = m_listener;
+		for (int i = 0; i < MAX_PLAYING_SOUNDS; ++i)
+		{
+			VoiceParams& params = m_params[i];
+			Voice& voice = m_voices[i];
+			if (voice.generation != params.generation)
+			{
+				// streams are destroyed after the lock is released
+				if (voice.stream) m_destroyed_streams[destroyed_count++] = voice.stream;
+				voice.stream = params.stream;
+				params.stream = nullptr;
+				voice.generation = params.generation;
+				voice.next_frame = 0;
+				voice.window_frame = 0;
+				voice.window_count = 0;
+				voice.window_end = -1;
+				voice.cursor = 0;
+				voice.is_finished = false;
+				voice.echo_pos = 0;
+				if (voice.echo_line)
+				{
+					setMemory(voice.echo_line, 0, voice.echo_size * 2 * sizeof(float));
+				}
+			}
+			if (!params.is_used)
+			{
+				voice.params.is_used = false;
+				continue;
+			}
+
+			if (params.seek_frame >= 0)
+			{
+				voice.next_frame = params.seek_frame;
+				voice.window_frame = params.seek_frame;
+				voice.window_count = 0;
+				voice.window_end = -1;
+				voice.cursor = 0;
+				voice.is_finished = false;
+				params.seek_frame = -1;
+			}
+			voice.params = params;
+			voice.params.stream = nullptr;
+			params.frame = voice.params.frame_count > 0
+							   ? (voice.window_frame + int(voice.cursor)) % voice.params.frame_count
+							   : 0;
+			params.is_finished = voice.is_finished;
+		}
+		m_mutex.unlock();
+
+		// they can lock for a while, e.g. to release clip data
+		for (int i = 0; i < destroyed_count; ++i)
+		{
+			m_destroyed_streams[i]->destroy();
+		}
+	}
+
+
+	int readFrames(Voice& voice, int16* dest, int count)
+	{
+		const VoiceParams& params = voice.params;
+		int frame_size = params.channels * sizeof(int16);
+		int pos = voice.next_frame * frame_size;
+		int read;
+		if (voice.stream)
+		{
+			read = voice.stream->read(pos, dest, count * frame_size) / frame_size;
+		}
+		else if (params.data)
+		{
+			copyMemory(dest, (const uint8*)params.data + pos, count * frame_size);
+			read = count;
+		}
+		else
+		{
+			return 0;
+		}
+
+		if (params.channels == 1)
+		{
+			// in place, from the end so no sample is overwritten before it is copied
+			for (int i = read - 1; i >= 0; --i)
+			{
+				dest[i * 2 + 1] = dest[i];
+				dest[i * 2] = dest[i];
+			}
+		}
+		return read;
+	}
+
+
+	// makes sure the window has needed frames from the cursor, frames behind it are dropped
+	void fillWindow(Voice& voice, int needed)
+	{
+		const VoiceParams& params = voice.params;
+		int drop = Math::minValue(int(voice.cursor), voice.window_count);
+		if (drop > 0)
+		{
+			moveMemory(voice.source,
+				voice.source + drop * 2,
+				(voice.window_count - drop) * 2 * sizeof(int16));
+			voice.window_count -= drop;
+			voice.cursor -= drop;
+			voice.window_frame = (voice.window_frame + drop) % params.frame_count;
+			if (voice.window_end >= 0)
+			{
+				voice.window_end = Math::maxValue(0, voice.window_end - drop);
+			}
+		}
+
+		while (voice.window_count < needed && voice.window_end < 0)
+		{
+			if (voice.next_frame >= params.frame_count)
+			{
+				if (!params.looped)
+				{
+					voice.window_end = voice.window_count;
+					break;
+				}
+				voice.next_frame = 0;
+			}
+
+			int count = Math::minValue(
+				needed - voice.window_count, params.frame_count - voice.next_frame);
+			int read = readFrames(voice, voice.source + voice.window_count * 2, count);
+			if (read <= 0)
+			{
+				voice.window_end = voice.window_count;
+				break;
+			}
+			voice.next_frame += read;
+			voice.window_count += read;
+		}
+
+		// interpolation reads past the end of the data
+		if (voice.window_count < needed)
+		{
+			setMemory(voice.source + voice.window_count * 2,
+				0,
+				(needed - voice.window_count) * 2 * sizeof(int16));
+		}
+	}
+
+
+	void getGains(const VoiceParams& params, float* left, float* right) const
+	{
+		// samples are scaled to -1..1 by the gains
+		float gain = params.volume / 32768.0f;
+		if (!params.is_3d)
+		{
+			*left = *right = gain;
+			return;
+		}
+
+		Vec3 dir = params.position - m_mix_listener.position;
+		float dist = dir.length();
+		if (dist > MAX_DISTANCE)
+		{
+			*left = *right = 0;
+			return;
+		}
+
+		float pan = 0;
+		if (dist > 0.001f)
+		{
+			Vec3 side = crossProduct(m_mix_listener.up, m_mix_listener.front);
+			float side_length = side.length();
+			if (side_length > 0.001f) pan = dotProduct(dir, side) / (dist * side_length);
+		}
+		if (dist > MIN_DISTANCE) gain *= MIN_DISTANCE / dist;
+
+		// equal power
+		float angle = (pan + 1) * Math::PI * 0.25f;
+		*left = gain * cosf(angle) * Math::SQRT2;
+		*right = gain * sinf(angle) * Math::SQRT2;
+	}
+
+
+	// resamples the voice into out_left and out_right
+	void renderVoice(Voice& voice, int frames, float* out_left, float* out_right)
+	{
+		const VoiceParams& params = voice.params;
+		float frequency = params.frequency > 0 ? params.frequency : (float)params.sample_rate;
+		float step = Math::minValue(frequency / m_output_sample_rate, MAX_STEP);
+		fillWindow(voice, int(voice.cursor + step * frames) + 2);
+
+		float gain_left, gain_right;
+		getGains(params, &gain_left, &gain_right);
+		__m128 gain_l = _mm_set1_ps(gain_left);
+		__m128 gain_r = _mm_set1_ps(gain_right);
+		__m128 pos = _mm_set_ps(voice.cursor + step * 3,
+			voice.cursor + step * 2,
+			voice.cursor + step,
+			voice.cursor);
+		__m128 pos_step = _mm_set1_ps(step * 4);
+		const int16* source = voice.source;
+		for (int i = 0; i < frames; i += 4)
+		{
+			__m128i idx = _mm_cvttps_epi32(pos);
+			__m128 t = _mm_sub_ps(pos, _mm_cvtepi32_ps(idx));
+			int indices[4];
+			_mm_storeu_si128((__m128i*)indices, idx);
+
+			const int16* s0 = source + indices[0] * 2;
+			const int16* s1 = source + indices[1] * 2;
+			const int16* s2 = source + indices[2] * 2;
+			const int16* s3 = source + indices[3] * 2;
+			__m128 l0 = _mm_set_ps(s3[0], s2[0], s1[0], s0[0]);
+			__m128 r0 = _mm_set_ps(s3[1], s2[1], s1[1], s0[1]);
+			__m128 l1 = _mm_set_ps(s3[2], s2[2], s1[2], s0[2]);
+			__m128 r1 = _mm_set_ps(s3[3], s2[3], s1[3], s0[3]);
+
+			__m128 l = _mm_add_ps(l0, _mm_mul_ps(_mm_sub_ps(l1, l0), t));
+			__m128 r = _mm_add_ps(r0, _mm_mul_ps(_mm_sub_ps(r1, r0), t));
+			_mm_storeu_ps(out_left + i, _mm_mul_ps(l, gain_l));
+			_mm_storeu_ps(out_right + i, _mm_mul_ps(r, gain_r));
+			pos = _mm_add_ps(pos, pos_step);
+		}
+
+		voice.cursor += step * frames;
+		if (voice.window_end >= 0 && voice.cursor >= voice.window_end) voice.is_finished = true;
+	}
+
+
+	void updateEchoLine(Voice& voice)
+	{
+		const float* echo = voice.params.echo;
+		if (compareMemory(voice.echo, echo, sizeof(voice.echo)) == 0 && voice.echo_line) return;
+
+		copyMemory(voice.echo, echo, sizeof(voice.echo));
+		// delays are in milliseconds
+		int size = int(Math::maxValue(echo[2], echo[3]) * m_output_sample_rate / 1000) + 1;
+		if (size != voice.echo_size || !voice.echo_line)
+		{
+			if (voice.echo_line) m_allocator.deallocate(voice.echo_line);
+			voice.echo_line = (float*)m_allocator.allocate(size * 2 * sizeof(float));
+			voice.echo_size = size;
+		}
+		setMemory(voice.echo_line, 0, size * 2 * sizeof(float));
+		voice.echo_pos = 0;
+	}
+
+
+	// feedback delay line per channel
+	void applyEcho(Voice& voice, int frames, float* left, float* right)
+	{
+		updateEchoLine(voice);
+		float wet = Math::clamp(voice.echo[0], 0.0f, 1.0f);
+		float feedback = Math::clamp(voice.echo[1], 0.0f, MAX_ECHO_FEEDBACK);
+		int size = voice.echo_size;
+		int delay_l = Math::clamp(int(voice.echo[2] * m_output_sample_rate / 1000), 1, size);
+		int delay_r = Math::clamp(int(voice.echo[3] * m_output_sample_rate / 1000), 1, size);
+		float* line_l = voice.echo_line;
+		float* line_r = voice.echo_line + size;
+		int pos = voice.echo_pos;
+		for (int i = 0; i < frames; ++i)
+		{
+			float delayed_l = line_l[(pos + size - delay_l) % size];
+			float delayed_r = line_r[(pos + size - delay_r) % size];
+			line_l[pos] = left[i] + delayed_l * feedback;
+			line_r[pos] = right[i] + delayed_r * feedback;
+			left[i] = left[i] * (1 - wet) + delayed_l * wet;
+			right[i] = right[i] * (1 - wet) + delayed_r * wet;
+			pos = (pos + 1) % size;
+		}
+		voice.echo_pos = pos;
+	}
+
+
+	void mixBlock(int frames)
+	{
+		setMemory(m_mix_left, 0, sizeof(m_mix_left));
+		setMemory(m_mix_right, 0, sizeof(m_mix_right));
+		for (int i = 0; i < MAX_PLAYING_SOUNDS; ++i)
+		{
+			Voice& voice = m_voices[i];
+			const VoiceParams& params = voice.params;
+			if (!params.is_used || !params.is_playing || voice.is_finished) continue;
+			if (params.frame_count <= 0) continue;
+
+			renderVoice(voice, frames, m_voice_left, m_voice_right);
+			if (params.has_echo) applyEcho(voice, frames, m_voice_left, m_voice_right);
+			for (int j = 0; j < frames; j += 4)
+			{
+				_mm_storeu_ps(m_mix_left + j,
+					_mm_add_ps(_mm_loadu_ps(m_mix_left + j), _mm_loadu_ps(m_voice_left + j)));
+				_mm_storeu_ps(m_mix_right + j,
+					_mm_add_ps(_mm_loadu_ps(m_mix_right + j), _mm_loadu_ps(m_voice_right + j)));
+			}
+		}
+
+		__m128 one = _mm_set1_ps(1);
+		__m128 minus_one = _mm_set1_ps(-1);
+		__m128 scale = _mm_set1_ps(32767);
+		for (int i = 0; i < frames; i += 4)
+		{
+			__m128 l = _mm_max_ps(minus_one, _mm_min_ps(one, _mm_loadu_ps(m_mix_left + i)));
+			__m128 r = _mm_max_ps(minus_one, _mm_min_ps(one, _mm_loadu_ps(m_mix_right + i)));
+			__m128i il = _mm_cvtps_epi32(_mm_mul_ps(l, scale));
+			__m128i ir = _mm_cvtps_epi32(_mm_mul_ps(r, scale));
+			__m128i lo = _mm_unpacklo_epi32(il, ir);
+			__m128i hi = _mm_unpackhi_epi32(il, ir);
+			_mm_storeu_si128((__m128i*)(m_output_frames + i * 2), _mm_packs_epi32(lo, hi));
+		}
+		m_output.write(m_output_frames, frames);
+	}
+
+
+	// on the mixer thread
+	void mix()
+	{
+		PROFILE_FUNCTION();
+		int frames = m_output.getWritableFrames();
+		// rounded down to whole SSE steps, the rest is mixed the next time
+		frames &= ~3;
+		while (frames > 0)
+		{
+			syncVoices();
+			int block = Math::minValue(frames, MIX_BLOCK_FRAMES);
+			mixBlock(block);
+			frames -= block;
+		}
+	}
+
+
+	IAllocator& m_allocator;
+	AudioOutput& m_output;
+	int m_output_sample_rate;
+	MT::SpinMutex m_mutex;
+	VoiceParams m_params[MAX_PLAYING_SOUNDS];
+	Listener m_listener;
+
+	// touched only by the mixer thread
+	Voice* m_voices;
+	Listener m_mix_listener;
+	IStream* m_destroyed_streams[MAX_PLAYING_SOUNDS];
+	float m_mix_left[MIX_BLOCK_FRAMES];
+	float m_mix_right[MIX_BLOCK_FRAMES];
+	float m_voice_left[MIX_BLOCK_FRAMES];
+	float m_voice_right[MIX_BLOCK_FRAMES];
+	int16 m_output_frames[MIX_BLOCK_FRAMES * 2];
+
+	MixerTask m_task;
+	volatile bool m_is_quitting;
+};
+
+
+int MixerTask::task()
+{
+	while (!m_device.m_is_quitting)
+	{
+		m_device.mix();
+		MT::sleep(MIX_PERIOD_MS);
+	}
+	return 0;
+}
+
+
+SoftwareAudioDevice* SoftwareAudioDevice::create(IAllocator& allocator, AudioOutput& output)
+{
+	return LUMIX_NEW(allocator, SoftwareAudioDeviceImpl)(allocator, output);
+}
+
+
+void SoftwareAudioDevice::destroy(SoftwareAudioDevice& device)
+{
+	LUMIX_DELETE(static_cast<SoftwareAudioDeviceImpl&>(device).m_allocator, &device);
+}
+
+
+} // namespace Lumix
@@ -0,0 +1,41 @@
+#pragma once
+
+
+#include "audio_device.h"
+
+
+namespace Lumix
+{
+
+
+class IAllocator;
+
+
+// where a software mixed device writes its interleaved stereo 16bit PCM, called from the mixing
+// thread
+class LUMIX_AUDIO_API AudioOutput
+{
+public:
+	virtual ~AudioOutput() {}
+
+	virtual int getSampleRate() const = 0;
+	// how many frames can be written now without adding to the latency
+	virtual int getWritableFrames() = 0;
+	virtual void write(const int16* frames, int count) = 0;
+};
+
+
+// Mixes all buffers on the CPU into one output: resampling, volume, panning and echo run in SSE
+// on its own thread, so the cost does not depend on the OS and the only platform specific part
+// is the output.
+class LUMIX_AUDIO_API SoftwareAudioDevice : public AudioDevice
+{
+public:
+	static SoftwareAudioDevice* create(IAllocator& allocator, AudioOutput& output);
+	static void destroy(SoftwareAudioDevice& device);
+
+	virtual AudioOutput& getOutput() = 0;
+};
+
+
+} // namespace Lumix
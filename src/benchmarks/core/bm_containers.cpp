@@ -0,0 +1,100 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "unit_tests/suite/benchmark.h"
+#include "core/array.h"
+#include "core/flat_hash_map.h"
+#include "core/hash_map.h"
+
+
+namespace
+{
+	using Lumix::UnitTest::benchmark;
+
+
+	const int SAMPLE_COUNT = 50;
+	const int ITEM_COUNT = 10000;
+
+
+	// keeps the optimizer from removing the measured code
+	volatile int32 g_sink = 0;
+
+
+	void BM_array(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::Array<int32> array(allocator);
+		benchmark("array/push",
+			SAMPLE_COUNT,
+			ITEM_COUNT,
+			[&array]()
+			{
+				array.clear();
+				for (int32 i = 0; i < ITEM_COUNT; ++i) array.push(i);
+			});
+		benchmark("array/iterate",
+			SAMPLE_COUNT,
+			ITEM_COUNT,
+			[&array]()
+			{
+				int32 sum = 0;
+				for (int32 value : array) sum += value;
+				g_sink = sum;
+			});
+		benchmark("array/erase_fast",
+			SAMPLE_COUNT,
+			ITEM_COUNT / 10,
+			[&array]()
+			{
+				for (int32 i = 0; i < ITEM_COUNT / 10; ++i) array.eraseFast(0);
+				for (int32 i = 0; i < ITEM_COUNT / 10; ++i) array.push(i);
+			});
+	}
+
+
+	template <typename Map> void benchmarkMap(const char* insert_name, const char* find_name)
+	{
+		Lumix::DefaultAllocator allocator;
+		// into an empty map, including its growth
+		benchmark(insert_name,
+			SAMPLE_COUNT,
+			ITEM_COUNT,
+			[&allocator]()
+			{
+				Map map(allocator);
+				for (int32 i = 0; i < ITEM_COUNT; ++i) map.insert(i * 7, i);
+				g_sink = map.size();
+			});
+
+		Map map(allocator);
+		for (int32 i = 0; i < ITEM_COUNT; ++i) map.insert(i * 7, i);
+		benchmark(find_name,
+			SAMPLE_COUNT,
+			ITEM_COUNT,
+			[&map]()
+			{
+				int32 found = 0;
+				// every other key is missing
+				for (int32 i = 0; i < ITEM_COUNT; ++i)
+				{
+					if (map.find(i * 14) != map.end()) ++found;
+				}
+				g_sink = found;
+			});
+	}
+
+
+	void BM_hash_map(const char* params)
+	{
+		benchmarkMap<Lumix::HashMap<int32, int32>>("hash_map/insert", "hash_map/find");
+	}
+
+
+	void BM_flat_hash_map(const char* params)
+	{
+		benchmarkMap<Lumix::FlatHashMap<int32, int32>>(
+			"flat_hash_map/insert", "flat_hash_map/find");
+	}
+}
+
+REGISTER_TEST("benchmarks/core/array", BM_array, "");
+REGISTER_TEST("benchmarks/core/hash_map", BM_hash_map, "");
+REGISTER_TEST("benchmarks/core/flat_hash_map", BM_flat_hash_map, "");
@@ -0,0 +1,46 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "unit_tests/suite/benchmark.h"
+#include "core/crc32.h"
+
+
+namespace
+{
+	using Lumix::UnitTest::benchmark;
+
+
+	const int SAMPLE_COUNT = 50;
+	const int BUFFER_SIZE = 1024 * 1024;
+	const int NAME_COUNT = 10000;
+
+
+	volatile uint32 g_sink = 0;
+
+
+	void BM_crc32(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		uint8* buffer = (uint8*)allocator.allocate(BUFFER_SIZE);
+		for (int i = 0; i < BUFFER_SIZE; ++i) buffer[i] = uint8(i * 31);
+
+		// bytes of a big buffer, e.g. a file
+		benchmark("crc32/buffer",
+			SAMPLE_COUNT,
+			BUFFER_SIZE,
+			[buffer]() { g_sink = Lumix::crc32(buffer, BUFFER_SIZE); });
+
+		// short strings, e.g. the names of component types and properties
+		benchmark("crc32/name",
+			SAMPLE_COUNT,
+			NAME_COUNT,
+			[]()
+			{
+				uint32 hash = 0;
+				for (int i = 0; i < NAME_COUNT; ++i) hash ^= Lumix::crc32("renderable_model");
+				g_sink = hash;
+			});
+
+		allocator.deallocate(buffer);
+	}
+}
+
+REGISTER_TEST("benchmarks/core/crc32", BM_crc32, "");
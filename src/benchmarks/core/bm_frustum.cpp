@@ -0,0 +1,57 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "unit_tests/suite/benchmark.h"
+#include "core/frustum.h"
+#include "core/math_utils.h"
+#include "core/vec.h"
+
+
+namespace
+{
+	const int SAMPLE_COUNT = 50;
+	const int SPHERE_COUNT = 10000;
+
+
+	volatile int32 g_sink = 0;
+
+
+	void BM_frustum_sphere(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::Vec4* spheres =
+			(Lumix::Vec4*)allocator.allocate(sizeof(Lumix::Vec4) * SPHERE_COUNT);
+		for (int i = 0; i < SPHERE_COUNT; ++i)
+		{
+			using Lumix::Math::randFloat;
+			spheres[i].set(randFloat(-100, 100), randFloat(-100, 100), randFloat(-100, 100), 1);
+		}
+
+		// roughly a quarter of the spheres is visible
+		Lumix::Frustum frustum;
+		frustum.computePerspective(Lumix::Vec3(0, 0, 0),
+			Lumix::Vec3(0, 0, -1),
+			Lumix::Vec3(0, 1, 0),
+			Lumix::Math::degreesToRadians(90),
+			1,
+			0.1f,
+			200);
+
+		Lumix::UnitTest::benchmark("frustum/is_sphere_inside",
+			SAMPLE_COUNT,
+			SPHERE_COUNT,
+			[&frustum, spheres]()
+			{
+				int32 visible = 0;
+				for (int i = 0; i < SPHERE_COUNT; ++i)
+				{
+					const Lumix::Vec4& sphere = spheres[i];
+					Lumix::Vec3 center(sphere.x, sphere.y, sphere.z);
+					if (frustum.isSphereInside(center, sphere.w)) ++visible;
+				}
+				g_sink = visible;
+			});
+
+		allocator.deallocate(spheres);
+	}
+}
+
+REGISTER_TEST("benchmarks/core/frustum", BM_frustum_sphere, "");
@@ -0,0 +1,86 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "unit_tests/suite/benchmark.h"
+#include "core/fs/ifile.h"
+#include "core/FS/memory_file_device.h"
+#include "core/json_serializer.h"
+#include "core/path.h"
+
+
+namespace
+{
+	using Lumix::UnitTest::benchmark;
+
+
+	const int SAMPLE_COUNT = 20;
+	const int OBJECT_COUNT = 5000;
+
+
+	void write(Lumix::FS::IFile& file, Lumix::IAllocator& allocator)
+	{
+		file.seek(Lumix::FS::SeekMode::BEGIN, 0);
+		Lumix::JsonSerializer serializer(
+			file, Lumix::JsonSerializer::WRITE, Lumix::Path(""), allocator);
+		serializer.beginObject();
+		serializer.beginArray("objects");
+		for (int i = 0; i < OBJECT_COUNT; ++i)
+		{
+			serializer.beginObject();
+			serializer.serialize("index", i);
+			serializer.serialize("value", i * 0.5f);
+			serializer.serialize("name", "object name");
+			serializer.endObject();
+		}
+		serializer.endArray();
+		serializer.endObject();
+		serializer.flush();
+	}
+
+
+	void read(Lumix::FS::IFile& file, Lumix::IAllocator& allocator)
+	{
+		file.seek(Lumix::FS::SeekMode::BEGIN, 0);
+		Lumix::JsonSerializer serializer(
+			file, Lumix::JsonSerializer::READ, Lumix::Path(""), allocator);
+		serializer.deserializeObjectBegin();
+		serializer.deserializeArrayBegin("objects");
+		int count = 0;
+		while (!serializer.isArrayEnd())
+		{
+			serializer.nextArrayItem();
+			serializer.deserializeObjectBegin();
+			int index;
+			float value;
+			char name[32];
+			serializer.deserialize("index", index, -1);
+			serializer.deserialize("value", value, -1);
+			serializer.deserialize("name", name, sizeof(name), "");
+			serializer.deserializeObjectEnd();
+			++count;
+		}
+		serializer.deserializeArrayEnd();
+		serializer.deserializeObjectEnd();
+		LUMIX_EXPECT(count == OBJECT_COUNT);
+	}
+
+
+	void BM_json_serializer(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::PathManager path_manager(allocator);
+		Lumix::FS::MemoryFileDevice device(allocator);
+		Lumix::FS::IFile* file = device.createFile(nullptr);
+
+		benchmark("json_serializer/write",
+			SAMPLE_COUNT,
+			OBJECT_COUNT,
+			[file, &allocator]() { write(*file, allocator); });
+		benchmark("json_serializer/read",
+			SAMPLE_COUNT,
+			OBJECT_COUNT,
+			[file, &allocator]() { read(*file, allocator); });
+
+		device.destroyFile(file);
+	}
+}
+
+REGISTER_TEST("benchmarks/core/json_serializer", BM_json_serializer, "");
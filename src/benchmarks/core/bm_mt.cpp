@@ -0,0 +1,130 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "unit_tests/suite/benchmark.h"
+#include "core/MT/atomic.h"
+#include "core/MT/lock_free_fixed_queue.h"
+#include "core/MT/task.h"
+#include "core/MT/thread.h"
+#include "core/MTJD/job.h"
+#include "core/MTJD/manager.h"
+
+
+namespace
+{
+	using Lumix::UnitTest::benchmark;
+
+
+	const int SAMPLE_COUNT = 20;
+	const int ITEM_COUNT = 10000;
+	const int JOB_COUNT = 256;
+
+
+	typedef Lumix::MT::LockFreeFixedQueue<int32, 64> Queue;
+
+
+	class ConsumerTask : public Lumix::MT::Task
+	{
+	public:
+		ConsumerTask(Queue& queue, Lumix::IAllocator& allocator)
+			: Lumix::MT::Task(allocator)
+			, m_queue(queue)
+			, m_count(0)
+		{
+		}
+
+
+		int task() override
+		{
+			while (!m_queue.isAborted())
+			{
+				int32* item = m_queue.pop(true);
+				if (!item) break;
+				m_queue.dealoc(item);
+				Lumix::MT::atomicIncrement(&m_count);
+			}
+			return 0;
+		}
+
+
+		volatile int32 m_count;
+
+	private:
+		Queue& m_queue;
+	};
+
+
+	void BM_lock_free_queue(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Queue queue;
+		benchmark("lock_free_queue/single_thread",
+			SAMPLE_COUNT,
+			ITEM_COUNT,
+			[&queue]()
+			{
+				for (int i = 0; i < ITEM_COUNT; ++i)
+				{
+					queue.push(queue.alloc(true), true);
+					queue.dealoc(queue.pop(true));
+				}
+			});
+
+		ConsumerTask consumer(queue, allocator);
+		consumer.create("ConsumerTask");
+		consumer.run();
+		benchmark("lock_free_queue/producer_consumer",
+			SAMPLE_COUNT,
+			ITEM_COUNT,
+			[&queue, &consumer]()
+			{
+				int32 end = consumer.m_count + ITEM_COUNT;
+				for (int i = 0; i < ITEM_COUNT; ++i) queue.push(queue.alloc(true), true);
+				while (consumer.m_count != end) Lumix::MT::yield();
+			});
+		queue.abort();
+		consumer.destroy();
+	}
+
+
+	class EmptyJob : public Lumix::MTJD::Job
+	{
+	public:
+		EmptyJob(Lumix::MTJD::Manager& manager, Lumix::IAllocator& allocator)
+			: Job(Job::SYNC_EVENT, Lumix::MTJD::Priority::Default, manager, allocator, allocator)
+		{
+			setJobName("EmptyJob");
+		}
+
+
+		void execute() override {}
+	};
+
+
+	void benchmarkJobs(const char* name, Lumix::MTJD::SchedulerType scheduler_type)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::MTJD::Manager* manager = Lumix::MTJD::Manager::create(allocator, scheduler_type);
+		EmptyJob* jobs[JOB_COUNT];
+		benchmark(name,
+			SAMPLE_COUNT,
+			JOB_COUNT,
+			[&]()
+			{
+				for (auto& job : jobs) job = LUMIX_NEW(allocator, EmptyJob)(*manager, allocator);
+				for (auto* job : jobs) manager->schedule(job);
+				for (auto* job : jobs) job->sync();
+				for (auto* job : jobs) LUMIX_DELETE(allocator, job);
+			});
+		Lumix::MTJD::Manager::destroy(*manager);
+	}
+
+
+	// creating, scheduling, running and syncing jobs which do nothing
+	void BM_mtjd_job(const char* params)
+	{
+		benchmarkJobs("mtjd/central", Lumix::MTJD::SchedulerType::Central);
+		benchmarkJobs("mtjd/work_stealing", Lumix::MTJD::SchedulerType::WorkStealing);
+	}
+}
+
+REGISTER_TEST("benchmarks/core/lock_free_queue", BM_lock_free_queue, "");
+REGISTER_TEST("benchmarks/core/mtjd_job", BM_mtjd_job, "");
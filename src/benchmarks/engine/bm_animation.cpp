@@ -0,0 +1,64 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "unit_tests/suite/benchmark.h"
+#include "animation/animation_sampling.h"
+#include "core/math_utils.h"
+#include "core/string.h"
+
+
+namespace
+{
+	namespace Sampling = Lumix::AnimationSampling;
+
+
+	const int SAMPLE_COUNT = 50;
+	const int BONE_COUNT = 61;
+	const int POSE_COUNT = 1000;
+
+
+	volatile float g_sink = 0;
+
+
+	// the interpolation of two frames of an uncompressed animation done by Animation::getPose
+	void BM_animation_sampling(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		int stride = Sampling::getStride(BONE_COUNT);
+		int frame_size = Sampling::getFrameSize(BONE_COUNT);
+		float* frames = (float*)allocator.allocate(sizeof(float) * frame_size * 2);
+		Lumix::setMemory(frames, 0, sizeof(float) * frame_size * 2);
+		for (int i = 0; i < BONE_COUNT; ++i)
+		{
+			for (int frame = 0; frame < 2; ++frame)
+			{
+				float* rows = frames + frame * frame_size;
+				rows[Sampling::POSITION_X * stride + i] = Lumix::Math::randFloat(-1, 1);
+				rows[Sampling::POSITION_Y * stride + i] = Lumix::Math::randFloat(-1, 1);
+				rows[Sampling::POSITION_Z * stride + i] = Lumix::Math::randFloat(-1, 1);
+				rows[Sampling::ROTATION_W * stride + i] = 1;
+			}
+		}
+
+		Lumix::UnitTest::benchmark("animation/sample_pose",
+			SAMPLE_COUNT,
+			POSE_COUNT,
+			[frames, stride, frame_size]()
+			{
+				float sum = 0;
+				for (int pose = 0; pose < POSE_COUNT; ++pose)
+				{
+					float t = pose / float(POSE_COUNT);
+					for (int i = 0; i < BONE_COUNT; i += 4)
+					{
+						float sampled[Sampling::ROW_COUNT][4];
+						Sampling::sample4(frames, frames + frame_size, stride, i, t, sampled);
+						sum += sampled[Sampling::POSITION_X][0];
+					}
+				}
+				g_sink = sum;
+			});
+
+		allocator.deallocate(frames);
+	}
+}
+
+REGISTER_TEST("benchmarks/engine/animation_sampling", BM_animation_sampling, "");
@@ -0,0 +1,13 @@
+#include "lumix.h"
+#include "unit_tests/suite/unit_test_app.h"
+
+
+// Runs the benchmarks registered with REGISTER_TEST, all of them or the ones matching the
+// filter, e.g. benchmarks "benchmarks/core/*"
+int main(int argc, const char * argv[])
+{
+	Lumix::UnitTest::App app;
+	app.init();
+	app.run(argc, argv);
+	app.exit();
+}
@@ -1,7 +1,9 @@
 #include "asset_browser.h"
 #include "core/crc32.h"
+#include "core/fs/cache_file_device.h"
 #include "core/fs/disk_file_device.h"
 #include "core/log.h"
+#include "core/mt/task.h"
 #include "core/path_utils.h"
 #include "core/profiler.h"
 #include "core/resource.h"
@@ -18,6 +20,76 @@
 
 static const Lumix::uint32 UNIVERSE_HASH = Lumix::crc32("universe");
 static const Lumix::uint32 SOURCE_HASH = Lumix::crc32("source");
+static const int FOUND_FILES_BATCH_SIZE = 64;
+
+
+// walks the base paths so big projects do not block the editor while starting up or refreshing
+struct AssetBrowser::FindResourcesTask : public Lumix::MT::Task
+{
+	FindResourcesTask(AssetBrowser& browser, Lumix::IAllocator& allocator)
+		: Lumix::MT::Task(allocator)
+		, m_browser(browser)
+		, m_batch(allocator)
+		, m_is_canceled(false)
+	{
+		auto* device = browser.m_editor.getEngine().getDiskFileDevice();
+		Lumix::copyString(m_base_paths[0], device->getBasePath(0));
+		Lumix::copyString(m_base_paths[1], device->getBasePath(1));
+	}
+
+
+	int task() override
+	{
+		for (auto* base_path : m_base_paths)
+		{
+			if (base_path[0] != 0) processDir(base_path, Lumix::stringLength(base_path));
+		}
+		flush();
+		return 0;
+	}
+
+
+	void flush()
+	{
+		if (m_batch.empty()) return;
+
+		Lumix::MT::SpinLock lock(m_browser.m_found_files_mutex);
+		for (auto& path : m_batch) m_browser.m_found_files.push(path);
+		m_batch.clear();
+	}
+
+
+	void processDir(const char* dir, int base_length)
+	{
+		auto* iter = PlatformInterface::createFileIterator(dir, getAllocator());
+		PlatformInterface::FileInfo info;
+		while (!m_is_canceled && getNextFile(iter, &info))
+		{
+			if (info.filename[0] == '.') continue;
+
+			char child_path[Lumix::MAX_PATH_LENGTH];
+			Lumix::copyString(child_path, dir);
+			Lumix::catString(child_path, "/");
+			Lumix::catString(child_path, info.filename);
+			if (info.is_directory)
+			{
+				processDir(child_path, base_length);
+				continue;
+			}
+
+			m_batch.emplace(child_path + base_length);
+			if (m_batch.size() == FOUND_FILES_BATCH_SIZE) flush();
+		}
+
+		destroyFileIterator(iter);
+	}
+
+
+	AssetBrowser& m_browser;
+	char m_base_paths[2][Lumix::MAX_PATH_LENGTH];
+	Lumix::Array<Lumix::Path> m_batch;
+	volatile bool m_is_canceled;
+};
 
 
 Lumix::uint32 AssetBrowser::getResourceType(const char* path) const
@@ -48,6 +120,12 @@ AssetBrowser::AssetBrowser(Lumix::WorldEditor& editor, Metadata& metadata)
 	, m_history(editor.getAllocator())
 	, m_plugins(editor.getAllocator())
 	, m_on_resource_changed(editor.getAllocator())
+	, m_resource_hashes(editor.getAllocator())
+	, m_found_files(editor.getAllocator())
+	, m_found_files_mutex(false)
+	, m_find_task(nullptr)
+	, m_filtered_resources(editor.getAllocator())
+	, m_is_filter_dirty(true)
 {
 	m_is_update_enabled = true;
 	m_filter[0] = '\0';
@@ -76,6 +154,7 @@ AssetBrowser::AssetBrowser(Lumix::WorldEditor& editor, Metadata& metadata)
 
 AssetBrowser::~AssetBrowser()
 {
+	stopFindResources();
 	unloadResource();
 
 	for (auto* plugin : m_plugins)
@@ -91,6 +170,10 @@ AssetBrowser::~AssetBrowser()
 
 void AssetBrowser::onFileChanged(const char* path)
 {
+	// any file can be read through the cache, not only resources
+	auto* cache_device = m_editor.getEngine().getCacheFileDevice();
+	if (cache_device) cache_device->invalidate(Lumix::Path(path));
+
 	Lumix::uint32 resource_type = getResourceType(path);
 	if (resource_type == 0) return;
 
@@ -130,6 +213,8 @@ void AssetBrowser::update()
 {
 	PROFILE_FUNCTION();
 	if (!m_is_update_enabled) return;
+	addFoundResources();
+
 	bool is_empty;
 	{
 		Lumix::MT::SpinLock lock(m_changed_files_mutex);
@@ -154,20 +239,18 @@ void AssetBrowser::update()
 		Lumix::uint32 resource_type = getResourceType(path.c_str());
 		if (resource_type == 0) continue;
 
-		if (m_autoreload_changed_resource) m_editor.getEngine().getResourceManager().reload(path);
+		if (m_autoreload_changed_resource)
+		{
+			m_editor.getEngine().getResourceManager().queueReload(path);
+		}
 
 		if (!PlatformInterface::fileExists(path.c_str()))
 		{
-			int index = getTypeIndexFromManagerType(resource_type);
-			m_resources[index].eraseItemFast(path);
+			removeResource(path, getTypeIndexFromManagerType(resource_type));
 			continue;
 		}
 
-		char dir[Lumix::MAX_PATH_LENGTH];
-		char filename[Lumix::MAX_PATH_LENGTH];
-		Lumix::PathUtils::getDir(dir, sizeof(dir), path.c_str());
-		Lumix::PathUtils::getFilename(filename, sizeof(filename), path.c_str());
-		addResource(dir, filename);
+		addResource(path.c_str());
 	}
 	m_changed_files.clear();
 }
@@ -209,22 +292,28 @@ void AssetBrowser::onGUI()
 		return true;
 	};
 
-	ImGui::Combo("Type", &m_current_type, getter, this, 1 + m_plugins.size());
-	ImGui::InputText("Filter", m_filter, sizeof(m_filter));
+	if (ImGui::Combo("Type", &m_current_type, getter, this, 1 + m_plugins.size()))
+	{
+		m_is_filter_dirty = true;
+	}
+	if (ImGui::InputText("Filter", m_filter, sizeof(m_filter))) m_is_filter_dirty = true;
+	if (m_find_task) ImGui::Text("Searching for resources...");
+	updateFilteredResources();
 
 	ImGui::ListBoxHeader("Resources");
 	auto& resources = m_resources[m_current_type];
 
-	for (auto& resource : resources)
+	ImGuiListClipper clipper(m_filtered_resources.size(), ImGui::GetTextLineHeightWithSpacing());
+	for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
 	{
-		if (m_filter[0] != '\0' && strstr(resource.c_str(), m_filter) == nullptr) continue;
-
+		auto& resource = resources[m_filtered_resources[i]];
 		bool is_selected = m_selected_resource ? m_selected_resource->getPath() == resource : false;
 		if (ImGui::Selectable(resource.c_str(), is_selected))
 		{
 			selectResource(resource);
 		}
 	}
+	clipper.End();
 	ImGui::ListBoxFooter();
 	onGUIResource();
 	ImGui::EndDock();
@@ -392,65 +481,94 @@ int AssetBrowser::getResourceTypeIndex(const char* ext)
 }
 
 
-void AssetBrowser::addResource(const char* path, const char* filename)
+void AssetBrowser::addResource(const char* path)
 {
 	char ext[10];
-	Lumix::PathUtils::getExtension(ext, sizeof(ext), filename);
-
-	char fullpath[Lumix::MAX_PATH_LENGTH];
-	Lumix::copyString(fullpath, path);
-	Lumix::catString(fullpath, "/");
-	Lumix::catString(fullpath, filename);
-	
+	Lumix::PathUtils::getExtension(ext, sizeof(ext), path);
 	int index = getResourceTypeIndex(ext);
-
-	if (Lumix::startsWith(path, "/render_tests") != 0) return;
-	if (Lumix::startsWith(path, "/unit_tests") != 0) return;
 	if (index < 0) return;
 
-	Lumix::Path path_obj(fullpath);
-	if (m_resources[index].indexOf(path_obj) == -1)
+	Lumix::Path path_obj(path);
+	if (Lumix::startsWith(path_obj.c_str(), "render_tests")) return;
+	if (Lumix::startsWith(path_obj.c_str(), "unit_tests")) return;
+	if (m_resource_hashes.find(path_obj.getHash()).isValid()) return;
+
+	m_resource_hashes.insert(path_obj.getHash(), index);
+	m_resources[index].push(path_obj);
+	if (index == m_current_type) m_is_filter_dirty = true;
+}
+
+
+void AssetBrowser::removeResource(const Lumix::Path& path, int type_index)
+{
+	if (m_resource_hashes.erase(path.getHash()) == 0) return;
+
+	m_resources[type_index].eraseItemFast(path);
+	if (type_index == m_current_type) m_is_filter_dirty = true;
+}
+
+
+void AssetBrowser::addFoundResources()
+{
+	if (!m_find_task) return;
+
+	// the task could finish between the check and the lock, so check first
+	bool is_finished = m_find_task->isFinished();
+	Lumix::Array<Lumix::Path> found_files(m_editor.getAllocator());
+	{
+		Lumix::MT::SpinLock lock(m_found_files_mutex);
+		found_files.swap(m_found_files);
+	}
+	for (auto& path : found_files)
 	{
-		m_resources[index].push(path_obj);
+		addResource(path.c_str());
 	}
+
+	if (is_finished) stopFindResources();
 }
 
 
-void AssetBrowser::processDir(const char* dir, int base_length)
+void AssetBrowser::updateFilteredResources()
 {
-	auto* iter = PlatformInterface::createFileIterator(dir, m_editor.getAllocator());
-	PlatformInterface::FileInfo info;
-	while (getNextFile(iter, &info))
-	{
-		if (info.filename[0] == '.') continue;
+	if (!m_is_filter_dirty) return;
+	m_is_filter_dirty = false;
 
-		if (info.is_directory)
-		{
-			char child_path[Lumix::MAX_PATH_LENGTH];
-			Lumix::copyString(child_path, dir);
-			Lumix::catString(child_path, "/");
-			Lumix::catString(child_path, info.filename);
-			processDir(child_path, base_length);
-		}
-		else
-		{
-			addResource(dir + base_length, info.filename);
-		}
+	m_filtered_resources.clear();
+	auto& resources = m_resources[m_current_type];
+	for (int i = 0, c = resources.size(); i < c; ++i)
+	{
+		if (m_filter[0] != '\0' && strstr(resources[i].c_str(), m_filter) == nullptr) continue;
+		m_filtered_resources.push(i);
 	}
+}
+
 
-	destroyFileIterator(iter);
+void AssetBrowser::stopFindResources()
+{
+	if (!m_find_task) return;
+
+	m_find_task->m_is_canceled = true;
+	m_find_task->destroy();
+	LUMIX_DELETE(m_editor.getAllocator(), m_find_task);
+	m_find_task = nullptr;
+
+	Lumix::MT::SpinLock lock(m_found_files_mutex);
+	m_found_files.clear();
 }
 
 
 void AssetBrowser::findResources()
 {
+	stopFindResources();
 	for (auto& resources : m_resources)
 	{
 		resources.clear();
 	}
+	m_resource_hashes.clear();
+	m_is_filter_dirty = true;
 
-	const char* base_path = m_editor.getEngine().getDiskFileDevice()->getBasePath(0);
-	processDir(base_path, Lumix::stringLength(base_path));
-	base_path = m_editor.getEngine().getDiskFileDevice()->getBasePath(1);
-	if (base_path[0] != 0) processDir(base_path, Lumix::stringLength(base_path));
-}
\ No newline at end of file
+	auto& allocator = m_editor.getAllocator();
+	m_find_task = LUMIX_NEW(allocator, FindResourcesTask)(*this, allocator);
+	m_find_task->create("Find resources");
+	m_find_task->run();
+}
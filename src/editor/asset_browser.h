@@ -3,6 +3,7 @@
 
 #include "core/array.h"
 #include "core/delegate_list.h"
+#include "core/hash_map.h"
 #include "core/path.h"
 #include "core/mt/sync.h"
 
@@ -54,11 +55,17 @@ public:
 public:
 	bool m_is_opened;
 
+private:
+	struct FindResourcesTask;
+
 private:
 	void onFileChanged(const char* path);
 	void findResources();
-	void processDir(const char* path, int base_length);
-	void addResource(const char* path, const char* filename);
+	void stopFindResources();
+	void addFoundResources();
+	void addResource(const char* path);
+	void removeResource(const Lumix::Path& path, int type_index);
+	void updateFilteredResources();
 	void onGUIResource();
 	void unloadResource();
 	void selectResource(Lumix::Resource* resource);
@@ -74,6 +81,15 @@ private:
 	Lumix::Array<IPlugin*> m_plugins;
 	Lumix::MT::SpinMutex m_changed_files_mutex;
 	Lumix::Array<Lumix::Array<Lumix::Path> > m_resources;
+	// path hash -> index of the type in m_resources, to not add a file twice
+	Lumix::HashMap<Lumix::uint32, int> m_resource_hashes;
+	// files found by m_find_task, added in update() since plugins are not thread safe
+	Lumix::Array<Lumix::Path> m_found_files;
+	Lumix::MT::SpinMutex m_found_files_mutex;
+	FindResourcesTask* m_find_task;
+	// indices of resources of m_current_type passing m_filter
+	Lumix::Array<int> m_filtered_resources;
+	bool m_is_filter_dirty;
 	Lumix::Resource* m_selected_resource;
 	Lumix::WorldEditor& m_editor;
 	FileSystemWatcher* m_watchers[2];
@@ -1,5 +1,6 @@
 #include "entity_groups.h"
 #include "core/blob.h"
+#include "core/math_utils.h"
 #include "core/string.h"
 #include "universe/universe.h"
 
@@ -88,8 +89,8 @@ void EntityGroups::setUniverse(Universe* universe)
 {
 	if (m_universe)
 	{
-		m_universe->entityCreated().unbind<EntityGroups, &EntityGroups::onEntityCreated>(this);
-		m_universe->entityDestroyed().unbind<EntityGroups, &EntityGroups::onEntityDestroyed>(this);
+		m_universe->entitiesCreated().unbind<EntityGroups, &EntityGroups::onEntitiesCreated>(this);
+		m_universe->entitiesDestroyed().unbind<EntityGroups, &EntityGroups::onEntitiesDestroyed>(this);
 	}
 
 	m_universe = universe;
@@ -101,8 +102,8 @@ void EntityGroups::setUniverse(Universe* universe)
 
 	if (m_universe)
 	{
-		m_universe->entityCreated().bind<EntityGroups, &EntityGroups::onEntityCreated>(this);
-		m_universe->entityDestroyed().bind<EntityGroups, &EntityGroups::onEntityDestroyed>(this);
+		m_universe->entitiesCreated().bind<EntityGroups, &EntityGroups::onEntitiesCreated>(this);
+		m_universe->entitiesDestroyed().bind<EntityGroups, &EntityGroups::onEntitiesDestroyed>(this);
 	}
 }
 
@@ -113,18 +114,28 @@ int EntityGroups::getGroupEntitiesCount(int idx) const
 }
 
 
-void EntityGroups::onEntityCreated(Entity entity)
+void EntityGroups::onEntitiesCreated(const Entity* entities, int count)
 {
-	m_groups[0].push(entity);
-	if (entity >= m_entity_to_group_map.size()) m_entity_to_group_map.resize(entity + 1);
-	m_entity_to_group_map[entity] = 0;
+	Entity max_entity = -1;
+	for (int i = 0; i < count; ++i) max_entity = Math::maxValue(max_entity, entities[i]);
+	if (max_entity >= m_entity_to_group_map.size()) m_entity_to_group_map.resize(max_entity + 1);
+
+	auto& group = m_groups[0];
+	group.reserve(group.size() + count);
+	for (int i = 0; i < count; ++i)
+	{
+		group.push(entities[i]);
+		m_entity_to_group_map[entities[i]] = 0;
+	}
 }
 
 
-void EntityGroups::onEntityDestroyed(Entity entity)
+void EntityGroups::onEntitiesDestroyed(const Entity* entities, int count)
 {
-	removeFromGroup(entity);
-	m_entity_to_group_map[entity] = -1;
+	for (int i = 0; i < count; ++i)
+	{
+		removeFromGroup(entities[i]);
+	}
 }
 
 
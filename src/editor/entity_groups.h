@@ -47,8 +47,8 @@ private:
 
 private:
 	void removeFromGroup(Entity entity);
-	void onEntityCreated(Entity entity);
-	void onEntityDestroyed(Entity entity);
+	void onEntitiesCreated(const Entity* entities, int count);
+	void onEntitiesDestroyed(const Entity* entities, int count);
 
 private:
 	IAllocator& m_allocator;
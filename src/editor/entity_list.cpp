@@ -0,0 +1,221 @@
+#include "entity_list.h"
+#include "core/string.h"
+#include "editor/world_editor.h"
+#include "imgui/imgui.h"
+#include "universe/universe.h"
+#include "utils.h"
+#include <cstdlib>
+
+
+// batches bigger than this are merged to the list at once instead of entity by entity
+static const int BATCH_SIZE_THRESHOLD = 16;
+
+
+static int compareEntities(const void* a, const void* b)
+{
+	return *(const Lumix::Entity*)a - *(const Lumix::Entity*)b;
+}
+
+
+EntityList::EntityList(Lumix::WorldEditor& editor)
+	: m_editor(editor)
+	, m_universe(nullptr)
+	, m_entities(editor.getAllocator())
+{
+	m_filter[0] = '\0';
+	editor.universeCreated().bind<EntityList, &EntityList::onUniverseCreated>(this);
+	editor.universeDestroyed().bind<EntityList, &EntityList::onUniverseDestroyed>(this);
+	editor.universeLoaded().bind<EntityList, &EntityList::rebuild>(this);
+	editor.entityNameSet().bind<EntityList, &EntityList::onEntityNameSet>(this);
+	setUniverse(editor.getUniverse());
+}
+
+
+EntityList::~EntityList()
+{
+	setUniverse(nullptr);
+	m_editor.universeCreated().unbind<EntityList, &EntityList::onUniverseCreated>(this);
+	m_editor.universeDestroyed().unbind<EntityList, &EntityList::onUniverseDestroyed>(this);
+	m_editor.universeLoaded().unbind<EntityList, &EntityList::rebuild>(this);
+	m_editor.entityNameSet().unbind<EntityList, &EntityList::onEntityNameSet>(this);
+}
+
+
+void EntityList::onUniverseCreated()
+{
+	setUniverse(m_editor.getUniverse());
+}
+
+
+void EntityList::onUniverseDestroyed()
+{
+	setUniverse(nullptr);
+}
+
+
+void EntityList::setUniverse(Lumix::Universe* universe)
+{
+	if (m_universe)
+	{
+		m_universe->entitiesCreated().unbind<EntityList, &EntityList::onEntitiesCreated>(this);
+		m_universe->entitiesDestroyed().unbind<EntityList, &EntityList::onEntitiesDestroyed>(this);
+		m_universe->componentAdded().unbind<EntityList, &EntityList::onComponentChanged>(this);
+		m_universe->componentDestroyed().unbind<EntityList, &EntityList::onComponentChanged>(this);
+	}
+
+	m_universe = universe;
+
+	if (m_universe)
+	{
+		m_universe->entitiesCreated().bind<EntityList, &EntityList::onEntitiesCreated>(this);
+		m_universe->entitiesDestroyed().bind<EntityList, &EntityList::onEntitiesDestroyed>(this);
+		m_universe->componentAdded().bind<EntityList, &EntityList::onComponentChanged>(this);
+		m_universe->componentDestroyed().bind<EntityList, &EntityList::onComponentChanged>(this);
+	}
+	rebuild();
+}
+
+
+void EntityList::rebuild()
+{
+	m_entities.clear();
+	if (!m_universe) return;
+
+	int count = m_universe->getEntityCount();
+	m_entities.reserve(count);
+	for (int i = 0; i < count; ++i)
+	{
+		Lumix::Entity entity = m_universe->getEntityFromDenseIdx(i);
+		if (isMatching(entity)) m_entities.push(entity);
+	}
+	if (!m_entities.empty())
+	{
+		qsort(&m_entities[0], m_entities.size(), sizeof(m_entities[0]), compareEntities);
+	}
+}
+
+
+// names depend on components too, see getEntityListDisplayName
+bool EntityList::isMatching(Lumix::Entity entity) const
+{
+	if (m_filter[0] == '\0') return true;
+	char name[1024];
+	getEntityListDisplayName(m_editor, name, sizeof(name), entity);
+	return Lumix::stristr(name, m_filter) != nullptr;
+}
+
+
+int EntityList::lowerBound(Lumix::Entity entity) const
+{
+	int from = 0;
+	int to = m_entities.size();
+	while (from < to)
+	{
+		int mid = (from + to) >> 1;
+		if (m_entities[mid] < entity) from = mid + 1;
+		else to = mid;
+	}
+	return from;
+}
+
+
+void EntityList::update(Lumix::Entity entity)
+{
+	int idx = lowerBound(entity);
+	bool is_listed = idx < m_entities.size() && m_entities[idx] == entity;
+	if (is_listed == isMatching(entity)) return;
+	if (is_listed) m_entities.erase(idx);
+	else m_entities.insert(idx, entity);
+}
+
+
+void EntityList::remove(Lumix::Entity entity)
+{
+	int idx = lowerBound(entity);
+	if (idx < m_entities.size() && m_entities[idx] == entity) m_entities.erase(idx);
+}
+
+
+void EntityList::onEntitiesCreated(const Lumix::Entity* entities, int count)
+{
+	if (count <= BATCH_SIZE_THRESHOLD)
+	{
+		for (int i = 0; i < count; ++i) update(entities[i]);
+		return;
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		if (isMatching(entities[i])) m_entities.push(entities[i]);
+	}
+	if (!m_entities.empty())
+	{
+		qsort(&m_entities[0], m_entities.size(), sizeof(m_entities[0]), compareEntities);
+	}
+}
+
+
+void EntityList::onEntitiesDestroyed(const Lumix::Entity* entities, int count)
+{
+	if (count <= BATCH_SIZE_THRESHOLD)
+	{
+		for (int i = 0; i < count; ++i) remove(entities[i]);
+		return;
+	}
+
+	Lumix::Array<Lumix::Entity> destroyed(m_editor.getAllocator());
+	destroyed.resize(count);
+	Lumix::copyMemory(&destroyed[0], entities, sizeof(entities[0]) * count);
+	qsort(&destroyed[0], count, sizeof(destroyed[0]), compareEntities);
+
+	// both lists are sorted
+	int kept = 0;
+	for (int i = 0, j = 0, c = m_entities.size(); i < c; ++i)
+	{
+		Lumix::Entity entity = m_entities[i];
+		while (j < count && destroyed[j] < entity) ++j;
+		if (j < count && destroyed[j] == entity) continue;
+		m_entities[kept] = entity;
+		++kept;
+	}
+	m_entities.resize(kept);
+}
+
+
+void EntityList::onEntityNameSet(Lumix::Entity entity, const char*)
+{
+	if (m_filter[0] != '\0') update(entity);
+}
+
+
+void EntityList::onComponentChanged(const Lumix::ComponentUID& cmp)
+{
+	if (m_filter[0] != '\0') update(cmp.entity);
+}
+
+
+void EntityList::onGUI()
+{
+	if (!m_universe) return;
+
+	if (ImGui::InputText("Filter", m_filter, sizeof(m_filter))) rebuild();
+	ImGui::Text("%d / %d entities", m_entities.size(), m_universe->getEntityCount());
+
+	if (!ImGui::ListBoxHeader("Entities", m_entities.size(), 15)) return;
+	auto& selected = m_editor.getSelectedEntities();
+	ImGuiListClipper clipper(m_entities.size(), ImGui::GetTextLineHeightWithSpacing());
+	for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+	{
+		Lumix::Entity entity = m_entities[i];
+		char name[1024];
+		getEntityListDisplayName(m_editor, name, sizeof(name), entity);
+		ImGui::PushID(entity);
+		if (ImGui::Selectable(name, selected.indexOf(entity) >= 0))
+		{
+			m_editor.selectEntities(&entity, 1);
+		}
+		ImGui::PopID();
+	}
+	clipper.End();
+	ImGui::ListBoxFooter();
+}
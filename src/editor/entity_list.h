@@ -0,0 +1,47 @@
+#pragma once
+
+
+#include "core/array.h"
+#include "universe/component.h"
+
+
+namespace Lumix
+{
+	class Universe;
+	class WorldEditor;
+}
+
+
+// Flat list of all entities in the universe. Entities matching the filter are cached sorted by
+// entity and the cache is updated per created, destroyed or renamed entity, so the list is not
+// rebuilt every frame; only the visible rows are built.
+class LUMIX_EDITOR_API EntityList
+{
+public:
+	explicit EntityList(Lumix::WorldEditor& editor);
+	~EntityList();
+
+	void onGUI();
+	const Lumix::Array<Lumix::Entity>& getFilteredEntities() const { return m_entities; }
+
+private:
+	void setUniverse(Lumix::Universe* universe);
+	void onUniverseCreated();
+	void onUniverseDestroyed();
+	void rebuild();
+	bool isMatching(Lumix::Entity entity) const;
+	int lowerBound(Lumix::Entity entity) const;
+	// adds or removes the entity from the filtered list after it changed
+	void update(Lumix::Entity entity);
+	void remove(Lumix::Entity entity);
+	void onEntitiesCreated(const Lumix::Entity* entities, int count);
+	void onEntitiesDestroyed(const Lumix::Entity* entities, int count);
+	void onEntityNameSet(Lumix::Entity entity, const char* name);
+	void onComponentChanged(const Lumix::ComponentUID& cmp);
+
+private:
+	Lumix::WorldEditor& m_editor;
+	Lumix::Universe* m_universe;
+	Lumix::Array<Lumix::Entity> m_entities;
+	char m_filter[128];
+};
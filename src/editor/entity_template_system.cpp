@@ -1,5 +1,6 @@
 #include "entity_template_system.h"
 #include "core/array.h"
+#include "core/associative_array.h"
 #include "core/blob.h"
 #include "core/crc32.h"
 #include "core/json_serializer.h"
@@ -8,6 +9,8 @@
 #include "editor/ieditor_command.h"
 #include "editor/world_editor.h"
 #include "engine.h"
+#include "engine/iproperty_descriptor.h"
+#include "engine/property_register.h"
 #include "iplugin.h"
 #include "universe/universe.h"
 #include <cstdlib>
@@ -218,6 +221,182 @@ private:
 		Quat m_rotation;
 	};
 
+	// one undo step for a whole batch, e.g. entities painted on a terrain; the template is
+	// serialized once and each instance is created from the blob
+	class CreateInstancesCommand : public IEditorCommand
+	{
+	public:
+		explicit CreateInstancesCommand(WorldEditor& editor)
+			: m_entity_system(
+				  static_cast<EntityTemplateSystemImpl&>(editor.getEntityTemplateSystem()))
+			, m_editor(editor)
+			, m_template_name_hash(0)
+			, m_entities(editor.getAllocator())
+			, m_positions(editor.getAllocator())
+			, m_rotations(editor.getAllocator())
+		{
+		}
+
+
+		CreateInstancesCommand(EntityTemplateSystemImpl& entity_system,
+			WorldEditor& editor,
+			const char* template_name,
+			const Vec3* positions,
+			const Quat* rotations,
+			int count)
+			: m_entity_system(entity_system)
+			, m_editor(editor)
+			, m_template_name_hash(crc32(template_name))
+			, m_entities(editor.getAllocator())
+			, m_positions(editor.getAllocator())
+			, m_rotations(editor.getAllocator())
+		{
+			m_positions.resize(count);
+			m_rotations.resize(count);
+			for (int i = 0; i < count; ++i)
+			{
+				m_positions[i] = positions[i];
+				m_rotations[i] = rotations[i];
+			}
+		}
+
+
+		void serialize(JsonSerializer& serializer) override
+		{
+			serializer.serialize("template_name_hash", m_template_name_hash);
+			serializer.beginArray("transforms");
+			for (int i = 0; i < m_positions.size(); ++i)
+			{
+				serializer.serializeArrayItem(m_positions[i].x);
+				serializer.serializeArrayItem(m_positions[i].y);
+				serializer.serializeArrayItem(m_positions[i].z);
+				serializer.serializeArrayItem(m_rotations[i].x);
+				serializer.serializeArrayItem(m_rotations[i].y);
+				serializer.serializeArrayItem(m_rotations[i].z);
+				serializer.serializeArrayItem(m_rotations[i].w);
+			}
+			serializer.endArray();
+		}
+
+
+		void deserialize(JsonSerializer& serializer) override
+		{
+			serializer.deserialize("template_name_hash", m_template_name_hash, 0);
+			m_positions.clear();
+			m_rotations.clear();
+			serializer.deserializeArrayBegin("transforms");
+			while (!serializer.isArrayEnd())
+			{
+				Vec3& pos = m_positions.emplace();
+				Quat& rot = m_rotations.emplace();
+				serializer.deserializeArrayItem(pos.x, 0);
+				serializer.deserializeArrayItem(pos.y, 0);
+				serializer.deserializeArrayItem(pos.z, 0);
+				serializer.deserializeArrayItem(rot.x, 0);
+				serializer.deserializeArrayItem(rot.y, 0);
+				serializer.deserializeArrayItem(rot.z, 0);
+				serializer.deserializeArrayItem(rot.w, 1);
+			}
+			serializer.deserializeArrayEnd();
+		}
+
+
+		bool execute() override
+		{
+			int instance_index = m_entity_system.m_instances.find(m_template_name_hash);
+			if (instance_index < 0 || m_positions.empty()) return false;
+
+			Array<Entity>& instances = m_entity_system.m_instances.at(instance_index);
+			OutputBlob tpl(m_editor.getAllocator());
+			const WorldEditor::ComponentList& template_cmps = m_editor.getComponents(instances[0]);
+			tpl.write((int32)template_cmps.size());
+			for (int i = 0; i < template_cmps.size(); ++i)
+			{
+				tpl.write(template_cmps[i].type);
+				Array<IPropertyDescriptor*>& props =
+					PropertyRegister::getDescriptors(template_cmps[i].type);
+				for (int j = 0; j < props.size(); ++j)
+				{
+					props[j]->get(template_cmps[i], -1, tpl);
+				}
+			}
+
+			Universe* universe = m_editor.getUniverse();
+			m_entities.resize(m_positions.size());
+			universe->createEntities(
+				&m_entities[0], &m_positions[0], &m_rotations[0], m_entities.size());
+			instances.reserve(instances.size() + m_entities.size());
+			const Array<IScene*>& scenes = m_editor.getScenes();
+			for (int i = 0; i < m_entities.size(); ++i)
+			{
+				Entity entity = m_entities[i];
+				instances.push(entity);
+				InputBlob blob(tpl);
+				int32 cmps_count;
+				blob.read(cmps_count);
+				for (int k = 0; k < cmps_count; ++k)
+				{
+					uint32 type;
+					blob.read(type);
+					ComponentUID cmp = ComponentUID::INVALID;
+					for (int j = 0; j < scenes.size() && !cmp.isValid(); ++j)
+					{
+						cmp = ComponentUID(
+							entity, type, scenes[j], scenes[j]->createComponent(type, entity));
+					}
+					Array<IPropertyDescriptor*>& props = PropertyRegister::getDescriptors(type);
+					for (int j = 0; j < props.size(); ++j)
+					{
+						props[j]->set(cmp, -1, blob);
+					}
+				}
+			}
+			return true;
+		}
+
+
+		void undo() override
+		{
+			for (int i = 0; i < m_entities.size(); ++i)
+			{
+				const WorldEditor::ComponentList& cmps = m_editor.getComponents(m_entities[i]);
+				for (int j = cmps.size() - 1; j >= 0; --j)
+				{
+					cmps[j].scene->destroyComponent(cmps[j].index, cmps[j].type);
+				}
+			}
+			m_entity_system.m_universe->destroyEntities(&m_entities[0], m_entities.size());
+			m_entities.clear();
+		}
+
+
+		bool merge(IEditorCommand&) override { return false; }
+
+
+		int getMemorySize() const override
+		{
+			return m_positions.size() * (sizeof(Vec3) + sizeof(Quat) + sizeof(Entity));
+		}
+
+
+		uint32 getType() override
+		{
+			static const uint32 hash = crc32("create_entity_template_instances");
+			return hash;
+		}
+
+
+		const Array<Entity>& getEntities() const { return m_entities; }
+
+	private:
+		EntityTemplateSystemImpl& m_entity_system;
+		WorldEditor& m_editor;
+		uint32 m_template_name_hash;
+		Array<Entity> m_entities;
+		Array<Vec3> m_positions;
+		Array<Quat> m_rotations;
+	};
+
 public:
 	explicit EntityTemplateSystemImpl(WorldEditor& editor)
 		: m_editor(editor)
@@ -233,6 +412,8 @@ public:
 		setUniverse(editor.getUniverse());
 		editor.registerEditorCommandCreator("create_entity_template_instance",
 			&EntityTemplateSystemImpl::createCreateInstanceCommand);
+		editor.registerEditorCommandCreator("create_entity_template_instances",
+			&EntityTemplateSystemImpl::createCreateInstancesCommand);
 		editor.registerEditorCommandCreator(
 			"create_entity_template", &EntityTemplateSystemImpl::createCreateTemplateCommand);
 	}
@@ -244,6 +425,12 @@ public:
 	}
 
 
+	static IEditorCommand* createCreateInstancesCommand(WorldEditor& editor)
+	{
+		return LUMIX_NEW(editor.getAllocator(), CreateInstancesCommand)(editor);
+	}
+
+
 	static IEditorCommand* createCreateTemplateCommand(WorldEditor& editor)
 	{
 		return LUMIX_NEW(editor.getAllocator(), CreateTemplateCommand)(editor);
@@ -365,6 +552,18 @@ public:
 	}
 
 
+	void createInstances(const char* name,
+		const Vec3* positions,
+		const Quat* rotations,
+		int count) override
+	{
+		if (count <= 0) return;
+		CreateInstancesCommand* command = LUMIX_NEW(m_editor.getAllocator(),
+			CreateInstancesCommand)(*this, m_editor, name, positions, rotations, count);
+		m_editor.executeCommand(command);
+	}
+
+
 	void serialize(OutputBlob& serializer) override
 	{
 		serializer.write((int32)m_template_names.size());
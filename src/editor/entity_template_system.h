@@ -29,6 +29,11 @@ namespace Lumix
 			virtual const Array<Entity>& getInstances(uint32 template_name_hash) = 0;
 			virtual Array<string>& getTemplateNames() = 0;
 			virtual Entity createInstance(const char* name, const Vec3& position, const Quat& rot) = 0;
+			// all instances are created by a single command, i.e. they are undone as a whole
+			virtual void createInstances(const char* name,
+				const Vec3* positions,
+				const Quat* rotations,
+				int count) = 0;
 
 			virtual DelegateList<void()>& updated() = 0;
 	};
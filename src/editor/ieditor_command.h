@@ -19,6 +19,12 @@ namespace Lumix
 			virtual void deserialize(JsonSerializer& serializer) = 0;
 			virtual uint32 getType() = 0;
 			virtual bool merge(IEditorCommand& command) = 0;
+			// bytes kept for undo and redo, the oldest commands are dropped from the undo stack
+			// when the sum gets over its budget; commands without big data keep the default
+			virtual int getMemorySize() const { return 0; }
+			// called on commands deep in the undo stack, they can compress their data until they
+			// need it again in execute(), undo() or serialize()
+			virtual void compact() {}
 	};
 
 
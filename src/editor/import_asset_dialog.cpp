@@ -1,4 +1,5 @@
 #include "animation/animation.h"
+#include "animation/animation_compression.h"
 #include "assimp/DefaultLogger.hpp"
 #include "assimp/ProgressHandler.hpp"
 #include "assimp/postprocess.h"
@@ -6,7 +7,9 @@
 #include "core/FS/disk_file_device.h"
 #include "core/FS/os_file.h"
 #include "core/math_utils.h"
+#include "core/MT/atomic.h"
 #include "core/MT/task.h"
+#include "core/MT/thread.h"
 #include "core/crc32.h"
 #include "core/log.h"
 #include "core/path_utils.h"
@@ -17,6 +20,7 @@
 #include "engine/engine.h"
 #include "imgui/imgui.h"
 #include "import_asset_dialog.h"
+#include "mesh_simplifier.h"
 #include "metadata.h"
 #include "physics/physics_geometry_manager.h"
 #include "platform_interface.h"
@@ -31,6 +35,9 @@
 typedef StringBuilder<Lumix::MAX_PATH_LENGTH> PathBuilder;
 
 
+static const char* TEXTURE_CACHE_FILENAME = "texture_import_cache.bin";
+
+
 enum class VertexAttributeDef : Lumix::uint32
 {
 	POSITION,
@@ -80,12 +87,16 @@ static crn_bool ddsConvertCallback(crn_uint32 phase_index,
 {
 	auto *data = (ImportAssetDialog::DDSConvertCallbackData*)pUser_data_ptr;
 
-	float fraction = phase_index / float(total_phases) +
-					 (subphase_index / float(total_subphases)) / total_phases;
-	data->dialog->setImportMessage(
-		StringBuilder<Lumix::MAX_PATH_LENGTH + 50>("Saving ", data->dest_path), fraction);
+	// images converted in batches report only the count of finished ones
+	if (data->dest_path)
+	{
+		float fraction = phase_index / float(total_phases) +
+						 (subphase_index / float(total_subphases)) / total_phases;
+		data->dialog->setImportMessage(
+			StringBuilder<Lumix::MAX_PATH_LENGTH + 50>("Saving ", data->dest_path), fraction);
+	}
 
-	return !data->cancel_requested;
+	return !data->dialog->getDDSConvertCallbackData().cancel_requested;
 }
 
 
@@ -136,15 +147,22 @@ static bool saveAsDDS(ImportAssetDialog& dialog,
 	int image_width,
 	int image_height,
 	bool alpha,
-	const char* dest_path)
+	const char* dest_path,
+	int helper_threads)
 {
 	ASSERT(image_data);
 
-	dialog.setImportMessage(StringBuilder<Lumix::MAX_PATH_LENGTH + 30>("Saving ") << dest_path, 0);
-	
-	dialog.getDDSConvertCallbackData().dialog = &dialog;
-	dialog.getDDSConvertCallbackData().dest_path = dest_path;
-	dialog.getDDSConvertCallbackData().cancel_requested = false;
+	// the dialog's data has only the cancel flag, several images can be converted at once
+	ImportAssetDialog::DDSConvertCallbackData callback_data;
+	callback_data.dialog = &dialog;
+	callback_data.dest_path = nullptr;
+	callback_data.cancel_requested = false;
+	if (helper_threads > 0)
+	{
+		dialog.setImportMessage(
+			StringBuilder<Lumix::MAX_PATH_LENGTH + 30>("Saving ") << dest_path, 0);
+		callback_data.dest_path = dest_path;
+	}
 
 	crn_uint32 size;
 	crn_comp_params comp_params;
@@ -156,8 +174,8 @@ static bool saveAsDDS(ImportAssetDialog& dialog,
 	comp_params.m_dxt_quality = cCRNDXTQualitySuperFast;
 	comp_params.m_dxt_compressor_type = cCRNDXTCompressorRYG;
 	comp_params.m_pProgress_func = ddsConvertCallback;
-	comp_params.m_pProgress_func_data = &dialog.getDDSConvertCallbackData();
-	comp_params.m_num_helper_threads = 3;
+	comp_params.m_pProgress_func_data = &callback_data;
+	comp_params.m_num_helper_threads = helper_threads;
 	comp_params.m_pImages[0][0] = (Lumix::uint32*)image_data;
 	crn_mipmap_params mipmap_params;
 	mipmap_params.m_mode = cCRNMipModeGenerateMips;
@@ -188,6 +206,174 @@ static bool saveAsDDS(ImportAssetDialog& dialog,
 }
 
 
+// Converts images to DDS on all cores, each image by a single crnlib thread. Sources with the same
+// crc32 as at their last conversion are skipped if the destination still exists, the hashes are
+// kept in the import cache of the dialog.
+struct DDSBatch
+{
+	struct Job
+	{
+		// only for messages if the image is in memory
+		char source[Lumix::MAX_PATH_LENGTH];
+		char dest[Lumix::MAX_PATH_LENGTH];
+		// embedded images, they stay alive until the batch is run
+		const void* memory;
+		int memory_size;
+		Lumix::uint32 source_hash;
+		bool is_converted;
+	};
+
+
+	struct Worker : public Lumix::MT::Task
+	{
+		Worker(DDSBatch& _batch, Lumix::IAllocator& allocator)
+			: Task(allocator)
+			, batch(_batch)
+		{
+		}
+
+		int task() override
+		{
+			batch.work();
+			return 0;
+		}
+
+		DDSBatch& batch;
+	};
+
+
+	explicit DDSBatch(ImportAssetDialog& dialog)
+		: m_dialog(dialog)
+		, m_jobs(dialog.getEditor().getAllocator())
+		, m_next_job(0)
+		, m_finished_count(0)
+	{
+	}
+
+
+	void add(const char* source, const char* dest, const void* memory, int memory_size)
+	{
+		Job& job = m_jobs.emplace();
+		Lumix::copyString(job.source, source);
+		Lumix::copyString(job.dest, dest);
+		job.memory = memory;
+		job.memory_size = memory_size;
+		job.source_hash = 0;
+		job.is_converted = false;
+	}
+
+
+	bool convert(Job& job)
+	{
+		Lumix::Array<Lumix::uint8> file_data(m_dialog.getEditor().getAllocator());
+		const void* data = job.memory;
+		int size = job.memory_size;
+		if (!data)
+		{
+			Lumix::FS::OsFile file;
+			auto& allocator = m_dialog.getEditor().getAllocator();
+			if (!file.open(job.source, Lumix::FS::Mode::OPEN_AND_READ, allocator))
+			{
+				m_dialog.setMessage(StringBuilder<Lumix::MAX_PATH_LENGTH + 20>(
+					"Could not load image ", job.source));
+				return false;
+			}
+			file_data.resize((int)file.size());
+			if (!file_data.empty()) file.read(&file_data[0], file_data.size());
+			file.close();
+			data = file_data.empty() ? nullptr : &file_data[0];
+			size = file_data.size();
+		}
+
+		job.source_hash = Lumix::crc32(data, size);
+		if (m_dialog.isTextureUpToDate(job.dest, job.source_hash)) return true;
+
+		int width, height, comp;
+		auto* image = stbi_load_from_memory((stbi_uc*)data, size, &width, &height, &comp, 4);
+		if (!image)
+		{
+			m_dialog.setMessage(StringBuilder<Lumix::MAX_PATH_LENGTH + 20>(
+				"Could not load image ", job.source));
+			return false;
+		}
+		// cores are already busy with other images
+		int helper_threads = m_jobs.size() == 1 ? 3 : 0;
+		bool success = saveAsDDS(m_dialog,
+			m_dialog.getEditor().getEngine().getFileSystem(),
+			job.source,
+			image,
+			width,
+			height,
+			comp == 4,
+			job.dest,
+			helper_threads);
+		stbi_image_free(image);
+		return success;
+	}
+
+
+	void work()
+	{
+		for (;;)
+		{
+			int index = Lumix::MT::atomicIncrement(&m_next_job) - 1;
+			if (index >= m_jobs.size()) return;
+
+			Job& job = m_jobs[index];
+			job.is_converted = convert(job);
+			int finished = Lumix::MT::atomicIncrement(&m_finished_count);
+			if (m_jobs.size() > 1)
+			{
+				m_dialog.setImportMessage(
+					StringBuilder<50>("Converting textures ", finished, "/", m_jobs.size()),
+					finished / (float)m_jobs.size());
+			}
+		}
+	}
+
+
+	// returns false if any image could not be converted
+	bool run()
+	{
+		auto& allocator = m_dialog.getEditor().getAllocator();
+		int worker_count =
+			Lumix::Math::minValue((int)Lumix::MT::getCPUsCount(), m_jobs.size()) - 1;
+		Lumix::Array<Worker*> workers(allocator);
+		for (int i = 0; i < worker_count; ++i)
+		{
+			Worker* worker = LUMIX_NEW(allocator, Worker)(*this, allocator);
+			worker->create("DDSWorker");
+			worker->run();
+			workers.push(worker);
+		}
+		work();
+		for (Worker* worker : workers)
+		{
+			worker->destroy();
+			LUMIX_DELETE(allocator, worker);
+		}
+
+		bool success = true;
+		for (const Job& job : m_jobs)
+		{
+			success = success && job.is_converted;
+			if (job.is_converted) m_dialog.setTextureHash(job.dest, job.source_hash);
+		}
+		m_dialog.saveTextureCache();
+		m_jobs.clear();
+		m_next_job = 0;
+		m_finished_count = 0;
+		return success;
+	}
+
+
+	ImportAssetDialog& m_dialog;
+	Lumix::Array<Job> m_jobs;
+	volatile Lumix::int32 m_next_job;
+	volatile Lumix::int32 m_finished_count;
+};
+
+
 struct ImportTextureTask : public Lumix::MT::Task
 {
 	explicit ImportTextureTask(ImportAssetDialog& dialog)
@@ -234,6 +420,22 @@ struct ImportTextureTask : public Lumix::MT::Task
 	int task() override
 	{
 		m_dialog.setImportMessage("Importing texture...", 0);
+		char dest_path[Lumix::MAX_PATH_LENGTH];
+		getDestinationPath(m_dialog.m_output_dir,
+			m_dialog.m_source,
+			m_dialog.m_convert_to_dds,
+			m_dialog.m_convert_to_raw,
+			dest_path,
+			Lumix::lengthOf(dest_path));
+
+		if (m_dialog.m_convert_to_dds)
+		{
+			m_dialog.setImportMessage("Converting to DDS...", 0);
+			DDSBatch batch(m_dialog);
+			batch.add(m_dialog.m_source, dest_path, nullptr, 0);
+			return batch.run() ? 0 : -1;
+		}
+
 		int image_width;
 		int image_height;
 		int image_comp;
@@ -248,28 +450,7 @@ struct ImportTextureTask : public Lumix::MT::Task
 			return -1;
 		}
 
-		char dest_path[Lumix::MAX_PATH_LENGTH];
-		getDestinationPath(m_dialog.m_output_dir,
-			m_dialog.m_source,
-			m_dialog.m_convert_to_dds,
-			m_dialog.m_convert_to_raw,
-			dest_path,
-			Lumix::lengthOf(dest_path));
-
-		if (m_dialog.m_convert_to_dds)
-		{
-			m_dialog.setImportMessage("Converting to DDS...", 0);
-
-			saveAsDDS(m_dialog,
-				m_dialog.m_editor.getEngine().getFileSystem(),
-				m_dialog.m_source,
-				data,
-				image_width,
-				image_height,
-				image_comp == 4,
-				dest_path);
-		}
-		else if (m_dialog.m_convert_to_raw)
+		if (m_dialog.m_convert_to_raw)
 		{
 			m_dialog.setImportMessage("Converting to RAW...", -1);
 
@@ -362,7 +543,8 @@ struct ImportTask : public Lumix::MT::Task
 		unsigned int flags =
 			aiProcess_JoinIdenticalVertices | aiProcess_RemoveComponent | aiProcess_GenUVCoords |
 			aiProcess_RemoveRedundantMaterials | aiProcess_Triangulate | aiProcess_FindInvalidData |
-			aiProcess_OptimizeGraph | aiProcess_ValidateDataStructure | aiProcess_CalcTangentSpace;
+			aiProcess_OptimizeGraph | aiProcess_ValidateDataStructure | aiProcess_CalcTangentSpace |
+			aiProcess_ImproveCacheLocality;
 		flags |= m_dialog.m_gen_smooth_normal ? aiProcess_GenSmoothNormals : aiProcess_GenNormals;
 		flags |= m_dialog.m_optimize_mesh_on_import ? aiProcess_OptimizeMeshes : 0;
 		const aiScene* scene = m_dialog.m_importer.ReadFile(m_dialog.m_source, flags);
@@ -415,13 +597,16 @@ struct ConvertTask : public Lumix::MT::Task
 		, m_filtered_meshes(dialog.m_editor.getAllocator())
 		, m_scale(scale)
 		, m_nodes(dialog.m_editor.getAllocator())
+		, m_dds_batch(dialog)
+		, m_generated_lods(dialog.m_editor.getAllocator())
+		, m_generated_lod_count(0)
 	{
 	}
 
 
+	// the textures are converted by m_dds_batch
 	bool saveEmbeddedTextures(const aiScene* scene, unsigned int* materials, int materials_count)
 	{
-		bool success = true;
 		m_dialog.m_saved_embedded_textures.clear();
 
 		Lumix::Array<unsigned int> textures(m_dialog.m_editor.getAllocator());
@@ -460,35 +645,20 @@ struct ConvertTask : public Lumix::MT::Task
 			}
 			PathBuilder texture_name("texture");
 			texture_name << i << ".dds";
-			int width, height, comp;
-			auto data = stbi_load_from_memory(
-				(stbi_uc*)texture->pcData, texture->mWidth, &width, &height, &comp, 4);
-			if (!data) continue;
-
 			m_dialog.m_saved_embedded_textures[i] = texture_name;
 			PathBuilder dest(m_dialog.m_texture_output_dir[0] ? m_dialog.m_texture_output_dir
 															  : m_dialog.m_output_dir);
 			dest << "/" << texture_name;
-			bool saved = saveAsDDS(m_dialog,
-				m_dialog.m_editor.getEngine().getFileSystem(),
-				"Embedded texture",
-				data,
-				width,
-				height,
-				comp == 4,
-				dest);
-			success = success && saved;
-
-			stbi_image_free(data);
+			m_dds_batch.add("Embedded texture", dest, texture->pcData, texture->mWidth);
 		}
-		return success;
+		return true;
 	}
 
 
 	bool saveTexture(const char* texture_path,
 		const char* source_mesh_dir,
 		Lumix::FS::OsFile& material_file,
-		bool is_srgb) const
+		bool is_srgb)
 	{
 		Lumix::string texture_source_path(texture_path, m_dialog.m_editor.getAllocator());
 		int mapping_index = m_dialog.m_path_mapping.find(texture_source_path);
@@ -549,31 +719,7 @@ struct ConvertTask : public Lumix::MT::Task
 			PathBuilder dest(m_dialog.m_texture_output_dir[0] ? m_dialog.m_texture_output_dir
 															  : m_dialog.m_output_dir);
 			dest << "/" << texture_info.m_basename << ".dds";
-			int image_width, image_height, image_comp;
-			auto data = stbi_load(source, &image_width, &image_height, &image_comp, 4);
-			if (!data)
-			{
-				StringBuilder<Lumix::MAX_PATH_LENGTH + 20> error_msg(
-					"Could not load image ", source);
-				m_dialog.setMessage(error_msg);
-				return false;
-			}
-
-			if (!saveAsDDS(m_dialog,
-				m_dialog.m_editor.getEngine().getFileSystem(),
-				source,
-				data,
-				image_width,
-				image_height,
-				image_comp == 4,
-				dest))
-			{
-				stbi_image_free(data);
-				m_dialog.setMessage(StringBuilder<Lumix::MAX_PATH_LENGTH * 2 + 20>(
-					"Error converting ", source, " to ", dest));
-				return false;
-			}
-			stbi_image_free(data);
+			m_dds_batch.add(source, dest, nullptr, 0);
 		}
 		else
 		{
@@ -675,6 +821,57 @@ struct ConvertTask : public Lumix::MT::Task
 	}
 
 
+	static void writeCompressedTrack(Lumix::FS::OsFile& file,
+		const Lumix::Vec3* positions,
+		const Lumix::Quat* rotations,
+		int frame_count,
+		Lumix::IAllocator& allocator)
+	{
+		namespace Compression = Lumix::AnimationCompression;
+		static const float POSITION_TOLERANCE = 0.001f;
+		static const float ROTATION_TOLERANCE = 0.00001f; // about half a degree
+
+		Lumix::Array<Lumix::uint16> position_frames(allocator);
+		Lumix::Array<Lumix::uint16> rotation_frames(allocator);
+		Compression::reduceKeys(positions, frame_count, POSITION_TOLERANCE, position_frames);
+		Compression::reduceKeys(rotations, frame_count, ROTATION_TOLERANCE, rotation_frames);
+
+		Lumix::Vec3 min = positions[position_frames[0]];
+		Lumix::Vec3 max = min;
+		for (auto frame : position_frames)
+		{
+			const Lumix::Vec3& pos = positions[frame];
+			min.set(Lumix::Math::minValue(min.x, pos.x),
+				Lumix::Math::minValue(min.y, pos.y),
+				Lumix::Math::minValue(min.z, pos.z));
+			max.set(Lumix::Math::maxValue(max.x, pos.x),
+				Lumix::Math::maxValue(max.y, pos.y),
+				Lumix::Math::maxValue(max.z, pos.z));
+		}
+
+		Compression::TrackHeader header;
+		header.position_min = min;
+		header.position_scale = Compression::getPositionScale(min, max);
+		header.position_key_count = (Lumix::uint16)position_frames.size();
+		header.rotation_key_count = (Lumix::uint16)rotation_frames.size();
+		file.write(&header, sizeof(header));
+
+		file.write(&position_frames[0], sizeof(position_frames[0]) * position_frames.size());
+		for (auto frame : position_frames)
+		{
+			auto packed = Compression::packPosition(
+				positions[frame], header.position_min, header.position_scale);
+			file.write(&packed, sizeof(packed));
+		}
+		file.write(&rotation_frames[0], sizeof(rotation_frames[0]) * rotation_frames.size());
+		for (auto frame : rotation_frames)
+		{
+			auto packed = Compression::packQuat(rotations[frame]);
+			file.write(&packed, sizeof(packed));
+		}
+	}
+
+
 	bool saveLumixAnimations()
 	{
 		if (!m_dialog.m_import_animations) return true;
@@ -723,11 +920,18 @@ struct ConvertTask : public Lumix::MT::Task
 					? 25
 					: (animation->mTicksPerSecond == 1 ? 30 : animation->mTicksPerSecond));
 			header.magic = Lumix::Animation::HEADER_MAGIC;
-			header.version = 1;
+			header.version = Lumix::AnimationCompression::VERSION;
 
 			file.write(&header, sizeof(header));
 			float anim_length = getLength(animation);
 			int frame_count = Lumix::Math::maxValue(int(anim_length * header.fps), 1);
+			if (frame_count > Lumix::AnimationCompression::MAX_FRAME_COUNT)
+			{
+				Lumix::g_log_warning.log("Editor") << ani_path << " is too long, it's cut to "
+												   << Lumix::AnimationCompression::MAX_FRAME_COUNT
+												   << " frames";
+				frame_count = Lumix::AnimationCompression::MAX_FRAME_COUNT;
+			}
 			file.write(&frame_count, sizeof(frame_count));
 			int bone_count = (int)animation->mNumChannels;
 			file.write(&bone_count, sizeof(bone_count));
@@ -753,20 +957,26 @@ struct ConvertTask : public Lumix::MT::Task
 					pos.x *= scale.x;
 					pos.y *= scale.y;
 					pos.z *= scale.z;
-					positions[frame * bone_count + channel_idx] = pos;
-					rotations[frame * bone_count + channel_idx] =
+					positions[channel_idx * frame_count + frame] = pos;
+					rotations[channel_idx * frame_count + frame] =
 						getRotation(channel, frame, header.fps);
 				}
 			}
 
-			file.write((const char*)&positions[0], sizeof(positions[0]) * positions.size());
-			file.write((const char*)&rotations[0], sizeof(rotations[0]) * rotations.size());
 			for (unsigned int channel_idx = 0; channel_idx < animation->mNumChannels; ++channel_idx)
 			{
 				const aiNodeAnim* channel = animation->mChannels[channel_idx];
 				uint32_t hash = Lumix::crc32(channel->mNodeName.C_Str());
 				file.write((const char*)&hash, sizeof(hash));
 			}
+			for (int channel_idx = 0; channel_idx < bone_count; ++channel_idx)
+			{
+				writeCompressedTrack(file,
+					&positions[channel_idx * frame_count],
+					&rotations[channel_idx * frame_count],
+					frame_count,
+					m_dialog.m_editor.getAllocator());
+			}
 
 
 			file.close();
@@ -801,21 +1011,25 @@ struct ConvertTask : public Lumix::MT::Task
 		char source_mesh_dir[Lumix::MAX_PATH_LENGTH];
 		Lumix::PathUtils::getDir(source_mesh_dir, sizeof(source_mesh_dir), m_dialog.m_source);
 
+		bool success = true;
 		for (auto i : materials)
 		{
 			const aiMaterial* material = scene->mMaterials[i];
 			if (!saveMaterial(material, source_mesh_dir, &undefined_count))
 			{
-				return false;
+				success = false;
+				break;
 			}
 		}
-		return true;
+		// the materials are written even if some of their textures fail
+		if (!m_dds_batch.run()) m_dialog.setMessage("Failed to convert some textures");
+		return success;
 	}
 
 
 	bool saveMaterial(const aiMaterial* material,
 		const char* source_mesh_dir,
-		int* undefined_count) const
+		int* undefined_count)
 	{
 		ASSERT(undefined_count);
 
@@ -1065,6 +1279,36 @@ struct ConvertTask : public Lumix::MT::Task
 	}
 
 
+	// appends mesh's vertices in the order of their first use to order (new -> old) and
+	// their new positions to remap (old -> new), unused vertices go last
+	static void computeVertexOrder(const aiMesh* mesh,
+		Lumix::Array<Lumix::int32>& order,
+		Lumix::Array<Lumix::int32>& remap)
+	{
+		int remap_offset = remap.size();
+		for (unsigned int i = 0; i < mesh->mNumVertices; ++i) remap.push(-1);
+
+		int next = 0;
+		for (unsigned int i = 0; i < mesh->mNumFaces; ++i)
+		{
+			for (int j = 0; j < 3; ++j)
+			{
+				int index = mesh->mFaces[i].mIndices[j];
+				if (remap[remap_offset + index] >= 0) continue;
+				remap[remap_offset + index] = next++;
+				order.push(index);
+			}
+		}
+		for (unsigned int i = 0; i < mesh->mNumVertices; ++i)
+		{
+			if (remap[remap_offset + i] >= 0) continue;
+			remap[remap_offset + i] = next++;
+			order.push(i);
+		}
+		ASSERT(next == (int)mesh->mNumVertices);
+	}
+
+
 	void writeGeometry(Lumix::FS::OsFile& file) const
 	{
 		const aiScene* scene = m_dialog.m_importer.GetScene();
@@ -1077,19 +1321,64 @@ struct ConvertTask : public Lumix::MT::Task
 			vertices_count += mesh->mNumVertices;
 			vertices_size += mesh->mNumVertices * getVertexSize(mesh);
 		}
+		for (auto& lod_indices : m_generated_lods) indices_count += lod_indices.size();
 
+		// assimp already reordered triangles for the vertex cache, vertices are reordered to be
+		// fetched in the order they are first used
+		Lumix::Array<Lumix::int32> vertex_order(m_dialog.m_editor.getAllocator());
+		Lumix::Array<Lumix::int32> vertex_remap(m_dialog.m_editor.getAllocator());
+		vertex_order.reserve(vertices_count);
+		bool is_16bit = true;
+		for (auto* mesh : m_filtered_meshes)
+		{
+			computeVertexOrder(mesh, vertex_order, vertex_remap);
+			if (mesh->mNumVertices > 0xffff + 1) is_16bit = false;
+		}
+
+		Lumix::int32 index_size = is_16bit ? sizeof(Lumix::uint16) : sizeof(Lumix::int32);
+		file.write((const char*)&index_size, sizeof(index_size));
 		file.write((const char*)&indices_count, sizeof(indices_count));
-		Lumix::int32 polygon_idx = 0;
+		int mesh_vertex_offset = 0;
 		for (auto* mesh : m_filtered_meshes)
 		{
 			for (unsigned int j = 0; j < mesh->mNumFaces; ++j)
 			{
-				polygon_idx = mesh->mFaces[j].mIndices[0];
-				file.write((const char*)&polygon_idx, sizeof(polygon_idx));
-				polygon_idx = mesh->mFaces[j].mIndices[1];
-				file.write((const char*)&polygon_idx, sizeof(polygon_idx));
-				polygon_idx = mesh->mFaces[j].mIndices[2];
-				file.write((const char*)&polygon_idx, sizeof(polygon_idx));
+				for (int k = 0; k < 3; ++k)
+				{
+					int old_index = mesh->mFaces[j].mIndices[k];
+					Lumix::int32 index = vertex_remap[mesh_vertex_offset + old_index];
+					if (is_16bit)
+					{
+						Lumix::uint16 short_index = (Lumix::uint16)index;
+						file.write((const char*)&short_index, sizeof(short_index));
+					}
+					else
+					{
+						file.write((const char*)&index, sizeof(index));
+					}
+				}
+			}
+			mesh_vertex_offset += mesh->mNumVertices;
+		}
+		for (int lod = 1; lod <= m_generated_lod_count; ++lod)
+		{
+			mesh_vertex_offset = 0;
+			for (int i = 0; i < m_filtered_meshes.size(); ++i)
+			{
+				for (int old_index : getGeneratedLOD(lod, i))
+				{
+					Lumix::int32 index = vertex_remap[mesh_vertex_offset + old_index];
+					if (is_16bit)
+					{
+						Lumix::uint16 short_index = (Lumix::uint16)index;
+						file.write((const char*)&short_index, sizeof(short_index));
+					}
+					else
+					{
+						file.write((const char*)&index, sizeof(index));
+					}
+				}
+				mesh_vertex_offset += m_filtered_meshes[i]->mNumVertices;
 			}
 		}
 
@@ -1098,24 +1387,22 @@ struct ConvertTask : public Lumix::MT::Task
 		Lumix::Array<SkinInfo> skin_infos(m_dialog.m_editor.getAllocator());
 		fillSkinInfo(scene, skin_infos, vertices_count);
 
-		int skin_index = 0;
-
+		mesh_vertex_offset = 0;
 		for (auto* mesh : m_filtered_meshes)
 		{
 			auto mesh_matrix = getGlobalTransform(getNode(mesh, scene->mRootNode));
 			auto normal_matrix = mesh_matrix;
 			normal_matrix.a4 = normal_matrix.b4 = normal_matrix.c4 = 0;
 			bool is_skinned = isSkinned(mesh);
-			for (unsigned int j = 0; j < mesh->mNumVertices; ++j)
+			for (unsigned int k = 0; k < mesh->mNumVertices; ++k)
 			{
+				int j = vertex_order[mesh_vertex_offset + k];
 				if (is_skinned)
 				{
-					file.write((const char*)skin_infos[skin_index].weights,
-						sizeof(skin_infos[skin_index].weights));
-					file.write((const char*)skin_infos[skin_index].bone_indices,
-						sizeof(skin_infos[skin_index].bone_indices));
+					const SkinInfo& skin_info = skin_infos[mesh_vertex_offset + j];
+					file.write((const char*)skin_info.weights, sizeof(skin_info.weights));
+					file.write((const char*)skin_info.bone_indices, sizeof(skin_info.bone_indices));
 				}
-				++skin_index;
 
 				auto v = mesh_matrix * mesh->mVertices[j];
 
@@ -1153,6 +1440,7 @@ struct ConvertTask : public Lumix::MT::Task
 				uv.y = -uv.y;
 				file.write((const char*)&uv, sizeof(uv.x) + sizeof(uv.y));
 			}
+			mesh_vertex_offset += mesh->mNumVertices;
 		}
 	}
 
@@ -1228,57 +1516,129 @@ struct ConvertTask : public Lumix::MT::Task
 	}
 
 
-	void writeMeshes(Lumix::FS::OsFile& file)
+	void writeMesh(Lumix::FS::OsFile& file,
+		const aiMesh* mesh,
+		Lumix::int32 attribute_array_offset,
+		Lumix::int32 indices_offset,
+		Lumix::int32 tri_count,
+		const char* mesh_name)
 	{
 		const aiScene* scene = m_dialog.m_importer.GetScene();
-		Lumix::int32 mesh_count = 0;
-		for (int i = 0; i < m_dialog.m_mesh_mask.size(); ++i)
+		aiString material_name;
+		scene->mMaterials[mesh->mMaterialIndex]->Get(AI_MATKEY_NAME, material_name);
+		Lumix::int32 length = Lumix::stringLength(material_name.C_Str());
+		file.write((const char*)&length, sizeof(length));
+		file.write((const char*)material_name.C_Str(), length);
+
+		file.write((const char*)&attribute_array_offset, sizeof(attribute_array_offset));
+		Lumix::int32 attribute_array_size = mesh->mNumVertices * getVertexSize(mesh);
+		file.write((const char*)&attribute_array_size, sizeof(attribute_array_size));
+
+		file.write((const char*)&indices_offset, sizeof(indices_offset));
+		file.write((const char*)&tri_count, sizeof(tri_count));
+
+		length = Lumix::stringLength(mesh_name);
+		file.write((const char*)&length, sizeof(length));
+		file.write((const char*)mesh_name, length);
+
+		Lumix::int32 attribute_count = getAttributeCount(mesh);
+		file.write((const char*)&attribute_count, sizeof(attribute_count));
+
+		if (isSkinned(mesh))
 		{
-			if (m_dialog.m_mesh_mask[i]) ++mesh_count;
+			writeAttribute("in_weights", VertexAttributeDef::FLOAT4, file);
+			writeAttribute("in_indices", VertexAttributeDef::SHORT4, file);
 		}
 
+		writeAttribute("in_position", VertexAttributeDef::POSITION, file);
+		if (mesh->mColors[0]) writeAttribute("in_colors", VertexAttributeDef::BYTE4, file);
+		writeAttribute("in_normal", VertexAttributeDef::BYTE4, file);
+		if (mesh->mTangents) writeAttribute("in_tangents", VertexAttributeDef::BYTE4, file);
+		writeAttribute("in_tex_coords", VertexAttributeDef::FLOAT2, file);
+	}
+
+
+	// generated LODs are additional meshes sharing the vertices of their source mesh
+	void writeMeshes(Lumix::FS::OsFile& file)
+	{
+		Lumix::int32 mesh_count = m_filtered_meshes.size() * (1 + m_generated_lod_count);
 		file.write((const char*)&mesh_count, sizeof(mesh_count));
 		Lumix::int32 attribute_array_offset = 0;
 		Lumix::int32 indices_offset = 0;
 		for (auto* mesh : m_filtered_meshes)
 		{
-			int vertex_size = getVertexSize(mesh);
-			aiString material_name;
-			scene->mMaterials[mesh->mMaterialIndex]->Get(AI_MATKEY_NAME, material_name);
-			Lumix::int32 length = Lumix::stringLength(material_name.C_Str());
-			file.write((const char*)&length, sizeof(length));
-			file.write((const char*)material_name.C_Str(), length);
-
-			file.write((const char*)&attribute_array_offset, sizeof(attribute_array_offset));
-			Lumix::int32 attribute_array_size = mesh->mNumVertices * vertex_size;
-			attribute_array_offset += attribute_array_size;
-			file.write((const char*)&attribute_array_size, sizeof(attribute_array_size));
-
-			file.write((const char*)&indices_offset, sizeof(indices_offset));
-			Lumix::int32 mesh_tri_count = mesh->mNumFaces;
+			writeMesh(file,
+				mesh,
+				attribute_array_offset,
+				indices_offset,
+				mesh->mNumFaces,
+				getMeshName(mesh).C_Str());
+			attribute_array_offset += mesh->mNumVertices * getVertexSize(mesh);
 			indices_offset += mesh->mNumFaces * 3;
-			file.write((const char*)&mesh_tri_count, sizeof(mesh_tri_count));
+		}
+
+		for (int lod = 1; lod <= m_generated_lod_count; ++lod)
+		{
+			attribute_array_offset = 0;
+			for (int i = 0; i < m_filtered_meshes.size(); ++i)
+			{
+				auto* mesh = m_filtered_meshes[i];
+				auto& indices = getGeneratedLOD(lod, i);
+				StringBuilder<256> name(getMeshName(mesh).C_Str(), "_LOD", lod);
+				writeMesh(
+					file, mesh, attribute_array_offset, indices_offset, indices.size() / 3, name);
+				attribute_array_offset += mesh->mNumVertices * getVertexSize(mesh);
+				indices_offset += indices.size();
+			}
+		}
+	}
 
-			aiString mesh_name = getMeshName(mesh);
-			length = Lumix::stringLength(mesh_name.C_Str());
 
-			file.write((const char*)&length, sizeof(length));
-			file.write((const char*)mesh_name.C_Str(), length);
+	Lumix::Array<Lumix::int32>& getGeneratedLOD(int lod, int mesh_index)
+	{
+		return m_generated_lods[(lod - 1) * m_filtered_meshes.size() + mesh_index];
+	}
 
-			Lumix::int32 attribute_count = getAttributeCount(mesh);
-			file.write((const char*)&attribute_count, sizeof(attribute_count));
 
-			if (isSkinned(mesh))
+	const Lumix::Array<Lumix::int32>& getGeneratedLOD(int lod, int mesh_index) const
+	{
+		return m_generated_lods[(lod - 1) * m_filtered_meshes.size() + mesh_index];
+	}
+
+
+	void generateLODs()
+	{
+		m_generated_lods.clear();
+		m_generated_lod_count = 0;
+		if (!m_dialog.m_generate_lods) return;
+		for (auto* mesh : m_filtered_meshes)
+		{
+			if (getMeshLOD(&mesh) >= 0) return;
+		}
+
+		m_dialog.setImportMessage("Generating LODs...", -1);
+		auto& allocator = m_dialog.m_editor.getAllocator();
+		Lumix::Array<Lumix::int32> indices(allocator);
+		m_generated_lod_count = m_dialog.m_generated_lod_count;
+		for (int lod = 1; lod <= m_generated_lod_count; ++lod)
+		{
+			for (auto* mesh : m_filtered_meshes)
 			{
-				writeAttribute("in_weights", VertexAttributeDef::FLOAT4, file);
-				writeAttribute("in_indices", VertexAttributeDef::SHORT4, file);
+				indices.clear();
+				for (unsigned int j = 0; j < mesh->mNumFaces; ++j)
+				{
+					for (int k = 0; k < 3; ++k) indices.push(mesh->mFaces[j].mIndices[k]);
+				}
+				int target = int(indices.size() / 3 * m_dialog.m_lod_ratios[lod - 1]) * 3;
+				auto& lod_indices = m_generated_lods.emplace(allocator);
+				simplifyMesh((const Lumix::Vec3*)mesh->mVertices,
+					mesh->mNumVertices,
+					&indices[0],
+					indices.size(),
+					target,
+					lod_indices,
+					allocator);
 			}
-
-			writeAttribute("in_position", VertexAttributeDef::POSITION, file);
-			if (mesh->mColors[0]) writeAttribute("in_colors", VertexAttributeDef::BYTE4, file);
-			writeAttribute("in_normal", VertexAttributeDef::BYTE4, file);
-			if (mesh->mTangents) writeAttribute("in_tangents", VertexAttributeDef::BYTE4, file);
-			writeAttribute("in_tex_coords", VertexAttributeDef::FLOAT2, file);
 		}
 	}
 
@@ -1310,7 +1670,24 @@ struct ConvertTask : public Lumix::MT::Task
 			lod_count = Lumix::Math::maxValue(lod_count, lod + 1);
 		}
 
-		if (lods[0] < 0)
+		if (m_generated_lod_count > 0)
+		{
+			lod_count = 1 + m_generated_lod_count;
+			file.write((const char*)&lod_count, sizeof(lod_count));
+			for (int i = 0; i < lod_count; ++i)
+			{
+				Lumix::int32 to_mesh = (i + 1) * m_filtered_meshes.size() - 1;
+				file.write((const char*)&to_mesh, sizeof(to_mesh));
+				// models compare squared distances
+				float distance = FLT_MAX;
+				if (i < lod_count - 1)
+				{
+					distance = m_dialog.m_lod_distances[i] * m_dialog.m_lod_distances[i];
+				}
+				file.write((const char*)&distance, sizeof(distance));
+			}
+		}
+		else if (lods[0] < 0)
 		{
 			lod_count = 1;
 			file.write((const char*)&lod_count, sizeof(lod_count));
@@ -1680,6 +2057,7 @@ struct ConvertTask : public Lumix::MT::Task
 
 		filterMeshes();
 		gatherNodes();
+		generateLODs();
 
 		writeModelHeader(file);
 		writeMeshes(file);
@@ -1692,9 +2070,13 @@ struct ConvertTask : public Lumix::MT::Task
 	}
 
 	Lumix::Array<aiMesh*> m_filtered_meshes;
+	// indices of generated LODs, for each LOD one array per filtered mesh
+	Lumix::Array<Lumix::Array<Lumix::int32>> m_generated_lods;
+	int m_generated_lod_count;
 	ImportAssetDialog& m_dialog;
 	Lumix::Array<aiNode*> m_nodes;
 	float m_scale;
+	DDSBatch m_dds_batch;
 
 }; // struct ConvertTask
 
@@ -1714,12 +2096,21 @@ ImportAssetDialog::ImportAssetDialog(Lumix::WorldEditor& editor, Metadata& metad
 	, m_saved_textures(editor.getAllocator())
 	, m_saved_embedded_textures(editor.getAllocator())
 	, m_path_mapping(editor.getAllocator())
+	, m_texture_cache(editor.getAllocator())
 	, m_mesh_mask(editor.getAllocator())
 	, m_convert_to_dds(false)
 	, m_convert_to_raw(false)
 	, m_raw_texture_scale(1)
 	, m_mesh_scale(1)
+	, m_generate_lods(false)
+	, m_generated_lod_count(2)
 {
+	static_assert(MAX_GENERATED_LODS == Lumix::Model::MAX_LOD_COUNT - 1, "Wrong LOD count");
+	for (int i = 0; i < MAX_GENERATED_LODS; ++i)
+	{
+		m_lod_ratios[i] = 1.0f / (2 << i);
+		m_lod_distances[i] = 20.0f * (i + 1);
+	}
 	m_orientation = Y_UP;
 	m_is_opened = false;
 	m_message[0] = '\0';
@@ -1729,6 +2120,10 @@ ImportAssetDialog::ImportAssetDialog(Lumix::WorldEditor& editor, Metadata& metad
 	m_output_dir[0] = '\0';
 	m_texture_output_dir[0] = '\0';
 	Lumix::copyString(m_last_dir, m_editor.getEngine().getDiskFileDevice()->getBasePath(0));
+	m_dds_convert_callback.dialog = this;
+	m_dds_convert_callback.dest_path = nullptr;
+	m_dds_convert_callback.cancel_requested = false;
+	loadTextureCache();
 }
 
 
@@ -1875,6 +2270,72 @@ void ImportAssetDialog::checkSource()
 }
 
 
+void ImportAssetDialog::loadTextureCache()
+{
+	Lumix::FS::OsFile file;
+	auto& allocator = m_editor.getAllocator();
+	if (!file.open(TEXTURE_CACHE_FILENAME, Lumix::FS::Mode::OPEN_AND_READ, allocator)) return;
+
+	int count = 0;
+	file.read(&count, sizeof(count));
+	for (int i = 0; i < count; ++i)
+	{
+		Lumix::uint32 dest_hash;
+		Lumix::uint32 source_hash;
+		if (!file.read(&dest_hash, sizeof(dest_hash))) break;
+		if (!file.read(&source_hash, sizeof(source_hash))) break;
+		m_texture_cache.insert(dest_hash, source_hash);
+	}
+	file.close();
+}
+
+
+void ImportAssetDialog::saveTextureCache()
+{
+	Lumix::FS::OsFile file;
+	auto& allocator = m_editor.getAllocator();
+	auto mode = Lumix::FS::Mode::CREATE | Lumix::FS::Mode::WRITE;
+	if (!file.open(TEXTURE_CACHE_FILENAME, mode, allocator))
+	{
+		Lumix::g_log_warning.log("Editor") << "Could not save " << TEXTURE_CACHE_FILENAME;
+		return;
+	}
+
+	int count = m_texture_cache.size();
+	file.write(&count, sizeof(count));
+	for (int i = 0; i < count; ++i)
+	{
+		Lumix::uint32 dest_hash = m_texture_cache.getKey(i);
+		file.write(&dest_hash, sizeof(dest_hash));
+		file.write(&m_texture_cache.at(i), sizeof(m_texture_cache.at(i)));
+	}
+	file.close();
+}
+
+
+bool ImportAssetDialog::isTextureUpToDate(const char* dest, Lumix::uint32 source_hash) const
+{
+	int index = m_texture_cache.find(Lumix::crc32(dest));
+	if (index < 0 || m_texture_cache.at(index) != source_hash) return false;
+	return PlatformInterface::fileExists(dest);
+}
+
+
+void ImportAssetDialog::setTextureHash(const char* dest, Lumix::uint32 source_hash)
+{
+	Lumix::uint32 dest_hash = Lumix::crc32(dest);
+	int index = m_texture_cache.find(dest_hash);
+	if (index < 0)
+	{
+		m_texture_cache.insert(dest_hash, source_hash);
+	}
+	else
+	{
+		m_texture_cache.at(index) = source_hash;
+	}
+}
+
+
 void ImportAssetDialog::setMessage(const char* message)
 {
 	Lumix::MT::SpinLock lock(m_mutex);
@@ -1910,6 +2371,7 @@ void ImportAssetDialog::convert()
 	if (!checkTextures()) return;
 
 	setImportMessage("Converting...", -1);
+	m_dds_convert_callback.cancel_requested = false;
 	m_is_converting = true;
 	m_task = LUMIX_NEW(m_editor.getAllocator(), ConvertTask)(*this, m_mesh_scale);
 	m_task->create("ConvertAssetTask");
@@ -1937,6 +2399,7 @@ void ImportAssetDialog::importTexture()
 
 	m_metadata.setString(hash, Lumix::crc32("source"), m_source);
 
+	m_dds_convert_callback.cancel_requested = false;
 	m_is_importing_texture = true;
 	m_task = LUMIX_NEW(m_editor.getAllocator(), ImportTextureTask)(*this);
 	m_task->create("ImportTextureTask");
@@ -1977,7 +2440,7 @@ void ImportAssetDialog::onGUI()
 		{
 			if (ImGui::Button("Cancel"))
 			{
-				if (m_is_importing_texture)
+				if (m_is_importing_texture || m_is_converting)
 				{
 					m_dds_convert_callback.cancel_requested = true;
 				}
@@ -2065,6 +2528,20 @@ void ImportAssetDialog::onGUI()
 				ImGui::Indent();
 				ImGui::DragFloat("Scale", &m_mesh_scale, 0.01f, 0.001f, 0);
 				ImGui::Combo("Orientation", &(int&)m_orientation, "Y up\0Z up\0-Z up\0");
+				ImGui::Checkbox("Generate LODs", &m_generate_lods);
+				if (m_generate_lods)
+				{
+					ImGui::SliderInt("LOD count", &m_generated_lod_count, 1, MAX_GENERATED_LODS);
+					for (int i = 0; i < m_generated_lod_count; ++i)
+					{
+						ImGui::PushID(i);
+						ImGui::Text("LOD %d", i + 1);
+						ImGui::SameLine();
+						ImGui::DragFloat("Triangles", &m_lod_ratios[i], 0.01f, 0.01f, 1.0f);
+						ImGui::DragFloat("From distance", &m_lod_distances[i], 1.0f, 0.0f, FLT_MAX);
+						ImGui::PopID();
+					}
+				}
 				ImGui::Unindent();
 			}
 
@@ -31,6 +31,7 @@ class LUMIX_EDITOR_API ImportAssetDialog
 	friend struct ImportTask;
 	friend struct ConvertTask;
 	friend struct ImportTextureTask;
+	friend struct DDSBatch;
 	public:
 		enum Orientation : int
 		{
@@ -46,6 +47,9 @@ class LUMIX_EDITOR_API ImportAssetDialog
 			bool cancel_requested;
 		};
 
+		// LOD0 is the imported mesh, models can have up to four LODs
+		static const int MAX_GENERATED_LODS = 3;
+
 	public:
 		ImportAssetDialog(Lumix::WorldEditor& editor, Metadata& metadata);
 		~ImportAssetDialog();
@@ -67,6 +71,11 @@ class LUMIX_EDITOR_API ImportAssetDialog
 		bool checkTexture(const char* source_dir, const char* path, const char* message);
 		void importTexture();
 		bool isTextureDirValid() const;
+		// crc32 of the sources of converted textures, by crc32 of their destination paths
+		void loadTextureCache();
+		void saveTextureCache();
+		bool isTextureUpToDate(const char* dest, Lumix::uint32 source_hash) const;
+		void setTextureHash(const char* dest, Lumix::uint32 source_hash);
 
 	private:
 		Lumix::WorldEditor& m_editor;
@@ -74,6 +83,7 @@ class LUMIX_EDITOR_API ImportAssetDialog
 		Lumix::Array<Lumix::string> m_saved_embedded_textures;
 		Assimp::Importer m_importer;
 		Lumix::AssociativeArray<Lumix::string, Lumix::string> m_path_mapping;
+		Lumix::AssociativeArray<Lumix::uint32, Lumix::uint32> m_texture_cache;
 		Lumix::BinaryArray m_mesh_mask;
 		char m_import_message[1024];
 		float m_progress_fraction;
@@ -97,6 +107,11 @@ class LUMIX_EDITOR_API ImportAssetDialog
 		bool m_is_importing_texture;
 		float m_raw_texture_scale;
 		float m_mesh_scale;
+		// used only for models without authored LODs
+		bool m_generate_lods;
+		int m_generated_lod_count;
+		float m_lod_ratios[MAX_GENERATED_LODS];
+		float m_lod_distances[MAX_GENERATED_LODS];
 		Orientation m_orientation;
 		Lumix::MT::Task* m_task;
 		Lumix::MT::SpinMutex m_mutex;
@@ -0,0 +1,297 @@
+#include "mesh_simplifier.h"
+#include "core/array.h"
+#include "core/vec.h"
+#include <cstdlib>
+
+
+namespace
+{
+
+
+struct Quadric
+{
+	float a2, ab, ac, ad;
+	float b2, bc, bd;
+	float c2, cd;
+	float d2;
+
+
+	void add(const Quadric& rhs)
+	{
+		a2 += rhs.a2; ab += rhs.ab; ac += rhs.ac; ad += rhs.ad;
+		b2 += rhs.b2; bc += rhs.bc; bd += rhs.bd;
+		c2 += rhs.c2; cd += rhs.cd;
+		d2 += rhs.d2;
+	}
+
+
+	void addPlane(const Lumix::Vec3& n, float d, float weight)
+	{
+		a2 += weight * n.x * n.x; ab += weight * n.x * n.y; ac += weight * n.x * n.z;
+		ad += weight * n.x * d;
+		b2 += weight * n.y * n.y; bc += weight * n.y * n.z; bd += weight * n.y * d;
+		c2 += weight * n.z * n.z; cd += weight * n.z * d;
+		d2 += weight * d * d;
+	}
+
+
+	float getError(const Lumix::Vec3& p) const
+	{
+		return a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z + 2 * ad * p.x +
+			   b2 * p.y * p.y + 2 * bc * p.y * p.z + 2 * bd * p.y + c2 * p.z * p.z +
+			   2 * cd * p.z + d2;
+	}
+};
+
+
+struct Collapse
+{
+	Lumix::int32 from;
+	Lumix::int32 to;
+	float error;
+};
+
+
+struct SortedVertex
+{
+	Lumix::Vec3 position;
+	Lumix::int32 index;
+};
+
+
+static int compareCollapses(const void* a, const void* b)
+{
+	float error_a = static_cast<const Collapse*>(a)->error;
+	float error_b = static_cast<const Collapse*>(b)->error;
+	return error_a < error_b ? -1 : (error_a > error_b ? 1 : 0);
+}
+
+
+static int compareVertices(const void* a, const void* b)
+{
+	const Lumix::Vec3& pa = static_cast<const SortedVertex*>(a)->position;
+	const Lumix::Vec3& pb = static_cast<const SortedVertex*>(b)->position;
+	if (pa.x != pb.x) return pa.x < pb.x ? -1 : 1;
+	if (pa.y != pb.y) return pa.y < pb.y ? -1 : 1;
+	if (pa.z != pb.z) return pa.z < pb.z ? -1 : 1;
+	return 0;
+}
+
+
+static int compareEdges(const void* a, const void* b)
+{
+	Lumix::uint64 edge_a = *static_cast<const Lumix::uint64*>(a);
+	Lumix::uint64 edge_b = *static_cast<const Lumix::uint64*>(b);
+	return edge_a < edge_b ? -1 : (edge_a > edge_b ? 1 : 0);
+}
+
+
+static void lockSeamsAndBorders(const Lumix::Vec3* positions,
+	int vertex_count,
+	const Lumix::Array<Lumix::int32>& indices,
+	Lumix::Array<bool>& is_locked,
+	Lumix::IAllocator& allocator)
+{
+	Lumix::Array<SortedVertex> sorted(allocator);
+	sorted.resize(vertex_count);
+	for (int i = 0; i < vertex_count; ++i) sorted[i] = {positions[i], i};
+	if (vertex_count > 0) qsort(&sorted[0], vertex_count, sizeof(sorted[0]), compareVertices);
+	for (int i = 1; i < vertex_count; ++i)
+	{
+		if (compareVertices(&sorted[i - 1], &sorted[i]) != 0) continue;
+		is_locked[sorted[i - 1].index] = true;
+		is_locked[sorted[i].index] = true;
+	}
+
+	// edges used by only one triangle are on a border
+	Lumix::Array<Lumix::uint64> edges(allocator);
+	edges.reserve(indices.size());
+	for (int i = 0; i < indices.size(); i += 3)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			Lumix::uint64 a = indices[i + j];
+			Lumix::uint64 b = indices[i + (j + 1) % 3];
+			edges.push(a < b ? (a << 32) | b : (b << 32) | a);
+		}
+	}
+	if (edges.empty()) return;
+	qsort(&edges[0], edges.size(), sizeof(edges[0]), compareEdges);
+	for (int i = 0; i < edges.size();)
+	{
+		int j = i + 1;
+		while (j < edges.size() && edges[j] == edges[i]) ++j;
+		if (j - i == 1)
+		{
+			is_locked[int(edges[i] >> 32)] = true;
+			is_locked[int(edges[i] & 0xffffFFFF)] = true;
+		}
+		i = j;
+	}
+}
+
+
+static Lumix::Vec3 getNormal(const Lumix::Vec3& a, const Lumix::Vec3& b, const Lumix::Vec3& c)
+{
+	return crossProduct(b - a, c - a);
+}
+
+
+// collapsing an edge must not turn any of the remaining triangles around
+static bool isCollapseValid(const Lumix::Vec3* positions,
+	const Lumix::Array<Lumix::int32>& indices,
+	const Lumix::int32* triangles,
+	int triangle_count,
+	int from,
+	int to)
+{
+	for (int i = 0; i < triangle_count; ++i)
+	{
+		const Lumix::int32* tri = &indices[triangles[i] * 3];
+		if (tri[0] == to || tri[1] == to || tri[2] == to) continue;
+
+		Lumix::Vec3 moved[3];
+		for (int j = 0; j < 3; ++j) moved[j] = positions[tri[j] == from ? to : tri[j]];
+		Lumix::Vec3 old_normal = getNormal(positions[tri[0]], positions[tri[1]], positions[tri[2]]);
+		Lumix::Vec3 new_normal = getNormal(moved[0], moved[1], moved[2]);
+		if (dotProduct(old_normal, new_normal) <= 0) return false;
+	}
+	return true;
+}
+
+
+static int countSharedTriangles(const Lumix::Array<Lumix::int32>& indices,
+	const Lumix::int32* triangles,
+	int triangle_count,
+	int vertex)
+{
+	int count = 0;
+	for (int i = 0; i < triangle_count; ++i)
+	{
+		const Lumix::int32* tri = &indices[triangles[i] * 3];
+		if (tri[0] == vertex || tri[1] == vertex || tri[2] == vertex) ++count;
+	}
+	return count;
+}
+
+
+} // anonymous namespace
+
+
+void simplifyMesh(const Lumix::Vec3* positions,
+	int vertex_count,
+	const Lumix::int32* src_indices,
+	int index_count,
+	int target_index_count,
+	Lumix::Array<Lumix::int32>& out,
+	Lumix::IAllocator& allocator)
+{
+	out.clear();
+	for (int i = 0; i < index_count; ++i) out.push(src_indices[i]);
+	if (index_count <= target_index_count) return;
+
+	Lumix::Array<bool> is_locked(allocator);
+	is_locked.resize(vertex_count);
+	for (auto& locked : is_locked) locked = false;
+	lockSeamsAndBorders(positions, vertex_count, out, is_locked, allocator);
+
+	Lumix::Array<Quadric> quadrics(allocator);
+	quadrics.resize(vertex_count);
+	for (auto& quadric : quadrics) quadric = {};
+	for (int i = 0; i < out.size(); i += 3)
+	{
+		const Lumix::Vec3& p0 = positions[out[i]];
+		Lumix::Vec3 normal = getNormal(p0, positions[out[i + 1]], positions[out[i + 2]]);
+		float length = normal.length();
+		if (length == 0) continue;
+
+		normal *= 1 / length;
+		// weighted by area, so small triangles do not hold big flat areas in place
+		float weight = length * 0.5f;
+		for (int j = 0; j < 3; ++j)
+		{
+			quadrics[out[i + j]].addPlane(normal, -dotProduct(normal, p0), weight);
+		}
+	}
+
+	Lumix::Array<Collapse> collapses(allocator);
+	Lumix::Array<Lumix::int32> remap(allocator);
+	Lumix::Array<bool> is_touched(allocator);
+	Lumix::Array<Lumix::int32> triangle_offsets(allocator);
+	Lumix::Array<Lumix::int32> vertex_triangles(allocator);
+	remap.resize(vertex_count);
+	is_touched.resize(vertex_count);
+	triangle_offsets.resize(vertex_count + 1);
+	while (out.size() > target_index_count)
+	{
+		collapses.clear();
+		for (int i = 0; i < out.size(); i += 3)
+		{
+			for (int j = 0; j < 3; ++j)
+			{
+				int a = out[i + j];
+				int b = out[i + (j + 1) % 3];
+				Quadric q = quadrics[a];
+				q.add(quadrics[b]);
+				if (!is_locked[a]) collapses.push({a, b, q.getError(positions[b])});
+				if (!is_locked[b]) collapses.push({b, a, q.getError(positions[a])});
+			}
+		}
+		if (collapses.empty()) break;
+		qsort(&collapses[0], collapses.size(), sizeof(collapses[0]), compareCollapses);
+
+		// triangles of each vertex, vertex_triangles[triangle_offsets[v]..triangle_offsets[v+1]]
+		for (auto& offset : triangle_offsets) offset = 0;
+		for (int index : out) ++triangle_offsets[index + 1];
+		for (int i = 0; i < vertex_count; ++i) triangle_offsets[i + 1] += triangle_offsets[i];
+		vertex_triangles.resize(out.size());
+		for (int i = 0; i < vertex_count; ++i) remap[i] = triangle_offsets[i];
+		for (int i = 0; i < out.size(); ++i) vertex_triangles[remap[out[i]]++] = i / 3;
+
+		for (int i = 0; i < vertex_count; ++i)
+		{
+			remap[i] = i;
+			is_touched[i] = false;
+		}
+
+		int removed_triangles = 0;
+		int triangles_to_remove = (out.size() - target_index_count + 2) / 3;
+		for (const Collapse& collapse : collapses)
+		{
+			if (removed_triangles >= triangles_to_remove) break;
+			if (is_touched[collapse.from] || is_touched[collapse.to]) continue;
+
+			const Lumix::int32* triangles = &vertex_triangles[triangle_offsets[collapse.from]];
+			int triangle_count =
+				triangle_offsets[collapse.from + 1] - triangle_offsets[collapse.from];
+			if (!isCollapseValid(
+					positions, out, triangles, triangle_count, collapse.from, collapse.to))
+			{
+				continue;
+			}
+
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to].add(quadrics[collapse.from]);
+			removed_triangles += countSharedTriangles(out, triangles, triangle_count, collapse.to);
+			// the triangles around changed, their vertices wait for the next pass
+			for (int i = 0; i < triangle_count; ++i)
+			{
+				for (int j = 0; j < 3; ++j) is_touched[out[triangles[i] * 3 + j]] = true;
+			}
+		}
+		if (removed_triangles == 0) break;
+
+		int size = 0;
+		for (int i = 0; i < out.size(); i += 3)
+		{
+			int a = remap[out[i]];
+			int b = remap[out[i + 1]];
+			int c = remap[out[i + 2]];
+			if (a == b || b == c || a == c) continue;
+			out[size++] = a;
+			out[size++] = b;
+			out[size++] = c;
+		}
+		out.resize(size);
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+
+#include "lumix.h"
+
+
+namespace Lumix
+{
+	class IAllocator;
+	template <typename T> class Array;
+	struct Vec3;
+}
+
+
+// Quadric error edge collapse. Vertices are only collapsed onto other vertices, so the simplified
+// indices can use the vertex buffer of the source mesh. Vertices on open borders and vertices
+// sharing their position with others (uv or normal seams) are never removed, so the mesh does not
+// tear, but it can stop short of target_index_count.
+void simplifyMesh(const Lumix::Vec3* positions,
+	int vertex_count,
+	const Lumix::int32* indices,
+	int index_count,
+	int target_index_count,
+	Lumix::Array<Lumix::int32>& out,
+	Lumix::IAllocator& allocator);
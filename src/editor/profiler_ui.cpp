@@ -1,4 +1,6 @@
 #include "profiler_ui.h"
+#include "core/fs/cache_file_device.h"
+#include "core/fs/compressed_file_device.h"
 #include "core/fs/file_events_device.h"
 #include "core/fs/file_system.h"
 #include "core/fs/os_file.h"
@@ -6,19 +8,24 @@
 #include "core/math_utils.h"
 #include "core/mt/atomic.h"
 #include "core/mt/lock_free_fixed_queue.h"
+#include "core/mt/sync.h"
+#include "core/network.h"
 #include "core/profiler.h"
 #include "core/resource.h"
 #include "core/resource_manager.h"
 #include "core/resource_manager_base.h"
 #include "core/timer.h"
+#include "core/tracking_allocator.h"
 #include "debug/debug.h"
 #include "engine/engine.h"
 #include "imgui/imgui.h"
+#include "platform_interface.h"
 #include "utils.h"
 #include <cstdlib>
 
 
 static const int MAX_FRAMES = 200;
+static const int HITCH_CAPTURED_FRAMES = 10;
 
 
 enum Column
@@ -43,8 +50,10 @@ struct ProfilerUIImpl : public ProfilerUI
 		, m_resource_manager(engine.getResourceManager())
 		, m_logs(allocator)
 		, m_opened_files(allocator)
+		, m_opened_files_mutex(false)
 		, m_device(allocator)
 		, m_engine(engine)
+		, m_trace_connector(m_allocator)
 	{
 		m_viewed_thread_id = 0;
 		m_allocation_size_from = 0;
@@ -59,6 +68,7 @@ struct ProfilerUIImpl : public ProfilerUI
 		m_allocation_root->m_stack_node = nullptr;
 		m_filter[0] = 0;
 		m_resource_filter[0] = 0;
+		m_allocation_source[0] = 0;
 
 		m_timer = Lumix::Timer::create(engine.getAllocator());
 		m_device.OnEvent.bind<ProfilerUIImpl, &ProfilerUIImpl::onFileSystemEvent>(this);
@@ -82,11 +92,17 @@ struct ProfilerUIImpl : public ProfilerUI
 		m_current_transfer_rate = 0;
 		m_bytes_read = 0;
 		m_next_transfer_rate_time = 0;
+		m_trace_stream = nullptr;
+		Lumix::copyString(m_trace_ip, "127.0.0.1");
+		m_trace_port = 9000;
+		m_is_capturing_hitches = false;
+		m_hitch_threshold = 100;
 	}
 
 
 	~ProfilerUIImpl()
 	{
+		stopTraceStream();
 		while (m_engine.getFileSystem().hasWork())
 		{
 			m_engine.getFileSystem().updateAsyncTransactions();
@@ -116,6 +132,8 @@ struct ProfilerUIImpl : public ProfilerUI
 
 	void onFileSystemEvent(const Lumix::FS::Event& event)
 	{
+		// events come from all IO workers
+		Lumix::MT::SpinLock lock(m_opened_files_mutex);
 		if (event.type == Lumix::FS::EventType::OPEN_BEGIN)
 		{
 			auto& file = m_opened_files.emplace();
@@ -241,6 +259,47 @@ struct ProfilerUIImpl : public ProfilerUI
 			FLT_MAX,
 			ImVec2(0, 100));
 
+		const auto& stats = m_engine.getFileSystem().getAsyncStats();
+		ImGui::Text("Pending: %d, in progress: %d, completed backlog: %d",
+			stats.pending_count,
+			stats.in_progress_count,
+			stats.completed_backlog);
+		ImGui::Text("Callbacks: %d in %.2f ms", stats.callbacks_count, stats.callbacks_time * 1000.0f);
+		float budget = m_engine.getFileSystem().getCallbacksTimeBudget();
+		if (ImGui::DragFloat("Callbacks budget (ms)", &budget, 0.1f, 0, FLT_MAX))
+		{
+			m_engine.getFileSystem().setCallbacksTimeBudget(Lumix::Math::maxValue(0.0f, budget));
+		}
+		auto* compressed_device = m_engine.getCompressedFileDevice();
+		if (compressed_device)
+		{
+			auto compressed_stats = compressed_device->getStats();
+			float ratio = compressed_stats.compressed_bytes > 0
+				? float(compressed_stats.decompressed_bytes) / compressed_stats.compressed_bytes
+				: 0;
+			float throughput = compressed_stats.decompression_time > 0
+				? compressed_stats.decompressed_bytes / compressed_stats.decompression_time / (1024 * 1024)
+				: 0;
+			ImGui::Text("Compressed files: %d, ratio: %.2f, decompression: %.1f MB/s",
+				compressed_stats.file_count,
+				ratio,
+				throughput);
+			ImGui::SameLine();
+			if (ImGui::Button("Reset")) compressed_device->resetStats();
+		}
+		auto* cache_device = m_engine.getCacheFileDevice();
+		if (cache_device)
+		{
+			auto cache_stats = cache_device->getStats();
+			ImGui::Text("Cache hits: %d, misses: %d, cached files: %d (%.1f MB)",
+				cache_stats.hit_count,
+				cache_stats.miss_count,
+				cache_stats.file_count,
+				cache_stats.cached_bytes / (1024.0f * 1024.0f));
+			ImGui::SameLine();
+			if (ImGui::Button("Reset###reset_cache_stats")) cache_device->resetStats();
+		}
+
 		ImGui::InputText("filter###fs_filter", m_filter, Lumix::lengthOf(m_filter));
 
 		if (ImGui::Button("Clear")) m_logs.clear();
@@ -377,7 +436,6 @@ struct ProfilerUIImpl : public ProfilerUI
 	{
 		explicit AllocationStackNode(Lumix::IAllocator& allocator)
 			: m_children(allocator)
-			, m_allocations(allocator)
 		{
 		}
 
@@ -403,17 +461,19 @@ struct ProfilerUIImpl : public ProfilerUI
 		bool m_opened;
 		Lumix::Debug::StackNode* m_stack_node;
 		Lumix::Array<AllocationStackNode*> m_children;
-		Lumix::Array<Lumix::Debug::Allocator::AllocationInfo*> m_allocations;
 	};
 
 
 	void onGUICPUProfiler();
+	void onGUITrace();
+	void stopTraceStream();
 	void onGUIMemoryProfiler();
+	void onGUISubsystemsMemory();
 	void onGUIResources();
 	void onFrame();
 	void showProfileBlock(Block* block, int column);
 	void cloneBlock(Block* my_block, Lumix::Profiler::Block* remote_block);
-	void addToTree(Lumix::Debug::Allocator::AllocationInfo* info);
+	void addToTree(Lumix::Debug::StackNode* stack_leaf, size_t size);
 	void refreshAllocations();
 	void showAllocationTree(AllocationStackNode* node, int column);
 	AllocationStackNode* getOrCreate(AllocationStackNode* my_node,
@@ -433,7 +493,9 @@ struct ProfilerUIImpl : public ProfilerUI
 	bool m_is_paused;
 	char m_filter[100];
 	char m_resource_filter[100];
+	char m_allocation_source[32]; // tag of a tracking allocator, empty for the main allocator
 	Lumix::Array<OpenedFile> m_opened_files;
+	Lumix::MT::SpinMutex m_opened_files_mutex;
 	Lumix::MT::LockFreeFixedQueue<Log, 512> m_queue;
 	Lumix::Array<Log> m_logs;
 	Lumix::FS::FileEventsDevice m_device;
@@ -444,6 +506,12 @@ struct ProfilerUIImpl : public ProfilerUI
 	volatile int m_bytes_read;
 	float m_next_transfer_rate_time;
 	SortOrder m_sort_order;
+	Lumix::Net::TCPConnector m_trace_connector;
+	Lumix::Net::TCPStream* m_trace_stream;
+	char m_trace_ip[32];
+	int m_trace_port;
+	bool m_is_capturing_hitches;
+	float m_hitch_threshold;
 };
 
 
@@ -461,6 +529,9 @@ void ProfilerUIImpl::cloneBlock(Block* my_block, Lumix::Profiler::Block* remote_
 		case Lumix::Profiler::BlockType::INT:
 			my_block->m_int_values.push(Lumix::Profiler::getBlockInt(remote_block));
 			break;
+		case Lumix::Profiler::BlockType::FLOAT:
+			my_block->m_frames.push(Lumix::Profiler::getBlockFloat(remote_block));
+			break;
 		default:
 			ASSERT(false);
 			break;
@@ -608,6 +679,19 @@ void ProfilerUIImpl::showProfileBlock(Block* block, int column)
 						}
 					}
 					break;
+					case Lumix::Profiler::BlockType::FLOAT:
+					{
+						float value = m_current_frame < 0 ? block->m_frames.back()
+														  : block->m_frames[m_current_frame];
+						if (ImGui::Selectable(
+							StringBuilder<50>("") << value << "###f" << (Lumix::int64)block,
+							m_current_block == block,
+							ImGuiSelectableFlags_SpanAllColumns))
+						{
+							m_current_block = block;
+						}
+					}
+					break;
 					default:
 						ASSERT(false);
 						break;
@@ -794,17 +878,16 @@ ProfilerUIImpl::AllocationStackNode* ProfilerUIImpl::getOrCreate(AllocationStack
 }
 
 
-void ProfilerUIImpl::addToTree(Lumix::Debug::Allocator::AllocationInfo* info)
+void ProfilerUIImpl::addToTree(Lumix::Debug::StackNode* stack_leaf, size_t size)
 {
 	Lumix::Debug::StackNode* nodes[1024];
-	int count = Lumix::Debug::StackTree::getPath(info->m_stack_leaf, nodes, Lumix::lengthOf(nodes));
+	int count = Lumix::Debug::StackTree::getPath(stack_leaf, nodes, Lumix::lengthOf(nodes));
 
 	auto node = m_allocation_root;
 	for (int i = count - 1; i >= 0; --i)
 	{
-		node = getOrCreate(node, nodes[i], info->m_size);
+		node = getOrCreate(node, nodes[i], size);
 	}
-	node->m_allocations.push(info);
 }
 
 
@@ -815,18 +898,117 @@ void ProfilerUIImpl::refreshAllocations()
 	m_allocation_root = LUMIX_NEW(m_allocator, AllocationStackNode)(m_allocator);
 	m_allocation_root->m_stack_node = nullptr;
 
+	if (m_allocation_source[0])
+	{
+		Lumix::TrackingAllocator::lockList();
+		Lumix::TrackingAllocator* allocator = Lumix::TrackingAllocator::getFirst();
+		while (allocator && Lumix::compareString(allocator->getTag(), m_allocation_source) != 0)
+		{
+			allocator = allocator->getNext();
+		}
+		if (allocator)
+		{
+			allocator->lock();
+			const auto& infos = allocator->getAllocationInfos();
+			for (auto iter = infos.begin(), end = infos.end(); iter != end; ++iter)
+			{
+				addToTree(iter.value().stack_leaf, iter.value().size);
+			}
+			allocator->unlock();
+		}
+		Lumix::TrackingAllocator::unlockList();
+		return;
+	}
+
 	m_main_allocator.lock();
 	auto* current_info = m_main_allocator.getFirstAllocationInfo();
 
 	while (current_info)
 	{
-		addToTree(current_info);
+		addToTree(current_info->m_stack_leaf, current_info->m_size);
 		current_info = current_info->m_next;
 	}
 	m_main_allocator.unlock();
 }
 
 
+void ProfilerUIImpl::onGUISubsystemsMemory()
+{
+	static const float MB = 1024 * 1024;
+
+	ImGui::Columns(5, "memsubsystems");
+	ImGui::Text("Subsystem");
+	ImGui::NextColumn();
+	ImGui::Text("Current / peak");
+	ImGui::NextColumn();
+	ImGui::Text("Budget (MB)");
+	ImGui::NextColumn();
+	ImGui::Text("Allocations per frame");
+	ImGui::NextColumn();
+	ImGui::Text("Callstacks");
+	ImGui::NextColumn();
+	ImGui::Separator();
+
+	bool refresh = false;
+	Lumix::TrackingAllocator::lockList();
+	for (auto* allocator = Lumix::TrackingAllocator::getFirst(); allocator;
+		 allocator = allocator->getNext())
+	{
+		Lumix::AllocatorStats stats;
+		allocator->getStats(stats);
+		size_t budget = allocator->getBudget();
+		bool is_over_budget = budget > 0 && stats.live_bytes > budget;
+		ImGui::PushID(allocator);
+		if (is_over_budget)
+		{
+			ImGui::TextColored(ImVec4(1, 0, 0, 1), "%s", allocator->getTag());
+		}
+		else
+		{
+			ImGui::Text("%s", allocator->getTag());
+		}
+		ImGui::NextColumn();
+		ImGui::Text("%.3fMB / %.3fMB", stats.live_bytes / MB, allocator->getPeakSize() / MB);
+		ImGui::NextColumn();
+		int budget_mb = int(budget / (1024 * 1024));
+		if (ImGui::InputInt("##budget", &budget_mb))
+		{
+			allocator->setBudget(size_t(Lumix::Math::maxValue(budget_mb, 0)) * 1024 * 1024);
+		}
+		ImGui::NextColumn();
+		ImGui::Text("%u", allocator->getFrameAllocationCount());
+		ImGui::NextColumn();
+		bool is_source = Lumix::compareString(m_allocation_source, allocator->getTag()) == 0;
+		bool callstacks = allocator->areCallstacksEnabled();
+		if (ImGui::Checkbox("##callstacks", &callstacks))
+		{
+			// the tree points to the allocator's callstacks, they are gone when disabled
+			if (!callstacks && is_source)
+			{
+				m_allocation_source[0] = 0;
+				refresh = true;
+			}
+			allocator->enableCallstacks(callstacks);
+		}
+		if (callstacks)
+		{
+			ImGui::SameLine();
+			if (ImGui::Button("Show"))
+			{
+				Lumix::copyString(m_allocation_source, allocator->getTag());
+				refresh = true;
+			}
+		}
+		ImGui::NextColumn();
+		ImGui::PopID();
+	}
+	Lumix::TrackingAllocator::unlockList();
+	ImGui::Columns(1);
+
+	if (refresh) refreshAllocations();
+}
+
+
 void ProfilerUIImpl::showAllocationTree(AllocationStackNode* node, int column)
 {
 	if (column == FUNCTION)
@@ -888,10 +1070,23 @@ void ProfilerUIImpl::onGUIMemoryProfiler()
 {
 	if (!ImGui::CollapsingHeader("Memory")) return;
 
+	onGUISubsystemsMemory();
+
 	if (ImGui::Button("Refresh"))
 	{
 		refreshAllocations();
 	}
+	if (m_allocation_source[0])
+	{
+		ImGui::SameLine();
+		ImGui::Text("Showing %s", m_allocation_source);
+		ImGui::SameLine();
+		if (ImGui::Button("Show all"))
+		{
+			m_allocation_source[0] = 0;
+			refreshAllocations();
+		}
+	}
 
 	ImGui::SameLine();
 	if (ImGui::Button("Check memory"))
@@ -914,6 +1109,68 @@ void ProfilerUIImpl::onGUIMemoryProfiler()
 }
 
 
+void ProfilerUIImpl::stopTraceStream()
+{
+	if (!m_trace_stream) return;
+
+	Lumix::Profiler::setTraceStream(nullptr);
+	m_trace_connector.close(m_trace_stream);
+	m_trace_stream = nullptr;
+}
+
+
+void ProfilerUIImpl::onGUITrace()
+{
+	bool changed = ImGui::Checkbox("Capture hitches", &m_is_capturing_hitches);
+	ImGui::SameLine();
+	ImGui::PushItemWidth(100);
+	changed = ImGui::InputFloat("Threshold [ms]", &m_hitch_threshold) || changed;
+	ImGui::PopItemWidth();
+	if (changed)
+	{
+		float threshold = m_is_capturing_hitches ? m_hitch_threshold : 0;
+		Lumix::Profiler::setHitchCapture(threshold, HITCH_CAPTURED_FRAMES, "");
+	}
+
+	if (ImGui::Button("Save trace"))
+	{
+		char path[Lumix::MAX_PATH_LENGTH];
+		if (PlatformInterface::getSaveFilename(path, sizeof(path), "Trace\0*.json\0", "json"))
+		{
+			Lumix::Profiler::saveTrace(path);
+		}
+	}
+
+	if (m_trace_stream)
+	{
+		ImGui::SameLine();
+		if (ImGui::Button("Stop streaming")) stopTraceStream();
+		return;
+	}
+
+	ImGui::SameLine();
+	if (ImGui::Button("Stream trace"))
+	{
+		m_trace_stream = m_trace_connector.connect(m_trace_ip, (Lumix::uint16)m_trace_port);
+		if (m_trace_stream)
+		{
+			Lumix::Profiler::setTraceStream(m_trace_stream);
+		}
+		else
+		{
+			Lumix::g_log_error.log("Editor") << "Failed to connect to " << m_trace_ip << ":"
+											 << m_trace_port;
+		}
+	}
+	ImGui::SameLine();
+	ImGui::PushItemWidth(100);
+	ImGui::InputText("##trace_ip", m_trace_ip, sizeof(m_trace_ip));
+	ImGui::SameLine();
+	ImGui::InputInt("Port##trace_port", &m_trace_port);
+	ImGui::PopItemWidth();
+}
+
+
 void ProfilerUIImpl::onGUICPUProfiler()
 {
 	if (!ImGui::CollapsingHeader("CPU")) return;
@@ -941,6 +1198,8 @@ void ProfilerUIImpl::onGUICPUProfiler()
 		m_current_frame = -1;
 	}
 
+	onGUITrace();
+
 	if (!m_root) return;
 
 	ImGui::Columns(3, "cpuc");
@@ -954,8 +1213,11 @@ void ProfilerUIImpl::onGUICPUProfiler()
 
 	auto* block = m_current_block ? m_current_block : m_root;
 	float width = ImGui::GetWindowContentRegionWidth();
-	int count = Lumix::Math::minValue(int(width / 5), block->m_int_values.size());
-	int offset = block->m_int_values.size() - count;
+	int frames_count = block->m_type == Lumix::Profiler::BlockType::FLOAT
+		? block->m_frames.size()
+		: block->m_int_values.size();
+	int count = Lumix::Math::minValue(int(width / 5), frames_count);
+	int offset = frames_count - count;
 	struct PlotData
 	{
 		Block* block;
@@ -967,6 +1229,7 @@ void ProfilerUIImpl::onGUICPUProfiler()
 		switch (plot_data->block->m_type)
 		{
 			case Lumix::Profiler::BlockType::TIME:
+			case Lumix::Profiler::BlockType::FLOAT:
 				return plot_data->block->m_frames[plot_data->offset + idx];
 			case Lumix::Profiler::BlockType::INT:
 				return (float)plot_data->block->m_int_values[plot_data->offset + idx];
@@ -210,33 +210,10 @@ void PropertyGrid::showEntityProperty(Lumix::ComponentUID cmp, int index, Lumix:
 {
 	Lumix::OutputBlob blob(m_editor.getAllocator());
 	desc.get(cmp, index, blob);
-	int value = *(int*)blob.getData();
-	auto& universe = cmp.scene->getUniverse();
-	int count = universe.getEntityCount();
+	Lumix::Entity value = *(Lumix::Entity*)blob.getData();
 
-	struct Data
-	{
-		Lumix::IPropertyDescriptor* descriptor;
-		Lumix::IScene* scene;
-		Lumix::WorldEditor* editor;
-	};
-
-	auto getter = [](void* data, int index, const char** out) -> bool {
-		auto* combo_data = static_cast<Data*>(data);
-		static char buf[128];
-		Lumix::Entity entity = combo_data->scene->getUniverse().getEntityFromDenseIdx(index);
-		getEntityListDisplayName(*combo_data->editor, buf, Lumix::lengthOf(buf), entity);
-		*out = buf;
-
-		return true;
-	};
-
-	Data data;
-	data.scene = cmp.scene;
-	data.descriptor = &desc;
-	data.editor = &m_editor;
-
-	if(ImGui::Combo(desc.getName(), &value, getter, &data, count))
+	// the popup list of entityInput builds only the visible rows, a combo would build all of them
+	if (entityInput(desc.getName(), StringBuilder<20>("", (Lumix::uint64)&desc), value))
 	{
 		m_editor.setProperty(cmp.type, index, desc, &value, sizeof(value));
 	}
@@ -553,27 +530,36 @@ void PropertyGrid::showCoreProperties(Lumix::Entity entity)
 void PropertyGrid::onGUI()
 {
 	auto& ents = m_editor.getSelectedEntities();
-	if (ImGui::BeginDock("Properties", &m_is_opened) && ents.size() == 1)
+	if (ImGui::BeginDock("Properties", &m_is_opened) && !ents.empty())
 	{
-		if (ImGui::Button("Add component"))
+		// properties of the first selected entity are shown, edits are applied to all the selected
+		// entities with the same component
+		if (ents.size() == 1)
 		{
-			ImGui::OpenPopup("AddComponentPopup");
-		}
-		if (ImGui::BeginPopup("AddComponentPopup"))
-		{
-			for (int i = 0; i < Lumix::PropertyRegister::getComponentTypesCount(); ++i)
+			if (ImGui::Button("Add component"))
+			{
+				ImGui::OpenPopup("AddComponentPopup");
+			}
+			if (ImGui::BeginPopup("AddComponentPopup"))
 			{
-				if (ImGui::Selectable(Lumix::PropertyRegister::getComponentTypeName(i)))
+				for (int i = 0; i < Lumix::PropertyRegister::getComponentTypesCount(); ++i)
 				{
-					m_editor.addComponent(
-						Lumix::crc32(Lumix::PropertyRegister::getComponentTypeID(i)));
-					break;
+					if (ImGui::Selectable(Lumix::PropertyRegister::getComponentTypeName(i)))
+					{
+						m_editor.addComponent(
+							Lumix::crc32(Lumix::PropertyRegister::getComponentTypeID(i)));
+						break;
+					}
 				}
+				ImGui::EndPopup();
 			}
-			ImGui::EndPopup();
-		}
 
-		showCoreProperties(ents[0]);
+			showCoreProperties(ents[0]);
+		}
+		else
+		{
+			ImGui::Text("%d entities selected", ents.size());
+		}
 
 		auto& cmps = m_editor.getComponents(ents[0]);
 		for (auto cmp : cmps)
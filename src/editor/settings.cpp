@@ -1,12 +1,12 @@
 #include "settings.h"
 #include "core/fs/os_file.h"
 #include "core/log.h"
+#include "core/lua_compat.h"
 #include "debug/debug.h"
 #include "imgui/imgui.h"
 #include "platform_interface.h"
 #include "utils.h"
 #include <cstdio>
-#include <lua.hpp>
 
 
 static const char SETTINGS_PATH[] = "studio.ini";
@@ -5,8 +5,10 @@
 #include "core/command_line_parser.h"
 #include "core/crc32.h"
 #include "core/default_allocator.h"
+#include "core/fs/disk_file_device.h"
 #include "core/fs/file_system.h"
 #include "core/fs/os_file.h"
+#include "core/fs/pack_file_device.h"
 #include "core/input_system.h"
 #include "core/log.h"
 #include "core/lua_wrapper.h"
@@ -16,14 +18,17 @@
 #include "core/quat.h"
 #include "core/resource_manager.h"
 #include "core/system.h"
+#include "core/thread_caching_allocator.h"
 #include "core/timer.h"
 #include "debug/debug.h"
 #include "editor/gizmo.h"
 #include "editor/entity_groups.h"
+#include "editor/entity_list.h"
 #include "editor/entity_template_system.h"
 #include "editor/world_editor.h"
 #include "engine.h"
 #include "engine/plugin_manager.h"
+#include "engine/universe/world_streamer.h"
 #include "import_asset_dialog.h"
 #include "log_ui.h"
 #include "metadata.h"
@@ -43,7 +48,11 @@ class StudioAppImpl : public StudioApp
 {
 public:
 	StudioAppImpl()
-		: m_is_entity_list_opened(true)
+		: m_thread_caching_allocator(m_main_allocator)
+		, m_allocator(checkAllocatorCommandLine()
+						  ? (Lumix::IAllocator&)m_thread_caching_allocator
+						  : (Lumix::IAllocator&)m_main_allocator)
+		, m_is_entity_list_opened(true)
 		, m_finished(false)
 		, m_import_asset_dialog(nullptr)
 		, m_is_entity_template_list_opened(false)
@@ -51,12 +60,14 @@ public:
 		, m_profiler_ui(nullptr)
 		, m_asset_browser(nullptr)
 		, m_property_grid(nullptr)
+		, m_entity_list(nullptr)
 		, m_actions(m_allocator)
 		, m_metadata(m_allocator)
 		, m_is_welcome_screen_opened(true)
 		, m_editor(nullptr)
 		, m_settings(m_allocator)
 		, m_plugins(m_allocator)
+		, m_cookers(m_allocator)
 	{
 		m_exit_code = 0;
 		g_app = this;
@@ -474,6 +485,25 @@ public:
 	}
 
 
+	void saveStreamingCells()
+	{
+		static const float CELL_SIZE = 64;
+		char dir[Lumix::MAX_PATH_LENGTH];
+		auto* base_path = m_engine->getDiskFileDevice()->getBasePath(0);
+		if (!PlatformInterface::getOpenDirectory(dir, Lumix::lengthOf(dir), base_path)) return;
+		auto& entities = m_editor->getSelectedEntities();
+		if (!Lumix::WorldStreamer::saveCells(*m_engine,
+				*m_editor->getUniverse(),
+				&entities[0],
+				entities.size(),
+				dir,
+				CELL_SIZE))
+		{
+			Lumix::g_log_error.log("Editor") << "Failed to save streaming cells to " << dir;
+		}
+	}
+
+
 	template <void (StudioAppImpl::*func)()>
 	void addAction(const char* label, const char* name)
 	{
@@ -606,6 +636,13 @@ public:
 				doMenuItem(getAction("autosnapDown"), m_editor->getGizmo().isAutosnapDown(), true);
 				if (ImGui::MenuItem("Save commands")) saveUndoStack();
 				if (ImGui::MenuItem("Load commands")) loadAndExecuteCommands();
+				if (ImGui::MenuItem("Save selection as streaming cells",
+						nullptr,
+						nullptr,
+						is_any_entity_selected))
+				{
+					saveStreamingCells();
+				}
 
 				ImGui::MenuItem("Import asset", nullptr, &m_import_asset_dialog->m_is_opened);
 				ImGui::EndMenu();
@@ -701,6 +738,13 @@ public:
 		{
 			auto* universe = m_editor->getUniverse();
 
+			if (ImGui::TreeNode("All entities"))
+			{
+				m_entity_list->onGUI();
+				ImGui::TreePop();
+			}
+			ImGui::Separator();
+
 			auto& groups = m_editor->getEntityGroups();
 			static char group_name[20] = "";
 			ImGui::InputText("New group name", group_name, Lumix::lengthOf(group_name));
@@ -854,6 +898,7 @@ public:
 		ProfilerUI::destroy(*m_profiler_ui);
 		LUMIX_DELETE(m_allocator, m_asset_browser);
 		LUMIX_DELETE(m_allocator, m_property_grid);
+		LUMIX_DELETE(m_allocator, m_entity_list);
 		LUMIX_DELETE(m_allocator, m_import_asset_dialog);
 		LUMIX_DELETE(m_allocator, m_log_ui);
 		Lumix::WorldEditor::destroy(m_editor, m_allocator);
@@ -983,6 +1028,20 @@ public:
 	}
 
 
+	static bool checkAllocatorCommandLine()
+	{
+		char cmd_line[2048];
+		Lumix::getCommandLine(cmd_line, Lumix::lengthOf(cmd_line));
+
+		Lumix::CommandLineParser parser(cmd_line);
+		while (parser.next())
+		{
+			if (parser.currentEquals("-thread_caching_allocator")) return true;
+		}
+		return false;
+	}
+
+
 	static void checkDataDirCommandLine(char* dir, int max_size)
 	{
 		char cmd_line[2048];
@@ -1016,6 +1075,14 @@ public:
 	}
 
 
+	void registerCooker(const char* extension, Cooker cooker) override
+	{
+		auto& entry = m_cookers.emplace();
+		Lumix::copyString(entry.extension, extension);
+		entry.cooker = cooker;
+	}
+
+
 	void setStudioApp()
 	{
 		auto& plugin_manager = m_editor->getEngine().getPluginManager();
@@ -1128,8 +1195,102 @@ public:
 	}
 
 
+	void collectPackFiles(const char* dir, int base_length, Lumix::Array<Lumix::Path>& paths)
+	{
+		auto* iter = PlatformInterface::createFileIterator(dir, m_allocator);
+		PlatformInterface::FileInfo info;
+		while (getNextFile(iter, &info))
+		{
+			if (info.filename[0] == '.') continue;
+
+			char child_path[Lumix::MAX_PATH_LENGTH];
+			Lumix::copyString(child_path, dir);
+			Lumix::catString(child_path, "/");
+			Lumix::catString(child_path, info.filename);
+			if (info.is_directory)
+			{
+				collectPackFiles(child_path, base_length, paths);
+			}
+			else
+			{
+				char ext[10];
+				Lumix::PathUtils::getExtension(ext, sizeof(ext), info.filename);
+				if (Lumix::compareString(ext, "pak") == 0) continue;
+
+				Lumix::Path path(child_path + base_length);
+				if (paths.indexOf(path) < 0) paths.push(path);
+			}
+		}
+		destroyFileIterator(iter);
+	}
+
+
+	struct PackCooker : public Lumix::FS::PackFileDevice::ICooker
+	{
+		explicit PackCooker(StudioAppImpl& _app) : app(_app) {}
+
+		bool cook(const char* path, const void* data, int size, Lumix::OutputBlob& out) override
+		{
+			char ext[10];
+			Lumix::PathUtils::getExtension(ext, sizeof(ext), path);
+			for (const auto& entry : app.m_cookers)
+			{
+				if (Lumix::compareString(entry.extension, ext) != 0) continue;
+				return entry.cooker(path, data, size, out, app.m_allocator);
+			}
+			return false;
+		}
+
+		StudioAppImpl& app;
+	};
+
+
+	// -pack <archive> packs all files from the data directory, except other archives, and exits,
+	// -pack_compressed <archive> does the same but compresses the files which get smaller,
+	// files with a registered cooker are stored converted, e.g. materials as binaries
+	void checkPackCommandLine()
+	{
+		char command_line[1024];
+		Lumix::getCommandLine(command_line, Lumix::lengthOf(command_line));
+		Lumix::CommandLineParser parser(command_line);
+		while (parser.next())
+		{
+			bool compress = parser.currentEquals("-pack_compressed");
+			if (!compress && !parser.currentEquals("-pack")) continue;
+			if (!parser.next()) break;
+
+			char archive_path[Lumix::MAX_PATH_LENGTH];
+			parser.getCurrent(archive_path, Lumix::lengthOf(archive_path));
+			const char* base_path = m_engine->getDiskFileDevice()->getBasePath(0);
+			Lumix::Array<Lumix::Path> paths(m_allocator);
+			collectPackFiles(base_path, Lumix::stringLength(base_path), paths);
+
+			Lumix::Array<const char*> path_strings(m_allocator);
+			for (const Lumix::Path& path : paths)
+			{
+				path_strings.push(path.c_str());
+			}
+			PackCooker cooker(*this);
+			if (Lumix::FS::PackFileDevice::pack(archive_path,
+					base_path,
+					path_strings.empty() ? nullptr : &path_strings[0],
+					path_strings.size(),
+					compress,
+					m_allocator,
+					&cooker))
+			{
+				Lumix::g_log_info.log("Editor") << "Packed " << path_strings.size() << " files to "
+												<< archive_path;
+			}
+			m_finished = true;
+			break;
+		}
+	}
+
+
 	void run()
 	{
+		checkPackCommandLine();
 		checkScriptCommandLine();
 
 		Lumix::Timer* timer = Lumix::Timer::create(m_allocator);
@@ -1294,6 +1455,7 @@ public:
 
 		m_asset_browser = LUMIX_NEW(m_allocator, AssetBrowser)(*m_editor, m_metadata);
 		m_property_grid = LUMIX_NEW(m_allocator, PropertyGrid)(*m_editor, *m_asset_browser, m_actions);
+		m_entity_list = LUMIX_NEW(m_allocator, EntityList)(*m_editor);
 		auto engine_allocator = static_cast<Lumix::Debug::Allocator*>(&m_engine->getAllocator());
 		m_profiler_ui = ProfilerUI::create(*m_engine);
 		m_log_ui = LUMIX_NEW(m_allocator, LogUI)(m_editor->getAllocator());
@@ -1362,15 +1524,26 @@ public:
 	}
 
 
-	Lumix::DefaultAllocator m_allocator;
+	struct CookerEntry
+	{
+		char extension[10];
+		Cooker cooker;
+	};
+
+
+	Lumix::DefaultAllocator m_main_allocator;
+	Lumix::ThreadCachingAllocator m_thread_caching_allocator;
+	Lumix::IAllocator& m_allocator;
 	Lumix::Engine* m_engine;
 
 	float m_time_to_autosave;
 	Lumix::Array<Action*> m_actions;
 	Lumix::Array<IPlugin*> m_plugins;
+	Lumix::Array<CookerEntry> m_cookers;
 	Lumix::WorldEditor* m_editor;
 	AssetBrowser* m_asset_browser;
 	PropertyGrid* m_property_grid;
+	EntityList* m_entity_list;
 	LogUI* m_log_ui;
 	ProfilerUI* m_profiler_ui;
 	ImportAssetDialog* m_import_asset_dialog;
@@ -18,6 +18,8 @@
 
 namespace Lumix
 {
+class IAllocator;
+class OutputBlob;
 class WorldEditor;
 }
 
@@ -49,6 +51,14 @@ public:
 		const char* name;
 	};
 
+	// converts a file to the format stored in archives built by -pack, returns false if the file
+	// should be stored as it is
+	typedef bool (*Cooker)(const char* path,
+		const void* data,
+		int size,
+		Lumix::OutputBlob& out,
+		Lumix::IAllocator& allocator);
+
 public:
 	static StudioApp* create();
 	static void destroy(StudioApp& app);
@@ -59,6 +69,7 @@ public:
 	virtual Lumix::WorldEditor* getWorldEditor() = 0;
 	virtual void addPlugin(IPlugin& plugin) = 0;
 	virtual void removePlugin(IPlugin& plugin) = 0;
+	virtual void registerCooker(const char* extension, Cooker cooker) = 0;
 	virtual int getExitCode() const = 0;
 	virtual void runScript(const char* src, const char* script_name) = 0;
 	virtual Lumix::Array<Action*>& getActions() = 0;
@@ -12,10 +12,14 @@
 #include "core/fs/tcp_file_device.h"
 #include "core/fs/tcp_file_server.h"
 #include "core/fs/ifile.h"
+#include "core/fs/os_file.h"
 #include "core/input_system.h"
 #include "core/json_serializer.h"
 #include "core/log.h"
+#include "core/lz4.h"
 #include "core/matrix.h"
+#include "core/mt/task.h"
+#include "core/mt/thread.h"
 #include "core/path.h"
 #include "core/path_utils.h"
 #include "core/profiler.h"
@@ -40,6 +44,7 @@
 #include "renderer/ray_cast_model_hit.h"
 #include "renderer/render_scene.h"
 #include "universe/universe.h"
+#include <cfloat>
 
 
 namespace Lumix
@@ -48,6 +53,37 @@ namespace Lumix
 
 static const uint32 RENDERABLE_HASH = crc32("renderable");
 static const uint32 CAMERA_HASH = crc32("camera");
+// total IEditorCommand::getMemorySize of the undo stack
+static const int UNDO_STACK_BUDGET = 256 * 1024 * 1024;
+// commands closer than this to the top of the undo stack are not compacted
+static const int UNCOMPACTED_UNDO_COMMANDS = 16;
+
+
+// commands deep in the undo stack keep their data compressed, see IEditorCommand::compact
+static void compactBlob(OutputBlob& blob, bool& is_compacted, IAllocator& allocator)
+{
+	if (is_compacted) return;
+
+	Array<uint8> data(allocator);
+	blob.swap(data);
+	is_compacted = lz4CompressInPlace(data, allocator);
+	blob.swap(data);
+}
+
+
+static void expandBlob(OutputBlob& blob, bool& is_compacted, IAllocator& allocator)
+{
+	if (!is_compacted) return;
+
+	Array<uint8> data(allocator);
+	blob.swap(data);
+	if (!lz4DecompressInPlace(data, allocator))
+	{
+		g_log_error.log("Editor") << "Could not decompress undo data";
+	}
+	blob.swap(data);
+	is_compacted = false;
+}
 
 
 class BeginGroupCommand : public IEditorCommand
@@ -170,6 +206,7 @@ public:
 		: m_blob(editor.getAllocator())
 		, m_editor(editor)
 		, m_entities(editor.getAllocator())
+		, m_is_compacted(false)
 	{
 	}
 
@@ -179,15 +216,19 @@ public:
 		, m_editor(editor)
 		, m_position(editor.getCameraRaycastHit())
 		, m_entities(editor.getAllocator())
+		, m_is_compacted(false)
 	{
 	}
 
 
 	bool execute() override;
+	int getMemorySize() const override { return m_blob.getSize(); }
+	void compact() override { compactBlob(m_blob, m_is_compacted, m_editor.getAllocator()); }
 
 
 	void serialize(JsonSerializer& serializer)
 	{
+		expandBlob(m_blob, m_is_compacted, m_editor.getAllocator());
 		serializer.serialize("pos_x", m_position.x);
 		serializer.serialize("pos_y", m_position.y);
 		serializer.serialize("pos_z", m_position.z);
@@ -211,6 +252,7 @@ public:
 		serializer.deserialize("size", size, 0);
 		serializer.deserializeArrayBegin("data");
 		m_blob.clear();
+		m_is_compacted = false;
 		for (int i = 0; i < m_blob.getSize(); ++i)
 		{
 			int32 data;
@@ -254,6 +296,7 @@ private:
 	WorldEditor& m_editor;
 	Vec3 m_position;
 	Lumix::Array<Entity> m_entities;
+	bool m_is_compacted;
 };
 
 
@@ -594,6 +637,7 @@ public:
 	bool execute() override
 	{
 		m_descriptor->removeArrayItem(m_component, m_index);
+		m_editor.propertySet().invoke(m_component, *m_descriptor);
 		return true;
 	}
 
@@ -607,6 +651,7 @@ public:
 			m_descriptor->getChildren()[i]->set(
 				m_component, m_index, old_values);
 		}
+		m_editor.propertySet().invoke(m_component, *m_descriptor);
 	}
 
 
@@ -676,6 +721,7 @@ public:
 	{
 		m_descriptor->addArrayItem(m_component, -1);
 		m_index = m_descriptor->getCount(m_component) - 1;
+		m_editor.propertySet().invoke(m_component, *m_descriptor);
 		return true;
 	}
 
@@ -683,6 +729,7 @@ public:
 	void undo() override
 	{
 		m_descriptor->removeArrayItem(m_component, m_index);
+		m_editor.propertySet().invoke(m_component, *m_descriptor);
 	}
 
 
@@ -703,62 +750,58 @@ private:
 };
 
 
+// sets one value to the property of all the entities' components, it is a single undo step and
+// the resource the value refers to is loaded once for the whole batch
 class SetPropertyCommand : public IEditorCommand
 {
 public:
 	SetPropertyCommand(WorldEditor& editor)
 		: m_editor(editor)
+		, m_entities(editor.getAllocator())
 		, m_new_value(editor.getAllocator())
-		, m_old_value(editor.getAllocator())
-	{
-	}
-
-
-	SetPropertyCommand(WorldEditor& editor,
-					   Entity entity,
-					   uint32 component_type,
-					   const IPropertyDescriptor& property_descriptor,
-					   const void* data,
-					   int size)
-		: m_component_type(component_type)
-		, m_entity(entity)
-		, m_property_descriptor(&property_descriptor)
-		, m_editor(editor)
-		, m_new_value(editor.getAllocator())
-		, m_old_value(editor.getAllocator())
+		, m_old_values(editor.getAllocator())
+		, m_is_compacted(false)
+		, m_property_descriptor(nullptr)
 	{
-		m_index = -1;
-		m_new_value.write(data, size);
-		ComponentUID component = m_editor.getComponent(entity, component_type);
-		m_property_descriptor->get(component, -1, m_old_value);
 	}
 
 
 	SetPropertyCommand(WorldEditor& editor,
-					   Entity entity,
+					   const Entity* entities,
+					   int count,
 					   uint32 component_type,
 					   int index,
 					   const IPropertyDescriptor& property_descriptor,
 					   const void* data,
 					   int size)
 		: m_component_type(component_type)
-		, m_entity(entity)
+		, m_entities(editor.getAllocator())
 		, m_property_descriptor(&property_descriptor)
 		, m_editor(editor)
 		, m_new_value(editor.getAllocator())
-		, m_old_value(editor.getAllocator())
+		, m_old_values(editor.getAllocator())
+		, m_is_compacted(false)
 	{
 		m_index = index;
+		m_entities.resize(count);
+		for (int i = 0; i < count; ++i)
+		{
+			m_entities[i] = entities[i];
+		}
 		m_new_value.write(data, size);
-		ComponentUID component = m_editor.getComponent(entity, component_type);
-		m_property_descriptor->get(component, m_index, m_old_value);
+		storeOldValues();
 	}
 
 
 	void serialize(JsonSerializer& serializer) override
 	{
 		serializer.serialize("index", m_index);
-		serializer.serialize("entity_index", m_entity);
+		serializer.beginArray("entities");
+		for (int i = 0; i < m_entities.size(); ++i)
+		{
+			serializer.serializeArrayItem(m_entities[i]);
+		}
+		serializer.endArray();
 		serializer.serialize("component_type", m_component_type);
 		serializer.beginArray("data");
 		for (int i = 0; i < m_new_value.getSize(); ++i)
@@ -775,7 +818,15 @@ public:
 	void deserialize(JsonSerializer& serializer) override
 	{
 		serializer.deserialize("index", m_index, 0);
-		serializer.deserialize("entity_index", m_entity, 0);
+		serializer.deserializeArrayBegin("entities");
+		m_entities.clear();
+		while (!serializer.isArrayEnd())
+		{
+			Entity entity;
+			serializer.deserializeArrayItem(entity, 0);
+			m_entities.push(entity);
+		}
+		serializer.deserializeArrayEnd();
 		serializer.deserialize("component_type", m_component_type, 0);
 		serializer.deserializeArrayBegin("data");
 		m_new_value.clear();
@@ -790,24 +841,43 @@ public:
 		serializer.deserialize("property_name_hash", property_name_hash, 0);
 		m_property_descriptor =
 			PropertyRegister::getDescriptor(m_component_type, property_name_hash);
+		storeOldValues();
 	}
 
 
 	bool execute() override
 	{
+		ResourceManagerBase* manager = getBatchResourceManager();
+		Resource* resource = nullptr;
+		if (manager) resource = manager->load(Path((const char*)m_new_value.getData()));
 		InputBlob blob(m_new_value);
-		set(blob);
+		for (int i = 0; i < m_entities.size(); ++i)
+		{
+			set(m_entities[i], blob);
+		}
+		if (resource) manager->unload(*resource);
 		return true;
 	}
 
 
 	void undo() override
 	{
-		InputBlob blob(m_old_value);
-		set(blob);
+		expandBlob(m_old_values, m_is_compacted, m_editor.getAllocator());
+		InputBlob blob(m_old_values);
+		for (int i = 0; i < m_entities.size(); ++i)
+		{
+			int32 size;
+			blob.read(size);
+			InputBlob value(blob.skip(size), size);
+			set(m_entities[i], value);
+		}
 	}
 
 
+	int getMemorySize() const override { return m_old_values.getSize() + m_new_value.getSize(); }
+	void compact() override { compactBlob(m_old_values, m_is_compacted, m_editor.getAllocator()); }
+
+
 	uint32 getType() override
 	{
 		static const uint32 hash = crc32("set_property");
@@ -819,22 +889,26 @@ public:
 	{
 		ASSERT(command.getType() == getType());
 		SetPropertyCommand& src = static_cast<SetPropertyCommand&>(command);
-		if (m_component_type == src.m_component_type &&
-			m_entity == src.m_entity &&
-			src.m_property_descriptor == m_property_descriptor &&
-			m_index == src.m_index)
+		if (m_component_type != src.m_component_type ||
+			src.m_property_descriptor != m_property_descriptor ||
+			m_index != src.m_index ||
+			m_entities.size() != src.m_entities.size())
 		{
-			src.m_new_value = m_new_value;
-			return true;
+			return false;
 		}
-		return false;
+		for (int i = 0; i < m_entities.size(); ++i)
+		{
+			if (m_entities[i] != src.m_entities[i]) return false;
+		}
+		src.m_new_value = m_new_value;
+		return true;
 	}
 
 
-	void set(InputBlob& stream)
+	void set(Entity entity, InputBlob& stream)
 	{
-		ComponentUID component = m_editor.getComponent(m_entity, m_component_type);
-		uint32 template_hash = m_editor.getEntityTemplateSystem().getTemplate(m_entity);
+		ComponentUID component = m_editor.getComponent(entity, m_component_type);
+		uint32 template_hash = m_editor.getEntityTemplateSystem().getTemplate(entity);
 		if (template_hash)
 		{
 			const Array<Entity>& entities =
@@ -847,14 +921,7 @@ public:
 				{
 					if (cmps[j].type == m_component_type)
 					{
-						if (m_index >= 0)
-						{
-							m_property_descriptor->set(cmps[j], m_index, stream);
-						}
-						else
-						{
-							m_property_descriptor->set(cmps[j], -1, stream);
-						}
+						m_property_descriptor->set(cmps[j], m_index, stream);
 						break;
 					}
 				}
@@ -862,25 +929,53 @@ public:
 		}
 		else
 		{
-			if (m_index >= 0)
-			{
-				m_property_descriptor->set(component, m_index, stream);
-			}
-			else
-			{
-				m_property_descriptor->set(component, -1, stream);
-			}
+			stream.rewind();
+			m_property_descriptor->set(component, m_index, stream);
 		}
 		m_editor.propertySet().invoke(component, *m_property_descriptor);
 	}
 
 
 private:
+	void storeOldValues()
+	{
+		m_old_values.clear();
+		m_is_compacted = false;
+		if (!m_property_descriptor) return;
+
+		OutputBlob value(m_editor.getAllocator());
+		for (int i = 0; i < m_entities.size(); ++i)
+		{
+			value.clear();
+			ComponentUID component = m_editor.getComponent(m_entities[i], m_component_type);
+			m_property_descriptor->get(component, m_index, value);
+			m_old_values.write((int32)value.getSize());
+			m_old_values.write(value.getData(), value.getSize());
+		}
+	}
+
+
+	// the new resource is kept loaded while it is set to all the components, so it is not
+	// unloaded and loaded again when components release and acquire it
+	ResourceManagerBase* getBatchResourceManager()
+	{
+		if (m_entities.size() < 2) return nullptr;
+		if (m_property_descriptor->getType() != IPropertyDescriptor::RESOURCE) return nullptr;
+		if (m_new_value.getSize() < 2) return nullptr;
+
+		auto& resource_descriptor =
+			dynamic_cast<const ResourcePropertyDescriptorBase&>(*m_property_descriptor);
+		uint32 type = resource_descriptor.getResourceType();
+		return m_editor.getEngine().getResourceManager().get(type);
+	}
+
+
 	WorldEditor& m_editor;
 	uint32 m_component_type;
-	Entity m_entity;
+	Array<Entity> m_entities;
 	OutputBlob m_new_value;
-	OutputBlob m_old_value;
+	OutputBlob m_old_values;
+	bool m_is_compacted;
 	int m_index;
 	const IPropertyDescriptor* m_property_descriptor;
 };
@@ -1015,6 +1110,7 @@ private:
 			, m_entities(editor.getAllocator())
 			, m_positons_rotations(editor.getAllocator())
 			, m_old_values(editor.getAllocator())
+			, m_is_compacted(false)
 		{
 		}
 
@@ -1026,6 +1122,7 @@ private:
 			, m_entities(editor.getAllocator())
 			, m_positons_rotations(editor.getAllocator())
 			, m_old_values(editor.getAllocator())
+			, m_is_compacted(false)
 		{
 			m_entities.reserve(count);
 			m_positons_rotations.reserve(m_entities.size());
@@ -1096,6 +1193,7 @@ private:
 			Universe* universe = m_editor.getUniverse();
 			m_positons_rotations.clear();
 			m_old_values.clear();
+			m_is_compacted = false;
 			for (int i = 0; i < m_entities.size(); ++i)
 			{
 				const WorldEditor::ComponentList& cmps =
@@ -1124,10 +1222,18 @@ private:
 
 
 		bool merge(IEditorCommand&) override { return false; }
+		int getMemorySize() const override { return m_old_values.getSize(); }
+
+
+		void compact() override
+		{
+			compactBlob(m_old_values, m_is_compacted, m_editor.getAllocator());
+		}
 
 
 		void undo() override
 		{
+			expandBlob(m_old_values, m_is_compacted, m_editor.getAllocator());
 			Universe* universe = m_editor.getUniverse();
 			const Array<IScene*>& scenes = m_editor.getScenes();
 			InputBlob blob(m_old_values);
@@ -1186,6 +1292,7 @@ private:
 		Array<Entity> m_entities;
 		Array<PositionRotation> m_positons_rotations;
 		OutputBlob m_old_values;
+		bool m_is_compacted;
 	};
 
 
@@ -1510,6 +1617,7 @@ public:
 	{
 		PROFILE_FUNCTION();
 		updateGoTo();
+		if (m_save_task && !m_save_task->isRunning()) finishSave();
 
 		if (!m_selected_entities.empty())
 		{
@@ -1544,6 +1652,7 @@ public:
 		}
 		destroyUndoStack();
 
+		finishSave();
 		destroyUniverse();
 		EditorIcons::destroy(*m_editor_icons);
 		EntityTemplateSystem::destroy(m_template_system);
@@ -1631,9 +1740,9 @@ public:
 			if (camera_cmp.isValid())
 			{
 				RenderScene* scene = static_cast<RenderScene*>(camera_cmp.scene);
+				if (m_gizmo->isActive()) return;
 				scene->getRay(camera_cmp.index, (float)x, (float)y, origin, dir);
 				RayCastModelHit hit = scene->castRay(origin, dir, INVALID_COMPONENT);
-				if (m_gizmo->isActive()) return;
 
 				if(m_is_snap_mode && !m_selected_entities.empty() && hit.m_is_hit)
 				{
@@ -1744,41 +1853,106 @@ public:
 
 	void saveUniverse(const Path& path, bool save_path) override
 	{
+		PROFILE_FUNCTION();
 		g_log_info.log("Editor") << "saving universe " << path << "...";
-		FS::FileSystem& fs = m_engine->getFileSystem();
-		char bkp_path[MAX_PATH_LENGTH];
-		copyString(bkp_path, path.c_str());
-		catString(bkp_path, ".bkp");
-		copyFile(path.c_str(), bkp_path);
-		FS::IFile* file = fs.open(fs.getDefaultDevice(), path, FS::Mode::CREATE | FS::Mode::WRITE);
-		save(*file);
-		fs.close(*file);
+		finishSave();
+		m_save_task = LUMIX_NEW(m_allocator, SaveTask)(path, m_allocator);
+		save(m_save_task->m_blob);
+		m_save_task->create("Save universe");
+		m_save_task->run();
 		if (save_path) m_universe_path = path;
 	}
 
 
-	void save(FS::IFile& file)
+	// the universe is serialized into the blob, the hash in its header is not computed yet
+	void save(OutputBlob& blob)
 	{
 		ASSERT(m_universe);
 
-		OutputBlob blob(m_allocator);
 		blob.reserve(m_universe->getEntityCount() * 100);
 
 		Header header = {0xffffFFFF, (int)SerializedVersion::LATEST, 0, 0};
 		blob.write(header);
-		int hashed_offset = sizeof(header);
 
-		header.engine_hash = m_engine->serialize(*m_universe, blob);
+		header.engine_hash = m_engine->serialize(*m_universe, blob, m_serialization_cache);
 		m_template_system->serialize(blob);
 		m_entity_groups.serialize(blob);
-		header.hash = crc32((const uint8*)blob.getData() + hashed_offset, blob.getSize() - hashed_offset);
 		*(Header*)blob.getData() = header;
+	}
+
+
+	static void computeHash(OutputBlob& blob)
+	{
+		Header& header = *(Header*)blob.getData();
+		int hashed_offset = sizeof(header);
+		header.hash =
+			crc32((const uint8*)blob.getData() + hashed_offset, blob.getSize() - hashed_offset);
+	}
+
 
-		g_log_info.log("editor") << "Universe saved";
+	void save(FS::IFile& file)
+	{
+		OutputBlob blob(m_allocator);
+		save(blob);
+		computeHash(blob);
 		file.write(blob.getData(), blob.getSize());
 	}
 
 
+	// waits for the previous save, it must not overwrite the newer one
+	void finishSave()
+	{
+		if (!m_save_task) return;
+
+		m_save_task->destroy();
+		if (m_save_task->m_success)
+		{
+			g_log_info.log("Editor") << "Universe saved";
+		}
+		else
+		{
+			g_log_error.log("Editor") << "Failed to save " << m_save_task->m_path;
+		}
+		LUMIX_DELETE(m_allocator, m_save_task);
+		m_save_task = nullptr;
+	}
+
+
+	void markSceneDirty(IScene* scene) override { m_serialization_cache.markDirty(scene); }
+
+
+	void onPropertySet(ComponentUID cmp, const IPropertyDescriptor&)
+	{
+		m_serialization_cache.markDirty(cmp.scene);
+	}
+
+
+	// commands which change scenes only through components and properties are tracked by
+	// the universe and propertySet callbacks, anything else can change any scene
+	void markDirty(IEditorCommand& command)
+	{
+		static const uint32 TRACKED_COMMANDS[] = {crc32("begin_group"),
+			crc32("end_group"),
+			crc32("set_entity_name"),
+			crc32("paste_entity"),
+			crc32("move_entity"),
+			crc32("scale_entity"),
+			crc32("remove_array_property_item"),
+			crc32("add_array_property_item"),
+			crc32("set_property"),
+			crc32("add_component"),
+			crc32("destroy_entities"),
+			crc32("destroy_component"),
+			crc32("add_entity")};
+		uint32 type = command.getType();
+		for (uint32 tracked : TRACKED_COMMANDS)
+		{
+			if (tracked == type) return;
+		}
+		m_serialization_cache.markAllDirty();
+	}
+
+
 	void setRenderInterface(class RenderInterface* interface) override
 	{
 		m_render_interface = interface;
@@ -2023,17 +2197,67 @@ public:
 		cmd->group_type = m_current_group_type;
 		m_undo_stack.push(cmd);
 		++m_undo_index;
+		compactUndoStack();
+	}
+
+
+	// all but the last few commands are compacted, the oldest ones are dropped, groups as a whole,
+	// while the undo stack is over UNDO_STACK_BUDGET; the current command is always kept
+	void compactUndoStack()
+	{
+		int memory = 0;
+		for (int i = 0; i < m_undo_stack.size(); ++i)
+		{
+			if (i < m_undo_index - UNCOMPACTED_UNDO_COMMANDS) m_undo_stack[i]->compact();
+			memory += m_undo_stack[i]->getMemorySize();
+		}
+
+		static const uint32 begin_group_hash = crc32("begin_group");
+		static const uint32 end_group_hash = crc32("end_group");
+		int drop_count = 0;
+		while (memory > UNDO_STACK_BUDGET && drop_count < m_undo_index)
+		{
+			int last = drop_count;
+			if (m_undo_stack[last]->getType() == begin_group_hash)
+			{
+				while (last < m_undo_index && m_undo_stack[last]->getType() != end_group_hash)
+				{
+					++last;
+				}
+			}
+			if (last >= m_undo_index) break;
+
+			for (int i = drop_count; i <= last; ++i)
+			{
+				memory -= m_undo_stack[i]->getMemorySize();
+			}
+			drop_count = last + 1;
+		}
+		if (drop_count == 0) return;
+
+		for (int i = 0; i < drop_count; ++i)
+		{
+			LUMIX_DELETE(m_allocator, m_undo_stack[i]);
+		}
+		for (int i = drop_count; i < m_undo_stack.size(); ++i)
+		{
+			m_undo_stack[i - drop_count] = m_undo_stack[i];
+		}
+		m_undo_stack.resize(m_undo_stack.size() - drop_count);
+		m_undo_index -= drop_count;
 	}
 
 
 	void executeCommand(IEditorCommand* command) override
 	{
+		markDirty(*command);
 		if (m_undo_index >= 0 && command->getType() == m_undo_stack[m_undo_index]->getType())
 		{
 			if (command->merge(*m_undo_stack[m_undo_index]))
 			{
 				m_undo_stack[m_undo_index]->execute();
 				LUMIX_DELETE(m_allocator, command);
+				compactUndoStack();
 				return;
 			}
 		}
@@ -2050,6 +2274,7 @@ public:
 			}
 			m_undo_stack.push(command);
 			++m_undo_index;
+			compactUndoStack();
 		}
 		else
 		{
@@ -2350,9 +2575,48 @@ public:
 	#pragma pack()
 
 
+	// hashes and writes a snapshot of the universe, so the editor does not wait for the disk
+	class SaveTask : public MT::Task
+	{
+	public:
+		SaveTask(const Path& path, IAllocator& allocator)
+			: MT::Task(allocator)
+			, m_blob(allocator)
+			, m_path(path)
+			, m_success(false)
+		{
+		}
+
+
+		int task() override
+		{
+			char bkp_path[MAX_PATH_LENGTH];
+			copyString(bkp_path, m_path.c_str());
+			catString(bkp_path, ".bkp");
+			copyFile(m_path.c_str(), bkp_path);
+
+			computeHash(m_blob);
+			FS::OsFile file;
+			if (!file.open(m_path.c_str(), FS::Mode::CREATE | FS::Mode::WRITE, getAllocator()))
+			{
+				return -1;
+			}
+			m_success = file.write(m_blob.getData(), m_blob.getSize());
+			file.close();
+			return 0;
+		}
+
+
+		OutputBlob m_blob;
+		Path m_path;
+		bool m_success;
+	};
+
+
 	void load(FS::IFile& file)
 	{
 		m_is_loading = true;
+		m_serialization_cache.markAllDirty();
 		ASSERT(file.getBuffer());
 		m_components.clear();
 		m_components.reserve(5000);
@@ -2486,6 +2750,8 @@ public:
 		, m_universe_created(m_allocator)
 		, m_universe_loaded(m_allocator)
 		, m_property_set(m_allocator)
+		, m_serialization_cache(m_allocator)
+		, m_save_task(nullptr)
 		, m_selected_entities(m_allocator)
 		, m_editor_icons(nullptr)
 		, m_plugins(m_allocator)
@@ -2513,15 +2779,17 @@ public:
 		addPlugin(*m_measure_tool);
 
 		m_engine = &engine;
+		m_property_set.bind<WorldEditorImpl, &WorldEditorImpl::onPropertySet>(this);
 
 		const char* plugins[] = {"renderer", "animation", "audio", "physics", "lua_script"};
 
-		PluginManager& plugin_manager = m_engine->getPluginManager();
-		for (auto* plugin_name : plugins)
+		IPlugin* loaded[sizeof(plugins) / sizeof(plugins[0])];
+		m_engine->getPluginManager().load(plugins, lengthOf(plugins), loaded);
+		for (int i = 0; i < lengthOf(plugins); ++i)
 		{
-			if (!plugin_manager.load(plugin_name))
+			if (!loaded[i])
 			{
-				g_log_info.log("Editor") << plugin_name << " plugin has not been loaded";
+				g_log_info.log("Editor") << plugins[i] << " plugin has not been loaded";
 			}
 		}
 
@@ -2628,24 +2896,27 @@ public:
 		int size) override
 	{
 
-		ASSERT(m_selected_entities.size() == 1);
-		uint32 component_hash = component;
-		ComponentUID cmp = getComponent(m_selected_entities[0], component_hash);
-		if (cmp.isValid())
+		Array<Entity> entities(m_allocator);
+		entities.reserve(m_selected_entities.size());
+		static const uint32 SLOT_HASH = crc32("Slot");
+		for (Entity entity : m_selected_entities)
 		{
-			static const uint32 SLOT_HASH = crc32("Slot");
+			ComponentUID cmp = getComponent(entity, component);
+			if (!cmp.isValid()) continue;
 			if (component == CAMERA_HASH && property.getNameHash() == SLOT_HASH)
 			{
 				if (static_cast<RenderScene*>(cmp.scene)->getCameraEntity(cmp.index) == m_camera)
 				{
-					return;
+					continue;
 				}
 			}
-
-			IEditorCommand* command = LUMIX_NEW(m_allocator, SetPropertyCommand)(
-				*this, cmp.entity, cmp.type, index, property, data, size);
-			executeCommand(command);
+			entities.push(entity);
 		}
+		if (entities.empty()) return;
+
+		IEditorCommand* command = LUMIX_NEW(m_allocator, SetPropertyCommand)(
+			*this, &entities[0], entities.size(), component, index, property, data, size);
+		executeCommand(command);
 	}
 
 
@@ -2791,11 +3062,19 @@ public:
 	void onComponentAdded(const ComponentUID& cmp)
 	{
 		getComponents(cmp.entity).push(cmp);
+		m_serialization_cache.markDirty(cmp.scene);
 	}
 
 	void onComponentDestroyed(const ComponentUID& cmp)
 	{
 		getComponents(cmp.entity).eraseItemFast(cmp);
+		m_serialization_cache.markDirty(cmp.scene);
+	}
+
+	// transformations are serialized by the universe, only the hierarchy keeps local matrices
+	void onEntityTransformed(Entity)
+	{
+		m_serialization_cache.markDirty(m_universe->getScene(crc32("hierarchy")));
 	}
 
 	void onEntityDestroyed(Entity entity)
@@ -2812,6 +3091,7 @@ public:
 		m_entity_groups.setUniverse(nullptr);
 		ASSERT(m_universe);
 		destroyUndoStack();
+		m_serialization_cache.clear();
 		m_universe_destroyed.invoke();
 		m_editor_icons->clear();
 		m_components.clear();
@@ -2906,6 +3186,8 @@ public:
 			.bind<WorldEditorImpl, &WorldEditorImpl::onComponentDestroyed>(this);
 		universe->entityDestroyed().bind<WorldEditorImpl, &WorldEditorImpl::onEntityDestroyed>(
 			this);
+		universe->entityTransformed()
+			.bind<WorldEditorImpl, &WorldEditorImpl::onEntityTransformed>(this);
 
 		m_selected_entities.clear();
 		m_universe_created.invoke();
@@ -2947,6 +3229,7 @@ public:
 			--m_undo_index;
 			while(m_undo_stack[m_undo_index]->getType() != begin_group_hash)
 			{
+				markDirty(*m_undo_stack[m_undo_index]);
 				m_undo_stack[m_undo_index]->undo();
 				--m_undo_index;
 			}
@@ -2954,6 +3237,7 @@ public:
 		}
 		else
 		{
+			markDirty(*m_undo_stack[m_undo_index]);
 			m_undo_stack[m_undo_index]->undo();
 			--m_undo_index;
 		}
@@ -2973,12 +3257,14 @@ public:
 			++m_undo_index;
 			while(m_undo_stack[m_undo_index]->getType() != end_group_hash)
 			{
+				markDirty(*m_undo_stack[m_undo_index]);
 				m_undo_stack[m_undo_index]->execute();
 				++m_undo_index;
 			}
 		}
 		else
 		{
+			markDirty(*m_undo_stack[m_undo_index]);
 			m_undo_stack[m_undo_index]->execute();
 		}
 	}
@@ -3034,6 +3320,7 @@ public:
 			}
 			serializer.endArray();
 			serializer.endObject();
+			serializer.flush();
 			m_engine->getFileSystem().close(*file);
 		}
 		else
@@ -3153,12 +3440,24 @@ public:
 	}
 
 
+	void waitForResources()
+	{
+		auto& fs = m_engine->getFileSystem();
+		auto& resource_manager = m_engine->getResourceManager();
+		while (fs.hasWork() || resource_manager.isParsing())
+		{
+			fs.updateAsyncTransactions();
+			resource_manager.update(FLT_MAX);
+		}
+	}
+
+
 	bool runTest(const Path& undo_stack_path, const Path& result_universe_path) override
 	{
-		while (m_engine->getFileSystem().hasWork()) m_engine->getFileSystem().updateAsyncTransactions();
+		waitForResources();
 		newUniverse();
 		executeUndoStack(undo_stack_path);
-		while (m_engine->getFileSystem().hasWork()) m_engine->getFileSystem().updateAsyncTransactions();
+		waitForResources();
 
 		FS::IFile* file =
 			m_engine->getFileSystem().open(m_engine->getFileSystem().getMemoryDevice(),
@@ -3248,6 +3547,8 @@ private:
 	bool m_is_additive_selection;
 	bool m_is_snap_mode;
 	FS::IFile* m_game_mode_file;
+	SceneSerializationCache m_serialization_cache;
+	SaveTask* m_save_task;
 	Engine* m_engine;
 	Entity m_camera;
 	DelegateList<void()> m_universe_destroyed;
@@ -3290,6 +3591,7 @@ void WorldEditor::destroy(WorldEditor* editor, IAllocator& allocator)
 
 bool PasteEntityCommand::execute()
 {
+	expandBlob(m_blob, m_is_compacted, m_editor.getAllocator());
 	InputBlob blob(m_blob.getData(), m_blob.getSize());
 	Universe* universe = m_editor.getUniverse();
 	
@@ -90,7 +90,11 @@ public:
 	virtual void undo() = 0;
 	virtual void redo() = 0;
 	virtual void loadUniverse(const Path& path) = 0;
+	// the universe is written in the background, saves serialize only the scenes changed since
+	// the previous one
 	virtual void saveUniverse(const Path& path, bool save_path) = 0;
+	// for changes made outside of editor commands, so the next save serializes the scene again
+	virtual void markSceneDirty(IScene* scene) = 0;
 	virtual void newUniverse() = 0;
 	virtual Path getUniversePath() const = 0;
 	virtual void showEntities(const Entity* entities, int count) = 0;
@@ -122,6 +126,7 @@ public:
 	virtual void snapDown() = 0;
 	virtual void toggleGameMode() = 0;
 	virtual void navigate(float forward, float right, float speed) = 0;
+	// sets the property of all the selected entities with the component in a single command
 	virtual void setProperty(uint32 component,
 		int index,
 		IPropertyDescriptor& property,
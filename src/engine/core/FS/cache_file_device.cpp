@@ -0,0 +1,346 @@
+#include "core/fs/cache_file_device.h"
+#include "core/iallocator.h"
+#include "core/fs/ifile.h"
+#include "core/fs/ifile_system_defines.h"
+#include "core/log.h"
+#include "core/math_utils.h"
+#include "core/path.h"
+#include "core/string.h"
+
+
+namespace Lumix
+{
+	namespace FS
+	{
+		static const size_t DEFAULT_BUDGET = 32 * 1024 * 1024;
+
+
+		struct CacheFileDevice::Entry
+		{
+			uint32 path_hash;
+			uint8* data;
+			size_t size;
+			// files reading the entry and one more while it is cached
+			int ref_count;
+			bool is_cached;
+			Entry* prev;
+			Entry* next;
+		};
+
+
+		class CacheFile : public IFile
+		{
+		public:
+			CacheFile(IFile* file, CacheFileDevice& device)
+				: m_device(device)
+				, m_file(file)
+				, m_entry(nullptr)
+				, m_pos(0)
+			{
+			}
+
+			~CacheFile()
+			{
+				releaseEntry();
+				if (m_file) m_file->release();
+			}
+
+
+			IFileDevice& getDevice() override { return m_device; }
+
+
+			bool open(const Path& path, Mode mode) override
+			{
+				ASSERT(!m_entry);
+				if (mode & Mode::WRITE)
+				{
+					m_device.invalidate(path);
+					return m_file && m_file->open(path, mode);
+				}
+
+				m_pos = 0;
+				m_entry = m_device.acquire(path.getHash());
+				if (m_entry) return true;
+
+				if (!m_file || !m_file->open(path, mode)) return false;
+				size_t size = m_file->size();
+				if (!m_device.isCacheable(size)) return true;
+
+				m_entry = m_device.createEntry(path.getHash(), size);
+				const void* child_buffer = m_file->getBuffer();
+				if (child_buffer)
+				{
+					copyMemory(m_entry->data, child_buffer, size);
+				}
+				else if (!m_file->read(m_entry->data, size))
+				{
+					// the child serves the file as if there was no cache
+					g_log_warning.log("FS") << "Could not cache " << path.c_str();
+					releaseEntry();
+					m_file->seek(SeekMode::BEGIN, 0);
+					return true;
+				}
+
+				// the child is not needed anymore, everything is served from the entry
+				m_file->close();
+				m_device.insert(*m_entry);
+				return true;
+			}
+
+
+			void close() override
+			{
+				if (m_entry)
+				{
+					releaseEntry();
+					return;
+				}
+				if (m_file) m_file->close();
+			}
+
+
+			bool read(void* buffer, size_t size) override
+			{
+				if (!m_entry) return m_file->read(buffer, size);
+
+				size_t amount = m_pos + size < m_entry->size ? size : m_entry->size - m_pos;
+				copyMemory(buffer, m_entry->data + m_pos, amount);
+				m_pos += amount;
+				return amount == size;
+			}
+
+
+			bool write(const void* buffer, size_t size) override
+			{
+				if (m_entry) return false;
+				return m_file->write(buffer, size);
+			}
+
+
+			const void* getBuffer() const override
+			{
+				if (m_entry) return m_entry->data;
+				return m_file ? m_file->getBuffer() : nullptr;
+			}
+
+
+			size_t size() override
+			{
+				if (m_entry) return m_entry->size;
+				return m_file->size();
+			}
+
+
+			size_t seek(SeekMode base, size_t pos) override
+			{
+				if (!m_entry) return m_file->seek(base, pos);
+
+				switch (base)
+				{
+					case SeekMode::BEGIN: m_pos = pos; break;
+					case SeekMode::CURRENT: m_pos += pos; break;
+					case SeekMode::END: m_pos = m_entry->size - pos; break;
+					default: ASSERT(0); break;
+				}
+				m_pos = Math::minValue(m_pos, m_entry->size);
+				return m_pos;
+			}
+
+
+			size_t pos() override
+			{
+				if (m_entry) return m_pos;
+				return m_file->pos();
+			}
+
+		private:
+			void releaseEntry()
+			{
+				if (m_entry) m_device.release(*m_entry);
+				m_entry = nullptr;
+				m_pos = 0;
+			}
+
+		private:
+			CacheFileDevice& m_device;
+			IFile* m_file;
+			CacheFileDevice::Entry* m_entry;
+			size_t m_pos;
+		};
+
+
+		CacheFileDevice::CacheFileDevice(IAllocator& allocator)
+			: m_allocator(allocator)
+			, m_mutex(false)
+			, m_entries(allocator)
+			, m_first(nullptr)
+			, m_last(nullptr)
+			, m_budget(DEFAULT_BUDGET)
+			, m_cached_size(0)
+			, m_hit_count(0)
+			, m_miss_count(0)
+		{
+		}
+
+
+		CacheFileDevice::~CacheFileDevice()
+		{
+			clear();
+		}
+
+
+		IFile* CacheFileDevice::createFile(IFile* child)
+		{
+			return LUMIX_NEW(m_allocator, CacheFile)(child, *this);
+		}
+
+
+		void CacheFileDevice::destroyFile(IFile* file)
+		{
+			LUMIX_DELETE(m_allocator, file);
+		}
+
+
+		void CacheFileDevice::setBudget(size_t bytes)
+		{
+			MT::SpinLock lock(m_mutex);
+			m_budget = bytes;
+			evict();
+		}
+
+
+		void CacheFileDevice::invalidate(const Path& path)
+		{
+			MT::SpinLock lock(m_mutex);
+			auto iter = m_entries.find(path.getHash());
+			if (iter.isValid()) uncache(*iter.value());
+		}
+
+
+		void CacheFileDevice::clear()
+		{
+			MT::SpinLock lock(m_mutex);
+			while (m_first) uncache(*m_first);
+		}
+
+
+		CacheFileDevice::Stats CacheFileDevice::getStats()
+		{
+			MT::SpinLock lock(m_mutex);
+			Stats stats;
+			stats.hit_count = m_hit_count;
+			stats.miss_count = m_miss_count;
+			stats.file_count = m_entries.size();
+			stats.cached_bytes = m_cached_size;
+			return stats;
+		}
+
+
+		void CacheFileDevice::resetStats()
+		{
+			MT::SpinLock lock(m_mutex);
+			m_hit_count = 0;
+			m_miss_count = 0;
+		}
+
+
+		CacheFileDevice::Entry* CacheFileDevice::acquire(uint32 path_hash)
+		{
+			MT::SpinLock lock(m_mutex);
+			auto iter = m_entries.find(path_hash);
+			if (!iter.isValid())
+			{
+				++m_miss_count;
+				return nullptr;
+			}
+
+			++m_hit_count;
+			Entry* entry = iter.value();
+			++entry->ref_count;
+			if (entry == m_first) return entry;
+
+			// move to the front
+			entry->prev->next = entry->next;
+			if (entry->next) entry->next->prev = entry->prev;
+			else m_last = entry->prev;
+			entry->prev = nullptr;
+			entry->next = m_first;
+			m_first->prev = entry;
+			m_first = entry;
+			return entry;
+		}
+
+
+		CacheFileDevice::Entry* CacheFileDevice::createEntry(uint32 path_hash, size_t size)
+		{
+			Entry* entry = LUMIX_NEW(m_allocator, Entry);
+			entry->path_hash = path_hash;
+			entry->data = (uint8*)m_allocator.allocate(Math::maxValue(size, (size_t)1));
+			entry->size = size;
+			entry->ref_count = 1;
+			entry->is_cached = false;
+			entry->prev = entry->next = nullptr;
+			return entry;
+		}
+
+
+		// the entry of another file read at the same time is replaced
+		void CacheFileDevice::insert(Entry& entry)
+		{
+			MT::SpinLock lock(m_mutex);
+			ASSERT(!entry.is_cached);
+			auto iter = m_entries.find(entry.path_hash);
+			if (iter.isValid()) uncache(*iter.value());
+
+			m_entries.insert(entry.path_hash, &entry);
+			entry.is_cached = true;
+			++entry.ref_count;
+			entry.prev = nullptr;
+			entry.next = m_first;
+			if (m_first) m_first->prev = &entry;
+			else m_last = &entry;
+			m_first = &entry;
+			m_cached_size += entry.size;
+			evict();
+		}
+
+
+		void CacheFileDevice::release(Entry& entry)
+		{
+			MT::SpinLock lock(m_mutex);
+			removeReference(entry);
+		}
+
+
+		void CacheFileDevice::uncache(Entry& entry)
+		{
+			ASSERT(entry.is_cached);
+			if (entry.prev) entry.prev->next = entry.next;
+			else m_first = entry.next;
+			if (entry.next) entry.next->prev = entry.prev;
+			else m_last = entry.prev;
+			entry.prev = entry.next = nullptr;
+			entry.is_cached = false;
+			m_entries.erase(entry.path_hash);
+			m_cached_size -= entry.size;
+			removeReference(entry);
+		}
+
+
+		void CacheFileDevice::removeReference(Entry& entry)
+		{
+			ASSERT(entry.ref_count > 0);
+			--entry.ref_count;
+			if (entry.ref_count > 0) return;
+
+			m_allocator.deallocate(entry.data);
+			LUMIX_DELETE(m_allocator, &entry);
+		}
+
+
+		void CacheFileDevice::evict()
+		{
+			while (m_cached_size > m_budget && m_last) uncache(*m_last);
+		}
+	} // ~namespace FS
+} // ~namespace Lumix
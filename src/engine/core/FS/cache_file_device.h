@@ -0,0 +1,80 @@
+#pragma once
+
+#include "lumix.h"
+#include "core/fs/ifile_device.h"
+#include "core/hash_map.h"
+#include "core/mt/sync.h"
+
+namespace Lumix
+{
+	class IAllocator;
+	class Path;
+
+	namespace FS
+	{
+		class IFile;
+
+		// Keeps whole files read from the devices below it in memory, so files opened again, e.g.
+		// shaders and materials shared by many resources, are not read from them again. Cached
+		// files take at most the budget, the least recently opened ones are dropped first. Files
+		// bigger than a quarter of the budget and writes are passed to the child, writes drop the
+		// cached copy; files opened before a copy is dropped keep it until they are closed.
+		// Put it above the compressed device to cache decompressed data, e.g.
+		// "memory:cache:compressed:pack:disk".
+		class LUMIX_ENGINE_API CacheFileDevice : public IFileDevice
+		{
+		public:
+			struct Stats
+			{
+				int hit_count;
+				int miss_count;
+				int file_count;
+				uint64 cached_bytes;
+			};
+
+			struct Entry;
+
+		public:
+			explicit CacheFileDevice(IAllocator& allocator);
+			~CacheFileDevice();
+
+			IFile* createFile(IFile* child) override;
+			void destroyFile(IFile* file) override;
+			const char* name() const override { return "cache"; }
+
+			void setBudget(size_t bytes);
+			size_t getBudget() const { return m_budget; }
+			bool isCacheable(size_t size) const { return size <= m_budget / 4; }
+			// files changed outside of the file system must be invalidated, e.g. from
+			// FileSystemWatcher callbacks; can be called from any thread
+			void invalidate(const Path& path);
+			void clear();
+			Stats getStats();
+			void resetStats();
+
+			// used by files of the device from IO workers, acquired entries must be released
+			Entry* acquire(uint32 path_hash);
+			Entry* createEntry(uint32 path_hash, size_t size);
+			void insert(Entry& entry);
+			void release(Entry& entry);
+			IAllocator& getAllocator() { return m_allocator; }
+
+		private:
+			void uncache(Entry& entry);
+			void removeReference(Entry& entry);
+			void evict();
+
+		private:
+			IAllocator& m_allocator;
+			MT::SpinMutex m_mutex;
+			HashMap<uint32, Entry*> m_entries;
+			// cached entries, the most recently used first
+			Entry* m_first;
+			Entry* m_last;
+			size_t m_budget;
+			size_t m_cached_size;
+			int m_hit_count;
+			int m_miss_count;
+		};
+	} // ~namespace FS
+} // ~namespace Lumix
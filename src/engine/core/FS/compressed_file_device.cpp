@@ -0,0 +1,359 @@
+#include "core/fs/compressed_file_device.h"
+#include "core/array.h"
+#include "core/blob.h"
+#include "core/iallocator.h"
+#include "core/fs/ifile.h"
+#include "core/fs/ifile_system_defines.h"
+#include "core/log.h"
+#include "core/lz4.h"
+#include "core/math_utils.h"
+#include "core/path.h"
+#include "core/string.h"
+#include "core/timer.h"
+
+
+namespace Lumix
+{
+	namespace FS
+	{
+		static const uint32 COMPRESSED_MAGIC = 0x5a4c5a4c; // 'LZLZ'
+		static const uint32 COMPRESSED_VERSION = 0;
+		static const uint32 BLOCK_SIZE = 64 * 1024;
+		// set in the block table for blocks which did not get smaller and are stored as they are
+		static const uint32 STORED_BLOCK_FLAG = 0x80000000;
+
+
+		struct CompressedHeader
+		{
+			uint32 magic;
+			uint32 version;
+			uint64 size;
+			uint32 block_size;
+			uint32 block_count;
+		};
+
+
+		class CompressedFile : public IFile
+		{
+		public:
+			CompressedFile(IFile* file, CompressedFileDevice& device)
+				: m_device(device)
+				, m_file(file)
+				, m_data(nullptr)
+				, m_size(0)
+				, m_pos(0)
+			{
+			}
+
+			~CompressedFile()
+			{
+				freeData();
+				if (m_file) m_file->release();
+			}
+
+
+			IFileDevice& getDevice() override { return m_device; }
+
+
+			bool open(const Path& path, Mode mode) override
+			{
+				ASSERT(!m_data);
+				if (!m_file || !m_file->open(path, mode)) return false;
+				if (mode & Mode::WRITE) return true;
+
+				size_t compressed_size = m_file->size();
+				if (compressed_size < sizeof(CompressedHeader)) return true;
+
+				const uint8* compressed = (const uint8*)m_file->getBuffer();
+				if (!compressed)
+				{
+					CompressedHeader header;
+					if (!m_file->read(&header, sizeof(header))) return true;
+					m_file->seek(SeekMode::BEGIN, 0);
+					if (!CompressedFileDevice::isCompressed(&header, sizeof(header))) return true;
+				}
+				else if (!CompressedFileDevice::isCompressed(compressed, compressed_size))
+				{
+					return true;
+				}
+
+				// the child is not needed anymore, everything is served from m_data
+				bool success = decompress(compressed, compressed_size);
+				m_file->close();
+				if (!success)
+				{
+					g_log_error.log("FS") << "Could not decompress " << path.c_str();
+					freeData();
+				}
+				return success;
+			}
+
+
+			void close() override
+			{
+				if (m_data)
+				{
+					freeData();
+					return;
+				}
+				if (m_file) m_file->close();
+			}
+
+
+			bool read(void* buffer, size_t size) override
+			{
+				if (!m_data) return m_file->read(buffer, size);
+
+				size_t amount = m_pos + size < m_size ? size : m_size - m_pos;
+				copyMemory(buffer, m_data + m_pos, amount);
+				m_pos += amount;
+				return amount == size;
+			}
+
+
+			bool write(const void* buffer, size_t size) override
+			{
+				if (m_data) return false;
+				return m_file->write(buffer, size);
+			}
+
+
+			const void* getBuffer() const override
+			{
+				if (m_data) return m_data;
+				return m_file ? m_file->getBuffer() : nullptr;
+			}
+
+
+			size_t size() override
+			{
+				if (m_data) return m_size;
+				return m_file->size();
+			}
+
+
+			size_t seek(SeekMode base, size_t pos) override
+			{
+				if (!m_data) return m_file->seek(base, pos);
+
+				switch (base)
+				{
+					case SeekMode::BEGIN: m_pos = pos; break;
+					case SeekMode::CURRENT: m_pos += pos; break;
+					case SeekMode::END: m_pos = m_size - pos; break;
+					default: ASSERT(0); break;
+				}
+				m_pos = Math::minValue(m_pos, m_size);
+				return m_pos;
+			}
+
+
+			size_t pos() override
+			{
+				if (m_data) return m_pos;
+				return m_file->pos();
+			}
+
+		private:
+			// compressed is the child's buffer or nullptr if the child does not have one
+			bool decompress(const uint8* compressed, size_t compressed_size)
+			{
+				IAllocator& allocator = m_device.getAllocator();
+				float start_time = m_device.getTime();
+
+				uint8* tmp = nullptr;
+				if (!compressed)
+				{
+					tmp = (uint8*)allocator.allocate(compressed_size);
+					if (!m_file->read(tmp, compressed_size))
+					{
+						allocator.deallocate(tmp);
+						return false;
+					}
+					compressed = tmp;
+				}
+
+				bool success = decompressBlocks(compressed, compressed_size);
+				allocator.deallocate(tmp);
+				if (success) m_device.addStats(compressed_size, m_size, m_device.getTime() - start_time);
+				return success;
+			}
+
+
+			bool decompressBlocks(const uint8* compressed, size_t compressed_size)
+			{
+				const CompressedHeader& header = *(const CompressedHeader*)compressed;
+				size_t table_size = sizeof(uint32) * header.block_count;
+				if (compressed_size < sizeof(header) + table_size) return false;
+				if (header.size > (uint64)header.block_count * header.block_size) return false;
+
+				m_size = (size_t)header.size;
+				m_pos = 0;
+				m_data = (uint8*)m_device.getAllocator().allocate(Math::maxValue(m_size, (size_t)1));
+
+				const uint32* block_table = (const uint32*)(compressed + sizeof(header));
+				const uint8* src = compressed + sizeof(header) + table_size;
+				const uint8* src_end = compressed + compressed_size;
+				uint8* dst = m_data;
+				size_t remaining = m_size;
+				for (uint32 i = 0; i < header.block_count; ++i)
+				{
+					bool is_stored = (block_table[i] & STORED_BLOCK_FLAG) != 0;
+					size_t block_size = block_table[i] & ~STORED_BLOCK_FLAG;
+					size_t raw_size = Math::minValue(remaining, (size_t)header.block_size);
+					if (block_size > size_t(src_end - src)) return false;
+
+					if (is_stored)
+					{
+						if (block_size != raw_size) return false;
+						copyMemory(dst, src, raw_size);
+					}
+					else if (lz4Decompress(src, (int)block_size, dst, (int)raw_size) != (int)raw_size)
+					{
+						return false;
+					}
+					src += block_size;
+					dst += raw_size;
+					remaining -= raw_size;
+				}
+				return remaining == 0;
+			}
+
+
+			void freeData()
+			{
+				if (m_data) m_device.getAllocator().deallocate(m_data);
+				m_data = nullptr;
+				m_size = 0;
+				m_pos = 0;
+			}
+
+		private:
+			CompressedFileDevice& m_device;
+			IFile* m_file;
+			uint8* m_data;
+			size_t m_size;
+			size_t m_pos;
+		};
+
+
+		CompressedFileDevice::CompressedFileDevice(IAllocator& allocator)
+			: m_allocator(allocator)
+			, m_mutex(false)
+		{
+			m_timer = Timer::create(allocator);
+			resetStats();
+		}
+
+
+		CompressedFileDevice::~CompressedFileDevice()
+		{
+			Timer::destroy(m_timer);
+		}
+
+
+		IFile* CompressedFileDevice::createFile(IFile* child)
+		{
+			return LUMIX_NEW(m_allocator, CompressedFile)(child, *this);
+		}
+
+
+		void CompressedFileDevice::destroyFile(IFile* file)
+		{
+			LUMIX_DELETE(m_allocator, file);
+		}
+
+
+		CompressedFileDevice::Stats CompressedFileDevice::getStats()
+		{
+			MT::SpinLock lock(m_mutex);
+			return m_stats;
+		}
+
+
+		void CompressedFileDevice::resetStats()
+		{
+			MT::SpinLock lock(m_mutex);
+			m_stats.file_count = 0;
+			m_stats.compressed_bytes = 0;
+			m_stats.decompressed_bytes = 0;
+			m_stats.decompression_time = 0;
+		}
+
+
+		void CompressedFileDevice::addStats(uint64 compressed_bytes, uint64 decompressed_bytes, float time)
+		{
+			MT::SpinLock lock(m_mutex);
+			++m_stats.file_count;
+			m_stats.compressed_bytes += compressed_bytes;
+			m_stats.decompressed_bytes += decompressed_bytes;
+			m_stats.decompression_time += time;
+		}
+
+
+		float CompressedFileDevice::getTime()
+		{
+			return m_timer->getTimeSinceStart();
+		}
+
+
+		bool CompressedFileDevice::isCompressed(const void* data, size_t size)
+		{
+			if (size < sizeof(CompressedHeader)) return false;
+			const CompressedHeader& header = *(const CompressedHeader*)data;
+			return header.magic == COMPRESSED_MAGIC && header.version == COMPRESSED_VERSION;
+		}
+
+
+		bool CompressedFileDevice::compress(const void* data,
+			size_t size,
+			OutputBlob& out,
+			IAllocator& allocator)
+		{
+			CompressedHeader header;
+			header.magic = COMPRESSED_MAGIC;
+			header.version = COMPRESSED_VERSION;
+			header.size = size;
+			header.block_size = BLOCK_SIZE;
+			header.block_count = uint32((size + BLOCK_SIZE - 1) / BLOCK_SIZE);
+
+			Array<uint32> block_table(allocator);
+			block_table.resize(header.block_count);
+			Array<uint8> blocks(allocator);
+			blocks.resize(lz4CompressBound(BLOCK_SIZE) * header.block_count);
+
+			const uint8* src = (const uint8*)data;
+			int blocks_size = 0;
+			for (uint32 i = 0; i < header.block_count; ++i)
+			{
+				int raw_size = (int)Math::minValue(size - (size_t)i * BLOCK_SIZE, (size_t)BLOCK_SIZE);
+				uint8* dst = &blocks[blocks_size];
+				int compressed_size = lz4Compress(src, raw_size, dst, lz4CompressBound(BLOCK_SIZE));
+				if (compressed_size < raw_size)
+				{
+					block_table[i] = compressed_size;
+					blocks_size += compressed_size;
+				}
+				else
+				{
+					copyMemory(dst, src, raw_size);
+					block_table[i] = raw_size | STORED_BLOCK_FLAG;
+					blocks_size += raw_size;
+				}
+				src += raw_size;
+			}
+
+			size_t total_size = sizeof(header) + sizeof(uint32) * header.block_count + blocks_size;
+			if (total_size >= size) return false;
+
+			out.reserve(out.getSize() + (int)total_size);
+			out.write(header);
+			if (header.block_count > 0)
+			{
+				out.write(&block_table[0], sizeof(uint32) * header.block_count);
+				out.write(&blocks[0], blocks_size);
+			}
+			return true;
+		}
+	} // ~namespace FS
+} // ~namespace Lumix
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "lumix.h"
+#include "core/fs/ifile_device.h"
+#include "core/mt/sync.h"
+
+namespace Lumix
+{
+	class IAllocator;
+	class OutputBlob;
+	class Timer;
+
+	namespace FS
+	{
+		class IFile;
+
+		// Transparently decompresses files made by compress(). The whole file is decompressed in open(),
+		// i.e. on the IO worker for async reads, and read() and getBuffer() return decompressed data.
+		// Files without the header and writes are passed to the child device, so it can be put above
+		// both pack and disk devices, e.g. "memory:compressed:pack:disk".
+		class LUMIX_ENGINE_API CompressedFileDevice : public IFileDevice
+		{
+		public:
+			struct Stats
+			{
+				int file_count;
+				uint64 compressed_bytes;
+				uint64 decompressed_bytes;
+				float decompression_time;
+			};
+
+		public:
+			explicit CompressedFileDevice(IAllocator& allocator);
+			~CompressedFileDevice();
+
+			IFile* createFile(IFile* child) override;
+			void destroyFile(IFile* file) override;
+			const char* name() const override { return "compressed"; }
+
+			Stats getStats();
+			void resetStats();
+			void addStats(uint64 compressed_bytes, uint64 decompressed_bytes, float time);
+			float getTime();
+			IAllocator& getAllocator() { return m_allocator; }
+
+			static bool isCompressed(const void* data, size_t size);
+			// appends compressed image of data to out, returns false and does not touch out
+			// if it would not be smaller than data
+			static bool compress(const void* data, size_t size, OutputBlob& out, IAllocator& allocator);
+
+		private:
+			IAllocator& m_allocator;
+			Timer* m_timer;
+			MT::SpinMutex m_mutex;
+			Stats m_stats;
+		};
+	} // ~namespace FS
+} // ~namespace Lumix
@@ -4,14 +4,15 @@
 #include "core/base_proxy_allocator.h"
 #include "core/fs/disk_file_device.h"
 #include "core/fs/ifile.h"
+#include "core/math_utils.h"
 #include "core/mt/lock_free_fixed_queue.h"
 #include "core/mt/task.h"
 #include "core/mt/transaction.h"
 #include "core/path.h"
 #include "core/profiler.h"
-#include "core/queue.h"
 #include "core/stack_allocator.h"
 #include "core/string.h"
+#include "core/timer.h"
 
 
 namespace Lumix
@@ -36,14 +37,19 @@ struct AsyncItem
 	ReadCallback m_cb;
 	Mode m_mode;
 	char m_path[MAX_PATH_LENGTH];
+	uint32 m_path_hash;
+	int m_priority;
 	uint8 m_flags;
 };
 
-static const int32 C_MAX_TRANS = 16;
+static const int32 C_MAX_TRANS = 32;
+static const int MAX_IO_WORKERS = 8;
+// closing releases the file, it should not wait behind the opens
+static const int CLOSE_PRIORITY = 0x7fffffff;
 
 typedef MT::Transaction<AsyncItem> AsynTrans;
 typedef MT::LockFreeFixedQueue<AsynTrans, C_MAX_TRANS> TransQueue;
-typedef Queue<AsynTrans*, C_MAX_TRANS> InProgressQueue;
+typedef Array<AsynTrans*> InProgressQueue;
 typedef Array<AsyncItem> ItemsTable;
 typedef Array<IFileDevice*> DevicesTable;
 
@@ -94,32 +100,48 @@ private:
 class FileSystemImpl : public FileSystem
 {
 public:
-	explicit FileSystemImpl(IAllocator& allocator)
+	FileSystemImpl(int worker_count, IAllocator& allocator)
 		: m_allocator(allocator)
 		, m_in_progress(m_allocator)
 		, m_pending(m_allocator)
 		, m_devices(m_allocator)
+		, m_tasks(m_allocator)
+		, m_callbacks_time_budget(0)
 	{
-		m_task = LUMIX_NEW(m_allocator, FSTask)(&m_transaction_queue, m_allocator);
-		m_task->create("FSTask");
-		m_task->run();
+		m_timer = Timer::create(m_allocator);
+		setMemory(&m_async_stats, 0, sizeof(m_async_stats));
+		// workers share the transaction queue, so a slow device does not stall the others
+		worker_count = Math::clamp(worker_count, 1, MAX_IO_WORKERS);
+		m_in_progress.reserve(C_MAX_TRANS);
+		for (int i = 0; i < worker_count; ++i)
+		{
+			FSTask* task = LUMIX_NEW(m_allocator, FSTask)(&m_transaction_queue, m_allocator);
+			task->create("FSTask");
+			task->run();
+			m_tasks.push(task);
+		}
 	}
 
 	~FileSystemImpl()
 	{
-		m_task->stop();
-		m_task->destroy();
-		while (!m_in_progress.empty())
+		m_transaction_queue.abort();
+		for (FSTask* task : m_tasks)
+		{
+			task->destroy();
+		}
+		for (auto* trans : m_in_progress)
 		{
-			auto* trans = m_in_progress.front();
-			m_in_progress.pop();
 			if (trans->data.m_file) close(*trans->data.m_file);
 		}
 		for (auto& i : m_pending)
 		{
 			close(*i.m_file);
 		}
-		LUMIX_DELETE(m_allocator, m_task);
+		for (FSTask* task : m_tasks)
+		{
+			LUMIX_DELETE(m_allocator, task);
+		}
+		Timer::destroy(m_timer);
 	}
 
 	BaseProxyAllocator& getAllocator() { return m_allocator; }
@@ -206,7 +228,8 @@ public:
 	bool openAsync(const DeviceList& device_list,
 		const Path& file,
 		int mode,
-		const ReadCallback& call_back) override
+		const ReadCallback& call_back,
+		int priority) override
 	{
 		IFile* prev = createFile(device_list);
 
@@ -218,6 +241,8 @@ public:
 			item.m_cb = call_back;
 			item.m_mode = mode;
 			copyString(item.m_path, file.c_str());
+			item.m_path_hash = file.getHash();
+			item.m_priority = priority;
 			item.m_flags = E_IS_OPEN;
 		}
 
@@ -225,6 +250,16 @@ public:
 	}
 
 
+	void setAsyncPriority(const Path& file, int priority) override
+	{
+		uint32 hash = file.getHash();
+		for (auto& item : m_pending)
+		{
+			if (item.m_flags == E_IS_OPEN && item.m_path_hash == hash) item.m_priority = priority;
+		}
+	}
+
+
 	void setDefaultDevice(const char* dev) override { fillDeviceList(dev, m_default_device); }
 
 
@@ -279,6 +314,9 @@ public:
 		item.m_file = &file;
 		item.m_cb.bind<closeAsync>();
 		item.m_mode = 0;
+		item.m_path[0] = '\0';
+		item.m_path_hash = 0;
+		item.m_priority = CLOSE_PRIORITY;
 		item.m_flags = E_CLOSE;
 	}
 
@@ -286,13 +324,30 @@ public:
 	void updateAsyncTransactions() override
 	{
 		PROFILE_FUNCTION();
-		while (!m_in_progress.empty())
+		float start_time = m_timer->getTimeSinceStart();
+		float budget = m_callbacks_time_budget * 0.001f;
+		m_async_stats.callbacks_count = 0;
+		m_async_stats.completed_backlog = 0;
+		// transactions are completed out of order by the workers, so do not wait for the oldest one
+		for (int i = 0; i < m_in_progress.size();)
 		{
-			AsynTrans* tr = m_in_progress.front();
-			if (!tr->isCompleted()) break;
+			AsynTrans* tr = m_in_progress[i];
+			if (!tr->isCompleted())
+			{
+				++i;
+				continue;
+			}
+			if (budget > 0 && m_async_stats.callbacks_count > 0 &&
+				m_timer->getTimeSinceStart() - start_time > budget)
+			{
+				++m_async_stats.completed_backlog;
+				++i;
+				continue;
+			}
 
 			PROFILE_BLOCK("processAsyncTransaction");
-			m_in_progress.pop();
+			m_in_progress.erase(i);
+			++m_async_stats.callbacks_count;
 
 			tr->data.m_cb.invoke(*tr->data.m_file, !!(tr->data.m_flags & E_SUCCESS));
 			if ((tr->data.m_flags & (E_SUCCESS | E_FAIL)) != 0)
@@ -308,22 +363,65 @@ public:
 			AsynTrans* tr = m_transaction_queue.alloc(false);
 			if (tr)
 			{
-				AsyncItem& item = m_pending[0];
+				int index = getHighestPriorityPending();
+				AsyncItem& item = m_pending[index];
 				tr->data.m_file = item.m_file;
 				tr->data.m_cb = item.m_cb;
 				tr->data.m_mode = item.m_mode;
 				copyString(tr->data.m_path, sizeof(tr->data.m_path), item.m_path);
+				tr->data.m_path_hash = item.m_path_hash;
+				tr->data.m_priority = item.m_priority;
 				tr->data.m_flags = item.m_flags;
 				tr->reset();
 
 				m_transaction_queue.push(tr, true);
 				m_in_progress.push(tr);
-				m_pending.erase(0);
+				m_pending.erase(index);
 			}
 			can_add--;
 		}
+
+		m_async_stats.callbacks_time = m_timer->getTimeSinceStart() - start_time;
+		m_async_stats.pending_count = m_pending.size();
+		m_async_stats.in_progress_count = m_in_progress.size() - m_async_stats.completed_backlog;
+	}
+
+
+	void setCallbacksTimeBudget(float budget_ms) override { m_callbacks_time_budget = budget_ms; }
+
+
+	float getCallbacksTimeBudget() const override { return m_callbacks_time_budget; }
+
+
+	const AsyncStats& getAsyncStats() const override { return m_async_stats; }
+
+
+	int getAsyncPaths(const char** paths, int max_count) const override
+	{
+		int count = 0;
+		for (int i = 0; i < m_in_progress.size() && count < max_count; ++i)
+		{
+			paths[count++] = m_in_progress[i]->data.m_path;
+		}
+		for (int i = 0; i < m_pending.size() && count < max_count; ++i)
+		{
+			paths[count++] = m_pending[i].m_path;
+		}
+		return count;
 	}
 
+	// the first one of the items with the same priority, so they stay in FIFO order
+	int getHighestPriorityPending() const
+	{
+		int best = 0;
+		for (int i = 1, c = m_pending.size(); i < c; ++i)
+		{
+			if (m_pending[i].m_priority > m_pending[best].m_priority) best = i;
+		}
+		return best;
+	}
+
+
 	const DeviceList& getDefaultDevice() const override { return m_default_device; }
 
 	const DeviceList& getSaveGameDevice() const override { return m_save_game_device; }
@@ -340,15 +438,12 @@ public:
 
 	static void closeAsync(IFile&, bool) {}
 
-	void destroy()
-	{
-		m_transaction_queue.abort();
-		m_task->destroy();
-	}
-
 private:
 	BaseProxyAllocator m_allocator;
-	FSTask* m_task;
+	Array<FSTask*> m_tasks;
+	Timer* m_timer;
+	float m_callbacks_time_budget;
+	AsyncStats m_async_stats;
 	DevicesTable m_devices;
 
 	ItemsTable m_pending;
@@ -361,9 +456,9 @@ private:
 	DeviceList m_save_game_device;
 };
 
-FileSystem* FileSystem::create(IAllocator& allocator)
+FileSystem* FileSystem::create(IAllocator& allocator, int worker_count)
 {
-	return LUMIX_NEW(allocator, FileSystemImpl)(allocator);
+	return LUMIX_NEW(allocator, FileSystemImpl)(worker_count, allocator);
 }
 
 void FileSystem::destroy(FileSystem* fs)
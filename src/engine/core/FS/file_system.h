@@ -24,10 +24,22 @@ struct LUMIX_ENGINE_API DeviceList
 };
 
 
+struct AsyncStats
+{
+	int pending_count;
+	int in_progress_count;
+	// completed transactions whose callbacks were postponed by the time budget
+	int completed_backlog;
+	int callbacks_count;
+	float callbacks_time;
+};
+
+
 class LUMIX_ENGINE_API FileSystem
 {
 public:
-	static FileSystem* create(IAllocator& allocator);
+	// async transactions are processed by worker_count threads
+	static FileSystem* create(IAllocator& allocator, int worker_count = 2);
 	static void destroy(FileSystem* fs);
 
 	FileSystem() {}
@@ -37,15 +49,26 @@ public:
 	virtual bool unMount(IFileDevice* device) = 0;
 
 	virtual IFile* open(const DeviceList& device_list, const Path& file, Mode mode) = 0;
+	// pending files are opened in the order of priority, higher first
 	virtual bool openAsync(const DeviceList& device_list,
 						   const Path& file,
 						   int mode,
-						   const ReadCallback& call_back) = 0;
+						   const ReadCallback& call_back,
+						   int priority = 0) = 0;
+	virtual void setAsyncPriority(const Path& file, int priority) = 0;
 
 	virtual void close(IFile& file) = 0;
 	virtual void closeAsync(IFile& file) = 0;
 
 	virtual void updateAsyncTransactions() = 0;
+	// completion callbacks stop after budget_ms in one updateAsyncTransactions, at least one is
+	// always invoked, the rest waits for the next update; 0 means no limit
+	virtual void setCallbacksTimeBudget(float budget_ms) = 0;
+	virtual float getCallbacksTimeBudget() const = 0;
+	// stats of the last updateAsyncTransactions
+	virtual const AsyncStats& getAsyncStats() const = 0;
+	// paths of the transactions in progress and then of the pending ones, returns their count
+	virtual int getAsyncPaths(const char** paths, int max_count) const = 0;
 
 	virtual void fillDeviceList(const char* dev, DeviceList& device_list) = 0;
 	virtual const DeviceList& getDefaultDevice() const = 0;
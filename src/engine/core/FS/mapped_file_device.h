@@ -0,0 +1,32 @@
+#pragma once
+
+#include "lumix.h"
+#include "core/fs/ifile_device.h"
+
+namespace Lumix
+{
+	class IAllocator;
+
+	namespace FS
+	{
+		class IFile;
+
+		// Maps files opened for reading to memory, getBuffer() returns a pointer to the mapped view,
+		// so nothing is copied. Writes and files which can not be mapped (e.g. empty files)
+		// are passed to the child device.
+		class LUMIX_ENGINE_API MappedFileDevice : public IFileDevice
+		{
+		public:
+			MappedFileDevice(const char* base_path0, const char* base_path1, IAllocator& allocator);
+
+			IFile* createFile(IFile* child) override;
+			void destroyFile(IFile* file) override;
+			const char* getBasePath(int index) const { return m_base_paths[index]; }
+			const char* name() const override { return "mapped"; }
+
+		private:
+			IAllocator& m_allocator;
+			char m_base_paths[2][MAX_PATH_LENGTH];
+		};
+	} // ~namespace FS
+} // ~namespace Lumix
@@ -16,6 +16,7 @@ namespace Lumix
 			MemoryFile(IFile* file, MemoryFileDevice& device, IAllocator& allocator)
 				: m_device(device)
 				, m_buffer(nullptr)
+				, m_child_buffer(nullptr)
 				, m_size(0)
 				, m_capacity(0)
 				, m_pos(0)
@@ -51,6 +52,15 @@ namespace Lumix
 					{
 						if(mode & Mode::READ)
 						{
+							// children with their own buffer, e.g. mapped files, are read in place
+							m_child_buffer = m_write ? nullptr : (const uint8*)m_file->getBuffer();
+							if (m_child_buffer)
+							{
+								m_size = m_file->size();
+								m_pos = 0;
+								return true;
+							}
+
 							m_capacity = m_size = m_file->size();
 							m_buffer = (uint8*)m_allocator.allocate(sizeof(uint8) * m_size);
 							m_file->read(m_buffer, m_size);
@@ -85,18 +95,22 @@ namespace Lumix
 
 				m_allocator.deallocate(m_buffer);
 				m_buffer = nullptr;
+				m_child_buffer = nullptr;
 			}
 
 			bool read(void* buffer, size_t size) override
 			{
 				size_t amount = m_pos + size < m_size ? size : m_size - m_pos;
-				copyMemory(buffer, m_buffer + m_pos, (int)amount);
+				const uint8* data = m_child_buffer ? m_child_buffer : m_buffer;
+				copyMemory(buffer, data + m_pos, (int)amount);
 				m_pos += amount;
 				return amount == size;
 			}
 
 			bool write(const void* buffer, size_t size) override
 			{
+				if (m_child_buffer) return false;
+
 				size_t pos = m_pos;
 				size_t cap = m_capacity;
 				size_t sz = m_size;
@@ -119,7 +133,7 @@ namespace Lumix
 
 			const void* getBuffer() const override
 			{
-				return m_buffer;
+				return m_child_buffer ? m_child_buffer : m_buffer;
 			}
 
 			size_t size() override
@@ -161,6 +175,7 @@ namespace Lumix
 			IAllocator& m_allocator;
 			MemoryFileDevice& m_device;
 			uint8* m_buffer;
+			const uint8* m_child_buffer;
 			size_t m_size;
 			size_t m_capacity;
 			size_t m_pos;
@@ -0,0 +1,352 @@
+#include "core/fs/pack_file_device.h"
+#include "core/blob.h"
+#include "core/crc32.h"
+#include "core/fs/compressed_file_device.h"
+#include "core/iallocator.h"
+#include "core/fs/ifile.h"
+#include "core/fs/ifile_system_defines.h"
+#include "core/fs/os_file.h"
+#include "core/log.h"
+#include "core/math_utils.h"
+#include "core/path.h"
+#include "core/path_utils.h"
+#include "core/string.h"
+
+
+namespace Lumix
+{
+	namespace FS
+	{
+		static const uint32 PACK_MAGIC = 0x4b41504c; // 'LPAK'
+		static const uint32 PACK_VERSION = 0;
+
+
+		struct PackHeader
+		{
+			uint32 magic;
+			uint32 version;
+			uint32 count;
+			uint32 reserved;
+		};
+
+
+		struct PackTOCEntry
+		{
+			uint32 hash;
+			uint32 reserved;
+			uint64 offset;
+			uint64 size;
+		};
+
+
+		class PackFile : public IFile
+		{
+		public:
+			PackFile(IFile* file, PackFileDevice& device)
+				: m_device(device)
+				, m_file(file)
+				, m_is_packed(false)
+				, m_pos(0)
+			{
+			}
+
+			~PackFile()
+			{
+				if (m_file)
+				{
+					m_file->release();
+				}
+			}
+
+
+			IFileDevice& getDevice() override
+			{
+				return m_device;
+			}
+
+
+			bool open(const Path& path, Mode mode) override
+			{
+				m_is_packed = false;
+				m_pos = 0;
+				if (!(mode & Mode::WRITE))
+				{
+					const PackFileDevice::Entry* entry = m_device.find(path.getHash());
+					if (entry)
+					{
+						m_entry = *entry;
+						m_is_packed = true;
+						return true;
+					}
+				}
+				return m_file && m_file->open(path, mode);
+			}
+
+
+			void close() override
+			{
+				if (m_is_packed)
+				{
+					m_is_packed = false;
+					return;
+				}
+				if (m_file) m_file->close();
+			}
+
+
+			bool read(void* buffer, size_t size) override
+			{
+				if (!m_is_packed) return m_file->read(buffer, size);
+
+				size_t amount = m_pos + size < m_entry.size ? size : size_t(m_entry.size - m_pos);
+				if (!m_device.read(m_entry, m_pos, buffer, amount)) return false;
+				m_pos += amount;
+				return amount == size;
+			}
+
+
+			bool write(const void* buffer, size_t size) override
+			{
+				if (m_is_packed) return false;
+				return m_file->write(buffer, size);
+			}
+
+
+			const void* getBuffer() const override
+			{
+				if (m_is_packed) return nullptr;
+				return m_file ? m_file->getBuffer() : nullptr;
+			}
+
+
+			size_t size() override
+			{
+				if (m_is_packed) return (size_t)m_entry.size;
+				return m_file->size();
+			}
+
+
+			size_t seek(SeekMode base, size_t pos) override
+			{
+				if (!m_is_packed) return m_file->seek(base, pos);
+
+				size_t size = (size_t)m_entry.size;
+				switch (base)
+				{
+					case SeekMode::BEGIN: m_pos = pos; break;
+					case SeekMode::CURRENT: m_pos += pos; break;
+					case SeekMode::END: m_pos = size - pos; break;
+					default: ASSERT(0); break;
+				}
+				m_pos = Math::minValue(m_pos, size);
+				return m_pos;
+			}
+
+
+			size_t pos() override
+			{
+				if (m_is_packed) return m_pos;
+				return m_file->pos();
+			}
+
+		private:
+			PackFileDevice& m_device;
+			IFile* m_file;
+			PackFileDevice::Entry m_entry;
+			bool m_is_packed;
+			size_t m_pos;
+		};
+
+
+		PackFileDevice::PackFileDevice(IAllocator& allocator)
+			: m_allocator(allocator)
+			, m_archives(allocator)
+			, m_entries(allocator)
+			, m_mutex(false)
+		{
+		}
+
+
+		PackFileDevice::~PackFileDevice()
+		{
+			for (OsFile* archive : m_archives)
+			{
+				archive->close();
+				LUMIX_DELETE(m_allocator, archive);
+			}
+		}
+
+
+		bool PackFileDevice::mount(const char* path)
+		{
+			OsFile* archive = LUMIX_NEW(m_allocator, OsFile);
+			if (!archive->open(path, Mode::OPEN_AND_READ, m_allocator))
+			{
+				g_log_error.log("FS") << "Could not open archive " << path;
+				LUMIX_DELETE(m_allocator, archive);
+				return false;
+			}
+
+			PackHeader header;
+			if (!archive->read(&header, sizeof(header)) || header.magic != PACK_MAGIC ||
+				header.version != PACK_VERSION)
+			{
+				g_log_error.log("FS") << path << " is not a valid archive";
+				archive->close();
+				LUMIX_DELETE(m_allocator, archive);
+				return false;
+			}
+
+			Array<PackTOCEntry> toc(m_allocator);
+			toc.resize(header.count);
+			if (header.count > 0 && !archive->read(&toc[0], sizeof(toc[0]) * header.count))
+			{
+				g_log_error.log("FS") << "Could not read table of contents of " << path;
+				archive->close();
+				LUMIX_DELETE(m_allocator, archive);
+				return false;
+			}
+
+			MT::Lock lock(m_mutex);
+			int archive_index = m_archives.size();
+			m_archives.push(archive);
+			m_entries.rehash(m_entries.size() + header.count);
+			for (const PackTOCEntry& toc_entry : toc)
+			{
+				Entry entry;
+				entry.archive = archive_index;
+				entry.offset = toc_entry.offset;
+				entry.size = toc_entry.size;
+				auto iter = m_entries.find(toc_entry.hash);
+				if (iter.isValid())
+				{
+					iter.value() = entry;
+				}
+				else
+				{
+					m_entries.insert(toc_entry.hash, entry);
+				}
+			}
+			return true;
+		}
+
+
+		const PackFileDevice::Entry* PackFileDevice::find(uint32 hash) const
+		{
+			auto iter = m_entries.find(hash);
+			return iter.isValid() ? &iter.value() : nullptr;
+		}
+
+
+		bool PackFileDevice::read(const Entry& entry, uint64 offset, void* buffer, size_t size)
+		{
+			ASSERT(offset + size <= entry.size);
+			if (size == 0) return true;
+
+			// archives are shared by all files and both sync and async reads end up here
+			MT::Lock lock(m_mutex);
+			OsFile* archive = m_archives[entry.archive];
+			archive->seek(SeekMode::BEGIN, size_t(entry.offset + offset));
+			return archive->read(buffer, size);
+		}
+
+
+		IFile* PackFileDevice::createFile(IFile* child)
+		{
+			return LUMIX_NEW(m_allocator, PackFile)(child, *this);
+		}
+
+
+		void PackFileDevice::destroyFile(IFile* file)
+		{
+			LUMIX_DELETE(m_allocator, file);
+		}
+
+
+		bool PackFileDevice::pack(const char* out_path,
+			const char* base_path,
+			const char* const* paths,
+			int count,
+			bool compress,
+			IAllocator& allocator,
+			ICooker* cooker)
+		{
+			OsFile out;
+			if (!out.open(out_path, Mode::CREATE | Mode::WRITE, allocator))
+			{
+				g_log_error.log("FS") << "Could not create archive " << out_path;
+				return false;
+			}
+
+			Array<PackTOCEntry> toc(allocator);
+			toc.resize(count);
+			PackHeader header;
+			header.magic = PACK_MAGIC;
+			header.version = PACK_VERSION;
+			header.count = count;
+			header.reserved = 0;
+			bool success = out.write(&header, sizeof(header));
+			if (count > 0) success = success && out.write(&toc[0], sizeof(toc[0]) * count);
+
+			Array<uint8> data(allocator);
+			OutputBlob compressed(allocator);
+			OutputBlob cooked(allocator);
+			uint64 offset = sizeof(header) + sizeof(toc[0]) * count;
+			for (int i = 0; i < count && success; ++i)
+			{
+				char normalized[MAX_PATH_LENGTH];
+				PathUtils::normalize(paths[i], normalized, lengthOf(normalized));
+				char full_path[MAX_PATH_LENGTH];
+				copyString(full_path, base_path);
+				catString(full_path, normalized);
+
+				OsFile file;
+				if (!file.open(full_path, Mode::OPEN_AND_READ, allocator))
+				{
+					g_log_error.log("FS") << "Could not open " << full_path;
+					success = false;
+					break;
+				}
+				size_t size = file.size();
+				data.resize((int)size);
+				success = size == 0 || file.read(&data[0], size);
+				file.close();
+				const void* content = size > 0 ? &data[0] : nullptr;
+				cooked.clear();
+				if (success && cooker && size > 0 &&
+					cooker->cook(normalized, content, (int)size, cooked))
+				{
+					content = cooked.getData();
+					size = cooked.getSize();
+				}
+				compressed.clear();
+				if (success && compress && size > 0 &&
+					CompressedFileDevice::compress(content, size, compressed, allocator))
+				{
+					size = compressed.getSize();
+					success = out.write(compressed.getData(), size);
+				}
+				else if (success && size > 0)
+				{
+					success = out.write(content, size);
+				}
+
+				PackTOCEntry& entry = toc[i];
+				entry.hash = crc32(normalized);
+				entry.reserved = 0;
+				entry.offset = offset;
+				entry.size = size;
+				offset += size;
+			}
+
+			if (success && count > 0)
+			{
+				out.seek(SeekMode::BEGIN, sizeof(header));
+				success = out.write(&toc[0], sizeof(toc[0]) * count);
+			}
+			out.close();
+			if (!success) g_log_error.log("FS") << "Could not write archive " << out_path;
+			return success;
+		}
+	} // ~namespace FS
+} // ~namespace Lumix
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "lumix.h"
+#include "core/array.h"
+#include "core/fs/ifile_device.h"
+#include "core/hash_map.h"
+#include "core/mt/sync.h"
+
+namespace Lumix
+{
+	class IAllocator;
+	class OutputBlob;
+
+	namespace FS
+	{
+		class IFile;
+		class OsFile;
+
+		// Serves files from archives built by pack(). Entries are found by the same hash as Path,
+		// files which are not in any mounted archive are opened by the child device, so loose
+		// files still work in "memory:pack:disk" and can be used next to the archives.
+		class LUMIX_ENGINE_API PackFileDevice : public IFileDevice
+		{
+		public:
+			struct Entry
+			{
+				int archive;
+				uint64 offset;
+				uint64 size;
+			};
+
+			// converts files to the format stored in archives, e.g. text sources to binaries,
+			// returns false if the file is stored as it is
+			struct ICooker
+			{
+				virtual ~ICooker() {}
+				virtual bool cook(const char* path, const void* data, int size, OutputBlob& out) = 0;
+			};
+
+		public:
+			explicit PackFileDevice(IAllocator& allocator);
+			~PackFileDevice();
+
+			// entries from later mounted archives override entries from earlier ones,
+			// archives should be mounted before any file is opened through the device
+			bool mount(const char* path);
+			const Entry* find(uint32 hash) const;
+			bool read(const Entry& entry, uint64 offset, void* buffer, size_t size);
+
+			IFile* createFile(IFile* child) override;
+			void destroyFile(IFile* file) override;
+			const char* name() const override { return "pack"; }
+
+			// paths are relative to base_path, they are stored the same way as Path normalizes them,
+			// compressed entries are decompressed by CompressedFileDevice above this device,
+			// files are cooked before they are compressed
+			static bool pack(const char* out_path,
+				const char* base_path,
+				const char* const* paths,
+				int count,
+				bool compress,
+				IAllocator& allocator,
+				ICooker* cooker = nullptr);
+
+		private:
+			IAllocator& m_allocator;
+			Array<OsFile*> m_archives;
+			HashMap<uint32, Entry> m_entries;
+			MT::Mutex m_mutex;
+		};
+	} // ~namespace FS
+} // ~namespace Lumix
@@ -0,0 +1,208 @@
+#include "core/fs/mapped_file_device.h"
+#include "core/iallocator.h"
+#include "core/fs/ifile.h"
+#include "core/fs/ifile_system_defines.h"
+#include "core/math_utils.h"
+#include "core/path.h"
+#include "core/string.h"
+
+#include "core/pc/simple_win.h"
+#include <windows.h>
+
+
+namespace Lumix
+{
+namespace FS
+{
+
+
+class MappedFile : public IFile
+{
+public:
+	MappedFile(IFile* file, MappedFileDevice& device)
+		: m_device(device)
+		, m_file(file)
+		, m_handle(INVALID_HANDLE_VALUE)
+		, m_mapping(nullptr)
+		, m_data(nullptr)
+		, m_size(0)
+		, m_pos(0)
+	{
+	}
+
+	~MappedFile()
+	{
+		unmap();
+		if (m_file) m_file->release();
+	}
+
+
+	IFileDevice& getDevice() override { return m_device; }
+
+
+	bool open(const Path& path, Mode mode) override
+	{
+		ASSERT(!m_data);
+		if (!(mode & Mode::WRITE))
+		{
+			if (map(path.c_str())) return true;
+
+			char tmp[MAX_PATH_LENGTH];
+			copyString(tmp, m_device.getBasePath(0));
+			catString(tmp, path.c_str());
+			if (map(tmp)) return true;
+
+			copyString(tmp, m_device.getBasePath(1));
+			catString(tmp, path.c_str());
+			if (map(tmp)) return true;
+		}
+		return m_file && m_file->open(path, mode);
+	}
+
+
+	void close() override
+	{
+		if (m_data)
+		{
+			unmap();
+			return;
+		}
+		if (m_file) m_file->close();
+	}
+
+
+	bool read(void* buffer, size_t size) override
+	{
+		if (!m_data) return m_file->read(buffer, size);
+
+		size_t amount = m_pos + size < m_size ? size : m_size - m_pos;
+		copyMemory(buffer, m_data + m_pos, (int)amount);
+		m_pos += amount;
+		return amount == size;
+	}
+
+
+	bool write(const void* buffer, size_t size) override
+	{
+		if (m_data) return false;
+		return m_file->write(buffer, size);
+	}
+
+
+	const void* getBuffer() const override
+	{
+		if (m_data) return m_data;
+		return m_file ? m_file->getBuffer() : nullptr;
+	}
+
+
+	size_t size() override
+	{
+		if (m_data) return m_size;
+		return m_file->size();
+	}
+
+
+	size_t seek(SeekMode base, size_t pos) override
+	{
+		if (!m_data) return m_file->seek(base, pos);
+
+		switch (base)
+		{
+			case SeekMode::BEGIN: m_pos = pos; break;
+			case SeekMode::CURRENT: m_pos += pos; break;
+			case SeekMode::END: m_pos = m_size - pos; break;
+			default: ASSERT(0); break;
+		}
+		m_pos = Math::minValue(m_pos, m_size);
+		return m_pos;
+	}
+
+
+	size_t pos() override
+	{
+		if (m_data) return m_pos;
+		return m_file->pos();
+	}
+
+private:
+	bool map(const char* path)
+	{
+		m_handle = ::CreateFile(
+			path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (m_handle == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER size;
+		// empty files can not be mapped
+		if (!::GetFileSizeEx(m_handle, &size) || size.QuadPart == 0)
+		{
+			unmap();
+			return false;
+		}
+
+		m_mapping = ::CreateFileMapping(m_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!m_mapping)
+		{
+			unmap();
+			return false;
+		}
+
+		m_data = (const uint8*)::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!m_data)
+		{
+			unmap();
+			return false;
+		}
+		m_size = (size_t)size.QuadPart;
+		m_pos = 0;
+		return true;
+	}
+
+
+	void unmap()
+	{
+		if (m_data) ::UnmapViewOfFile(m_data);
+		if (m_mapping) ::CloseHandle(m_mapping);
+		if (m_handle != INVALID_HANDLE_VALUE) ::CloseHandle(m_handle);
+		m_data = nullptr;
+		m_mapping = nullptr;
+		m_handle = INVALID_HANDLE_VALUE;
+		m_size = 0;
+		m_pos = 0;
+	}
+
+private:
+	MappedFileDevice& m_device;
+	IFile* m_file;
+	HANDLE m_handle;
+	HANDLE m_mapping;
+	const uint8* m_data;
+	size_t m_size;
+	size_t m_pos;
+};
+
+
+MappedFileDevice::MappedFileDevice(const char* base_path0, const char* base_path1, IAllocator& allocator)
+	: m_allocator(allocator)
+{
+	copyString(m_base_paths[0], base_path0);
+	if (m_base_paths[0][0] != '\0') catString(m_base_paths[0], "/");
+	copyString(m_base_paths[1], base_path1);
+	if (m_base_paths[1][0] != '\0') catString(m_base_paths[1], "/");
+}
+
+
+void MappedFileDevice::destroyFile(IFile* file)
+{
+	LUMIX_DELETE(m_allocator, file);
+}
+
+
+IFile* MappedFileDevice::createFile(IFile* child)
+{
+	return LUMIX_NEW(m_allocator, MappedFile)(child, *this);
+}
+
+
+} // namespace FS
+} // namespace Lumix
@@ -1,12 +1,18 @@
 #include "core/fs/tcp_file_device.h"
+#include "core/array.h"
+#include "core/crc32.h"
 #include "core/iallocator.h"
-#include "core/blob.h"
 #include "core/fs/ifile.h"
 #include "core/fs/ifile_system_defines.h"
 #include "core/fs/file_system.h"
+#include "core/fs/os_file.h"
+#include "core/math_utils.h"
+#include "core/mt/atomic.h"
 #include "core/mt/sync.h"
+#include "core/mt/task.h"
 #include "core/path.h"
 #include "core/network.h"
+#include "core/string.h"
 
 
 namespace Lumix
@@ -15,17 +21,228 @@ namespace Lumix
 	{
 		static const uint32 INVALID_FILE = 0xffffFFFF;
 
+
+		struct TCPRequest
+		{
+			TCPRequest()
+				: event(0)
+				, id(TCP_NO_RESPONSE)
+				, buffer(nullptr)
+				, capacity(0)
+				, allocate(false)
+				, size(0)
+				, result(-1)
+			{
+			}
+
+			MT::Event event;
+			uint32 id;
+			// payload of the response is read to buffer, if allocate is set the buffer is allocated
+			// by the receiver and the requester owns it
+			void* buffer;
+			size_t capacity;
+			bool allocate;
+			size_t size;
+			int64 result;
+		};
+
+
+		class TCPReceiverTask : public MT::Task
+		{
+		public:
+			TCPReceiverTask(TCPImpl& impl, IAllocator& allocator)
+				: MT::Task(allocator)
+				, m_impl(impl)
+			{
+			}
+
+			int task() override;
+
+		private:
+			bool skip(Net::TCPStream& stream, size_t size);
+
+		private:
+			TCPImpl& m_impl;
+			uint8 m_skip_buffer[4096];
+		};
+
+
+		struct TCPImpl
+		{
+			explicit TCPImpl(IAllocator& allocator)
+				: m_allocator(allocator)
+				, m_connector(m_allocator)
+				, m_stream(nullptr)
+				, m_send_mutex(false)
+				, m_pending_mutex(false)
+				, m_pending(allocator)
+				, m_next_id(TCP_NO_RESPONSE)
+				, m_is_connected(false)
+				, m_receiver(*this, allocator)
+				, m_cache_hits(0)
+				, m_cache_misses(0)
+			{
+				m_cache_dir[0] = '\0';
+			}
+
+
+			// sends the request and waits for response if there is one, other threads can send
+			// their requests in the meantime
+			bool request(TCPRequest* response,
+				int32 command,
+				uint32 file,
+				const void* payload,
+				uint32 payload_size,
+				const void* payload2 = nullptr,
+				uint32 payload2_size = 0)
+			{
+				TCPRequestHeader header;
+				header.id = TCP_NO_RESPONSE;
+				header.command = command;
+				header.file = file;
+				header.size = payload_size + payload2_size;
+				if (response)
+				{
+					// registered before it is sent, the response can come before send returns
+					MT::SpinLock lock(m_pending_mutex);
+					if (!m_is_connected) return false;
+					++m_next_id;
+					if (m_next_id == TCP_NO_RESPONSE) ++m_next_id;
+					header.id = m_next_id;
+					response->id = header.id;
+					m_pending.push(response);
+				}
+
+				bool success;
+				{
+					MT::Lock lock(m_send_mutex);
+					success = m_stream->write(&header, sizeof(header));
+					if (payload_size > 0) success = success && m_stream->write(payload, payload_size);
+					if (payload2_size > 0) success = success && m_stream->write(payload2, payload2_size);
+				}
+
+				if (!response) return success;
+				if (!success && takePending(response->id)) return false;
+				response->event.wait();
+				return response->result >= 0;
+			}
+
+
+			TCPRequest* takePending(uint32 id)
+			{
+				MT::SpinLock lock(m_pending_mutex);
+				for (int i = 0, c = m_pending.size(); i < c; ++i)
+				{
+					TCPRequest* request = m_pending[i];
+					if (request->id == id)
+					{
+						m_pending.eraseFast(i);
+						return request;
+					}
+				}
+				return nullptr;
+			}
+
+
+			void failPending()
+			{
+				MT::SpinLock lock(m_pending_mutex);
+				m_is_connected = false;
+				for (TCPRequest* request : m_pending)
+				{
+					request->result = -1;
+					request->event.trigger();
+				}
+				m_pending.clear();
+			}
+
+
+			IAllocator& m_allocator;
+			Net::TCPConnector m_connector;
+			Net::TCPStream* m_stream;
+			MT::Mutex m_send_mutex;
+			MT::SpinMutex m_pending_mutex;
+			Array<TCPRequest*> m_pending;
+			uint32 m_next_id;
+			bool m_is_connected;
+			TCPReceiverTask m_receiver;
+			char m_cache_dir[MAX_PATH_LENGTH];
+			volatile int32 m_cache_hits;
+			volatile int32 m_cache_misses;
+		};
+
+
+		bool TCPReceiverTask::skip(Net::TCPStream& stream, size_t size)
+		{
+			while (size > 0)
+			{
+				size_t chunk = Math::minValue(size, sizeof(m_skip_buffer));
+				if (!stream.read(m_skip_buffer, chunk)) return false;
+				size -= chunk;
+			}
+			return true;
+		}
+
+
+		int TCPReceiverTask::task()
+		{
+			Net::TCPStream& stream = *m_impl.m_stream;
+			for (;;)
+			{
+				TCPResponseHeader header;
+				if (!stream.read(&header, sizeof(header))) break;
+
+				TCPRequest* request = m_impl.takePending(header.id);
+				if (!request)
+				{
+					if (!skip(stream, header.size)) break;
+					continue;
+				}
+
+				request->result = header.result;
+				request->size = header.size;
+				bool success = true;
+				if (header.size > 0)
+				{
+					if (request->allocate)
+					{
+						request->buffer = m_impl.m_allocator.allocate(header.size);
+						success = stream.read(request->buffer, header.size);
+					}
+					else if (header.size <= request->capacity)
+					{
+						success = stream.read(request->buffer, header.size);
+					}
+					else
+					{
+						request->result = -1;
+						success = skip(stream, header.size);
+					}
+				}
+				if (!success) request->result = -1;
+				request->event.trigger();
+				if (!success) break;
+			}
+
+			m_impl.failPending();
+			return 0;
+		}
+
+
 		class TCPFile : public IFile
 		{
 		public:
-			TCPFile(Net::TCPStream* stream, TCPFileDevice& device, MT::SpinMutex& spin_mutex) 
+			TCPFile(TCPImpl& impl, TCPFileDevice& device)
 				: m_device(device)
-				, m_stream(stream)
-				, m_spin_mutex(spin_mutex)
+				, m_impl(impl)
 				, m_file(INVALID_FILE)
+				, m_is_fetched(false)
+				, m_data(nullptr)
+				, m_size(0)
+				, m_pos(0)
 			{}
 
-			~TCPFile() {}
+			~TCPFile() { freeData(); }
 
 			IFileDevice& getDevice() override
 			{
@@ -34,139 +251,221 @@ namespace Lumix
 
 			bool open(const Path& path, Mode mode) override
 			{
-				if (!m_stream)
+				int path_size = stringLength(path.c_str()) + 1;
+				if (!(mode & Mode::WRITE))
 				{
-					return false;
+					bool is_cached = m_impl.m_cache_dir[0] != '\0';
+					if (is_cached && openCached(path)) return true;
+
+					TCPRequest response;
+					response.allocate = true;
+					if (!m_impl.request(&response, TCPCommand::ReadFile, INVALID_FILE, path.c_str(), path_size))
+					{
+						if (response.buffer) m_impl.m_allocator.deallocate(response.buffer);
+						return false;
+					}
+					m_data = (uint8*)response.buffer;
+					m_size = response.size;
+					m_pos = 0;
+					m_is_fetched = true;
+					if (is_cached) storeCached(path, (uint32)response.result);
+					return true;
 				}
 
-				int32 op = TCPCommand::OpenFile;
-
-				MT::SpinLock lock(m_spin_mutex);
-				m_stream->write(op);
-				m_stream->write(mode);
-				m_stream->writeString(path.c_str());
-				m_stream->read(m_file);
-
-				return INVALID_FILE != m_file;
+				int32 mode_value = mode.value;
+				TCPRequest response;
+				if (!m_impl.request(&response,
+						TCPCommand::OpenFile,
+						INVALID_FILE,
+						&mode_value,
+						sizeof(mode_value),
+						path.c_str(),
+						path_size))
+				{
+					return false;
+				}
+				m_file = (uint32)response.result;
+				return true;
 			}
 
 			void close() override
 			{
+				if (m_is_fetched)
+				{
+					freeData();
+					return;
+				}
 				if (INVALID_FILE != m_file)
 				{
-					int32 op = TCPCommand::Close;
-
-					MT::SpinLock lock(m_spin_mutex);
-					m_stream->write(op);
-					m_stream->write(m_file);
+					m_impl.request(nullptr, TCPCommand::Close, m_file, nullptr, 0);
+					m_file = INVALID_FILE;
 				}
 			}
 
 			bool read(void* buffer, size_t size) override
 			{
-				int32 op = TCPCommand::Read;
-
-				MT::SpinLock lock(m_spin_mutex);
-				m_stream->write(op);
-				m_stream->write(m_file);
-				m_stream->write(size);
-
-				m_stream->read(buffer, size);
-				bool successful = false;
-				m_stream->read(successful);
+				if (m_is_fetched)
+				{
+					size_t amount = m_pos + size < m_size ? size : m_size - m_pos;
+					copyMemory(buffer, m_data + m_pos, amount);
+					m_pos += amount;
+					return amount == size;
+				}
 
-				return successful;
+				uint32 size32 = (uint32)size;
+				TCPRequest response;
+				response.buffer = buffer;
+				response.capacity = size;
+				return m_impl.request(&response, TCPCommand::Read, m_file, &size32, sizeof(size32)) &&
+					   response.result > 0 && response.size == size;
 			}
 
 			bool write(const void* buffer, size_t size) override
 			{
-				int32 op = TCPCommand::Write;
+				if (m_is_fetched) return false;
 
-				MT::SpinLock lock(m_spin_mutex);
-				m_stream->write(op);
-				m_stream->write(m_file);
-				m_stream->write(size);
-				m_stream->write(buffer, size);
-
-				bool successful = false;
-				m_stream->read(successful);
-
-				return successful;
+				TCPRequest response;
+				return m_impl.request(&response, TCPCommand::Write, m_file, buffer, (uint32)size) &&
+					   response.result > 0;
 			}
 
 			const void* getBuffer() const override
 			{
-				return nullptr;
+				return m_is_fetched ? m_data : nullptr;
 			}
 
 			size_t size() override
 			{
-				int32 op = TCPCommand::Size;
-				uint32 size = 0;
-
-				MT::SpinLock lock(m_spin_mutex);
-				m_stream->write(op);
-				m_stream->write(m_file);
+				if (m_is_fetched) return m_size;
 
-				m_stream->read(size);
-
-				return (size_t)size;
+				TCPRequest response;
+				if (!m_impl.request(&response, TCPCommand::Size, m_file, nullptr, 0)) return 0;
+				return (size_t)response.result;
 			}
 
 			size_t seek(SeekMode base, size_t pos) override
 			{
-				int32 op = TCPCommand::Seek;
+				if (m_is_fetched)
+				{
+					switch (base)
+					{
+						case SeekMode::BEGIN: m_pos = pos; break;
+						case SeekMode::CURRENT: m_pos += pos; break;
+						case SeekMode::END: m_pos = m_size - pos; break;
+						default: ASSERT(0); break;
+					}
+					m_pos = Math::minValue(m_pos, m_size);
+					return m_pos;
+				}
 
-				MT::SpinLock lock(m_spin_mutex);
-				m_stream->write(op);
-				m_stream->write(m_file);
-				m_stream->write(base);
-				m_stream->write(pos);
+				TCPSeekRequest payload;
+				payload.base = base.value;
+				payload.reserved = 0;
+				payload.pos = pos;
+				TCPRequest response;
+				if (!m_impl.request(&response, TCPCommand::Seek, m_file, &payload, sizeof(payload))) return 0;
+				return (size_t)response.result;
+			}
 
-				int32 ret = 0;
-				m_stream->read(ret);
+			size_t pos() override
+			{
+				if (m_is_fetched) return m_pos;
 
-				return (size_t)ret;
+				TCPRequest response;
+				if (!m_impl.request(&response, TCPCommand::Pos, m_file, nullptr, 0)) return 0;
+				return (size_t)response.result;
 			}
 
-			size_t pos() override
+		private:
+			void getCachePath(const Path& path, uint32 hash, char (&cache_path)[MAX_PATH_LENGTH]) const
+			{
+				char tmp[20];
+				copyString(cache_path, m_impl.m_cache_dir);
+				toCString(path.getHash(), tmp, lengthOf(tmp));
+				catString(cache_path, tmp);
+				catString(cache_path, "_");
+				toCString(hash, tmp, lengthOf(tmp));
+				catString(cache_path, tmp);
+			}
+
+
+			bool openCached(const Path& path)
 			{
-				int32 op = TCPCommand::Seek;
-				int32 pos = 0;
+				uint64 size = 0;
+				TCPRequest response;
+				response.buffer = &size;
+				response.capacity = sizeof(size);
+				int path_size = stringLength(path.c_str()) + 1;
+				if (!m_impl.request(&response, TCPCommand::FileHash, INVALID_FILE, path.c_str(), path_size) ||
+					response.size != sizeof(size))
+				{
+					return false;
+				}
+
+				char cache_path[MAX_PATH_LENGTH];
+				getCachePath(path, (uint32)response.result, cache_path);
+				OsFile file;
+				if (!file.open(cache_path, Mode::OPEN_AND_READ, m_impl.m_allocator))
+				{
+					MT::atomicIncrement(&m_impl.m_cache_misses);
+					return false;
+				}
+
+				// a file which was not written completely has a different size
+				bool success = file.size() == size;
+				if (success && size > 0)
+				{
+					m_data = (uint8*)m_impl.m_allocator.allocate((size_t)size);
+					success = file.read(m_data, (size_t)size);
+				}
+				file.close();
+				if (!success)
+				{
+					freeData();
+					MT::atomicIncrement(&m_impl.m_cache_misses);
+					return false;
+				}
 
-				MT::SpinLock lock(m_spin_mutex);
-				m_stream->write(op);
-				m_stream->write(m_file);
+				m_size = (size_t)size;
+				m_pos = 0;
+				m_is_fetched = true;
+				MT::atomicIncrement(&m_impl.m_cache_hits);
+				return true;
+			}
 
-				m_stream->read(pos);
 
-				return (size_t)pos;
+			void storeCached(const Path& path, uint32 hash)
+			{
+				char cache_path[MAX_PATH_LENGTH];
+				getCachePath(path, hash, cache_path);
+				OsFile file;
+				if (!file.open(cache_path, Mode::CREATE | Mode::WRITE, m_impl.m_allocator)) return;
+				if (m_size > 0) file.write(m_data, m_size);
+				file.close();
+			}
+
+
+			void freeData()
+			{
+				if (m_data) m_impl.m_allocator.deallocate(m_data);
+				m_data = nullptr;
+				m_size = 0;
+				m_pos = 0;
+				m_is_fetched = false;
 			}
 
-		private:
 			void operator=(const TCPFile&);
 			TCPFile(const TCPFile&);
 
 			TCPFileDevice& m_device;
-			Net::TCPStream* m_stream;
-			MT::SpinMutex& m_spin_mutex;
+			TCPImpl& m_impl;
 			uint32 m_file;
+			bool m_is_fetched;
+			uint8* m_data;
+			size_t m_size;
+			size_t m_pos;
 		};
 
-		struct TCPImpl
-		{
-			explicit TCPImpl(IAllocator& allocator)
-				: m_spin_mutex(false)
-				, m_allocator(allocator)
-				, m_connector(m_allocator)
-				, m_stream(nullptr)
-			{}
-
-			IAllocator& m_allocator;
-			Net::TCPConnector m_connector;
-			Net::TCPStream* m_stream;
-			MT::SpinMutex m_spin_mutex;
-		};
 
 		TCPFileDevice::TCPFileDevice()
 			: m_impl(nullptr)
@@ -175,7 +474,7 @@ namespace Lumix
 
 		IFile* TCPFileDevice::createFile(IFile*)
 		{
-			return LUMIX_NEW(m_impl->m_allocator, TCPFile)(m_impl->m_stream, *this, m_impl->m_spin_mutex);
+			return LUMIX_NEW(m_impl->m_allocator, TCPFile)(*m_impl, *this);
 		}
 
 		void TCPFileDevice::destroyFile(IFile* file)
@@ -187,13 +486,42 @@ namespace Lumix
 		{
 			m_impl = LUMIX_NEW(allocator, TCPImpl)(allocator);
 			m_impl->m_stream = m_impl->m_connector.connect(ip, port);
+			if (!m_impl->m_stream) return;
+
+			m_impl->m_is_connected = true;
+			m_impl->m_receiver.create("TCP File Device Receiver");
+			m_impl->m_receiver.run();
+		}
+
+		void TCPFileDevice::setCacheDirectory(const char* path)
+		{
+			copyString(m_impl->m_cache_dir, path);
+			int len = stringLength(m_impl->m_cache_dir);
+			if (len > 0 && m_impl->m_cache_dir[len - 1] != '/' && m_impl->m_cache_dir[len - 1] != '\\')
+			{
+				catString(m_impl->m_cache_dir, "/");
+			}
+		}
+
+		TCPFileDevice::CacheStats TCPFileDevice::getCacheStats() const
+		{
+			CacheStats stats;
+			stats.hits = m_impl->m_cache_hits;
+			stats.misses = m_impl->m_cache_misses;
+			return stats;
 		}
 
 		void TCPFileDevice::disconnect()
 		{
-			m_impl->m_stream->write(TCPCommand::Disconnect);
-			m_impl->m_connector.close(m_impl->m_stream);
+			if (m_impl->m_stream)
+			{
+				// the server closes the connection, that stops the receiver
+				m_impl->request(nullptr, TCPCommand::Disconnect, INVALID_FILE, nullptr, 0);
+				m_impl->m_receiver.destroy();
+				m_impl->m_connector.close(m_impl->m_stream);
+			}
 			LUMIX_DELETE(m_impl->m_allocator, m_impl);
+			m_impl = nullptr;
 		}
 	} // namespace FS
 } // ~namespace Lumix
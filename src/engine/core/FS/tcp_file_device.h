@@ -30,6 +30,10 @@ namespace Lumix
 				Seek,
 				Pos,
 				Disconnect,
+				// opens, reads the whole file and closes it in one request, result is crc32 of the file
+				ReadFile,
+				// result is crc32 of the file, payload of the response is uint64 size of the file
+				FileHash,
 			};
 
 			TCPCommand() : value(0) {}
@@ -39,8 +43,49 @@ namespace Lumix
 			int32 value;
 		};
 
+		// Every request starts with this header and it is followed by size bytes of payload.
+		// Requests are identified by id, so a client can send many of them without waiting,
+		// the server answers in the order it handles them. Requests with TCP_NO_RESPONSE id,
+		// e.g. Close, are not answered.
+		struct TCPRequestHeader
+		{
+			uint32 id;
+			int32 command;
+			uint32 file;
+			uint32 size;
+		};
+
+		struct TCPResponseHeader
+		{
+			uint32 id;
+			uint32 size;
+			int64 result;
+		};
+
+		struct TCPSeekRequest
+		{
+			uint32 base;
+			uint32 reserved;
+			uint64 pos;
+		};
+
+		static const uint32 TCP_NO_RESPONSE = 0;
+		static const uint16 TCP_FILE_SERVER_PORT = 10001;
+
+		// Files opened only for reading are fetched whole by one ReadFile request and served
+		// from memory, other files send a request for each operation. Requests from different
+		// threads share one connection and are pipelined.
+		// With a cache directory, fetched files are stored there under their path and content hash,
+		// next time only the hash is requested and unchanged files are read from the local disk.
 		class LUMIX_ENGINE_API TCPFileDevice : public IFileDevice
 		{
+		public:
+			struct CacheStats
+			{
+				int hits;
+				int misses;
+			};
+
 		public:
 			TCPFileDevice();
 
@@ -50,8 +95,11 @@ namespace Lumix
 
 			void connect(const char* ip, uint16 port, IAllocator& allocator);
 			void disconnect();
+			// the directory must exist, empty path disables the cache
+			void setCacheDirectory(const char* path);
+			CacheStats getCacheStats() const;
 
-			Net::TCPStream* getStream();
+			TCPImpl& getImpl() { return *m_impl; }
 
 		private:
 			TCPImpl* m_impl;
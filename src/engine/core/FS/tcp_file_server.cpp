@@ -1,14 +1,15 @@
 #include "core/fs/tcp_file_server.h"
 
 #include "core/array.h"
-#include "core/free_list.h"
+#include "core/crc32.h"
 #include "core/fs/os_file.h"
 #include "core/fs/tcp_file_device.h"
+#include "core/log.h"
+#include "core/mt/sync.h"
 #include "core/mt/task.h"
 #include "core/path.h"
 #include "core/profiler.h"
 #include "core/stack_allocator.h"
-#include "core/static_array.h"
 #include "core/string.h"
 #include "core/network.h"
 
@@ -21,202 +22,308 @@ namespace FS
 {
 
 
-class TCPFileServerTask : public MT::Task
+static const uint32 MAX_PAYLOAD_SIZE = 0x40000000;
+
+
+// Handles requests of one client, every client has its own thread and files.
+class TCPFileServerClient : public MT::Task
 {
 public:
-	explicit TCPFileServerTask(IAllocator& allocator)
+	TCPFileServerClient(Net::TCPStream* stream, const Path& base_path, IAllocator& allocator)
 		: MT::Task(allocator)
-		, m_acceptor(allocator)
+		, m_stream(stream)
+		, m_base_path(base_path)
+		, m_files(allocator)
+		, m_payload(allocator)
+		, m_response(allocator)
+		, m_is_finished(false)
 	{
 	}
 
 
-	~TCPFileServerTask()
+	~TCPFileServerClient()
 	{
+		for (OsFile* file : m_files)
+		{
+			if (!file) continue;
+			file->close();
+			LUMIX_DELETE(getAllocator(), file);
+		}
 	}
 
 
-	void openFile(Net::TCPStream* stream)
-	{
-		int32 mode = 0;
-		stream->read(mode);
-		stream->readString(m_buffer.data(), m_buffer.size());
+	Net::TCPStream* getStream() const { return m_stream; }
+	bool isClientFinished() const { return m_is_finished; }
 
-		int32 ret = -2;
-		int32 id = m_ids.alloc();
-		if (id > 0)
-		{
-			OsFile* file = LUMIX_NEW(getAllocator(), OsFile)();
-			m_files[id] = file;
 
-			char path[MAX_PATH_LENGTH];
-			if (compareStringN(m_buffer.data(), m_base_path.c_str(), m_base_path.length()) != 0)
-			{
-				copyString(path, m_base_path.c_str());
-				catString(path, m_buffer.data());
-			}
-			else
-			{
-				copyString(path, m_buffer.data());
-			}
-			ret = file->open(path, mode, getAllocator()) ? id : -1;
-			if (ret == -1)
+	int task() override
+	{
+		for (;;)
+		{
+			TCPRequestHeader header;
+			if (!m_stream->read(&header, sizeof(header))) break;
+			if (header.size > MAX_PAYLOAD_SIZE)
 			{
-				m_ids.release(id);
-				file->close();
-				LUMIX_DELETE(getAllocator(), file);
+				g_log_error.log("FS") << "Invalid request to file server";
+				break;
 			}
+
+			m_payload.resize(header.size + 1);
+			if (header.size > 0 && !m_stream->read(&m_payload[0], header.size)) break;
+			// paths are at the end of the payload, this makes sure they are terminated
+			m_payload[header.size] = 0;
+
+			PROFILE_BLOCK("File server operation");
+			if (header.command == TCPCommand::Disconnect) break;
+			if (!handle(header)) break;
 		}
-		stream->write(ret);
+		m_is_finished = true;
+		return 0;
 	}
 
-
-	void read(Net::TCPStream* stream)
+private:
+	void getFullPath(const char* path, char (&full_path)[MAX_PATH_LENGTH]) const
 	{
-		bool read_successful = true;
-		uint32 id = 0xffffFFFF;
-		stream->read(id);
-		OsFile* file = m_files[id];
-
-		uint32 size = 0;
-		stream->read(size);
-
-		while (size > 0)
+		if (compareStringN(path, m_base_path.c_str(), stringLength(m_base_path.c_str())) != 0)
 		{
-			int32 read = (int32)size > m_buffer.size() ? m_buffer.size()
-														   : (int32)size;
-			read_successful &= file->read((void*)m_buffer.data(), read);
-			stream->write((const void*)m_buffer.data(), read);
-			size -= read;
+			copyString(full_path, m_base_path.c_str());
+			catString(full_path, path);
+		}
+		else
+		{
+			copyString(full_path, path);
 		}
-
-		stream->write(read_successful);
 	}
 
 
-	void close(Net::TCPStream* stream)
+	OsFile* getFile(uint32 id) const
 	{
-		uint32 id = 0xffffFFFF;
-		stream->read(id);
-		OsFile* file = m_files[id];
-		m_ids.release(id);
+		return id < (uint32)m_files.size() ? m_files[id] : nullptr;
+	}
 
-		file->close();
-		LUMIX_DELETE(getAllocator(), file);
+
+	bool respond(const TCPRequestHeader& request, int64 result, const void* payload, uint32 size)
+	{
+		if (request.id == TCP_NO_RESPONSE) return true;
+
+		TCPResponseHeader header;
+		header.id = request.id;
+		header.size = size;
+		header.result = result;
+		bool success = m_stream->write(&header, sizeof(header));
+		if (size > 0) success = success && m_stream->write(payload, size);
+		return success;
 	}
 
 
-	void write(Net::TCPStream* stream)
+	bool openFile(const TCPRequestHeader& request)
 	{
-		bool write_successful = true;
-		uint32 id = 0xffffFFFF;
-		stream->read(id);
-		OsFile* file = m_files[id];
+		if (request.size < sizeof(int32)) return respond(request, -1, nullptr, 0);
 
-		uint32 size = 0;
-		stream->read(size);
+		int32 mode = *(int32*)&m_payload[0];
+		char path[MAX_PATH_LENGTH];
+		getFullPath((const char*)&m_payload[sizeof(int32)], path);
 
-		while (size > 0)
+		OsFile* file = LUMIX_NEW(getAllocator(), OsFile)();
+		if (!file->open(path, mode, getAllocator()))
 		{
-			int32 read = (int32)size > m_buffer.size() ? m_buffer.size()
-														   : (int32)size;
-			write_successful &= stream->read((void*)m_buffer.data(), read);
-			file->write(m_buffer.data(), read);
-			size -= read;
+			LUMIX_DELETE(getAllocator(), file);
+			return respond(request, -1, nullptr, 0);
 		}
 
-		stream->write(write_successful);
+		int id = m_files.indexOf(nullptr);
+		if (id < 0)
+		{
+			id = m_files.size();
+			m_files.push(file);
+		}
+		else
+		{
+			m_files[id] = file;
+		}
+		return respond(request, id, nullptr, 0);
 	}
 
 
-	void seek(Net::TCPStream* stream)
+	bool readFile(const TCPRequestHeader& request)
 	{
-		uint32 id = 0xffffFFFF;
-		stream->read(id);
-		OsFile* file = m_files[id];
+		char path[MAX_PATH_LENGTH];
+		getFullPath((const char*)&m_payload[0], path);
+
+		OsFile file;
+		if (!file.open(path, Mode::OPEN_AND_READ, getAllocator())) return respond(request, -1, nullptr, 0);
+
+		size_t size = file.size();
+		m_response.resize((int)size);
+		bool success = size == 0 || file.read(&m_response[0], size);
+		file.close();
+		if (!success) return respond(request, -1, nullptr, 0);
+		const void* data = m_response.empty() ? nullptr : &m_response[0];
+		return respond(request, crc32(data, (int)size), data, (uint32)size);
+	}
 
-		uint32 base = 0;
-		int32 offset = 0;
-		stream->read(base);
-		stream->read(offset);
 
-		uint32 pos = (uint32)file->seek((SeekMode)base, offset);
-		stream->write(pos);
+	bool fileHash(const TCPRequestHeader& request)
+	{
+		char path[MAX_PATH_LENGTH];
+		getFullPath((const char*)&m_payload[0], path);
+
+		OsFile file;
+		if (!file.open(path, Mode::OPEN_AND_READ, getAllocator())) return respond(request, -1, nullptr, 0);
+
+		// reading the file here is much cheaper than sending it
+		uint64 size = file.size();
+		m_response.resize((int)size);
+		bool success = size == 0 || file.read(&m_response[0], (size_t)size);
+		file.close();
+		if (!success) return respond(request, -1, nullptr, 0);
+		const void* data = m_response.empty() ? nullptr : &m_response[0];
+		return respond(request, crc32(data, (int)size), &size, sizeof(size));
 	}
 
 
-	void size(Net::TCPStream* stream)
+	bool close(const TCPRequestHeader& request)
 	{
-		uint32 id = 0xffffFFFF;
-		stream->read(id);
-		OsFile* file = m_files[id];
+		OsFile* file = getFile(request.file);
+		if (file)
+		{
+			file->close();
+			LUMIX_DELETE(getAllocator(), file);
+			m_files[request.file] = nullptr;
+		}
+		return respond(request, 1, nullptr, 0);
+	}
+
 
-		uint32 size = (uint32)file->size();
-		stream->write(size);
+	bool read(const TCPRequestHeader& request)
+	{
+		OsFile* file = getFile(request.file);
+		if (!file || request.size < sizeof(uint32)) return respond(request, -1, nullptr, 0);
+
+		uint32 size = *(uint32*)&m_payload[0];
+		if (size > MAX_PAYLOAD_SIZE) return respond(request, -1, nullptr, 0);
+		m_response.resize(size);
+		bool success = size == 0 || file->read(&m_response[0], size);
+		return respond(request, success ? 1 : 0, m_response.empty() ? nullptr : &m_response[0], size);
 	}
 
 
-	void pos(Net::TCPStream* stream)
+	bool write(const TCPRequestHeader& request)
 	{
-		uint32 id = 0xffffFFFF;
-		stream->read(id);
-		OsFile* file = m_files[id];
+		OsFile* file = getFile(request.file);
+		if (!file) return respond(request, -1, nullptr, 0);
 
-		uint32 pos = (uint32)file->pos();
-		stream->write(pos);
+		bool success = request.size == 0 || file->write(&m_payload[0], request.size);
+		return respond(request, success ? 1 : 0, nullptr, 0);
 	}
 
 
-	int task()
+	bool handle(const TCPRequestHeader& request)
 	{
-		bool quit = false;
+		switch (request.command)
+		{
+			case TCPCommand::OpenFile: return openFile(request);
+			case TCPCommand::ReadFile: return readFile(request);
+			case TCPCommand::FileHash: return fileHash(request);
+			case TCPCommand::Close: return close(request);
+			case TCPCommand::Read: return read(request);
+			case TCPCommand::Write: return write(request);
+			case TCPCommand::Size:
+			{
+				OsFile* file = getFile(request.file);
+				return respond(request, file ? (int64)file->size() : -1, nullptr, 0);
+			}
+			case TCPCommand::Pos:
+			{
+				OsFile* file = getFile(request.file);
+				return respond(request, file ? (int64)file->pos() : -1, nullptr, 0);
+			}
+			case TCPCommand::Seek:
+			{
+				OsFile* file = getFile(request.file);
+				if (!file || request.size < sizeof(TCPSeekRequest)) return respond(request, -1, nullptr, 0);
+				const TCPSeekRequest& seek = *(const TCPSeekRequest*)&m_payload[0];
+				return respond(request, (int64)file->seek(seek.base, (size_t)seek.pos), nullptr, 0);
+			}
+			default:
+				g_log_error.log("FS") << "Unknown file server command " << request.command;
+				return false;
+		}
+	}
+
+private:
+	Net::TCPStream* m_stream;
+	Path m_base_path;
+	Array<OsFile*> m_files;
+	Array<uint8> m_payload;
+	Array<uint8> m_response;
+	volatile bool m_is_finished;
+};
 
-		m_acceptor.start("127.0.0.1", 10001);
-		Net::TCPStream* stream = m_acceptor.accept();
 
-		while (!quit)
+class TCPFileServerTask : public MT::Task
+{
+public:
+	explicit TCPFileServerTask(IAllocator& allocator)
+		: MT::Task(allocator)
+		, m_acceptor(allocator)
+		, m_clients(allocator)
+		, m_clients_mutex(false)
+		, m_quit(false)
+	{
+	}
+
+
+	~TCPFileServerTask()
+	{
+		ASSERT(m_clients.empty());
+	}
+
+
+	int task() override
+	{
+		if (!m_acceptor.start("127.0.0.1", TCP_FILE_SERVER_PORT))
 		{
-			PROFILE_BLOCK("File server operation")
-			int32 op = 0;
-			stream->read(op);
-			switch (op)
+			g_log_error.log("FS") << "File server could not listen on port " << TCP_FILE_SERVER_PORT;
+			return -1;
+		}
+
+		while (!m_quit)
+		{
+			Net::TCPStream* stream = m_acceptor.accept();
+			if (!stream) break;
+			if (m_quit)
 			{
-				case TCPCommand::OpenFile:
-					openFile(stream);
-					break;
-				case TCPCommand::Close:
-					close(stream);
-					break;
-				case TCPCommand::Read:
-					read(stream);
-					break;
-				case TCPCommand::Write:
-					write(stream);
-					break;
-				case TCPCommand::Size:
-					size(stream);
-					break;
-				case TCPCommand::Seek:
-					seek(stream);
-					break;
-				case TCPCommand::Pos:
-					pos(stream);
-					break;
-				case TCPCommand::Disconnect:
-					quit = true;
-					break;
-				default:
-					ASSERT(0);
-					break;
+				m_acceptor.close(stream);
+				break;
 			}
-		}
 
-		m_acceptor.close(stream);
+			MT::Lock lock(m_clients_mutex);
+			destroyClients(false);
+			auto* client = LUMIX_NEW(getAllocator(), TCPFileServerClient)(stream, m_base_path, getAllocator());
+			client->create("TCP File Server Client");
+			client->run();
+			m_clients.push(client);
+		}
 		return 0;
 	}
 
 
-	void stop() {}
+	void stop()
+	{
+		m_quit = true;
+		// wakes up the blocking accept
+		Net::TCPConnector connector(getAllocator());
+		Net::TCPStream* stream = connector.connect("127.0.0.1", TCP_FILE_SERVER_PORT);
+		if (stream) connector.close(stream);
+
+		MT::Lock lock(m_clients_mutex);
+		for (TCPFileServerClient* client : m_clients)
+		{
+			client->getStream()->shutdown();
+		}
+		destroyClients(true);
+	}
 
 
 	void setBasePath(const char* base_path)
@@ -233,12 +340,27 @@ public:
 
 	const char* getBasePath() const { return m_base_path.c_str(); }
 
+private:
+	void destroyClients(bool all)
+	{
+		for (int i = m_clients.size() - 1; i >= 0; --i)
+		{
+			TCPFileServerClient* client = m_clients[i];
+			if (!all && !client->isClientFinished()) continue;
+
+			client->destroy();
+			m_acceptor.close(client->getStream());
+			LUMIX_DELETE(getAllocator(), client);
+			m_clients.eraseFast(i);
+		}
+	}
+
 private:
 	Net::TCPAcceptor m_acceptor;
-	StaticArray<char, 0x50000> m_buffer;
-	StaticArray<OsFile*, 0x50000> m_files;
-	FreeList<int32, 0x50000> m_ids;
+	Array<TCPFileServerClient*> m_clients;
+	MT::Mutex m_clients_mutex;
 	Path m_base_path;
+	volatile bool m_quit;
 };
 
 
@@ -0,0 +1,43 @@
+#pragma once
+
+
+#include "lumix.h"
+
+
+namespace Lumix
+{
+
+
+namespace MT
+{
+
+
+namespace Fiber
+{
+
+
+typedef void* Handle;
+#ifdef _WIN32
+	#define LUMIX_FIBER_CALL __stdcall
+#else
+	#define LUMIX_FIBER_CALL
+#endif
+typedef void(LUMIX_FIBER_CALL* FiberProc)(void*);
+
+
+LUMIX_ENGINE_API Handle create(int stack_size, FiberProc proc, void* parameter);
+LUMIX_ENGINE_API void destroy(Handle fiber);
+// the fiber which runs on the calling thread, the thread is converted to a fiber the first time
+LUMIX_ENGINE_API Handle getCurrent();
+// undoes the conversion done by getCurrent(), the thread must be running its own fiber
+LUMIX_ENGINE_API void convertToThread();
+LUMIX_ENGINE_API void switchTo(Handle fiber);
+
+
+} // namespace Fiber
+
+
+} // namespace MT
+
+
+} // namespace Lumix
@@ -0,0 +1,184 @@
+#pragma once
+
+#include "core/array.h"
+#include "core/iallocator.h"
+#include "core/mt/atomic.h"
+#include "core/mt/sync.h"
+
+
+namespace Lumix
+{
+	namespace MT
+	{
+		// Drop-in replacement for LockFreeFixedQueue which never runs out of slots.
+		// Items are allocated from a pool which grows by chunk_size items, the queue
+		// itself is a ring buffer which doubles when full. Both are guarded by a spin mutex
+		// which is held only for a few instructions.
+		template <class T, int32 chunk_size>
+		class GrowableQueue
+		{
+			static_assert((chunk_size & (chunk_size - 1)) == 0, "chunk_size must be a power of two");
+
+		public:
+			explicit GrowableQueue(IAllocator& allocator)
+				: m_allocator(allocator)
+				, m_chunks(allocator)
+				, m_free(allocator)
+				, m_queue(nullptr)
+				, m_queue_capacity(0)
+				, m_rd(0)
+				, m_wr(0)
+				, m_allocated(0)
+				, m_allocated_high_water_mark(0)
+				, m_queued_high_water_mark(0)
+				, m_aborted(false)
+				, m_mutex(false)
+				, m_data_signal(0, 0x7fffFFFF)
+			{
+			}
+
+			~GrowableQueue()
+			{
+				for (auto* chunk : m_chunks)
+				{
+					m_allocator.deallocate_aligned(chunk);
+				}
+				m_allocator.deallocate(m_queue);
+			}
+
+			T* alloc(bool)
+			{
+				T* val;
+				{
+					SpinLock lock(m_mutex);
+					if (m_free.empty())
+					{
+						grow();
+					}
+					val = m_free.back();
+					m_free.pop();
+					++m_allocated;
+					if (m_allocated > m_allocated_high_water_mark)
+					{
+						m_allocated_high_water_mark = m_allocated;
+					}
+				}
+				new (NewPlaceholder(), val) T();
+				return val;
+			}
+
+			void dealoc(T* tr)
+			{
+				tr->~T();
+				SpinLock lock(m_mutex);
+				m_free.push(tr);
+				--m_allocated;
+			}
+
+			bool push(const T* tr, bool)
+			{
+				{
+					SpinLock lock(m_mutex);
+					if (m_wr - m_rd == m_queue_capacity)
+					{
+						growQueue();
+					}
+					m_queue[m_wr & (m_queue_capacity - 1)] = const_cast<T*>(tr);
+					++m_wr;
+					int32 queued = m_wr - m_rd;
+					if (queued > m_queued_high_water_mark)
+					{
+						m_queued_high_water_mark = queued;
+					}
+				}
+				m_data_signal.signal();
+				return true;
+			}
+
+			// waiting for data spins on the indices and parks on the semaphore after the spin
+			// limit, so idle workers do not burn CPU
+			T* pop(bool wait)
+			{
+				if (wait)
+				{
+					Backoff backoff;
+					while (m_rd == m_wr && !m_aborted && backoff.spin()) {}
+				}
+				bool can_read = wait ? m_data_signal.wait(), wait : m_data_signal.poll();
+
+				if (isAborted() || !can_read)
+				{
+					return nullptr;
+				}
+
+				SpinLock lock(m_mutex);
+				ASSERT(m_rd != m_wr);
+				T* val = m_queue[m_rd & (m_queue_capacity - 1)];
+				++m_rd;
+				return val;
+			}
+
+			bool isAborted() const
+			{
+				return m_aborted;
+			}
+
+			bool isEmpty() const
+			{
+				return m_rd == m_wr;
+			}
+
+			void abort()
+			{
+				m_aborted = true;
+				m_data_signal.signal();
+			}
+
+			int32 getAllocatedHighWaterMark() const { return m_allocated_high_water_mark; }
+			int32 getQueuedHighWaterMark() const { return m_queued_high_water_mark; }
+			int32 getCapacity() const { return m_chunks.size() * chunk_size; }
+
+		private:
+			void grow()
+			{
+				T* chunk = (T*)m_allocator.allocate_aligned(sizeof(T) * chunk_size, ALIGN_OF(T));
+				m_chunks.push(chunk);
+				m_free.reserve(m_chunks.size() * chunk_size);
+				for (int32 i = chunk_size - 1; i >= 0; --i)
+				{
+					m_free.push(&chunk[i]);
+				}
+			}
+
+			void growQueue()
+			{
+				int32 new_capacity = m_queue_capacity == 0 ? chunk_size : m_queue_capacity * 2;
+				T** new_queue = (T**)m_allocator.allocate(sizeof(T*) * new_capacity);
+				for (int32 i = 0; i < m_wr - m_rd; ++i)
+				{
+					new_queue[i] = m_queue[(m_rd + i) & (m_queue_capacity - 1)];
+				}
+				m_wr = m_wr - m_rd;
+				m_rd = 0;
+				m_allocator.deallocate(m_queue);
+				m_queue = new_queue;
+				m_queue_capacity = new_capacity;
+			}
+
+		private:
+			IAllocator& m_allocator;
+			Array<T*> m_chunks;
+			Array<T*> m_free;
+			T** m_queue;
+			int32 m_queue_capacity;
+			volatile int32 m_rd;
+			volatile int32 m_wr;
+			int32 m_allocated;
+			int32 m_allocated_high_water_mark;
+			int32 m_queued_high_water_mark;
+			volatile bool m_aborted;
+			SpinMutex m_mutex;
+			Semaphore m_data_signal;
+		};
+	} // ~namespace MT
+} // ~namespace Lumix
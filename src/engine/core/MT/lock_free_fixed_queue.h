@@ -18,8 +18,10 @@ namespace Lumix
 				, m_fr(0)
 				, m_rd(0)
 				, m_wr(0)
+				, m_alloc_waiters(0)
 				, m_aborted(false)
 				, m_data_signal(0, size)
+				, m_free_signal(0, 0x7fffFFFF)
 			{
 				for (int32 i = 0; i < size; i++)
 				{
@@ -34,11 +36,23 @@ namespace Lumix
 			{
 			}
 
+			// waiting for a free slot parks the thread until dealoc() after a short spin
 			T* alloc(bool wait)
 			{
+				Backoff backoff;
 				do
 				{
-					if ((m_al - m_fr) < size)
+					if ((m_al - m_fr) >= size)
+					{
+						if (wait && !backoff.spin())
+						{
+							atomicIncrement(&m_alloc_waiters);
+							// dealoc() could free the slot before it sees the waiter
+							if ((m_al - m_fr) >= size) m_free_signal.wait();
+							atomicDecrement(&m_alloc_waiters);
+						}
+					}
+					else
 					{
 						int32 alloc_ptr = m_al;
 						int32 alloc_idx = alloc_ptr & (size - 1);
@@ -57,6 +71,7 @@ namespace Lumix
 								return val;
 							}
 						}
+						if (wait) backoff.pause();
 					}
 				} while (wait);
 
@@ -72,6 +87,7 @@ namespace Lumix
 				Node cur_val(0, -1);
 				Node new_val(0, idx);
 
+				Backoff backoff;
 				for(;;)
 				{
 					int32 free_ptr = m_fr;
@@ -84,7 +100,9 @@ namespace Lumix
 						atomicIncrement(&m_fr);
 						break;
 					}
+					backoff.pause();
 				};
+				if (m_alloc_waiters > 0) m_free_signal.signal();
 			}
 
 			bool push(const T* tr, bool wait)
@@ -92,6 +110,7 @@ namespace Lumix
 				int32 idx = int32(tr - (T*)m_pool);
 				ASSERT(idx >= 0 && idx < size);
 
+				Backoff backoff;
 				do
 				{
 					ASSERT((m_wr - m_rd) < size);
@@ -111,17 +130,27 @@ namespace Lumix
 						m_data_signal.signal();
 						return true;
 					}
+					if (wait) backoff.pause();
 				} while (wait);
 
 				return false;
 			}
 
+			// waiting for data spins on the indices, which is cheaper than polling the semaphore,
+			// and parks on the semaphore after the spin limit
 			T* pop(bool wait)
 			{
+				Backoff backoff;
+				if (wait)
+				{
+					while (m_rd == m_wr && !m_aborted && backoff.spin()) {}
+				}
 				bool can_read = wait ? m_data_signal.wait(), wait : m_data_signal.poll();
 
 				if (isAborted())
 				{
+					// wake up the next waiting consumer, so all of them can see the abort
+					m_data_signal.signal();
 					return nullptr;
 				}
 
@@ -145,6 +174,7 @@ namespace Lumix
 							}
 						}
 					}
+					backoff.pause();
 				}
 
 				return nullptr;
@@ -199,8 +229,10 @@ namespace Lumix
 			Node				m_alloc[size];
 			Node				m_queue[size];
 			uint8				m_pool[sizeof(T) * size];
+			volatile int32		m_alloc_waiters;
 			volatile bool		m_aborted;
 			MT::Semaphore		m_data_signal;
+			MT::Semaphore		m_free_signal;
 		};
 	} // ~namespace MT
 } // ~namespace Lumix
@@ -0,0 +1,48 @@
+#include "lumix.h"
+#include "core/mt/fiber.h"
+#include "core/pc/simple_win.h"
+#include <Windows.h>
+
+
+namespace Lumix
+{
+namespace MT
+{
+namespace Fiber
+{
+
+
+Handle create(int stack_size, FiberProc proc, void* parameter)
+{
+	return ::CreateFiber(stack_size, proc, parameter);
+}
+
+
+void destroy(Handle fiber)
+{
+	::DeleteFiber(fiber);
+}
+
+
+Handle getCurrent()
+{
+	if (::IsThreadAFiber()) return ::GetCurrentFiber();
+	return ::ConvertThreadToFiber(nullptr);
+}
+
+
+void convertToThread()
+{
+	if (::IsThreadAFiber()) ::ConvertFiberToThread();
+}
+
+
+void switchTo(Handle fiber)
+{
+	::SwitchToFiber(fiber);
+}
+
+
+} // namespace Fiber
+} // namespace MT
+} // namespace Lumix
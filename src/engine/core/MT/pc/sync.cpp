@@ -3,6 +3,7 @@
 #include "core/mt/thread.h"
 #include "core/pc/simple_win.h"
 #include <Windows.h>
+#include <intrin.h>
 
 
 namespace Lumix
@@ -11,6 +12,103 @@ namespace MT
 {
 
 
+struct WaitCounters
+{
+	volatile LONG spin_limit;
+	volatile LONG64 spin_count;
+	volatile LONG64 park_count;
+	volatile LONG64 spin_ticks;
+	volatile LONG64 park_ticks;
+};
+
+
+static WaitCounters g_wait_stats = { 10, 0, 0, 0, 0 };
+
+
+static uint64 getTicks()
+{
+	LARGE_INTEGER tick;
+	QueryPerformanceCounter(&tick);
+	return tick.QuadPart;
+}
+
+
+Backoff::Backoff()
+	: m_round(0)
+	, m_start(0)
+	, m_park_start(0)
+{
+}
+
+
+Backoff::~Backoff()
+{
+	if (m_start == 0) return;
+
+	uint64 now = getTicks();
+	if (m_park_start == 0)
+	{
+		InterlockedIncrement64(&g_wait_stats.spin_count);
+		InterlockedExchangeAdd64(&g_wait_stats.spin_ticks, now - m_start);
+		return;
+	}
+	InterlockedIncrement64(&g_wait_stats.park_count);
+	InterlockedExchangeAdd64(&g_wait_stats.spin_ticks, m_park_start - m_start);
+	InterlockedExchangeAdd64(&g_wait_stats.park_ticks, now - m_park_start);
+}
+
+
+bool Backoff::spin()
+{
+	if (m_start == 0) m_start = getTicks();
+	if (m_round >= g_wait_stats.spin_limit)
+	{
+		if (m_park_start == 0) m_park_start = getTicks();
+		return false;
+	}
+
+	for (int i = 1 << m_round; i > 0; --i)
+	{
+		_mm_pause();
+	}
+	++m_round;
+	return true;
+}
+
+
+void Backoff::pause()
+{
+	if (!spin()) yield();
+}
+
+
+void setSpinLimit(int rounds)
+{
+	// more than 2^20 pauses is not a short wait
+	g_wait_stats.spin_limit = rounds < 0 ? 0 : (rounds > 20 ? 20 : rounds);
+}
+
+
+void getWaitStats(WaitStats& stats)
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	stats.spin_count = g_wait_stats.spin_count;
+	stats.park_count = g_wait_stats.park_count;
+	stats.spin_time = float(double(g_wait_stats.spin_ticks) / frequency.QuadPart);
+	stats.park_time = float(double(g_wait_stats.park_ticks) / frequency.QuadPart);
+}
+
+
+void resetWaitStats()
+{
+	InterlockedExchange64(&g_wait_stats.spin_count, 0);
+	InterlockedExchange64(&g_wait_stats.park_count, 0);
+	InterlockedExchange64(&g_wait_stats.spin_ticks, 0);
+	InterlockedExchange64(&g_wait_stats.park_ticks, 0);
+}
+
+
 Semaphore::Semaphore(int init_count, int max_count)
 {
 	m_id = ::CreateSemaphore(nullptr, init_count, max_count, nullptr);
@@ -121,9 +219,10 @@ void SpinMutex::lock()
 			return;
 		}
 
+		Backoff backoff;
 		while (m_id)
 		{
-			yield();
+			backoff.pause();
 		}
 	}
 }
@@ -103,7 +103,7 @@ namespace Lumix
 			m_implementation->m_affinity_mask = affinity_mask;
 			if (m_implementation->m_handle)
 			{
-				::SetThreadIdealProcessor(m_implementation->m_handle, affinity_mask);
+				::SetThreadAffinityMask(m_implementation->m_handle, affinity_mask);
 			}
 		}
 
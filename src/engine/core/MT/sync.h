@@ -124,5 +124,42 @@ private:
 };
 
 
+// Waits which are usually short: each spin() pauses twice as long as the previous one and
+// returns false once the spin limit is reached, then the caller parks on an OS primitive, or
+// yields if it has none. The time spent in both is added to the wait stats when the backoff
+// is destroyed, nothing is measured if it never spins.
+class LUMIX_ENGINE_API Backoff
+{
+public:
+	Backoff();
+	~Backoff();
+
+	bool spin();
+	// spin() and yield the thread when it returns false
+	void pause();
+
+private:
+	int m_round;
+	uint64 m_start;
+	uint64 m_park_start;
+};
+
+
+struct WaitStats
+{
+	int64 spin_count;
+	int64 park_count;
+	// seconds, summed over all threads
+	float spin_time;
+	float park_time;
+};
+
+
+// rounds of spinning before parking, i.e. 2^rounds - 1 pauses; 0 parks right away
+LUMIX_ENGINE_API void setSpinLimit(int rounds);
+LUMIX_ENGINE_API void getWaitStats(WaitStats& stats);
+LUMIX_ENGINE_API void resetWaitStats();
+
+
 } // namespace MT
 } // namespace Lumix
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "lumix.h"
+#include "core/mt/atomic.h"
+
+
+namespace Lumix
+{
+	namespace MT
+	{
+		// Chase-Lev deque with a fixed capacity. Only the owner thread may call push and pop,
+		// any thread may call steal. T must be trivially copyable (usually a pointer).
+		template <class T, int32 size>
+		class WorkStealingDeque
+		{
+			static_assert((size & (size - 1)) == 0, "size must be a power of two");
+
+		public:
+			WorkStealingDeque()
+				: m_top(0)
+				, m_bottom(0)
+			{
+			}
+
+			bool push(T value)
+			{
+				int32 bottom = m_bottom;
+				int32 top = m_top;
+				if (bottom - top >= size)
+				{
+					return false;
+				}
+
+				m_data[bottom & (size - 1)] = value;
+				memoryBarrier();
+				m_bottom = bottom + 1;
+				return true;
+			}
+
+			bool pop(T* value)
+			{
+				int32 bottom = m_bottom - 1;
+				m_bottom = bottom;
+				memoryBarrier();
+				int32 top = m_top;
+
+				if (top > bottom)
+				{
+					m_bottom = top;
+					return false;
+				}
+
+				*value = m_data[bottom & (size - 1)];
+				if (top != bottom)
+				{
+					return true;
+				}
+
+				bool won = compareAndExchange(&m_top, top + 1, top);
+				m_bottom = top + 1;
+				return won;
+			}
+
+			bool steal(T* value)
+			{
+				int32 top = m_top;
+				memoryBarrier();
+				int32 bottom = m_bottom;
+
+				if (top >= bottom)
+				{
+					return false;
+				}
+
+				*value = m_data[top & (size - 1)];
+				return compareAndExchange(&m_top, top + 1, top);
+			}
+
+			bool isEmpty() const
+			{
+				return m_bottom <= m_top;
+			}
+
+		private:
+			volatile int32 m_top;
+			volatile int32 m_bottom;
+			T m_data[size];
+		};
+	} // ~namespace MT
+} // ~namespace Lumix
@@ -50,6 +50,23 @@ namespace Lumix
 			ASSERT(nullptr != m_sync_event);
 			m_sync_event->wait();
 
+#endif //TYPE == MULTI_THREAD
+		}
+
+		void BaseEntry::sync(Manager& manager)
+		{
+#if TYPE == MULTI_THREAD
+
+			ASSERT(nullptr != m_sync_event);
+			while (!m_sync_event->poll())
+			{
+				if (!manager.tryExecuteJob())
+				{
+					m_sync_event->wait();
+					return;
+				}
+			}
+
 #endif //TYPE == MULTI_THREAD
 		}
 
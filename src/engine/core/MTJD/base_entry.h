@@ -22,6 +22,9 @@ namespace MTJD
 {
 
 
+class Manager;
+
+
 class LUMIX_ENGINE_API BaseEntry
 {
 public:
@@ -33,9 +36,12 @@ public:
 	void addDependency(BaseEntry* entry);
 
 	void sync();
+	// executes pending jobs on the calling thread until there is nothing left to help with
+	void sync(Manager& manager);
 
 	virtual void incrementDependency() = 0;
 	virtual void decrementDependency() = 0;
+	virtual bool isReady() const = 0;
 
 	uint32 getDependenceCount() const { return m_dependency_count; }
 
@@ -27,6 +27,13 @@ namespace Lumix
 
 		};
 
+		enum class SchedulerType
+		{
+			Central,
+			WorkStealing,
+			Default = Central,
+		};
+
 		enum class JobType
 		{
 			None = -1,
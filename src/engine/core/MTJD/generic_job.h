@@ -16,8 +16,8 @@ namespace MTJD
 template <class T> class GenericJob : public MTJD::Job
 {
 public:
-	GenericJob(MTJD::Manager& manager, T function, IAllocator& allocator)
-		: MTJD::Job(Job::AUTO_DESTROY, MTJD::Priority::Normal, manager, allocator, allocator)
+	GenericJob(MTJD::Manager& manager, T function, IAllocator& allocator, Priority priority)
+		: MTJD::Job(Job::AUTO_DESTROY, priority, manager, allocator, allocator)
 		, m_function(function)
 	{
 	}
@@ -29,9 +29,14 @@ private:
 };
 
 
-template <class T> MTJD::Job* makeJob(MTJD::Manager& manager, T function, IAllocator& allocator)
+// background work which nothing waits for this frame should use Priority::Low or lower
+template <class T>
+MTJD::Job* makeJob(MTJD::Manager& manager,
+	T function,
+	IAllocator& allocator,
+	Priority priority = Priority::Normal)
 {
-	return LUMIX_NEW(allocator, GenericJob<T>)(manager, function, allocator);
+	return LUMIX_NEW(allocator, GenericJob<T>)(manager, function, allocator, priority);
 }
 
 
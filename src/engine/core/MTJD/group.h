@@ -16,6 +16,7 @@ namespace Lumix
 
 			void incrementDependency() override;
 			void decrementDependency() override;
+			bool isReady() const override { return m_dependency_count == 0; }
 
 		protected:
 
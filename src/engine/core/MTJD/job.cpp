@@ -2,6 +2,7 @@
 #include "core/MTJD/job.h"
 
 #include "core/MTJD/manager.h"
+#include "core/mt/thread.h"
 
 namespace Lumix
 {
@@ -18,6 +19,10 @@ Job::Job(int flags,
 	, m_auto_destroy((flags & AUTO_DESTROY) != 0)
 	, m_scheduled(false)
 	, m_executed(false)
+	, m_use_fiber((flags & FIBER) != 0)
+	, m_fiber(nullptr)
+	, m_return_fiber(nullptr)
+	, m_waiting_for(nullptr)
 	, m_job_allocator(job_allocator)
 {
 	setJobName("Unknown Job");
@@ -50,8 +55,32 @@ void Job::decrementDependency()
 #endif // TYPE == MULTI_THREAD
 }
 
+void Job::waitFor(BaseEntry& entry)
+{
+#if TYPE == MULTI_THREAD
+
+	if (entry.isReady()) return;
+
+	if (m_fiber)
+	{
+		// the manager resumes the fiber once entry is ready
+		m_waiting_for = &entry;
+		MT::Fiber::switchTo(m_return_fiber);
+		ASSERT(entry.isReady());
+		return;
+	}
+
+	while (!entry.isReady())
+	{
+		if (!m_manager.tryExecuteJob()) MT::yield();
+	}
+
+#endif // TYPE == MULTI_THREAD
+}
+
 void Job::onExecuted()
 {
+	ASSERT(!m_fiber);
 	m_executed = true;
 	bool auto_destroy = m_auto_destroy;
 
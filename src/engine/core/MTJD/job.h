@@ -2,24 +2,31 @@
 
 #include "core/MTJD/enums.h"
 #include "core/MTJD/group.h"
+#include "core/mt/fiber.h"
 
 namespace Lumix
 {
 namespace MTJD
 {
 class Manager;
+struct JobFiber;
 
 
 class LUMIX_ENGINE_API Job : public BaseEntry
 {
 	friend struct ManagerImpl;
+	friend struct WorkStealingManagerImpl;
 	friend class WorkerTask;
 
 public:
 	enum Flags
 	{
 		SYNC_EVENT = 1,
-		AUTO_DESTROY = 1 << 1
+		AUTO_DESTROY = 1 << 1,
+		// executed on a fiber, so waitFor() suspends the job instead of blocking the worker;
+		// it can continue on another thread, so profiler blocks and thread locals must not
+		// span waitFor(); the work stealing manager and the central one without fibers ignore it
+		FIBER = 1 << 2
 	};
 
 public:
@@ -32,6 +39,8 @@ public:
 
 	void incrementDependency() override;
 	void decrementDependency() override;
+	// executed, jobs with AUTO_DESTROY are destroyed by then, so nothing can wait for them
+	bool isReady() const override { return m_executed; }
 
 	Priority getPriority() const { return m_priority; }
 
@@ -39,6 +48,10 @@ protected:
 	virtual void execute() = 0;
 	virtual void onExecuted();
 
+	// called from execute(), returns when entry is ready; a job on a fiber is suspended and
+	// its worker executes other jobs meanwhile, other jobs execute pending jobs while they wait
+	void waitFor(BaseEntry& entry);
+
 	IAllocator& m_job_allocator;
 
 	Manager& m_manager;
@@ -46,6 +59,10 @@ protected:
 	bool m_auto_destroy;
 	bool m_scheduled;
 	bool m_executed;
+	bool m_use_fiber;
+	JobFiber* m_fiber;
+	MT::Fiber::Handle m_return_fiber;
+	BaseEntry* volatile m_waiting_for;
 
 private:
 	Job& operator=(const Job& rhs);
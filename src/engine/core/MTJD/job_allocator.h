@@ -0,0 +1,127 @@
+#pragma once
+
+#include "lumix.h"
+#include "core/array.h"
+#include "core/iallocator.h"
+#include "core/mt/sync.h"
+
+
+namespace Lumix
+{
+	namespace MTJD
+	{
+		// Thread-safe pool for short lived jobs. Blocks are never returned to the source
+		// allocator until the pool is destroyed, allocations bigger than BLOCK_SIZE are
+		// forwarded to the source allocator.
+		class JobAllocator : public IAllocator
+		{
+		public:
+			static const size_t BLOCK_SIZE = 256;
+			static const int32 CHUNK_BLOCKS = 64;
+
+			explicit JobAllocator(IAllocator& source)
+				: m_source(source)
+				, m_chunks(source)
+				, m_free(source)
+				, m_mutex(false)
+			{
+			}
+
+			~JobAllocator()
+			{
+				for (auto* chunk : m_chunks)
+				{
+					m_source.deallocate_aligned(chunk);
+				}
+			}
+
+			void* allocate(size_t size) override
+			{
+				Header* header;
+				if (size > BLOCK_SIZE)
+				{
+					header = (Header*)m_source.allocate_aligned(size + sizeof(Header), HEADER_ALIGN);
+					header->is_pooled = false;
+					return header + 1;
+				}
+
+				MT::SpinLock lock(m_mutex);
+				if (m_free.empty())
+				{
+					grow();
+				}
+				header = m_free.back();
+				m_free.pop();
+				header->is_pooled = true;
+				return header + 1;
+			}
+
+			void deallocate(void* ptr) override
+			{
+				if (!ptr) return;
+
+				Header* header = (Header*)ptr - 1;
+				if (!header->is_pooled)
+				{
+					m_source.deallocate_aligned(header);
+					return;
+				}
+
+				MT::SpinLock lock(m_mutex);
+				m_free.push(header);
+			}
+
+			void* reallocate(void*, size_t) override
+			{
+				ASSERT(false);
+				return nullptr;
+			}
+
+			void* allocate_aligned(size_t size, size_t align) override
+			{
+				ASSERT(align <= HEADER_ALIGN);
+				return allocate(size);
+			}
+
+			void deallocate_aligned(void* ptr) override
+			{
+				deallocate(ptr);
+			}
+
+			void* reallocate_aligned(void*, size_t, size_t) override
+			{
+				ASSERT(false);
+				return nullptr;
+			}
+
+			int32 getPooledBlocksCount() const { return m_chunks.size() * CHUNK_BLOCKS; }
+
+		private:
+			struct Header
+			{
+				bool is_pooled;
+				uint8 padding[15];
+			};
+
+			static const size_t HEADER_ALIGN = 16;
+			static const size_t STRIDE = BLOCK_SIZE + sizeof(Header);
+
+			void grow()
+			{
+				uint8* chunk = (uint8*)m_source.allocate_aligned(STRIDE * CHUNK_BLOCKS, HEADER_ALIGN);
+				m_chunks.push(chunk);
+				m_free.reserve(m_chunks.size() * CHUNK_BLOCKS);
+				for (int32 i = CHUNK_BLOCKS - 1; i >= 0; --i)
+				{
+					m_free.push((Header*)(chunk + i * STRIDE));
+				}
+			}
+
+		private:
+			IAllocator& m_source;
+			Array<uint8*> m_chunks;
+			Array<Header*> m_free;
+			MT::SpinMutex m_mutex;
+		};
+	} // namepsace MTJD
+} // namepsace Lumix
@@ -2,10 +2,14 @@
 #include "core/mtjd/manager.h"
 
 #include "core/mtjd/job.h"
+#include "core/mtjd/job_allocator.h"
 #include "core/mtjd/scheduler.h"
+#include "core/mtjd/work_stealing_manager.h"
 #include "core/mtjd/worker_thread.h"
 
+#include "core/math_utils.h"
 #include "core/mt/thread.h"
+#include "core/profiler.h"
 
 namespace Lumix
 {
@@ -13,21 +17,57 @@ namespace MTJD
 {
 
 
+struct JobFiber
+{
+	MT::Fiber::Handle handle;
+	Job* job;
+};
+
+
 struct ManagerImpl : public Manager
 {
-	typedef MT::LockFreeFixedQueue<Job*, 512>	JobsTable;
+	typedef MT::GrowableQueue<Job*, 512>		JobsTable;
 	typedef Array<JobTrans*>					TransTable;
 
+	struct SuspendedJob
+	{
+		JobTrans* trans;
+		bool is_background;
+	};
+
 
-	ManagerImpl(IAllocator& allocator)
+	ManagerImpl(IAllocator& allocator, const Config& config)
 		: m_scheduling_counter(0)
+		, m_extra_dispatches(0)
 		, m_scheduler(*this, allocator)
 		, m_worker_tasks(allocator)
 		, m_allocator(allocator)
 		, m_pending_trans(allocator)
+		, m_pending_background_trans(allocator)
+		, m_trans_queue(allocator)
+		, m_background_trans_queue(allocator)
+		, m_job_allocator(allocator)
+		, m_affinity_mask(config.affinity_mask)
+		, m_aging_limit(config.aging_limit)
+		, m_fiber_stack_size(config.fiber_stack_size)
+		, m_fibers(allocator)
+		, m_free_fibers(allocator)
+		, m_fibers_mutex(false)
+		, m_new_suspended(allocator)
+		, m_suspended(allocator)
+		, m_suspended_mutex(false)
 	{
+		for (int32 i = 0; i < (int32)Priority::Count; ++i)
+		{
+			m_ready_to_execute[i] = LUMIX_NEW(m_allocator, JobsTable)(m_allocator);
+			m_skipped_dispatches[i] = 0;
+		}
+
 #if TYPE == MULTI_THREAD
-		uint32 threads_num = getCpuThreadsCount();
+		uint32 threads_num = MT::getCPUsCount();
+		m_background_workers =
+			Math::clamp(config.background_workers, 0, Math::maxValue((int)threads_num - 1, 0));
+		m_foreground_workers = threads_num - m_background_workers;
 
 		m_scheduler.create("MTJD::Scheduler");
 		m_scheduler.run();
@@ -35,12 +75,18 @@ struct ManagerImpl : public Manager
 		m_worker_tasks.reserve(threads_num);
 		for (uint32 i = 0; i < threads_num; ++i)
 		{
+			bool is_background = (int)i >= m_foreground_workers;
 			m_worker_tasks.push(LUMIX_NEW(m_allocator, WorkerTask)(m_allocator));
-			m_worker_tasks[i]->create("MTJD::WorkerTask", this, &m_trans_queue);
+			m_worker_tasks[i]->create(is_background ? "MTJD::BackgroundWorkerTask"
+													: "MTJD::WorkerTask",
+				this,
+				is_background ? &m_background_trans_queue : &m_trans_queue);
 			m_worker_tasks[i]->setAffinityMask(getAffinityMask(i));
 			m_worker_tasks[i]->run();
 		}
-
+#else // TYPE == MULTI_THREAD
+		m_background_workers = 0;
+		m_foreground_workers = 1;
 #endif // TYPE == MULTI_THREAD
 	}
 
@@ -48,13 +94,17 @@ struct ManagerImpl : public Manager
 	{
 #if TYPE == MULTI_THREAD
 
-		uint32 threads_num = getCpuThreadsCount();
-		for (uint32 i = 0; i < threads_num; ++i)
+		// each abort wakes one worker
+		for (int i = 0; i < m_foreground_workers; ++i)
 		{
 			m_trans_queue.abort();
 		}
+		for (int i = 0; i < m_background_workers; ++i)
+		{
+			m_background_trans_queue.abort();
+		}
 
-		for (uint32 i = 0; i < threads_num; ++i)
+		for (int i = 0; i < m_worker_tasks.size(); ++i)
 		{
 			m_worker_tasks[i]->destroy();
 			LUMIX_DELETE(m_allocator, m_worker_tasks[i]);
@@ -65,19 +115,42 @@ struct ManagerImpl : public Manager
 		m_scheduler.destroy();
 
 #endif // TYPE == MULTI_THREAD
+
+		for (int32 i = 0; i < (int32)Priority::Count; ++i)
+		{
+			LUMIX_DELETE(m_allocator, m_ready_to_execute[i]);
+		}
+
+		ASSERT(m_suspended.empty() && m_new_suspended.empty());
+		for (JobFiber* fiber : m_fibers)
+		{
+			MT::Fiber::destroy(fiber->handle);
+			LUMIX_DELETE(m_job_allocator, fiber);
+		}
 	}
 
-	uint32 getCpuThreadsCount() const override
-	{
-#if TYPE == MULTI_THREAD
+	// background workers do not help with parallel work of other jobs
+	uint32 getCpuThreadsCount() const override { return m_foreground_workers; }
 
-		return MT::getCPUsCount();
 
-#else // TYPE == MULTI_THREAD
+	SchedulerType getSchedulerType() const override { return SchedulerType::Central; }
+	IAllocator& getJobAllocator() override { return m_job_allocator; }
 
-		return 1;
 
-#endif // TYPE == MULTI_THREAD
+	int32 getQueuedHighWaterMark() const override
+	{
+		int32 ret = m_trans_queue.getQueuedHighWaterMark();
+		for (int32 i = 0; i < (int32)Priority::Count; ++i)
+		{
+			ret = Math::maxValue(ret, m_ready_to_execute[i]->getQueuedHighWaterMark());
+		}
+		return ret;
+	}
+
+
+	int32 getAllocatedHighWaterMark() const override
+	{
+		return m_trans_queue.getAllocatedHighWaterMark();
 	}
 
 
@@ -106,20 +179,150 @@ struct ManagerImpl : public Manager
 #endif // TYPE == MULTI_THREAD
 	}
 
-	void scheduleCpu(Job* job)
+	void scheduleCpu(Job* job, bool is_background)
+	{
+		JobTransQueue& queue = is_background ? m_background_trans_queue : m_trans_queue;
+		JobTrans* tr = queue.alloc(false);
+		tr->data = job;
+		(is_background ? m_pending_background_trans : m_pending_trans).push(tr);
+		queue.push(tr, false);
+	}
+
+
+	bool isBackground(Priority priority) const
+	{
+		return m_background_workers > 0 && priority >= Priority::Low;
+	}
+
+
+	static void LUMIX_FIBER_CALL fiberMain(void* data)
+	{
+		JobFiber* fiber = (JobFiber*)data;
+		for (;;)
+		{
+			Job* job = fiber->job;
+			job->execute();
+			fiber->job = nullptr;
+			MT::Fiber::switchTo(job->m_return_fiber);
+		}
+	}
+
+
+	JobFiber* allocFiber(Job* job)
+	{
+		MT::SpinLock lock(m_fibers_mutex);
+		JobFiber* fiber;
+		if (m_free_fibers.empty())
+		{
+			fiber = LUMIX_NEW(m_job_allocator, JobFiber);
+			fiber->handle = MT::Fiber::create(m_fiber_stack_size, fiberMain, fiber);
+			m_fibers.push(fiber);
+		}
+		else
+		{
+			fiber = m_free_fibers.back();
+			m_free_fibers.pop();
+		}
+		fiber->job = job;
+		return fiber;
+	}
+
+
+	void executeJob(JobTrans* tr) override
+	{
+		Job* job = tr->data;
+		if (!job->m_use_fiber || m_fiber_stack_size <= 0)
+		{
+			job->execute();
+			tr->setCompleted();
+			return;
+		}
+
+		if (!job->m_fiber) job->m_fiber = allocFiber(job);
+		job->m_return_fiber = MT::Fiber::getCurrent();
+		MT::Fiber::switchTo(job->m_fiber->handle);
+
+		if (job->m_waiting_for)
+		{
+			// the fiber is switched out, doScheduling can resume it on any thread
+			MT::SpinLock lock(m_suspended_mutex);
+			m_new_suspended.push(tr);
+			return;
+		}
+
+		{
+			MT::SpinLock lock(m_fibers_mutex);
+			m_free_fibers.push(job->m_fiber);
+		}
+		job->m_fiber = nullptr;
+		tr->setCompleted();
+	}
+
+
+	// suspended jobs do not count in the dispatch limits and resumed ones ignore them, they
+	// already run and hold fibers
+	void resumeSuspended()
+	{
+		{
+			MT::SpinLock lock(m_suspended_mutex);
+			for (JobTrans* tr : m_new_suspended)
+			{
+				SuspendedJob& suspended = m_suspended.emplace();
+				suspended.trans = tr;
+				int idx = m_pending_trans.indexOf(tr);
+				suspended.is_background = idx < 0;
+				if (idx < 0)
+				{
+					m_pending_background_trans.eraseItemFast(tr);
+				}
+				else
+				{
+					m_pending_trans.eraseFast(idx);
+				}
+			}
+			m_new_suspended.clear();
+		}
+
+		for (int i = 0; i < m_suspended.size();)
+		{
+			SuspendedJob suspended = m_suspended[i];
+			Job* job = suspended.trans->data;
+			if (!job->m_waiting_for->isReady())
+			{
+				++i;
+				continue;
+			}
+
+			job->m_waiting_for = nullptr;
+			m_suspended.eraseFast(i);
+			if (suspended.is_background)
+			{
+				m_pending_background_trans.push(suspended.trans);
+				m_background_trans_queue.push(suspended.trans, false);
+			}
+			else
+			{
+				m_pending_trans.push(suspended.trans);
+				m_trans_queue.push(suspended.trans, false);
+			}
+		}
+	}
+
+
+	void collectCompleted(TransTable& pending, JobTransQueue& queue)
 	{
-		JobTrans* tr = m_trans_queue.alloc(false);
-		if (tr)
+		for (int i = 0; i < pending.size();)
 		{
-			tr->data = job;
-			if (!m_trans_queue.push(tr, false))
+			JobTrans* tr = pending[i];
+			if (tr->isCompleted())
 			{
-				m_trans_queue.dealoc(tr);
-				pushReadyJob(job);
+				tr->data->onExecuted();
+				queue.dealoc(tr);
+				pending.eraseFast(i);
 			}
 			else
 			{
-				m_pending_trans.push(tr);
+				++i;
 			}
 		}
 	}
@@ -133,25 +336,35 @@ struct ManagerImpl : public Manager
 		{
 			do
 			{
-				for (int i = 0; i < m_pending_trans.size();)
+				collectCompleted(m_pending_trans, m_trans_queue);
+				collectCompleted(m_pending_background_trans, m_background_trans_queue);
+				resumeSuspended();
+
+				// ready jobs wait in the priority queues until a worker is free, so a job of
+				// a higher priority never waits behind the queued jobs of lower priorities;
+				// one more than workers since the threads waiting for jobs help
+				for (;;)
 				{
-					JobTrans* tr = m_pending_trans[i];
-					if (tr->isCompleted())
+					bool can_foreground = m_pending_trans.size() <= m_foreground_workers;
+					bool can_background = m_pending_background_trans.size() < m_background_workers;
+					Job* job = getNextReadyJob(can_foreground, can_background);
+					if (job)
 					{
-						tr->data->onExecuted();
-						m_trans_queue.dealoc(tr);
-						m_pending_trans.eraseFast(i);
+						scheduleCpu(job, isBackground(job->getPriority()));
+						continue;
 					}
-					else
+
+					// a thread waits in tryExecuteJob, it gets a job even over the limits,
+					// otherwise jobs waiting for other jobs could block all workers
+					if (m_extra_dispatches <= 0) break;
+					job = getNextReadyJob(true, true);
+					if (!job)
 					{
-						++i;
+						m_extra_dispatches = 0;
+						break;
 					}
-				}
-
-				Job* job = getNextReadyJob();
-				if (job)
-				{
-					scheduleCpu(job);
+					MT::atomicDecrement(&m_extra_dispatches);
+					scheduleCpu(job, false);
 				}
 
 				count = MT::atomicDecrement(&m_scheduling_counter);
@@ -161,25 +374,75 @@ struct ManagerImpl : public Manager
 #endif // TYPE == MULTI_THREAD
 	}
 
-	Job* getNextReadyJob()
+	bool tryExecuteJob() override
 	{
 #if TYPE == MULTI_THREAD
 
-		for (int32 i = 0; i < (int32)Priority::Count; ++i)
+		doScheduling();
+		JobTrans* tr = m_trans_queue.pop(false);
+		if (!tr)
 		{
-			if (!m_ready_to_execute[i].isEmpty())
-			{
-				Job** entry = m_ready_to_execute[i].pop(true);
-				Job* ret = *entry;
-				m_ready_to_execute[i].dealoc(entry);
+			MT::atomicIncrement(&m_extra_dispatches);
+			doScheduling();
+			tr = m_trans_queue.pop(false);
+			if (!tr) return false;
+		}
 
-				return ret;
+		PROFILE_BLOCK("tryExecuteJob");
+		executeJob(tr);
+		doScheduling();
+		return true;
+
+#else // TYPE == MULTI_THREAD
+
+		return false;
+
+#endif // TYPE == MULTI_THREAD
+	}
+
+	// called only from doScheduling, which runs on one thread at a time
+	Job* getNextReadyJob(bool can_foreground, bool can_background)
+	{
+#if TYPE == MULTI_THREAD
+
+		auto isAllowed = [&](int32 priority) -> bool {
+			bool is_background = isBackground((Priority)priority);
+			if (is_background ? !can_background : !can_foreground) return false;
+			return !m_ready_to_execute[priority]->isEmpty();
+		};
+
+		// jobs skipped too many times go first
+		int32 picked = -1;
+		if (m_aging_limit > 0)
+		{
+			for (int32 i = 0; i < (int32)Priority::Count && picked < 0; ++i)
+			{
+				if (m_skipped_dispatches[i] >= m_aging_limit && isAllowed(i)) picked = i;
 			}
 		}
+		for (int32 i = 0; i < (int32)Priority::Count && picked < 0; ++i)
+		{
+			if (isAllowed(i)) picked = i;
+		}
+		if (picked < 0) return nullptr;
 
-#endif // TYPE == MULTI_THREAD
+		Job** entry = m_ready_to_execute[picked]->pop(false);
+		if (!entry) return nullptr;
+		Job* ret = *entry;
+		m_ready_to_execute[picked]->dealoc(entry);
+
+		m_skipped_dispatches[picked] = 0;
+		for (int32 i = picked + 1; i < (int32)Priority::Count; ++i)
+		{
+			if (!m_ready_to_execute[i]->isEmpty()) ++m_skipped_dispatches[i];
+		}
+		return ret;
+
+#else // TYPE == MULTI_THREAD
 
 		return nullptr;
+
+#endif // TYPE == MULTI_THREAD
 	}
 
 	void pushReadyJob(Job* job)
@@ -188,46 +451,89 @@ struct ManagerImpl : public Manager
 
 #if TYPE == MULTI_THREAD
 
-		Job** jobEntry = m_ready_to_execute[(int32)job->getPriority()].alloc(true);
-		if (jobEntry)
-		{
-			*jobEntry = job;
-			m_ready_to_execute[(int32)job->getPriority()].push(jobEntry, true);
-		}
+		JobsTable& queue = *m_ready_to_execute[(int32)job->getPriority()];
+		Job** job_entry = queue.alloc(false);
+		*job_entry = job;
+		queue.push(job_entry, false);
 
 #endif // TYPE == MULTI_THREAD
 	}
 
-	uint32 getAffinityMask(uint32) const
+	uint32 getAffinityMask(uint32 worker) const
 	{
 #if defined(_WIN32) || defined(_WIN64)
-		return MT::getProccessAffinityMask();
+		uint32 mask = m_affinity_mask & MT::getProccessAffinityMask();
+		if (!mask) return MT::getProccessAffinityMask();
+
+		// the n-th CPU of the mask, repeated when there are more workers than CPUs
+		int cpus = 0;
+		for (uint32 i = 0; i < 32; ++i)
+		{
+			if (mask & (1 << i)) ++cpus;
+		}
+		int n = worker % cpus;
+		for (uint32 i = 0; i < 32; ++i)
+		{
+			if (!(mask & (1 << i))) continue;
+			if (n == 0) return 1 << i;
+			--n;
+		}
+		return mask;
 #else
 #error "Not Supported!"
 #endif
 	}
 
 	IAllocator&			m_allocator;
-	JobsTable			m_ready_to_execute[(size_t)Priority::Count];
+	JobAllocator		m_job_allocator;
+	JobsTable*			m_ready_to_execute[(size_t)Priority::Count];
 	JobTransQueue		m_trans_queue;
+	JobTransQueue		m_background_trans_queue;
 	TransTable			m_pending_trans;
+	TransTable			m_pending_background_trans;
 	Array<WorkerTask*>	m_worker_tasks;
 	Scheduler			m_scheduler;
+	int					m_foreground_workers;
+	int					m_background_workers;
+	uint32				m_affinity_mask;
+	int					m_aging_limit;
+	// dispatches of higher priorities since the last dispatch of the priority
+	int					m_skipped_dispatches[(size_t)Priority::Count];
 
 	volatile int32 m_scheduling_counter;
+	// threads waiting in tryExecuteJob for a job
+	volatile int32 m_extra_dispatches;
+
+	int					m_fiber_stack_size;
+	Array<JobFiber*>	m_fibers;
+	Array<JobFiber*>	m_free_fibers;
+	MT::SpinMutex		m_fibers_mutex;
+	// suspended by workers, not seen by doScheduling yet
+	TransTable			m_new_suspended;
+	Array<SuspendedJob>	m_suspended;
+	MT::SpinMutex		m_suspended_mutex;
 
 
 }; // struct ManagerImpl
 
 
-Manager* Manager::create(IAllocator& allocator)
+Manager* Manager::create(IAllocator& allocator, SchedulerType type, const Config& config)
 {
-	return LUMIX_NEW(allocator, ManagerImpl)(allocator);
+	if (type == SchedulerType::WorkStealing)
+	{
+		return createWorkStealingManager(allocator);
+	}
+	return LUMIX_NEW(allocator, ManagerImpl)(allocator, config);
 }
 
 
 void Manager::destroy(Manager& manager)
 {
+	if (manager.getSchedulerType() == SchedulerType::WorkStealing)
+	{
+		destroyWorkStealingManager(manager);
+		return;
+	}
 	LUMIX_DELETE(static_cast<ManagerImpl&>(manager).m_allocator, &manager);
 }
 
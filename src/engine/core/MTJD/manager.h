@@ -6,8 +6,9 @@
 
 #define TYPE MULTI_THREAD
 
-#include "core/mt/lock_free_fixed_queue.h"
+#include "core/mt/growable_queue.h"
 #include "core/mt/transaction.h"
+#include "core/MTJD/enums.h"
 
 
 namespace Lumix
@@ -28,15 +29,49 @@ class LUMIX_ENGINE_API Manager
 
 public:
 	typedef MT::Transaction<Job*> JobTrans;
-	typedef MT::LockFreeFixedQueue<JobTrans, 32> JobTransQueue;
+	typedef MT::GrowableQueue<JobTrans, 32> JobTransQueue;
+
+	// used by the central scheduler, the work stealing one ignores it
+	struct Config
+	{
+		Config()
+			: background_workers(0)
+			, aging_limit(0)
+			, affinity_mask(0)
+			, fiber_stack_size(64 * 1024)
+		{
+		}
+
+		// workers which execute only jobs with Priority::Low and lower, other workers do not
+		// execute them; 0 means all workers execute all jobs
+		int background_workers;
+		// a ready job is dispatched after this many jobs of higher priorities were dispatched
+		// while it waited; 0 for strict priorities
+		int aging_limit;
+		// each worker is pinned to one CPU of the mask, in order, background workers after
+		// the others; 0 keeps the process affinity
+		uint32 affinity_mask;
+		// of fibers for jobs with Job::FIBER, they are pooled; 0 runs such jobs on the workers
+		int fiber_stack_size;
+	};
 
 	virtual ~Manager() {}
 
 	virtual uint32 getCpuThreadsCount() const = 0;
 	virtual void schedule(Job* job) = 0;
 	virtual void doScheduling() = 0;
-
-	static Manager* create(IAllocator& allocator);
+	virtual bool tryExecuteJob() = 0;
+	// executes the job on the calling thread and completes the transaction, unless the job
+	// was suspended in Job::waitFor()
+	virtual void executeJob(JobTrans* tr) = 0;
+	virtual IAllocator& getJobAllocator() = 0;
+	virtual SchedulerType getSchedulerType() const = 0;
+	virtual int32 getQueuedHighWaterMark() const = 0;
+	virtual int32 getAllocatedHighWaterMark() const = 0;
+
+	static Manager* create(IAllocator& allocator,
+		SchedulerType type = SchedulerType::Default,
+		const Config& config = Config());
 	static void destroy(Manager& manager);
 };
 
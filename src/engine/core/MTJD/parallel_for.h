@@ -0,0 +1,119 @@
+#pragma once
+
+
+#include "core/math_utils.h"
+#include "core/mt/atomic.h"
+#include "core/mt/thread.h"
+#include "job.h"
+#include "manager.h"
+
+
+namespace Lumix
+{
+
+
+namespace MTJD
+{
+
+
+template <class T> struct ParallelForContext
+{
+	T* function;
+	int begin;
+	int end;
+	int grain;
+	int32 batches_count;
+	volatile int32 next_batch;
+	volatile int32 running_jobs;
+
+
+	void run()
+	{
+		for (;;)
+		{
+			int32 batch = MT::atomicIncrement(&next_batch) - 1;
+			if (batch >= batches_count) break;
+
+			int from = begin + batch * grain;
+			int to = Math::minValue(from + grain, end);
+			(*function)(from, to);
+		}
+	}
+};
+
+
+template <class T> class ParallelForJob : public MTJD::Job
+{
+public:
+	ParallelForJob(MTJD::Manager& manager, ParallelForContext<T>& context)
+		: MTJD::Job(Job::AUTO_DESTROY,
+			  MTJD::Priority::Default,
+			  manager,
+			  manager.getJobAllocator(),
+			  manager.getJobAllocator())
+		, m_context(context)
+	{
+		setJobName("ParallelForJob");
+	}
+
+	void execute() override
+	{
+		m_context.run();
+		MT::atomicDecrement(&m_context.running_jobs);
+	}
+
+private:
+	ParallelForJob& operator=(const ParallelForJob&);
+
+	ParallelForContext<T>& m_context;
+};
+
+
+// Calls function(from, to) for consecutive subranges of [begin, end) with at most grain items;
+// returns after all subranges are processed. Subranges are handed out on demand so batches are
+// balanced between workers, the calling thread processes batches too.
+template <class T> void parallelFor(MTJD::Manager& manager, int begin, int end, int grain, T function)
+{
+	if (end <= begin) return;
+
+	int count = end - begin;
+	grain = Math::maxValue(grain, 1);
+	int batches_count = (count + grain - 1) / grain;
+	int jobs_count = Math::minValue(batches_count, (int)manager.getCpuThreadsCount()) - 1;
+	if (jobs_count <= 0)
+	{
+		function(begin, end);
+		return;
+	}
+
+	ParallelForContext<T> context;
+	context.function = &function;
+	context.begin = begin;
+	context.end = end;
+	context.grain = grain;
+	context.batches_count = batches_count;
+	context.next_batch = 0;
+	context.running_jobs = jobs_count;
+
+	IAllocator& job_allocator = manager.getJobAllocator();
+	for (int i = 0; i < jobs_count; ++i)
+	{
+		manager.schedule(LUMIX_NEW(job_allocator, ParallelForJob<T>)(manager, context));
+	}
+
+	context.run();
+
+	while (context.running_jobs > 0)
+	{
+		if (!manager.tryExecuteJob())
+		{
+			MT::yield();
+		}
+	}
+}
+
+
+} // namespace MTJD
+
+
+} // namespace Lumix
@@ -0,0 +1,306 @@
+#include "lumix.h"
+#include "core/MTJD/work_stealing_manager.h"
+
+#include "core/array.h"
+#include "core/math_utils.h"
+#include "core/MTJD/job.h"
+#include "core/MTJD/job_allocator.h"
+#include "core/mt/atomic.h"
+#include "core/mt/sync.h"
+#include "core/mt/task.h"
+#include "core/mt/thread.h"
+#include "core/mt/work_stealing_deque.h"
+#include "core/profiler.h"
+
+
+namespace Lumix
+{
+namespace MTJD
+{
+
+
+struct WorkStealingManagerImpl;
+
+
+class StealingWorkerTask : public MT::Task
+{
+public:
+	typedef MT::WorkStealingDeque<Job*, 512> Deque;
+
+	StealingWorkerTask(WorkStealingManagerImpl& manager, int index, IAllocator& allocator)
+		: MT::Task(allocator)
+		, m_manager(manager)
+		, m_index(index)
+		, m_thread_id(0)
+	{
+	}
+
+	int task() override;
+
+	uint32 getThreadID() const { return m_thread_id; }
+	Deque& getDeque() { return m_deque; }
+
+private:
+	StealingWorkerTask& operator=(const StealingWorkerTask&);
+
+	WorkStealingManagerImpl& m_manager;
+	Deque m_deque;
+	int m_index;
+	volatile uint32 m_thread_id;
+};
+
+
+struct WorkStealingManagerImpl : public Manager
+{
+	typedef MT::GrowableQueue<Job*, 512> JobsTable;
+
+
+	WorkStealingManagerImpl(IAllocator& allocator)
+		: m_allocator(allocator)
+		, m_job_allocator(allocator)
+		, m_worker_tasks(allocator)
+		, m_work_signal(0, 0x7fffFFFF)
+		, m_aborted(false)
+	{
+		for (int32 i = 0; i < (int32)Priority::Count; ++i)
+		{
+			m_global_jobs[i] = LUMIX_NEW(m_allocator, JobsTable)(m_allocator);
+		}
+
+#if TYPE == MULTI_THREAD
+		uint32 threads_num = getCpuThreadsCount();
+
+		m_worker_tasks.reserve(threads_num);
+		for (uint32 i = 0; i < threads_num; ++i)
+		{
+			m_worker_tasks.push(LUMIX_NEW(m_allocator, StealingWorkerTask)(*this, i, m_allocator));
+			m_worker_tasks[i]->create("MTJD::StealingWorkerTask");
+			m_worker_tasks[i]->setAffinityMask(MT::getProccessAffinityMask());
+			m_worker_tasks[i]->run();
+		}
+#endif // TYPE == MULTI_THREAD
+	}
+
+
+	~WorkStealingManagerImpl()
+	{
+#if TYPE == MULTI_THREAD
+		m_aborted = true;
+		for (int i = 0; i < m_worker_tasks.size(); ++i)
+		{
+			m_work_signal.signal();
+		}
+
+		for (int i = 0; i < m_worker_tasks.size(); ++i)
+		{
+			m_worker_tasks[i]->destroy();
+			LUMIX_DELETE(m_allocator, m_worker_tasks[i]);
+		}
+#endif // TYPE == MULTI_THREAD
+
+		for (int32 i = 0; i < (int32)Priority::Count; ++i)
+		{
+			LUMIX_DELETE(m_allocator, m_global_jobs[i]);
+		}
+	}
+
+
+	uint32 getCpuThreadsCount() const override
+	{
+#if TYPE == MULTI_THREAD
+		return MT::getCPUsCount();
+#else // TYPE == MULTI_THREAD
+		return 1;
+#endif // TYPE == MULTI_THREAD
+	}
+
+
+	SchedulerType getSchedulerType() const override { return SchedulerType::WorkStealing; }
+	IAllocator& getJobAllocator() override { return m_job_allocator; }
+
+
+	int32 getQueuedHighWaterMark() const override
+	{
+		int32 ret = 0;
+		for (int32 i = 0; i < (int32)Priority::Count; ++i)
+		{
+			ret = Math::maxValue(ret, m_global_jobs[i]->getQueuedHighWaterMark());
+		}
+		return ret;
+	}
+
+
+	int32 getAllocatedHighWaterMark() const override
+	{
+		int32 ret = 0;
+		for (int32 i = 0; i < (int32)Priority::Count; ++i)
+		{
+			ret += m_global_jobs[i]->getAllocatedHighWaterMark();
+		}
+		return ret;
+	}
+
+
+	void schedule(Job* job) override
+	{
+		ASSERT(job);
+		ASSERT(false == job->m_scheduled);
+		ASSERT(job->m_dependency_count > 0);
+
+#if TYPE == MULTI_THREAD
+
+		if (1 == job->getDependenceCount())
+		{
+			job->m_scheduled = true;
+
+			StealingWorkerTask* worker = getCurrentWorker();
+			if (!worker || !worker->getDeque().push(job))
+			{
+				pushGlobalJob(job);
+			}
+			m_work_signal.signal();
+		}
+
+#else // TYPE == MULTI_THREAD
+
+		job->execute();
+		job->onExecuted();
+
+#endif // TYPE == MULTI_THREAD
+	}
+
+
+	void doScheduling() override {}
+
+
+	void executeJob(JobTrans* tr) override
+	{
+		tr->data->execute();
+		tr->setCompleted();
+	}
+
+
+	bool tryExecuteJob() override
+	{
+		Job* job = popGlobalJob();
+		for (int i = 0; !job && i < m_worker_tasks.size(); ++i)
+		{
+			if (!m_worker_tasks[i]->getDeque().steal(&job)) job = nullptr;
+		}
+		if (!job) return false;
+
+		runJob(job);
+		return true;
+	}
+
+
+	StealingWorkerTask* getCurrentWorker() const
+	{
+		uint32 thread_id = MT::getCurrentThreadID();
+		for (auto* worker : m_worker_tasks)
+		{
+			if (worker->getThreadID() == thread_id) return worker;
+		}
+		return nullptr;
+	}
+
+
+	void pushGlobalJob(Job* job)
+	{
+		JobsTable& queue = *m_global_jobs[(int32)job->getPriority()];
+		Job** entry = queue.alloc(false);
+		*entry = job;
+		queue.push(entry, false);
+	}
+
+
+	Job* popGlobalJob()
+	{
+		for (int32 i = 0; i < (int32)Priority::Count; ++i)
+		{
+			if (m_global_jobs[i]->isEmpty()) continue;
+
+			Job** entry = m_global_jobs[i]->pop(false);
+			if (entry)
+			{
+				Job* ret = *entry;
+				m_global_jobs[i]->dealoc(entry);
+				return ret;
+			}
+		}
+		return nullptr;
+	}
+
+
+	Job* getNextJob(int worker_index)
+	{
+		Job* job = nullptr;
+		if (m_worker_tasks[worker_index]->getDeque().pop(&job)) return job;
+
+		job = popGlobalJob();
+		if (job) return job;
+
+		int count = m_worker_tasks.size();
+		for (int i = 1; i < count; ++i)
+		{
+			auto& victim = m_worker_tasks[(worker_index + i) % count]->getDeque();
+			if (victim.steal(&job)) return job;
+		}
+		return nullptr;
+	}
+
+
+	void runJob(Job* job)
+	{
+		PROFILE_BLOCK("StealingWorkerTask");
+		job->execute();
+		job->onExecuted();
+	}
+
+
+	void waitForJob() { m_work_signal.wait(); }
+	bool isAborted() const { return m_aborted; }
+
+
+	IAllocator& m_allocator;
+	JobAllocator m_job_allocator;
+	Array<StealingWorkerTask*> m_worker_tasks;
+	JobsTable* m_global_jobs[(size_t)Priority::Count];
+	MT::Semaphore m_work_signal;
+	volatile bool m_aborted;
+};
+
+
+int StealingWorkerTask::task()
+{
+	m_thread_id = MT::getCurrentThreadID();
+	while (!m_manager.isAborted())
+	{
+		Job* job = m_manager.getNextJob(m_index);
+		if (job)
+		{
+			m_manager.runJob(job);
+		}
+		else
+		{
+			m_manager.waitForJob();
+		}
+	}
+	return 0;
+}
+
+
+Manager* createWorkStealingManager(IAllocator& allocator)
+{
+	return LUMIX_NEW(allocator, WorkStealingManagerImpl)(allocator);
+}
+
+
+void destroyWorkStealingManager(Manager& manager)
+{
+	LUMIX_DELETE(static_cast<WorkStealingManagerImpl&>(manager).m_allocator, &manager);
+}
+
+
+} // namepsace MTJD
+} // namepsace Lumix
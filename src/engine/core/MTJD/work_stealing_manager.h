@@ -0,0 +1,18 @@
+#pragma once
+
+
+#include "core/MTJD/manager.h"
+
+
+namespace Lumix
+{
+namespace MTJD
+{
+
+
+Manager* createWorkStealingManager(IAllocator& allocator);
+void destroyWorkStealingManager(Manager& manager);
+
+
+} // namepsace MTJD
+} // namepsace Lumix
@@ -45,14 +45,14 @@ namespace Lumix
 
 				PROFILE_START("WorkerTask");
 				PROFILE_START(tr->data->getJobName());
-				tr->data->execute();
-				tr->setCompleted();
+				m_manager->executeJob(tr);
 				PROFILE_STOP(tr->data->getJobName());
 				PROFILE_STOP("WorkerTask");
 
 				m_manager->doScheduling();
 			}
 
+			MT::Fiber::convertToThread();
 			return 0;
 		}
 
@@ -2,12 +2,30 @@
 
 
 #include "core/iallocator.h"
+#include "core/math_utils.h"
+#include "core/string.h"
 
 
 namespace Lumix
 {
 
 
+// Array moves elements by copying their memory, which is fine for almost everything, including
+// nested arrays. Types which point into themselves must specialize this, e.g. with
+// LUMIX_NOT_RELOCATABLE, and are then move constructed and destroyed one by one.
+template <typename T> struct IsRelocatable
+{
+	enum { value = 1 };
+};
+
+
+#define LUMIX_NOT_RELOCATABLE(T) \
+	template <> struct IsRelocatable<T> \
+	{ \
+		enum { value = 0 }; \
+	}
+
+
 template <typename T> class Array
 {
 public:
@@ -135,7 +153,7 @@ public:
 			m_data[index].~T();
 			if (index != m_size - 1)
 			{
-				moveMemory(m_data + index, m_data + m_size - 1, sizeof(T));
+				relocate(m_data + index, m_data + m_size - 1, 1);
 			}
 			--m_size;
 		}
@@ -160,7 +178,7 @@ public:
 		{
 			grow();
 		}
-		moveMemory(m_data + index + 1, m_data + index, sizeof(T) * (m_size - index));
+		relocate(m_data + index + 1, m_data + index, m_size - index);
 		new (NewPlaceholder(), &m_data[index]) T(value);
 		++m_size;
 	}
@@ -173,7 +191,7 @@ public:
 			m_data[index].~T();
 			if (index < m_size - 1)
 			{
-				moveMemory(m_data + index, m_data + index + 1, sizeof(T) * (m_size - index - 1));
+				relocate(m_data + index, m_data + index + 1, m_size - index - 1);
 			}
 			--m_size;
 		}
@@ -192,6 +210,21 @@ public:
 	}
 
 
+	// grows at most once, values must not point into this array
+	void push(const T* values, int count)
+	{
+		if (m_size + count > m_capacity)
+		{
+			reserve(Math::maxValue(m_size + count, m_capacity * 2));
+		}
+		for (int i = 0; i < count; ++i)
+		{
+			new (NewPlaceholder(), (char*)(m_data + m_size + i)) T(values[i]);
+		}
+		m_size += count;
+	}
+
+
 	template <class _Ty> struct remove_reference
 	{ // remove rvalue reference
 		typedef _Ty type;
@@ -230,10 +263,7 @@ public:
 		{
 			grow();
 		}
-		for (int i = m_size - 1; i >= idx; --i)
-		{
-			copyMemory(&m_data[i + 1], &m_data[i], sizeof(m_data[i]));
-		}
+		relocate(m_data + idx + 1, m_data + idx, m_size - idx);
 		new (NewPlaceholder(), (char*)(m_data + idx)) T(myforward<Params>(params)...);
 		++m_size;
 		return m_data[idx];
@@ -276,57 +306,12 @@ public:
 		m_size = size;
 	}
 
-	void moveMemory(void* dest, const void* src, size_t count)
-	{
-		if(dest == src) return;
-
-		if(dest < src || dest >= (uint8*)src + count)
-		{
-			uint8* dest8 = (uint8*)dest;
-			const uint8* src8 = (const uint8*)src;
-
-			const uint8* src_end = src8 + count;
-			while(src8 != src_end)
-			{
-				*dest8 = *src8;
-				++src8;
-				++dest8;
-			}
-		}
-		else
-		{
-			uint8* dest8 = (uint8*)dest + count - 1;
-			const uint8* src8 = (const uint8*)src + count - 1;
-
-			while(src8 >= src)
-			{
-				*dest8 = *src8;
-				--src8;
-				--dest8;
-			}
-		}
-	}
-
-	void copyMemory(void* dest, const void* src, size_t count)
-	{
-		uint8* dest8 = (uint8*)dest;
-		const uint8* src8 = (const uint8*)src;
-
-		const uint8* src_end = src8 + count;
-		while(src8 != src_end)
-		{
-			*dest8 = *src8;
-			++src8;
-			++dest8;
-		}
-	}
-
 	void reserve(int capacity)
 	{
 		if (capacity > m_capacity)
 		{
 			T* newData = (T*)m_allocator.allocate(capacity * sizeof(T));
-			copyMemory(newData, m_data, sizeof(T) * m_size);
+			relocate(newData, m_data, m_size);
 			m_allocator.deallocate(m_data);
 			m_data = newData;
 			m_capacity = capacity;
@@ -347,16 +332,55 @@ public:
 	int capacity() const { return m_capacity; }
 
 private:
+	template <int> struct RelocateTag {};
+
+
 	void grow()
 	{
 		int newCapacity = m_capacity == 0 ? 4 : m_capacity * 2;
 		T* new_data = (T*)m_allocator.allocate(newCapacity * sizeof(T));
-		copyMemory(new_data, m_data, sizeof(T) * m_size);
+		relocate(new_data, m_data, m_size);
 		m_allocator.deallocate(m_data);
 		m_data = new_data;
 		m_capacity = newCapacity;
 	}
 
+
+	// moves count elements from src to uninitialized dest, ranges can overlap,
+	// src is left uninitialized
+	static void relocate(T* dest, T* src, int count)
+	{
+		if (count <= 0 || dest == src) return;
+		relocate(dest, src, count, RelocateTag<IsRelocatable<T>::value>());
+	}
+
+
+	static void relocate(T* dest, T* src, int count, RelocateTag<1>)
+	{
+		Lumix::moveMemory(dest, src, sizeof(T) * count);
+	}
+
+
+	static void relocate(T* dest, T* src, int count, RelocateTag<0>)
+	{
+		if (dest < src)
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				new (NewPlaceholder(), (char*)(dest + i)) T(static_cast<T&&>(src[i]));
+				src[i].~T();
+			}
+		}
+		else
+		{
+			for (int i = count - 1; i >= 0; --i)
+			{
+				new (NewPlaceholder(), (char*)(dest + i)) T(static_cast<T&&>(src[i]));
+				src[i].~T();
+			}
+		}
+	}
+
 	void callDestructors(T* begin, T* end)
 	{
 		for (; begin < end; ++begin)
@@ -373,4 +397,107 @@ private:
 };
 
 
+// hands out its buffer to the first allocation which fits, everything else goes to the parent
+template <size_t SIZE> class InlineAllocator : public IAllocator
+{
+public:
+	explicit InlineAllocator(IAllocator& parent)
+		: m_parent(parent)
+		, m_is_used(false)
+	{
+	}
+
+
+	void* allocate(size_t size) override
+	{
+		if (!m_is_used && size <= SIZE)
+		{
+			m_is_used = true;
+			return m_buffer;
+		}
+		return m_parent.allocate(size);
+	}
+
+
+	void deallocate(void* ptr) override
+	{
+		if (ptr == m_buffer)
+		{
+			m_is_used = false;
+			return;
+		}
+		m_parent.deallocate(ptr);
+	}
+
+
+	void* reallocate(void* ptr, size_t size) override
+	{
+		if (ptr != m_buffer) return m_parent.reallocate(ptr, size);
+		if (size <= SIZE) return ptr;
+		void* new_ptr = m_parent.allocate(size);
+		Lumix::copyMemory(new_ptr, m_buffer, SIZE);
+		m_is_used = false;
+		return new_ptr;
+	}
+
+
+	void* allocate_aligned(size_t size, size_t align) override
+	{
+		return m_parent.allocate_aligned(size, align);
+	}
+
+
+	void deallocate_aligned(void* ptr) override { m_parent.deallocate_aligned(ptr); }
+
+
+	void* reallocate_aligned(void* ptr, size_t size, size_t align) override
+	{
+		return m_parent.reallocate_aligned(ptr, size, align);
+	}
+
+
+	IAllocator& getParent() const { return m_parent; }
+
+private:
+	IAllocator& m_parent;
+	bool m_is_used;
+	// 8 byte alignment is enough for everything stored in arrays
+	uint64 m_buffer[(SIZE + sizeof(uint64) - 1) / sizeof(uint64)];
+};
+
+
+// Array with inline storage for N elements, the allocator is used only when it grows bigger,
+// so short lived arrays of a known typical size do not allocate at all.
+// The allocator is the first base so it outlives the array part.
+template <typename T, int N>
+class SmallArray : private InlineAllocator<sizeof(T) * N>, public Array<T>
+{
+public:
+	explicit SmallArray(IAllocator& allocator)
+		: InlineAllocator<sizeof(T) * N>(allocator)
+		, Array<T>(*static_cast<IAllocator*>(this))
+	{
+		this->reserve(N);
+	}
+
+
+	SmallArray(const SmallArray& rhs)
+		: InlineAllocator<sizeof(T) * N>(rhs.getParent())
+		, Array<T>(*static_cast<IAllocator*>(this))
+	{
+		*this = rhs;
+	}
+
+
+	void operator=(const SmallArray& rhs) { Array<T>::operator=(rhs); }
+};
+
+
+// the array points to the allocator inside itself
+template <typename T, int N> struct IsRelocatable<SmallArray<T, N>>
+{
+	enum { value = 0 };
+};
+
+
 } // ~namespace Lumix
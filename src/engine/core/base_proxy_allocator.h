@@ -16,6 +16,8 @@ public:
 		: m_source(source)
 	{
 		m_allocation_count = 0;
+		m_total_allocation_count = 0;
+		m_live_bytes = 0;
 	}
 
 	virtual ~BaseProxyAllocator() { ASSERT(m_allocation_count == 0); }
@@ -24,7 +26,10 @@ public:
 	void* allocate_aligned(size_t size, size_t align) override
 	{
 		MT::atomicIncrement(&m_allocation_count);
-		return m_source.allocate_aligned(size, align);
+		MT::atomicIncrement(&m_total_allocation_count);
+		void* ptr = m_source.allocate_aligned(size, align);
+		addLiveBytes(m_source.getAllocationSize(ptr, true));
+		return ptr;
 	}
 
 
@@ -33,6 +38,7 @@ public:
 		if(ptr)
 		{
 			MT::atomicDecrement(&m_allocation_count);
+			addLiveBytes(-(int64)m_source.getAllocationSize(ptr, true));
 			m_source.deallocate_aligned(ptr);
 		}
 	}
@@ -40,14 +46,20 @@ public:
 
 	void* reallocate_aligned(void* ptr, size_t size, size_t align) override
 	{
-		return m_source.reallocate_aligned(ptr, size, align);
+		int64 old_size = ptr ? m_source.getAllocationSize(ptr, true) : 0;
+		void* new_ptr = m_source.reallocate_aligned(ptr, size, align);
+		addLiveBytes((int64)m_source.getAllocationSize(new_ptr, true) - old_size);
+		return new_ptr;
 	}
 
 
 	void* allocate(size_t size) override
 	{
 		MT::atomicIncrement(&m_allocation_count);
-		return m_source.allocate(size);
+		MT::atomicIncrement(&m_total_allocation_count);
+		void* ptr = m_source.allocate(size);
+		addLiveBytes(m_source.getAllocationSize(ptr, false));
+		return ptr;
 	}
 
 	void deallocate(void* ptr) override
@@ -55,21 +67,54 @@ public:
 		if (ptr)
 		{
 			MT::atomicDecrement(&m_allocation_count);
+			addLiveBytes(-(int64)m_source.getAllocationSize(ptr, false));
 			m_source.deallocate(ptr);
 		}
 	}
 
 	void* reallocate(void* ptr, size_t size) override
 	{
-		return m_source.reallocate(ptr, size);
+		int64 old_size = ptr ? m_source.getAllocationSize(ptr, false) : 0;
+		void* new_ptr = m_source.reallocate(ptr, size);
+		addLiveBytes((int64)m_source.getAllocationSize(new_ptr, false) - old_size);
+		return new_ptr;
+	}
+
+
+	size_t getAllocationSize(void* ptr, bool is_aligned) override
+	{
+		return m_source.getAllocationSize(ptr, is_aligned);
+	}
+
+
+	// live bytes are known only if the source allocator knows sizes of its blocks
+	bool getStats(AllocatorStats& stats) override
+	{
+		stats.live_bytes = (size_t)m_live_bytes;
+		stats.live_count = m_allocation_count;
+		stats.allocation_count = (uint32)m_total_allocation_count;
+		return true;
 	}
 
 
 	IAllocator& getSourceAllocator() { return m_source; }
 
+private:
+	void addLiveBytes(int64 value)
+	{
+		if (value == 0) return;
+		int64 old_value;
+		do
+		{
+			old_value = m_live_bytes;
+		} while (!MT::compareAndExchange64(&m_live_bytes, old_value + value, old_value));
+	}
+
 private:
 	IAllocator& m_source;
 	volatile int32 m_allocation_count;
+	volatile int32 m_total_allocation_count;
+	volatile int64 m_live_bytes;
 };
 
 
@@ -24,6 +24,8 @@ namespace Lumix
 			template <class T> void write(const T& value) { write(&value, sizeof(T)); }
 			template <> void write<bool>(const bool& value) { uint8 v = value; write(&v, sizeof(v)); }
 			void clear() { m_data.clear(); }
+			// exchanges the content with data, which must use the same allocator
+			void swap(Array<uint8>& data) { m_data.swap(data); }
 
 			OutputBlob& operator << (const char* str);
 			OutputBlob& operator << (int value);
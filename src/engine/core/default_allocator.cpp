@@ -40,4 +40,12 @@ namespace Lumix
 		return _aligned_realloc(ptr, size, align);
 	}
 
+
+	size_t DefaultAllocator::getAllocationSize(void* ptr, bool is_aligned)
+	{
+		// _aligned_msize needs the alignment, which we do not have here
+		if (!ptr || is_aligned) return 0;
+		return _msize(ptr);
+	}
+
 } // ~namespace Lumix
@@ -225,6 +225,11 @@ namespace Lumix
 				m_stub.second = &ClassMethodStub<C, Function>;
 			}
 
+			bool isValid()
+			{
+				return m_stub.second != nullptr;
+			}
+
 			R invoke(A0 a0, A1 a1, A2 a2) const
 			{
 				ASSERT(m_stub.second != nullptr);
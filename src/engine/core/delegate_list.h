@@ -199,4 +199,48 @@ namespace Lumix
 	private:
 		Array<Delegate<R(A0, A1, A2)> > m_delegates;
 	};
+
+	template <typename R, typename A0, typename A1, typename A2, typename A3>
+	class DelegateList<R(A0, A1, A2, A3)>
+	{
+	public:
+		DelegateList<R(A0, A1, A2, A3)>(IAllocator& allocator)
+			: m_delegates(allocator)
+		{
+		}
+
+		template <typename C, R(C::*Function)(A0, A1, A2, A3)>
+		void bind(C* instance)
+		{
+			Delegate<R(A0, A1, A2, A3)> cb;
+			cb.bind<C, Function>(instance);
+			m_delegates.push(cb);
+		}
+
+		template <typename C, R(C::*Function)(A0, A1, A2, A3)>
+		void unbind(C* instance)
+		{
+			Delegate<R(A0, A1, A2, A3)> cb;
+			cb.bind<C, Function>(instance);
+			for (int i = 0; i < m_delegates.size(); ++i)
+			{
+				if (m_delegates[i] == cb)
+				{
+					m_delegates.eraseFast(i);
+					break;
+				}
+			}
+		}
+
+		void invoke(A0 a0, A1 a1, A2 a2, A3 a3)
+		{
+			for (int i = 0; i < m_delegates.size(); ++i)
+			{
+				m_delegates[i].invoke(a0, a1, a2, a3);
+			}
+		}
+
+	private:
+		Array<Delegate<R(A0, A1, A2, A3)> > m_delegates;
+	};
 } // ~namespace Lumix
@@ -0,0 +1,107 @@
+#pragma once
+
+
+#include "lumix.h"
+#include "core/array.h"
+
+
+namespace Lumix
+{
+
+
+// Events which happen often and for which most listeners do not care, e.g. transformations of
+// entities. Instead of calling every listener for every event, events are recorded in a buffer
+// and each reader pulls the ones it has not read yet in bulk, when it needs them, and filters
+// them itself. Nothing is recorded while there are no readers.
+template <typename T> class EventChannel
+{
+public:
+	struct Event
+	{
+		Entity entity;
+		T data;
+	};
+
+public:
+	explicit EventChannel(IAllocator& allocator)
+		: m_events(allocator)
+		, m_readers(allocator)
+		, m_reader_count(0)
+	{
+	}
+
+
+	void push(Entity entity, const T& data)
+	{
+		if (m_reader_count == 0) return;
+		Event& event = m_events.emplace();
+		event.entity = entity;
+		event.data = data;
+	}
+
+
+	// the reader gets the events pushed from now on
+	int addReader()
+	{
+		++m_reader_count;
+		for (int i = 0; i < m_readers.size(); ++i)
+		{
+			if (m_readers[i] >= 0) continue;
+			m_readers[i] = m_events.size();
+			return i;
+		}
+		m_readers.push(m_events.size());
+		return m_readers.size() - 1;
+	}
+
+
+	void removeReader(int reader)
+	{
+		ASSERT(m_readers[reader] >= 0);
+		m_readers[reader] = -1;
+		--m_reader_count;
+		if (m_reader_count == 0) m_events.clear();
+	}
+
+
+	// events pushed since the last read of the reader, valid until the next push() or compact()
+	int read(int reader, const Event*& events)
+	{
+		int from = m_readers[reader];
+		ASSERT(from >= 0);
+		m_readers[reader] = m_events.size();
+		events = from < m_events.size() ? &m_events[from] : nullptr;
+		return m_events.size() - from;
+	}
+
+
+	// drops the events all readers have read, e.g. once per frame
+	void compact()
+	{
+		int min_read = m_events.size();
+		for (int read : m_readers)
+		{
+			if (read >= 0 && read < min_read) min_read = read;
+		}
+		if (min_read == 0) return;
+
+		for (int i = min_read; i < m_events.size(); ++i)
+		{
+			m_events[i - min_read] = m_events[i];
+		}
+		m_events.resize(m_events.size() - min_read);
+		for (int& read : m_readers)
+		{
+			if (read >= 0) read -= min_read;
+		}
+	}
+
+private:
+	Array<Event> m_events;
+	// index of the first event the reader did not read, -1 for removed readers
+	Array<int> m_readers;
+	int m_reader_count;
+};
+
+
+} // namespace Lumix
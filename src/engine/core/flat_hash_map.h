@@ -0,0 +1,339 @@
+#pragma once
+
+#include "lumix.h"
+#include "core/iallocator.h"
+#include "core/math_utils.h"
+#include "core/pod_hash_map.h"
+
+
+namespace Lumix
+{
+	// Open addressing (Robin Hood) alternative to PODHashMap with the same interface.
+	// Keys and values are stored in one flat table, there are no per node allocations.
+	// Keys and values must be POD, they are moved by copying memory. Inserting an existing key
+	// replaces its value. Iterators and pointers to values are invalidated by insert and erase.
+	template <class K, class T, class Hasher = PODHashFunc<K>>
+	class FlatHashMap
+	{
+	public:
+		typedef T value_type;
+		typedef K key_type;
+		typedef Hasher hasher_type;
+		typedef FlatHashMap<key_type, value_type, hasher_type> my_type;
+		typedef uint32 size_type;
+
+		static const size_type s_default_ids_count = 8;
+
+	private:
+		struct Slot
+		{
+			K key;
+			T value;
+		};
+
+		// distance from the ideal position + 1, 0 means the slot is empty; with a sane hash
+		// probe sequences are short, the range is wide so that bad hashes only make it slow
+		typedef uint16 Distance;
+		static const uint32 MAX_DISTANCE = 0xffff;
+
+	public:
+		template <class Map, class S>
+		class Iterator
+		{
+		public:
+			Iterator()
+				: m_hash_map(nullptr)
+				, m_index(0)
+			{
+			}
+
+			Iterator(Map* hm, size_type index)
+				: m_hash_map(hm)
+				, m_index(index)
+			{
+			}
+
+			bool isValid() const { return m_hash_map && m_index < m_hash_map->m_capacity; }
+			const key_type& key() const { return m_hash_map->m_slots[m_index].key; }
+			S& value() const { return m_hash_map->m_slots[m_index].value; }
+			S& operator*() const { return value(); }
+
+			Iterator& operator++()
+			{
+				m_index = m_hash_map->nextUsed(m_index + 1);
+				return *this;
+			}
+
+			Iterator operator++(int)
+			{
+				Iterator tmp = *this;
+				++*this;
+				return tmp;
+			}
+
+			bool operator==(const Iterator& it) const { return it.m_index == m_index; }
+			bool operator!=(const Iterator& it) const { return it.m_index != m_index; }
+
+		private:
+			friend class FlatHashMap;
+
+			Map* m_hash_map;
+			size_type m_index;
+		};
+
+		typedef Iterator<my_type, value_type> iterator;
+		typedef Iterator<const my_type, const value_type> const_iterator;
+
+		explicit FlatHashMap(IAllocator& allocator)
+			: m_allocator(allocator)
+			, m_slots(nullptr)
+			, m_distances(nullptr)
+			, m_size(0)
+			, m_capacity(0)
+			, m_max_load_factor(0.75f)
+		{
+		}
+
+		FlatHashMap(size_type buckets, IAllocator& allocator)
+			: m_allocator(allocator)
+			, m_slots(nullptr)
+			, m_distances(nullptr)
+			, m_size(0)
+			, m_capacity(0)
+			, m_max_load_factor(0.75f)
+		{
+			init(buckets);
+		}
+
+		FlatHashMap(const my_type& src)
+			: m_allocator(src.m_allocator)
+			, m_slots(nullptr)
+			, m_distances(nullptr)
+			, m_size(0)
+			, m_capacity(0)
+			, m_max_load_factor(src.m_max_load_factor)
+		{
+			copyFrom(src);
+		}
+
+		~FlatHashMap() { m_allocator.deallocate(m_slots); }
+
+		my_type& operator=(const my_type& src)
+		{
+			if (this != &src)
+			{
+				m_max_load_factor = src.m_max_load_factor;
+				copyFrom(src);
+			}
+			return *this;
+		}
+
+		size_type size() const { return m_size; }
+		bool empty() const { return 0 == m_size; }
+		size_type capacity() const { return m_capacity; }
+		float loadFactor() const { return m_capacity == 0 ? 0 : float(m_size) / m_capacity; }
+		float maxLoadFactor() const { return m_max_load_factor; }
+
+		// lower factor means shorter probe sequences for the price of memory
+		void setMaxLoadFactor(float factor)
+		{
+			ASSERT(factor > 0 && factor < 1);
+			m_max_load_factor = factor;
+			if (m_size > 0 && loadFactor() > m_max_load_factor) rehash(m_capacity * 2);
+		}
+
+		value_type& operator[](const key_type& key) const
+		{
+			size_type index = findIndex(key);
+			ASSERT(index < m_capacity);
+			return m_slots[index].value;
+		}
+
+		void insert(const key_type& key, const value_type& val)
+		{
+			size_type index = findIndex(key);
+			if (index < m_capacity)
+			{
+				copyMemory(&m_slots[index].value, &val, sizeof(val));
+				return;
+			}
+
+			if (float(m_size + 1) > m_capacity * m_max_load_factor)
+			{
+				rehash(m_capacity == 0 ? s_default_ids_count : m_capacity * 2);
+			}
+			Slot slot;
+			copyMemory(&slot.key, &key, sizeof(key));
+			copyMemory(&slot.value, &val, sizeof(val));
+			place(slot);
+			++m_size;
+		}
+
+		iterator erase(iterator it)
+		{
+			ASSERT(it.isValid());
+			size_type index = it.m_index;
+			bool shifted = eraseAt(index);
+			// the element moved to index was not visited yet, unless it wrapped around the table
+			if (shifted && index != m_capacity - 1) return iterator(this, index);
+			return iterator(this, nextUsed(index + 1));
+		}
+
+		size_type erase(const key_type& key)
+		{
+			size_type index = findIndex(key);
+			if (index >= m_capacity) return 0;
+			eraseAt(index);
+			return 1;
+		}
+
+		void clear()
+		{
+			if (m_capacity > 0) setMemory(m_distances, 0, sizeof(Distance) * m_capacity);
+			m_size = 0;
+		}
+
+		// capacity is rounded up to a power of two and never drops below the current size
+		void rehash(size_type ids_count)
+		{
+			size_type capacity = s_default_ids_count;
+			while (capacity < ids_count || capacity * m_max_load_factor < m_size) capacity *= 2;
+
+			Slot* old_slots = m_slots;
+			Distance* old_distances = m_distances;
+			size_type old_capacity = m_capacity;
+
+			init(capacity);
+			for (size_type i = 0; i < old_capacity; ++i)
+			{
+				if (old_distances[i] != 0) place(old_slots[i]);
+			}
+			m_allocator.deallocate(old_slots);
+		}
+
+		const_iterator begin() const { return const_iterator(this, nextUsed(0)); }
+		const_iterator end() const { return const_iterator(this, m_capacity); }
+		iterator begin() { return iterator(this, nextUsed(0)); }
+		iterator end() { return iterator(this, m_capacity); }
+
+		iterator find(const key_type& key) { return iterator(this, findIndex(key)); }
+		const_iterator find(const key_type& key) const { return const_iterator(this, findIndex(key)); }
+
+		value_type& at(const key_type& key)
+		{
+			size_type index = findIndex(key);
+			ASSERT(index < m_capacity);
+			return m_slots[index].value;
+		}
+
+	private:
+		void init(size_type capacity)
+		{
+			ASSERT(Math::isPowOfTwo(capacity));
+			// one block, distances are after the slots so slots keep the allocator's alignment
+			m_slots = (Slot*)m_allocator.allocate((sizeof(Slot) + sizeof(Distance)) * capacity);
+			m_distances = (Distance*)(m_slots + capacity);
+			setMemory(m_distances, 0, sizeof(Distance) * capacity);
+			m_capacity = capacity;
+		}
+
+		void copyFrom(const my_type& src)
+		{
+			m_allocator.deallocate(m_slots);
+			m_slots = nullptr;
+			m_distances = nullptr;
+			m_capacity = 0;
+			m_size = src.m_size;
+			if (src.m_capacity == 0) return;
+
+			init(src.m_capacity);
+			copyMemory(m_slots, src.m_slots, sizeof(Slot) * m_capacity);
+			copyMemory(m_distances, src.m_distances, sizeof(Distance) * m_capacity);
+		}
+
+		size_type nextUsed(size_type index) const
+		{
+			while (index < m_capacity && m_distances[index] == 0) ++index;
+			return index;
+		}
+
+		size_type findIndex(const key_type& key) const
+		{
+			if (m_size == 0) return m_capacity;
+
+			size_type mask = m_capacity - 1;
+			size_type index = Hasher::get(key) & mask;
+			for (uint32 distance = 1; distance <= m_distances[index]; ++distance)
+			{
+				if (m_distances[index] == distance && m_slots[index].key == key) return index;
+				index = (index + 1) & mask;
+			}
+			return m_capacity;
+		}
+
+		// the key must not be in the table, m_size is not changed
+		void place(Slot slot)
+		{
+			size_type mask = m_capacity - 1;
+			size_type index = Hasher::get(slot.key) & mask;
+			uint32 distance = 1;
+			for (;;)
+			{
+				Distance& current = m_distances[index];
+				if (current == 0)
+				{
+					copyMemory(&m_slots[index], &slot, sizeof(slot));
+					current = (Distance)distance;
+					return;
+				}
+				// take from the rich, elements far from their ideal position stay
+				if (current < distance)
+				{
+					Slot tmp;
+					copyMemory(&tmp, &m_slots[index], sizeof(tmp));
+					copyMemory(&m_slots[index], &slot, sizeof(slot));
+					copyMemory(&slot, &tmp, sizeof(slot));
+					uint32 tmp_distance = current;
+					current = (Distance)distance;
+					distance = tmp_distance;
+				}
+				index = (index + 1) & mask;
+				++distance;
+				if (distance >= MAX_DISTANCE)
+				{
+					// too long probe sequence, everything but the carried element is in the table,
+					// grow it and put the element into the bigger one
+					rehash(m_capacity * 2);
+					place(slot);
+					return;
+				}
+			}
+		}
+
+		// backward shift deletion, returns true if an element was moved to index
+		bool eraseAt(size_type index)
+		{
+			size_type mask = m_capacity - 1;
+			size_type next = (index + 1) & mask;
+			bool shifted = false;
+			while (m_distances[next] > 1)
+			{
+				copyMemory(&m_slots[index], &m_slots[next], sizeof(Slot));
+				m_distances[index] = m_distances[next] - 1;
+				index = next;
+				next = (next + 1) & mask;
+				shifted = true;
+			}
+			m_distances[index] = 0;
+			--m_size;
+			return shifted;
+		}
+
+		IAllocator& m_allocator;
+		Slot* m_slots;
+		Distance* m_distances;
+		size_type m_size;
+		size_type m_capacity;
+		float m_max_load_factor;
+	};
+} // ~namespace Lumix
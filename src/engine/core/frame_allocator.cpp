@@ -0,0 +1,193 @@
+#include "core/frame_allocator.h"
+#include "core/log.h"
+#include "core/math_utils.h"
+#include "core/mt/atomic.h"
+#include "core/string.h"
+
+
+namespace Lumix
+{
+
+
+static const size_t CHUNK_SIZE = 16 * 1024;
+static const size_t DEFAULT_ALIGN = 16;
+static const int32 MAX_BUFFER_SIZE = 0x10000000;
+
+
+// part of the current buffer owned by a thread, it's valid only in the frame it was taken in
+struct ThreadChunk
+{
+	int32 allocator_id;
+	uint32 frame;
+	uint8* current;
+	uint8* end;
+};
+
+
+static LUMIX_THREAD_LOCAL ThreadChunk s_thread_chunk = { 0, 0, nullptr, nullptr };
+static volatile int32 s_last_allocator_id = 0;
+
+
+// size is kept in front of each allocation so reallocate knows how much to copy
+static uint8* placeAllocation(uint8* mem, size_t size, size_t align)
+{
+	uintptr ptr = ((uintptr)mem + sizeof(size_t) + align - 1) & ~(uintptr)(align - 1);
+	((size_t*)ptr)[-1] = size;
+	return (uint8*)ptr;
+}
+
+
+FrameAllocator::FrameAllocator(IAllocator& parent, size_t buffer_size)
+	: m_parent(parent)
+	, m_buffer_size((int32)buffer_size)
+	, m_frame(0)
+	, m_first(parent)
+	, m_second(parent)
+	, m_current(&m_first)
+	, m_previous(&m_second)
+	, m_peak(0)
+	, m_is_overflow_reported(false)
+	, m_overflow_mutex(false)
+{
+	ASSERT(buffer_size <= (size_t)MAX_BUFFER_SIZE);
+	m_id = MT::atomicIncrement(&s_last_allocator_id);
+	m_first.data = (uint8*)parent.allocate(buffer_size * 2);
+	m_second.data = m_first.data + buffer_size;
+}
+
+
+FrameAllocator::~FrameAllocator()
+{
+	reset(m_first);
+	reset(m_second);
+	m_parent.deallocate(m_first.data);
+}
+
+
+void FrameAllocator::reset(Buffer& buffer)
+{
+	buffer.offset = 0;
+	for (void* mem : buffer.overflow)
+	{
+		m_parent.deallocate(mem);
+	}
+	buffer.overflow.clear();
+	buffer.overflow_size = 0;
+}
+
+
+size_t FrameAllocator::getUsed(const Buffer& buffer) const
+{
+	return Math::minValue(buffer.offset, m_buffer_size) + buffer.overflow_size;
+}
+
+
+void FrameAllocator::endFrame()
+{
+	m_peak = Math::maxValue(m_peak, getUsed(*m_current));
+
+	// memory of the previous frame is not used anymore, the current one stays valid
+	Buffer* tmp = m_previous;
+	m_previous = m_current;
+	m_current = tmp;
+	reset(*m_current);
+	++m_frame;
+}
+
+
+FrameAllocator::Stats FrameAllocator::getStats() const
+{
+	Stats stats;
+	stats.capacity = m_buffer_size;
+	stats.used = getUsed(*m_current);
+	stats.peak = Math::maxValue(m_peak, stats.used);
+	stats.overflow_count = m_current->overflow.size();
+	stats.overflow_size = m_current->overflow_size;
+	return stats;
+}
+
+
+uint8* FrameAllocator::allocateOverflow(size_t size)
+{
+	uint8* mem = (uint8*)m_parent.allocate(size);
+	bool report;
+	{
+		MT::SpinLock lock(m_overflow_mutex);
+		m_current->overflow.push(mem);
+		m_current->overflow_size += size;
+		report = !m_is_overflow_reported;
+		m_is_overflow_reported = true;
+	}
+	if (report)
+	{
+		g_log_warning.log("engine") << "Frame allocator (" << (uint64)m_buffer_size
+									<< " bytes) is full, using its parent allocator";
+	}
+	return mem;
+}
+
+
+uint8* FrameAllocator::grab(size_t size)
+{
+	Buffer& buffer = *m_current;
+	// once the buffer is full the offset is not touched, so it can not overflow
+	if (buffer.offset < m_buffer_size && size <= (size_t)m_buffer_size)
+	{
+		int32 offset = MT::atomicAdd(&buffer.offset, (int32)size);
+		if (offset + (int32)size <= m_buffer_size) return buffer.data + offset;
+	}
+	return allocateOverflow(size);
+}
+
+
+void* FrameAllocator::allocate_aligned(size_t size, size_t align)
+{
+	ASSERT(Math::isPowOfTwo(align));
+	size_t required = size + sizeof(size_t) + align - 1;
+
+	ThreadChunk& chunk = s_thread_chunk;
+	if (chunk.allocator_id != m_id || chunk.frame != m_frame ||
+		chunk.current + required > chunk.end)
+	{
+		// big allocations would waste most of a chunk
+		if (required > CHUNK_SIZE / 4) return placeAllocation(grab(required), size, align);
+
+		chunk.allocator_id = m_id;
+		chunk.frame = m_frame;
+		chunk.current = grab(CHUNK_SIZE);
+		chunk.end = chunk.current + CHUNK_SIZE;
+	}
+
+	uint8* ptr = placeAllocation(chunk.current, size, align);
+	chunk.current = ptr + size;
+	return ptr;
+}
+
+
+void* FrameAllocator::allocate(size_t size)
+{
+	return allocate_aligned(size, DEFAULT_ALIGN);
+}
+
+
+void FrameAllocator::deallocate(void*) {}
+
+
+void FrameAllocator::deallocate_aligned(void*) {}
+
+
+void* FrameAllocator::reallocate_aligned(void* ptr, size_t size, size_t align)
+{
+	void* new_ptr = allocate_aligned(size, align);
+	if (ptr) copyMemory(new_ptr, ptr, Math::minValue(((size_t*)ptr)[-1], size));
+	return new_ptr;
+}
+
+
+void* FrameAllocator::reallocate(void* ptr, size_t size)
+{
+	return reallocate_aligned(ptr, size, DEFAULT_ALIGN);
+}
+
+
+} // ~namespace Lumix
@@ -0,0 +1,84 @@
+#pragma once
+
+
+#include "lumix.h"
+#include "core/array.h"
+#include "core/iallocator.h"
+#include "core/mt/sync.h"
+
+
+namespace Lumix
+{
+
+
+	/// Linear allocator for per-frame scratch memory. There are two buffers, allocations
+	/// of a frame are valid until the end of the next frame, when their buffer is reset
+	/// wholesale; deallocate does nothing. Threads bump pointers in their own chunks of the
+	/// current buffer, when it is full allocations go to the parent allocator.
+	class LUMIX_ENGINE_API FrameAllocator : public IAllocator
+	{
+		public:
+			struct Stats
+			{
+				size_t capacity;
+				size_t used; // bytes taken by the current frame
+				size_t peak; // max used by any finished frame
+				int32 overflow_count; // allocations of the current frame which did not fit
+				size_t overflow_size;
+			};
+
+		public:
+			FrameAllocator(IAllocator& parent, size_t buffer_size);
+			~FrameAllocator();
+
+			// no other thread may allocate while the frame ends
+			void endFrame();
+			Stats getStats() const;
+			uint32 getFrame() const { return m_frame; }
+
+			void* allocate(size_t size) override;
+			void deallocate(void* ptr) override;
+			void* reallocate(void* ptr, size_t size) override;
+			void* allocate_aligned(size_t size, size_t align) override;
+			void deallocate_aligned(void* ptr) override;
+			void* reallocate_aligned(void* ptr, size_t size, size_t align) override;
+
+		private:
+			struct Buffer
+			{
+				explicit Buffer(IAllocator& allocator)
+					: data(nullptr)
+					, offset(0)
+					, overflow(allocator)
+					, overflow_size(0)
+				{
+				}
+
+				uint8* data;
+				volatile int32 offset;
+				Array<void*> overflow;
+				size_t overflow_size;
+			};
+
+		private:
+			uint8* grab(size_t size);
+			uint8* allocateOverflow(size_t size);
+			void reset(Buffer& buffer);
+			size_t getUsed(const Buffer& buffer) const;
+
+		private:
+			IAllocator& m_parent;
+			int32 m_buffer_size;
+			int32 m_id;
+			uint32 m_frame;
+			Buffer m_first;
+			Buffer m_second;
+			Buffer* m_current;
+			Buffer* m_previous;
+			size_t m_peak;
+			bool m_is_overflow_reported;
+			MT::SpinMutex m_overflow_mutex;
+	};
+
+
+} // ~namespace Lumix
@@ -0,0 +1,287 @@
+#include "frame_stats.h"
+#include "core/blob.h"
+#include "core/default_allocator.h"
+#include "core/fs/os_file.h"
+#include "core/log.h"
+#include "core/math_utils.h"
+#include "core/mt/atomic.h"
+#include "core/mt/sync.h"
+#include "core/string.h"
+#include "core/timer.h"
+
+
+namespace Lumix
+{
+
+
+namespace FrameStats
+{
+
+
+static const char* COUNTER_NAMES[] = {"resources loaded", "bytes streamed", "draw calls"};
+static_assert(sizeof(COUNTER_NAMES) / sizeof(COUNTER_NAMES[0]) == (int)Counter::COUNT,
+	"Missing counter names");
+
+
+struct Histogram
+{
+	char name[32];
+	float max_value;
+	volatile int32 buckets[BUCKETS_COUNT];
+	volatile int32 count;
+};
+
+
+struct Instance
+{
+	Instance()
+		: mutex(false)
+	{
+		timer = Timer::create(allocator);
+		frequency = (double)timer->getFrequency();
+		histograms_count = 0;
+		setMemory(histograms, 0, sizeof(histograms));
+		setMemory((void*)frame_counters, 0, sizeof(frame_counters));
+		setMemory(counters, 0, sizeof(counters));
+		hitch_threshold = 50;
+		hitch_count = 0;
+		dump_period = 0;
+		time_to_dump = 0;
+		dump_path[0] = '\0';
+	}
+
+
+	~Instance() { Timer::destroy(timer); }
+
+
+	DefaultAllocator allocator;
+	Timer* timer;
+	double frequency;
+	Histogram histograms[MAX_HISTOGRAMS];
+	volatile int32 histograms_count;
+	// added by any thread during the frame, moved to counters in frame()
+	volatile int32 frame_counters[(int)Counter::COUNT];
+	int64 counters[(int)Counter::COUNT];
+	float hitch_threshold;
+	int hitch_count;
+	float dump_period;
+	float time_to_dump;
+	char dump_path[MAX_PATH_LENGTH];
+	MT::SpinMutex mutex;
+};
+
+
+static Instance g_instance;
+// registered first, so it's FRAME_TIME
+static const int g_frame_time = addHistogram("frame time", 100);
+
+
+static int findHistogram(const char* name)
+{
+	for (int i = 0; i < g_instance.histograms_count; ++i)
+	{
+		if (compareString(g_instance.histograms[i].name, name) == 0) return i;
+	}
+	return -1;
+}
+
+
+int addHistogram(const char* name, float max_value)
+{
+	// histograms are never removed, so existing ones are found without the lock
+	int existing = findHistogram(name);
+	if (existing >= 0) return existing;
+
+	MT::SpinLock lock(g_instance.mutex);
+	existing = findHistogram(name);
+	if (existing >= 0) return existing;
+	if (g_instance.histograms_count == MAX_HISTOGRAMS) return -1;
+
+	Histogram& histogram = g_instance.histograms[g_instance.histograms_count];
+	copyString(histogram.name, name);
+	histogram.max_value = max_value;
+	MT::memoryBarrier();
+	++g_instance.histograms_count;
+	return g_instance.histograms_count - 1;
+}
+
+
+int getHistogramCount()
+{
+	return g_instance.histograms_count;
+}
+
+
+const char* getHistogramName(int histogram)
+{
+	return g_instance.histograms[histogram].name;
+}
+
+
+void record(int histogram, float value)
+{
+	if (histogram < 0) return;
+
+	Histogram& h = g_instance.histograms[histogram];
+	int bucket = int(value / h.max_value * BUCKETS_COUNT);
+	bucket = Math::clamp(bucket, 0, BUCKETS_COUNT - 1);
+	MT::atomicIncrement(&h.buckets[bucket]);
+	MT::atomicIncrement(&h.count);
+}
+
+
+int getSampleCount(int histogram)
+{
+	return g_instance.histograms[histogram].count;
+}
+
+
+float getPercentile(int histogram, float percentile)
+{
+	const Histogram& h = g_instance.histograms[histogram];
+	if (h.count == 0) return 0;
+
+	float bucket_size = h.max_value / BUCKETS_COUNT;
+	float target = h.count * percentile / 100;
+	int sum = 0;
+	for (int i = 0; i < BUCKETS_COUNT; ++i)
+	{
+		int bucket = h.buckets[i];
+		if (bucket > 0 && sum + bucket >= target)
+		{
+			float t = Math::clamp((target - sum) / bucket, 0.0f, 1.0f);
+			return (i + t) * bucket_size;
+		}
+		sum += bucket;
+	}
+	return h.max_value;
+}
+
+
+void add(Counter counter, int32 value)
+{
+	MT::atomicAdd(&g_instance.frame_counters[(int)counter], value);
+}
+
+
+int64 getCounter(Counter counter)
+{
+	return g_instance.counters[(int)counter];
+}
+
+
+const char* getCounterName(Counter counter)
+{
+	return COUNTER_NAMES[(int)counter];
+}
+
+
+void setHitchThreshold(float threshold)
+{
+	g_instance.hitch_threshold = threshold;
+}
+
+
+int getHitchCount()
+{
+	return g_instance.hitch_count;
+}
+
+
+void setDump(float period, const char* path)
+{
+	g_instance.dump_period = period;
+	g_instance.time_to_dump = period;
+	copyString(g_instance.dump_path, path ? path : "");
+}
+
+
+void dump(const char* path)
+{
+	OutputBlob blob(g_instance.allocator);
+	blob << "hitches " << g_instance.hitch_count;
+	for (int i = 0; i < (int)Counter::COUNT; ++i)
+	{
+		char tmp[30];
+		toCString(g_instance.counters[i], tmp, lengthOf(tmp));
+		blob << ", " << COUNTER_NAMES[i] << " " << tmp;
+	}
+	for (int i = 0; i < g_instance.histograms_count; ++i)
+	{
+		if (g_instance.histograms[i].count == 0) continue;
+		blob << ", " << g_instance.histograms[i].name << " p50 " << getPercentile(i, 50);
+		blob << " p95 " << getPercentile(i, 95) << " p99 " << getPercentile(i, 99);
+	}
+
+	if (!path || !path[0])
+	{
+		blob.write("\0", 1);
+		g_log_info.log("Engine") << (const char*)blob.getData();
+		return;
+	}
+
+	blob << "\n";
+	FS::OsFile file;
+	if (!file.open(path, FS::Mode::OPEN_OR_CREATE | FS::Mode::WRITE, g_instance.allocator))
+	{
+		g_log_error.log("Engine") << "Failed to write frame stats to " << path;
+		return;
+	}
+	file.seek(FS::SeekMode::END, 0);
+	file.write(blob.getData(), blob.getSize());
+	file.close();
+}
+
+
+void reset()
+{
+	for (int i = 0; i < g_instance.histograms_count; ++i)
+	{
+		Histogram& h = g_instance.histograms[i];
+		setMemory((void*)h.buckets, 0, sizeof(h.buckets));
+		h.count = 0;
+	}
+	setMemory(g_instance.counters, 0, sizeof(g_instance.counters));
+	g_instance.hitch_count = 0;
+}
+
+
+uint64 getRawTime()
+{
+	return g_instance.timer->getRawTimeSinceStart();
+}
+
+
+float toMilliseconds(uint64 raw_time)
+{
+	return float(raw_time * 1000.0 / g_instance.frequency);
+}
+
+
+void frame(float time)
+{
+	float ms = time * 1000;
+	record(g_frame_time, ms);
+	if (ms > g_instance.hitch_threshold) ++g_instance.hitch_count;
+
+	for (int i = 0; i < (int)Counter::COUNT; ++i)
+	{
+		int32 value = g_instance.frame_counters[i];
+		MT::atomicSubtract(&g_instance.frame_counters[i], value);
+		g_instance.counters[i] += value;
+	}
+
+	if (g_instance.dump_period <= 0) return;
+	g_instance.time_to_dump -= time;
+	if (g_instance.time_to_dump > 0) return;
+
+	g_instance.time_to_dump = g_instance.dump_period;
+	dump(g_instance.dump_path);
+	reset();
+}
+
+
+} // namespace FrameStats
+
+
+} // namespace Lumix
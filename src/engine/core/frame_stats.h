@@ -0,0 +1,86 @@
+#pragma once
+
+
+#include "lumix.h"
+
+
+namespace Lumix
+{
+
+
+// Fixed counters and histograms cheap enough to be always on, even in shipped builds: adding a
+// value is one or two atomic increments, there are no blocks, names or allocations per frame.
+namespace FrameStats
+{
+
+
+enum class Counter : int
+{
+	RESOURCES_LOADED,
+	BYTES_STREAMED,
+	DRAW_CALLS,
+
+	COUNT
+};
+
+
+enum
+{
+	MAX_HISTOGRAMS = 32,
+	BUCKETS_COUNT = 128,
+	// always the first histogram, in ms
+	FRAME_TIME = 0
+};
+
+
+// returns the existing histogram with the same name, -1 if there is no free one; values over
+// max_value are clamped into the last bucket
+LUMIX_ENGINE_API int addHistogram(const char* name, float max_value);
+LUMIX_ENGINE_API int getHistogramCount();
+LUMIX_ENGINE_API const char* getHistogramName(int histogram);
+// can be called from any thread
+LUMIX_ENGINE_API void record(int histogram, float value);
+LUMIX_ENGINE_API int getSampleCount(int histogram);
+// percentile in the 0-100 range, interpolated inside a bucket
+LUMIX_ENGINE_API float getPercentile(int histogram, float percentile);
+
+// can be called from any thread
+LUMIX_ENGINE_API void add(Counter counter, int32 value);
+// totals since the last reset, the current frame is included after frame()
+LUMIX_ENGINE_API int64 getCounter(Counter counter);
+LUMIX_ENGINE_API const char* getCounterName(Counter counter);
+
+// frames longer than threshold [ms] are hitches
+LUMIX_ENGINE_API void setHitchThreshold(float threshold);
+LUMIX_ENGINE_API int getHitchCount();
+
+// every period seconds the stats are written to the log, or appended to the file at path if
+// it is not empty, and reset; period <= 0 disables it
+LUMIX_ENGINE_API void setDump(float period, const char* path);
+LUMIX_ENGINE_API void dump(const char* path);
+LUMIX_ENGINE_API void reset();
+
+LUMIX_ENGINE_API uint64 getRawTime();
+LUMIX_ENGINE_API float toMilliseconds(uint64 raw_time);
+// main thread, time is the real length of the frame in seconds
+LUMIX_ENGINE_API void frame(float time);
+
+
+struct Scope
+{
+	explicit Scope(int histogram)
+		: histogram(histogram)
+		, start(getRawTime())
+	{
+	}
+	~Scope() { record(histogram, toMilliseconds(getRawTime() - start)); }
+
+	int histogram;
+	uint64 start;
+};
+
+
+} // namespace FrameStats
+
+
+} // namespace Lumix
@@ -73,6 +73,17 @@ public:
 		return true;
 	}
 
+	// moves all planes outwards, spheres closer than distance to the frustum pass
+	void grow(float distance)
+	{
+		for (int i = 0; i < PLANE_COUNT; ++i)
+		{
+			m_plane[i].d += distance;
+		}
+	}
+
+	static const int PLANE_COUNT = 6;
+	const Plane& getPlane(int index) const { return m_plane[index]; }
 	const Vec3& getCenter() const { return m_center; }
 	const Vec3& getPosition() const { return m_position; }
 	const Vec3& getDirection() const { return m_direction; }
@@ -94,9 +105,10 @@ private:
 		BOTTOM_PLANE,
 		COUNT
 	};
+	static_assert((int)Sides::COUNT == PLANE_COUNT, "Wrong plane count");
 
 private:
-	Plane m_plane[(uint32)Sides::COUNT];
+	Plane m_plane[PLANE_COUNT];
 	Vec3 m_center;
 	Vec3 m_position;
 	Vec3 m_direction;
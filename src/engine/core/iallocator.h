@@ -29,6 +29,15 @@ namespace Lumix
 #define LUMIX_DELETE(allocator, var) (allocator).deleteObject(var);
 
 
+struct AllocatorStats
+{
+	size_t live_bytes;
+	int32 live_count;
+	// since the allocator was created, allocation rate is the difference of two samples
+	uint32 allocation_count;
+};
+
+
 class LUMIX_ENGINE_API IAllocator
 {
 public:
@@ -42,6 +51,11 @@ public:
 	virtual void deallocate_aligned(void* ptr) = 0;
 	virtual void* reallocate_aligned(void* ptr, size_t size, size_t align) = 0;
 
+	// usable size of a live block, 0 for nullptr or if the allocator does not know it
+	virtual size_t getAllocationSize(void* ptr, bool is_aligned) { return 0; }
+	// false if the allocator does not keep statistics
+	virtual bool getStats(AllocatorStats& stats) { return false; }
+
 	template <class T> void deleteObject(T* ptr)
 	{
 		if (ptr)
@@ -8,6 +8,8 @@ namespace Lumix
 {
 
 	class IAllocator;
+	class InputBlob;
+	class OutputBlob;
 
 	class LUMIX_ENGINE_API InputSystem
 	{
@@ -41,6 +43,14 @@ namespace Lumix
 			virtual float getMouseYMove() const = 0;
 			virtual void clear() = 0;
 			virtual void addAction(uint32 action, InputType type, int key, int controller_id) = 0;
+
+			// writes the values of all actions and the mouse move, getActionValue returns the
+			// written values until stopRecordReplay() so the recording is what the game saw
+			virtual void recordFrame(OutputBlob& blob) = 0;
+			// reads a frame written by recordFrame, false at the end of the recording
+			virtual bool replayFrame(InputBlob& blob) = 0;
+			// getActionValue polls the devices again
+			virtual void stopRecordReplay() = 0;
 	};
 
 
@@ -54,6 +54,7 @@ JsonSerializer::JsonSerializer(FS::IFile& file,
 	m_is_first_in_block = true;
 	m_data = nullptr;
 	m_is_string_token = false;
+	m_write_buffer_size = 0;
 	if (m_access_mode == READ)
 	{
 		m_data_size = (int)file.size();
@@ -79,6 +80,7 @@ JsonSerializer::JsonSerializer(FS::IFile& file,
 
 JsonSerializer::~JsonSerializer()
 {
+	flush();
 	if (m_access_mode == READ && m_own_data)
 	{
 		m_allocator.deallocate((void*)m_data);
@@ -95,8 +97,8 @@ void JsonSerializer::serialize(const char* label, unsigned int value)
 	char tmp[20];
 	writeString(label);
 	toCString(value, tmp, 20);
-	m_file.write(" : ", stringLength(" : "));
-	m_file.write(tmp, stringLength(tmp));
+	write(" : ", stringLength(" : "));
+	write(tmp, stringLength(tmp));
 	m_is_first_in_block = false;
 }
 
@@ -107,8 +109,8 @@ void JsonSerializer::serialize(const char* label, float value)
 	char tmp[20];
 	writeString(label);
 	toCString(value, tmp, 20, 8);
-	m_file.write(" : ", stringLength(" : "));
-	m_file.write(tmp, stringLength(tmp));
+	write(" : ", stringLength(" : "));
+	write(tmp, stringLength(tmp));
 	m_is_first_in_block = false;
 }
 
@@ -119,8 +121,8 @@ void JsonSerializer::serialize(const char* label, int value)
 	char tmp[20];
 	writeString(label);
 	toCString(value, tmp, 20);
-	m_file.write(" : ", stringLength(" : "));
-	m_file.write(tmp, stringLength(tmp));
+	write(" : ", stringLength(" : "));
+	write(tmp, stringLength(tmp));
 	m_is_first_in_block = false;
 }
 
@@ -129,9 +131,9 @@ void JsonSerializer::serialize(const char* label, const Path& value)
 {
 	writeBlockComma();
 	writeString(label);
-	m_file.write(" : \"", 4);
-	m_file.write(value.c_str(), value.length());
-	m_file.write("\"", 1);
+	write(" : \"", 4);
+	write(value.c_str(), value.length());
+	write("\"", 1);
 	m_is_first_in_block = false;
 }
 
@@ -140,16 +142,16 @@ void JsonSerializer::serialize(const char* label, const char* value)
 {
 	writeBlockComma();
 	writeString(label);
-	m_file.write(" : \"", 4);
+	write(" : \"", 4);
 	if (value == nullptr)
 	{
-		m_file.write("", 1);
+		write("", 1);
 	}
 	else
 	{
-		m_file.write(value, stringLength(value));
+		write(value, stringLength(value));
 	}
-	m_file.write("\"", 1);
+	write("\"", 1);
 	m_is_first_in_block = false;
 }
 
@@ -158,7 +160,7 @@ void JsonSerializer::serialize(const char* label, bool value)
 {
 	writeBlockComma();
 	writeString(label);
-	m_file.write(value ? " : true" : " : false", value ? 7 : 8);
+	write(value ? " : true" : " : false", value ? 7 : 8);
 	m_is_first_in_block = false;
 }
 
@@ -166,7 +168,7 @@ void JsonSerializer::serialize(const char* label, bool value)
 void JsonSerializer::beginObject()
 {
 	writeBlockComma();
-	m_file.write("{", 1);
+	write("{", 1);
 	m_is_first_in_block = true;
 }
 
@@ -175,13 +177,13 @@ void JsonSerializer::beginObject(const char* label)
 {
 	writeBlockComma();
 	writeString(label);
-	m_file.write(" : {", 4);
+	write(" : {", 4);
 	m_is_first_in_block = true;
 }
 
 void JsonSerializer::endObject()
 {
-	m_file.write("}", 1);
+	write("}", 1);
 	m_is_first_in_block = false;
 }
 
@@ -190,14 +192,14 @@ void JsonSerializer::beginArray(const char* label)
 {
 	writeBlockComma();
 	writeString(label);
-	m_file.write(" : [", 4);
+	write(" : [", 4);
 	m_is_first_in_block = true;
 }
 
 
 void JsonSerializer::endArray()
 {
-	m_file.write("]", 1);
+	write("]", 1);
 	m_is_first_in_block = false;
 }
 
@@ -222,7 +224,7 @@ void JsonSerializer::serializeArrayItem(unsigned int value)
 	writeBlockComma();
 	char tmp[20];
 	toCString(value, tmp, 20);
-	m_file.write(tmp, stringLength(tmp));
+	write(tmp, stringLength(tmp));
 	m_is_first_in_block = false;
 }
 
@@ -232,7 +234,7 @@ void JsonSerializer::serializeArrayItem(int value)
 	writeBlockComma();
 	char tmp[20];
 	toCString(value, tmp, 20);
-	m_file.write(tmp, stringLength(tmp));
+	write(tmp, stringLength(tmp));
 	m_is_first_in_block = false;
 }
 
@@ -242,7 +244,7 @@ void JsonSerializer::serializeArrayItem(int64 value)
 	writeBlockComma();
 	char tmp[30];
 	toCString(value, tmp, 30);
-	m_file.write(tmp, stringLength(tmp));
+	write(tmp, stringLength(tmp));
 	m_is_first_in_block = false;
 }
 
@@ -252,7 +254,7 @@ void JsonSerializer::serializeArrayItem(float value)
 	writeBlockComma();
 	char tmp[20];
 	toCString(value, tmp, 20, 8);
-	m_file.write(tmp, stringLength(tmp));
+	write(tmp, stringLength(tmp));
 	m_is_first_in_block = false;
 }
 
@@ -260,7 +262,7 @@ void JsonSerializer::serializeArrayItem(float value)
 void JsonSerializer::serializeArrayItem(bool value)
 {
 	writeBlockComma();
-	m_file.write(value ? "true" : "false", value ? 4 : 5);
+	write(value ? "true" : "false", value ? 4 : 5);
 	m_is_first_in_block = false;
 }
 
@@ -728,14 +730,38 @@ void JsonSerializer::deserializeLabel(char* label, int max_length)
 }
 
 
+void JsonSerializer::write(const char* data, int size)
+{
+	if (m_write_buffer_size + size > lengthOf(m_write_buffer))
+	{
+		flush();
+		if (size > lengthOf(m_write_buffer))
+		{
+			m_file.write(data, size);
+			return;
+		}
+	}
+	copyMemory(m_write_buffer + m_write_buffer_size, data, size);
+	m_write_buffer_size += size;
+}
+
+
+void JsonSerializer::flush()
+{
+	if (m_write_buffer_size == 0) return;
+	m_file.write(m_write_buffer, m_write_buffer_size);
+	m_write_buffer_size = 0;
+}
+
+
 void JsonSerializer::writeString(const char* str)
 {
-	m_file.write("\"", 1);
+	write("\"", 1);
 	if (str)
 	{
-		m_file.write(str, stringLength(str));
+		write(str, stringLength(str));
 	}
-	m_file.write("\"", 1);
+	write("\"", 1);
 }
 
 
@@ -743,7 +769,7 @@ void JsonSerializer::writeBlockComma()
 {
 	if (!m_is_first_in_block)
 	{
-		m_file.write(",\n", 2);
+		write(",\n", 2);
 	}
 }
 
@@ -766,7 +792,8 @@ void JsonSerializer::deserializeLabel(const char* label)
 								<< "\", expected string.";
 		deserializeToken();
 	}
-	if (compareStringN(label, m_token, m_token_size) != 0)
+	// the token is not null terminated, the length check rejects most labels without comparing
+	if (stringLength(label) != m_token_size || compareStringN(label, m_token, m_token_size) != 0)
 	{
 		ErrorProxy(*this).log() << "Unexpected label \""
 								<< string(m_token, m_token_size, m_allocator) << "\", expected \""
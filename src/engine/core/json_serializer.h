@@ -32,6 +32,9 @@ namespace Lumix
 			JsonSerializer(FS::IFile& file, AccessMode access_mode, const Path& path, IAllocator& allocator);
 			~JsonSerializer();
 
+			// the output is buffered, it must be flushed before the file is closed
+			void flush();
+
 			// serialize
 			void serialize(const char* label, uint32 value);
 			void serialize(const char* label, float value);
@@ -89,6 +92,7 @@ namespace Lumix
 			void deserializeArrayComma();
 			float tokenToFloat();
 			void expectToken(char expected_token);
+			void write(const char* data, int size);
 			void writeString(const char* str);
 			void writeBlockComma();
 
@@ -110,6 +114,9 @@ namespace Lumix
 			int m_data_size;
 			bool m_own_data;
 			bool m_is_error;
+
+			char m_write_buffer[4096];
+			int m_write_buffer_size;
 	};
 
 
@@ -1,7 +1,11 @@
 #include "core/log.h"
 #include "core/array.h"
+#include "core/mt/atomic.h"
+#include "core/mt/lock_free_fixed_queue.h"
+#include "core/mt/task.h"
 #include "core/path.h"
 #include "core/string.h"
+#include "core/timer.h"
 
 
 namespace Lumix
@@ -13,6 +17,176 @@ Log g_log_warning;
 Log g_log_error;
 
 
+static const int32 MAX_QUEUED_RECORDS = 256;
+// more info and warning records in one second are dropped, errors never are
+static const int MAX_RECORDS_PER_SECOND = 100;
+
+
+struct LogRecord
+{
+	Log* log;
+	// system and message share one allocation
+	char* system;
+	char* message;
+};
+
+
+class LogWriter : public MT::Task
+{
+public:
+	explicit LogWriter(IAllocator& allocator)
+		: MT::Task(allocator)
+		, m_allocator(allocator)
+		, m_last_log(nullptr)
+		, m_last_system(allocator)
+		, m_last_message(allocator)
+		, m_repeat_count(0)
+		, m_window_start(0)
+		, m_window_count(0)
+		, m_rate_dropped_count(0)
+		, m_full_dropped_count(0)
+	{
+		m_timer = Timer::create(allocator);
+	}
+
+
+	~LogWriter() { Timer::destroy(m_timer); }
+
+
+	// lock free, when the queue is full the record is dropped instead of waiting for the writer
+	void push(Log& log, const char* system, const char* message)
+	{
+		LogRecord* record = m_queue.alloc(false);
+		if (!record)
+		{
+			MT::atomicIncrement(&m_full_dropped_count);
+			return;
+		}
+		int system_size = stringLength(system) + 1;
+		int message_size = stringLength(message) + 1;
+		record->log = &log;
+		record->system = (char*)m_allocator.allocate(system_size + message_size);
+		record->message = record->system + system_size;
+		copyMemory(record->system, system, system_size);
+		copyMemory(record->message, message, message_size);
+		m_queue.push(record, true);
+	}
+
+
+	// a record without log, the thread finishes once it gets to it
+	void pushStop()
+	{
+		LogRecord* record = m_queue.alloc(true);
+		record->log = nullptr;
+		record->system = record->message = nullptr;
+		m_queue.push(record, true);
+	}
+
+
+	int task() override
+	{
+		for (;;)
+		{
+			LogRecord* record = m_queue.pop(true);
+			if (!record) break;
+
+			Log* log = record->log;
+			if (log)
+			{
+				write(*log, record->system, record->message);
+				m_allocator.deallocate(record->system);
+			}
+			m_queue.dealoc(record);
+			if (!log) break;
+		}
+		flushRepeated();
+		reportDropped();
+		return 0;
+	}
+
+
+	IAllocator& m_allocator;
+
+private:
+	void write(Log& log, const char* system, const char* message)
+	{
+		if (&log == m_last_log && m_last_system == system && m_last_message == message)
+		{
+			++m_repeat_count;
+			return;
+		}
+		flushRepeated();
+
+		if (&log != &g_log_error)
+		{
+			float now = m_timer->getTimeSinceStart();
+			if (now - m_window_start > 1)
+			{
+				m_window_start = now;
+				m_window_count = 0;
+			}
+			if (m_window_count >= MAX_RECORDS_PER_SECOND)
+			{
+				++m_rate_dropped_count;
+				return;
+			}
+			++m_window_count;
+		}
+
+		reportDropped();
+		log.getCallback().invoke(system, message);
+		m_last_log = &log;
+		m_last_system = system;
+		m_last_message = message;
+	}
+
+
+	void flushRepeated()
+	{
+		if (m_repeat_count == 0) return;
+
+		char tmp[64];
+		copyString(tmp, "Last message repeated ");
+		int len = stringLength(tmp);
+		toCString(m_repeat_count, tmp + len, lengthOf(tmp) - len);
+		catString(tmp, " times");
+		m_repeat_count = 0;
+		m_last_log->getCallback().invoke(m_last_system.c_str(), tmp);
+	}
+
+
+	void reportDropped()
+	{
+		int32 dropped = m_full_dropped_count;
+		if (dropped > 0) MT::atomicSubtract(&m_full_dropped_count, dropped);
+		dropped += m_rate_dropped_count;
+		m_rate_dropped_count = 0;
+		if (dropped == 0) return;
+
+		char tmp[64];
+		toCString(dropped, tmp, lengthOf(tmp));
+		catString(tmp, " log messages were dropped");
+		g_log_warning.getCallback().invoke("Log", tmp);
+	}
+
+
+private:
+	MT::LockFreeFixedQueue<LogRecord, MAX_QUEUED_RECORDS> m_queue;
+	Timer* m_timer;
+	Log* m_last_log;
+	string m_last_system;
+	string m_last_message;
+	int m_repeat_count;
+	float m_window_start;
+	int m_window_count;
+	int m_rate_dropped_count;
+	volatile int32 m_full_dropped_count;
+};
+
+
+static LogWriter* volatile g_log_writer = nullptr;
+
+
 LogProxy Log::log(const char* system)
 {
 	return LogProxy(*this, system, m_allocator);
@@ -24,6 +198,32 @@ Log::Callback& Log::getCallback()
 	return m_callbacks;
 }
 
+
+void Log::startWriter(IAllocator& allocator)
+{
+	ASSERT(!g_log_writer);
+	LogWriter* writer = LUMIX_NEW(allocator, LogWriter)(allocator);
+	if (!writer->create("Log") || !writer->run())
+	{
+		LUMIX_DELETE(allocator, writer);
+		return;
+	}
+	g_log_writer = writer;
+}
+
+
+void Log::stopWriter()
+{
+	LogWriter* writer = g_log_writer;
+	if (!writer) return;
+
+	g_log_writer = nullptr;
+	writer->pushStop();
+	writer->destroy();
+	IAllocator& allocator = writer->m_allocator;
+	LUMIX_DELETE(allocator, writer);
+}
+
 LogProxy::LogProxy(Log& log, const char* system, IAllocator& allocator)
 	: m_allocator(allocator)
 	, m_log(log)
@@ -34,7 +234,15 @@ LogProxy::LogProxy(Log& log, const char* system, IAllocator& allocator)
 
 LogProxy::~LogProxy()
 {
-	m_log.getCallback().invoke(m_system.c_str(), m_message.c_str());
+	LogWriter* writer = g_log_writer;
+	if (writer)
+	{
+		writer->push(m_log, m_system.c_str(), m_message.c_str());
+	}
+	else
+	{
+		m_log.getCallback().invoke(m_system.c_str(), m_message.c_str());
+	}
 }
 
 
@@ -47,6 +47,13 @@ namespace Lumix
 
 			LogProxy log(const char* system);
 			Callback& getCallback();
+
+			// while the writer runs, records of all logs are queued and its thread passes them to
+			// the callbacks, repeated messages are merged and the ones over the rate limit are
+			// dropped; without it, the thread which logs calls the callbacks itself
+			static void startWriter(IAllocator& allocator);
+			// passes all queued records to the callbacks, no other thread may log meanwhile
+			static void stopWriter();
 		
 		private:
 			Log(const Log&);
@@ -0,0 +1,138 @@
+#include "core/lua_allocator.h"
+#include "core/iallocator.h"
+#include "core/math_utils.h"
+#include "core/string.h"
+
+
+namespace Lumix
+{
+
+
+static const size_t PAGE_SIZE = 64 * 1024;
+
+
+static int getSizeClass(size_t size)
+{
+	return int((size + 7) / 8) - 1;
+}
+
+
+LuaAllocator::LuaAllocator(IAllocator& parent)
+	: m_parent(parent)
+	, m_pages(parent)
+{
+	setMemory(m_classes, 0, sizeof(m_classes));
+	setMemory(&m_stats, 0, sizeof(m_stats));
+}
+
+
+LuaAllocator::~LuaAllocator()
+{
+	ASSERT(m_stats.large_count == 0);
+	for (void* page : m_pages)
+	{
+		m_parent.deallocate(page);
+	}
+}
+
+
+void* LuaAllocator::luaAlloc(void* user_data, void* ptr, size_t old_size, size_t new_size)
+{
+	return static_cast<LuaAllocator*>(user_data)->reallocate(ptr, old_size, new_size);
+}
+
+
+void* LuaAllocator::allocateSmall(int size_class)
+{
+	SizeClass& cls = m_classes[size_class];
+	size_t block_size = (size_class + 1) * GRANULARITY;
+	++m_stats.small_count;
+	m_stats.small_bytes += block_size;
+
+	if (cls.free_list)
+	{
+		void* ptr = cls.free_list;
+		cls.free_list = *(void**)ptr;
+		return ptr;
+	}
+
+	if (!cls.current || cls.current + block_size > cls.end)
+	{
+		uint8* page = (uint8*)m_parent.allocate(PAGE_SIZE);
+		m_pages.push(page);
+		m_stats.page_bytes += PAGE_SIZE;
+		cls.current = page;
+		cls.end = page + PAGE_SIZE;
+	}
+	void* ptr = cls.current;
+	cls.current += block_size;
+	return ptr;
+}
+
+
+void LuaAllocator::deallocateSmall(void* ptr, int size_class)
+{
+	SizeClass& cls = m_classes[size_class];
+	--m_stats.small_count;
+	m_stats.small_bytes -= (size_class + 1) * GRANULARITY;
+	*(void**)ptr = cls.free_list;
+	cls.free_list = ptr;
+}
+
+
+void* LuaAllocator::allocate(size_t size)
+{
+	if (size <= MAX_SMALL_SIZE) return allocateSmall(getSizeClass(size));
+
+	++m_stats.large_count;
+	m_stats.large_bytes += size;
+	return m_parent.allocate(size);
+}
+
+
+void LuaAllocator::deallocate(void* ptr, size_t size)
+{
+	if (size <= MAX_SMALL_SIZE)
+	{
+		deallocateSmall(ptr, getSizeClass(size));
+		return;
+	}
+
+	--m_stats.large_count;
+	m_stats.large_bytes -= size;
+	m_parent.deallocate(ptr);
+}
+
+
+void* LuaAllocator::reallocate(void* ptr, size_t old_size, size_t new_size)
+{
+	if (new_size == 0)
+	{
+		if (ptr) deallocate(ptr, old_size);
+		return nullptr;
+	}
+	// without a block, old_size is the type of the object Lua creates
+	if (!ptr) return allocate(new_size);
+
+	bool is_old_small = old_size <= MAX_SMALL_SIZE;
+	bool is_new_small = new_size <= MAX_SMALL_SIZE;
+	if (is_old_small && is_new_small && getSizeClass(old_size) == getSizeClass(new_size))
+	{
+		return ptr;
+	}
+	if (!is_old_small && !is_new_small)
+	{
+		void* new_ptr = m_parent.reallocate(ptr, new_size);
+		if (new_ptr) m_stats.large_bytes += new_size - old_size;
+		return new_ptr;
+	}
+
+	void* new_ptr = allocate(new_size);
+	if (!new_ptr) return nullptr;
+	copyMemory(new_ptr, ptr, Math::minValue(old_size, new_size));
+	deallocate(ptr, old_size);
+	return new_ptr;
+}
+
+
+} // ~namespace Lumix
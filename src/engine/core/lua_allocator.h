@@ -0,0 +1,70 @@
+#pragma once
+
+
+#include "lumix.h"
+#include "core/array.h"
+
+
+namespace Lumix
+{
+
+
+	class IAllocator;
+
+
+	/// Allocator of a Lua state, pass luaAlloc and the allocator to lua_newstate. Lua tells the
+	/// allocator the old size of every block, so small blocks need no header: they are rounded
+	/// up to size classes and served from free lists cut out of pages. Bigger blocks go to the
+	/// parent allocator. A Lua state runs on one thread at a time, so there is no locking.
+	/// Pages are returned to the parent only when the allocator is destroyed.
+	class LUMIX_ENGINE_API LuaAllocator
+	{
+		public:
+			struct Stats
+			{
+				size_t small_bytes; // live small blocks, rounded up to their size classes
+				size_t large_bytes;
+				size_t page_bytes; // taken from the parent for small blocks
+				int32 small_count;
+				int32 large_count;
+			};
+
+		public:
+			explicit LuaAllocator(IAllocator& parent);
+			~LuaAllocator();
+
+			// lua_Alloc, user_data is the LuaAllocator
+			static void* luaAlloc(void* user_data, void* ptr, size_t old_size, size_t new_size);
+			void* reallocate(void* ptr, size_t old_size, size_t new_size);
+			const Stats& getStats() const { return m_stats; }
+
+		private:
+			enum
+			{
+				GRANULARITY = 8,
+				MAX_SMALL_SIZE = 256,
+				SIZE_CLASS_COUNT = MAX_SMALL_SIZE / GRANULARITY
+			};
+
+			struct SizeClass
+			{
+				void* free_list;
+				uint8* current;
+				uint8* end;
+			};
+
+		private:
+			void* allocateSmall(int size_class);
+			void deallocateSmall(void* ptr, int size_class);
+			void* allocate(size_t size);
+			void deallocate(void* ptr, size_t size);
+
+		private:
+			IAllocator& m_parent;
+			SizeClass m_classes[SIZE_CLASS_COUNT];
+			Array<void*> m_pages;
+			Stats m_stats;
+	};
+
+
+} // ~namespace Lumix
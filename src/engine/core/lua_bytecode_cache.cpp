@@ -0,0 +1,209 @@
+#include "core/lua_bytecode_cache.h"
+#include "core/crc32.h"
+#include "core/fs/os_file.h"
+#include "core/log.h"
+#include "core/lua_compat.h"
+#include "core/string.h"
+
+
+namespace Lumix
+{
+
+
+static const uint32 CHUNK_MAGIC = 0x43425546; // 'FUBC'
+
+
+struct ChunkHeader
+{
+	uint32 magic;
+	uint32 hash;
+	uint32 source_size;
+	uint32 bytecode_size;
+};
+
+
+static int writeBytecode(lua_State*, const void* data, size_t size, void* user_data)
+{
+	auto& bytecode = *static_cast<Array<uint8>*>(user_data);
+	int offset = bytecode.size();
+	bytecode.resize(offset + (int)size);
+	copyMemory(&bytecode[offset], data, size);
+	return 0;
+}
+
+
+LuaBytecodeCache::LuaBytecodeCache(IAllocator& allocator)
+	: m_allocator(allocator)
+	, m_chunks(allocator)
+	, m_mutex(false)
+{
+	m_directory[0] = '\0';
+}
+
+
+LuaBytecodeCache::~LuaBytecodeCache()
+{
+	clear();
+}
+
+
+void LuaBytecodeCache::setDirectory(const char* path)
+{
+	copyString(m_directory, path);
+	int len = stringLength(m_directory);
+	if (len > 0 && m_directory[len - 1] != '/' && m_directory[len - 1] != '\\')
+	{
+		catString(m_directory, "/");
+	}
+}
+
+
+void LuaBytecodeCache::clear()
+{
+	MT::SpinLock lock(m_mutex);
+	for (Chunk* chunk : m_chunks)
+	{
+		LUMIX_DELETE(m_allocator, chunk);
+	}
+	m_chunks.clear();
+}
+
+
+LuaBytecodeCache::Chunk* LuaBytecodeCache::find(uint32 hash, size_t source_size)
+{
+	auto iter = m_chunks.find(hash);
+	if (!iter.isValid() || iter.value()->source_size != source_size) return nullptr;
+	return iter.value();
+}
+
+
+void LuaBytecodeCache::remove(uint32 hash)
+{
+	auto iter = m_chunks.find(hash);
+	if (!iter.isValid()) return;
+	LUMIX_DELETE(m_allocator, iter.value());
+	m_chunks.erase(iter);
+}
+
+
+void LuaBytecodeCache::getChunkPath(uint32 hash, char (&path)[MAX_PATH_LENGTH]) const
+{
+	char tmp[20];
+	copyString(path, m_directory);
+	toCString(hash, tmp, lengthOf(tmp));
+	catString(path, tmp);
+	catString(path, ".luac");
+}
+
+
+LuaBytecodeCache::Chunk* LuaBytecodeCache::loadFromDirectory(uint32 hash, size_t source_size)
+{
+	char path[MAX_PATH_LENGTH];
+	getChunkPath(hash, path);
+	FS::OsFile file;
+	if (!file.open(path, FS::Mode::OPEN_AND_READ, m_allocator)) return nullptr;
+
+	ChunkHeader header;
+	bool success = file.read(&header, sizeof(header)) && header.magic == CHUNK_MAGIC &&
+				   header.hash == hash && header.source_size == source_size &&
+				   // a file which was not written completely has a different size
+				   file.size() == sizeof(header) + header.bytecode_size &&
+				   header.bytecode_size > 0;
+	Chunk* chunk = nullptr;
+	if (success)
+	{
+		chunk = LUMIX_NEW(m_allocator, Chunk)(m_allocator);
+		chunk->source_size = header.source_size;
+		chunk->bytecode.resize(header.bytecode_size);
+		if (!file.read(&chunk->bytecode[0], chunk->bytecode.size()))
+		{
+			LUMIX_DELETE(m_allocator, chunk);
+			chunk = nullptr;
+		}
+	}
+	file.close();
+	return chunk;
+}
+
+
+void LuaBytecodeCache::storeToDirectory(uint32 hash, const Chunk& chunk)
+{
+	char path[MAX_PATH_LENGTH];
+	getChunkPath(hash, path);
+	FS::OsFile file;
+	if (!file.open(path, FS::Mode::CREATE | FS::Mode::WRITE, m_allocator))
+	{
+		g_log_warning.log("Lua") << "Could not write bytecode " << path;
+		return;
+	}
+
+	ChunkHeader header;
+	header.magic = CHUNK_MAGIC;
+	header.hash = hash;
+	header.source_size = chunk.source_size;
+	header.bytecode_size = chunk.bytecode.size();
+	file.write(&header, sizeof(header));
+	file.write(&chunk.bytecode[0], chunk.bytecode.size());
+	file.close();
+}
+
+
+int LuaBytecodeCache::load(lua_State* L, const char* source, size_t size, const char* name)
+{
+	// the chunk name is a part of the debug info in the bytecode
+	uint32 hash = continueCrc32(crc32(source, (int)size), name ? name : "");
+
+	Chunk* loaded = nullptr;
+	{
+		MT::SpinLock lock(m_mutex);
+		Chunk* chunk = find(hash, size);
+		if (chunk)
+		{
+			const char* bytecode = (const char*)&chunk->bytecode[0];
+			if (luaL_loadbuffer(L, bytecode, chunk->bytecode.size(), name) == LUA_OK)
+			{
+				return LUA_OK;
+			}
+			lua_pop(L, 1);
+			remove(hash);
+		}
+	}
+
+	if (m_directory[0]) loaded = loadFromDirectory(hash, size);
+	if (loaded)
+	{
+		const char* bytecode = (const char*)&loaded->bytecode[0];
+		if (luaL_loadbuffer(L, bytecode, loaded->bytecode.size(), name) != LUA_OK)
+		{
+			// written by a different version of Lua
+			lua_pop(L, 1);
+			LUMIX_DELETE(m_allocator, loaded);
+			loaded = nullptr;
+		}
+	}
+
+	if (!loaded)
+	{
+		int res = luaL_loadbuffer(L, source, size, name);
+		if (res != LUA_OK) return res;
+
+		// keep the debug info, errors should still report lines
+		loaded = LUMIX_NEW(m_allocator, Chunk)(m_allocator);
+		loaded->source_size = (uint32)size;
+		lua_dump(L, writeBytecode, &loaded->bytecode, 0);
+		if (loaded->bytecode.empty())
+		{
+			LUMIX_DELETE(m_allocator, loaded);
+			return LUA_OK;
+		}
+		if (m_directory[0]) storeToDirectory(hash, *loaded);
+	}
+
+	MT::SpinLock lock(m_mutex);
+	remove(hash);
+	m_chunks.insert(hash, loaded);
+	return LUA_OK;
+}
+
+
+} // ~namespace Lumix
@@ -0,0 +1,64 @@
+#pragma once
+
+
+#include "lumix.h"
+#include "core/array.h"
+#include "core/hash_map.h"
+#include "core/mt/sync.h"
+
+
+struct lua_State;
+
+
+namespace Lumix
+{
+
+
+	class IAllocator;
+
+
+	/// Compiled Lua chunks keyed by the hash of their source and chunk name, so a source is
+	/// parsed only the first time it is seen. With a directory set, chunks are also written
+	/// there (like luac output) and the next run loads them without parsing at all.
+	class LUMIX_ENGINE_API LuaBytecodeCache
+	{
+		public:
+			explicit LuaBytecodeCache(IAllocator& allocator);
+			~LuaBytecodeCache();
+
+			// "" keeps the chunks in memory only
+			void setDirectory(const char* path);
+			const char* getDirectory() const { return m_directory; }
+			// same as luaL_loadbuffer, the chunk is pushed on success, the error message otherwise
+			int load(lua_State* L, const char* source, size_t size, const char* name);
+			void clear();
+
+		private:
+			struct Chunk
+			{
+				explicit Chunk(IAllocator& allocator)
+					: source_size(0)
+					, bytecode(allocator)
+				{
+				}
+
+				uint32 source_size;
+				Array<uint8> bytecode;
+			};
+
+		private:
+			Chunk* find(uint32 hash, size_t source_size);
+			Chunk* loadFromDirectory(uint32 hash, size_t source_size);
+			void storeToDirectory(uint32 hash, const Chunk& chunk);
+			void getChunkPath(uint32 hash, char (&path)[MAX_PATH_LENGTH]) const;
+			void remove(uint32 hash);
+
+		private:
+			IAllocator& m_allocator;
+			HashMap<uint32, Chunk*> m_chunks;
+			MT::SpinMutex m_mutex;
+			char m_directory[MAX_PATH_LENGTH];
+	};
+
+
+} // ~namespace Lumix
@@ -0,0 +1,41 @@
+#pragma once
+
+
+// Lua headers for the engine and the plugins. The code is written against Lua 5.3. Building
+// with LUMIX_LUAJIT defined switches to LuaJIT: link lua51 instead of lua and export the
+// API from engine_luajit.def instead of engine.def. LuaJIT implements the 5.1 API, the 5.3
+// calls the code uses are mapped onto it below.
+#include <lua.hpp>
+#include <lauxlib.h>
+
+
+#ifdef LUMIX_LUAJIT
+
+
+#ifndef LUA_OK
+	#define LUA_OK 0
+#endif
+
+
+// 5.3 getters return the type of the pushed value
+#define lua_getfield(L, index, key) (lua_getfield(L, index, key), lua_type(L, -1))
+#define lua_rawgeti(L, index, n) (lua_rawgeti(L, index, n), lua_type(L, -1))
+#undef lua_getglobal
+#define lua_getglobal(L, name) lua_getfield(L, LUA_GLOBALSINDEX, name)
+
+#define lua_rawlen(L, index) lua_objlen(L, index)
+#define lua_pushglobaltable(L) lua_pushvalue(L, LUA_GLOBALSINDEX)
+// there is no strip flag, the debug info is always kept
+#define lua_dump(L, writer, data, strip) lua_dump(L, writer, data)
+
+
+// there is no integer subtype, a number is an integer if it has no fractional part
+inline int lua_isinteger(lua_State* L, int index)
+{
+	if (lua_type(L, index) != LUA_TNUMBER) return 0;
+	lua_Number value = lua_tonumber(L, index);
+	return value == (lua_Number)(lua_Integer)value;
+}
+
+
+#endif
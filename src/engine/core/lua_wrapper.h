@@ -2,9 +2,8 @@
 
 
 #include "core/log.h"
+#include "core/lua_compat.h"
 #include "core/vec.h"
-#include <lua.hpp>
-#include <lauxlib.h>
 #include <tuple>
 
 
@@ -14,6 +13,17 @@ namespace Lumix
 
 namespace LuaWrapper
 {
+// metatable of Vec3 userdata, registered with the engine's Lua API; functions taking a Vec3
+// accept both the userdata and a table {x, y, z}
+static const char VEC3_TYPE_NAME[] = "Vec3";
+
+
+inline Vec3* toVec3Userdata(lua_State* L, int index)
+{
+	return (Vec3*)luaL_testudata(L, index, VEC3_TYPE_NAME);
+}
+
+
 template <typename T> inline T toType(lua_State* L, int index)
 {
 	return (T)lua_touserdata(L, index);
@@ -24,6 +34,8 @@ template <> inline int toType(lua_State* L, int index)
 }
 template <> inline Vec3 toType(lua_State* L, int index)
 {
+	if (Vec3* userdata = toVec3Userdata(L, index)) return *userdata;
+
 	Vec3 v;
 	lua_rawgeti(L, index, 1);
 	v.x = (float)lua_tonumber(L, -1);
@@ -101,7 +113,7 @@ template <> inline bool isType<int>(lua_State* L, int index)
 }
 template <> inline bool isType<Vec3>(lua_State* L, int index)
 {
-	return lua_istable(L, index) != 0;
+	return lua_istable(L, index) != 0 || toVec3Userdata(L, index);
 }
 template <> inline bool isType<uint32>(lua_State* L, int index)
 {
@@ -137,19 +149,24 @@ template <> inline void pushLua(lua_State* L, float value)
 {
 	lua_pushnumber(L, value);
 }
+// a table in states without the Vec3 metatable, the userdata can be indexed the same way
 inline void pushLua(lua_State* L, const Vec3& value)
 {
-	lua_createtable(L, 3, 0);
+	if (luaL_getmetatable(L, VEC3_TYPE_NAME) != LUA_TNIL)
+	{
+		auto* v = (Vec3*)lua_newuserdata(L, sizeof(Vec3));
+		*v = value;
+		lua_insert(L, -2);
+		lua_setmetatable(L, -2);
+		return;
+	}
+	lua_pop(L, 1);
 
-	lua_pushvalue(L, -1);
+	lua_createtable(L, 3, 0);
 	lua_pushnumber(L, value.x);
 	lua_rawseti(L, -2, 1);
-
-	lua_pushvalue(L, -1);
 	lua_pushnumber(L, value.y);
 	lua_rawseti(L, -2, 2);
-
-	lua_pushvalue(L, -1);
 	lua_pushnumber(L, value.z);
 	lua_rawseti(L, -2, 3);
 }
@@ -201,6 +218,48 @@ inline void createSystemFunction(lua_State* L, const char* system, const char* v
 }
 
 
+// pops a table and makes it the environment of the function at function_index
+inline void setEnvironment(lua_State* L, int function_index)
+{
+#ifdef LUMIX_LUAJIT
+	lua_setfenv(L, function_index);
+#else
+	lua_setupvalue(L, function_index, 1);
+#endif
+}
+
+
+#ifdef LUMIX_LUAJIT
+// Declares the C functions in cdefs to the FFI and sets system.ffi to the namespace of library,
+// scripts call them directly, without the lua_CFunction marshalling. Without the library, e.g.
+// with static plugins, the functions are looked up in the executable.
+inline void createFFINamespace(lua_State* L,
+	const char* system,
+	const char* library,
+	const char* cdefs)
+{
+	static const char* src = "local system, library, cdefs = ...\n"
+							 "local ffi = require(\"ffi\")\n"
+							 "ffi.cdef(cdefs)\n"
+							 "local ok, lib = pcall(ffi.load, library)\n"
+							 "_G[system].ffi = ok and lib or ffi.C\n";
+	bool errors = luaL_loadstring(L, src) != LUA_OK;
+	if (!errors)
+	{
+		lua_pushstring(L, system);
+		lua_pushstring(L, library);
+		lua_pushstring(L, cdefs);
+		errors = lua_pcall(L, 3, 0, 0) != LUA_OK;
+	}
+	if (errors)
+	{
+		g_log_error.log("Lua") << system << " FFI: " << lua_tostring(L, -1);
+		lua_pop(L, 1);
+	}
+}
+#endif
+
+
 inline const char* luaTypeToString(int type)
 {
 	switch (type)
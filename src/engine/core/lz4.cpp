@@ -0,0 +1,204 @@
+#include "core/lz4.h"
+#include "core/math_utils.h"
+#include "core/string.h"
+
+
+namespace Lumix
+{
+
+
+static const int MIN_MATCH = 4;
+static const int LAST_LITERALS = 5;
+static const int MATCH_START_LIMIT = 12;
+static const int MAX_OFFSET = 0xffff;
+static const int HASH_BITS = 12;
+
+
+static uint32 read32(const uint8* ptr)
+{
+	uint32 value;
+	copyMemory(&value, ptr, sizeof(value));
+	return value;
+}
+
+
+static uint32 hashSequence(uint32 sequence)
+{
+	return (sequence * 2654435761U) >> (32 - HASH_BITS);
+}
+
+
+static uint8* writeLength(uint8* op, int length)
+{
+	while (length >= 255)
+	{
+		*op++ = 255;
+		length -= 255;
+	}
+	*op++ = (uint8)length;
+	return op;
+}
+
+
+static bool readLength(const uint8*& ip, const uint8* iend, int& length)
+{
+	uint8 byte;
+	do
+	{
+		if (ip >= iend) return false;
+		byte = *ip++;
+		length += byte;
+	} while (byte == 255);
+	return true;
+}
+
+
+int lz4CompressBound(int size)
+{
+	return size + size / 255 + 16;
+}
+
+
+int lz4Compress(const void* src, int src_size, void* dst, int dst_capacity)
+{
+	ASSERT(dst_capacity >= lz4CompressBound(src_size));
+
+	const uint8* const base = (const uint8*)src;
+	const uint8* const end = base + src_size;
+	const uint8* ip = base;
+	const uint8* anchor = base;
+	uint8* op = (uint8*)dst;
+
+	if (src_size > MATCH_START_LIMIT)
+	{
+		int table[1 << HASH_BITS];
+		for (int& i : table) i = -1;
+
+		const uint8* const match_start_limit = end - MATCH_START_LIMIT;
+		const uint8* const match_end_limit = end - LAST_LITERALS;
+		while (ip < match_start_limit)
+		{
+			uint32 sequence = read32(ip);
+			uint32 hash = hashSequence(sequence);
+			int candidate = table[hash];
+			table[hash] = int(ip - base);
+			if (candidate < 0 || ip - (base + candidate) > MAX_OFFSET || read32(base + candidate) != sequence)
+			{
+				++ip;
+				continue;
+			}
+
+			const uint8* match = base + candidate;
+			const uint8* match_end = ip + MIN_MATCH;
+			const uint8* ref = match + MIN_MATCH;
+			while (match_end < match_end_limit && *match_end == *ref)
+			{
+				++match_end;
+				++ref;
+			}
+
+			int literal_length = int(ip - anchor);
+			int match_length = int(match_end - ip) - MIN_MATCH;
+			uint8* token = op++;
+			*token = uint8((Math::minValue(literal_length, 15) << 4) | Math::minValue(match_length, 15));
+			if (literal_length >= 15) op = writeLength(op, literal_length - 15);
+			copyMemory(op, anchor, literal_length);
+			op += literal_length;
+			int offset = int(ip - match);
+			*op++ = uint8(offset & 0xff);
+			*op++ = uint8(offset >> 8);
+			if (match_length >= 15) op = writeLength(op, match_length - 15);
+
+			ip = match_end;
+			anchor = ip;
+		}
+	}
+
+	int literal_length = int(end - anchor);
+	*op++ = uint8(Math::minValue(literal_length, 15) << 4);
+	if (literal_length >= 15) op = writeLength(op, literal_length - 15);
+	copyMemory(op, anchor, literal_length);
+	op += literal_length;
+
+	return int(op - (uint8*)dst);
+}
+
+
+int lz4Decompress(const void* src, int src_size, void* dst, int dst_capacity)
+{
+	const uint8* ip = (const uint8*)src;
+	const uint8* const iend = ip + src_size;
+	uint8* const base = (uint8*)dst;
+	uint8* op = base;
+	uint8* const oend = base + dst_capacity;
+
+	while (ip < iend)
+	{
+		uint8 token = *ip++;
+
+		int literal_length = token >> 4;
+		if (literal_length == 15 && !readLength(ip, iend, literal_length)) return -1;
+		if (literal_length > iend - ip || literal_length > oend - op) return -1;
+		copyMemory(op, ip, literal_length);
+		ip += literal_length;
+		op += literal_length;
+
+		// the last sequence has only literals
+		if (ip == iend) break;
+
+		if (iend - ip < 2) return -1;
+		int offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > op - base) return -1;
+
+		int match_length = token & 15;
+		if (match_length == 15 && !readLength(ip, iend, match_length)) return -1;
+		match_length += MIN_MATCH;
+		if (match_length > oend - op) return -1;
+
+		// source and destination can overlap, e.g. offset 1 repeats the last byte
+		const uint8* match = op - offset;
+		for (int i = 0; i < match_length; ++i) op[i] = match[i];
+		op += match_length;
+	}
+
+	return int(op - base);
+}
+
+
+bool lz4CompressInPlace(Array<uint8>& data, IAllocator& allocator)
+{
+	int raw_size = data.size();
+	if (raw_size == 0) return false;
+
+	Array<uint8> compressed(allocator);
+	compressed.resize(lz4CompressBound(raw_size));
+	int size = lz4Compress(&data[0], raw_size, &compressed[0], compressed.size());
+	if (size <= 0 || size + (int)sizeof(int32) >= raw_size) return false;
+
+	Array<uint8> packed(allocator);
+	packed.resize(sizeof(int32) + size);
+	copyMemory(&packed[0], &raw_size, sizeof(raw_size));
+	copyMemory(&packed[sizeof(int32)], &compressed[0], size);
+	data.swap(packed);
+	return true;
+}
+
+
+bool lz4DecompressInPlace(Array<uint8>& data, IAllocator& allocator)
+{
+	if (data.size() < (int)sizeof(int32)) return false;
+
+	int32 raw_size;
+	copyMemory(&raw_size, &data[0], sizeof(raw_size));
+	if (raw_size <= 0) return false;
+	Array<uint8> raw(allocator);
+	raw.resize(raw_size);
+	int size = data.size() - (int)sizeof(int32);
+	if (lz4Decompress(&data[sizeof(int32)], size, &raw[0], raw_size) != raw_size) return false;
+	data.swap(raw);
+	return true;
+}
+
+
+} // namespace Lumix
@@ -0,0 +1,27 @@
+#pragma once
+
+
+#include "lumix.h"
+#include "core/array.h"
+
+
+namespace Lumix
+{
+
+
+// Compressor and decompressor of the LZ4 block format, blocks are compatible with the reference
+// implementation, frames and dictionaries are not supported.
+LUMIX_ENGINE_API int lz4CompressBound(int size);
+// dst must be at least lz4CompressBound(src_size) bytes, returns size of compressed data
+LUMIX_ENGINE_API int lz4Compress(const void* src, int src_size, void* dst, int dst_capacity);
+// returns size of decompressed data or -1 if src is malformed or does not fit into dst
+LUMIX_ENGINE_API int lz4Decompress(const void* src, int src_size, void* dst, int dst_capacity);
+// replaces data by its raw size followed by the compressed block, the old buffer is freed;
+// returns false and leaves data untouched if it would not get smaller, allocator must be
+// the one of data
+LUMIX_ENGINE_API bool lz4CompressInPlace(Array<uint8>& data, IAllocator& allocator);
+// reverts lz4CompressInPlace
+LUMIX_ENGINE_API bool lz4DecompressInPlace(Array<uint8>& data, IAllocator& allocator);
+
+
+} // namespace Lumix
@@ -2,12 +2,32 @@
 #include "core/quat.h"
 #include "core/vec.h"
 #include <cmath>
+#include <xmmintrin.h>
 
 
 namespace Lumix
 {
 
 
+// rows of the result are linear combinations of the rows of lhs, weighted by the rows of rhs
+static void multiplyRows(float* result, const float* lhs, const float* rhs)
+{
+	__m128 row0 = _mm_loadu_ps(lhs);
+	__m128 row1 = _mm_loadu_ps(lhs + 4);
+	__m128 row2 = _mm_loadu_ps(lhs + 8);
+	__m128 row3 = _mm_loadu_ps(lhs + 12);
+	for (int i = 0; i < 4; ++i)
+	{
+		const float* weights = rhs + i * 4;
+		__m128 tmp = _mm_mul_ps(_mm_set1_ps(weights[0]), row0);
+		tmp = _mm_add_ps(tmp, _mm_mul_ps(_mm_set1_ps(weights[1]), row1));
+		tmp = _mm_add_ps(tmp, _mm_mul_ps(_mm_set1_ps(weights[2]), row2));
+		tmp = _mm_add_ps(tmp, _mm_mul_ps(_mm_set1_ps(weights[3]), row3));
+		_mm_storeu_ps(result + i * 4, tmp);
+	}
+}
+
+
 const Matrix Matrix::IDENTITY(
 	1, 0, 0, 0,
 	0, 1, 0, 0,
@@ -63,51 +83,15 @@ void multiplicate(Matrix& result, const Matrix& op1, const Matrix& op2)
 	ASSERT(&result != &op2);
 	ASSERT(&result != &op1); // use operator *
 
-	result.m11 = op1.m11 * op2.m11 + op1.m21 * op2.m12 + op1.m31 * op2.m13 + op1.m41 * op2.m14;
-	result.m21 = op1.m11 * op2.m21 + op1.m21 * op2.m22 + op1.m31 * op2.m23 + op1.m41 * op2.m24;
-	result.m31 = op1.m11 * op2.m31 + op1.m21 * op2.m32 + op1.m31 * op2.m33 + op1.m41 * op2.m34;
-	result.m41 = op1.m11 * op2.m41 + op1.m21 * op2.m42 + op1.m31 * op2.m43 + op1.m41 * op2.m44;
-
-	result.m12 = op1.m12 * op2.m11 + op1.m22 * op2.m12 + op1.m32 * op2.m13 + op1.m42 * op2.m14;
-	result.m22 = op1.m12 * op2.m21 + op1.m22 * op2.m22 + op1.m32 * op2.m23 + op1.m42 * op2.m24;
-	result.m32 = op1.m12 * op2.m31 + op1.m22 * op2.m32 + op1.m32 * op2.m33 + op1.m42 * op2.m34;
-	result.m42 = op1.m12 * op2.m41 + op1.m22 * op2.m42 + op1.m32 * op2.m43 + op1.m42 * op2.m44;
-
-	result.m13 = op1.m13 * op2.m11 + op1.m23 * op2.m12 + op1.m33 * op2.m13 + op1.m43 * op2.m14;
-	result.m23 = op1.m13 * op2.m21 + op1.m23 * op2.m22 + op1.m33 * op2.m23 + op1.m43 * op2.m24;
-	result.m33 = op1.m13 * op2.m31 + op1.m23 * op2.m32 + op1.m33 * op2.m33 + op1.m43 * op2.m34;
-	result.m43 = op1.m13 * op2.m41 + op1.m23 * op2.m42 + op1.m33 * op2.m43 + op1.m43 * op2.m44;
-
-	result.m14 = op1.m14 * op2.m11 + op1.m24 * op2.m12 + op1.m34 * op2.m13 + op1.m44 * op2.m14;
-	result.m24 = op1.m14 * op2.m21 + op1.m24 * op2.m22 + op1.m34 * op2.m23 + op1.m44 * op2.m24;
-	result.m34 = op1.m14 * op2.m31 + op1.m24 * op2.m32 + op1.m34 * op2.m33 + op1.m44 * op2.m34;
-	result.m44 = op1.m14 * op2.m41 + op1.m24 * op2.m42 + op1.m34 * op2.m43 + op1.m44 * op2.m44;
+	multiplyRows(&result.m11, &op1.m11, &op2.m11);
 }
 
 
 Matrix Matrix::operator *(const Matrix& rhs) const
 {
-	return Matrix(
-		this->m11 * rhs.m11 + this->m21 * rhs.m12 + this->m31 * rhs.m13 + this->m41 * rhs.m14,
-		this->m12 * rhs.m11 + this->m22 * rhs.m12 + this->m32 * rhs.m13 + this->m42 * rhs.m14,
-		this->m13 * rhs.m11 + this->m23 * rhs.m12 + this->m33 * rhs.m13 + this->m43 * rhs.m14,
-		this->m14 * rhs.m11 + this->m24 * rhs.m12 + this->m34 * rhs.m13 + this->m44 * rhs.m14,
-
-		this->m11 * rhs.m21 + this->m21 * rhs.m22 + this->m31 * rhs.m23 + this->m41 * rhs.m24,
-		this->m12 * rhs.m21 + this->m22 * rhs.m22 + this->m32 * rhs.m23 + this->m42 * rhs.m24,
-		this->m13 * rhs.m21 + this->m23 * rhs.m22 + this->m33 * rhs.m23 + this->m43 * rhs.m24,
-		this->m14 * rhs.m21 + this->m24 * rhs.m22 + this->m34 * rhs.m23 + this->m44 * rhs.m24,
-
-		this->m11 * rhs.m31 + this->m21 * rhs.m32 + this->m31 * rhs.m33 + this->m41 * rhs.m34,
-		this->m12 * rhs.m31 + this->m22 * rhs.m32 + this->m32 * rhs.m33 + this->m42 * rhs.m34,
-		this->m13 * rhs.m31 + this->m23 * rhs.m32 + this->m33 * rhs.m33 + this->m43 * rhs.m34,
-		this->m14 * rhs.m31 + this->m24 * rhs.m32 + this->m34 * rhs.m33 + this->m44 * rhs.m34,
-
-		this->m11 * rhs.m41 + this->m21 * rhs.m42 + this->m31 * rhs.m43 + this->m41 * rhs.m44,
-		this->m12 * rhs.m41 + this->m22 * rhs.m42 + this->m32 * rhs.m43 + this->m42 * rhs.m44,
-		this->m13 * rhs.m41 + this->m23 * rhs.m42 + this->m33 * rhs.m43 + this->m43 * rhs.m44,
-		this->m14 * rhs.m41 + this->m24 * rhs.m42 + this->m34 * rhs.m43 + this->m44 * rhs.m44
-	);
+	Matrix result;
+	multiplyRows(&result.m11, &m11, &rhs.m11);
+	return result;
 }
 
 
@@ -199,11 +183,13 @@ void Matrix::multiply3x3(float scale)
 
 Vec3 Matrix::multiplyPosition(const Vec3& rhs) const
 {
-	return Vec3(
-		m11 * rhs.x + m21 * rhs.y + m31 * rhs.z + m41,	
-		m12 * rhs.x + m22 * rhs.y + m32 * rhs.z + m42,	
-		m13 * rhs.x + m23 * rhs.y + m33 * rhs.z + m43
-	);
+	__m128 tmp = _mm_loadu_ps(&m41);
+	tmp = _mm_add_ps(tmp, _mm_mul_ps(_mm_set1_ps(rhs.x), _mm_loadu_ps(&m11)));
+	tmp = _mm_add_ps(tmp, _mm_mul_ps(_mm_set1_ps(rhs.y), _mm_loadu_ps(&m21)));
+	tmp = _mm_add_ps(tmp, _mm_mul_ps(_mm_set1_ps(rhs.z), _mm_loadu_ps(&m31)));
+	float result[4];
+	_mm_storeu_ps(result, tmp);
+	return Vec3(result[0], result[1], result[2]);
 }
 
 
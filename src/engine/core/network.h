@@ -18,6 +18,38 @@ namespace Net
 class TCPStream;
 
 
+// IPv4 address and port in host byte order
+struct Address
+{
+	uint32 ip;
+	uint16 port;
+
+	bool operator==(const Address& rhs) const { return ip == rhs.ip && port == rhs.port; }
+};
+
+
+LUMIX_ENGINE_API Address makeAddress(const char* ip, uint16 port);
+
+
+// non-blocking, packets can get lost, duplicated or come out of order
+class LUMIX_ENGINE_API UDPSocket
+{
+public:
+	UDPSocket();
+	~UDPSocket();
+
+	// port 0 lets the system choose one, e.g. for clients
+	bool open(uint16 port);
+	void close();
+	bool send(const Address& address, const void* data, int size);
+	// size of the received packet, -1 when there is none
+	int receive(Address* address, void* data, int max_size);
+
+private:
+	uintptr m_socket;
+};
+
+
 class LUMIX_ENGINE_API TCPAcceptor
 {
 public:
@@ -82,6 +114,8 @@ public:
 
 	bool read(void* buffer, size_t size);
 	bool write(const void* buffer, size_t size);
+	// makes pending and future reads and writes fail, can be called from another thread
+	void shutdown();
 
 private:
 	TCPStream();
@@ -3,6 +3,7 @@
 
 #include "core/blob.h"
 #include "core/crc32.h"
+#include "core/mt/atomic.h"
 #include "core/mt/sync.h"
 #include "core/path_utils.h"
 #include "core/string.h"
@@ -14,11 +15,20 @@ namespace Lumix
 	static PathManager* g_path_manager = nullptr;
 
 
-	PathManager::PathManager(Lumix::IAllocator& allocator)
+	PathManager::Shard::Shard(IAllocator& allocator)
 		: m_paths(allocator)
+		, m_pages(allocator)
+		, m_page_used(PAGE_SIZE)
 		, m_mutex(false)
-		, m_allocator(allocator)
 	{
+		for (auto& free : m_free) free = nullptr;
+	}
+
+
+	PathManager::PathManager(Lumix::IAllocator& allocator)
+		: m_allocator(allocator)
+	{
+		for (auto& shard : m_shards) shard = LUMIX_NEW(m_allocator, Shard)(m_allocator);
 		g_path_manager = this;
 		m_empty_path = getPath(0, "");
 	}
@@ -28,26 +38,38 @@ namespace Lumix
 	{
 		decrementRefCount(m_empty_path);
 		m_empty_path = nullptr;
-		ASSERT(m_paths.size() == 0);
+		for (Shard* shard : m_shards)
+		{
+			ASSERT(shard->m_paths.empty());
+			for (uint8* page : shard->m_pages) m_allocator.deallocate(page);
+			LUMIX_DELETE(m_allocator, shard);
+		}
 		g_path_manager = nullptr;
 	}
 
 
 	void PathManager::serialize(OutputBlob& serializer)
 	{
-		MT::SpinLock lock(m_mutex);
-		clear();
-		serializer.write((int32)m_paths.size());
-		for (int i = 0; i < m_paths.size(); ++i)
+		for (Shard* shard : m_shards) shard->m_mutex.lock();
+
+		int32 count = 0;
+		for (Shard* shard : m_shards)
 		{
-			serializer.writeString(m_paths.at(i)->m_path);
+			clear(*shard);
+			count += shard->m_paths.size();
 		}
+		serializer.write(count);
+		for (Shard* shard : m_shards)
+		{
+			for (PathInternal* path : shard->m_paths) serializer.writeString(path->m_path);
+		}
+
+		for (Shard* shard : m_shards) shard->m_mutex.unlock();
 	}
 
 
 	void PathManager::deserialize(InputBlob& serializer)
 	{
-		MT::SpinLock lock(m_mutex);
 		int32 size;
 		serializer.read(size);
 		for (int i = 0; i < size; ++i)
@@ -55,8 +77,10 @@ namespace Lumix
 			char path[MAX_PATH_LENGTH];
 			serializer.readString(path, sizeof(path));
 			uint32 hash = crc32(path);
-			PathInternal* internal = getPathMultithreadUnsafe(hash, path);
-			--internal->m_ref_count;
+			Shard& shard = getShard(hash);
+			MT::SpinLock lock(shard.m_mutex);
+			PathInternal* internal = getPathMultithreadUnsafe(shard, hash, path);
+			MT::atomicDecrement(&internal->m_ref_count);
 		}
 	}
 
@@ -76,72 +100,134 @@ namespace Lumix
 
 	PathInternal* PathManager::getPath(uint32 hash)
 	{
-		MT::SpinLock lock(m_mutex);
-		int index = m_paths.find(hash);
-		if (index < 0)
+		Shard& shard = getShard(hash);
+		MT::SpinLock lock(shard.m_mutex);
+		auto iter = shard.m_paths.find(hash);
+		if (iter == shard.m_paths.end())
 		{
 			return nullptr;
 		}
-		++m_paths.at(index)->m_ref_count;
-		return m_paths.at(index);
+		MT::atomicIncrement(&iter.value()->m_ref_count);
+		return iter.value();
 	}
 
 
 	PathInternal* PathManager::getPath(uint32 hash, const char* path)
 	{
-		MT::SpinLock lock(m_mutex);
-		return getPathMultithreadUnsafe(hash, path);
+		Shard& shard = getShard(hash);
+		MT::SpinLock lock(shard.m_mutex);
+		return getPathMultithreadUnsafe(shard, hash, path);
 	}
 
 
 	void PathManager::clear()
 	{
-		for (int i = m_paths.size() - 1; i >= 0; --i)
+		for (Shard* shard : m_shards)
 		{
-			if (m_paths.at(i)->m_ref_count == 0)
+			MT::SpinLock lock(shard->m_mutex);
+			clear(*shard);
+		}
+	}
+
+
+	void PathManager::clear(Shard& shard)
+	{
+		for (auto iter = shard.m_paths.begin(); iter != shard.m_paths.end();)
+		{
+			PathInternal* path = iter.value();
+			if (path->m_ref_count == 0)
 			{
-				LUMIX_DELETE(m_allocator, m_paths.at(i));
-				m_paths.eraseAt(i);
+				iter = shard.m_paths.erase(iter);
+				deallocate(shard, path);
+			}
+			else
+			{
+				++iter;
 			}
 		}
 	}
 
 
-	PathInternal* PathManager::getPathMultithreadUnsafe(uint32 hash, const char* path)
+	PathInternal* PathManager::getPathMultithreadUnsafe(Shard& shard,
+		uint32 hash,
+		const char* path)
 	{
-		int index = m_paths.find(hash);
-		if (index < 0)
+		auto iter = shard.m_paths.find(hash);
+		if (iter != shard.m_paths.end())
 		{
-			PathInternal* internal = LUMIX_NEW(m_allocator, PathInternal);
-			internal->m_ref_count = 1;
-			internal->m_id = hash;
-			copyString(internal->m_path, path);
-			m_paths.insert(hash, internal);
-			return internal;
+			MT::atomicIncrement(&iter.value()->m_ref_count);
+			return iter.value();
+		}
+
+		int length = stringLength(path);
+		PathInternal* internal = allocate(shard, length);
+		internal->m_ref_count = 1;
+		internal->m_id = hash;
+		internal->m_length = (uint16)length;
+		copyMemory(internal->m_path, path, length + 1);
+		shard.m_paths.insert(hash, internal);
+		return internal;
+	}
+
+
+	PathInternal* PathManager::allocate(Shard& shard, int length)
+	{
+		int size_class =
+			(sizeof(PathInternal) + length + SIZE_CLASS_GRANULARITY - 1) / SIZE_CLASS_GRANULARITY;
+		ASSERT(size_class < SIZE_CLASS_COUNT);
+		PathInternal* path = shard.m_free[size_class];
+		if (path)
+		{
+			// freed entries link to the next free one through their first bytes
+			shard.m_free[size_class] = *(PathInternal**)path;
 		}
 		else
 		{
-			++m_paths.at(index)->m_ref_count;
-			return m_paths.at(index);
+			int size = size_class * SIZE_CLASS_GRANULARITY;
+			if (shard.m_page_used + size > PAGE_SIZE)
+			{
+				shard.m_pages.push((uint8*)m_allocator.allocate(PAGE_SIZE));
+				shard.m_page_used = 0;
+			}
+			path = (PathInternal*)(shard.m_pages.back() + shard.m_page_used);
+			shard.m_page_used += size;
 		}
+		path->m_size_class = (uint16)size_class;
+		return path;
+	}
+
+
+	void PathManager::deallocate(Shard& shard, PathInternal* path)
+	{
+		int size_class = path->m_size_class;
+		*(PathInternal**)path = shard.m_free[size_class];
+		shard.m_free[size_class] = path;
 	}
 
 
 	void PathManager::incrementRefCount(PathInternal* path)
 	{
-		MT::SpinLock lock(m_mutex);
-		++path->m_ref_count;
+		MT::atomicIncrement(&path->m_ref_count);
 	}
 
 
 	void PathManager::decrementRefCount(PathInternal* path)
 	{
-		MT::SpinLock lock(m_mutex);
-		--path->m_ref_count;
-		if (path->m_ref_count == 0)
+		// only the last reference is released under the lock, so a lookup, which runs under the
+		// same lock, can not get a path which is being removed
+		for (;;)
 		{
-			m_paths.erase(path->m_id);
-			LUMIX_DELETE(m_allocator, path);
+			int32 count = path->m_ref_count;
+			if (count <= 1) break;
+			if (MT::compareAndExchange(&path->m_ref_count, count - 1, count)) return;
+		}
+
+		Shard& shard = getShard(path->m_id);
+		MT::SpinLock lock(shard.m_mutex);
+		if (MT::atomicDecrement(&path->m_ref_count) == 0)
+		{
+			shard.m_paths.erase(path->m_id);
+			deallocate(shard, path);
 		}
 	}
 
@@ -173,15 +259,15 @@ namespace Lumix
 
 	int Path::length() const
 	{
-		return stringLength(m_data->m_path);
+		return m_data->m_length;
 	}
 
 
 	void Path::operator =(const Path& rhs)
 	{
+		g_path_manager->incrementRefCount(rhs.m_data);
 		g_path_manager->decrementRefCount(m_data);
 		m_data = rhs.m_data;
-		g_path_manager->incrementRefCount(m_data);
 	}
 
 
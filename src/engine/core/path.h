@@ -1,6 +1,7 @@
 #pragma once
 
-#include "core/associative_array.h"
+#include "core/array.h"
+#include "core/flat_hash_map.h"
 #include "core/mt/sync.h"
 
 
@@ -13,12 +14,15 @@ class InputBlob;
 class OutputBlob;
 
 
+// allocated with only as many characters of m_path as the path needs
 class PathInternal
 {
 public:
-	char m_path[MAX_PATH_LENGTH];
 	uint32 m_id;
 	volatile int32 m_ref_count;
+	uint16 m_length;
+	uint16 m_size_class;
+	char m_path[1];
 };
 
 
@@ -35,17 +39,42 @@ public:
 
 	void clear();
 
+private:
+	// entries are spread over shards by hash, each with its own lock, so threads interning
+	// different paths rarely wait for each other
+	static const int SHARD_COUNT = 16;
+	static const int PAGE_SIZE = 16 * 1024;
+	static const int SIZE_CLASS_GRANULARITY = 16;
+	static const int SIZE_CLASS_COUNT =
+		(sizeof(PathInternal) + MAX_PATH_LENGTH) / SIZE_CLASS_GRANULARITY + 1;
+
+	// arena of entries, a freed entry is reused by the next one of the same size class
+	struct Shard
+	{
+		explicit Shard(IAllocator& allocator);
+
+		FlatHashMap<uint32, PathInternal*> m_paths;
+		Array<uint8*> m_pages;
+		PathInternal* m_free[SIZE_CLASS_COUNT];
+		int m_page_used;
+		MT::SpinMutex m_mutex;
+	};
+
 private:
 	PathInternal* getPath(uint32 hash, const char* path);
 	PathInternal* getPath(uint32 hash);
-	PathInternal* getPathMultithreadUnsafe(uint32 hash, const char* path);
+	PathInternal* getPathMultithreadUnsafe(Shard& shard, uint32 hash, const char* path);
+	// the top 4 bits pick one of the SHARD_COUNT shards, their maps hash the low ones
+	Shard& getShard(uint32 hash) const { return *m_shards[hash >> 28]; }
+	PathInternal* allocate(Shard& shard, int length);
+	void deallocate(Shard& shard, PathInternal* path);
+	void clear(Shard& shard);
 	void incrementRefCount(PathInternal* path);
 	void decrementRefCount(PathInternal* path);
 
 private:
 	IAllocator& m_allocator;
-	AssociativeArray<uint32, PathInternal*> m_paths;
-	MT::SpinMutex m_mutex;
+	Shard* m_shards[SHARD_COUNT];
 	PathInternal* m_empty_path;
 };
 
@@ -1,5 +1,6 @@
 #include "core/input_system.h"
 #include "core/associative_array.h"
+#include "core/blob.h"
 #include "core/profiler.h"
 #include "core/string.h"
 
@@ -20,8 +21,10 @@ namespace Lumix
 
 		explicit InputSystemImpl(IAllocator& allocator)
 			: m_actions(allocator)
+			, m_frame_values(allocator)
 			, m_allocator(allocator)
 			, m_is_enabled(false)
+			, m_is_recording_or_replaying(false)
 			, m_mouse_rel_x(0)
 			, m_mouse_rel_y(0)
 			, m_xinput_library(nullptr)
@@ -130,8 +133,63 @@ namespace Lumix
 		}
 
 
+		void recordFrame(OutputBlob& blob) override
+		{
+			m_is_recording_or_replaying = false;
+			m_frame_values.clear();
+			for (int i = 0; i < m_actions.size(); ++i)
+			{
+				float value = getActionValue(m_actions.getKey(i));
+				if (value != 0) m_frame_values.insert(m_actions.getKey(i), value);
+			}
+			m_is_recording_or_replaying = true;
+
+			blob.write(m_mouse_rel_x);
+			blob.write(m_mouse_rel_y);
+			blob.write(m_frame_values.size());
+			for (int i = 0; i < m_frame_values.size(); ++i)
+			{
+				blob.write(m_frame_values.getKey(i));
+				blob.write(m_frame_values.at(i));
+			}
+		}
+
+
+		bool replayFrame(InputBlob& blob) override
+		{
+			m_is_recording_or_replaying = true;
+			m_frame_values.clear();
+			int count = 0;
+			if (!blob.read(&m_mouse_rel_x, sizeof(m_mouse_rel_x))) return false;
+			if (!blob.read(&m_mouse_rel_y, sizeof(m_mouse_rel_y))) return false;
+			if (!blob.read(&count, sizeof(count))) return false;
+			for (int i = 0; i < count; ++i)
+			{
+				uint32 action;
+				float value;
+				if (!blob.read(&action, sizeof(action))) return false;
+				if (!blob.read(&value, sizeof(value))) return false;
+				m_frame_values.insert(action, value);
+			}
+			return true;
+		}
+
+
+		void stopRecordReplay() override
+		{
+			m_is_recording_or_replaying = false;
+			m_frame_values.clear();
+		}
+
+
 		float getActionValue(uint32 action) override
 		{
+			// the recorded values already went through the enabled check
+			if (m_is_recording_or_replaying)
+			{
+				float value;
+				return m_frame_values.find(action, value) ? value : 0;
+			}
 			if (!m_is_enabled) return 0;
 			InputSystemImpl::Action value;
 			if (m_actions.find(action, value))
@@ -197,9 +255,12 @@ namespace Lumix
 
 		IAllocator& m_allocator;
 		AssociativeArray<uint32, Action> m_actions;
+		// actions which are not in it are 0 while recording or replaying
+		AssociativeArray<uint32, float> m_frame_values;
 		float m_mouse_rel_x;
 		float m_mouse_rel_y;
 		bool m_is_enabled;
+		bool m_is_recording_or_replaying;
 		HMODULE m_xinput_library;
 		XInputGetState_fn_ptr m_xinput_get_state;
 		XINPUT_STATE m_xinput_states[XUSER_MAX_COUNT];
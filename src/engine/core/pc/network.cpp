@@ -15,6 +15,94 @@ namespace Net
 {
 
 
+static bool initWinsock()
+{
+	WSADATA wsa_data;
+	return WSAStartup(MAKEWORD(2, 2), &wsa_data) == 0;
+}
+
+
+Address makeAddress(const char* ip, uint16 port)
+{
+	Address address;
+	address.ip = ip ? ntohl(::inet_addr(ip)) : INADDR_ANY;
+	address.port = port;
+	return address;
+}
+
+
+UDPSocket::UDPSocket()
+	: m_socket(INVALID_SOCKET)
+{
+}
+
+
+UDPSocket::~UDPSocket()
+{
+	close();
+}
+
+
+bool UDPSocket::open(uint16 port)
+{
+	close();
+	if (!initWinsock()) return false;
+
+	SOCKET socket = ::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (socket == INVALID_SOCKET) return false;
+
+	SOCKADDR_IN sin;
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(port);
+	sin.sin_addr.s_addr = INADDR_ANY;
+	u_long non_blocking = 1;
+	if (::bind(socket, (LPSOCKADDR)&sin, sizeof(sin)) == SOCKET_ERROR ||
+		::ioctlsocket(socket, FIONBIO, &non_blocking) != 0)
+	{
+		::closesocket(socket);
+		return false;
+	}
+	m_socket = socket;
+	return true;
+}
+
+
+void UDPSocket::close()
+{
+	if (m_socket == INVALID_SOCKET) return;
+	::closesocket(m_socket);
+	m_socket = INVALID_SOCKET;
+}
+
+
+bool UDPSocket::send(const Address& address, const void* data, int size)
+{
+	SOCKADDR_IN sin;
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(address.port);
+	sin.sin_addr.s_addr = htonl(address.ip);
+	int sent = ::sendto(m_socket, (const char*)data, size, 0, (LPSOCKADDR)&sin, sizeof(sin));
+	return sent == size;
+}
+
+
+int UDPSocket::receive(Address* address, void* data, int max_size)
+{
+	SOCKADDR_IN sin;
+	int sin_size = sizeof(sin);
+	int received = ::recvfrom(m_socket, (char*)data, max_size, 0, (LPSOCKADDR)&sin, &sin_size);
+	if (received < 0) return -1;
+	if (address)
+	{
+		address->ip = ntohl(sin.sin_addr.s_addr);
+		address->port = ntohs(sin.sin_port);
+	}
+	return received;
+}
+
+
 TCPAcceptor::TCPAcceptor(IAllocator& allocator)
 	: m_allocator(allocator)
 {
@@ -61,6 +149,7 @@ void TCPAcceptor::close(TCPStream* stream)
 TCPStream* TCPAcceptor::accept()
 {
 	SOCKET socket = ::accept(m_socket, nullptr, nullptr);
+	if (socket == INVALID_SOCKET) return nullptr;
 	return LUMIX_NEW(m_allocator, TCPStream)(socket);
 }
 
@@ -112,6 +201,14 @@ TCPStream::~TCPStream()
 }
 
 
+void TCPStream::shutdown()
+{
+	// SD_BOTH, it is not defined by winsock.h included from windows.h
+	static const int SHUTDOWN_BOTH = 2;
+	::shutdown(m_socket, SHUTDOWN_BOTH);
+}
+
+
 bool TCPStream::readString(char* string, uint32 max_size)
 {
 	uint32 len = 0;
@@ -13,6 +13,36 @@ namespace Lumix
 	}
 
 
+	bool deleteFile(const char* path)
+	{
+		return DeleteFile(path) == TRUE;
+	}
+
+
+	bool makePath(const char* path)
+	{
+		char tmp[MAX_PATH];
+		if (!copyString(tmp, path)) return false;
+		for (char* c = tmp; *c; ++c)
+		{
+			if ((*c != '/' && *c != '\\') || c == tmp || c[-1] == ':') continue;
+			char separator = *c;
+			*c = '\0';
+			if (!CreateDirectory(tmp, NULL) && GetLastError() != ERROR_ALREADY_EXISTS) return false;
+			*c = separator;
+		}
+		return true;
+	}
+
+
+	bool getCacheDirectory(char* output, int max_size)
+	{
+		char path[MAX_PATH];
+		if (FAILED(SHGetFolderPath(NULL, CSIDL_LOCAL_APPDATA, NULL, 0, path))) return false;
+		return copyString(output, max_size, path) && catString(output, max_size, "\\Lumix\\");
+	}
+
+
 	void messageBox(const char* text)
 	{
 		MessageBox(NULL, text, "Message", MB_OK);
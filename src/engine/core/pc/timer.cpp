@@ -28,6 +28,18 @@ class TimerImpl : public Timer
 			return delta;
 		}
 
+		uint64 getRawTimeSinceStart() override
+		{
+			LARGE_INTEGER tick;
+			QueryPerformanceCounter(&tick);
+			return tick.QuadPart - m_first_tick.QuadPart;
+		}
+
+		uint64 getFrequency() override
+		{
+			return m_frequency.QuadPart;
+		}
+
 		float getTimeSinceTick() override
 		{
 			LARGE_INTEGER tick;
@@ -1,6 +1,11 @@
 #include "profiler.h"
 #include "core/pod_hash_map.h"
+#include "core/blob.h"
+#include "core/fs/os_file.h"
 #include "core/log.h"
+#include "core/math_utils.h"
+#include "core/mt/atomic.h"
+#include "core/network.h"
 #include "core/timer.h"
 #include "core/mt/sync.h"
 #include "core/mt/thread.h"
@@ -84,6 +89,12 @@ int getBlockInt(Block* block)
 }
 
 
+float getBlockFloat(Block* block)
+{
+	return block->m_values.float_value;
+}
+
+
 BlockType getBlockType(Block* block)
 {
 	return block->m_type;
@@ -119,29 +130,94 @@ float getBlockLength(Block* block)
 }
 
 
+enum class EventType : uint8
+{
+	BEGIN,
+	END,
+	INT,
+	FLOAT
+};
+
+
+struct Event
+{
+	const char* name;
+	uint64 time;
+	union
+	{
+		float float_value;
+		int int_value;
+	};
+	EventType type;
+};
+
+
+struct TraceEvent
+{
+	Event event;
+	uint32 thread_id;
+};
+
+
+// events are written only by the owning thread, without any lock, and the block tree is built
+// from them in frame()
 struct ThreadData
 {
-	ThreadData() 
+	enum
+	{
+		EVENTS_COUNT = 1 << 14
+	};
+
+	ThreadData()
 	{
 		root_block = current_block = nullptr;
 		name[0] = '\0';
+		write_pos = read_pos = 0;
+		dropped_depth = 0;
+		thread_id = 0;
 	}
 
 	Block* root_block;
 	Block* current_block;
 	char name[30];
+
+	Event events[EVENTS_COUNT];
+	volatile int32 write_pos;
+	volatile int32 read_pos;
+	// blocks begun while the buffer was full, their ends are dropped too
+	int dropped_depth;
+	uint32 thread_id;
 };
 
 
 struct Instance
 {
+	enum
+	{
+		TRACE_EVENTS_COUNT = 1 << 17,
+		MAX_CAPTURED_FRAMES = 64
+	};
+
 	Instance()
 		: threads(allocator)
 		, frame_listeners(allocator)
+		, hitch_listeners(allocator)
+		, trace(allocator)
 		, m_mutex(false)
 	{
-		threads.insert(MT::getCurrentThreadID(), &main_thread);
+		main_thread.thread_id = MT::getCurrentThreadID();
+		threads.insert(main_thread.thread_id, &main_thread);
 		timer = Timer::create(allocator);
+		frequency = (double)timer->getFrequency();
+		trace.resize(TRACE_EVENTS_COUNT);
+		trace_pos = 0;
+		trace_stream = nullptr;
+		trace_stream_pos = 0;
+		frame_index = 0;
+		last_frame_time = 0;
+		hitch_threshold = 0;
+		hitch_frames = 0;
+		hitch_directory[0] = '\0';
 	}
 
 
@@ -157,112 +233,431 @@ struct Instance
 
 	DefaultAllocator allocator;
 	DelegateList<void()> frame_listeners;
+	DelegateList<void(HitchInfo&)> hitch_listeners;
 	PODHashMap<uint32, ThreadData*> threads;
 	ThreadData main_thread;
 	Timer* timer;
+	double frequency;
+	// rolling window of the last TRACE_EVENTS_COUNT events of all threads
+	Array<TraceEvent> trace;
+	int64 trace_pos;
+	Net::TCPStream* trace_stream;
+	int64 trace_stream_pos;
+	// trace_pos at the end of the last frames
+	int64 frame_trace_pos[MAX_CAPTURED_FRAMES];
+	int64 frame_index;
+	uint64 last_frame_time;
+	float hitch_threshold;
+	int hitch_frames;
+	char hitch_directory[MAX_PATH_LENGTH];
 	MT::SpinMutex m_mutex;
 };
 
 
 Instance g_instance;
+static LUMIX_THREAD_LOCAL ThreadData* s_thread_data = nullptr;
 
-struct BlockInfo
-{
-	Block* block;
-	ThreadData* thread_data;
-};
 
-static BlockInfo getBlock(const char* name)
+static ThreadData& getThreadData()
 {
+	if (s_thread_data) return *s_thread_data;
+
 	auto thread_id = MT::getCurrentThreadID();
+	MT::SpinLock lock(g_instance.m_mutex);
+	auto iter = g_instance.threads.find(thread_id);
+	if (iter == g_instance.threads.end())
+	{
+		auto* thread_data = LUMIX_NEW(g_instance.allocator, ThreadData);
+		thread_data->thread_id = thread_id;
+		g_instance.threads.insert(thread_id, thread_data);
+		iter = g_instance.threads.find(thread_id);
+	}
+	s_thread_data = iter.value();
+	return *s_thread_data;
+}
 
-	ThreadData* thread_data = nullptr;
+
+static Event* beginEvent(ThreadData& thread_data, EventType type)
+{
+	if (type == EventType::END && thread_data.dropped_depth > 0)
 	{
-		MT::SpinLock lock(g_instance.m_mutex);
-		auto iter = g_instance.threads.find(thread_id);
-		if (iter == g_instance.threads.end())
-		{
-			g_instance.threads.insert(thread_id, LUMIX_NEW(g_instance.allocator, ThreadData));
-			iter = g_instance.threads.find(thread_id);
-		}
+		--thread_data.dropped_depth;
+		return nullptr;
+	}
+	if (thread_data.write_pos - thread_data.read_pos >= ThreadData::EVENTS_COUNT)
+	{
+		if (type == EventType::BEGIN) ++thread_data.dropped_depth;
+		return nullptr;
+	}
+	Event* event = &thread_data.events[thread_data.write_pos & (ThreadData::EVENTS_COUNT - 1)];
+	event->type = type;
+	event->time = g_instance.timer->getRawTimeSinceStart();
+	return event;
+}
+
+
+static void endEvent(ThreadData& thread_data)
+{
+	MT::memoryBarrier();
+	++thread_data.write_pos;
+}
+
+
+void record(const char* name, float value)
+{
+	ThreadData& thread_data = getThreadData();
+	Event* event = beginEvent(thread_data, EventType::FLOAT);
+	if (!event) return;
+	event->name = name;
+	event->float_value = value;
+	endEvent(thread_data);
+}
+
 
-		thread_data = iter.value();
+void record(const char* name, int value)
+{
+	ThreadData& thread_data = getThreadData();
+	Event* event = beginEvent(thread_data, EventType::INT);
+	if (!event) return;
+	event->name = name;
+	event->int_value = value;
+	endEvent(thread_data);
+}
+
+
+void beginBlock(const char* name)
+{
+	ThreadData& thread_data = getThreadData();
+	Event* event = beginEvent(thread_data, EventType::BEGIN);
+	if (!event) return;
+	event->name = name;
+	endEvent(thread_data);
+}
+
+
+void endBlock()
+{
+	ThreadData& thread_data = getThreadData();
+	Event* event = beginEvent(thread_data, EventType::END);
+	if (!event) return;
+	event->name = nullptr;
+	endEvent(thread_data);
+}
+
+
+static Block* getChildBlock(ThreadData& thread_data, const char* name)
+{
+	Block* parent = thread_data.current_block;
+	Block* LUMIX_RESTRICT block = parent ? parent->m_first_child : thread_data.root_block;
+	while (block && block->m_name != name)
+	{
+		block = block->m_next;
 	}
+	if (block) return block;
 
-	if (!thread_data->current_block)
+	block = LUMIX_NEW(g_instance.allocator, Block)(g_instance.allocator);
+	block->m_parent = parent;
+	block->m_first_child = nullptr;
+	block->m_name = name;
+	if (parent)
 	{
-		Block* LUMIX_RESTRICT root = thread_data->root_block;
-		while (root && root->m_name != name)
-		{
-			root = root->m_next;
-		}
-		if (root)
+		block->m_next = parent->m_first_child;
+		parent->m_first_child = block;
+	}
+	else
+	{
+		block->m_next = thread_data.root_block;
+		thread_data.root_block = block;
+	}
+	return block;
+}
+
+
+static float toSeconds(uint64 time)
+{
+	return float(time / g_instance.frequency);
+}
+
+
+static void processEvent(ThreadData& thread_data, const Event& event)
+{
+	TraceEvent& trace_event =
+		g_instance.trace[int(g_instance.trace_pos & (Instance::TRACE_EVENTS_COUNT - 1))];
+	trace_event.event = event;
+	trace_event.thread_id = thread_data.thread_id;
+	++g_instance.trace_pos;
+
+	switch (event.type)
+	{
+		case EventType::BEGIN:
 		{
-			thread_data->current_block = root;
+			Block* block = getChildBlock(thread_data, event.name);
+			auto& hit = block->m_hits.emplace();
+			hit.m_start = toSeconds(event.time);
+			hit.m_length = 0;
+			thread_data.current_block = block;
+			break;
 		}
-		else
+		case EventType::END:
 		{
-			Block* root = LUMIX_NEW(g_instance.allocator, Block)(g_instance.allocator);
-			root->m_parent = nullptr;
-			root->m_next = thread_data->root_block;
-			root->m_first_child = nullptr;
-			root->m_name = name;
-			thread_data->root_block = thread_data->current_block = root;
+			Block* block = thread_data.current_block;
+			ASSERT(block);
+			if (!block) break;
+			if (!block->m_hits.empty())
+			{
+				auto& hit = block->m_hits.back();
+				hit.m_length = 1000.0f * (toSeconds(event.time) - hit.m_start);
+			}
+			thread_data.current_block = block->m_parent;
+			break;
 		}
-	}
-	else
-	{
-		Block* LUMIX_RESTRICT child = thread_data->current_block->m_first_child;
-		while (child && child->m_name != name)
+		case EventType::INT:
 		{
-			child = child->m_next;
+			Block* block = getChildBlock(thread_data, event.name);
+			if (block->m_type != BlockType::INT)
+			{
+				block->m_values.int_value = 0;
+				block->m_type = BlockType::INT;
+			}
+			block->m_values.int_value += event.int_value;
+			break;
 		}
-		if (!child)
+		case EventType::FLOAT:
 		{
-			child = LUMIX_NEW(g_instance.allocator, Block)(g_instance.allocator);
-			child->m_parent = thread_data->current_block;
-			child->m_first_child = nullptr;
-			child->m_name = name;
-			child->m_next = thread_data->current_block->m_first_child;
-			thread_data->current_block->m_first_child = child;
+			Block* block = getChildBlock(thread_data, event.name);
+			block->m_type = BlockType::FLOAT;
+			block->m_values.float_value = event.float_value;
+			break;
 		}
+	}
+}
 
-		thread_data->current_block = child;
+
+static void processEvents(ThreadData& thread_data)
+{
+	int32 write_pos = thread_data.write_pos;
+	MT::memoryBarrier();
+	for (int32 i = thread_data.read_pos; i != write_pos; ++i)
+	{
+		processEvent(thread_data, thread_data.events[i & (ThreadData::EVENTS_COUNT - 1)]);
 	}
+	MT::memoryBarrier();
+	thread_data.read_pos = write_pos;
+}
+
 
-	return { thread_data->current_block, thread_data };
+static void writeTimestamp(OutputBlob& blob, uint64 time)
+{
+	// microseconds with a fractional part, float seconds are not precise enough after a while
+	uint64 ns = uint64(time * (1000000000.0 / g_instance.frequency));
+	char tmp[30];
+	toCString(ns / 1000, tmp, lengthOf(tmp));
+	blob << tmp << ".";
+	uint32 fraction = uint32(ns % 1000);
+	if (fraction < 100) blob << "0";
+	if (fraction < 10) blob << "0";
+	blob << fraction;
 }
 
 
-void record(const char* name, float value)
+static void writeJSONString(OutputBlob& blob, const char* str)
 {
-	auto data = getBlock(name);
-	data.block->m_type = BlockType::FLOAT;
-	data.block->m_values.float_value = value;
-	data.thread_data->current_block = data.block->m_parent;
+	blob << "\"";
+	for (const char* c = str; *c; ++c)
+	{
+		if (*c == '"' || *c == '\\') blob.write("\\", 1);
+		blob.write(c, 1);
+	}
+	blob << "\"";
 }
 
 
-void record(const char* name, int value)
+// one object of the Chrome Trace Event format, followed by a comma
+static void writeTraceEvent(OutputBlob& blob, const TraceEvent& trace_event)
 {
-	auto data = getBlock(name);
-	if (data.block->m_type != BlockType::INT)
+	const Event& event = trace_event.event;
+	blob << "{";
+	if (event.type != EventType::END)
 	{
-		data.block->m_values.int_value = 0;
-		data.block->m_type = BlockType::INT;
+		blob << "\"name\":";
+		writeJSONString(blob, event.name);
+		blob << ",";
 	}
-	data.block->m_values.int_value += value;
-	data.thread_data->current_block = data.block->m_parent;
+	switch (event.type)
+	{
+		case EventType::BEGIN: blob << "\"ph\":\"B\""; break;
+		case EventType::END: blob << "\"ph\":\"E\""; break;
+		case EventType::INT:
+		case EventType::FLOAT: blob << "\"ph\":\"C\""; break;
+	}
+	blob << ",\"ts\":";
+	writeTimestamp(blob, event.time);
+	blob << ",\"pid\":0,\"tid\":" << trace_event.thread_id;
+	if (event.type == EventType::INT) blob << ",\"args\":{\"value\":" << event.int_value << "}";
+	if (event.type == EventType::FLOAT)
+	{
+		blob << ",\"args\":{\"value\":" << event.float_value << "}";
+	}
+	blob << "},\n";
 }
 
 
-void beginBlock(const char* name)
+static void writeMetadata(OutputBlob& blob)
+{
+	blob << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"Lumix\"}}";
+	for (auto* i : g_instance.threads)
+	{
+		if (!i->name[0]) continue;
+		blob << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << i->thread_id;
+		blob << ",\"args\":{\"name\":";
+		writeJSONString(blob, i->name);
+		blob << "}}";
+	}
+}
+
+
+static void writeTraceEvents(OutputBlob& blob, int64 from)
+{
+	from = Math::maxValue(from, g_instance.trace_pos - Instance::TRACE_EVENTS_COUNT);
+	for (int64 i = from; i < g_instance.trace_pos; ++i)
+	{
+		writeTraceEvent(blob, g_instance.trace[int(i & (Instance::TRACE_EVENTS_COUNT - 1))]);
+	}
+}
+
+
+static bool saveBlob(const char* path, const OutputBlob& blob)
 {
-	auto data = getBlock(name);
+	FS::OsFile file;
+	if (!file.open(path, FS::Mode::CREATE | FS::Mode::WRITE, g_instance.allocator))
+	{
+		g_log_error.log("Engine") << "Failed to save profiler trace to " << path;
+		return false;
+	}
+	bool success = file.write(blob.getData(), blob.getSize());
+	file.close();
+	return success;
+}
+
 
-	auto& hit = data.block->m_hits.emplace();
-	hit.m_start = g_instance.timer->getTimeSinceStart();
-	hit.m_length = 0;
+bool saveTrace(const char* path)
+{
+	OutputBlob blob(g_instance.allocator);
+	{
+		MT::SpinLock lock(g_instance.m_mutex);
+		blob << "[\n";
+		writeTraceEvents(blob, 0);
+		writeMetadata(blob);
+		blob << "\n]\n";
+	}
+	return saveBlob(path, blob);
+}
+
+
+struct HitchInfoImpl : HitchInfo
+{
+	explicit HitchInfoImpl(OutputBlob& blob)
+		: blob(blob)
+	{
+	}
+
+
+	void add(const char* key, const char* value) override
+	{
+		blob << ",\n";
+		writeJSONString(blob, key);
+		blob << ":";
+		writeJSONString(blob, value);
+	}
+
+
+	OutputBlob& blob;
+};
+
+
+// the trace of the last frames in the object format, the hitch info goes to its otherData
+static void saveHitch(float frame_time)
+{
+	OutputBlob info(g_instance.allocator);
+	info << "\"frame time [ms]\":\"" << frame_time << "\"";
+	HitchInfoImpl hitch_info(info);
+	g_instance.hitch_listeners.invoke(hitch_info);
+
+	OutputBlob blob(g_instance.allocator);
+	int64 frame_index;
+	{
+		MT::SpinLock lock(g_instance.m_mutex);
+		frame_index = g_instance.frame_index;
+		int frames = Math::clamp(g_instance.hitch_frames, 1, Instance::MAX_CAPTURED_FRAMES - 1);
+		int64 from_frame = frame_index - frames;
+		int64 from = from_frame > 0
+			? g_instance.frame_trace_pos[from_frame % Instance::MAX_CAPTURED_FRAMES]
+			: 0;
+		blob << "{\"traceEvents\":[\n";
+		writeTraceEvents(blob, from);
+		writeMetadata(blob);
+		blob << "\n],\n\"otherData\":{";
+	}
+	blob.write(info.getData(), info.getSize());
+	blob << "}}\n";
+
+	char path[MAX_PATH_LENGTH];
+	char tmp[30];
+	toCString(frame_index, tmp, lengthOf(tmp));
+	copyString(path, g_instance.hitch_directory);
+	if (path[0]) catString(path, "/");
+	catString(path, "hitch_");
+	catString(path, tmp);
+	catString(path, ".json");
+	if (saveBlob(path, blob))
+	{
+		g_log_info.log("Engine") << "Frame took " << frame_time << " ms, profiler trace saved to "
+								 << path;
+	}
+}
+
+
+void setHitchCapture(float threshold, int frames, const char* directory)
+{
+	MT::SpinLock lock(g_instance.m_mutex);
+	g_instance.hitch_threshold = threshold;
+	g_instance.hitch_frames = frames;
+	copyString(g_instance.hitch_directory, directory ? directory : "");
+}
+
+
+DelegateList<void(HitchInfo&)>& getHitchListeners()
+{
+	return g_instance.hitch_listeners;
+}
+
+
+// the closing bracket is optional in the Chrome trace format, so events are just appended to
+// the array until the stream is closed
+void setTraceStream(Net::TCPStream* stream)
+{
+	MT::SpinLock lock(g_instance.m_mutex);
+	g_instance.trace_stream = stream;
+	g_instance.trace_stream_pos = g_instance.trace_pos;
+	if (!stream) return;
+
+	OutputBlob blob(g_instance.allocator);
+	blob << "[\n";
+	writeMetadata(blob);
+	blob << ",\n";
+	stream->write(blob.getData(), blob.getSize());
+}
+
+
+static void streamTraceEvents()
+{
+	if (!g_instance.trace_stream) return;
+	if (g_instance.trace_stream_pos == g_instance.trace_pos) return;
+
+	OutputBlob blob(g_instance.allocator);
+	writeTraceEvents(blob, g_instance.trace_stream_pos);
+	g_instance.trace_stream_pos = g_instance.trace_pos;
+	g_instance.trace_stream->write(blob.getData(), blob.getSize());
 }
 
 
@@ -276,15 +671,7 @@ const char* getThreadName(uint32 thread_id)
 
 void setThreadName(const char* name)
 {
-	MT::SpinLock lock(g_instance.m_mutex);
-	uint32 thread_id = MT::getCurrentThreadID();
-	auto iter = g_instance.threads.find(thread_id);
-	if (iter == g_instance.threads.end())
-	{
-		g_instance.threads.insert(thread_id, LUMIX_NEW(g_instance.allocator, ThreadData));
-		iter = g_instance.threads.find(thread_id);
-	}
-	Lumix::copyString(iter.value()->name, name);
+	Lumix::copyString(getThreadData().name, name);
 }
 
 
@@ -331,47 +718,46 @@ Block* getRootBlock(uint32 thread_id)
 }
 
 
-void endBlock()
-{
-	auto thread_id = MT::getCurrentThreadID();
-
-	ThreadData* thread_data = nullptr;
-	{
-		MT::SpinLock lock(g_instance.m_mutex);
-		auto iter = g_instance.threads.find(thread_id);
-		ASSERT(iter.isValid());
-		thread_data = iter.value();
-	}
-
-	ASSERT(thread_data->current_block);
-	float now = g_instance.timer->getTimeSinceStart();
-	thread_data->current_block->m_hits.back().m_length =
-		1000.0f * (now - thread_data->current_block->m_hits.back().m_start);
-	thread_data->current_block = thread_data->current_block->m_parent;
-}
-
-
 void frame()
 {
 	PROFILE_FUNCTION();
 
-	MT::SpinLock lock(g_instance.m_mutex);
-	g_instance.frame_listeners.invoke();
-	float now = g_instance.timer->getTimeSinceStart();
+	uint64 frame_time = g_instance.timer->getRawTimeSinceStart();
+	uint64 frame_ticks = frame_time - g_instance.last_frame_time;
+	float frame_length = float(frame_ticks * 1000 / g_instance.frequency);
+	bool is_hitch = g_instance.hitch_threshold > 0 && g_instance.frame_index > 0 &&
+					frame_length > g_instance.hitch_threshold;
+	g_instance.last_frame_time = frame_time;
 
-	for (auto* i : g_instance.threads)
 	{
-		if (!i->root_block) continue;
-		i->root_block->frame();
-		auto* block = i->current_block;
-		while (block)
+		MT::SpinLock lock(g_instance.m_mutex);
+		for (auto* i : g_instance.threads)
 		{
-			auto& hit = block->m_hits.emplace();
-			hit.m_start = now;
-			hit.m_length = 0;
-			block = block->m_parent;
+			processEvents(*i);
+		}
+		streamTraceEvents();
+		++g_instance.frame_index;
+		g_instance.frame_trace_pos[g_instance.frame_index % Instance::MAX_CAPTURED_FRAMES] =
+			g_instance.trace_pos;
+		g_instance.frame_listeners.invoke();
+		float now = g_instance.timer->getTimeSinceStart();
+
+		for (auto* i : g_instance.threads)
+		{
+			if (!i->root_block) continue;
+			i->root_block->frame();
+			auto* block = i->current_block;
+			while (block)
+			{
+				auto& hit = block->m_hits.emplace();
+				hit.m_start = now;
+				hit.m_length = 0;
+				block = block->m_parent;
+			}
 		}
 	}
+
+	if (is_hitch) saveHitch(frame_length);
 }
 
 
@@ -11,6 +11,12 @@ namespace Lumix
 {
 
 
+namespace Net
+{
+class TCPStream;
+}
+
+
 namespace Profiler
 {
 
@@ -32,6 +38,7 @@ LUMIX_ENGINE_API int getThreadCount();
 
 LUMIX_ENGINE_API Block* getRootBlock(uint32 thread_id);
 LUMIX_ENGINE_API int getBlockInt(Block* block);
+LUMIX_ENGINE_API float getBlockFloat(Block* block);
 LUMIX_ENGINE_API BlockType getBlockType(Block* block);
 LUMIX_ENGINE_API Block* getBlockFirstChild(Block* block);
 LUMIX_ENGINE_API Block* getBlockNext(Block* block);
@@ -45,6 +52,24 @@ LUMIX_ENGINE_API void beginBlock(const char* name);
 LUMIX_ENGINE_API void endBlock();
 LUMIX_ENGINE_API void frame();
 LUMIX_ENGINE_API DelegateList<void ()>& getFrameListeners();
+// the last events of all threads in the Chrome Trace Event format (chrome://tracing)
+LUMIX_ENGINE_API bool saveTrace(const char* path);
+// new events are written to the stream every frame, nullptr stops streaming
+LUMIX_ENGINE_API void setTraceStream(Net::TCPStream* stream);
+
+
+// filled by the hitch listeners, the values are saved with the captured trace
+struct LUMIX_ENGINE_API HitchInfo
+{
+	virtual ~HitchInfo() {}
+	virtual void add(const char* key, const char* value) = 0;
+};
+
+
+// when the time between two frame() calls exceeds threshold [ms], the trace of the last frames
+// is saved to directory/hitch_<frame>.json; threshold <= 0 disables it
+LUMIX_ENGINE_API void setHitchCapture(float threshold, int frames, const char* directory);
+LUMIX_ENGINE_API DelegateList<void(HitchInfo&)>& getHitchListeners();
 
 
 struct Scope
@@ -3,6 +3,7 @@
 #include "core/vec.h"
 #include "core/math_utils.h"
 #include "core/matrix.h"
+#include <xmmintrin.h>
 
 
 namespace Lumix
@@ -128,14 +129,22 @@ void nlerp(const Quat& q1, const Quat& q2, Quat* out, float t)
 
 Quat Quat::operator *(const Quat& rhs) const
 {
-	Quat tmp;
-
-	tmp.w = (rhs.w * w) - (rhs.x * x) - (rhs.y * y) - (rhs.z * z);
-	tmp.x = (rhs.w * x) + (rhs.x * w) + (rhs.y * z) - (rhs.z * y);
-	tmp.y = (rhs.w * y) + (rhs.y * w) + (rhs.z * x) - (rhs.x * z);
-	tmp.z = (rhs.w * z) + (rhs.z * w) + (rhs.x * y) - (rhs.y * x);
-
-	return tmp;
+	// lanes are x, y, z, w, each component of rhs scales a swizzled and signed copy of this
+	__m128 q = _mm_loadu_ps(&x);
+	__m128 tmp = _mm_mul_ps(_mm_set1_ps(rhs.w), q);
+	__m128 wzyx = _mm_shuffle_ps(q, q, _MM_SHUFFLE(0, 1, 2, 3));
+	__m128 zwxy = _mm_shuffle_ps(q, q, _MM_SHUFFLE(1, 0, 3, 2));
+	__m128 yxwz = _mm_shuffle_ps(q, q, _MM_SHUFFLE(2, 3, 0, 1));
+	wzyx = _mm_mul_ps(wzyx, _mm_setr_ps(1, -1, 1, -1));
+	zwxy = _mm_mul_ps(zwxy, _mm_setr_ps(1, 1, -1, -1));
+	yxwz = _mm_mul_ps(yxwz, _mm_setr_ps(-1, 1, 1, -1));
+	tmp = _mm_add_ps(tmp, _mm_mul_ps(_mm_set1_ps(rhs.x), wzyx));
+	tmp = _mm_add_ps(tmp, _mm_mul_ps(_mm_set1_ps(rhs.y), zwxy));
+	tmp = _mm_add_ps(tmp, _mm_mul_ps(_mm_set1_ps(rhs.z), yxwz));
+
+	Quat result;
+	_mm_storeu_ps(&result.x, tmp);
+	return result;
 }
 
 
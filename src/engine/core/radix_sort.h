@@ -0,0 +1,67 @@
+#pragma once
+
+
+#include "lumix.h"
+
+
+namespace Lumix
+{
+
+
+// Stable LSD radix sort of data by 64bit keys returned by get_key(const T&), 8 bits per pass.
+// tmp must have space for count items. Passes where all keys share the same byte are skipped,
+// so keys using only a few bits are cheap to sort. T is copied by assignment.
+template <typename T, typename KeyFn>
+void radixSort(T* LUMIX_RESTRICT data, T* LUMIX_RESTRICT tmp, int count, KeyFn get_key)
+{
+	static const int PASS_COUNT = sizeof(uint64);
+	if (count < 2) return;
+
+	int histograms[PASS_COUNT][256] = {};
+	for (int i = 0; i < count; ++i)
+	{
+		uint64 key = get_key(data[i]);
+		for (int pass = 0; pass < PASS_COUNT; ++pass)
+		{
+			++histograms[pass][(key >> (pass * 8)) & 0xff];
+		}
+	}
+
+	T* src = data;
+	T* dst = tmp;
+	for (int pass = 0; pass < PASS_COUNT; ++pass)
+	{
+		int* histogram = histograms[pass];
+		uint64 first_byte = (get_key(src[0]) >> (pass * 8)) & 0xff;
+		if (histogram[first_byte] == count) continue;
+
+		int offset = 0;
+		for (int i = 0; i < 256; ++i)
+		{
+			int bucket_size = histogram[i];
+			histogram[i] = offset;
+			offset += bucket_size;
+		}
+
+		for (int i = 0; i < count; ++i)
+		{
+			int byte = int((get_key(src[i]) >> (pass * 8)) & 0xff);
+			dst[histogram[byte]++] = src[i];
+		}
+
+		T* swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	if (src != data)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			data[i] = src[i];
+		}
+	}
+}
+
+
+} // namespace Lumix
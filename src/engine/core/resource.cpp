@@ -1,6 +1,8 @@
 #include "lumix.h"
 #include "core/resource.h"
+#include "core/frame_stats.h"
 #include "core/fs/file_system.h"
+#include "core/fs/ifile.h"
 #include "core/log.h"
 #include "core/path.h"
 #include "core/resource_manager.h"
@@ -12,13 +14,18 @@ Resource::Resource(const Path& path, ResourceManager& resource_manager, IAllocat
 	: m_ref_count()
 	, m_empty_dep_count(1)
 	, m_failed_dep_count(0)
+	, m_priority(DEFAULT_PRIORITY)
 	, m_current_state(State::EMPTY)
 	, m_desired_state(State::EMPTY)
 	, m_path(path)
 	, m_size()
 	, m_cb(allocator)
 	, m_resource_manager(resource_manager)
+	, m_parse_file(nullptr)
+	, m_prefetched(allocator)
 	, m_is_waiting_for_load(false)
+	, m_is_parsing(false)
+	, m_is_parse_successful(false)
 {
 }
 
@@ -35,6 +42,7 @@ void Resource::checkState()
 	{
 		m_current_state = State::FAILURE;
 		m_cb.invoke(old_state, m_current_state);
+		releasePrefetched();
 	}
 
 	if (m_failed_dep_count == 0)
@@ -43,8 +51,11 @@ void Resource::checkState()
 			m_desired_state != State::EMPTY)
 		{
 			onBeforeReady();
+			FrameStats::add(FrameStats::Counter::RESOURCES_LOADED, 1);
+			m_resource_manager.onLoaded(*this);
 			m_current_state = State::READY;
 			m_cb.invoke(old_state, m_current_state);
+			releasePrefetched();
 		}
 
 		if (m_empty_dep_count > 0 && m_current_state != State::EMPTY)
@@ -74,6 +85,24 @@ void Resource::fileLoaded(FS::IFile& file, bool success)
 		return;
 	}
 
+	FrameStats::add(FrameStats::Counter::BYTES_STREAMED, (int32)file.size());
+
+	if (isParsedAsync() && file.getBuffer())
+	{
+		// the file is closed after this callback, so workers parse a copy
+		FS::FileSystem& fs = m_resource_manager.getFileSystem();
+		m_parse_file = fs.open(fs.getMemoryDevice(), m_path, FS::Mode::WRITE);
+		if (m_parse_file)
+		{
+			m_parse_file->write(file.getBuffer(), file.size());
+			m_parse_file->seek(FS::SeekMode::BEGIN, 0);
+			m_is_waiting_for_load = true;
+			m_is_parsing = true;
+			m_resource_manager.parseAsync(*this);
+			return;
+		}
+	}
+
 	if (!load(file))
 	{
 		++m_failed_dep_count;
@@ -85,9 +114,59 @@ void Resource::fileLoaded(FS::IFile& file, bool success)
 }
 
 
+void Resource::onParsed()
+{
+	m_is_parsing = false;
+	m_is_waiting_for_load = false;
+	m_resource_manager.getFileSystem().close(*m_parse_file);
+	m_parse_file = nullptr;
+
+	// unloaded while it was parsed
+	if (m_desired_state != State::READY)
+	{
+		unload();
+		return;
+	}
+
+	if (!m_is_parse_successful || !finishParse())
+	{
+		++m_failed_dep_count;
+	}
+
+	--m_empty_dep_count;
+	checkState();
+}
+
+
+void Resource::onDeferredLoad(bool success)
+{
+	ASSERT(m_empty_dep_count > 0);
+	if (!success) ++m_failed_dep_count;
+	--m_empty_dep_count;
+	checkState();
+}
+
+
+void Resource::releasePrefetched()
+{
+	if (m_prefetched.empty()) return;
+
+	// the array can not be touched while dependencies are unloaded, they can call checkState
+	Array<Resource*> prefetched(m_prefetched);
+	m_prefetched.clear();
+	for (Resource* resource : prefetched)
+	{
+		if (resource->remRef() == 0) resource->doUnload();
+	}
+}
+
+
 void Resource::doUnload()
 {
+	releasePrefetched();
 	m_desired_state = State::EMPTY;
+	// workers still write to the resource, onParsed unloads it
+	if (m_is_parsing) return;
 	unload();
 	ASSERT(m_empty_dep_count <= 1);
 
@@ -117,10 +196,24 @@ void Resource::doLoad()
 
 	if (m_is_waiting_for_load) return;
 	m_is_waiting_for_load = true;
+	m_resource_manager.prefetch(*this);
+	// dependencies are recorded again, so the manifest does not keep the ones which are not used anymore
+	m_resource_manager.clearDependencies(*this);
 	FS::FileSystem& fs = m_resource_manager.getFileSystem();
 	FS::ReadCallback cb;
 	cb.bind<Resource, &Resource::fileLoaded>(this);
-	fs.openAsync(fs.getDefaultDevice(), m_path, FS::Mode::OPEN_AND_READ, cb);
+	fs.openAsync(fs.getDefaultDevice(), m_path, FS::Mode::OPEN_AND_READ, cb, m_priority);
+}
+
+
+void Resource::setPriority(int priority)
+{
+	if (m_priority == priority) return;
+	m_priority = priority;
+	if (m_is_waiting_for_load)
+	{
+		m_resource_manager.getFileSystem().setAsyncPriority(m_path, priority);
+	}
 }
 
 
@@ -129,6 +222,8 @@ void Resource::addDependency(Resource& dependent_resource)
 	ASSERT(m_desired_state != State::EMPTY);
 
 	dependent_resource.m_cb.bind<Resource, &Resource::onStateChanged>(this);
+	m_resource_manager.recordDependency(*this, dependent_resource);
+	if (dependent_resource.m_priority < m_priority) dependent_resource.setPriority(m_priority);
 	if (dependent_resource.isEmpty()) ++m_empty_dep_count;
 	if (dependent_resource.isFailure()) ++m_failed_dep_count;
 
@@ -2,6 +2,7 @@
 
 
 #include "core/fs/ifile_system_defines.h"
+#include "core/array.h"
 #include "core/delegate_list.h"
 #include "core/path.h"
 
@@ -16,6 +17,7 @@ class ResourceManager;
 class LUMIX_ENGINE_API Resource
 {
 public:
+	friend class ResourceManager;
 	friend class ResourceManagerBase;
 
 	enum class State : uint32
@@ -27,6 +29,9 @@ public:
 
 	typedef DelegateList<void(State, State)> ObserverCallback;
 
+	static const int DEFAULT_PRIORITY = 0;
+	static const int HIGH_PRIORITY = 1000;
+
 public:
 	State getState() const { return m_current_state; }
 
@@ -38,6 +43,9 @@ public:
 	size_t size() const { return m_size; }
 	const Path& getPath() const { return m_path; }
 	ResourceManager& getResourceManager() { return m_resource_manager; }
+	int getPriority() const { return m_priority; }
+	// resources with higher priority are read first, it can be changed while the file is queued
+	void setPriority(int priority);
 
 	template <typename C, void (C::*Function)(State, State)> void onLoaded(C* instance)
 	{
@@ -55,8 +63,17 @@ protected:
 	virtual void onBeforeReady() {}
 	virtual void unload(void) = 0;
 	virtual bool load(FS::IFile& file) = 0;
+	// Two phase loading, if isParsedAsync() returns true, parse() is called on a worker thread and
+	// then finishParse() on the main thread instead of load(). finishParse() should only do what
+	// must be done on the main thread, e.g. creating GPU buffers or loading dependencies.
+	virtual bool isParsedAsync() const { return false; }
+	virtual bool parse(FS::IFile& file) { return false; }
+	virtual bool finishParse() { return true; }
 
 	void onCreated(State state);
+	// finishes a load which goes on after finishParse(), e.g. a queued GPU upload; finishParse()
+	// keeps the resource empty by adding an empty dependency, this removes it
+	void onDeferredLoad(bool success);
 	void doUnload();
 
 	void addDependency(Resource& dependent_resource);
@@ -74,7 +91,9 @@ protected:
 private:
 	void doLoad();
 	void fileLoaded(FS::IFile& file, bool success);
+	void onParsed();
 	void onStateChanged(State old_state, State new_state);
+	void releasePrefetched();
 	uint32 addRef(void) { return ++m_ref_count; }
 	uint32 remRef(void) { return --m_ref_count; }
 
@@ -86,8 +105,14 @@ private:
 	Path m_path;
 	uint16 m_ref_count;
 	uint16 m_failed_dep_count;
+	int m_priority;
 	State m_current_state;
+	FS::IFile* m_parse_file;
+	// dependencies from the manifest, they are kept loaded until this resource is loaded
+	Array<Resource*> m_prefetched;
 	bool m_is_waiting_for_load;
+	bool m_is_parsing;
+	bool m_is_parse_successful;
 }; // class Resource
 
 
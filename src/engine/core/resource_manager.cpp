@@ -1,41 +1,325 @@
 #include "lumix.h"
+#include "core/blob.h"
+#include "core/fs/file_system.h"
+#include "core/log.h"
+#include "core/math_utils.h"
+#include "core/mt/atomic.h"
+#include "core/mtjd/generic_job.h"
+#include "core/mtjd/manager.h"
 #include "core/path.h"
+#include "core/profiler.h"
+#include "core/resource.h"
 #include "core/resource_manager.h"
 #include "core/resource_manager_base.h"
+#include "core/timer.h"
+#include <cfloat>
 
 namespace Lumix
 {
+	static const uint32 MANIFEST_MAGIC = 0x4e414d4c; // 'LMAN'
+	static const uint32 MANIFEST_VERSION = 0;
+	// an external tool saving many files at once notifies about them over this many seconds
+	static const float RELOAD_DELAY = 0.25f;
+
+
 	ResourceManager::ResourceManager(IAllocator& allocator) 
 		: m_resource_managers(allocator)
+		, m_managers_mutex(false)
 		, m_allocator(allocator)
+		, m_file_system(nullptr)
+		, m_mtjd_manager(nullptr)
+		, m_timer(nullptr)
+		, m_parsed(allocator)
+		, m_parsed_mutex(false)
+		, m_parsing_count(0)
+		, m_manifest(allocator)
+		, m_is_manifest_dirty(false)
+		, m_is_prefetching(false)
+		, m_last_loaded_count(0)
+		, m_load_mutex(false)
+		, m_is_parallel_loading(false)
+		, m_reload_queue(allocator)
+		, m_reloads(allocator)
+		, m_last_reload_request(0)
 	{
 	}
 
 	ResourceManager::~ResourceManager()
 	{
+		for (ManifestDependencies* dependencies : m_manifest)
+		{
+			LUMIX_DELETE(m_allocator, dependencies);
+		}
 	}
 
-	void ResourceManager::create(FS::FileSystem& fs)
+	void ResourceManager::create(FS::FileSystem& fs, MTJD::Manager& mtjd_manager)
 	{
 		m_file_system = &fs;
+		m_mtjd_manager = &mtjd_manager;
+		m_timer = Timer::create(m_allocator);
 	}
 
 	void ResourceManager::destroy()
 	{
+		ASSERT(!isParsing());
+		ASSERT(m_reloads.empty());
+		Timer::destroy(m_timer);
+		m_timer = nullptr;
+	}
+
+	void ResourceManager::lockLoading()
+	{
+		if (m_is_parallel_loading) m_load_mutex.lock();
+	}
+
+
+	void ResourceManager::unlockLoading()
+	{
+		if (m_is_parallel_loading) m_load_mutex.unlock();
+	}
+
+
+	void ResourceManager::onLoaded(Resource& resource)
+	{
+		if (!m_timer) return;
+
+		auto& loaded = m_last_loaded[m_last_loaded_count % MAX_LAST_LOADED];
+		copyString(loaded.path, resource.getPath().c_str());
+		loaded.time = m_timer->getTimeSinceStart();
+		++m_last_loaded_count;
+	}
+
+
+	int ResourceManager::getLastLoadedCount() const
+	{
+		return Math::minValue(m_last_loaded_count, (int)MAX_LAST_LOADED);
+	}
+
+
+	const ResourceManager::LoadedResource& ResourceManager::getLastLoaded(int index) const
+	{
+		ASSERT(index < getLastLoadedCount());
+		return m_last_loaded[(m_last_loaded_count - 1 - index) % MAX_LAST_LOADED];
+	}
+
+
+	float ResourceManager::getTime() const
+	{
+		return m_timer ? m_timer->getTimeSinceStart() : 0;
+	}
+
+
+	void ResourceManager::parseAsync(Resource& resource)
+	{
+		MT::atomicIncrement(&m_parsing_count);
+		Resource* res = &resource;
+		auto* job = MTJD::makeJob(*m_mtjd_manager,
+			[this, res]() {
+				PROFILE_BLOCK("parse resource");
+				res->m_is_parse_successful = res->parse(*res->m_parse_file);
+				MT::SpinLock lock(m_parsed_mutex);
+				m_parsed.push(res);
+			},
+			m_mtjd_manager->getJobAllocator(),
+			MTJD::Priority::Low);
+		m_mtjd_manager->schedule(job);
+	}
+
+	void ResourceManager::update(float time_budget)
+	{
+		PROFILE_FUNCTION();
+		if (!m_reloads.empty())
+		{
+			finishReloads();
+		}
+		else if (!m_reload_queue.empty() && getTime() - m_last_reload_request > RELOAD_DELAY)
+		{
+			startReloads();
+		}
+
+		float start = m_timer->getTimeSinceStart();
+		for (;;)
+		{
+			Resource* resource;
+			{
+				MT::SpinLock lock(m_parsed_mutex);
+				if (m_parsed.empty()) return;
+				resource = m_parsed[0];
+				m_parsed.erase(0);
+			}
+			MT::atomicDecrement(&m_parsing_count);
+			resource->onParsed();
+			if (m_timer->getTimeSinceStart() - start > time_budget) return;
+		}
+	}
+
+	void ResourceManager::finishParsing()
+	{
+		while (isParsing())
+		{
+			m_mtjd_manager->tryExecuteJob();
+			update(FLT_MAX);
+		}
 	}
 	
+	ResourceManager::ManifestDependencies& ResourceManager::getManifestDependencies(uint32 owner_hash)
+	{
+		auto iter = m_manifest.find(owner_hash);
+		if (iter.isValid()) return *iter.value();
+
+		auto* dependencies = LUMIX_NEW(m_allocator, ManifestDependencies)(m_allocator);
+		m_manifest.insert(owner_hash, dependencies);
+		return *dependencies;
+	}
+
+	void ResourceManager::recordDependency(Resource& owner, Resource& dependency)
+	{
+		uint32 type = 0;
+		for (auto iter = m_resource_managers.begin(), end = m_resource_managers.end(); iter != end; ++iter)
+		{
+			if (iter.value()->get(dependency.getPath()) == &dependency)
+			{
+				type = iter.key();
+				break;
+			}
+		}
+		if (type == 0) return;
+
+		ManifestDependencies& dependencies = getManifestDependencies(owner.getPath().getHash());
+		for (const ManifestDependency& dep : dependencies)
+		{
+			if (dep.type == type && dep.path == dependency.getPath()) return;
+		}
+		ManifestDependency& dep = dependencies.emplace();
+		dep.type = type;
+		dep.path = dependency.getPath();
+		m_is_manifest_dirty = true;
+	}
+
+	void ResourceManager::clearDependencies(Resource& owner)
+	{
+		auto iter = m_manifest.find(owner.getPath().getHash());
+		if (!iter.isValid() || iter.value()->empty()) return;
+		iter.value()->clear();
+		m_is_manifest_dirty = true;
+	}
+
+	void ResourceManager::prefetch(Resource& resource)
+	{
+		// resources loaded from here load their own dependencies too, those are already in the list
+		if (m_is_prefetching) return;
+		auto root_iter = m_manifest.find(resource.getPath().getHash());
+		if (!root_iter.isValid() || root_iter.value()->empty()) return;
+
+		PROFILE_FUNCTION();
+		// collect everything first, loading a resource clears its dependencies in the manifest
+		Array<uint32> visited(m_allocator);
+		Array<ManifestDependencies*> queue(m_allocator);
+		ManifestDependencies to_load(m_allocator);
+		visited.push(resource.getPath().getHash());
+		queue.push(root_iter.value());
+		while (!queue.empty())
+		{
+			ManifestDependencies* dependencies = queue.back();
+			queue.pop();
+			for (const ManifestDependency& dep : *dependencies)
+			{
+				uint32 hash = dep.path.getHash();
+				if (visited.indexOf(hash) >= 0) continue;
+				visited.push(hash);
+				to_load.push(dep);
+
+				auto iter = m_manifest.find(hash);
+				if (iter.isValid()) queue.push(iter.value());
+			}
+		}
+
+		m_is_prefetching = true;
+		for (const ManifestDependency& dep : to_load)
+		{
+			auto manager_iter = m_resource_managers.find(dep.type);
+			if (manager_iter == m_resource_managers.end()) continue;
+			resource.m_prefetched.push(manager_iter.value()->load(dep.path));
+		}
+		m_is_prefetching = false;
+	}
+
+	void ResourceManager::saveManifest(OutputBlob& blob)
+	{
+		int count = 0;
+		for (ManifestDependencies* dependencies : m_manifest)
+		{
+			if (!dependencies->empty()) ++count;
+		}
+
+		blob.write(MANIFEST_MAGIC);
+		blob.write(MANIFEST_VERSION);
+		blob.write((int32)count);
+		for (auto iter = m_manifest.begin(), end = m_manifest.end(); iter != end; ++iter)
+		{
+			ManifestDependencies& dependencies = *iter.value();
+			if (dependencies.empty()) continue;
+			blob.write(iter.key());
+			blob.write((int32)dependencies.size());
+			for (const ManifestDependency& dep : dependencies)
+			{
+				blob.write(dep.type);
+				blob.writeString(dep.path.c_str());
+			}
+		}
+		m_is_manifest_dirty = false;
+	}
+
+	bool ResourceManager::loadManifest(InputBlob& blob)
+	{
+		uint32 magic = 0;
+		uint32 version = 0;
+		int32 count = 0;
+		blob.read(magic);
+		blob.read(version);
+		if (magic != MANIFEST_MAGIC || version != MANIFEST_VERSION)
+		{
+			g_log_warning.log("Core") << "Unsupported resource manifest";
+			return false;
+		}
+
+		blob.read(count);
+		for (int i = 0; i < count; ++i)
+		{
+			uint32 owner_hash = 0;
+			int32 dependency_count = 0;
+			blob.read(owner_hash);
+			blob.read(dependency_count);
+			ManifestDependencies& dependencies = getManifestDependencies(owner_hash);
+			dependencies.clear();
+			dependencies.reserve(dependency_count);
+			for (int j = 0; j < dependency_count; ++j)
+			{
+				ManifestDependency& dep = dependencies.emplace();
+				char path[MAX_PATH_LENGTH];
+				blob.read(dep.type);
+				blob.readString(path, lengthOf(path));
+				dep.path = path;
+			}
+		}
+		return true;
+	}
+
 	ResourceManagerBase* ResourceManager::get(uint32 id)
 	{
+		MT::SpinLock lock(m_managers_mutex);
 		return m_resource_managers[id]; 
 	}
 
 	void ResourceManager::add(uint32 id, ResourceManagerBase* rm)
 	{ 
+		MT::SpinLock lock(m_managers_mutex);
 		m_resource_managers.insert(id, rm);
 	}
 
 	void ResourceManager::remove(uint32 id) 
 	{ 
+		MT::SpinLock lock(m_managers_mutex);
 		m_resource_managers.erase(id); 
 	}
 
@@ -47,6 +331,21 @@ namespace Lumix
 		}
 	}
 
+	void ResourceManager::evictCaches()
+	{
+		// unloaded resources can release dependencies into caches which are already evicted
+		bool is_any_cached = true;
+		while (is_any_cached)
+		{
+			is_any_cached = false;
+			for (auto* i : m_resource_managers)
+			{
+				is_any_cached = is_any_cached || i->getCachedCount() > 0;
+				i->evictCache(0);
+			}
+		}
+	}
+
 	void ResourceManager::reload(const Path& path)
 	{
 		for (auto iter = m_resource_managers.begin(), end = m_resource_managers.end(); iter != end; ++iter)
@@ -54,4 +353,110 @@ namespace Lumix
 			iter.value()->reload(Path(path));
 		}
 	}
+
+	void ResourceManager::queueReload(const Path& path)
+	{
+		m_last_reload_request = getTime();
+		if (m_reload_queue.indexOf(path) < 0) m_reload_queue.push(path);
+	}
+
+	void ResourceManager::startReloads()
+	{
+		PROFILE_FUNCTION();
+		for (const Path& path : m_reload_queue)
+		{
+			for (ResourceManagerBase* manager : m_resource_managers)
+			{
+				Resource* resource = manager->get(path);
+				if (!resource) continue;
+				// there is no current version to keep
+				if (resource->isEmpty())
+				{
+					bool is_used = resource->m_desired_state == Resource::State::READY;
+					if (is_used) manager->reload(*resource);
+					continue;
+				}
+
+				PendingReload& reload = m_reloads.emplace();
+				reload.manager = manager;
+				reload.path = path;
+				reload.shadow = manager->createResource(path);
+				reload.shadow->doLoad();
+			}
+		}
+		m_reload_queue.clear();
+	}
+
+	bool ResourceManager::isDependencyOfReload(const Path& path)
+	{
+		for (const PendingReload& reload : m_reloads)
+		{
+			auto iter = m_manifest.find(reload.path.getHash());
+			if (!iter.isValid()) continue;
+			for (const ManifestDependency& dep : *iter.value())
+			{
+				if (dep.path == path) return true;
+			}
+		}
+		return false;
+	}
+
+	void ResourceManager::finishReloads()
+	{
+		for (const PendingReload& reload : m_reloads)
+		{
+			if (reload.shadow->isEmpty()) return;
+		}
+
+		PROFILE_FUNCTION();
+		// owners first, unloading them can release a changed dependency, which then starts to load
+		// its new version when the owner loads again, and must not be reloaded once more
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			for (const PendingReload& reload : m_reloads)
+			{
+				if (!reload.shadow->isReady()) continue;
+				if (isDependencyOfReload(reload.path) != (pass == 1)) continue;
+				Resource* resource = reload.manager->get(reload.path);
+				if (!resource || resource->m_is_waiting_for_load) continue;
+				reload.manager->reload(*resource);
+			}
+		}
+
+		// the current versions hold the dependencies of the new ones now
+		for (const PendingReload& reload : m_reloads)
+		{
+			if (reload.shadow->isFailure())
+			{
+				g_log_error.log("Core") << "Could not reload " << reload.path.c_str()
+										<< ", the current version is kept";
+			}
+			reload.shadow->doUnload();
+			reload.manager->destroyResource(*reload.shadow);
+		}
+		m_reloads.clear();
+	}
+
+	void ResourceManager::cancelReloads()
+	{
+		m_reload_queue.clear();
+		// update() must not swap them in meanwhile
+		Array<PendingReload> reloads(m_allocator);
+		reloads.swap(m_reloads);
+		for (const PendingReload& reload : reloads)
+		{
+			// file callbacks and workers must not get the destroyed resource
+			while (reload.shadow->m_is_waiting_for_load || reload.shadow->m_is_parsing)
+			{
+				m_file_system->updateAsyncTransactions();
+				m_mtjd_manager->tryExecuteJob();
+				update(FLT_MAX);
+			}
+		}
+		for (const PendingReload& reload : reloads)
+		{
+			reload.shadow->doUnload();
+			reload.manager->destroyResource(*reload.shadow);
+		}
+	}
 }
\ No newline at end of file
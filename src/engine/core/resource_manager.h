@@ -1,12 +1,17 @@
 #pragma once
 
+#include "core/array.h"
+#include "core/hash_map.h"
+#include "core/mt/sync.h"
+#include "core/path.h"
 #include "core/pod_hash_map.h"
 
 namespace Lumix
 {
 
 
-class Path;
+class InputBlob;
+class OutputBlob;
 class Resource;
 
 
@@ -16,7 +21,14 @@ class FileSystem;
 }
 
 
+namespace MTJD
+{
+class Manager;
+}
+
+
 class ResourceManagerBase;
+class Timer;
 
 
 class LUMIX_ENGINE_API ResourceManager final
@@ -36,8 +48,14 @@ public:
 	explicit ResourceManager(IAllocator& allocator);
 	~ResourceManager();
 
-	void create(FS::FileSystem& fs);
+	void create(FS::FileSystem& fs, MTJD::Manager& mtjd_manager);
 	void destroy();
+	// finishes resources parsed on workers, at least one and then as many as fit in time_budget
+	// seconds, the rest is left for the next call
+	void update(float time_budget);
+	// waits for all resources which are being parsed
+	void finishParsing();
+	bool isParsing() const { return m_parsing_count > 0; }
 
 	IAllocator& getAllocator() { return m_allocator; }
 	ResourceManagerBase* get(uint32 id);
@@ -46,14 +64,109 @@ public:
 	void add(uint32 id, ResourceManagerBase* rm);
 	void remove(uint32 id);
 	void reload(const Path& path);
+	// for files changed on disk, e.g. by an external tool; changes are collected until none come
+	// for a while, then new versions of the changed resources are loaded next to the current
+	// ones, which are reloaded in one go when all new versions are ready and are kept when a new
+	// version fails to load
+	void queueReload(const Path& path);
+	bool isReloading() const { return !m_reload_queue.empty() || !m_reloads.empty(); }
+	// drops the new versions which are not swapped in yet, before resource managers are destroyed
+	void cancelReloads();
 	void removeUnreferenced();
+	// unloads the cached unreferenced resources of all types, e.g. when the memory runs low
+	void evictCaches();
 
 	FS::FileSystem& getFileSystem() { return *m_file_system; }
 
+	// Dependencies are recorded while resources load. When a resource with recorded dependencies
+	// starts loading, all of them, including the indirect ones, are requested at once, so their
+	// files are read in parallel instead of one level of dependencies after another.
+	void saveManifest(OutputBlob& blob);
+	bool loadManifest(InputBlob& blob);
+	bool isManifestDirty() const { return m_is_manifest_dirty; }
+	// while enabled, resources are loaded and unloaded under a lock, so workers can do it, e.g.
+	// scenes deserialized in parallel; only the main thread may switch it, with no jobs running
+	void enableParallelLoading(bool enable) { m_is_parallel_loading = enable; }
+
+	struct LoadedResource
+	{
+		char path[MAX_PATH_LENGTH];
+		float time;
+	};
+	enum
+	{
+		MAX_LAST_LOADED = 32
+	};
+	// the most recently loaded resources for diagnostics, index 0 is the newest
+	int getLastLoadedCount() const;
+	const LoadedResource& getLastLoaded(int index) const;
+	float getTime() const;
+
+private:
+	struct ManifestDependency
+	{
+		uint32 type;
+		Path path;
+	};
+	typedef Array<ManifestDependency> ManifestDependencies;
+
+	struct PendingReload
+	{
+		ResourceManagerBase* manager;
+		Path path;
+		// the new version, it is not in the resource table of the manager
+		Resource* shadow;
+	};
+
+private:
+	friend class Resource;
+	friend class ResourceManagerBase;
+	void parseAsync(Resource& resource);
+	void lockLoading();
+	void unlockLoading();
+
+	struct LoadingLock
+	{
+		explicit LoadingLock(ResourceManager& manager)
+			: manager(manager)
+		{
+			manager.lockLoading();
+		}
+		~LoadingLock() { manager.unlockLoading(); }
+
+		ResourceManager& manager;
+	};
+	void recordDependency(Resource& owner, Resource& dependency);
+	void clearDependencies(Resource& owner);
+	void prefetch(Resource& resource);
+	void onLoaded(Resource& resource);
+	ManifestDependencies& getManifestDependencies(uint32 owner_hash);
+	void startReloads();
+	void finishReloads();
+	bool isDependencyOfReload(const Path& path);
+
 private:
 	IAllocator& m_allocator;
 	ResourceManagerTable m_resource_managers;
+	// plugins created in parallel add their managers at the same time
+	MT::SpinMutex m_managers_mutex;
 	FS::FileSystem* m_file_system;
+	MTJD::Manager* m_mtjd_manager;
+	Timer* m_timer;
+	Array<Resource*> m_parsed;
+	MT::SpinMutex m_parsed_mutex;
+	volatile int32 m_parsing_count;
+	HashMap<uint32, ManifestDependencies*> m_manifest;
+	bool m_is_manifest_dirty;
+	bool m_is_prefetching;
+	LoadedResource m_last_loaded[MAX_LAST_LOADED];
+	int m_last_loaded_count;
+	// recursive, loading a resource can load its dependencies
+	MT::Mutex m_load_mutex;
+	bool m_is_parallel_loading;
+	Array<Path> m_reload_queue;
+	Array<PendingReload> m_reloads;
+	float m_last_reload_request;
 };
 
 
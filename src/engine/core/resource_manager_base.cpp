@@ -9,6 +9,10 @@
 
 namespace Lumix
 {
+	// resources which do not know their size would fill the cache for free
+	static const int MAX_CACHED_COUNT = 256;
+
+
 	void ResourceManagerBase::create(uint32 id, ResourceManager& owner)
 	{
 		owner.add(id, this);
@@ -17,6 +21,7 @@ namespace Lumix
 
 	void ResourceManagerBase::destroy(void)
 	{ 
+		evictCache(0);
 		for (auto iter = m_resources.begin(), end = m_resources.end(); iter != end; ++iter)
 		{
 			Resource* resource = iter.value();
@@ -28,6 +33,7 @@ namespace Lumix
 
 	Resource* ResourceManagerBase::get(const Path& path)
 	{
+		ResourceManager::LoadingLock lock(*m_owner);
 		ResourceTable::iterator it = m_resources.find(path.getHash());
 
 		if(m_resources.end() != it)
@@ -54,6 +60,7 @@ namespace Lumix
 
 	Resource* ResourceManagerBase::load(const Path& path)
 	{
+		ResourceManager::LoadingLock lock(*m_owner);
 		Resource* resource = get(path);
 
 		if(nullptr == resource)
@@ -67,6 +74,7 @@ namespace Lumix
 			resource->doLoad();
 		}
 
+		if (resource->getRefCount() == 0) removeFromCache(*resource);
 		resource->addRef();
 		return resource;
 	}
@@ -76,7 +84,10 @@ namespace Lumix
 		Array<Resource*> to_remove(m_allocator);
 		for (auto* i : m_resources)
 		{
-			if (i->getRefCount() == 0) to_remove.push(i);
+			if (i->getRefCount() == 0 && !i->m_is_parsing && getCacheIndex(*i) < 0)
+			{
+				to_remove.push(i);
+			}
 		}
 
 		for (auto* i : to_remove)
@@ -88,11 +99,13 @@ namespace Lumix
 
 	void ResourceManagerBase::load(Resource& resource)
 	{
+		ResourceManager::LoadingLock lock(*m_owner);
 		if(resource.isEmpty())
 		{
 			resource.doLoad();
 		}
 
+		if (resource.getRefCount() == 0) removeFromCache(resource);
 		resource.addRef();
 	}
 
@@ -107,9 +120,20 @@ namespace Lumix
 
 	void ResourceManagerBase::unload(Resource& resource)
 	{
+		ResourceManager::LoadingLock lock(*m_owner);
 		if(0 == resource.remRef())
 		{
-			resource.doUnload();
+			if (m_cache_budget == 0 || !resource.isReady())
+			{
+				resource.doUnload();
+				return;
+			}
+
+			CachedResource& cached = m_cache.emplace();
+			cached.resource = &resource;
+			cached.size = resource.size();
+			m_cache_size += cached.size;
+			evictCache(m_cache_budget);
 		}
 	}
 
@@ -124,6 +148,7 @@ namespace Lumix
 
 	void ResourceManagerBase::forceUnload(Resource& resource)
 	{
+		removeFromCache(resource);
 		resource.doUnload();
 		resource.m_ref_count = 0;
 	}
@@ -143,14 +168,55 @@ namespace Lumix
 		resource.doLoad();
 	}
 
+	void ResourceManagerBase::setCacheBudget(size_t bytes)
+	{
+		m_cache_budget = bytes;
+		evictCache(bytes);
+	}
+
+	int ResourceManagerBase::getCacheIndex(Resource& resource) const
+	{
+		for (int i = 0, c = m_cache.size(); i < c; ++i)
+		{
+			if (m_cache[i].resource == &resource) return i;
+		}
+		return -1;
+	}
+
+	void ResourceManagerBase::removeFromCache(Resource& resource)
+	{
+		int index = getCacheIndex(resource);
+		if (index < 0) return;
+		m_cache_size -= m_cache[index].size;
+		m_cache.erase(index);
+	}
+
+	void ResourceManagerBase::evictCache(size_t size)
+	{
+		ResourceManager::LoadingLock lock(*m_owner);
+		while (!m_cache.empty() &&
+			   (size == 0 || m_cache_size > size || m_cache.size() > MAX_CACHED_COUNT))
+		{
+			Resource* resource = m_cache[0].resource;
+			m_cache_size -= m_cache[0].size;
+			m_cache.erase(0);
+			// can release dependencies, which then go to their own caches
+			resource->doUnload();
+		}
+	}
+
 	ResourceManagerBase::ResourceManagerBase(IAllocator& allocator)
 		: m_size(0)
 		, m_resources(allocator)
 		, m_allocator(allocator)
+		, m_cache(allocator)
+		, m_cache_budget(0)
+		, m_cache_size(0)
 	{ }
 
 	ResourceManagerBase::~ResourceManagerBase()
 	{
 		ASSERT(m_resources.empty());
+		ASSERT(m_cache.empty());
 	}
 }
\ No newline at end of file
@@ -1,7 +1,8 @@
 #pragma once
 
 
-#include "core/pod_hash_map.h"
+#include "core/array.h"
+#include "core/flat_hash_map.h"
 
 
 namespace Lumix
@@ -22,8 +23,9 @@ class ResourceManager;
 class LUMIX_ENGINE_API ResourceManagerBase
 {
 	friend class Resource;
+	friend class ResourceManager;
 public:
-	typedef PODHashMap<uint32, Resource*> ResourceTable;
+	typedef FlatHashMap<uint32, Resource*> ResourceTable;
 
 public:
 	void create(uint32 id, ResourceManager& owner);
@@ -46,6 +48,17 @@ public:
 	void reload(Resource& resource);
 	ResourceTable& getResourceTable() { return m_resources; }
 
+	// Unreferenced resources stay loaded, so they do not have to be loaded again when they are
+	// used soon, e.g. on respawns or level transitions, until the sizes of the cached resources
+	// add up to more than the budget. The least recently used are unloaded first. By default the
+	// budget is 0 and unreferenced resources are unloaded right away.
+	void setCacheBudget(size_t bytes);
+	size_t getCacheBudget() const { return m_cache_budget; }
+	size_t getCacheSize() const { return m_cache_size; }
+	int getCachedCount() const { return m_cache.size(); }
+	// unloads the least recently used cached resources until the rest takes at most size bytes
+	void evictCache(size_t size);
+
 	ResourceManagerBase(IAllocator& allocator);
 	virtual ~ResourceManagerBase();
 
@@ -54,11 +67,27 @@ protected:
 	virtual void destroyResource(Resource& resource) = 0;
 
 	ResourceManager& getOwner() const { return *m_owner; }
+
+private:
+	struct CachedResource
+	{
+		Resource* resource;
+		// the resource may change its size while it is cached, e.g. when it is reloaded
+		size_t size;
+	};
+
+	int getCacheIndex(Resource& resource) const;
+	void removeFromCache(Resource& resource);
+
 private:
 	IAllocator& m_allocator;
 	uint32 m_size;
 	ResourceTable m_resources;
 	ResourceManager* m_owner;
+	// the least recently used first
+	Array<CachedResource> m_cache;
+	size_t m_cache_budget;
+	size_t m_cache_size;
 };
 
 
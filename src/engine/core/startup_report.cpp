@@ -0,0 +1,158 @@
+#include "startup_report.h"
+#include "core/blob.h"
+#include "core/default_allocator.h"
+#include "core/frame_stats.h"
+#include "core/fs/os_file.h"
+#include "core/log.h"
+#include "core/mt/sync.h"
+#include "core/mt/thread.h"
+#include "core/string.h"
+
+
+namespace Lumix
+{
+
+
+namespace StartupReport
+{
+
+
+static const char* PHASE_NAMES[] = {"dll load", "plugin create", "universe load", "first frame"};
+static_assert(sizeof(PHASE_NAMES) / sizeof(PHASE_NAMES[0]) == (int)Phase::COUNT,
+	"Missing phase names");
+
+
+struct Instance
+{
+	Instance()
+		: mutex(false)
+	{
+		count = 0;
+		setMemory(recorded, 0, sizeof(recorded));
+	}
+
+
+	DefaultAllocator allocator;
+	Event events[MAX_EVENTS];
+	int count;
+	bool recorded[(int)Phase::COUNT];
+	MT::SpinMutex mutex;
+};
+
+
+static Instance g_instance;
+
+
+static bool isRecordedOnce(Phase phase)
+{
+	return phase == Phase::UNIVERSE_LOAD || phase == Phase::FIRST_FRAME;
+}
+
+
+void record(Phase phase, const char* name, uint64 start)
+{
+	uint64 end = FrameStats::getRawTime();
+	{
+		MT::SpinLock lock(g_instance.mutex);
+		if (isRecordedOnce(phase) && g_instance.recorded[(int)phase]) return;
+		if (g_instance.count == MAX_EVENTS) return;
+
+		Event& event = g_instance.events[g_instance.count];
+		copyString(event.name, name);
+		event.phase = phase;
+		event.start = FrameStats::toMilliseconds(start);
+		event.duration = FrameStats::toMilliseconds(end - start);
+		event.is_main_thread = MT::isMainThread();
+		g_instance.recorded[(int)phase] = true;
+		++g_instance.count;
+	}
+
+	if (phase == Phase::FIRST_FRAME) dump(nullptr);
+}
+
+
+bool isRecorded(Phase phase)
+{
+	return g_instance.recorded[(int)phase];
+}
+
+
+int getEventCount()
+{
+	return g_instance.count;
+}
+
+
+const Event& getEvent(int index)
+{
+	return g_instance.events[index];
+}
+
+
+const char* getPhaseName(Phase phase)
+{
+	return PHASE_NAMES[(int)phase];
+}
+
+
+void dump(const char* path)
+{
+	OutputBlob blob(g_instance.allocator);
+	blob << "startup";
+	{
+		MT::SpinLock lock(g_instance.mutex);
+		for (int i = 0; i < g_instance.count; ++i)
+		{
+			const Event& event = g_instance.events[i];
+			if (event.phase == Phase::FIRST_FRAME)
+			{
+				blob << ", time to first frame " << event.start + event.duration << " ms";
+			}
+		}
+		for (int i = 0; i < g_instance.count; ++i)
+		{
+			const Event& event = g_instance.events[i];
+			blob << "\n" << PHASE_NAMES[(int)event.phase] << " " << event.name;
+			blob << " at " << event.start << " ms took " << event.duration << " ms";
+			if (!event.is_main_thread) blob << " on a worker";
+		}
+	}
+
+	if (!path || !path[0])
+	{
+		blob.write("\0", 1);
+		g_log_info.log("Engine") << (const char*)blob.getData();
+		return;
+	}
+
+	blob << "\n";
+	FS::OsFile file;
+	if (!file.open(path, FS::Mode::OPEN_OR_CREATE | FS::Mode::WRITE, g_instance.allocator))
+	{
+		g_log_error.log("Engine") << "Failed to write startup report to " << path;
+		return;
+	}
+	file.seek(FS::SeekMode::END, 0);
+	file.write(blob.getData(), blob.getSize());
+	file.close();
+}
+
+
+Scope::Scope(Phase phase, const char* name)
+	: phase(phase)
+	, name(name)
+	, start(FrameStats::getRawTime())
+{
+}
+
+
+Scope::~Scope()
+{
+	record(phase, name, start);
+}
+
+
+} // namespace StartupReport
+
+
+} // namespace Lumix
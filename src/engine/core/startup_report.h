@@ -0,0 +1,72 @@
+#pragma once
+
+
+#include "lumix.h"
+
+
+namespace Lumix
+{
+
+
+// Timeline of the startup, to track the time to the first frame. The report is written to the log
+// when the first frame is recorded, phases recorded later, e.g. the first universe the user loads
+// in the editor, are only kept in the event list.
+namespace StartupReport
+{
+
+
+enum class Phase : int
+{
+	DLL_LOAD,
+	PLUGIN_CREATE,
+	// only the first universe load and the first frame are recorded
+	UNIVERSE_LOAD,
+	FIRST_FRAME,
+
+	COUNT
+};
+
+
+enum
+{
+	MAX_EVENTS = 64
+};
+
+
+struct Event
+{
+	char name[32];
+	Phase phase;
+	// ms since the start of the process
+	float start;
+	float duration;
+	bool is_main_thread;
+};
+
+
+// can be called from any thread, start is FrameStats::getRawTime() when the phase started, the
+// phase ends now
+LUMIX_ENGINE_API void record(Phase phase, const char* name, uint64 start);
+LUMIX_ENGINE_API bool isRecorded(Phase phase);
+LUMIX_ENGINE_API int getEventCount();
+LUMIX_ENGINE_API const Event& getEvent(int index);
+LUMIX_ENGINE_API const char* getPhaseName(Phase phase);
+// writes the report to the log, or appends it to the file at path if it is not empty
+LUMIX_ENGINE_API void dump(const char* path);
+
+
+struct LUMIX_ENGINE_API Scope
+{
+	Scope(Phase phase, const char* name);
+	~Scope();
+
+	Phase phase;
+	const char* name;
+	uint64 start;
+};
+
+
+} // namespace StartupReport
+
+
+} // namespace Lumix
@@ -7,6 +7,11 @@
 namespace Lumix
 {
 	LUMIX_ENGINE_API bool copyFile(const char* from, const char* to);
+	LUMIX_ENGINE_API bool deleteFile(const char* path);
+	// creates all missing directories of the path, the part after the last slash is ignored
+	LUMIX_ENGINE_API bool makePath(const char* path);
+	// per user directory for data which can be thrown away, ends with a slash
+	LUMIX_ENGINE_API bool getCacheDirectory(char* output, int max_size);
 	LUMIX_ENGINE_API void messageBox(const char* text);
 	LUMIX_ENGINE_API bool getCommandLine(char* output, int max_size);
 	LUMIX_ENGINE_API void* loadLibrary(const char* path);
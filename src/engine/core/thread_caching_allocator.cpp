@@ -0,0 +1,331 @@
+#include "core/thread_caching_allocator.h"
+#include "core/math_utils.h"
+#include "core/mt/atomic.h"
+#include "core/mt/thread.h"
+#include "core/string.h"
+
+
+namespace Lumix
+{
+
+
+// up to 128 bytes in steps of 16, then four classes between each two powers of two
+static const uint32 SIZE_CLASSES[] = {16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320,
+	384, 448, 512, 640, 768, 896, 1024, 1280, 1536, 1792, 2048, 2560, 3072, 3584, 4096, 5120,
+	6144, 7168, 8192, 10240, 12288, 14336, 16384};
+static const int SIZE_CLASS_COUNT = sizeof(SIZE_CLASSES) / sizeof(SIZE_CLASSES[0]);
+static const size_t MAX_SMALL_SIZE = 16384;
+static const uint32 LARGE_BLOCK = 0xffffFFFF;
+static const size_t HEADER_SIZE = 16;
+static const size_t MIN_SPAN_SIZE = 64 * 1024;
+static const size_t MIN_BLOCKS_PER_SPAN = 8;
+static const int THREAD_CACHE_SLOTS = 4;
+
+
+// in front of every block, keeps the alignment of HEADER_SIZE
+struct BlockHeader
+{
+	union
+	{
+		void* owner; // small blocks
+		size_t size; // large blocks
+	};
+	uint32 size_class;
+	uint32 offset; // of the user pointer in the parent's block, large blocks only
+};
+
+
+struct ThreadCacheSlot
+{
+	int32 allocator_id;
+	void* cache;
+};
+
+
+static LUMIX_THREAD_LOCAL ThreadCacheSlot s_thread_caches[THREAD_CACHE_SLOTS] = {};
+static volatile int32 s_last_allocator_id = 0;
+
+
+struct ThreadCachingAllocator::ThreadCache
+{
+	struct SizeClass
+	{
+		void* free_list;
+		uint8* current;
+		uint8* end;
+	};
+
+	explicit ThreadCache(IAllocator& allocator)
+		: spans(allocator)
+		, remote_frees(nullptr)
+		, remote_mutex(false)
+		, allocated_bytes(0)
+		, freed_bytes(0)
+		, allocation_count(0)
+		, deallocation_count(0)
+	{
+		thread_id = MT::getCurrentThreadID();
+		setMemory(classes, 0, sizeof(classes));
+	}
+
+	uint32 thread_id;
+	SizeClass classes[SIZE_CLASS_COUNT];
+	Array<void*> spans;
+
+	// blocks of this cache freed by other threads
+	void* volatile remote_frees;
+	MT::SpinMutex remote_mutex;
+
+	// written only by the thread, read by getStats
+	volatile int64 allocated_bytes;
+	volatile int64 freed_bytes;
+	volatile uint32 allocation_count;
+	volatile uint32 deallocation_count;
+};
+
+
+static int getSizeClass(size_t size)
+{
+	if (size <= 128) return size == 0 ? 0 : int((size - 1) / 16);
+
+	int log2 = 7;
+	while ((size - 1) >> (log2 + 1)) ++log2;
+	int step_log2 = log2 - 2;
+	return 8 + (log2 - 7) * 4 + int((size - 1 - ((size_t)1 << log2)) >> step_log2);
+}
+
+
+static BlockHeader* getHeader(void* ptr)
+{
+	return (BlockHeader*)((uint8*)ptr - HEADER_SIZE);
+}
+
+
+ThreadCachingAllocator::ThreadCachingAllocator(IAllocator& parent)
+	: m_parent(parent)
+	, m_caches(parent)
+	, m_caches_mutex(false)
+{
+	m_id = MT::atomicIncrement(&s_last_allocator_id);
+}
+
+
+ThreadCachingAllocator::~ThreadCachingAllocator()
+{
+	for (ThreadCache* cache : m_caches)
+	{
+		for (void* span : cache->spans)
+		{
+			m_parent.deallocate_aligned(span);
+		}
+		LUMIX_DELETE(m_parent, cache);
+	}
+}
+
+
+ThreadCachingAllocator::ThreadCache& ThreadCachingAllocator::createThreadCache()
+{
+	uint32 thread_id = MT::getCurrentThreadID();
+	MT::SpinLock lock(m_caches_mutex);
+	// the thread was pushed out of the thread local slots by other allocators
+	for (ThreadCache* cache : m_caches)
+	{
+		if (cache->thread_id == thread_id) return *cache;
+	}
+	ThreadCache* cache = LUMIX_NEW(m_parent, ThreadCache)(m_parent);
+	m_caches.push(cache);
+	return *cache;
+}
+
+
+ThreadCachingAllocator::ThreadCache& ThreadCachingAllocator::getThreadCache()
+{
+	for (int i = 0; i < THREAD_CACHE_SLOTS; ++i)
+	{
+		if (s_thread_caches[i].allocator_id == m_id) return *(ThreadCache*)s_thread_caches[i].cache;
+	}
+
+	ThreadCache& cache = createThreadCache();
+	for (int i = THREAD_CACHE_SLOTS - 1; i > 0; --i)
+	{
+		s_thread_caches[i] = s_thread_caches[i - 1];
+	}
+	s_thread_caches[0].allocator_id = m_id;
+	s_thread_caches[0].cache = &cache;
+	return cache;
+}
+
+
+void ThreadCachingAllocator::collectRemoteFrees(ThreadCache& cache)
+{
+	void* ptr;
+	{
+		MT::SpinLock lock(cache.remote_mutex);
+		ptr = cache.remote_frees;
+		cache.remote_frees = nullptr;
+	}
+	while (ptr)
+	{
+		void* next = *(void**)ptr;
+		ThreadCache::SizeClass& size_class = cache.classes[getHeader(ptr)->size_class];
+		*(void**)ptr = size_class.free_list;
+		size_class.free_list = ptr;
+		ptr = next;
+	}
+}
+
+
+void* ThreadCachingAllocator::allocateSmall(ThreadCache& cache, int size_class_index)
+{
+	ThreadCache::SizeClass& size_class = cache.classes[size_class_index];
+	if (!size_class.free_list && cache.remote_frees) collectRemoteFrees(cache);
+	if (size_class.free_list)
+	{
+		void* ptr = size_class.free_list;
+		size_class.free_list = *(void**)ptr;
+		return ptr;
+	}
+
+	size_t block_size = SIZE_CLASSES[size_class_index] + HEADER_SIZE;
+	if (!size_class.current || size_class.current + block_size > size_class.end)
+	{
+		size_t span_size = Math::maxValue(MIN_SPAN_SIZE, block_size * MIN_BLOCKS_PER_SPAN);
+		size_class.current = (uint8*)m_parent.allocate_aligned(span_size, HEADER_SIZE);
+		size_class.end = size_class.current + span_size;
+		cache.spans.push(size_class.current);
+	}
+
+	void* ptr = size_class.current + HEADER_SIZE;
+	size_class.current += block_size;
+	BlockHeader* header = getHeader(ptr);
+	header->owner = &cache;
+	header->size_class = size_class_index;
+	header->offset = 0;
+	return ptr;
+}
+
+
+void* ThreadCachingAllocator::allocateLarge(ThreadCache& cache, size_t size, size_t align)
+{
+	size_t offset = Math::maxValue(align, HEADER_SIZE);
+	uint8* mem = (uint8*)m_parent.allocate_aligned(size + offset, offset);
+	void* ptr = mem + offset;
+	BlockHeader* header = getHeader(ptr);
+	header->size = size;
+	header->size_class = LARGE_BLOCK;
+	header->offset = (uint32)offset;
+	return ptr;
+}
+
+
+void* ThreadCachingAllocator::allocate_aligned(size_t size, size_t align)
+{
+	ASSERT(Math::isPowOfTwo(align));
+	ThreadCache& cache = getThreadCache();
+	++cache.allocation_count;
+	if (size <= MAX_SMALL_SIZE && align <= HEADER_SIZE)
+	{
+		int size_class = getSizeClass(size);
+		cache.allocated_bytes += SIZE_CLASSES[size_class];
+		return allocateSmall(cache, size_class);
+	}
+	cache.allocated_bytes += size;
+	return allocateLarge(cache, size, align);
+}
+
+
+void ThreadCachingAllocator::deallocate_aligned(void* ptr)
+{
+	if (!ptr) return;
+
+	ThreadCache& cache = getThreadCache();
+	++cache.deallocation_count;
+	BlockHeader* header = getHeader(ptr);
+	if (header->size_class == LARGE_BLOCK)
+	{
+		cache.freed_bytes += header->size;
+		m_parent.deallocate_aligned((uint8*)ptr - header->offset);
+		return;
+	}
+
+	cache.freed_bytes += SIZE_CLASSES[header->size_class];
+	ThreadCache* owner = (ThreadCache*)header->owner;
+	if (owner == &cache)
+	{
+		ThreadCache::SizeClass& size_class = cache.classes[header->size_class];
+		*(void**)ptr = size_class.free_list;
+		size_class.free_list = ptr;
+		return;
+	}
+
+	MT::SpinLock lock(owner->remote_mutex);
+	*(void**)ptr = owner->remote_frees;
+	owner->remote_frees = ptr;
+}
+
+
+void* ThreadCachingAllocator::reallocate_aligned(void* ptr, size_t size, size_t align)
+{
+	if (!ptr) return allocate_aligned(size, align);
+
+	size_t old_size = getAllocationSize(ptr, true);
+	bool is_aligned = ((uintptr)ptr & (align - 1)) == 0;
+	if (is_aligned && size <= old_size && size > old_size / 2) return ptr;
+
+	void* new_ptr = allocate_aligned(size, align);
+	copyMemory(new_ptr, ptr, Math::minValue(old_size, size));
+	deallocate_aligned(ptr);
+	return new_ptr;
+}
+
+
+void* ThreadCachingAllocator::allocate(size_t size)
+{
+	return allocate_aligned(size, HEADER_SIZE);
+}
+
+
+void ThreadCachingAllocator::deallocate(void* ptr)
+{
+	deallocate_aligned(ptr);
+}
+
+
+void* ThreadCachingAllocator::reallocate(void* ptr, size_t size)
+{
+	return reallocate_aligned(ptr, size, HEADER_SIZE);
+}
+
+
+size_t ThreadCachingAllocator::getAllocationSize(void* ptr, bool)
+{
+	if (!ptr) return 0;
+	BlockHeader* header = getHeader(ptr);
+	return header->size_class == LARGE_BLOCK ? header->size : SIZE_CLASSES[header->size_class];
+}
+
+
+bool ThreadCachingAllocator::getStats(AllocatorStats& stats)
+{
+	int64 allocated_bytes = 0;
+	int64 freed_bytes = 0;
+	uint32 allocation_count = 0;
+	uint32 deallocation_count = 0;
+	{
+		MT::SpinLock lock(m_caches_mutex);
+		for (ThreadCache* cache : m_caches)
+		{
+			allocated_bytes += cache->allocated_bytes;
+			freed_bytes += cache->freed_bytes;
+			allocation_count += cache->allocation_count;
+			deallocation_count += cache->deallocation_count;
+		}
+	}
+	stats.live_bytes = (size_t)(allocated_bytes - freed_bytes);
+	stats.live_count = int32(allocation_count - deallocation_count);
+	stats.allocation_count = allocation_count;
+	return true;
+}
+
+
+} // ~namespace Lumix
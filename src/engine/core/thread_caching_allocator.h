@@ -0,0 +1,52 @@
+#pragma once
+
+
+#include "lumix.h"
+#include "core/array.h"
+#include "core/iallocator.h"
+#include "core/mt/sync.h"
+
+
+namespace Lumix
+{
+
+
+	/// General purpose allocator for many threads. Small blocks are rounded up to size classes
+	/// and served from per-thread free lists, which need no locking. A block freed by another
+	/// thread goes back to its owner's list through a small locked queue. Big blocks go
+	/// directly to the parent allocator. Memory of small blocks is returned to the parent
+	/// only when the allocator is destroyed.
+	class LUMIX_ENGINE_API ThreadCachingAllocator : public IAllocator
+	{
+		public:
+			explicit ThreadCachingAllocator(IAllocator& parent);
+			~ThreadCachingAllocator();
+
+			void* allocate(size_t size) override;
+			void deallocate(void* ptr) override;
+			void* reallocate(void* ptr, size_t size) override;
+			void* allocate_aligned(size_t size, size_t align) override;
+			void deallocate_aligned(void* ptr) override;
+			void* reallocate_aligned(void* ptr, size_t size, size_t align) override;
+			size_t getAllocationSize(void* ptr, bool is_aligned) override;
+			bool getStats(AllocatorStats& stats) override;
+
+		private:
+			struct ThreadCache;
+
+		private:
+			ThreadCache& getThreadCache();
+			ThreadCache& createThreadCache();
+			void* allocateSmall(ThreadCache& cache, int size_class);
+			void* allocateLarge(ThreadCache& cache, size_t size, size_t align);
+			void collectRemoteFrees(ThreadCache& cache);
+
+		private:
+			IAllocator& m_parent;
+			int32 m_id;
+			Array<ThreadCache*> m_caches;
+			MT::SpinMutex m_caches_mutex;
+	};
+
+
+} // ~namespace Lumix
@@ -11,6 +11,9 @@ namespace Lumix
 			virtual float tick() = 0;
 			virtual float getTimeSinceStart() = 0;
 			virtual float getTimeSinceTick() = 0;
+			// ticks of getFrequency() per second, without the precision loss of float seconds
+			virtual uint64 getRawTimeSinceStart() = 0;
+			virtual uint64 getFrequency() = 0;
 
 			static Timer* create(IAllocator& allocator);
 			static void destroy(Timer* timer);
@@ -0,0 +1,209 @@
+#include "core/tracking_allocator.h"
+#include "core/log.h"
+#include "core/mt/atomic.h"
+#include "core/string.h"
+#include "debug/debug.h"
+
+
+namespace Lumix
+{
+
+
+static TrackingAllocator* s_first = nullptr;
+static MT::SpinMutex s_list_mutex(false);
+
+
+TrackingAllocator::TrackingAllocator(IAllocator& source, const char* tag)
+	: BaseProxyAllocator(source)
+	, m_peak_size(0)
+	, m_budget(0)
+	, m_is_over_budget(0)
+	, m_frame_start_count(0)
+	, m_frame_allocation_count(0)
+	, m_stack_tree(nullptr)
+	, m_allocation_infos(source)
+	, m_mutex(false)
+	, m_previous(nullptr)
+{
+	copyString(m_tag, tag);
+
+	MT::SpinLock lock(s_list_mutex);
+	m_next = s_first;
+	if (s_first) s_first->m_previous = this;
+	s_first = this;
+}
+
+
+TrackingAllocator::~TrackingAllocator()
+{
+	enableCallstacks(false);
+
+	MT::SpinLock lock(s_list_mutex);
+	if (m_previous) m_previous->m_next = m_next;
+	if (m_next) m_next->m_previous = m_previous;
+	if (s_first == this) s_first = m_next;
+}
+
+
+TrackingAllocator* TrackingAllocator::getFirst()
+{
+	return s_first;
+}
+
+
+TrackingAllocator* TrackingAllocator::find(const char* tag)
+{
+	MT::SpinLock lock(s_list_mutex);
+	for (TrackingAllocator* allocator = s_first; allocator; allocator = allocator->m_next)
+	{
+		if (compareString(allocator->m_tag, tag) == 0) return allocator;
+	}
+	return nullptr;
+}
+
+
+void TrackingAllocator::lockList()
+{
+	s_list_mutex.lock();
+}
+
+
+void TrackingAllocator::unlockList()
+{
+	s_list_mutex.unlock();
+}
+
+
+void TrackingAllocator::endFrame()
+{
+	MT::SpinLock lock(s_list_mutex);
+	for (TrackingAllocator* allocator = s_first; allocator; allocator = allocator->m_next)
+	{
+		AllocatorStats stats;
+		allocator->getStats(stats);
+		allocator->m_frame_allocation_count = stats.allocation_count - allocator->m_frame_start_count;
+		allocator->m_frame_start_count = stats.allocation_count;
+	}
+}
+
+
+void TrackingAllocator::enableCallstacks(bool enable)
+{
+	MT::SpinLock lock(m_mutex);
+	if (enable == (m_stack_tree != nullptr)) return;
+
+	IAllocator& allocator = getSourceAllocator();
+	if (enable)
+	{
+		m_stack_tree = LUMIX_NEW(allocator, Debug::StackTree);
+		return;
+	}
+	LUMIX_DELETE(allocator, m_stack_tree);
+	m_stack_tree = nullptr;
+	m_allocation_infos.clear();
+}
+
+
+void TrackingAllocator::onAllocated(void* ptr, bool is_aligned)
+{
+	if (!ptr) return;
+
+	AllocatorStats stats;
+	getStats(stats);
+	int64 size = (int64)stats.live_bytes;
+	int64 peak = m_peak_size;
+	while (size > peak && !MT::compareAndExchange64(&m_peak_size, size, peak))
+	{
+		peak = m_peak_size;
+	}
+
+	if (m_budget > 0 && stats.live_bytes > m_budget &&
+		MT::compareAndExchange(&m_is_over_budget, 1, 0))
+	{
+		g_log_warning.log("engine") << m_tag << " is over its memory budget, "
+									<< (uint64)stats.live_bytes << " of " << (uint64)m_budget
+									<< " bytes";
+	}
+
+	if (!m_stack_tree) return;
+	MT::SpinLock lock(m_mutex);
+	if (!m_stack_tree) return;
+	AllocationInfo info;
+	info.stack_leaf = m_stack_tree->record();
+	info.size = getSourceAllocator().getAllocationSize(ptr, is_aligned);
+	m_allocation_infos.insert(ptr, info);
+}
+
+
+// called before the block is freed, another thread could get the same address right after
+void TrackingAllocator::eraseAllocationInfo(void* ptr)
+{
+	if (!ptr || !m_stack_tree) return;
+	MT::SpinLock lock(m_mutex);
+	m_allocation_infos.erase(ptr);
+}
+
+
+void TrackingAllocator::onDeallocated()
+{
+	if (!m_is_over_budget) return;
+
+	AllocatorStats stats;
+	getStats(stats);
+	if (stats.live_bytes <= m_budget) m_is_over_budget = 0;
+}
+
+
+void* TrackingAllocator::allocate(size_t size)
+{
+	void* ptr = BaseProxyAllocator::allocate(size);
+	onAllocated(ptr, false);
+	return ptr;
+}
+
+
+void TrackingAllocator::deallocate(void* ptr)
+{
+	eraseAllocationInfo(ptr);
+	BaseProxyAllocator::deallocate(ptr);
+	onDeallocated();
+}
+
+
+void* TrackingAllocator::reallocate(void* ptr, size_t size)
+{
+	eraseAllocationInfo(ptr);
+	void* new_ptr = BaseProxyAllocator::reallocate(ptr, size);
+	onDeallocated();
+	onAllocated(new_ptr, false);
+	return new_ptr;
+}
+
+
+void* TrackingAllocator::allocate_aligned(size_t size, size_t align)
+{
+	void* ptr = BaseProxyAllocator::allocate_aligned(size, align);
+	onAllocated(ptr, true);
+	return ptr;
+}
+
+
+void TrackingAllocator::deallocate_aligned(void* ptr)
+{
+	eraseAllocationInfo(ptr);
+	BaseProxyAllocator::deallocate_aligned(ptr);
+	onDeallocated();
+}
+
+
+void* TrackingAllocator::reallocate_aligned(void* ptr, size_t size, size_t align)
+{
+	eraseAllocationInfo(ptr);
+	void* new_ptr = BaseProxyAllocator::reallocate_aligned(ptr, size, align);
+	onDeallocated();
+	onAllocated(new_ptr, true);
+	return new_ptr;
+}
+
+
+} // namespace Lumix
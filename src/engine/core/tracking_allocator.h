@@ -0,0 +1,91 @@
+#pragma once
+
+
+#include "lumix.h"
+#include "core/base_proxy_allocator.h"
+#include "core/mt/sync.h"
+#include "core/pod_hash_map.h"
+
+
+namespace Lumix
+{
+
+
+namespace Debug
+{
+class StackNode;
+class StackTree;
+}
+
+
+/// Proxy allocator which accounts memory of one subsystem. All tracking allocators are in
+/// a global list, so tools can show them. Byte counts are known only if the source allocator
+/// knows sizes of its blocks, see IAllocator::getAllocationSize.
+class LUMIX_ENGINE_API TrackingAllocator : public BaseProxyAllocator
+{
+public:
+	struct AllocationInfo
+	{
+		Debug::StackNode* stack_leaf;
+		size_t size;
+	};
+
+	typedef PODHashMap<void*, AllocationInfo> AllocationInfos;
+
+public:
+	TrackingAllocator(IAllocator& source, const char* tag);
+	~TrackingAllocator();
+
+	void* allocate(size_t size) override;
+	void deallocate(void* ptr) override;
+	void* reallocate(void* ptr, size_t size) override;
+	void* allocate_aligned(size_t size, size_t align) override;
+	void deallocate_aligned(void* ptr) override;
+	void* reallocate_aligned(void* ptr, size_t size, size_t align) override;
+
+	const char* getTag() const { return m_tag; }
+	size_t getPeakSize() const { return (size_t)m_peak_size; }
+	// allocations in the last finished frame
+	uint32 getFrameAllocationCount() const { return m_frame_allocation_count; }
+	// warning is logged when the live size gets over the budget, 0 means no budget
+	void setBudget(size_t budget) { m_budget = budget; }
+	size_t getBudget() const { return m_budget; }
+
+	// callstacks are recorded only while enabled, it's slow
+	void enableCallstacks(bool enable);
+	bool areCallstacksEnabled() const { return m_stack_tree != nullptr; }
+	// lock while accessing getAllocationInfos
+	void lock() { m_mutex.lock(); }
+	void unlock() { m_mutex.unlock(); }
+	const AllocationInfos& getAllocationInfos() const { return m_allocation_infos; }
+
+	TrackingAllocator* getNext() const { return m_next; }
+	static TrackingAllocator* getFirst();
+	static TrackingAllocator* find(const char* tag);
+	// lock while iterating the list
+	static void lockList();
+	static void unlockList();
+	// called by the engine once per frame
+	static void endFrame();
+
+private:
+	void onAllocated(void* ptr, bool is_aligned);
+	void eraseAllocationInfo(void* ptr);
+	void onDeallocated();
+
+private:
+	char m_tag[32];
+	volatile int64 m_peak_size;
+	size_t m_budget;
+	volatile int32 m_is_over_budget;
+	uint32 m_frame_start_count;
+	uint32 m_frame_allocation_count;
+	Debug::StackTree* m_stack_tree;
+	AllocationInfos m_allocation_infos;
+	MT::SpinMutex m_mutex;
+	TrackingAllocator* m_next;
+	TrackingAllocator* m_previous;
+};
+
+
+} // namespace Lumix
@@ -63,6 +63,8 @@ public:
 	void* allocate_aligned(size_t size, size_t align) override;
 	void deallocate_aligned(void* ptr) override;
 	void* reallocate_aligned(void* ptr, size_t size, size_t align) override;
+	size_t getAllocationSize(void* ptr, bool is_aligned) override;
+	bool getStats(AllocatorStats& stats) override { return m_source.getStats(stats); }
 	size_t getTotalSize() const { return m_total_size; }
 	void checkGuards();
 
@@ -402,6 +402,18 @@ void* Allocator::reallocate_aligned(void* ptr, size_t size, size_t align)
 }
 
 
+size_t Allocator::getAllocationSize(void* ptr, bool is_aligned)
+{
+#ifndef _DEBUG
+	return m_source.getAllocationSize(ptr, is_aligned);
+#else
+	// aligned allocations are not tracked
+	if (!ptr || is_aligned) return m_source.getAllocationSize(ptr, is_aligned);
+	return getAllocationInfoFromUser(ptr)->m_size;
+#endif
+}
+
+
 void* Allocator::allocate(size_t size)
 {
 #ifndef _DEBUG
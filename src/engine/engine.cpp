@@ -1,16 +1,33 @@
 #include "engine.h"
 #include "core/blob.h"
+#include "core/command_line_parser.h"
 #include "core/crc32.h"
+#include "core/frame_allocator.h"
+#include "core/frame_stats.h"
 #include "core/fs/os_file.h"
 #include "core/input_system.h"
 #include "core/log.h"
+#include "core/lua_allocator.h"
+#include "core/lua_bytecode_cache.h"
+#include "core/lua_compat.h"
 #include "core/path.h"
 #include "core/profiler.h"
 #include "core/resource_manager.h"
+#include "core/startup_report.h"
+#include "core/string.h"
+#include "core/system.h"
 #include "core/timer.h"
+#include "core/tracking_allocator.h"
+#include "core/fs/cache_file_device.h"
+#include "core/fs/compressed_file_device.h"
 #include "core/fs/disk_file_device.h"
 #include "core/fs/file_system.h"
+#include "core/fs/ifile.h"
+#include "core/fs/mapped_file_device.h"
 #include "core/fs/memory_file_device.h"
+#include "core/fs/pack_file_device.h"
+#include "core/mtjd/generic_job.h"
+#include "core/mtjd/group.h"
 #include "core/mtjd/manager.h"
 #include "debug/debug.h"
 #include "engine/iplugin.h"
@@ -19,7 +36,6 @@
 #include "plugin_manager.h"
 #include "universe/hierarchy.h"
 #include "universe/universe.h"
-#include <lua.hpp>
 
 
 namespace Lumix
@@ -27,6 +43,15 @@ namespace Lumix
 
 static const uint32 SERIALIZED_ENGINE_MAGIC = 0x5f4c454e; // == '_LEN'
 static const uint32 HIERARCHY_HASH = crc32("hierarchy");
+static const float RESOURCE_FINISH_TIME_BUDGET = 0.002f;
+static const float FILE_CALLBACKS_TIME_BUDGET_MS = 4.0f;
+static const size_t FRAME_ALLOCATOR_SIZE = 8 * 1024 * 1024;
+static const char* RESOURCE_MANIFEST_PATH = "resources.manifest";
+static const float DEFAULT_LUA_GC_BUDGET = 0.001f;
+static const int LUA_GC_STEP_KB = 16;
+// the heap may grow this much over its size after the last cycle before the budget is ignored
+static const int LUA_GC_MAX_GROWTH_KB = 16 * 1024;
+static const uint32 INPUT_RECORDING_MAGIC = 0x5f52454c; // == '_REL'
 
 
 enum class SerializedEngineVersion : int32
@@ -37,6 +62,7 @@ enum class SerializedEngineVersion : int32
 	SCENE_VERSION,
 	HIERARCHY_COMPONENT,
 	SCENE_VERSION_CHECK,
+	SCENE_CHUNKS,
 
 	LATEST // must be the last one
 };
@@ -53,11 +79,168 @@ public:
 #pragma pack()
 
 
+SceneSerializationCache::SceneSerializationCache(IAllocator& allocator)
+	: m_allocator(allocator)
+	, m_chunks(allocator)
+{
+}
+
+
+SceneSerializationCache::~SceneSerializationCache()
+{
+	clear();
+}
+
+
+void SceneSerializationCache::markDirty(IScene* scene)
+{
+	for (auto& chunk : m_chunks)
+	{
+		if (chunk.scene == scene) chunk.is_dirty = true;
+	}
+}
+
+
+void SceneSerializationCache::markAllDirty()
+{
+	for (auto& chunk : m_chunks) chunk.is_dirty = true;
+}
+
+
+void SceneSerializationCache::clear()
+{
+	for (auto& chunk : m_chunks) LUMIX_DELETE(m_allocator, chunk.blob);
+	m_chunks.clear();
+}
+
+
+SceneSerializationCache::Chunk& SceneSerializationCache::getChunk(IScene* scene)
+{
+	for (auto& chunk : m_chunks)
+	{
+		if (chunk.scene == scene) return chunk;
+	}
+	Chunk& chunk = m_chunks.emplace();
+	chunk.scene = scene;
+	chunk.blob = LUMIX_NEW(m_allocator, OutputBlob)(m_allocator);
+	chunk.is_dirty = true;
+	return chunk;
+}
+
+
+static void getLuaCacheDirectory(char* dir, int max_size)
+{
+	dir[0] = '\0';
+	char cmd_line[2048];
+	getCommandLine(cmd_line, lengthOf(cmd_line));
+
+	CommandLineParser parser(cmd_line);
+	while (parser.next())
+	{
+		if (!parser.currentEquals("-lua_cache")) continue;
+		if (!parser.next()) break;
+
+		parser.getCurrent(dir, max_size);
+		break;
+	}
+}
+
+
+struct InputRecordingOptions
+{
+	char record_path[MAX_PATH_LENGTH];
+	char replay_path[MAX_PATH_LENGTH];
+	int fixed_fps;
+};
+
+
+static void getInputRecordingOptions(InputRecordingOptions& options)
+{
+	options.record_path[0] = '\0';
+	options.replay_path[0] = '\0';
+	options.fixed_fps = 0;
+	char cmd_line[2048];
+	getCommandLine(cmd_line, lengthOf(cmd_line));
+
+	CommandLineParser parser(cmd_line);
+	while (parser.next())
+	{
+		if (parser.currentEquals("-record_input"))
+		{
+			if (!parser.next()) break;
+			parser.getCurrent(options.record_path, lengthOf(options.record_path));
+		}
+		else if (parser.currentEquals("-replay_input"))
+		{
+			if (!parser.next()) break;
+			parser.getCurrent(options.replay_path, lengthOf(options.replay_path));
+		}
+		else if (parser.currentEquals("-fixed_fps"))
+		{
+			if (!parser.next()) break;
+			char tmp[16];
+			parser.getCurrent(tmp, lengthOf(tmp));
+			fromCString(tmp, lengthOf(tmp), &options.fixed_fps);
+		}
+	}
+}
+
+
+static uint32 parseHex(const char* str)
+{
+	if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) str += 2;
+	uint32 value = 0;
+	for (; *str; ++str)
+	{
+		char c = *str;
+		if (c >= '0' && c <= '9') value = (value << 4) | (c - '0');
+		else if (c >= 'a' && c <= 'f') value = (value << 4) | (c - 'a' + 10);
+		else if (c >= 'A' && c <= 'F') value = (value << 4) | (c - 'A' + 10);
+		else break;
+	}
+	return value;
+}
+
+
+static void getJobManagerConfig(MTJD::Manager::Config& config)
+{
+	char cmd_line[2048];
+	getCommandLine(cmd_line, lengthOf(cmd_line));
+
+	CommandLineParser parser(cmd_line);
+	while (parser.next())
+	{
+		char tmp[16];
+		if (parser.currentEquals("-job_background_workers"))
+		{
+			if (!parser.next()) break;
+			parser.getCurrent(tmp, lengthOf(tmp));
+			fromCString(tmp, lengthOf(tmp), &config.background_workers);
+		}
+		else if (parser.currentEquals("-job_aging"))
+		{
+			if (!parser.next()) break;
+			parser.getCurrent(tmp, lengthOf(tmp));
+			fromCString(tmp, lengthOf(tmp), &config.aging_limit);
+		}
+		else if (parser.currentEquals("-job_affinity"))
+		{
+			if (!parser.next()) break;
+			parser.getCurrent(tmp, lengthOf(tmp));
+			config.affinity_mask = parseHex(tmp);
+		}
+	}
+}
+
+
 class EngineImpl : public Engine
 {
 public:
 	EngineImpl(const char* base_path0, const char* base_path1, FS::FileSystem* fs, IAllocator& allocator)
 		: m_allocator(allocator)
+		, m_frame_allocator(m_allocator, FRAME_ALLOCATOR_SIZE)
+		, m_lua_allocator(m_allocator, "lua")
+		, m_lua_pool(m_lua_allocator)
 		, m_resource_manager(m_allocator)
 		, m_mtjd_manager(nullptr)
 		, m_fps(0)
@@ -65,59 +248,85 @@ public:
 		, m_component_types(m_allocator)
 		, m_last_time_delta(0)
 		, m_path_manager(m_allocator)
+		, m_lua_bytecode_cache(m_allocator)
+		, m_lua_gc_budget(DEFAULT_LUA_GC_BUDGET)
+		, m_lua_heap_after_cycle(0)
 		, m_time_multiplier(1.0f)
+		, m_fixed_time_delta(0)
 		, m_paused(false)
 		, m_next_frame(false)
+		, m_is_frame_pipelining_enabled(false)
+		, m_is_recording_input(false)
+		, m_is_replaying_input(false)
+		, m_input_record_blob(m_allocator)
+		, m_input_replay_data(m_allocator)
+		, m_input_replay_blob(nullptr, 0)
+		, m_scene_jobs(m_allocator)
+		, m_scene_jobs_sync(true, m_allocator)
 	{
-		m_state = lua_newstate(luaAllocator, &m_allocator);
+#ifdef LUMIX_LUAJIT
+		// LuaJIT on 64-bit does not support custom allocators
+		m_state = luaL_newstate();
+#else
+		m_state = lua_newstate(&LuaAllocator::luaAlloc, &m_lua_pool);
+#endif
 		luaL_openlibs(m_state);
-
-		m_mtjd_manager = MTJD::Manager::create(m_allocator);
+		// collected in update(), with a time budget, instead of whenever Lua allocates
+		lua_gc(m_state, LUA_GCSTOP, 0);
+		m_lua_heap_after_cycle = lua_gc(m_state, LUA_GCCOUNT, 0);
+		char lua_cache_dir[MAX_PATH_LENGTH];
+		getLuaCacheDirectory(lua_cache_dir, lengthOf(lua_cache_dir));
+		m_lua_bytecode_cache.setDirectory(lua_cache_dir);
+
+		MTJD::Manager::Config job_config;
+		getJobManagerConfig(job_config);
+		m_mtjd_manager =
+			MTJD::Manager::create(m_allocator, MTJD::SchedulerType::Default, job_config);
 		if (!fs)
 		{
 			m_file_system = FS::FileSystem::create(m_allocator);
 
 			m_mem_file_device = LUMIX_NEW(m_allocator, FS::MemoryFileDevice)(m_allocator);
 			m_disk_file_device = LUMIX_NEW(m_allocator, FS::DiskFileDevice)(base_path0, base_path1, m_allocator);
+			m_pack_file_device = LUMIX_NEW(m_allocator, FS::PackFileDevice)(m_allocator);
+			m_compressed_file_device = LUMIX_NEW(m_allocator, FS::CompressedFileDevice)(m_allocator);
+			m_cache_file_device = LUMIX_NEW(m_allocator, FS::CacheFileDevice)(m_allocator);
+			m_mapped_file_device =
+				LUMIX_NEW(m_allocator, FS::MappedFileDevice)(base_path0, base_path1, m_allocator);
 
 			m_file_system->mount(m_mem_file_device);
+			m_file_system->mount(m_cache_file_device);
+			m_file_system->mount(m_compressed_file_device);
+			m_file_system->mount(m_pack_file_device);
+			m_file_system->mount(m_mapped_file_device);
 			m_file_system->mount(m_disk_file_device);
-			m_file_system->setDefaultDevice("memory:disk");
+			m_file_system->setDefaultDevice("memory:cache:compressed:pack:mapped:disk");
 			m_file_system->setSaveGameDevice("memory:disk");
+			m_file_system->setCallbacksTimeBudget(FILE_CALLBACKS_TIME_BUDGET_MS);
 		}
 		else
 		{
 			m_file_system = fs;
 			m_mem_file_device = nullptr;
 			m_disk_file_device = nullptr;
+			m_pack_file_device = nullptr;
+			m_compressed_file_device = nullptr;
+			m_cache_file_device = nullptr;
+			m_mapped_file_device = nullptr;
 		}
 
-		m_resource_manager.create(*m_file_system);
+		m_resource_manager.create(*m_file_system, *m_mtjd_manager);
+		if (m_disk_file_device) loadResourceManifest();
+		Profiler::getHitchListeners().bind<EngineImpl, &EngineImpl::onHitch>(this);
 
 		m_timer = Timer::create(m_allocator);
 		m_fps_timer = Timer::create(m_allocator);
+		m_gc_timer = Timer::create(m_allocator);
 		m_fps_frame = 0;
 		PropertyRegister::init(m_allocator);
 	}
 
 
-	static void* luaAllocator(void* ud, void* ptr, size_t osize, size_t nsize)
-	{
-		auto& allocator = *static_cast<IAllocator*>(ud);
-		if (nsize == 0)
-		{
-			allocator.deallocate(ptr);
-			return nullptr;
-		}
-		if (nsize > 0 && ptr == nullptr) return allocator.allocate(nsize);
-
-		void* new_mem = allocator.allocate(nsize);
-		copyMemory(new_mem, ptr, Math::minValue(osize, nsize));
-		allocator.deallocate(ptr);
-		return new_mem;
-	}
-
-
 	void registerProperties()
 	{
 		PropertyRegister::registerComponentType("hierarchy", "Hierarchy");
@@ -136,7 +345,7 @@ public:
 			return false;
 		}
 
-		HierarchyPlugin* hierarchy = LUMIX_NEW(m_allocator, HierarchyPlugin)(m_allocator);
+		HierarchyPlugin* hierarchy = LUMIX_NEW(m_allocator, HierarchyPlugin)(*m_mtjd_manager, m_allocator);
 		m_plugin_manager->addPlugin(hierarchy);
 
 		m_input_system = InputSystem::create(m_allocator);
@@ -147,15 +356,106 @@ public:
 
 		registerProperties();
 
+		InputRecordingOptions options;
+		getInputRecordingOptions(options);
+		if (options.fixed_fps > 0) setFixedTimeDelta(1.0f / options.fixed_fps);
+		if (options.record_path[0]) startInputRecording(options.record_path);
+		if (options.replay_path[0]) startInputReplay(options.replay_path);
+
 		return true;
 	}
 
 
+	// what was loading when the frame took too long
+	void onHitch(Profiler::HitchInfo& info)
+	{
+		const FS::AsyncStats& stats = m_file_system->getAsyncStats();
+		char tmp[MAX_PATH_LENGTH + 30];
+		toCString(stats.in_progress_count, tmp, lengthOf(tmp));
+		info.add("fs in progress", tmp);
+		toCString(stats.pending_count, tmp, lengthOf(tmp));
+		info.add("fs pending", tmp);
+		toCString(stats.callbacks_time * 1000, tmp, lengthOf(tmp), 3);
+		info.add("fs callbacks [ms]", tmp);
+
+		const char* paths[32];
+		int count = m_file_system->getAsyncPaths(paths, lengthOf(paths));
+		for (int i = 0; i < count; ++i)
+		{
+			char key[30];
+			copyString(key, "fs transaction ");
+			toCString(i, tmp, lengthOf(tmp));
+			catString(key, tmp);
+			info.add(key, paths[i]);
+		}
+
+		float now = m_resource_manager.getTime();
+		for (int i = 0, c = m_resource_manager.getLastLoadedCount(); i < c; ++i)
+		{
+			const auto& loaded = m_resource_manager.getLastLoaded(i);
+			char key[30];
+			copyString(key, "loaded resource ");
+			toCString(i, tmp, lengthOf(tmp));
+			catString(key, tmp);
+			copyString(tmp, loaded.path);
+			catString(tmp, ", ");
+			char age[20];
+			toCString(now - loaded.time, age, lengthOf(age), 3);
+			catString(tmp, age);
+			catString(tmp, " s ago");
+			info.add(key, tmp);
+		}
+	}
+
+
+	void loadResourceManifest()
+	{
+		FS::IFile* file = m_file_system->open(
+			m_file_system->getDiskDevice(), Path(RESOURCE_MANIFEST_PATH), FS::Mode::OPEN_AND_READ);
+		if (!file) return;
+
+		Array<uint8> data(m_allocator);
+		data.resize((int)file->size());
+		if (!data.empty() && file->read(&data[0], data.size()))
+		{
+			InputBlob blob(&data[0], data.size());
+			m_resource_manager.loadManifest(blob);
+		}
+		m_file_system->close(*file);
+	}
+
+
+	void saveResourceManifest()
+	{
+		if (!m_resource_manager.isManifestDirty()) return;
+
+		FS::IFile* file = m_file_system->open(
+			m_file_system->getDiskDevice(), Path(RESOURCE_MANIFEST_PATH), FS::Mode::CREATE | FS::Mode::WRITE);
+		if (!file)
+		{
+			g_log_warning.log("Core") << "Could not save " << RESOURCE_MANIFEST_PATH;
+			return;
+		}
+
+		OutputBlob blob(m_allocator);
+		m_resource_manager.saveManifest(blob);
+		file->write(blob.getData(), blob.getSize());
+		m_file_system->close(*file);
+	}
+
+
 	~EngineImpl()
 	{
+		Profiler::getHitchListeners().unbind<EngineImpl, &EngineImpl::onHitch>(this);
+		stopInputRecording();
+		m_resource_manager.finishParsing();
+		m_resource_manager.cancelReloads();
+		m_resource_manager.evictCaches();
+		if (m_disk_file_device) saveResourceManifest();
 		PropertyRegister::shutdown();
 		Timer::destroy(m_timer);
 		Timer::destroy(m_fps_timer);
+		Timer::destroy(m_gc_timer);
 		PluginManager::destroy(m_plugin_manager);
 		if (m_input_system) InputSystem::destroy(*m_input_system);
 		if (m_disk_file_device)
@@ -163,6 +463,10 @@ public:
 			FS::FileSystem::destroy(m_file_system);
 			LUMIX_DELETE(m_allocator, m_mem_file_device);
 			LUMIX_DELETE(m_allocator, m_disk_file_device);
+			LUMIX_DELETE(m_allocator, m_pack_file_device);
+			LUMIX_DELETE(m_allocator, m_compressed_file_device);
+			LUMIX_DELETE(m_allocator, m_cache_file_device);
+			LUMIX_DELETE(m_allocator, m_mapped_file_device);
 		}
 
 		m_resource_manager.destroy();
@@ -185,6 +489,7 @@ public:
 
 
 	IAllocator& getAllocator() override { return m_allocator; }
+	FrameAllocator& getFrameAllocator() override { return m_frame_allocator; }
 
 
 	Universe& createUniverse() override
@@ -229,6 +534,9 @@ public:
 
 	FS::FileSystem& getFileSystem() override { return *m_file_system; }
 	FS::DiskFileDevice* getDiskFileDevice() override { return m_disk_file_device; }
+	FS::PackFileDevice* getPackFileDevice() override { return m_pack_file_device; }
+	FS::CompressedFileDevice* getCompressedFileDevice() override { return m_compressed_file_device; }
+	FS::CacheFileDevice* getCacheFileDevice() override { return m_cache_file_device; }
 
 	void startGame(Universe& context) override
 	{
@@ -264,12 +572,125 @@ public:
 	}
 
 
+	void enableFramePipelining(bool enable) override
+	{
+		m_is_frame_pipelining_enabled = enable;
+	}
+
+
+	bool isFramePipeliningEnabled() const override
+	{
+		return m_is_frame_pipelining_enabled;
+	}
+
+
 	void setTimeMultiplier(float multiplier) override
 	{
 		m_time_multiplier = multiplier;
 	}
 
 
+	void setFixedTimeDelta(float time_delta) override
+	{
+		m_fixed_time_delta = time_delta;
+	}
+
+
+	bool startInputRecording(const char* path) override
+	{
+		stopInputRecording();
+		stopInputReplay();
+		if (!m_input_record_file.open(path, FS::Mode::CREATE | FS::Mode::WRITE, m_allocator))
+		{
+			g_log_error.log("Core") << "Could not create input recording " << path;
+			return false;
+		}
+		m_input_record_file.write(&INPUT_RECORDING_MAGIC, sizeof(INPUT_RECORDING_MAGIC));
+		m_is_recording_input = true;
+		g_log_info.log("Core") << "Recording input to " << path;
+		return true;
+	}
+
+
+	void stopInputRecording() override
+	{
+		if (!m_is_recording_input) return;
+		m_is_recording_input = false;
+		m_input_record_file.close();
+		m_input_system->stopRecordReplay();
+	}
+
+
+	bool startInputReplay(const char* path) override
+	{
+		stopInputRecording();
+		stopInputReplay();
+		FS::OsFile file;
+		if (!file.open(path, FS::Mode::OPEN_AND_READ, m_allocator))
+		{
+			g_log_error.log("Core") << "Could not open input recording " << path;
+			return false;
+		}
+		m_input_replay_data.resize((int)file.size());
+		bool success = !m_input_replay_data.empty() &&
+					   file.read(&m_input_replay_data[0], m_input_replay_data.size());
+		file.close();
+		uint32 magic = 0;
+		if (success)
+		{
+			m_input_replay_blob = InputBlob(&m_input_replay_data[0], m_input_replay_data.size());
+			m_input_replay_blob.read(magic);
+		}
+		if (magic != INPUT_RECORDING_MAGIC)
+		{
+			g_log_error.log("Core") << "Invalid input recording " << path;
+			m_input_replay_data.clear();
+			return false;
+		}
+		m_is_replaying_input = true;
+		g_log_info.log("Core") << "Replaying input from " << path;
+		return true;
+	}
+
+
+	void stopInputReplay() override
+	{
+		if (!m_is_replaying_input) return;
+		m_is_replaying_input = false;
+		m_input_replay_blob = InputBlob(nullptr, 0);
+		m_input_replay_data.clear();
+		m_input_system->stopRecordReplay();
+	}
+
+
+	bool isReplayingInput() const override { return m_is_replaying_input; }
+
+
+	// returns the recorded time delta instead of the measured one
+	float recordReplayInput(float frame_time)
+	{
+		if (m_is_replaying_input)
+		{
+			float recorded_time;
+			if (m_input_replay_blob.read(&recorded_time, sizeof(recorded_time)) &&
+				m_input_system->replayFrame(m_input_replay_blob))
+			{
+				return recorded_time;
+			}
+			g_log_info.log("Core") << "Input replay finished";
+			stopInputReplay();
+		}
+		else if (m_is_recording_input)
+		{
+			m_input_record_blob.clear();
+			m_input_record_blob.write(frame_time);
+			m_input_system->recordFrame(m_input_record_blob);
+			m_input_record_file.write(m_input_record_blob.getData(), m_input_record_blob.getSize());
+		}
+		return frame_time;
+	}
+
+
 	void update(Universe& context) override
 	{
 		PROFILE_FUNCTION();
@@ -280,23 +701,27 @@ public:
 			m_fps = m_fps_frame / m_fps_timer->tick();
 			m_fps_frame = 0;
 		}
-		dt = m_timer->tick() * m_time_multiplier;
+		float frame_time = m_timer->tick();
+		float input_time = recordReplayInput(frame_time);
+		dt = (m_fixed_time_delta > 0 ? m_fixed_time_delta : input_time) * m_time_multiplier;
 		if (m_next_frame)
 		{
 			m_paused = false;
 			dt = 1 / 30.0f;
 		}
 		m_last_time_delta = dt;
-		{
-			PROFILE_BLOCK("update scenes");
-			for (auto* scene : context.getScenes())
-			{
-				scene->update(dt, m_paused);
-			}
-		}
+		updateScenes(context, dt);
 		m_plugin_manager->update(dt, m_paused);
+		auto* hierarchy = static_cast<Hierarchy*>(context.getScene(crc32("hierarchy")));
+		if (hierarchy) hierarchy->updateWorldMatrices();
+		context.notifyTransformChanges();
 		m_input_system->update(dt);
 		getFileSystem().updateAsyncTransactions();
+		m_resource_manager.update(RESOURCE_FINISH_TIME_BUDGET);
+		updateLuaGC();
+		m_frame_allocator.endFrame();
+		TrackingAllocator::endFrame();
+		FrameStats::frame(frame_time);
 
 		if (m_next_frame)
 		{
@@ -306,6 +731,112 @@ public:
 	}
 
 
+	void updateLuaGC()
+	{
+		PROFILE_FUNCTION();
+		int heap_kb = lua_gc(m_state, LUA_GCCOUNT, 0);
+		// garbage is made faster than the budget collects it, finish the cycle now
+		bool is_over_limit = heap_kb > m_lua_heap_after_cycle + LUA_GC_MAX_GROWTH_KB;
+		float start = m_gc_timer->getTimeSinceStart();
+		do
+		{
+			if (lua_gc(m_state, LUA_GCSTEP, LUA_GC_STEP_KB))
+			{
+				m_lua_heap_after_cycle = lua_gc(m_state, LUA_GCCOUNT, 0);
+				break;
+			}
+		} while (is_over_limit || m_gc_timer->getTimeSinceStart() - start < m_lua_gc_budget);
+
+		PROFILE_INT("Lua heap [KB]", lua_gc(m_state, LUA_GCCOUNT, 0));
+		const LuaAllocator::Stats& pool_stats = m_lua_pool.getStats();
+		PROFILE_INT("Lua pool pages [KB]", int(pool_stats.page_bytes >> 10));
+		PROFILE_INT("Lua small blocks", pool_stats.small_count);
+	}
+
+
+	void setLuaGCBudget(float seconds) override { m_lua_gc_budget = seconds; }
+	float getLuaGCBudget() const override { return m_lua_gc_budget; }
+
+
+	static bool isParallelUpdateScene(const IScene& scene)
+	{
+		return scene.getUpdateReads() != SceneData::ALL && scene.getUpdateWrites() != SceneData::ALL;
+	}
+
+
+	void runSceneJobs()
+	{
+		if (m_scene_jobs.empty()) return;
+
+		for (auto& scene_job : m_scene_jobs)
+		{
+			if (scene_job.is_root) m_mtjd_manager->schedule(scene_job.job);
+		}
+		m_scene_jobs_sync.sync(*m_mtjd_manager);
+		m_scene_jobs.clear();
+	}
+
+
+	void addSceneJob(IScene* scene, float dt)
+	{
+		bool paused = m_paused;
+		SceneJob& scene_job = m_scene_jobs.emplace();
+		scene_job.reads = scene->getUpdateReads();
+		scene_job.writes = scene->getUpdateWrites();
+		scene_job.is_root = true;
+		int histogram = getUpdateHistogram(*scene);
+		scene_job.job = MTJD::makeJob(*m_mtjd_manager,
+			[scene, dt, paused, histogram]() {
+				FrameStats::Scope stats_scope(histogram);
+				scene->update(dt, paused);
+			},
+			m_mtjd_manager->getJobAllocator());
+		scene_job.job->addDependency(&m_scene_jobs_sync);
+
+		for (int i = 0; i < m_scene_jobs.size() - 1; ++i)
+		{
+			SceneJob& prev = m_scene_jobs[i];
+			if ((prev.writes & (scene_job.reads | scene_job.writes)) != 0 ||
+				(prev.reads & scene_job.writes) != 0)
+			{
+				prev.job->addDependency(scene_job.job);
+				scene_job.is_root = false;
+			}
+		}
+	}
+
+
+	// update time of each scene type, in ms
+	static int getUpdateHistogram(IScene& scene)
+	{
+		return FrameStats::addHistogram(scene.getPlugin().getName(), 20);
+	}
+
+
+	void updateScenes(Universe& context, float dt)
+	{
+		PROFILE_BLOCK("update scenes");
+		for (auto* scene : context.getScenes())
+		{
+			if (isParallelUpdateScene(*scene))
+			{
+				addSceneJob(scene, dt);
+			}
+			else
+			{
+				runSceneJobs();
+				FrameStats::Scope stats_scope(getUpdateHistogram(*scene));
+				scene->update(dt, m_paused);
+			}
+		}
+		runSceneJobs();
+		for (auto* scene : context.getScenes())
+		{
+			scene->lateUpdate(dt, m_paused);
+		}
+	}
+
+
 	InputSystem& getInputSystem() override { return *m_input_system; }
 
 
@@ -379,6 +910,15 @@ public:
 
 
 	uint32 serialize(Universe& ctx, OutputBlob& serializer) override
+	{
+		SceneSerializationCache cache(m_allocator);
+		return serialize(ctx, serializer, cache);
+	}
+
+
+	uint32 serialize(Universe& ctx,
+		OutputBlob& serializer,
+		SceneSerializationCache& cache) override
 	{
 		SerializedEngineHeader header;
 		header.m_magic = SERIALIZED_ENGINE_MAGIC; // == '_LEN'
@@ -396,7 +936,16 @@ public:
 		{
 			serializer.writeString(scene->getPlugin().getName());
 			serializer.write(scene->getVersion());
-			scene->serialize(serializer);
+			auto& chunk = cache.getChunk(scene);
+			if (chunk.is_dirty)
+			{
+				PROFILE_BLOCK(scene->getPlugin().getName());
+				chunk.blob->clear();
+				scene->serialize(*chunk.blob);
+				chunk.is_dirty = false;
+			}
+			serializer.write((int32)chunk.blob->getSize());
+			serializer.write(chunk.blob->getData(), chunk.blob->getSize());
 		}
 		uint32 crc = crc32((const uint8*)serializer.getData() + pos,
 							 serializer.getSize() - pos);
@@ -405,6 +954,15 @@ public:
 
 
 	bool deserialize(Universe& ctx, InputBlob& serializer) override
+	{
+		uint64 start = FrameStats::getRawTime();
+		bool success = deserializeUniverse(ctx, serializer);
+		if (success) StartupReport::record(StartupReport::Phase::UNIVERSE_LOAD, "universe", start);
+		return success;
+	}
+
+
+	bool deserializeUniverse(Universe& ctx, InputBlob& serializer)
 	{
 		SerializedEngineHeader header;
 		serializer.read(header);
@@ -439,6 +997,12 @@ public:
 		m_plugin_manager->deserialize(serializer);
 		int32 scene_count;
 		serializer.read(scene_count);
+		if (header.m_version > SerializedEngineVersion::SCENE_CHUNKS)
+		{
+			bool success = deserializeSceneChunks(ctx, serializer, scene_count);
+			m_path_manager.clear();
+			return success;
+		}
 		for (int i = 0; i < scene_count; ++i)
 		{
 			char tmp[32];
@@ -456,7 +1020,71 @@ public:
 	}
 
 
+	// every scene is in its own length prefixed chunk, so neighbouring scenes which allow it are
+	// deserialized in parallel and unknown scenes are skipped
+	bool deserializeSceneChunks(Universe& ctx, InputBlob& serializer, int scene_count)
+	{
+		bool success = true;
+		const uint8* end = (const uint8*)serializer.getData() + serializer.getSize();
+		PROFILE_FUNCTION();
+		ctx.beginComponentBatch();
+		m_resource_manager.enableParallelLoading(true);
+		for (int i = 0; i < scene_count; ++i)
+		{
+			char tmp[32];
+			serializer.readString(tmp, sizeof(tmp));
+			int32 scene_version;
+			serializer.read(scene_version);
+			int32 size;
+			serializer.read(size);
+			const void* data = serializer.skip(size);
+			if (size < 0 || (const uint8*)data + size > end)
+			{
+				g_log_error.log("Core") << "Wrong or corrupted file";
+				success = false;
+				break;
+			}
+			IScene* scene = ctx.getScene(crc32(tmp));
+			if (!scene)
+			{
+				g_log_warning.log("Core") << "Skipping unknown scene " << tmp;
+				continue;
+			}
+
+			if (scene->isDeserializedInParallel())
+			{
+				addDeserializeJob(scene, data, size, scene_version);
+				continue;
+			}
+			runSceneJobs();
+			InputBlob scene_blob(data, size);
+			scene->deserialize(scene_blob, scene_version);
+		}
+		runSceneJobs();
+		m_resource_manager.enableParallelLoading(false);
+		ctx.endComponentBatch();
+		return success;
+	}
+
+
+	void addDeserializeJob(IScene* scene, const void* data, int size, int version)
+	{
+		SceneJob& scene_job = m_scene_jobs.emplace();
+		scene_job.reads = scene_job.writes = 0;
+		scene_job.is_root = true;
+		scene_job.job = MTJD::makeJob(*m_mtjd_manager,
+			[scene, data, size, version]() {
+				PROFILE_BLOCK("deserialize scene");
+				InputBlob blob(data, size);
+				scene->deserialize(blob, version);
+			},
+			m_mtjd_manager->getJobAllocator());
+		scene_job.job->addDependency(&m_scene_jobs_sync);
+	}
+
+
 	lua_State* getState() override { return m_state; }
+	LuaBytecodeCache& getLuaBytecodeCache() override { return m_lua_bytecode_cache; }
 	PathManager& getPathManager() override{ return m_path_manager; }
 	float getLastTimeDelta() override { return m_last_time_delta; }
 
@@ -476,32 +1104,61 @@ private:
 		uint32 m_dependency;
 	};
 
+	struct SceneJob
+	{
+		MTJD::Job* job;
+		uint32 reads;
+		uint32 writes;
+		bool is_root;
+	};
+
 private:
 	Debug::Allocator m_allocator;
+	FrameAllocator m_frame_allocator;
+	TrackingAllocator m_lua_allocator;
+	LuaAllocator m_lua_pool;
 
 	FS::FileSystem* m_file_system;
 	FS::MemoryFileDevice* m_mem_file_device;
 	FS::DiskFileDevice* m_disk_file_device;
+	FS::PackFileDevice* m_pack_file_device;
+	FS::CompressedFileDevice* m_compressed_file_device;
+	FS::CacheFileDevice* m_cache_file_device;
+	FS::MappedFileDevice* m_mapped_file_device;
 
 	ResourceManager m_resource_manager;
 	
 	MTJD::Manager* m_mtjd_manager;
+	Array<SceneJob> m_scene_jobs;
+	MTJD::Group m_scene_jobs_sync;
 
 	Array<ComponentType> m_component_types;
 	PluginManager* m_plugin_manager;
 	InputSystem* m_input_system;
 	Timer* m_timer;
 	Timer* m_fps_timer;
+	Timer* m_gc_timer;
 	int m_fps_frame;
 	float m_time_multiplier;
+	float m_fixed_time_delta;
 	float m_fps;
 	float m_last_time_delta;
 	bool m_is_game_running;
 	bool m_paused;
 	bool m_next_frame;
+	bool m_is_frame_pipelining_enabled;
+	bool m_is_recording_input;
+	bool m_is_replaying_input;
+	FS::OsFile m_input_record_file;
+	OutputBlob m_input_record_blob;
+	Array<uint8> m_input_replay_data;
+	InputBlob m_input_replay_blob;
 	PlatformData m_platform_data;
 	PathManager m_path_manager;
+	LuaBytecodeCache m_lua_bytecode_cache;
 	lua_State* m_state;
+	float m_lua_gc_budget;
+	int m_lua_heap_after_cycle;
 
 private:
 	void operator=(const EngineImpl&);
@@ -545,12 +1202,15 @@ Engine* Engine::create(const char* base_path0,
 	g_log_info.getCallback().bind<showLogInVS>();
 	g_log_warning.getCallback().bind<showLogInVS>();
 	g_log_error.getCallback().bind<showLogInVS>();
+	// the callbacks write to files and the debug output, workers should not wait for that
+	Log::startWriter(allocator);
 
 	EngineImpl* engine = LUMIX_NEW(allocator, EngineImpl)(base_path0, base_path1, fs, allocator);
 	if (!engine->create())
 	{
 		g_log_error.log("Core") << "Failed to create engine.";
 		LUMIX_DELETE(allocator, engine);
+		Log::stopWriter();
 		return nullptr;
 	}
 	g_log_info.log("Core") << "Engine created.";
@@ -562,6 +1222,7 @@ void Engine::destroy(Engine* engine, IAllocator& allocator)
 {
 	LUMIX_DELETE(allocator, engine);
 
+	Log::stopWriter();
 	g_error_file.close();
 }
 
@@ -2,6 +2,7 @@
 
 
 #include "lumix.h"
+#include "core/array.h"
 
 
 struct lua_State;
@@ -11,8 +12,11 @@ namespace Lumix
 {
 namespace FS
 {
+class CacheFileDevice;
+class CompressedFileDevice;
 class DiskFileDevice;
 class FileSystem;
+class PackFileDevice;
 }
 
 namespace MTJD
@@ -20,9 +24,12 @@ namespace MTJD
 class Manager;
 }
 
+class FrameAllocator;
 class InputBlob;
 class IAllocator;
 class InputSystem;
+class IScene;
+class LuaBytecodeCache;
 class OutputBlob;
 class PathManager;
 class PluginManager;
@@ -30,6 +37,35 @@ class ResourceManager;
 class Universe;
 
 
+// Serialized scenes kept between Engine::serialize calls, scenes which are not marked dirty are
+// copied from here instead of being serialized again
+class LUMIX_ENGINE_API SceneSerializationCache
+{
+public:
+	struct Chunk
+	{
+		IScene* scene;
+		OutputBlob* blob;
+		bool is_dirty;
+	};
+
+public:
+	explicit SceneSerializationCache(IAllocator& allocator);
+	~SceneSerializationCache();
+
+	void markDirty(IScene* scene);
+	void markAllDirty();
+	// must be called before the scenes are destroyed
+	void clear();
+	// chunks of scenes not serialized yet are dirty
+	Chunk& getChunk(IScene* scene);
+
+private:
+	IAllocator& m_allocator;
+	Array<Chunk> m_chunks;
+};
+
+
 class LUMIX_ENGINE_API Engine
 {
 public:
@@ -54,25 +90,52 @@ public:
 
 	virtual FS::FileSystem& getFileSystem() = 0;
 	virtual FS::DiskFileDevice* getDiskFileDevice() = 0;
+	virtual FS::PackFileDevice* getPackFileDevice() = 0;
+	virtual FS::CompressedFileDevice* getCompressedFileDevice() = 0;
+	virtual FS::CacheFileDevice* getCacheFileDevice() = 0;
 	virtual InputSystem& getInputSystem() = 0;
 	virtual PluginManager& getPluginManager() = 0;
 	virtual MTJD::Manager& getMTJDManager() = 0;
 	virtual ResourceManager& getResourceManager() = 0;
 	virtual IAllocator& getAllocator() = 0;
+	// scratch memory valid until the end of the next update()
+	virtual FrameAllocator& getFrameAllocator() = 0;
 
 	virtual void startGame(Universe& context) = 0;
 	virtual void stopGame(Universe& context) = 0;
 
 	virtual void update(Universe& context) = 0;
 	virtual uint32 serialize(Universe& ctx, OutputBlob& serializer) = 0;
+	// scenes which are not dirty in the cache are not serialized again
+	virtual uint32 serialize(Universe& ctx,
+		OutputBlob& serializer,
+		SceneSerializationCache& cache) = 0;
 	virtual bool deserialize(Universe& ctx, InputBlob& serializer) = 0;
 	virtual float getFPS() const = 0;
 	virtual float getLastTimeDelta() = 0;
 	virtual void setTimeMultiplier(float multiplier) = 0;
+	// every update() advances the time by this instead of the measured frame time, 0 turns it off
+	virtual void setFixedTimeDelta(float time_delta) = 0;
+	// every update() writes its time delta and the input to the file, see -record_input
+	virtual bool startInputRecording(const char* path) = 0;
+	virtual void stopInputRecording() = 0;
+	// update() takes the time deltas and the input from a recording until its end, with a fixed
+	// time delta only the input is replayed; see -replay_input and -fixed_fps
+	virtual bool startInputReplay(const char* path) = 0;
+	virtual void stopInputReplay() = 0;
+	virtual bool isReplayingInput() const = 0;
 	virtual void pause(bool pause) = 0;
 	virtual void nextFrame() = 0;
+	// scenes may leave work started in update() running while the caller renders the frame,
+	// its results are applied in the next update(), i.e. one frame later
+	virtual void enableFramePipelining(bool enable) = 0;
+	virtual bool isFramePipeliningEnabled() const = 0;
 	virtual PathManager& getPathManager() = 0;
 	virtual lua_State* getState() = 0;
+	virtual LuaBytecodeCache& getLuaBytecodeCache() = 0;
+	// the automatic Lua GC is off, update() runs incremental steps for at most this long
+	virtual void setLuaGCBudget(float seconds) = 0;
+	virtual float getLuaGCBudget() const = 0;
 
 protected:
 	Engine() {}
@@ -14,6 +14,24 @@ namespace Lumix
 	class Universe;
 
 
+	// Data touched by IScene::update. Scenes which override getUpdateReads / getUpdateWrites
+	// are updated on MTJD workers, in parallel with other scenes which do not touch the same data.
+	struct SceneData
+	{
+		enum : uint32
+		{
+			TRANSFORMS = 1 << 0,
+			RENDER = 1 << 1,
+			PHYSICS = 1 << 2,
+			ANIMATION = 1 << 3,
+			SCRIPT = 1 << 4,
+			AUDIO = 1 << 5,
+
+			ALL = 0xffffFFFF
+		};
+	};
+
+
 	class LUMIX_ENGINE_API IScene
 	{
 		public:
@@ -25,6 +43,9 @@ namespace Lumix
 			virtual void deserialize(InputBlob& serializer, int version) = 0;
 			virtual IPlugin& getPlugin() const = 0;
 			virtual void update(float time_delta, bool paused) = 0;
+			// called on the main thread after all scenes are updated, finishes work which ran
+			// in parallel with other scenes since update
+			virtual void lateUpdate(float /*time_delta*/, bool /*paused*/) {}
 			virtual bool ownComponentType(uint32 type) const = 0;
 			virtual ComponentIndex getComponent(Entity entity, uint32 type) = 0;
 			virtual Universe& getUniverse() = 0;
@@ -32,6 +53,11 @@ namespace Lumix
 			virtual void stopGame() {}
 			virtual int getVersion() const { return -1; }
 			virtual void sendMessage(uint32 /*type*/, void* /*message*/) {}
+			virtual uint32 getUpdateReads() const { return SceneData::ALL; }
+			virtual uint32 getUpdateWrites() const { return SceneData::ALL; }
+			// deserialize can run on a worker, in parallel with the neighbouring scenes which
+			// return true too; it must not depend on them
+			virtual bool isDeserializedInParallel() const { return false; }
 	};
 
 
@@ -47,6 +73,14 @@ namespace Lumix
 			virtual void update(float) {}
 			virtual const char* getName() const = 0;
 			virtual void sendMessage(const char*) {}
+			// create can run on a worker, in parallel with other plugins loaded by the same
+			// PluginManager::load call which return true too; it must not touch the window or
+			// the graphics device, and plugins loaded by that call are not in getPlugin yet
+			virtual bool isCreatedInParallel() const { return false; }
+			// plugins loaded before this one by the same PluginManager::load call, which have to
+			// be created first; a plugin created in parallel depending on one which is not is
+			// created on the main thread too
+			virtual bool dependsOn(const char* /*plugin_name*/) const { return false; }
 
 			virtual IScene* createScene(Universe&) { return nullptr; }
 			virtual void destroyScene(IScene*) { ASSERT(false); }
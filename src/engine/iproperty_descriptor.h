@@ -83,7 +83,7 @@ class ResourcePropertyDescriptorBase
 public:
 	ResourcePropertyDescriptorBase(uint32 resource_type) { m_resource_type = resource_type; }
 
-	uint32 getResourceType() { return m_resource_type; }
+	uint32 getResourceType() const { return m_resource_type; }
 
 	uint32 m_resource_type;
 };
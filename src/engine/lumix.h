@@ -67,6 +67,7 @@ namespace Lumix
 #define LUMIX_LIBRARY_IMPORT __declspec(dllimport)
 #define LUMIX_FORCE_INLINE __forceinline
 #define LUMIX_RESTRICT __restrict
+#define LUMIX_THREAD_LOCAL __declspec(thread)
 
 #ifdef STATIC_PLUGINS
 	#define LUMIX_AUDIO_API
@@ -1,7 +1,12 @@
 #include "plugin_manager.h"
 #include "core/array.h"
 #include "core/log.h"
+#include "core/mtjd/generic_job.h"
+#include "core/mtjd/group.h"
+#include "core/mtjd/manager.h"
+#include "core/path_utils.h"
 #include "core/profiler.h"
+#include "core/startup_report.h"
 #include "core/system.h"
 #include "debug/debug.h"
 #include "engine.h"
@@ -105,50 +110,53 @@ class PluginManagerImpl : public PluginManager
 
 		IPlugin* load(const char* path) override
 		{
-			char path_with_ext[MAX_PATH_LENGTH];
-			copyString(path_with_ext, path);
-			catString(path_with_ext, ".dll");
-			g_log_info.log("Core") << "loading plugin " << path_with_ext;
-			typedef IPlugin* (*PluginCreator)(Engine&);
-			auto* lib = loadLibrary(path_with_ext);
-			if (lib)
+			IPlugin* plugin;
+			load(&path, 1, &plugin);
+			return plugin;
+		}
+
+
+		void load(const char* const* paths, int count, IPlugin** loaded) override
+		{
+			Array<LoadingPlugin> plugins(m_allocator);
+			plugins.resize(count);
+			for (int i = 0; i < count; ++i)
+			{
+				loadPlugin(paths[i], plugins[i]);
+			}
+
+			createPlugins(plugins);
+
+			bool any_library = false;
+			for (int i = 0; i < count; ++i)
 			{
-				PluginCreator creator = (PluginCreator)getLibrarySymbol(lib, "createPlugin");
-				if (creator)
+				LoadingPlugin& loading = plugins[i];
+				loaded[i] = loading.is_created ? loading.plugin : nullptr;
+				if (!loading.is_created)
 				{
-					IPlugin* plugin = creator(m_engine);
-					if (!plugin || !plugin->create())
+					if (loading.plugin)
 					{
 						g_log_error.log("Core") << "createPlugin failed.";
-						LUMIX_DELETE(m_engine.getAllocator(), plugin);
-						ASSERT(false);
-						return nullptr;
+						LUMIX_DELETE(m_engine.getAllocator(), loading.plugin);
 					}
-					m_plugins.push(plugin);
-					m_libraries.push(lib);
-					m_library_loaded.invoke(lib);
-					g_log_info.log("Core") << "Plugin loaded.";
-					Lumix::Debug::StackTree::refreshModuleList();
-					return plugin;
-				}
-				else
-				{
-					g_log_error.log("Core") << "No createPlugin function in plugin.";
+					else
+					{
+						g_log_warning.log("Core") << "Failed to load plugin.";
+					}
+					unloadLibrary(loading.library);
+					continue;
 				}
-			}
-			else
-			{
-				auto* plugin = StaticPluginRegister::create(path, m_engine);
-				if (plugin && plugin->create())
+
+				m_plugins.push(loading.plugin);
+				if (loading.library)
 				{
-					g_log_info.log("Core") << "Plugin loaded.";
-					m_plugins.push(plugin);
-					return plugin;
+					m_libraries.push(loading.library);
+					m_library_loaded.invoke(loading.library);
+					any_library = true;
 				}
-				g_log_warning.log("Core") << "Failed to load plugin.";
+				g_log_info.log("Core") << "Plugin loaded.";
 			}
-			unloadLibrary(lib);
-			return 0;
+			if (any_library) Lumix::Debug::StackTree::refreshModuleList();
 		}
 
 
@@ -161,6 +169,143 @@ class PluginManagerImpl : public PluginManager
 		}
 
 
+	private:
+		struct LoadingPlugin
+		{
+			char name[MAX_PATH_LENGTH];
+			IPlugin* plugin;
+			void* library;
+			MTJD::Job* job;
+			bool is_root;
+			bool is_created;
+		};
+
+
+		void loadPlugin(const char* path, LoadingPlugin& loading)
+		{
+			PathUtils::getBasename(loading.name, lengthOf(loading.name), path);
+			loading.plugin = nullptr;
+			loading.library = nullptr;
+			loading.job = nullptr;
+			loading.is_root = true;
+			loading.is_created = false;
+
+			StartupReport::Scope scope(StartupReport::Phase::DLL_LOAD, loading.name);
+			char path_with_ext[MAX_PATH_LENGTH];
+			copyString(path_with_ext, path);
+			catString(path_with_ext, ".dll");
+			g_log_info.log("Core") << "loading plugin " << path_with_ext;
+			typedef IPlugin* (*PluginCreator)(Engine&);
+			loading.library = loadLibrary(path_with_ext);
+			if (!loading.library)
+			{
+				loading.plugin = StaticPluginRegister::create(path, m_engine);
+				return;
+			}
+
+			PluginCreator creator = (PluginCreator)getLibrarySymbol(loading.library, "createPlugin");
+			if (!creator)
+			{
+				g_log_error.log("Core") << "No createPlugin function in plugin.";
+				return;
+			}
+			loading.plugin = creator(m_engine);
+		}
+
+
+		static bool dependsOn(const LoadingPlugin& plugin, const LoadingPlugin& dependency)
+		{
+			return dependency.plugin ? plugin.plugin->dependsOn(dependency.plugin->getName())
+									 : plugin.plugin->dependsOn(dependency.name);
+		}
+
+
+		static bool areDependenciesCreated(const Array<LoadingPlugin>& plugins, int idx)
+		{
+			for (int i = 0; i < idx; ++i)
+			{
+				if (dependsOn(plugins[idx], plugins[i]) && !plugins[i].is_created) return false;
+			}
+			return true;
+		}
+
+
+		static void createPlugin(Array<LoadingPlugin>& plugins, int idx)
+		{
+			LoadingPlugin& loading = plugins[idx];
+			if (!areDependenciesCreated(plugins, idx)) return;
+
+			StartupReport::Scope scope(
+				StartupReport::Phase::PLUGIN_CREATE, loading.plugin->getName());
+			loading.is_created = loading.plugin->create();
+		}
+
+
+		// jobs are created first, so the dependencies between them are known before they run;
+		// plugins on the main thread are created meanwhile, in order
+		void createPlugins(Array<LoadingPlugin>& plugins)
+		{
+			MTJD::Manager& mtjd_manager = m_engine.getMTJDManager();
+			MTJD::Group sync(true, m_allocator);
+			Array<LoadingPlugin>* plugins_ptr = &plugins;
+			bool any_job = false;
+			for (int i = 0; i < plugins.size(); ++i)
+			{
+				LoadingPlugin& loading = plugins[i];
+				if (!loading.plugin || !loading.plugin->isCreatedInParallel()) continue;
+
+				bool depends_on_main_thread = false;
+				for (int j = 0; j < i; ++j)
+				{
+					if (plugins[j].plugin && !plugins[j].job && dependsOn(loading, plugins[j]))
+					{
+						depends_on_main_thread = true;
+						break;
+					}
+				}
+				if (depends_on_main_thread) continue;
+
+				loading.job = MTJD::makeJob(mtjd_manager,
+					[plugins_ptr, i]() { createPlugin(*plugins_ptr, i); },
+					mtjd_manager.getJobAllocator());
+				loading.job->addDependency(&sync);
+				any_job = true;
+				for (int j = 0; j < i; ++j)
+				{
+					if (plugins[j].job && dependsOn(loading, plugins[j]))
+					{
+						plugins[j].job->addDependency(loading.job);
+						loading.is_root = false;
+					}
+				}
+			}
+
+			for (auto& loading : plugins)
+			{
+				if (loading.job && loading.is_root) mtjd_manager.schedule(loading.job);
+			}
+
+			for (int i = 0; i < plugins.size(); ++i)
+			{
+				LoadingPlugin& loading = plugins[i];
+				if (!loading.plugin || loading.job) continue;
+
+				if (any_job)
+				{
+					for (int j = 0; j < i; ++j)
+					{
+						if (!plugins[j].job || !dependsOn(loading, plugins[j])) continue;
+						sync.sync(mtjd_manager);
+						any_job = false;
+						break;
+					}
+				}
+				createPlugin(plugins, i);
+			}
+			if (any_job) sync.sync(mtjd_manager);
+		}
+
+
 	private:
 		Engine& m_engine;
 		DelegateList<void(void*)> m_library_loaded;
@@ -26,6 +26,10 @@ namespace Lumix
 			static void destroy(PluginManager* manager);
 			
 			virtual IPlugin* load(const char* path) = 0;
+			// loads all the plugins before any is created, so plugins returning true from
+			// IPlugin::isCreatedInParallel are created on workers; loaded[i] is nullptr if
+			// paths[i] failed
+			virtual void load(const char* const* paths, int count, IPlugin** loaded) = 0;
 			virtual void addPlugin(IPlugin* plugin) = 0;
 			virtual void update(float dt, bool paused) = 0;
 			virtual void serialize(OutputBlob& serializer) = 0;
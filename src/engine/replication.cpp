@@ -0,0 +1,874 @@
+#include "replication.h"
+#include "core/math_utils.h"
+#include "core/quat.h"
+#include "core/string.h"
+#include "iplugin.h"
+#include "iproperty_descriptor.h"
+#include "universe/component.h"
+#include "universe/universe.h"
+
+
+namespace Lumix
+{
+
+
+// number of sent / received snapshots kept as possible baselines
+static const int HISTORY_SIZE = 32;
+static const uint32 NO_BASELINE = 0xffff;
+static const Entity MAX_ENTITY = 0x7fffFFFF;
+
+
+struct ReplicationSnapshot
+{
+	explicit ReplicationSnapshot(IAllocator& allocator)
+		: entities(allocator)
+		, masks(allocator)
+		, values(allocator)
+		, sequence(0)
+		, is_valid(false)
+	{
+	}
+
+
+	void clear()
+	{
+		entities.clear();
+		masks.clear();
+		values.clear();
+	}
+
+
+	void add(Entity entity, uint32 mask, const uint32* entity_values, int value_count)
+	{
+		entities.push(entity);
+		masks.push(mask);
+		for (int i = 0; i < value_count; ++i) values.push(entity_values[i]);
+	}
+
+
+	// sorted by entity
+	Array<Entity> entities;
+	Array<uint32> masks;
+	// getValues().size() values per entity
+	Array<uint32> values;
+	uint16 sequence;
+	bool is_valid;
+};
+
+
+namespace
+{
+
+
+struct BitWriter
+{
+	BitWriter(uint8* data, int size)
+		: m_data(data)
+		, m_size_bits(size * 8)
+		, m_position(0)
+		, m_is_overflow(false)
+	{
+	}
+
+
+	void write(uint32 value, int bits)
+	{
+		if (m_position + bits > m_size_bits)
+		{
+			m_is_overflow = true;
+			return;
+		}
+		writeAt(m_position, value, bits);
+		m_position += bits;
+	}
+
+
+	void writeAt(int position, uint32 value, int bits)
+	{
+		for (int i = 0; i < bits; ++i, ++position)
+		{
+			uint8 bit = 1 << (position & 7);
+			if ((value >> i) & 1)
+			{
+				m_data[position >> 3] |= bit;
+			}
+			else
+			{
+				m_data[position >> 3] &= ~bit;
+			}
+		}
+	}
+
+
+	void writeVarUint(uint32 value)
+	{
+		do
+		{
+			write(value & 0x7f, 7);
+			value >>= 7;
+			write(value != 0 ? 1 : 0, 1);
+		} while (value != 0);
+	}
+
+
+	// drops everything written after position
+	void rollback(int position)
+	{
+		m_position = position;
+		m_is_overflow = false;
+	}
+
+
+	int getPosition() const { return m_position; }
+	int getByteSize() const { return (m_position + 7) >> 3; }
+	bool isOverflow() const { return m_is_overflow; }
+
+private:
+	uint8* m_data;
+	int m_size_bits;
+	int m_position;
+	bool m_is_overflow;
+};
+
+
+struct BitReader
+{
+	BitReader(const uint8* data, int size)
+		: m_data(data)
+		, m_size_bits(size * 8)
+		, m_position(0)
+		, m_is_overflow(false)
+	{
+	}
+
+
+	uint32 read(int bits)
+	{
+		if (m_position + bits > m_size_bits)
+		{
+			m_is_overflow = true;
+			return 0;
+		}
+		uint32 value = 0;
+		for (int i = 0; i < bits; ++i, ++m_position)
+		{
+			if (m_data[m_position >> 3] & (1 << (m_position & 7))) value |= 1U << i;
+		}
+		return value;
+	}
+
+
+	uint32 readVarUint()
+	{
+		uint32 value = 0;
+		for (int shift = 0; shift < 32 && !m_is_overflow; shift += 7)
+		{
+			value |= read(7) << shift;
+			if (read(1) == 0) break;
+		}
+		return value;
+	}
+
+
+	bool isOverflow() const { return m_is_overflow; }
+
+private:
+	const uint8* m_data;
+	int m_size_bits;
+	int m_position;
+	bool m_is_overflow;
+};
+
+
+} // anonymous namespace
+
+
+// sequence numbers wrap around
+static bool isNewer(uint16 a, uint16 b)
+{
+	return int16(a - b) > 0;
+}
+
+
+static uint32 quantize(float value, const ReplicationSchema::Value& format)
+{
+	if (format.bits == 32)
+	{
+		uint32 raw;
+		copyMemory(&raw, &value, sizeof(raw));
+		return raw;
+	}
+	float max_quantized = float((1U << format.bits) - 1);
+	float t = Math::clamp((value - format.min) / (format.max - format.min), 0.0f, 1.0f);
+	return uint32(t * max_quantized + 0.5f);
+}
+
+
+static float dequantize(uint32 value, const ReplicationSchema::Value& format)
+{
+	if (format.bits == 32)
+	{
+		float raw;
+		copyMemory(&raw, &value, sizeof(raw));
+		return raw;
+	}
+	float max_quantized = float((1U << format.bits) - 1);
+	return format.min + value / max_quantized * (format.max - format.min);
+}
+
+
+static bool isFloatProperty(IPropertyDescriptor::Type type)
+{
+	return type == IPropertyDescriptor::DECIMAL || type == IPropertyDescriptor::VEC3 ||
+		   type == IPropertyDescriptor::COLOR;
+}
+
+
+static void getScenes(Universe& universe, const ReplicationSchema& schema, Array<IScene*>& scenes)
+{
+	for (uint32 type : schema.getComponentTypes())
+	{
+		IScene* type_scene = nullptr;
+		for (IScene* scene : universe.getScenes())
+		{
+			if (scene->ownComponentType(type)) type_scene = scene;
+		}
+		scenes.push(type_scene);
+	}
+}
+
+
+static ComponentIndex getComponent(IScene* scene, Entity entity, uint32 type)
+{
+	return scene ? scene->getComponent(entity, type) : INVALID_COMPONENT;
+}
+
+
+ReplicationSchema::ReplicationSchema(IAllocator& allocator)
+	: m_component_types(allocator)
+	, m_properties(allocator)
+	, m_values(allocator)
+{
+	Property& position = m_properties.emplace();
+	position.descriptor = nullptr;
+	position.component = -1;
+	addValues(position, 3, -1024, 1024, 16);
+
+	Property& rotation = m_properties.emplace();
+	rotation.descriptor = nullptr;
+	rotation.component = -1;
+	addValues(rotation, 4, -1, 1, 16);
+}
+
+
+bool ReplicationSchema::addProperty(uint32 component_type,
+	const IPropertyDescriptor* descriptor,
+	float min,
+	float max,
+	int bits)
+{
+	ASSERT(descriptor);
+	int count = 1;
+	switch (descriptor->getType())
+	{
+		case IPropertyDescriptor::DECIMAL: break;
+		case IPropertyDescriptor::VEC3:
+		case IPropertyDescriptor::COLOR: count = 3; break;
+		case IPropertyDescriptor::INTEGER:
+		case IPropertyDescriptor::ENUM: bits = 32; break;
+		case IPropertyDescriptor::BOOL:
+			min = 0;
+			max = 1;
+			bits = 1;
+			break;
+		default: return false;
+	}
+	ASSERT((bits > 0 && bits <= 24) || bits == 32);
+	ASSERT(bits == 32 || max > min);
+
+	int component = m_component_types.indexOf(component_type);
+	if (component < 0)
+	{
+		if (m_component_types.size() == MAX_COMPONENT_TYPES) return false;
+		component = m_component_types.size();
+		m_component_types.push(component_type);
+	}
+
+	Property& property = m_properties.emplace();
+	property.descriptor = descriptor;
+	property.component = component;
+	addValues(property, count, min, max, bits);
+	return true;
+}
+
+
+void ReplicationSchema::setPositionQuantization(const Vec3& min, const Vec3& max, int bits)
+{
+	ASSERT(bits > 0 && bits <= 24);
+	for (int i = 0; i < 3; ++i)
+	{
+		Value& value = m_values[m_properties[0].first_value + i];
+		value.min = (&min.x)[i];
+		value.max = (&max.x)[i];
+		value.bits = bits;
+	}
+}
+
+
+void ReplicationSchema::addValues(Property& property, int count, float min, float max, int bits)
+{
+	property.first_value = m_values.size();
+	property.value_count = count;
+	for (int i = 0; i < count; ++i)
+	{
+		Value& value = m_values.emplace();
+		value.min = min;
+		value.max = max;
+		value.bits = bits;
+	}
+}
+
+
+struct ReplicationServer::Client
+{
+	explicit Client(IAllocator& allocator)
+		: allocator(allocator)
+		, view_position(0, 0, 0)
+		, view_radius(0)
+		, next_sequence(0)
+		, acked_sequence(-1)
+	{
+		for (auto& snapshot : history)
+		{
+			snapshot = LUMIX_NEW(allocator, ReplicationSnapshot)(allocator);
+		}
+	}
+
+
+	~Client()
+	{
+		for (auto* snapshot : history) LUMIX_DELETE(allocator, snapshot);
+	}
+
+
+	const ReplicationSnapshot* getBaseline() const
+	{
+		if (acked_sequence < 0) return nullptr;
+		const ReplicationSnapshot* snapshot = history[acked_sequence % HISTORY_SIZE];
+		return snapshot->is_valid && snapshot->sequence == acked_sequence ? snapshot : nullptr;
+	}
+
+
+	IAllocator& allocator;
+	ReplicationSnapshot* history[HISTORY_SIZE];
+	Vec3 view_position;
+	float view_radius;
+	uint16 next_sequence;
+	int acked_sequence;
+};
+
+
+ReplicationServer::ReplicationServer(Universe& universe,
+	const ReplicationSchema& schema,
+	IAllocator& allocator)
+	: m_allocator(allocator)
+	, m_universe(universe)
+	, m_schema(schema)
+	, m_scenes(allocator)
+	, m_clients(allocator)
+	, m_property_blob(allocator)
+{
+	m_current = LUMIX_NEW(allocator, ReplicationSnapshot)(allocator);
+	getScenes(universe, schema, m_scenes);
+}
+
+
+ReplicationServer::~ReplicationServer()
+{
+	for (Client* client : m_clients) LUMIX_DELETE(m_allocator, client);
+	LUMIX_DELETE(m_allocator, m_current);
+}
+
+
+int ReplicationServer::addClient()
+{
+	Client* client = LUMIX_NEW(m_allocator, Client)(m_allocator);
+	for (int i = 0; i < m_clients.size(); ++i)
+	{
+		if (!m_clients[i])
+		{
+			m_clients[i] = client;
+			return i;
+		}
+	}
+	m_clients.push(client);
+	return m_clients.size() - 1;
+}
+
+
+void ReplicationServer::removeClient(int client)
+{
+	LUMIX_DELETE(m_allocator, m_clients[client]);
+	m_clients[client] = nullptr;
+}
+
+
+void ReplicationServer::setClientView(int client, const Vec3& position, float radius)
+{
+	m_clients[client]->view_position = position;
+	m_clients[client]->view_radius = radius;
+}
+
+
+void ReplicationServer::update()
+{
+	const auto& types = m_schema.getComponentTypes();
+	const auto& values = m_schema.getValues();
+	m_current->clear();
+	for (Entity entity = m_universe.getFirstEntity(); entity != INVALID_ENTITY;
+		 entity = m_universe.getNextEntity(entity))
+	{
+		uint32 mask = 0;
+		for (int i = 0; i < types.size(); ++i)
+		{
+			if (getComponent(m_scenes[i], entity, types[i]) != INVALID_COMPONENT) mask |= 1 << i;
+		}
+		if (mask == 0) continue;
+
+		m_current->entities.push(entity);
+		m_current->masks.push(mask);
+		int first_value = m_current->values.size();
+		m_current->values.resize(first_value + values.size());
+		uint32* entity_values = &m_current->values[first_value];
+
+		Vec3 pos = m_universe.getPosition(entity);
+		Quat rot = m_universe.getRotation(entity);
+		for (int i = 0; i < 3; ++i) entity_values[i] = quantize((&pos.x)[i], values[i]);
+		for (int i = 0; i < 4; ++i) entity_values[3 + i] = quantize((&rot.x)[i], values[3 + i]);
+
+		for (const auto& property : m_schema.getProperties())
+		{
+			if (!property.descriptor) continue;
+			uint32* property_values = entity_values + property.first_value;
+			for (int i = 0; i < property.value_count; ++i) property_values[i] = 0;
+			if ((mask & (1 << property.component)) == 0) continue;
+
+			IScene* scene = m_scenes[property.component];
+			uint32 type = types[property.component];
+			ComponentUID cmp(entity, type, scene, scene->getComponent(entity, type));
+			m_property_blob.clear();
+			property.descriptor->get(cmp, -1, m_property_blob);
+			InputBlob blob(m_property_blob);
+			IPropertyDescriptor::Type property_type = property.descriptor->getType();
+			for (int i = 0; i < property.value_count; ++i)
+			{
+				const auto& format = values[property.first_value + i];
+				if (isFloatProperty(property_type))
+				{
+					property_values[i] = quantize(blob.read<float>(), format);
+				}
+				else if (property_type == IPropertyDescriptor::BOOL)
+				{
+					property_values[i] = blob.read<uint8>() != 0 ? 1 : 0;
+				}
+				else
+				{
+					property_values[i] = (uint32)blob.read<int32>();
+				}
+			}
+		}
+	}
+}
+
+
+static void writeEntity(BitWriter& writer,
+	const ReplicationSchema& schema,
+	uint32 delta,
+	uint32 mask,
+	const uint32* values,
+	uint32 base_mask,
+	const uint32* base_values)
+{
+	writer.writeVarUint(delta);
+	writer.write(0, 1);
+	writer.write(mask != base_mask ? 1 : 0, 1);
+	if (mask != base_mask) writer.write(mask, schema.getComponentTypes().size());
+
+	const auto& formats = schema.getValues();
+	for (const auto& property : schema.getProperties())
+	{
+		if (property.component >= 0 && (mask & (1 << property.component)) == 0) continue;
+		for (int i = property.first_value; i < property.first_value + property.value_count; ++i)
+		{
+			uint32 base_value = base_values ? base_values[i] : 0;
+			writer.write(values[i] != base_value ? 1 : 0, 1);
+			if (values[i] != base_value) writer.write(values[i], formats[i].bits);
+		}
+	}
+}
+
+
+void ReplicationServer::writePacket(int client_idx, OutputBlob& packet)
+{
+	Client& client = *m_clients[client_idx];
+	int value_count = m_schema.getValues().size();
+	ReplicationSnapshot& sent = *client.history[client.next_sequence % HISTORY_SIZE];
+	const ReplicationSnapshot* baseline = client.getBaseline();
+	// the client did not acknowledge anything for a whole history, start over
+	if (baseline == &sent) baseline = nullptr;
+	sent.clear();
+	sent.sequence = client.next_sequence;
+	sent.is_valid = true;
+	++client.next_sequence;
+
+	uint8 data[MAX_PACKET_SIZE];
+	BitWriter writer(data, sizeof(data));
+	writer.write(sent.sequence, 16);
+	writer.write(baseline ? baseline->sequence : NO_BASELINE, 16);
+	int count_position = writer.getPosition();
+	writer.write(0, 16);
+
+	// both entity lists are sorted, entities which did not change since the baseline are not
+	// written at all, the client keeps them
+	const ReplicationSnapshot& current = *m_current;
+	float radius_squared = client.view_radius * client.view_radius;
+	int record_count = 0;
+	Entity last_written = -1;
+	bool is_full = false;
+	int current_idx = 0;
+	int base_idx = 0;
+	int base_count = baseline ? baseline->entities.size() : 0;
+	for (;;)
+	{
+		while (current_idx < current.entities.size() && client.view_radius > 0 &&
+			   (m_universe.getPosition(current.entities[current_idx]) - client.view_position)
+					   .squaredLength() > radius_squared)
+		{
+			++current_idx;
+		}
+		Entity current_entity =
+			current_idx < current.entities.size() ? current.entities[current_idx] : MAX_ENTITY;
+		Entity base_entity = base_idx < base_count ? baseline->entities[base_idx] : MAX_ENTITY;
+		Entity entity = Math::minValue(current_entity, base_entity);
+		if (entity == MAX_ENTITY) break;
+
+		uint32 base_mask = entity == base_entity ? baseline->masks[base_idx] : 0;
+		const uint32* base_values =
+			entity == base_entity ? &baseline->values[base_idx * value_count] : nullptr;
+		if (entity == base_entity) ++base_idx;
+
+		bool is_written = false;
+		int position = writer.getPosition();
+		if (entity == current_entity)
+		{
+			uint32 mask = current.masks[current_idx];
+			const uint32* values = &current.values[current_idx * value_count];
+			++current_idx;
+
+			bool is_same = base_values && mask == base_mask &&
+						   compareMemory(values, base_values, value_count * sizeof(uint32)) == 0;
+			if (is_same)
+			{
+				sent.add(entity, mask, values, value_count);
+				continue;
+			}
+			if (!is_full)
+			{
+				writeEntity(writer, m_schema, entity - last_written - 1, mask, values, base_mask,
+					base_values);
+				is_written = !writer.isOverflow();
+			}
+			if (is_written) sent.add(entity, mask, values, value_count);
+		}
+		else if (!is_full)
+		{
+			// left the view or was destroyed
+			writer.writeVarUint(entity - last_written - 1);
+			writer.write(1, 1);
+			is_written = !writer.isOverflow();
+		}
+
+		if (is_written)
+		{
+			++record_count;
+			last_written = entity;
+			continue;
+		}
+		if (!is_full)
+		{
+			writer.rollback(position);
+			is_full = true;
+		}
+		// not sent, the client still has the baseline state
+		if (base_values) sent.add(entity, base_mask, base_values, value_count);
+	}
+
+	writer.writeAt(count_position, record_count, 16);
+	packet.write(data, writer.getByteSize());
+}
+
+
+void ReplicationServer::readAck(int client_idx, InputBlob& ack)
+{
+	Client& client = *m_clients[client_idx];
+	uint8 has_sequence = 0;
+	uint16 sequence = 0;
+	if (!ack.read(&has_sequence, sizeof(has_sequence)) || !has_sequence) return;
+	if (!ack.read(&sequence, sizeof(sequence))) return;
+	// acks of packets which were not sent yet can not be trusted
+	if (!isNewer(client.next_sequence, sequence)) return;
+	if (client.acked_sequence < 0 || isNewer(sequence, (uint16)client.acked_sequence))
+	{
+		client.acked_sequence = sequence;
+	}
+}
+
+
+ReplicationClient::ReplicationClient(Universe& universe,
+	const ReplicationSchema& schema,
+	IAllocator& allocator)
+	: m_allocator(allocator)
+	, m_universe(universe)
+	, m_schema(schema)
+	, m_scenes(allocator)
+	, m_history(allocator)
+	, m_entity_map(allocator)
+	, m_entity_left(allocator)
+	, m_last_sequence(-1)
+{
+	getScenes(universe, schema, m_scenes);
+	for (int i = 0; i < HISTORY_SIZE; ++i)
+	{
+		m_history.push(LUMIX_NEW(allocator, ReplicationSnapshot)(allocator));
+	}
+}
+
+
+ReplicationClient::~ReplicationClient()
+{
+	for (auto* snapshot : m_history) LUMIX_DELETE(m_allocator, snapshot);
+}
+
+
+static void readEntity(BitReader& reader,
+	const ReplicationSchema& schema,
+	ReplicationSnapshot& snapshot,
+	uint32 base_mask,
+	const uint32* base_values)
+{
+	const auto& formats = schema.getValues();
+	uint32 mask = base_mask;
+	if (reader.read(1)) mask = reader.read(schema.getComponentTypes().size());
+	snapshot.masks.push(mask);
+	for (const auto& property : schema.getProperties())
+	{
+		bool is_present = property.component < 0 || (mask & (1 << property.component)) != 0;
+		for (int i = property.first_value; i < property.first_value + property.value_count; ++i)
+		{
+			uint32 value = 0;
+			if (is_present)
+			{
+				value = base_values ? base_values[i] : 0;
+				if (reader.read(1)) value = reader.read(formats[i].bits);
+			}
+			snapshot.values.push(value);
+		}
+	}
+}
+
+
+bool ReplicationClient::readPacket(InputBlob& packet)
+{
+	BitReader reader((const uint8*)packet.getData(), packet.getSize());
+	uint16 sequence = (uint16)reader.read(16);
+	uint32 base_sequence = reader.read(16);
+	int record_count = reader.read(16);
+	if (reader.isOverflow()) return false;
+	if (m_last_sequence >= 0 && !isNewer(sequence, (uint16)m_last_sequence)) return false;
+
+	const ReplicationSnapshot* baseline = nullptr;
+	if (base_sequence != NO_BASELINE)
+	{
+		baseline = m_history[base_sequence % HISTORY_SIZE];
+		if (!baseline->is_valid || baseline->sequence != base_sequence) return false;
+	}
+	ReplicationSnapshot& snapshot = *m_history[sequence % HISTORY_SIZE];
+	if (&snapshot == baseline) return false;
+	snapshot.clear();
+	snapshot.is_valid = false;
+
+	// decode everything first, a malformed packet must not be applied halfway
+	struct Record
+	{
+		Entity entity;
+		int index; // in snapshot, -1 for removed entities
+		int base_index;
+	};
+	int value_count = m_schema.getValues().size();
+	int base_count = baseline ? baseline->entities.size() : 0;
+	int base_idx = 0;
+	Entity entity = -1;
+	Array<Record> records(m_allocator);
+	for (int i = 0; i < record_count; ++i)
+	{
+		entity += reader.readVarUint() + 1;
+		bool is_removed = reader.read(1) != 0;
+		if (reader.isOverflow() || entity < 0) return false;
+		// entities which are not in the packet did not change
+		while (base_idx < base_count && baseline->entities[base_idx] < entity)
+		{
+			snapshot.add(baseline->entities[base_idx],
+				baseline->masks[base_idx],
+				&baseline->values[base_idx * value_count],
+				value_count);
+			++base_idx;
+		}
+		Record& record = records.emplace();
+		record.entity = entity;
+		record.index = -1;
+		record.base_index = -1;
+		if (base_idx < base_count && baseline->entities[base_idx] == entity)
+		{
+			record.base_index = base_idx;
+			++base_idx;
+		}
+		if (is_removed) continue;
+
+		record.index = snapshot.entities.size();
+		snapshot.entities.push(entity);
+		uint32 base_mask = record.base_index >= 0 ? baseline->masks[record.base_index] : 0;
+		const uint32* base_values =
+			record.base_index >= 0 ? &baseline->values[record.base_index * value_count] : nullptr;
+		readEntity(reader, m_schema, snapshot, base_mask, base_values);
+	}
+	if (reader.isOverflow()) return false;
+	for (; base_idx < base_count; ++base_idx)
+	{
+		snapshot.add(baseline->entities[base_idx],
+			baseline->masks[base_idx],
+			&baseline->values[base_idx * value_count],
+			value_count);
+	}
+	snapshot.sequence = sequence;
+	snapshot.is_valid = true;
+	m_last_sequence = sequence;
+
+	const auto& types = m_schema.getComponentTypes();
+	const auto& formats = m_schema.getValues();
+	for (const Record& record : records)
+	{
+		if (record.index < 0)
+		{
+			auto iter = m_entity_map.find(record.entity);
+			if (iter != m_entity_map.end()) m_entity_left.invoke(iter.value());
+			continue;
+		}
+
+		uint32 mask = snapshot.masks[record.index];
+		uint32 base_mask = record.base_index >= 0 ? baseline->masks[record.base_index] : 0;
+		const uint32* values = &snapshot.values[record.index * value_count];
+		const uint32* base_values =
+			record.base_index >= 0 ? &baseline->values[record.base_index * value_count] : nullptr;
+		Entity local_entity = getLocalEntity(record.entity, mask);
+
+		for (const auto& property : m_schema.getProperties())
+		{
+			uint32 component_bit = property.component >= 0 ? 1 << property.component : 0;
+			if (component_bit && (mask & component_bit) == 0) continue;
+			// added components get all their properties, even those equal to the defaults
+			bool is_changed = !base_values || (component_bit && (base_mask & component_bit) == 0);
+			int end = property.first_value + property.value_count;
+			for (int i = property.first_value; i < end && !is_changed; ++i)
+			{
+				is_changed = values[i] != base_values[i];
+			}
+			if (!is_changed) continue;
+
+			float floats[4];
+			for (int i = 0; i < property.value_count; ++i)
+			{
+				floats[i] = dequantize(values[property.first_value + i],
+					formats[property.first_value + i]);
+			}
+			if (!property.descriptor)
+			{
+				if (property.first_value == 0)
+				{
+					m_universe.setPosition(local_entity, floats[0], floats[1], floats[2]);
+				}
+				else
+				{
+					Quat rot(floats[0], floats[1], floats[2], floats[3]);
+					rot.normalize();
+					m_universe.setRotation(local_entity, rot);
+				}
+				continue;
+			}
+
+			IScene* scene = m_scenes[property.component];
+			uint32 type = types[property.component];
+			ComponentUID cmp(local_entity, type, scene, scene->getComponent(local_entity, type));
+			uint8 data[sizeof(floats)];
+			int size = sizeof(int32);
+			IPropertyDescriptor::Type property_type = property.descriptor->getType();
+			if (isFloatProperty(property_type))
+			{
+				size = property.value_count * sizeof(float);
+				copyMemory(data, floats, size);
+			}
+			else if (property_type == IPropertyDescriptor::BOOL)
+			{
+				size = sizeof(bool);
+				data[0] = values[property.first_value] != 0 ? 1 : 0;
+			}
+			else
+			{
+				copyMemory(data, &values[property.first_value], size);
+			}
+			InputBlob blob(data, size);
+			property.descriptor->set(cmp, -1, blob);
+		}
+	}
+	return true;
+}
+
+
+void ReplicationClient::writeAck(OutputBlob& ack)
+{
+	uint8 has_sequence = m_last_sequence >= 0 ? 1 : 0;
+	ack.write(has_sequence);
+	ack.write((uint16)m_last_sequence);
+}
+
+
+Entity ReplicationClient::getLocalEntity(Entity server_entity, uint32 component_mask)
+{
+	Entity entity;
+	auto iter = m_entity_map.find(server_entity);
+	if (iter != m_entity_map.end())
+	{
+		entity = iter.value();
+	}
+	else
+	{
+		// loaded from the same universe as on the server
+		entity = m_universe.hasEntity(server_entity)
+					 ? server_entity
+					 : m_universe.createEntity(Vec3(0, 0, 0), Quat(0, 0, 0, 1));
+		m_entity_map.insert(server_entity, entity);
+	}
+
+	const auto& types = m_schema.getComponentTypes();
+	for (int i = 0; i < types.size(); ++i)
+	{
+		if ((component_mask & (1 << i)) == 0 || !m_scenes[i]) continue;
+		if (m_scenes[i]->getComponent(entity, types[i]) == INVALID_COMPONENT)
+		{
+			m_scenes[i]->createComponent(types[i], entity);
+		}
+	}
+	return entity;
+}
+
+
+} // namespace Lumix
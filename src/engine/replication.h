@@ -0,0 +1,145 @@
+#pragma once
+
+
+#include "lumix.h"
+#include "core/array.h"
+#include "core/blob.h"
+#include "core/delegate_list.h"
+#include "core/flat_hash_map.h"
+#include "core/vec.h"
+
+
+namespace Lumix
+{
+
+
+class IPropertyDescriptor;
+class IScene;
+class Universe;
+struct ReplicationSnapshot;
+
+
+// What the server replicates to its clients, both have to add the same properties in the same
+// order. Entities with a component of any added type are replicated with their position and
+// rotation, other entities are not.
+class LUMIX_ENGINE_API ReplicationSchema
+{
+public:
+	static const int MAX_COMPONENT_TYPES = 32;
+
+	// one quantized value of an entity
+	struct Value
+	{
+		float min;
+		float max;
+		// 32 bits are sent as they are, without quantization
+		int bits;
+	};
+
+	struct Property
+	{
+		// null for the position and the rotation
+		const IPropertyDescriptor* descriptor;
+		// index in getComponentTypes(), -1 for the position and the rotation
+		int component;
+		int first_value;
+		int value_count;
+	};
+
+public:
+	explicit ReplicationSchema(IAllocator& allocator);
+
+	// decimal, vec3 and color properties are quantized to bits in [min, max], integer, enum and
+	// bool ones are sent whole; false for other types
+	bool addProperty(uint32 component_type,
+		const IPropertyDescriptor* descriptor,
+		float min,
+		float max,
+		int bits);
+	// the default is 16 bits in [-1024, 1024]
+	void setPositionQuantization(const Vec3& min, const Vec3& max, int bits);
+
+	const Array<uint32>& getComponentTypes() const { return m_component_types; }
+	// the position and the rotation are the first two properties
+	const Array<Property>& getProperties() const { return m_properties; }
+	const Array<Value>& getValues() const { return m_values; }
+
+private:
+	void addValues(Property& property, int count, float min, float max, int bits);
+
+private:
+	Array<uint32> m_component_types;
+	Array<Property> m_properties;
+	Array<Value> m_values;
+};
+
+
+// Server side of the replication, packets carry the state of all entities close enough to the
+// client as a delta against the last snapshot the client acknowledged. The caller sends the
+// packets, e.g. with Net::UDPSocket; lost packets only make the next deltas bigger.
+class LUMIX_ENGINE_API ReplicationServer
+{
+public:
+	static const int MAX_PACKET_SIZE = 1200;
+
+public:
+	ReplicationServer(Universe& universe, const ReplicationSchema& schema, IAllocator& allocator);
+	~ReplicationServer();
+
+	int addClient();
+	void removeClient(int client);
+	// entities further than radius from the position are not sent, radius <= 0 sends all
+	void setClientView(int client, const Vec3& position, float radius);
+
+	// takes a snapshot of the universe, once per tick before the packets are written
+	void update();
+	// entities which would make the packet bigger than MAX_PACKET_SIZE wait for the next one
+	void writePacket(int client, OutputBlob& packet);
+	void readAck(int client, InputBlob& ack);
+
+private:
+	struct Client;
+
+private:
+	IAllocator& m_allocator;
+	Universe& m_universe;
+	const ReplicationSchema& m_schema;
+	Array<IScene*> m_scenes;
+	Array<Client*> m_clients;
+	ReplicationSnapshot* m_current;
+	OutputBlob m_property_blob;
+};
+
+
+// Client side of the replication. The client is expected to load the same universe as the
+// server, so the entities of the server exist on it; entities created on the server later are
+// created on the client together with their replicated components.
+class LUMIX_ENGINE_API ReplicationClient
+{
+public:
+	ReplicationClient(Universe& universe, const ReplicationSchema& schema, IAllocator& allocator);
+	~ReplicationClient();
+
+	// false for packets which are older than the last one or whose baseline was not received
+	bool readPacket(InputBlob& packet);
+	// acknowledges the last applied packet, the server uses it as the baseline of the next ones
+	void writeAck(OutputBlob& ack);
+	// entities the server stopped sending, e.g. because they are not close to the client anymore
+	DelegateList<void(Entity)>& entityLeft() { return m_entity_left; }
+
+private:
+	Entity getLocalEntity(Entity server_entity, uint32 component_mask);
+
+private:
+	IAllocator& m_allocator;
+	Universe& m_universe;
+	const ReplicationSchema& m_schema;
+	Array<IScene*> m_scenes;
+	Array<ReplicationSnapshot*> m_history;
+	FlatHashMap<Entity, Entity> m_entity_map;
+	DelegateList<void(Entity)> m_entity_left;
+	int m_last_sequence;
+};
+
+
+} // namespace Lumix
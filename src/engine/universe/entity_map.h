@@ -0,0 +1,65 @@
+#pragma once
+
+
+#include "lumix.h"
+#include "core/array.h"
+
+
+namespace Lumix
+{
+
+
+// entity which can be kept across frames, see Universe::getHandle and Universe::isValid,
+// slots of destroyed entities are reused, so bare Entity can point to a different entity later
+struct EntityHandle
+{
+	Entity entity;
+	uint32 generation;
+};
+
+
+// Maps entities to component indices in O(1). Entities are dense small integers,
+// so the map is a plain array indexed by entity; scenes keep one map per component type
+// next to their component arrays instead of searching those arrays.
+class EntityMap
+{
+public:
+	explicit EntityMap(IAllocator& allocator)
+		: m_indices(allocator)
+	{
+	}
+
+
+	void insert(Entity entity, ComponentIndex cmp)
+	{
+		ASSERT(entity >= 0);
+		int old_size = m_indices.size();
+		if (entity >= old_size)
+		{
+			m_indices.resize(entity + 1);
+			for (int i = old_size; i < m_indices.size(); ++i) m_indices[i] = INVALID_COMPONENT;
+		}
+		m_indices[entity] = cmp;
+	}
+
+
+	void erase(Entity entity)
+	{
+		if (entity >= 0 && entity < m_indices.size()) m_indices[entity] = INVALID_COMPONENT;
+	}
+
+
+	ComponentIndex get(Entity entity) const
+	{
+		return entity >= 0 && entity < m_indices.size() ? m_indices[entity] : INVALID_COMPONENT;
+	}
+
+
+	void clear() { m_indices.clear(); }
+
+private:
+	Array<ComponentIndex> m_indices;
+};
+
+
+} // namespace Lumix
@@ -3,6 +3,8 @@
 #include "core/crc32.h"
 #include "core/hash_map.h"
 #include "core/json_serializer.h"
+#include "core/mtjd/parallel_for.h"
+#include "core/profiler.h"
 #include "engine/engine.h"
 #include "universe.h"
 
@@ -12,6 +14,7 @@ namespace Lumix
 
 
 static const Lumix::uint32 HIERARCHY_HASH = Lumix::crc32("hierarchy");
+static const int MIN_CHILDREN_PER_JOB = 256;
 
 
 class HierarchyImpl : public Hierarchy
@@ -19,13 +22,30 @@ class HierarchyImpl : public Hierarchy
 private:
 	typedef PODHashMap<Entity, Entity> Parents;
 
+	struct LevelItem
+	{
+		Entity parent;
+		const Matrix* local_matrix;
+	};
+
 public:
-	HierarchyImpl(IPlugin& system, Universe& universe, IAllocator& allocator)
+	HierarchyImpl(IPlugin& system,
+		Universe& universe,
+		MTJD::Manager& mtjd_manager,
+		IAllocator& allocator)
 		: m_universe(universe)
 		, m_parents(allocator)
 		, m_children(allocator)
 		, m_allocator(allocator)
 		, m_system(system)
+		, m_mtjd_manager(mtjd_manager)
+		, m_dirty_bits(allocator)
+		, m_dirty(allocator)
+		, m_level_parents(allocator)
+		, m_level_entities(allocator)
+		, m_level_positions(allocator)
+		, m_level_rotations(allocator)
+		, m_next_parents(allocator)
 	{
 		m_is_processing = false;
 		universe.entityDestroyed().bind<HierarchyImpl, &HierarchyImpl::onEntityDestroyed>(this);
@@ -107,25 +127,123 @@ public:
 	}
 
 
-	void onEntityMoved(Entity entity)
+	bool isDirty(Entity entity) const
+	{
+		int word = entity >> 5;
+		return word < m_dirty_bits.size() && (m_dirty_bits[word] & (1U << (entity & 31))) != 0;
+	}
+
+
+	bool hasDirtyAncestor(Entity entity) const
+	{
+		for (;;)
+		{
+			auto iter = m_parents.find(entity);
+			if (!iter.isValid() || iter.value() == INVALID_ENTITY) return false;
+			entity = iter.value();
+			if (isDirty(entity)) return true;
+		}
+	}
+
+
+	void markDirty(Entity entity)
+	{
+		if (isDirty(entity)) return;
+		int word = entity >> 5;
+		while (m_dirty_bits.size() <= word) m_dirty_bits.push(0);
+		m_dirty_bits[word] |= 1U << (entity & 31);
+		m_dirty.push(entity);
+	}
+
+
+	void clearDirty()
+	{
+		for (Entity entity : m_dirty)
+		{
+			m_dirty_bits[entity >> 5] &= ~(1U << (entity & 31));
+		}
+		m_dirty.clear();
+	}
+
+
+	void computeLevel(int from, int to)
 	{
-		bool was_processing = m_is_processing;
+		const LevelItem* LUMIX_RESTRICT items = &m_level_parents[0];
+		Vec3* LUMIX_RESTRICT positions = &m_level_positions[0];
+		Quat* LUMIX_RESTRICT rotations = &m_level_rotations[0];
+		for (int i = from; i < to; ++i)
+		{
+			Matrix mtx = m_universe.getPositionAndRotation(items[i].parent) * *items[i].local_matrix;
+			positions[i] = mtx.getTranslation();
+			mtx.getRotation(rotations[i]);
+		}
+	}
+
+
+	// subtrees of the moved entities are updated breadth first, all children in the same depth
+	// are computed in parallel and written to the universe with one bulk call
+	void updateWorldMatrices() override
+	{
+		if (m_dirty.empty()) return;
+		PROFILE_FUNCTION();
+
+		m_next_parents.clear();
+		for (Entity entity : m_dirty)
+		{
+			// the subtree is recomputed from the topmost moved ancestor anyway
+			if (hasDirtyAncestor(entity)) continue;
+			if (m_children.find(entity).isValid()) m_next_parents.push(entity);
+		}
+		clearDirty();
+
 		m_is_processing = true;
-		Children::iterator iter = m_children.find(entity);
-		if (iter.isValid())
+		while (!m_next_parents.empty())
 		{
-			Matrix parent_matrix = m_universe.getPositionAndRotation(entity);
-			Array<Child>& children = *iter.value();
-			for (int i = 0, c = children.size(); i < c; ++i)
+			m_level_parents.clear();
+			m_level_entities.clear();
+			for (Entity parent : m_next_parents)
 			{
-				m_universe.setMatrix(
-					children[i].m_entity, parent_matrix * children[i].m_local_matrix);
+				Children::iterator iter = m_children.find(parent);
+				if (!iter.isValid()) continue;
+				for (const Child& child : *iter.value())
+				{
+					LevelItem& item = m_level_parents.emplace();
+					item.parent = parent;
+					item.local_matrix = &child.m_local_matrix;
+					m_level_entities.push(child.m_entity);
+				}
+			}
+
+			int count = m_level_entities.size();
+			if (count == 0) break;
+			m_level_positions.resize(count);
+			m_level_rotations.resize(count);
+			MTJD::parallelFor(m_mtjd_manager,
+				0,
+				count,
+				MIN_CHILDREN_PER_JOB,
+				[this](int from, int to) { computeLevel(from, to); });
+			m_universe.setPositionsAndRotations(
+				&m_level_entities[0], &m_level_positions[0], &m_level_rotations[0], count);
+
+			m_next_parents.clear();
+			for (Entity entity : m_level_entities)
+			{
+				if (m_children.find(entity).isValid()) m_next_parents.push(entity);
 			}
 		}
-		m_is_processing = was_processing;
+		m_is_processing = false;
+	}
+
 
+	void onEntityMoved(Entity entity)
+	{
 		if (m_is_processing) return;
 
+		// children follow in updateWorldMatrices, so a parent moved several times in a frame
+		// updates its subtree only once
+		if (m_children.find(entity).isValid()) markDirty(entity);
+
 		Parents::iterator parent_iter = m_parents.find(entity);
 		if (parent_iter.isValid())
 		{
@@ -236,6 +354,7 @@ public:
 
 	void deserialize(InputBlob& serializer, int /*version*/) override
 	{
+		clearDirty();
 		int32 size;
 		serializer.read(size);
 		for (int i = 0; i < size; ++i)
@@ -266,13 +385,21 @@ private:
 	Parents m_parents;
 	Children m_children;
 	IPlugin& m_system;
+	MTJD::Manager& m_mtjd_manager;
 	bool m_is_processing;
+	Array<uint32> m_dirty_bits;
+	Array<Entity> m_dirty;
+	Array<LevelItem> m_level_parents;
+	Array<Entity> m_level_entities;
+	Array<Vec3> m_level_positions;
+	Array<Quat> m_level_rotations;
+	Array<Entity> m_next_parents;
 };
 
 
 IScene* HierarchyPlugin::createScene(Universe& ctx)
 {
-	return Hierarchy::create(*this, ctx, m_allocator);
+	return Hierarchy::create(*this, ctx, m_mtjd_manager, m_allocator);
 }
 
 
@@ -282,9 +409,12 @@ void HierarchyPlugin::destroyScene(IScene* scene)
 }
 
 
-Hierarchy* Hierarchy::create(IPlugin& system, Universe& universe, IAllocator& allocator)
+Hierarchy* Hierarchy::create(IPlugin& system,
+	Universe& universe,
+	MTJD::Manager& mtjd_manager,
+	IAllocator& allocator)
 {
-	return LUMIX_NEW(allocator, HierarchyImpl)(system, universe, allocator);
+	return LUMIX_NEW(allocator, HierarchyImpl)(system, universe, mtjd_manager, allocator);
 }
 
 
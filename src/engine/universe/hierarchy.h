@@ -15,12 +15,20 @@ namespace Lumix
 	class OutputBlob;
 	class Universe;
 	template <typename T> class Array;
+	namespace MTJD
+	{
+	class Manager;
+	}
 
 
 	class HierarchyPlugin : public IPlugin
 	{
 	public:
-		explicit HierarchyPlugin(IAllocator& allocator) : m_allocator(allocator) {}
+		HierarchyPlugin(MTJD::Manager& mtjd_manager, IAllocator& allocator)
+			: m_mtjd_manager(mtjd_manager)
+			, m_allocator(allocator)
+		{
+		}
 
 		bool create() override { return true; }
 		void destroy() override {}
@@ -30,6 +38,7 @@ namespace Lumix
 		void destroyScene(IScene*) override;
 	
 	private:
+		MTJD::Manager& m_mtjd_manager;
 		IAllocator& m_allocator;
 	};
 
@@ -47,7 +56,10 @@ namespace Lumix
 			typedef PODHashMap<int32, Array<Child>*> Children;
 
 		public:
-			static Hierarchy* create(IPlugin& system, Universe& universe, IAllocator& allocator);
+			static Hierarchy* create(IPlugin& system,
+				Universe& universe,
+				MTJD::Manager& mtjd_manager,
+				IAllocator& allocator);
 			static void destroy(Hierarchy* hierarchy);
 
 			virtual ~Hierarchy() {}
@@ -57,6 +69,9 @@ namespace Lumix
 			virtual Entity getParent(ComponentIndex cmp) = 0;
 			virtual Array<Child>* getChildren(Entity parent) = 0;
 			virtual const Children& getAllChildren() const = 0;
+			// children of moved entities are moved here, level by level, called once per frame
+			// by the engine before transform changes are notified
+			virtual void updateWorldMatrices() = 0;
 	};
 
 
@@ -1,6 +1,7 @@
 #include "universe.h"
 #include "core/blob.h"
 #include "core/crc32.h"
+#include "core/math_utils.h"
 #include "core/matrix.h"
 #include "core/json_serializer.h"
 #include "engine/iplugin.h"
@@ -23,18 +24,36 @@ Universe::Universe(IAllocator& allocator)
 	: m_allocator(allocator)
 	, m_name_to_id_map(m_allocator)
 	, m_id_to_name_map(m_allocator)
-	, m_transformations(m_allocator)
+	, m_entities(m_allocator)
+	, m_positions(m_allocator)
+	, m_rotations(m_allocator)
+	, m_scales(m_allocator)
 	, m_component_added(m_allocator)
 	, m_component_destroyed(m_allocator)
 	, m_entity_created(m_allocator)
 	, m_entity_destroyed(m_allocator)
+	, m_entities_created(m_allocator)
+	, m_entities_destroyed(m_allocator)
 	, m_entity_moved(m_allocator)
+	, m_entities_moved(m_allocator)
+	, m_transform_events(m_allocator)
+	, m_transformed_bits(m_allocator)
+	, m_transformed(m_allocator)
+	, m_notified_transformed(m_allocator)
 	, m_entity_map(m_allocator)
+	, m_generations(m_allocator)
+	, m_batched_components(m_allocator)
+	, m_batch_mutex(false)
+	, m_is_batching_components(false)
 	, m_first_free_slot(-1)
 	, m_scenes(m_allocator)
 {
-	m_transformations.reserve(RESERVED_ENTITIES_COUNT);
+	m_entities.reserve(RESERVED_ENTITIES_COUNT);
+	m_positions.reserve(RESERVED_ENTITIES_COUNT);
+	m_rotations.reserve(RESERVED_ENTITIES_COUNT);
+	m_scales.reserve(RESERVED_ENTITIES_COUNT);
 	m_entity_map.reserve(RESERVED_ENTITIES_COUNT);
+	m_generations.reserve(RESERVED_ENTITIES_COUNT);
 }
 
 
@@ -63,29 +82,75 @@ void Universe::addScene(IScene* scene)
 }
 
 
+void Universe::onEntityTransformed(Entity entity, uint8 flags)
+{
+	m_transform_events.push(entity, flags);
+	int word = entity >> 5;
+	uint32 mask = 1U << (entity & 31);
+	if (word >= m_transformed_bits.size())
+	{
+		int old_size = m_transformed_bits.size();
+		m_transformed_bits.resize(Math::maxValue(word + 1, m_entity_map.size() >> 5));
+		for (int i = old_size; i < m_transformed_bits.size(); ++i) m_transformed_bits[i] = 0;
+	}
+	if ((m_transformed_bits[word] & mask) == 0)
+	{
+		m_transformed_bits[word] |= mask;
+		m_transformed.push(entity);
+	}
+
+	m_entity_moved.invoke(entity);
+}
+
+
+void Universe::onEntitiesTransformed(const Entity* entities, int count, uint8 flags)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		onEntityTransformed(entities[i], flags);
+	}
+}
+
+
+void Universe::notifyTransformChanges()
+{
+	m_transform_events.compact();
+	if (m_transformed.empty()) return;
+
+	// listeners can move entities, those are notified next time
+	m_notified_transformed.swap(m_transformed);
+	for (Entity entity : m_notified_transformed)
+	{
+		m_transformed_bits[entity >> 5] &= ~(1U << (entity & 31));
+	}
+	m_entities_moved.invoke(&m_notified_transformed[0], m_notified_transformed.size());
+	m_notified_transformed.clear();
+}
+
+
 const Vec3& Universe::getPosition(Entity entity) const
 {
-	return m_transformations[m_entity_map[entity]].position;
+	return m_positions[m_entity_map[entity]];
 }
 
 
 const Quat& Universe::getRotation(Entity entity) const
 {
-	return m_transformations[m_entity_map[entity]].rotation;
+	return m_rotations[m_entity_map[entity]];
 }
 
 
 void Universe::setRotation(Entity entity, const Quat& rot)
 {
-	m_transformations[m_entity_map[entity]].rotation = rot;
-	entityTransformed().invoke(entity);
+	m_rotations[m_entity_map[entity]] = rot;
+	onEntityTransformed(entity, ROTATION);
 }
 
 
 void Universe::setRotation(Entity entity, float x, float y, float z, float w)
 {
-	m_transformations[m_entity_map[entity]].rotation.set(x, y, z, w);
-	entityTransformed().invoke(entity);
+	m_rotations[m_entity_map[entity]].set(x, y, z, w);
+	onEntityTransformed(entity, ROTATION);
 }
 
 
@@ -95,22 +160,39 @@ bool Universe::hasEntity(Entity entity) const
 }
 
 
+EntityHandle Universe::getHandle(Entity entity) const
+{
+	ASSERT(hasEntity(entity));
+	EntityHandle handle;
+	handle.entity = entity;
+	handle.generation = m_generations[entity];
+	return handle;
+}
+
+
+bool Universe::isValid(const EntityHandle& handle) const
+{
+	return hasEntity(handle.entity) && m_generations[handle.entity] == handle.generation;
+}
+
+
 void Universe::setMatrix(Entity entity, const Matrix& mtx)
 {
 	Quat rot;
 	mtx.getRotation(rot);
-	m_transformations[m_entity_map[entity]].position = mtx.getTranslation();
-	m_transformations[m_entity_map[entity]].rotation = rot;
-	entityTransformed().invoke(entity);
+	int idx = m_entity_map[entity];
+	m_positions[idx] = mtx.getTranslation();
+	m_rotations[idx] = rot;
+	onEntityTransformed(entity, POSITION | ROTATION);
 }
 
 
 Matrix Universe::getPositionAndRotation(Entity entity) const
 {
 	Matrix mtx;
-	auto& transform = m_transformations[m_entity_map[entity]];
-	transform.rotation.toMatrix(mtx);
-	mtx.setTranslation(transform.position);
+	int idx = m_entity_map[entity];
+	m_rotations[idx].toMatrix(mtx);
+	mtx.setTranslation(m_positions[idx]);
 	return mtx;
 }
 
@@ -118,27 +200,93 @@ Matrix Universe::getPositionAndRotation(Entity entity) const
 Matrix Universe::getMatrix(Entity entity) const
 {
 	Matrix mtx;
-	auto& transform = m_transformations[m_entity_map[entity]];
-	transform.rotation.toMatrix(mtx);
-	mtx.setTranslation(transform.position);
-	mtx.multiply3x3(transform.scale);
+	int idx = m_entity_map[entity];
+	m_rotations[idx].toMatrix(mtx);
+	mtx.setTranslation(m_positions[idx]);
+	mtx.multiply3x3(m_scales[idx]);
 	return mtx;
 }
 
 
 void Universe::setPosition(Entity entity, float x, float y, float z)
 {
-	auto& transform = m_transformations[m_entity_map[entity]];
-	transform.position.set(x, y, z);
-	entityTransformed().invoke(entity);
+	m_positions[m_entity_map[entity]].set(x, y, z);
+	onEntityTransformed(entity, POSITION);
 }
 
 
 void Universe::setPosition(Entity entity, const Vec3& pos)
 {
-	auto& transform = m_transformations[m_entity_map[entity]];
-	transform.position = pos;
-	entityTransformed().invoke(entity);
+	m_positions[m_entity_map[entity]] = pos;
+	onEntityTransformed(entity, POSITION);
+}
+
+
+void Universe::setPositionAndRotation(Entity entity, const Vec3& pos, const Quat& rot)
+{
+	int idx = m_entity_map[entity];
+	m_positions[idx] = pos;
+	m_rotations[idx] = rot;
+	onEntityTransformed(entity, POSITION | ROTATION);
+}
+
+
+void Universe::setPositions(const Entity* entities, const Vec3* positions, int count)
+{
+	if (count == 0) return;
+	const int* LUMIX_RESTRICT entity_map = &m_entity_map[0];
+	Vec3* LUMIX_RESTRICT dst = &m_positions[0];
+	for (int i = 0; i < count; ++i)
+	{
+		dst[entity_map[entities[i]]] = positions[i];
+	}
+	onEntitiesTransformed(entities, count, POSITION);
+}
+
+
+void Universe::setPositionsAndRotations(const Entity* entities,
+	const Vec3* positions,
+	const Quat* rotations,
+	int count)
+{
+	if (count == 0) return;
+	const int* LUMIX_RESTRICT entity_map = &m_entity_map[0];
+	Vec3* LUMIX_RESTRICT dst_positions = &m_positions[0];
+	Quat* LUMIX_RESTRICT dst_rotations = &m_rotations[0];
+	for (int i = 0; i < count; ++i)
+	{
+		int idx = entity_map[entities[i]];
+		dst_positions[idx] = positions[i];
+		dst_rotations[idx] = rotations[i];
+	}
+	onEntitiesTransformed(entities, count, POSITION | ROTATION);
+}
+
+
+void Universe::getPositions(const Entity* entities, Vec3* positions, int count) const
+{
+	if (count == 0) return;
+	const int* LUMIX_RESTRICT entity_map = &m_entity_map[0];
+	const Vec3* LUMIX_RESTRICT src = &m_positions[0];
+	for (int i = 0; i < count; ++i)
+	{
+		positions[i] = src[entity_map[entities[i]]];
+	}
+}
+
+
+void Universe::getMatrices(const Entity* entities, Matrix* matrices, int count) const
+{
+	if (count == 0) return;
+	const int* LUMIX_RESTRICT entity_map = &m_entity_map[0];
+	for (int i = 0; i < count; ++i)
+	{
+		int idx = entity_map[entities[i]];
+		Matrix& mtx = matrices[i];
+		m_rotations[idx].toMatrix(mtx);
+		mtx.setTranslation(m_positions[idx]);
+		mtx.multiply3x3(m_scales[idx]);
+	}
 }
 
 
@@ -187,52 +335,92 @@ void Universe::createEntity(Entity entity)
 	{
 		m_entity_map[prev_id] = m_entity_map[entity];
 	}
-	m_entity_map[entity] = m_transformations.size();
+	m_entity_map[entity] = m_entities.size();
 
-	Transformation& trans = m_transformations.emplace();
-	trans.position.set(0, 0, 0);
-	trans.rotation.set(0, 0, 0, 1);
-	trans.scale = 1;
-	trans.entity = entity;
+	m_entities.push(entity);
+	m_positions.emplace(0, 0, 0);
+	m_rotations.emplace(0, 0, 0, 1);
+	m_scales.push(1);
 
 	m_entity_created.invoke(entity);
+	m_entities_created.invoke(&entity, 1);
 }
 
 
-Entity Universe::createEntity(const Vec3& position, const Quat& rotation)
+Entity Universe::allocateEntity(const Vec3& position, const Quat& rotation)
 {
 	int global_id = 0;
 	if (m_first_free_slot >= 0)
 	{
 		global_id = m_first_free_slot;
 		m_first_free_slot = -m_entity_map[m_first_free_slot];
-		m_entity_map[global_id] = m_transformations.size();
+		m_entity_map[global_id] = m_entities.size();
 	}
 	else
 	{
 		global_id = m_entity_map.size();
-		m_entity_map.push(m_transformations.size());
+		m_entity_map.push(m_entities.size());
+		m_generations.push(0);
 	}
 
-	Transformation& trans = m_transformations.emplace();
-	trans.position = position;
-	trans.rotation = rotation;
-	trans.scale = 1;
-	trans.entity = global_id;
-	m_entity_created.invoke(global_id);
-
+	m_entities.push(global_id);
+	m_positions.push(position);
+	m_rotations.push(rotation);
+	m_scales.push(1);
 	return global_id;
 }
 
 
-void Universe::destroyEntity(Entity entity)
+Entity Universe::createEntity(const Vec3& position, const Quat& rotation)
+{
+	Entity entity = allocateEntity(position, rotation);
+	m_entity_created.invoke(entity);
+	m_entities_created.invoke(&entity, 1);
+	return entity;
+}
+
+
+void Universe::createEntities(Entity* entities,
+	const Vec3* positions,
+	const Quat* rotations,
+	int count)
+{
+	if (count <= 0) return;
+
+	int new_size = m_entities.size() + count;
+	m_entities.reserve(new_size);
+	m_positions.reserve(new_size);
+	m_rotations.reserve(new_size);
+	m_scales.reserve(new_size);
+	m_entity_map.reserve(m_entity_map.size() + count);
+	m_generations.reserve(m_generations.size() + count);
+	for (int i = 0; i < count; ++i)
+	{
+		entities[i] = allocateEntity(positions[i], rotations[i]);
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		m_entity_created.invoke(entities[i]);
+	}
+	m_entities_created.invoke(entities, count);
+}
+
+
+// does not remove the entity from m_transformed, callers do it, so batches can do it in one pass
+bool Universe::releaseEntity(Entity entity)
 {
-	if (entity < 0 || m_entity_map[entity] < 0) return;
+	if (entity < 0 || m_entity_map[entity] < 0) return false;
 
-	int last_item_id = m_transformations.back().entity;
-	m_entity_map[last_item_id] = m_entity_map[entity];
-	m_transformations.eraseFast(m_entity_map[entity]);
+	int idx = m_entity_map[entity];
+	int last_item_id = m_entities.back();
+	m_entity_map[last_item_id] = idx;
+	m_entities.eraseFast(idx);
+	m_positions.eraseFast(idx);
+	m_rotations.eraseFast(idx);
+	m_scales.eraseFast(idx);
 	m_entity_map[entity] = m_first_free_slot >= 0 ? -m_first_free_slot : INT32_MIN;
+	++m_generations[entity];
 
 	int name_index = m_id_to_name_map.find(entity);
 	if (name_index >= 0)
@@ -243,7 +431,66 @@ void Universe::destroyEntity(Entity entity)
 	}
 
 	m_first_free_slot = entity;
+	return true;
+}
+
+
+void Universe::destroyEntity(Entity entity)
+{
+	if (!releaseEntity(entity)) return;
+
+	int word = entity >> 5;
+	uint32 mask = 1U << (entity & 31);
+	if (word < m_transformed_bits.size() && (m_transformed_bits[word] & mask) != 0)
+	{
+		m_transformed_bits[word] &= ~mask;
+		m_transformed.eraseItemFast(entity);
+	}
+
 	m_entity_destroyed.invoke(entity);
+	m_entities_destroyed.invoke(&entity, 1);
+}
+
+
+void Universe::destroyEntities(const Entity* entities, int count)
+{
+	if (count <= 0) return;
+
+	bool any_transformed = false;
+	for (int i = 0; i < count; ++i)
+	{
+		Entity entity = entities[i];
+		bool released = releaseEntity(entity);
+		ASSERT(released);
+		if (!released) continue;
+
+		int word = entity >> 5;
+		uint32 mask = 1U << (entity & 31);
+		if (word < m_transformed_bits.size() && (m_transformed_bits[word] & mask) != 0)
+		{
+			m_transformed_bits[word] &= ~mask;
+			any_transformed = true;
+		}
+	}
+
+	if (any_transformed)
+	{
+		// entities which are still in m_transformed have their bit set
+		for (int i = m_transformed.size() - 1; i >= 0; --i)
+		{
+			Entity entity = m_transformed[i];
+			if ((m_transformed_bits[entity >> 5] & (1U << (entity & 31))) == 0)
+			{
+				m_transformed.eraseFast(i);
+			}
+		}
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		m_entity_destroyed.invoke(entities[i]);
+	}
+	m_entities_destroyed.invoke(entities, count);
 }
 
 
@@ -255,7 +502,7 @@ int Universe::getDenseIdx(Entity entity)
 
 Entity Universe::getEntityFromDenseIdx(int idx)
 {
-	return m_transformations[idx].entity;
+	return m_entities[idx];
 }
 
 
@@ -287,9 +534,15 @@ Entity Universe::getNextEntity(Entity entity)
 
 void Universe::serialize(OutputBlob& serializer)
 {
-	serializer.write((int32)m_transformations.size());
-	serializer.write(
-		&m_transformations[0], sizeof(m_transformations[0]) * m_transformations.size());
+	// the same layout as when transformations were stored as an array of structures
+	serializer.write((int32)m_entities.size());
+	for (int i = 0, c = m_entities.size(); i < c; ++i)
+	{
+		serializer.write(m_entities[i]);
+		serializer.write(m_positions[i]);
+		serializer.write(m_rotations[i]);
+		serializer.write(m_scales[i]);
+	}
 	serializer.write((int32)m_id_to_name_map.size());
 	for (int i = 0, c = m_id_to_name_map.size(); i < c; ++i)
 	{
@@ -310,9 +563,17 @@ void Universe::deserialize(InputBlob& serializer)
 {
 	int32 count;
 	serializer.read(count);
-	m_transformations.resize(count);
-
-	serializer.read(&m_transformations[0], sizeof(m_transformations[0]) * m_transformations.size());
+	m_entities.resize(count);
+	m_positions.resize(count);
+	m_rotations.resize(count);
+	m_scales.resize(count);
+	for (int i = 0; i < count; ++i)
+	{
+		serializer.read(m_entities[i]);
+		serializer.read(m_positions[i]);
+		serializer.read(m_rotations[i]);
+		serializer.read(m_scales[i]);
+	}
 
 	serializer.read(count);
 	m_id_to_name_map.clear();
@@ -327,6 +588,9 @@ void Universe::deserialize(InputBlob& serializer)
 		m_name_to_id_map.insert(crc32(name), key);
 	}
 
+	m_transformed.clear();
+	m_transformed_bits.clear();
+
 	serializer.read(m_first_free_slot);
 	serializer.read(count);
 	m_entity_map.resize(count);
@@ -334,37 +598,82 @@ void Universe::deserialize(InputBlob& serializer)
 	{
 		serializer.read(&m_entity_map[0], sizeof(m_entity_map[0]) * count);
 	}
+
+	// handles to entities of the previous content must not match the new ones
+	int old_count = m_generations.size();
+	m_generations.resize(count);
+	for (int i = 0; i < count; ++i)
+	{
+		m_generations[i] = i < old_count ? m_generations[i] + 1 : 0;
+	}
 }
 
 
 void Universe::setScale(Entity entity, float scale)
 {
-	auto& transform = m_transformations[m_entity_map[entity]];
-	transform.scale = scale;
-	entityTransformed().invoke(entity);
+	m_scales[m_entity_map[entity]] = scale;
+	onEntityTransformed(entity, SCALE);
 }
 
 
 float Universe::getScale(Entity entity)
 {
-	auto& transform = m_transformations[m_entity_map[entity]];
-	return transform.scale;
+	return m_scales[m_entity_map[entity]];
 }
 
 
 void Universe::destroyComponent(Entity entity, uint32 component_type, IScene* scene, int index)
 {
-	m_component_destroyed.invoke(ComponentUID(entity, component_type, scene, index));
+	ComponentUID cmp(entity, component_type, scene, index);
+	if (m_is_batching_components)
+	{
+		MT::SpinLock lock(m_batch_mutex);
+		m_batched_components.push({cmp, false});
+		return;
+	}
+	m_component_destroyed.invoke(cmp);
 }
 
 
 void Universe::addComponent(Entity entity, uint32 component_type, IScene* scene, int index)
 {
 	ComponentUID cmp(entity, component_type, scene, index);
+	if (m_is_batching_components)
+	{
+		MT::SpinLock lock(m_batch_mutex);
+		m_batched_components.push({cmp, true});
+		return;
+	}
 	m_component_added.invoke(cmp);
 }
 
 
+void Universe::beginComponentBatch()
+{
+	ASSERT(!m_is_batching_components);
+	m_is_batching_components = true;
+}
+
+
+void Universe::endComponentBatch()
+{
+	ASSERT(m_is_batching_components);
+	m_is_batching_components = false;
+	for (const auto& batched : m_batched_components)
+	{
+		if (batched.is_added)
+		{
+			m_component_added.invoke(batched.cmp);
+		}
+		else
+		{
+			m_component_destroyed.invoke(batched.cmp);
+		}
+	}
+	m_batched_components.clear();
+}
+
+
 bool Universe::nameExists(const char* name) const
 {
 	return m_name_to_id_map.find(crc32(name)) != -1;
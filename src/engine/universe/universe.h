@@ -5,10 +5,13 @@
 #include "core/array.h"
 #include "core/associative_array.h"
 #include "core/delegate_list.h"
+#include "core/event_channel.h"
+#include "core/mt/sync.h"
 #include "core/quat.h"
 #include "core/string.h"
 #include "core/vec.h"
 #include "universe/component.h"
+#include "universe/entity_map.h"
 
 
 namespace Lumix
@@ -24,6 +27,17 @@ class Universe;
 
 class LUMIX_ENGINE_API Universe
 {
+public:
+	// what changed, in the data of transform events
+	enum TransformFlags : uint8
+	{
+		POSITION = 1 << 0,
+		ROTATION = 1 << 1,
+		SCALE = 1 << 2
+	};
+
+	typedef EventChannel<uint8> TransformEvents;
+
 public:
 	explicit Universe(IAllocator& allocator);
 	~Universe();
@@ -32,9 +46,18 @@ public:
 	void createEntity(Entity entity);
 	Entity createEntity(const Vec3& position, const Quat& rotation);
 	void destroyEntity(Entity entity);
+	// storage is reserved once for all entities, entityCreated / entityDestroyed are called
+	// for every entity, entitiesCreated / entitiesDestroyed once for the whole batch;
+	// destroyed entities must exist and must not repeat
+	void createEntities(Entity* entities, const Vec3* positions, const Quat* rotations, int count);
+	void destroyEntities(const Entity* entities, int count);
 	void addComponent(Entity entity, uint32 component_type, IScene* scene, int index);
 	void destroyComponent(Entity entity, uint32 component_type, IScene* scene, int index);
-	int getEntityCount() const { return m_transformations.size(); }
+	// between these, addComponent / destroyComponent can be called from any thread, componentAdded
+	// and componentDestroyed are invoked in the original order by endComponentBatch
+	void beginComponentBatch();
+	void endComponentBatch();
+	int getEntityCount() const { return m_entities.size(); }
 
 	int getDenseIdx(Entity entity);
 	Entity getEntityFromDenseIdx(int idx);
@@ -44,6 +67,9 @@ public:
 	const char* getEntityName(Entity entity) const;
 	void setEntityName(Entity entity, const char* name);
 	bool hasEntity(Entity entity) const;
+	EntityHandle getHandle(Entity entity) const;
+	// false if the entity was destroyed since the handle was made, even if its slot is reused
+	bool isValid(const EntityHandle& handle) const;
 
 	void setMatrix(Entity entity, const Matrix& mtx);
 	Matrix getPositionAndRotation(Entity entity) const;
@@ -52,14 +78,39 @@ public:
 	void setRotation(Entity entity, const Quat& rot);
 	void setPosition(Entity entity, float x, float y, float z);
 	void setPosition(Entity entity, const Vec3& pos);
+	void setPositionAndRotation(Entity entity, const Vec3& pos, const Quat& rot);
+	// bulk versions, entities are notified the same way as by the functions above
+	void setPositions(const Entity* entities, const Vec3* positions, int count);
+	void setPositionsAndRotations(const Entity* entities,
+		const Vec3* positions,
+		const Quat* rotations,
+		int count);
+	void getPositions(const Entity* entities, Vec3* positions, int count) const;
+	void getMatrices(const Entity* entities, Matrix* matrices, int count) const;
+	// indexed by getDenseIdx()
+	const Vec3* getAllPositions() const { return m_positions.empty() ? nullptr : &m_positions[0]; }
+	const Quat* getAllRotations() const { return m_rotations.empty() ? nullptr : &m_rotations[0]; }
 	void setScale(Entity entity, float scale);
 	float getScale(Entity entity);
 	const Vec3& getPosition(Entity entity) const;
 	const Quat& getRotation(Entity entity) const;
 
+	// called immediately after every change of transformation
 	DelegateList<void(Entity)>& entityTransformed() { return m_entity_moved; }
+	// called from notifyTransformChanges() with all entities transformed since the last call,
+	// every entity is there only once, no matter how many times it moved
+	DelegateList<void(const Entity*, int)>& entitiesTransformed() { return m_entities_moved; }
+	// every change of transformation with TransformFlags, for listeners which care only about
+	// few entities and can pull the changes when they need them
+	TransformEvents& getTransformEvents() { return m_transform_events; }
+	// called once per frame by the engine
+	void notifyTransformChanges();
 	DelegateList<void(Entity)>& entityCreated() { return m_entity_created; }
 	DelegateList<void(Entity)>& entityDestroyed() { return m_entity_destroyed; }
+	// called after entityCreated / entityDestroyed of every entity in the batch,
+	// single entity functions call these with count == 1
+	DelegateList<void(const Entity*, int)>& entitiesCreated() { return m_entities_created; }
+	DelegateList<void(const Entity*, int)>& entitiesDestroyed() { return m_entities_destroyed; }
 	DelegateList<void(const ComponentUID&)>& componentDestroyed() { return m_component_destroyed; }
 	DelegateList<void(const ComponentUID&)>& componentAdded() { return m_component_added; }
 
@@ -71,26 +122,44 @@ public:
 	void addScene(IScene* scene);
 
 private:
-	struct Transformation
-	{
-		Entity entity;
-		Vec3 position;
-		Quat rotation;
-		float scale;
-	};
+	Entity allocateEntity(const Vec3& position, const Quat& rotation);
+	bool releaseEntity(Entity entity);
+	void onEntityTransformed(Entity entity, uint8 flags);
+	void onEntitiesTransformed(const Entity* entities, int count, uint8 flags);
 
 private:
 	IAllocator& m_allocator;
 	Array<IScene*> m_scenes;
-	Array<Transformation> m_transformations;
+	// structure of arrays indexed by dense index, see m_entity_map
+	Array<Entity> m_entities;
+	Array<Vec3> m_positions;
+	Array<Quat> m_rotations;
+	Array<float> m_scales;
 	Array<int> m_entity_map;
+	// indexed by entity, incremented every time the entity is destroyed
+	Array<uint32> m_generations;
 	AssociativeArray<uint32, uint32> m_name_to_id_map;
 	AssociativeArray<uint32, string> m_id_to_name_map;
 	DelegateList<void(Entity)> m_entity_moved;
+	DelegateList<void(const Entity*, int)> m_entities_moved;
+	TransformEvents m_transform_events;
+	Array<uint32> m_transformed_bits;
+	Array<Entity> m_transformed;
+	Array<Entity> m_notified_transformed;
 	DelegateList<void(Entity)> m_entity_created;
 	DelegateList<void(Entity)> m_entity_destroyed;
+	DelegateList<void(const Entity*, int)> m_entities_created;
+	DelegateList<void(const Entity*, int)> m_entities_destroyed;
 	DelegateList<void(const ComponentUID&)> m_component_destroyed;
 	DelegateList<void(const ComponentUID&)> m_component_added;
+	struct BatchedComponent
+	{
+		ComponentUID cmp;
+		bool is_added;
+	};
+	Array<BatchedComponent> m_batched_components;
+	MT::SpinMutex m_batch_mutex;
+	bool m_is_batching_components;
 	int m_first_free_slot;
 };
 
@@ -0,0 +1,622 @@
+#include "world_streamer.h"
+#include "core/array.h"
+#include "core/blob.h"
+#include "core/crc32.h"
+#include "core/fs/file_system.h"
+#include "core/fs/ifile.h"
+#include "core/log.h"
+#include "core/math_utils.h"
+#include "core/path.h"
+#include "core/profiler.h"
+#include "core/string.h"
+#include "core/vec.h"
+#include "engine/engine.h"
+#include "engine/iplugin.h"
+#include "engine/iproperty_descriptor.h"
+#include "engine/property_register.h"
+#include "universe/universe.h"
+#include <cfloat>
+#include <cmath>
+
+
+namespace Lumix
+{
+
+
+static const uint32 CELL_MAGIC = 0x4C45434C; // 'LCEL'
+static const uint32 INDEX_MAGIC = 0x5849434C; // 'LCIX'
+static const int32 FILE_VERSION = 0;
+
+
+struct ComponentType
+{
+	uint32 type;
+	IScene* scene;
+};
+
+
+static void getCellPath(const char* dir, int x, int z, char* out, int max_size)
+{
+	char tmp[20];
+	copyString(out, max_size, dir);
+	catString(out, max_size, "/cell_");
+	toCString(x, tmp, lengthOf(tmp));
+	catString(out, max_size, tmp);
+	catString(out, max_size, "_");
+	toCString(z, tmp, lengthOf(tmp));
+	catString(out, max_size, tmp);
+	catString(out, max_size, ".cell");
+}
+
+
+static void getIndexPath(const char* dir, char* out, int max_size)
+{
+	copyString(out, max_size, dir);
+	catString(out, max_size, "/cells.idx");
+}
+
+
+static void getComponentTypes(Universe& universe, Array<ComponentType>& types)
+{
+	for (int i = 0, c = PropertyRegister::getComponentTypesCount(); i < c; ++i)
+	{
+		uint32 type = crc32(PropertyRegister::getComponentTypeID(i));
+		for (IScene* scene : universe.getScenes())
+		{
+			if (!scene->ownComponentType(type)) continue;
+			types.push({type, scene});
+			break;
+		}
+	}
+}
+
+
+static bool writeFile(FS::FileSystem& fs, const char* path, const OutputBlob& blob)
+{
+	FS::IFile* file =
+		fs.open(fs.getDefaultDevice(), Path(path), FS::Mode::CREATE | FS::Mode::WRITE);
+	if (!file)
+	{
+		g_log_error.log("Engine") << "Could not create " << path;
+		return false;
+	}
+	bool success = file->write(blob.getData(), blob.getSize());
+	fs.close(*file);
+	return success;
+}
+
+
+static void writeComponent(const ComponentUID& cmp,
+	const Array<Entity>& cell_entities,
+	OutputBlob& blob)
+{
+	Universe& universe = cmp.scene->getUniverse();
+	for (auto* desc : PropertyRegister::getDescriptors(cmp.type))
+	{
+		if (desc->getType() != IPropertyDescriptor::ENTITY)
+		{
+			desc->get(cmp, -1, blob);
+			continue;
+		}
+
+		// entities are referenced by their index in the cell, they get new IDs when loaded
+		OutputBlob tmp(universe.getAllocator());
+		desc->get(cmp, -1, tmp);
+		int32 dense_idx = *(const int32*)tmp.getData();
+		int32 local_idx = -1;
+		if (dense_idx >= 0)
+		{
+			local_idx = cell_entities.indexOf(universe.getEntityFromDenseIdx(dense_idx));
+		}
+		blob.write(local_idx);
+	}
+}
+
+
+bool WorldStreamer::saveCells(Engine& engine,
+	Universe& universe,
+	const Entity* entities,
+	int count,
+	const char* dir,
+	float cell_size)
+{
+	ASSERT(cell_size > 0);
+	IAllocator& allocator = engine.getAllocator();
+	Array<ComponentType> types(allocator);
+	getComponentTypes(universe, types);
+
+	struct CellEntities
+	{
+		CellEntities(int32 x, int32 z, IAllocator& allocator)
+			: x(x)
+			, z(z)
+			, entities(allocator)
+		{
+		}
+
+		int32 x, z;
+		Array<Entity> entities;
+	};
+	Array<CellEntities*> cells(allocator);
+	for (int i = 0; i < count; ++i)
+	{
+		const Vec3& pos = universe.getPosition(entities[i]);
+		int32 x = (int32)floorf(pos.x / cell_size);
+		int32 z = (int32)floorf(pos.z / cell_size);
+		CellEntities* cell = nullptr;
+		for (auto* c : cells)
+		{
+			if (c->x == x && c->z == z) cell = c;
+		}
+		if (!cell)
+		{
+			cell = LUMIX_NEW(allocator, CellEntities)(x, z, allocator);
+			cells.push(cell);
+		}
+		cell->entities.push(entities[i]);
+	}
+
+	FS::FileSystem& fs = engine.getFileSystem();
+	char path[MAX_PATH_LENGTH];
+	bool success = true;
+	OutputBlob index(allocator);
+	index.write(INDEX_MAGIC);
+	index.write(FILE_VERSION);
+	index.write(cell_size);
+	index.write((int32)cells.size());
+	Array<ComponentUID> cmps(allocator);
+	for (auto* cell : cells)
+	{
+		index.write(cell->x);
+		index.write(cell->z);
+		index.write((int32)cell->entities.size());
+
+		OutputBlob blob(allocator);
+		blob.write(CELL_MAGIC);
+		blob.write(FILE_VERSION);
+		blob.write((int32)cell->entities.size());
+		for (Entity entity : cell->entities)
+		{
+			blob.write(universe.getPosition(entity));
+			blob.write(universe.getRotation(entity));
+			blob.write(universe.getScale(entity));
+			blob.writeString(universe.getEntityName(entity));
+		}
+		for (Entity entity : cell->entities)
+		{
+			cmps.clear();
+			for (auto& type : types)
+			{
+				ComponentIndex index = type.scene->getComponent(entity, type.type);
+				if (index < 0) continue;
+				// dependencies first, they have to exist when the dependent component is created
+				int insert_at = cmps.size();
+				for (int j = 0; j < cmps.size(); ++j)
+				{
+					if (PropertyRegister::componentDepends(cmps[j].type, type.type))
+					{
+						insert_at = j;
+						break;
+					}
+				}
+				cmps.insert(insert_at, ComponentUID(entity, type.type, type.scene, index));
+			}
+
+			blob.write((int32)cmps.size());
+			for (auto& cmp : cmps)
+			{
+				blob.write(cmp.type);
+				int size_pos = blob.getSize();
+				blob.write((int32)0);
+				writeComponent(cmp, cell->entities, blob);
+				// lets the loader skip components whose properties changed since
+				int32 size = blob.getSize() - size_pos - sizeof(int32);
+				*(int32*)((uint8*)blob.getData() + size_pos) = size;
+			}
+		}
+
+		getCellPath(dir, cell->x, cell->z, path, lengthOf(path));
+		success = writeFile(fs, path, blob) && success;
+		LUMIX_DELETE(allocator, cell);
+	}
+
+	getIndexPath(dir, path, lengthOf(path));
+	success = writeFile(fs, path, index) && success;
+	return success;
+}
+
+
+namespace
+{
+
+
+struct WorldStreamerImpl;
+
+
+struct CellComponent
+{
+	// index in Cell::entities
+	int entity;
+	uint32 type;
+	IScene* scene;
+	ComponentIndex index;
+};
+
+
+struct Cell
+{
+	enum class State
+	{
+		UNLOADED,
+		LOADING,
+		LOADED
+	};
+
+	Cell(WorldStreamerImpl& streamer, IAllocator& allocator)
+		: streamer(streamer)
+		, entities(allocator)
+		, components(allocator)
+		, state(State::UNLOADED)
+		, is_wanted(false)
+	{
+	}
+
+	void fileLoaded(FS::IFile& file, bool success);
+
+	WorldStreamerImpl& streamer;
+	int32 x, z;
+	int32 entity_count;
+	State state;
+	// can change while the cell is loading, it's checked again when the file is loaded
+	bool is_wanted;
+	char path[MAX_PATH_LENGTH];
+	Array<EntityHandle> entities;
+	Array<CellComponent> components;
+};
+
+
+struct WorldStreamerImpl : public WorldStreamer
+{
+	WorldStreamerImpl(Engine& engine, Universe& universe, IAllocator& allocator)
+		: m_engine(engine)
+		, m_universe(universe)
+		, m_allocator(allocator)
+		, m_cells(allocator)
+		, m_anchors(allocator)
+		, m_component_types(allocator)
+		, m_cell_size(0)
+		, m_load_distance(100)
+		, m_unload_distance(150)
+		, m_loading_count(0)
+		, m_loaded_count(0)
+	{
+	}
+
+
+	~WorldStreamerImpl()
+	{
+		unloadAll();
+		clearCells();
+	}
+
+
+	void clearCells()
+	{
+		// cells are referenced by the pending async callbacks
+		FS::FileSystem& fs = m_engine.getFileSystem();
+		while (m_loading_count > 0) fs.updateAsyncTransactions();
+
+		for (auto* cell : m_cells) LUMIX_DELETE(m_allocator, cell);
+		m_cells.clear();
+	}
+
+
+	bool loadIndex(const char* dir) override
+	{
+		unloadAll();
+		clearCells();
+		m_component_types.clear();
+		getComponentTypes(m_universe, m_component_types);
+
+		char path[MAX_PATH_LENGTH];
+		getIndexPath(dir, path, lengthOf(path));
+		FS::FileSystem& fs = m_engine.getFileSystem();
+		FS::IFile* file = fs.open(fs.getDefaultDevice(), Path(path), FS::Mode::OPEN_AND_READ);
+		if (!file)
+		{
+			g_log_error.log("Engine") << "Could not open " << path;
+			return false;
+		}
+		Array<uint8> data(m_allocator);
+		data.resize((int)file->size());
+		bool success = data.empty() || file->read(&data[0], data.size());
+		fs.close(*file);
+
+		InputBlob blob(data.empty() ? nullptr : &data[0], data.size());
+		if (!success || blob.read<uint32>() != INDEX_MAGIC || blob.read<int32>() > FILE_VERSION)
+		{
+			g_log_error.log("Engine") << "Invalid streaming index " << path;
+			return false;
+		}
+		blob.read(m_cell_size);
+		int32 count = blob.read<int32>();
+		m_cells.reserve(count);
+		for (int i = 0; i < count; ++i)
+		{
+			Cell* cell = LUMIX_NEW(m_allocator, Cell)(*this, m_allocator);
+			blob.read(cell->x);
+			blob.read(cell->z);
+			blob.read(cell->entity_count);
+			getCellPath(dir, cell->x, cell->z, cell->path, lengthOf(cell->path));
+			m_cells.push(cell);
+		}
+		return true;
+	}
+
+
+	int addAnchor(const Vec3& position) override
+	{
+		for (int i = 0; i < m_anchors.size(); ++i)
+		{
+			if (m_anchors[i].is_used) continue;
+			m_anchors[i] = {position, true};
+			return i;
+		}
+		m_anchors.push({position, true});
+		return m_anchors.size() - 1;
+	}
+
+
+	void setAnchor(int anchor, const Vec3& position) override
+	{
+		m_anchors[anchor].position = position;
+	}
+
+
+	void removeAnchor(int anchor) override { m_anchors[anchor].is_used = false; }
+
+
+	void setDistances(float load_distance, float unload_distance) override
+	{
+		ASSERT(load_distance <= unload_distance);
+		m_load_distance = load_distance;
+		m_unload_distance = unload_distance;
+	}
+
+
+	float getSquaredDistance(const Cell& cell) const
+	{
+		float min_x = cell.x * m_cell_size;
+		float min_z = cell.z * m_cell_size;
+		float result = FLT_MAX;
+		for (auto& anchor : m_anchors)
+		{
+			if (!anchor.is_used) continue;
+			float dx = Math::maxValue(0.0f,
+				Math::maxValue(min_x - anchor.position.x, anchor.position.x - min_x - m_cell_size));
+			float dz = Math::maxValue(0.0f,
+				Math::maxValue(min_z - anchor.position.z, anchor.position.z - min_z - m_cell_size));
+			result = Math::minValue(result, dx * dx + dz * dz);
+		}
+		return result;
+	}
+
+
+	void update() override
+	{
+		PROFILE_FUNCTION();
+		float load_distance2 = m_load_distance * m_load_distance;
+		float unload_distance2 = m_unload_distance * m_unload_distance;
+		FS::FileSystem& fs = m_engine.getFileSystem();
+		for (auto* cell : m_cells)
+		{
+			float distance2 = getSquaredDistance(*cell);
+			if (distance2 < load_distance2) cell->is_wanted = true;
+			else if (distance2 > unload_distance2) cell->is_wanted = false;
+
+			if (cell->is_wanted && cell->state == Cell::State::UNLOADED)
+			{
+				cell->state = Cell::State::LOADING;
+				++m_loading_count;
+				FS::ReadCallback cb;
+				cb.bind<Cell, &Cell::fileLoaded>(cell);
+				// nearer cells first
+				int priority = -(int)(sqrtf(distance2) / m_cell_size);
+				fs.openAsync(
+					fs.getDefaultDevice(), Path(cell->path), FS::Mode::OPEN_AND_READ, cb, priority);
+			}
+			else if (!cell->is_wanted && cell->state == Cell::State::LOADED)
+			{
+				unloadCell(*cell);
+			}
+		}
+	}
+
+
+	void unloadAll() override
+	{
+		for (auto* cell : m_cells)
+		{
+			cell->is_wanted = false;
+			if (cell->state == Cell::State::LOADED) unloadCell(*cell);
+		}
+	}
+
+
+	void unloadCell(Cell& cell)
+	{
+		PROFILE_FUNCTION();
+		// the game could destroy some of them in the meantime
+		for (int i = cell.components.size() - 1; i >= 0; --i)
+		{
+			const CellComponent& cmp = cell.components[i];
+			const EntityHandle& entity = cell.entities[cmp.entity];
+			if (!m_universe.isValid(entity)) continue;
+			if (cmp.scene->getComponent(entity.entity, cmp.type) != cmp.index) continue;
+			cmp.scene->destroyComponent(cmp.index, cmp.type);
+		}
+		for (auto& entity : cell.entities)
+		{
+			if (m_universe.isValid(entity)) m_universe.destroyEntity(entity.entity);
+		}
+		cell.components.clear();
+		cell.entities.clear();
+		cell.state = Cell::State::UNLOADED;
+		--m_loaded_count;
+	}
+
+
+	IScene* getScene(uint32 type) const
+	{
+		for (auto& cmp_type : m_component_types)
+		{
+			if (cmp_type.type == type) return cmp_type.scene;
+		}
+		return nullptr;
+	}
+
+
+	void readComponent(Cell& cell, const ComponentUID& cmp, InputBlob& blob)
+	{
+		for (auto* desc : PropertyRegister::getDescriptors(cmp.type))
+		{
+			if (desc->getType() != IPropertyDescriptor::ENTITY)
+			{
+				desc->set(cmp, -1, blob);
+				continue;
+			}
+
+			int32 local_idx = blob.read<int32>();
+			int32 dense_idx = -1;
+			if (local_idx >= 0 && local_idx < cell.entities.size())
+			{
+				dense_idx = m_universe.getDenseIdx(cell.entities[local_idx].entity);
+			}
+			InputBlob tmp(&dense_idx, sizeof(dense_idx));
+			desc->set(cmp, -1, tmp);
+		}
+	}
+
+
+	bool createCell(Cell& cell, InputBlob& blob)
+	{
+		if (blob.read<uint32>() != CELL_MAGIC || blob.read<int32>() > FILE_VERSION) return false;
+
+		int32 count = blob.read<int32>();
+		cell.entities.reserve(count);
+		for (int i = 0; i < count; ++i)
+		{
+			Vec3 pos = blob.read<Vec3>();
+			Quat rot = blob.read<Quat>();
+			float scale = blob.read<float>();
+			char name[50];
+			blob.readString(name, lengthOf(name));
+			Entity entity = m_universe.createEntity(pos, rot);
+			m_universe.setScale(entity, scale);
+			if (name[0] && !m_universe.nameExists(name)) m_universe.setEntityName(entity, name);
+			cell.entities.push(m_universe.getHandle(entity));
+		}
+
+		// all entities exist before the components, so they can reference each other
+		for (int i = 0; i < count; ++i)
+		{
+			Entity entity = cell.entities[i].entity;
+			int32 cmps_count = blob.read<int32>();
+			for (int j = 0; j < cmps_count; ++j)
+			{
+				uint32 type = blob.read<uint32>();
+				int32 size = blob.read<int32>();
+				IScene* scene = getScene(type);
+				if (!scene)
+				{
+					g_log_warning.log("Engine") << "Unknown component in " << cell.path;
+					blob.skip(size);
+					continue;
+				}
+				ComponentIndex index = scene->createComponent(type, entity);
+				cell.components.push({i, type, scene, index});
+				readComponent(cell, ComponentUID(entity, type, scene, index), blob);
+			}
+		}
+		return true;
+	}
+
+
+	void onCellLoaded(Cell& cell, FS::IFile& file, bool success)
+	{
+		PROFILE_FUNCTION();
+		--m_loading_count;
+		cell.state = Cell::State::UNLOADED;
+		if (!success)
+		{
+			g_log_error.log("Engine") << "Could not load " << cell.path;
+			return;
+		}
+		// the anchors moved away while it was loading, next update loads it again if needed
+		if (!cell.is_wanted) return;
+
+		Array<uint8> data(m_allocator);
+		const void* buffer = file.getBuffer();
+		if (!buffer)
+		{
+			data.resize((int)file.size());
+			if (!data.empty()) file.read(&data[0], data.size());
+			buffer = data.empty() ? nullptr : &data[0];
+		}
+		InputBlob blob(buffer, (int)file.size());
+		cell.state = Cell::State::LOADED;
+		++m_loaded_count;
+		if (!createCell(cell, blob))
+		{
+			g_log_error.log("Engine") << "Invalid world cell " << cell.path;
+		}
+	}
+
+
+	int getCellCount() const override { return m_cells.size(); }
+	int getLoadedCellCount() const override { return m_loaded_count; }
+	int getLoadingCellCount() const override { return m_loading_count; }
+
+
+	struct Anchor
+	{
+		Vec3 position;
+		bool is_used;
+	};
+
+	Engine& m_engine;
+	Universe& m_universe;
+	IAllocator& m_allocator;
+	Array<Cell*> m_cells;
+	Array<Anchor> m_anchors;
+	Array<ComponentType> m_component_types;
+	float m_cell_size;
+	float m_load_distance;
+	float m_unload_distance;
+	int m_loading_count;
+	int m_loaded_count;
+};
+
+
+void Cell::fileLoaded(FS::IFile& file, bool success)
+{
+	streamer.onCellLoaded(*this, file, success);
+}
+
+
+} // anonymous namespace
+
+
+WorldStreamer* WorldStreamer::create(Engine& engine, Universe& universe, IAllocator& allocator)
+{
+	return LUMIX_NEW(allocator, WorldStreamerImpl)(engine, universe, allocator);
+}
+
+
+void WorldStreamer::destroy(WorldStreamer* streamer)
+{
+	LUMIX_DELETE(static_cast<WorldStreamerImpl*>(streamer)->m_allocator, streamer);
+}
+
+
+} // namespace Lumix
@@ -0,0 +1,53 @@
+#pragma once
+
+
+#include "lumix.h"
+
+
+namespace Lumix
+{
+
+
+class Engine;
+class IAllocator;
+class Universe;
+struct Vec3;
+
+
+// The world is split into square cells on the xz plane, entities of every cell are saved in their
+// own file and created only while some anchor (usually the camera or the player) is nearby.
+// Entity properties pointing to an entity in another cell are not restored.
+class LUMIX_ENGINE_API WorldStreamer
+{
+public:
+	static WorldStreamer* create(Engine& engine, Universe& universe, IAllocator& allocator);
+	static void destroy(WorldStreamer* streamer);
+
+	// writes dir/cells.idx and dir/cell_<x>_<z>.cell for the entities, they stay in the universe
+	static bool saveCells(Engine& engine,
+		Universe& universe,
+		const Entity* entities,
+		int count,
+		const char* dir,
+		float cell_size);
+
+	virtual ~WorldStreamer() {}
+
+	// unloads all cells loaded from the previous index
+	virtual bool loadIndex(const char* dir) = 0;
+	virtual int addAnchor(const Vec3& position) = 0;
+	virtual void setAnchor(int anchor, const Vec3& position) = 0;
+	virtual void removeAnchor(int anchor) = 0;
+	// cells closer than load_distance to an anchor are loaded, cells farther than
+	// unload_distance from all anchors are unloaded
+	virtual void setDistances(float load_distance, float unload_distance) = 0;
+	// starts async loads and unloads cells, loaded cells are created in FS callbacks
+	virtual void update() = 0;
+	virtual void unloadAll() = 0;
+	virtual int getCellCount() const = 0;
+	virtual int getLoadedCellCount() const = 0;
+	virtual int getLoadingCellCount() const = 0;
+};
+
+
+} // namespace Lumix
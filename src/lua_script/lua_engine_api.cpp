@@ -1,3 +1,4 @@
+#include "core/array.h"
 #include "core/crc32.h"
 #include "core/input_system.h"
 #include "core/lua_wrapper.h"
@@ -206,6 +207,255 @@ static int getEntityDirection(lua_State* L)
 }
 
 
+// 1, 2, 3, "x", "y" or "z" to 0, 1, 2, -1 for other keys
+static int getVec3Component(lua_State* L, int index)
+{
+	if (lua_type(L, index) == LUA_TNUMBER)
+	{
+		int i = (int)lua_tointeger(L, index);
+		return i >= 1 && i <= 3 ? i - 1 : -1;
+	}
+	const char* key = lua_tostring(L, index);
+	if (!key || key[0] < 'x' || key[0] > 'z' || key[1] != '\0') return -1;
+	return key[0] - 'x';
+}
+
+
+static int vec3Index(lua_State* L)
+{
+	Vec3* v = LuaWrapper::toVec3Userdata(L, 1);
+	int component = getVec3Component(L, 2);
+	if (v && component >= 0)
+	{
+		lua_pushnumber(L, (&v->x)[component]);
+		return 1;
+	}
+	// methods are in the metatable
+	lua_getmetatable(L, 1);
+	lua_pushvalue(L, 2);
+	lua_rawget(L, -2);
+	return 1;
+}
+
+
+static int vec3NewIndex(lua_State* L)
+{
+	Vec3* v = LuaWrapper::toVec3Userdata(L, 1);
+	int component = getVec3Component(L, 2);
+	if (!v || component < 0) return luaL_argerror(L, 2, "expected 1, 2, 3, x, y or z");
+	(&v->x)[component] = (float)luaL_checknumber(L, 3);
+	return 0;
+}
+
+
+static int vec3New(lua_State* L)
+{
+	Vec3 v(0, 0, 0);
+	if (lua_gettop(L) == 1)
+	{
+		v = LuaWrapper::checkArg<Vec3>(L, 1);
+	}
+	else
+	{
+		v.x = (float)luaL_optnumber(L, 1, 0);
+		v.y = (float)luaL_optnumber(L, 2, 0);
+		v.z = (float)luaL_optnumber(L, 3, 0);
+	}
+	LuaWrapper::pushLua(L, v);
+	return 1;
+}
+
+
+static int vec3Add(lua_State* L)
+{
+	Vec3 a = LuaWrapper::checkArg<Vec3>(L, 1);
+	LuaWrapper::pushLua(L, a + LuaWrapper::checkArg<Vec3>(L, 2));
+	return 1;
+}
+
+
+static int vec3Sub(lua_State* L)
+{
+	Vec3 a = LuaWrapper::checkArg<Vec3>(L, 1);
+	LuaWrapper::pushLua(L, a - LuaWrapper::checkArg<Vec3>(L, 2));
+	return 1;
+}
+
+
+// vector * number or number * vector
+static int vec3Mul(lua_State* L)
+{
+	if (lua_type(L, 1) == LUA_TNUMBER)
+	{
+		float s = (float)lua_tonumber(L, 1);
+		LuaWrapper::pushLua(L, LuaWrapper::checkArg<Vec3>(L, 2) * s);
+		return 1;
+	}
+	Vec3 v = LuaWrapper::checkArg<Vec3>(L, 1);
+	LuaWrapper::pushLua(L, v * (float)luaL_checknumber(L, 2));
+	return 1;
+}
+
+
+static int vec3Div(lua_State* L)
+{
+	Vec3 v = LuaWrapper::checkArg<Vec3>(L, 1);
+	LuaWrapper::pushLua(L, v / (float)luaL_checknumber(L, 2));
+	return 1;
+}
+
+
+static int vec3Unm(lua_State* L)
+{
+	LuaWrapper::pushLua(L, -LuaWrapper::checkArg<Vec3>(L, 1));
+	return 1;
+}
+
+
+static int vec3Eq(lua_State* L)
+{
+	Vec3 a = LuaWrapper::checkArg<Vec3>(L, 1);
+	Vec3 b = LuaWrapper::checkArg<Vec3>(L, 2);
+	lua_pushboolean(L, a.x == b.x && a.y == b.y && a.z == b.z);
+	return 1;
+}
+
+
+static int vec3Len(lua_State* L)
+{
+	lua_pushinteger(L, 3);
+	return 1;
+}
+
+
+static int vec3ToString(lua_State* L)
+{
+	Vec3 v = LuaWrapper::checkArg<Vec3>(L, 1);
+	lua_pushfstring(L, "(%f, %f, %f)", (lua_Number)v.x, (lua_Number)v.y, (lua_Number)v.z);
+	return 1;
+}
+
+
+static int vec3Length(lua_State* L)
+{
+	lua_pushnumber(L, LuaWrapper::checkArg<Vec3>(L, 1).length());
+	return 1;
+}
+
+
+static int vec3SquaredLength(lua_State* L)
+{
+	lua_pushnumber(L, LuaWrapper::checkArg<Vec3>(L, 1).squaredLength());
+	return 1;
+}
+
+
+static int vec3Normalized(lua_State* L)
+{
+	LuaWrapper::pushLua(L, LuaWrapper::checkArg<Vec3>(L, 1).normalized());
+	return 1;
+}
+
+
+static int vec3Dot(lua_State* L)
+{
+	Vec3 a = LuaWrapper::checkArg<Vec3>(L, 1);
+	lua_pushnumber(L, dotProduct(a, LuaWrapper::checkArg<Vec3>(L, 2)));
+	return 1;
+}
+
+
+static int vec3Cross(lua_State* L)
+{
+	Vec3 a = LuaWrapper::checkArg<Vec3>(L, 1);
+	LuaWrapper::pushLua(L, crossProduct(a, LuaWrapper::checkArg<Vec3>(L, 2)));
+	return 1;
+}
+
+
+// Vec3 userdata, indexed by 1, 2, 3 or x, y, z like the tables it replaces, with operators
+// and the methods length, squaredLength, normalized, dot and cross
+static void registerVec3(lua_State* L)
+{
+	static const luaL_Reg functions[] = {
+		{"__index", &vec3Index},
+		{"__newindex", &vec3NewIndex},
+		{"__add", &vec3Add},
+		{"__sub", &vec3Sub},
+		{"__mul", &vec3Mul},
+		{"__div", &vec3Div},
+		{"__unm", &vec3Unm},
+		{"__eq", &vec3Eq},
+		{"__len", &vec3Len},
+		{"__tostring", &vec3ToString},
+		{"length", &vec3Length},
+		{"squaredLength", &vec3SquaredLength},
+		{"normalized", &vec3Normalized},
+		{"dot", &vec3Dot},
+		{"cross", &vec3Cross},
+		{nullptr, nullptr}};
+
+	luaL_newmetatable(L, LuaWrapper::VEC3_TYPE_NAME);
+	luaL_setfuncs(L, functions, 0);
+	lua_pop(L, 1);
+}
+
+
+// Engine.setEntityPositions(universe, entities, positions), moves all the entities with one
+// transform notification instead of one per entity
+static int setEntityPositions(lua_State* L)
+{
+	auto* universe = LuaWrapper::checkArg<Universe*>(L, 1);
+	LuaWrapper::checkTableArg(L, 2);
+	LuaWrapper::checkTableArg(L, 3);
+
+	int count = (int)lua_rawlen(L, 2);
+	if ((int)lua_rawlen(L, 3) != count) luaL_argerror(L, 3, "expected one position per entity");
+
+	Array<Entity> entities(universe->getAllocator());
+	Array<Vec3> positions(universe->getAllocator());
+	entities.reserve(count);
+	positions.reserve(count);
+	for (int i = 0; i < count; ++i)
+	{
+		lua_rawgeti(L, 2, i + 1);
+		lua_rawgeti(L, 3, i + 1);
+		Entity entity = LuaWrapper::toType<Entity>(L, -2);
+		if (LuaWrapper::isType<Vec3>(L, -1) && universe->hasEntity(entity))
+		{
+			entities.push(entity);
+			positions.push(LuaWrapper::toType<Vec3>(L, -1));
+		}
+		lua_pop(L, 2);
+	}
+
+	if (!entities.empty()) universe->setPositions(&entities[0], &positions[0], entities.size());
+	return 0;
+}
+
+
+// Engine.getEntityPositions(universe, entities), returns a table of positions
+static int getEntityPositions(lua_State* L)
+{
+	auto* universe = LuaWrapper::checkArg<Universe*>(L, 1);
+	LuaWrapper::checkTableArg(L, 2);
+
+	int count = (int)lua_rawlen(L, 2);
+	lua_createtable(L, count, 0);
+	for (int i = 0; i < count; ++i)
+	{
+		lua_rawgeti(L, 2, i + 1);
+		Entity entity = LuaWrapper::toType<Entity>(L, -1);
+		lua_pop(L, 1);
+		if (!universe->hasEntity(entity)) continue;
+
+		LuaWrapper::pushLua(L, universe->getPosition(entity));
+		lua_rawseti(L, -2, i + 1);
+	}
+	return 1;
+}
+
+
 static int multVecQuat(lua_State* L)
 {
 	Vec3 v = LuaWrapper::checkArg<Vec3>(L, 1);
@@ -322,10 +572,74 @@ void registerUniverse(Universe* ctx, lua_State* L)
 }
 
 
+#ifdef LUMIX_LUAJIT
+// Engine.ffi.*, universe is g_universe; with LuaJIT these are called without lua_CFunction
+// marshalling, vectors are passed as float arrays, e.g. ffi.new("float[3]")
+extern "C" {
+
+
+LUMIX_SCRIPT_API void lumix_getEntityPosition(void* universe, int entity, float* pos)
+{
+	Vec3 p = static_cast<Universe*>(universe)->getPosition(entity);
+	pos[0] = p.x;
+	pos[1] = p.y;
+	pos[2] = p.z;
+}
+
+
+LUMIX_SCRIPT_API void lumix_setEntityPosition(void* universe, int entity, const float* pos)
+{
+	static_cast<Universe*>(universe)->setPosition(entity, pos[0], pos[1], pos[2]);
+}
+
+
+LUMIX_SCRIPT_API void lumix_getEntityRotation(void* universe, int entity, float* rot)
+{
+	Quat r = static_cast<Universe*>(universe)->getRotation(entity);
+	rot[0] = r.x;
+	rot[1] = r.y;
+	rot[2] = r.z;
+	rot[3] = r.w;
+}
+
+
+LUMIX_SCRIPT_API void lumix_setEntityRotation(void* universe, int entity, const float* rot)
+{
+	static_cast<Universe*>(universe)->setRotation(entity, rot[0], rot[1], rot[2], rot[3]);
+}
+
+
+// positions has 3 * count floats
+LUMIX_SCRIPT_API void lumix_setEntityPositions(void* universe,
+	const int* entities,
+	const float* positions,
+	int count)
+{
+	static_assert(sizeof(Vec3) == sizeof(float) * 3, "positions are reinterpreted as Vec3");
+	static_assert(sizeof(Entity) == sizeof(int), "entities are reinterpreted as Entity");
+	static_cast<Universe*>(universe)->setPositions(
+		(const Entity*)entities, (const Vec3*)positions, count);
+}
+
+
+} // extern "C"
+
+
+static const char* FFI_CDEFS =
+	"void lumix_getEntityPosition(void* universe, int entity, float* pos);\n"
+	"void lumix_setEntityPosition(void* universe, int entity, const float* pos);\n"
+	"void lumix_getEntityRotation(void* universe, int entity, float* rot);\n"
+	"void lumix_setEntityRotation(void* universe, int entity, const float* rot);\n"
+	"void lumix_setEntityPositions(void* universe, const int* entities, "
+	"const float* positions, int count);\n";
+#endif
+
+
 void registerEngineLuaAPI(LuaScriptScene& scene, Engine& engine, lua_State* L)
 {
 	lua_pushlightuserdata(L, &engine);
 	lua_setglobal(L, "g_engine");
+	LuaAPI::registerVec3(L);
 
 	#define REGISTER_FUNCTION(name) \
 		LuaWrapper::createSystemFunction(L, "Engine", #name, &LuaWrapper::wrap<decltype(&LuaAPI::name), LuaAPI::name>); \
@@ -351,8 +665,15 @@ void registerEngineLuaAPI(LuaScriptScene& scene, Engine& engine, lua_State* L)
 	LuaWrapper::createSystemFunction(L, "Engine", "multVecQuat", &LuaAPI::multVecQuat);
 	LuaWrapper::createSystemFunction(L, "Engine", "getEntityPosition", &LuaAPI::getEntityPosition);
 	LuaWrapper::createSystemFunction(L, "Engine", "getEntityDirection", &LuaAPI::getEntityDirection);
+	LuaWrapper::createSystemFunction(L, "Engine", "getEntityPositions", &LuaAPI::getEntityPositions);
+	LuaWrapper::createSystemFunction(L, "Engine", "setEntityPositions", &LuaAPI::setEntityPositions);
+	LuaWrapper::createSystemFunction(L, "Engine", "vec3", &LuaAPI::vec3New);
 
 	#undef REGISTER_FUNCTION
+
+#ifdef LUMIX_LUAJIT
+	LuaWrapper::createFFINamespace(L, "Engine", "lua_script", FFI_CDEFS);
+#endif
 }
 
 
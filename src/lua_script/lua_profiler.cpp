@@ -0,0 +1,129 @@
+#include "lua_script/lua_profiler.h"
+#include "core/crc32.h"
+#include "core/iallocator.h"
+#include "core/lua_compat.h"
+#include "core/profiler.h"
+#include "core/string.h"
+#include "core/timer.h"
+
+
+namespace Lumix
+{
+
+
+static const int SAMPLE_PERIOD = 4096; // instructions
+
+
+// hooks get no user data, only one call is profiled at a time
+static LuaProfiler* s_profiler = nullptr;
+
+
+LuaProfiler::LuaProfiler(IAllocator& allocator)
+	: m_allocator(allocator)
+	, m_function_map(allocator)
+	, m_functions(allocator)
+	, m_last_sample_time(0)
+	, m_current_function(-1)
+	, m_is_enabled(false)
+	, m_is_in_call(false)
+{
+	m_timer = Timer::create(m_allocator);
+}
+
+
+LuaProfiler::~LuaProfiler()
+{
+	for (auto& function : m_functions)
+	{
+		m_allocator.deallocate(function.name);
+	}
+	Timer::destroy(m_timer);
+}
+
+
+int LuaProfiler::getFunction(const lua_Debug& ar)
+{
+	char name[MAX_PATH_LENGTH + 64];
+	char line[20];
+	copyString(name, ar.short_src);
+	toCString(ar.linedefined, line, lengthOf(line));
+	catString(name, ":");
+	catString(name, line);
+	if (ar.name)
+	{
+		catString(name, " ");
+		catString(name, ar.name);
+	}
+
+	uint32 hash = crc32(name);
+	auto iter = m_function_map.find(hash);
+	if (iter.isValid()) return iter.value();
+
+	int len = stringLength(name);
+	Function& function = m_functions.emplace();
+	function.name = (char*)m_allocator.allocate(len + 1);
+	copyMemory(function.name, name, len + 1);
+	function.time = 0;
+	m_function_map.insert(hash, m_functions.size() - 1);
+	return m_functions.size() - 1;
+}
+
+
+void LuaProfiler::sample(int function)
+{
+	float now = m_timer->getTimeSinceStart();
+	m_functions[function].time += now - m_last_sample_time;
+	m_last_sample_time = now;
+	m_current_function = function;
+}
+
+
+void LuaProfiler::hook(lua_State* L, lua_Debug* ar)
+{
+	if (!s_profiler || !lua_getinfo(L, "Sn", ar)) return;
+	s_profiler->sample(s_profiler->getFunction(*ar));
+}
+
+
+void LuaProfiler::beginCall(lua_State* L)
+{
+	if (!m_is_enabled || m_is_in_call) return;
+
+	lua_Debug ar;
+	lua_pushvalue(L, -1);
+	if (!lua_getinfo(L, ">S", &ar)) return;
+	ar.name = nullptr;
+
+	m_is_in_call = true;
+	s_profiler = this;
+	m_current_function = getFunction(ar);
+	m_last_sample_time = m_timer->getTimeSinceStart();
+	lua_sethook(L, &hook, LUA_MASKCOUNT, SAMPLE_PERIOD);
+}
+
+
+void LuaProfiler::endCall(lua_State* L)
+{
+	if (!m_is_in_call) return;
+
+	lua_sethook(L, nullptr, 0, 0);
+	// the rest of the call since the last sample
+	sample(m_current_function);
+	s_profiler = nullptr;
+	m_is_in_call = false;
+}
+
+
+void LuaProfiler::frame()
+{
+	for (auto& function : m_functions)
+	{
+		if (function.time <= 0) continue;
+
+		Profiler::record(function.name, function.time * 1000);
+		function.time = 0;
+	}
+}
+
+
+} // namespace Lumix
@@ -0,0 +1,64 @@
+#pragma once
+
+
+#include "lumix.h"
+#include "core/array.h"
+#include "core/hash_map.h"
+
+
+struct lua_Debug;
+struct lua_State;
+
+
+namespace Lumix
+{
+
+
+class IAllocator;
+class Timer;
+
+
+// Sampling profiler for scripts. While enabled, a count hook on the called state samples the
+// running function every few thousand instructions, the time since the previous sample is
+// attributed to it. frame() records the summed times as values of the current profiler block.
+// When disabled, there is no hook and calls cost only a branch.
+class LuaProfiler
+{
+public:
+	explicit LuaProfiler(IAllocator& allocator);
+	~LuaProfiler();
+
+	void enable(bool enable) { m_is_enabled = enable; }
+	bool isEnabled() const { return m_is_enabled; }
+	// the function to be called is on the top of the stack
+	void beginCall(lua_State* L);
+	void endCall(lua_State* L);
+	// records the time of each function sampled since the last frame, in milliseconds
+	void frame();
+
+private:
+	struct Function
+	{
+		// "path:line function", it is a name of a profiler block, so it lives as long as this
+		char* name;
+		float time;
+	};
+
+private:
+	static void hook(lua_State* L, lua_Debug* ar);
+	int getFunction(const lua_Debug& ar);
+	void sample(int function);
+
+private:
+	IAllocator& m_allocator;
+	HashMap<uint32, int> m_function_map;
+	Array<Function> m_functions;
+	Timer* m_timer;
+	float m_last_sample_time;
+	int m_current_function;
+	bool m_is_enabled;
+	bool m_is_in_call;
+};
+
+
+} // namespace Lumix
@@ -16,6 +16,7 @@ LuaScript::LuaScript(const Path& path,
 	: Resource(path, resource_manager, allocator)
 	, m_source_code(allocator)
 	, m_properties(allocator)
+	, m_group(0)
 {
 }
 
@@ -30,16 +31,24 @@ void LuaScript::unload()
 {
 	m_properties.clear();
 	m_source_code = "";
+	m_group = 0;
 }
 
 
 const char* LuaScript::getPropertyName(uint32 hash) const
+{
+	const Property* property = getProperty(hash);
+	return property ? property->name : nullptr;
+}
+
+
+const LuaScript::Property* LuaScript::getProperty(uint32 hash) const
 {
 	for (auto& property : m_properties)
 	{
-		if (crc32(property.name) == hash)
+		if (property.name_hash == hash)
 		{
-			return property.name;
+			return &property;
 		}
 	}
 	return nullptr;
@@ -86,6 +95,7 @@ void LuaScript::parseProperties()
 
 		Property& property = m_properties.emplace();
 		token = getToken(token, property.name, sizeof(property.name));
+		property.name_hash = crc32(property.name);
 		char type[50];
 		token = getToken(token, type, sizeof(type));
 		if (compareString(type, "entity") == 0)
@@ -96,6 +106,14 @@ void LuaScript::parseProperties()
 		{
 			property.type = Property::FLOAT;
 		}
+		else if (compareString(type, "bool") == 0)
+		{
+			property.type = Property::BOOLEAN;
+		}
+		else if (compareString(type, "resource") == 0)
+		{
+			property.type = Property::RESOURCE;
+		}
 		else
 		{
 			property.type = Property::ANY;
@@ -106,11 +124,25 @@ void LuaScript::parseProperties()
 }
 
 
+void LuaScript::parseGroup()
+{
+	static const char* GROUP_MARK = "-- LUMIX GROUP";
+	m_group = 0;
+	const char* mark = findSubstring(m_source_code.c_str(), GROUP_MARK);
+	if (!mark) return;
+
+	char name[50];
+	getToken(mark + stringLength(GROUP_MARK), name, sizeof(name));
+	if (name[0]) m_group = crc32(name);
+}
+
+
 bool LuaScript::load(FS::IFile& file)
 {
 	m_properties.clear();
 	m_source_code.set((const char*)file.getBuffer(), (int)file.size());
 	parseProperties();
+	parseGroup();
 	m_size = file.size();
 	return true;
 }
@@ -17,10 +17,13 @@ public:
 	struct Property
 	{
 		char name[50];
+		uint32 name_hash;
 		enum Type
 		{
 			ENTITY,
 			FLOAT,
+			BOOLEAN,
+			RESOURCE,
 			ANY
 		};
 		Type type;
@@ -36,17 +39,23 @@ public:
 	bool load(FS::IFile& file) override;
 	const char* getSourceCode() const { return m_source_code.c_str(); }
 	const char* getPropertyName(uint32 hash) const;
+	const Property* getProperty(uint32 hash) const;
 	const Array<Property>& getProperties() const
 	{
 		return m_properties;
 	}
+	// hash of the name after "-- LUMIX GROUP", scripts of a group share a Lua state which is
+	// updated in parallel with other groups; 0 for scripts in the main state
+	uint32 getGroup() const { return m_group; }
 
 private:
 	void parseProperties();
+	void parseGroup();
 
 private:
 	string m_source_code;
 	Array<Property> m_properties;
+	uint32 m_group;
 };
 
 
@@ -3,15 +3,24 @@
 #include "core/base_proxy_allocator.h"
 #include "core/binary_array.h"
 #include "core/blob.h"
+#include "core/command_line_parser.h"
 #include "core/crc32.h"
+#include "core/mtjd/parallel_for.h"
 #include "core/fs/file_system.h"
 #include "core/fs/ifile.h"
 #include "core/iallocator.h"
+#include "core/input_system.h"
 #include "core/json_serializer.h"
 #include "core/log.h"
+#include "core/lua_allocator.h"
+#include "core/lua_bytecode_cache.h"
 #include "core/lua_wrapper.h"
 #include "core/path_utils.h"
+#include "core/profiler.h"
 #include "core/resource_manager.h"
+#include "core/system.h"
+#include "core/timer.h"
+#include "core/tracking_allocator.h"
 #include "debug/debug.h"
 #include "editor/asset_browser.h"
 #include "editor/ieditor_command.h"
@@ -24,9 +33,11 @@
 #include "engine/property_register.h"
 #include "engine/property_descriptor.h"
 #include "iplugin.h"
+#include "lua_script/lua_profiler.h"
 #include "lua_script/lua_script_manager.h"
 #include "plugin_manager.h"
 #include "universe/universe.h"
+#include <cstdlib>
 
 
 namespace Lumix
@@ -36,6 +47,7 @@ namespace Lumix
 	enum class LuaScriptVersion
 	{
 		MULTIPLE_SCRIPTS,
+		TYPED_PROPERTIES,
 
 		LATEST
 	};
@@ -48,6 +60,111 @@ namespace Lumix
 	static const uint32 LUA_SCRIPT_HASH = crc32("lua_script");
 
 
+	static LuaScriptScene::Property::Type getStoredType(LuaScript::Property::Type type)
+	{
+		switch (type)
+		{
+			case LuaScript::Property::FLOAT: return LuaScriptScene::Property::NUMBER;
+			case LuaScript::Property::BOOLEAN: return LuaScriptScene::Property::BOOLEAN;
+			case LuaScript::Property::ENTITY: return LuaScriptScene::Property::ENTITY;
+			case LuaScript::Property::RESOURCE: return LuaScriptScene::Property::RESOURCE;
+			default: return LuaScriptScene::Property::ANY;
+		}
+	}
+
+
+	// empty values stay ANY, they are not set to Lua
+	static void parseProperty(LuaScriptScene::Property& prop,
+		LuaScriptScene::Property::Type type,
+		const char* value)
+	{
+		typedef LuaScriptScene::Property Property;
+		prop.m_type = value[0] ? type : Property::ANY;
+		switch (prop.m_type)
+		{
+			case Property::NUMBER: prop.m_number = (float)atof(value); break;
+			case Property::BOOLEAN: prop.m_boolean = compareString(value, "true") == 0; break;
+			case Property::ENTITY:
+				if (!fromCString(value, stringLength(value), &prop.m_entity))
+				{
+					prop.m_entity = INVALID_ENTITY;
+				}
+				break;
+			default: prop.m_string = value; break;
+		}
+	}
+
+
+	// values kept as Lua code while the type was not known
+	static void parseLuaValue(LuaScriptScene::Property& prop, LuaScriptScene::Property::Type type)
+	{
+		char tmp[1024];
+		copyString(tmp, prop.m_string.c_str());
+		char* value = tmp;
+		int length = stringLength(tmp);
+		bool is_quoted = length >= 2 && tmp[0] == '"' && tmp[length - 1] == '"';
+		if (type == LuaScriptScene::Property::RESOURCE && is_quoted)
+		{
+			tmp[length - 1] = '\0';
+			++value;
+		}
+		prop.m_string = "";
+		parseProperty(prop, type, value);
+	}
+
+
+	static void formatProperty(const LuaScriptScene::Property& prop, char* out, int max_size)
+	{
+		typedef LuaScriptScene::Property Property;
+		switch (prop.m_type)
+		{
+			case Property::NUMBER: toCString(prop.m_number, out, max_size, 5); break;
+			case Property::BOOLEAN:
+				copyString(out, max_size, prop.m_boolean ? "true" : "false");
+				break;
+			case Property::ENTITY: toCString(prop.m_entity, out, max_size); break;
+			default: copyString(out, max_size, prop.m_string.c_str()); break;
+		}
+	}
+
+
+	static void serializeProperty(OutputBlob& blob, const LuaScriptScene::Property& prop)
+	{
+		typedef LuaScriptScene::Property Property;
+		blob.write(prop.m_name_hash);
+		blob.write(prop.m_type);
+		switch (prop.m_type)
+		{
+			case Property::NUMBER: blob.write(prop.m_number); break;
+			case Property::BOOLEAN: blob.write(prop.m_boolean); break;
+			case Property::ENTITY: blob.write(prop.m_entity); break;
+			default: blob.writeString(prop.m_string.c_str()); break;
+		}
+	}
+
+
+	static void deserializeProperty(InputBlob& blob, LuaScriptScene::Property& prop)
+	{
+		typedef LuaScriptScene::Property Property;
+		blob.read(prop.m_name_hash);
+		blob.read(prop.m_type);
+		switch (prop.m_type)
+		{
+			case Property::NUMBER: blob.read(prop.m_number); break;
+			case Property::BOOLEAN: blob.read(prop.m_boolean); break;
+			case Property::ENTITY: blob.read(prop.m_entity); break;
+			default:
+			{
+				char tmp[1024];
+				tmp[0] = 0;
+				blob.readString(tmp, sizeof(tmp));
+				prop.m_string = tmp;
+			}
+			break;
+		}
+	}
+
+
 	class LuaScriptSystemImpl : public IPlugin
 	{
 	public:
@@ -58,13 +175,17 @@ namespace Lumix
 		IScene* createScene(Universe& universe) override;
 		void destroyScene(IScene* scene) override;
 		bool create() override;
+		bool isCreatedInParallel() const override { return true; }
 		void destroy() override;
 		const char* getName() const override;
 		LuaScriptManager& getScriptManager() { return m_script_manager; }
 
 		Engine& m_engine;
+		TrackingAllocator m_tracking_allocator;
 		Debug::Allocator m_allocator;
 		LuaScriptManager m_script_manager;
+		// shared by all scenes, names of the profiler blocks must outlive them
+		LuaProfiler m_profiler;
 	};
 
 
@@ -73,10 +194,109 @@ namespace Lumix
 	public:
 		struct UpdateData
 		{
-			LuaScript* script;
 			lua_State* state;
+			// registry reference of the update function, resolved when the script is loaded
+			int function;
+			// identifies the script instance
 			int environment;
-			ComponentIndex cmp;
+			// update_interval of the script, 0 updates it every frame
+			float interval;
+			// since the last update of a script with an interval
+			float time;
+		};
+
+
+		struct EventArg
+		{
+			enum Type : uint8
+			{
+				INT,
+				FLOAT,
+				POINTER
+			};
+
+			Type type;
+			union
+			{
+				int i;
+				float f;
+				void* p;
+			};
+		};
+
+
+		struct Event
+		{
+			Entity entity;
+			// state and environment of the only script instance to call, nullptr and -1 call
+			// all scripts of the entity
+			lua_State* state;
+			int environment;
+			// keeps the order of the events of an entity when they are sorted
+			int index;
+			int first_arg;
+			int arg_count;
+			char function[32];
+		};
+
+
+		struct ScriptTimer
+		{
+			Entity entity;
+			int id;
+			float time;
+		};
+
+
+		struct InputListener
+		{
+			Entity entity;
+			uint32 action;
+			float value;
+		};
+
+
+		// recorded by scripts of a group during the parallel update, executed after it
+		struct GroupCommand
+		{
+			enum Type : uint8
+			{
+				SET_POSITION,
+				SET_ROTATION,
+				EVENT
+			};
+
+			Type type;
+			Entity entity;
+			float values[4];
+			EventArg args[4];
+			int arg_count;
+			char function[32];
+		};
+
+
+		// scripts with the same "-- LUMIX GROUP" share this state, groups are updated in parallel
+		// so a group can use only its Group API and not the engine's
+		struct ScriptGroup
+		{
+			explicit ScriptGroup(IAllocator& allocator)
+				: allocator(allocator)
+				, lua_allocator(allocator)
+				, updates(allocator)
+				, commands(allocator)
+				, errors(allocator)
+			{
+			}
+
+			IAllocator& allocator;
+			uint32 name_hash;
+			Universe* universe;
+			LuaAllocator lua_allocator;
+			lua_State* state;
+			Array<UpdateData> updates;
+			Array<GroupCommand> commands;
+			// the log is not thread safe, errors are logged with the commands
+			Array<string> errors;
 		};
 
 
@@ -87,10 +307,12 @@ namespace Lumix
 			{
 				m_script = nullptr;
 				m_state = nullptr;
+				m_group = nullptr;
 			}
 
 			LuaScript* m_script;
 			lua_State* m_state;
+			ScriptGroup* m_group;
 			int m_environment;
 			Array<Property> m_properties;
 		};
@@ -111,6 +333,7 @@ namespace Lumix
 				{
 					if ((!script.m_script || !script.m_script->isReady()) && script.m_state)
 					{
+						m_scene.removeUpdate(script);
 						luaL_unref(script.m_state, LUA_REGISTRYINDEX, script.m_environment);
 						script.m_state = nullptr;
 						continue;
@@ -122,7 +345,9 @@ namespace Lumix
 
 					script.m_environment = -1;
 
-					script.m_state = lua_newthread(m_scene.m_global_state);
+					script.m_group = m_scene.getScriptGroup(script.m_script->getGroup());
+					script.m_state = lua_newthread(
+						script.m_group ? script.m_group->state : m_scene.m_global_state);
 					lua_newtable(script.m_state);
 					// reference environment
 					lua_pushvalue(script.m_state, -1);
@@ -142,7 +367,8 @@ namespace Lumix
 					lua_pop(script.m_state, 1);
 
 					lua_rawgeti(script.m_state, LUA_REGISTRYINDEX, script.m_environment);
-					bool errors = luaL_loadbuffer(script.m_state,
+					auto& bytecode_cache = m_scene.m_system.m_engine.getLuaBytecodeCache();
+					bool errors = bytecode_cache.load(script.m_state,
 						script.m_script->getSourceCode(),
 						stringLength(script.m_script->getSourceCode()),
 						script.m_script->getPath().c_str()) != LUA_OK;
@@ -156,7 +382,7 @@ namespace Lumix
 					}
 
 					lua_pushvalue(script.m_state, -2);
-					lua_setupvalue(script.m_state, -2, 1); // function's environment
+					LuaWrapper::setEnvironment(script.m_state, -2);
 
 					errors = errors || lua_pcall(script.m_state, 0, LUA_MULTRET, 0) != LUA_OK;
 					if (errors)
@@ -166,6 +392,13 @@ namespace Lumix
 						lua_pop(script.m_state, 1);
 					}
 					lua_pop(script.m_state, 1);
+
+					// loaded while the game runs, e.g. reloaded or created by other scripts
+					if (m_scene.m_is_game_running)
+					{
+						m_scene.addUpdate(script);
+						m_scene.queueEvent(m_entity, script.m_state, script.m_environment, "init");
+					}
 				}
 			}
 
@@ -207,6 +440,31 @@ namespace Lumix
 		};
 
 
+		struct EventCall : IFunctionCall
+		{
+			void add(int parameter) override
+			{
+				scene->addEventArg(EventArg::INT).i = parameter;
+			}
+
+
+			void add(float parameter) override
+			{
+				scene->addEventArg(EventArg::FLOAT).f = parameter;
+			}
+
+
+			void add(void* parameter) override
+			{
+				scene->addEventArg(EventArg::POINTER).p = parameter;
+			}
+
+
+			LuaScriptSceneImpl* scene;
+			bool is_in_progress;
+		};
+
+
 	public:
 		LuaScriptSceneImpl(LuaScriptSystemImpl& system, Universe& ctx)
 			: m_system(system)
@@ -215,9 +473,23 @@ namespace Lumix
 			, m_scripts(system.getAllocator())
 			, m_updates(system.getAllocator())
 			, m_entity_script_map(system.getAllocator())
+			, m_events(system.getAllocator())
+			, m_event_args(system.getAllocator())
+			, m_dispatched_events(system.getAllocator())
+			, m_dispatched_event_args(system.getAllocator())
+			, m_timers(system.getAllocator())
+			, m_input_listeners(system.getAllocator())
+			, m_groups(system.getAllocator())
 		{
 			m_function_call.is_in_progress = false;
+			m_event_call.scene = this;
+			m_event_call.is_in_progress = false;
+			m_last_timer_id = 0;
 			m_is_api_registered = false;
+			m_is_game_running = false;
+			m_update_budget = 0.002f;
+			m_update_cursor = 0;
+			m_timer = Timer::create(system.getAllocator());
 		}
 
 
@@ -274,9 +546,492 @@ namespace Lumix
 		}
 
 
+		IFunctionCall* beginEvent(Entity entity, const char* function) override
+		{
+			ASSERT(!m_event_call.is_in_progress);
+
+			// nobody would handle it
+			if (!m_is_game_running || !m_entity_script_map.find(entity).isValid()) return nullptr;
+
+			queueEvent(entity, nullptr, -1, function);
+			m_event_call.is_in_progress = true;
+			return &m_event_call;
+		}
+
+
+		void endEvent(IFunctionCall& caller) override
+		{
+			ASSERT(&caller == &m_event_call);
+			ASSERT(m_event_call.is_in_progress);
+
+			m_event_call.is_in_progress = false;
+		}
+
+
+		void queueEvent(Entity entity, lua_State* state, int environment, const char* function)
+		{
+			ASSERT(!m_event_call.is_in_progress);
+
+			Event& event = m_events.emplace();
+			event.entity = entity;
+			event.state = state;
+			event.environment = environment;
+			event.index = m_events.size() - 1;
+			event.first_arg = m_event_args.size();
+			event.arg_count = 0;
+			ASSERT(stringLength(function) < lengthOf(event.function));
+			copyString(event.function, function);
+		}
+
+
+		EventArg& addEventArg(EventArg::Type type)
+		{
+			++m_events.back().arg_count;
+			EventArg& arg = m_event_args.emplace();
+			arg.type = type;
+			return arg;
+		}
+
+
+		static int compareEvents(const void* a, const void* b)
+		{
+			auto* event_a = static_cast<const Event*>(a);
+			auto* event_b = static_cast<const Event*>(b);
+			if (event_a->entity < event_b->entity) return -1;
+			if (event_a->entity > event_b->entity) return 1;
+			return event_a->index - event_b->index;
+		}
+
+
+		void pushEventArg(lua_State* state, const EventArg& arg)
+		{
+			switch (arg.type)
+			{
+				case EventArg::INT: lua_pushinteger(state, arg.i); break;
+				case EventArg::FLOAT: lua_pushnumber(state, arg.f); break;
+				case EventArg::POINTER: lua_pushlightuserdata(state, arg.p); break;
+				default: ASSERT(false); break;
+			}
+		}
+
+
+		// events of one entity, [begin, end) in m_dispatched_events
+		void dispatchEntityEvents(int begin, int end)
+		{
+			ComponentIndex cmp = getComponent(m_dispatched_events[begin].entity);
+			if (cmp == INVALID_COMPONENT) return;
+
+			ScriptComponent* script_cmp = m_scripts[cmp];
+			for (int i = 0; i < script_cmp->m_scripts.size(); ++i)
+			{
+				lua_State* state = script_cmp->m_scripts[i].m_state;
+				int environment = script_cmp->m_scripts[i].m_environment;
+				if (!state) continue;
+
+				lua_rawgeti(state, LUA_REGISTRYINDEX, environment);
+				for (int j = begin; j < end; ++j)
+				{
+					const Event& event = m_dispatched_events[j];
+					if (event.state && (event.state != state || event.environment != environment))
+					{
+						continue;
+					}
+					if (lua_getfield(state, -1, event.function) != LUA_TFUNCTION)
+					{
+						lua_pop(state, 1);
+						continue;
+					}
+
+					m_system.m_profiler.beginCall(state);
+					for (int k = 0; k < event.arg_count; ++k)
+					{
+						pushEventArg(state, m_dispatched_event_args[event.first_arg + k]);
+					}
+					if (lua_pcall(state, event.arg_count, 0, 0) != LUA_OK)
+					{
+						g_log_error.log("Lua Script") << lua_tostring(state, -1);
+						lua_pop(state, 1);
+					}
+					m_system.m_profiler.endCall(state);
+
+					// the handler destroyed the component or removed the script
+					if (m_scripts[cmp] != script_cmp || i >= script_cmp->m_scripts.size() ||
+						script_cmp->m_scripts[i].m_environment != environment)
+					{
+						lua_pop(state, 1);
+						return;
+					}
+				}
+				lua_pop(state, 1);
+			}
+		}
+
+
+		void dispatchEvents()
+		{
+			if (m_events.empty()) return;
+
+			PROFILE_FUNCTION();
+			// events queued by the handlers are dispatched in the next frame
+			m_events.swap(m_dispatched_events);
+			m_event_args.swap(m_dispatched_event_args);
+			int count = m_dispatched_events.size();
+			PROFILE_INT("script events", count);
+
+			// all events of a script are dispatched at once
+			qsort(&m_dispatched_events[0], count, sizeof(m_dispatched_events[0]), compareEvents);
+			for (int begin = 0; begin < count;)
+			{
+				int end = begin + 1;
+				Entity entity = m_dispatched_events[begin].entity;
+				while (end < count && m_dispatched_events[end].entity == entity) ++end;
+				dispatchEntityEvents(begin, end);
+				begin = end;
+			}
+			m_dispatched_events.clear();
+			m_dispatched_event_args.clear();
+		}
+
+
+		int setTimer(Entity entity, float seconds) override
+		{
+			ScriptTimer& timer = m_timers.emplace();
+			timer.entity = entity;
+			timer.id = ++m_last_timer_id;
+			timer.time = seconds;
+			return timer.id;
+		}
+
+
+		void cancelTimer(int timer) override
+		{
+			for (int i = 0; i < m_timers.size(); ++i)
+			{
+				if (m_timers[i].id != timer) continue;
+
+				m_timers.eraseFast(i);
+				return;
+			}
+		}
+
+
+		void updateTimers(float time_delta)
+		{
+			for (int i = m_timers.size() - 1; i >= 0; --i)
+			{
+				ScriptTimer& timer = m_timers[i];
+				timer.time -= time_delta;
+				if (timer.time > 0) continue;
+
+				queueEvent(timer.entity, nullptr, -1, "onTimer");
+				addEventArg(EventArg::INT).i = timer.id;
+				m_timers.eraseFast(i);
+			}
+		}
+
+
+		void addInputListener(Entity entity, uint32 action) override
+		{
+			for (auto& listener : m_input_listeners)
+			{
+				if (listener.entity == entity && listener.action == action) return;
+			}
+
+			InputListener& listener = m_input_listeners.emplace();
+			listener.entity = entity;
+			listener.action = action;
+			listener.value = m_system.m_engine.getInputSystem().getActionValue(action);
+		}
+
+
+		void removeInputListener(Entity entity, uint32 action) override
+		{
+			for (int i = 0; i < m_input_listeners.size(); ++i)
+			{
+				if (m_input_listeners[i].entity != entity) continue;
+				if (m_input_listeners[i].action != action) continue;
+
+				m_input_listeners.eraseFast(i);
+				return;
+			}
+		}
+
+
+		void updateInputListeners()
+		{
+			InputSystem& input = m_system.m_engine.getInputSystem();
+			for (auto& listener : m_input_listeners)
+			{
+				float value = input.getActionValue(listener.action);
+				if (value == listener.value) continue;
+
+				listener.value = value;
+				queueEvent(listener.entity, nullptr, -1, "onInputAction");
+				addEventArg(EventArg::INT).i = (int)listener.action;
+				addEventArg(EventArg::FLOAT).f = value;
+			}
+		}
+
+
+		void removeEntityEvents(Entity entity)
+		{
+			for (int i = m_timers.size() - 1; i >= 0; --i)
+			{
+				if (m_timers[i].entity == entity) m_timers.eraseFast(i);
+			}
+			for (int i = m_input_listeners.size() - 1; i >= 0; --i)
+			{
+				if (m_input_listeners[i].entity == entity) m_input_listeners.eraseFast(i);
+			}
+		}
+
+
+		static ScriptGroup& getGroupUpvalue(lua_State* L)
+		{
+			return *static_cast<ScriptGroup*>(lua_touserdata(L, lua_upvalueindex(1)));
+		}
+
+
+		// nothing writes to the universe during the parallel update, so reads are safe
+		static int LUA_groupGetEntityPosition(lua_State* L)
+		{
+			auto& group = getGroupUpvalue(L);
+			Entity entity = LuaWrapper::checkArg<Entity>(L, 1);
+			LuaWrapper::pushLua(L, group.universe->getPosition(entity));
+			return 1;
+		}
+
+
+		static int LUA_groupSetEntityPosition(lua_State* L)
+		{
+			auto& group = getGroupUpvalue(L);
+			Entity entity = LuaWrapper::checkArg<Entity>(L, 1);
+			Vec3 pos = LuaWrapper::checkArg<Vec3>(L, 2);
+
+			GroupCommand& cmd = group.commands.emplace();
+			cmd.type = GroupCommand::SET_POSITION;
+			cmd.entity = entity;
+			cmd.values[0] = pos.x;
+			cmd.values[1] = pos.y;
+			cmd.values[2] = pos.z;
+			return 0;
+		}
+
+
+		static int LUA_groupSetEntityRotation(lua_State* L)
+		{
+			auto& group = getGroupUpvalue(L);
+			Entity entity = LuaWrapper::checkArg<Entity>(L, 1);
+			Vec3 axis = LuaWrapper::checkArg<Vec3>(L, 2);
+			float angle = LuaWrapper::checkArg<float>(L, 3);
+
+			Quat rot(axis, angle);
+			GroupCommand& cmd = group.commands.emplace();
+			cmd.type = GroupCommand::SET_ROTATION;
+			cmd.entity = entity;
+			cmd.values[0] = rot.x;
+			cmd.values[1] = rot.y;
+			cmd.values[2] = rot.z;
+			cmd.values[3] = rot.w;
+			return 0;
+		}
+
+
+		// Group.postEvent(entity, function, ...) queues the event after the parallel update,
+		// this is how groups talk to each other and to the main state
+		static int LUA_groupPostEvent(lua_State* L)
+		{
+			auto& group = getGroupUpvalue(L);
+			Entity entity = LuaWrapper::checkArg<Entity>(L, 1);
+			const char* function = LuaWrapper::checkArg<const char*>(L, 2);
+
+			GroupCommand& cmd = group.commands.emplace();
+			cmd.type = GroupCommand::EVENT;
+			cmd.entity = entity;
+			copyString(cmd.function, function);
+			cmd.arg_count = toEventArgs(L, 3, cmd.args, lengthOf(cmd.args));
+			return 0;
+		}
+
+
+		// LuaScript.postEvent(scene, entity, function, ...) from the main state
+		static int LUA_postEvent(lua_State* L)
+		{
+			auto* scene = LuaWrapper::checkArg<LuaScriptSceneImpl*>(L, 1);
+			Entity entity = LuaWrapper::checkArg<Entity>(L, 2);
+			const char* function = LuaWrapper::checkArg<const char*>(L, 3);
+
+			EventArg args[4];
+			int arg_count = toEventArgs(L, 4, args, lengthOf(args));
+			if (!scene->m_entity_script_map.find(entity).isValid()) return 0;
+
+			scene->queueEvent(entity, nullptr, -1, function);
+			for (int i = 0; i < arg_count; ++i)
+			{
+				scene->addEventArg(args[i].type) = args[i];
+			}
+			return 0;
+		}
+
+
+		// numbers from first to the top of the stack, at most max_count
+		static int toEventArgs(lua_State* L, int first, EventArg* args, int max_count)
+		{
+			int count = Math::minValue(lua_gettop(L) - first + 1, max_count);
+			for (int i = 0; i < count; ++i)
+			{
+				EventArg& arg = args[i];
+				if (lua_isinteger(L, first + i))
+				{
+					arg.type = EventArg::INT;
+					arg.i = (int)lua_tointeger(L, first + i);
+				}
+				else
+				{
+					arg.type = EventArg::FLOAT;
+					arg.f = (float)luaL_checknumber(L, first + i);
+				}
+			}
+			return Math::maxValue(count, 0);
+		}
+
+
+		static void registerGroupFunction(ScriptGroup& group, const char* name, lua_CFunction f)
+		{
+			lua_pushlightuserdata(group.state, &group);
+			lua_pushcclosure(group.state, f, 1);
+			lua_setfield(group.state, -2, name);
+		}
+
+
+		ScriptGroup* getScriptGroup(uint32 name_hash)
+		{
+			if (name_hash == 0) return nullptr;
+
+			for (auto* group : m_groups)
+			{
+				if (group->name_hash == name_hash) return group;
+			}
+
+			auto* group = LUMIX_NEW(m_system.getAllocator(), ScriptGroup)(m_system.getAllocator());
+			group->name_hash = name_hash;
+			group->universe = &m_universe;
+#ifdef LUMIX_LUAJIT
+			group->state = luaL_newstate();
+#else
+			group->state = lua_newstate(&LuaAllocator::luaAlloc, &group->lua_allocator);
+#endif
+			luaL_openlibs(group->state);
+			lua_newtable(group->state);
+			registerGroupFunction(*group, "getEntityPosition", &LUA_groupGetEntityPosition);
+			registerGroupFunction(*group, "setEntityPosition", &LUA_groupSetEntityPosition);
+			registerGroupFunction(*group, "setEntityRotation", &LUA_groupSetEntityRotation);
+			registerGroupFunction(*group, "postEvent", &LUA_groupPostEvent);
+			lua_setglobal(group->state, "Group");
+			m_groups.push(group);
+			return group;
+		}
+
+
+		void destroyScriptGroups()
+		{
+			for (auto* group : m_groups)
+			{
+				lua_close(group->state);
+				LUMIX_DELETE(m_system.getAllocator(), group);
+			}
+			m_groups.clear();
+		}
+
+
+		// runs on a worker
+		static void updateScriptGroup(ScriptGroup& group, float time_delta)
+		{
+			for (auto& update : group.updates)
+			{
+				float script_time_delta = time_delta;
+				if (update.interval > 0)
+				{
+					update.time += time_delta;
+					if (update.time < update.interval) continue;
+					script_time_delta = update.time;
+					update.time = 0;
+				}
+
+				lua_rawgeti(update.state, LUA_REGISTRYINDEX, update.function);
+				lua_pushnumber(update.state, script_time_delta);
+				if (lua_pcall(update.state, 1, 0, 0) != LUA_OK)
+				{
+					group.errors.emplace(lua_tostring(update.state, -1), group.allocator);
+					lua_pop(update.state, 1);
+				}
+			}
+		}
+
+
+		void executeGroupCommands(ScriptGroup& group)
+		{
+			for (auto& error : group.errors)
+			{
+				g_log_error.log("Lua Script") << error.c_str();
+			}
+			group.errors.clear();
+
+			for (auto& cmd : group.commands)
+			{
+				switch (cmd.type)
+				{
+					case GroupCommand::SET_POSITION:
+						m_universe.setPosition(
+							cmd.entity, cmd.values[0], cmd.values[1], cmd.values[2]);
+						break;
+					case GroupCommand::SET_ROTATION:
+						m_universe.setRotation(
+							cmd.entity, cmd.values[0], cmd.values[1], cmd.values[2], cmd.values[3]);
+						break;
+					case GroupCommand::EVENT:
+						if (!m_entity_script_map.find(cmd.entity).isValid()) break;
+						queueEvent(cmd.entity, nullptr, -1, cmd.function);
+						for (int i = 0; i < cmd.arg_count; ++i)
+						{
+							addEventArg(cmd.args[i].type) = cmd.args[i];
+						}
+						break;
+					default: ASSERT(false); break;
+				}
+			}
+			group.commands.clear();
+		}
+
+
+		void updateScriptGroups(float time_delta)
+		{
+			if (m_groups.empty()) return;
+
+			PROFILE_FUNCTION();
+			MTJD::parallelFor(m_system.m_engine.getMTJDManager(),
+				0,
+				m_groups.size(),
+				1,
+				[this, time_delta](int from, int to)
+				{
+					for (int i = from; i < to; ++i)
+					{
+						updateScriptGroup(*m_groups[i], time_delta);
+					}
+				});
+			for (auto* group : m_groups)
+			{
+				executeGroupCommands(*group);
+			}
+		}
+
+
 		~LuaScriptSceneImpl()
 		{
 			unloadAllScripts();
+			destroyScriptGroups();
+			Timer::destroy(m_timer);
 		}
 
 		
@@ -313,6 +1068,25 @@ namespace Lumix
 			m_global_state = lua_newthread(m_system.m_engine.getState());
 			registerUniverse(&m_universe, m_global_state);
 			registerEngineLuaAPI(*this, m_system.m_engine, m_global_state);
+
+			#define REGISTER_FUNCTION(name) \
+				do {\
+					auto f = &LuaWrapper::wrapMethod<LuaScriptSceneImpl, \
+						decltype(&LuaScriptSceneImpl::name), \
+						&LuaScriptSceneImpl::name>; \
+					LuaWrapper::createSystemFunction(m_global_state, "LuaScript", #name, f); \
+				} while(false) \
+
+			REGISTER_FUNCTION(setTimer);
+			REGISTER_FUNCTION(cancelTimer);
+			REGISTER_FUNCTION(addInputListener);
+			REGISTER_FUNCTION(removeInputListener);
+
+			#undef REGISTER_FUNCTION
+
+			LuaWrapper::createSystemFunction(
+				m_global_state, "LuaScript", "postEvent", &LUA_postEvent);
+
 			uint32 register_msg = crc32("registerLuaAPI");
 			for (auto* i : m_universe.getScenes())
 			{
@@ -332,7 +1106,7 @@ namespace Lumix
 
 		void applyProperty(ScriptInstance& script, Property& prop)
 		{
-			if (prop.m_value.length() == 0) return;
+			if (prop.m_type == Property::ANY && prop.m_string.length() == 0) return;
 
 			lua_State* state = script.m_state;
 			const char* name = script.m_script->getPropertyName(prop.m_name_hash);
@@ -340,16 +1114,32 @@ namespace Lumix
 			{
 				return;
 			}
+
+			if (prop.m_type != Property::ANY)
+			{
+				lua_rawgeti(state, LUA_REGISTRYINDEX, script.m_environment);
+				switch (prop.m_type)
+				{
+					case Property::NUMBER: lua_pushnumber(state, prop.m_number); break;
+					case Property::BOOLEAN: lua_pushboolean(state, prop.m_boolean); break;
+					case Property::ENTITY: lua_pushinteger(state, prop.m_entity); break;
+					default: lua_pushstring(state, prop.m_string.c_str()); break;
+				}
+				lua_setfield(state, -2, name);
+				lua_pop(state, 1);
+				return;
+			}
+
 			char tmp[1024];
 			copyString(tmp, name);
 			catString(tmp, " = ");
-			catString(tmp, prop.m_value.c_str());
+			catString(tmp, prop.m_string.c_str());
 
 			bool errors =
 				luaL_loadbuffer(state, tmp, stringLength(tmp), nullptr) != LUA_OK;
 
 			lua_rawgeti(script.m_state, LUA_REGISTRYINDEX, script.m_environment);
-			lua_setupvalue(script.m_state, -2, 1);
+			LuaWrapper::setEnvironment(script.m_state, -2);
 
 			errors = errors || lua_pcall(state, 0, LUA_MULTRET, 0) != LUA_OK;
 
@@ -368,26 +1158,47 @@ namespace Lumix
 		}
 
 
-		const char* getPropertyValue(Lumix::ComponentIndex cmp, int scr_index, const char* name) const
+		const Property* getProperty(ComponentIndex cmp, int scr_index, uint32 name_hash) const
 		{
-			auto& script = *m_scripts[cmp];
-			uint32 hash = crc32(name);
-
-			for (auto& value : script.m_scripts[scr_index].m_properties)
+			for (auto& prop : m_scripts[cmp]->m_scripts[scr_index].m_properties)
 			{
-				if (value.m_name_hash == hash)
-				{
-					return value.m_value.c_str();
-				}
+				if (prop.m_name_hash == name_hash) return &prop;
 			}
+			return nullptr;
+		}
+
+
+		const Property* getProperty(ComponentIndex cmp, int scr_index, int index) const override
+		{
+			return getProperty(cmp, scr_index, crc32(getPropertyName(cmp, scr_index, index)));
+		}
 
-			return "";
+
+		void getPropertyValue(ComponentIndex cmp,
+			int scr_index,
+			const char* name,
+			char* out,
+			int max_size) const
+		{
+			const Property* prop = getProperty(cmp, scr_index, crc32(name));
+			if (prop)
+			{
+				formatProperty(*prop, out, max_size);
+			}
+			else
+			{
+				copyString(out, max_size, "");
+			}
 		}
 
 
-		const char* getPropertyValue(Lumix::ComponentIndex cmp, int scr_index, int index) const override
+		void getPropertyValue(ComponentIndex cmp,
+			int scr_index,
+			int index,
+			char* out,
+			int max_size) const override
 		{
-			return getPropertyValue(cmp, scr_index, getPropertyName(cmp, scr_index, index));
+			getPropertyValue(cmp, scr_index, getPropertyName(cmp, scr_index, index), out, max_size);
 		}
 
 
@@ -399,11 +1210,15 @@ namespace Lumix
 			if (!m_scripts[cmp]) return;
 
 			Property& prop = getScriptProperty(cmp, scr_index, name);
-			prop.m_value = value;
+			ScriptInstance& script = m_scripts[cmp]->m_scripts[scr_index];
+			const LuaScript::Property* declaration =
+				script.m_script ? script.m_script->getProperty(prop.m_name_hash) : nullptr;
+			parseProperty(
+				prop, declaration ? getStoredType(declaration->type) : Property::ANY, value);
 
-			if (m_scripts[cmp]->m_scripts[scr_index].m_state)
+			if (script.m_state)
 			{
-				applyProperty(m_scripts[cmp]->m_scripts[scr_index], prop);
+				applyProperty(script, prop);
 			}
 		}
 
@@ -430,6 +1245,14 @@ namespace Lumix
 
 			for (Property& prop : script.m_properties)
 			{
+				// set while the script was not loaded or loaded from an old version
+				const LuaScript::Property* declaration =
+					script.m_script->getProperty(prop.m_name_hash);
+				if (prop.m_type == Property::ANY && declaration)
+				{
+					Property::Type type = getStoredType(declaration->type);
+					if (type != Property::ANY) parseLuaValue(prop, type);
+				}
 				applyProperty(script, prop);
 			}
 		}
@@ -458,7 +1281,11 @@ namespace Lumix
 
 			if (inst.m_script)
 			{
-				if(inst.m_state) luaL_unref(inst.m_state, LUA_REGISTRYINDEX, inst.m_environment);
+				if (inst.m_state)
+				{
+					removeUpdate(inst);
+					luaL_unref(inst.m_state, LUA_REGISTRYINDEX, inst.m_environment);
+				}
 				inst.m_state = nullptr;
 				auto& cb = inst.m_script->getObserverCb();
 				cb.unbind<ScriptComponent, &ScriptComponent::onScriptLoaded>(&cmp);
@@ -474,24 +1301,95 @@ namespace Lumix
 		}
 
 
+		void addUpdate(ScriptInstance& inst)
+		{
+			lua_rawgeti(inst.m_state, LUA_REGISTRYINDEX, inst.m_environment);
+			if (lua_getfield(inst.m_state, -1, "update") != LUA_TFUNCTION)
+			{
+				lua_pop(inst.m_state, 2);
+				return;
+			}
+
+			auto& updates = inst.m_group ? inst.m_group->updates : m_updates;
+			auto& update_data = updates.emplace();
+			update_data.state = inst.m_state;
+			update_data.function = luaL_ref(inst.m_state, LUA_REGISTRYINDEX);
+			update_data.environment = inst.m_environment;
+			update_data.interval = 0;
+			update_data.time = 0;
+			// e.g. 0.1 for 10 Hz
+			if (lua_getfield(inst.m_state, -1, "update_interval") == LUA_TNUMBER)
+			{
+				update_data.interval = Math::maxValue(0.0f, (float)lua_tonumber(inst.m_state, -1));
+			}
+			lua_pop(inst.m_state, 2);
+		}
+
+
+		void setUpdateBudget(float seconds) override
+		{
+			m_update_budget = seconds;
+		}
+
+
+		float getUpdateBudget() const override
+		{
+			return m_update_budget;
+		}
+
+
+		void enableProfiler(bool enable) override
+		{
+			m_system.m_profiler.enable(enable);
+		}
+
+
+		bool isProfilerEnabled() const override
+		{
+			return m_system.m_profiler.isEnabled();
+		}
+
+
+		void callUpdate(int index, float time_delta)
+		{
+			lua_State* state = m_updates[index].state;
+			lua_rawgeti(state, LUA_REGISTRYINDEX, m_updates[index].function);
+			m_system.m_profiler.beginCall(state);
+			lua_pushnumber(state, time_delta);
+			if (lua_pcall(state, 1, 0, 0) != LUA_OK)
+			{
+				g_log_error.log("Lua Script") << lua_tostring(state, -1);
+				lua_pop(state, 1);
+			}
+			m_system.m_profiler.endCall(state);
+		}
+
+
+		// must be called before the environment of the instance is released
+		void removeUpdate(ScriptInstance& inst)
+		{
+			auto& updates = inst.m_group ? inst.m_group->updates : m_updates;
+			for (int i = updates.size() - 1; i >= 0; --i)
+			{
+				if (updates[i].environment != inst.m_environment) continue;
+
+				luaL_unref(updates[i].state, LUA_REGISTRYINDEX, updates[i].function);
+				updates.erase(i);
+			}
+		}
+
+
 		void startGame() override
 		{
+			m_is_game_running = true;
 			for (auto* scr : m_scripts)
 			{
 				if (!scr) continue;
 				for (auto& i : scr->m_scripts)
 				{
-					if (!i.m_script) continue;
+					if (!i.m_script || !i.m_state) continue;
 
-					lua_rawgeti(i.m_state, LUA_REGISTRYINDEX, i.m_environment);
-					if (lua_getfield(i.m_state, -1, "update") == LUA_TFUNCTION)
-					{
-						auto& update_data = m_updates.emplace();
-						update_data.script = i.m_script;
-						update_data.state = i.m_state;
-						update_data.environment = i.m_environment;
-					}
-					lua_pop(i.m_state, 1);
+					addUpdate(i);
 
 					lua_rawgeti(i.m_state, LUA_REGISTRYINDEX, i.m_environment);
 					if (lua_getfield(i.m_state, -1, "init") != LUA_TFUNCTION)
@@ -513,7 +1411,26 @@ namespace Lumix
 
 		void stopGame() override
 		{
+			for (auto& i : m_updates)
+			{
+				luaL_unref(i.state, LUA_REGISTRYINDEX, i.function);
+			}
 			m_updates.clear();
+			for (auto* group : m_groups)
+			{
+				for (auto& i : group->updates)
+				{
+					luaL_unref(i.state, LUA_REGISTRYINDEX, i.function);
+				}
+				group->updates.clear();
+				group->commands.clear();
+				group->errors.clear();
+			}
+			m_events.clear();
+			m_event_args.clear();
+			m_timers.clear();
+			m_input_listeners.clear();
+			m_is_game_running = false;
 		}
 
 
@@ -550,16 +1467,17 @@ namespace Lumix
 		{
 			if (type != LUA_SCRIPT_HASH) return;
 
-			for (int i = 0, c = m_updates.size(); i < c; ++i)
-			{
-				if(m_updates[i].cmp == component) m_updates.erase(i);
-			}
 			for (auto& scr : m_scripts[component]->m_scripts)
 			{
-				if (scr.m_state) luaL_unref(scr.m_state, LUA_REGISTRYINDEX, scr.m_environment);
+				if (scr.m_state)
+				{
+					removeUpdate(scr);
+					luaL_unref(scr.m_state, LUA_REGISTRYINDEX, scr.m_environment);
+				}
 				if (scr.m_script) m_system.getScriptManager().unload(*scr.m_script);
 			}
 			m_entity_script_map.erase(m_scripts[component]->m_entity);
+			removeEntityEvents(m_scripts[component]->m_entity);
 			auto* script = m_scripts[component];
 			m_scripts[component] = nullptr;
 			m_universe.destroyComponent(script->m_entity, type, this, component);
@@ -583,8 +1501,7 @@ namespace Lumix
 					serializer.write(scr.m_properties.size());
 					for (Property& prop : scr.m_properties)
 					{
-						serializer.write(prop.m_name_hash);
-						serializer.writeString(prop.m_value.c_str());
+						serializeProperty(serializer, prop);
 					}
 				}
 			}
@@ -604,6 +1521,7 @@ namespace Lumix
 				deserializeOld(serializer);
 				return;
 			}
+			bool is_typed = version > (int)LuaScriptVersion::TYPED_PROPERTIES;
 
 			int len = serializer.read<int>();
 			unloadAllScripts();
@@ -639,11 +1557,16 @@ namespace Lumix
 					for (int j = 0; j < prop_count; ++j)
 					{
 						Property& prop = scr.m_properties.emplace(m_system.getAllocator());
+						if (is_typed)
+						{
+							deserializeProperty(serializer, prop);
+							continue;
+						}
 						serializer.read(prop.m_name_hash);
 						char tmp[1024];
 						tmp[0] = 0;
 						serializer.readString(tmp, sizeof(tmp));
-						prop.m_value = tmp;
+						prop.m_string = tmp;
 					}
 				}
 				m_universe.addComponent(
@@ -687,7 +1610,7 @@ namespace Lumix
 					char tmp[1024];
 					tmp[0] = 0;
 					serializer.readString(tmp, sizeof(tmp));
-					prop.m_value = tmp;
+					prop.m_string = tmp;
 				}
 				m_universe.addComponent(m_scripts[i]->m_entity, LUA_SCRIPT_HASH, this, i);
 			}
@@ -701,23 +1624,47 @@ namespace Lumix
 		{
 			if (!m_global_state || paused) { return; }
 
-			for (auto& i : m_updates)
+			PROFILE_FUNCTION();
+			// scripts can destroy components, which removes their updates
+			for (int i = 0; i < m_updates.size(); ++i)
 			{
-				lua_rawgeti(i.state, LUA_REGISTRYINDEX, i.environment);
-				if (lua_getfield(i.state, -1, "update") != LUA_TFUNCTION)
+				if (m_updates[i].interval > 0)
 				{
-					lua_pop(i.state, 1);
+					m_updates[i].time += time_delta;
 					continue;
 				}
+				callUpdate(i, time_delta);
+			}
+
+			// scripts with an interval are updated round-robin until the budget is spent, the
+			// rest is the first to update in the next frame
+			float start = m_timer->getTimeSinceStart();
+			int count = m_updates.size();
+			int deferred = 0;
+			for (int i = 0; i < count && i < m_updates.size(); ++i)
+			{
+				int index = (m_update_cursor + i) % m_updates.size();
+				UpdateData& update = m_updates[index];
+				if (update.interval <= 0 || update.time < update.interval) continue;
 
-				lua_pushnumber(i.state, time_delta);
-				if (lua_pcall(i.state, 1, 0, 0) != LUA_OK)
+				if (m_timer->getTimeSinceStart() - start > m_update_budget)
 				{
-					g_log_error.log("Lua Script") << lua_tostring(i.state, -1);
-					lua_pop(i.state, 1);
+					if (deferred == 0) m_update_cursor = index;
+					++deferred;
+					continue;
 				}
-				lua_pop(i.state, 1);
+				float script_time_delta = update.time;
+				update.time = 0;
+				callUpdate(index, script_time_delta);
 			}
+			if (deferred == 0 && count > 0) m_update_cursor = (m_update_cursor + 1) % count;
+			PROFILE_INT("deferred script updates", deferred);
+
+			updateScriptGroups(time_delta);
+			updateTimers(time_delta);
+			updateInputListeners();
+			dispatchEvents();
+			m_system.m_profiler.frame();
 		}
 
 
@@ -802,10 +1749,9 @@ namespace Lumix
 			auto& scr = m_scripts[cmp]->m_scripts[scr_index];
 			blob.writeString(scr.m_script ? scr.m_script->getPath().c_str() : "");
 			blob.write(scr.m_properties.size());
-			for (auto prop : scr.m_properties)
+			for (auto& prop : scr.m_properties)
 			{
-				blob.write(prop.m_name_hash);
-				blob.writeString(prop.m_value.c_str());
+				serializeProperty(blob, prop);
 			}
 		}
 
@@ -822,9 +1768,7 @@ namespace Lumix
 			for (int i = 0; i < count; ++i)
 			{
 				auto& prop = scr.m_properties.emplace(m_system.m_allocator);
-				blob.read(prop.m_name_hash);
-				blob.readString(buf, lengthOf(buf));
-				prop.m_value = buf;
+				deserializeProperty(blob, prop);
 			}
 		}
 
@@ -838,17 +1782,40 @@ namespace Lumix
 		Universe& m_universe;
 		Array<UpdateData> m_updates;
 		FunctionCall m_function_call;
+		EventCall m_event_call;
+		Array<Event> m_events;
+		Array<EventArg> m_event_args;
+		Array<Event> m_dispatched_events;
+		Array<EventArg> m_dispatched_event_args;
+		Array<ScriptTimer> m_timers;
+		int m_last_timer_id;
+		Array<InputListener> m_input_listeners;
+		Array<ScriptGroup*> m_groups;
 		bool m_is_api_registered;
+		bool m_is_game_running;
+		float m_update_budget;
+		int m_update_cursor;
+		Timer* m_timer;
 	};
 
 
 	LuaScriptSystemImpl::LuaScriptSystemImpl(Engine& engine)
 		: m_engine(engine)
-		, m_allocator(engine.getAllocator())
+		, m_tracking_allocator(engine.getAllocator(), "lua_script")
+		, m_allocator(m_tracking_allocator)
 		, m_script_manager(m_allocator)
+		, m_profiler(m_allocator)
 	{
 		m_script_manager.create(crc32("lua_script"), engine.getResourceManager());
 
+		char cmd_line[2048];
+		getCommandLine(cmd_line, lengthOf(cmd_line));
+		CommandLineParser parser(cmd_line);
+		while (parser.next())
+		{
+			if (parser.currentEquals("-lua_profiler")) m_profiler.enable(true);
+		}
+
 		PropertyRegister::registerComponentType("lua_script", "Lua script");
 	}
 
@@ -1076,7 +2043,10 @@ namespace Lumix
 				}
 				else
 				{
-					old_value = scene->getPropertyValue(component, script_index, property_name);
+					char tmp[1024];
+					scene->getPropertyValue(
+						component, script_index, property_name, tmp, sizeof(tmp));
+					old_value = tmp;
 				}
 			}
 
@@ -1223,13 +2193,17 @@ namespace Lumix
 					for (int i = 0; i < scene->getPropertyCount(cmp.index, j); ++i)
 					{
 						char buf[256];
-						Lumix::copyString(buf, scene->getPropertyValue(cmp.index, j, i));
 						const char* property_name = scene->getPropertyName(cmp.index, j, i);
+						// values of the declared type are shown without parsing
+						const auto* prop = scene->getProperty(cmp.index, j, i);
+						auto stored_type = getStoredType(script_res->getProperties()[i].type);
+						bool is_typed = prop && prop->m_type == stored_type;
+						if (!is_typed) scene->getPropertyValue(cmp.index, j, i, buf, sizeof(buf));
 						switch (script_res->getProperties()[i].type)
 						{
 						case Lumix::LuaScript::Property::FLOAT:
 						{
-							float f = (float)atof(buf);
+							float f = is_typed ? prop->m_number : (float)atof(buf);
 							if (ImGui::DragFloat(property_name, &f))
 							{
 								Lumix::toCString(f, buf, sizeof(buf), 5);
@@ -1238,10 +2212,28 @@ namespace Lumix
 							}
 						}
 						break;
+						case Lumix::LuaScript::Property::BOOLEAN:
+						{
+							bool b = is_typed ? prop->m_boolean : compareString(buf, "true") == 0;
+							if (ImGui::Checkbox(property_name, &b))
+							{
+								Lumix::copyString(buf, b ? "true" : "false");
+								auto* cmd = LUMIX_NEW(allocator, SetPropertyCommand)(scene, cmp.index, j, property_name, buf, allocator);
+								editor.executeCommand(cmd);
+							}
+						}
+						break;
 						case Lumix::LuaScript::Property::ENTITY:
 						{
-							Lumix::Entity e;
-							Lumix::fromCString(buf, sizeof(buf), &e);
+							Lumix::Entity e = Lumix::INVALID_ENTITY;
+							if (is_typed)
+							{
+								e = prop->m_entity;
+							}
+							else
+							{
+								Lumix::fromCString(buf, sizeof(buf), &e);
+							}
 							if (grid.entityInput(
 								property_name, StringBuilder<50>(property_name, cmp.index), e))
 							{
@@ -1251,7 +2243,9 @@ namespace Lumix
 							}
 						}
 						break;
+						case Lumix::LuaScript::Property::RESOURCE:
 						case Lumix::LuaScript::Property::ANY:
+							if (is_typed) Lumix::copyString(buf, prop->m_string.c_str());
 							if (ImGui::InputText(property_name, buf, sizeof(buf)))
 							{
 								auto* cmd = LUMIX_NEW(allocator, SetPropertyCommand)(scene, cmp.index, j, property_name, buf, allocator);
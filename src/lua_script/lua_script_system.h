@@ -19,15 +19,37 @@ class LuaScript;
 class LuaScriptScene : public IScene
 {
 public:
+	// values of properties are stored with the type declared in the script, so they are
+	// serialized and set to Lua without string conversions
 	struct Property
 	{
+		enum Type : uint8
+		{
+			NUMBER,
+			BOOLEAN,
+			ENTITY,
+			// path, a string in Lua
+			RESOURCE,
+			// Lua code, also values set while the script is not loaded
+			ANY
+		};
+
 		explicit Property(IAllocator& allocator)
-			: m_value(allocator)
+			: m_string(allocator)
+			, m_type(ANY)
 		{
 		}
 
-		string m_value;
 		uint32 m_name_hash;
+		Type m_type;
+		union
+		{
+			float m_number;
+			bool m_boolean;
+			Entity m_entity;
+		};
+		// RESOURCE and ANY
+		string m_string;
 	};
 
 	class IFunctionCall
@@ -46,8 +68,16 @@ public:
 	virtual void setScriptPath(ComponentIndex cmp, int scr_index, const Path& path) = 0;
 	virtual int getPropertyCount(ComponentIndex cmp, int scr_index) const = 0;
 	virtual const char* getPropertyName(ComponentIndex cmp, int scr_index, int prop_index) const = 0;
-	virtual const char* getPropertyValue(ComponentIndex cmp, int scr_index, int prop_index) const = 0;
+	// the value formatted as a string
+	virtual void getPropertyValue(ComponentIndex cmp,
+		int scr_index,
+		int prop_index,
+		char* out,
+		int max_size) const = 0;
+	// nullptr if the property is not set
+	virtual const Property* getProperty(ComponentIndex cmp, int scr_index, int prop_index) const = 0;
 	virtual LuaScript* getScriptResource(ComponentIndex cmp, int scr_index) const = 0;
+	// the value is parsed as the type declared in the script
 	virtual void setPropertyValue(ComponentIndex cmp,
 		int scr_index,
 		const char* name,
@@ -58,6 +88,27 @@ public:
 	virtual void endFunctionCall(IFunctionCall& caller) = 0;
 	virtual int getScriptCount(ComponentIndex cmp) = 0;
 	virtual lua_State* getGlobalState() = 0;
+	// scripts with update_interval in their environment are updated at most that often, they
+	// are updated until the budget in seconds is spent and the rest waits for the next frame;
+	// scripts without an interval are updated every frame regardless of the budget
+	virtual void setUpdateBudget(float seconds) = 0;
+	virtual float getUpdateBudget() const = 0;
+	// samples script functions during updates and shows their times under the update block
+	// in the profiler, -lua_profiler on the command line enables it at start
+	virtual void enableProfiler(bool enable) = 0;
+	virtual bool isProfilerEnabled() const = 0;
+	// like beginFunctionCall, but the call is queued and called in every script of the entity
+	// which has the function; queued events are dispatched once a frame after the updates,
+	// all events of a script at once, e.g. onContact from the physics
+	virtual IFunctionCall* beginEvent(Entity entity, const char* function) = 0;
+	virtual void endEvent(IFunctionCall& caller) = 0;
+	// onTimer(id) is called in the scripts of the entity once the time in seconds elapses
+	virtual int setTimer(Entity entity, float seconds) = 0;
+	virtual void cancelTimer(int timer) = 0;
+	// onInputAction(action, value) is called in the scripts of the entity when the value of
+	// the input action changes
+	virtual void addInputListener(Entity entity, uint32 action) = 0;
+	virtual void removeInputListener(Entity entity, uint32 action) = 0;
 };
 
 
@@ -1,7 +1,12 @@
 #include "physics_geometry_manager.h"
+#include "core/array.h"
+#include "core/crc32.h"
 #include "core/fs/file_system.h"
 #include "core/fs/ifile.h"
+#include "core/fs/os_file.h"
+#include "core/log.h"
 #include "core/resource_manager.h"
+#include "core/string.h"
 #include "core/vec.h"
 #include "physics/physics_system.h"
 #include <PxPhysicsAPI.h>
@@ -11,6 +16,34 @@ namespace Lumix
 {
 
 
+	static const uint32 COOKED_MAGIC = 0x434c5046; // 'FPLC'
+
+
+	// prefix of a cooked mesh stream in the cache
+	struct CookedHeader
+	{
+		uint32 magic;
+		uint32 physx_version;
+		uint32 source_hash;
+		uint32 is_convex;
+		uint32 size;
+	};
+
+
+	static uint32 hashFile(FS::IFile& file, IAllocator& allocator)
+	{
+		if (file.getBuffer()) return crc32(file.getBuffer(), (int)file.size());
+
+		size_t pos = file.pos();
+		Array<uint8> data(allocator);
+		data.resize((int)file.size());
+		file.seek(FS::SeekMode::BEGIN, 0);
+		if (!data.empty()) file.read(&data[0], data.size());
+		file.seek(FS::SeekMode::BEGIN, pos);
+		return data.empty() ? 0 : crc32(&data[0], data.size());
+	}
+
+
 	struct OutputStream : public physx::PxOutputStream
 	{
 		explicit OutputStream(IAllocator& allocator)
@@ -83,6 +116,17 @@ namespace Lumix
 	};
 
 
+	void PhysicsGeometryManager::setCacheDirectory(const char* path)
+	{
+		copyString(m_cache_dir, path);
+		int len = stringLength(m_cache_dir);
+		if (len > 0 && m_cache_dir[len - 1] != '/' && m_cache_dir[len - 1] != '\\')
+		{
+			catString(m_cache_dir, "/");
+		}
+	}
+
+
 	Resource* PhysicsGeometryManager::createResource(const Path& path)
 	{
 		return LUMIX_NEW(m_allocator, PhysicsGeometry)(path, getOwner(), m_allocator);
@@ -119,6 +163,15 @@ namespace Lumix
 
 		auto* phy_manager = m_resource_manager.get(ResourceManager::PHYSICS);
 		PhysicsSystem& system = static_cast<PhysicsGeometryManager*>(phy_manager)->getSystem();
+		m_is_convex = header.m_convex != 0;
+
+		bool is_cached = static_cast<PhysicsGeometryManager*>(phy_manager)->getCacheDirectory()[0];
+		uint32 source_hash = is_cached ? hashFile(file, getAllocator()) : 0;
+		if (is_cached && loadCooked(source_hash))
+		{
+			m_size = file.size();
+			return true;
+		}
 
 		uint32 num_verts;
 		Array<Vec3> verts(getAllocator());
@@ -126,7 +179,6 @@ namespace Lumix
 		verts.resize(num_verts);
 		file.read(&verts[0], sizeof(verts[0]) * verts.size());
 
-		m_is_convex = header.m_convex != 0;
 		if (!m_is_convex)
 		{
 			physx::PxTriangleMeshGeometry* geom =
@@ -149,6 +201,7 @@ namespace Lumix
 
 			OutputStream writeBuffer(getAllocator());
 			system.getCooking()->cookTriangleMesh(meshDesc, writeBuffer);
+			if (is_cached) storeCooked(source_hash, writeBuffer.data, writeBuffer.size);
 
 			InputStream readBuffer(writeBuffer.data, writeBuffer.size);
 			geom->triangleMesh = system.getPhysics()->createTriangleMesh(readBuffer);
@@ -172,6 +225,7 @@ namespace Lumix
 				m_geometry = nullptr;
 				return false;
 			}
+			if (is_cached) storeCooked(source_hash, writeBuffer.data, writeBuffer.size);
 
 			InputStream readBuffer(writeBuffer.data, writeBuffer.size);
 			physx::PxConvexMesh* mesh = system.getPhysics()->createConvexMesh(readBuffer);
@@ -183,6 +237,90 @@ namespace Lumix
 	}
 
 
+	void PhysicsGeometry::getCachePath(uint32 source_hash, char (&cache_path)[MAX_PATH_LENGTH])
+	{
+		auto* manager = static_cast<PhysicsGeometryManager*>(
+			m_resource_manager.get(ResourceManager::PHYSICS));
+		char tmp[20];
+		copyString(cache_path, manager->getCacheDirectory());
+		toCString(getPath().getHash(), tmp, lengthOf(tmp));
+		catString(cache_path, tmp);
+		catString(cache_path, "_");
+		toCString(source_hash, tmp, lengthOf(tmp));
+		catString(cache_path, tmp);
+		catString(cache_path, ".cooked");
+	}
+
+
+	bool PhysicsGeometry::loadCooked(uint32 source_hash)
+	{
+		char cache_path[MAX_PATH_LENGTH];
+		getCachePath(source_hash, cache_path);
+		FS::OsFile file;
+		if (!file.open(cache_path, FS::Mode::OPEN_AND_READ, getAllocator())) return false;
+
+		CookedHeader header;
+		Array<uint8> data(getAllocator());
+		bool success = file.read(&header, sizeof(header)) && header.magic == COOKED_MAGIC &&
+					   header.physx_version == PX_PHYSICS_VERSION &&
+					   header.source_hash == source_hash &&
+					   header.is_convex == (m_is_convex ? 1U : 0U) &&
+					   // a file which was not written completely has a different size
+					   file.size() == sizeof(header) + header.size && header.size > 0;
+		if (success)
+		{
+			data.resize(header.size);
+			success = file.read(&data[0], data.size());
+		}
+		file.close();
+		if (!success) return false;
+
+		auto* manager = static_cast<PhysicsGeometryManager*>(
+			m_resource_manager.get(ResourceManager::PHYSICS));
+		physx::PxPhysics* physics = manager->getSystem().getPhysics();
+		InputStream read_buffer(&data[0], data.size());
+		if (m_is_convex)
+		{
+			physx::PxConvexMesh* mesh = physics->createConvexMesh(read_buffer);
+			if (!mesh) return false;
+			auto* geom = LUMIX_NEW(getAllocator(), physx::PxConvexMeshGeometry)();
+			geom->convexMesh = mesh;
+			m_geometry = geom;
+			return true;
+		}
+
+		physx::PxTriangleMesh* mesh = physics->createTriangleMesh(read_buffer);
+		if (!mesh) return false;
+		auto* geom = LUMIX_NEW(getAllocator(), physx::PxTriangleMeshGeometry)();
+		geom->triangleMesh = mesh;
+		m_geometry = geom;
+		return true;
+	}
+
+
+	void PhysicsGeometry::storeCooked(uint32 source_hash, const void* data, int size)
+	{
+		char cache_path[MAX_PATH_LENGTH];
+		getCachePath(source_hash, cache_path);
+		FS::OsFile file;
+		if (!file.open(cache_path, FS::Mode::CREATE | FS::Mode::WRITE, getAllocator()))
+		{
+			g_log_warning.log("Physics") << "Could not write cooked mesh " << cache_path;
+			return;
+		}
+
+		CookedHeader header;
+		header.magic = COOKED_MAGIC;
+		header.physx_version = PX_PHYSICS_VERSION;
+		header.source_hash = source_hash;
+		header.is_convex = m_is_convex ? 1 : 0;
+		header.size = (uint32)size;
+		file.write(&header, sizeof(header));
+		file.write(data, size);
+		file.close();
+	}
+
+
 	IAllocator& PhysicsGeometry::getAllocator()
 	{
 		return static_cast<PhysicsGeometryManager*>(m_resource_manager.get(ResourceManager::PHYSICS))->getAllocator();
@@ -26,10 +26,16 @@ class LUMIX_PHYSICS_API PhysicsGeometryManager : public ResourceManagerBase
 			: ResourceManagerBase(allocator)
 			, m_allocator(allocator)
 			, m_system(system)
-		{}
+		{
+			m_cache_dir[0] = '\0';
+		}
 		~PhysicsGeometryManager() {}
 		IAllocator& getAllocator() { return m_allocator; }
 		PhysicsSystem& getSystem() { return m_system; }
+		// cooked meshes are stored in the directory, which must exist, and loaded from it if the
+		// source and the PhysX version did not change; empty path disables the cache
+		void setCacheDirectory(const char* path);
+		const char* getCacheDirectory() const { return m_cache_dir; }
 
 	protected:
 		Resource* createResource(const Path& path) override;
@@ -38,6 +44,7 @@ class LUMIX_PHYSICS_API PhysicsGeometryManager : public ResourceManagerBase
 	private:
 		IAllocator& m_allocator;
 		PhysicsSystem& m_system;
+		char m_cache_dir[MAX_PATH_LENGTH];
 };
 
 
@@ -67,6 +74,9 @@ class LUMIX_PHYSICS_API PhysicsGeometry : public Resource
 
 	private:
 		IAllocator& getAllocator();
+		void getCachePath(uint32 source_hash, char (&cache_path)[MAX_PATH_LENGTH]);
+		bool loadCooked(uint32 source_hash);
+		void storeCooked(uint32 source_hash, const void* data, int size);
 
 		void unload(void) override;
 		bool load(FS::IFile& file) override;
@@ -8,6 +8,11 @@
 #include "core/log.h"
 #include "core/lua_wrapper.h"
 #include "core/matrix.h"
+#include "core/mt/atomic.h"
+#include "core/MTJD/generic_job.h"
+#include "core/MTJD/manager.h"
+#include "core/MTJD/parallel_for.h"
+#include "core/mt/thread.h"
 #include "core/path.h"
 #include "core/profiler.h"
 #include "core/resource_manager.h"
@@ -18,6 +23,7 @@
 #include "renderer/texture.h"
 #include "physics/physics_system.h"
 #include "physics/physics_geometry_manager.h"
+#include "universe/entity_map.h"
 #include "universe/universe.h"
 #include <PxPhysicsAPI.h>
 
@@ -125,11 +131,36 @@ static void matrix2Transform(const Matrix& mtx, physx::PxTransform& transform)
 }
 
 
+// dynamic actors checked against the simulation region each frame
+static const int SIMULATION_REGION_BATCH = 1024;
+// samples of a tile along x and z, neighbouring tiles share their border samples
+static const int HEIGHTFIELD_TILE_SIZE = 257;
+
+
+struct HeightfieldTile
+{
+	// attached to the actor of the terrain
+	physx::PxShape* shape;
+	// created by a job, taken on the main thread once is_ready is set
+	physx::PxHeightField* heightfield;
+	volatile int32 is_ready;
+	bool is_building;
+	// changed while it was built, it is built again when the job finishes
+	bool is_dirty;
+	int x;
+	int y;
+	int width;
+	int height;
+};
+
+
 struct Heightfield
 {
-	Heightfield();
+	explicit Heightfield(IAllocator& allocator);
 	~Heightfield();
 	void heightmapLoaded(Resource::State, Resource::State new_state);
+	// only the tiles in the edited rectangle are rebuilt
+	void heightmapUpdated(int x, int y, int w, int h);
 
 	struct PhysicsSceneImpl* m_scene;
 	Entity m_entity;
@@ -138,6 +169,69 @@ struct Heightfield
 	float m_xz_scale;
 	float m_y_scale;
 	int m_layer;
+	Array<HeightfieldTile> m_tiles;
+	int m_tiles_x;
+	int m_tiles_y;
+	int m_building_count;
+	volatile int32 m_running_jobs;
+};
+
+
+// converts samples of the tile from the heightmap, called from jobs
+static physx::PxHeightField* createTileHeightField(const Texture& heightmap,
+	const HeightfieldTile& tile,
+	physx::PxPhysics& physics,
+	IAllocator& allocator)
+{
+	PROFILE_FUNCTION();
+	Array<physx::PxHeightFieldSample> samples(allocator);
+	samples.resize(tile.width * tile.height);
+	int width = heightmap.getWidth();
+	int bytes_per_pixel = heightmap.getBytesPerPixel();
+	const uint8* data = heightmap.getData();
+	const uint16* data16 = (const uint16*)data;
+	// rows go along x, columns along z
+	for (int i = 0; i < tile.width; ++i)
+	{
+		for (int j = 0; j < tile.height; ++j)
+		{
+			physx::PxHeightFieldSample& sample = samples[i * tile.height + j];
+			int pixel = tile.x + i + (tile.y + j) * width;
+			sample.height = bytes_per_pixel == 2 ? data16[pixel] : data[pixel * bytes_per_pixel];
+			sample.materialIndex0 = sample.materialIndex1 = 0;
+			sample.setTessFlag();
+		}
+	}
+
+	physx::PxHeightFieldDesc desc;
+	desc.format = physx::PxHeightFieldFormat::eS16_TM;
+	desc.nbRows = tile.width;
+	desc.nbColumns = tile.height;
+	desc.samples.data = &samples[0];
+	desc.samples.stride = sizeof(physx::PxHeightFieldSample);
+	desc.thickness = -1;
+	return physics.createHeightField(desc);
+}
+
+
+// the layer of a shape is in the word0 of its simulation filter data
+struct LayerQueryFilter : public physx::PxQueryFilterCallback
+{
+	physx::PxQueryHitType::Enum preFilter(const physx::PxFilterData& filter_data,
+		const physx::PxShape* shape,
+		const physx::PxRigidActor*,
+		physx::PxHitFlags&) override
+	{
+		bool is_in_layers = (shape->getSimulationFilterData().word0 & filter_data.word0) != 0;
+		return is_in_layers ? physx::PxQueryHitType::eBLOCK : physx::PxQueryHitType::eNONE;
+	}
+
+
+	physx::PxQueryHitType::Enum postFilter(const physx::PxFilterData&,
+		const physx::PxQueryHit&) override
+	{
+		return physx::PxQueryHitType::eBLOCK;
+	}
 };
 
 
@@ -172,7 +266,24 @@ struct PhysicsSceneImpl : public PhysicsScene
 		}
 
 
-		void onTrigger(physx::PxTriggerPair* pairs, physx::PxU32 count) override {}
+		void onTrigger(physx::PxTriggerPair* pairs, physx::PxU32 count) override
+		{
+			for (physx::PxU32 i = 0; i < count; i++)
+			{
+				const auto& pair = pairs[i];
+				const physx::PxTriggerPairFlags removed_flags =
+					physx::PxTriggerPairFlag::eREMOVED_SHAPE_TRIGGER |
+					physx::PxTriggerPairFlag::eREMOVED_SHAPE_OTHER;
+				if (pair.flags & removed_flags) continue;
+
+				auto trigger = (Entity)(intptr_t)pair.triggerActor->userData;
+				auto other = (Entity)(intptr_t)pair.otherActor->userData;
+				bool is_enter = pair.status == physx::PxPairFlag::eNOTIFY_TOUCH_FOUND;
+				m_scene.onTrigger(trigger, other, is_enter);
+			}
+		}
+
+
 		void onConstraintBreak(physx::PxConstraintInfo*, physx::PxU32) override {}
 		void onWake(physx::PxActor**, physx::PxU32) override {}
 		void onSleep(physx::PxActor**, physx::PxU32) override {}
@@ -199,6 +310,8 @@ struct PhysicsSceneImpl : public PhysicsScene
 			, m_scene(scene)
 			, m_is_dynamic(false)
 			, m_layer(0)
+			, m_active_step(0)
+			, m_is_frozen(false)
 		{
 		}
 
@@ -212,6 +325,17 @@ struct PhysicsSceneImpl : public PhysicsScene
 		void setDynamic(bool dynamic) { m_is_dynamic = dynamic; }
 		int getLayer() const { return m_layer; }
 		void setLayer(int layer) { m_layer = layer; }
+		// the pose is not interpolated from the previous one, e.g. after a teleport
+		void resetPose();
+
+		// poses after the last two steps the actor was active in, kept for the interpolation
+		Vec3 m_position;
+		Quat m_rotation;
+		Vec3 m_previous_position;
+		Quat m_previous_rotation;
+		uint32 m_active_step;
+		// kinematic because it is outside of the simulation region
+		bool m_is_frozen;
 
 	private:
 		void onStateChanged(Resource::State old_state, Resource::State new_state);
@@ -229,14 +353,37 @@ struct PhysicsSceneImpl : public PhysicsScene
 	PhysicsSceneImpl(Universe& context, IAllocator& allocator)
 		: m_allocator(allocator)
 		, m_controllers(m_allocator)
+		, m_controller_map(m_allocator)
 		, m_actors(m_allocator)
+		, m_actor_map(m_allocator)
 		, m_terrains(m_allocator)
 		, m_dynamic_actors(m_allocator)
+		, m_dynamic_entities(m_allocator)
+		, m_dynamic_positions(m_allocator)
+		, m_dynamic_rotations(m_allocator)
+		, m_active_actors(m_allocator)
+		, m_controller_entities(m_allocator)
+		, m_simulation_anchors(m_allocator)
+		, m_anchor_positions(m_allocator)
+		, m_simulation_radius(200)
+		, m_simulation_region_cursor(0)
+		, m_controller_positions(m_allocator)
+		, m_lua_queries(m_allocator)
+		, m_lua_query_hits(m_allocator)
+		, m_step_index(0)
+		, m_active_actors_step(0)
 		, m_universe(context)
 		, m_is_game_running(false)
 		, m_contact_callback(*this)
 		, m_queued_forces(m_allocator)
 		, m_layers_count(2)
+		, m_is_simulating(false)
+		, m_is_async_simulation(false)
+		, m_is_writing_transforms(false)
+		, m_fixed_step(0)
+		, m_max_substeps(4)
+		, m_accumulator(0)
+		, m_interpolation_alpha(1)
 	{
 		setMemory(m_layers_names, 0, sizeof(m_layers_names));
 		for (int i = 0; i < lengthOf(m_layers_names); ++i)
@@ -261,31 +408,26 @@ struct PhysicsSceneImpl : public PhysicsScene
 		}
 		for (int i = 0; i < m_terrains.size(); ++i)
 		{
-			LUMIX_DELETE(m_allocator, m_terrains[i]);
+			if (m_terrains[i]) destroyHeightfield(m_terrains[i]);
 		}
 	}
 
 
+	// called from inside the simulation, scripts get the events after it
 	void onContact(Entity e1, Entity e2, const Vec3& position)
 	{
 		if (!m_script_scene) return;
 
 		auto send = [this](Entity e1, Entity e2, const Vec3& position)
 		{
-			auto cmp = m_script_scene->getComponent(e1);
-			if (cmp == INVALID_COMPONENT) return;
+			auto* call = m_script_scene->beginEvent(e1, "onContact");
+			if (!call) return;
 
-			for (int i = 0, c = m_script_scene->getScriptCount(cmp); i < c; ++i)
-			{
-				auto* call = m_script_scene->beginFunctionCall(cmp, i, "onContact");
-				if (!call) continue;
-
-				call->add(e2);
-				call->add(position.x);
-				call->add(position.y);
-				call->add(position.z);
-				m_script_scene->endFunctionCall(*call);
-			}
+			call->add(e2);
+			call->add(position.x);
+			call->add(position.y);
+			call->add(position.z);
+			m_script_scene->endEvent(*call);
 		};
 
 		send(e1, e2, position);
@@ -293,6 +435,25 @@ struct PhysicsSceneImpl : public PhysicsScene
 	}
 
 
+	void onTrigger(Entity trigger, Entity other, bool is_enter)
+	{
+		if (!m_script_scene) return;
+
+		const char* function = is_enter ? "onTriggerEnter" : "onTriggerLeave";
+		auto send = [this, function](Entity e1, Entity e2)
+		{
+			auto* call = m_script_scene->beginEvent(e1, function);
+			if (!call) return;
+
+			call->add(e2);
+			m_script_scene->endEvent(*call);
+		};
+
+		send(trigger, other);
+		send(other, trigger);
+	}
+
+
 	void sendMessage(uint32 type, void*) override
 	{
 		static const uint32 register_hash = crc32("registerLuaAPI");
@@ -333,22 +494,8 @@ struct PhysicsSceneImpl : public PhysicsScene
 	ComponentIndex getComponent(Entity entity, uint32 type) override
 	{
 		ASSERT(ownComponentType(type));
-		if (type == BOX_ACTOR_HASH || type == MESH_ACTOR_HASH)
-		{
-			for (int i = 0; i < m_actors.size(); ++i)
-			{
-				if (m_actors[i] && m_actors[i]->getEntity() == entity) return i;
-			}
-			return INVALID_COMPONENT;
-		}
-		if (type == CONTROLLER_HASH)
-		{
-			for (int i = 0; i < m_controllers.size(); ++i)
-			{
-				if (!m_controllers[i].m_is_free && m_controllers[i].m_entity == entity) return i;
-			}
-			return INVALID_COMPONENT;
-		}
+		if (type == BOX_ACTOR_HASH || type == MESH_ACTOR_HASH) return m_actor_map.get(entity);
+		if (type == CONTROLLER_HASH) return m_controller_map.get(entity);
 		if (type == HEIGHTFIELD_HASH)
 		{
 			for (int i = 0; i < m_terrains.size(); ++i)
@@ -403,18 +550,7 @@ struct PhysicsSceneImpl : public PhysicsScene
 		ASSERT(layer < lengthOf(m_layers_names));
 		m_terrains[cmp]->m_layer = layer;
 
-		if (m_terrains[cmp]->m_actor)
-		{
-			physx::PxFilterData data;
-			data.word0 = 1 << layer;
-			data.word1 = m_collision_filter[layer];
-			physx::PxShape* shapes[8];
-			int shapes_count = m_terrains[cmp]->m_actor->getShapes(shapes, lengthOf(shapes));
-			for (int i = 0; i < shapes_count; ++i)
-			{
-				shapes[i]->setSimulationFilterData(data);
-			}
-		}
+		updateFilterData(*m_terrains[cmp]);
 	}
 
 
@@ -445,22 +581,29 @@ struct PhysicsSceneImpl : public PhysicsScene
 		if (type == HEIGHTFIELD_HASH)
 		{
 			Entity entity = m_terrains[cmp]->m_entity;
-			LUMIX_DELETE(m_allocator, m_terrains[cmp]);
+			destroyHeightfield(m_terrains[cmp]);
 			m_terrains[cmp] = nullptr;
 			m_universe.destroyComponent(entity, type, this, cmp);
 		}
 		else if (type == CONTROLLER_HASH)
 		{
+			finishSimulation();
 			Entity entity = m_controllers[cmp].m_entity;
 			m_controllers[cmp].m_is_free = true;
+			m_controller_map.erase(entity);
 			m_universe.destroyComponent(entity, type, this, cmp);
 		}
 		else if (type == MESH_ACTOR_HASH || type == BOX_ACTOR_HASH)
 		{
 			Entity entity = m_actors[cmp]->getEntity();
+			m_actor_map.erase(entity);
 			m_actors[cmp]->setEntity(INVALID_ENTITY);
 			m_actors[cmp]->setPhysxActor(nullptr);
-			m_dynamic_actors.eraseItem(m_actors[cmp]);
+			if (m_actors[cmp]->isDynamic())
+			{
+				m_actors[cmp]->setDynamic(false);
+				m_dynamic_actors.eraseItem(m_actors[cmp]);
+			}
 			m_universe.destroyComponent(entity, type, this, cmp);
 		}
 		else
@@ -472,7 +615,7 @@ struct PhysicsSceneImpl : public PhysicsScene
 
 	ComponentIndex createHeightfield(Entity entity)
 	{
-		Heightfield* terrain = LUMIX_NEW(m_allocator, Heightfield)();
+		Heightfield* terrain = LUMIX_NEW(m_allocator, Heightfield)(m_allocator);
 		m_terrains.push(terrain);
 		terrain->m_heightmap = nullptr;
 		terrain->m_scene = this;
@@ -486,6 +629,7 @@ struct PhysicsSceneImpl : public PhysicsScene
 
 	ComponentIndex createController(Entity entity)
 	{
+		finishSimulation();
 		physx::PxCapsuleControllerDesc cDesc;
 		cDesc.material = m_default_material;
 		cDesc.height = 1.8f;
@@ -517,6 +661,7 @@ struct PhysicsSceneImpl : public PhysicsScene
 			shapes[i]->setSimulationFilterData(data);
 		}
 
+		m_controller_map.insert(entity, m_controllers.size() - 1);
 		m_universe.addComponent(entity, CONTROLLER_HASH, this, m_controllers.size() - 1);
 		return m_controllers.size() - 1;
 	}
@@ -540,6 +685,7 @@ struct PhysicsSceneImpl : public PhysicsScene
 			PxCreateStatic(*m_system->getPhysics(), transform, geom, *m_default_material);
 		actor->setPhysxActor(physx_actor);
 
+		m_actor_map.insert(entity, m_actors.size() - 1);
 		m_universe.addComponent(entity, BOX_ACTOR_HASH, this, m_actors.size() - 1);
 		return m_actors.size() - 1;
 	}
@@ -551,6 +697,7 @@ struct PhysicsSceneImpl : public PhysicsScene
 		m_actors.push(actor);
 		actor->setEntity(entity);
 
+		m_actor_map.insert(entity, m_actors.size() - 1);
 		m_universe.addComponent(
 			entity, MESH_ACTOR_HASH, this, m_actors.size() - 1);
 		return m_actors.size() - 1;
@@ -610,9 +757,13 @@ struct PhysicsSceneImpl : public PhysicsScene
 		auto* old_hm = m_terrains[cmp]->m_heightmap;
 		if (old_hm)
 		{
+			// jobs read the data of the old heightmap
+			waitForTiles(*m_terrains[cmp]);
 			resource_manager.get(ResourceManager::TEXTURE)->unload(*old_hm);
 			auto& cb = old_hm->getObserverCb();
 			cb.unbind<Heightfield, &Heightfield::heightmapLoaded>(m_terrains[cmp]);
+			auto& data_cb = old_hm->getDataUpdatedCb();
+			data_cb.unbind<Heightfield, &Heightfield::heightmapUpdated>(m_terrains[cmp]);
 		}
 		auto* texture_manager = resource_manager.get(ResourceManager::TEXTURE);
 		if (str.isValid())
@@ -620,7 +771,9 @@ struct PhysicsSceneImpl : public PhysicsScene
 			auto* new_hm = static_cast<Texture*>(texture_manager->load(str));
 			m_terrains[cmp]->m_heightmap = new_hm;
 			new_hm->onLoaded<Heightfield, &Heightfield::heightmapLoaded>(m_terrains[cmp]);
-			new_hm->addDataReference();
+			auto& data_cb = new_hm->getDataUpdatedCb();
+			data_cb.bind<Heightfield, &Heightfield::heightmapUpdated>(m_terrains[cmp]);
+			new_hm->addDataReference(Texture::DataChannels::RED_ONLY);
 		}
 		else
 		{
@@ -683,16 +836,85 @@ struct PhysicsSceneImpl : public PhysicsScene
 	}
 
 
+	// writes only actors which moved in the steps since clearActiveActors, sleeping ones keep
+	// their transforms
 	void updateDynamicActors()
 	{
 		PROFILE_FUNCTION();
-		for (auto* actor : m_dynamic_actors)
+		int count = m_active_actors.size();
+		m_dynamic_entities.resize(count);
+		m_dynamic_positions.resize(count);
+		m_dynamic_rotations.resize(count);
+		float t = m_fixed_step > 0 ? m_interpolation_alpha : 1;
+		int written = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			RigidActor* actor = m_active_actors[i];
+			// destroyed since it moved
+			if (!actor->isDynamic()) continue;
+
+			m_dynamic_entities[written] = actor->getEntity();
+			if (actor->m_active_step == m_step_index)
+			{
+				lerp(actor->m_previous_position,
+					actor->m_position,
+					&m_dynamic_positions[written],
+					t);
+				nlerp(actor->m_previous_rotation,
+					actor->m_rotation,
+					&m_dynamic_rotations[written],
+					t);
+			}
+			else
+			{
+				// came to rest before the last step
+				m_dynamic_positions[written] = actor->m_position;
+				m_dynamic_rotations[written] = actor->m_rotation;
+			}
+			++written;
+		}
+		if (written > 0)
+		{
+			// the actors are already there, or at the state the interpolation started from
+			m_is_writing_transforms = true;
+			m_universe.setPositionsAndRotations(
+				&m_dynamic_entities[0], &m_dynamic_positions[0], &m_dynamic_rotations[0], written);
+			m_is_writing_transforms = false;
+		}
+	}
+
+
+	// starts a new list of moved actors, it must be called before the first step of a frame
+	void clearActiveActors()
+	{
+		m_active_actors.clear();
+		m_active_actors_step = m_step_index;
+	}
+
+
+	// PhysX reports only actors which were awake in the step
+	void collectActiveActors()
+	{
+		PROFILE_FUNCTION();
+		++m_step_index;
+		physx::PxU32 count;
+		const physx::PxActiveTransform* transforms = m_scene->getActiveTransforms(count);
+		for (physx::PxU32 i = 0; i < count; ++i)
 		{
-			physx::PxTransform trans = actor->getPhysxActor()->getGlobalPose();
-			m_universe.setPosition(
-				actor->getEntity(), trans.p.x, trans.p.y, trans.p.z);
-			m_universe.setRotation(
-				actor->getEntity(), trans.q.x, trans.q.y, trans.q.z, trans.q.w);
+			const physx::PxActiveTransform& transform = transforms[i];
+			// kinematic actors of controllers are reported too
+			ComponentIndex cmp = m_actor_map.get((Entity)(intptr_t)transform.userData);
+			if (cmp < 0) continue;
+			RigidActor* actor = m_actors[cmp];
+			if (actor->getPhysxActor() != transform.actor || !actor->isDynamic()) continue;
+
+			if (actor->m_active_step <= m_active_actors_step) m_active_actors.push(actor);
+			actor->m_active_step = m_step_index;
+			actor->m_previous_position = actor->m_position;
+			actor->m_previous_rotation = actor->m_rotation;
+			const physx::PxTransform& pose = transform.actor2World;
+			actor->m_position.set(pose.p.x, pose.p.y, pose.p.z);
+			actor->m_rotation.set(pose.q.x, pose.q.y, pose.q.z, pose.q.w);
 		}
 	}
 
@@ -700,14 +922,35 @@ struct PhysicsSceneImpl : public PhysicsScene
 	void simulateScene(float time_delta)
 	{
 		PROFILE_FUNCTION();
+		ASSERT(!m_is_simulating);
 		m_scene->simulate(time_delta);
+		m_is_simulating = true;
 	}
 
 
 	void fetchResults()
 	{
 		PROFILE_FUNCTION();
+		// PhysX tasks run as jobs, help with them instead of blocking
+		auto& manager = m_engine->getMTJDManager();
+		while (!m_scene->checkResults(false))
+		{
+			if (!manager.tryExecuteJob()) MT::yield();
+		}
 		m_scene->fetchResults(true);
+		m_is_simulating = false;
+		collectActiveActors();
+	}
+
+
+	// waits for a step left running by frame pipelining, it must be called before actors or
+	// controllers are added or removed
+	void finishSimulation()
+	{
+		if (!m_is_simulating) return;
+
+		fetchResults();
+		updateDynamicActors();
 	}
 
 
@@ -715,21 +958,33 @@ struct PhysicsSceneImpl : public PhysicsScene
 	{
 		PROFILE_FUNCTION();
 		Vec3 g(0, time_delta * -9.8f, 0);
+		m_controller_entities.clear();
+		m_controller_positions.clear();
+		// move() writes kinematic actors of controllers to the scene, so controllers are moved
+		// one after another; only the transforms are written in one batch
 		for (int i = 0; i < m_controllers.size(); ++i)
 		{
-			if (m_controllers[i].m_is_free) continue;
+			Controller& controller = m_controllers[i];
+			if (controller.m_is_free) continue;
 
-			Vec3 dif = g + m_controllers[i].m_frame_change;
-			m_controllers[i].m_frame_change.set(0, 0, 0);
-			const physx::PxExtendedVec3& p = m_controllers[i].m_controller->getPosition();
-			m_controllers[i].m_controller->move(physx::PxVec3(dif.x, dif.y, dif.z),
+			Vec3 dif = g + controller.m_frame_change;
+			controller.m_frame_change.set(0, 0, 0);
+			controller.m_controller->move(physx::PxVec3(dif.x, dif.y, dif.z),
 				0.01f,
 				time_delta,
 				physx::PxControllerFilters());
 
-			float y = (float)p.y - m_controllers[i].m_height * 0.5f - m_controllers[i].m_radius;
-			m_universe.setPosition(m_controllers[i].m_entity, (float)p.x, y, (float)p.z);
+			const physx::PxExtendedVec3& p = controller.m_controller->getPosition();
+			float y = (float)p.y - controller.m_height * 0.5f - controller.m_radius;
+			m_controller_entities.push(controller.m_entity);
+			m_controller_positions.push(Vec3((float)p.x, y, (float)p.z));
 		}
+		if (m_controller_entities.empty()) return;
+
+		m_is_writing_transforms = true;
+		m_universe.setPositions(
+			&m_controller_entities[0], &m_controller_positions[0], m_controller_entities.size());
+		m_is_writing_transforms = false;
 	}
 
 
@@ -746,6 +1001,7 @@ struct PhysicsSceneImpl : public PhysicsScene
 
 			auto* physx_actor = static_cast<physx::PxRigidDynamic*>(actor->getPhysxActor());
 			if (!physx_actor) return;
+			if (actor->m_is_frozen) continue;
 			physx::PxVec3 f(i.force.x, i.force.y, i.force.z);
 			physx_actor->addForce(f);
 		}
@@ -753,13 +1009,116 @@ struct PhysicsSceneImpl : public PhysicsScene
 	}
 
 
+	void setFrozen(RigidActor& actor, bool is_frozen)
+	{
+		auto* body = static_cast<physx::PxRigidDynamic*>(actor.getPhysxActor());
+		actor.m_is_frozen = is_frozen;
+		body->setRigidBodyFlag(physx::PxRigidBodyFlag::eKINEMATIC, is_frozen);
+		if (!is_frozen) body->wakeUp();
+	}
+
+
+	// checks a part of dynamic actors each frame, frozen actors are woken a bit closer than the
+	// distance they are frozen at, so actors on the border do not switch every check
+	void updateSimulationRegion()
+	{
+		PROFILE_FUNCTION();
+		for (int i = m_simulation_anchors.size() - 1; i >= 0; --i)
+		{
+			if (!m_universe.hasEntity(m_simulation_anchors[i])) m_simulation_anchors.eraseFast(i);
+		}
+		if (m_simulation_anchors.empty()) return;
+		int count = m_dynamic_actors.size();
+		if (count == 0) return;
+
+		m_anchor_positions.resize(m_simulation_anchors.size());
+		m_universe.getPositions(
+			&m_simulation_anchors[0], &m_anchor_positions[0], m_simulation_anchors.size());
+		float wake_distance_sq = m_simulation_radius * m_simulation_radius;
+		float freeze_distance_sq = wake_distance_sq * 1.2f;
+		int batch = Math::minValue(count, SIMULATION_REGION_BATCH);
+		m_simulation_region_cursor %= count;
+		for (int i = 0; i < batch; ++i)
+		{
+			RigidActor* actor = m_dynamic_actors[(m_simulation_region_cursor + i) % count];
+			if (!actor->getPhysxActor()) continue;
+
+			float distance_sq = FLT_MAX;
+			for (const Vec3& anchor : m_anchor_positions)
+			{
+				float anchor_distance_sq = (actor->m_position - anchor).squaredLength();
+				distance_sq = Math::minValue(distance_sq, anchor_distance_sq);
+			}
+			if (!actor->m_is_frozen && distance_sq > freeze_distance_sq) setFrozen(*actor, true);
+			if (actor->m_is_frozen && distance_sq < wake_distance_sq) setFrozen(*actor, false);
+		}
+		m_simulation_region_cursor = (m_simulation_region_cursor + batch) % count;
+	}
+
+
+	void addSimulationAnchor(Entity entity) override
+	{
+		if (m_simulation_anchors.indexOf(entity) < 0) m_simulation_anchors.push(entity);
+	}
+
+
+	void removeSimulationAnchor(Entity entity) override
+	{
+		m_simulation_anchors.eraseItemFast(entity);
+		if (!m_simulation_anchors.empty()) return;
+
+		finishSimulation();
+		for (auto* actor : m_dynamic_actors)
+		{
+			if (actor->m_is_frozen) setFrozen(*actor, false);
+		}
+	}
+
+
+	void setSimulationRadius(float radius) override
+	{
+		m_simulation_radius = radius;
+	}
+
+
+	float getSimulationRadius() const override
+	{
+		return m_simulation_radius;
+	}
+
+
 	void update(float time_delta, bool paused) override
 	{
-		if (!m_is_game_running || paused) return;
-		
+		if (!m_is_game_running)
+		{
+			updateHeightfields();
+			return;
+		}
+
+		// with frame pipelining the step started in the previous update simulated this frame on
+		// PhysX workers while the previous one was rendered, raycasts see the state from before it
+		finishSimulation();
+		updateHeightfields();
+		if (paused) return;
+
 		applyQueuedForces();
+		updateSimulationRegion();
+
+		if (m_fixed_step > 0)
+		{
+			updateFixedStep(time_delta);
+			return;
+		}
 
 		time_delta = Math::minValue(1 / 20.0f, time_delta);
+		clearActiveActors();
+		if (m_engine->isFramePipeliningEnabled() || m_is_async_simulation)
+		{
+			updateControllers(time_delta);
+			simulateScene(time_delta);
+			return;
+		}
+
 		simulateScene(time_delta);
 		fetchResults();
 		updateDynamicActors();
@@ -767,13 +1126,95 @@ struct PhysicsSceneImpl : public PhysicsScene
 	}
 
 
-	ComponentIndex getActorComponent(Entity entity) override
+	// The scene is simulated in steps of m_fixed_step, what is left of the time is accumulated
+	// for the next update. Only the last step of the frame can run asynchronously.
+	void updateFixedStep(float time_delta)
 	{
-		for (int i = 0; i < m_actors.size(); ++i)
+		PROFILE_FUNCTION();
+		m_accumulator += time_delta;
+		int steps = (int)(m_accumulator / m_fixed_step);
+		if (steps > m_max_substeps)
+		{
+			// the time which can not be simulated is dropped, otherwise every next frame
+			// would be slower because of more steps
+			steps = m_max_substeps;
+			m_accumulator = steps * m_fixed_step;
+		}
+		m_accumulator = Math::maxValue(0.0f, m_accumulator - steps * m_fixed_step);
+		m_interpolation_alpha = Math::minValue(1.0f, m_accumulator / m_fixed_step);
+
+		updateControllers(time_delta);
+		if (steps == 0)
+		{
+			updateDynamicActors();
+			return;
+		}
+
+		clearActiveActors();
+		for (int i = 0; i < steps - 1; ++i)
 		{
-			if (m_actors[i]->getEntity() == entity) return i;
+			simulateScene(m_fixed_step);
+			fetchResults();
 		}
-		return -1;
+		simulateScene(m_fixed_step);
+		if (m_engine->isFramePipeliningEnabled() || m_is_async_simulation) return;
+
+		fetchResults();
+		updateDynamicActors();
+	}
+
+
+	void lateUpdate(float time_delta, bool paused) override
+	{
+		if (m_engine->isFramePipeliningEnabled()) return;
+
+		// scripts and other scenes were updated while the step was simulated on workers
+		finishSimulation();
+	}
+
+
+	void setAsyncSimulation(bool is_async) override
+	{
+		m_is_async_simulation = is_async;
+	}
+
+
+	bool isAsyncSimulation() const override
+	{
+		return m_is_async_simulation;
+	}
+
+
+	void setFixedStep(float step) override
+	{
+		finishSimulation();
+		m_fixed_step = Math::maxValue(0.0f, step);
+		m_accumulator = 0;
+		m_interpolation_alpha = 1;
+	}
+
+
+	float getFixedStep() const override
+	{
+		return m_fixed_step;
+	}
+
+
+	void setMaxSubsteps(int count) override
+	{
+		m_max_substeps = Math::maxValue(1, count);
+	}
+
+
+	int getMaxSubsteps() const override
+	{
+		return m_max_substeps;
+	}
+
+
+	ComponentIndex getActorComponent(Entity entity) override
+	{
+		return m_actor_map.get(entity);
 	}
 
 
@@ -797,15 +1238,35 @@ struct PhysicsSceneImpl : public PhysicsScene
 		REGISTER_FUNCTION(applyForceToActor);
 		REGISTER_FUNCTION(moveController);
 		REGISTER_FUNCTION(raycast);
+		REGISTER_FUNCTION(setAsyncSimulation);
+		REGISTER_FUNCTION(setFixedStep);
+		REGISTER_FUNCTION(setMaxSubsteps);
+		REGISTER_FUNCTION(addSimulationAnchor);
+		REGISTER_FUNCTION(removeSimulationAnchor);
+		REGISTER_FUNCTION(setSimulationRadius);
 
 		#undef REGISTER_FUNCTION
+
+		LuaWrapper::createSystemFunction(L, "Physics", "query", &PhysicsSceneImpl::LUA_query);
+
+#ifdef LUMIX_LUAJIT
+		LuaWrapper::createFFINamespace(L,
+			"Physics",
+			"physics",
+			"int lumix_raycast(void* scene, const float* origin, const float* dir, "
+			"float distance, float* hit_position, float* hit_normal);");
+#endif
 	}
 
 
 	void startGame() override { m_is_game_running = true; }
 
 
-	void stopGame() override { m_is_game_running = false; }
+	void stopGame() override
+	{
+		finishSimulation();
+		m_is_game_running = false;
+	}
 
 
 	float getControllerRadius(ComponentIndex cmp) override
@@ -822,14 +1283,7 @@ struct PhysicsSceneImpl : public PhysicsScene
 
 	ComponentIndex getController(Entity entity) override
 	{
-		for (int i = 0; i < m_controllers.size(); ++i)
-		{
-			if (m_controllers[i].m_entity == entity)
-			{
-				return i;
-			}
-		}
-		return INVALID_COMPONENT;
+		return m_controller_map.get(entity);
 	}
 
 
@@ -879,48 +1333,190 @@ struct PhysicsSceneImpl : public PhysicsScene
 	}
 
 
-	void onEntityMoved(Entity entity)
+	void query(const SceneQuery* queries, RaycastHit* hits, int count) override
+	{
+		PROFILE_FUNCTION();
+		// queries only read the scene, PhysX allows them from more threads at once
+		MTJD::parallelFor(m_engine->getMTJDManager(),
+			0,
+			count,
+			32,
+			[this, queries, hits](int from, int to) {
+				for (int i = from; i < to; ++i)
+				{
+					query(queries[i], hits[i]);
+				}
+			});
+	}
+
+
+	void query(const SceneQuery& query, RaycastHit& hit)
 	{
-		for (int i = 0, c = m_dynamic_actors.size(); i < c; ++i)
+		physx::PxFilterData filter_data;
+		filter_data.word0 = query.layers_mask;
+		physx::PxQueryFilterData query_filter(
+			filter_data, physx::PxQueryFlag::eSTATIC | physx::PxQueryFlag::eDYNAMIC);
+		query_filter.flags |= physx::PxQueryFlag::ePREFILTER;
+		LayerQueryFilter filter;
+		physx::PxVec3 origin(query.origin.x, query.origin.y, query.origin.z);
+		physx::PxVec3 dir(query.dir.x, query.dir.y, query.dir.z);
+		physx::PxHitFlags hit_flags = physx::PxHitFlag::ePOSITION | physx::PxHitFlag::eNORMAL;
+
+		hit.entity = INVALID_ENTITY;
+		const physx::PxLocationHit* location = nullptr;
+		physx::PxRaycastBuffer raycast_buffer;
+		physx::PxSweepBuffer sweep_buffer;
+		switch (query.type)
 		{
-			if (m_dynamic_actors[i]->getEntity() == entity)
+			case SceneQuery::RAYCAST:
+				m_scene->raycast(
+					origin, dir, query.distance, raycast_buffer, hit_flags, query_filter, &filter);
+				if (raycast_buffer.hasBlock) location = &raycast_buffer.block;
+				break;
+			case SceneQuery::SPHERE_SWEEP:
+				m_scene->sweep(physx::PxSphereGeometry(query.radius),
+					physx::PxTransform(origin),
+					dir,
+					query.distance,
+					sweep_buffer,
+					hit_flags,
+					query_filter,
+					&filter);
+				if (sweep_buffer.hasBlock) location = &sweep_buffer.block;
+				break;
+			case SceneQuery::SPHERE_OVERLAP:
 			{
-				Vec3 pos = m_universe.getPosition(entity);
-				physx::PxVec3 pvec(pos.x, pos.y, pos.z);
-				Quat q = m_universe.getRotation(entity);
-				physx::PxQuat pquat(q.x, q.y, q.z, q.w);
-				physx::PxTransform trans(pvec, pquat);
-				m_dynamic_actors[i]->getPhysxActor()->setGlobalPose(trans,
-																	false);
+				physx::PxOverlapBuffer overlap_buffer;
+				query_filter.flags |= physx::PxQueryFlag::eANY_HIT;
+				m_scene->overlap(physx::PxSphereGeometry(query.radius),
+					physx::PxTransform(origin),
+					overlap_buffer,
+					query_filter,
+					&filter);
+				if (!overlap_buffer.hasBlock) return;
+				hit.position = query.origin;
+				hit.normal.set(0, 0, 0);
+				physx::PxRigidActor* actor = overlap_buffer.block.actor;
+				if (actor && actor->userData) hit.entity = (int)actor->userData;
 				return;
 			}
+			default: ASSERT(false); return;
 		}
 
-		for (int i = 0, c = m_controllers.size(); i < c; ++i)
+		if (!location) return;
+		hit.position.set(location->position.x, location->position.y, location->position.z);
+		hit.normal.set(location->normal.x, location->normal.y, location->normal.z);
+		physx::PxRigidActor* actor = location->actor;
+		if (actor && actor->userData) hit.entity = (int)actor->userData;
+	}
+
+
+	static float getQueryNumber(lua_State* L, const char* name, float default_value)
+	{
+		float value = default_value;
+		if (lua_getfield(L, -1, name) == LUA_TNUMBER) value = (float)lua_tonumber(L, -1);
+		lua_pop(L, 1);
+		return value;
+	}
+
+
+	static Vec3 getQueryVec3(lua_State* L, const char* name)
+	{
+		Vec3 value(0, 0, 0);
+		if (lua_getfield(L, -1, name) == LUA_TTABLE) value = LuaWrapper::toType<Vec3>(L, -1);
+		lua_pop(L, 1);
+		return value;
+	}
+
+
+	// Physics.query(scene, queries), a query is a table with type ("raycast", "sweep" or
+	// "overlap"), origin, dir, distance, radius and layers, it returns a table with a result
+	// per query; the result has entity -1 if nothing is hit, otherwise also position and normal
+	static int LUA_query(lua_State* L)
+	{
+		auto* scene = LuaWrapper::checkArg<PhysicsSceneImpl*>(L, 1);
+		LuaWrapper::checkTableArg(L, 2);
+		int count = (int)lua_rawlen(L, 2);
+		auto& queries = scene->m_lua_queries;
+		queries.resize(count);
+		scene->m_lua_query_hits.resize(count);
+		for (int i = 0; i < count; ++i)
 		{
-			if (m_controllers[i].m_entity == entity)
+			SceneQuery& query = queries[i];
+			query.type = SceneQuery::RAYCAST;
+			query.layers_mask = 0xffffFFFF;
+			if (lua_rawgeti(L, 2, 1 + i) != LUA_TTABLE)
 			{
-				Vec3 pos = m_universe.getPosition(entity);
-				pos.y += m_controllers[i].m_height * 0.5f;
-				pos.y += m_controllers[i].m_radius;
-				physx::PxExtendedVec3 pvec(pos.x, pos.y, pos.z);
-				m_controllers[i].m_controller->setPosition(pvec);
-				return;
+				lua_pop(L, 1);
+				LuaWrapper::argError(L, 2, "table of queries");
+			}
+			if (lua_getfield(L, -1, "type") == LUA_TSTRING)
+			{
+				const char* type = lua_tostring(L, -1);
+				if (compareString(type, "sweep") == 0) query.type = SceneQuery::SPHERE_SWEEP;
+				if (compareString(type, "overlap") == 0) query.type = SceneQuery::SPHERE_OVERLAP;
+			}
+			lua_pop(L, 1);
+			query.origin = getQueryVec3(L, "origin");
+			query.dir = getQueryVec3(L, "dir");
+			query.distance = getQueryNumber(L, "distance", FLT_MAX);
+			query.radius = getQueryNumber(L, "radius", 0);
+			if (lua_getfield(L, -1, "layers") == LUA_TNUMBER)
+			{
+				query.layers_mask = (uint32)lua_tointeger(L, -1);
 			}
+			lua_pop(L, 2);
 		}
 
-		for (int i = 0, c = m_actors.size(); i < c; ++i)
+		if (count > 0) scene->query(&queries[0], &scene->m_lua_query_hits[0], count);
+
+		lua_createtable(L, count, 0);
+		for (int i = 0; i < count; ++i)
 		{
-			if (m_actors[i]->getEntity() == entity)
+			const RaycastHit& hit = scene->m_lua_query_hits[i];
+			lua_createtable(L, 0, 3);
+			lua_pushinteger(L, hit.entity);
+			lua_setfield(L, -2, "entity");
+			if (hit.entity != INVALID_ENTITY)
 			{
-				Vec3 pos = m_universe.getPosition(entity);
-				physx::PxVec3 pvec(pos.x, pos.y, pos.z);
-				Quat q = m_universe.getRotation(entity);
-				physx::PxQuat pquat(q.x, q.y, q.z, q.w);
-				physx::PxTransform trans(pvec, pquat);
-				m_actors[i]->getPhysxActor()->setGlobalPose(trans, false);
-				return;
+				LuaWrapper::pushLua(L, hit.position);
+				lua_setfield(L, -2, "position");
+				LuaWrapper::pushLua(L, hit.normal);
+				lua_setfield(L, -2, "normal");
 			}
+			lua_rawseti(L, -2, 1 + i);
+		}
+		return 1;
+	}
+
+
+	void onEntityMoved(Entity entity)
+	{
+		if (m_is_writing_transforms) return;
+
+		// dynamic actors take precedence over controllers, static actors come last
+		ComponentIndex actor = m_actor_map.get(entity);
+		bool is_dynamic_actor = actor >= 0 && m_actors[actor]->isDynamic();
+		ComponentIndex controller = m_controller_map.get(entity);
+		if (!is_dynamic_actor && controller >= 0)
+		{
+			Vec3 pos = m_universe.getPosition(entity);
+			pos.y += m_controllers[controller].m_height * 0.5f;
+			pos.y += m_controllers[controller].m_radius;
+			physx::PxExtendedVec3 pvec(pos.x, pos.y, pos.z);
+			m_controllers[controller].m_controller->setPosition(pvec);
+			return;
+		}
+
+		if (actor >= 0 && m_actors[actor]->getPhysxActor())
+		{
+			Vec3 pos = m_universe.getPosition(entity);
+			physx::PxVec3 pvec(pos.x, pos.y, pos.z);
+			Quat q = m_universe.getRotation(entity);
+			physx::PxQuat pquat(q.x, q.y, q.z, q.w);
+			physx::PxTransform trans(pvec, pquat);
+			m_actors[actor]->getPhysxActor()->setGlobalPose(trans, false);
+			m_actors[actor]->resetPose();
 		}
 	}
 
@@ -928,111 +1524,210 @@ struct PhysicsSceneImpl : public PhysicsScene
 	void heightmapLoaded(Heightfield* terrain)
 	{
 		PROFILE_FUNCTION();
-		Array<physx::PxHeightFieldSample> heights(m_allocator);
-
+		waitForTiles(*terrain);
 		int width = terrain->m_heightmap->getWidth();
 		int height = terrain->m_heightmap->getHeight();
-		heights.resize(width * height);
-		int bytes_per_pixel = terrain->m_heightmap->getBytesPerPixel();
-		if (bytes_per_pixel == 2)
-		{
-			PROFILE_BLOCK("copyData");
-			const uint16* LUMIX_RESTRICT data =
-				(const uint16*)terrain->m_heightmap->getData();
-			for (int j = 0; j < height; ++j)
+		int tiles_x = Math::maxValue(1, (width - 2) / (HEIGHTFIELD_TILE_SIZE - 1) + 1);
+		int tiles_y = Math::maxValue(1, (height - 2) / (HEIGHTFIELD_TILE_SIZE - 1) + 1);
+		if (tiles_x != terrain->m_tiles_x || tiles_y != terrain->m_tiles_y)
+		{
+			// old tiles do not match the new ones, they are removed at once
+			finishSimulation();
+			releaseTiles(*terrain);
+			terrain->m_tiles_x = tiles_x;
+			terrain->m_tiles_y = tiles_y;
+			terrain->m_tiles.resize(tiles_x * tiles_y);
+			for (int j = 0; j < tiles_y; ++j)
 			{
-				int idx = j * width;
-				for (int i = 0; i < width; ++i)
+				for (int i = 0; i < tiles_x; ++i)
 				{
-					int idx2 = j + i * height;
-					heights[idx].height = data[idx2];
-					heights[idx].materialIndex0 = heights[idx].materialIndex1 =
-						0;
-					heights[idx].setTessFlag();
-					++idx;
+					HeightfieldTile& tile = terrain->m_tiles[i + j * tiles_x];
+					tile.shape = nullptr;
+					tile.heightfield = nullptr;
+					tile.is_ready = 0;
+					tile.is_building = false;
+					tile.is_dirty = false;
+					tile.x = i * (HEIGHTFIELD_TILE_SIZE - 1);
+					tile.y = j * (HEIGHTFIELD_TILE_SIZE - 1);
+					tile.width = Math::minValue(HEIGHTFIELD_TILE_SIZE, width - tile.x);
+					tile.height = Math::minValue(HEIGHTFIELD_TILE_SIZE, height - tile.y);
 				}
 			}
 		}
-		else
+
+		// otherwise the old tiles are replaced one by one as the new ones are ready
+		for (int i = 0; i < terrain->m_tiles.size(); ++i)
+		{
+			scheduleTile(*terrain, i);
+		}
+	}
+
+
+	void updateHeightfield(ComponentIndex cmp, int x, int y, int width, int height) override
+	{
+		updateHeightfieldTiles(*m_terrains[cmp], x, y, width, height);
+	}
+
+
+	void updateHeightfieldTiles(Heightfield& terrain, int x, int y, int width, int height)
+	{
+		for (int i = 0; i < terrain.m_tiles.size(); ++i)
+		{
+			const HeightfieldTile& tile = terrain.m_tiles[i];
+			if (x >= tile.x + tile.width || y >= tile.y + tile.height) continue;
+			if (x + width <= tile.x || y + height <= tile.y) continue;
+			scheduleTile(terrain, i);
+		}
+	}
+
+
+	void scheduleTile(Heightfield& terrain, int index)
+	{
+		HeightfieldTile& tile = terrain.m_tiles[index];
+		if (tile.is_building)
 		{
-			PROFILE_BLOCK("copyData");
-			const uint8* data = terrain->m_heightmap->getData();
-			for (int j = 0; j < height; ++j)
+			tile.is_dirty = true;
+			return;
+		}
+
+		tile.is_building = true;
+		tile.is_dirty = false;
+		tile.is_ready = 0;
+		++terrain.m_building_count;
+		MT::atomicIncrement(&terrain.m_running_jobs);
+
+		Heightfield* terrain_ptr = &terrain;
+		const Texture* heightmap = terrain.m_heightmap;
+		physx::PxPhysics* physics = m_system->getPhysics();
+		IAllocator* allocator = &m_allocator;
+		auto& manager = m_engine->getMTJDManager();
+		auto* job = MTJD::makeJob(manager,
+			[terrain_ptr, index, heightmap, physics, allocator]()
 			{
-				for (int i = 0; i < width; ++i)
-				{
-					int idx = i + j * width;
-					int idx2 = j + i * height;
-					heights[idx].height = data[idx2 * bytes_per_pixel];
-					heights[idx].materialIndex0 = heights[idx].materialIndex1 =
-						0;
-					heights[idx].setTessFlag();
-				}
-			}
+				HeightfieldTile& tile = terrain_ptr->m_tiles[index];
+				tile.heightfield = createTileHeightField(*heightmap, tile, *physics, *allocator);
+				MT::atomicIncrement(&tile.is_ready);
+				MT::atomicDecrement(&terrain_ptr->m_running_jobs);
+			},
+			manager.getJobAllocator(),
+			MTJD::Priority::Low);
+		manager.schedule(job);
+	}
+
+
+	// the tiles array must not change while jobs write to it
+	void waitForTiles(Heightfield& terrain)
+	{
+		auto& manager = m_engine->getMTJDManager();
+		while (terrain.m_running_jobs > 0)
+		{
+			if (!manager.tryExecuteJob()) MT::yield();
 		}
+	}
+
+
+	void releaseTiles(Heightfield& terrain)
+	{
+		for (auto& tile : terrain.m_tiles)
+		{
+			if (tile.heightfield) tile.heightfield->release();
+		}
+		terrain.m_tiles.clear();
+		terrain.m_tiles_x = terrain.m_tiles_y = 0;
+		terrain.m_building_count = 0;
+		if (terrain.m_actor)
+		{
+			m_scene->removeActor(*terrain.m_actor);
+			terrain.m_actor->release();
+			terrain.m_actor = nullptr;
+		}
+	}
 
-		{ // PROFILE_BLOCK scope
-			PROFILE_BLOCK("PhysX");
-			physx::PxHeightFieldDesc hfDesc;
-			hfDesc.format = physx::PxHeightFieldFormat::eS16_TM;
-			hfDesc.nbColumns = width;
-			hfDesc.nbRows = height;
-			hfDesc.samples.data = &heights[0];
-			hfDesc.samples.stride = sizeof(physx::PxHeightFieldSample);
-			hfDesc.thickness = -1;
-
-			physx::PxHeightField* heightfield =
-				m_system->getPhysics()->createHeightField(hfDesc);
-			float height_scale =
-				bytes_per_pixel == 2 ? 1 / (256 * 256.0f - 1) : 1 / 255.0f;
-			physx::PxHeightFieldGeometry hfGeom(heightfield,
-												physx::PxMeshGeometryFlags(),
-												height_scale *
-													terrain->m_y_scale,
-												terrain->m_xz_scale,
-												terrain->m_xz_scale);
-			if (terrain->m_actor)
+
+	void destroyHeightfield(Heightfield* terrain)
+	{
+		waitForTiles(*terrain);
+		finishSimulation();
+		releaseTiles(*terrain);
+		LUMIX_DELETE(m_allocator, terrain);
+	}
+
+
+	// attaches tiles built since the last update, there is no simulation running
+	void updateHeightfields()
+	{
+		for (auto* terrain : m_terrains)
+		{
+			if (!terrain || terrain->m_building_count == 0) continue;
+
+			for (int i = 0; i < terrain->m_tiles.size(); ++i)
 			{
-				physx::PxRigidActor* actor = terrain->m_actor;
-				m_scene->removeActor(*actor);
-				actor->release();
-				terrain->m_actor = nullptr;
+				HeightfieldTile& tile = terrain->m_tiles[i];
+				if (!tile.is_building || tile.is_ready == 0) continue;
+
+				tile.is_building = false;
+				--terrain->m_building_count;
+				attachTile(*terrain, tile);
+				if (tile.is_dirty) scheduleTile(*terrain, i);
 			}
+		}
+	}
+
 
+	void attachTile(Heightfield& terrain, HeightfieldTile& tile)
+	{
+		PROFILE_FUNCTION();
+		physx::PxHeightField* heightfield = tile.heightfield;
+		tile.heightfield = nullptr;
+		if (!heightfield)
+		{
+			g_log_error.log("Physics") << "Could not create PhysX heightfield "
+									   << terrain.m_heightmap->getPath();
+			return;
+		}
+
+		if (!terrain.m_actor)
+		{
 			physx::PxTransform transform;
-			Matrix mtx = m_universe.getPositionAndRotation(terrain->m_entity);
+			Matrix mtx = m_universe.getPositionAndRotation(terrain.m_entity);
 			matrix2Transform(mtx, transform);
+			terrain.m_actor = m_system->getPhysics()->createRigidStatic(transform);
+			terrain.m_actor->setActorFlag(physx::PxActorFlag::eVISUALIZATION,
+				terrain.m_heightmap->getWidth() <= 1024);
+			terrain.m_actor->userData = (void*)terrain.m_entity;
+			m_scene->addActor(*terrain.m_actor);
+		}
+
+		int bytes_per_pixel = terrain.m_heightmap->getBytesPerPixel();
+		float height_scale = bytes_per_pixel == 2 ? 1 / (256 * 256.0f - 1) : 1 / 255.0f;
+		physx::PxHeightFieldGeometry geom(heightfield,
+			physx::PxMeshGeometryFlags(),
+			height_scale * terrain.m_y_scale,
+			terrain.m_xz_scale,
+			terrain.m_xz_scale);
+		if (tile.shape) terrain.m_actor->detachShape(*tile.shape);
+		tile.shape = terrain.m_actor->createShape(geom, *m_default_material);
+		// the shape keeps its own reference
+		heightfield->release();
+		if (!tile.shape) return;
+
+		physx::PxVec3 offset(tile.x * terrain.m_xz_scale, 0, tile.y * terrain.m_xz_scale);
+		tile.shape->setLocalPose(physx::PxTransform(offset));
+		physx::PxFilterData data;
+		data.word0 = 1 << terrain.m_layer;
+		data.word1 = m_collision_filter[terrain.m_layer];
+		tile.shape->setSimulationFilterData(data);
+	}
 
-			physx::PxRigidActor* actor;
-			actor = PxCreateStatic(*m_system->getPhysics(),
-								   transform,
-								   hfGeom,
-								   *m_default_material);
-			if (actor)
-			{
-				actor->setActorFlag(physx::PxActorFlag::eVISUALIZATION,
-									width <= 1024);
-				actor->userData = (void*)terrain->m_entity;
-				m_scene->addActor(*actor);
-				terrain->m_actor = actor;
-
-				physx::PxFilterData data;
-				int terrain_layer = terrain->m_layer;
-				data.word0 = 1 << terrain_layer;
-				data.word1 = m_collision_filter[terrain_layer];
-				physx::PxShape* shapes[8];
-				int shapes_count = actor->getShapes(shapes, lengthOf(shapes));
-				for (int i = 0; i < shapes_count; ++i)
-				{
-					shapes[i]->setSimulationFilterData(data);
-				}
-			}
-			else
-			{
-				g_log_error.log("Physics")
-					<< "Could not create PhysX heightfield "
-					<< terrain->m_heightmap->getPath();
-			}
+
+	void updateFilterData(Heightfield& terrain)
+	{
+		physx::PxFilterData data;
+		data.word0 = 1 << terrain.m_layer;
+		data.word1 = m_collision_filter[terrain.m_layer];
+		for (auto& tile : terrain.m_tiles)
+		{
+			if (tile.shape) tile.shape->setSimulationFilterData(data);
 		}
 	}
 
@@ -1155,18 +1850,7 @@ struct PhysicsSceneImpl : public PhysicsScene
 		for (auto* terrain : m_terrains)
 		{
 			if (!terrain) continue;
-			if (!terrain->m_actor) continue;
-
-			physx::PxFilterData data;
-			int terrain_layer = terrain->m_layer;
-			data.word0 = 1 << terrain_layer;
-			data.word1 = m_collision_filter[terrain_layer];
-			physx::PxShape* shapes[8];
-			int shapes_count = terrain->m_actor->getShapes(shapes, lengthOf(shapes));
-			for (int i = 0; i < shapes_count; ++i)
-			{
-				shapes[i]->setSimulationFilterData(data);
-			}
+			updateFilterData(*terrain);
 		}
 	}
 
@@ -1186,14 +1870,7 @@ struct PhysicsSceneImpl : public PhysicsScene
 
 	bool isDynamic(RigidActor* actor)
 	{
-		for (int i = 0, c = m_dynamic_actors.size(); i < c; ++i)
-		{
-			if (m_dynamic_actors[i] == actor)
-			{
-				return true;
-			}
-		}
-		return false;
+		return actor->isDynamic();
 	}
 
 
@@ -1236,9 +1913,7 @@ struct PhysicsSceneImpl : public PhysicsScene
 	void setIsDynamic(ComponentIndex cmp, bool new_value) override
 	{
 		RigidActor* actor = m_actors[cmp];
-		int dynamic_index = m_dynamic_actors.indexOf(actor);
-		bool is_dynamic = dynamic_index != -1;
-		if (is_dynamic != new_value)
+		if (actor->isDynamic() != new_value)
 		{
 			m_actors[cmp]->setDynamic(new_value);
 			if (new_value)
@@ -1435,6 +2110,8 @@ struct PhysicsSceneImpl : public PhysicsScene
 	{
 		int32 count;
 		m_dynamic_actors.clear();
+		m_active_actors.clear();
+		m_actor_map.clear();
 		serializer.read(count);
 		for (int i = count; i < m_actors.size(); ++i)
 		{
@@ -1463,6 +2140,7 @@ struct PhysicsSceneImpl : public PhysicsScene
 
 			if (m_actors[i]->getEntity() != -1)
 			{
+				m_actor_map.insert(e, i);
 				deserializeActor(serializer, i, version);
 			}
 		}
@@ -1481,6 +2159,7 @@ struct PhysicsSceneImpl : public PhysicsScene
 			}
 		}
 		m_controllers.clear();
+		m_controller_map.clear();
 		for (int i = 0; i < count; ++i)
 		{
 			int32 index;
@@ -1517,6 +2196,7 @@ struct PhysicsSceneImpl : public PhysicsScene
 				c.m_controller =
 					m_controller_manager->createController(*m_system->getPhysics(), m_scene, cDesc);
 				c.m_entity = e;
+				m_controller_map.insert(e, i);
 				m_universe.addComponent(e, CONTROLLER_HASH, this, i);
 			}
 		}
@@ -1529,7 +2209,7 @@ struct PhysicsSceneImpl : public PhysicsScene
 		serializer.read(count);
 		for (int i = count; i < m_terrains.size(); ++i)
 		{
-			LUMIX_DELETE(m_allocator, m_terrains[i]);
+			if (m_terrains[i]) destroyHeightfield(m_terrains[i]);
 			m_terrains[i] = nullptr;
 		}
 		int old_size = m_terrains.size();
@@ -1546,7 +2226,7 @@ struct PhysicsSceneImpl : public PhysicsScene
 			{
 				if (!m_terrains[i])
 				{
-					m_terrains[i] = LUMIX_NEW(m_allocator, Heightfield);
+					m_terrains[i] = LUMIX_NEW(m_allocator, Heightfield)(m_allocator);
 				}
 				m_terrains[i]->m_scene = this;
 				serializer.read(m_terrains[i]->m_entity);
@@ -1576,6 +2256,7 @@ struct PhysicsSceneImpl : public PhysicsScene
 
 	void deserialize(InputBlob& serializer, int version) override
 	{
+		finishSimulation();
 		if (version > (int)PhysicsSceneVersion::LAYERS)
 		{
 			serializer.read(m_layers_count);
@@ -1685,15 +2366,43 @@ struct PhysicsSceneImpl : public PhysicsScene
 	physx::PxControllerManager* m_controller_manager;
 	physx::PxMaterial* m_default_material;
 	Array<RigidActor*> m_actors;
+	EntityMap m_actor_map;
 	Array<RigidActor*> m_dynamic_actors;
+	// temporaries of updateDynamicActors, kept to avoid allocations every frame
+	Array<Entity> m_dynamic_entities;
+	Array<Vec3> m_dynamic_positions;
+	Array<Quat> m_dynamic_rotations;
+	// dynamic actors moved in the steps of the frame
+	Array<RigidActor*> m_active_actors;
+	uint32 m_step_index;
+	uint32 m_active_actors_step;
+	Array<Entity> m_simulation_anchors;
+	// temporary of updateSimulationRegion
+	Array<Vec3> m_anchor_positions;
+	float m_simulation_radius;
+	int m_simulation_region_cursor;
+	// temporaries of updateControllers
+	Array<Entity> m_controller_entities;
+	Array<Vec3> m_controller_positions;
+	// temporaries of LUA_query
+	Array<SceneQuery> m_lua_queries;
+	Array<RaycastHit> m_lua_query_hits;
 	bool m_is_game_running;
 
 	Array<QueuedForce> m_queued_forces;
 	Array<Controller> m_controllers;
+	EntityMap m_controller_map;
 	Array<Heightfield*> m_terrains;
 	uint32 m_collision_filter[32];
 	char m_layers_names[32][30];
 	int m_layers_count;
+	bool m_is_simulating;
+	bool m_is_async_simulation;
+	bool m_is_writing_transforms;
+	float m_fixed_step;
+	int m_max_substeps;
+	float m_accumulator;
+	float m_interpolation_alpha;
 };
 
 
@@ -1708,18 +2417,11 @@ PhysicsScene* PhysicsScene::create(PhysicsSystem& system,
 	impl->m_engine = &engine;
 	physx::PxSceneDesc sceneDesc(system.getPhysics()->getTolerancesScale());
 	sceneDesc.gravity = physx::PxVec3(0.0f, -9.8f, 0.0f);
-	if (!sceneDesc.cpuDispatcher)
-	{
-		physx::PxDefaultCpuDispatcher* cpu_dispatcher = physx::PxDefaultCpuDispatcherCreate(1);
-		if (!cpu_dispatcher)
-		{
-			g_log_error.log("Physics") << "PxDefaultCpuDispatcherCreate failed!";
-		}
-		sceneDesc.cpuDispatcher = cpu_dispatcher;
-	}
+	sceneDesc.cpuDispatcher = system.getCpuDispatcher();
 
 	sceneDesc.filterShader = impl->filterShader;
 	sceneDesc.simulationEventCallback = &impl->m_contact_callback;
+	sceneDesc.flags |= physx::PxSceneFlag::eENABLE_ACTIVETRANSFORMS;
 
 	impl->m_scene = system.getPhysics()->createScene(sceneDesc);
 	if (!impl->m_scene)
@@ -1740,6 +2442,7 @@ PhysicsScene* PhysicsScene::create(PhysicsSystem& system,
 void PhysicsScene::destroy(PhysicsScene* scene)
 {
 	PhysicsSceneImpl* impl = static_cast<PhysicsSceneImpl*>(scene);
+	impl->finishSimulation();
 	impl->m_controller_manager->release();
 	impl->m_default_material->release();
 	impl->m_scene->release();
@@ -1789,22 +2492,35 @@ void PhysicsSceneImpl::RigidActor::onStateChanged(Resource::State, Resource::Sta
 
 void PhysicsSceneImpl::RigidActor::setPhysxActor(physx::PxRigidActor* actor)
 {
+	m_scene.finishSimulation();
 	if (m_physx_actor)
 	{
 		m_scene.m_scene->removeActor(*m_physx_actor);
 		m_physx_actor->release();
 	}
 	m_physx_actor = actor;
+	m_is_frozen = false;
 	if (actor)
 	{
 		m_scene.m_scene->addActor(*actor);
 		actor->setActorFlag(physx::PxActorFlag::eVISUALIZATION, true);
 		actor->userData = (void*)m_entity;
 		m_scene.updateFilterData(actor, m_layer);
+		resetPose();
 	}
 }
 
 
+void PhysicsSceneImpl::RigidActor::resetPose()
+{
+	physx::PxTransform pose = m_physx_actor->getGlobalPose();
+	m_position.set(pose.p.x, pose.p.y, pose.p.z);
+	m_rotation.set(pose.q.x, pose.q.y, pose.q.z, pose.q.w);
+	m_previous_position = m_position;
+	m_previous_rotation = m_rotation;
+}
+
+
 void PhysicsSceneImpl::RigidActor::setResource(PhysicsGeometry* resource)
 {
 	if (m_resource)
@@ -1820,13 +2536,18 @@ void PhysicsSceneImpl::RigidActor::setResource(PhysicsGeometry* resource)
 }
 
 
-Heightfield::Heightfield()
+Heightfield::Heightfield(IAllocator& allocator)
+	: m_tiles(allocator)
 {
 	m_heightmap = nullptr;
 	m_xz_scale = 1.0f;
 	m_y_scale = 1.0f;
 	m_actor = nullptr;
 	m_layer = 0;
+	m_tiles_x = 0;
+	m_tiles_y = 0;
+	m_building_count = 0;
+	m_running_jobs = 0;
 }
 
 
@@ -1839,6 +2560,8 @@ Heightfield::~Heightfield()
 			->unload(*m_heightmap);
 		m_heightmap->getObserverCb().unbind<Heightfield, &Heightfield::heightmapLoaded>(
 			this);
+		m_heightmap->getDataUpdatedCb().unbind<Heightfield, &Heightfield::heightmapUpdated>(
+			this);
 	}
 }
 
@@ -1852,4 +2575,37 @@ void Heightfield::heightmapLoaded(Resource::State, Resource::State new_state)
 }
 
 
+void Heightfield::heightmapUpdated(int x, int y, int w, int h)
+{
+	m_scene->updateHeightfieldTiles(*this, x, y, w, h);
+}
+
+
+#ifdef LUMIX_LUAJIT
+// Physics.ffi.lumix_raycast, scene is g_scene_physics, returns the hit entity or -1
+extern "C" LUMIX_PHYSICS_API int lumix_raycast(void* scene,
+	const float* origin,
+	const float* dir,
+	float distance,
+	float* hit_position,
+	float* hit_normal)
+{
+	auto* physics_scene = static_cast<PhysicsScene*>(static_cast<IScene*>(scene));
+	RaycastHit hit;
+	Vec3 from(origin[0], origin[1], origin[2]);
+	if (!physics_scene->raycastEx(from, Vec3(dir[0], dir[1], dir[2]), distance, hit))
+	{
+		return INVALID_ENTITY;
+	}
+	hit_position[0] = hit.position.x;
+	hit_position[1] = hit.position.y;
+	hit_position[2] = hit.position.z;
+	hit_normal[0] = hit.normal.x;
+	hit_normal[1] = hit.normal.y;
+	hit_normal[2] = hit.normal.z;
+	return hit.entity;
+}
+#endif
+
+
 } // !namespace Lumix
@@ -25,6 +25,27 @@ struct RaycastHit
 };
 
 
+struct SceneQuery
+{
+	enum Type
+	{
+		RAYCAST,
+		SPHERE_SWEEP,
+		SPHERE_OVERLAP
+	};
+
+	Type type;
+	// center of the sphere of sweeps and overlaps
+	Vec3 origin;
+	// normalized, not used by overlaps
+	Vec3 dir;
+	float distance;
+	float radius;
+	// bit per collision layer, only shapes in these layers are hit
+	uint32 layers_mask;
+};
+
+
 class LUMIX_PHYSICS_API PhysicsScene : public IScene
 {
 	friend class PhysicsSystem;
@@ -39,7 +60,29 @@ class LUMIX_PHYSICS_API PhysicsScene : public IScene
 			const Vec3& dir,
 			float distance,
 			RaycastHit& result) = 0;
+		// hits[i] is the closest hit of queries[i], its entity is INVALID_ENTITY if nothing is
+		// hit; queries are distributed between workers
+		virtual void query(const SceneQuery* queries, RaycastHit* hits, int count) = 0;
 		virtual PhysicsSystem& getSystem() const = 0;
+		// the step started in update is finished in lateUpdate, other scenes of the frame are
+		// updated while it is simulated; ignored with frame pipelining, which finishes the step
+		// in the next frame
+		virtual void setAsyncSimulation(bool is_async) = 0;
+		virtual bool isAsyncSimulation() const = 0;
+		// 0 simulates the whole frame in one step, otherwise the scene is simulated in steps of
+		// the same length and dynamic actors are interpolated between the last two of them
+		virtual void setFixedStep(float step) = 0;
+		virtual float getFixedStep() const = 0;
+		// at most this many steps are simulated in one update, the rest of the time is dropped
+		virtual void setMaxSubsteps(int count) = 0;
+		virtual int getMaxSubsteps() const = 0;
+		// dynamic actors farther than the radius from all anchors (e.g. players or cameras) are
+		// frozen as kinematic, they are simulated again when an anchor comes closer; without
+		// anchors everything is simulated
+		virtual void addSimulationAnchor(Entity entity) = 0;
+		virtual void removeSimulationAnchor(Entity entity) = 0;
+		virtual void setSimulationRadius(float radius) = 0;
+		virtual float getSimulationRadius() const = 0;
 
 		virtual ComponentIndex getActorComponent(Entity entity) = 0;
 		virtual void setActorLayer(ComponentIndex cmp, int layer) = 0;
@@ -58,6 +101,9 @@ class LUMIX_PHYSICS_API PhysicsScene : public IScene
 		virtual void setHeightmapYScale(ComponentIndex cmp, float scale) = 0;
 		virtual int getHeightfieldLayer(ComponentIndex cmp) = 0;
 		virtual void setHeightfieldLayer(ComponentIndex cmp, int layer) = 0;
+		// rebuilds tiles of the heightfield in the rectangle of the heightmap, after its data
+		// changed
+		virtual void updateHeightfield(ComponentIndex cmp, int x, int y, int width, int height) = 0;
 
 		virtual void applyForceToActor(ComponentIndex cmp, const Vec3& force) = 0;
 		virtual float getActorSpeed(ComponentIndex cmp) = 0;
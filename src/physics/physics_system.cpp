@@ -3,10 +3,15 @@
 #include <PxPhysicsAPI.h>
 
 #include "cooking/PxCooking.h"
-#include "core/base_proxy_allocator.h"
+#include "core/command_line_parser.h"
 #include "core/crc32.h"
 #include "core/log.h"
+#include "core/math_utils.h"
+#include "core/MTJD/generic_job.h"
+#include "core/MTJD/manager.h"
 #include "core/resource_manager.h"
+#include "core/system.h"
+#include "core/tracking_allocator.h"
 #include "editor/studio_app.h"
 #include "editor/utils.h"
 #include "editor/world_editor.h"
@@ -196,18 +201,98 @@ namespace Lumix
 	}
 
 
+	// Runs PhysX tasks as MTJD jobs, so physics does not oversubscribe the cores used by the
+	// engine's workers. The worker count only tells PhysX how much to split its work.
+	class MTJDCpuDispatcher : public physx::PxCpuDispatcher
+	{
+	public:
+		MTJDCpuDispatcher(MTJD::Manager& manager, physx::PxU32 worker_count)
+			: m_manager(manager)
+			, m_worker_count(worker_count)
+		{
+		}
+
+
+		void submitTask(physx::PxBaseTask& task) override
+		{
+			physx::PxBaseTask* task_ptr = &task;
+			auto* job = MTJD::makeJob(m_manager,
+				[task_ptr]()
+				{
+					task_ptr->run();
+					task_ptr->release();
+				},
+				m_manager.getJobAllocator());
+			m_manager.schedule(job);
+		}
+
+
+		physx::PxU32 getWorkerCount() const override { return m_worker_count; }
+
+	private:
+		MTJD::Manager& m_manager;
+		physx::PxU32 m_worker_count;
+	};
+
+
+	// -physics_threads N, all engine workers by default
+	static int getPhysicsThreadsCount(int max_count)
+	{
+		char cmd_line[2048];
+		getCommandLine(cmd_line, lengthOf(cmd_line));
+
+		CommandLineParser parser(cmd_line);
+		while (parser.next())
+		{
+			if (!parser.currentEquals("-physics_threads")) continue;
+			if (!parser.next()) break;
+
+			char tmp[16];
+			parser.getCurrent(tmp, lengthOf(tmp));
+			int count;
+			if (!fromCString(tmp, lengthOf(tmp), &count)) break;
+			return Math::clamp(count, 1, max_count);
+		}
+		return max_count;
+	}
+
+
+	// -physics_cache DIR, cooked meshes are not cached by default
+	static void getPhysicsCacheDirectory(char* dir, int max_size)
+	{
+		dir[0] = '\0';
+		char cmd_line[2048];
+		getCommandLine(cmd_line, lengthOf(cmd_line));
+
+		CommandLineParser parser(cmd_line);
+		while (parser.next())
+		{
+			if (!parser.currentEquals("-physics_cache")) continue;
+			if (!parser.next()) break;
+
+			parser.getCurrent(dir, max_size);
+			break;
+		}
+	}
+
+
 	struct PhysicsSystemImpl : public PhysicsSystem
 	{
 		PhysicsSystemImpl(Engine& engine)
-			: m_allocator(engine.getAllocator())
+			: m_allocator(engine.getAllocator(), "physics")
 			, m_engine(engine)
 			, m_manager(*this, engine.getAllocator())
 		{
 			registerProperties(engine.getAllocator());
 			m_manager.create(ResourceManager::PHYSICS, engine.getResourceManager());
+			char cache_dir[MAX_PATH_LENGTH];
+			getPhysicsCacheDirectory(cache_dir, lengthOf(cache_dir));
+			m_manager.setCacheDirectory(cache_dir);
 		}
 
 		bool create() override;
+		// PhysX foundation, physics and cooking do not need the window
+		bool isCreatedInParallel() const override { return true; }
 		IScene* createScene(Universe& universe) override;
 		void destroyScene(IScene* scene) override;
 		void destroy() override;
@@ -222,6 +307,11 @@ namespace Lumix
 			return m_cooking;
 		}
 
+		physx::PxCpuDispatcher* getCpuDispatcher() override
+		{
+			return m_cpu_dispatcher;
+		}
+
 		bool connect2VisualDebugger();
 
 		physx::PxPhysics*			m_physics;
@@ -230,9 +320,10 @@ namespace Lumix
 		physx::PxAllocatorCallback*	m_physx_allocator;
 		physx::PxErrorCallback*		m_error_callback;
 		physx::PxCooking*			m_cooking;
+		MTJDCpuDispatcher*			m_cpu_dispatcher;
 		PhysicsGeometryManager		m_manager;
 		class Engine&				m_engine;
-		class BaseProxyAllocator	m_allocator;
+		TrackingAllocator			m_allocator;
 	};
 
 
@@ -343,6 +434,10 @@ namespace Lumix
 
 		physx::PxTolerancesScale scale;
 		m_cooking = PxCreateCooking(PX_PHYSICS_VERSION, *m_foundation, physx::PxCookingParams(scale));
+
+		auto& manager = m_engine.getMTJDManager();
+		int threads_count = getPhysicsThreadsCount((int)manager.getCpuThreadsCount());
+		m_cpu_dispatcher = LUMIX_NEW(m_allocator, MTJDCpuDispatcher)(manager, threads_count);
 		connect2VisualDebugger();
 		return true;
 	}
@@ -353,6 +448,7 @@ namespace Lumix
 		m_cooking->release();
 		m_physics->release();
 		m_foundation->release();
+		LUMIX_DELETE(m_allocator, m_cpu_dispatcher);
 		LUMIX_DELETE(m_allocator, m_physx_allocator);
 		LUMIX_DELETE(m_allocator, m_error_callback);
 	}
@@ -417,11 +513,13 @@ namespace {
 						if (ImGui::InputText(label, buf, lengthOf(buf)))
 						{
 							scene->setCollisionLayerName(i, buf);
+							m_editor.markSceneDirty(scene);
 						}
 					}
 					if (ImGui::Button("Add layer"))
 					{
 						scene->addCollisionLayer();
+						m_editor.markSceneDirty(scene);
 					}
 					if (scene->getCollisionsLayersCount() > 1)
 					{
@@ -429,6 +527,7 @@ namespace {
 						if (ImGui::Button("Remove layer"))
 						{
 							scene->removeCollisionLayer();
+							m_editor.markSceneDirty(scene);
 						}
 					}
 				}
@@ -468,6 +567,7 @@ namespace {
 							if (ImGui::Checkbox(StringBuilder<10>("###", i, "-") << j, &b))
 							{
 								scene->setLayersCanCollide(i, j, b);
+								m_editor.markSceneDirty(scene);
 							}
 							ImGui::NextColumn();
 						}
@@ -10,6 +10,7 @@ namespace physx
 
 	class PxControllerManager;
 	class PxCooking;
+	class PxCpuDispatcher;
 	class PxPhysics;
 
 } // namespace physx
@@ -28,6 +29,8 @@ class LUMIX_PHYSICS_API PhysicsSystem : public IPlugin
 		
 		virtual physx::PxPhysics* getPhysics() = 0;
 		virtual physx::PxCooking* getCooking() = 0;
+		// shared by all scenes, runs PhysX tasks on the engine's job system
+		virtual physx::PxCpuDispatcher* getCpuDispatcher() = 0;
 
 	protected:
 		PhysicsSystem() {}
@@ -1,24 +1,40 @@
 #include "core/FS/file_system.h"
 #include "core/FS/ifile.h"
 #include "core/blob.h"
+#include "core/command_line_parser.h"
 #include "core/crc32.h"
+#include "core/frame_stats.h"
 #include "debug/debug.h"
+#include "core/json_serializer.h"
 #include "core/log.h"
+#include "core/math_utils.h"
 #include "core/mt/thread.h"
 #include "core/path_utils.h"
 #include "core/profiler.h"
+#include "core/quat.h"
 #include "core/resource_manager.h"
 #include "core/resource_manager_base.h"
+#include "core/system.h"
 #include "editor/gizmo.h"
 #include "editor/world_editor.h"
 #include "engine/engine.h"
 #include "engine/plugin_manager.h"
 #include "renderer/pipeline.h"
+#include "renderer/render_scene.h"
 #include "renderer/renderer.h"
 #include "renderer/texture.h"
 #include "universe/universe.h"
 #include <Windows.h>
 #include <cstdio>
+#include <cstdlib>
+
+
+// Without arguments the tests are rendered and compared with the stored images. With -perf each
+// test flies the camera along render_tests/<test>.cam, or stays in place for
+// DEFAULT_PERF_FRAME_COUNT frames if there is none, and the timings and render stats are written
+// to render_tests/perf_results.json; a test fails if it is slower than its entry in
+// render_tests/perf_baseline.json by more than -threshold (0.1 = 10%):
+// render_test -perf [-threshold 0.1]
 
 
 class App
@@ -27,6 +43,8 @@ public:
 	App()
 		: m_tests(m_allocator)
 	{
+		m_is_performance_mode = false;
+		m_regression_threshold = DEFAULT_REGRESSION_THRESHOLD;
 		m_current_test = -1;
 		m_is_test_universe_loaded = false;
 		m_universe = nullptr;
@@ -108,6 +126,7 @@ public:
 
 	void init()
 	{
+		parseCommandLine();
 		auto hwnd = createWindow();
 
 		Lumix::g_log_info.getCallback().bind<outputToVS>();
@@ -205,6 +224,8 @@ public:
 			Lumix::copyString(test.path, "render_tests/");
 			Lumix::catString(test.path, basename);
 			test.failed = false;
+			test.cpu_time = test.cpu_time_p95 = test.gpu_time = 0;
+			test.draw_calls = test.visible_meshes = 0;
 		};
 
 		if (handle != INVALID_HANDLE_VALUE)
@@ -225,11 +246,16 @@ public:
 		Lumix::FS::FileSystem& fs = m_engine->getFileSystem();
 
 		bool can_do_next_test = m_current_test == -1 ||
-								(!m_engine->getFileSystem().hasWork() && m_is_test_universe_loaded);
+								(!m_engine->getFileSystem().hasWork() && !m_engine->getResourceManager().isParsing() &&
+									m_is_test_universe_loaded);
 		if (can_do_next_test)
 		{
 			char path[Lumix::MAX_PATH_LENGTH];
-			if (m_current_test >= 0)
+			if (m_current_test >= 0 && m_is_performance_mode)
+			{
+				runPerformanceTest(m_current_test);
+			}
+			else if (m_current_test >= 0)
 			{
 				Lumix::Renderer* renderer = static_cast<Lumix::Renderer*>(
 					m_engine->getPluginManager().getPlugin("renderer"));
@@ -306,14 +332,15 @@ public:
 			m_pipeline->render();
 			auto* renderer = m_engine->getPluginManager().getPlugin("renderer");
 			static_cast<Lumix::Renderer*>(renderer)->frame();
-			if (!m_engine->getFileSystem().hasWork())
+			if (!m_engine->getFileSystem().hasWork() && !m_engine->getResourceManager().isParsing())
 			{
-				if (!nextTest()) return;
+				if (!nextTest()) break;
 			}
 			m_engine->getFileSystem().updateAsyncTransactions();
 			Lumix::MT::sleep(100);
 			handleEvents();
 		}
+		if (m_is_performance_mode) checkPerformance();
 		int failed_count = getFailedCount();
 		if (failed_count)
 		{
@@ -322,6 +349,233 @@ public:
 	}
 
 
+	void parseCommandLine()
+	{
+		char cmd_line[1024];
+		Lumix::getCommandLine(cmd_line, Lumix::lengthOf(cmd_line));
+		Lumix::CommandLineParser parser(cmd_line);
+		while (parser.next())
+		{
+			if (parser.currentEquals("-perf"))
+			{
+				m_is_performance_mode = true;
+			}
+			else if (parser.currentEquals("-threshold"))
+			{
+				if (!parser.next()) break;
+				char tmp[32];
+				parser.getCurrent(tmp, Lumix::lengthOf(tmp));
+				m_regression_threshold = (float)atof(tmp);
+			}
+		}
+	}
+
+
+	// render_tests/<test>.cam is {"frames" : [x, y, z, rot_x, rot_y, rot_z, rot_w, ...]}, one
+	// camera transform per frame
+	void loadCameraPath(const char* test_path,
+		Lumix::Array<Lumix::Vec3>& positions,
+		Lumix::Array<Lumix::Quat>& rotations)
+	{
+		char path[Lumix::MAX_PATH_LENGTH];
+		Lumix::copyString(path, test_path);
+		Lumix::catString(path, ".cam");
+		Lumix::FS::FileSystem& fs = m_engine->getFileSystem();
+		Lumix::FS::IFile* file =
+			fs.open(fs.getDefaultDevice(), Lumix::Path(path), Lumix::FS::Mode::OPEN_AND_READ);
+		if (!file) return;
+
+		Lumix::JsonSerializer serializer(
+			*file, Lumix::JsonSerializer::READ, Lumix::Path(path), m_allocator);
+		serializer.deserializeObjectBegin();
+		serializer.deserializeArrayBegin("frames");
+		while (!serializer.isArrayEnd())
+		{
+			float values[7];
+			for (float& value : values)
+			{
+				serializer.deserializeArrayItem(value, 0);
+			}
+			positions.push(Lumix::Vec3(values[0], values[1], values[2]));
+			rotations.push(Lumix::Quat(values[3], values[4], values[5], values[6]));
+		}
+		serializer.deserializeArrayEnd();
+		serializer.deserializeObjectEnd();
+		fs.close(*file);
+	}
+
+
+	static int compareFloats(const void* a, const void* b)
+	{
+		float lhs = *(const float*)a;
+		float rhs = *(const float*)b;
+		return lhs < rhs ? -1 : (lhs > rhs ? 1 : 0);
+	}
+
+
+	static float getPercentile(Lumix::Array<float>& values, float percentile)
+	{
+		if (values.empty()) return 0;
+		qsort(&values[0], values.size(), sizeof(values[0]), compareFloats);
+		int index = int(percentile * 0.01f * (values.size() - 1) + 0.5f);
+		return values[index];
+	}
+
+
+	void runPerformanceTest(int test_idx)
+	{
+		Test& test = m_tests[test_idx];
+		Lumix::Array<Lumix::Vec3> positions(m_allocator);
+		Lumix::Array<Lumix::Quat> rotations(m_allocator);
+		loadCameraPath(test.path, positions, rotations);
+		int frame_count = positions.empty() ? DEFAULT_PERF_FRAME_COUNT : positions.size();
+
+		auto* scene = static_cast<Lumix::RenderScene*>(
+			m_universe->getScene(Lumix::crc32("renderer")));
+		Lumix::ComponentIndex camera = scene->getCameraInSlot("main");
+		Lumix::Entity camera_entity =
+			camera == Lumix::INVALID_COMPONENT ? Lumix::INVALID_ENTITY
+											   : scene->getCameraEntity(camera);
+		auto* renderer =
+			static_cast<Lumix::Renderer*>(m_engine->getPluginManager().getPlugin("renderer"));
+
+		Lumix::Array<float> cpu_times(m_allocator);
+		Lumix::Array<float> gpu_times(m_allocator);
+		Lumix::int64 draw_calls = 0;
+		Lumix::int64 visible_meshes = 0;
+		for (int i = -PERF_WARMUP_FRAME_COUNT; i < frame_count; ++i)
+		{
+			int path_frame = Lumix::Math::maxValue(i, 0);
+			if (camera_entity != Lumix::INVALID_ENTITY && !positions.empty())
+			{
+				m_universe->setPositionAndRotation(
+					camera_entity, positions[path_frame], rotations[path_frame]);
+			}
+
+			Lumix::uint64 start = Lumix::FrameStats::getRawTime();
+			m_engine->update(*m_universe);
+			m_pipeline->setViewport(0, 0, 600, 400);
+			m_pipeline->render();
+			renderer->frame();
+			Lumix::uint64 cpu_time = Lumix::FrameStats::getRawTime() - start;
+			handleEvents();
+			if (i < 0) continue;
+
+			cpu_times.push(Lumix::FrameStats::toMilliseconds(cpu_time));
+			// measured a few frames ago, the warm up frames cover the latency
+			gpu_times.push(renderer->getGPUFrameTime());
+			draw_calls += m_pipeline->getStats().m_draw_call_count;
+			visible_meshes += m_pipeline->getStats().m_visible_mesh_count;
+		}
+
+		test.cpu_time = getPercentile(cpu_times, 50);
+		test.cpu_time_p95 = getPercentile(cpu_times, 95);
+		test.gpu_time = getPercentile(gpu_times, 50);
+		test.draw_calls = int(draw_calls / frame_count);
+		test.visible_meshes = int(visible_meshes / frame_count);
+		Lumix::g_log_info.log("render_test") << test.path << ": CPU " << test.cpu_time
+											 << " ms (95% " << test.cpu_time_p95 << " ms), GPU "
+											 << test.gpu_time << " ms, " << test.draw_calls
+											 << " draw calls, " << test.visible_meshes
+											 << " visible meshes";
+	}
+
+
+	void writePerformanceResults()
+	{
+		Lumix::FS::FileSystem& fs = m_engine->getFileSystem();
+		Lumix::Path path(PERF_RESULTS_PATH);
+		Lumix::FS::IFile* file =
+			fs.open(fs.getDiskDevice(), path, Lumix::FS::Mode::CREATE | Lumix::FS::Mode::WRITE);
+		if (!file)
+		{
+			Lumix::g_log_error.log("render_test") << "Could not write " << path;
+			return;
+		}
+
+		Lumix::JsonSerializer serializer(*file, Lumix::JsonSerializer::WRITE, path, m_allocator);
+		serializer.beginObject();
+		serializer.beginArray("tests");
+		for (const auto& test : m_tests)
+		{
+			serializer.beginObject();
+			serializer.serialize("name", test.path);
+			serializer.serialize("cpu_ms", test.cpu_time);
+			serializer.serialize("cpu_p95_ms", test.cpu_time_p95);
+			serializer.serialize("gpu_ms", test.gpu_time);
+			serializer.serialize("draw_calls", test.draw_calls);
+			serializer.serialize("visible_meshes", test.visible_meshes);
+			serializer.endObject();
+		}
+		serializer.endArray();
+		serializer.endObject();
+		serializer.flush();
+		fs.close(*file);
+	}
+
+
+	bool isRegression(const char* test, const char* name, float value, float baseline) const
+	{
+		if (value <= baseline * (1 + m_regression_threshold)) return false;
+		Lumix::g_log_error.log("render_test") << test << ": " << name << " regressed from "
+											  << baseline << " to " << value;
+		return true;
+	}
+
+
+	void checkPerformance()
+	{
+		writePerformanceResults();
+
+		Lumix::FS::FileSystem& fs = m_engine->getFileSystem();
+		Lumix::Path path(PERF_BASELINE_PATH);
+		Lumix::FS::IFile* file =
+			fs.open(fs.getDiskDevice(), path, Lumix::FS::Mode::OPEN_AND_READ);
+		if (!file)
+		{
+			Lumix::g_log_warning.log("render_test") << "No baseline " << path
+													<< ", copy the results there to create it";
+			return;
+		}
+
+		Lumix::JsonSerializer serializer(*file, Lumix::JsonSerializer::READ, path, m_allocator);
+		serializer.deserializeObjectBegin();
+		serializer.deserializeArrayBegin("tests");
+		while (!serializer.isArrayEnd())
+		{
+			serializer.nextArrayItem();
+			serializer.deserializeObjectBegin();
+			char name[Lumix::MAX_PATH_LENGTH];
+			float cpu_time, cpu_time_p95, gpu_time;
+			int draw_calls, visible_meshes;
+			serializer.deserialize("name", name, Lumix::lengthOf(name), "");
+			serializer.deserialize("cpu_ms", cpu_time, 0);
+			serializer.deserialize("cpu_p95_ms", cpu_time_p95, 0);
+			serializer.deserialize("gpu_ms", gpu_time, 0);
+			serializer.deserialize("draw_calls", draw_calls, 0);
+			serializer.deserialize("visible_meshes", visible_meshes, 0);
+			serializer.deserializeObjectEnd();
+
+			for (auto& test : m_tests)
+			{
+				if (Lumix::compareString(test.path, name) != 0) continue;
+
+				// with | instead of || all regressions of the test are logged
+				test.failed |= isRegression(name, "CPU time", test.cpu_time, cpu_time);
+				test.failed |= isRegression(name, "CPU time 95%", test.cpu_time_p95, cpu_time_p95);
+				test.failed |= isRegression(name, "GPU time", test.gpu_time, gpu_time);
+				test.failed |=
+					isRegression(name, "draw calls", (float)test.draw_calls, (float)draw_calls);
+				test.failed |= isRegression(
+					name, "visible meshes", (float)test.visible_meshes, (float)visible_meshes);
+			}
+		}
+		serializer.deserializeArrayEnd();
+		serializer.deserializeObjectEnd();
+		fs.close(*file);
+	}
+
+
 	int getFailedCount() const
 	{
 		int count = 0;
@@ -334,10 +588,25 @@ public:
 
 
 private:
+	static const int DEFAULT_PERF_FRAME_COUNT = 300;
+	// the GPU time is measured a few frames late and the first frames stream resources
+	static const int PERF_WARMUP_FRAME_COUNT = 30;
+	static const float DEFAULT_REGRESSION_THRESHOLD;
+	static const char PERF_RESULTS_PATH[];
+	static const char PERF_BASELINE_PATH[];
+
+
 	struct Test
 	{
 		char path[Lumix::MAX_PATH_LENGTH];
 		bool failed;
+		// median or 95th percentile of a frame [ms]
+		float cpu_time;
+		float cpu_time_p95;
+		float gpu_time;
+		// average per frame
+		int draw_calls;
+		int visible_meshes;
 	};
 
 	Lumix::DefaultAllocator m_allocator;
@@ -345,6 +614,8 @@ private:
 	Lumix::Universe* m_universe;
 	Lumix::Pipeline* m_pipeline;
 	Lumix::Array<Test> m_tests;
+	bool m_is_performance_mode;
+	float m_regression_threshold;
 	int m_current_test;
 	bool m_is_test_universe_loaded;
 	bool m_finished;
@@ -352,6 +623,11 @@ private:
 };
 
 
+const float App::DEFAULT_REGRESSION_THRESHOLD = 0.1f;
+const char App::PERF_RESULTS_PATH[] = "render_tests/perf_results.json";
+const char App::PERF_BASELINE_PATH[] = "render_tests/perf_baseline.json";
+
+
 INT WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, INT)
 {
 	App app;
@@ -1,55 +1,645 @@
 #include "culling_system.h"
 #include "lumix.h"
 
+#include "core/aabb.h"
 #include "core/binary_array.h"
+#include "core/crc32.h"
 #include "core/free_list.h"
 #include "core/frustum.h"
+#include "core/math_utils.h"
 #include "core/profiler.h"
+#include "core/string.h"
 
 #include "core/mtjd/group.h"
 #include "core/mtjd/manager.h"
 #include "core/mtjd/job.h"
+#include "core/mtjd/parallel_for.h"
 
 #include "core/sphere.h"
 
+#include <xmmintrin.h>
+
 namespace Lumix
 {
-typedef Array<int64> LayerMasks;
-typedef Array<ComponentIndex> RenderabletoSphereMap;
-typedef Array<int> SphereToRenderableMap;
+typedef Array<ComponentIndex> SphereToRenderableMap;
 
 static const int MIN_ENTITIES_PER_THREAD = 50;
+static const int MAX_FRUSTUMS_PER_PASS = 8;
+
+
+struct SphereArrays
+{
+	explicit SphereArrays(IAllocator& allocator)
+		: xs(allocator)
+		, ys(allocator)
+		, zs(allocator)
+		, radiuses(allocator)
+	{
+	}
+
+	int size() const { return xs.size(); }
+	bool empty() const { return xs.empty(); }
+
+	void reserve(int capacity)
+	{
+		xs.reserve(capacity);
+		ys.reserve(capacity);
+		zs.reserve(capacity);
+		radiuses.reserve(capacity);
+	}
+
+	void clear()
+	{
+		xs.clear();
+		ys.clear();
+		zs.clear();
+		radiuses.clear();
+	}
+
+	void push(const Sphere& sphere)
+	{
+		xs.push(sphere.m_position.x);
+		ys.push(sphere.m_position.y);
+		zs.push(sphere.m_position.z);
+		radiuses.push(sphere.m_radius);
+	}
+
+	void eraseFast(int index)
+	{
+		xs.eraseFast(index);
+		ys.eraseFast(index);
+		zs.eraseFast(index);
+		radiuses.eraseFast(index);
+	}
+
+	void setPosition(int index, const Vec3& position)
+	{
+		xs[index] = position.x;
+		ys[index] = position.y;
+		zs[index] = position.z;
+	}
+
+	Sphere get(int index) const
+	{
+		return Sphere(xs[index], ys[index], zs[index], radiuses[index]);
+	}
+
+	Array<float> xs;
+	Array<float> ys;
+	Array<float> zs;
+	Array<float> radiuses;
+};
+
+
+// conservative, boxes near the frustum's corners can pass
+static bool isAABBInside(const Frustum& frustum, const AABB& aabb)
+{
+	Vec3 center = (aabb.getMin() + aabb.getMax()) * 0.5f;
+	Vec3 extents = (aabb.getMax() - aabb.getMin()) * 0.5f;
+	for (int i = 0; i < Frustum::PLANE_COUNT; ++i)
+	{
+		const Plane& plane = frustum.getPlane(i);
+		float radius = extents.x * Math::abs(plane.normal.x) +
+					   extents.y * Math::abs(plane.normal.y) +
+					   extents.z * Math::abs(plane.normal.z);
+		if (plane.distance(center) < -radius) return false;
+	}
+	return true;
+}
+
+
+// Tests each group of four spheres against all frustums while it's in registers, so the sphere
+// arrays are streamed from memory only once for all frustums.
+static void doMultiCulling(int start,
+	int end,
+	const SphereArrays& spheres,
+	const AABB* LUMIX_RESTRICT aabbs,
+	const Frustum* LUMIX_RESTRICT frustums,
+	int frustum_count,
+	const ComponentIndex* LUMIX_RESTRICT sphere_to_renderable_map,
+	CullingSystem::Subresults* const* results)
+{
+	PROFILE_FUNCTION();
+	ASSERT(frustum_count > 0 && frustum_count <= MAX_FRUSTUMS_PER_PASS);
+	PROFILE_INT("objects", end - start);
+
+	const float* LUMIX_RESTRICT xs = &spheres.xs[0];
+	const float* LUMIX_RESTRICT ys = &spheres.ys[0];
+	const float* LUMIX_RESTRICT zs = &spheres.zs[0];
+	const float* LUMIX_RESTRICT radiuses = &spheres.radiuses[0];
+
+	static const int MAX_PLANES = MAX_FRUSTUMS_PER_PASS * Frustum::PLANE_COUNT;
+	__m128 plane_nx[MAX_PLANES];
+	__m128 plane_ny[MAX_PLANES];
+	__m128 plane_nz[MAX_PLANES];
+	__m128 plane_d[MAX_PLANES];
+	for (int f = 0; f < frustum_count; ++f)
+	{
+		for (int i = 0; i < Frustum::PLANE_COUNT; ++i)
+		{
+			const Plane& plane = frustums[f].getPlane(i);
+			int idx = f * Frustum::PLANE_COUNT + i;
+			plane_nx[idx] = _mm_set1_ps(plane.normal.x);
+			plane_ny[idx] = _mm_set1_ps(plane.normal.y);
+			plane_nz[idx] = _mm_set1_ps(plane.normal.z);
+			plane_d[idx] = _mm_set1_ps(plane.d);
+		}
+	}
+
+	int i = start;
+	for (int simd_end = end - 3; i < simd_end; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(xs + i);
+		__m128 y = _mm_loadu_ps(ys + i);
+		__m128 z = _mm_loadu_ps(zs + i);
+		__m128 neg_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radiuses + i));
+
+		for (int f = 0; f < frustum_count; ++f)
+		{
+			__m128 inside = _mm_cmpeq_ps(x, x);
+			for (int j = f * Frustum::PLANE_COUNT, c = j + Frustum::PLANE_COUNT; j < c; ++j)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, plane_nx[j]), _mm_mul_ps(y, plane_ny[j])),
+					_mm_add_ps(_mm_mul_ps(z, plane_nz[j]), plane_d[j]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, neg_radius));
+			}
 
-static void doCulling(int start_index,
-	const Sphere* LUMIX_RESTRICT start,
-	const Sphere* LUMIX_RESTRICT end,
+			int mask = _mm_movemask_ps(inside);
+			while (mask)
+			{
+				int lane = mask & 1 ? 0 : mask & 2 ? 1 : mask & 4 ? 2 : 3;
+				mask &= mask - 1;
+				if (!aabbs || isAABBInside(frustums[f], aabbs[i + lane]))
+				{
+					results[f]->push(sphere_to_renderable_map[i + lane]);
+				}
+			}
+		}
+	}
+
+	for (; i < end; ++i)
+	{
+		Vec3 center(xs[i], ys[i], zs[i]);
+		for (int f = 0; f < frustum_count; ++f)
+		{
+			if (frustums[f].isSphereInside(center, radiuses[i]) &&
+				(!aabbs || isAABBInside(frustums[f], aabbs[i])))
+			{
+				results[f]->push(sphere_to_renderable_map[i]);
+			}
+		}
+	}
+}
+
+
+static void doCulling(int start,
+	int end,
+	const SphereArrays& spheres,
+	const AABB* LUMIX_RESTRICT aabbs,
 	const Frustum* LUMIX_RESTRICT frustum,
-	const int64* LUMIX_RESTRICT layer_masks,
-	const int* LUMIX_RESTRICT sphere_to_renderable_map,
-	int64 layer_mask,
+	const ComponentIndex* LUMIX_RESTRICT sphere_to_renderable_map,
 	CullingSystem::Subresults& results)
 {
-	PROFILE_FUNCTION();
-	int i = start_index;
-	ASSERT(results.empty());
-	PROFILE_INT("objects", int(end - start));
-	for (const Sphere *sphere = start; sphere <= end; sphere++, ++i)
+	CullingSystem::Subresults* results_ptr = &results;
+	doMultiCulling(
+		start, end, spheres, aabbs, frustum, 1, sphere_to_renderable_map, &results_ptr);
+}
+
+
+static void doSphereCulling(int start,
+	int end,
+	const SphereArrays& spheres,
+	const Sphere& sphere,
+	const ComponentIndex* LUMIX_RESTRICT sphere_to_renderable_map,
+	CullingSystem::Subresults& results)
+{
+	const float* LUMIX_RESTRICT xs = &spheres.xs[0];
+	const float* LUMIX_RESTRICT ys = &spheres.ys[0];
+	const float* LUMIX_RESTRICT zs = &spheres.zs[0];
+	const float* LUMIX_RESTRICT radiuses = &spheres.radiuses[0];
+	for (int i = start; i < end; ++i)
 	{
-		if (frustum->isSphereInside(sphere->m_position, sphere->m_radius) &&
-			((layer_masks[i] & layer_mask) != 0))
+		float dx = xs[i] - sphere.m_position.x;
+		float dy = ys[i] - sphere.m_position.y;
+		float dz = zs[i] - sphere.m_position.z;
+		float radius = radiuses[i] + sphere.m_radius;
+		if (dx * dx + dy * dy + dz * dz < radius * radius)
 		{
 			results.push(sphere_to_renderable_map[i]);
 		}
 	}
 }
 
+
+static const float OCTREE_ROOT_HALF_SIZE = 4096.0f;
+static const int OCTREE_MAX_DEPTH = 10;
+
+
+// Loose octree over SphereArrays indices. A sphere is stored in the deepest cell which contains
+// its center and whose half size is not smaller than its radius, so it always lies inside
+// the cell's loose bounds (twice the cell size). Spheres outside of the root cell stay in the root,
+// the root is therefore never rejected as a whole.
+class CullingOctree
+{
+public:
+	explicit CullingOctree(IAllocator& allocator)
+		: m_allocator(allocator)
+		, m_nodes(allocator)
+		, m_sphere_nodes(allocator)
+		, m_sphere_slots(allocator)
+	{
+		clear();
+	}
+
+
+	void clear()
+	{
+		m_nodes.clear();
+		m_sphere_nodes.clear();
+		m_sphere_slots.clear();
+		m_nodes.emplace(m_allocator, Vec3(0, 0, 0), OCTREE_ROOT_HALF_SIZE, -1, 0);
+	}
+
+
+	void build(const SphereArrays& spheres)
+	{
+		clear();
+		m_sphere_nodes.reserve(spheres.size());
+		m_sphere_slots.reserve(spheres.size());
+		for (int i = 0; i < spheres.size(); ++i)
+		{
+			add(i, spheres);
+		}
+	}
+
+
+	// sphere must be the last one in spheres
+	void add(int sphere, const SphereArrays& spheres)
+	{
+		ASSERT(sphere == m_sphere_nodes.size());
+		m_sphere_nodes.push(-1);
+		m_sphere_slots.push(-1);
+		attach(sphere, findNode(spheres, sphere));
+	}
+
+
+	// mirrors SphereArrays::eraseFast, the last sphere takes the index of the removed one
+	void remove(int sphere)
+	{
+		detach(sphere);
+		int last = m_sphere_nodes.size() - 1;
+		if (sphere != last)
+		{
+			m_nodes[m_sphere_nodes[last]].items[m_sphere_slots[last]] = sphere;
+		}
+		m_sphere_nodes.eraseFast(sphere);
+		m_sphere_slots.eraseFast(sphere);
+	}
+
+
+	// cost is proportional to the depth of the tree, the sphere is moved only if it left its cell
+	void update(int sphere, const SphereArrays& spheres)
+	{
+		int node = findNode(spheres, sphere);
+		if (node == m_sphere_nodes[sphere]) return;
+
+		detach(sphere);
+		attach(sphere, node);
+	}
+
+
+	// aabbs are tested after the spheres if they are not null
+	void cull(const SphereArrays& spheres,
+		const AABB* LUMIX_RESTRICT aabbs,
+		const Frustum& frustum,
+		const ComponentIndex* LUMIX_RESTRICT sphere_to_renderable_map,
+		CullingSystem::Subresults& results) const
+	{
+		PROFILE_FUNCTION();
+		CullContext ctx = {&spheres, aabbs, &frustum, sphere_to_renderable_map, &results};
+		cullNode(ctx, 0);
+		PROFILE_INT("objects", results.size());
+	}
+
+
+	void cull(const SphereArrays& spheres,
+		const Sphere& sphere,
+		const ComponentIndex* LUMIX_RESTRICT sphere_to_renderable_map,
+		CullingSystem::Subresults& results) const
+	{
+		SphereCullContext ctx = {&spheres, &sphere, sphere_to_renderable_map, &results};
+		cullNode(ctx, 0);
+	}
+
+
+private:
+	struct Node
+	{
+		Node(IAllocator& allocator, const Vec3& _center, float _half_size, int _parent, int _depth)
+			: items(allocator)
+			, center(_center)
+			, half_size(_half_size)
+			, parent(_parent)
+			, depth(_depth)
+			, subtree_count(0)
+		{
+			for (int i = 0; i < lengthOf(children); ++i)
+			{
+				children[i] = -1;
+			}
+		}
+
+		bool contains(const Vec3& point) const
+		{
+			return Math::abs(point.x - center.x) <= half_size && Math::abs(point.y - center.y) <= half_size &&
+				   Math::abs(point.z - center.z) <= half_size;
+		}
+
+		Array<int> items;
+		Vec3 center;
+		float half_size;
+		int parent;
+		int depth;
+		int subtree_count;
+		int children[8];
+	};
+
+
+	struct CullContext
+	{
+		const SphereArrays* spheres;
+		const AABB* aabbs;
+		const Frustum* frustum;
+		const ComponentIndex* sphere_to_renderable_map;
+		CullingSystem::Subresults* results;
+	};
+
+
+	struct SphereCullContext
+	{
+		const SphereArrays* spheres;
+		const Sphere* sphere;
+		const ComponentIndex* sphere_to_renderable_map;
+		CullingSystem::Subresults* results;
+	};
+
+
+	enum class Classification
+	{
+		Outside,
+		Intersect,
+		Inside
+	};
+
+
+	Classification classify(const Frustum& frustum, const Node& node) const
+	{
+		float loose_half_size = node.half_size * 2;
+		Classification ret = Classification::Inside;
+		for (int i = 0; i < Frustum::PLANE_COUNT; ++i)
+		{
+			const Plane& plane = frustum.getPlane(i);
+			float extent = loose_half_size * (Math::abs(plane.normal.x) + Math::abs(plane.normal.y) +
+											  Math::abs(plane.normal.z));
+			float distance = plane.distance(node.center);
+			if (distance < -extent) return Classification::Outside;
+			if (distance < extent) ret = Classification::Intersect;
+		}
+		return ret;
+	}
+
+
+	void cullNode(CullContext& ctx, int node_index) const
+	{
+		const Node& node = m_nodes[node_index];
+		if (node.subtree_count == 0) return;
+
+		Classification classification = node_index == 0 ? Classification::Intersect : classify(*ctx.frustum, node);
+		if (classification == Classification::Outside) return;
+		if (classification == Classification::Inside)
+		{
+			acceptNode(ctx, node_index);
+			return;
+		}
+
+		const SphereArrays& spheres = *ctx.spheres;
+		for (int sphere : node.items)
+		{
+			Vec3 center(spheres.xs[sphere], spheres.ys[sphere], spheres.zs[sphere]);
+			if (ctx.frustum->isSphereInside(center, spheres.radiuses[sphere]) &&
+				(!ctx.aabbs || isAABBInside(*ctx.frustum, ctx.aabbs[sphere])))
+			{
+				ctx.results->push(ctx.sphere_to_renderable_map[sphere]);
+			}
+		}
+
+		for (int child : node.children)
+		{
+			if (child >= 0) cullNode(ctx, child);
+		}
+	}
+
+
+	void cullNode(SphereCullContext& ctx, int node_index) const
+	{
+		const Node& node = m_nodes[node_index];
+		if (node.subtree_count == 0) return;
+
+		const Vec3& center = ctx.sphere->m_position;
+		if (node_index != 0)
+		{
+			// distance from the sphere's center to the node's loose bounds
+			float loose_half_size = node.half_size * 2;
+			float dx = Math::maxValue(Math::abs(center.x - node.center.x) - loose_half_size, 0.0f);
+			float dy = Math::maxValue(Math::abs(center.y - node.center.y) - loose_half_size, 0.0f);
+			float dz = Math::maxValue(Math::abs(center.z - node.center.z) - loose_half_size, 0.0f);
+			if (dx * dx + dy * dy + dz * dz > ctx.sphere->m_radius * ctx.sphere->m_radius) return;
+		}
+
+		const SphereArrays& spheres = *ctx.spheres;
+		for (int sphere : node.items)
+		{
+			float dx = spheres.xs[sphere] - center.x;
+			float dy = spheres.ys[sphere] - center.y;
+			float dz = spheres.zs[sphere] - center.z;
+			float radius = spheres.radiuses[sphere] + ctx.sphere->m_radius;
+			if (dx * dx + dy * dy + dz * dz < radius * radius)
+			{
+				ctx.results->push(ctx.sphere_to_renderable_map[sphere]);
+			}
+		}
+
+		for (int child : node.children)
+		{
+			if (child >= 0) cullNode(ctx, child);
+		}
+	}
+
+
+	void acceptNode(CullContext& ctx, int node_index) const
+	{
+		const Node& node = m_nodes[node_index];
+		if (node.subtree_count == 0) return;
+
+		// the loose bounds are inside the frustum, so are the spheres and the objects in them
+		for (int sphere : node.items)
+		{
+			ctx.results->push(ctx.sphere_to_renderable_map[sphere]);
+		}
+
+		for (int child : node.children)
+		{
+			if (child >= 0) acceptNode(ctx, child);
+		}
+	}
+
+
+	int findNode(const SphereArrays& spheres, int sphere)
+	{
+		Vec3 position(spheres.xs[sphere], spheres.ys[sphere], spheres.zs[sphere]);
+		float radius = spheres.radiuses[sphere];
+
+		if (!m_nodes[0].contains(position)) return 0;
+
+		int node_index = 0;
+		for (;;)
+		{
+			const Node& node = m_nodes[node_index];
+			float child_half_size = node.half_size * 0.5f;
+			if (node.depth == OCTREE_MAX_DEPTH || radius > child_half_size) return node_index;
+
+			int octant = (position.x > node.center.x ? 1 : 0) | (position.y > node.center.y ? 2 : 0) |
+						 (position.z > node.center.z ? 4 : 0);
+			int child = node.children[octant];
+			if (child < 0)
+			{
+				Vec3 child_center(node.center.x + (octant & 1 ? child_half_size : -child_half_size),
+					node.center.y + (octant & 2 ? child_half_size : -child_half_size),
+					node.center.z + (octant & 4 ? child_half_size : -child_half_size));
+				int depth = node.depth + 1;
+				child = m_nodes.size();
+				m_nodes[node_index].children[octant] = child;
+				// node is invalidated by emplace
+				m_nodes.emplace(m_allocator, child_center, child_half_size, node_index, depth);
+			}
+			node_index = child;
+		}
+	}
+
+
+	void attach(int sphere, int node_index)
+	{
+		Node& node = m_nodes[node_index];
+		m_sphere_nodes[sphere] = node_index;
+		m_sphere_slots[sphere] = node.items.size();
+		node.items.push(sphere);
+		for (int i = node_index; i >= 0; i = m_nodes[i].parent)
+		{
+			++m_nodes[i].subtree_count;
+		}
+	}
+
+
+	void detach(int sphere)
+	{
+		int node_index = m_sphere_nodes[sphere];
+		Node& node = m_nodes[node_index];
+		int slot = m_sphere_slots[sphere];
+		int moved = node.items.back();
+		node.items.eraseFast(slot);
+		if (moved != sphere) m_sphere_slots[moved] = slot;
+		for (int i = node_index; i >= 0; i = m_nodes[i].parent)
+		{
+			--m_nodes[i].subtree_count;
+		}
+	}
+
+
+private:
+	IAllocator& m_allocator;
+	Array<Node> m_nodes;
+	Array<int> m_sphere_nodes;
+	Array<int> m_sphere_slots;
+};
+
+
+// Spheres of renderables with the same layer mask, culling skips buckets of layers which are
+// not requested instead of testing the mask of each sphere.
+struct LayerBucket
+{
+	LayerBucket(int64 _layer_mask, IAllocator& allocator)
+		: layer_mask(_layer_mask)
+		, spheres(allocator)
+		, aabbs(allocator)
+		, sphere_to_renderable_map(allocator)
+		, octree(allocator)
+	{
+	}
+
+	int size() const { return spheres.size(); }
+
+	int64 layer_mask;
+	SphereArrays spheres;
+	// world space, cubes around the spheres unless CullingSystem::setAABB is called
+	Array<AABB> aabbs;
+	SphereToRenderableMap sphere_to_renderable_map;
+	CullingOctree octree;
+};
+
+
+typedef Array<LayerBucket*> LayerBuckets;
+
+
+struct SphereLocation
+{
+	int bucket;
+	int index;
+};
+
+
+static int getSphereCount(const LayerBuckets& buckets, int64 layer_mask)
+{
+	int count = 0;
+	for (const LayerBucket* bucket : buckets)
+	{
+		if ((bucket->layer_mask & layer_mask) != 0) count += bucket->size();
+	}
+	return count;
+}
+
+
+// buckets of the layer mask are one range of getSphereCount spheres, f(bucket, from, to) is
+// called for the part of [start, end) in each of them
+template <typename F>
+static void forEachRange(const LayerBuckets& buckets, int64 layer_mask, int start, int end, F f)
+{
+	int offset = 0;
+	for (const LayerBucket* bucket : buckets)
+	{
+		if ((bucket->layer_mask & layer_mask) == 0) continue;
+
+		int from = Math::maxValue(start - offset, 0);
+		int to = Math::minValue(end - offset, bucket->size());
+		if (from < to) f(*bucket, from, to);
+		offset += bucket->size();
+		if (offset >= end) return;
+	}
+}
+
+
+static AABB getSphereAABB(const Sphere& sphere)
+{
+	Vec3 extents(sphere.m_radius, sphere.m_radius, sphere.m_radius);
+	return AABB(sphere.m_position - extents, sphere.m_position + extents);
+}
+
+
 class CullingJob : public MTJD::Job
 {
 public:
-	CullingJob(const CullingSystem::InputSpheres& spheres,
-		const LayerMasks& layer_masks,
-		const SphereToRenderableMap& sphere_to_renderable_map,
+	CullingJob(const LayerBuckets& buckets,
 		int64 layer_mask,
+		bool test_aabbs,
 		CullingSystem::Subresults& results,
 		int start,
 		int end,
@@ -58,14 +648,13 @@ public:
 		IAllocator& allocator,
 		IAllocator& job_allocator)
 		: Job(Job::AUTO_DESTROY, MTJD::Priority::Default, manager, allocator, job_allocator)
-		, m_spheres(spheres)
+		, m_buckets(buckets)
 		, m_results(results)
 		, m_start(start)
 		, m_end(end)
 		, m_frustum(frustum)
-		, m_layer_masks(layer_masks)
 		, m_layer_mask(layer_mask)
-		, m_sphere_to_renderable_map(sphere_to_renderable_map)
+		, m_test_aabbs(test_aabbs)
 	{
 		setJobName("CullingJob");
 		m_results.reserve(end - start);
@@ -78,23 +667,27 @@ public:
 	void execute() override
 	{
 		ASSERT(m_results.empty() && !m_is_executed);
-		doCulling(m_start,
-			&m_spheres[m_start],
-			&m_spheres[m_end],
-			&m_frustum,
-			&m_layer_masks[0],
-			&m_sphere_to_renderable_map[0],
+		forEachRange(m_buckets,
 			m_layer_mask,
-			m_results);
+			m_start,
+			m_end,
+			[this](const LayerBucket& bucket, int from, int to) {
+				doCulling(from,
+					to,
+					bucket.spheres,
+					m_test_aabbs ? &bucket.aabbs[0] : nullptr,
+					&m_frustum,
+					&bucket.sphere_to_renderable_map[0],
+					m_results);
+			});
 		m_is_executed = true;
 	}
 
 private:
-	const CullingSystem::InputSpheres& m_spheres;
+	const LayerBuckets& m_buckets;
 	CullingSystem::Subresults& m_results;
-	const LayerMasks& m_layer_masks;
-	const SphereToRenderableMap& m_sphere_to_renderable_map;
 	int64 m_layer_mask;
+	bool m_test_aabbs;
 	int m_start;
 	int m_end;
 	const Frustum& m_frustum;
@@ -107,18 +700,28 @@ public:
 	CullingSystemImpl(MTJD::Manager& mtjd_manager, IAllocator& allocator)
 		: m_allocator(allocator)
 		, m_job_allocator(allocator)
-		, m_spheres(allocator)
+		, m_buckets(allocator)
+		, m_sphere_count(0)
 		, m_result(allocator)
 		, m_sync_point(true, allocator)
 		, m_mtjd_manager(mtjd_manager)
-		, m_layer_masks(m_allocator)
-		, m_sphere_to_renderable_map(m_allocator)
 		, m_renderable_to_sphere_map(m_allocator)
+		, m_is_octree_enabled(false)
+		, m_is_aabb_test_enabled(false)
+		, m_dirty_renderables(m_allocator)
+		, m_result_slots(m_allocator)
+		, m_generation(0)
+		, m_result_generation(-1)
+		, m_result_frustum_hash(0)
+		, m_result_layer_mask(0)
+		, m_are_result_slots_valid(false)
+		, m_is_async_result(false)
 	{
 		m_result.emplace(m_allocator);
 		m_renderable_to_sphere_map.reserve(5000);
-		m_sphere_to_renderable_map.reserve(5000);
-		m_spheres.reserve(5000);
+		getBucket(1);
+		m_buckets[0]->spheres.reserve(5000);
+		m_buckets[0]->sphere_to_renderable_map.reserve(5000);
 		int cpu_count = (int)m_mtjd_manager.getCpuThreadsCount();
 		while (m_result.size() < cpu_count)
 		{
@@ -127,18 +730,65 @@ public:
 	}
 
 
-	~CullingSystemImpl() {}
+	~CullingSystemImpl()
+	{
+		for (LayerBucket* bucket : m_buckets)
+		{
+			LUMIX_DELETE(m_allocator, bucket);
+		}
+	}
 
 
 	void clear() override
 	{
-		m_spheres.clear();
-		m_layer_masks.clear();
+		for (LayerBucket* bucket : m_buckets)
+		{
+			bucket->spheres.clear();
+			bucket->aabbs.clear();
+			bucket->sphere_to_renderable_map.clear();
+			bucket->octree.clear();
+		}
+		m_sphere_count = 0;
 		m_renderable_to_sphere_map.clear();
-		m_sphere_to_renderable_map.clear();
+		invalidateResult();
+	}
+
+
+	void enableOctree(bool enable) override
+	{
+		if (enable == m_is_octree_enabled) return;
+
+		m_is_octree_enabled = enable;
+		invalidateResult();
+		for (LayerBucket* bucket : m_buckets)
+		{
+			if (enable)
+			{
+				bucket->octree.build(bucket->spheres);
+			}
+			else
+			{
+				bucket->octree.clear();
+			}
+		}
 	}
 
 
+	bool isOctreeEnabled() const override { return m_is_octree_enabled; }
+
+
+	void enableAABBTest(bool enable) override
+	{
+		if (enable == m_is_aabb_test_enabled) return;
+
+		m_is_aabb_test_enabled = enable;
+		invalidateResult();
+	}
+
+
+	bool isAABBTestEnabled() const override { return m_is_aabb_test_enabled; }
+
+
 	IAllocator& getAllocator() { return m_allocator; }
 
 
@@ -146,36 +796,173 @@ public:
 	{
 		if (m_is_async_result)
 		{
-			m_sync_point.sync();
+			m_sync_point.sync(m_mtjd_manager);
 		}
 		return m_result;
 	}
 
 
+	void invalidateResult()
+	{
+		++m_generation;
+		m_dirty_renderables.clear();
+	}
+
+
+	// moved spheres are retested in the next cull with the same frustum, if too many of them
+	// moved it's cheaper to cull everything
+	void markDirty(ComponentIndex renderable)
+	{
+		if (m_result_generation != m_generation) return;
+
+		if (m_dirty_renderables.size() >= (m_sphere_count >> 2))
+		{
+			invalidateResult();
+			return;
+		}
+		m_dirty_renderables.push(renderable);
+	}
+
+
+	void setResultKey(const Frustum& frustum, uint32 frustum_hash, int64 layer_mask)
+	{
+		m_result_generation = m_generation;
+		m_result_frustum = frustum;
+		m_result_frustum_hash = frustum_hash;
+		m_result_layer_mask = layer_mask;
+		m_are_result_slots_valid = false;
+		m_dirty_renderables.clear();
+	}
+
+
+	// returns true if m_result can be reused for the frustum, only dirty spheres are retested
+	bool reuseResult(const Frustum& frustum, uint32 frustum_hash, int64 layer_mask)
+	{
+		if (m_result_generation != m_generation) return false;
+		if (m_result_frustum_hash != frustum_hash || m_result_layer_mask != layer_mask) return false;
+		if (compareMemory(&m_result_frustum, &frustum, sizeof(frustum)) != 0) return false;
+		if (m_dirty_renderables.empty()) return true;
+
+		PROFILE_FUNCTION();
+		PROFILE_INT("dirty spheres", m_dirty_renderables.size());
+		if (m_is_async_result)
+		{
+			m_sync_point.sync(m_mtjd_manager);
+			m_is_async_result = false;
+		}
+		if (!m_are_result_slots_valid) buildResultSlots();
+
+		for (ComponentIndex renderable : m_dirty_renderables)
+		{
+			retestSphere(renderable, frustum, layer_mask);
+		}
+		m_dirty_renderables.clear();
+		return true;
+	}
+
+
+	void buildResultSlots()
+	{
+		m_result_slots.resize(m_renderable_to_sphere_map.size());
+		for (auto& slot : m_result_slots)
+		{
+			slot.subresult = -1;
+			slot.index = -1;
+		}
+		for (int i = 0; i < m_result.size(); ++i)
+		{
+			const Subresults& subresults = m_result[i];
+			for (int j = 0, c = subresults.size(); j < c; ++j)
+			{
+				ResultSlot& slot = m_result_slots[subresults[j]];
+				slot.subresult = i;
+				slot.index = j;
+			}
+		}
+		m_are_result_slots_valid = true;
+	}
+
+
+	void retestSphere(ComponentIndex renderable, const Frustum& frustum, int64 layer_mask)
+	{
+		ResultSlot& slot = m_result_slots[renderable];
+		if (slot.subresult >= 0)
+		{
+			Subresults& subresults = m_result[slot.subresult];
+			ComponentIndex moved = subresults.back();
+			subresults.eraseFast(slot.index);
+			if (moved != renderable) m_result_slots[moved].index = slot.index;
+			slot.subresult = -1;
+			slot.index = -1;
+		}
+
+		const SphereLocation& location = m_renderable_to_sphere_map[renderable];
+		const LayerBucket& bucket = *m_buckets[location.bucket];
+		if ((bucket.layer_mask & layer_mask) == 0) return;
+
+		const SphereArrays& spheres = bucket.spheres;
+		int i = location.index;
+		Vec3 center(spheres.xs[i], spheres.ys[i], spheres.zs[i]);
+		if (frustum.isSphereInside(center, spheres.radiuses[i]) &&
+			(!m_is_aabb_test_enabled || isAABBInside(frustum, bucket.aabbs[i])))
+		{
+			slot.subresult = 0;
+			slot.index = m_result[0].size();
+			m_result[0].push(renderable);
+		}
+	}
+
+
+	const AABB* getAABBs(const LayerBucket& bucket) const
+	{
+		return m_is_aabb_test_enabled ? &bucket.aabbs[0] : nullptr;
+	}
+
+
 	void cullToFrustum(const Frustum& frustum, int64 layer_mask) override
 	{
+		uint32 frustum_hash = crc32(&frustum, sizeof(frustum));
+		if (reuseResult(frustum, frustum_hash, layer_mask)) return;
+
+		setResultKey(frustum, frustum_hash, layer_mask);
 		for (int i = 0; i < m_result.size(); ++i)
 		{
 			m_result[i].clear();
 		}
-		if (!m_spheres.empty())
+		m_is_async_result = false;
+
+		for (const LayerBucket* bucket : m_buckets)
 		{
-			doCulling(0,
-				&m_spheres[0],
-				&m_spheres.back(),
-				&frustum,
-				&m_layer_masks[0],
-				&m_sphere_to_renderable_map[0],
-				layer_mask,
-				m_result[0]);
+			if ((bucket->layer_mask & layer_mask) == 0 || bucket->size() == 0) continue;
+
+			if (m_is_octree_enabled)
+			{
+				bucket->octree.cull(bucket->spheres,
+					getAABBs(*bucket),
+					frustum,
+					&bucket->sphere_to_renderable_map[0],
+					m_result[0]);
+			}
+			else
+			{
+				doCulling(0,
+					bucket->size(),
+					bucket->spheres,
+					getAABBs(*bucket),
+					&frustum,
+					&bucket->sphere_to_renderable_map[0],
+					m_result[0]);
+			}
 		}
-		m_is_async_result = false;
 	}
 
 
 	void cullToFrustumAsync(const Frustum& frustum, int64 layer_mask) override
 	{
-		int count = m_spheres.size();
+		uint32 frustum_hash = crc32(&frustum, sizeof(frustum));
+		if (reuseResult(frustum, frustum_hash, layer_mask)) return;
+
+		int count = getSphereCount(m_buckets, layer_mask);
 		for(auto& i : m_result)
 		{
 			i.clear();
@@ -183,32 +970,33 @@ public:
 
 		if (count == 0)
 		{
+			setResultKey(frustum, frustum_hash, layer_mask);
 			m_is_async_result = false;
 			return;
 		}
 
-		if (count < m_result.size() * MIN_ENTITIES_PER_THREAD)
+		// the octree rejects most of the objects at once, its traversal is not worth splitting
+		if (m_is_octree_enabled || count < m_result.size() * MIN_ENTITIES_PER_THREAD)
 		{
 			cullToFrustum(frustum, layer_mask);
 			return;
 		}
+		setResultKey(frustum, frustum_hash, layer_mask);
 		m_is_async_result = true;
 
 		int cpu_count = m_mtjd_manager.getCpuThreadsCount();
 		int step = count / cpu_count;
-		int i = 0;
 		CullingJob* jobs[16];
 		ASSERT(lengthOf(jobs) >= cpu_count);
-		for (; i < cpu_count - 1; i++)
+		for (int i = 0; i < cpu_count; i++)
 		{
 			m_result[i].clear();
-			CullingJob* cj = LUMIX_NEW(m_job_allocator, CullingJob)(m_spheres,
-				m_layer_masks,
-				m_sphere_to_renderable_map,
+			CullingJob* cj = LUMIX_NEW(m_job_allocator, CullingJob)(m_buckets,
 				layer_mask,
+				m_is_aabb_test_enabled,
 				m_result[i],
 				i * step,
-				(i + 1) * step - 1,
+				i == cpu_count - 1 ? count : (i + 1) * step,
 				frustum,
 				m_mtjd_manager,
 				m_allocator,
@@ -217,86 +1005,231 @@ public:
 			jobs[i] = cj;
 		}
 
-		m_result[i].clear();
-		CullingJob* cj = LUMIX_NEW(m_job_allocator, CullingJob)(m_spheres,
-			m_layer_masks,
-			m_sphere_to_renderable_map,
-			layer_mask,
-			m_result[i],
-			i * step,
-			count - 1,
-			frustum,
-			m_mtjd_manager,
-			m_allocator,
-			m_job_allocator);
-		cj->addDependency(&m_sync_point);
-		jobs[i] = cj;
-
-		for (i = 0; i < cpu_count; ++i)
+		for (int i = 0; i < cpu_count; ++i)
 		{
 			m_mtjd_manager.schedule(jobs[i]);
 		}
 	}
 
 
+	void cullToFrustums(const Frustum* frustums, int count, int64 layer_mask, Results* results) override
+	{
+		PROFILE_FUNCTION();
+		int batches_count = m_result.size();
+		for (int f = 0; f < count; ++f)
+		{
+			while (results[f].size() < batches_count)
+			{
+				results[f].emplace(m_allocator);
+			}
+			for (auto& subresults : results[f])
+			{
+				subresults.clear();
+			}
+		}
+		int spheres_count = getSphereCount(m_buckets, layer_mask);
+		if (spheres_count == 0 || count <= 0) return;
+
+		if (m_is_octree_enabled)
+		{
+			for (int f = 0; f < count; ++f)
+			{
+				for (const LayerBucket* bucket : m_buckets)
+				{
+					if ((bucket->layer_mask & layer_mask) == 0 || bucket->size() == 0) continue;
+					bucket->octree.cull(bucket->spheres,
+						getAABBs(*bucket),
+						frustums[f],
+						&bucket->sphere_to_renderable_map[0],
+						results[f][0]);
+				}
+			}
+			return;
+		}
+
+		int grain = Math::maxValue(MIN_ENTITIES_PER_THREAD, (spheres_count + batches_count - 1) / batches_count);
+		MTJD::parallelFor(m_mtjd_manager,
+			0,
+			spheres_count,
+			grain,
+			[this, frustums, count, layer_mask, results, grain](int from, int to)
+			{
+				int batch = from / grain;
+				CullingSystem::Subresults* batch_results[MAX_FRUSTUMS_PER_PASS];
+				for (int first = 0; first < count; first += MAX_FRUSTUMS_PER_PASS)
+				{
+					int pass_count = Math::minValue(count - first, MAX_FRUSTUMS_PER_PASS);
+					for (int f = 0; f < pass_count; ++f)
+					{
+						batch_results[f] = &results[first + f][batch];
+					}
+					forEachRange(m_buckets,
+						layer_mask,
+						from,
+						to,
+						[&](const LayerBucket& bucket, int bucket_from, int bucket_to) {
+							doMultiCulling(bucket_from,
+								bucket_to,
+								bucket.spheres,
+								getAABBs(bucket),
+								frustums + first,
+								pass_count,
+								&bucket.sphere_to_renderable_map[0],
+								batch_results);
+						});
+				}
+			});
+	}
+
+
+	void cullToSphere(const Sphere& sphere, int64 layer_mask, Subresults& results) override
+	{
+		PROFILE_FUNCTION();
+		for (const LayerBucket* bucket : m_buckets)
+		{
+			if ((bucket->layer_mask & layer_mask) == 0 || bucket->size() == 0) continue;
+
+			if (m_is_octree_enabled)
+			{
+				bucket->octree.cull(
+					bucket->spheres, sphere, &bucket->sphere_to_renderable_map[0], results);
+				continue;
+			}
+			doSphereCulling(0,
+				bucket->size(),
+				bucket->spheres,
+				sphere,
+				&bucket->sphere_to_renderable_map[0],
+				results);
+		}
+	}
+
+
+	int getBucket(int64 layer_mask)
+	{
+		for (int i = 0; i < m_buckets.size(); ++i)
+		{
+			if (m_buckets[i]->layer_mask == layer_mask) return i;
+		}
+		m_buckets.push(LUMIX_NEW(m_allocator, LayerBucket)(layer_mask, m_allocator));
+		return m_buckets.size() - 1;
+	}
+
+
+	void addSphere(ComponentIndex renderable,
+		const Sphere& sphere,
+		const AABB& aabb,
+		int64 layer_mask)
+	{
+		int bucket_index = getBucket(layer_mask);
+		LayerBucket& bucket = *m_buckets[bucket_index];
+		bucket.spheres.push(sphere);
+		bucket.aabbs.push(aabb);
+		bucket.sphere_to_renderable_map.push(renderable);
+		while (renderable >= m_renderable_to_sphere_map.size())
+		{
+			m_renderable_to_sphere_map.push({-1, -1});
+		}
+		m_renderable_to_sphere_map[renderable] = {bucket_index, bucket.size() - 1};
+		if (m_is_octree_enabled) bucket.octree.add(bucket.size() - 1, bucket.spheres);
+		++m_sphere_count;
+	}
+
+
+	void removeSphere(ComponentIndex renderable)
+	{
+		SphereLocation& location = m_renderable_to_sphere_map[renderable];
+		LayerBucket& bucket = *m_buckets[location.bucket];
+		int index = location.index;
+		if (m_is_octree_enabled) bucket.octree.remove(index);
+		m_renderable_to_sphere_map[bucket.sphere_to_renderable_map.back()].index = index;
+		bucket.spheres.eraseFast(index);
+		bucket.aabbs.eraseFast(index);
+		bucket.sphere_to_renderable_map.eraseFast(index);
+		location.bucket = -1;
+		location.index = -1;
+		--m_sphere_count;
+	}
+
+
 	void setLayerMask(ComponentIndex renderable, int64 layer) override
 	{
-		m_layer_masks[m_renderable_to_sphere_map[renderable]] = layer;
+		SphereLocation location = m_renderable_to_sphere_map[renderable];
+		const LayerBucket& bucket = *m_buckets[location.bucket];
+		if (bucket.layer_mask == layer) return;
+
+		Sphere sphere = bucket.spheres.get(location.index);
+		AABB aabb = bucket.aabbs[location.index];
+		removeSphere(renderable);
+		addSphere(renderable, sphere, aabb, layer);
+		markDirty(renderable);
 	}
 
 
 	int64 getLayerMask(ComponentIndex renderable) override
 	{
-		return m_layer_masks[m_renderable_to_sphere_map[renderable]];
+		return m_buckets[m_renderable_to_sphere_map[renderable].bucket]->layer_mask;
 	}
 
 
 	void addStatic(ComponentIndex renderable, const Sphere& sphere) override
 	{
-		if (renderable < m_renderable_to_sphere_map.size() && m_renderable_to_sphere_map[renderable] != -1)
+		if (isAdded(renderable))
 		{
 			ASSERT(false);
 			return;
 		}
 
-		m_spheres.push(sphere);
-		m_sphere_to_renderable_map.push(renderable);
-		while(renderable >= m_renderable_to_sphere_map.size())
-		{
-			m_renderable_to_sphere_map.push(-1);
-		}
-		m_renderable_to_sphere_map[renderable] = m_spheres.size() - 1;
-		m_layer_masks.push(1);
+		addSphere(renderable, sphere, getSphereAABB(sphere), 1);
+		invalidateResult();
 	}
 
 
 	void removeStatic(ComponentIndex renderable) override
 	{
-		int index = m_renderable_to_sphere_map[renderable];
-		if (index < 0) return;
-		ASSERT(index < m_spheres.size());
+		if (!isAdded(renderable)) return;
+
+		removeSphere(renderable);
+		invalidateResult();
+	}
+
+
+	bool isAdded(ComponentIndex renderable) const override
+	{
+		return renderable < m_renderable_to_sphere_map.size() &&
+			   m_renderable_to_sphere_map[renderable].bucket >= 0;
+	}
 
-		m_renderable_to_sphere_map[m_sphere_to_renderable_map.back()] = index;
-		m_spheres[index] = m_spheres.back();
-		m_sphere_to_renderable_map[index] = m_sphere_to_renderable_map.back();
-		m_layer_masks[index] = m_layer_masks.back();
 
-		m_spheres.pop();
-		m_sphere_to_renderable_map.pop();
-		m_layer_masks.pop();
-		m_renderable_to_sphere_map[renderable] = -1;
+	void setAABB(ComponentIndex renderable, const AABB& aabb) override
+	{
+		const SphereLocation& location = m_renderable_to_sphere_map[renderable];
+		m_buckets[location.bucket]->aabbs[location.index] = aabb;
+		if (m_is_aabb_test_enabled) markDirty(renderable);
 	}
 
 
 	void updateBoundingRadius(float radius, ComponentIndex renderable) override
 	{
-		m_spheres[m_renderable_to_sphere_map[renderable]].m_radius = radius;
+		const SphereLocation& location = m_renderable_to_sphere_map[renderable];
+		LayerBucket& bucket = *m_buckets[location.bucket];
+		bucket.spheres.radiuses[location.index] = radius;
+		if (m_is_octree_enabled) bucket.octree.update(location.index, bucket.spheres);
+		markDirty(renderable);
 	}
 
 
 	void updateBoundingPosition(const Vec3& position, ComponentIndex renderable) override
 	{
-		m_spheres[m_renderable_to_sphere_map[renderable]].m_position = position;
+		const SphereLocation& location = m_renderable_to_sphere_map[renderable];
+		LayerBucket& bucket = *m_buckets[location.bucket];
+		int index = location.index;
+		AABB& aabb = bucket.aabbs[index];
+		Vec3 delta = position - bucket.spheres.get(index).m_position;
+		aabb.set(aabb.getMin() + delta, aabb.getMax() + delta);
+		bucket.spheres.setPosition(index, position);
+		if (m_is_octree_enabled) bucket.octree.update(index, bucket.spheres);
+		markDirty(renderable);
 	}
 
 
@@ -304,32 +1237,44 @@ public:
 	{
 		for (int i = 0; i < spheres.size(); i++)
 		{
-			m_spheres.push(spheres[i]);
-			while(m_renderable_to_sphere_map.size() <= renderables[i])
-			{
-				m_renderable_to_sphere_map.push(-1);
-			}
-			m_renderable_to_sphere_map[renderables[i]] = m_spheres.size() - 1;
-			m_sphere_to_renderable_map.push(renderables[i]);
-			m_layer_masks.push(1);
+			addSphere(renderables[i], spheres[i], getSphereAABB(spheres[i]), 1);
 		}
+		invalidateResult();
 	}
 
 
-	const Sphere& getSphere(ComponentIndex renderable) override
+	Sphere getSphere(ComponentIndex renderable) override
 	{
-		return m_spheres[m_renderable_to_sphere_map[renderable]];
+		const SphereLocation& location = m_renderable_to_sphere_map[renderable];
+		return m_buckets[location.bucket]->spheres.get(location.index);
 	}
 
 
 private:
 	IAllocator& m_allocator;
 	FreeList<CullingJob, 16> m_job_allocator;
-	InputSpheres m_spheres;
+	LayerBuckets m_buckets;
+	int m_sphere_count;
 	Results m_result;
-	LayerMasks m_layer_masks;
-	RenderabletoSphereMap m_renderable_to_sphere_map;
-	SphereToRenderableMap m_sphere_to_renderable_map;
+	Array<SphereLocation> m_renderable_to_sphere_map;
+	bool m_is_octree_enabled;
+	bool m_is_aabb_test_enabled;
+
+	struct ResultSlot
+	{
+		int subresult;
+		int index;
+	};
+
+	Array<ComponentIndex> m_dirty_renderables;
+	// indexed by renderable
+	Array<ResultSlot> m_result_slots;
+	uint32 m_generation;
+	uint32 m_result_generation;
+	Frustum m_result_frustum;
+	uint32 m_result_frustum_hash;
+	int64 m_result_layer_mask;
+	bool m_are_result_slots_valid;
 
 	MTJD::Manager& m_mtjd_manager;
 	MTJD::Group m_sync_point;
@@ -347,4 +1292,4 @@ void CullingSystem::destroy(CullingSystem& culling_system)
 {
 	LUMIX_DELETE(static_cast<CullingSystemImpl&>(culling_system).getAllocator(), &culling_system);
 }
-}
\ No newline at end of file
+}
@@ -7,6 +7,7 @@
 namespace Lumix
 {
 	template <typename T> class Array;
+	class AABB;
 	class IAllocator;
 	struct Sphere;
 	struct Vec3;
@@ -32,21 +33,37 @@ namespace Lumix
 		static void destroy(CullingSystem& culling_system);
 
 		virtual void clear() = 0;
+
+		// loose octree rejects or accepts whole subtrees, it's kept up to date incrementally
+		virtual void enableOctree(bool enable) = 0;
+		virtual bool isOctreeEnabled() const = 0;
+		// spheres which pass are tested with their AABBs too, much tighter for long objects
+		virtual void enableAABBTest(bool enable) = 0;
+		virtual bool isAABBTestEnabled() const = 0;
 		virtual const Results& getResult() = 0;
 
 		virtual void cullToFrustum(const Frustum& frustum, int64 layer_mask) = 0;
 		virtual void cullToFrustumAsync(const Frustum& frustum, int64 layer_mask) = 0;
+		// reads the spheres only once for all frustums, results[i] is filled for frustums[i]
+		virtual void cullToFrustums(const Frustum* frustums, int count, int64 layer_mask, Results* results) = 0;
+		// appends renderables whose spheres intersect the sphere, getResult() is not affected
+		virtual void cullToSphere(const Sphere& sphere, int64 layer_mask, Subresults& results) = 0;
 
 		virtual void addStatic(ComponentIndex renderable, const Sphere& sphere) = 0;
 		virtual void removeStatic(ComponentIndex renderable) = 0;
+		virtual bool isAdded(ComponentIndex renderable) const = 0;
 
+		// spheres are stored per layer mask, culls skip whole layers which are not requested
 		virtual void setLayerMask(ComponentIndex renderable, int64 layer) = 0;
 		virtual int64 getLayerMask(ComponentIndex renderable) = 0;
 
 		virtual void updateBoundingRadius(float radius, int index) = 0;
+		// the AABB is moved with the sphere, setAABB has to be called if it rotates or scales
 		virtual void updateBoundingPosition(const Vec3& position, int index) = 0;
+		// world space, a cube around the sphere by default
+		virtual void setAABB(ComponentIndex renderable, const AABB& aabb) = 0;
 
 		virtual void insert(const InputSpheres& spheres, const Array<ComponentIndex>& renderables) = 0;
-		virtual const Sphere& getSphere(ComponentIndex renderable) = 0;
+		virtual Sphere getSphere(ComponentIndex renderable) = 0;
 	};
 } // ~namespace Lux
\ No newline at end of file
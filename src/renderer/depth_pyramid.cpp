@@ -0,0 +1,135 @@
+#include "depth_pyramid.h"
+
+#include "core/aabb.h"
+#include "core/math_utils.h"
+#include "core/profiler.h"
+#include "core/string.h"
+
+#include <cfloat>
+#include <cmath>
+
+
+namespace Lumix
+{
+
+
+static const float MIN_W = 0.001f;
+
+
+DepthPyramid::DepthPyramid(IAllocator& allocator)
+	: m_levels(allocator)
+	, m_depth(allocator)
+{
+	m_view_projection = Matrix::IDENTITY;
+}
+
+
+void DepthPyramid::clear()
+{
+	m_levels.clear();
+	m_depth.clear();
+}
+
+
+void DepthPyramid::build(const float* depth, int width, int height, const Matrix& view_projection)
+{
+	PROFILE_FUNCTION();
+	ASSERT(width > 0 && height > 0);
+	m_view_projection = view_projection;
+	m_levels.clear();
+
+	int size = 0;
+	for (int w = width, h = height;; w = (w + 1) >> 1, h = (h + 1) >> 1)
+	{
+		Level& level = m_levels.emplace();
+		level.width = w;
+		level.height = h;
+		level.offset = size;
+		size += w * h;
+		if (w == 1 && h == 1) break;
+	}
+	m_depth.resize(size);
+	copyMemory(&m_depth[0], depth, sizeof(depth[0]) * width * height);
+
+	for (int i = 1; i < m_levels.size(); ++i)
+	{
+		const Level& src_level = m_levels[i - 1];
+		const Level& level = m_levels[i];
+		const float* src = &m_depth[src_level.offset];
+		float* dst = &m_depth[level.offset];
+		for (int y = 0; y < level.height; ++y)
+		{
+			const float* row0 = src + 2 * y * src_level.width;
+			const float* row1 = 2 * y + 1 < src_level.height ? row0 + src_level.width : row0;
+			for (int x = 0; x < level.width; ++x)
+			{
+				int x0 = 2 * x;
+				int x1 = Math::minValue(x0 + 1, src_level.width - 1);
+				float farthest = Math::minValue(row0[x0], row0[x1]);
+				farthest = Math::minValue(farthest, Math::minValue(row1[x0], row1[x1]));
+				dst[y * level.width + x] = farthest;
+			}
+		}
+	}
+}
+
+
+bool DepthPyramid::isVisible(const AABB& aabb, const Matrix& world) const
+{
+	if (m_levels.empty()) return true;
+
+	Vec3 corners[8];
+	aabb.getCorners(world, corners);
+
+	const Level& base = m_levels[0];
+	float min_x = FLT_MAX;
+	float max_x = -FLT_MAX;
+	float min_y = FLT_MAX;
+	float max_y = -FLT_MAX;
+	float max_inv_w = 0;
+	for (int i = 0; i < lengthOf(corners); ++i)
+	{
+		Vec4 pos = m_view_projection * Vec4(corners[i], 1);
+		if (pos.w < MIN_W) return true;
+
+		float inv_w = 1 / pos.w;
+		float x = (pos.x * inv_w * 0.5f + 0.5f) * base.width;
+		float y = (0.5f - pos.y * inv_w * 0.5f) * base.height;
+		min_x = Math::minValue(min_x, x);
+		max_x = Math::maxValue(max_x, x);
+		min_y = Math::minValue(min_y, y);
+		max_y = Math::maxValue(max_y, y);
+		max_inv_w = Math::maxValue(max_inv_w, inv_w);
+	}
+
+	int from_x = Math::maxValue(0, (int)floorf(min_x));
+	int to_x = Math::minValue(base.width - 1, (int)floorf(max_x));
+	int from_y = Math::maxValue(0, (int)floorf(min_y));
+	int to_y = Math::minValue(base.height - 1, (int)floorf(max_y));
+	if (from_x > to_x || from_y > to_y) return true;
+
+	// the finest level where the rectangle covers at most 2x2 texels
+	int level_idx = 0;
+	while (level_idx + 1 < m_levels.size() && (to_x - from_x > 1 || to_y - from_y > 1))
+	{
+		++level_idx;
+		from_x >>= 1;
+		to_x >>= 1;
+		from_y >>= 1;
+		to_y >>= 1;
+	}
+
+	const Level& level = m_levels[level_idx];
+	for (int row = from_y; row <= to_y; ++row)
+	{
+		const float* depth = &m_depth[level.offset + row * level.width];
+		for (int col = from_x; col <= to_x; ++col)
+		{
+			if (depth[col] <= max_inv_w) return true;
+		}
+	}
+	return false;
+}
+
+
+} // namespace Lumix
@@ -0,0 +1,49 @@
+#pragma once
+
+
+#include "lumix.h"
+#include "core/array.h"
+#include "core/matrix.h"
+
+
+namespace Lumix
+{
+
+
+class AABB;
+
+
+// Hierarchical depth of a frame read back from the GPU, used to reject objects hidden in that
+// frame. Depth is 1/w like in OcclusionBuffer, i.e. what a shader gets in gl_FragCoord.w, bigger
+// is closer, 0 means nothing was rendered. Every texel of a level keeps the farthest depth of the
+// four texels below it, so a test reads at most 2x2 texels of the level matching the object's
+// size on screen.
+class DepthPyramid
+{
+public:
+	explicit DepthPyramid(IAllocator& allocator);
+
+	// depth has width * height values, the top row first, rendered with view_projection
+	void build(const float* depth, int width, int height, const Matrix& view_projection);
+	void clear();
+	bool isReady() const { return !m_levels.empty(); }
+	int getLevelCount() const { return m_levels.size(); }
+	// objects crossing the near plane of the frame are always visible
+	bool isVisible(const AABB& aabb, const Matrix& world) const;
+
+private:
+	struct Level
+	{
+		int width;
+		int height;
+		int offset;
+	};
+
+private:
+	Matrix m_view_projection;
+	Array<Level> m_levels;
+	Array<float> m_depth;
+};
+
+
+} // namespace Lumix
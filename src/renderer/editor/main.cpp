@@ -1,4 +1,5 @@
 #include "lumix.h"
+#include "core/blob.h"
 #include "core/crc32.h"
 #include "core/FS/file_system.h"
 #include "core/json_serializer.h"
@@ -7,6 +8,7 @@
 #include "core/path_utils.h"
 #include "core/resource_manager.h"
 #include "core/resource_manager_base.h"
+#include "core/string.h"
 #include "editor/asset_browser.h"
 #include "editor/ieditor_command.h"
 #include "editor/platform_interface.h"
@@ -172,6 +174,7 @@ struct MaterialPlugin : public AssetBrowser::IPlugin
 				g_log_error.log("Editor") << "Error saving "
 					<< material->getPath().c_str();
 			}
+			serializer.flush();
 			fs.close(*file);
 
 			PlatformInterface::deleteFile(material->getPath().c_str());
@@ -1150,14 +1153,56 @@ struct GameViewPlugin : public StudioApp::IPlugin
 		m_gui_pipeline->render();
 		setGUIProjection();
 
-		for(int i = 0; i < draw_data->CmdListsCount; ++i)
-		{
-			ImDrawList* cmd_list = draw_data->CmdLists[i];
-			drawGUICmdList(cmd_list);
-		}
-
 		Lumix::Renderer* renderer =
 			static_cast<Lumix::Renderer*>(m_engine->getPluginManager().getPlugin("renderer"));
+		const bgfx::VertexDecl& decl = renderer->getBasic2DVertexDecl();
+		// all lists share one geometry, unless their rebased indices do not fit in 16 bits
+		if (draw_data->TotalVtxCount <= 0x10000)
+		{
+			Lumix::TransientGeometry geom(
+				draw_data->TotalVtxCount, decl, draw_data->TotalIdxCount);
+			auto* vertices = static_cast<ImDrawVert*>(geom.getVertexData());
+			Lumix::uint16* indices = geom.getIndexData();
+			int vertex_offset = 0;
+			int index_offset = 0;
+			for (int i = 0; i < draw_data->CmdListsCount; ++i)
+			{
+				ImDrawList* cmd_list = draw_data->CmdLists[i];
+				int vertex_count = cmd_list->VtxBuffer.size();
+				int index_count = cmd_list->IdxBuffer.size();
+				Lumix::copyMemory(vertices + vertex_offset,
+					cmd_list->VtxBuffer.Data,
+					vertex_count * sizeof(*vertices));
+				for (int j = 0; j < index_count; ++j)
+				{
+					indices[index_offset + j] =
+						Lumix::uint16(cmd_list->IdxBuffer.Data[j] + vertex_offset);
+				}
+				vertex_offset += vertex_count;
+				index_offset += index_count;
+			}
+
+			index_offset = 0;
+			for (int i = 0; i < draw_data->CmdListsCount; ++i)
+			{
+				ImDrawList* cmd_list = draw_data->CmdLists[i];
+				drawGUICmdList(cmd_list, geom, index_offset);
+				index_offset += cmd_list->IdxBuffer.size();
+			}
+		}
+		else
+		{
+			for (int i = 0; i < draw_data->CmdListsCount; ++i)
+			{
+				ImDrawList* cmd_list = draw_data->CmdLists[i];
+				Lumix::TransientGeometry geom(cmd_list->VtxBuffer.Data,
+					cmd_list->VtxBuffer.size(),
+					decl,
+					cmd_list->IdxBuffer.Data,
+					cmd_list->IdxBuffer.size());
+				drawGUICmdList(cmd_list, geom, 0);
+			}
+		}
 
 		renderer->frame();
 	}
@@ -1195,20 +1240,9 @@ struct GameViewPlugin : public StudioApp::IPlugin
 	}
 
 
-	void drawGUICmdList(ImDrawList* cmd_list)
+	void drawGUICmdList(ImDrawList* cmd_list, Lumix::TransientGeometry& geom, int first_index)
 	{
-		Lumix::Renderer* renderer =
-			static_cast<Lumix::Renderer*>(m_engine->getPluginManager().getPlugin("renderer"));
-
-		Lumix::TransientGeometry geom(&cmd_list->VtxBuffer[0],
-			cmd_list->VtxBuffer.size(),
-			renderer->getBasic2DVertexDecl(),
-			&cmd_list->IdxBuffer[0],
-			cmd_list->IdxBuffer.size());
-
-		if(geom.getNumVertices() < 0) return;
-
-		Lumix::uint32 elem_offset = 0;
+		Lumix::uint32 elem_offset = first_index;
 		const ImDrawCmd* pcmd_begin = cmd_list->CmdBuffer.begin();
 		const ImDrawCmd* pcmd_end = cmd_list->CmdBuffer.end();
 		for(const ImDrawCmd* pcmd = pcmd_begin; pcmd != pcmd_end; pcmd++)
@@ -1450,6 +1484,16 @@ struct WorldEditorPlugin : public WorldEditor::Plugin
 };
 
 
+static bool cookMaterial(const char* path,
+	const void* data,
+	int size,
+	OutputBlob& out,
+	IAllocator& allocator)
+{
+	return Material::compile(data, size, Path(path), out, allocator);
+}
+
+
 extern "C" {
 
 
@@ -1490,6 +1534,8 @@ LUMIX_STUDIO_ENTRY(renderer)
 
 	auto* world_editor_plugin = LUMIX_NEW(allocator, WorldEditorPlugin)();
 	app.getWorldEditor()->addPlugin(*world_editor_plugin);
+
+	app.registerCooker("mat", cookMaterial);
 }
 
 
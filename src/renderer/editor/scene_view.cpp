@@ -339,6 +339,7 @@ void SceneView::onGUI()
 			const auto& stats = m_current_pipeline->getStats();
 			ImGui::LabelText("Draw calls", "%d", stats.m_draw_call_count);
 			ImGui::LabelText("Instances", "%d", stats.m_instance_count);
+			ImGui::LabelText("Visible meshes", "%d", stats.m_visible_mesh_count);
 			char buf[30];
 			Lumix::toCStringPretty(stats.m_triangle_count, buf, Lumix::lengthOf(buf));
 			ImGui::LabelText("Triangles", buf);
@@ -3,7 +3,9 @@
 #include "core/FS/file_system.h"
 #include "core/FS/ifile.h"
 #include "core/FS/os_file.h"
+#include "core/crc32.h"
 #include "core/log.h"
+#include "core/math_utils.h"
 #include "core/mt/thread.h"
 #include "core/path.h"
 #include "core/path_utils.h"
@@ -31,10 +33,16 @@ ShaderCompiler::ShaderCompiler(StudioApp& app, LogUI& log_ui)
 	, m_to_reload(m_editor.getAllocator())
 	, m_processes(m_editor.getAllocator())
 	, m_changed_files(m_editor.getAllocator())
+	, m_jobs(m_editor.getAllocator())
+	, m_progress(m_editor.getAllocator())
+	, m_hashes(m_editor.getAllocator())
+	, m_file_hashes(m_editor.getAllocator())
 	, m_mutex(false)
 {
 	m_notifications_id = -1;
 	m_is_compiling = false;
+	m_max_processes = Lumix::Math::maxValue((int)Lumix::MT::getCPUsCount(), 1);
+	loadHashes();
 
 	m_watcher = FileSystemWatcher::create("shaders", m_editor.getAllocator());
 	m_watcher->getCallback().bind<ShaderCompiler, &ShaderCompiler::onFileChanged>(this);
@@ -99,10 +107,17 @@ bool ShaderCompiler::isChanged(const Lumix::ShaderCombinations& combinations,
 		shd_last_modified = PlatformInterface::getLastModified(tmp);
 	}
 
+	const char* pack_path = StringBuilder<Lumix::MAX_PATH_LENGTH>(bin_base_path, ".shp");
+	if (!PlatformInterface::fileExists(pack_path) ||
+		PlatformInterface::getLastModified(pack_path) < shd_last_modified)
+	{
+		return true;
+	}
+
 	for (int i = 0; i < combinations.m_pass_count; ++i)
 	{
 		const char* pass_path =
-			StringBuilder<Lumix::MAX_PATH_LENGTH>(bin_base_path, combinations.m_passes[i]);
+			StringBuilder<Lumix::MAX_PATH_LENGTH>(bin_base_path, "_", combinations.m_passes[i]);
 		for (int j = 0; j < 1 << Lumix::lengthOf(combinations.m_defines); ++j)
 		{
 			if ((j & (~combinations.m_vs_local_mask[i])) == 0)
@@ -164,7 +179,7 @@ void ShaderCompiler::makeUpToDate()
 		Lumix::Shader::getShaderCombinations(getRenderer(), &data[0], &combinations);
 
 		const char* bin_base_path =
-			StringBuilder<Lumix::MAX_PATH_LENGTH>("shaders/compiled/", basename, "_");
+			StringBuilder<Lumix::MAX_PATH_LENGTH>("shaders/compiled/", basename);
 		if (isChanged(combinations, bin_base_path, shd_path))
 		{
 			src_list.emplace(shd_path, m_editor.getAllocator());
@@ -311,7 +326,7 @@ void ShaderCompiler::addDependency(const char* ckey, const char* cvalue)
 
 ShaderCompiler::~ShaderCompiler()
 {
-	while (!m_processes.empty()) update();
+	while (!m_processes.empty() || !m_jobs.empty()) update();
 
 	FileSystemWatcher::destroy(m_watcher);
 }
@@ -339,7 +354,7 @@ void ShaderCompiler::updateNotifications()
 		m_notifications_id = m_log_ui.addNotification("Compiling shaders...");
 	}
 
-	if (!m_is_compiling)
+	if (!m_is_compiling && m_notifications_id >= 0)
 	{
 		m_log_ui.setNotificationTime(m_notifications_id, 3.0f);
 		m_notifications_id = -1;
@@ -347,6 +362,120 @@ void ShaderCompiler::updateNotifications()
 }
 
 
+static const char* HASHES_PATH = "/shaders/compiled/hashes.bin";
+
+
+void ShaderCompiler::loadHashes()
+{
+	StringBuilder<Lumix::MAX_PATH_LENGTH> path(
+		m_editor.getEngine().getDiskFileDevice()->getBasePath(0), HASHES_PATH);
+	Lumix::FS::OsFile file;
+	if (!file.open(path, Lumix::FS::Mode::OPEN_AND_READ, m_editor.getAllocator())) return;
+
+	Lumix::int32 count = 0;
+	file.read(&count, sizeof(count));
+	for (int i = 0; i < count; ++i)
+	{
+		Lumix::uint32 key, hash;
+		if (!file.read(&key, sizeof(key)) || !file.read(&hash, sizeof(hash))) break;
+		m_hashes.insert(key, hash);
+	}
+	file.close();
+}
+
+
+void ShaderCompiler::saveHashes()
+{
+	StringBuilder<Lumix::MAX_PATH_LENGTH> path(
+		m_editor.getEngine().getDiskFileDevice()->getBasePath(0), HASHES_PATH);
+	Lumix::FS::OsFile file;
+	if (!file.open(path, Lumix::FS::Mode::CREATE | Lumix::FS::Mode::WRITE, m_editor.getAllocator()))
+	{
+		Lumix::g_log_error.log("Editor") << "Could not save " << path;
+		return;
+	}
+
+	Lumix::int32 count = m_hashes.size();
+	file.write(&count, sizeof(count));
+	for (int i = 0; i < count; ++i)
+	{
+		Lumix::uint32 key = m_hashes.getKey(i);
+		file.write(&key, sizeof(key));
+		file.write(&m_hashes.at(i), sizeof(m_hashes.at(i)));
+	}
+	file.close();
+}
+
+
+Lumix::uint32 ShaderCompiler::getFileHash(const char* path)
+{
+	Lumix::uint32 path_hash = Lumix::crc32(path);
+	int idx = m_file_hashes.find(path_hash);
+	if (idx >= 0) return m_file_hashes.at(idx);
+
+	Lumix::uint32 hash = 0;
+	Lumix::FS::OsFile file;
+	if (file.open(path, Lumix::FS::Mode::OPEN_AND_READ, m_editor.getAllocator()))
+	{
+		Lumix::Array<Lumix::uint8> data(m_editor.getAllocator());
+		data.resize((int)file.size());
+		if (!data.empty()) file.read(&data[0], data.size());
+		file.close();
+		hash = data.empty() ? 0 : Lumix::crc32(&data[0], data.size());
+	}
+	m_file_hashes.insert(path_hash, hash);
+	return hash;
+}
+
+
+// the command line has the defines, the includes are listed in the .d file of the last compile
+Lumix::uint32 ShaderCompiler::getPermutationHash(const char* source_path,
+	const char* out_path,
+	const char* args)
+{
+	Lumix::uint32 hash = Lumix::crc32(args) ^ getFileHash(source_path);
+
+	StringBuilder<Lumix::MAX_PATH_LENGTH> dep_path(out_path, ".d");
+	Lumix::FS::OsFile file;
+	if (!file.open(dep_path, Lumix::FS::Mode::OPEN_AND_READ, m_editor.getAllocator())) return hash;
+
+	Lumix::Array<char> data(m_editor.getAllocator());
+	data.resize((int)file.size() + 1);
+	if (data.size() > 1) file.read(&data[0], data.size() - 1);
+	data.back() = '\0';
+	file.close();
+
+	// the first line is the binary itself
+	char* c = &data[0];
+	while (*c && *c != '\n') ++c;
+	while (*c)
+	{
+		while (*c == ' ' || *c == '\t' || *c == '\n' || *c == '\r' || *c == '\\') ++c;
+		char* include = c;
+		while (*c && *c != ' ' && *c != '\t' && *c != '\n' && *c != '\r') ++c;
+		if (c == include) continue;
+		char tmp = *c;
+		*c = '\0';
+		hash = Lumix::crc32(&hash, sizeof(hash)) ^ getFileHash(include);
+		*c = tmp;
+	}
+	return hash;
+}
+
+
+int ShaderCompiler::getShaderProgress(const char* shd_path)
+{
+	for (int i = 0; i < m_progress.size(); ++i)
+	{
+		if (Lumix::compareString(m_progress[i].path, shd_path) == 0) return i;
+	}
+	ShaderProgress& progress = m_progress.emplace();
+	Lumix::copyString(progress.path, shd_path);
+	progress.compiled_count = progress.failed_count = progress.skipped_count = 0;
+	return m_progress.size() - 1;
+}
+
+
 void ShaderCompiler::compilePass(const char* shd_path,
 	bool is_vertex_shader,
 	const char* pass,
@@ -354,12 +483,12 @@ void ShaderCompiler::compilePass(const char* shd_path,
 	const Lumix::ShaderCombinations::Defines& all_defines)
 {
 	const char* base_path = m_editor.getEngine().getDiskFileDevice()->getBasePath(0);
+	int shader_idx = getShaderProgress(shd_path);
 
 	for (int mask = 0; mask < 1 << Lumix::lengthOf(all_defines); ++mask)
 	{
 		if ((mask & (~define_mask)) == 0)
 		{
-			updateNotifications();
 			char basename[Lumix::MAX_PATH_LENGTH];
 			Lumix::PathUtils::getBasename(basename, sizeof(basename), shd_path);
 			const char* source_path = StringBuilder<Lumix::MAX_PATH_LENGTH>(
@@ -385,22 +514,53 @@ void ShaderCompiler::compilePass(const char* shd_path,
 				}
 			}
 
-			StringBuilder<Lumix::MAX_PATH_LENGTH> cmd(base_path, "/shaders/shaderc.exe");
-
-			PlatformInterface::deleteFile(out_path);
-			auto* process = PlatformInterface::createProcess(cmd, args, m_editor.getAllocator());
-			if (!process)
-			{
-				Lumix::g_log_error.log("Editor") << "Could not execute command: " << cmd;
-			}
-			else
+			StringBuilder<Lumix::MAX_PATH_LENGTH> source_file(
+				base_path, "/shaders/", basename, is_vertex_shader ? "_vs.sc" : "_fs.sc");
+			Lumix::uint32 hash = getPermutationHash(source_file, out_path, args);
+			int hash_idx = m_hashes.find(Lumix::crc32(out_path));
+			if (hash_idx >= 0 && m_hashes.at(hash_idx) == hash &&
+				PlatformInterface::fileExists(out_path))
 			{
-				auto& p = m_processes.emplace();
-				p.process = process;
-				Lumix::copyString(p.path, out_path);
+				++m_progress[shader_idx].skipped_count;
+				continue;
 			}
+
+			CompileJob& job = m_jobs.emplace();
+			Lumix::copyString(job.path, out_path);
+			Lumix::copyString(job.args, args);
+			job.hash = hash;
+			job.shader_idx = shader_idx;
 		}
 	}
+	m_is_compiling = m_is_compiling || !m_jobs.empty();
+	updateNotifications();
+}
+
+
+void ShaderCompiler::startJobs()
+{
+	const char* base_path = m_editor.getEngine().getDiskFileDevice()->getBasePath(0);
+	StringBuilder<Lumix::MAX_PATH_LENGTH> cmd(base_path, "/shaders/shaderc.exe");
+	while (!m_jobs.empty() && m_processes.size() < m_max_processes)
+	{
+		CompileJob job = m_jobs.back();
+		m_jobs.pop();
+
+		PlatformInterface::deleteFile(job.path);
+		auto* process = PlatformInterface::createProcess(cmd, job.args, m_editor.getAllocator());
+		if (!process)
+		{
+			Lumix::g_log_error.log("Editor") << "Could not execute command: " << cmd;
+			++m_progress[job.shader_idx].failed_count;
+			continue;
+		}
+
+		auto& p = m_processes.emplace();
+		p.process = process;
+		p.hash = job.hash;
+		p.shader_idx = job.shader_idx;
+		Lumix::copyString(p.path, job.path);
+	}
 }
 
 
@@ -493,33 +653,73 @@ void ShaderCompiler::update()
 
 				char buf[1024];
 				int read;
-				Lumix::g_log_error.log("Editor") << m_processes[i].path;
+				Lumix::g_log_error.log("Editor")
+					<< m_progress[m_processes[i].shader_idx].path << ": " << m_processes[i].path;
 				while ((read = PlatformInterface::getProcessOutput(
 							*m_processes[i].process, buf, sizeof(buf) - 1)) > 0)
 				{
 					buf[read] = 0;
 					Lumix::g_log_error.log("Editor") << buf;
 				}
+				++m_progress[m_processes[i].shader_idx].failed_count;
+			}
+			else
+			{
+				++m_progress[m_processes[i].shader_idx].compiled_count;
+				Lumix::uint32 key = Lumix::crc32(m_processes[i].path);
+				int hash_idx = m_hashes.find(key);
+				if (hash_idx >= 0)
+				{
+					m_hashes.at(hash_idx) = m_processes[i].hash;
+				}
+				else
+				{
+					m_hashes.insert(key, m_processes[i].hash);
+				}
 			}
 
 			PlatformInterface::destroyProcess(*m_processes[i].process);
 			m_processes.eraseFast(i);
-
-			updateNotifications();
-			if (m_processes.empty() && m_changed_files.empty())
-			{
-				reloadShaders();
-				parseDependencies();
-			}
+			--i;
 		}
 	}
-	m_is_compiling = !m_processes.empty();
+	startJobs();
+
+	if (m_processes.empty() && m_jobs.empty() && m_changed_files.empty() && !m_progress.empty())
+	{
+		finishCompilation();
+	}
+	m_is_compiling = !m_processes.empty() || !m_jobs.empty();
+	updateNotifications();
 	m_app.getAssetBrowser()->enableUpdate(!m_is_compiling);
 
 	processChangedFiles();
 }
 
 
+void ShaderCompiler::finishCompilation()
+{
+	m_to_reload.removeDuplicates();
+	for (auto& path : m_to_reload)
+	{
+		pack(path.c_str());
+	}
+	reloadShaders();
+	parseDependencies();
+	saveHashes();
+
+	for (auto& progress : m_progress)
+	{
+		auto& log = progress.failed_count > 0 ? Lumix::g_log_error : Lumix::g_log_info;
+		log.log("Editor") << progress.path << ": " << progress.compiled_count << " compiled, "
+						  << progress.skipped_count << " up to date, " << progress.failed_count
+						  << " failed";
+	}
+	m_progress.clear();
+	m_file_hashes.clear();
+}
+
+
 void ShaderCompiler::compileAllPasses(const char* path,
 	bool is_vertex_shader,
 	const int* define_masks,
@@ -536,6 +736,110 @@ void ShaderCompiler::compileAllPasses(const char* path,
 }
 
 
+// the runtime reads only the pack, the .shb files are kept to know what is up to date
+void ShaderCompiler::pack(const char* shd_path)
+{
+	auto& allocator = m_editor.getAllocator();
+	auto& fs = m_editor.getEngine().getFileSystem();
+	auto* file = fs.open(fs.getDiskDevice(), Lumix::Path(shd_path), Lumix::FS::Mode::OPEN_AND_READ);
+	if (!file)
+	{
+		Lumix::g_log_error.log("Editor") << "Could not open " << shd_path;
+		return;
+	}
+	int size = (int)file->size();
+	Lumix::Array<char> data(allocator);
+	data.resize(size + 1);
+	file->read(&data[0], size);
+	data[size] = 0;
+	fs.close(*file);
+
+	Lumix::ShaderCombinations combinations;
+	Lumix::Shader::getShaderCombinations(getRenderer(), &data[0], &combinations);
+
+	const char* base_path = m_editor.getEngine().getDiskFileDevice()->getBasePath(0);
+	char basename[Lumix::MAX_PATH_LENGTH];
+	Lumix::PathUtils::getBasename(basename, sizeof(basename), shd_path);
+	Lumix::Array<Lumix::ShaderPackEntry> entries(allocator);
+	Lumix::Array<Lumix::ShaderPackBlob> blobs(allocator);
+	Lumix::Array<Lumix::uint32> blob_hashes(allocator);
+	Lumix::Array<Lumix::uint8> bytecode(allocator);
+	Lumix::Array<Lumix::uint8> binary(allocator);
+	for (int i = 0; i < combinations.m_pass_count; ++i)
+	{
+		const char* pass = combinations.m_passes[i];
+		for (int is_vertex = 0; is_vertex < 2; ++is_vertex)
+		{
+			int local_mask =
+				is_vertex ? combinations.m_vs_local_mask[i] : combinations.m_fs_local_mask[i];
+			for (int mask = 0; mask < 1 << Lumix::lengthOf(combinations.m_defines); ++mask)
+			{
+				if ((mask & (~local_mask)) != 0) continue;
+
+				StringBuilder<Lumix::MAX_PATH_LENGTH> bin_path(
+					base_path, "/shaders/compiled/", basename, "_");
+				bin_path << pass << mask << (is_vertex ? "_vs.shb" : "_fs.shb");
+				Lumix::FS::OsFile bin_file;
+				if (!bin_file.open(bin_path, Lumix::FS::Mode::OPEN_AND_READ, allocator))
+				{
+					Lumix::g_log_error.log("Editor") << "Could not open " << bin_path;
+					continue;
+				}
+				binary.resize((int)bin_file.size());
+				if (!binary.empty()) bin_file.read(&binary[0], binary.size());
+				bin_file.close();
+				if (binary.empty()) continue;
+
+				Lumix::uint32 hash = Lumix::crc32(&binary[0], binary.size());
+				int blob_idx = -1;
+				for (int j = 0; j < blobs.size(); ++j)
+				{
+					if (blob_hashes[j] == hash && blobs[j].size == (Lumix::uint32)binary.size() &&
+						Lumix::compareMemory(
+							&bytecode[blobs[j].offset], &binary[0], binary.size()) == 0)
+					{
+						blob_idx = j;
+						break;
+					}
+				}
+				if (blob_idx < 0)
+				{
+					blob_idx = blobs.size();
+					Lumix::ShaderPackBlob& blob = blobs.emplace();
+					blob.offset = bytecode.size();
+					blob.size = binary.size();
+					blob_hashes.push(hash);
+					bytecode.resize(bytecode.size() + binary.size());
+					Lumix::copyMemory(&bytecode[blob.offset], &binary[0], binary.size());
+				}
+				Lumix::ShaderPackEntry& entry = entries.emplace();
+				entry.key = Lumix::Shader::getPackKey(pass, mask, is_vertex != 0);
+				entry.blob = blob_idx;
+			}
+		}
+	}
+
+	StringBuilder<Lumix::MAX_PATH_LENGTH> pack_path(
+		base_path, "/shaders/compiled/", basename, ".shp");
+	Lumix::FS::OsFile pack_file;
+	if (!pack_file.open(pack_path, Lumix::FS::Mode::CREATE | Lumix::FS::Mode::WRITE, allocator))
+	{
+		Lumix::g_log_error.log("Editor") << "Could not create " << pack_path;
+		return;
+	}
+	Lumix::ShaderPackHeader header;
+	header.magic = Lumix::ShaderPackHeader::MAGIC;
+	header.version = Lumix::ShaderPackHeader::VERSION;
+	header.entry_count = entries.size();
+	header.blob_count = blobs.size();
+	pack_file.write(&header, sizeof(header));
+	if (!entries.empty()) pack_file.write(&entries[0], entries.size() * sizeof(entries[0]));
+	if (!blobs.empty()) pack_file.write(&blobs[0], blobs.size() * sizeof(blobs[0]));
+	if (!bytecode.empty()) pack_file.write(&bytecode[0], bytecode.size());
+	pack_file.close();
+}
+
+
 void ShaderCompiler::compile(const char* path)
 {
 	StringBuilder<Lumix::MAX_PATH_LENGTH> compiled_dir(
@@ -33,6 +33,9 @@ public:
 	void compileAll(bool wait);
 	void update();
 	bool isCompiling() const { return m_is_compiling; }
+	// how many shaderc processes run at once, the number of cores by default
+	void setMaxProcesses(int count) { m_max_processes = count > 0 ? count : 1; }
+	int getMaxProcesses() const { return m_max_processes; }
 
 private:
 	void wait();
@@ -55,16 +58,45 @@ private:
 	void onFileChanged(const char* path);
 	void parseDependencies();
 	void compile(const char* path);
+	void pack(const char* shd_path);
 	void makeUpToDate();
 	Lumix::Renderer& getRenderer();
 	void addDependency(const char* key, const char* value);
 	void processChangedFiles();
+	void startJobs();
+	void finishCompilation();
+	int getShaderProgress(const char* shd_path);
+	Lumix::uint32 getFileHash(const char* path);
+	Lumix::uint32 getPermutationHash(const char* source_path,
+		const char* out_path,
+		const char* args);
+	void loadHashes();
+	void saveHashes();
 
 private:
+	struct CompileJob
+	{
+		char path[Lumix::MAX_PATH_LENGTH];
+		char args[1024];
+		Lumix::uint32 hash;
+		int shader_idx;
+	};
+
 	struct ProcessInfo
 	{
 		PlatformInterface::Process* process;
 		char path[Lumix::MAX_PATH_LENGTH];
+		Lumix::uint32 hash;
+		int shader_idx;
+	};
+
+	// permutations of one shader compiled in the current batch
+	struct ShaderProgress
+	{
+		char path[Lumix::MAX_PATH_LENGTH];
+		int compiled_count;
+		int failed_count;
+		int skipped_count;
 	};
 
 private:
@@ -76,6 +108,13 @@ private:
 	Lumix::Array<Lumix::string> m_to_reload;
 	Lumix::Array<ProcessInfo> m_processes;
 	Lumix::Array<Lumix::string> m_changed_files;
+	Lumix::Array<CompileJob> m_jobs;
+	Lumix::Array<ShaderProgress> m_progress;
+	// hash of the inputs of each compiled permutation, by the hash of its output path
+	Lumix::AssociativeArray<Lumix::uint32, Lumix::uint32> m_hashes;
+	// contents of sources and includes read in the current batch
+	Lumix::AssociativeArray<Lumix::uint32, Lumix::uint32> m_file_hashes;
+	int m_max_processes;
 	Lumix::MT::SpinMutex m_mutex;
 	LogUI& m_log_ui;
 	bool m_is_compiling;
@@ -3,6 +3,8 @@
 #include "core/crc32.h"
 #include "core/frustum.h"
 #include "core/json_serializer.h"
+#include "core/lz4.h"
+#include "core/MTJD/parallel_for.h"
 #include "core/profiler.h"
 #include "core/resource_manager.h"
 #include "core/resource_manager_base.h"
@@ -32,6 +34,8 @@ static const char* SPLATMAP_UNIFORM = "u_texSplatmap";
 static const char* COLORMAP_UNIFORM = "u_texColormap";
 static const char* TEX_COLOR_UNIFORM = "u_texColor";
 static const float MIN_BRUSH_SIZE = 0.5f;
+// pixels of a brush rastered by one job
+static const int BRUSH_TILE_PIXELS = 64 * 64;
 
 
 struct PaintTerrainCommand : public Lumix::IEditorCommand
@@ -51,6 +55,8 @@ struct PaintTerrainCommand : public Lumix::IEditorCommand
 		, m_old_data(editor.getAllocator())
 		, m_items(editor.getAllocator())
 		, m_mask(editor.getAllocator())
+		, m_is_new_data_compacted(false)
+		, m_is_old_data_compacted(false)
 	{
 	}
 
@@ -76,6 +82,8 @@ struct PaintTerrainCommand : public Lumix::IEditorCommand
 		, m_texture_idx(texture_idx)
 		, m_mask(editor.getAllocator())
 		, m_flat_height(flat_height)
+		, m_is_new_data_compacted(false)
+		, m_is_old_data_compacted(false)
 	{
 		m_mask.resize(mask.size());
 		for (int i = 0; i < mask.size(); ++i)
@@ -168,12 +176,34 @@ struct PaintTerrainCommand : public Lumix::IEditorCommand
 			saveOldData();
 			generateNewData();
 		}
+		expand();
 		applyData(m_new_data);
 		return true;
 	}
 
 
-	void undo() override { applyData(m_old_data); }
+	void undo() override
+	{
+		expand();
+		applyData(m_old_data);
+	}
+
+
+	int getMemorySize() const override { return m_new_data.size() + m_old_data.size(); }
+
+
+	void compact() override
+	{
+		auto& allocator = m_world_editor.getAllocator();
+		if (!m_is_new_data_compacted)
+		{
+			m_is_new_data_compacted = Lumix::lz4CompressInPlace(m_new_data, allocator);
+		}
+		if (!m_is_old_data_compacted)
+		{
+			m_is_old_data_compacted = Lumix::lz4CompressInPlace(m_old_data, allocator);
+		}
+	}
 
 
 	Lumix::uint32 getType() override
@@ -194,6 +224,7 @@ struct PaintTerrainCommand : public Lumix::IEditorCommand
 		if (m_terrain == my_command.m_terrain && m_type == my_command.m_type &&
 			m_texture_idx == my_command.m_texture_idx)
 		{
+			my_command.expand();
 			my_command.m_items.push(m_items.back());
 			my_command.resizeData();
 			my_command.rasterItem(
@@ -285,25 +316,24 @@ private:
 
 
 	void rasterColorItem(Lumix::Texture* texture,
-						 Lumix::Array<Lumix::uint8>& data,
-						 Item& item)
+		Lumix::Array<Lumix::uint8>& data,
+		Item& item,
+		const Rectangle& r,
+		int from_y,
+		int to_y)
 	{
-		int texture_width = texture->getWidth();
-		Rectangle r =
-			item.getBoundingRectangle(texture_width, texture->getHeight());
-
 		if (texture->getBytesPerPixel() != 4)
 		{
 			ASSERT(false);
 			return;
 		}
-		float fx = 0;
 		float fstepx = 1.0f / (r.m_to_x - r.m_from_x);
 		float fstepy = 1.0f / (r.m_to_y - r.m_from_y);
-		for (int i = r.m_from_x, end = r.m_to_x; i < end; ++i, fx += fstepx)
+		float fy = (from_y - r.m_from_y) * fstepy;
+		for (int j = from_y; j < to_y; ++j, fy += fstepy)
 		{
-			float fy = 0;
-			for (int j = r.m_from_y, end2 = r.m_to_y; j < end2; ++j, fy += fstepy)
+			float fx = 0;
+			for (int i = r.m_from_x, end = r.m_to_x; i < end; ++i, fx += fstepx)
 			{
 				if (isMasked(fx, fy))
 				{
@@ -333,26 +363,25 @@ private:
 
 
 	void rasterLayerItem(Lumix::Texture* texture,
-						 Lumix::Array<Lumix::uint8>& data,
-						 Item& item)
+		Lumix::Array<Lumix::uint8>& data,
+		Item& item,
+		const Rectangle& r,
+		int from_y,
+		int to_y)
 	{
-		int texture_width = texture->getWidth();
-		Rectangle r =
-			item.getBoundingRectangle(texture_width, texture->getHeight());
-
 		if (texture->getBytesPerPixel() != 4)
 		{
 			ASSERT(false);
 			return;
 		}
 
-		float fx = 0;
 		float fstepx = 1.0f / (r.m_to_x - r.m_from_x);
 		float fstepy = 1.0f / (r.m_to_y - r.m_from_y);
-		for (int i = r.m_from_x, end = r.m_to_x; i < end; ++i, fx += fstepx)
+		float fy = (from_y - r.m_from_y) * fstepy;
+		for (int j = from_y; j < to_y; ++j, fy += fstepy)
 		{
-			float fy = 0;
-			for (int j = r.m_from_y, end2 = r.m_to_y; j < end2; ++j, fy += fstepy)
+			float fx = 0;
+			for (int i = r.m_from_x, end = r.m_to_x; i < end; ++i, fx += fstepx)
 			{
 				if (isMasked(fx, fy))
 				{
@@ -379,18 +408,20 @@ private:
 	}
 
 
-	void rasterSmoothHeightItem(Lumix::Texture* texture, Lumix::Array<Lumix::uint8>& data, Item& item)
+	void rasterSmoothHeightItem(Lumix::Texture* texture,
+		Lumix::Array<Lumix::uint8>& data,
+		Item& item,
+		const Rectangle& rect,
+		int from_y,
+		int to_y,
+		float avg)
 	{
 		ASSERT(texture->getBytesPerPixel() == 2);
 
 		int texture_width = texture->getWidth();
-		Rectangle rect;
-		rect = item.getBoundingRectangle(texture_width, texture->getHeight());
-
-		float avg = computeAverage16(texture, rect.m_from_x, rect.m_to_x, rect.m_from_y, rect.m_to_y);
-		for (int i = rect.m_from_x, end = rect.m_to_x; i < end; ++i)
+		for (int j = from_y; j < to_y; ++j)
 		{
-			for (int j = rect.m_from_y, end2 = rect.m_to_y; j < end2; ++j)
+			for (int i = rect.m_from_x, end = rect.m_to_x; i < end; ++i)
 			{
 				float attenuation = getAttenuation(item, i, j);
 				int offset = i - m_x + (j - m_y) * m_width;
@@ -402,17 +433,17 @@ private:
 	}
 
 
-	void rasterFlatHeightItem(Lumix::Texture* texture, Lumix::Array<Lumix::uint8>& data, Item& item)
+	void rasterFlatHeightItem(Lumix::Texture* texture,
+		Lumix::Array<Lumix::uint8>& data,
+		const Rectangle& rect,
+		int from_y,
+		int to_y)
 	{
 		ASSERT(texture->getBytesPerPixel() == 2);
 
-		int texture_width = texture->getWidth();
-		Rectangle rect;
-		rect = item.getBoundingRectangle(texture_width, texture->getHeight());
-
-		for (int i = rect.m_from_x, end = rect.m_to_x; i < end; ++i)
+		for (int j = from_y; j < to_y; ++j)
 		{
-			for (int j = rect.m_from_y, end2 = rect.m_to_y; j < end2; ++j)
+			for (int i = rect.m_from_x, end = rect.m_to_x; i < end; ++i)
 			{
 				int offset = i - m_x + (j - m_y) * m_width;
 				((Lumix::uint16*)&data[0])[offset] = m_flat_height;
@@ -421,42 +452,23 @@ private:
 	}
 
 
-	void rasterItem(Lumix::Texture* texture, Lumix::Array<Lumix::uint8>& data, Item& item)
+	void rasterHeightItem(Lumix::Texture* texture,
+		Lumix::Array<Lumix::uint8>& data,
+		Item& item,
+		const Rectangle& rect,
+		int from_y,
+		int to_y)
 	{
-		if (m_type == TerrainEditor::COLOR)
-		{
-			rasterColorItem(texture, data, item);
-			return;
-		}
-		else if (m_type == TerrainEditor::LAYER)
-		{
-			rasterLayerItem(texture, data, item);
-			return;
-		}
-		else if (m_type == TerrainEditor::SMOOTH_HEIGHT)
-		{
-			rasterSmoothHeightItem(texture, data, item);
-			return;
-		}
-		else if (m_type == TerrainEditor::FLAT_HEIGHT)
-		{
-			rasterFlatHeightItem(texture, data, item);
-			return;		
-		}
-
 		ASSERT(texture->getBytesPerPixel() == 2);
 
 		int texture_width = texture->getWidth();
-		Rectangle rect;
-		rect = item.getBoundingRectangle(texture_width, texture->getHeight());
-
 		const float STRENGTH_MULTIPLICATOR = 256.0f;
 		float amount =
 			Lumix::Math::maxValue(item.m_amount * item.m_amount * STRENGTH_MULTIPLICATOR, 1.0f);
 
-		for (int i = rect.m_from_x, end = rect.m_to_x; i < end; ++i)
+		for (int j = from_y; j < to_y; ++j)
 		{
-			for (int j = rect.m_from_y, end2 = rect.m_to_y; j < end2; ++j)
+			for (int i = rect.m_from_x, end = rect.m_to_x; i < end; ++i)
 			{
 				float attenuation = getAttenuation(item, i, j);
 				int offset = i - m_x + (j - m_y) * m_width;
@@ -471,6 +483,57 @@ private:
 	}
 
 
+	// rows of the brush are split to tiles rastered in parallel, each tile writes its own rows
+	void rasterItem(Lumix::Texture* texture, Lumix::Array<Lumix::uint8>& data, Item& item)
+	{
+		PROFILE_FUNCTION();
+		Rectangle rect = item.getBoundingRectangle(texture->getWidth(), texture->getHeight());
+		int width = rect.m_to_x - rect.m_from_x;
+		if (width <= 0 || rect.m_to_y <= rect.m_from_y) return;
+
+		float avg = 0;
+		if (m_type == TerrainEditor::SMOOTH_HEIGHT)
+		{
+			avg = computeAverage16(
+				texture, rect.m_from_x, rect.m_to_x, rect.m_from_y, rect.m_to_y);
+		}
+
+		int rows_per_tile = Lumix::Math::maxValue(BRUSH_TILE_PIXELS / width, 1);
+		auto& manager = m_world_editor.getEngine().getMTJDManager();
+		Lumix::MTJD::parallelFor(manager,
+			rect.m_from_y,
+			rect.m_to_y,
+			rows_per_tile,
+			[this, texture, &data, &item, &rect, avg](int from_y, int to_y) {
+				switch (m_type)
+				{
+					case TerrainEditor::COLOR:
+						rasterColorItem(texture, data, item, rect, from_y, to_y);
+						break;
+					case TerrainEditor::LAYER:
+						rasterLayerItem(texture, data, item, rect, from_y, to_y);
+						break;
+					case TerrainEditor::SMOOTH_HEIGHT:
+						rasterSmoothHeightItem(texture, data, item, rect, from_y, to_y, avg);
+						break;
+					case TerrainEditor::FLAT_HEIGHT:
+						rasterFlatHeightItem(texture, data, rect, from_y, to_y);
+						break;
+					default: rasterHeightItem(texture, data, item, rect, from_y, to_y); break;
+				}
+			});
+	}
+
+
+	void expand()
+	{
+		auto& allocator = m_world_editor.getAllocator();
+		if (m_is_new_data_compacted) Lumix::lz4DecompressInPlace(m_new_data, allocator);
+		if (m_is_old_data_compacted) Lumix::lz4DecompressInPlace(m_old_data, allocator);
+		m_is_new_data_compacted = m_is_old_data_compacted = false;
+	}
+
+
 	void generateNewData()
 	{
 		auto texture = getDestinationTexture();
@@ -537,8 +600,8 @@ private:
 				}
 			}
 		}
+		// the terrain regenerates its grass in the rectangle, it is uploaded at the end of frame
 		texture->onDataUpdated(m_x, m_y, m_width, m_height);
-		static_cast<Lumix::RenderScene*>(m_terrain.scene)->forceGrassUpdate(m_terrain.index);
 	}
 
 
@@ -630,6 +693,8 @@ private:
 	Lumix::BinaryArray m_mask;
 	Lumix::uint16 m_flat_height;
 	bool m_can_be_merged;
+	bool m_is_new_data_compacted;
+	bool m_is_old_data_compacted;
 };
 
 
@@ -1084,8 +1149,6 @@ void TerrainEditor::paintEntities(const Lumix::RayCastModelHit& hit)
 	int templates_count = template_names.size();
 	if (m_selected_entity_template >= templates_count) return;
 
-	static const Lumix::uint32 PAINT_ENTITIES_HASH = Lumix::crc32("paint_entities");
-	m_world_editor.beginCommandGroup(PAINT_ENTITIES_HASH);
 	{
 		Lumix::RenderScene* scene = static_cast<Lumix::RenderScene*>(m_component.scene);
 		Lumix::Matrix terrain_matrix = m_world_editor.getUniverse()->getMatrix(m_component.entity);
@@ -1117,6 +1180,8 @@ void TerrainEditor::paintEntities(const Lumix::RayCastModelHit& hit)
 		scene->getTerrainSize(m_component.index, &w, &h);
 		float scale = 1.0f - Lumix::Math::maxValue(0.01f, m_terrain_brush_strength);
 		Lumix::Model* model = scene->getRenderableModel(renderable.index);
+		Lumix::Array<Lumix::Vec3> positions(m_world_editor.getAllocator());
+		Lumix::Array<Lumix::Quat> rotations(m_world_editor.getAllocator());
 		for(int i = 0; i <= m_terrain_brush_size * m_terrain_brush_size / 1000.0f; ++i)
 		{
 			float angle = Lumix::Math::randFloat(0, Lumix::Math::PI * 2);
@@ -1159,12 +1224,17 @@ void TerrainEditor::paintEntities(const Lumix::RayCastModelHit& hit)
 						}
 					}
 
-					auto entity = template_system.createInstance(template_name, pos, rot);
+					positions.push(pos);
+					rotations.push(rot);
 				}
 			}
 		}
+		if (!positions.empty())
+		{
+			template_system.createInstances(
+				template_name, &positions[0], &rotations[0], positions.size());
+		}
 	}
-	m_world_editor.endCommandGroup();
 }
 
 
@@ -1250,6 +1320,11 @@ void TerrainEditor::onGUI()
 	bool is_grass_enabled = scene->isGrassEnabled();
 
 	if (ImGui::Checkbox("Enable grass", &is_grass_enabled)) scene->enableGrass(is_grass_enabled);
+	bool is_gpu_grass_enabled = scene->isGPUGrassEnabled();
+	if (ImGui::Checkbox("GPU grass", &is_gpu_grass_enabled))
+	{
+		scene->enableGPUGrass(is_gpu_grass_enabled);
+	}
 
 	if (ImGui::Combo(
 			"Brush type", &m_current_brush, "Height\0Layer\0Entity\0Color\0"))
@@ -1,11 +1,10 @@
 #include "renderer/frame_buffer.h"
 #include "core/json_serializer.h"
 #include "core/log.h"
+#include "core/lua_compat.h"
 #include "core/string.h"
 #include "core/vec.h"
 #include <bgfx/bgfx.h>
-#include <lua.hpp>
-#include <lauxlib.h>
 
 
 namespace Lumix
@@ -16,21 +15,9 @@ FrameBuffer::FrameBuffer(const Declaration& decl)
 	: m_declaration(decl)
 {
 	m_autodestroy_handle = true;
-	bgfx::TextureHandle texture_handles[16];
-
-	for (int i = 0; i < decl.m_renderbuffers_count; ++i)
-	{
-		const RenderBuffer& renderbuffer = decl.m_renderbuffers[i];
-		texture_handles[i] = bgfx::createTexture2D((uint16_t)decl.m_width,
-			(uint16_t)decl.m_height,
-			1,
-			renderbuffer.m_format,
-			BGFX_TEXTURE_RT);
-		m_declaration.m_renderbuffers[i].m_handle = texture_handles[i];
-	}
-
+	m_is_alias = false;
 	m_window_handle = nullptr;
-	m_handle = bgfx::createFrameBuffer((uint8_t)decl.m_renderbuffers_count, texture_handles);
+	createRenderbuffers();
 	ASSERT(bgfx::isValid(m_handle));
 }
 
@@ -38,6 +25,7 @@ FrameBuffer::FrameBuffer(const Declaration& decl)
 FrameBuffer::FrameBuffer(const char* name, int width, int height, void* window_handle)
 {
 	m_autodestroy_handle = false;
+	m_is_alias = false;
 	copyString(m_declaration.m_name, name);
 	m_declaration.m_width = width;
 	m_declaration.m_height = height;
@@ -50,7 +38,7 @@ FrameBuffer::FrameBuffer(const char* name, int width, int height, void* window_h
 
 FrameBuffer::~FrameBuffer()
 {
-	if (m_autodestroy_handle)
+	if (m_autodestroy_handle && !m_is_alias)
 	{
 		destroyRenderbuffers();
 		bgfx::destroyFrameBuffer(m_handle);
@@ -58,6 +46,26 @@ FrameBuffer::~FrameBuffer()
 }
 
 
+void FrameBuffer::createRenderbuffers()
+{
+	bgfx::TextureHandle texture_handles[16];
+
+	for (int i = 0; i < m_declaration.m_renderbuffers_count; ++i)
+	{
+		const RenderBuffer& renderbuffer = m_declaration.m_renderbuffers[i];
+		texture_handles[i] = bgfx::createTexture2D((uint16_t)m_declaration.m_width,
+			(uint16_t)m_declaration.m_height,
+			1,
+			renderbuffer.m_format,
+			BGFX_TEXTURE_RT);
+		m_declaration.m_renderbuffers[i].m_handle = texture_handles[i];
+	}
+
+	m_handle =
+		bgfx::createFrameBuffer((uint8_t)m_declaration.m_renderbuffers_count, texture_handles);
+}
+
+
 void FrameBuffer::destroyRenderbuffers()
 {
 	for (int i = 0; i < m_declaration.m_renderbuffers_count; ++i)
@@ -69,11 +77,13 @@ void FrameBuffer::destroyRenderbuffers()
 
 void FrameBuffer::resize(int width, int height)
 {
-	if (bgfx::isValid(m_handle))
+	// an alias gets its own textures, the owner of the shared ones has to alias it again
+	if (bgfx::isValid(m_handle) && !m_is_alias)
 	{
 		destroyRenderbuffers();
 		bgfx::destroyFrameBuffer(m_handle);
 	}
+	m_is_alias = false;
 
 	m_declaration.m_width = width;
 	m_declaration.m_height = height;
@@ -83,18 +93,54 @@ void FrameBuffer::resize(int width, int height)
 	}
 	else
 	{
-		bgfx::TextureHandle texture_handles[16];
+		createRenderbuffers();
+	}
+}
 
-		for (int i = 0; i < m_declaration.m_renderbuffers_count; ++i)
+
+bool FrameBuffer::canAlias(const FrameBuffer& framebuffer) const
+{
+	const Declaration& decl = framebuffer.m_declaration;
+	if (m_window_handle || framebuffer.m_window_handle) return false;
+	if (decl.m_width != m_declaration.m_width || decl.m_height != m_declaration.m_height)
+	{
+		return false;
+	}
+	if (decl.m_renderbuffers_count != m_declaration.m_renderbuffers_count) return false;
+	for (int i = 0; i < decl.m_renderbuffers_count; ++i)
+	{
+		if (decl.m_renderbuffers[i].m_format != m_declaration.m_renderbuffers[i].m_format)
 		{
-			const RenderBuffer& renderbuffer = m_declaration.m_renderbuffers[i];
-			texture_handles[i] =
-				bgfx::createTexture2D((uint16_t)width, (uint16_t)height, 1, renderbuffer.m_format, BGFX_TEXTURE_RT);
-			m_declaration.m_renderbuffers[i].m_handle = texture_handles[i];
+			return false;
 		}
+	}
+	return true;
+}
+
 
-		m_window_handle = nullptr;
-		m_handle = bgfx::createFrameBuffer((uint8_t)m_declaration.m_renderbuffers_count, texture_handles);
+void FrameBuffer::setAlias(const FrameBuffer* framebuffer)
+{
+	ASSERT(m_autodestroy_handle);
+	ASSERT(!framebuffer || canAlias(*framebuffer));
+	if (!framebuffer && !m_is_alias) return;
+
+	if (!m_is_alias)
+	{
+		destroyRenderbuffers();
+		bgfx::destroyFrameBuffer(m_handle);
+	}
+	m_is_alias = framebuffer != nullptr;
+	if (!framebuffer)
+	{
+		createRenderbuffers();
+		return;
+	}
+
+	m_handle = framebuffer->m_handle;
+	for (int i = 0; i < m_declaration.m_renderbuffers_count; ++i)
+	{
+		m_declaration.m_renderbuffers[i].m_handle =
+			framebuffer->m_declaration.m_renderbuffers[i].m_handle;
 	}
 }
 
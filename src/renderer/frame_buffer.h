@@ -33,6 +33,7 @@ class FrameBuffer
 			Declaration()
 				: m_renderbuffers_count(0)
 				, m_size_ratio(-1, -1)
+				, m_is_transient(false)
 			{ }
 
 			static const int MAX_RENDERBUFFERS = 16;
@@ -42,6 +43,8 @@ class FrameBuffer
 			Vec2 m_size_ratio;
 			RenderBuffer m_renderbuffers[MAX_RENDERBUFFERS];
 			int32 m_renderbuffers_count;
+			// content is not kept between frames, the memory can be shared with other framebuffers
+			bool m_is_transient;
 			char m_name[64];
 		};
 
@@ -56,13 +59,20 @@ class FrameBuffer
 		void resize(int width, int height);
 		Vec2 getSizeRatio() const { return m_declaration.m_size_ratio; }
 		const char* getName() const { return m_declaration.m_name; }
+		const Declaration& getDeclaration() const { return m_declaration; }
+		bool isTransient() const { return m_declaration.m_is_transient; }
+		// renders to the textures of framebuffer instead of its own ones, nullptr creates own again
+		void setAlias(const FrameBuffer* framebuffer);
+		bool canAlias(const FrameBuffer& framebuffer) const;
 		bgfx::TextureHandle getRenderbufferHandle(int idx) const { return m_declaration.m_renderbuffers[idx].m_handle; }
 
 	private:
+		void createRenderbuffers();
 		void destroyRenderbuffers();
 
 	private:
 		bool m_autodestroy_handle;
+		bool m_is_alias;
 		void* m_window_handle;
 		bgfx::FrameBufferHandle m_handle;
 		Declaration m_declaration;
@@ -0,0 +1,176 @@
+#include "light_grid.h"
+
+#include "core/math_utils.h"
+#include "core/mtjd/parallel_for.h"
+#include "core/profiler.h"
+
+#include <cmath>
+
+
+namespace Lumix
+{
+
+
+LightGrid::LightGrid(IAllocator& allocator)
+	: m_allocator(allocator)
+	, m_view_lights(allocator)
+	, m_slices(allocator)
+	, m_clusters(allocator)
+	, m_light_indices(allocator)
+	, m_light_count(0)
+	, m_tan_half_fov(1)
+	, m_ratio(1)
+	, m_near_distance(1)
+	, m_far_distance(2)
+	, m_slice_scale(1)
+{
+	static_assert(TILES_X <= 256 && TILES_Y <= 256, "Tiles are stored as uint8");
+	static_assert(MAX_LIGHT_INDICES <= 0x10000, "Offsets are stored as uint16");
+	for (int i = 0; i < DEPTH_SLICES; ++i)
+	{
+		m_slices.emplace(allocator);
+	}
+	m_clusters.resize(CLUSTER_COUNT);
+	for (Cluster& cluster : m_clusters)
+	{
+		cluster.offset = 0;
+		cluster.count = 0;
+	}
+}
+
+
+void LightGrid::build(MTJD::Manager& manager,
+	const Matrix& view,
+	float fov,
+	float ratio,
+	float near_distance,
+	float far_distance,
+	const Light* lights,
+	int light_count)
+{
+	PROFILE_FUNCTION();
+	ASSERT(near_distance > 0 && near_distance < far_distance);
+	m_tan_half_fov = tanf(fov * 0.5f);
+	m_ratio = ratio;
+	m_near_distance = near_distance;
+	m_far_distance = far_distance;
+	m_slice_scale = DEPTH_SLICES / logf(far_distance / near_distance);
+
+	m_light_count = Math::minValue(light_count, MAX_LIGHTS);
+	m_view_lights.resize(m_light_count);
+	for (int i = 0; i < m_light_count; ++i)
+	{
+		m_view_lights[i] = Vec4(view.multiplyPosition(lights[i].position), lights[i].radius);
+	}
+
+	MTJD::parallelFor(manager,
+		0,
+		DEPTH_SLICES,
+		1,
+		[this](int from, int to)
+		{
+			for (int slice = from; slice < to; ++slice)
+			{
+				buildSlice(slice);
+			}
+		});
+
+	m_light_indices.clear();
+	for (int slice = 0; slice < DEPTH_SLICES; ++slice)
+	{
+		Cluster* clusters = &m_clusters[slice * TILES_X * TILES_Y];
+		const Array<uint16>& indices = m_slices[slice].indices;
+		for (int i = 0; i < TILES_X * TILES_Y; ++i)
+		{
+			Cluster& cluster = clusters[i];
+			int offset = m_light_indices.size();
+			int count = Math::minValue((int)cluster.count, MAX_LIGHT_INDICES - offset);
+			for (int j = 0; j < count; ++j)
+			{
+				m_light_indices.push(indices[cluster.offset + j]);
+			}
+			cluster.offset = (uint16)Math::minValue(offset, MAX_LIGHT_INDICES - 1);
+			cluster.count = (uint16)count;
+		}
+	}
+}
+
+
+static int toTile(float ndc, int tiles)
+{
+	return Math::clamp((int)floorf((ndc * 0.5f + 0.5f) * tiles), 0, tiles - 1);
+}
+
+
+void LightGrid::buildSlice(int slice)
+{
+	float slice_near = m_near_distance * powf(m_far_distance / m_near_distance, slice / (float)DEPTH_SLICES);
+	float slice_far =
+		m_near_distance * powf(m_far_distance / m_near_distance, (slice + 1) / (float)DEPTH_SLICES);
+	float scale_x = m_tan_half_fov * m_ratio;
+	float scale_y = m_tan_half_fov;
+
+	Slice& data = m_slices[slice];
+	data.rects.clear();
+	for (int i = 0; i < m_light_count; ++i)
+	{
+		const Vec4& light = m_view_lights[i];
+		float depth = -light.z;
+		float radius = light.w;
+		if (depth + radius < slice_near || depth - radius > slice_far) continue;
+
+		// bounds of the sphere's box between the nearest and the farthest depth inside the slice
+		float min_depth = Math::maxValue(slice_near, depth - radius);
+		float max_depth = Math::minValue(slice_far, depth + radius);
+		float left = light.x - radius;
+		float right = light.x + radius;
+		float bottom = light.y - radius;
+		float top = light.y + radius;
+		float min_x = left / ((left >= 0 ? max_depth : min_depth) * scale_x);
+		float max_x = right / ((right >= 0 ? min_depth : max_depth) * scale_x);
+		float min_y = bottom / ((bottom >= 0 ? max_depth : min_depth) * scale_y);
+		float max_y = top / ((top >= 0 ? min_depth : max_depth) * scale_y);
+		if (min_x > 1 || max_x < -1 || min_y > 1 || max_y < -1) continue;
+
+		TileRect& rect = data.rects.emplace();
+		rect.min_x = (uint8)toTile(min_x, TILES_X);
+		rect.max_x = (uint8)toTile(max_x, TILES_X);
+		rect.min_y = (uint8)toTile(min_y, TILES_Y);
+		rect.max_y = (uint8)toTile(max_y, TILES_Y);
+		rect.light = (uint16)i;
+	}
+
+	data.indices.clear();
+	Cluster* clusters = &m_clusters[slice * TILES_X * TILES_Y];
+	for (int y = 0; y < TILES_Y; ++y)
+	{
+		for (int x = 0; x < TILES_X; ++x)
+		{
+			Cluster& cluster = clusters[y * TILES_X + x];
+			cluster.offset = (uint16)data.indices.size();
+			for (const TileRect& rect : data.rects)
+			{
+				if (x < rect.min_x || x > rect.max_x || y < rect.min_y || y > rect.max_y) continue;
+				data.indices.push(rect.light);
+			}
+			cluster.count = uint16(data.indices.size() - cluster.offset);
+		}
+	}
+}
+
+
+int LightGrid::getClusterIndex(const Vec3& view_position) const
+{
+	float depth = -view_position.z;
+	if (depth < m_near_distance || depth >= m_far_distance) return -1;
+
+	float ndc_x = view_position.x / (depth * m_tan_half_fov * m_ratio);
+	float ndc_y = view_position.y / (depth * m_tan_half_fov);
+	if (ndc_x < -1 || ndc_x > 1 || ndc_y < -1 || ndc_y > 1) return -1;
+
+	int slice = Math::clamp((int)(logf(depth / m_near_distance) * m_slice_scale), 0, DEPTH_SLICES - 1);
+	return (slice * TILES_Y + toTile(ndc_y, TILES_Y)) * TILES_X + toTile(ndc_x, TILES_X);
+}
+
+
+} // namespace Lumix
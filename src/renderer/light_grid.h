@@ -0,0 +1,106 @@
+#pragma once
+
+
+#include "lumix.h"
+#include "core/array.h"
+#include "core/matrix.h"
+#include "core/vec.h"
+
+
+namespace Lumix
+{
+
+
+namespace MTJD
+{
+class Manager;
+}
+
+
+// Clustered light grid, view frustum is split to TILES_X x TILES_Y screen tiles and DEPTH_SLICES
+// exponentially distributed depth slices, every cluster references lights which can touch it.
+// Tiles are indexed from the bottom left corner of the screen, clusters are stored slice by slice.
+class LightGrid
+{
+public:
+	static const int TILES_X = 16;
+	static const int TILES_Y = 8;
+	static const int DEPTH_SLICES = 24;
+	static const int CLUSTER_COUNT = TILES_X * TILES_Y * DEPTH_SLICES;
+	static const int MAX_LIGHTS = 256;
+	static const int MAX_LIGHT_INDICES = 256 * 256;
+
+	struct Light
+	{
+		Vec3 position;
+		float radius;
+	};
+
+	struct Cluster
+	{
+		uint16 offset;
+		uint16 count;
+	};
+
+	explicit LightGrid(IAllocator& allocator);
+
+	// view transforms world to view space, the camera looks down -z; slices are built on workers
+	void build(MTJD::Manager& manager,
+		const Matrix& view,
+		float fov,
+		float ratio,
+		float near_distance,
+		float far_distance,
+		const Light* lights,
+		int light_count);
+	// returns -1 for positions outside of the frustum
+	int getClusterIndex(const Vec3& view_position) const;
+	const Cluster& getCluster(int index) const { return m_clusters[index]; }
+	const Cluster* getClusters() const { return &m_clusters[0]; }
+	const uint16* getLightIndices() const { return m_light_indices.empty() ? nullptr : &m_light_indices[0]; }
+	int getLightIndicesCount() const { return m_light_indices.size(); }
+	int getLightCount() const { return m_light_count; }
+	float getNearDistance() const { return m_near_distance; }
+	// slice = floor(log(depth / near) * slice_scale)
+	float getSliceScale() const { return m_slice_scale; }
+
+private:
+	struct TileRect
+	{
+		uint8 min_x;
+		uint8 max_x;
+		uint8 min_y;
+		uint8 max_y;
+		uint16 light;
+	};
+
+	struct Slice
+	{
+		explicit Slice(IAllocator& allocator)
+			: rects(allocator)
+			, indices(allocator)
+		{
+		}
+
+		Array<TileRect> rects;
+		Array<uint16> indices;
+	};
+
+	void buildSlice(int slice);
+
+private:
+	IAllocator& m_allocator;
+	Array<Vec4> m_view_lights;
+	Array<Slice> m_slices;
+	Array<Cluster> m_clusters;
+	Array<uint16> m_light_indices;
+	int m_light_count;
+	float m_tan_half_fov;
+	float m_ratio;
+	float m_near_distance;
+	float m_far_distance;
+	float m_slice_scale;
+};
+
+
+} // namespace Lumix
@@ -1,7 +1,9 @@
 #include "renderer/material.h"
+#include "core/blob.h"
 #include "core/crc32.h"
 #include "core/fs/file_system.h"
 #include "core/fs/ifile.h"
+#include "core/fs/memory_file_device.h"
 #include "core/json_serializer.h"
 #include "core/log.h"
 #include "core/path_utils.h"
@@ -21,6 +23,9 @@ namespace Lumix
 
 static const uint32 SHADOWMAP_HASH = crc32("shadowmap");
 static const float DEFAULT_ALPHA_REF_VALUE = 0.3f;
+// compiled materials start with it, JSON sources can't because they start with '{'
+static const uint32 BINARY_MAGIC = 0x424D544C; // 'LTMB'
+static const int32 BINARY_VERSION = 0;
 
 
 Material::Material(const Path& path, ResourceManager& resource_manager, IAllocator& allocator)
@@ -35,6 +40,7 @@ Material::Material(const Path& path, ResourceManager& resource_manager, IAllocat
 	, m_shader_instance(nullptr)
 	, m_define_mask(0)
 	, m_command_buffer(nullptr)
+	, m_uniforms_offset(0)
 	, m_layer_count(1)
 {
 	auto* manager = resource_manager.get(ResourceManager::MATERIAL);
@@ -218,29 +224,67 @@ bool Material::save(JsonSerializer& serializer)
 }
 
 
-void Material::deserializeDefines(JsonSerializer& serializer)
+// everything a material file describes, both the JSON source and the compiled binary are read into
+// it, so they can't get out of sync
+struct MaterialDesc
+{
+	struct Define
+	{
+		char name[32];
+	};
+
+	struct Texture
+	{
+		// resolved relative to the material, empty if the slot has no texture
+		char path[MAX_PATH_LENGTH];
+		int32 atlas_size;
+		uint32 flags;
+		bool keep_data;
+	};
+
+	explicit MaterialDesc(IAllocator& allocator)
+		: defines(allocator)
+		, textures(allocator)
+		, uniforms(allocator)
+		, layer_count(1)
+		, alpha_ref(DEFAULT_ALPHA_REF_VALUE)
+		, shininess(4)
+		, color(1, 1, 1)
+	{
+		shader[0] = '\0';
+	}
+
+	char shader[MAX_PATH_LENGTH];
+	int32 layer_count;
+	float alpha_ref;
+	float shininess;
+	Vec3 color;
+	Array<Define> defines;
+	Array<Texture> textures;
+	Array<Material::Uniform> uniforms;
+};
+
+
+static void deserializeDefines(JsonSerializer& serializer, MaterialDesc& desc)
 {
-	auto* manager = getResourceManager().get(ResourceManager::MATERIAL);
-	auto& renderer = static_cast<MaterialManager*>(manager)->getRenderer();
 	serializer.deserializeArrayBegin();
-	m_define_mask = 0;
+	desc.defines.clear();
 	while (!serializer.isArrayEnd())
 	{
-		char tmp[32];
-		serializer.deserializeArrayItem(tmp, lengthOf(tmp), "");
-		m_define_mask |= 1 << renderer.getShaderDefineIdx(tmp);
+		auto& define = desc.defines.emplace();
+		serializer.deserializeArrayItem(define.name, lengthOf(define.name), "");
 	}
 	serializer.deserializeArrayEnd();
 }
 
 
-void Material::deserializeUniforms(JsonSerializer& serializer)
+static void deserializeUniforms(JsonSerializer& serializer, Array<Material::Uniform>& uniforms)
 {
 	serializer.deserializeArrayBegin();
-	m_uniforms.clear();
+	uniforms.clear();
 	while (!serializer.isArrayEnd())
 	{
-		Uniform& uniform = m_uniforms.emplace();
+		Material::Uniform& uniform = uniforms.emplace();
 		serializer.nextArrayItem();
 		serializer.deserializeObjectBegin();
 		char label[256];
@@ -366,7 +410,17 @@ void Material::createCommandBuffer()
 	if (!m_shader) return;
 
 	CommandBufferGenerator generator;
+	for (int i = 0; i < m_shader->getTextureSlotCount(); ++i)
+	{
+		if (i >= m_texture_count || !m_textures[i]) continue;
 
+		generator.setTexture(
+			i, m_shader->getTextureSlot(i).m_uniform_handle, m_textures[i]->getTextureHandle());
+	}
+	generator.end();
+
+	// uniforms follow the textures in the same block, see getUniformCommandBuffer
+	CommandBufferGenerator uniforms_generator;
 	for (int i = 0; i < m_shader->getUniformCount(); ++i)
 	{
 		const Material::Uniform& uniform = m_uniforms[i];
@@ -375,34 +429,32 @@ void Material::createCommandBuffer()
 		switch (shader_uniform.type)
 		{
 			case Shader::Uniform::FLOAT:
-				generator.setUniform(shader_uniform.handle, Vec4(uniform.float_value, 0, 0, 0));
+				uniforms_generator.setUniform(
+					shader_uniform.handle, Vec4(uniform.float_value, 0, 0, 0));
 				break;
 			case Shader::Uniform::VEC3:
 			case Shader::Uniform::COLOR:
-				generator.setUniform(shader_uniform.handle, Vec4(*(Vec3*)uniform.vec3, 0));
+				uniforms_generator.setUniform(shader_uniform.handle, Vec4(*(Vec3*)uniform.vec3, 0));
+				break;
+			case Shader::Uniform::TIME:
+				uniforms_generator.setTimeUniform(shader_uniform.handle);
 				break;
-			case Shader::Uniform::TIME: generator.setTimeUniform(shader_uniform.handle); break;
 			default: ASSERT(false); break;
 		}
 	}
 
-	for (int i = 0; i < m_shader->getTextureSlotCount(); ++i)
-	{
-		if (i >= m_texture_count || !m_textures[i]) continue;
-
-		generator.setTexture(
-			i, m_shader->getTextureSlot(i).m_uniform_handle, m_textures[i]->getTextureHandle());
-	}
-
 	Vec4 color_shininess(m_color, m_shininess);
 	auto* material_manager = getResourceManager().get(ResourceManager::MATERIAL);
 	auto& renderer = static_cast<MaterialManager*>(material_manager)->getRenderer();
 	auto& uniform = renderer.getMaterialColorShininessUniform();
-	generator.setUniform(uniform, color_shininess);
-	generator.end();
+	uniforms_generator.setUniform(uniform, color_shininess);
+	uniforms_generator.end();
 
-	m_command_buffer = (uint8*)m_allocator.allocate(generator.getSize());
+	m_uniforms_offset = generator.getSize();
+	m_command_buffer =
+		(uint8*)m_allocator.allocate(m_uniforms_offset + uniforms_generator.getSize());
 	generator.getData(m_command_buffer);
+	uniforms_generator.getData(m_command_buffer + m_uniforms_offset);
 }
 
 
@@ -515,14 +567,19 @@ Texture* Material::getTextureByUniform(const char* uniform) const
 	return nullptr;
 }
 
-bool Material::deserializeTexture(JsonSerializer& serializer, const char* material_dir)
+static bool deserializeTexture(JsonSerializer& serializer,
+	const char* material_dir,
+	const Path& material_path,
+	MaterialDesc::Texture& texture)
 {
 	char path[MAX_PATH_LENGTH];
 	serializer.deserializeObjectBegin();
 	char label[256];
-	bool keep_data = false;
-	uint32 flags = 0;
-	int atlas_size = -1;
+	texture.path[0] = '\0';
+	texture.keep_data = false;
+	texture.flags = 0;
+	texture.atlas_size = -1;
+	uint32& flags = texture.flags;
 
 	while (!serializer.isObjectEnd())
 	{
@@ -530,26 +587,19 @@ bool Material::deserializeTexture(JsonSerializer& serializer, const char* materi
 		if (compareString(label, "source") == 0)
 		{
 			serializer.deserialize(path, MAX_PATH_LENGTH, "");
-			if (path[0] != '\0')
+			if (path[0] != '\0' && path[0] != '/' && path[0] != '\\')
 			{
-				char texture_path[MAX_PATH_LENGTH];
-				if (path[0] != '/' && path[0] != '\\')
-				{
-					copyString(texture_path, material_dir);
-					catString(texture_path, path);
-				}
-				else
-				{
-					copyString(texture_path, path);
-				}
-				auto* mng = m_resource_manager.get(ResourceManager::TEXTURE);
-				m_textures[m_texture_count] = static_cast<Texture*>(mng->load(Path(texture_path)));
-				addDependency(*m_textures[m_texture_count]);
+				copyString(texture.path, material_dir);
+				catString(texture.path, path);
+			}
+			else
+			{
+				copyString(texture.path, path);
 			}
 		}
 		else if (compareString(label, "atlas_size") == 0)
 		{
-			serializer.deserialize(atlas_size, -1);
+			serializer.deserialize(texture.atlas_size, -1);
 		}
 		else if (compareString(label, "min_filter") == 0)
 		{
@@ -565,7 +615,7 @@ bool Material::deserializeTexture(JsonSerializer& serializer, const char* materi
 			else
 			{
 				g_log_error.log("Renderer") << "Unknown texture filter \"" << label
-											<< "\" in material " << getPath();
+											<< "\" in material " << material_path;
 			}
 		}
 		else if (compareString(label, "mag_filter") == 0)
@@ -582,7 +632,7 @@ bool Material::deserializeTexture(JsonSerializer& serializer, const char* materi
 			else
 			{
 				g_log_error.log("Renderer") << "Unknown texture filter \"" << label
-											<< "\" in material " << getPath();
+											<< "\" in material " << material_path;
 			}
 		}
 		else if (compareString(label, "u_clamp") == 0)
@@ -614,7 +664,7 @@ bool Material::deserializeTexture(JsonSerializer& serializer, const char* materi
 		}
 		else if (compareString(label, "keep_data") == 0)
 		{
-			serializer.deserialize(keep_data, false);
+			serializer.deserialize(texture.keep_data, false);
 		}
 		else if (compareString(label, "srgb") == 0)
 		{
@@ -625,22 +675,11 @@ bool Material::deserializeTexture(JsonSerializer& serializer, const char* materi
 		else
 		{
 			g_log_warning.log("Renderer") << "Unknown data \"" << label << "\" in material "
-										  << getPath();
+										  << material_path;
 			return false;
 		}
 	}
-	if (m_textures[m_texture_count])
-	{
-		m_textures[m_texture_count]->setAtlasSize(atlas_size);
-		m_textures[m_texture_count]->setFlags(flags);
-
-		if (keep_data)
-		{
-			m_textures[m_texture_count]->addDataReference();
-		}
-	}
 	serializer.deserializeObjectEnd();
-	++m_texture_count;
 	return true;
 }
 
@@ -654,70 +693,252 @@ void Material::setAlphaRef(float value)
 }
 
 
-bool Material::load(FS::IFile& file)
+static bool deserialize(JsonSerializer& serializer, const Path& path, MaterialDesc& desc)
 {
-	PROFILE_FUNCTION();
-
-	m_render_states = 0;
-	setAlphaRef(DEFAULT_ALPHA_REF_VALUE);
-	m_uniforms.clear();
-	JsonSerializer serializer(file, JsonSerializer::READ, getPath(), m_allocator);
 	serializer.deserializeObjectBegin();
 	char label[256];
 	char material_dir[MAX_PATH_LENGTH];
-	PathUtils::getDir(material_dir, MAX_PATH_LENGTH, getPath().c_str());
+	PathUtils::getDir(material_dir, MAX_PATH_LENGTH, path.c_str());
 	while (!serializer.isObjectEnd())
 	{
 		serializer.deserializeLabel(label, 255);
 		if (compareString(label, "defines") == 0)
 		{
-			deserializeDefines(serializer);
+			deserializeDefines(serializer, desc);
 		}
 		else if (compareString(label, "uniforms") == 0)
 		{
-			deserializeUniforms(serializer);
+			deserializeUniforms(serializer, desc.uniforms);
 		}
 		else if (compareString(label, "texture") == 0)
 		{
-			if (!deserializeTexture(serializer, material_dir))
+			if (!deserializeTexture(serializer, material_dir, path, desc.textures.emplace()))
 			{
 				return false;
 			}
 		}
 		else if (compareString(label, "alpha_ref") == 0)
 		{
-			serializer.deserialize(m_alpha_ref, 0.3f);
+			serializer.deserialize(desc.alpha_ref, 0.3f);
 		}
 		else if (compareString(label, "layer_count") == 0)
 		{
-			serializer.deserialize(m_layer_count, 1);
+			serializer.deserialize(desc.layer_count, 1);
 		}
 		else if (compareString(label, "color") == 0)
 		{
 			serializer.deserializeArrayBegin();
-			serializer.deserializeArrayItem(m_color.x, 1.0f);
-			serializer.deserializeArrayItem(m_color.y, 1.0f);
-			serializer.deserializeArrayItem(m_color.z, 1.0f);
+			serializer.deserializeArrayItem(desc.color.x, 1.0f);
+			serializer.deserializeArrayItem(desc.color.y, 1.0f);
+			serializer.deserializeArrayItem(desc.color.z, 1.0f);
 			serializer.deserializeArrayEnd();
 		}
 		else if (compareString(label, "shininess") == 0)
 		{
-			serializer.deserialize(m_shininess, 4.0f);
+			serializer.deserialize(desc.shininess, 4.0f);
 		}
 		else if (compareString(label, "shader") == 0)
 		{
-			Path path;
-			serializer.deserialize(path, Path(""));
-			auto* manager = m_resource_manager.get(ResourceManager::SHADER);
-			setShader(static_cast<Shader*>(manager->load(Path(path))));
+			serializer.deserialize(desc.shader, lengthOf(desc.shader), "");
 		}
 		else
 		{
 			g_log_warning.log("Renderer") << "Unknown parameter " << label << " in material "
-										  << getPath();
+										  << path;
 		}
 	}
 	serializer.deserializeObjectEnd();
+	return true;
+}
+
+
+static void writeBinary(const MaterialDesc& desc, OutputBlob& blob)
+{
+	blob.write(BINARY_MAGIC);
+	blob.write(BINARY_VERSION);
+	blob.writeString(desc.shader);
+	blob.write(desc.layer_count);
+	blob.write(desc.alpha_ref);
+	blob.write(desc.shininess);
+	blob.write(desc.color);
+	blob.write(desc.defines.size());
+	for (const auto& define : desc.defines)
+	{
+		blob.writeString(define.name);
+	}
+	blob.write(desc.textures.size());
+	for (const auto& texture : desc.textures)
+	{
+		blob.writeString(texture.path);
+		blob.write(texture.atlas_size);
+		blob.write(texture.flags);
+		blob.write((uint8)texture.keep_data);
+	}
+	// uniforms are stored as they are in memory, name hashes included
+	blob.write(desc.uniforms.size());
+	if (!desc.uniforms.empty())
+	{
+		blob.write(&desc.uniforms[0], sizeof(desc.uniforms[0]) * desc.uniforms.size());
+	}
+}
+
+
+static bool readCount(InputBlob& blob, int32& count)
+{
+	// a count larger than the rest of the data means the file is corrupted
+	return blob.read(&count, sizeof(count)) && count >= 0 && count <= blob.getSize();
+}
+
+
+static bool readBinary(InputBlob& blob, MaterialDesc& desc)
+{
+	if (blob.read<uint32>() != BINARY_MAGIC) return false;
+	if (blob.read<int32>() != BINARY_VERSION) return false;
+
+	blob.readString(desc.shader, lengthOf(desc.shader));
+	blob.read(desc.layer_count);
+	blob.read(desc.alpha_ref);
+	blob.read(desc.shininess);
+	blob.read(desc.color);
+	int32 count;
+	if (!readCount(blob, count)) return false;
+	desc.defines.resize(count);
+	for (auto& define : desc.defines)
+	{
+		blob.readString(define.name, lengthOf(define.name));
+	}
+	if (!readCount(blob, count)) return false;
+	desc.textures.resize(count);
+	for (auto& texture : desc.textures)
+	{
+		blob.readString(texture.path, lengthOf(texture.path));
+		blob.read(texture.atlas_size);
+		blob.read(texture.flags);
+		texture.keep_data = blob.read<uint8>() != 0;
+	}
+	if (!readCount(blob, count)) return false;
+	desc.uniforms.resize(count);
+	return count == 0 || blob.read(&desc.uniforms[0], sizeof(desc.uniforms[0]) * count);
+}
+
+
+static bool isBinary(FS::IFile& file)
+{
+	uint32 magic = 0;
+	if (file.size() < sizeof(magic)) return false;
+	if (file.getBuffer())
+	{
+		copyMemory(&magic, file.getBuffer(), sizeof(magic));
+		return magic == BINARY_MAGIC;
+	}
+	file.read(&magic, sizeof(magic));
+	file.seek(FS::SeekMode::BEGIN, 0);
+	return magic == BINARY_MAGIC;
+}
+
+
+bool Material::compile(const void* source,
+	int size,
+	const Path& path,
+	OutputBlob& out,
+	IAllocator& allocator)
+{
+	FS::MemoryFileDevice device(allocator);
+	FS::IFile* file = device.createFile(nullptr);
+	file->write(source, size);
+	file->seek(FS::SeekMode::BEGIN, 0);
+
+	MaterialDesc desc(allocator);
+	bool success;
+	{
+		JsonSerializer serializer(*file, JsonSerializer::READ, path, allocator);
+		success = deserialize(serializer, path, desc);
+	}
+	device.destroyFile(file);
+
+	if (success) writeBinary(desc, out);
+	return success;
+}
+
+
+void Material::apply(const MaterialDesc& desc)
+{
+	auto* material_manager = getResourceManager().get(ResourceManager::MATERIAL);
+	auto& renderer = static_cast<MaterialManager*>(material_manager)->getRenderer();
+	m_define_mask = 0;
+	for (const auto& define : desc.defines)
+	{
+		m_define_mask |= 1 << renderer.getShaderDefineIdx(define.name);
+	}
+
+	m_uniforms.clear();
+	for (const auto& uniform : desc.uniforms)
+	{
+		m_uniforms.push(uniform);
+	}
+
+	auto* texture_manager = m_resource_manager.get(ResourceManager::TEXTURE);
+	for (const auto& texture_desc : desc.textures)
+	{
+		if (m_texture_count == MAX_TEXTURE_COUNT)
+		{
+			g_log_error.log("Renderer") << "Too many textures in material " << getPath();
+			break;
+		}
+		Texture* texture = nullptr;
+		if (texture_desc.path[0] != '\0')
+		{
+			texture = static_cast<Texture*>(texture_manager->load(Path(texture_desc.path)));
+			addDependency(*texture);
+			texture->setAtlasSize(texture_desc.atlas_size);
+			texture->setFlags(texture_desc.flags);
+			if (texture_desc.keep_data) texture->addDataReference();
+		}
+		m_textures[m_texture_count] = texture;
+		++m_texture_count;
+	}
+
+	setAlphaRef(desc.alpha_ref);
+	m_layer_count = desc.layer_count;
+	m_shininess = desc.shininess;
+	m_color = desc.color;
+	if (desc.shader[0] != '\0')
+	{
+		auto* shader_manager = m_resource_manager.get(ResourceManager::SHADER);
+		setShader(static_cast<Shader*>(shader_manager->load(Path(desc.shader))));
+	}
+}
+
+
+bool Material::load(FS::IFile& file)
+{
+	PROFILE_FUNCTION();
+
+	m_render_states = 0;
+	MaterialDesc desc(m_allocator);
+	if (isBinary(file))
+	{
+		Array<uint8> data(m_allocator);
+		const void* buffer = file.getBuffer();
+		if (!buffer)
+		{
+			data.resize((int)file.size());
+			file.read(&data[0], data.size());
+			buffer = &data[0];
+		}
+		InputBlob blob(buffer, (int)file.size());
+		if (!readBinary(blob, desc))
+		{
+			g_log_error.log("Renderer") << "Invalid compiled material " << getPath();
+			return false;
+		}
+	}
+	else
+	{
+		JsonSerializer serializer(file, JsonSerializer::READ, getPath(), m_allocator);
+		if (!deserialize(serializer, getPath(), desc)) return false;
+	}
+	apply(desc);
 
 	if (!m_shader)
 	{
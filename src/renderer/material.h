@@ -16,10 +16,12 @@ namespace FS
 }
 
 class JsonSerializer;
+class OutputBlob;
 class ResourceManager;
 class Shader;
 class ShaderInstance;
 class Texture;
+struct MaterialDesc;
 
 
 class LUMIX_RENDERER_API Material : public Resource
@@ -72,7 +74,11 @@ public:
 	const Uniform& getUniform(int index) const { return m_uniforms[index]; }
 	ShaderInstance& getShaderInstance() { ASSERT(m_shader_instance); return *m_shader_instance; }
 	const ShaderInstance& getShaderInstance() const { ASSERT(m_shader_instance); return *m_shader_instance; }
+	// textures, bgfx forgets them after each draw
 	const uint8* getCommandBuffer() const { return m_command_buffer; }
+	// uniforms, bgfx keeps them until they are set again, so they can be skipped when the
+	// previous draw used the same material
+	const uint8* getUniformCommandBuffer() const { return m_command_buffer + m_uniforms_offset; }
 	int getLayerCount() const { return m_layer_count; }
 	void setLayerCount(int count) { m_layer_count = count; }
 	void createCommandBuffer();
@@ -81,14 +87,21 @@ public:
 	bool hasDefine(uint8 define_idx) const;
 	bool isDefined(uint8 define_idx) const;
 
+	// converts the JSON source of a material to the binary format, which load() reads in one go
+	// without any parsing; texture paths are resolved and defines are kept by name, because
+	// their indices depend on the order shaders register them at runtime
+	static bool compile(const void* source,
+		int size,
+		const Path& path,
+		OutputBlob& out,
+		IAllocator& allocator);
+
 private:
 	void onBeforeReady() override;
 	void unload(void) override;
 	bool load(FS::IFile& file) override;
 
-	bool deserializeTexture(JsonSerializer& serializer, const char* material_dir);
-	void deserializeUniforms(JsonSerializer& serializer);
-	void deserializeDefines(JsonSerializer& serializer);
+	void apply(const MaterialDesc& desc);
 
 private:
 	static const int MAX_TEXTURE_COUNT = 16;
@@ -106,6 +119,7 @@ private:
 	float m_alpha_ref;
 	uint32 m_define_mask;
 	uint8* m_command_buffer;
+	int m_uniforms_offset;
 	int m_layer_count;
 };
 
@@ -0,0 +1,114 @@
+#include "mesh_simplifier.h"
+
+#include "core/radix_sort.h"
+#include "core/vec.h"
+
+#include <cmath>
+
+
+namespace Lumix
+{
+
+
+// 21 bits per axis, the grid is centered at the origin
+static const int CELL_BITS = 21;
+static const int32 CELL_OFFSET = 1 << (CELL_BITS - 1);
+
+
+struct ClusteredVertex
+{
+	uint64 cell;
+	int32 vertex;
+};
+
+
+static uint64 getCell(const Vec3& position, float inv_grid_size)
+{
+	const uint32 max_cell = (1 << CELL_BITS) - 1;
+	uint64 key = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		int32 cell = (int32)floorf((&position.x)[i] * inv_grid_size) + CELL_OFFSET;
+		uint32 clamped = cell < 0 ? 0 : ((uint32)cell > max_cell ? max_cell : (uint32)cell);
+		key |= (uint64)clamped << (CELL_BITS * i);
+	}
+	return key;
+}
+
+
+int simplifyMesh(const uint8* vertices,
+	int vertex_count,
+	int stride,
+	int position_offset,
+	const int32* indices,
+	int index_count,
+	float grid_size,
+	IAllocator& allocator,
+	Array<uint8>& out_vertices,
+	Array<int32>& out_indices)
+{
+	ASSERT(grid_size > 0);
+	out_vertices.clear();
+	out_indices.clear();
+	if (vertex_count == 0) return 0;
+
+	float inv_grid_size = 1 / grid_size;
+	Array<ClusteredVertex> clustered(allocator);
+	Array<ClusteredVertex> tmp(allocator);
+	clustered.resize(vertex_count);
+	tmp.resize(vertex_count);
+	for (int i = 0; i < vertex_count; ++i)
+	{
+		const Vec3& position = *(const Vec3*)(vertices + i * stride + position_offset);
+		clustered[i].cell = getCell(position, inv_grid_size);
+		clustered[i].vertex = i;
+	}
+	// stable, so the first vertex of a cell has the lowest index
+	radixSort(&clustered[0],
+		&tmp[0],
+		vertex_count,
+		[](const ClusteredVertex& vertex) { return vertex.cell; });
+
+	int cells = 1;
+	for (int i = 1; i < vertex_count; ++i)
+	{
+		if (clustered[i].cell != clustered[i - 1].cell) ++cells;
+	}
+	out_vertices.resize(cells * stride);
+
+	Array<int32> remap(allocator);
+	remap.resize(vertex_count);
+	int cluster_count = 0;
+	for (int i = 0; i < vertex_count;)
+	{
+		int run_end = i + 1;
+		while (run_end < vertex_count && clustered[run_end].cell == clustered[i].cell) ++run_end;
+
+		Vec3 sum(0, 0, 0);
+		for (int j = i; j < run_end; ++j)
+		{
+			sum += *(const Vec3*)(vertices + clustered[j].vertex * stride + position_offset);
+			remap[clustered[j].vertex] = cluster_count;
+		}
+		uint8* out = &out_vertices[cluster_count * stride];
+		copyMemory(out, vertices + clustered[i].vertex * stride, stride);
+		*(Vec3*)(out + position_offset) = sum * (1.0f / (run_end - i));
+		++cluster_count;
+		i = run_end;
+	}
+
+	for (int i = 0; i + 2 < index_count; i += 3)
+	{
+		int32 a = remap[indices[i]];
+		int32 b = remap[indices[i + 1]];
+		int32 c = remap[indices[i + 2]];
+		if (a == b || b == c || a == c) continue;
+		out_indices.push(a);
+		out_indices.push(b);
+		out_indices.push(c);
+	}
+	return cluster_count;
+}
+
+
+} // namespace Lumix
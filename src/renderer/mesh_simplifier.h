@@ -0,0 +1,29 @@
+#pragma once
+
+
+#include "lumix.h"
+#include "core/array.h"
+
+
+namespace Lumix
+{
+
+
+// Simplifies a mesh by vertex clustering. Vertices are snapped to a grid of grid_size cells, all
+// vertices in a cell are merged to one at their average position with the other attributes of
+// the first of them, triangles which collapse are dropped. It does not care about topology, so
+// it suits proxies of whole clusters of objects seen from far away. The error is at most the
+// size of a cell. Returns the number of vertices written to out_vertices.
+int simplifyMesh(const uint8* vertices,
+	int vertex_count,
+	int stride,
+	int position_offset,
+	const int32* indices,
+	int index_count,
+	float grid_size,
+	IAllocator& allocator,
+	Array<uint8>& out_vertices,
+	Array<int32>& out_indices);
+
+
+} // namespace Lumix
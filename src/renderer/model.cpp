@@ -6,6 +6,8 @@
 #include "core/fs/file_system.h"
 #include "core/fs/ifile.h"
 #include "core/log.h"
+#include "core/math_utils.h"
+#include "core/mt/atomic.h"
 #include "core/path_utils.h"
 #include "core/profiler.h"
 #include "core/resource_manager.h"
@@ -24,6 +26,9 @@ namespace Lumix
 {
 
 
+static volatile int32 s_last_bones_id = 0;
+
+
 Mesh::Mesh(const bgfx::VertexDecl& def,
 		   Material* mat,
 		   int attribute_array_offset,
@@ -42,6 +47,7 @@ Mesh::Mesh(const bgfx::VertexDecl& def,
 	this->indices_count = index_count;
 	this->name = name;
 	this->instance_idx = -1;
+	this->lod = 0;
 }
 
 
@@ -59,6 +65,17 @@ void Mesh::set(const bgfx::VertexDecl& def,
 }
 
 
+static void clearBuffers(Model::LODBuffers& buffers)
+{
+	buffers.vertices = BGFX_INVALID_HANDLE;
+	buffers.indices = BGFX_INVALID_HANDLE;
+	buffers.first_vertex = 0;
+	buffers.vertex_count = 0;
+	buffers.first_index = 0;
+	buffers.index_count = 0;
+}
+
+
 Model::Model(const Path& path, ResourceManager& resource_manager, IAllocator& allocator)
 	: Resource(path, resource_manager, allocator)
 	, m_bounding_radius()
@@ -68,13 +85,27 @@ Model::Model(const Path& path, ResourceManager& resource_manager, IAllocator& al
 	, m_bones(m_allocator)
 	, m_indices(m_allocator)
 	, m_vertices(m_allocator)
-	, m_vertices_handle(BGFX_INVALID_HANDLE)
-	, m_indices_handle(BGFX_INVALID_HANDLE)
+	, m_attributes(m_allocator)
+	, m_lod_count(0)
+	, m_material_paths(m_allocator)
+	, m_parsed_vertices(nullptr)
+	, m_bvh_nodes(m_allocator)
+	, m_bvh_triangles(m_allocator)
+	, m_bones_id(0)
+	, m_is_streamed(false)
+	, m_streaming_vertices(m_allocator)
+	, m_streaming_indices(m_allocator)
+	, m_index_size(0)
+	, m_resident_lod(0)
+	, m_wanted_lod(0)
+	, m_unused_frames(0)
+	, m_requested_lod(NO_LOD_REQUEST)
 {
 	m_lods[0] = { -1, -1, -1 };
 	m_lods[1] = { -1, -1, -1 };
 	m_lods[2] = { -1, -1, -1 };
 	m_lods[3] = { -1, -1, -1 };
+	for (LODBuffers& buffers : m_buffers) clearBuffers(buffers);
 }
 
 
@@ -84,6 +115,143 @@ Model::~Model()
 }
 
 
+static const int BVH_LEAF_SIZE = 4;
+static const int BVH_MAX_DEPTH = 48;
+
+
+// the CPU copy of indices is 32bit, GPU indices of models with small meshes are 16bit
+static void copyIndices(const Array<int32>& indices, int index_size, uint8* dst)
+{
+	if (index_size == sizeof(uint16))
+	{
+		uint16* dst16 = (uint16*)dst;
+		for (int i = 0; i < indices.size(); ++i) dst16[i] = (uint16)indices[i];
+		return;
+	}
+	copyMemory(dst, &indices[0], indices.size() * sizeof(indices[0]));
+}
+
+
+static void addToBounds(const Vec3& p, Vec3& min, Vec3& max)
+{
+	min.x = Math::minValue(min.x, p.x);
+	min.y = Math::minValue(min.y, p.y);
+	min.z = Math::minValue(min.z, p.z);
+	max.x = Math::maxValue(max.x, p.x);
+	max.y = Math::maxValue(max.y, p.y);
+	max.z = Math::maxValue(max.z, p.z);
+}
+
+
+// returns the distance where the ray enters the box or -1 if it misses it
+static float getRayBoxDistance(const Vec3& origin,
+	const Vec3& inv_dir,
+	const Vec3& min,
+	const Vec3& max)
+{
+	float t0 = (min.x - origin.x) * inv_dir.x;
+	float t1 = (max.x - origin.x) * inv_dir.x;
+	float tmin = Math::minValue(t0, t1);
+	float tmax = Math::maxValue(t0, t1);
+
+	t0 = (min.y - origin.y) * inv_dir.y;
+	t1 = (max.y - origin.y) * inv_dir.y;
+	tmin = Math::maxValue(tmin, Math::minValue(t0, t1));
+	tmax = Math::minValue(tmax, Math::maxValue(t0, t1));
+
+	t0 = (min.z - origin.z) * inv_dir.z;
+	t1 = (max.z - origin.z) * inv_dir.z;
+	tmin = Math::maxValue(tmin, Math::minValue(t0, t1));
+	tmax = Math::minValue(tmax, Math::maxValue(t0, t1));
+
+	if (tmax < 0 || tmin > tmax) return -1;
+	return Math::maxValue(tmin, 0.0f);
+}
+
+
+int Model::buildBVHNode(int from, int to, Array<Vec3>& centroids, int depth)
+{
+	int node_idx = m_bvh_nodes.size();
+	BVHNode& node = m_bvh_nodes.emplace();
+	node.min.set(FLT_MAX, FLT_MAX, FLT_MAX);
+	node.max.set(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	Vec3 centroid_min = node.min;
+	Vec3 centroid_max = node.max;
+	for (int i = from; i < to; ++i)
+	{
+		for (int index : m_bvh_triangles[i].indices)
+		{
+			addToBounds(m_vertices[index], node.min, node.max);
+		}
+		addToBounds(centroids[i], centroid_min, centroid_max);
+	}
+
+	if (to - from <= BVH_LEAF_SIZE || depth == BVH_MAX_DEPTH)
+	{
+		node.first = from;
+		node.count = to - from;
+		return node_idx;
+	}
+
+	Vec3 size = centroid_max - centroid_min;
+	int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+	float split = ((&centroid_min.x)[axis] + (&centroid_max.x)[axis]) * 0.5f;
+	int mid = from;
+	for (int i = from; i < to; ++i)
+	{
+		if ((&centroids[i].x)[axis] >= split) continue;
+
+		Vec3 tmp_centroid = centroids[i];
+		centroids[i] = centroids[mid];
+		centroids[mid] = tmp_centroid;
+		BVHTriangle tmp_triangle = m_bvh_triangles[i];
+		m_bvh_triangles[i] = m_bvh_triangles[mid];
+		m_bvh_triangles[mid] = tmp_triangle;
+		++mid;
+	}
+	// all centroids are in one half, any split is as good
+	if (mid == from || mid == to) mid = (from + to) / 2;
+
+	node.count = 0;
+	buildBVHNode(from, mid, centroids, depth + 1);
+	int right = buildBVHNode(mid, to, centroids, depth + 1);
+	m_bvh_nodes[node_idx].first = right;
+	return node_idx;
+}
+
+
+void Model::buildBVH()
+{
+	PROFILE_FUNCTION();
+	Array<Vec3> centroids(m_allocator);
+	centroids.reserve(m_indices.size() / 3);
+	m_bvh_triangles.reserve(m_indices.size() / 3);
+	int vertex_offset = 0;
+	for (int mesh_index = 0; mesh_index < m_meshes.size(); ++mesh_index)
+	{
+		const Mesh& mesh = m_meshes[mesh_index];
+		int indices_end = mesh.indices_offset + mesh.indices_count;
+		for (int i = mesh.indices_offset; i < indices_end; i += 3)
+		{
+			BVHTriangle& triangle = m_bvh_triangles.emplace();
+			triangle.mesh = mesh_index;
+			for (int j = 0; j < 3; ++j)
+			{
+				triangle.indices[j] = vertex_offset + m_indices[i + j];
+			}
+			centroids.push((m_vertices[triangle.indices[0]] + m_vertices[triangle.indices[1]] +
+							   m_vertices[triangle.indices[2]]) *
+						   (1 / 3.0f));
+		}
+		vertex_offset += mesh.attribute_array_size / mesh.vertex_def.getStride();
+	}
+	if (m_bvh_triangles.empty()) return;
+
+	m_bvh_nodes.reserve(2 * m_bvh_triangles.size() / BVH_LEAF_SIZE + 1);
+	buildBVHNode(0, m_bvh_triangles.size(), centroids, 0);
+}
+
+
 RayCastModelHit Model::castRay(const Vec3& origin,
 							   const Vec3& dir,
 							   const Matrix& model_transform)
@@ -99,64 +267,58 @@ RayCastModelHit Model::castRay(const Vec3& origin,
 	inv.inverse();
 	Vec3 local_origin = inv.multiplyPosition(origin);
 	Vec3 local_dir = static_cast<Vec3>(inv * Vec4(dir.x, dir.y, dir.z, 0));
+	Vec3 inv_dir(1 / local_dir.x, 1 / local_dir.y, 1 / local_dir.z);
 
-	const Array<Vec3>& vertices = m_vertices;
-	const Array<int32>& indices = m_indices;
-	int vertex_offset = 0;
-	for (int mesh_index = 0; mesh_index < m_meshes.size(); ++mesh_index)
+	if (m_vertices.empty())
 	{
-		int indices_end = m_meshes[mesh_index].indices_offset +
-						  m_meshes[mesh_index].indices_count;
-		for (int i = m_meshes[mesh_index].indices_offset; i < indices_end;
-			 i += 3)
-		{
-			Vec3 p0 = vertices[vertex_offset + indices[i]];
-			Vec3 p1 = vertices[vertex_offset + indices[i + 1]];
-			Vec3 p2 = vertices[vertex_offset + indices[i + 2]];
-			Vec3 normal = crossProduct(p1 - p0, p2 - p0);
-			float q = dotProduct(normal, local_dir);
-			if (q == 0)
-			{
-				continue;
-			}
-			float d = -dotProduct(normal, p0);
-			float t = -(dotProduct(normal, local_origin) + d) / q;
-			if (t < 0)
-			{
-				continue;
-			}
-			Vec3 hit_point = local_origin + local_dir * t;
+		// geometry was released after upload, the AABB is all that is left
+		float t = getRayBoxDistance(local_origin, inv_dir, m_aabb.getMin(), m_aabb.getMax());
+		if (t < 0) return hit;
+		hit.m_is_hit = true;
+		hit.m_t = t;
+		hit.m_mesh = &m_meshes[0];
+		hit.m_origin = origin;
+		hit.m_dir = dir;
+		return hit;
+	}
 
-			Vec3 edge0 = p1 - p0;
-			Vec3 VP0 = hit_point - p0;
-			if (dotProduct(normal, crossProduct(edge0, VP0)) < 0)
-			{
-				continue;
-			}
+	if (m_bvh_nodes.empty()) buildBVH();
+	if (m_bvh_nodes.empty()) return hit;
 
-			Vec3 edge1 = p2 - p1;
-			Vec3 VP1 = hit_point - p1;
-			if (dotProduct(normal, crossProduct(edge1, VP1)) < 0)
-			{
-				continue;
-			}
+	// a pending right child per level and both children of the deepest node
+	int stack[BVH_MAX_DEPTH + 2];
+	int stack_size = 0;
+	stack[stack_size++] = 0;
+	while (stack_size > 0)
+	{
+		const BVHNode& node = m_bvh_nodes[stack[--stack_size]];
+		float box_t = getRayBoxDistance(local_origin, inv_dir, node.min, node.max);
+		if (box_t < 0 || (hit.m_is_hit && box_t > hit.m_t)) continue;
 
-			Vec3 edge2 = p0 - p2;
-			Vec3 VP2 = hit_point - p2;
-			if (dotProduct(normal, crossProduct(edge2, VP2)) < 0)
-			{
-				continue;
-			}
+		if (node.count == 0)
+		{
+			stack[stack_size++] = node.first;
+			stack[stack_size++] = int(&node - &m_bvh_nodes[0]) + 1;
+			continue;
+		}
 
-			if (!hit.m_is_hit || hit.m_t > t)
+		for (int i = node.first, end = node.first + node.count; i < end; ++i)
+		{
+			const BVHTriangle& triangle = m_bvh_triangles[i];
+			float t;
+			if (Math::getRayTriangleIntersection(local_origin,
+					local_dir,
+					m_vertices[triangle.indices[0]],
+					m_vertices[triangle.indices[1]],
+					m_vertices[triangle.indices[2]],
+					&t) &&
+				(!hit.m_is_hit || hit.m_t > t))
 			{
 				hit.m_is_hit = true;
 				hit.m_t = t;
-				hit.m_mesh = &m_meshes[mesh_index];
+				hit.m_mesh = &m_meshes[triangle.mesh];
 			}
 		}
-		vertex_offset += m_meshes[mesh_index].attribute_array_size /
-						 m_meshes[mesh_index].vertex_def.getStride();
 	}
 	hit.m_origin = origin;
 	hit.m_dir = dir;
@@ -258,14 +420,18 @@ void Model::create(const bgfx::VertexDecl& def,
 				   const void* attributes_data,
 				   int attributes_size)
 {
-	ASSERT(!bgfx::isValid(m_vertices_handle));
-	m_vertices_handle = bgfx::createVertexBuffer(bgfx::copy(attributes_data, attributes_size), def);
+	LODBuffers& buffers = m_buffers[0];
+	ASSERT(!bgfx::isValid(buffers.vertices));
+	buffers.vertices = bgfx::createVertexBuffer(bgfx::copy(attributes_data, attributes_size), def);
+	buffers.vertex_count = attributes_size / def.getStride();
 	m_vertices_size = attributes_size;
 
-	ASSERT(!bgfx::isValid(m_indices_handle));
+	ASSERT(!bgfx::isValid(buffers.indices));
 	auto* mem = bgfx::copy(indices_data, indices_size);
-	m_indices_handle = bgfx::createIndexBuffer(mem, BGFX_BUFFER_INDEX32);
+	buffers.indices = bgfx::createIndexBuffer(mem, BGFX_BUFFER_INDEX32);
+	buffers.index_count = indices_size / int(sizeof(int));
 	m_indices_size = indices_size;
+	m_index_size = sizeof(int);
 
 	m_meshes.emplace(def,
 					 material,
@@ -281,6 +447,7 @@ void Model::create(const bgfx::VertexDecl& def,
 	lod.from_mesh = 0;
 	lod.to_mesh = 0;
 	m_lods[0] = lod;
+	m_lod_count = 1;
 
 	m_indices.resize(indices_size / sizeof(m_indices[0]));
 	copyMemory(&m_indices[0], indices_data, indices_size);
@@ -292,6 +459,39 @@ void Model::create(const bgfx::VertexDecl& def,
 }
 
 
+void Model::splitToLODs(const int* vertex_counts,
+	const int* index_counts,
+	const float* squared_distances,
+	int lod_count)
+{
+	ASSERT(m_meshes.size() == 1 && lod_count > 0 && lod_count <= MAX_LOD_COUNT);
+	bgfx::VertexDecl def = m_meshes[0].vertex_def;
+	Material* material = m_meshes[0].material;
+	int stride = def.getStride();
+	m_meshes.clear();
+	int attribute_array_offset = 0;
+	int indices_offset = 0;
+	for (int i = 0; i < lod_count; ++i)
+	{
+		m_meshes.emplace(def,
+			material,
+			attribute_array_offset,
+			vertex_counts[i] * stride,
+			indices_offset,
+			index_counts[i],
+			"default",
+			m_allocator);
+		m_meshes[i].lod = i;
+		attribute_array_offset += vertex_counts[i] * stride;
+		indices_offset += index_counts[i];
+		m_lods[i].from_mesh = m_lods[i].to_mesh = i;
+		m_lods[i].distance = i < lod_count - 1 ? squared_distances[i] : FLT_MAX;
+	}
+	m_lod_count = lod_count;
+	ASSERT(attribute_array_offset == m_vertices_size);
+}
+
+
 void Model::computeRuntimeData(const uint8* vertices)
 {
 	int index = 0;
@@ -333,29 +533,39 @@ void Model::computeRuntimeData(const uint8* vertices)
 }
 
 
-bool Model::parseGeometry(FS::IFile& file)
+bool Model::parseGeometry(FS::IFile& file, uint32 version)
 {
+	int32 index_size = sizeof(int32);
+	if (version >= (uint32)FileVersion::SIZED_INDICES) file.read(&index_size, sizeof(index_size));
+	if (index_size != sizeof(int32) && index_size != sizeof(uint16)) return false;
+
 	int32 indices_count = 0;
 	file.read(&indices_count, sizeof(indices_count));
 	if (indices_count <= 0) return false;
 
+	// the CPU copy is always 32bit, ray casts and occluders do not have to care
 	m_indices.resize(indices_count);
-	file.read(&m_indices[0], sizeof(m_indices[0]) * indices_count);
+	if (index_size == sizeof(uint16))
+	{
+		uint16* tmp = (uint16*)&m_indices[0];
+		file.read(tmp, sizeof(uint16) * indices_count);
+		for (int i = indices_count - 1; i >= 0; --i) m_indices[i] = tmp[i];
+	}
+	else
+	{
+		file.read(&m_indices[0], sizeof(m_indices[0]) * indices_count);
+	}
 
 	int32 vertices_size = 0;
 	file.read(&vertices_size, sizeof(vertices_size));
 	if (vertices_size <= 0) return false;
 
-	ASSERT(!bgfx::isValid(m_vertices_handle));
-	const bgfx::Memory* vertices_mem = bgfx::alloc(vertices_size);
-	file.read(vertices_mem->data, vertices_size);
-	m_vertices_handle = bgfx::createVertexBuffer(vertices_mem, m_meshes[0].vertex_def);
+	// buffers are created in finishParse
+	ASSERT(!m_parsed_vertices);
+	m_parsed_vertices = (uint8*)m_allocator.allocate(vertices_size);
+	file.read(m_parsed_vertices, vertices_size);
 	m_vertices_size = vertices_size;
-
-	ASSERT(!bgfx::isValid(m_indices_handle));
-	m_indices_size = sizeof(m_indices[0]) * indices_count;
-	const bgfx::Memory* mem = bgfx::copy(&m_indices[0], m_indices_size);
-	m_indices_handle = bgfx::createIndexBuffer(mem, BGFX_BUFFER_INDEX32);
+	m_indices_size = index_size * indices_count;
 
 	int vertex_count = 0;
 	for (int i = 0; i < m_meshes.size(); ++i)
@@ -364,7 +574,7 @@ bool Model::parseGeometry(FS::IFile& file)
 	}
 	m_vertices.resize(vertex_count);
 
-	computeRuntimeData(vertices_mem->data);
+	computeRuntimeData(m_parsed_vertices);
 
 	return true;
 }
@@ -377,6 +587,7 @@ bool Model::parseBones(FS::IFile& file)
 	{
 		return false;
 	}
+	m_bones_id = (uint32)MT::atomicIncrement(&s_last_bones_id);
 	m_bones.reserve(bone_count);
 	for (int i = 0; i < bone_count; ++i)
 	{
@@ -480,9 +691,8 @@ bool Model::parseMeshes(FS::IFile& file)
 		copyString(material_path, model_dir);
 		catString(material_path, material_name);
 		catString(material_path, ".mat");
-
-		auto* material_manager = m_resource_manager.get(ResourceManager::MATERIAL);
-		Material* material = static_cast<Material*>(material_manager->load(Path(material_path)));
+		// materials are loaded in finishParse, this can run on a worker
+		m_material_paths.emplace(material_path);
 
 		int32 attribute_array_offset = 0;
 		file.read(&attribute_array_offset, sizeof(attribute_array_offset));
@@ -494,11 +704,7 @@ bool Model::parseMeshes(FS::IFile& file)
 		file.read(&mesh_tri_count, sizeof(mesh_tri_count));
 
 		file.read(&str_size, sizeof(str_size));
-		if (str_size >= MAX_PATH_LENGTH)
-		{
-			material_manager->unload(*material);
-			return false;
-		}
+		if (str_size >= MAX_PATH_LENGTH) return false;
 
 		char mesh_name[MAX_PATH_LENGTH];
 		mesh_name[str_size] = 0;
@@ -507,14 +713,13 @@ bool Model::parseMeshes(FS::IFile& file)
 		bgfx::VertexDecl def;
 		parseVertexDef(file, &def);
 		m_meshes.emplace(def,
-						 material,
+						 nullptr,
 						 attribute_array_offset,
 						 attribute_array_size,
 						 indices_offset,
 						 mesh_tri_count * 3,
 						 mesh_name,
 						 m_allocator);
-		addDependency(*material);
 	}
 	return true;
 }
@@ -533,12 +738,23 @@ bool Model::parseLODs(FS::IFile& file)
 		file.read(&m_lods[i].to_mesh, sizeof(m_lods[i].to_mesh));
 		file.read(&m_lods[i].distance, sizeof(m_lods[i].distance));
 		m_lods[i].from_mesh = i > 0 ? m_lods[i - 1].to_mesh + 1 : 0;
+		for (int j = m_lods[i].from_mesh; j <= m_lods[i].to_mesh && j < m_meshes.size(); ++j)
+		{
+			m_meshes[j].lod = i;
+		}
 	}
+	m_lod_count = lod_count;
 	return true;
 }
 
 
 bool Model::load(FS::IFile& file)
+{
+	return parse(file) && finishParse();
+}
+
+
+bool Model::parse(FS::IFile& file)
 {
 	PROFILE_FUNCTION();
 	FileHeader header;
@@ -546,7 +762,7 @@ bool Model::load(FS::IFile& file)
 	if (header.m_magic == FILE_MAGIC 
 		&& header.m_version <= (uint32)FileVersion::LATEST 
 		&& parseMeshes(file) 
-		&& parseGeometry(file) 
+		&& parseGeometry(file, header.m_version) 
 		&& parseBones(file) 
 		&& parseLODs(file))
 	{
@@ -558,21 +774,228 @@ bool Model::load(FS::IFile& file)
 	return false;
 }
 
+bool Model::finishParse()
+{
+	PROFILE_FUNCTION();
+	auto* material_manager = m_resource_manager.get(ResourceManager::MATERIAL);
+	for (int i = 0; i < m_meshes.size(); ++i)
+	{
+		Material* material = static_cast<Material*>(material_manager->load(m_material_paths[i]));
+		m_meshes[i].material = material;
+		addDependency(*material);
+	}
+	m_material_paths.clear();
+
+	m_index_size = m_indices_size / m_indices.size();
+	if (isStreamable())
+	{
+		initStreaming();
+	}
+	else
+	{
+		LODBuffers& buffers = m_buffers[0];
+		ASSERT(!bgfx::isValid(buffers.vertices));
+		const bgfx::Memory* vertices_mem = bgfx::copy(m_parsed_vertices, m_vertices_size);
+		buffers.vertices = bgfx::createVertexBuffer(vertices_mem, m_meshes[0].vertex_def);
+		buffers.vertex_count = m_vertices_size / m_meshes[0].vertex_def.getStride();
+
+		ASSERT(!bgfx::isValid(buffers.indices));
+		const bgfx::Memory* indices_mem = bgfx::alloc(m_indices_size);
+		copyIndices(m_indices, m_index_size, indices_mem->data);
+		uint16 flags = m_index_size == sizeof(uint16) ? BGFX_BUFFER_NONE : BGFX_BUFFER_INDEX32;
+		buffers.indices = bgfx::createIndexBuffer(indices_mem, flags);
+		buffers.index_count = m_indices.size();
+	}
+
+	auto* model_manager = static_cast<ModelManager*>(m_resource_manager.get(ResourceManager::MODEL));
+	if (model_manager->isKeepAttributes())
+	{
+		m_attributes.resize(m_vertices_size);
+		copyMemory(&m_attributes[0], m_parsed_vertices, m_vertices_size);
+	}
+	m_allocator.deallocate(m_parsed_vertices);
+	m_parsed_vertices = nullptr;
+
+	if (!model_manager->isKeepGeometry()) releaseGeometry();
+	return true;
+}
+
+
+// LODs must cover all meshes, every mesh is drawn from the buffers of its LOD
+bool Model::isStreamable() const
+{
+	if (m_lod_count < 2 || m_lods[m_lod_count - 1].to_mesh != m_meshes.size() - 1) return false;
+	for (int i = 0; i < m_lod_count; ++i)
+	{
+		if (m_lods[i].from_mesh > m_lods[i].to_mesh) return false;
+	}
+	return true;
+}
+
+
+void Model::initStreaming()
+{
+	PROFILE_FUNCTION();
+	int stride = m_meshes[0].vertex_def.getStride();
+	for (int i = 0; i < m_lod_count; ++i)
+	{
+		int vertices_from = m_vertices_size;
+		int vertices_to = 0;
+		int indices_from = m_indices.size();
+		int indices_to = 0;
+		for (int j = m_lods[i].from_mesh; j <= m_lods[i].to_mesh; ++j)
+		{
+			const Mesh& mesh = m_meshes[j];
+			vertices_from = Math::minValue(vertices_from, mesh.attribute_array_offset);
+			vertices_to =
+				Math::maxValue(vertices_to, mesh.attribute_array_offset + mesh.attribute_array_size);
+			indices_from = Math::minValue(indices_from, mesh.indices_offset);
+			indices_to = Math::maxValue(indices_to, mesh.indices_offset + mesh.indices_count);
+		}
+		LODBuffers& buffers = m_buffers[i];
+		buffers.first_vertex = vertices_from / stride;
+		buffers.vertex_count = (vertices_to - vertices_from) / stride;
+		buffers.first_index = indices_from;
+		buffers.index_count = indices_to - indices_from;
+	}
+
+	m_streaming_vertices.resize(m_vertices_size);
+	copyMemory(&m_streaming_vertices[0], m_parsed_vertices, m_vertices_size);
+	m_streaming_indices.resize(m_indices_size);
+	copyIndices(m_indices, m_index_size, &m_streaming_indices[0]);
+
+	m_is_streamed = true;
+	m_resident_lod = m_lod_count;
+	m_wanted_lod = m_lod_count - 1;
+	m_unused_frames = 0;
+	m_requested_lod = NO_LOD_REQUEST;
+	// renderables are drawn as soon as the coarsest LOD is on the GPU
+	uploadLOD(m_lod_count - 1);
+	auto* manager = static_cast<ModelManager*>(m_resource_manager.get(ResourceManager::MODEL));
+	manager->addStreamed(*this);
+}
+
+
+bool Model::uploadLOD(int lod)
+{
+	PROFILE_FUNCTION();
+	ASSERT(m_is_streamed && lod == m_resident_lod - 1);
+	LODBuffers& buffers = m_buffers[lod];
+	if (buffers.vertex_count == 0 || buffers.index_count == 0) return false;
+
+	const bgfx::VertexDecl& def = m_meshes[0].vertex_def;
+	int stride = def.getStride();
+	const uint8* vertices = &m_streaming_vertices[buffers.first_vertex * stride];
+	const bgfx::Memory* vertices_mem = bgfx::copy(vertices, buffers.vertex_count * stride);
+	buffers.vertices = bgfx::createVertexBuffer(vertices_mem, def);
+	const uint8* indices = &m_streaming_indices[buffers.first_index * m_index_size];
+	const bgfx::Memory* indices_mem = bgfx::copy(indices, buffers.index_count * m_index_size);
+	uint16 flags = m_index_size == sizeof(uint16) ? BGFX_BUFFER_NONE : BGFX_BUFFER_INDEX32;
+	buffers.indices = bgfx::createIndexBuffer(indices_mem, flags);
+
+	if (!bgfx::isValid(buffers.vertices) || !bgfx::isValid(buffers.indices))
+	{
+		if (bgfx::isValid(buffers.vertices)) bgfx::destroyVertexBuffer(buffers.vertices);
+		if (bgfx::isValid(buffers.indices)) bgfx::destroyIndexBuffer(buffers.indices);
+		buffers.vertices = BGFX_INVALID_HANDLE;
+		buffers.indices = BGFX_INVALID_HANDLE;
+		return false;
+	}
+	m_resident_lod = lod;
+	return true;
+}
+
+
+void Model::evictLOD(int lod)
+{
+	ASSERT(m_is_streamed && lod == m_resident_lod && lod < m_lod_count - 1);
+	LODBuffers& buffers = m_buffers[lod];
+	bgfx::destroyVertexBuffer(buffers.vertices);
+	bgfx::destroyIndexBuffer(buffers.indices);
+	buffers.vertices = BGFX_INVALID_HANDLE;
+	buffers.indices = BGFX_INVALID_HANDLE;
+	m_resident_lod = lod + 1;
+}
+
+
+int Model::getLODSize(int lod) const
+{
+	const LODBuffers& buffers = m_buffers[lod];
+	return buffers.vertex_count * m_meshes[0].vertex_def.getStride() +
+		   buffers.index_count * m_index_size;
+}
+
+
+// GPU memory taken when LODs from lod to the coarsest one are resident
+int Model::getResidentSize(int lod) const
+{
+	int size = 0;
+	for (int i = lod; i < m_lod_count; ++i) size += getLODSize(i);
+	return size;
+}
+
+
+int Model::requestLOD(int lod)
+{
+	if (!m_is_streamed) return lod;
+
+	for (;;)
+	{
+		int32 requested = m_requested_lod;
+		if (requested <= lod) break;
+		if (MT::compareAndExchange(&m_requested_lod, lod, requested)) break;
+	}
+	// the coarsest LOD failed to upload when nothing is resident, draws of it are skipped
+	return Math::minValue(Math::maxValue(lod, m_resident_lod), m_lod_count - 1);
+}
+
+
+void Model::releaseGeometry()
+{
+	Array<int32>(m_allocator).swap(m_indices);
+	Array<Vec3>(m_allocator).swap(m_vertices);
+	m_bvh_nodes.clear();
+	m_bvh_triangles.clear();
+}
+
+
 void Model::unload(void)
 {
 	auto* material_manager = m_resource_manager.get(ResourceManager::MATERIAL);
 	for (int i = 0; i < m_meshes.size(); ++i)
 	{
+		// meshes of a model which failed to parse have no materials
+		if (!m_meshes[i].material) continue;
 		removeDependency(*m_meshes[i].material);
 		material_manager->unload(*m_meshes[i].material);
 	}
 	m_meshes.clear();
 	m_bones.clear();
+	m_bone_map.clear();
+	m_bones_id = 0;
+	m_material_paths.clear();
+	m_allocator.deallocate(m_parsed_vertices);
+	m_parsed_vertices = nullptr;
+	Array<uint8>(m_allocator).swap(m_attributes);
+	m_bvh_nodes.clear();
+	m_bvh_triangles.clear();
+
+	if (m_is_streamed)
+	{
+		auto* manager = static_cast<ModelManager*>(m_resource_manager.get(ResourceManager::MODEL));
+		manager->removeStreamed(*this);
+		m_is_streamed = false;
+	}
+	Array<uint8>(m_allocator).swap(m_streaming_vertices);
+	Array<uint8>(m_allocator).swap(m_streaming_indices);
+	m_lod_count = 0;
 
-	if(bgfx::isValid(m_vertices_handle)) bgfx::destroyVertexBuffer(m_vertices_handle);
-	if(bgfx::isValid(m_indices_handle)) bgfx::destroyIndexBuffer(m_indices_handle);
-	m_indices_handle = BGFX_INVALID_HANDLE;
-	m_vertices_handle = BGFX_INVALID_HANDLE;
+	for (LODBuffers& buffers : m_buffers)
+	{
+		if (bgfx::isValid(buffers.vertices)) bgfx::destroyVertexBuffer(buffers.vertices);
+		if (bgfx::isValid(buffers.indices)) bgfx::destroyIndexBuffer(buffers.indices);
+		clearBuffers(buffers);
+	}
 }
 
 
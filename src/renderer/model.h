@@ -3,6 +3,7 @@
 
 #include "core/aabb.h"
 #include "core/array.h"
+#include "core/flat_hash_map.h"
 #include "core/hash_map.h"
 #include "core/matrix.h"
 #include "core/quat.h"
@@ -53,6 +54,8 @@ public:
 	int32 attribute_array_size;
 	int32 indices_offset;
 	int32 indices_count;
+	// LOD of the model the mesh belongs to
+	int32 lod;
 	Material* material;
 	string name;
 };
@@ -68,7 +71,7 @@ struct LODMeshIndices
 class LUMIX_RENDERER_API Model : public Resource
 {
 public:
-	typedef HashMap<uint32, int> BoneMap;
+	typedef FlatHashMap<uint32, int> BoneMap;
 
 #pragma pack(1)
 	class FileHeader
@@ -82,6 +85,7 @@ public:
 	enum class FileVersion : uint32
 	{
 		FIRST,
+		SIZED_INDICES, // indices are preceded by their size, 2 or 4 bytes
 
 		LATEST // keep this last
 	};
@@ -110,6 +114,19 @@ public:
 		int parent_idx;
 	};
 
+	// GPU buffers of a LOD, streamed models have them for each LOD, others one for all LODs
+	struct LODBuffers
+	{
+		bgfx::VertexBufferHandle vertices;
+		bgfx::IndexBufferHandle indices;
+		// the buffers hold vertex_count vertices of the model from first_vertex and index_count
+		// indices from first_index
+		int32 first_vertex;
+		int32 vertex_count;
+		int32 first_index;
+		int32 index_count;
+	};
+
 public:
 	Model(const Path& path, ResourceManager& resource_manager, IAllocator& allocator);
 	~Model();
@@ -120,11 +137,28 @@ public:
 		int indices_size,
 		const void* attributes_data,
 		int attributes_size);
+	// splits the mesh made by create() to LODs of its material, LOD i is made of vertex_counts[i]
+	// vertices and index_counts[i] indices following those of LOD i - 1, its indices are relative
+	// to its first vertex; the material must have a reference for each LOD
+	void splitToLODs(const int* vertex_counts,
+		const int* index_counts,
+		const float* squared_distances,
+		int lod_count);
 
 	LODMeshIndices getLODMeshIndices(float squared_distance) const;
 	Mesh& getMesh(int index) { return m_meshes[index]; }
-	bgfx::VertexBufferHandle getVerticesHandle() const { return m_vertices_handle; }
-	bgfx::IndexBufferHandle getIndicesHandle() const { return m_indices_handle; }
+	// handles are invalid while the LOD of the mesh is not on the GPU
+	const LODBuffers& getBuffers(const Mesh& mesh) const
+	{
+		return m_buffers[m_is_streamed ? mesh.lod : 0];
+	}
+	// models with more LODs are uploaded with just the coarsest one, ModelManager uploads finer
+	// ones when they are requested; called from render jobs, returns the LOD which can be drawn
+	// now, i.e. lod or the finest coarser one on the GPU
+	int requestLOD(int lod);
+	bool isStreamed() const { return m_is_streamed; }
+	int getResidentLOD() const { return m_resident_lod; }
+	int getLODCount() const { return m_lod_count; }
 	const Mesh& getMesh(int index) const { return m_meshes[index]; }
 	const Mesh* getMeshPtr(int index) const { return &m_meshes[index]; }
 	int getMeshCount() const { return m_meshes.size(); }
@@ -132,11 +166,18 @@ public:
 	const Bone& getBone(int i) const { return m_bones[i]; }
 	int getFirstNonrootBoneIndex() const { return m_first_nonroot_bone_index; }
 	BoneMap::iterator getBoneIndex(uint32 hash) { return m_bone_map.find(hash); }
+	// unique for each load of the bones, tables built from bone indices can check it's still valid
+	uint32 getBonesID() const { return m_bones_id; }
 	void getPose(Pose& pose);
 	float getBoundingRadius() const { return m_bounding_radius; }
 	RayCastModelHit castRay(const Vec3& origin, const Vec3& dir, const Matrix& model_transform);
 	const AABB& getAABB() const { return m_aabb; }
+	const Array<Vec3>& getVertices() const { return m_vertices; }
+	const Array<int32>& getIndices() const { return m_indices; }
+	// empty unless the model was loaded with ModelManager::isKeepAttributes
+	const Array<uint8>& getAttributes() const { return m_attributes; }
 	LOD* getLODs() { return m_lods; }
+	const LOD* getLODs() const { return m_lods; }
 
 public:
 	static const uint32 FILE_MAGIC = 0x5f4c4d4f; // == '_LMO'
@@ -147,31 +188,83 @@ private:
 	void operator=(const Model&);
 
 	bool parseVertexDef(FS::IFile& file, bgfx::VertexDecl* vertex_definition);
-	bool parseGeometry(FS::IFile& file);
+	bool parseGeometry(FS::IFile& file, uint32 version);
 	bool parseBones(FS::IFile& file);
 	bool parseMeshes(FS::IFile& file);
 	bool parseLODs(FS::IFile& file);
 	int getBoneIdx(const char* name);
 	void computeRuntimeData(const uint8* vertices);
+	void buildBVH();
+	void releaseGeometry();
+	int buildBVHNode(int from, int to, Array<Vec3>& centroids, int depth);
 
 	void unload(void) override;
 	bool load(FS::IFile& file) override;
+	bool isParsedAsync() const override { return true; }
+	bool parse(FS::IFile& file) override;
+	bool finishParse() override;
+	bool isStreamable() const;
+	void initStreaming();
+	bool uploadLOD(int lod);
+	void evictLOD(int lod);
+	int getLODSize(int lod) const;
+	int getResidentSize(int lod) const;
+
+private:
+	// inner nodes have count == 0, their left child follows them and the right child is first
+	struct BVHNode
+	{
+		Vec3 min;
+		int32 first;
+		Vec3 max;
+		int32 count;
+	};
+
+	struct BVHTriangle
+	{
+		int32 indices[3];
+		int32 mesh;
+	};
+
+private:
+	friend class ModelManager;
+
+	static const int32 NO_LOD_REQUEST = 0x7fffffff;
 
 private:
 	IAllocator& m_allocator;
-	bgfx::IndexBufferHandle m_indices_handle;
-	bgfx::VertexBufferHandle m_vertices_handle;
+	LODBuffers m_buffers[MAX_LOD_COUNT];
+	// size of the index buffer on GPU, indices of models with small meshes are 16bit there
 	int m_indices_size;
 	int m_vertices_size;
 	Array<Mesh> m_meshes;
 	Array<Bone> m_bones;
 	Array<int32> m_indices;
 	Array<Vec3> m_vertices;
+	Array<uint8> m_attributes;
 	LOD m_lods[MAX_LOD_COUNT];
+	int m_lod_count;
 	float m_bounding_radius;
 	BoneMap m_bone_map;
+	uint32 m_bones_id;
 	AABB m_aabb;
 	int m_first_nonroot_bone_index;
+	// filled by parse() and consumed by finishParse() on the main thread
+	Array<Path> m_material_paths;
+	uint8* m_parsed_vertices;
+	// built by the first castRay, most models are never ray cast
+	Array<BVHNode> m_bvh_nodes;
+	Array<BVHTriangle> m_bvh_triangles;
+	// streamed models keep their GPU vertex and index data, LODs from m_resident_lod to the
+	// coarsest one are on the GPU
+	bool m_is_streamed;
+	Array<uint8> m_streaming_vertices;
+	Array<uint8> m_streaming_indices;
+	int m_index_size;
+	int m_resident_lod;
+	int m_wanted_lod;
+	int m_unused_frames;
+	volatile int32 m_requested_lod;
 };
 
 
@@ -1,6 +1,8 @@
 #include "lumix.h"
 #include "renderer/model_manager.h"
 
+#include "core/math_utils.h"
+#include "core/profiler.h"
 #include "core/resource.h"
 #include "renderer/model.h"
 
@@ -15,4 +17,86 @@ namespace Lumix
 	{
 		LUMIX_DELETE(m_allocator, static_cast<Model*>(&resource));
 	}
-}
\ No newline at end of file
+
+
+	void ModelManager::addStreamed(Model& model)
+	{
+		m_streamed.push(&model);
+	}
+
+
+	void ModelManager::removeStreamed(Model& model)
+	{
+		m_streamed.eraseItemFast(&model);
+	}
+
+
+	void ModelManager::update()
+	{
+		PROFILE_FUNCTION();
+		if (m_streamed.empty()) return;
+
+		int64 resident_size = 0;
+		int64 needed_size = 0;
+		for (Model* model : m_streamed)
+		{
+			int requested = model->m_requested_lod;
+			model->m_requested_lod = Model::NO_LOD_REQUEST;
+			if (requested < model->m_lod_count)
+			{
+				model->m_unused_frames = 0;
+				model->m_wanted_lod = requested;
+			}
+			else
+			{
+				++model->m_unused_frames;
+			}
+			int lod = model->m_resident_lod;
+			resident_size += model->getResidentSize(lod);
+			if (model->m_wanted_lod < lod) needed_size += model->getLODSize(lod - 1);
+		}
+
+		resident_size = evictUnused(resident_size, needed_size);
+
+		int uploaded_size = 0;
+		for (Model* model : m_streamed)
+		{
+			if (model->m_wanted_lod >= model->m_resident_lod) continue;
+
+			int size = model->getLODSize(model->m_resident_lod - 1);
+			if (resident_size + size > m_streaming_budget) continue;
+			if (uploaded_size > 0 && uploaded_size + size > m_upload_budget) continue;
+			if (!model->uploadLOD(model->m_resident_lod - 1)) continue;
+			uploaded_size += size;
+			resident_size += size;
+		}
+	}
+
+
+	// LODs requested in this frame are kept, the finest LOD of the model not requested for the
+	// longest time goes first; returns the resident size after evictions
+	int64 ModelManager::evictUnused(int64 resident_size, int64 needed_size)
+	{
+		while (resident_size + needed_size > m_streaming_budget)
+		{
+			Model* evicted = nullptr;
+			for (Model* model : m_streamed)
+			{
+				int lod = model->m_resident_lod;
+				if (lod >= model->m_lod_count - 1) continue;
+				if (model->m_unused_frames == 0 && lod >= model->m_wanted_lod) continue;
+				if (!evicted || model->m_unused_frames > evicted->m_unused_frames) evicted = model;
+			}
+			if (!evicted) break;
+
+			int lod = evicted->m_resident_lod;
+			resident_size -= evicted->getLODSize(lod);
+			if (evicted->m_wanted_lod < lod) needed_size -= evicted->getLODSize(lod - 1);
+			evicted->evictLOD(lod);
+			// it is uploaded again only when it is requested again
+			evicted->m_wanted_lod = Math::maxValue(evicted->m_wanted_lod, lod + 1);
+			++m_eviction_version;
+		}
+		return resident_size;
+	}
+}
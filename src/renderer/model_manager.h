@@ -1,10 +1,12 @@
 #pragma once
 
+#include "core/array.h"
 #include "core/resource_manager_base.h"
 
 namespace Lumix
 {
 
+	class Model;
 	class Renderer;
 
 
@@ -15,18 +17,54 @@ namespace Lumix
 			: ResourceManagerBase(allocator)
 			, m_allocator(allocator)
 			, m_renderer(renderer)
+			, m_keep_geometry(true)
+			, m_keep_attributes(false)
+			, m_streamed(allocator)
+			, m_upload_budget(8 * 1024 * 1024)
+			, m_streaming_budget(256 * 1024 * 1024)
+			, m_eviction_version(0)
 		{}
 
 		~ModelManager() {}
 
 		Renderer& getRenderer() { return m_renderer; }
+		// models loaded while this is false free their CPU copies of vertices and indices once
+		// they are uploaded, they are ray cast against their AABB and can not be occluders
+		void setKeepGeometry(bool keep) { m_keep_geometry = keep; }
+		bool isKeepGeometry() const { return m_keep_geometry; }
+		// models loaded while this is true keep a CPU copy of all vertex attributes, which static
+		// batching merges into buffers of whole cells
+		void setKeepAttributes(bool keep) { m_keep_attributes = keep; }
+		bool isKeepAttributes() const { return m_keep_attributes; }
+
+		// streamed models get the LODs requested by the renderer, update() uploads one LOD of a
+		// model at a time while they fit in the upload budget; when the resident LODs do not fit
+		// in the streaming budget, fine LODs not requested for the longest time are evicted
+		void addStreamed(Model& model);
+		void removeStreamed(Model& model);
+		void update();
+		void setUploadBudget(int bytes) { m_upload_budget = bytes; }
+		int getUploadBudget() const { return m_upload_budget; }
+		void setStreamingBudget(int64 bytes) { m_streaming_budget = bytes; }
+		int64 getStreamingBudget() const { return m_streaming_budget; }
+		// changes when LODs are evicted, meshes of evicted LODs must not be drawn anymore
+		uint32 getEvictionVersion() const { return m_eviction_version; }
 
 	protected:
 		Resource* createResource(const Path& path) override;
 		void destroyResource(Resource& resource) override;
 
+	private:
+		int64 evictUnused(int64 resident_size, int64 needed_size);
+
 	private:
 		IAllocator& m_allocator;
 		Renderer& m_renderer;
+		bool m_keep_geometry;
+		bool m_keep_attributes;
+		Array<Model*> m_streamed;
+		int m_upload_budget;
+		int64 m_streaming_budget;
+		uint32 m_eviction_version;
 	};
-}
\ No newline at end of file
+}
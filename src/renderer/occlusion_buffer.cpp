@@ -0,0 +1,233 @@
+#include "occlusion_buffer.h"
+
+#include "core/aabb.h"
+#include "core/math_utils.h"
+#include "core/mtjd/parallel_for.h"
+#include "core/profiler.h"
+
+#include <cfloat>
+#include <cmath>
+#include <xmmintrin.h>
+
+
+namespace Lumix
+{
+
+
+static const float MIN_W = 0.001f;
+
+
+OcclusionBuffer::OcclusionBuffer(IAllocator& allocator)
+	: m_triangles(allocator)
+	, m_transformed(allocator)
+	, m_depth(allocator)
+{
+	static_assert(WIDTH % 4 == 0, "Rows are rasterized 4 pixels at a time");
+	static_assert(HEIGHT % BAND_HEIGHT == 0, "Bands must cover all rows");
+	m_view_projection = Matrix::IDENTITY;
+	m_depth.resize(WIDTH * HEIGHT);
+	clear(Matrix::IDENTITY);
+}
+
+
+void OcclusionBuffer::clear(const Matrix& view_projection)
+{
+	m_view_projection = view_projection;
+	m_triangles.clear();
+	for (int i = 0, c = m_depth.size(); i < c; ++i)
+	{
+		m_depth[i] = 0;
+	}
+}
+
+
+void OcclusionBuffer::addOccluder(const Vec3* vertices,
+	const int32* indices,
+	int indices_count,
+	const Matrix& world)
+{
+	Matrix mvp = m_view_projection * world;
+	m_transformed.clear();
+	for (int i = 0; i < indices_count; ++i)
+	{
+		while (m_transformed.size() <= indices[i])
+		{
+			Vec4 pos = mvp * Vec4(vertices[m_transformed.size()], 1);
+			if (pos.w >= MIN_W)
+			{
+				pos.w = 1 / pos.w;
+				pos.x = (pos.x * pos.w * 0.5f + 0.5f) * WIDTH;
+				pos.y = (pos.y * pos.w * 0.5f + 0.5f) * HEIGHT;
+			}
+			else
+			{
+				pos.w = -1;
+			}
+			m_transformed.push(pos);
+		}
+	}
+
+	for (int i = 0; i + 2 < indices_count; i += 3)
+	{
+		const Vec4* v[] = {&m_transformed[indices[i]],
+			&m_transformed[indices[i + 1]],
+			&m_transformed[indices[i + 2]]};
+		if (v[0]->w < 0 || v[1]->w < 0 || v[2]->w < 0) continue;
+
+		float min_x = Math::minValue(v[0]->x, Math::minValue(v[1]->x, v[2]->x));
+		float max_x = Math::maxValue(v[0]->x, Math::maxValue(v[1]->x, v[2]->x));
+		float min_y = Math::minValue(v[0]->y, Math::minValue(v[1]->y, v[2]->y));
+		float max_y = Math::maxValue(v[0]->y, Math::maxValue(v[1]->y, v[2]->y));
+		if (max_x < 0 || min_x >= WIDTH || max_y < 0 || min_y >= HEIGHT) continue;
+
+		Triangle& triangle = m_triangles.emplace();
+		for (int j = 0; j < 3; ++j)
+		{
+			triangle.x[j] = v[j]->x;
+			triangle.y[j] = v[j]->y;
+			triangle.inv_w[j] = v[j]->w;
+		}
+		triangle.min_y = Math::maxValue(0, (int)min_y);
+		triangle.max_y = Math::minValue(HEIGHT - 1, (int)max_y);
+	}
+}
+
+
+void OcclusionBuffer::rasterize(MTJD::Manager& manager)
+{
+	PROFILE_FUNCTION();
+	PROFILE_INT("triangles", m_triangles.size());
+	if (m_triangles.empty()) return;
+
+	MTJD::parallelFor(manager,
+		0,
+		HEIGHT / BAND_HEIGHT,
+		1,
+		[this](int from, int to)
+		{
+			for (int band = from; band < to; ++band)
+			{
+				rasterizeBand(band);
+			}
+		});
+}
+
+
+void OcclusionBuffer::rasterizeBand(int band)
+{
+	int from_row = band * BAND_HEIGHT;
+	int to_row = from_row + BAND_HEIGHT - 1;
+	for (const Triangle& triangle : m_triangles)
+	{
+		if (triangle.max_y < from_row || triangle.min_y > to_row) continue;
+		rasterizeTriangle(triangle, from_row, to_row);
+	}
+}
+
+
+void OcclusionBuffer::rasterizeTriangle(const Triangle& triangle, int from_row, int to_row)
+{
+	const float* x = triangle.x;
+	const float* y = triangle.y;
+	const float* inv_w = triangle.inv_w;
+
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (area == 0) return;
+
+	// edge i is opposite to vertex i, it's positive inside the triangle for both windings
+	int i1 = area > 0 ? 1 : 2;
+	int i2 = area > 0 ? 2 : 1;
+	area = Math::abs(area);
+	float edge_a[3] = {y[i1] - y[i2], y[i2] - y[0], y[0] - y[i1]};
+	float edge_b[3] = {x[i2] - x[i1], x[0] - x[i2], x[i1] - x[0]};
+	float edge_c[3] = {x[i1] * y[i2] - y[i1] * x[i2], x[i2] * y[0] - y[i2] * x[0], x[0] * y[i1] - y[0] * x[i1]};
+
+	float inv_area = 1 / area;
+	float w[3] = {inv_w[0] * inv_area, inv_w[i1] * inv_area, inv_w[i2] * inv_area};
+	float depth_a = w[0] * edge_a[0] + w[1] * edge_a[1] + w[2] * edge_a[2];
+	float depth_b = w[0] * edge_b[0] + w[1] * edge_b[1] + w[2] * edge_b[2];
+	float depth_c = w[0] * edge_c[0] + w[1] * edge_c[1] + w[2] * edge_c[2];
+
+	int min_x = Math::maxValue(0, (int)Math::minValue(x[0], Math::minValue(x[1], x[2]))) & ~3;
+	int max_x = Math::minValue(WIDTH - 1, (int)Math::maxValue(x[0], Math::maxValue(x[1], x[2])));
+	int min_y = Math::maxValue(from_row, triangle.min_y);
+	int max_y = Math::minValue(to_row, triangle.max_y);
+
+	__m128 step_x = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	__m128 zero = _mm_setzero_ps();
+	__m128 a0 = _mm_set1_ps(edge_a[0]);
+	__m128 a1 = _mm_set1_ps(edge_a[1]);
+	__m128 a2 = _mm_set1_ps(edge_a[2]);
+	__m128 da = _mm_set1_ps(depth_a);
+
+	for (int row = min_y; row <= max_y; ++row)
+	{
+		float py = row + 0.5f;
+		__m128 row0 = _mm_set1_ps(edge_b[0] * py + edge_c[0]);
+		__m128 row1 = _mm_set1_ps(edge_b[1] * py + edge_c[1]);
+		__m128 row2 = _mm_set1_ps(edge_b[2] * py + edge_c[2]);
+		__m128 row_depth = _mm_set1_ps(depth_b * py + depth_c);
+		float* LUMIX_RESTRICT depth = &m_depth[row * WIDTH];
+
+		for (int col = min_x; col <= max_x; col += 4)
+		{
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)col), step_x);
+			__m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), row0);
+			__m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), row1);
+			__m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), row2);
+			__m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+			if (_mm_movemask_ps(inside) == 0) continue;
+
+			__m128 z = _mm_add_ps(_mm_mul_ps(da, px), row_depth);
+			__m128 old_z = _mm_loadu_ps(depth + col);
+			__m128 new_z = _mm_max_ps(old_z, z);
+			_mm_storeu_ps(depth + col, _mm_or_ps(_mm_and_ps(inside, new_z), _mm_andnot_ps(inside, old_z)));
+		}
+	}
+}
+
+
+bool OcclusionBuffer::isVisible(const AABB& aabb, const Matrix& world) const
+{
+	Vec3 corners[8];
+	aabb.getCorners(world, corners);
+
+	float min_x = FLT_MAX;
+	float max_x = -FLT_MAX;
+	float min_y = FLT_MAX;
+	float max_y = -FLT_MAX;
+	float max_inv_w = 0;
+	for (int i = 0; i < lengthOf(corners); ++i)
+	{
+		Vec4 pos = m_view_projection * Vec4(corners[i], 1);
+		if (pos.w < MIN_W) return true;
+
+		float inv_w = 1 / pos.w;
+		float x = (pos.x * inv_w * 0.5f + 0.5f) * WIDTH;
+		float y = (pos.y * inv_w * 0.5f + 0.5f) * HEIGHT;
+		min_x = Math::minValue(min_x, x);
+		max_x = Math::maxValue(max_x, x);
+		min_y = Math::minValue(min_y, y);
+		max_y = Math::maxValue(max_y, y);
+		max_inv_w = Math::maxValue(max_inv_w, inv_w);
+	}
+
+	int from_x = Math::maxValue(0, (int)floorf(min_x));
+	int to_x = Math::minValue(WIDTH - 1, (int)floorf(max_x));
+	int from_y = Math::maxValue(0, (int)floorf(min_y));
+	int to_y = Math::minValue(HEIGHT - 1, (int)floorf(max_y));
+	if (from_x > to_x || from_y > to_y) return true;
+
+	for (int row = from_y; row <= to_y; ++row)
+	{
+		const float* depth = &m_depth[row * WIDTH];
+		for (int col = from_x; col <= to_x; ++col)
+		{
+			if (depth[col] <= max_inv_w) return true;
+		}
+	}
+	return false;
+}
+
+
+} // namespace Lumix
@@ -0,0 +1,63 @@
+#pragma once
+
+
+#include "lumix.h"
+#include "core/array.h"
+#include "core/matrix.h"
+#include "core/vec.h"
+
+
+namespace Lumix
+{
+
+
+class AABB;
+namespace MTJD
+{
+class Manager;
+}
+
+
+// Low resolution software depth buffer used to reject objects hidden behind occluders.
+// Depth is stored as 1/w, bigger value is closer, 0 means nothing was rasterized.
+// Triangles crossing the near plane are dropped, so the buffer can only miss occlusion,
+// it never hides a visible object.
+class OcclusionBuffer
+{
+public:
+	static const int WIDTH = 256;
+	static const int HEIGHT = 128;
+	static const int BAND_HEIGHT = 8;
+
+	explicit OcclusionBuffer(IAllocator& allocator);
+
+	void clear(const Matrix& view_projection);
+	void addOccluder(const Vec3* vertices, const int32* indices, int indices_count, const Matrix& world);
+	// rasterizes all added occluders, bands of rows are distributed between workers
+	void rasterize(MTJD::Manager& manager);
+	bool isVisible(const AABB& aabb, const Matrix& world) const;
+	bool hasOccluders() const { return !m_triangles.empty(); }
+	const float* getDepth() const { return &m_depth[0]; }
+
+private:
+	struct Triangle
+	{
+		float x[3];
+		float y[3];
+		float inv_w[3];
+		int min_y;
+		int max_y;
+	};
+
+	void rasterizeBand(int band);
+	void rasterizeTriangle(const Triangle& triangle, int from_row, int to_row);
+
+private:
+	Matrix m_view_projection;
+	Array<Triangle> m_triangles;
+	Array<Vec4> m_transformed;
+	Array<float> m_depth;
+};
+
+
+} // namespace Lumix
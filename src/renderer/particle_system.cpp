@@ -11,12 +11,14 @@
 #include "renderer/render_scene.h"
 #include "universe/universe.h"
 #include <cmath>
+#include <xmmintrin.h>
 
 
 enum class ParticleEmitterVersion : int
 {
 	SPAWN_COUNT,
 	SIZE_ALPHA_SAVE,
+	GPU_SIMULATION,
 
 	LATEST,
 	INVALID = -1
@@ -27,6 +29,30 @@ namespace Lumix
 {
 
 
+static_assert(sizeof(Vec3) == 3 * sizeof(float), "Vec3 arrays are processed as float arrays");
+
+
+// dst[i] += src[i] * scale
+static void addScaled(float* LUMIX_RESTRICT dst,
+	const float* LUMIX_RESTRICT src,
+	float scale,
+	int count)
+{
+	__m128 scale4 = _mm_set1_ps(scale);
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 d = _mm_loadu_ps(dst + i);
+		__m128 s = _mm_loadu_ps(src + i);
+		_mm_storeu_ps(dst + i, _mm_add_ps(d, _mm_mul_ps(s, scale4)));
+	}
+	for (; i < count; ++i)
+	{
+		dst[i] += src[i] * scale;
+	}
+}
+
+
 template <typename T>
 static ParticleEmitter::ModuleBase* create(ParticleEmitter& emitter)
 {
@@ -85,14 +111,27 @@ void ParticleEmitter::ForceModule::deserialize(InputBlob& blob, int)
 }
 
 
-void ParticleEmitter::ForceModule::update(float time_delta)
+void ParticleEmitter::ForceModule::update(float time_delta, int from, int to)
 {
-	if (m_emitter.m_velocity.empty()) return;
-
+	if (from >= to) return;
+
+	// four particles are 12 floats, i.e. three vectors with the acceleration's xyz repeated
+	Vec3 a = m_acceleration * time_delta;
+	__m128 a0 = _mm_setr_ps(a.x, a.y, a.z, a.x);
+	__m128 a1 = _mm_setr_ps(a.y, a.z, a.x, a.y);
+	__m128 a2 = _mm_setr_ps(a.z, a.x, a.y, a.z);
+	float* LUMIX_RESTRICT velocity = &m_emitter.m_velocity[from].x;
+	int i = 0;
+	for (int c = (to - from) & ~3; i < c; i += 4, velocity += 12)
+	{
+		_mm_storeu_ps(velocity, _mm_add_ps(_mm_loadu_ps(velocity), a0));
+		_mm_storeu_ps(velocity + 4, _mm_add_ps(_mm_loadu_ps(velocity + 4), a1));
+		_mm_storeu_ps(velocity + 8, _mm_add_ps(_mm_loadu_ps(velocity + 8), a2));
+	}
 	Vec3* LUMIX_RESTRICT particle_velocity = &m_emitter.m_velocity[0];
-	for (int i = 0, c = m_emitter.m_velocity.size(); i < c; ++i)
+	for (i += from; i < to; ++i)
 	{
-		particle_velocity[i] += m_acceleration * time_delta;
+		particle_velocity[i] += a;
 	}
 }
 
@@ -130,7 +169,7 @@ void ParticleEmitter::AttractorModule::drawGizmo(WorldEditor& editor, RenderScen
 }
 
 
-void ParticleEmitter::AttractorModule::update(float time_delta)
+void ParticleEmitter::AttractorModule::update(float time_delta, int from, int to)
 {
 	if(m_emitter.m_alpha.empty()) return;
 
@@ -144,7 +183,7 @@ void ParticleEmitter::AttractorModule::update(float time_delta)
 		if (!m_emitter.m_universe.hasEntity(entity)) continue;
 		Vec3 pos = m_emitter.m_universe.getPosition(entity);
 
-		for(int i = m_emitter.m_position.size() - 1; i >= 0; --i)
+		for(int i = to - 1; i >= from; --i)
 		{
 			Vec3 to_center = pos - particle_pos[i];
 			float dist2 = to_center.squaredLength();
@@ -219,7 +258,7 @@ void ParticleEmitter::PlaneModule::drawGizmo(WorldEditor& editor, RenderScene& s
 }
 
 
-void ParticleEmitter::PlaneModule::update(float time_delta)
+void ParticleEmitter::PlaneModule::update(float time_delta, int from, int to)
 {
 	if (m_emitter.m_alpha.empty()) return;
 
@@ -234,7 +273,7 @@ void ParticleEmitter::PlaneModule::update(float time_delta)
 		Vec3 normal = m_emitter.m_universe.getRotation(entity) * Vec3(0, 1, 0);
 		float D = -dotProduct(normal, m_emitter.m_universe.getPosition(entity));
 
-		for (int i = m_emitter.m_position.size() - 1; i >= 0; --i)
+		for (int i = to - 1; i >= from; --i)
 		{
 			const auto& pos = particle_pos[i];
 			if (dotProduct(normal, pos) + D < 0)
@@ -280,20 +319,23 @@ ParticleEmitter::SpawnShapeModule::SpawnShapeModule(ParticleEmitter& emitter)
 }
 
 
-void ParticleEmitter::SpawnShapeModule::spawnParticle(int index)
+void ParticleEmitter::SpawnShapeModule::spawn(int begin, int count)
 {
 	// ugly and ~0.1% from uniform distribution, but still faster than the correct solution
 	float r2 = m_radius * m_radius;
-	for (int i = 0; i < 10; ++i)
+	for (int index = begin; index < begin + count; ++index)
 	{
-		Vec3 v(m_radius * Math::randFloat(-1, 1),
-			m_radius * Math::randFloat(-1, 1),
-			m_radius * Math::randFloat(-1, 1));
-
-		if (v.squaredLength() < r2)
+		for (int i = 0; i < 10; ++i)
 		{
-			m_emitter.m_position[index] += v;
-			return;
+			Vec3 v(m_radius * Math::randFloat(-1, 1),
+				m_radius * Math::randFloat(-1, 1),
+				m_radius * Math::randFloat(-1, 1));
+
+			if (v.squaredLength() < r2)
+			{
+				m_emitter.m_position[index] += v;
+				break;
+			}
 		}
 	}
 }
@@ -322,11 +364,14 @@ ParticleEmitter::LinearMovementModule::LinearMovementModule(ParticleEmitter& emi
 }
 
 
-void ParticleEmitter::LinearMovementModule::spawnParticle(int index)
+void ParticleEmitter::LinearMovementModule::spawn(int begin, int count)
 {
-	m_emitter.m_velocity[index].x = m_x.getRandom();
-	m_emitter.m_velocity[index].y = m_y.getRandom();
-	m_emitter.m_velocity[index].z = m_z.getRandom();
+	for (int index = begin; index < begin + count; ++index)
+	{
+		m_emitter.m_velocity[index].x = m_x.getRandom();
+		m_emitter.m_velocity[index].y = m_y.getRandom();
+		m_emitter.m_velocity[index].z = m_z.getRandom();
+	}
 }
 
 
@@ -428,7 +473,7 @@ void ParticleEmitter::AlphaModule::sample()
 }
 
 
-void ParticleEmitter::AlphaModule::update(float)
+void ParticleEmitter::AlphaModule::update(float, int from, int to)
 {
 	if(m_emitter.m_alpha.empty()) return;
 
@@ -436,7 +481,7 @@ void ParticleEmitter::AlphaModule::update(float)
 	float* LUMIX_RESTRICT rel_life = &m_emitter.m_rel_life[0];
 	int size = m_sampled.size() - 1;
 	float float_size = (float)size;
-	for(int i = 0, c = m_emitter.m_size.size(); i < c; ++i)
+	for(int i = from; i < to; ++i)
 	{
 		float float_idx = float_size * rel_life[i];
 		int idx = (int)float_idx;
@@ -494,7 +539,7 @@ void ParticleEmitter::SizeModule::sample()
 }
 
 
-void ParticleEmitter::SizeModule::update(float)
+void ParticleEmitter::SizeModule::update(float, int from, int to)
 {
 	if (m_emitter.m_size.empty()) return;
 
@@ -502,14 +547,13 @@ void ParticleEmitter::SizeModule::update(float)
 	float* LUMIX_RESTRICT rel_life = &m_emitter.m_rel_life[0];
 	int size = m_sampled.size() - 1;
 	float float_size = (float)size;
-	for (int i = 0, c = m_emitter.m_size.size(); i < c; ++i)
+	for (int i = from; i < to; ++i)
 	{
 		float float_idx = float_size * rel_life[i];
 		int idx = (int)float_idx;
 		int next_idx = Math::minValue(idx + 1, size);
 		float w = float_idx - idx;
 		particle_size[i] = m_sampled[idx] * (1 - w) + m_sampled[next_idx] * w;
-		PROFILE_INT("Test", int(particle_size[i] * 1000));
 	}
 }
 
@@ -523,9 +567,12 @@ ParticleEmitter::RandomRotationModule::RandomRotationModule(ParticleEmitter& emi
 }
 
 
-void ParticleEmitter::RandomRotationModule::spawnParticle(int index)
+void ParticleEmitter::RandomRotationModule::spawn(int begin, int count)
 {
-	m_emitter.m_rotation[index] = Math::randFloat(0, Math::PI * 2);
+	for (int index = begin; index < begin + count; ++index)
+	{
+		m_emitter.m_rotation[index] = Math::randFloat(0, Math::PI * 2);
+	}
 }
 
 
@@ -582,6 +629,7 @@ ParticleEmitter::ParticleEmitter(Entity entity, Universe& universe, IAllocator&
 	, m_velocity(allocator)
 	, m_rotation(allocator)
 	, m_rotational_speed(allocator)
+	, m_dead(allocator)
 	, m_alpha(allocator)
 	, m_universe(universe)
 	, m_entity(entity)
@@ -594,6 +642,12 @@ ParticleEmitter::ParticleEmitter(Entity entity, Universe& universe, IAllocator&
 	m_initial_life.to = 2;
 	m_initial_size.from = 1;
 	m_initial_size.to = 1;
+	m_is_gpu_simulated = false;
+	m_gpu_time = 0;
+	m_is_one_shot = false;
+	m_origin.set(0, 0, 0);
+	Vec3 pos = entity != INVALID_ENTITY ? universe.getPosition(entity) : m_origin;
+	m_bounds.set(pos, pos);
 }
 
 
@@ -618,6 +672,42 @@ void ParticleEmitter::reset()
 	m_alpha.clear();
 	m_rotation.clear();
 	m_rotational_speed.clear();
+	m_dead.clear();
+	m_gpu_time = 0;
+}
+
+
+void ParticleEmitter::reserveParticles()
+{
+	int bursts = m_is_one_shot ? 1 : int(m_initial_life.to / m_spawn_period.from) + 1;
+	int capacity = m_spawn_count.to * bursts;
+	m_rel_life.reserve(capacity);
+	m_life.reserve(capacity);
+	m_size.reserve(capacity);
+	m_position.reserve(capacity);
+	m_velocity.reserve(capacity);
+	m_alpha.reserve(capacity);
+	m_rotation.reserve(capacity);
+	m_rotational_speed.reserve(capacity);
+	m_dead.reserve(capacity);
+}
+
+
+void ParticleEmitter::startOneShot(const Vec3& origin)
+{
+	ASSERT(m_entity == INVALID_ENTITY);
+	reset();
+	m_is_one_shot = true;
+	m_origin = origin;
+	reserveParticles();
+	spawnParticles(m_spawn_count.getRandom());
+	m_bounds = getBounds(0, m_life.size());
+}
+
+
+Vec3 ParticleEmitter::getOrigin() const
+{
+	return m_entity != INVALID_ENTITY ? m_universe.getPosition(m_entity) : m_origin;
 }
 
 
@@ -632,19 +722,34 @@ void ParticleEmitter::setMaterial(Material* material)
 }
 
 
-void ParticleEmitter::spawnParticle()
+void ParticleEmitter::spawnParticles(int count)
 {
-	m_position.push(m_universe.getPosition(m_entity));
-	m_rotation.push(0);
-	m_rotational_speed.push(0);
-	m_life.push(m_initial_life.getRandom());
-	m_rel_life.push(0.0f);
-	m_alpha.push(1);
-	m_velocity.push(Vec3(0, 0, 0));
-	m_size.push(m_initial_size.getRandom());
+	int begin = m_life.size();
+	int end = begin + count;
+	m_position.resize(end);
+	m_rotation.resize(end);
+	m_rotational_speed.resize(end);
+	m_life.resize(end);
+	m_rel_life.resize(end);
+	m_alpha.resize(end);
+	m_velocity.resize(end);
+	m_size.resize(end);
+
+	Vec3 pos = getOrigin();
+	for (int i = begin; i < end; ++i)
+	{
+		m_position[i] = pos;
+		m_rotation[i] = 0;
+		m_rotational_speed[i] = 0;
+		m_life[i] = m_initial_life.getRandom();
+		m_rel_life[i] = 0;
+		m_alpha[i] = 1;
+		m_velocity[i].set(0, 0, 0);
+		m_size[i] = m_initial_size.getRandom();
+	}
 	for (auto* module : m_modules)
 	{
-		module->spawnParticle(m_life.size() - 1);
+		module->spawn(begin, count);
 	}
 }
 
@@ -655,38 +760,52 @@ void ParticleEmitter::addModule(ModuleBase* module)
 }
 
 
-void ParticleEmitter::destroyParticle(int index)
+// ages all particles and marks the dead ones first, then removes them in one pass
+void ParticleEmitter::updateLives(float time_delta)
 {
-	for (auto* module : m_modules)
+	int count = m_rel_life.size();
+	if (count == 0) return;
+
+	m_dead.resize(count);
+	float* LUMIX_RESTRICT rel_life = &m_rel_life[0];
+	const float* LUMIX_RESTRICT life = &m_life[0];
+	uint8* LUMIX_RESTRICT dead = &m_dead[0];
+	__m128 time_delta4 = _mm_set1_ps(time_delta);
+	__m128 one = _mm_set1_ps(1);
+	int any_dead = 0;
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
 	{
-		module->destoryParticle(index);
+		__m128 age = _mm_div_ps(time_delta4, _mm_loadu_ps(life + i));
+		__m128 r = _mm_add_ps(_mm_loadu_ps(rel_life + i), age);
+		_mm_storeu_ps(rel_life + i, r);
+		int mask = _mm_movemask_ps(_mm_cmpgt_ps(r, one));
+		any_dead |= mask;
+		dead[i] = mask & 1;
+		dead[i + 1] = (mask >> 1) & 1;
+		dead[i + 2] = (mask >> 2) & 1;
+		dead[i + 3] = (mask >> 3) & 1;
 	}
-	m_life.eraseFast(index);
-	m_rel_life.eraseFast(index);
-	m_position.eraseFast(index);
-	m_velocity.eraseFast(index);
-	m_rotation.eraseFast(index);
-	m_rotational_speed.eraseFast(index);
-	m_alpha.eraseFast(index);
-	m_size.eraseFast(index);
-}
-
-
-void ParticleEmitter::updateLives(float time_delta)
-{
-	for (int i = 0, c = m_rel_life.size(); i < c; ++i)
+	for (; i < count; ++i)
 	{
-		float rel_life = m_rel_life[i];
-		rel_life += time_delta / m_life[i];
-		m_rel_life[i] = rel_life;
+		rel_life[i] += time_delta / life[i];
+		dead[i] = rel_life[i] > 1 ? 1 : 0;
+		any_dead |= dead[i];
+	}
+	if (!any_dead) return;
 
-		if (rel_life > 1)
-		{
-			destroyParticle(i);
-			--i;
-			--c;
-		}
+	for (auto* module : m_modules)
+	{
+		module->kill(dead);
 	}
+	compact(m_life, dead);
+	compact(m_rel_life, dead);
+	compact(m_position, dead);
+	compact(m_velocity, dead);
+	compact(m_rotation, dead);
+	compact(m_rotational_speed, dead);
+	compact(m_alpha, dead);
+	compact(m_size, dead);
 }
 
 
@@ -698,6 +817,7 @@ void ParticleEmitter::serialize(OutputBlob& blob)
 	blob.write(m_initial_life);
 	blob.write(m_initial_size);
 	blob.write(m_entity);
+	blob.write(m_is_gpu_simulated);
 	blob.writeString(m_material ? m_material->getPath().c_str() : "");
 	blob.write(m_modules.size());
 	for (auto* module : m_modules)
@@ -720,6 +840,8 @@ void ParticleEmitter::deserialize(InputBlob& blob, ResourceManager& manager, boo
 	blob.read(m_initial_life);
 	blob.read(m_initial_size);
 	blob.read(m_entity);
+	m_is_gpu_simulated = false;
+	if (version > (int)ParticleEmitterVersion::GPU_SIMULATION) blob.read(m_is_gpu_simulated);
 	char path[MAX_PATH_LENGTH];
 	blob.readString(path, lengthOf(path));
 	auto material_manager = manager.get(ResourceManager::MATERIAL);
@@ -744,51 +866,198 @@ void ParticleEmitter::deserialize(InputBlob& blob, ResourceManager& manager, boo
 }
 
 
-void ParticleEmitter::updatePositions(float time_delta)
+void ParticleEmitter::updatePositions(float time_delta, int from, int to)
 {
-	for (int i = 0, c = m_position.size(); i < c; ++i)
-	{
-		m_position[i] += m_velocity[i] * time_delta;
-	}
+	if (from >= to) return;
+	addScaled(&m_position[from].x, &m_velocity[from].x, time_delta, (to - from) * 3);
+}
+
+
+void ParticleEmitter::updateRotations(float time_delta, int from, int to)
+{
+	if (from >= to) return;
+	addScaled(&m_rotation[from], &m_rotational_speed[from], time_delta, to - from);
 }
 
 
-void ParticleEmitter::updateRotations(float time_delta)
+void ParticleEmitter::update(float time_delta)
 {
-	for (int i = 0, c = m_rotation.size(); i < c; ++i)
+	if (m_is_gpu_simulated)
 	{
-		m_rotation[i] += m_rotational_speed[i] * time_delta;
+		updateGPU(time_delta);
+		return;
 	}
+	updateSpawning(time_delta);
+	updateParticles(time_delta, 0, m_life.size());
+	m_bounds = getBounds(0, m_life.size());
 }
 
 
-void ParticleEmitter::update(float time_delta)
+void ParticleEmitter::updateSpawning(float time_delta)
 {
 	spawnParticles(time_delta);
 	updateLives(time_delta);
-	updatePositions(time_delta);
-	updateRotations(time_delta);
+}
+
+
+void ParticleEmitter::updateParticles(float time_delta, int from, int to)
+{
+	updatePositions(time_delta, from, to);
+	updateRotations(time_delta, from, to);
+	for (auto* module : m_modules)
+	{
+		module->update(time_delta, from, to);
+	}
+}
+
+
+AABB ParticleEmitter::getBounds(int from, int to) const
+{
+	if (from >= to)
+	{
+		Vec3 pos = getOrigin();
+		return AABB(pos, pos);
+	}
+
+	Vec3 min = m_position[from];
+	Vec3 max = m_position[from];
+	for (int i = from; i < to; ++i)
+	{
+		const Vec3& pos = m_position[i];
+		float size = m_size[i];
+		min.x = Math::minValue(min.x, pos.x - size);
+		min.y = Math::minValue(min.y, pos.y - size);
+		min.z = Math::minValue(min.z, pos.z - size);
+		max.x = Math::maxValue(max.x, pos.x + size);
+		max.y = Math::maxValue(max.y, pos.y + size);
+		max.z = Math::maxValue(max.z, pos.z + size);
+	}
+	return AABB(min, max);
+}
+
+
+template <typename T> T* ParticleEmitter::getModule() const
+{
 	for (auto* module : m_modules)
 	{
-		module->update(time_delta);
+		if (module->getType() == T::s_type) return static_cast<T*>(module);
 	}
+	return nullptr;
+}
+
+
+float ParticleEmitter::getSpawnRate() const
+{
+	float period = (m_spawn_period.from + m_spawn_period.to) * 0.5f;
+	float count = (m_spawn_count.from + m_spawn_count.to) * 0.5f;
+	return period > 0 ? count / period : 0;
+}
+
+
+void ParticleEmitter::setGPUSimulated(bool is_gpu_simulated)
+{
+	m_is_gpu_simulated = is_gpu_simulated;
+	reset();
+}
+
+
+int ParticleEmitter::getGPUParticleCount() const
+{
+	float count = getSpawnRate() * m_initial_life.to;
+	return Math::clamp(int(count) + 1, 0, MAX_GPU_PARTICLE_COUNT);
+}
+
+
+// bounds are estimated from the farthest a particle can get during its life
+void ParticleEmitter::updateGPU(float time_delta)
+{
+	m_gpu_time += time_delta;
+
+	float life = m_initial_life.to;
+	float distance = m_initial_size.to;
+	if (auto* shape = getModule<SpawnShapeModule>()) distance += shape->m_radius;
+	if (auto* movement = getModule<LinearMovementModule>())
+	{
+		Vec3 from(movement->m_x.from, movement->m_y.from, movement->m_z.from);
+		Vec3 to(movement->m_x.to, movement->m_y.to, movement->m_z.to);
+		distance += Math::maxValue(from.length(), to.length()) * life;
+	}
+	if (auto* force = getModule<ForceModule>())
+	{
+		distance += 0.5f * force->m_acceleration.length() * life * life;
+	}
+	Vec3 pos = getOrigin();
+	Vec3 extent(distance, distance, distance);
+	m_bounds.set(pos - extent, pos + extent);
+}
+
+
+// without a curve all values are 1
+static void resampleCurve(const Array<float>* sampled, Vec4* out)
+{
+	float* values = &out[0].x;
+	int size = sampled ? sampled->size() - 1 : -1;
+	for (int i = 0; i < ParticleEmitter::GPU_CURVE_SAMPLES; ++i)
+	{
+		if (size < 0)
+		{
+			values[i] = 1;
+			continue;
+		}
+		float float_idx = size * i / float(ParticleEmitter::GPU_CURVE_SAMPLES - 1);
+		int idx = (int)float_idx;
+		int next_idx = Math::minValue(idx + 1, size);
+		float w = float_idx - idx;
+		values[i] = (*sampled)[idx] * (1 - w) + (*sampled)[next_idx] * w;
+	}
+}
+
+
+void ParticleEmitter::getGPUParams(Vec4* params) const
+{
+	float rate = getSpawnRate();
+	int count = getGPUParticleCount();
+	params[0].set(getOrigin(), m_gpu_time);
+	params[1].set(m_initial_life.from, m_initial_life.to, rate, rate > 0 ? count / rate : 0);
+
+	auto* shape = getModule<SpawnShapeModule>();
+	auto* movement = getModule<LinearMovementModule>();
+	auto* force = getModule<ForceModule>();
+	auto* alpha = getModule<AlphaModule>();
+	auto* size = getModule<SizeModule>();
+	float radius = shape ? shape->m_radius : 0;
+	if (movement)
+	{
+		params[2].set(movement->m_x.from, movement->m_y.from, movement->m_z.from, radius);
+		params[3].set(movement->m_x.to, movement->m_y.to, movement->m_z.to, 0);
+	}
+	else
+	{
+		params[2].set(0, 0, 0, radius);
+		params[3].set(0, 0, 0, 0);
+	}
+	params[3].w = getModule<RandomRotationModule>() ? 1.0f : 0.0f;
+	params[4].set(force ? force->m_acceleration : Vec3(0, 0, 0), 0);
+	params[5].set(m_initial_size.from, m_initial_size.to, size ? 1.0f : 0.0f, alpha ? 1.0f : 0.0f);
+
+	static const int CURVE_VEC4_COUNT = GPU_CURVE_SAMPLES / 4;
+	resampleCurve(alpha ? &alpha->m_sampled : nullptr, params + 6);
+	resampleCurve(size ? &size->m_sampled : nullptr, params + 6 + CURVE_VEC4_COUNT);
 }
 
 
 void ParticleEmitter::spawnParticles(float time_delta)
 {
+	if (m_is_one_shot) return;
 	m_next_spawn_time -= time_delta;
 
+	int spawn_count = 0;
 	while (m_next_spawn_time < 0)
 	{
 		m_next_spawn_time += m_spawn_period.getRandom();
-
-		int spawn_count = m_spawn_count.getRandom();
-		for (int i = 0; i < spawn_count; ++i)
-		{
-			spawnParticle();
-		}
+		spawn_count += m_spawn_count.getRandom();
 	}
+	if (spawn_count > 0) spawnParticles(spawn_count);
 }
 
 
@@ -807,13 +1076,16 @@ struct InitialVelocityModule : public ParticleEmitter::ModuleBase
 	}
 
 
-	void spawnParticle(int index) override
+	void spawn(int begin, int count) override
 	{
-		Vec3 v;
-		v.x = m_x.getRandom();
-		v.y = m_y.getRandom();
-		v.z = m_z.getRandom();
-		m_emitter.m_velocity[index] = v;
+		for (int index = begin; index < begin + count; ++index)
+		{
+			Vec3 v;
+			v.x = m_x.getRandom();
+			v.y = m_y.getRandom();
+			v.z = m_z.getRandom();
+			m_emitter.m_velocity[index] = v;
+		}
 	}
 };
 
@@ -2,6 +2,7 @@
 
 
 #include "lumix.h"
+#include "core/aabb.h"
 #include "core/array.h"
 #include "core/vec.h"
 
@@ -64,9 +65,13 @@ public:
 		explicit ModuleBase(ParticleEmitter& emitter);
 
 		virtual ~ModuleBase() {}
-		virtual void spawnParticle(int /*index*/) {}
-		virtual void destoryParticle(int /*index*/) {}
-		virtual void update(float /*time_delta*/) {}
+		// particles [begin, begin + count) were just added
+		virtual void spawn(int /*begin*/, int /*count*/) {}
+		// called before particles with dead[i] != 0 are removed by ParticleEmitter::compact,
+		// modules with their own per-particle arrays compact them the same way
+		virtual void kill(const uint8* /*dead*/) {}
+		// updates particles [from, to), ranges of one emitter can run on different threads
+		virtual void update(float /*time_delta*/, int /*from*/, int /*to*/) {}
 		virtual void serialize(OutputBlob& blob) = 0;
 		virtual void deserialize(InputBlob& blob, int version) = 0;
 		virtual uint32 getType() const = 0;
@@ -79,7 +84,7 @@ public:
 	struct LUMIX_RENDERER_API SpawnShapeModule : public ModuleBase
 	{
 		explicit SpawnShapeModule(ParticleEmitter& emitter);
-		void spawnParticle(int index) override;
+		void spawn(int begin, int count) override;
 		void serialize(OutputBlob& blob) override;
 		void deserialize(InputBlob& blob, int version) override;
 		uint32 getType() const override { return s_type; }
@@ -97,7 +102,7 @@ public:
 	struct LUMIX_RENDERER_API LinearMovementModule : public ModuleBase
 	{
 		explicit LinearMovementModule(ParticleEmitter& emitter);
-		void spawnParticle(int index) override;
+		void spawn(int begin, int count) override;
 		void serialize(OutputBlob& blob) override;
 		void deserialize(InputBlob& blob, int version) override;
 		uint32 getType() const override { return s_type; }
@@ -114,7 +119,7 @@ public:
 		explicit PlaneModule(ParticleEmitter& emitter);
 		void serialize(OutputBlob& blob) override;
 		void deserialize(InputBlob& blob, int version) override;
-		void update(float time_delta) override;
+		void update(float time_delta, int from, int to) override;
 		uint32 getType() const override { return s_type; }
 		void drawGizmo(WorldEditor& editor, RenderScene& scene) override;
 
@@ -130,7 +135,7 @@ public:
 		explicit AttractorModule(ParticleEmitter& emitter);
 		void serialize(OutputBlob& blob) override;
 		void deserialize(InputBlob& blob, int version) override;
-		void update(float time_delta) override;
+		void update(float time_delta, int from, int to) override;
 		uint32 getType() const override { return s_type; }
 		void drawGizmo(WorldEditor& editor, RenderScene& scene) override;
 
@@ -146,7 +151,7 @@ public:
 		explicit ForceModule(ParticleEmitter& emitter);
 		void serialize(OutputBlob& blob) override;
 		void deserialize(InputBlob& blob, int version) override;
-		void update(float time_delta) override;
+		void update(float time_delta, int from, int to) override;
 		uint32 getType() const override { return s_type; }
 
 		static const uint32 s_type;
@@ -157,7 +162,7 @@ public:
 	struct LUMIX_RENDERER_API AlphaModule : public ModuleBase
 	{
 		explicit AlphaModule(ParticleEmitter& emitter);
-		void update(float time_delta) override;
+		void update(float time_delta, int from, int to) override;
 		void serialize(OutputBlob&) override;
 		void deserialize(InputBlob&, int) override;
 		uint32 getType() const override { return s_type; }
@@ -173,7 +178,7 @@ public:
 	struct LUMIX_RENDERER_API SizeModule : public ModuleBase
 	{
 		explicit SizeModule(ParticleEmitter& emitter);
-		void update(float time_delta) override;
+		void update(float time_delta, int from, int to) override;
 		void serialize(OutputBlob&) override;
 		void deserialize(InputBlob&, int) override;
 		uint32 getType() const override { return s_type; }
@@ -189,7 +194,7 @@ public:
 	struct LUMIX_RENDERER_API RandomRotationModule : public ModuleBase
 	{
 		explicit RandomRotationModule(ParticleEmitter& emitter);
-		void spawnParticle(int index) override;
+		void spawn(int begin, int count) override;
 		void serialize(OutputBlob&) override {}
 		void deserialize(InputBlob&, int) override {}
 		uint32 getType() const override { return s_type; }
@@ -203,15 +208,63 @@ public:
 	~ParticleEmitter();
 
 	void reset();
+	// reserves arrays for the most particles the spawn settings can keep alive
+	void reserveParticles();
+	// the emitter must not have an entity, it spawns one burst at origin and stops spawning
+	void startOneShot(const Vec3& origin);
+	bool isOneShotFinished() const { return m_is_one_shot && m_life.empty(); }
 	void drawGizmo(WorldEditor& editor, RenderScene& scene);
 	void serialize(OutputBlob& blob);
 	void deserialize(InputBlob& blob, ResourceManager& manager, bool has_version);
 	void update(float time_delta);
+	// spawns and destroys particles, must run before updateParticles
+	void updateSpawning(float time_delta);
+	void updateParticles(float time_delta, int from, int to);
+	AABB getBounds(int from, int to) const;
+	// swap-removes elements with dead[i] != 0, the same dead mask moves the same elements
+	template <typename T> static void compact(Array<T>& array, const uint8* dead)
+	{
+		int last = array.size() - 1;
+		for (int i = 0; i <= last; ++i)
+		{
+			if (!dead[i]) continue;
+			while (last > i && dead[last]) --last;
+			if (last == i)
+			{
+				last = i - 1;
+				break;
+			}
+			array[i] = array[last];
+			--last;
+		}
+		array.resize(last + 1);
+	}
+	// GPU simulated emitters have no particles on the CPU, the vertex shader computes each
+	// particle from its slot and the time, attractors and planes are ignored
+	void updateGPU(float time_delta);
+	void setGPUSimulated(bool is_gpu_simulated);
+	bool isGPUSimulated() const { return m_is_gpu_simulated; }
+	int getGPUParticleCount() const;
+	// u_particleParams:
+	// [0] position xyz, time
+	// [1] life from, life to, particles per second, cycle of a slot in seconds
+	// [2] velocity from xyz, spawn radius
+	// [3] velocity to xyz, random rotation (0/1)
+	// [4] acceleration xyz, 0
+	// [5] initial size from, initial size to, has size curve (0/1), has alpha curve (0/1)
+	// [6-9] alpha curve, GPU_CURVE_SAMPLES values over the relative life
+	// [10-13] size curve
+	void getGPUParams(Vec4* params) const;
 	Material* getMaterial() const { return m_material; }
 	void setMaterial(Material* material);
 	IAllocator& getAllocator() { return m_allocator; }
 	void addModule(ModuleBase* module);
 
+public:
+	static const int MAX_GPU_PARTICLE_COUNT = 1 << 17;
+	static const int GPU_CURVE_SAMPLES = 16;
+	static const int GPU_PARAMS_COUNT = 6 + 2 * GPU_CURVE_SAMPLES / 4;
+
 public:
 	Array<float> m_rel_life;
 	Array<float> m_life;
@@ -221,6 +274,7 @@ public:
 	Array<float> m_alpha;
 	Array<float> m_rotation;
 	Array<float> m_rotational_speed;
+	Array<uint8> m_dead;
 
 	Interval m_spawn_period;
 	Interval m_initial_life;
@@ -229,18 +283,27 @@ public:
 
 	Array<ModuleBase*> m_modules;
 	Entity m_entity;
+	// of all particles including their size, set by update
+	AABB m_bounds;
 
 private:
-	void spawnParticle();
-	void destroyParticle(int index);
+	void spawnParticles(int count);
 	void spawnParticles(float time_delta);
 	void updateLives(float time_delta);
-	void updatePositions(float time_delta);
-	void updateRotations(float time_delta);
+	void updatePositions(float time_delta, int from, int to);
+	void updateRotations(float time_delta, int from, int to);
+	template <typename T> T* getModule() const;
+	float getSpawnRate() const;
+	Vec3 getOrigin() const;
 
 private:
 	IAllocator& m_allocator;
 	float m_next_spawn_time;
+	bool m_is_gpu_simulated;
+	float m_gpu_time;
+	bool m_is_one_shot;
+	// used instead of the entity's position by one-shot emitters
+	Vec3 m_origin;
 	Universe& m_universe;
 	Material* m_material;
 };
@@ -1,19 +1,28 @@
 #include "pipeline.h"
 
 #include "renderer/pipeline.h"
+#include "core/aabb.h"
 #include "core/crc32.h"
+#include "core/frame_allocator.h"
+#include "core/frame_stats.h"
 #include "core/frustum.h"
 #include "core/fs/disk_file_device.h"
 #include "core/fs/ifile.h"
 #include "core/fs/file_system.h"
 #include "core/lifo_allocator.h"
 #include "core/log.h"
+#include "core/lua_bytecode_cache.h"
 #include "core/lua_wrapper.h"
+#include "core/mtjd/parallel_for.h"
 #include "core/profiler.h"
+#include "core/radix_sort.h"
 #include "core/static_array.h"
+#include "core/string.h"
 #include "engine.h"
 #include "lua_script/lua_script_system.h"
+#include "renderer/depth_pyramid.h"
 #include "renderer/frame_buffer.h"
+#include "renderer/light_grid.h"
 #include "renderer/material.h"
 #include "renderer/material_manager.h"
 #include "renderer/model.h"
@@ -36,6 +45,30 @@ namespace Lumix
 
 static const float SHADOW_CAM_NEAR = 50.0f;
 static const float SHADOW_CAM_FAR = 5000.0f;
+static const int SHADOW_CASCADES_COUNT = 4;
+// cascades from this one on are updated round-robin, one per frame, when shadowmap caching is enabled
+static const int SHADOW_FIRST_CACHED_CASCADE = 2;
+// a cascade fitted to its receivers is at most 2^SHADOW_MAX_FIT_STEPS times smaller than its split
+static const int SHADOW_MAX_FIT_STEPS = 3;
+static const int FILL_BATCHES_GRAIN = 64;
+// model LOD distances are authored for this vertical FOV (in degrees) and screen height
+static const float LOD_REFERENCE_FOV = 60.0f;
+static const float LOD_REFERENCE_HEIGHT = 1080.0f;
+// light grid textures: lights have one texel per row for position and radius, color and
+// attenuation, direction and fov, specular; light indices are stored in rows of this width
+static const int LIGHT_GRID_LIGHT_TEXELS = 4;
+static const int LIGHT_GRID_INDICES_WIDTH = 256;
+// skinning matrices of instanced skinned meshes, all of them for a frame are in one RGBA32F
+// texture; a matrix takes four consecutive texels, the matrix i starts at the texel
+// (i % BONE_TEXTURE_MATRICES_PER_ROW * 4, i / BONE_TEXTURE_MATRICES_PER_ROW)
+static const int BONE_TEXTURE_WIDTH = 1024;
+static const int BONE_TEXTURE_HEIGHT = 128;
+static const int BONE_TEXTURE_MATRICES_PER_ROW = BONE_TEXTURE_WIDTH / 4;
+static const int BONE_TEXTURE_CAPACITY = BONE_TEXTURE_MATRICES_PER_ROW * BONE_TEXTURE_HEIGHT;
+// dynamic resolution changes the scale of screen sized framebuffers by this step, at most once in
+// RESOLUTION_SCALE_COOLDOWN frames
+static const float RESOLUTION_SCALE_STEP = 0.05f;
+static const int RESOLUTION_SCALE_COOLDOWN = 10;
 
 
 struct InstanceData
@@ -49,6 +82,25 @@ struct InstanceData
 };
 
 
+// instance data of skinned meshes drawn with the bone texture
+struct SkinnedInstance
+{
+	Matrix matrix;
+	// x is the index of the first skinning matrix of the instance in the bone texture
+	Vec4 palette;
+};
+
+
+// instanced draw of consecutive sorted meshes, skinned meshes have no instance buffer unless
+// their shader reads skinning matrices from the bone texture
+struct MeshBatch
+{
+	InstanceData instances;
+	int first;
+	bool is_skinned;
+};
+
+
 struct View
 {
 	uint8 bgfx_id;
@@ -56,6 +108,10 @@ struct View
 	uint32 stencil;
 	int pass_idx;
 	CommandBufferGenerator command_buffer;
+	// key of the last draw which sent uniforms of its material, see PipelineImpl::setMaterial
+	Material* material;
+	bgfx::ProgramHandle material_program;
+	uint64 material_state;
 };
 
 
@@ -238,6 +294,22 @@ void CommandBufferGenerator::end()
 }
 
 
+// false while the LOD of the mesh is not on the GPU, i.e. the mesh must not be drawn
+static bool setMeshBuffers(const Model& model, const Mesh& mesh)
+{
+	const Model::LODBuffers& buffers = model.getBuffers(mesh);
+	if (!bgfx::isValid(buffers.vertices)) return false;
+
+	const uint16 stride = mesh.vertex_def.getStride();
+	bgfx::setVertexBuffer(buffers.vertices,
+		mesh.attribute_array_offset / stride - buffers.first_vertex,
+		mesh.attribute_array_size / stride);
+	bgfx::setIndexBuffer(
+		buffers.indices, mesh.indices_offset - buffers.first_index, mesh.indices_count);
+	return true;
+}
+
+
 
 struct PipelineImpl : public Pipeline
 {
@@ -245,12 +317,20 @@ struct PipelineImpl : public Pipeline
 		: m_allocator(allocator)
 		, m_path(path)
 		, m_framebuffers(allocator)
+		, m_transient_framebuffers(allocator)
+		, m_framebuffer_pool(allocator)
 		, m_lua_state(nullptr)
 		, m_parameters(allocator)
 		, m_custom_commands_handlers(allocator)
 		, m_tmp_terrains(allocator)
 		, m_tmp_grasses(allocator)
+		, m_particle_batches(allocator)
 		, m_tmp_meshes(allocator)
+		, m_sorted_meshes(allocator)
+		, m_sorted_meshes_tmp(allocator)
+		, m_sorted_meshes_offsets(allocator)
+		, m_sorted_meshes_heads(allocator)
+		, m_mesh_batches(allocator)
 		, m_tmp_local_lights(allocator)
 		, m_uniforms(allocator)
 		, m_renderer(renderer)
@@ -258,9 +338,27 @@ struct PipelineImpl : public Pipeline
 		, m_debug_line_material(nullptr)
 		, m_debug_flags(BGFX_DEBUG_TEXT)
 		, m_point_light_shadowmaps(allocator)
+		, m_cached_shadowmaps(allocator)
+		, m_is_shadowmap_caching_enabled(true)
 		, m_materials(allocator)
 		, m_is_rendering_in_shadowmap(false)
 		, m_is_ready(false)
+		, m_is_occlusion_culling_enabled(false)
+		, m_depth_pyramid(allocator)
+		, m_hiz_renderbuffer_idx(-1)
+		, m_is_hiz_readback_pending(false)
+		, m_lod_bias(1)
+		, m_target_gpu_frame_time(0)
+		, m_min_resolution_scale(1)
+		, m_max_resolution_scale(1)
+		, m_resolution_scale(1)
+		, m_resolution_scale_cooldown(0)
+		, m_light_grid(allocator)
+		, m_light_grid_lights(allocator)
+		, m_palette_slots(allocator)
+		, m_palette_uploads(allocator)
+		, m_palette_frame(0)
+		, m_bone_texture_used(0)
 	{
 		m_deferred_point_light_vertex_decl.begin()
 			.add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float)
@@ -273,8 +371,13 @@ struct PipelineImpl : public Pipeline
 			.end();
 
 		m_is_wireframe = false;
+		m_hiz_framebuffer[0] = '\0';
 		m_view_x = m_view_y = 0;
 		m_has_shadowmap_define_idx = m_renderer.getShaderDefineIdx("HAS_SHADOWMAP");
+		m_bone_texture_define_idx = m_renderer.getShaderDefineIdx("BONE_TEXTURE");
+		m_gpu_grass_define_idx = m_renderer.getShaderDefineIdx("GPU_GRASS");
+		m_gpu_particles_define_idx = m_renderer.getShaderDefineIdx("GPU_PARTICLES");
+		m_gpu_particle_slots = BGFX_INVALID_HANDLE;
 
 		createUniforms();
 
@@ -283,9 +386,12 @@ struct PipelineImpl : public Pipeline
 
 		m_scene = nullptr;
 		m_width = m_height = -1;
+		invalidateShadowmapCache();
 
 		createParticleBuffers();
 		createCubeBuffers();
+		createLightGridTextures();
+		createBoneTexture();
 		m_stats = {};
 	}
 
@@ -374,6 +480,9 @@ struct PipelineImpl : public Pipeline
 		}
 		LUMIX_DELETE(m_allocator, m_default_framebuffer);
 		m_framebuffers.clear();
+		m_transient_framebuffers.clear();
+		destroyFramebufferPool();
+		invalidateShadowmapCache();
 		bgfx::frame();
 		bgfx::frame();
 	}
@@ -411,8 +520,9 @@ struct PipelineImpl : public Pipeline
 			exposeCustomCommandToLua(handler);
 		}
 
+		auto& bytecode_cache = m_renderer.getEngine().getLuaBytecodeCache();
 		bool errors =
-			luaL_loadbuffer(
+			bytecode_cache.load(
 				m_lua_state, (const char*)file.getBuffer(), file.size(), m_path.c_str()) !=
 			LUA_OK;
 		if (errors)
@@ -423,7 +533,7 @@ struct PipelineImpl : public Pipeline
 		}
 
 		lua_rawgeti(m_lua_state, LUA_REGISTRYINDEX, m_lua_env);
-		lua_setupvalue(m_lua_state, -2, 1);
+		LuaWrapper::setEnvironment(m_lua_state, -2);
 		errors = lua_pcall(m_lua_state, 0, LUA_MULTRET, 0) != LUA_OK;
 		if (errors)
 		{
@@ -538,9 +648,24 @@ struct PipelineImpl : public Pipeline
 		m_bone_matrices_uniform =
 			bgfx::createUniform("u_boneMatrices", bgfx::UniformType::Mat4, 64);
 		m_layer_uniform = bgfx::createUniform("u_layer", bgfx::UniformType::Vec4);
+		m_lod_fade_uniform = bgfx::createUniform("u_lodFade", bgfx::UniformType::Vec4);
+		m_light_grid_params_uniform = bgfx::createUniform("u_lightGridParams", bgfx::UniformType::Vec4);
+		m_light_grid_clusters_uniform =
+			bgfx::createUniform("u_texLightGridClusters", bgfx::UniformType::Int1);
+		m_light_grid_indices_uniform =
+			bgfx::createUniform("u_texLightGridIndices", bgfx::UniformType::Int1);
+		m_light_grid_lights_uniform = bgfx::createUniform("u_texLightGridLights", bgfx::UniformType::Int1);
+		m_bone_texture_uniform = bgfx::createUniform("u_texBoneMatrices", bgfx::UniformType::Int1);
 		m_mat_color_shininess_uniform =
 			bgfx::createUniform("u_materialColorShininess", bgfx::UniformType::Vec4);
 		m_terrain_matrix_uniform = bgfx::createUniform("u_terrainMatrix", bgfx::UniformType::Mat4);
+		m_grass_params_uniform = bgfx::createUniform("u_grassParams", bgfx::UniformType::Vec4);
+		m_grass_heightmap_uniform =
+			bgfx::createUniform("u_texGrassHeightmap", bgfx::UniformType::Int1);
+		m_grass_splatmap_uniform =
+			bgfx::createUniform("u_texGrassSplatmap", bgfx::UniformType::Int1);
+		m_particle_params_uniform = bgfx::createUniform(
+			"u_particleParams", bgfx::UniformType::Vec4, ParticleEmitter::GPU_PARAMS_COUNT);
 	}
 
 
@@ -548,9 +673,19 @@ struct PipelineImpl : public Pipeline
 	{
 		bgfx::destroyUniform(m_tex_shadowmap_uniform);
 		bgfx::destroyUniform(m_terrain_matrix_uniform);
+		bgfx::destroyUniform(m_grass_params_uniform);
+		bgfx::destroyUniform(m_grass_heightmap_uniform);
+		bgfx::destroyUniform(m_grass_splatmap_uniform);
+		bgfx::destroyUniform(m_particle_params_uniform);
 		bgfx::destroyUniform(m_mat_color_shininess_uniform);
 		bgfx::destroyUniform(m_bone_matrices_uniform);
 		bgfx::destroyUniform(m_layer_uniform);
+		bgfx::destroyUniform(m_lod_fade_uniform);
+		bgfx::destroyUniform(m_light_grid_params_uniform);
+		bgfx::destroyUniform(m_light_grid_clusters_uniform);
+		bgfx::destroyUniform(m_light_grid_indices_uniform);
+		bgfx::destroyUniform(m_light_grid_lights_uniform);
+		bgfx::destroyUniform(m_bone_texture_uniform);
 		bgfx::destroyUniform(m_terrain_scale_uniform);
 		bgfx::destroyUniform(m_rel_camera_pos_uniform);
 		bgfx::destroyUniform(m_terrain_params_uniform);
@@ -593,93 +728,189 @@ struct PipelineImpl : public Pipeline
 			bgfx::destroyUniform(m_uniforms[i]);
 		}
 
+		if (m_is_hiz_readback_pending) m_renderer.cancelReadbacks(getHiZReadbackCallback());
 		for (int i = 0; i < m_framebuffers.size(); ++i)
 		{
 			LUMIX_DELETE(m_allocator, m_framebuffers[i]);
 			if (m_framebuffers[i] == m_default_framebuffer) m_default_framebuffer = nullptr;
 		}
 		LUMIX_DELETE(m_allocator, m_default_framebuffer);
+		destroyFramebufferPool();
 
 		bgfx::destroyVertexBuffer(m_cube_vb);
 		bgfx::destroyIndexBuffer(m_cube_ib);
+		bgfx::destroyTexture(m_light_grid_clusters_texture);
+		bgfx::destroyTexture(m_light_grid_indices_texture);
+		bgfx::destroyTexture(m_light_grid_lights_texture);
+		bgfx::destroyTexture(m_bone_texture);
+		m_allocator.deallocate(m_bone_texture_data);
 		bgfx::destroyIndexBuffer(m_particle_index_buffer);
 		bgfx::destroyVertexBuffer(m_particle_vertex_buffer);
+		if (bgfx::isValid(m_gpu_particle_slots)) bgfx::destroyVertexBuffer(m_gpu_particle_slots);
 	}
 
 
-	void renderParticlesFromEmitter(const ParticleEmitter& emitter)
+	// slot index and three random numbers for each GPU simulated particle, shared by emitters
+	void createGPUParticleSlots()
 	{
-		static const int PARTICLE_BATCH_SIZE = 256;
+		int count = ParticleEmitter::MAX_GPU_PARTICLE_COUNT;
+		const bgfx::Memory* mem = bgfx::alloc(count * sizeof(Vec4));
+		Vec4* slots = (Vec4*)mem->data;
+		for (int i = 0; i < count; ++i)
+		{
+			slots[i].set((float)i, Math::randFloat(), Math::randFloat(), Math::randFloat());
+		}
+		bgfx::VertexDecl decl;
+		decl.begin().add(bgfx::Attrib::TexCoord7, 4, bgfx::AttribType::Float).end();
+		m_gpu_particle_slots = bgfx::createVertexBuffer(mem, decl);
+	}
 
-		if (emitter.m_life.empty()) return;
-		if (!emitter.getMaterial()) return;
-		if (!emitter.getMaterial()->isReady()) return;
 
-		Material* material = emitter.getMaterial();
+	struct ParticleInstance
+	{
+		Vec4 pos;
+		Vec4 alpha_and_rotation;
+	};
 
-		const bgfx::InstanceDataBuffer* instance_buffer = nullptr;
-		struct Instance
-		{
-			Vec4 pos;
-			Vec4 alpha_and_rotation;
-		};
-		Instance* instance = nullptr;
 
-		auto& view = m_views[m_current_render_views[0]];
-		for (int i = 0, c = emitter.m_life.size(); i < c; ++i)
+	struct ParticleBatch
+	{
+		const ParticleEmitter* emitter;
+		const bgfx::InstanceDataBuffer* buffer;
+	};
+
+
+	void submitParticles(Material* material,
+		bgfx::VertexBufferHandle instances,
+		int first_instance,
+		const bgfx::InstanceDataBuffer* transient_instances,
+		int count)
+	{
+		for (int i = 0; i < m_current_render_view_count; ++i)
 		{
-			if (i % PARTICLE_BATCH_SIZE == 0)
-			{
-				if (instance_buffer)
-				{
-					executeCommandBuffer(material->getCommandBuffer(), material);
-					executeCommandBuffer(view.command_buffer.buffer, material);
-
-					bgfx::setInstanceDataBuffer(instance_buffer, PARTICLE_BATCH_SIZE);
-					bgfx::setVertexBuffer(m_particle_vertex_buffer);
-					bgfx::setIndexBuffer(m_particle_index_buffer);
-					bgfx::setStencil(view.stencil, BGFX_STENCIL_NONE);
-					bgfx::setState(view.render_state | material->getRenderStates());
-					++m_stats.m_draw_call_count;
-					m_stats.m_instance_count += PARTICLE_BATCH_SIZE;
-					m_stats.m_triangle_count += PARTICLE_BATCH_SIZE * 2;
-					bgfx::submit(view.bgfx_id, material->getShaderInstance().m_program_handles[view.pass_idx]);
-				}
+			auto& view = m_views[m_current_render_views[i]];
+			uint64 state = view.render_state | material->getRenderStates();
+			auto program = setMaterial(view, material, state);
 
-				instance_buffer = bgfx::allocInstanceDataBuffer(PARTICLE_BATCH_SIZE, sizeof(Instance));
-				instance = (Instance*)instance_buffer->data;
+			if (transient_instances)
+			{
+				bgfx::setInstanceDataBuffer(transient_instances, count);
 			}
+			else
+			{
+				bgfx::setInstanceDataBuffer(instances, first_instance, count);
+			}
+			bgfx::setVertexBuffer(m_particle_vertex_buffer);
+			bgfx::setIndexBuffer(m_particle_index_buffer);
+			bgfx::setStencil(view.stencil, BGFX_STENCIL_NONE);
+			bgfx::setState(state);
+			++m_stats.m_draw_call_count;
+			m_stats.m_instance_count += count;
+			m_stats.m_triangle_count += count * 2;
+			bgfx::submit(view.bgfx_id, program);
+		}
+	}
+
 
-			instance->pos = Vec4(emitter.m_position[i], emitter.m_size[i]);
-			instance->alpha_and_rotation = Vec4(emitter.m_alpha[i], emitter.m_rotation[i], 0, 0);
-			++instance;
+	void renderGPUParticles(const ParticleEmitter& emitter)
+	{
+		int count = emitter.getGPUParticleCount();
+		if (count == 0) return;
+		if (!bgfx::isValid(m_gpu_particle_slots)) createGPUParticleSlots();
+
+		Material* material = emitter.getMaterial();
+		if (!material->isDefined(m_gpu_particles_define_idx))
+		{
+			material->setDefine(m_gpu_particles_define_idx, true);
 		}
+		Vec4 params[ParticleEmitter::GPU_PARAMS_COUNT];
+		emitter.getGPUParams(params);
+		bgfx::setUniform(m_particle_params_uniform, params, ParticleEmitter::GPU_PARAMS_COUNT);
 
-		executeCommandBuffer(material->getCommandBuffer(), material);
-		executeCommandBuffer(view.command_buffer.buffer, material);
+		submitParticles(material, m_gpu_particle_slots, 0, nullptr, count);
+	}
 
-		int instance_count = emitter.m_life.size() % PARTICLE_BATCH_SIZE;
-		bgfx::setInstanceDataBuffer(instance_buffer, instance_count);
-		bgfx::setVertexBuffer(m_particle_vertex_buffer);
-		bgfx::setIndexBuffer(m_particle_index_buffer);
-		bgfx::setStencil(view.stencil, BGFX_STENCIL_NONE);
-		bgfx::setState(view.render_state | material->getRenderStates());
-		++m_stats.m_draw_call_count;
-		m_stats.m_instance_count += instance_count;
-		m_stats.m_triangle_count += instance_count * 2;
-		bgfx::submit(view.bgfx_id, material->getShaderInstance().m_program_handles[view.pass_idx]);
+
+	// returns false when there is no memory left for instances
+	bool addParticleBatch(const ParticleEmitter& emitter)
+	{
+		Material* material = emitter.getMaterial();
+		if (!material || !material->isReady()) return true;
+
+		const AABB& bounds = emitter.m_bounds;
+		Vec3 center = (bounds.getMin() + bounds.getMax()) * 0.5f;
+		if (!m_camera_frustum.isSphereInside(center, (bounds.getMax() - center).length()))
+		{
+			return true;
+		}
+
+		if (emitter.isGPUSimulated())
+		{
+			renderGPUParticles(emitter);
+			return true;
+		}
+
+		int count = emitter.m_life.size();
+		if (count == 0) return true;
+		if (!bgfx::checkAvailInstanceDataBuffer(count, sizeof(ParticleInstance)))
+		{
+			g_log_warning.log("Renderer") << "Not enough memory for particles";
+			return false;
+		}
+		if (material->isDefined(m_gpu_particles_define_idx))
+		{
+			material->setDefine(m_gpu_particles_define_idx, false);
+		}
+		ParticleBatch& batch = m_particle_batches.emplace();
+		batch.emitter = &emitter;
+		batch.buffer = bgfx::allocInstanceDataBuffer(count, sizeof(ParticleInstance));
+		return true;
 	}
 
 
+	// visible emitters get one instance buffer each, workers fill them, then each emitter is
+	// one instanced draw per view
 	void renderParticles()
 	{
 		PROFILE_FUNCTION();
-		const auto& emitters = m_scene->getParticleEmitters();
-		for (const auto* emitter : emitters)
+		m_particle_batches.clear();
+		bool has_memory = true;
+		for (const auto* emitter : m_scene->getParticleEmitters())
+		{
+			if (emitter && has_memory) has_memory = addParticleBatch(*emitter);
+		}
+		for (const auto* emitter : m_scene->getParticleEffects())
 		{
-			if (!emitter) continue;
+			if (has_memory) has_memory = addParticleBatch(*emitter);
+		}
+
+		MTJD::parallelFor(m_renderer.getEngine().getMTJDManager(),
+			0,
+			m_particle_batches.size(),
+			1,
+			[this](int from, int to)
+			{
+				for (int i = from; i < to; ++i)
+				{
+					const ParticleEmitter& emitter = *m_particle_batches[i].emitter;
+					auto* LUMIX_RESTRICT instance =
+						(ParticleInstance*)m_particle_batches[i].buffer->data;
+					for (int j = 0, c = emitter.m_life.size(); j < c; ++j)
+					{
+						instance[j].pos = Vec4(emitter.m_position[j], emitter.m_size[j]);
+						instance[j].alpha_and_rotation =
+							Vec4(emitter.m_alpha[j], emitter.m_rotation[j], 0, 0);
+					}
+				}
+			});
 
-			renderParticlesFromEmitter(*emitter);
+		for (const ParticleBatch& batch : m_particle_batches)
+		{
+			submitParticles(batch.emitter->getMaterial(),
+				BGFX_INVALID_HANDLE,
+				0,
+				batch.buffer,
+				batch.emitter->m_life.size());
 		}
 	}
 
@@ -690,6 +921,7 @@ struct PipelineImpl : public Pipeline
 	{
 		FrameBuffer* fb = getFramebuffer(framebuffer_name);
 		if (!fb) return;
+		useFramebuffer(fb);
 
 		Vec4 size;
 		size.x = (float)fb->getWidth();
@@ -719,30 +951,24 @@ struct PipelineImpl : public Pipeline
 		Mesh& mesh = *data.mesh;
 		const Model& model = *data.model;
 		Material* material = mesh.material;
-		const uint16 stride = mesh.vertex_def.getStride();
 
 		for (int i = 0; i <	view_count; ++i)
 		{
 			auto& view = m_views[views[i]];
 			ShaderInstance& shader_instance = mesh.material->getShaderInstance();
 			if (!bgfx::isValid(shader_instance.m_program_handles[view.pass_idx])) continue;
+			if (!setMeshBuffers(model, mesh)) break;
 			
-			executeCommandBuffer(material->getCommandBuffer(), material);
-			executeCommandBuffer(view.command_buffer.buffer, material);
-
-			bgfx::setVertexBuffer(model.getVerticesHandle(),
-				mesh.attribute_array_offset / stride,
-				mesh.attribute_array_size / stride);
-			bgfx::setIndexBuffer(model.getIndicesHandle(),
-				mesh.indices_offset,
-				mesh.indices_count);
+			uint64 state = view.render_state | material->getRenderStates();
+			auto program = setMaterial(view, material, state);
+
 			bgfx::setStencil(view.stencil, BGFX_STENCIL_NONE);
-			bgfx::setState(view.render_state | material->getRenderStates());
+			bgfx::setState(state);
 			bgfx::setInstanceDataBuffer(data.buffer, data.instance_count);
 			++m_stats.m_draw_call_count;
 			m_stats.m_instance_count += data.instance_count;
 			m_stats.m_triangle_count += data.instance_count * mesh.indices_count / 3;
-			bgfx::submit(view.bgfx_id, shader_instance.m_program_handles[view.pass_idx]);
+			bgfx::submit(view.bgfx_id, program);
 		}
 		data.buffer = nullptr;
 		data.instance_count = 0;
@@ -750,39 +976,37 @@ struct PipelineImpl : public Pipeline
 	}
 
 
-	void finishInstances(int idx)
+	void submitInstances(const InstanceData& data)
 	{
-		InstanceData& data = m_instances_data[idx];
-		if (!data.buffer) return;
-
 		Mesh& mesh = *data.mesh;
 		const Model& model = *data.model;
 		Material* material = mesh.material;
-		const uint16 stride = mesh.vertex_def.getStride();
 
 		auto& view = m_views[m_current_render_views[0]];
+		if (!setMeshBuffers(model, mesh)) return;
 
-		executeCommandBuffer(material->getCommandBuffer(), material);
-		executeCommandBuffer(view.command_buffer.buffer, material);
+		uint64 state = view.render_state | material->getRenderStates();
+		auto program = setMaterial(view, material, state);
 
-		bgfx::setVertexBuffer(model.getVerticesHandle(),
-							  mesh.attribute_array_offset / stride,
-							  mesh.attribute_array_size / stride);
-		bgfx::setIndexBuffer(model.getIndicesHandle(),
-							 mesh.indices_offset,
-							 mesh.indices_count);
 		bgfx::setStencil(view.stencil, BGFX_STENCIL_NONE);
-		bgfx::setState(view.render_state | material->getRenderStates());
+		bgfx::setState(state);
 		bgfx::setInstanceDataBuffer(data.buffer, data.instance_count);
-		ShaderInstance& shader_instance = mesh.material->getShaderInstance();
 		++m_stats.m_draw_call_count;
 		m_stats.m_instance_count += data.instance_count;
 		m_stats.m_triangle_count += data.instance_count * mesh.indices_count / 3;
-		bgfx::submit(view.bgfx_id, shader_instance.m_program_handles[view.pass_idx]);
+		bgfx::submit(view.bgfx_id, program);
+	}
+
+
+	void finishInstances(int idx)
+	{
+		InstanceData& data = m_instances_data[idx];
+		if (!data.buffer) return;
 
+		submitInstances(data);
 		data.buffer = nullptr;
 		data.instance_count = 0;
-		mesh.instance_idx = -1;
+		data.mesh->instance_idx = -1;
 	}
 
 
@@ -807,9 +1031,24 @@ struct PipelineImpl : public Pipeline
 		Matrix mtx = universe.getMatrix(m_scene->getCameraEntity(cmp));
 		mtx.fastInverse();
 		bgfx::setViewTransform(m_bgfx_view, &mtx.m11, &projection_matrix.m11);
+		m_camera_view_projection = projection_matrix * mtx;
 
+		// distance scale keeping projected size equal to the reference view, bias > 1 means coarser
+		float lod_distance_scale = m_lod_bias * tanf(Math::degreesToRadians(fov) * 0.5f) /
+								   tanf(Math::degreesToRadians(LOD_REFERENCE_FOV) * 0.5f) *
+								   LOD_REFERENCE_HEIGHT / m_height;
+		m_scene->setLODReference(
+			universe.getPosition(m_scene->getCameraEntity(cmp)), lod_distance_scale);
+
+		int width = m_width;
+		int height = m_height;
+		if (isScaledFramebuffer(m_current_framebuffer))
+		{
+			width = int(m_width * m_resolution_scale);
+			height = int(m_height * m_resolution_scale);
+		}
 		bgfx::setViewRect(
-			m_bgfx_view, (uint16_t)m_view_x, (uint16_t)m_view_y, (uint16)m_width, (uint16)m_height);
+			m_bgfx_view, (uint16_t)m_view_x, (uint16_t)m_view_y, (uint16)width, (uint16)height);
 	}
 
 	
@@ -872,6 +1111,7 @@ struct PipelineImpl : public Pipeline
 		m_current_framebuffer = getFramebuffer(framebuffer_name);
 		if (m_current_framebuffer)
 		{
+			useFramebuffer(m_current_framebuffer);
 			bgfx::setViewFrameBuffer(m_bgfx_view,
 									 m_current_framebuffer->getHandle());
 		}
@@ -923,9 +1163,11 @@ struct PipelineImpl : public Pipeline
 		view.stencil = m_stencil;
 		view.pass_idx = m_pass_idx;
 		view.command_buffer.clear();
+		view.material = nullptr;
 		m_global_textures_count = 0;
 		if (m_current_framebuffer)
 		{
+			useFramebuffer(m_current_framebuffer);
 			bgfx::setViewFrameBuffer(m_bgfx_view, m_current_framebuffer->getHandle());
 		}
 		else
@@ -945,6 +1187,8 @@ struct PipelineImpl : public Pipeline
 		auto* src_fb = getFramebuffer(src_fb_name);
 		auto* dest_fb = getFramebuffer(dest_fb_name);
 		if (!src_fb || !dest_fb) return;
+		useFramebuffer(src_fb);
+		useFramebuffer(dest_fb);
 
 		auto src_rb = src_fb->getRenderbufferHandle(src_rb_idx);
 		auto dest_rb = dest_fb->getRenderbufferHandle(dest_rb_idx);
@@ -953,6 +1197,177 @@ struct PipelineImpl : public Pipeline
 	}
 
 
+	void useFramebuffer(FrameBuffer* framebuffer, int from_view, int to_view)
+	{
+		if (!framebuffer->isTransient()) return;
+
+		for (auto& transient : m_transient_framebuffers)
+		{
+			if (transient.framebuffer != framebuffer) continue;
+
+			if (transient.first_view < 0 || from_view < transient.first_view)
+			{
+				transient.first_view = from_view;
+			}
+			transient.last_view = Math::maxValue(transient.last_view, to_view);
+			return;
+		}
+	}
+
+
+	void useFramebuffer(FrameBuffer* framebuffer)
+	{
+		int view = Math::maxValue(m_view_idx, 0);
+		useFramebuffer(framebuffer, view, view);
+	}
+
+
+	// shadowmaps are read by all views rendered after them, cached ones in the next frames too
+	void keepFramebuffer(FrameBuffer* framebuffer)
+	{
+		int from_view = m_is_shadowmap_caching_enabled ? 0 : Math::maxValue(m_view_idx, 0);
+		useFramebuffer(framebuffer, from_view, lengthOf(m_views));
+	}
+
+
+	static int compareTransientFramebuffers(const void* a, const void* b)
+	{
+		auto* transient_a = static_cast<const TransientFramebuffer*>(a);
+		auto* transient_b = static_cast<const TransientFramebuffer*>(b);
+		return transient_a->assigned_first_view - transient_b->assigned_first_view;
+	}
+
+
+	// transient framebuffers used by views which do not overlap render to the same textures; the
+	// views are known only after the frame, so a change in their order is applied in the next one
+	void assignTransientFramebuffers()
+	{
+		bool is_changed = false;
+		for (auto& transient : m_transient_framebuffers)
+		{
+			if (transient.first_view < 0) continue;
+			if (transient.first_view == transient.assigned_first_view &&
+				transient.last_view == transient.assigned_last_view)
+			{
+				continue;
+			}
+			transient.assigned_first_view = transient.first_view;
+			transient.assigned_last_view = transient.last_view;
+			is_changed = true;
+		}
+		if (!is_changed) return;
+
+		qsort(&m_transient_framebuffers[0],
+			m_transient_framebuffers.size(),
+			sizeof(m_transient_framebuffers[0]),
+			compareTransientFramebuffers);
+
+		Array<FrameBuffer*> old_pool(m_allocator);
+		old_pool.swap(m_framebuffer_pool);
+		Array<int> pool_last_views(m_allocator);
+		Array<int> pool_indices(m_allocator);
+		pool_indices.resize(m_transient_framebuffers.size());
+		for (int i = 0; i < m_transient_framebuffers.size(); ++i)
+		{
+			const auto& transient = m_transient_framebuffers[i];
+			pool_indices[i] = -1;
+			// never used ones keep their own textures
+			if (transient.assigned_first_view < 0) continue;
+
+			for (int j = 0; j < m_framebuffer_pool.size(); ++j)
+			{
+				if (pool_last_views[j] < transient.assigned_first_view &&
+					m_framebuffer_pool[j]->canAlias(*transient.framebuffer))
+				{
+					pool_indices[i] = j;
+					break;
+				}
+			}
+			if (pool_indices[i] < 0)
+			{
+				FrameBuffer::Declaration decl = transient.framebuffer->getDeclaration();
+				decl.m_is_transient = false;
+				pool_indices[i] = m_framebuffer_pool.size();
+				m_framebuffer_pool.push(LUMIX_NEW(m_allocator, FrameBuffer)(decl));
+				pool_last_views.push(-1);
+			}
+			pool_last_views[pool_indices[i]] = transient.assigned_last_view;
+		}
+
+		for (int i = 0; i < m_transient_framebuffers.size(); ++i)
+		{
+			int pool_idx = pool_indices[i];
+			m_transient_framebuffers[i].framebuffer->setAlias(
+				pool_idx < 0 ? nullptr : m_framebuffer_pool[pool_idx]);
+		}
+		// bgfx destroys the textures after the frame, views submitted in it still can use them
+		for (auto* framebuffer : old_pool) LUMIX_DELETE(m_allocator, framebuffer);
+	}
+
+
+	void destroyFramebufferPool()
+	{
+		for (auto* framebuffer : m_framebuffer_pool) LUMIX_DELETE(m_allocator, framebuffer);
+		m_framebuffer_pool.clear();
+	}
+
+
+	// transient framebuffers get their own textures and are assigned again in the next frame
+	void releaseFramebufferPool()
+	{
+		for (auto& transient : m_transient_framebuffers)
+		{
+			transient.framebuffer->setAlias(nullptr);
+			transient.assigned_first_view = transient.assigned_last_view = -1;
+		}
+		destroyFramebufferPool();
+	}
+
+
+	void createLightGridTextures()
+	{
+		const uint32 flags = BGFX_TEXTURE_MIN_POINT | BGFX_TEXTURE_MAG_POINT | BGFX_TEXTURE_MIP_POINT |
+							 BGFX_TEXTURE_U_CLAMP | BGFX_TEXTURE_V_CLAMP;
+		m_light_grid_clusters_texture = bgfx::createTexture2D(LightGrid::TILES_X * LightGrid::TILES_Y,
+			LightGrid::DEPTH_SLICES,
+			1,
+			bgfx::TextureFormat::RG32F,
+			flags);
+		m_light_grid_indices_texture = bgfx::createTexture2D(LIGHT_GRID_INDICES_WIDTH,
+			LightGrid::MAX_LIGHT_INDICES / LIGHT_GRID_INDICES_WIDTH,
+			1,
+			bgfx::TextureFormat::R32F,
+			flags);
+		m_light_grid_lights_texture = bgfx::createTexture2D(
+			LightGrid::MAX_LIGHTS, LIGHT_GRID_LIGHT_TEXELS, 1, bgfx::TextureFormat::RGBA32F, flags);
+	}
+
+
+	void createBoneTexture()
+	{
+		const uint32 flags = BGFX_TEXTURE_MIN_POINT | BGFX_TEXTURE_MAG_POINT | BGFX_TEXTURE_MIP_POINT |
+							 BGFX_TEXTURE_U_CLAMP | BGFX_TEXTURE_V_CLAMP;
+		m_bone_texture = bgfx::createTexture2D(
+			BONE_TEXTURE_WIDTH, BONE_TEXTURE_HEIGHT, 1, bgfx::TextureFormat::RGBA32F, flags);
+		m_bone_texture_data =
+			(Matrix*)m_allocator.allocate(sizeof(Matrix) * BONE_TEXTURE_CAPACITY);
+	}
+
+
+	// bgfx applies texture updates before it renders the frame, so draws submitted earlier in
+	// the frame see the matrices
+	void uploadBoneTexture()
+	{
+		if (m_bone_texture_used == 0) return;
+
+		int rows = (m_bone_texture_used + BONE_TEXTURE_MATRICES_PER_ROW - 1) /
+				   BONE_TEXTURE_MATRICES_PER_ROW;
+		const bgfx::Memory* mem =
+			bgfx::copy(m_bone_texture_data, rows * BONE_TEXTURE_MATRICES_PER_ROW * sizeof(Matrix));
+		bgfx::updateTexture2D(m_bone_texture, 0, 0, 0, BONE_TEXTURE_WIDTH, (uint16)rows, mem);
+	}
+
+
 	void createCubeBuffers()
 	{
 		const Vec3 cube_vertices[] = {
@@ -1125,6 +1540,7 @@ struct PipelineImpl : public Pipeline
 
 		PointLightShadowmap& s = m_point_light_shadowmaps.emplace();
 		s.m_framebuffer = m_current_framebuffer;
+		keepFramebuffer(m_current_framebuffer);
 		s.m_light = light;
 		static const Matrix biasMatrix(
 			0.5,  0.0, 0.0, 0.0,
@@ -1164,6 +1580,7 @@ struct PipelineImpl : public Pipeline
 
 		PointLightShadowmap& shadowmap_info = m_point_light_shadowmaps.emplace();
 		shadowmap_info.m_framebuffer = m_current_framebuffer;
+		keepFramebuffer(m_current_framebuffer);
 		shadowmap_info.m_light = light;
 		//setPointLightUniforms(light);
 
@@ -1214,6 +1631,64 @@ struct PipelineImpl : public Pipeline
 	}
 
 
+	void invalidateShadowmapCache()
+	{
+		m_cached_shadowmaps.clear();
+		invalidateCascadesCache();
+	}
+
+
+	void invalidateCascadesCache()
+	{
+		m_cached_cascades.framebuffer = nullptr;
+		m_cached_cascades.light = INVALID_COMPONENT;
+		m_cached_cascades.next_update = 0;
+		for (bool& is_valid : m_cached_cascades.is_valid)
+		{
+			is_valid = false;
+		}
+	}
+
+
+	// framebuffer's content is kept from the last frame it was rendered in,
+	// it's reused if nothing changed in the light's range since then
+	bool useCachedShadowmap(ComponentIndex light, uint32 version)
+	{
+		if (!m_is_shadowmap_caching_enabled) return false;
+
+		for (const CachedShadowmap& cached : m_cached_shadowmaps)
+		{
+			if (cached.shadowmap.m_framebuffer != m_current_framebuffer) continue;
+			if (cached.shadowmap.m_light != light || cached.version != version) return false;
+
+			m_point_light_shadowmaps.push(cached.shadowmap);
+			keepFramebuffer(m_current_framebuffer);
+			return true;
+		}
+		return false;
+	}
+
+
+	void cacheLastShadowmap(uint32 version)
+	{
+		if (!m_is_shadowmap_caching_enabled) return;
+
+		const auto& shadowmap = m_point_light_shadowmaps.back();
+		for (CachedShadowmap& cached : m_cached_shadowmaps)
+		{
+			if (cached.shadowmap.m_framebuffer == shadowmap.m_framebuffer)
+			{
+				cached.shadowmap = shadowmap;
+				cached.version = version;
+				return;
+			}
+		}
+		CachedShadowmap& cached = m_cached_shadowmaps.emplace();
+		cached.shadowmap = shadowmap;
+		cached.version = version;
+	}
+
+
 	void renderLocalLightShadowmaps(ComponentIndex camera,
 		FrameBuffer** fbs,
 		int framebuffers_count)
@@ -1236,6 +1711,13 @@ struct PipelineImpl : public Pipeline
 			float fov = m_scene->getLightFOV(lights[i]);
 
 			m_current_framebuffer = fbs[i];
+			uint32 version = m_scene->getPointLightShadowVersion(lights[i]);
+			if (useCachedShadowmap(lights[i], version))
+			{
+				++fb_index;
+				continue;
+			}
+
 			if (fov < 180)
 			{
 				renderSpotLightShadowmap(lights[i]);
@@ -1244,6 +1726,7 @@ struct PipelineImpl : public Pipeline
 			{
 				renderOmniLightShadowmap(lights[i]);
 			}
+			cacheLastShadowmap(version);
 			++fb_index;
 		}
 	}
@@ -1265,33 +1748,67 @@ struct PipelineImpl : public Pipeline
 	}
 
 
-	void renderShadowmap(int split_index)
+	void getShadowSplitDistances(ComponentIndex light_cmp, float* split_distances)
 	{
-		Universe& universe = m_scene->getUniverse();
-		ComponentIndex light_cmp = m_scene->getActiveGlobalLight();
-		if (light_cmp < 0 || m_applied_camera < 0) return;
-		float camera_height = m_scene->getCameraHeight(m_applied_camera);
-		if (!camera_height) return;
+		Vec4 cascades = m_scene->getShadowmapCascades(light_cmp);
+		split_distances[0] = 0.01f;
+		split_distances[1] = cascades.x;
+		split_distances[2] = cascades.y;
+		split_distances[3] = cascades.z;
+		split_distances[4] = cascades.w;
+	}
+
+
+	// the square around center is shrunk in power of two steps while it covers the receivers, and
+	// its center is snapped to texels, so the shadow does not shimmer while the size is kept;
+	// returns false if no receiver is in the square
+	static bool fitShadowCamera(const AABB& receivers,
+		float viewport_size,
+		Vec3& center,
+		float& half_size,
+		float& far_depth)
+	{
+		float min_x = Math::maxValue(receivers.getMin().x, center.x - half_size);
+		float max_x = Math::minValue(receivers.getMax().x, center.x + half_size);
+		float min_y = Math::maxValue(receivers.getMin().y, center.y - half_size);
+		float max_y = Math::minValue(receivers.getMax().y, center.y + half_size);
+		if (min_x > max_x || min_y > max_y) return false;
+
+		float extent = Math::maxValue(max_x - min_x, max_y - min_y) * 0.5f;
+		for (int i = 0; i < SHADOW_MAX_FIT_STEPS; ++i)
+		{
+			float smaller = half_size * 0.5f;
+			float texel = 2 * smaller / viewport_size;
+			if (smaller < extent + texel) break;
+			half_size = smaller;
+		}
+
+		float texel = 2 * half_size / viewport_size;
+		center.x = (min_x + max_x) * 0.5f;
+		center.y = (min_y + max_y) * 0.5f;
+		center.x -= fmodf(center.x, texel);
+		center.y -= fmodf(center.y, texel);
+		// casters behind the farthest receiver can not cast a shadow on it
+		far_depth = receivers.getMax().z + texel;
+		return true;
+	}
+
 
+	// returns false if the cascade has no visible receivers, there is nothing to render then
+	bool computeShadowCamera(int split_index,
+		ComponentIndex light_cmp,
+		float shadowmap_width,
+		Matrix& view_matrix,
+		Matrix& projection_matrix,
+		Frustum& shadow_camera_frustum)
+	{
+		Universe& universe = m_scene->getUniverse();
 		Matrix light_mtx = universe.getMatrix(m_scene->getGlobalLightEntity(light_cmp));
-		m_global_light_shadowmap = m_current_framebuffer;
-		float shadowmap_height = (float)m_current_framebuffer->getHeight();
-		float shadowmap_width = (float)m_current_framebuffer->getWidth();
-		float viewports[] = { 0, 0, 0.5f, 0, 0, 0.5f, 0.5f, 0.5f };
 		float camera_fov = Math::degreesToRadians(m_scene->getCameraFOV(m_applied_camera));
-		float camera_ratio = m_scene->getCameraWidth(m_applied_camera) / camera_height;
-		Vec4 cascades = m_scene->getShadowmapCascades(light_cmp);
-		float split_distances[] = { 0.01f, cascades.x, cascades.y, cascades.z, cascades.w };
-		m_is_rendering_in_shadowmap = true;
-		bgfx::setViewClear(
-			m_bgfx_view, BGFX_CLEAR_DEPTH | BGFX_CLEAR_COLOR, 0xffffffff, 1.0f, 0);
-		bgfx::touch(m_bgfx_view);
-		float* viewport = viewports + split_index * 2;
-		bgfx::setViewRect(m_bgfx_view,
-			(uint16)(1 + shadowmap_width * viewport[0]),
-			(uint16)(1 + shadowmap_height * viewport[1]),
-			(uint16)(0.5f * shadowmap_width - 2),
-			(uint16)(0.5f * shadowmap_height - 2));
+		float camera_ratio =
+			m_scene->getCameraWidth(m_applied_camera) / m_scene->getCameraHeight(m_applied_camera);
+		float split_distances[SHADOW_CASCADES_COUNT + 1];
+		getShadowSplitDistances(light_cmp, split_distances);
 
 		Frustum frustum;
 		Matrix camera_matrix = universe.getMatrix(m_scene->getCameraEntity(m_applied_camera));
@@ -1308,127 +1825,225 @@ struct PipelineImpl : public Pipeline
 		shadow_cam_pos =
 			shadowmapTexelAlign(shadow_cam_pos, 0.5f * shadowmap_width - 2, bb_size, light_mtx);
 
-		Matrix projection_matrix;
+		Matrix inv_light_mtx = light_mtx;
+		inv_light_mtx.fastInverse();
+		Vec3 center = inv_light_mtx.multiplyPosition(shadow_cam_pos);
+		float half_size = bb_size;
+		float far_depth = center.z + SHADOW_CAM_FAR * 0.5f;
+		AABB receivers = m_shadow_receivers[split_index];
+		// cached cascades are used in the next frames too, when more receivers can be visible
+		if (m_is_shadowmap_caching_enabled && split_index >= SHADOW_FIRST_CACHED_CASCADE)
+		{
+			Vec3 margin(bb_size * 0.25f, bb_size * 0.25f, bb_size * 0.25f);
+			receivers.set(receivers.getMin() - margin, receivers.getMax() + margin);
+		}
+		bool has_receivers = fitShadowCamera(
+			receivers, 0.5f * shadowmap_width - 2, center, half_size, far_depth);
+		if (!has_receivers)
+		{
+			center = inv_light_mtx.multiplyPosition(shadow_cam_pos);
+			half_size = bb_size;
+			far_depth = center.z + SHADOW_CAM_FAR * 0.5f;
+		}
+
 		projection_matrix.setOrtho(
-			bb_size, -bb_size, -bb_size, bb_size, SHADOW_CAM_NEAR, SHADOW_CAM_FAR);
+			half_size, -half_size, -half_size, half_size, SHADOW_CAM_NEAR, SHADOW_CAM_FAR);
 		Vec3 light_forward = light_mtx.getZVector();
-		shadow_cam_pos -= light_forward * SHADOW_CAM_FAR * 0.5f;
-		Matrix view_matrix;
+		shadow_cam_pos =
+			light_mtx.multiplyPosition(Vec3(center.x, center.y, far_depth - SHADOW_CAM_FAR));
 		view_matrix.lookAt(
 			shadow_cam_pos, shadow_cam_pos + light_forward, light_mtx.getYVector());
-		bgfx::setViewTransform(m_bgfx_view, &view_matrix.m11, &projection_matrix.m11);
-		static const Matrix biasMatrix(
-			0.5, 0.0, 0.0, 0.0, 0.0, -0.5, 0.0, 0.0, 0.0, 0.0, 0.5, 0.0, 0.5, 0.5, 0.5, 1.0);
-		m_shadow_viewprojection[split_index] = biasMatrix * (projection_matrix * view_matrix);
 
-		Frustum shadow_camera_frustum;
 		shadow_camera_frustum.computeOrtho(shadow_cam_pos,
 			-light_forward,
 			light_mtx.getYVector(),
-			bb_size * 2,
-			bb_size * 2,
+			half_size * 2,
+			half_size * 2,
 			SHADOW_CAM_NEAR,
 			SHADOW_CAM_FAR);
-		m_current_render_views = &m_view_idx;
-		m_current_render_view_count = 1;
-		renderAll(shadow_camera_frustum, false);
-		m_is_rendering_in_shadowmap = false;
+		return has_receivers;
 	}
 
 
-	void renderDebugShapes()
+	// all cascades are culled in one pass when the first cascade is rendered, they are fitted to
+	// the receivers visible by the camera, so the camera is culled first; casters are culled by
+	// the receivers' bounds extruded towards the light
+	void cullShadowCascades(ComponentIndex light_cmp, float shadowmap_width)
 	{
-		renderDebugLines();
-		renderDebugPoints();
-	}
+		m_scene->cullFrustums(&m_camera_frustum, 1);
 
+		Matrix light_space =
+			m_scene->getUniverse().getMatrix(m_scene->getGlobalLightEntity(light_cmp));
+		light_space.fastInverse();
+		float split_distances[SHADOW_CASCADES_COUNT + 1];
+		getShadowSplitDistances(light_cmp, split_distances);
+		m_scene->getShadowReceiversBounds(m_camera_frustum,
+			light_space,
+			split_distances,
+			SHADOW_CASCADES_COUNT,
+			m_shadow_receivers);
 
-	void renderDebugPoints()
-	{
-		const Array<DebugPoint>& points = m_scene->getDebugPoints();
-		if (points.empty() || !m_debug_line_material->isReady())
+		Frustum frustums[SHADOW_CASCADES_COUNT];
+		int count = 0;
+		for (int i = 0; i < SHADOW_CASCADES_COUNT; ++i)
 		{
-			return;
-		}
-		bgfx::TransientVertexBuffer tvb;
-		bgfx::TransientIndexBuffer tib;
-		if (bgfx::allocTransientBuffers(
-				&tvb, m_base_vertex_decl, points.size(), &tib, points.size()))
-		{
-			BaseVertex* vertex = (BaseVertex*)tvb.data;
-			uint16* indices = (uint16*)tib.data;
-			for (int i = 0; i < points.size(); ++i)
+			Matrix view_matrix;
+			Matrix projection_matrix;
+			if (computeShadowCamera(
+					i, light_cmp, shadowmap_width, view_matrix, projection_matrix, frustums[count]))
 			{
-				const DebugPoint& point = points[i];
-				vertex[0].rgba = point.m_color;
-				vertex[0].x = point.m_pos.x;
-				vertex[0].y = point.m_pos.y;
-				vertex[0].z = point.m_pos.z;
-				vertex[0].u = vertex[0].v = 0;
-
-				indices[0] = i;
-				++vertex;
-				++indices;
+				++count;
 			}
-
-			bgfx::setVertexBuffer(&tvb);
-			bgfx::setIndexBuffer(&tib);
-			bgfx::setStencil(m_stencil, BGFX_STENCIL_NONE);
-			bgfx::setState(
-				m_render_state | m_debug_line_material->getRenderStates() | BGFX_STATE_PT_POINTS);
-			bgfx::submit(m_bgfx_view,
-				m_debug_line_material->getShaderInstance().m_program_handles[m_pass_idx]);
 		}
+		m_scene->cullFrustums(frustums, count);
 	}
 
 
-	void renderDebugLines()
+	// far cascades cover large areas with low resolution, they are updated round-robin and the rest
+	// are kept from previous frames together with their matrices; all of them are rendered again
+	// when the light or the shadowmap changes
+	bool isCascadeCached(int split_index, ComponentIndex light_cmp)
 	{
-		const Array<DebugLine>& lines = m_scene->getDebugLines();
-		if (lines.empty() || !m_debug_line_material->isReady()) return;
-
-		bgfx::TransientVertexBuffer tvb;
-		bgfx::TransientIndexBuffer tib;
-
-		static const int BATCH_SIZE = 1024 * 16;
-
-		for (int j = 0; j < lines.size(); j += BATCH_SIZE)
+		CachedCascades& cache = m_cached_cascades;
+		if (split_index == 0)
 		{
-			int count = Math::minValue(BATCH_SIZE, lines.size() - j);
-			if (bgfx::allocTransientBuffers(&tvb, m_base_vertex_decl, count * 2, &tib, count * 2))
+			Vec3 light_direction =
+				m_scene->getUniverse().getRotation(m_scene->getGlobalLightEntity(light_cmp)) * Vec3(0, 0, 1);
+			Vec4 splits = m_scene->getShadowmapCascades(light_cmp);
+			if (!m_is_shadowmap_caching_enabled || cache.framebuffer != m_current_framebuffer ||
+				cache.light != light_cmp || light_direction.x != cache.light_direction.x ||
+				light_direction.y != cache.light_direction.y || light_direction.z != cache.light_direction.z ||
+				splits.x != cache.splits.x || splits.y != cache.splits.y || splits.z != cache.splits.z ||
+				splits.w != cache.splits.w)
 			{
-				BaseVertex* vertex = (BaseVertex*)tvb.data;
-				uint16* indices = (uint16*)tib.data;
-				for (int i = 0; i < count; ++i)
-				{
-					const DebugLine& line = lines[j + i];
-					vertex[0].rgba = line.m_color;
-					vertex[0].x = line.m_from.x;
-					vertex[0].y = line.m_from.y;
-					vertex[0].z = line.m_from.z;
-					vertex[0].u = vertex[0].v = 0;
-
-					vertex[1].rgba = line.m_color;
-					vertex[1].x = line.m_to.x;
-					vertex[1].y = line.m_to.y;
-					vertex[1].z = line.m_to.z;
-					vertex[1].u = vertex[0].v = 0;
-
-					indices[0] = i * 2;
-					indices[1] = i * 2 + 1;
-					vertex += 2;
-					indices += 2;
-				}
-
-				bgfx::setVertexBuffer(&tvb);
-				bgfx::setIndexBuffer(&tib);
-				bgfx::setStencil(m_stencil, BGFX_STENCIL_NONE);
-				bgfx::setState(m_render_state | m_debug_line_material->getRenderStates() |
-							   BGFX_STATE_PT_LINES);
-				bgfx::submit(m_bgfx_view,
-					m_debug_line_material->getShaderInstance().m_program_handles[m_pass_idx]);
+				invalidateCascadesCache();
+				cache.framebuffer = m_current_framebuffer;
+				cache.light = light_cmp;
+				cache.light_direction = light_direction;
+				cache.splits = splits;
 			}
+			cache.next_update = (cache.next_update + 1) % (SHADOW_CASCADES_COUNT - SHADOW_FIRST_CACHED_CASCADE);
+		}
+
+		bool is_cached = m_is_shadowmap_caching_enabled && split_index >= SHADOW_FIRST_CACHED_CASCADE &&
+						 cache.is_valid[split_index] &&
+						 split_index - SHADOW_FIRST_CACHED_CASCADE != cache.next_update;
+		if (!is_cached) cache.is_valid[split_index] = m_is_shadowmap_caching_enabled;
+		return is_cached;
+	}
+
+
+	void renderShadowmap(int split_index)
+	{
+		ComponentIndex light_cmp = m_scene->getActiveGlobalLight();
+		if (light_cmp < 0 || m_applied_camera < 0) return;
+		float camera_height = m_scene->getCameraHeight(m_applied_camera);
+		if (!camera_height) return;
+
+		m_global_light_shadowmap = m_current_framebuffer;
+		keepFramebuffer(m_current_framebuffer);
+		if (isCascadeCached(split_index, light_cmp)) return;
+
+		float shadowmap_height = (float)m_current_framebuffer->getHeight();
+		float shadowmap_width = (float)m_current_framebuffer->getWidth();
+		float viewports[] = { 0, 0, 0.5f, 0, 0, 0.5f, 0.5f, 0.5f };
+		m_is_rendering_in_shadowmap = true;
+		bgfx::setViewClear(
+			m_bgfx_view, BGFX_CLEAR_DEPTH | BGFX_CLEAR_COLOR, 0xffffffff, 1.0f, 0);
+		bgfx::touch(m_bgfx_view);
+		float* viewport = viewports + split_index * 2;
+		bgfx::setViewRect(m_bgfx_view,
+			(uint16)(1 + shadowmap_width * viewport[0]),
+			(uint16)(1 + shadowmap_height * viewport[1]),
+			(uint16)(0.5f * shadowmap_width - 2),
+			(uint16)(0.5f * shadowmap_height - 2));
+
+		if (split_index == 0) cullShadowCascades(light_cmp, shadowmap_width);
+
+		Matrix view_matrix;
+		Matrix projection_matrix;
+		Frustum shadow_camera_frustum;
+		bool has_receivers = computeShadowCamera(
+			split_index, light_cmp, shadowmap_width, view_matrix, projection_matrix, shadow_camera_frustum);
+		bgfx::setViewTransform(m_bgfx_view, &view_matrix.m11, &projection_matrix.m11);
+		static const Matrix biasMatrix(
+			0.5, 0.0, 0.0, 0.0, 0.0, -0.5, 0.0, 0.0, 0.0, 0.0, 0.5, 0.0, 0.5, 0.5, 0.5, 1.0);
+		m_shadow_viewprojection[split_index] = biasMatrix * (projection_matrix * view_matrix);
+
+		m_current_render_views = &m_view_idx;
+		m_current_render_view_count = 1;
+		if (has_receivers) renderAll(shadow_camera_frustum, false);
+		m_is_rendering_in_shadowmap = false;
+	}
+
+
+	void renderDebugShapes()
+	{
+		renderDebugLines();
+		renderDebugPoints();
+	}
+
+
+	void renderDebugPoints()
+	{
+		const Array<DebugPoint>& points = m_scene->getDebugPoints();
+		if (points.empty() || !m_debug_line_material->isReady())
+		{
+			return;
 		}
+		TransientGeometry geom(points.size(), m_base_vertex_decl, 0);
+		BaseVertex* vertex = (BaseVertex*)geom.getVertexData();
+		for (int i = 0; i < points.size(); ++i)
+		{
+			const DebugPoint& point = points[i];
+			vertex[0].rgba = point.m_color;
+			vertex[0].x = point.m_pos.x;
+			vertex[0].y = point.m_pos.y;
+			vertex[0].z = point.m_pos.z;
+			vertex[0].u = vertex[0].v = 0;
+			++vertex;
+		}
+
+		geom.setBuffers(0, 0);
+		bgfx::setStencil(m_stencil, BGFX_STENCIL_NONE);
+		bgfx::setState(
+			m_render_state | m_debug_line_material->getRenderStates() | BGFX_STATE_PT_POINTS);
+		bgfx::submit(m_bgfx_view,
+			m_debug_line_material->getShaderInstance().m_program_handles[m_pass_idx]);
+	}
+
+
+	void renderDebugLines()
+	{
+		const Array<DebugLine>& lines = m_scene->getDebugLines();
+		if (lines.empty() || !m_debug_line_material->isReady()) return;
+
+		// lines are drawn without an index buffer, the vertices are already in drawing order
+		TransientGeometry geom(lines.size() * 2, m_base_vertex_decl, 0);
+		BaseVertex* vertex = (BaseVertex*)geom.getVertexData();
+		for (int i = 0; i < lines.size(); ++i)
+		{
+			const DebugLine& line = lines[i];
+			vertex[0].rgba = line.m_color;
+			vertex[0].x = line.m_from.x;
+			vertex[0].y = line.m_from.y;
+			vertex[0].z = line.m_from.z;
+			vertex[0].u = vertex[0].v = 0;
+
+			vertex[1].rgba = line.m_color;
+			vertex[1].x = line.m_to.x;
+			vertex[1].y = line.m_to.y;
+			vertex[1].z = line.m_to.z;
+			vertex[1].u = vertex[1].v = 0;
+			vertex += 2;
+		}
+
+		geom.setBuffers(0, 0);
+		bgfx::setStencil(m_stencil, BGFX_STENCIL_NONE);
+		bgfx::setState(
+			m_render_state | m_debug_line_material->getRenderStates() | BGFX_STATE_PT_LINES);
+		bgfx::submit(m_bgfx_view,
+			m_debug_line_material->getShaderInstance().m_program_handles[m_pass_idx]);
 	}
 
 
@@ -1512,6 +2127,118 @@ struct PipelineImpl : public Pipeline
 	}
 
 
+	// builds the light grid for the applied camera and binds it to the current view,
+	// shaders look up lights by cluster instead of rendering geometry once per light
+	void setClusteredLightsUniforms()
+	{
+		PROFILE_FUNCTION();
+		if (m_applied_camera == INVALID_COMPONENT) return;
+
+		m_tmp_local_lights.clear();
+		m_scene->getPointLights(m_camera_frustum, m_tmp_local_lights);
+		int light_count = Math::minValue(m_tmp_local_lights.size(), LightGrid::MAX_LIGHTS);
+		PROFILE_INT("light count", light_count);
+
+		Universe& universe = m_scene->getUniverse();
+		m_light_grid_lights.resize(light_count);
+		const bgfx::Memory* lights_mem =
+			bgfx::alloc(LightGrid::MAX_LIGHTS * LIGHT_GRID_LIGHT_TEXELS * sizeof(Vec4));
+		Vec4* lights_data = (Vec4*)lights_mem->data;
+		setMemory(lights_data, 0, lights_mem->size);
+		for (int i = 0; i < light_count; ++i)
+		{
+			ComponentIndex light_cmp = m_tmp_local_lights[i];
+			Entity entity = m_scene->getPointLightEntity(light_cmp);
+			Vec3 pos = universe.getPosition(entity);
+			float range = m_scene->getLightRange(light_cmp);
+			Vec3 light_dir = universe.getRotation(entity) * Vec3(0, 0, -1);
+			float fov = Math::degreesToRadians(m_scene->getLightFOV(light_cmp));
+			float intensity = m_scene->getPointLightIntensity(light_cmp);
+			intensity *= intensity;
+			Vec3 color = m_scene->getPointLightColor(light_cmp) * intensity;
+			float specular_intensity = m_scene->getPointLightSpecularIntensity(light_cmp);
+			Vec3 specular = m_scene->getPointLightSpecularColor(light_cmp) * specular_intensity *
+							specular_intensity;
+
+			m_light_grid_lights[i].position = pos;
+			m_light_grid_lights[i].radius = range;
+			lights_data[i].set(pos, range);
+			lights_data[LightGrid::MAX_LIGHTS + i].set(color, m_scene->getLightAttenuation(light_cmp));
+			lights_data[LightGrid::MAX_LIGHTS * 2 + i].set(light_dir, fov);
+			lights_data[LightGrid::MAX_LIGHTS * 3 + i].set(specular, 1);
+		}
+
+		Matrix view = universe.getMatrix(m_scene->getCameraEntity(m_applied_camera));
+		view.fastInverse();
+		m_light_grid.build(m_renderer.getEngine().getMTJDManager(),
+			view,
+			m_camera_frustum.getFOV(),
+			m_camera_frustum.getRatio(),
+			m_camera_frustum.getNearDistance(),
+			m_camera_frustum.getFarDistance(),
+			light_count > 0 ? &m_light_grid_lights[0] : nullptr,
+			light_count);
+
+		const bgfx::Memory* clusters_mem = bgfx::alloc(LightGrid::CLUSTER_COUNT * 2 * sizeof(float));
+		float* clusters_data = (float*)clusters_mem->data;
+		for (int i = 0; i < LightGrid::CLUSTER_COUNT; ++i)
+		{
+			const LightGrid::Cluster& cluster = m_light_grid.getCluster(i);
+			clusters_data[i * 2] = cluster.offset;
+			clusters_data[i * 2 + 1] = cluster.count;
+		}
+
+		int indices_count = m_light_grid.getLightIndicesCount();
+		int indices_rows = (indices_count + LIGHT_GRID_INDICES_WIDTH - 1) / LIGHT_GRID_INDICES_WIDTH;
+		if (indices_rows > 0)
+		{
+			const bgfx::Memory* indices_mem =
+				bgfx::alloc(indices_rows * LIGHT_GRID_INDICES_WIDTH * sizeof(float));
+			float* indices_data = (float*)indices_mem->data;
+			const uint16* indices = m_light_grid.getLightIndices();
+			for (int i = 0; i < indices_count; ++i)
+			{
+				indices_data[i] = indices[i];
+			}
+			for (int i = indices_count, c = indices_rows * LIGHT_GRID_INDICES_WIDTH; i < c; ++i)
+			{
+				indices_data[i] = 0;
+			}
+			bgfx::updateTexture2D(m_light_grid_indices_texture,
+				0,
+				0,
+				0,
+				LIGHT_GRID_INDICES_WIDTH,
+				(uint16)indices_rows,
+				indices_mem);
+		}
+		bgfx::updateTexture2D(m_light_grid_clusters_texture,
+			0,
+			0,
+			0,
+			LightGrid::TILES_X * LightGrid::TILES_Y,
+			LightGrid::DEPTH_SLICES,
+			clusters_mem);
+		bgfx::updateTexture2D(
+			m_light_grid_lights_texture, 0, 0, 0, LightGrid::MAX_LIGHTS, LIGHT_GRID_LIGHT_TEXELS, lights_mem);
+
+		auto& command_buffer = m_views[m_view_idx].command_buffer;
+		command_buffer.beginAppend();
+		command_buffer.setUniform(m_light_grid_params_uniform,
+			Vec4(m_light_grid.getNearDistance(), m_light_grid.getSliceScale(), (float)light_count, 0));
+		command_buffer.setTexture(
+			15 - m_global_textures_count, m_light_grid_clusters_uniform, m_light_grid_clusters_texture);
+		++m_global_textures_count;
+		command_buffer.setTexture(
+			15 - m_global_textures_count, m_light_grid_indices_uniform, m_light_grid_indices_texture);
+		++m_global_textures_count;
+		command_buffer.setTexture(
+			15 - m_global_textures_count, m_light_grid_lights_uniform, m_light_grid_lights_texture);
+		++m_global_textures_count;
+		command_buffer.end();
+	}
+
+
 	void setActiveGlobalLightUniforms()
 	{
 		auto current_light = m_scene->getActiveGlobalLight();
@@ -1606,7 +2333,7 @@ struct PipelineImpl : public Pipeline
 	{
 		PROFILE_FUNCTION();
 
-		Array<ComponentIndex> lights(m_allocator);
+		SmallArray<ComponentIndex, 64> lights(m_renderer.getEngine().getFrameAllocator());
 		m_scene->getPointLights(frustum, lights);
 		for (int i = 0; i < lights.size(); ++i)
 		{
@@ -1619,9 +2346,9 @@ struct PipelineImpl : public Pipeline
 			setPointLightUniforms(light);
 			m_scene->getPointLightInfluencedGeometry(light, frustum, m_tmp_meshes);
 
-			m_scene->getTerrainInfos(m_tmp_terrains,
+			m_scene->getTerrainInfos(frustum,
 				m_scene->getUniverse().getPosition(m_scene->getCameraEntity(m_applied_camera)),
-				m_renderer.getFrameAllocator());
+				m_tmp_terrains);
 
 			m_scene->getGrassInfos(frustum, m_tmp_grasses, m_applied_camera);
 			renderMeshes(m_tmp_meshes);
@@ -1705,8 +2432,8 @@ struct PipelineImpl : public Pipeline
 		vertex[5].u = 0;
 		vertex[5].v = 1;
 
-		executeCommandBuffer(material->getCommandBuffer(), material);
-		executeCommandBuffer(m_views[m_view_idx].command_buffer.buffer, material);
+		uint64 state = m_render_state | material->getRenderStates();
+		auto program = setMaterial(m_views[m_view_idx], material, state);
 
 		if (m_applied_camera >= 0)
 		{
@@ -1736,12 +2463,12 @@ struct PipelineImpl : public Pipeline
 		}
 
 		bgfx::setStencil(m_stencil, BGFX_STENCIL_NONE);
-		bgfx::setState(m_render_state | material->getRenderStates());
+		bgfx::setState(state);
 		bgfx::setVertexBuffer(&vb);
 		++m_stats.m_draw_call_count;
 		++m_stats.m_instance_count;
 		m_stats.m_triangle_count += 2;
-		bgfx::submit(m_bgfx_view, material->getShaderInstance().m_program_handles[m_pass_idx]);
+		bgfx::submit(m_bgfx_view, program);
 	}
 
 
@@ -1754,11 +2481,29 @@ struct PipelineImpl : public Pipeline
 		m_tmp_grasses.clear();
 		m_tmp_terrains.clear();
 
-		auto& meshes = m_scene->getRenderableInfos(frustum);
+		// occlusion in the camera's view says nothing about shadow casters
+		Array<Array<RenderableMesh>>* infos;
+		if (m_is_rendering_in_shadowmap)
+		{
+			infos = &m_scene->getRenderableInfos(frustum);
+		}
+		else if (m_is_occlusion_culling_enabled)
+		{
+			infos = &m_scene->getOcclusionCulledRenderableInfos(frustum, m_camera_view_projection);
+		}
+		else if (m_hiz_renderbuffer_idx >= 0)
+		{
+			infos = &m_scene->getHiZCulledRenderableInfos(frustum, m_depth_pyramid);
+		}
+		else
+		{
+			infos = &m_scene->getRenderableInfos(frustum);
+		}
+		auto& meshes = *infos;
+		for (const auto& subinfos : meshes) m_stats.m_visible_mesh_count += subinfos.size();
 		Entity camera_entity = m_scene->getCameraEntity(m_applied_camera);
 		Vec3 camera_pos = m_scene->getUniverse().getPosition(camera_entity);
-		LIFOAllocator& frame_allocator = m_renderer.getFrameAllocator();
-		m_scene->getTerrainInfos(m_tmp_terrains, camera_pos, frame_allocator);
+		m_scene->getTerrainInfos(frustum, camera_pos, m_tmp_terrains);
 
 		m_is_current_light_global = true;
 
@@ -1841,21 +2586,14 @@ struct PipelineImpl : public Pipeline
 		Material* material = mesh.material;
 		auto& shader_instance = mesh.material->getShaderInstance();
 
-		Matrix bone_mtx[128];
-
-		const Pose& pose = *renderable.pose;
-		const Model& model = *renderable.model;
-		Vec3* poss = pose.getPositions();
-		Quat* rots = pose.getRotations();
+		static const int MAX_BONE_COUNT = 128;
 
-		ASSERT(pose.getCount() <= lengthOf(bone_mtx));
-		for (int bone_index = 0, bone_count = pose.getCount(); bone_index < bone_count;
-		++bone_index)
+		Pose& pose = *renderable.pose;
+		ASSERT(pose.getCount() <= MAX_BONE_COUNT);
+		const Matrix* bone_mtx = pose.getSkinningMatrices(*renderable.model);
+		if (material->hasDefine(m_bone_texture_define_idx))
 		{
-			auto& bone = model.getBone(bone_index);
-			rots[bone_index].toMatrix(bone_mtx[bone_index]);
-			bone_mtx[bone_index].translate(poss[bone_index]);
-			bone_mtx[bone_index] = bone_mtx[bone_index] * bone.inv_bind_matrix;
+			material->setDefine(m_bone_texture_define_idx, false);
 		}
 
 		for (int i = 0; i < m_current_render_view_count; ++i)
@@ -1863,25 +2601,22 @@ struct PipelineImpl : public Pipeline
 			auto& view = m_views[m_current_render_views[i]];
 			if (!bgfx::isValid(shader_instance.m_program_handles[view.pass_idx])) continue;
 
+			// layers are consecutive draws with the same key, they keep the bones of the first
+			bgfx::setUniform(m_bone_matrices_uniform, bone_mtx, pose.getCount());
+			uint64 state = view.render_state | material->getRenderStates();
 			for (int j = 0, c = material->getLayerCount(); j < c; ++j)
 			{
+				if (!setMeshBuffers(*renderable.model, mesh)) return;
 				bgfx::setUniform(m_layer_uniform, &Vec4((j + 1) / (float)c, 0, 0, 0));
-				bgfx::setUniform(m_bone_matrices_uniform, bone_mtx, pose.getCount());
-				executeCommandBuffer(material->getCommandBuffer(), material);
-				executeCommandBuffer(view.command_buffer.buffer, material);
+				auto program = setMaterial(view, material, state);
 
 				bgfx::setTransform(&renderable.matrix);
-				bgfx::setVertexBuffer(renderable.model->getVerticesHandle(),
-					mesh.attribute_array_offset / mesh.vertex_def.getStride(),
-					mesh.attribute_array_size / mesh.vertex_def.getStride());
-				bgfx::setIndexBuffer(
-					renderable.model->getIndicesHandle(), mesh.indices_offset, mesh.indices_count);
 				bgfx::setStencil(view.stencil, BGFX_STENCIL_NONE);
-				bgfx::setState(view.render_state | material->getRenderStates());
+				bgfx::setState(state);
 				++m_stats.m_draw_call_count;
 				++m_stats.m_instance_count;
 				m_stats.m_triangle_count += mesh.indices_count / 3;
-				bgfx::submit(view.bgfx_id, shader_instance.m_program_handles[view.pass_idx]);
+				bgfx::submit(view.bgfx_id, program);
 			}
 		}
 	}
@@ -1909,8 +2644,7 @@ struct PipelineImpl : public Pipeline
 		bgfx::setStencil(m_stencil, BGFX_STENCIL_NONE);
 		bgfx::setState(m_render_state | render_states);
 		bgfx::setTransform(&mtx.m11);
-		bgfx::setVertexBuffer(&geom.getVertexBuffer());
-		bgfx::setIndexBuffer(&geom.getIndexBuffer(), first_index, num_indices);
+		geom.setBuffers(first_index, num_indices);
 		++m_stats.m_draw_call_count;
 		++m_stats.m_instance_count;
 		m_stats.m_triangle_count += num_indices / 3;
@@ -1918,6 +2652,170 @@ struct PipelineImpl : public Pipeline
 	}
 
 
+	static bool isSkinned(const Renderable& renderable)
+	{
+		return renderable.pose && renderable.pose->getCount() > 0;
+	}
+
+
+	static const Renderable& getRenderable(const Renderable* renderables,
+		const Renderable* static_batches,
+		ComponentIndex cmp)
+	{
+		if (cmp & STATIC_BATCH_FLAG) return static_batches[cmp & ~STATIC_BATCH_FLAG];
+		return renderables[cmp & ~IMPOSTER_FLAG];
+	}
+
+
+	// imposters are quads of their own models
+	Model* getMeshModel(const Renderable& renderable, const RenderableMesh& mesh) const
+	{
+		if (mesh.renderable & IMPOSTER_FLAG) return m_scene->getImposterModel(mesh.renderable);
+		return renderable.model;
+	}
+
+
+	bool canUseBoneTexture(const Mesh& mesh) const
+	{
+		// layers are drawn one by one with their own uniform, instances can not do it
+		return mesh.material->hasDefine(m_bone_texture_define_idx) &&
+			   mesh.material->getLayerCount() <= 1;
+	}
+
+
+	// the first skinning matrix of the renderable in the bone texture, -1 if the texture is full;
+	// the matrices are copied by fillMeshBatches, once per frame even if drawn in more passes
+	int getPaletteOffset(ComponentIndex renderable, int bone_count)
+	{
+		while (m_palette_slots.size() <= renderable)
+		{
+			m_palette_slots.emplace().frame = m_palette_frame - 1;
+		}
+		PaletteSlot& slot = m_palette_slots[renderable];
+		if (slot.frame == m_palette_frame) return slot.offset;
+		if (m_bone_texture_used + bone_count > BONE_TEXTURE_CAPACITY) return -1;
+
+		slot.frame = m_palette_frame;
+		slot.offset = m_bone_texture_used;
+		m_bone_texture_used += bone_count;
+		m_palette_uploads.push(renderable);
+		return slot.offset;
+	}
+
+
+	// splits sorted meshes to batches, runs of the same rigid mesh become instanced batches, so do
+	// runs of the same skinned mesh if it can use the bone texture; instance buffers are
+	// allocated here, since bgfx allocation must run on this thread
+	void recordMeshBatches()
+	{
+		PROFILE_FUNCTION();
+		m_mesh_batches.clear();
+		Renderable* renderables = m_scene->getRenderables();
+		Renderable* static_batches = m_scene->getStaticBatches();
+		for (int i = 0, c = m_sorted_meshes.size(); i < c;)
+		{
+			const RenderableMesh& mesh = m_sorted_meshes[i];
+			const Renderable& renderable =
+				getRenderable(renderables, static_batches, mesh.renderable);
+			MeshBatch& batch = m_mesh_batches.emplace();
+			batch.first = i;
+			batch.instances.mesh = mesh.mesh;
+			batch.instances.model = getMeshModel(renderable, mesh);
+			batch.is_skinned = isSkinned(renderable);
+			int bone_count = batch.is_skinned ? renderable.pose->getCount() : 0;
+			bool is_uniform_skinned = batch.is_skinned && (!canUseBoneTexture(*mesh.mesh) ||
+										 getPaletteOffset(mesh.renderable, bone_count) < 0);
+			if (is_uniform_skinned)
+			{
+				batch.instances.buffer = nullptr;
+				batch.instances.instance_count = 1;
+				++i;
+				continue;
+			}
+
+			int run_end = i + 1;
+			while (run_end < c && run_end - i < InstanceData::MAX_INSTANCE_COUNT &&
+				   m_sorted_meshes[run_end].mesh == mesh.mesh &&
+				   m_sorted_meshes[run_end].lod_fade == mesh.lod_fade)
+			{
+				ComponentIndex next = m_sorted_meshes[run_end].renderable;
+				if (isSkinned(getRenderable(renderables, static_batches, next)) != batch.is_skinned)
+				{
+					break;
+				}
+				if (batch.is_skinned && getPaletteOffset(next, bone_count) < 0) break;
+				++run_end;
+			}
+			batch.instances.instance_count = run_end - i;
+			batch.instances.buffer = bgfx::allocInstanceDataBuffer(batch.instances.instance_count,
+				batch.is_skinned ? sizeof(SkinnedInstance) : sizeof(Matrix));
+			i = run_end;
+		}
+	}
+
+
+	// gathers instance matrices of all batches and new skinning matrices on workers
+	void fillMeshBatches()
+	{
+		PROFILE_FUNCTION();
+		MTJD::parallelFor(m_renderer.getEngine().getMTJDManager(),
+			0,
+			m_mesh_batches.size(),
+			FILL_BATCHES_GRAIN,
+			[this](int from, int to)
+			{
+				const Renderable* LUMIX_RESTRICT renderables = m_scene->getRenderables();
+				const Renderable* LUMIX_RESTRICT static_batches = m_scene->getStaticBatches();
+				for (int i = from; i < to; ++i)
+				{
+					const MeshBatch& batch = m_mesh_batches[i];
+					if (!batch.instances.buffer) continue;
+
+					const RenderableMesh* meshes = &m_sorted_meshes[batch.first];
+					if (batch.is_skinned)
+					{
+						auto* LUMIX_RESTRICT instances =
+							(SkinnedInstance*)batch.instances.buffer->data;
+						for (int j = 0; j < batch.instances.instance_count; ++j)
+						{
+							ComponentIndex renderable = meshes[j].renderable;
+							instances[j].matrix = renderables[renderable].matrix;
+							float offset = (float)m_palette_slots[renderable].offset;
+							instances[j].palette.set(offset, 0, 0, 0);
+						}
+						continue;
+					}
+
+					Matrix* LUMIX_RESTRICT mtcs = (Matrix*)batch.instances.buffer->data;
+					for (int j = 0; j < batch.instances.instance_count; ++j)
+					{
+						ComponentIndex renderable = meshes[j].renderable;
+						mtcs[j] = getRenderable(renderables, static_batches, renderable).matrix;
+					}
+				}
+			});
+
+		MTJD::parallelFor(m_renderer.getEngine().getMTJDManager(),
+			0,
+			m_palette_uploads.size(),
+			FILL_BATCHES_GRAIN,
+			[this](int from, int to)
+			{
+				const Renderable* LUMIX_RESTRICT renderables = m_scene->getRenderables();
+				for (int i = from; i < to; ++i)
+				{
+					ComponentIndex cmp = m_palette_uploads[i];
+					const Renderable& renderable = renderables[cmp];
+					const Matrix* mtcs = renderable.pose->getSkinningMatrices(*renderable.model);
+					copyMemory(m_bone_texture_data + m_palette_slots[cmp].offset,
+						mtcs,
+						sizeof(Matrix) * renderable.pose->getCount());
+				}
+			});
+		m_palette_uploads.clear();
+	}
+
+
 	void renderRigidMesh(const Renderable& renderable, const RenderableMesh& info)
 	{
 		int instance_idx = info.mesh->instance_idx;
@@ -1934,7 +2832,7 @@ struct PipelineImpl : public Pipeline
 				bgfx::allocInstanceDataBuffer(InstanceData::MAX_INSTANCE_COUNT, sizeof(Matrix));
 			data.instance_count = 0;
 			data.mesh = info.mesh;
-			data.model = renderable.model;
+			data.model = getMeshModel(renderable, info);
 			info.mesh->instance_idx = instance_idx;
 		}
 		InstanceData& data = m_instances_data[instance_idx];
@@ -1949,6 +2847,30 @@ struct PipelineImpl : public Pipeline
 	}
 
 
+	// Sets the material and the view for a draw, returns the program to submit. bgfx forgets
+	// textures after each draw but keeps uniforms, so the uniforms of the material are sent only
+	// when the previous draw in the view had another material, program or state. Draws with the
+	// same key are kept in the submit order, so nothing can come between them and change the
+	// uniforms.
+	bgfx::ProgramHandle setMaterial(View& view, Material* material, uint64 state)
+	{
+		executeCommandBuffer(material->getCommandBuffer(), material);
+		executeCommandBuffer(view.command_buffer.buffer, material);
+
+		// the view's command buffer can change defines of the material
+		auto program = material->getShaderInstance().m_program_handles[view.pass_idx];
+		if (view.material != material || view.material_program.idx != program.idx ||
+			view.material_state != state)
+		{
+			executeCommandBuffer(material->getUniformCommandBuffer(), material);
+			view.material = material;
+			view.material_program = program;
+			view.material_state = state;
+		}
+		return program;
+	}
+
+
 	void executeCommandBuffer(const uint8* data, Material* material) const
 	{
 		const uint8* ip = data;
@@ -2014,24 +2936,11 @@ struct PipelineImpl : public Pipeline
 	}
 
 
-	void renderTerrain(const TerrainInfo& info)
+	// all visible patches of a terrain in one instanced draw, patches are quarters of quads and
+	// all use the first quarter of the grid moved to their place by the instance data
+	void renderTerrainPatches(const TerrainInfo* const* infos, int count)
 	{
-		auto& inst = m_terrain_instances[info.m_index];
-		if ((inst.m_count > 0 && inst.m_infos[0]->m_terrain != info.m_terrain) ||
-			inst.m_count == lengthOf(inst.m_infos))
-		{
-			finishTerrainInstances(info.m_index);
-		}
-		inst.m_infos[inst.m_count] = &info;
-		++inst.m_count;
-	}
-
-
-	void finishTerrainInstances(int index)
-	{
-		if (m_terrain_instances[index].m_count == 0) return;
-
-		const TerrainInfo& info = *m_terrain_instances[index].m_infos[0];
+		const TerrainInfo& info = *infos[0];
 		Material* material = info.m_terrain->getMaterial();
 		if (!material->isReady()) return;
 
@@ -2061,69 +2970,126 @@ struct PipelineImpl : public Pipeline
 		bgfx::setUniform(m_terrain_matrix_uniform, &info.m_world_matrix.m11);
 
 		auto& view = m_views[m_current_render_views[0]];
-		executeCommandBuffer(material->getCommandBuffer(), material);
-		executeCommandBuffer(view.command_buffer.buffer, material);
+		uint64 state = view.render_state | mesh.material->getRenderStates();
+		auto program = setMaterial(view, material, state);
 
 		struct TerrainInstanceData
 		{
 			Vec4 m_quad_min_and_size;
 			Vec4 m_morph_const;
 		};
-		const bgfx::InstanceDataBuffer* instance_buffer = bgfx::allocInstanceDataBuffer(
-			m_terrain_instances[index].m_count, sizeof(TerrainInstanceData));
+		if (!bgfx::checkAvailInstanceDataBuffer(count, sizeof(TerrainInstanceData)))
+		{
+			g_log_warning.log("Renderer") << "Not enough memory for terrain instances";
+			return;
+		}
+		const bgfx::InstanceDataBuffer* instance_buffer =
+			bgfx::allocInstanceDataBuffer(count, sizeof(TerrainInstanceData));
 		TerrainInstanceData* instance_data = (TerrainInstanceData*)instance_buffer->data;
 
-		for (int i = 0; i < m_terrain_instances[index].m_count; ++i)
+		for (int i = 0; i < count; ++i)
 		{
-			const TerrainInfo& info = *m_terrain_instances[index].m_infos[i];
-			instance_data[i].m_quad_min_and_size.set(
-				info.m_min.x, info.m_min.y, info.m_min.z, info.m_size);
+			const TerrainInfo& patch = *infos[i];
+			float half_size = patch.m_size * 0.5f;
+			// the size stays the size of the quad, the grid's first quarter covers half of it
+			Vec3 min = patch.m_min;
+			if (patch.m_index & 1) min.x += half_size;
+			if (patch.m_index & 2) min.z += half_size;
+			instance_data[i].m_quad_min_and_size.set(min.x, min.y, min.z, patch.m_size);
 			instance_data[i].m_morph_const.set(
-				info.m_morph_const.x, info.m_morph_const.y, info.m_morph_const.z, 0);
+				patch.m_morph_const.x, patch.m_morph_const.y, patch.m_morph_const.z, 0);
 		}
 
 		bgfx::setVertexBuffer(info.m_terrain->getVerticesHandle());
 		int mesh_part_indices_count = mesh.indices_count / 4;
-		bgfx::setIndexBuffer(info.m_terrain->getIndicesHandle(),
-			info.m_index * mesh_part_indices_count,
-			mesh_part_indices_count);
+		bgfx::setIndexBuffer(info.m_terrain->getIndicesHandle(), 0, mesh_part_indices_count);
 		bgfx::setStencil(view.stencil, BGFX_STENCIL_NONE);
-		bgfx::setState(view.render_state | mesh.material->getRenderStates());
-		bgfx::setInstanceDataBuffer(instance_buffer, m_terrain_instances[index].m_count);
-		auto shader_instance = material->getShaderInstance().m_program_handles[view.pass_idx];
+		bgfx::setState(state);
+		bgfx::setInstanceDataBuffer(instance_buffer, count);
 		++m_stats.m_draw_call_count;
-		m_stats.m_instance_count += m_terrain_instances[index].m_count;
-		m_stats.m_triangle_count += m_terrain_instances[index].m_count * mesh_part_indices_count;
-		bgfx::submit(view.bgfx_id, shader_instance);
+		m_stats.m_instance_count += count;
+		m_stats.m_triangle_count += count * mesh_part_indices_count / 3;
+		bgfx::submit(view.bgfx_id, program);
+	}
 
-		m_terrain_instances[index].m_count = 0;
+
+	// instances are offsets in the window around the camera, the vertex shader places them on
+	// the heightmap, drops those on other grounds and fades them out with the distance
+	void renderGPUGrass(const GrassInfo& grass)
+	{
+		Terrain& terrain = *grass.m_terrain;
+		Texture* heightmap = terrain.getHeightmap();
+		Texture* splatmap = terrain.getSplatmap();
+		if (!heightmap || !splatmap) return;
+
+		const Mesh& mesh = grass.m_model->getMesh(0);
+		Material* material = mesh.material;
+		grass.m_model->requestLOD(mesh.lod);
+		if (!bgfx::isValid(grass.m_model->getBuffers(mesh).vertices)) return;
+		if (!material->isDefined(m_gpu_grass_define_idx))
+		{
+			material->setDefine(m_gpu_grass_define_idx, true);
+		}
+
+		Matrix terrain_matrix = m_scene->getUniverse().getMatrix(terrain.getEntity());
+		Vec4 terrain_scale(terrain.getScale(), 0);
+		bgfx::setUniform(m_grass_params_uniform, &grass.m_gpu_params);
+		bgfx::setUniform(m_terrain_matrix_uniform, &terrain_matrix.m11);
+		bgfx::setUniform(m_terrain_scale_uniform, &terrain_scale);
+
+		auto& view = m_views[m_current_render_views[0]];
+		uint64 state = view.render_state | material->getRenderStates();
+		auto program = setMaterial(view, material, state);
+		// the stages after the shadowmap
+		bgfx::setTexture(
+			14 - m_global_textures_count, m_grass_heightmap_uniform, heightmap->getTextureHandle());
+		bgfx::setTexture(
+			13 - m_global_textures_count, m_grass_splatmap_uniform, splatmap->getTextureHandle());
+
+		setMeshBuffers(*grass.m_model, mesh);
+		bgfx::setStencil(view.stencil, BGFX_STENCIL_NONE);
+		bgfx::setState(state);
+		bgfx::setInstanceDataBuffer(
+			terrain.getGPUGrassInstances(grass.m_type), 0, grass.m_matrix_count);
+		++m_stats.m_draw_call_count;
+		m_stats.m_instance_count += grass.m_matrix_count;
+		m_stats.m_triangle_count += grass.m_matrix_count * mesh.indices_count;
+		bgfx::submit(view.bgfx_id, program);
 	}
 
 
 	void renderGrass(const GrassInfo& grass)
 	{
+		if (!grass.m_matrices)
+		{
+			renderGPUGrass(grass);
+			return;
+		}
+		const Mesh& mesh = grass.m_model->getMesh(0);
+		Material* material = mesh.material;
+		grass.m_model->requestLOD(mesh.lod);
+		if (!bgfx::isValid(grass.m_model->getBuffers(mesh).vertices)) return;
+		if (material->isDefined(m_gpu_grass_define_idx))
+		{
+			material->setDefine(m_gpu_grass_define_idx, false);
+		}
+
 		const bgfx::InstanceDataBuffer* idb =
 			bgfx::allocInstanceDataBuffer(grass.m_matrix_count, sizeof(Matrix));
 		copyMemory(idb->data, &grass.m_matrices[0], grass.m_matrix_count * sizeof(Matrix));
-		const Mesh& mesh = grass.m_model->getMesh(0);
-		Material* material = mesh.material;
 
 		auto& view = m_views[m_current_render_views[0]];
-		executeCommandBuffer(material->getCommandBuffer(), material);
-		executeCommandBuffer(view.command_buffer.buffer, material);
+		uint64 state = view.render_state | material->getRenderStates();
+		auto program = setMaterial(view, material, state);
 
-		bgfx::setVertexBuffer(grass.m_model->getVerticesHandle(),
-			mesh.attribute_array_offset / mesh.vertex_def.getStride(),
-			mesh.attribute_array_size / mesh.vertex_def.getStride());
-		bgfx::setIndexBuffer(
-			grass.m_model->getIndicesHandle(), mesh.indices_offset, mesh.indices_count);
+		setMeshBuffers(*grass.m_model, mesh);
 		bgfx::setStencil(view.stencil, BGFX_STENCIL_NONE);
-		bgfx::setState(view.render_state | material->getRenderStates());
+		bgfx::setState(state);
 		bgfx::setInstanceDataBuffer(idb, grass.m_matrix_count);
 		++m_stats.m_draw_call_count;
 		m_stats.m_instance_count += grass.m_matrix_count;
 		m_stats.m_triangle_count += grass.m_matrix_count * mesh.indices_count;
-		bgfx::submit(view.bgfx_id, material->getShaderInstance().m_program_handles[view.pass_idx]);
+		bgfx::submit(view.bgfx_id, program);
 	}
 
 
@@ -2141,13 +3107,12 @@ struct PipelineImpl : public Pipeline
 	{
 		PROFILE_FUNCTION();
 		PROFILE_INT("terrain patches", terrains.size());
-		for (auto* info : terrains)
-		{
-			renderTerrain(*info);
-		}
-		for (int i = 0; i < lengthOf(m_terrain_instances); ++i)
+		for (int i = 0, c = terrains.size(); i < c;)
 		{
-			finishTerrainInstances(i);
+			int run_end = i + 1;
+			while (run_end < c && terrains[run_end]->m_terrain == terrains[i]->m_terrain) ++run_end;
+			renderTerrainPatches(&terrains[i], run_end - i);
+			i = run_end;
 		}
 	}
 
@@ -2158,10 +3123,12 @@ struct PipelineImpl : public Pipeline
 		if(meshes.empty()) return;
 
 		Renderable* renderables = m_scene->getRenderables();
+		Renderable* static_batches = m_scene->getStaticBatches();
 		PROFILE_INT("mesh count", meshes.size());
 		for(auto& mesh : meshes)
 		{
-			Renderable& renderable = renderables[mesh.renderable];
+			const Renderable& renderable =
+				getRenderable(renderables, static_batches, mesh.renderable);
 			if(renderable.pose && renderable.pose->getCount() > 0)
 			{
 				renderSkinnedMesh(renderable, mesh);
@@ -2175,30 +3142,104 @@ struct PipelineImpl : public Pipeline
 	}
 
 	
-	void renderMeshes(const Array<Array<RenderableMesh>>& meshes)
+	// each culling subresult is sorted on a worker, sorted subresults are merged to m_sorted_meshes
+	void sortMeshes(const Array<Array<RenderableMesh>>& meshes)
 	{
 		PROFILE_FUNCTION();
+		m_sorted_meshes_offsets.clear();
 		int mesh_count = 0;
 		for (auto& submeshes : meshes)
 		{
-			if(submeshes.empty()) continue;
-			Renderable* renderables = m_scene->getRenderables();
+			m_sorted_meshes_offsets.push(mesh_count);
 			mesh_count += submeshes.size();
-			for (auto& mesh : submeshes)
+		}
+		m_sorted_meshes_offsets.push(mesh_count);
+		m_sorted_meshes.resize(mesh_count);
+		m_sorted_meshes_tmp.resize(mesh_count);
+		if (mesh_count == 0) return;
+
+		MTJD::parallelFor(m_renderer.getEngine().getMTJDManager(),
+			0,
+			meshes.size(),
+			1,
+			[this, &meshes](int from, int to)
 			{
-				Renderable& renderable = renderables[mesh.renderable];
-				if (renderable.pose && renderable.pose->getCount() > 0)
+				for (int i = from; i < to; ++i)
 				{
-					renderSkinnedMesh(renderable, mesh);
+					int count = meshes[i].size();
+					if (count == 0) continue;
+					RenderableMesh* LUMIX_RESTRICT tmp = &m_sorted_meshes_tmp[m_sorted_meshes_offsets[i]];
+					copyMemory(tmp, &meshes[i][0], count * sizeof(RenderableMesh));
+					RenderableMesh* LUMIX_RESTRICT sorted = &m_sorted_meshes[m_sorted_meshes_offsets[i]];
+					radixSort(tmp, sorted, count, [](const RenderableMesh& mesh) { return mesh.sort_key; });
 				}
-				else
+			});
+
+		m_sorted_meshes_heads.resize(meshes.size());
+		for (int i = 0; i < meshes.size(); ++i)
+		{
+			m_sorted_meshes_heads[i] = m_sorted_meshes_offsets[i];
+		}
+		for (int i = 0; i < mesh_count; ++i)
+		{
+			int best = -1;
+			for (int j = 0, c = m_sorted_meshes_heads.size(); j < c; ++j)
+			{
+				int head = m_sorted_meshes_heads[j];
+				if (head == m_sorted_meshes_offsets[j + 1]) continue;
+				if (best < 0 ||
+					m_sorted_meshes_tmp[head].sort_key <
+						m_sorted_meshes_tmp[m_sorted_meshes_heads[best]].sort_key)
 				{
-					renderRigidMesh(renderable, mesh);
+					best = j;
 				}
 			}
+			m_sorted_meshes[i] = m_sorted_meshes_tmp[m_sorted_meshes_heads[best]];
+			++m_sorted_meshes_heads[best];
 		}
+	}
+
+
+	void renderMeshes(const Array<Array<RenderableMesh>>& meshes)
+	{
+		PROFILE_FUNCTION();
+		sortMeshes(meshes);
+		if (m_sorted_meshes.empty()) return;
+
+		// equal meshes are next to each other after sorting, each run is drawn instanced
+		recordMeshBatches();
+		fillMeshBatches();
+
+		Renderable* renderables = m_scene->getRenderables();
+		float lod_fade = 0;
+		for (const MeshBatch& batch : m_mesh_batches)
+		{
+			float batch_lod_fade = m_sorted_meshes[batch.first].lod_fade;
+			if (batch_lod_fade != lod_fade)
+			{
+				lod_fade = batch_lod_fade;
+				bgfx::setUniform(m_lod_fade_uniform, &Vec4(lod_fade, 0, 0, 0));
+			}
+			if (batch.instances.buffer)
+			{
+				if (batch.is_skinned)
+				{
+					batch.instances.mesh->material->setDefine(m_bone_texture_define_idx, true);
+					// the stage after the shadowmap
+					bgfx::setTexture(
+						14 - m_global_textures_count, m_bone_texture_uniform, m_bone_texture);
+				}
+				submitInstances(batch.instances);
+			}
+			else
+			{
+				const RenderableMesh& mesh = m_sorted_meshes[batch.first];
+				renderSkinnedMesh(renderables[mesh.renderable], mesh);
+			}
+		}
+		if (lod_fade != 0) bgfx::setUniform(m_lod_fade_uniform, &Vec4(0, 0, 0, 0));
 		finishInstances();
-		PROFILE_INT("mesh count", mesh_count);
+		PROFILE_INT("mesh count", m_sorted_meshes.size());
 	}
 
 
@@ -2212,16 +3253,94 @@ struct PipelineImpl : public Pipeline
 		{
 			m_default_framebuffer->resize(w, h);
 		}
-		for (auto& i : m_framebuffers)
-		{
-			auto size_ratio = i->getSizeRatio();
-			if (size_ratio.x > 0 || size_ratio.y > 0)
-			{
-				i->resize(int(w * size_ratio.x), int(h * size_ratio.y));
-			}
-		}
 		m_width = w;
 		m_height = h;
+		resizeScreenFramebuffers();
+		invalidateShadowmapCache();
+	}
+
+
+	bool isScaledFramebuffer(FrameBuffer* framebuffer) const
+	{
+		if (m_resolution_scale == 1 || !framebuffer || framebuffer == m_default_framebuffer)
+		{
+			return false;
+		}
+		Vec2 size_ratio = framebuffer->getSizeRatio();
+		return size_ratio.x > 0 || size_ratio.y > 0;
+	}
+
+
+	// framebuffers sized by the screen are scaled by the dynamic resolution, the final pass
+	// renders them to the default framebuffer
+	void resizeScreenFramebuffers()
+	{
+		for (auto* framebuffer : m_framebuffers)
+		{
+			if (framebuffer == m_default_framebuffer) continue;
+			Vec2 size_ratio = framebuffer->getSizeRatio();
+			if (size_ratio.x <= 0 && size_ratio.y <= 0) continue;
+
+			float scale = m_resolution_scale;
+			int width = Math::maxValue(int(m_width * size_ratio.x * scale), 1);
+			int height = Math::maxValue(int(m_height * size_ratio.y * scale), 1);
+			framebuffer->resize(width, height);
+		}
+		releaseFramebufferPool();
+	}
+
+
+	// 0 target time disables the scaling
+	void setDynamicResolution(float target_gpu_frame_time, float min_scale, float max_scale)
+	{
+		m_target_gpu_frame_time = target_gpu_frame_time;
+		m_min_resolution_scale = Math::clamp(min_scale, 0.1f, 1.0f);
+		m_max_resolution_scale = Math::clamp(max_scale, m_min_resolution_scale, 1.0f);
+		float scale = target_gpu_frame_time > 0 ? Math::clamp(m_resolution_scale,
+													  m_min_resolution_scale,
+													  m_max_resolution_scale)
+												: 1.0f;
+		setResolutionScale(scale);
+	}
+
+
+	float getResolutionScale() const { return m_resolution_scale; }
+
+
+	void setResolutionScale(float scale)
+	{
+		if (scale == m_resolution_scale) return;
+		m_resolution_scale = scale;
+		m_resolution_scale_cooldown = RESOLUTION_SCALE_COOLDOWN;
+		if (m_width > 0) resizeScreenFramebuffers();
+	}
+
+
+	// the measured time is a few frames old, so the scale changes in small steps and waits for
+	// the result of the last change; the rendered pixels are proportional to the square of it
+	void updateResolutionScale()
+	{
+		if (m_target_gpu_frame_time <= 0) return;
+		if (m_resolution_scale_cooldown > 0)
+		{
+			--m_resolution_scale_cooldown;
+			return;
+		}
+		float gpu_frame_time = m_renderer.getGPUFrameTime();
+		if (gpu_frame_time <= 0) return;
+
+		float wanted = m_resolution_scale * sqrtf(m_target_gpu_frame_time / gpu_frame_time);
+		wanted = Math::clamp(wanted, m_min_resolution_scale, m_max_resolution_scale);
+		if (fabsf(wanted - m_resolution_scale) < RESOLUTION_SCALE_STEP)
+		{
+			// the limits do not have to be a multiple of the step away
+			bool is_limit = wanted == m_min_resolution_scale || wanted == m_max_resolution_scale;
+			if (is_limit) setResolutionScale(wanted);
+			return;
+		}
+		setResolutionScale(m_resolution_scale +
+						   (wanted > m_resolution_scale ? RESOLUTION_SCALE_STEP
+														: -RESOLUTION_SCALE_STEP));
 	}
 
 
@@ -2232,6 +3351,7 @@ struct PipelineImpl : public Pipeline
 		if (!isReady()) return;
 		if (!m_scene) return;
 
+		updateResolutionScale();
 		m_stats = {};
 		m_render_state = BGFX_STATE_RGB_WRITE | BGFX_STATE_ALPHA_WRITE | BGFX_STATE_DEPTH_WRITE | BGFX_STATE_MSAA;
 		m_applied_camera = INVALID_COMPONENT;
@@ -2243,10 +3363,12 @@ struct PipelineImpl : public Pipeline
 		m_pass_idx = -1;
 		m_current_framebuffer = m_default_framebuffer;
 		m_instance_data_idx = 0;
+		++m_palette_frame;
+		m_bone_texture_used = 0;
 		m_point_light_shadowmaps.clear();
-		for (int i = 0; i < lengthOf(m_terrain_instances); ++i)
+		for (auto& transient : m_transient_framebuffers)
 		{
-			m_terrain_instances[i].m_count = 0;
+			transient.first_view = transient.last_view = -1;
 		}
 		for (int i = 0; i < lengthOf(m_instances_data); ++i)
 		{
@@ -2269,6 +3391,10 @@ struct PipelineImpl : public Pipeline
 			lua_pop(m_lua_state, 1);
 		}
 		finishInstances();
+		uploadBoneTexture();
+		assignTransientFramebuffers();
+		readHiZDepth();
+		FrameStats::add(FrameStats::Counter::DRAW_CALLS, m_stats.m_draw_call_count);
 
 		m_renderer.getFrameAllocator().clear();
 	}
@@ -2346,6 +3472,79 @@ struct PipelineImpl : public Pipeline
 	}
 
 
+	void enableOcclusionCulling(bool enable)
+	{
+		m_is_occlusion_culling_enabled = enable;
+	}
+
+
+	// the renderbuffer is R32F with 1/w of the camera's depth, e.g. gl_FragCoord.w written by the
+	// pipeline's shaders; it is read back every frame and renderables hidden in the last depth
+	// which arrived are not rendered; a few frames of latency, so fast moving cameras can see
+	// objects pop in; an empty framebuffer name disables it
+	void enableHiZCulling(const char* framebuffer, int renderbuffer_idx)
+	{
+		if (m_is_hiz_readback_pending) m_renderer.cancelReadbacks(getHiZReadbackCallback());
+		m_is_hiz_readback_pending = false;
+		m_depth_pyramid.clear();
+		copyString(m_hiz_framebuffer, framebuffer);
+		m_hiz_renderbuffer_idx = framebuffer[0] ? renderbuffer_idx : -1;
+	}
+
+
+	Renderer::ReadbackCallback getHiZReadbackCallback()
+	{
+		Renderer::ReadbackCallback callback;
+		callback.bind<PipelineImpl, &PipelineImpl::onHiZReadback>(this);
+		return callback;
+	}
+
+
+	void readHiZDepth()
+	{
+		if (m_hiz_renderbuffer_idx < 0 || m_is_hiz_readback_pending) return;
+		if (m_applied_camera == INVALID_COMPONENT) return;
+		FrameBuffer* framebuffer = getFramebuffer(m_hiz_framebuffer);
+		if (!framebuffer) return;
+
+		auto callback = getHiZReadbackCallback();
+		if (!m_renderer.readFramebuffer(*framebuffer, m_hiz_renderbuffer_idx, callback))
+		{
+			g_log_error.log("Renderer") << "Hi-Z culling disabled";
+			m_hiz_renderbuffer_idx = -1;
+			return;
+		}
+		m_is_hiz_readback_pending = true;
+		m_hiz_view_projection = m_camera_view_projection;
+	}
+
+
+	void onHiZReadback(const uint8* data, int width, int height)
+	{
+		m_is_hiz_readback_pending = false;
+		m_depth_pyramid.build((const float*)data, width, height, m_hiz_view_projection);
+	}
+
+
+	void enableShadowmapCaching(bool enable)
+	{
+		m_is_shadowmap_caching_enabled = enable;
+		invalidateShadowmapCache();
+	}
+
+
+	void setLODBias(float bias)
+	{
+		m_lod_bias = bias;
+	}
+
+
+	void enableLODCrossFade(bool enable)
+	{
+		m_scene->enableLODCrossFade(enable);
+	}
+
+
 	void clear(uint32 flags, uint32 color)
 	{
 		bgfx::setViewClear(m_bgfx_view, (uint16)flags, color, 1.0f, 0);
@@ -2365,6 +3564,7 @@ struct PipelineImpl : public Pipeline
 	void setScene(RenderScene* scene) override 
 	{
 		m_scene = scene;
+		invalidateShadowmapCache();
 		if (m_lua_state && m_scene) callInitScene();
 	}
 
@@ -2391,13 +3591,6 @@ struct PipelineImpl : public Pipeline
 	}
 
 
-	struct TerrainInstance
-	{
-		int m_count;
-		const TerrainInfo* m_infos[64];
-	};
-
-
 	struct PointLightShadowmap
 	{
 		ComponentIndex m_light;
@@ -2406,6 +3599,36 @@ struct PipelineImpl : public Pipeline
 	};
 
 
+	struct TransientFramebuffer
+	{
+		FrameBuffer* framebuffer;
+		// range of views using it in this frame, -1 if it is not used
+		int first_view;
+		int last_view;
+		// the range it was assigned textures of the pool for
+		int assigned_first_view;
+		int assigned_last_view;
+	};
+
+
+	struct CachedShadowmap
+	{
+		PointLightShadowmap shadowmap;
+		uint32 version;
+	};
+
+
+	struct CachedCascades
+	{
+		FrameBuffer* framebuffer;
+		ComponentIndex light;
+		Vec3 light_direction;
+		Vec4 splits;
+		bool is_valid[SHADOW_CASCADES_COUNT];
+		int next_update;
+	};
+
+
 	struct BaseVertex
 	{
 		float x, y, z;
@@ -2417,7 +3640,6 @@ struct PipelineImpl : public Pipeline
 
 	bgfx::VertexDecl m_deferred_point_light_vertex_decl;
 	bgfx::VertexDecl m_base_vertex_decl;
-	TerrainInstance m_terrain_instances[4];
 	uint32 m_debug_flags;
 	uint8 m_bgfx_view;
 	int m_view_idx;
@@ -2431,9 +3653,14 @@ struct PipelineImpl : public Pipeline
 	FrameBuffer* m_current_framebuffer;
 	FrameBuffer* m_default_framebuffer;
 	Array<FrameBuffer*> m_framebuffers;
+	Array<TransientFramebuffer> m_transient_framebuffers;
+	Array<FrameBuffer*> m_framebuffer_pool;
 	Array<bgfx::UniformHandle> m_uniforms;
 	Array<Material*> m_materials;
 	Array<PointLightShadowmap> m_point_light_shadowmaps;
+	Array<CachedShadowmap> m_cached_shadowmaps;
+	CachedCascades m_cached_cascades;
+	bool m_is_shadowmap_caching_enabled;
 	FrameBuffer* m_global_light_shadowmap;
 	InstanceData m_instances_data[128];
 	int m_instance_data_idx;
@@ -2445,10 +3672,26 @@ struct PipelineImpl : public Pipeline
 	bool m_is_rendering_in_shadowmap;
 	bool m_is_ready;
 	Frustum m_camera_frustum;
+	Matrix m_camera_view_projection;
+	bool m_is_occlusion_culling_enabled;
+	DepthPyramid m_depth_pyramid;
+	char m_hiz_framebuffer[64];
+	int m_hiz_renderbuffer_idx;
+	bool m_is_hiz_readback_pending;
+	// of the frame being read back
+	Matrix m_hiz_view_projection;
+	float m_lod_bias;
+	float m_target_gpu_frame_time;
+	float m_min_resolution_scale;
+	float m_max_resolution_scale;
+	float m_resolution_scale;
+	int m_resolution_scale_cooldown;
 
 	int* m_current_render_views;
 	int m_current_render_view_count;
-	Matrix m_shadow_viewprojection[4];
+	Matrix m_shadow_viewprojection[SHADOW_CASCADES_COUNT];
+	// light space bounds of the receivers of each cascade, see cullShadowCascades
+	AABB m_shadow_receivers[SHADOW_CASCADES_COUNT];
 	int m_view_x;
 	int m_view_y;
 	int m_width;
@@ -2458,13 +3701,42 @@ struct PipelineImpl : public Pipeline
 	bgfx::IndexBufferHandle m_particle_index_buffer;
 	Array<CustomCommandHandler> m_custom_commands_handlers;
 	Array<RenderableMesh> m_tmp_meshes;
+	Array<RenderableMesh> m_sorted_meshes;
+	Array<RenderableMesh> m_sorted_meshes_tmp;
+	Array<int> m_sorted_meshes_offsets;
+	Array<int> m_sorted_meshes_heads;
+	Array<MeshBatch> m_mesh_batches;
+	// frame in which the skinning matrices of a renderable were put to the bone texture
+	struct PaletteSlot
+	{
+		uint32 frame;
+		int offset;
+	};
+	Array<PaletteSlot> m_palette_slots;
+	Array<ComponentIndex> m_palette_uploads;
+	uint32 m_palette_frame;
+	int m_bone_texture_used;
+	Matrix* m_bone_texture_data;
 	Array<const TerrainInfo*> m_tmp_terrains;
 	Array<GrassInfo> m_tmp_grasses;
+	Array<ParticleBatch> m_particle_batches;
 	Array<ComponentIndex> m_tmp_local_lights;
 
 	bgfx::UniformHandle m_mat_color_shininess_uniform;
 	bgfx::UniformHandle m_bone_matrices_uniform;
 	bgfx::UniformHandle m_layer_uniform;
+	bgfx::UniformHandle m_lod_fade_uniform;
+	bgfx::UniformHandle m_light_grid_params_uniform;
+	bgfx::UniformHandle m_light_grid_clusters_uniform;
+	bgfx::UniformHandle m_light_grid_indices_uniform;
+	bgfx::UniformHandle m_light_grid_lights_uniform;
+	bgfx::TextureHandle m_light_grid_clusters_texture;
+	bgfx::TextureHandle m_bone_texture;
+	bgfx::UniformHandle m_bone_texture_uniform;
+	bgfx::TextureHandle m_light_grid_indices_texture;
+	bgfx::TextureHandle m_light_grid_lights_texture;
+	LightGrid m_light_grid;
+	Array<LightGrid::Light> m_light_grid_lights;
 	bgfx::UniformHandle m_terrain_scale_uniform;
 	bgfx::UniformHandle m_rel_camera_pos_uniform;
 	bgfx::UniformHandle m_terrain_params_uniform;
@@ -2477,6 +3749,10 @@ struct PipelineImpl : public Pipeline
 	bgfx::UniformHandle m_shadowmap_matrices_uniform;
 	bgfx::UniformHandle m_light_specular_uniform;
 	bgfx::UniformHandle m_terrain_matrix_uniform;
+	bgfx::UniformHandle m_grass_params_uniform;
+	bgfx::UniformHandle m_grass_heightmap_uniform;
+	bgfx::UniformHandle m_grass_splatmap_uniform;
+	bgfx::UniformHandle m_particle_params_uniform;
 	bgfx::UniformHandle m_tex_shadowmap_uniform;
 	bgfx::UniformHandle m_cam_view_uniform;
 	bgfx::UniformHandle m_cam_proj_uniform;
@@ -2489,6 +3765,10 @@ struct PipelineImpl : public Pipeline
 
 	Material* m_debug_line_material;
 	int m_has_shadowmap_define_idx;
+	int m_bone_texture_define_idx;
+	int m_gpu_grass_define_idx;
+	int m_gpu_particles_define_idx;
+	bgfx::VertexBufferHandle m_gpu_particle_slots;
 };
 
 
@@ -2543,8 +3823,20 @@ int addFramebuffer(lua_State* L)
 		PipelineImpl::parseRenderbuffers(L, decl);
 	}
 	lua_pop(L, 1);
+	if(lua_getfield(L, 3, "transient") == LUA_TBOOLEAN)
+	{
+		decl.m_is_transient = lua_toboolean(L, -1) != 0;
+	}
+	lua_pop(L, 1);
 	auto* fb = LUMIX_NEW(pipeline->m_allocator, FrameBuffer)(decl);
 	pipeline->m_framebuffers.push(fb);
+	if (decl.m_is_transient)
+	{
+		auto& transient = pipeline->m_transient_framebuffers.emplace();
+		transient.framebuffer = fb;
+		transient.first_view = transient.last_view = -1;
+		transient.assigned_first_view = transient.assigned_last_view = -1;
+	}
 	if(compareString(decl.m_name, "default") == 0) pipeline->m_default_framebuffer = fb;
 
 	return 0;
@@ -2690,10 +3982,18 @@ void Pipeline::registerLuaAPI(lua_State* L)
 	REGISTER_FUNCTION(cameraExists);
 	REGISTER_FUNCTION(enableBlending);
 	REGISTER_FUNCTION(clear);
+	REGISTER_FUNCTION(enableOcclusionCulling);
+	REGISTER_FUNCTION(enableHiZCulling);
+	REGISTER_FUNCTION(enableShadowmapCaching);
+	REGISTER_FUNCTION(setLODBias);
+	REGISTER_FUNCTION(setDynamicResolution);
+	REGISTER_FUNCTION(getResolutionScale);
+	REGISTER_FUNCTION(enableLODCrossFade);
 	REGISTER_FUNCTION(renderPointLightLitGeometry);
 	REGISTER_FUNCTION(renderShadowmap);
 	REGISTER_FUNCTION(copyRenderbuffer);
 	REGISTER_FUNCTION(setActiveGlobalLightUniforms);
+	REGISTER_FUNCTION(setClusteredLightsUniforms);
 	REGISTER_FUNCTION(setStencil);
 	REGISTER_FUNCTION(setStencilRMask);
 	REGISTER_FUNCTION(setStencilRef);
@@ -63,6 +63,8 @@ class LUMIX_RENDERER_API Pipeline
 			int m_draw_call_count;
 			int m_instance_count;
 			int m_triangle_count;
+			// meshes which passed the culling, in all passes of the frame
+			int m_visible_mesh_count;
 		};
 
 		struct CustomCommandHandler
@@ -15,8 +15,10 @@ Pose::Pose(IAllocator& allocator)
 {
 	m_positions = 0;
 	m_rotations = 0;
+	m_skinning_matrices = nullptr;
 	m_count = 0;
 	m_is_absolute = false;
+	m_is_skinning_valid = false;
 }
 
 
@@ -24,6 +26,7 @@ Pose::~Pose()
 {
 	m_allocator.deallocate(m_positions);
 	m_allocator.deallocate(m_rotations);
+	m_allocator.deallocate(m_skinning_matrices);
 }
 
 
@@ -34,6 +37,7 @@ void Pose::blend(Pose& rhs, float weight)
 	{
 		return;
 	}
+	m_is_skinning_valid = false;
 	weight = Math::clamp(weight, 0.0f, 1.0f);
 	float inv = 1.0f - weight;
 	for (int i = 0, c = m_count; i < c; ++i)
@@ -44,21 +48,41 @@ void Pose::blend(Pose& rhs, float weight)
 }
 
 
+void Pose::copy(const Pose& rhs)
+{
+	ASSERT(m_count == rhs.m_count);
+	copyMemory(m_positions, rhs.m_positions, sizeof(m_positions[0]) * m_count);
+	copyMemory(m_rotations, rhs.m_rotations, sizeof(m_rotations[0]) * m_count);
+	if (rhs.m_is_skinning_valid)
+	{
+		copyMemory(m_skinning_matrices,
+			rhs.m_skinning_matrices,
+			sizeof(m_skinning_matrices[0]) * m_count);
+	}
+	m_is_absolute = rhs.m_is_absolute;
+	m_is_skinning_valid = rhs.m_is_skinning_valid;
+}
+
+
 void Pose::resize(int count)
 {
 	m_is_absolute = false;
+	m_is_skinning_valid = false;
 	m_allocator.deallocate(m_positions);
 	m_allocator.deallocate(m_rotations);
+	m_allocator.deallocate(m_skinning_matrices);
 	m_count = count;
 	if(m_count)
 	{
 		m_positions = static_cast<Vec3*>(m_allocator.allocate(sizeof(Vec3) * count));
 		m_rotations = static_cast<Quat*>(m_allocator.allocate(sizeof(Quat) * count));
+		m_skinning_matrices = static_cast<Matrix*>(m_allocator.allocate(sizeof(Matrix) * count));
 	}
 	else
 	{
 		m_positions = nullptr;
 		m_rotations = nullptr;
+		m_skinning_matrices = nullptr;
 	}
 }
 
@@ -67,6 +91,7 @@ void Pose::computeAbsolute(Model& model)
 {
 	PROFILE_FUNCTION();
 	if (m_is_absolute) return;
+	m_is_skinning_valid = false;
 	for (int i = model.getFirstNonrootBoneIndex(); i < m_count; ++i)
 	{
 		int parent = model.getBone(i).parent_idx;
@@ -81,6 +106,7 @@ void Pose::computeRelative(Model& model)
 {
 	PROFILE_FUNCTION();
 	if (!m_is_absolute) return;
+	m_is_skinning_valid = false;
 	for (int i = m_count - 1; i >= model.getFirstNonrootBoneIndex(); --i)
 	{
 		int parent = model.getBone(i).parent_idx;
@@ -101,4 +127,26 @@ void Pose::setMatrices(Matrix* mtx) const
 }
 
 
+void Pose::computeSkinningMatrices(const Model& model)
+{
+	ASSERT(m_is_absolute);
+	ASSERT(m_count <= model.getBoneCount());
+	for (int i = 0, c = m_count; i < c; ++i)
+	{
+		Matrix& mtx = m_skinning_matrices[i];
+		m_rotations[i].toMatrix(mtx);
+		mtx.translate(m_positions[i]);
+		mtx = mtx * model.getBone(i).inv_bind_matrix;
+	}
+	m_is_skinning_valid = true;
+}
+
+
+const Matrix* Pose::getSkinningMatrices(const Model& model)
+{
+	if (!m_is_skinning_valid) computeSkinningMatrices(model);
+	return m_skinning_matrices;
+}
+
+
 } // ~namespace Lumix
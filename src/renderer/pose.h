@@ -23,14 +23,20 @@ class LUMIX_RENDERER_API Pose
 
 		void resize(int count);
 		void setMatrices(Matrix* mtx) const;
+		// bone matrices for skinning, computed only when the pose has changed, so all meshes
+		// and views drawing the pose share them
+		const Matrix* getSkinningMatrices(const Model& model);
+		void computeSkinningMatrices(const Model& model);
 		int getCount() const { return m_count; }
 		Vec3* getPositions() const { return m_positions; }
 		Quat* getRotations() const { return m_rotations; }
 		void computeAbsolute(Model& model);
 		void computeRelative(Model& model);
-		void setIsRelative() { m_is_absolute = false; }
-		void setIsAbsolute() { m_is_absolute = true; }
+		void setIsRelative() { m_is_absolute = false; m_is_skinning_valid = false; }
+		void setIsAbsolute() { m_is_absolute = true; m_is_skinning_valid = false; }
 		void blend(Pose& rhs, float weight);
+		// rhs must have the same bone count, its skinning matrices are copied if computed
+		void copy(const Pose& rhs);
 
 	private:
 		Pose(const Pose&);
@@ -39,9 +45,11 @@ class LUMIX_RENDERER_API Pose
 	private:
 		IAllocator& m_allocator;
 		bool m_is_absolute;
+		bool m_is_skinning_valid;
 		int32 m_count;
 		Vec3* m_positions;
 		Quat* m_rotations;
+		Matrix* m_skinning_matrices;
 };
 
 
@@ -10,7 +10,7 @@
 #include "core/log.h"
 #include "core/lua_wrapper.h"
 #include "core/math_utils.h"
-#include "core/mtjd/generic_job.h"
+#include "core/mtjd/parallel_for.h"
 #include "core/mtjd/job.h"
 #include "core/mtjd/manager.h"
 #include "core/profiler.h"
@@ -18,6 +18,7 @@
 #include "core/resource_manager_base.h"
 #include "core/timer.h"
 #include "core/sphere.h"
+#include "core/string.h"
 #include "core/frustum.h"
 
 #include "engine.h"
@@ -25,9 +26,13 @@
 #include "lua_script/lua_script_system.h"
 
 #include "renderer/culling_system.h"
+#include "renderer/depth_pyramid.h"
 #include "renderer/material.h"
 #include "renderer/material_manager.h"
+#include "renderer/mesh_simplifier.h"
 #include "renderer/model.h"
+#include "renderer/model_manager.h"
+#include "renderer/occlusion_buffer.h"
 #include "renderer/particle_system.h"
 #include "renderer/pipeline.h"
 #include "renderer/pose.h"
@@ -38,7 +43,9 @@
 #include "renderer/texture.h"
 
 #include "universe/universe.h"
+#include <cfloat>
 #include <cmath>
+#include <cstdlib>
 
 
 namespace Lumix
@@ -75,12 +82,97 @@ enum class RenderSceneVersion : int32
 	GLOBAL_LIGHT_SPECULAR,
 	SPECULAR_INTENSITY,
 	RENDER_PARAMS,
+	RENDERABLE_OCCLUDER,
 
 	LATEST,
 	INVALID = -1,
 };
 
 
+static const int MAX_STATIC_RENDER_LISTS = 8;
+
+
+// LOD selected last time, while previous_lod != lod the two LODs are cross-faded
+struct RenderableLODState
+{
+	int8 lod;
+	int8 previous_lod;
+	float change_time;
+	// RenderSceneImpl::m_frame when the renderable was last in a culled frustum
+	uint32 visible_frame;
+};
+
+
+// copy of the model's LOD table next to the renderable's meshes, so building render infos
+// does not have to touch the model; the imposter of the model is one more LOD after the model's
+struct RenderableLODs
+{
+	Model* model;
+	Mesh* meshes;
+	uint32 model_hash;
+	float radius;
+	float squared_distances[Model::MAX_LOD_COUNT + 1];
+	int8 from_mesh[Model::MAX_LOD_COUNT + 1];
+	int8 to_mesh[Model::MAX_LOD_COUNT + 1];
+	// -1 without an imposter
+	int8 imposter_lod;
+	Model* imposter;
+};
+
+
+// renderables of the model are drawn as a quad of the imposter model from the distance
+struct ModelImposter
+{
+	uint32 model_path_hash;
+	Path material_path;
+	float squared_distance;
+	// created when a renderable with the model is loaded, the quad is as big as the model
+	Model* quad;
+};
+// how far can the camera move before static render lists are rebuilt
+static const float STATIC_RENDER_LIST_THRESHOLD = 2.0f;
+// relative size of the band around LOD borders in which the current LOD is kept
+static const float LOD_HYSTERESIS = 0.1f;
+static const float LOD_FADE_DURATION = 0.5f;
+// diameter in pixels of a unit sphere at a unit distance in the LOD reference view (1080p, 60°)
+static const float TEXTURE_STREAMING_SCREEN_SCALE = 1870.0f;
+// largest error of HLOD proxies at the distance where they replace their batches
+static const float HLOD_PIXEL_ERROR = 2.0f;
+
+
+enum class RenderableFilter
+{
+	ALL,
+	STATIC,
+	DYNAMIC
+};
+
+
+// render infos of static renderables visible from a view, dynamic renderables are appended
+// every frame after the first static_count arrays
+struct StaticRenderList
+{
+	explicit StaticRenderList(IAllocator& allocator)
+		: infos(allocator)
+		, fading(allocator)
+	{
+	}
+
+	Frustum frustum;
+	bool is_valid;
+	int static_count;
+	Array<Array<RenderableMesh>> infos;
+	// static renderables cross-fading their LODs or waiting for a streamed LOD when the list was
+	// built, updated every frame
+	CullingSystem::Results fading;
+	// infos are complete for this frustum in this frame, pipelines rendering the same camera
+	// get them without culling again
+	Frustum infos_frustum;
+	uint32 infos_frame;
+	bool has_infos;
+};
+
+
 struct RenderParamVec4
 {
 	char name[32];
@@ -145,6 +237,27 @@ struct Camera
 };
 
 
+struct ParticleEffectPool
+{
+	explicit ParticleEffectPool(IAllocator& allocator)
+		: free_emitters(allocator)
+	{
+	}
+
+	ComponentIndex template_emitter;
+	Array<ParticleEmitter*> free_emitters;
+};
+
+
+struct ParticleRange
+{
+	ParticleEmitter* emitter;
+	int from;
+	int to;
+	AABB bounds;
+};
+
+
 class RenderSceneImpl : public RenderScene
 {
 private:
@@ -194,17 +307,37 @@ public:
 		, m_renderer(renderer)
 		, m_allocator(allocator)
 		, m_model_loaded_callbacks(m_allocator)
+		, m_precached_shaders(m_allocator)
 		, m_renderables(m_allocator)
 		, m_cameras(m_allocator)
 		, m_terrains(m_allocator)
 		, m_point_lights(m_allocator)
 		, m_light_influenced_geometry(m_allocator)
+		, m_point_light_shadow_versions(m_allocator)
+		, m_last_shadow_version(0)
 		, m_global_lights(m_allocator)
 		, m_debug_lines(m_allocator)
 		, m_debug_points(m_allocator)
+		, m_renderable_positions(m_allocator)
+		, m_renderable_lods(m_allocator)
+		, m_is_renderable_dynamic(m_allocator)
+		, m_renderable_lod_states(m_allocator)
+		, m_is_renderable_batched(m_allocator)
+		, m_static_batches(m_allocator)
+		, m_static_batch_members(m_allocator)
+		, m_static_batch_renderables(m_allocator)
+		, m_model_imposters(m_allocator)
+		, m_has_lod_reference(false)
+		, m_lod_reference_position(0, 0, 0)
+		, m_lod_distance_scale(1)
+		, m_is_lod_cross_fade_enabled(false)
 		, m_temporary_infos(m_allocator)
-		, m_sync_point(true, m_allocator)
-		, m_jobs(m_allocator)
+		, m_static_render_lists(m_allocator)
+		, m_next_static_render_list(0)
+		, m_culled_frustums(m_allocator)
+		, m_culled_results(m_allocator)
+		, m_occlusion_buffer(m_allocator)
+		, m_occlusion_results(m_allocator)
 		, m_active_global_light_uid(-1)
 		, m_global_light_last_uid(-1)
 		, m_point_light_last_uid(-1)
@@ -212,19 +345,37 @@ public:
 		, m_renderable_created(m_allocator)
 		, m_renderable_destroyed(m_allocator)
 		, m_is_grass_enabled(true)
+		, m_is_gpu_grass_enabled(false)
 		, m_is_game_running(false)
 		, m_particle_emitters(m_allocator)
+		, m_particle_ranges(m_allocator)
+		, m_particle_effect_pools(m_allocator)
+		, m_particle_effects(m_allocator)
+		, m_particle_effect_templates(m_allocator)
+		, m_is_particle_culling_enabled(true)
 		, m_point_lights_map(m_allocator)
 		, m_render_params_float(m_allocator)
 		, m_render_params_vec4(m_allocator)
 	{
-		m_universe.entityTransformed()
-			.bind<RenderSceneImpl, &RenderSceneImpl::onEntityMoved>(this);
+		m_universe.entitiesTransformed()
+			.bind<RenderSceneImpl, &RenderSceneImpl::onEntitiesMoved>(this);
 		m_culling_system =
 			CullingSystem::create(m_engine.getMTJDManager(), m_allocator);
+		m_culling_system->enableAABBTest(true);
+		m_static_batch_culling_system =
+			CullingSystem::create(m_engine.getMTJDManager(), m_allocator);
 		m_time = 0;
+		m_frame = 0;
+		m_model_eviction_version = 0;
 		m_renderables.reserve(5000);
 		m_render_params_entity = INVALID_ENTITY;
+		for (int i = 0; i < MAX_STATIC_RENDER_LISTS; ++i)
+		{
+			StaticRenderList& list = m_static_render_lists.emplace(m_allocator);
+			list.is_valid = false;
+			list.has_infos = false;
+			list.static_count = 0;
+		}
 	}
 
 
@@ -233,19 +384,30 @@ public:
 		auto& rm = m_engine.getResourceManager();
 		auto* material_manager = static_cast<MaterialManager*>(rm.get(ResourceManager::MATERIAL));
 
-		m_universe.entityTransformed()
-			.unbind<RenderSceneImpl, &RenderSceneImpl::onEntityMoved>(this);
+		m_universe.entitiesTransformed()
+			.unbind<RenderSceneImpl, &RenderSceneImpl::onEntitiesMoved>(this);
 
 		for (int i = 0; i < m_model_loaded_callbacks.size(); ++i)
 		{
 			LUMIX_DELETE(m_allocator, m_model_loaded_callbacks[i]);
 		}
 
+		for (Shader* shader : m_precached_shaders)
+		{
+			rm.get(ResourceManager::SHADER)->unload(*shader);
+		}
+
 		for (int i = 0; i < m_terrains.size(); ++i)
 		{
 			LUMIX_DELETE(m_allocator, m_terrains[i]);
 		}
 
+		clearParticleEffects();
+		clearStaticBatches();
+		for (ModelImposter& imposter : m_model_imposters)
+		{
+			destroyImposterQuad(imposter);
+		}
 		for (int i = 0; i < m_particle_emitters.size(); ++i)
 		{
 			LUMIX_DELETE(m_allocator, m_particle_emitters[i]);
@@ -263,6 +425,7 @@ public:
 		}
 
 		CullingSystem::destroy(*m_culling_system);
+		CullingSystem::destroy(*m_static_batch_culling_system);
 	}
 
 
@@ -516,6 +679,8 @@ public:
 	{
 		PROFILE_FUNCTION();
 		m_time += dt;
+		++m_frame;
+		m_culled_frustums.clear();
 		for (int i = m_debug_lines.size() - 1; i >= 0; --i)
 		{
 			float life = m_debug_lines[i].m_life;
@@ -544,15 +709,208 @@ public:
 			}
 		}
 
-		if (m_is_game_running && !paused)
+		if (m_is_game_running && !paused) updateParticleEmitters(dt);
+	}
+
+
+	bool isParticleEmitterVisible(const ParticleEmitter& emitter,
+		const Frustum* frustums,
+		int frustum_count) const
+	{
+		if (frustum_count == 0) return true;
+
+		Vec3 center = (emitter.m_bounds.getMin() + emitter.m_bounds.getMax()) * 0.5f;
+		float radius = (emitter.m_bounds.getMax() - center).length();
+		for (int i = 0; i < frustum_count; ++i)
+		{
+			if (frustums[i].isSphereInside(center, radius)) return true;
+		}
+		return false;
+	}
+
+
+	// spawning changes the particle count so it runs per emitter on this thread, the rest is
+	// split to ranges of particles updated on workers
+	void updateParticleEmitters(float dt)
+	{
+		PROFILE_FUNCTION();
+		static const int MAX_FRUSTUMS = 8;
+		static const int PARTICLES_PER_JOB = 1024;
+
+		Frustum frustums[MAX_FRUSTUMS];
+		int frustum_count = 0;
+		for (int i = 0; m_is_particle_culling_enabled && i < m_cameras.size(); ++i)
+		{
+			const Camera& camera = m_cameras[i];
+			if (camera.m_is_free || !camera.m_is_active) continue;
+			if (frustum_count == MAX_FRUSTUMS) break;
+			frustums[frustum_count] = getCameraFrustum(i);
+			++frustum_count;
+		}
+
+		m_particle_ranges.clear();
+		auto update_spawning = [&](ParticleEmitter* emitter) {
+			if (!emitter) return;
+			if (!isParticleEmitterVisible(*emitter, frustums, frustum_count)) return;
+			if (emitter->isGPUSimulated())
+			{
+				emitter->updateGPU(dt);
+				return;
+			}
+
+			emitter->updateSpawning(dt);
+			int count = emitter->m_life.size();
+			if (count == 0) emitter->m_bounds = emitter->getBounds(0, 0);
+			for (int from = 0; from < count; from += PARTICLES_PER_JOB)
+			{
+				ParticleRange& range = m_particle_ranges.emplace();
+				range.emitter = emitter;
+				range.from = from;
+				range.to = Math::minValue(from + PARTICLES_PER_JOB, count);
+			}
+		};
+		for (auto* emitter : m_particle_emitters) update_spawning(emitter);
+		for (auto* emitter : m_particle_effects) update_spawning(emitter);
+
+		MTJD::parallelFor(m_engine.getMTJDManager(),
+			0,
+			m_particle_ranges.size(),
+			1,
+			[this, dt](int from, int to) {
+				for (int i = from; i < to; ++i)
+				{
+					ParticleRange& range = m_particle_ranges[i];
+					range.emitter->updateParticles(dt, range.from, range.to);
+					range.bounds = range.emitter->getBounds(range.from, range.to);
+				}
+			});
+
+		for (const ParticleRange& range : m_particle_ranges)
+		{
+			if (range.from == 0)
+			{
+				range.emitter->m_bounds = range.bounds;
+			}
+			else
+			{
+				range.emitter->m_bounds.merge(range.bounds);
+			}
+		}
+
+		releaseFinishedParticleEffects();
+	}
+
+
+	int getParticleEffectPool(ComponentIndex template_emitter)
+	{
+		for (int i = 0; i < m_particle_effect_pools.size(); ++i)
+		{
+			if (m_particle_effect_pools[i].template_emitter == template_emitter) return i;
+		}
+		return -1;
+	}
+
+
+	void spawnParticleEffect(ComponentIndex template_emitter, const Vec3& pos) override
+	{
+		ParticleEmitter* tpl = m_particle_emitters[template_emitter];
+		if (!tpl) return;
+
+		int pool_idx = getParticleEffectPool(template_emitter);
+		if (pool_idx < 0)
+		{
+			pool_idx = m_particle_effect_pools.size();
+			m_particle_effect_pools.emplace(m_allocator).template_emitter = template_emitter;
+		}
+		auto& free_emitters = m_particle_effect_pools[pool_idx].free_emitters;
+
+		ParticleEmitter* emitter;
+		if (free_emitters.empty())
+		{
+			// the template is copied when the pool grows, later changes of it affect only
+			// new instances
+			OutputBlob blob(m_allocator);
+			tpl->serialize(blob);
+			InputBlob input(blob);
+			emitter = LUMIX_NEW(m_allocator, ParticleEmitter)(
+				INVALID_ENTITY, m_universe, m_allocator);
+			emitter->deserialize(input, m_engine.getResourceManager(), true);
+			emitter->m_entity = INVALID_ENTITY;
+			if (emitter->isGPUSimulated()) emitter->setGPUSimulated(false);
+		}
+		else
+		{
+			emitter = free_emitters.back();
+			free_emitters.pop();
+		}
+		emitter->startOneShot(pos);
+		m_particle_effects.push(emitter);
+		m_particle_effect_templates.push(template_emitter);
+	}
+
+
+	const Array<ParticleEmitter*>& getParticleEffects() const override
+	{
+		return m_particle_effects;
+	}
+
+
+	void releaseFinishedParticleEffects()
+	{
+		for (int i = m_particle_effects.size() - 1; i >= 0; --i)
 		{
-			for (auto* emitter : m_particle_emitters)
+			ParticleEmitter* emitter = m_particle_effects[i];
+			if (!emitter->isOneShotFinished()) continue;
+
+			int pool_idx = getParticleEffectPool(m_particle_effect_templates[i]);
+			if (pool_idx >= 0)
 			{
-				if (!emitter) continue;
+				m_particle_effect_pools[pool_idx].free_emitters.push(emitter);
+			}
+			else
+			{
+				LUMIX_DELETE(m_allocator, emitter);
+			}
+			m_particle_effects.eraseFast(i);
+			m_particle_effect_templates.eraseFast(i);
+		}
+	}
+
+
+	// running effects of the template finish, then they are deleted
+	void destroyParticleEffectPool(ComponentIndex template_emitter)
+	{
+		int pool_idx = getParticleEffectPool(template_emitter);
+		if (pool_idx < 0) return;
+
+		for (auto* emitter : m_particle_effect_pools[pool_idx].free_emitters)
+		{
+			LUMIX_DELETE(m_allocator, emitter);
+		}
+		m_particle_effect_pools.eraseFast(pool_idx);
+		for (auto& effect_template : m_particle_effect_templates)
+		{
+			if (effect_template == template_emitter) effect_template = INVALID_COMPONENT;
+		}
+	}
+
 
-				emitter->update(dt);
+	void clearParticleEffects()
+	{
+		for (auto& pool : m_particle_effect_pools)
+		{
+			for (auto* emitter : pool.free_emitters)
+			{
+				LUMIX_DELETE(m_allocator, emitter);
 			}
 		}
+		m_particle_effect_pools.clear();
+		for (auto* emitter : m_particle_effects)
+		{
+			LUMIX_DELETE(m_allocator, emitter);
+		}
+		m_particle_effects.clear();
+		m_particle_effect_templates.clear();
 	}
 
 	void serializeRenderParams(OutputBlob& serializer)
@@ -625,6 +983,7 @@ public:
 						serializer.writeString(r.meshes[i].material->getPath().c_str());
 					}
 				}
+				serializer.write(r.is_occluder);
 			}
 			
 		}
@@ -650,6 +1009,7 @@ public:
 
 	void deserializeParticleEmitters(InputBlob& serializer, int version)
 	{
+		clearParticleEffects();
 		int count;
 		serializer.read(count);
 		m_particle_emitters.resize(count);
@@ -792,6 +1152,7 @@ public:
 	{
 		int32 size = 0;
 		serializer.read(size);
+		clearStaticBatches();
 		for (int i = 0; i < m_renderables.size(); ++i)
 		{
 			if (m_renderables[i].entity != INVALID_ENTITY)
@@ -800,8 +1161,20 @@ public:
 			}
 		}
 		m_culling_system->clear();
+		m_culled_frustums.clear();
+		invalidateStaticRenderLists();
 		m_renderables.clear();
 		m_renderables.reserve(size);
+		m_renderable_positions.clear();
+		m_renderable_positions.reserve(size);
+		m_renderable_lods.clear();
+		m_renderable_lods.reserve(size);
+		m_is_renderable_dynamic.clear();
+		m_is_renderable_dynamic.reserve(size);
+		m_renderable_lod_states.clear();
+		m_renderable_lod_states.reserve(size);
+		m_is_renderable_batched.clear();
+		m_is_renderable_batched.reserve(size);
 		for (int i = 0; i < size; ++i)
 		{
 			auto& r = m_renderables.emplace();
@@ -812,6 +1185,16 @@ public:
 			r.custom_meshes = false;
 			r.meshes = nullptr;
 			r.mesh_count = 0;
+			r.is_occluder = false;
+			m_is_renderable_dynamic.push(false);
+			m_renderable_positions.emplace();
+			RenderableLODs& lods = m_renderable_lods.emplace();
+			lods.meshes = nullptr;
+			lods.model = nullptr;
+			lods.imposter_lod = -1;
+			lods.imposter = nullptr;
+			m_renderable_lod_states.emplace().lod = -1;
+			m_is_renderable_batched.push(false);
 
 			if(r.entity != INVALID_ENTITY)
 			{
@@ -847,6 +1230,11 @@ public:
 					}
 				}
 
+				if (version > RenderSceneVersion::RENDERABLE_OCCLUDER)
+				{
+					serializer.read(r.is_occluder);
+				}
+
 				m_universe.addComponent(r.entity, RENDERABLE_HASH, this, r.entity);
 			}
 		}
@@ -859,9 +1247,11 @@ public:
 		m_point_lights_map.clear();
 		m_point_lights.resize(size);
 		m_light_influenced_geometry.clear();
+		m_point_light_shadow_versions.clear();
 		for (int i = 0; i < size; ++i)
 		{
 			m_light_influenced_geometry.push(Array<int>(m_allocator));
+			m_point_light_shadow_versions.push(++m_last_shadow_version);
 			PointLight& light = m_point_lights[i];
 			if (version > RenderSceneVersion::SPECULAR_INTENSITY)
 			{
@@ -1003,6 +1393,7 @@ public:
 		LUMIX_DELETE(m_allocator, m_renderables[component].pose);
 		m_renderables[component].pose = nullptr;
 		m_renderables[component].entity = INVALID_ENTITY;
+		m_is_renderable_dynamic[component] = false;
 		m_universe.destroyComponent(entity, RENDERABLE_HASH, this, component);
 	}
 
@@ -1028,6 +1419,7 @@ public:
 		m_point_lights.eraseFast(index);
 		m_point_lights_map.erase(component);
 		m_light_influenced_geometry.eraseFast(index);
+		m_point_light_shadow_versions.eraseFast(index);
 		m_universe.destroyComponent(entity, POINT_LIGHT_HASH, this, component);
 	}
 
@@ -1051,6 +1443,7 @@ public:
 
 	void destroyParticleEmitter(ComponentIndex component)
 	{
+		destroyParticleEffectPool(component);
 		Entity entity = m_particle_emitters[component]->m_entity;
 		LUMIX_DELETE(m_allocator, m_particle_emitters[component]);
 		m_particle_emitters[component] = nullptr;
@@ -1429,6 +1822,18 @@ public:
 	}
 
 
+	bool isParticleEmitterGPUSimulated(ComponentIndex cmp) override
+	{
+		return m_particle_emitters[cmp]->isGPUSimulated();
+	}
+
+
+	void setParticleEmitterGPUSimulated(ComponentIndex cmp, bool value) override
+	{
+		m_particle_emitters[cmp]->setGPUSimulated(value);
+	}
+
+
 	void setParticleEmitterSpawnPeriod(ComponentIndex cmp, const Vec2& value) override
 	{
 		m_particle_emitters[cmp]->m_spawn_period = value;
@@ -1641,7 +2046,8 @@ public:
 
 	Renderable* getRenderable(ComponentIndex cmp) override
 	{
-		return &m_renderables[cmp];
+		if (cmp & STATIC_BATCH_FLAG) return &m_static_batches[cmp & ~STATIC_BATCH_FLAG];
+		return &m_renderables[cmp & ~IMPOSTER_FLAG];
 	}
 
 
@@ -1654,19 +2060,13 @@ public:
 	}
 
 
-	Frustum getPointLightFrustum(ComponentIndex index) const
+	void onEntitiesMoved(const Entity* entities, int count)
 	{
-		const PointLight& light = m_point_lights[index];
-		Frustum frustum;
-		frustum.computeOrtho(m_universe.getPosition(light.m_entity),
-							 Vec3(1, 0, 0),
-							 Vec3(0, 1, 0),
-							 2.0f * light.m_range,
-							 2.0f * light.m_range,
-							 -light.m_range,
-							 light.m_range);
-
-		return frustum;
+		PROFILE_FUNCTION();
+		for (int i = 0; i < count; ++i)
+		{
+			onEntityMoved(entities[i]);
+		}
 	}
 
 
@@ -1677,34 +2077,48 @@ public:
 		if (cmp < m_renderables.size() && m_renderables[cmp].entity != INVALID_ENTITY &&
 			m_renderables[cmp].model && m_renderables[cmp].model->isReady())
 		{
+			breakStaticBatches(cmp);
 			Renderable& r = m_renderables[cmp];
 			r.matrix = m_universe.getMatrix(entity);
+			Sphere old_sphere = m_culling_system->getSphere(cmp);
+			invalidatePointLightShadows(old_sphere);
 			m_culling_system->updateBoundingPosition(m_universe.getPosition(entity), cmp);
+			m_renderable_positions[cmp] = r.matrix.getTranslation();
+			invalidateFrameRenderLists();
+			if (!m_is_renderable_dynamic[cmp])
+			{
+				// moved once, it will likely move again, so it's kept out of static render lists
+				m_is_renderable_dynamic[cmp] = true;
+				invalidateStaticRenderLists();
+			}
 			if (r.model && r.model->isReady())
 			{
 				float radius = m_universe.getScale(entity) * r.model->getBoundingRadius();
 				m_culling_system->updateBoundingRadius(radius, cmp);
+				m_renderable_lods[cmp].radius = radius;
+				updateCullingAABB(cmp);
 			}
+			Sphere sphere = m_culling_system->getSphere(cmp);
+			invalidatePointLightShadows(sphere);
 
 			if(m_is_forward_rendered)
 			{
-				float bounding_radius = r.model ? r.model->getBoundingRadius() : 1;
+				// only lights touched by the old or the new bounds have to be updated
 				for (int light_idx = 0, c = m_point_lights.size(); light_idx < c; ++light_idx)
 				{
-					for (int j = 0, c2 = m_light_influenced_geometry[light_idx].size(); j < c2; ++j)
+					Sphere light_sphere = getPointLightSphere(light_idx);
+					bool was_influenced = intersects(light_sphere, old_sphere);
+					bool is_influenced = intersects(light_sphere, sphere);
+					if (was_influenced == is_influenced) continue;
+
+					Array<ComponentIndex>& influenced_geometry = m_light_influenced_geometry[light_idx];
+					if (is_influenced)
 					{
-						if(m_light_influenced_geometry[light_idx][j] == cmp)
-						{
-							m_light_influenced_geometry[light_idx].eraseFast(j);
-							break;
-						}
+						influenced_geometry.push(cmp);
 					}
-
-					Vec3 pos = m_universe.getPosition(r.entity);
-					Frustum frustum = getPointLightFrustum(light_idx);
-					if(frustum.isSphereInside(pos, bounding_radius))
+					else
 					{
-						m_light_influenced_geometry[light_idx].push(cmp);
+						influenced_geometry.eraseItemFast(cmp);
 					}
 				}
 			}
@@ -1715,6 +2129,7 @@ public:
 			if (m_point_lights[i].m_entity == entity)
 			{
 				detectLightInfluencedGeometry(i);
+				m_point_light_shadow_versions[i] = ++m_last_shadow_version;
 				break;
 			}
 		}
@@ -1749,6 +2164,45 @@ public:
 	}
 
 
+	void getTerrainHeights(ComponentIndex cmp, const Vec2* xz, float* out, int count) override
+	{
+		m_terrains[cmp]->getHeights(xz, out, count);
+	}
+
+
+	// Renderer.getTerrainHeights(scene, cmp, {x0, z0, x1, z1, ...}) returns {h0, h1, ...}
+	static int LUA_getTerrainHeights(lua_State* L)
+	{
+		auto* scene = LuaWrapper::checkArg<RenderSceneImpl*>(L, 1);
+		ComponentIndex cmp = LuaWrapper::checkArg<int>(L, 2);
+		LuaWrapper::checkTableArg(L, 3);
+		int count = (int)lua_rawlen(L, 3) / 2;
+
+		static const int BATCH_SIZE = 256;
+		Vec2 xz[BATCH_SIZE];
+		float heights[BATCH_SIZE];
+		lua_createtable(L, count, 0);
+		for (int i = 0; i < count; i += BATCH_SIZE)
+		{
+			int batch_count = Math::minValue(BATCH_SIZE, count - i);
+			for (int j = 0; j < batch_count; ++j)
+			{
+				lua_rawgeti(L, 3, (i + j) * 2 + 1);
+				lua_rawgeti(L, 3, (i + j) * 2 + 2);
+				xz[j].set((float)lua_tonumber(L, -2), (float)lua_tonumber(L, -1));
+				lua_pop(L, 2);
+			}
+			scene->getTerrainHeights(cmp, xz, heights, batch_count);
+			for (int j = 0; j < batch_count; ++j)
+			{
+				lua_pushnumber(L, heights[j]);
+				lua_rawseti(L, -2, i + j + 1);
+			}
+		}
+		return 1;
+	}
+
+
 	void getTerrainSize(ComponentIndex cmp, float* width, float* height) override
 	{
 		m_terrains[cmp]->getSize(width, height);
@@ -1814,6 +2268,15 @@ public:
 	Model* getRenderableModel(ComponentIndex cmp) override { return m_renderables[cmp].model; }
 
 
+	int getRenderableVisibleLOD(ComponentIndex cmp) override
+	{
+		const RenderableLODState& state = m_renderable_lod_states[cmp];
+		// culling of this frame may not have happened yet
+		if (state.lod < 0 || state.visible_frame + 1 < m_frame) return -1;
+		return state.lod;
+	}
+
+
 	void showRenderable(ComponentIndex cmp) override
 	{
 		if (!m_renderables[cmp].model || !m_renderables[cmp].model->isReady()) return;
@@ -1821,12 +2284,28 @@ public:
 		Sphere sphere(m_universe.getPosition(m_renderables[cmp].entity),
 			m_renderables[cmp].model->getBoundingRadius());
 		m_culling_system->addStatic(cmp, sphere);
+		updateCullingAABB(cmp);
+		invalidateStaticRenderLists();
+		invalidatePointLightShadows(sphere);
+	}
+
+
+	void updateCullingAABB(ComponentIndex cmp)
+	{
+		const Renderable& r = m_renderables[cmp];
+		AABB aabb = r.model->getAABB();
+		aabb.transform(r.matrix);
+		m_culling_system->setAABB(cmp, aabb);
 	}
 
 
 	void hideRenderable(ComponentIndex cmp) override
 	{
+		breakStaticBatches(cmp);
+		invalidatePointLightShadows(cmp);
 		m_culling_system->removeStatic(cmp);
+		m_culled_frustums.clear();
+		invalidateStaticRenderLists();
 	}
 
 
@@ -1836,9 +2315,24 @@ public:
 	}
 
 
+	void setRenderableOccluder(ComponentIndex cmp, bool is_occluder) override
+	{
+		m_renderables[cmp].is_occluder = is_occluder;
+	}
+
+
+	bool isRenderableOccluder(ComponentIndex cmp) override
+	{
+		return m_renderables[cmp].is_occluder;
+	}
+
+
 	void setRenderableLayer(ComponentIndex cmp, const int32& layer) override
 	{
+		breakStaticBatches(cmp);
 		m_culling_system->setLayerMask(cmp, (int64)1 << (int64)layer);
+		invalidateStaticRenderLists();
+		invalidatePointLightShadows(cmp);
 	}
 
 
@@ -1869,9 +2363,9 @@ public:
 	void forceGrassUpdate(ComponentIndex cmp) override { m_terrains[cmp]->forceGrassUpdate(); }
 
 
-	void getTerrainInfos(Array<const TerrainInfo*>& infos,
-		const Vec3& camera_pos,
-		LIFOAllocator& frame_allocator) override
+	void getTerrainInfos(const Frustum& frustum,
+		const Vec3& lod_ref_point,
+		Array<const TerrainInfo*>& infos) override
 	{
 		PROFILE_FUNCTION();
 		infos.reserve(m_terrains.size());
@@ -1879,7 +2373,7 @@ public:
 		{
 			if (m_terrains[i])
 			{
-				m_terrains[i]->getInfos(infos, camera_pos, frame_allocator);
+				m_terrains[i]->getInfos(frustum, lod_ref_point, infos);
 			}
 		}
 	}
@@ -1897,7 +2391,14 @@ public:
 		{
 			if (m_terrains[i])
 			{
-				m_terrains[i]->getGrassInfos(frustum, infos, camera);
+				if (m_is_gpu_grass_enabled)
+				{
+					m_terrains[i]->getGPUGrassInfos(infos, camera);
+				}
+				else
+				{
+					m_terrains[i]->getGrassInfos(frustum, infos, camera);
+				}
 			}
 		}
 	}
@@ -1927,11 +2428,47 @@ public:
 		REGISTER_FUNCTION(getFogBottom);
 		REGISTER_FUNCTION(getFogHeight);
 		REGISTER_FUNCTION(getFogColor);
+		REGISTER_FUNCTION(precacheShader);
+		REGISTER_FUNCTION(getTerrainHeightAt);
+		REGISTER_FUNCTION(spawnParticleEffect);
+		REGISTER_FUNCTION(buildStaticBatches);
+		REGISTER_FUNCTION(clearStaticBatches);
+		REGISTER_FUNCTION(setModelImposter);
+		LuaWrapper::createSystemFunction(
+			L, "Renderer", "getTerrainHeights", &RenderSceneImpl::LUA_getTerrainHeights);
 
 		#undef REGISTER_FUNCTION
 	}
 
 
+	// shader instances are created when a material needs them, level scripts can ask for the
+	// combinations they expect, e.g. Renderer.precacheShader(g_scene_renderer,
+	// "shaders/rigid.shd", "SKINNED NORMAL_MAPPING"), the shader is kept loaded with the scene
+	void precacheShader(const char* path, const char* defines)
+	{
+		uint32 mask = 0;
+		const char* define = defines;
+		while (*define)
+		{
+			char tmp[32];
+			int len = 0;
+			while (define[len] && define[len] != ' ') ++len;
+			if (len > 0 && len < lengthOf(tmp))
+			{
+				copyNString(tmp, sizeof(tmp), define, len);
+				mask |= 1 << m_renderer.getShaderDefineIdx(tmp);
+			}
+			define += len;
+			while (*define == ' ') ++define;
+		}
+
+		auto* shader_manager = m_engine.getResourceManager().get(ResourceManager::SHADER);
+		Shader* shader = static_cast<Shader*>(shader_manager->load(Path(path)));
+		m_precached_shaders.push(shader);
+		shader->precache(mask);
+	}
+
+
 	void sendMessage(uint32 type, void*) override
 	{
 		static const uint32 register_hash = crc32("registerLuaAPI");
@@ -1966,6 +2503,30 @@ public:
 	}
 
 
+	bool isGPUGrassEnabled() const override
+	{
+		return m_is_gpu_grass_enabled;
+	}
+
+
+	void enableGPUGrass(bool enabled) override
+	{
+		m_is_gpu_grass_enabled = enabled;
+	}
+
+
+	bool isParticleCullingEnabled() const override
+	{
+		return m_is_particle_culling_enabled;
+	}
+
+
+	void enableParticleCulling(bool enabled) override
+	{
+		m_is_particle_culling_enabled = enabled;
+	}
+
+
 	void
 	setGrassDensity(ComponentIndex cmp, int index, int density) override
 	{
@@ -2038,91 +2599,327 @@ public:
 	}
 
 
+	void cullFrustums(const Frustum* frustums, int count) override
+	{
+		PROFILE_FUNCTION();
+		if (m_renderables.empty() || count <= 0) return;
+
+		Array<Frustum> new_frustums(m_allocator);
+		new_frustums.reserve(count);
+		for (int i = 0; i < count; ++i)
+		{
+			if (!isFrustumCulled(frustums[i])) new_frustums.push(frustums[i]);
+		}
+		if (new_frustums.empty()) return;
+
+		int offset = m_culled_frustums.size();
+		while (m_culled_results.size() < offset + new_frustums.size())
+		{
+			m_culled_results.emplace(m_allocator);
+		}
+		m_culling_system->cullToFrustums(
+			&new_frustums[0], new_frustums.size(), ~0UL, &m_culled_results[offset]);
+		for (const Frustum& frustum : new_frustums)
+		{
+			m_culled_frustums.push(frustum);
+		}
+	}
+
+
+	bool isFrustumCulled(const Frustum& frustum) const
+	{
+		for (const Frustum& culled : m_culled_frustums)
+		{
+			if (compareMemory(&culled, &frustum, sizeof(frustum)) == 0) return true;
+		}
+		return false;
+	}
+
+
 	const CullingSystem::Results* cull(const Frustum& frustum)
 	{
 		PROFILE_FUNCTION();
 		if (m_renderables.empty()) return nullptr;
 
+		for (int i = 0; i < m_culled_frustums.size(); ++i)
+		{
+			if (compareMemory(&m_culled_frustums[i], &frustum, sizeof(frustum)) == 0)
+			{
+				return &m_culled_results[i];
+			}
+		}
+
 		m_culling_system->cullToFrustumAsync(frustum, ~0UL);
 		return &m_culling_system->getResult();
 	}
 
 	
-	void runJobs(Array<MTJD::Job*>& jobs, MTJD::Group& sync_point)
+	void fillTemporaryInfos(const CullingSystem::Results& results, const Frustum& frustum)
 	{
-		PROFILE_FUNCTION();
-		for (int i = 0; i < jobs.size(); ++i)
-		{
-			m_engine.getMTJDManager().schedule(jobs[i]);
-		}
-		if (!jobs.empty())
-		{
-			sync_point.sync();
-		}
+		fillInfos(results, frustum, RenderableFilter::ALL, m_temporary_infos, 0, nullptr);
+		addStaticBatchInfos(frustum, frustum.getPosition(), m_temporary_infos);
 	}
 
 
-	void fillTemporaryInfos(const CullingSystem::Results& results, const Frustum& frustum)
+	// fills infos[offset + i] from results[i], infos are resized to offset + results.size();
+	// if fading is not null, cross-fading renderables are put there instead of to infos
+	void fillInfos(const CullingSystem::Results& results,
+		const Frustum& frustum,
+		RenderableFilter filter,
+		Array<Array<RenderableMesh>>& infos,
+		int offset,
+		CullingSystem::Results* fading)
 	{
 		PROFILE_FUNCTION();
-		m_jobs.clear();
-
-		while (m_temporary_infos.size() < results.size())
+		while (infos.size() < offset + results.size())
 		{
-			m_temporary_infos.emplace(m_allocator);
+			infos.emplace(m_allocator);
 		}
-		while (m_temporary_infos.size() > results.size())
+		while (infos.size() > offset + results.size())
 		{
-			m_temporary_infos.pop();
+			infos.pop();
 		}
-		for (int subresult_index = 0; subresult_index < results.size(); ++subresult_index)
+		if (fading)
 		{
-			Array<RenderableMesh>& subinfos = m_temporary_infos[subresult_index];
-			subinfos.clear();
-			if (results[subresult_index].empty()) continue;
+			while (fading->size() < results.size())
+			{
+				fading->emplace(m_allocator);
+			}
+			while (fading->size() > results.size())
+			{
+				fading->pop();
+			}
+		}
 
-			MTJD::Job* job = MTJD::makeJob(m_engine.getMTJDManager(),
-				[&subinfos, this, &results, subresult_index, &frustum]()
+		MTJD::parallelFor(m_engine.getMTJDManager(),
+			0,
+			results.size(),
+			1,
+			[this, &results, &frustum, filter, &infos, offset, fading](int from, int to)
+			{
+				for (int subresult_index = from; subresult_index < to; ++subresult_index)
 				{
-					PROFILE_BLOCK("Temporary Info Job");
-					PROFILE_INT("Renderable count", results[subresult_index].size());
-					Vec3 frustum_position = frustum.getPosition();
-					const int* LUMIX_RESTRICT raw_subresults = &results[subresult_index][0];
-					Renderable* LUMIX_RESTRICT renderables = &m_renderables[0];
-					for (int i = 0, c = results[subresult_index].size(); i < c; ++i)
-					{
-						Renderable* LUMIX_RESTRICT renderable = &renderables[raw_subresults[i]];
-						Model* LUMIX_RESTRICT model = renderable->model;
-						float squared_distance =
-							(renderable->matrix.getTranslation() - frustum_position)
-								.squaredLength();
-
-						LODMeshIndices lod = model->getLODMeshIndices(squared_distance);
-						for (int j = lod.from, c = lod.to; j <= c; ++j)
-						{
-							auto& info = subinfos.emplace();
-							info.renderable = raw_subresults[i];
-							info.mesh = &renderable->meshes[j];
-						}
-					}
-				},
-				m_allocator);
-			job->addDependency(&m_sync_point);
-			m_jobs.push(job);
-		}
-		runJobs(m_jobs, m_sync_point);
+					fillTemporaryInfo(results[subresult_index],
+						frustum,
+						filter,
+						infos[offset + subresult_index],
+						fading ? &(*fading)[subresult_index] : nullptr);
+				}
+			});
 	}
 
 
-	int getClosestPointLights(const Vec3& reference_pos,
-									   ComponentIndex* lights,
-									   int max_lights) override
+	static uint64 getSortKey(uint32 model_hash, const Mesh& mesh, float squared_distance)
 	{
+		// positive floats keep their order when compared as integers
+		uint32 depth;
+		copyMemory(&depth, &squared_distance, sizeof(depth));
+		const Material* material = mesh.material;
+		uint64 shader_hash = material->getShader() ? material->getShader()->getPath().getHash() : 0;
+		uint64 material_hash = material->getPath().getHash();
 
-		float dists[16];
-		ASSERT(max_lights <= lengthOf(dists));
-		ASSERT(max_lights > 0);
-		if (m_point_lights.empty()) return 0;
+		if (material->getRenderStates() & BGFX_STATE_BLEND_MASK)
+		{
+			return (1ULL << 63) | ((uint64)(~depth >> 1) << 32) | ((shader_hash & 0xffff) << 16) |
+				   (material_hash & 0xffff);
+		}
+		// consecutive meshes of a model differ in the lowest bits, so equal meshes end up next to
+		// each other and the pipeline can draw them instanced
+		uint64 mesh_hash = ((model_hash & 0xfff) << 4) | (((uintptr)&mesh / sizeof(Mesh)) & 0xf);
+		return ((shader_hash & 0x7fff) << 48) | ((material_hash & 0xffff) << 32) | (mesh_hash << 16) |
+			   (depth >> 16);
+	}
+
+
+	// picks LOD by squared distance already scaled to the reference screen size, LOD is kept
+	// while the distance is inside the hysteresis band around the border of the current LOD
+	int selectLOD(const RenderableLODs& lods, RenderableLODState& state, float squared_distance)
+	{
+		int lod = 0;
+		while (squared_distance >= lods.squared_distances[lod])
+		{
+			++lod;
+		}
+		if (state.lod < 0)
+		{
+			state.lod = state.previous_lod = (int8)lod;
+			return lod;
+		}
+
+		const float coarser_factor = (1 + LOD_HYSTERESIS) * (1 + LOD_HYSTERESIS);
+		const float finer_factor = (1 - LOD_HYSTERESIS) * (1 - LOD_HYSTERESIS);
+		while (lod > state.lod && squared_distance < lods.squared_distances[lod - 1] * coarser_factor)
+		{
+			--lod;
+		}
+		while (lod < state.lod && squared_distance >= lods.squared_distances[lod] * finer_factor)
+		{
+			++lod;
+		}
+		if (lod != state.lod)
+		{
+			state.previous_lod = m_is_lod_cross_fade_enabled ? state.lod : (int8)lod;
+			state.lod = (int8)lod;
+			state.change_time = m_time;
+		}
+		return lod;
+	}
+
+
+	// returns the visible part of the new LOD while cross-fading, 0 otherwise
+	float getLODFade(RenderableLODState& state) const
+	{
+		if (state.previous_lod == state.lod) return 0;
+
+		float t = (m_time - state.change_time) / LOD_FADE_DURATION;
+		if (!m_is_lod_cross_fade_enabled || t >= 1 || t < 0)
+		{
+			state.previous_lod = state.lod;
+			return 0;
+		}
+		return Math::maxValue(t, 0.001f);
+	}
+
+
+	static void addLODInfos(ComponentIndex renderable,
+		const RenderableLODs& lods,
+		int lod,
+		float lod_fade,
+		float squared_distance,
+		Array<RenderableMesh>& infos)
+	{
+		if (lod == lods.imposter_lod)
+		{
+			auto& info = infos.emplace();
+			info.renderable = IMPOSTER_FLAG | renderable;
+			info.mesh = &lods.imposter->getMesh(0);
+			info.lod_fade = lod_fade;
+			uint32 quad_hash = lods.imposter->getPath().getHash();
+			info.sort_key = getSortKey(quad_hash, *info.mesh, squared_distance);
+			return;
+		}
+		for (int j = lods.from_mesh[lod], c = lods.to_mesh[lod]; j <= c; ++j)
+		{
+			auto& info = infos.emplace();
+			info.renderable = renderable;
+			info.mesh = &lods.meshes[j];
+			info.lod_fade = lod_fade;
+			info.sort_key = getSortKey(lods.model_hash, *info.mesh, squared_distance);
+		}
+	}
+
+
+	static void requestTextureMips(const Material& material, float pixels)
+	{
+		for (int i = 0, texture_count = material.getTextureCount(); i < texture_count; ++i)
+		{
+			Texture* texture = material.getTexture(i);
+			if (texture) texture->requestMips(pixels);
+		}
+	}
+
+
+	// textures are streamed by the size of the renderable on the screen of the LOD reference view
+	static void requestTextureMips(const RenderableLODs& lods, int lod, float squared_distance)
+	{
+		float distance = Math::maxValue(sqrtf(squared_distance), lods.radius);
+		if (distance <= 0) return;
+		float pixels = lods.radius * TEXTURE_STREAMING_SCREEN_SCALE / distance;
+		if (lod == lods.imposter_lod)
+		{
+			requestTextureMips(*lods.imposter->getMesh(0).material, pixels);
+			return;
+		}
+		for (int j = lods.from_mesh[lod], c = lods.to_mesh[lod]; j <= c; ++j)
+		{
+			requestTextureMips(*lods.meshes[j].material, pixels);
+		}
+	}
+
+
+	// streamed models draw the finest LOD on the GPU until the selected one is uploaded
+	static int requestLOD(const RenderableLODs& lods, int lod)
+	{
+		if (lod == lods.imposter_lod) return lod;
+		return lods.model->requestLOD(lod);
+	}
+
+
+	void setLODReference(const Vec3& position, float distance_scale) override
+	{
+		m_has_lod_reference = true;
+		m_lod_reference_position = position;
+		m_lod_distance_scale = distance_scale * distance_scale;
+	}
+
+
+	void enableLODCrossFade(bool enable) override { m_is_lod_cross_fade_enabled = enable; }
+	bool isLODCrossFadeEnabled() const override { return m_is_lod_cross_fade_enabled; }
+
+
+	void fillTemporaryInfo(const CullingSystem::Subresults& subresults,
+		const Frustum& frustum,
+		RenderableFilter filter,
+		Array<RenderableMesh>& subinfos,
+		CullingSystem::Subresults* fading)
+	{
+		subinfos.clear();
+		if (fading) fading->clear();
+		if (subresults.empty()) return;
+
+		PROFILE_BLOCK("Temporary Info Job");
+		PROFILE_INT("Renderable count", subresults.size());
+		Vec3 frustum_position = frustum.getPosition();
+		Vec3 lod_position = m_has_lod_reference ? m_lod_reference_position : frustum_position;
+		float lod_distance_scale = m_has_lod_reference ? m_lod_distance_scale : 1;
+		const int* LUMIX_RESTRICT raw_subresults = &subresults[0];
+		const Vec3* LUMIX_RESTRICT positions = &m_renderable_positions[0];
+		const RenderableLODs* LUMIX_RESTRICT renderable_lods = &m_renderable_lods[0];
+		const bool* LUMIX_RESTRICT is_dynamic = &m_is_renderable_dynamic[0];
+		const bool* LUMIX_RESTRICT is_batched = &m_is_renderable_batched[0];
+		for (int i = 0, c = subresults.size(); i < c; ++i)
+		{
+			int renderable = raw_subresults[i];
+			// drawn by addStaticBatchInfos
+			if (is_batched[renderable]) continue;
+			if (filter == RenderableFilter::STATIC && is_dynamic[renderable]) continue;
+			if (filter == RenderableFilter::DYNAMIC && !is_dynamic[renderable]) continue;
+			float squared_distance = (positions[renderable] - frustum_position).squaredLength();
+			float lod_squared_distance =
+				(positions[renderable] - lod_position).squaredLength() * lod_distance_scale;
+
+			const RenderableLODs& lods = renderable_lods[renderable];
+			RenderableLODState& lod_state = m_renderable_lod_states[renderable];
+			int lod = selectLOD(lods, lod_state, lod_squared_distance);
+			lod_state.visible_frame = m_frame;
+			int resident_lod = requestLOD(lods, lod);
+			float fade = resident_lod == lod ? getLODFade(lod_state) : 0;
+			if ((fade > 0 || resident_lod != lod) && fading)
+			{
+				fading->push(renderable);
+				continue;
+			}
+
+			addLODInfos(renderable, lods, resident_lod, fade, squared_distance, subinfos);
+			requestTextureMips(lods, resident_lod, lod_squared_distance);
+			if (fade > 0)
+			{
+				int previous_lod = requestLOD(lods, lod_state.previous_lod);
+				addLODInfos(renderable, lods, previous_lod, -fade, squared_distance, subinfos);
+			}
+		}
+	}
+
+
+	int getClosestPointLights(const Vec3& reference_pos,
+									   ComponentIndex* lights,
+									   int max_lights) override
+	{
+
+		float dists[16];
+		ASSERT(max_lights <= lengthOf(dists));
+		ASSERT(max_lights > 0);
+		if (m_point_lights.empty()) return 0;
 
 		int light_count = 0;
 		for (auto light : m_point_lights)
@@ -2225,14 +3022,18 @@ public:
 		{
 			ComponentIndex renderable_cmp = m_light_influenced_geometry[light_index][j];
 			Renderable& renderable = m_renderables[renderable_cmp];
-			const Sphere& sphere = m_culling_system->getSphere(renderable_cmp);
+			Sphere sphere = m_culling_system->getSphere(renderable_cmp);
 			if (frustum.isSphereInside(sphere.m_position, sphere.m_radius))
 			{
+				float squared_distance = (sphere.m_position - frustum.getPosition()).squaredLength();
 				for (int k = 0, kc = renderable.model->getMeshCount(); k < kc; ++k)
 				{
 					auto& info = infos.emplace();
 					info.mesh = &renderable.model->getMesh(k);
 					info.renderable = renderable_cmp;
+					info.lod_fade = 0;
+					info.sort_key =
+						getSortKey(renderable.model->getPath().getHash(), *info.mesh, squared_distance);
 				}
 			}
 		}
@@ -2254,6 +3055,8 @@ public:
 				auto& info = infos.emplace();
 				info.mesh = &renderable.model->getMesh(k);
 				info.renderable = geoms[j];
+				info.lod_fade = 0;
+				info.sort_key = getSortKey(renderable.model->getPath().getHash(), *info.mesh, 0);
 			}
 		}
 	}
@@ -2276,19 +3079,773 @@ public:
 	}
 
 
+	// the receiver is in all splits its view depth range overlaps
+	static void addShadowReceiver(const Vec3* points,
+		int count,
+		const Frustum& camera_frustum,
+		const Matrix& light_space,
+		const float* split_distances,
+		int split_count,
+		AABB* bounds)
+	{
+		// frustums extend against their direction
+		const Vec3& camera_pos = camera_frustum.getPosition();
+		Vec3 camera_dir = -camera_frustum.getDirection();
+		float min_depth = FLT_MAX;
+		float max_depth = -FLT_MAX;
+		AABB light_space_bounds(Vec3(FLT_MAX, FLT_MAX, FLT_MAX), Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+		for (int i = 0; i < count; ++i)
+		{
+			float depth = dotProduct(points[i] - camera_pos, camera_dir);
+			min_depth = Math::minValue(min_depth, depth);
+			max_depth = Math::maxValue(max_depth, depth);
+			light_space_bounds.addPoint(light_space.multiplyPosition(points[i]));
+		}
+
+		for (int i = 0; i < split_count; ++i)
+		{
+			if (max_depth < split_distances[i] || min_depth > split_distances[i + 1]) continue;
+			bounds[i].merge(light_space_bounds);
+		}
+	}
+
+
+	static void addShadowReceiver(const Sphere& sphere,
+		const Frustum& camera_frustum,
+		const Matrix& light_space,
+		const float* split_distances,
+		int split_count,
+		AABB* bounds)
+	{
+		Vec3 radius(sphere.m_radius, sphere.m_radius, sphere.m_radius);
+		float depth = -dotProduct(sphere.m_position - camera_frustum.getPosition(),
+			camera_frustum.getDirection());
+		Vec3 center = light_space.multiplyPosition(sphere.m_position);
+		AABB light_space_bounds(center - radius, center + radius);
+		for (int i = 0; i < split_count; ++i)
+		{
+			if (depth + sphere.m_radius < split_distances[i]) continue;
+			if (depth - sphere.m_radius > split_distances[i + 1]) continue;
+			bounds[i].merge(light_space_bounds);
+		}
+	}
+
+
+	void getShadowReceiversBounds(const Frustum& camera_frustum,
+		const Matrix& light_space,
+		const float* split_distances,
+		int split_count,
+		AABB* bounds) override
+	{
+		PROFILE_FUNCTION();
+		for (int i = 0; i < split_count; ++i)
+		{
+			bounds[i].set(Vec3(FLT_MAX, FLT_MAX, FLT_MAX), Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+		}
+
+		const CullingSystem::Results* results = cull(camera_frustum);
+		if (results)
+		{
+			for (auto& subresults : *results)
+			{
+				for (ComponentIndex renderable_cmp : subresults)
+				{
+					addShadowReceiver(m_culling_system->getSphere(renderable_cmp),
+						camera_frustum,
+						light_space,
+						split_distances,
+						split_count,
+						bounds);
+				}
+			}
+		}
+
+		if (!m_static_batches.empty())
+		{
+			m_static_batch_culling_system->cullToFrustum(camera_frustum, ~0UL);
+			for (auto& subresults : m_static_batch_culling_system->getResult())
+			{
+				for (int index : subresults)
+				{
+					addShadowReceiver(m_static_batch_culling_system->getSphere(index),
+						camera_frustum,
+						light_space,
+						split_distances,
+						split_count,
+						bounds);
+				}
+			}
+		}
+
+		// heights are not known on the CPU for the whole terrain, its box goes from 0 to the
+		// y scale
+		for (Terrain* terrain : m_terrains)
+		{
+			if (!terrain) continue;
+
+			float width, height;
+			terrain->getSize(&width, &height);
+			AABB aabb(Vec3(0, 0, 0), Vec3(width, terrain->getYScale(), height));
+			Vec3 corners[8];
+			aabb.getCorners(m_universe.getMatrix(terrain->getEntity()), corners);
+			addShadowReceiver(corners,
+				lengthOf(corners),
+				camera_frustum,
+				light_space,
+				split_distances,
+				split_count,
+				bounds);
+		}
+	}
+
+
 	Array<Array<RenderableMesh>>& getRenderableInfos(const Frustum& frustum) override
 	{
 		PROFILE_FUNCTION();
 
 		for(auto& i : m_temporary_infos) i.clear();
+		if (m_renderables.empty()) return m_temporary_infos;
+
+		StaticRenderList& list = getStaticRenderList(frustum);
+		if (list.has_infos && list.infos_frame == m_frame &&
+			compareMemory(&list.infos_frustum, &frustum, sizeof(frustum)) == 0)
+		{
+			return list.infos;
+		}
+
+		const CullingSystem::Results* results = cull(frustum);
+		fillInfos(list.fading, frustum, RenderableFilter::ALL, list.infos, list.static_count, nullptr);
+		fillInfos(*results,
+			frustum,
+			RenderableFilter::DYNAMIC,
+			list.infos,
+			list.static_count + list.fading.size(),
+			nullptr);
+		list.infos_frustum = frustum;
+		list.infos_frame = m_frame;
+		list.has_infos = true;
+		return list.infos;
+	}
+
+
+	static bool canReuseStaticRenderList(const Frustum& list_frustum, const Frustum& frustum)
+	{
+		// the list was culled with planes moved out by the threshold, so it contains everything
+		// visible from any position within the threshold as long as the orientation is the same
+		for (int i = 0; i < Frustum::PLANE_COUNT; ++i)
+		{
+			if (compareMemory(&list_frustum.getPlane(i).normal, &frustum.getPlane(i).normal, sizeof(Vec3)) != 0)
+			{
+				return false;
+			}
+		}
+		return list_frustum.getNearDistance() == frustum.getNearDistance() &&
+			   list_frustum.getFarDistance() == frustum.getFarDistance() &&
+			   list_frustum.getRadius() == frustum.getRadius() &&
+			   (list_frustum.getPosition() - frustum.getPosition()).squaredLength() <
+				   STATIC_RENDER_LIST_THRESHOLD * STATIC_RENDER_LIST_THRESHOLD;
+	}
+
+
+	StaticRenderList& getStaticRenderList(const Frustum& frustum)
+	{
+		// lists can contain meshes of evicted LODs
+		uint32 eviction_version = m_renderer.getModelManager().getEvictionVersion();
+		if (eviction_version != m_model_eviction_version)
+		{
+			m_model_eviction_version = eviction_version;
+			invalidateStaticRenderLists();
+		}
+
+		for (StaticRenderList& list : m_static_render_lists)
+		{
+			if (list.is_valid && canReuseStaticRenderList(list.frustum, frustum)) return list;
+		}
+
+		PROFILE_BLOCK("Build static render list");
+		StaticRenderList& list = m_static_render_lists[m_next_static_render_list];
+		m_next_static_render_list = (m_next_static_render_list + 1) % m_static_render_lists.size();
+		list.frustum = frustum;
+		list.is_valid = true;
+		list.has_infos = false;
+
+		Frustum grown_frustum = frustum;
+		grown_frustum.grow(STATIC_RENDER_LIST_THRESHOLD);
+		m_culling_system->cullToFrustum(grown_frustum, ~0UL);
+		const CullingSystem::Results& results = m_culling_system->getResult();
+		fillInfos(results, frustum, RenderableFilter::STATIC, list.infos, 0, &list.fading);
+		addStaticBatchInfos(grown_frustum, frustum.getPosition(), list.infos);
+		list.static_count = list.infos.size();
+		return list;
+	}
+
+
+	// shadowmaps of lights touching the sphere must be rendered again
+	void invalidatePointLightShadows(const Sphere& sphere)
+	{
+		for (int i = 0, c = m_point_lights.size(); i < c; ++i)
+		{
+			if (intersects(getPointLightSphere(i), sphere))
+			{
+				m_point_light_shadow_versions[i] = ++m_last_shadow_version;
+			}
+		}
+	}
+
+
+	void invalidatePointLightShadows(ComponentIndex renderable)
+	{
+		const Renderable& r = m_renderables[renderable];
+		if (!r.model || !r.model->isReady()) return;
+		float radius = m_universe.getScale(r.entity) * r.model->getBoundingRadius();
+		invalidatePointLightShadows(Sphere(r.matrix.getTranslation(), radius));
+	}
+
+
+	uint32 getPointLightShadowVersion(ComponentIndex cmp) override
+	{
+		int index = getPointLightIndex(cmp);
+		// animated casters can change every frame without moving
+		for (ComponentIndex renderable_cmp : m_light_influenced_geometry[index])
+		{
+			const Pose* pose = m_renderables[renderable_cmp].pose;
+			if (pose && pose->getCount() > 0)
+			{
+				m_point_light_shadow_versions[index] = ++m_last_shadow_version;
+				break;
+			}
+		}
+		return m_point_light_shadow_versions[index];
+	}
+
+
+	// dynamic renderables are culled again when the same frustum is rendered in this frame
+	void invalidateFrameRenderLists()
+	{
+		for (StaticRenderList& list : m_static_render_lists)
+		{
+			list.has_infos = false;
+		}
+	}
+
+
+	void invalidateStaticRenderLists()
+	{
+		for (StaticRenderList& list : m_static_render_lists)
+		{
+			list.is_valid = false;
+			list.has_infos = false;
+		}
+	}
+
+
+	struct StaticBatchCandidate
+	{
+		int32 cell[3];
+		const Material* material;
+		uint32 vertex_def_hash;
+		int64 layer_mask;
+		ComponentIndex renderable;
+		int mesh;
+	};
+
+
+	struct StaticBatchMembers
+	{
+		int from;
+		int count;
+	};
+
+
+	static int compareStaticBatchKeys(const StaticBatchCandidate& a, const StaticBatchCandidate& b)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			if (a.cell[i] != b.cell[i]) return a.cell[i] < b.cell[i] ? -1 : 1;
+		}
+		if (a.material != b.material) return a.material < b.material ? -1 : 1;
+		if (a.vertex_def_hash != b.vertex_def_hash)
+		{
+			return a.vertex_def_hash < b.vertex_def_hash ? -1 : 1;
+		}
+		if (a.layer_mask != b.layer_mask) return a.layer_mask < b.layer_mask ? -1 : 1;
+		return 0;
+	}
+
+
+	static int compareStaticBatchCandidates(const void* a, const void* b)
+	{
+		auto* lhs = static_cast<const StaticBatchCandidate*>(a);
+		auto* rhs = static_cast<const StaticBatchCandidate*>(b);
+		int cmp = compareStaticBatchKeys(*lhs, *rhs);
+		if (cmp != 0) return cmp;
+		if (lhs->renderable != rhs->renderable) return lhs->renderable - rhs->renderable;
+		return lhs->mesh - rhs->mesh;
+	}
+
+
+	// all meshes of the renderable have to be batched, otherwise it's rendered on its own
+	bool canBeStaticBatched(ComponentIndex cmp)
+	{
+		const Renderable& r = m_renderables[cmp];
+		if (r.entity == INVALID_ENTITY || !r.model || !r.model->isReady()) return false;
+		if (r.pose || m_is_renderable_dynamic[cmp] || !m_culling_system->isAdded(cmp)) return false;
+
+		const Model* model = r.model;
+		if (model->getAttributes().empty() || model->getIndices().empty()) return false;
+		// the batch has no LODs, so models must not have them either
+		if (model->getLODs()[0].to_mesh != model->getMeshCount() - 1) return false;
+		for (int i = 0; i < r.mesh_count; ++i)
+		{
+			const Material* material = r.meshes[i].material;
+			// translucent meshes have to be sorted one by one
+			if (!material || !material->isReady()) return false;
+			if (material->getRenderStates() & BGFX_STATE_BLEND_MASK) return false;
+		}
+		return true;
+	}
+
+
+	static uint32 packNormal(const Vec3& normal, uint8 w)
+	{
+		uint8 packed[4] = {uint8(normal.x * 127.0f + 128.0f),
+			uint8(normal.y * 127.0f + 128.0f),
+			uint8(normal.z * 127.0f + 128.0f),
+			w};
+		uint32 result;
+		copyMemory(&result, packed, sizeof(result));
+		return result;
+	}
+
+
+	static void transformNormal(uint8* packed, const Matrix& matrix)
+	{
+		Vec3 normal((packed[0] - 128.0f) / 127.0f,
+			(packed[1] - 128.0f) / 127.0f,
+			(packed[2] - 128.0f) / 127.0f);
+		normal = matrix.getXVector() * normal.x + matrix.getYVector() * normal.y +
+				 matrix.getZVector() * normal.z;
+		normal.normalize();
+		uint32 result = packNormal(normal, packed[3]);
+		copyMemory(packed, &result, sizeof(result));
+	}
+
+
+	// merges meshes of candidates, which share a cell, a material and a vertex format, to a model
+	// in the space of the cell center; with proxy_distance the model gets a second LOD, a proxy
+	// simplified so its error does not exceed HLOD_PIXEL_ERROR from that distance
+	void createStaticBatch(const StaticBatchCandidate* candidates,
+		int count,
+		float cell_size,
+		float proxy_distance)
+	{
+		const Renderable& first = m_renderables[candidates[0].renderable];
+		const Mesh& first_mesh = first.meshes[candidates[0].mesh];
+		const bgfx::VertexDecl& vertex_def = first_mesh.vertex_def;
+		const int stride = vertex_def.getStride();
+		Vec3 center((candidates[0].cell[0] + 0.5f) * cell_size,
+			(candidates[0].cell[1] + 0.5f) * cell_size,
+			(candidates[0].cell[2] + 0.5f) * cell_size);
+
+		int attributes_size = 0;
+		int indices_count = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			const Mesh& mesh = m_renderables[candidates[i].renderable].meshes[candidates[i].mesh];
+			attributes_size += mesh.attribute_array_size;
+			indices_count += mesh.indices_count;
+		}
+
+		Array<uint8> attributes(m_allocator);
+		Array<int> indices(m_allocator);
+		attributes.resize(attributes_size);
+		indices.resize(indices_count);
+		int vertex_count = 0;
+		int index = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			const Renderable& r = m_renderables[candidates[i].renderable];
+			const Mesh& mesh = r.meshes[candidates[i].mesh];
+			const int32* src_indices = &r.model->getIndices()[mesh.indices_offset];
+			for (int j = 0; j < mesh.indices_count; ++j)
+			{
+				indices[index + j] = src_indices[j] + vertex_count;
+			}
+			index += mesh.indices_count;
+
+			uint8* vertices = &attributes[vertex_count * stride];
+			copyMemory(vertices,
+				&r.model->getAttributes()[mesh.attribute_array_offset],
+				mesh.attribute_array_size);
+			Matrix matrix = r.matrix;
+			matrix.setTranslation(matrix.getTranslation() - center);
+			for (int j = 0, c = mesh.attribute_array_size / stride; j < c; ++j)
+			{
+				uint8* vertex = vertices + j * stride;
+				Vec3* position = (Vec3*)(vertex + vertex_def.getOffset(bgfx::Attrib::Position));
+				*position = matrix.multiplyPosition(*position);
+				if (vertex_def.has(bgfx::Attrib::Normal))
+				{
+					transformNormal(vertex + vertex_def.getOffset(bgfx::Attrib::Normal), matrix);
+				}
+				if (vertex_def.has(bgfx::Attrib::Tangent))
+				{
+					transformNormal(vertex + vertex_def.getOffset(bgfx::Attrib::Tangent), matrix);
+				}
+			}
+			vertex_count += mesh.attribute_array_size / stride;
+		}
+
+		int lod_vertex_counts[] = {vertex_count, 0};
+		int lod_index_counts[] = {indices.size(), 0};
+		float lod_distances[] = {proxy_distance * proxy_distance, 0};
+		int lod_count = 1;
+		if (proxy_distance > 0)
+		{
+			Array<uint8> proxy_attributes(m_allocator);
+			Array<int32> proxy_indices(m_allocator);
+			float grid_size = proxy_distance * HLOD_PIXEL_ERROR / TEXTURE_STREAMING_SCREEN_SCALE;
+			lod_vertex_counts[1] = simplifyMesh(&attributes[0],
+				vertex_count,
+				stride,
+				vertex_def.getOffset(bgfx::Attrib::Position),
+				&indices[0],
+				indices.size(),
+				grid_size,
+				m_allocator,
+				proxy_attributes,
+				proxy_indices);
+			lod_index_counts[1] = proxy_indices.size();
+			attributes.resize(attributes.size() + proxy_attributes.size());
+			copyMemory(&attributes[attributes_size], &proxy_attributes[0], proxy_attributes.size());
+			for (int32 proxy_index : proxy_indices) indices.push(proxy_index);
+			lod_count = 2;
+		}
+
+		char path[MAX_PATH_LENGTH];
+		copyString(path, "*static_batch_");
+		int batch_index = m_static_batches.size();
+		toCString(batch_index, path + stringLength(path), lengthOf(path) - stringLength(path));
+		auto& rm = m_engine.getResourceManager();
+		auto* material_manager = static_cast<MaterialManager*>(rm.get(ResourceManager::MATERIAL));
+		// released by meshes of the model when it's unloaded
+		for (int i = 0; i < lod_count; ++i) material_manager->load(*first_mesh.material);
+		Model* model = LUMIX_NEW(m_allocator, Model)(Path(path), rm, m_allocator);
+		model->create(vertex_def,
+			first_mesh.material,
+			&indices[0],
+			indices.size() * sizeof(indices[0]),
+			&attributes[0],
+			attributes.size());
+		if (lod_count > 1)
+		{
+			model->splitToLODs(lod_vertex_counts, lod_index_counts, lod_distances, lod_count);
+		}
+
+		Renderable& batch = m_static_batches.emplace();
+		batch.entity = INVALID_ENTITY;
+		batch.model = model;
+		batch.pose = nullptr;
+		batch.matrix = Matrix::IDENTITY;
+		batch.matrix.setTranslation(center);
+		batch.layer_mask = candidates[0].layer_mask;
+		batch.meshes = &model->getMesh(0);
+		batch.custom_meshes = false;
+		batch.mesh_count = 1;
+		batch.is_occluder = false;
+
+		StaticBatchMembers& members = m_static_batch_members.emplace();
+		members.from = m_static_batch_renderables.size();
+		members.count = count;
+		for (int i = 0; i < count; ++i)
+		{
+			m_static_batch_renderables.push(candidates[i].renderable);
+			m_is_renderable_batched[candidates[i].renderable] = true;
+		}
+
+		m_static_batch_culling_system->addStatic(
+			batch_index, Sphere(center, model->getBoundingRadius()));
+		m_static_batch_culling_system->setLayerMask(batch_index, batch.layer_mask);
+	}
+
+
+	int buildStaticBatches(float cell_size, float proxy_distance) override
+	{
+		PROFILE_FUNCTION();
+		ASSERT(cell_size > 0);
+		clearStaticBatches();
+
+		Array<StaticBatchCandidate> candidates(m_allocator);
+		for (int i = 0, c = m_renderables.size(); i < c; ++i)
+		{
+			if (!canBeStaticBatched(i)) continue;
+
+			const Renderable& r = m_renderables[i];
+			Vec3 position = r.matrix.getTranslation();
+			for (int j = 0; j < r.mesh_count; ++j)
+			{
+				StaticBatchCandidate& candidate = candidates.emplace();
+				candidate.cell[0] = (int32)floorf(position.x / cell_size);
+				candidate.cell[1] = (int32)floorf(position.y / cell_size);
+				candidate.cell[2] = (int32)floorf(position.z / cell_size);
+				candidate.material = r.meshes[j].material;
+				candidate.vertex_def_hash = r.meshes[j].vertex_def.m_hash;
+				candidate.layer_mask = m_culling_system->getLayerMask(i);
+				candidate.renderable = i;
+				candidate.mesh = j;
+			}
+		}
+		if (candidates.empty()) return 0;
+
+		qsort(&candidates[0],
+			candidates.size(),
+			sizeof(candidates[0]),
+			compareStaticBatchCandidates);
+		for (int i = 0, c = candidates.size(); i < c;)
+		{
+			int run_end = i + 1;
+			while (run_end < c && compareStaticBatchKeys(candidates[i], candidates[run_end]) == 0)
+			{
+				++run_end;
+			}
+			createStaticBatch(&candidates[i], run_end - i, cell_size, proxy_distance);
+			i = run_end;
+		}
+		invalidateStaticRenderLists();
+		return m_static_batches.size();
+	}
+
+
+	void destroyStaticBatch(int index)
+	{
+		Renderable& batch = m_static_batches[index];
+		if (!batch.model) return;
+
+		m_static_batch_culling_system->removeStatic(index);
+		auto* model_manager = m_engine.getResourceManager().get(ResourceManager::MODEL);
+		model_manager->forceUnload(*batch.model);
+		LUMIX_DELETE(m_allocator, batch.model);
+		batch.model = nullptr;
+		batch.meshes = nullptr;
+	}
+
+
+	void clearStaticBatches() override
+	{
+		for (int i = 0; i < m_static_batches.size(); ++i)
+		{
+			destroyStaticBatch(i);
+		}
+		for (ComponentIndex cmp : m_static_batch_renderables)
+		{
+			m_is_renderable_batched[cmp] = false;
+		}
+		m_static_batches.clear();
+		m_static_batch_members.clear();
+		m_static_batch_renderables.clear();
+		m_static_batch_culling_system->clear();
+		invalidateStaticRenderLists();
+	}
+
+
+	// called before the renderable changes, batches with it are destroyed and their renderables
+	// are rendered on their own again, so batches with those renderables must go too
+	void breakStaticBatches(ComponentIndex cmp)
+	{
+		if (!m_is_renderable_batched[cmp]) return;
+
+		Array<ComponentIndex> to_break(m_allocator);
+		to_break.push(cmp);
+		m_is_renderable_batched[cmp] = false;
+		while (!to_break.empty())
+		{
+			ComponentIndex renderable = to_break.back();
+			to_break.pop();
+			for (int i = 0, c = m_static_batches.size(); i < c; ++i)
+			{
+				if (!m_static_batches[i].model) continue;
+
+				const StaticBatchMembers& members = m_static_batch_members[i];
+				const ComponentIndex* renderables = &m_static_batch_renderables[members.from];
+				bool contains = false;
+				for (int j = 0; j < members.count && !contains; ++j)
+				{
+					contains = renderables[j] == renderable;
+				}
+				if (!contains) continue;
+
+				for (int j = 0; j < members.count; ++j)
+				{
+					if (!m_is_renderable_batched[renderables[j]]) continue;
+					m_is_renderable_batched[renderables[j]] = false;
+					to_break.push(renderables[j]);
+				}
+				destroyStaticBatch(i);
+			}
+		}
+		invalidateStaticRenderLists();
+	}
+
+
+	Renderable* getStaticBatches() override
+	{
+		return m_static_batches.empty() ? nullptr : &m_static_batches[0];
+	}
+
+
+	// meshes of static batches visible in the culling frustum are appended as one more array
+	void addStaticBatchInfos(const Frustum& culling_frustum,
+		const Vec3& camera_position,
+		Array<Array<RenderableMesh>>& infos)
+	{
+		if (m_static_batches.empty()) return;
+
+		PROFILE_FUNCTION();
+		m_static_batch_culling_system->cullToFrustum(culling_frustum, ~0UL);
+		const CullingSystem::Results& results = m_static_batch_culling_system->getResult();
+		Array<RenderableMesh>& batch_infos = infos.emplace(m_allocator);
+		Vec3 lod_position = m_has_lod_reference ? m_lod_reference_position : camera_position;
+		float lod_distance_scale = m_has_lod_reference ? m_lod_distance_scale : 1;
+		for (auto& subresults : results)
+		{
+			for (int index : subresults)
+			{
+				const Renderable& batch = m_static_batches[index];
+				Sphere sphere = m_static_batch_culling_system->getSphere(index);
+				float squared_distance = (sphere.m_position - camera_position).squaredLength();
+				float lod_squared_distance =
+					(sphere.m_position - lod_position).squaredLength() * lod_distance_scale;
+				// the HLOD proxy replaces all meshes of the batch from its distance
+				Mesh* mesh = batch.meshes;
+				const Model::LOD* lods = batch.model->getLODs();
+				if (lod_squared_distance >= lods[0].distance) mesh = &batch.model->getMesh(1);
+				// small clusters can collapse completely
+				if (mesh->indices_count == 0) continue;
+
+				RenderableMesh& info = batch_infos.emplace();
+				info.renderable = STATIC_BATCH_FLAG | index;
+				info.mesh = mesh;
+				info.lod_fade = 0;
+				info.sort_key =
+					getSortKey(batch.model->getPath().getHash(), *info.mesh, squared_distance);
+
+				float distance = Math::maxValue(sqrtf(squared_distance), sphere.m_radius);
+				requestTextureMips(*info.mesh->material,
+					sphere.m_radius * TEXTURE_STREAMING_SCREEN_SCALE / distance);
+			}
+		}
+	}
+
+
+	Array<Array<RenderableMesh>>& getOcclusionCulledRenderableInfos(const Frustum& frustum,
+		const Matrix& view_projection) override
+	{
+		PROFILE_FUNCTION();
+
+		for (auto& i : m_temporary_infos) i.clear();
+		const CullingSystem::Results* results = cull(frustum);
+		if (!results) return m_temporary_infos;
+
+		rasterizeOccluders(*results, view_projection);
+		if (!m_occlusion_buffer.hasOccluders())
+		{
+			fillTemporaryInfos(*results, frustum);
+			return m_temporary_infos;
+		}
+
+		occlusionCull(*results, m_occlusion_buffer);
+		fillTemporaryInfos(m_occlusion_results, frustum);
+		return m_temporary_infos;
+	}
+
+
+	Array<Array<RenderableMesh>>& getHiZCulledRenderableInfos(const Frustum& frustum,
+		const DepthPyramid& depth_pyramid) override
+	{
+		PROFILE_FUNCTION();
+
+		for (auto& i : m_temporary_infos) i.clear();
 		const CullingSystem::Results* results = cull(frustum);
 		if (!results) return m_temporary_infos;
 
-		fillTemporaryInfos(*results, frustum);
+		if (!depth_pyramid.isReady())
+		{
+			fillTemporaryInfos(*results, frustum);
+			return m_temporary_infos;
+		}
+
+		occlusionCull(*results, depth_pyramid);
+		fillTemporaryInfos(m_occlusion_results, frustum);
 		return m_temporary_infos;
 	}
 
 
+	void rasterizeOccluders(const CullingSystem::Results& results, const Matrix& view_projection)
+	{
+		PROFILE_FUNCTION();
+		m_occlusion_buffer.clear(view_projection);
+		for (auto& subresults : results)
+		{
+			for (ComponentIndex renderable_cmp : subresults)
+			{
+				const Renderable& renderable = m_renderables[renderable_cmp];
+				if (!renderable.is_occluder) continue;
+
+				const Model* model = renderable.model;
+				const Array<int32>& indices = model->getIndices();
+				if (indices.empty()) continue;
+
+				LODMeshIndices lod = model->getLODMeshIndices(0);
+				for (int i = lod.from; i <= lod.to; ++i)
+				{
+					const Mesh& mesh = model->getMesh(i);
+					m_occlusion_buffer.addOccluder(&model->getVertices()[0],
+						&indices[mesh.indices_offset],
+						mesh.indices_count,
+						renderable.matrix);
+				}
+			}
+		}
+		m_occlusion_buffer.rasterize(m_engine.getMTJDManager());
+	}
+
+
+	// T is OcclusionBuffer or DepthPyramid
+	template <typename T> void occlusionCull(const CullingSystem::Results& results, const T& buffer)
+	{
+		PROFILE_FUNCTION();
+		while (m_occlusion_results.size() < results.size())
+		{
+			m_occlusion_results.emplace(m_allocator);
+		}
+		while (m_occlusion_results.size() > results.size())
+		{
+			m_occlusion_results.pop();
+		}
+
+		MTJD::parallelFor(m_engine.getMTJDManager(),
+			0,
+			results.size(),
+			1,
+			[this, &results, &buffer](int from, int to)
+			{
+				for (int i = from; i < to; ++i)
+				{
+					CullingSystem::Subresults& visible = m_occlusion_results[i];
+					visible.clear();
+					for (ComponentIndex renderable_cmp : results[i])
+					{
+						const Renderable& renderable = m_renderables[renderable_cmp];
+						if (buffer.isVisible(renderable.model->getAABB(), renderable.matrix))
+						{
+							visible.push(renderable_cmp);
+						}
+					}
+				}
+			});
+	}
+
+
 	void setCameraSlot(ComponentIndex camera, const char* slot) override
 	{
 		copyString(m_cameras[camera].m_slot, Camera::MAX_SLOT_LENGTH, slot);
@@ -2760,31 +4317,6 @@ public:
 		PROFILE_FUNCTION();
 		RayCastModelHit hit;
 		hit.m_is_hit = false;
-		Universe& universe = getUniverse();
-		for (int i = 0; i < m_renderables.size(); ++i)
-		{
-			auto& r = m_renderables[i];
-			if (ignored_renderable != i && r.model)
-			{
-				const Vec3& pos = r.matrix.getTranslation();
-				float radius = r.model->getBoundingRadius();
-				float scale = universe.getScale(r.entity);
-				Vec3 intersection;
-				if (dotProduct(pos - origin, pos - origin) < radius * radius ||
-					Math::getRaySphereIntersection(origin, dir, pos, radius * scale, intersection))
-				{
-					RayCastModelHit new_hit = r.model->castRay(origin, dir, r.matrix);
-					if (new_hit.m_is_hit && (!hit.m_is_hit || new_hit.m_t < hit.m_t))
-					{
-						new_hit.m_component = i;
-						new_hit.m_entity = r.entity;
-						new_hit.m_component_type = RENDERABLE_HASH;
-						hit = new_hit;
-						hit.m_is_hit = true;
-					}
-				}
-			}
-		}
 		for (int i = 0; i < m_terrains.size(); ++i)
 		{
 			if (m_terrains[i])
@@ -2799,10 +4331,65 @@ public:
 				}
 			}
 		}
+
+		// triangles are tested from the nearest bounding sphere, models whose sphere starts
+		// behind the closest hit so far can not be hit sooner
+		Universe& universe = getUniverse();
+		Array<RayCastCandidate> candidates(m_allocator);
+		for (int i = 0; i < m_renderables.size(); ++i)
+		{
+			auto& r = m_renderables[i];
+			if (ignored_renderable == i || !r.model) continue;
+
+			const Vec3& pos = r.matrix.getTranslation();
+			float radius = r.model->getBoundingRadius() * universe.getScale(r.entity);
+			Vec3 intersection;
+			if (dotProduct(pos - origin, pos - origin) < radius * radius)
+			{
+				candidates.push({i, 0});
+			}
+			else if (Math::getRaySphereIntersection(origin, dir, pos, radius, intersection))
+			{
+				candidates.push({i, dotProduct(intersection - origin, dir)});
+			}
+		}
+		if (candidates.empty()) return hit;
+
+		qsort(&candidates[0], candidates.size(), sizeof(candidates[0]), compareRayCastCandidates);
+		for (auto& candidate : candidates)
+		{
+			if (hit.m_is_hit && candidate.t > hit.m_t) break;
+
+			auto& r = m_renderables[candidate.renderable];
+			RayCastModelHit new_hit = r.model->castRay(origin, dir, r.matrix);
+			if (new_hit.m_is_hit && (!hit.m_is_hit || new_hit.m_t < hit.m_t))
+			{
+				new_hit.m_component = candidate.renderable;
+				new_hit.m_entity = r.entity;
+				new_hit.m_component_type = RENDERABLE_HASH;
+				hit = new_hit;
+				hit.m_is_hit = true;
+			}
+		}
 		return hit;
 	}
 
 
+	struct RayCastCandidate
+	{
+		int renderable;
+		float t;
+	};
+
+
+	static int compareRayCastCandidates(const void* a, const void* b)
+	{
+		float t_a = static_cast<const RayCastCandidate*>(a)->t;
+		float t_b = static_cast<const RayCastCandidate*>(b)->t;
+		return t_a < t_b ? -1 : (t_a > t_b ? 1 : 0);
+	}
+
+
 	int getPointLightIndex(ComponentIndex cmp) const
 	{
 		return m_point_lights_map[cmp];
@@ -2900,7 +4487,10 @@ public:
 
 	void setLightRange(ComponentIndex cmp, float value) override
 	{
-		m_point_lights[getPointLightIndex(cmp)].m_range = value;
+		int index = getPointLightIndex(cmp);
+		m_point_lights[index].m_range = value;
+		m_point_light_shadow_versions[index] = ++m_last_shadow_version;
+		detectLightInfluencedGeometry(index);
 	}
 
 	void setPointLightIntensity(ComponentIndex cmp, float intensity) override
@@ -3042,6 +4632,7 @@ public:
 
 	void modelUnloaded(Model*, ComponentIndex component)
 	{
+		breakStaticBatches(component);
 		auto& r = m_renderables[component];
 		if (!r.custom_meshes)
 		{
@@ -3052,6 +4643,8 @@ public:
 		r.pose = nullptr;
 
 		m_culling_system->removeStatic(component);
+		m_culled_frustums.clear();
+		invalidateStaticRenderLists();
 	}
 
 
@@ -3081,12 +4674,17 @@ public:
 		Sphere sphere(r.matrix.getTranslation(), bounding_radius * scale);
 		m_culling_system->addStatic(component, sphere);
 		m_culling_system->setLayerMask(component, r.layer_mask);
+		updateCullingAABB(component);
+		invalidateStaticRenderLists();
+		invalidatePointLightShadows(sphere);
 		ASSERT(!r.pose);
 		if (model->getBoneCount() > 0)
 		{
 			r.pose = LUMIX_NEW(m_allocator, Pose)(m_allocator);
 			r.pose->resize(model->getBoneCount());
 			model->getPose(*r.pose);
+			// kept out of static render lists, so getRenderableVisibleLOD is updated every frame
+			m_is_renderable_dynamic[component] = true;
 		}
 		r.matrix = m_universe.getMatrix(r.entity);
 		ASSERT(!r.meshes || r.custom_meshes)
@@ -3115,14 +4713,11 @@ public:
 			r.meshes = &r.model->getMesh(0);
 			r.mesh_count = r.model->getMeshCount();
 		}
+		updateRenderableLODs(component);
 
 		for (int i = 0; i < m_point_lights.size(); ++i)
 		{
-			PointLight& light = m_point_lights[i];
-			Vec3 t = r.matrix.getTranslation();
-			float radius = r.model->getBoundingRadius();
-			if ((t - m_universe.getPosition(light.m_entity)).squaredLength() <
-				(radius + light.m_range) * (radius + light.m_range))
+			if (intersects(getPointLightSphere(i), sphere))
 			{
 				m_light_influenced_geometry[i].push(component);
 			}
@@ -3212,6 +4807,133 @@ public:
 		r.meshes = new_meshes;
 		r.mesh_count = count;
 		r.custom_meshes = true;
+		m_renderable_lods[r.entity].meshes = new_meshes;
+	}
+
+
+	void updateRenderableLODs(ComponentIndex cmp)
+	{
+		const Renderable& r = m_renderables[cmp];
+		RenderableLODs& lods = m_renderable_lods[cmp];
+		const Model::LOD* model_lods = r.model->getLODs();
+		lods.model = r.model;
+		lods.meshes = r.meshes;
+		lods.model_hash = r.model->getPath().getHash();
+		lods.radius = m_universe.getScale(r.entity) * r.model->getBoundingRadius();
+		for (int i = 0; i < Model::MAX_LOD_COUNT; ++i)
+		{
+			lods.squared_distances[i] = model_lods[i].distance;
+			lods.from_mesh[i] = (int8)model_lods[i].from_mesh;
+			lods.to_mesh[i] = (int8)model_lods[i].to_mesh;
+		}
+		lods.squared_distances[Model::MAX_LOD_COUNT] = FLT_MAX;
+		lods.imposter_lod = -1;
+		lods.imposter = nullptr;
+		ModelImposter* imposter = getModelImposter(lods.model_hash);
+		if (imposter && !r.pose)
+		{
+			// the imposter takes the place of the infinite distance of the last LOD
+			int last = 0;
+			while (last < Model::MAX_LOD_COUNT - 1 && lods.squared_distances[last] < FLT_MAX) ++last;
+			float previous = last > 0 ? lods.squared_distances[last - 1] : 0;
+			lods.squared_distances[last] = Math::maxValue(previous, imposter->squared_distance);
+			lods.squared_distances[last + 1] = FLT_MAX;
+			lods.imposter_lod = int8(last + 1);
+			lods.imposter = getImposterQuad(*imposter, *r.model);
+		}
+		m_renderable_positions[cmp] = r.matrix.getTranslation();
+		m_renderable_lod_states[cmp].lod = -1;
+	}
+
+
+	ModelImposter* getModelImposter(uint32 model_path_hash)
+	{
+		for (ModelImposter& imposter : m_model_imposters)
+		{
+			if (imposter.model_path_hash == model_path_hash) return &imposter;
+		}
+		return nullptr;
+	}
+
+
+	Model* getImposterQuad(ModelImposter& imposter, const Model& model)
+	{
+		if (imposter.quad) return imposter.quad;
+
+		struct Vertex
+		{
+			Vec3 position;
+			float u, v;
+		};
+		float r = model.getBoundingRadius();
+		Vertex vertices[] = {
+			{{-r, -r, 0}, 0, 1}, {{r, -r, 0}, 1, 1}, {{r, r, 0}, 1, 0}, {{-r, r, 0}, 0, 0}};
+		int indices[] = {0, 1, 2, 0, 2, 3};
+		bgfx::VertexDecl vertex_def;
+		vertex_def.begin()
+			.add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float)
+			.add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Float)
+			.end();
+
+		auto& rm = m_engine.getResourceManager();
+		char path[MAX_PATH_LENGTH];
+		copyString(path, "*imposter_");
+		catString(path, model.getPath().c_str());
+		// released by the quad when it's unloaded
+		auto* material = static_cast<Material*>(
+			rm.get(ResourceManager::MATERIAL)->load(imposter.material_path));
+		imposter.quad = LUMIX_NEW(m_allocator, Model)(Path(path), rm, m_allocator);
+		imposter.quad->create(
+			vertex_def, material, indices, sizeof(indices), vertices, sizeof(vertices));
+		return imposter.quad;
+	}
+
+
+	void destroyImposterQuad(ModelImposter& imposter)
+	{
+		if (!imposter.quad) return;
+		m_engine.getResourceManager().get(ResourceManager::MODEL)->forceUnload(*imposter.quad);
+		LUMIX_DELETE(m_allocator, imposter.quad);
+		imposter.quad = nullptr;
+	}
+
+
+	void setModelImposter(const char* model_path, const char* material_path, float distance) override
+	{
+		uint32 model_path_hash = Path(model_path).getHash();
+		ModelImposter* imposter = getModelImposter(model_path_hash);
+		if (!imposter)
+		{
+			if (!material_path[0]) return;
+			imposter = &m_model_imposters.emplace();
+			imposter->model_path_hash = model_path_hash;
+			imposter->quad = nullptr;
+		}
+		// renderables must not point to the old quad
+		for (RenderableLODs& lods : m_renderable_lods)
+		{
+			if (!lods.imposter || lods.imposter != imposter->quad) continue;
+			lods.imposter_lod = -1;
+			lods.imposter = nullptr;
+		}
+		destroyImposterQuad(*imposter);
+		imposter->material_path = Path(material_path);
+		imposter->squared_distance = distance * distance;
+		if (!material_path[0]) m_model_imposters.eraseFast(int(imposter - &m_model_imposters[0]));
+
+		for (int i = 0, c = m_renderables.size(); i < c; ++i)
+		{
+			const Renderable& r = m_renderables[i];
+			if (r.entity == INVALID_ENTITY || !r.model || !r.model->isReady()) continue;
+			if (r.model->getPath().getHash() == model_path_hash) updateRenderableLODs(i);
+		}
+		invalidateStaticRenderLists();
+	}
+
+
+	Model* getImposterModel(ComponentIndex cmp) override
+	{
+		return m_renderable_lods[cmp & ~IMPOSTER_FLAG].imposter;
 	}
 
 
@@ -3220,6 +4942,8 @@ public:
 		auto& r = m_renderables[cmp];
 		if (r.meshes && r.mesh_count > index && path == r.meshes[index].material->getPath()) return;
 
+		breakStaticBatches(cmp);
+
 		auto& rm = r.model->getResourceManager();
 		auto* material_manager = static_cast<MaterialManager*>(rm.get(ResourceManager::MATERIAL));
 
@@ -3229,6 +4953,8 @@ public:
 		if (r.meshes[index].material) material_manager->unload(*r.meshes[index].material);
 		auto* new_material = static_cast<Material*>(material_manager->load(path));
 		r.meshes[index].material = new_material;
+		invalidateStaticRenderLists();
+		invalidatePointLightShadows(cmp);
 	}
 
 
@@ -3241,6 +4967,24 @@ public:
 	}
 
 
+	// closer resources are loaded first, the distance is measured from the main or the editor camera
+	void updateLoadPriority(Resource& resource, Entity entity)
+	{
+		ComponentIndex camera = getCameraInSlot("main");
+		if (camera == INVALID_COMPONENT) camera = getCameraInSlot("editor");
+		if (camera == INVALID_COMPONENT) return;
+
+		Vec3 camera_pos = m_universe.getPosition(m_cameras[camera].m_entity);
+		float distance = (m_universe.getPosition(entity) - camera_pos).length();
+		int priority = Resource::DEFAULT_PRIORITY - (int)distance;
+		// shared resources keep the priority of their closest user
+		if (resource.getRefCount() == 1 || priority > resource.getPriority())
+		{
+			resource.setPriority(priority);
+		}
+	}
+
+
 	void setModel(ComponentIndex component, Model* model)
 	{
 		ASSERT(m_renderables[component].entity != INVALID_ENTITY);
@@ -3254,6 +4998,7 @@ public:
 		}
 		if (old_model)
 		{
+			breakStaticBatches(component);
 			auto& rm = old_model->getResourceManager();
 			auto* material_manager = static_cast<MaterialManager*>(rm.get(ResourceManager::MATERIAL));
 			freeCustomMeshes(m_renderables[component], material_manager);
@@ -3261,7 +5006,10 @@ public:
 			--callback->m_ref_count;
 			if (old_model->isReady())
 			{
+				invalidatePointLightShadows(component);
 				m_culling_system->removeStatic(component);
+				m_culled_frustums.clear();
+				invalidateStaticRenderLists();
 			}
 			old_model->getResourceManager().get(ResourceManager::MODEL)->unload(*old_model);
 		}
@@ -3274,6 +5022,7 @@ public:
 		{
 			ModelLoadedCallback* callback = getModelLoadedCallback(model);
 			++callback->m_ref_count;
+			if (!model->isReady()) updateLoadPriority(*model, m_renderables[component].entity);
 
 			if (model->isReady())
 			{
@@ -3285,27 +5034,29 @@ public:
 	IAllocator& getAllocator() override { return m_allocator; }
 
 
+	Sphere getPointLightSphere(int light_index) const
+	{
+		const PointLight& light = m_point_lights[light_index];
+		return Sphere(m_universe.getPosition(light.m_entity), light.m_range);
+	}
+
+
+	// same test as CullingSystem::cullToSphere, so incremental updates match full queries
+	static bool intersects(const Sphere& a, const Sphere& b)
+	{
+		float radius = a.m_radius + b.m_radius;
+		return (a.m_position - b.m_position).squaredLength() < radius * radius;
+	}
+
+
 	void detectLightInfluencedGeometry(int light_index)
 	{
 		if (!m_is_forward_rendered) return;
 
-		Frustum frustum = getPointLightFrustum(light_index);
-		m_culling_system->cullToFrustum(frustum, 0xffffFFFF);
-		const CullingSystem::Results& results =
-			m_culling_system->getResult();
-		Array<int>& influenced_geometry =
-			m_light_influenced_geometry[light_index];
+		PROFILE_FUNCTION();
+		Array<int>& influenced_geometry = m_light_influenced_geometry[light_index];
 		influenced_geometry.clear();
-		for (int i = 0; i < results.size(); ++i)
-		{
-			const CullingSystem::Subresults& subresult = results[i];
-			influenced_geometry.reserve(influenced_geometry.size() +
-										subresult.size());
-			for (int j = 0, c = subresult.size(); j < c; ++j)
-			{
-				influenced_geometry.push(subresult[j]);
-			}
-		}
+		m_culling_system->cullToSphere(getPointLightSphere(light_index), 0xffffFFFF, influenced_geometry);
 	}
 
 
@@ -3459,7 +5210,9 @@ public:
 
 	void setLightFOV(ComponentIndex cmp, float fov) override
 	{
-		m_point_lights[getPointLightIndex(cmp)].m_fov = fov;
+		int index = getPointLightIndex(cmp);
+		m_point_lights[index].m_fov = fov;
+		m_point_light_shadow_versions[index] = ++m_last_shadow_version;
 	}
 
 
@@ -3494,6 +5247,7 @@ public:
 	{
 		PointLight& light = m_point_lights.emplace();
 		m_light_influenced_geometry.push(Array<int>(m_allocator));
+		m_point_light_shadow_versions.push(++m_last_shadow_version);
 		light.m_entity = entity;
 		light.m_diffuse_color.set(1, 1, 1);
 		light.m_diffuse_intensity = 1;
@@ -3535,6 +5289,15 @@ public:
 			r.entity = INVALID_ENTITY;
 			r.model = nullptr;
 			r.pose = nullptr;
+			m_is_renderable_dynamic.push(false);
+			m_renderable_positions.emplace();
+			RenderableLODs& lods = m_renderable_lods.emplace();
+			lods.meshes = nullptr;
+			lods.model = nullptr;
+			lods.imposter_lod = -1;
+			lods.imposter = nullptr;
+			m_renderable_lod_states.emplace().lod = -1;
+			m_is_renderable_batched.push(false);
 		}
 		auto& r = m_renderables[entity];
 		r.entity = entity;
@@ -3544,7 +5307,9 @@ public:
 		r.pose = nullptr;
 		r.custom_meshes = false;
 		r.mesh_count = 0;
+		r.is_occluder = false;
 		r.matrix = m_universe.getMatrix(entity);
+		m_is_renderable_dynamic[entity] = false;
 		m_universe.addComponent(entity, RENDERABLE_HASH, this, entity);
 		m_renderable_created.invoke(m_renderables.size() - 1);
 		return entity;
@@ -3580,6 +5345,7 @@ public:
 private:
 	IAllocator& m_allocator;
 	Array<ModelLoadedCallback*> m_model_loaded_callbacks;
+	Array<Shader*> m_precached_shaders;
 
 	Array<Renderable> m_renderables;
 
@@ -3590,6 +5356,8 @@ private:
 	Entity m_render_params_entity;
 	PODHashMap<ComponentIndex, int> m_point_lights_map;
 	Array<Array<ComponentIndex>> m_light_influenced_geometry;
+	Array<uint32> m_point_light_shadow_versions;
+	uint32 m_last_shadow_version;
 	int m_active_global_light_uid;
 	int m_global_light_last_uid;
 	Array<GlobalLight> m_global_lights;
@@ -3604,12 +5372,41 @@ private:
 	Array<DebugPoint> m_debug_points;
 	CullingSystem* m_culling_system;
 	Array<ParticleEmitter*> m_particle_emitters;
+	Array<ParticleRange> m_particle_ranges;
+	Array<ParticleEffectPool> m_particle_effect_pools;
+	Array<ParticleEmitter*> m_particle_effects;
+	// template emitter of each effect, to return it to the pool
+	Array<ComponentIndex> m_particle_effect_templates;
+	bool m_is_particle_culling_enabled;
+	// hot data of m_renderables used to build render infos every frame
+	Array<Vec3> m_renderable_positions;
+	Array<RenderableLODs> m_renderable_lods;
+	Array<bool> m_is_renderable_dynamic;
+	Array<RenderableLODState> m_renderable_lod_states;
+	Array<bool> m_is_renderable_batched;
+	// batches are never moved or reused, broken ones are left without a model
+	Array<Renderable> m_static_batches;
+	Array<StaticBatchMembers> m_static_batch_members;
+	Array<ComponentIndex> m_static_batch_renderables;
+	CullingSystem* m_static_batch_culling_system;
+	Array<ModelImposter> m_model_imposters;
+	bool m_has_lod_reference;
+	Vec3 m_lod_reference_position;
+	float m_lod_distance_scale;
+	bool m_is_lod_cross_fade_enabled;
 	Array<Array<RenderableMesh>> m_temporary_infos;
-	MTJD::Group m_sync_point;
-	Array<MTJD::Job*> m_jobs;
+	Array<StaticRenderList> m_static_render_lists;
+	int m_next_static_render_list;
+	Array<Frustum> m_culled_frustums;
+	Array<CullingSystem::Results> m_culled_results;
+	OcclusionBuffer m_occlusion_buffer;
+	CullingSystem::Results m_occlusion_results;
 	float m_time;
+	uint32 m_frame;
+	uint32 m_model_eviction_version;
 	bool m_is_forward_rendered;
 	bool m_is_grass_enabled;
+	bool m_is_gpu_grass_enabled;
 	bool m_is_game_running;
 	DelegateList<void(ComponentIndex)> m_renderable_created;
 	DelegateList<void(ComponentIndex)> m_renderable_destroyed;
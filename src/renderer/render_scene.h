@@ -9,6 +9,8 @@
 namespace Lumix
 {
 
+class AABB;
+class DepthPyramid;
 class Engine;
 class Frustum;
 class IAllocator;
@@ -49,6 +51,7 @@ struct Renderable
 	Mesh* meshes;
 	bool custom_meshes;
 	int8 mesh_count;
+	bool is_occluder;
 };
 
 
@@ -56,14 +59,32 @@ struct RenderableMesh
 {
 	ComponentIndex renderable;
 	Mesh* mesh;
+	// opaque meshes are ordered by shader, material, model and front-to-back,
+	// translucent meshes (highest bit set) back-to-front
+	uint64 sort_key;
+	// 0 - not cross-fading, > 0 - visible part of the new LOD, < 0 - hidden part of the old LOD
+	float lod_fade;
 };
 
 
+// set in RenderableMesh::renderable of meshes of static batches, the rest is the index of the batch
+static const ComponentIndex STATIC_BATCH_FLAG = 0x40000000;
+// set in RenderableMesh::renderable of imposters, the rest is the renderable, the mesh is
+// the quad of RenderScene::getImposterModel
+static const ComponentIndex IMPOSTER_FLAG = 0x20000000;
+
+
+// with GPU grass m_matrices is null and the instances are m_matrix_count offsets in
+// Terrain::getGPUGrassInstances of m_type, the vertex shader places them on the terrain
 struct GrassInfo
 {
 	Model* m_model;
 	const Matrix* m_matrices;
 	int m_matrix_count;
+	Terrain* m_terrain;
+	int m_type;
+	// x, z - local origin of the window, y - ground, w - fade distance
+	Vec4 m_gpu_params;
 };
 
 
@@ -195,6 +216,12 @@ public:
 	virtual void resetParticleEmitter(ComponentIndex cmp) = 0;
 	virtual void updateEmitter(ComponentIndex cmp, float time_delta) = 0;
 	virtual const Array<class ParticleEmitter*>& getParticleEmitters() const = 0;
+	// one burst of the template emitter at pos, emitters are pooled per template and reused
+	virtual void spawnParticleEffect(ComponentIndex template_emitter, const Vec3& pos) = 0;
+	virtual const Array<class ParticleEmitter*>& getParticleEffects() const = 0;
+	// emitters outside of all active cameras are not updated
+	virtual bool isParticleCullingEnabled() const = 0;
+	virtual void enableParticleCulling(bool enabled) = 0;
 	virtual const Vec2* getParticleEmitterAlpha(ComponentIndex cmp) = 0;
 	virtual int getParticleEmitterAlphaCount(ComponentIndex cmp) = 0;
 	virtual const Vec2* getParticleEmitterSize(ComponentIndex cmp) = 0;
@@ -207,6 +234,8 @@ public:
 	virtual Int2 getParticleEmitterSpawnCount(ComponentIndex cmp) = 0;
 	virtual Vec2 getParticleEmitterSpawnPeriod(ComponentIndex cmp) = 0;
 	virtual Vec2 getParticleEmitterInitialSize(ComponentIndex cmp) = 0;
+	virtual bool isParticleEmitterGPUSimulated(ComponentIndex cmp) = 0;
+	virtual void setParticleEmitterGPUSimulated(ComponentIndex cmp, bool value) = 0;
 	virtual void setParticleEmitterAlpha(ComponentIndex cmp, const Vec2* value, int count) = 0;
 	virtual void setParticleEmitterSize(ComponentIndex cmp, const Vec2* values, int count) = 0;
 	virtual void setParticleEmitterAcceleration(ComponentIndex cmp, const Vec3& value) = 0;
@@ -244,6 +273,7 @@ public:
 	virtual void showRenderable(ComponentIndex cmp) = 0;
 	virtual void hideRenderable(ComponentIndex cmp) = 0;
 	virtual ComponentIndex getRenderableComponent(Entity entity) = 0;
+	// resolves STATIC_BATCH_FLAG and IMPOSTER_FLAG too
 	virtual Renderable* getRenderable(ComponentIndex cmp) = 0;
 	virtual Renderable* getRenderables() = 0;
 	virtual Path getRenderablePath(ComponentIndex cmp) = 0;
@@ -252,8 +282,60 @@ public:
 	virtual int getRenderableMaterialsCount(ComponentIndex cmp) = 0;
 	virtual void setRenderableLayer(ComponentIndex cmp, const int32& layer) = 0;
 	virtual void setRenderablePath(ComponentIndex cmp, const Path& path) = 0;
+	// culls all frustums in one pass over the renderables, getRenderableInfos and
+	// getRenderableEntities called with one of these frustums reuse the result until the next
+	// update; frustums culled before in the same frame are not culled again
+	virtual void cullFrustums(const Frustum* frustums, int count) = 0;
+	// bounds, in light_space, of the receivers visible in camera_frustum whose view depth is between
+	// split_distances[i] and split_distances[i + 1]; bounds of splits without receivers are empty
+	virtual void getShadowReceiversBounds(const Frustum& camera_frustum,
+		const Matrix& light_space,
+		const float* split_distances,
+		int split_count,
+		AABB* bounds) = 0;
+	// pipelines rendering the same frustum in one frame, e.g. editor views of the same camera,
+	// get the infos of the first one, unless a renderable changed in between
 	virtual Array<Array<RenderableMesh>>& getRenderableInfos(const Frustum& frustum) = 0;
+	// merges meshes of static renderables without LODs, which share a material and lie in the same
+	// cell of a grid, to one model per cell and material culled by the cell's bounding sphere;
+	// batched renderables stay in the scene for editing and picking, a change of one of them
+	// breaks its batches; models have to be loaded with ModelManager::setKeepAttributes(true);
+	// if proxy_distance > 0, each batch gets a simplified HLOD proxy rendered instead of it from
+	// that distance of the LOD reference; returns the number of batches
+	virtual int buildStaticBatches(float cell_size, float proxy_distance) = 0;
+	virtual void clearStaticBatches() = 0;
+	// renderables of meshes with STATIC_BATCH_FLAG, batches broken since they were built have
+	// no model
+	virtual Renderable* getStaticBatches() = 0;
+	// from the distance to the LOD reference, renderables of the model are drawn as a quad with
+	// the material, which faces the camera and shows the model baked to a texture, as a LOD after
+	// the last LOD of the model; LOD cross-fading dithers the switch; the quad is as big as the
+	// bounding sphere of the model, its shader orients it and picks the view from the atlas;
+	// an empty material removes the imposter; skinned renderables have no imposters
+	virtual void setModelImposter(const char* model_path,
+		const char* material_path,
+		float distance) = 0;
+	virtual Model* getImposterModel(ComponentIndex cmp) = 0;
+	// LODs are selected by distance from position multiplied by distance_scale, the scale converts
+	// the distance so the projected size matches the view LOD distances were authored for
+	virtual void setLODReference(const Vec3& position, float distance_scale) = 0;
+	// LOD changes are dithered over time, meshes of both LODs have RenderableMesh::lod_fade set
+	virtual void enableLODCrossFade(bool enable) = 0;
+	// LOD selected for the renderable in the last rendered frame, -1 if it was not in any culled
+	// frustum, e.g. animations of distant or hidden renderables can be updated less often
+	virtual int getRenderableVisibleLOD(ComponentIndex cmp) = 0;
+	virtual bool isLODCrossFadeEnabled() const = 0;
+	// same as getRenderableInfos, then renderables hidden behind occluders visible in frustum
+	// are removed, occluders are rasterized with view_projection
+	virtual Array<Array<RenderableMesh>>& getOcclusionCulledRenderableInfos(const Frustum& frustum,
+		const Matrix& view_projection) = 0;
+	// same as getRenderableInfos, then renderables hidden in the depth of an earlier frame are
+	// removed; they are tested again every time, so they come back when they are disoccluded
+	virtual Array<Array<RenderableMesh>>& getHiZCulledRenderableInfos(const Frustum& frustum,
+		const DepthPyramid& depth_pyramid) = 0;
 	virtual void getRenderableEntities(const Frustum& frustum, Array<Entity>& entities) = 0;
+	virtual void setRenderableOccluder(ComponentIndex cmp, bool is_occluder) = 0;
+	virtual bool isRenderableOccluder(ComponentIndex cmp) = 0;
 	virtual Entity getRenderableEntity(ComponentIndex cmp) = 0;
 	virtual ComponentIndex getFirstRenderable() = 0;
 	virtual ComponentIndex getNextRenderable(ComponentIndex cmp) = 0;
@@ -263,10 +345,12 @@ public:
 		Array<GrassInfo>& infos,
 		ComponentIndex camera) = 0;
 	virtual void forceGrassUpdate(ComponentIndex cmp) = 0;
-	virtual void getTerrainInfos(Array<const TerrainInfo*>& infos,
-		const Vec3& camera_pos,
-		LIFOAllocator& allocator) = 0;
+	virtual void getTerrainInfos(const Frustum& frustum,
+		const Vec3& lod_ref_point,
+		Array<const TerrainInfo*>& infos) = 0;
 	virtual float getTerrainHeightAt(ComponentIndex cmp, float x, float z) = 0;
+	// getTerrainHeightAt for many points, xz are in the terrain's space
+	virtual void getTerrainHeights(ComponentIndex cmp, const Vec2* xz, float* out, int count) = 0;
 	virtual Vec3 getTerrainNormalAt(ComponentIndex cmp, float x, float z) = 0;
 	virtual void setTerrainMaterialPath(ComponentIndex cmp, const Path& path) = 0;
 	virtual Path getTerrainMaterialPath(ComponentIndex cmp) = 0;
@@ -282,6 +366,8 @@ public:
 	virtual int getGrassDistance(ComponentIndex cmp) = 0;
 	virtual void setGrassDistance(ComponentIndex cmp, int value) = 0;
 	virtual void enableGrass(bool enabled) = 0;
+	virtual bool isGPUGrassEnabled() const = 0;
+	virtual void enableGPUGrass(bool enabled) = 0;
 	virtual void setGrassPath(ComponentIndex cmp, int index, const Path& path) = 0;
 	virtual Path getGrassPath(ComponentIndex cmp, int index) = 0;
 	virtual void setGrassGround(ComponentIndex cmp, int index, int ground) = 0;
@@ -299,6 +385,9 @@ public:
 	virtual void getPointLightInfluencedGeometry(ComponentIndex light_cmp,
 		const Frustum& frustum,
 		Array<RenderableMesh>& infos) = 0;
+	// changes whenever the light or geometry in its range changes, a shadowmap rendered
+	// with the same version can be reused
+	virtual uint32 getPointLightShadowVersion(ComponentIndex cmp) = 0;
 	virtual void setLightCastShadows(ComponentIndex cmp, bool cast_shadows) = 0;
 	virtual bool getLightCastShadows(ComponentIndex cmp) = 0;
 	virtual float getLightAttenuation(ComponentIndex cmp) = 0;
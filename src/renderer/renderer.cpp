@@ -1,25 +1,38 @@
 #include "renderer.h"
 
 #include "core/array.h"
+#include "core/command_line_parser.h"
 #include "core/crc32.h"
+#include "core/frame_stats.h"
 #include "core/fs/os_file.h"
 #include "core/lifo_allocator.h"
 #include "core/log.h"
+#include "core/lua_compat.h"
+#include "core/mt/atomic.h"
+#include "core/mt/thread.h"
+#include "core/mtjd/generic_job.h"
+#include "core/path.h"
 #include "core/profiler.h"
 #include "core/resource_manager.h"
+#include "core/startup_report.h"
+#include "core/system.h"
+#include "core/tracking_allocator.h"
 #include "debug/debug.h"
 #include "engine.h"
 #include "engine/property_descriptor.h"
 #include "engine/property_register.h"
+#include "renderer/frame_buffer.h"
 #include "renderer/material.h"
 #include "renderer/material_manager.h"
 #include "renderer/model.h"
 #include "renderer/model_manager.h"
 #include "renderer/render_scene.h"
 #include "renderer/shader.h"
+#include "renderer/shader_cache.h"
 #include "renderer/shader_manager.h"
 #include "renderer/texture.h"
 #include "renderer/texture_manager.h"
+#include "renderer/transient_geometry.h"
 #include "universe/universe.h"
 #include <bgfx/bgfx.h>
 #include <cfloat>
@@ -206,6 +219,11 @@ static void registerProperties(IAllocator& allocator)
 							  &RenderScene::getParticleEmitterSpawnCount,
 							  &RenderScene::setParticleEmitterSpawnCount,
 							  allocator));
+	PropertyRegister::add("particle_emitter",
+		LUMIX_NEW(allocator, BoolPropertyDescriptor<RenderScene>)("GPU simulation",
+							  &RenderScene::isParticleEmitterGPUSimulated,
+							  &RenderScene::setParticleEmitterGPUSimulated,
+							  allocator));
 	PropertyRegister::add("particle_emitter",
 		LUMIX_NEW(allocator, ResourcePropertyDescriptor<RenderScene>)("Material",
 							  &RenderScene::getParticleEmitterMaterialPath,
@@ -263,6 +281,11 @@ static void registerProperties(IAllocator& allocator)
 		ResourceManager::MATERIAL,
 		allocator));
 	PropertyRegister::add("renderable", renderable_material);
+	PropertyRegister::add("renderable",
+		LUMIX_NEW(allocator, BoolPropertyDescriptor<RenderScene>)("Occluder",
+							  &RenderScene::isRenderableOccluder,
+							  &RenderScene::setRenderableOccluder,
+							  allocator));
 
 	PropertyRegister::add("global_light",
 		LUMIX_NEW(allocator, ColorPropertyDescriptor<RenderScene>)("Ambient color",
@@ -447,6 +470,24 @@ static const uint32 GLOBAL_LIGHT_HASH = crc32("global_light");
 static const uint32 POINT_LIGHT_HASH = crc32("point_light");
 static const uint32 RENDERABLE_HASH = crc32("renderable");
 static const uint32 CAMERA_HASH = crc32("camera");
+// unreferenced textures and models stay loaded up to these sizes of their files
+static const size_t TEXTURE_CACHE_BUDGET = 128 * 1024 * 1024;
+static const size_t MODEL_CACHE_BUDGET = 64 * 1024 * 1024;
+
+
+// RenderScene::buildStaticBatches needs vertex attributes of models on CPU
+static bool isStaticBatchingRequested()
+{
+	char cmd_line[2048];
+	getCommandLine(cmd_line, lengthOf(cmd_line));
+
+	CommandLineParser parser(cmd_line);
+	while (parser.next())
+	{
+		if (parser.currentEquals("-static_batching")) return true;
+	}
+	return false;
+}
 
 
 struct BGFXAllocator : public bx::AllocatorI
@@ -497,6 +538,23 @@ struct BGFXAllocator : public bx::AllocatorI
 
 struct RendererImpl : public Renderer
 {
+	// bgfx needs two frames until read textures are filled
+	static const int READBACK_LATENCY = 3;
+	static const uint8 READBACK_VIEW = 255;
+
+
+	struct Readback
+	{
+		bgfx::TextureHandle texture;
+		uint8* data;
+		int width;
+		int height;
+		int frames;
+		ReadbackCallback callback;
+		Path path;
+	};
+
+
 	struct CallbackStub : public bgfx::CallbackI
 	{
 		CallbackStub(RendererImpl& renderer)
@@ -583,9 +641,24 @@ struct RendererImpl : public Renderer
 		}
 
 
-		uint32 cacheReadSize(uint64) override { return 0; }
-		bool cacheRead(uint64, void*, uint32) override { return false; }
-		void cacheWrite(uint64, const void*, uint32) override {}
+		uint32 cacheReadSize(uint64 id) override
+		{
+			return m_renderer.m_shader_cache.getEntrySize(id);
+		}
+
+
+		bool cacheRead(uint64 id, void* data, uint32 size) override
+		{
+			return m_renderer.m_shader_cache.read(id, data, size);
+		}
+
+
+		void cacheWrite(uint64 id, const void* data, uint32 size) override
+		{
+			m_renderer.m_shader_cache.write(id, data, size);
+		}
+
+
 		void captureEnd() override { ASSERT(false); }
 		void captureFrame(const void*, uint32) override { ASSERT(false); }
 
@@ -595,7 +668,7 @@ struct RendererImpl : public Renderer
 
 	RendererImpl(Engine& engine)
 		: m_engine(engine)
-		, m_allocator(engine.getAllocator())
+		, m_allocator(engine.getAllocator(), "renderer")
 		, m_texture_manager(m_allocator)
 		, m_model_manager(m_allocator, *this)
 		, m_material_manager(*this, m_allocator)
@@ -606,6 +679,8 @@ struct RendererImpl : public Renderer
 		, m_bgfx_allocator(m_allocator)
 		, m_frame_allocator(m_allocator, 10 * 1024 * 1024)
 		, m_callback_stub(*this)
+		, m_shader_cache(m_allocator)
+		, m_readbacks(m_allocator)
 	{
 		registerProperties(engine.getAllocator());
 		bgfx::PlatformData d;
@@ -617,6 +692,7 @@ struct RendererImpl : public Renderer
 			bgfx::setPlatformData(d);
 		}
 		bgfx::init(bgfx::RendererType::Count, 0, 0, &m_callback_stub, &m_bgfx_allocator);
+		openShaderCache();
 		bgfx::reset(800, 600);
 		bgfx::setDebug(BGFX_DEBUG_TEXT);
 
@@ -626,9 +702,14 @@ struct RendererImpl : public Renderer
 		m_material_manager.create(ResourceManager::MATERIAL, manager);
 		m_shader_manager.create(ResourceManager::SHADER, manager);
 		m_shader_binary_manager.create(ResourceManager::SHADER_BINARY, manager);
+		m_texture_manager.setCacheBudget(TEXTURE_CACHE_BUDGET);
+		m_model_manager.setCacheBudget(MODEL_CACHE_BUDGET);
+		m_model_manager.setKeepAttributes(isStaticBatchingRequested());
 
 		m_current_pass_hash = crc32("MAIN");
 		m_view_counter = 0;
+		m_gpu_frame_time = 0;
+		m_pending_saves = 0;
 		m_mat_color_shininess_uniform =
 			bgfx::createUniform("u_materialColorShininess", bgfx::UniformType::Vec4);
 
@@ -643,6 +724,10 @@ struct RendererImpl : public Renderer
 			.add(bgfx::Attrib::Color0, 4, bgfx::AttribType::Uint8, true)
 			.end();
 
+		m_shader_state = luaL_newstate();
+		luaL_openlibs(m_shader_state);
+		Shader::registerLuaAPI(m_shader_state);
+
 		m_default_shader = static_cast<Shader*>(m_shader_manager.load(Path("shaders/default.shd")));
 	}
 
@@ -654,6 +739,14 @@ struct RendererImpl : public Renderer
 		m_material_manager.destroy();
 		m_shader_manager.destroy();
 		m_shader_binary_manager.destroy();
+		lua_close(m_shader_state);
+
+		for (Readback& readback : m_readbacks)
+		{
+			bgfx::destroyTexture(readback.texture);
+			m_allocator.deallocate(readback.data);
+		}
+		while (m_pending_saves > 0) MT::sleep(1);
 
 		bgfx::destroyUniform(m_mat_color_shininess_uniform);
 		bgfx::frame();
@@ -662,12 +755,44 @@ struct RendererImpl : public Renderer
 	}
 
 
+	void openShaderCache()
+	{
+		char dir[MAX_PATH_LENGTH];
+		if (!getCacheDirectory(dir, lengthOf(dir))) return;
+		catString(dir, "shader_cache\\");
+
+		// bgfx does not tell the driver version, binaries a new driver rejects are compiled and
+		// written again
+		const bgfx::Caps* caps = bgfx::getCaps();
+		struct
+		{
+			int32 renderer_type;
+			uint16 vendor_id;
+			uint16 device_id;
+		} device = { (int32)caps->rendererType, caps->vendorId, caps->deviceId };
+		uint32 device_key = crc32(&device, sizeof(device));
+		m_shader_cache.open(dir, device_key, ShaderCache::DEFAULT_MAX_SIZE);
+	}
+
+
 	MaterialManager& getMaterialManager()
 	{
 		return m_material_manager;
 	}
 
 
+	TextureManager& getTextureManager() override
+	{
+		return m_texture_manager;
+	}
+
+
+	ModelManager& getModelManager() override
+	{
+		return m_model_manager;
+	}
+
+
 	const bgfx::VertexDecl& getBasicVertexDecl() const override
 	{
 		return m_basic_vertex_decl;
@@ -764,8 +889,244 @@ struct RendererImpl : public Renderer
 	void frame() override
 	{
 		PROFILE_FUNCTION();
+		bool is_first_frame = !StartupReport::isRecorded(StartupReport::Phase::FIRST_FRAME);
+		uint64 start = FrameStats::getRawTime();
+		m_texture_manager.update();
+		m_model_manager.update();
 		bgfx::frame();
 		m_view_counter = 0;
+		recordGPUTime();
+		recordTransientGeometry();
+		updateReadbacks();
+		if (is_first_frame) StartupReport::record(StartupReport::Phase::FIRST_FRAME, "frame", start);
+	}
+
+
+	void recordTransientGeometry()
+	{
+		const TransientGeometry::Stats& stats = TransientGeometry::getFrameStats();
+		Profiler::record("Transient geometry KB", (stats.vertex_bytes + stats.index_bytes) / 1024);
+		Profiler::record("Transient geometry fallbacks", stats.fallback_count);
+		TransientGeometry::resetFrameStats();
+	}
+
+
+	Readback* addReadback(FrameBuffer& framebuffer, int renderbuffer_idx)
+	{
+		const FrameBuffer::Declaration& decl = framebuffer.getDeclaration();
+		if ((bgfx::getCaps()->supported & BGFX_CAPS_TEXTURE_READ_BACK) == 0)
+		{
+			g_log_error.log("Renderer") << "Reading textures back is not supported";
+			return nullptr;
+		}
+		// both have 4 bytes per texel
+		bgfx::TextureFormat::Enum format = renderbuffer_idx >= 0 &&
+												   renderbuffer_idx < decl.m_renderbuffers_count
+											   ? decl.m_renderbuffers[renderbuffer_idx].m_format
+											   : bgfx::TextureFormat::Unknown;
+		if (format != bgfx::TextureFormat::RGBA8 && format != bgfx::TextureFormat::R32F)
+		{
+			g_log_error.log("Renderer") << "Only RGBA8 and R32F renderbuffers can be read back, "
+										<< framebuffer.getName() << " " << renderbuffer_idx;
+			return nullptr;
+		}
+
+		Readback& readback = m_readbacks.emplace();
+		readback.width = framebuffer.getWidth();
+		readback.height = framebuffer.getHeight();
+		readback.frames = 0;
+		readback.texture = bgfx::createTexture2D((uint16)readback.width,
+			(uint16)readback.height,
+			1,
+			format,
+			BGFX_TEXTURE_BLIT_DST | BGFX_TEXTURE_READ_BACK);
+		readback.data = (uint8*)m_allocator.allocate(readback.width * readback.height * 4);
+		// views are executed in order, in the last one everything else is already rendered
+		bgfx::touch(READBACK_VIEW);
+		bgfx::blit(READBACK_VIEW,
+			readback.texture,
+			0,
+			0,
+			framebuffer.getRenderbufferHandle(renderbuffer_idx));
+		return &readback;
+	}
+
+
+	bool readFramebuffer(FrameBuffer& framebuffer,
+		int renderbuffer_idx,
+		const ReadbackCallback& callback) override
+	{
+		Readback* readback = addReadback(framebuffer, renderbuffer_idx);
+		if (!readback) return false;
+		readback->callback = callback;
+		return true;
+	}
+
+
+	void cancelReadbacks(const ReadbackCallback& callback) override
+	{
+		for (Readback& readback : m_readbacks)
+		{
+			if (readback.callback == callback) readback.callback = ReadbackCallback();
+		}
+	}
+
+
+	bool saveFramebuffer(FrameBuffer& framebuffer,
+		int renderbuffer_idx,
+		const Path& path) override
+	{
+		const FrameBuffer::Declaration& decl = framebuffer.getDeclaration();
+		if (renderbuffer_idx >= 0 && renderbuffer_idx < decl.m_renderbuffers_count &&
+			decl.m_renderbuffers[renderbuffer_idx].m_format != bgfx::TextureFormat::RGBA8)
+		{
+			g_log_error.log("Renderer") << "Only RGBA8 renderbuffers can be saved, "
+										<< framebuffer.getName() << " " << renderbuffer_idx;
+			return false;
+		}
+		Readback* readback = addReadback(framebuffer, renderbuffer_idx);
+		if (!readback) return false;
+		readback->path = path;
+		return true;
+	}
+
+
+	// blitted in the first frame, bgfx reads the copy in the next one and the data is there two
+	// frames after that
+	void updateReadbacks()
+	{
+		for (int i = 0; i < m_readbacks.size(); ++i)
+		{
+			Readback& readback = m_readbacks[i];
+			++readback.frames;
+			if (readback.frames == 1) bgfx::readTexture(readback.texture, readback.data);
+			if (readback.frames < READBACK_LATENCY) continue;
+
+			bgfx::destroyTexture(readback.texture);
+			auto type = bgfx::getCaps()->rendererType;
+			if (type == bgfx::RendererType::OpenGL || type == bgfx::RendererType::OpenGLES)
+			{
+				flipRows(readback.data, readback.width, readback.height);
+			}
+
+			if (readback.path.isValid())
+			{
+				saveTGAAsync(readback.path, readback.data, readback.width, readback.height);
+			}
+			else
+			{
+				if (readback.callback.isValid())
+				{
+					readback.callback.invoke(readback.data, readback.width, readback.height);
+				}
+				m_allocator.deallocate(readback.data);
+			}
+			m_readbacks.erase(i);
+			--i;
+		}
+	}
+
+
+	static void flipRows(uint8* pixels, int width, int height)
+	{
+		int pitch = width * 4;
+		for (int y = 0; y < height / 2; ++y)
+		{
+			uint8* top = pixels + y * pitch;
+			uint8* bottom = pixels + (height - 1 - y) * pitch;
+			for (int x = 0; x < pitch; ++x)
+			{
+				uint8 tmp = top[x];
+				top[x] = bottom[x];
+				bottom[x] = tmp;
+			}
+		}
+	}
+
+
+	// takes the ownership of pixels
+	void saveTGAAsync(const Path& path, uint8* pixels, int width, int height)
+	{
+		MT::atomicIncrement(&m_pending_saves);
+		auto& manager = m_engine.getMTJDManager();
+		auto* job = MTJD::makeJob(manager,
+			[this, path, pixels, width, height]() {
+				PROFILE_BLOCK("save TGA");
+				saveTGA(path.c_str(), pixels, width, height);
+				m_allocator.deallocate(pixels);
+				MT::atomicDecrement(&m_pending_saves);
+			},
+			manager.getJobAllocator(),
+			MTJD::Priority::Low);
+		manager.schedule(job);
+	}
+
+
+	// RGBA pixels, the top row first, are stored as BGRA
+	void saveTGA(const char* path, uint8* pixels, int width, int height)
+	{
+		#pragma pack(1)
+			struct TGAHeader
+			{
+				char idLength;
+				char colourMapType;
+				char dataType;
+				short int colourMapOrigin;
+				short int colourMapLength;
+				char colourMapDepth;
+				short int xOrigin;
+				short int yOrigin;
+				short int width;
+				short int height;
+				char bitsPerPixel;
+				char imageDescriptor;
+			};
+		#pragma pack()
+
+		TGAHeader header;
+		setMemory(&header, 0, sizeof(header));
+		header.bitsPerPixel = 32;
+		header.height = (short)height;
+		header.width = (short)width;
+		header.dataType = 2;
+		// origin in the top left corner, 8 alpha bits
+		header.imageDescriptor = 0x28;
+
+		for (int i = 0, c = width * height * 4; i < c; i += 4)
+		{
+			uint8 tmp = pixels[i];
+			pixels[i] = pixels[i + 2];
+			pixels[i + 2] = tmp;
+		}
+
+		FS::OsFile file;
+		if (!file.open(path, FS::Mode::CREATE | FS::Mode::WRITE, m_allocator))
+		{
+			g_log_error.log("Renderer") << "Failed to save " << path;
+			return;
+		}
+		file.write(&header, sizeof(header));
+		file.write(pixels, width * height * 4);
+		file.close();
+	}
+
+
+	// bgfx resolves its timer queries a few frames later, so this never waits for the GPU; this
+	// bgfx has no per view queries, so it's the time of the whole frame
+	void recordGPUTime()
+	{
+		const bgfx::Stats* stats = bgfx::getStats();
+		if (!stats || stats->gpuTimerFreq == 0 || stats->gpuTimeEnd < stats->gpuTimeBegin) return;
+
+		double length = double(stats->gpuTimeEnd - stats->gpuTimeBegin) / stats->gpuTimerFreq;
+		m_gpu_frame_time = float(length * 1000);
+		Profiler::record("GPU frame", m_gpu_frame_time);
+	}
+
+
+	float getGPUFrameTime() const override
+	{
+		return m_gpu_frame_time;
 	}
 
 
@@ -793,14 +1154,21 @@ struct RendererImpl : public Renderer
 	}
 
 
+	lua_State* getShaderState() override
+	{
+		return m_shader_state;
+	}
+
+
 	typedef char ShaderDefine[32];
 
 
 	Engine& m_engine;
-	IAllocator& m_allocator;
+	TrackingAllocator m_allocator;
 	Array<ShaderCombinations::Pass> m_passes;
 	Array<ShaderDefine> m_shader_defines;
 	CallbackStub m_callback_stub;
+	ShaderCache m_shader_cache;
 	LIFOAllocator m_frame_allocator;
 	TextureManager m_texture_manager;
 	MaterialManager m_material_manager;
@@ -809,7 +1177,11 @@ struct RendererImpl : public Renderer
 	ModelManager m_model_manager;
 	uint32 m_current_pass_hash;
 	int m_view_counter;
+	float m_gpu_frame_time;
+	Array<Readback> m_readbacks;
+	volatile int32 m_pending_saves;
 	Shader* m_default_shader;
+	lua_State* m_shader_state;
 	BGFXAllocator m_bgfx_allocator;
 	bgfx::VertexDecl m_basic_vertex_decl;
 	bgfx::VertexDecl m_basic_2d_vertex_decl;
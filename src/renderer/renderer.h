@@ -1,9 +1,13 @@
 #pragma once
 
 #include "lumix.h"
+#include "core/delegate.h"
 #include "iplugin.h"
 
 
+struct lua_State;
+
+
 namespace bgfx
 {
 	struct UniformHandle;
@@ -16,16 +20,21 @@ namespace Lumix
 
 
 class Engine;
+class FrameBuffer;
 class LIFOAllocator;
 class MaterialManager;
+class ModelManager;
 class Path;
 class Shader;
+class TextureManager;
 
 
 class LUMIX_RENDERER_API Renderer : public IPlugin 
 {
 	public:
 		typedef void* TransientDataHandle;
+		// RGBA8 pixels, 4 bytes each, the top row first; nullptr if the read failed
+		typedef Delegate<void(const uint8*, int, int)> ReadbackCallback;
 
 	public:
 		virtual ~Renderer() {}
@@ -34,6 +43,18 @@ class LUMIX_RENDERER_API Renderer : public IPlugin
 		virtual int getViewCounter() const = 0;
 		virtual void viewCounterAdd() = 0;
 		virtual void makeScreenshot(const Path& filename) = 0;
+		// the renderbuffer is copied at the end of the current frame and the callback is called
+		// from frame() a few frames later, so nothing waits for the GPU; only RGBA8 and R32F
+		// renderbuffers, the top row first
+		virtual bool readFramebuffer(FrameBuffer& framebuffer,
+			int renderbuffer_idx,
+			const ReadbackCallback& callback) = 0;
+		// the callback is not called for readbacks still in flight, e.g. when its owner is destroyed
+		virtual void cancelReadbacks(const ReadbackCallback& callback) = 0;
+		// like readFramebuffer, the TGA is encoded and written on a worker; only RGBA8
+		virtual bool saveFramebuffer(FrameBuffer& framebuffer,
+			int renderbuffer_idx,
+			const Path& path) = 0;
 		virtual int getPassIdx(const char* pass) = 0;
 		virtual uint8 getShaderDefineIdx(const char* define) = 0;
 		virtual const char* getShaderDefine(int define_idx) = 0;
@@ -41,8 +62,14 @@ class LUMIX_RENDERER_API Renderer : public IPlugin
 		virtual const bgfx::VertexDecl& getBasicVertexDecl() const = 0;
 		virtual const bgfx::VertexDecl& getBasic2DVertexDecl() const = 0;
 		virtual MaterialManager& getMaterialManager() = 0;
+		virtual ModelManager& getModelManager() = 0;
+		virtual TextureManager& getTextureManager() = 0;
 		virtual Shader* getDefaultShader() = 0;
+		// shared by all shader definitions, their functions are registered only once
+		virtual lua_State* getShaderState() = 0;
 		virtual const bgfx::UniformHandle& getMaterialColorShininessUniform() const = 0;
+		// in ms, measured a few frames ago; 0 if the backend has no timer queries
+		virtual float getGPUFrameTime() const = 0;
 
 		virtual Engine& getEngine() = 0;
 }; 
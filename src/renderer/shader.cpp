@@ -4,14 +4,14 @@
 #include "core/fs/ifile.h"
 #include "core/lua_wrapper.h"
 #include "core/log.h"
+#include "core/lua_bytecode_cache.h"
 #include "core/path_utils.h"
 #include "core/resource_manager.h"
 #include "core/resource_manager_base.h"
+#include "engine.h"
 #include "renderer/renderer.h"
 #include "renderer/shader_manager.h"
 #include <bgfx/bgfx.h>
-#include <lua.hpp>
-#include <lauxlib.h>
 
 
 namespace Lumix
@@ -22,6 +22,8 @@ Shader::Shader(const Path& path, ResourceManager& resource_manager, IAllocator&
 	: Resource(path, resource_manager, allocator)
 	, m_allocator(allocator)
 	, m_instances(m_allocator)
+	, m_precached_masks(m_allocator)
+	, m_binary(nullptr)
 	, m_texture_slot_count(0)
 	, m_uniforms(m_allocator)
 	, m_render_states(0)
@@ -49,6 +51,7 @@ ShaderInstance* Shader::getFirstInstance()
 
 ShaderInstance& Shader::getInstance(uint32 mask)
 {
+	mask &= m_combintions.m_all_defines_mask;
 	for (int i = 0; i < m_instances.size(); ++i)
 	{
 		if (m_instances[i]->m_define_mask == mask)
@@ -57,8 +60,18 @@ ShaderInstance& Shader::getInstance(uint32 mask)
 		}
 	}
 
-	g_log_error.log("Renderer") << "Unknown shader combination requested: " << mask;
-	return *m_instances[0];
+	return *createInstance(getDenseFromDefineMask(mask));
+}
+
+
+void Shader::precache(uint32 mask)
+{
+	if (isReady())
+	{
+		getInstance(mask);
+		return;
+	}
+	m_precached_masks.push(mask);
 }
 
 
@@ -68,10 +81,15 @@ ShaderCombinations::ShaderCombinations()
 }
 
 
+ShaderManager& Shader::getShaderManager()
+{
+	return *static_cast<ShaderManager*>(m_resource_manager.get(ResourceManager::SHADER));
+}
+
+
 Renderer& Shader::getRenderer()
 {
-	auto* manager = m_resource_manager.get(ResourceManager::SHADER);
-	return static_cast<ShaderManager*>(manager)->getRenderer();
+	return getShaderManager().getRenderer();
 }
 
 
@@ -89,62 +107,39 @@ uint32 Shader::getDefineMaskFromDense(uint32 dense) const
 }
 
 
-bool Shader::generateInstances()
+uint32 Shader::getDenseFromDefineMask(uint32 mask) const
 {
-	for (int i = 0; i < m_instances.size(); ++i)
+	uint32 dense = 0;
+	for (int i = 0; i < m_combintions.m_define_count; ++i)
 	{
-		LUMIX_DELETE(m_allocator, m_instances[i]);
+		if (mask & (1 << m_combintions.m_defines[i]))
+		{
+			dense |= 1 << i;
+		}
 	}
-	m_instances.clear();
-
-	uint32 count = 1 << m_combintions.m_define_count;
+	return dense;
+}
 
-	auto* binary_manager = m_resource_manager.get(ResourceManager::SHADER_BINARY);
-	char basename[MAX_PATH_LENGTH];
-	PathUtils::getBasename(basename, sizeof(basename), getPath().c_str());
 
-	for (uint32 mask = 0; mask < count; ++mask)
-	{
-		ShaderInstance* instance = LUMIX_NEW(m_allocator, ShaderInstance)(*this);
-		m_instances.push(instance);
+ShaderInstance* Shader::createInstance(uint32 dense_mask)
+{
+	ShaderInstance* instance = LUMIX_NEW(m_allocator, ShaderInstance)(*this);
+	m_instances.push(instance);
+	instance->m_define_mask = getDefineMaskFromDense(dense_mask);
+	instance->createPrograms();
+	return instance;
+}
 
-		instance->m_define_mask = getDefineMaskFromDense(mask);
 
-		for (int pass_idx = 0; pass_idx < m_combintions.m_pass_count; ++pass_idx)
-		{
-			const char* pass = m_combintions.m_passes[pass_idx];
-			char path[MAX_PATH_LENGTH];
-			copyString(path, "shaders/compiled/");
-			catString(path, basename);
-			catString(path, "_");
-			catString(path, pass);
-			char mask_str[10];
-			int actual_mask = mask & m_combintions.m_vs_local_mask[pass_idx];
-			toCString(actual_mask, mask_str, sizeof(mask_str));
-			catString(path, mask_str);
-			catString(path, "_vs.shb");
-
-			Path vs_path(path);
-			auto* vs_binary = static_cast<ShaderBinary*>(binary_manager->load(vs_path));
-			addDependency(*vs_binary);
-			instance->m_binaries[pass_idx * 2] = vs_binary;
-
-			copyString(path, "shaders/compiled/");
-			catString(path, basename);
-			catString(path, "_");
-			catString(path, pass);
-			actual_mask = mask & m_combintions.m_fs_local_mask[pass_idx];
-			toCString(actual_mask, mask_str, sizeof(mask_str));
-			catString(path, mask_str);
-			catString(path, "_fs.shb");
-
-			Path fs_path(path);
-			auto* fs_binary = static_cast<ShaderBinary*>(binary_manager->load(fs_path));
-			addDependency(*fs_binary);
-			instance->m_binaries[pass_idx * 2 + 1] = fs_binary;
-		}
-	}
-	return true;
+uint32 Shader::getPackKey(const char* pass, int mask, bool is_vertex)
+{
+	char key[64];
+	copyString(key, pass);
+	char mask_str[10];
+	toCString(mask, mask_str, sizeof(mask_str));
+	catString(key, mask_str);
+	catString(key, is_vertex ? "_vs" : "_fs");
+	return crc32(key);
 }
 
 
@@ -388,14 +383,8 @@ static void vs(lua_State* L)
 }
 
 
-static void registerFunctions(Shader* shader, ShaderCombinations* combinations, Renderer* renderer, lua_State* L)
+void Shader::registerLuaAPI(lua_State* L)
 {
-	lua_pushlightuserdata(L, combinations);
-	lua_setglobal(L, "this");
-	lua_pushlightuserdata(L, renderer);
-	lua_setglobal(L, "renderer");
-	lua_pushlightuserdata(L, shader);
-	lua_setglobal(L, "shader");
 	registerCFunction(L, "pass", &LuaWrapper::wrap<decltype(&pass), pass>);
 	registerCFunction(L, "fs", &LuaWrapper::wrap<decltype(&fs), fs>);
 	registerCFunction(L, "vs", &LuaWrapper::wrap<decltype(&vs), vs>);
@@ -409,30 +398,74 @@ static void registerFunctions(Shader* shader, ShaderCombinations* combinations,
 }
 
 
-bool Shader::load(FS::IFile& file)
+// Runs a shader definition in the renderer's shared state. The definition gets its own
+// environment, so globals it sets are not visible to the next one.
+static bool runDefinition(Shader* shader,
+	ShaderCombinations* combinations,
+	Renderer& renderer,
+	const char* source,
+	size_t size,
+	const char* name)
 {
-	lua_State* L = luaL_newstate();
-	luaL_openlibs(L);
-	registerFunctions(this, &m_combintions, &getRenderer(), L);
-	m_render_states = BGFX_STATE_CULL_CW | BGFX_STATE_DEPTH_TEST_LEQUAL;
+	lua_State* L = renderer.getShaderState();
+	lua_pushlightuserdata(L, combinations);
+	lua_setglobal(L, "this");
+	lua_pushlightuserdata(L, &renderer);
+	lua_setglobal(L, "renderer");
+	lua_pushlightuserdata(L, shader);
+	lua_setglobal(L, "shader");
 
-	bool errors = luaL_loadbuffer(L, (const char*)file.getBuffer(), file.size(), "") != LUA_OK;
-	errors = errors || lua_pcall(L, 0, LUA_MULTRET, 0) != LUA_OK;
+	auto& bytecode_cache = renderer.getEngine().getLuaBytecodeCache();
+	bool errors = bytecode_cache.load(L, source, size, name) != LUA_OK;
+	if (!errors)
+	{
+		lua_newtable(L);
+		lua_newtable(L);
+		lua_pushglobaltable(L);
+		lua_setfield(L, -2, "__index");
+		lua_setmetatable(L, -2);
+		LuaWrapper::setEnvironment(L, -2);
+		errors = lua_pcall(L, 0, 0, 0) != LUA_OK;
+	}
 	if (errors)
 	{
-		g_log_error.log("Renderer") << getPath().c_str() << ": " << lua_tostring(L, -1);
+		g_log_error.log("Renderer") << name << ": " << lua_tostring(L, -1);
 		lua_pop(L, 1);
-		return false;
 	}
-	
-	if (!generateInstances())
+
+	lua_pushnil(L);
+	lua_setglobal(L, "this");
+	lua_pushnil(L);
+	lua_setglobal(L, "renderer");
+	lua_pushnil(L);
+	lua_setglobal(L, "shader");
+	return !errors;
+}
+
+
+bool Shader::load(FS::IFile& file)
+{
+	m_render_states = BGFX_STATE_CULL_CW | BGFX_STATE_DEPTH_TEST_LEQUAL;
+	const char* source = (const char*)file.getBuffer();
+	if (!runDefinition(this, &m_combintions, getRenderer(), source, file.size(), getPath().c_str()))
 	{
-		g_log_error.log("Renderer") << "Could not load instances of shader " << getPath().c_str();
 		return false;
 	}
+	
+	char basename[MAX_PATH_LENGTH];
+	PathUtils::getBasename(basename, sizeof(basename), getPath().c_str());
+	char pack_path[MAX_PATH_LENGTH];
+	copyString(pack_path, "shaders/compiled/");
+	catString(pack_path, basename);
+	catString(pack_path, ".shp");
+	auto* binary_manager = m_resource_manager.get(ResourceManager::SHADER_BINARY);
+	m_binary = static_cast<ShaderBinary*>(binary_manager->load(Path(pack_path)));
+	addDependency(*m_binary);
+
+	// other combinations are created when materials ask for them
+	createInstance(0);
 
 	m_size = file.size();
-	lua_close(L);
 	return true;
 }
 
@@ -441,23 +474,13 @@ void Shader::onBeforeReady()
 {
 	for (auto* instance : m_instances)
 	{
-		auto** binaries = instance->m_binaries;
-		for (int i = 0; i < Lumix::lengthOf(instance->m_binaries); i += 2)
-		{
-			if (!binaries[i] || !binaries[i + 1]) continue;
-
-			auto vs_handle = binaries[i]->getHandle();
-			auto fs_handle = binaries[i + 1]->getHandle();
-			auto program = bgfx::createProgram(vs_handle, fs_handle);
-
-			ASSERT(bgfx::isValid(program));
-
-			int pass_idx = i / 2;
-			int global_idx = getRenderer().getPassIdx(m_combintions.m_passes[pass_idx]);
-
-			instance->m_program_handles[global_idx] = program;
-		}
+		instance->createPrograms();
+	}
+	for (uint32 mask : m_precached_masks)
+	{
+		getInstance(mask);
 	}
+	m_precached_masks.clear();
 }
 
 
@@ -486,26 +509,59 @@ void Shader::unload(void)
 		LUMIX_DELETE(m_allocator, i);
 	}
 	m_instances.clear();
+	m_precached_masks.clear();
+
+	// programs are destroyed before the shaders of the pack
+	if (m_binary)
+	{
+		ShaderBinary* binary = m_binary;
+		m_binary = nullptr;
+		removeDependency(*binary);
+		m_resource_manager.get(ResourceManager::SHADER_BINARY)->unload(*binary);
+	}
 }
 
 
-ShaderInstance::~ShaderInstance()
+void ShaderInstance::createPrograms()
 {
-	for (int i = 0; i < lengthOf(m_program_handles); ++i)
+	ShaderBinary* binary = m_shader.m_binary;
+	if (!binary || !binary->isReady()) return;
+
+	const ShaderCombinations& combinations = m_shader.m_combintions;
+	ShaderManager& manager = m_shader.getShaderManager();
+	uint32 dense_mask = m_shader.getDenseFromDefineMask(m_define_mask);
+	for (int i = 0; i < combinations.m_pass_count; ++i)
 	{
-		if (bgfx::isValid(m_program_handles[i]))
+		const char* pass = combinations.m_passes[i];
+		int global_idx = m_shader.getRenderer().getPassIdx(pass);
+		if (bgfx::isValid(m_program_handles[global_idx])) continue;
+
+		int vs_mask = dense_mask & combinations.m_vs_local_mask[i];
+		int fs_mask = dense_mask & combinations.m_fs_local_mask[i];
+		auto vs_handle = binary->getHandle(pass, vs_mask, true);
+		auto fs_handle = binary->getHandle(pass, fs_mask, false);
+		if (!bgfx::isValid(vs_handle) || !bgfx::isValid(fs_handle))
 		{
-			bgfx::destroyProgram(m_program_handles[i]);
+			g_log_error.log("Renderer") << "Shader " << m_shader.getPath().c_str()
+										<< " is missing pass " << pass << " for defines "
+										<< m_define_mask;
+			continue;
 		}
+		m_program_handles[global_idx] = manager.getProgram(vs_handle, fs_handle);
+		ASSERT(bgfx::isValid(m_program_handles[global_idx]));
 	}
+}
 
-	for (auto* binary : m_binaries)
-	{
-		if (!binary) continue;
 
-		m_shader.removeDependency(*binary);
-		auto* manager = binary->getResourceManager().get(ResourceManager::SHADER_BINARY);
-		manager->unload(*binary);
+ShaderInstance::~ShaderInstance()
+{
+	ShaderManager& manager = m_shader.getShaderManager();
+	for (int i = 0; i < lengthOf(m_program_handles); ++i)
+	{
+		if (bgfx::isValid(m_program_handles[i]))
+		{
+			manager.releaseProgram(m_program_handles[i]);
+		}
 	}
 }
 
@@ -514,21 +570,8 @@ bool Shader::getShaderCombinations(Renderer& renderer,
 	const char* shader_content,
 	ShaderCombinations* output)
 {
-	lua_State* L = luaL_newstate();
-	luaL_openlibs(L);
-	registerFunctions(nullptr, output, &renderer, L);
-
-	bool errors = luaL_loadbuffer(L, shader_content, stringLength(shader_content), "") != LUA_OK;
-	errors = errors || lua_pcall(L, 0, LUA_MULTRET, 0) != LUA_OK;
-	if (errors)
-	{
-		g_log_error.log("Renderer") << lua_tostring(L, -1);
-		lua_pop(L, 1);
-		lua_close(L);
-		return false;
-	}
-	lua_close(L);
-	return true;
+	return runDefinition(
+		nullptr, output, renderer, shader_content, stringLength(shader_content), "shader");
 }
 
 
@@ -536,26 +579,85 @@ ShaderBinary::ShaderBinary(const Path& path,
 	ResourceManager& resource_manager,
 	IAllocator& allocator)
 	: Resource(path, resource_manager, allocator)
-	, m_handle(BGFX_INVALID_HANDLE)
+	, m_allocator(allocator)
+	, m_bytecode(allocator)
+	, m_blobs(allocator)
+	, m_handles(allocator)
+	, m_entries(allocator)
+{
+}
+
+
+ShaderBinary::~ShaderBinary()
 {
+	ASSERT(isEmpty());
+}
+
+
+bgfx::ShaderHandle ShaderBinary::getHandle(const char* pass, int mask, bool is_vertex)
+{
+	auto iter = m_entries.find(Shader::getPackKey(pass, mask, is_vertex));
+	if (!iter.isValid()) return BGFX_INVALID_HANDLE;
+
+	int blob_idx = iter.value();
+	bgfx::ShaderHandle& handle = m_handles[blob_idx];
+	if (bgfx::isValid(handle)) return handle;
+
+	const ShaderPackBlob& blob = m_blobs[blob_idx];
+	auto* mem = bgfx::alloc(blob.size + 1);
+	copyMemory(mem->data, &m_bytecode[blob.offset], blob.size);
+	mem->data[blob.size] = '\0';
+	handle = bgfx::createShader(mem);
+	return handle;
 }
 
 
 void ShaderBinary::unload()
 {
-	if (bgfx::isValid(m_handle)) bgfx::destroyShader(m_handle);
-	m_handle = BGFX_INVALID_HANDLE;
+	for (auto handle : m_handles)
+	{
+		if (bgfx::isValid(handle)) bgfx::destroyShader(handle);
+	}
+	m_handles.clear();
+	m_blobs.clear();
+	m_bytecode.clear();
+	m_entries.clear();
 }
 
 
 bool ShaderBinary::load(FS::IFile& file)
 {
-	auto* mem = bgfx::alloc((uint32)file.size() + 1);
-	file.read(mem->data, file.size());
-	mem->data[file.size()] = '\0';
-	m_handle = bgfx::createShader(mem);
+	ShaderPackHeader header;
+	if (!file.read(&header, sizeof(header)) || header.magic != ShaderPackHeader::MAGIC ||
+		header.version != ShaderPackHeader::VERSION)
+	{
+		g_log_error.log("Renderer") << "Invalid shader pack " << getPath().c_str();
+		return false;
+	}
+
+	for (uint32 i = 0; i < header.entry_count; ++i)
+	{
+		ShaderPackEntry entry;
+		file.read(&entry, sizeof(entry));
+		if (entry.blob >= header.blob_count) return false;
+		m_entries.insert(entry.key, entry.blob);
+	}
+
+	m_blobs.resize(header.blob_count);
+	if (header.blob_count > 0) file.read(&m_blobs[0], sizeof(m_blobs[0]) * header.blob_count);
+
+	size_t bytecode_size = file.size() - file.pos();
+	m_bytecode.resize((int)bytecode_size);
+	if (bytecode_size > 0) file.read(&m_bytecode[0], bytecode_size);
+	for (const ShaderPackBlob& blob : m_blobs)
+	{
+		if (blob.offset + blob.size > bytecode_size) return false;
+	}
+
+	m_handles.resize(header.blob_count);
+	for (auto& handle : m_handles) handle = BGFX_INVALID_HANDLE;
 	m_size = file.size();
-	return bgfx::isValid(m_handle);
+	return true;
 }
 
 
@@ -1,5 +1,6 @@
 #pragma once
 #include "core/array.h"
+#include "core/hash_map.h"
 #include "core/resource.h"
 #include <bgfx/bgfx.h>
 
@@ -18,8 +19,11 @@ class IFile;
 class Renderer;
 class Shader;
 class ShaderBinary;
+class ShaderManager;
 
 
+// programs of one define combination, created from the shader's binary pack when it is loaded,
+// until then the handles are invalid; the programs are shared through ShaderManager
 class ShaderInstance
 {
 public:
@@ -29,14 +33,13 @@ public:
 		for (int i = 0; i < lengthOf(m_program_handles); ++i)
 		{
 			m_program_handles[i] = BGFX_INVALID_HANDLE;
-			m_binaries[i * 2] = nullptr;
-			m_binaries[i * 2 + 1] = nullptr;
 		}
 	}
 	~ShaderInstance();
 
+	void createPrograms();
+
 	bgfx::ProgramHandle m_program_handles[32];
-	ShaderBinary* m_binaries[64];
 	uint32 m_define_mask;
 	Shader& m_shader;
 };
@@ -61,18 +64,54 @@ struct LUMIX_RENDERER_API ShaderCombinations
 };
 
 
+// shaders/compiled/<name>.shp, all compiled permutations of a shader, the header is followed by
+// the entries, the blobs and the bytecode; identical bytecode of different masks is stored once
+struct ShaderPackHeader
+{
+	static const uint32 MAGIC = 0x5048534C; // "LSHP"
+	static const uint32 VERSION = 0;
+
+	uint32 magic;
+	uint32 version;
+	uint32 entry_count;
+	uint32 blob_count;
+};
+
+
+struct ShaderPackEntry
+{
+	uint32 key; // Shader::getPackKey
+	uint32 blob;
+};
+
+
+struct ShaderPackBlob
+{
+	uint32 offset; // from the start of the bytecode
+	uint32 size;
+};
+
+
+// the binary pack of a shader, bgfx shaders are created on the first request of a permutation
 class LUMIX_RENDERER_API ShaderBinary : public Resource
 {
 public:
 	ShaderBinary(const Path& path, ResourceManager& resource_manager, IAllocator& allocator);
-	bgfx::ShaderHandle getHandle() { return m_handle; }
+	~ShaderBinary();
+
+	// invalid handle if the pack does not contain the permutation
+	bgfx::ShaderHandle getHandle(const char* pass, int mask, bool is_vertex);
 
 private:
 	void unload() override;
 	bool load(FS::IFile& file) override;
 
 private:
-	bgfx::ShaderHandle m_handle;
+	IAllocator& m_allocator;
+	Array<uint8> m_bytecode;
+	Array<ShaderPackBlob> m_blobs;
+	Array<bgfx::ShaderHandle> m_handles;
+	HashMap<uint32, int> m_entries;
 };
 
 
@@ -122,20 +161,29 @@ public:
 	~Shader();
 
 	bool hasDefine(uint8 define_idx) const;
+	// instances are created on the first request of their combination, defines the shader does
+	// not have are ignored
 	ShaderInstance& getInstance(uint32 mask);
 	ShaderInstance* getFirstInstance();
+	// starts loading the binaries of the combination so they are there when a material needs them
+	void precache(uint32 mask);
 	const TextureSlot& getTextureSlot(int index) const { return m_texture_slots[index]; }
 	int getTextureSlotCount() const { return m_texture_slot_count; }
 	Renderer& getRenderer();
 	Uniform& getUniform(int index) { return m_uniforms[index]; }
 	int getUniformCount() const { return m_uniforms.size(); }
 
+	// key of the permutation in the binary pack, `mask` is local to the pass
+	static uint32 getPackKey(const char* pass, int mask, bool is_vertex);
 	static bool getShaderCombinations(Renderer& renderer,
 		const char* shader_content,
 		ShaderCombinations* output);
+	static void registerLuaAPI(lua_State* L);
 
 	IAllocator& m_allocator;
 	Array<ShaderInstance*> m_instances;
+	Array<uint32> m_precached_masks;
+	ShaderBinary* m_binary;
 	ShaderCombinations m_combintions;
 	uint64 m_render_states;
 	TextureSlot m_texture_slots[MAX_TEXTURE_SLOT_COUNT];
@@ -143,8 +191,10 @@ public:
 	Array<Uniform> m_uniforms;
 
 private:
-	bool generateInstances();
+	ShaderManager& getShaderManager();
+	ShaderInstance* createInstance(uint32 dense_mask);
 	uint32 getDefineMaskFromDense(uint32 dense) const;
+	uint32 getDenseFromDefineMask(uint32 mask) const;
 
 	void onBeforeReady() override;
 	void unload(void) override;
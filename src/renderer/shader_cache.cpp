@@ -0,0 +1,245 @@
+#include "shader_cache.h"
+#include "core/fs/os_file.h"
+#include "core/log.h"
+#include "core/string.h"
+#include "core/system.h"
+
+
+namespace Lumix
+{
+
+
+static const uint32 INDEX_MAGIC = 0x58444353; // 'SCDX'
+static const uint32 ENTRY_MAGIC = 0x4E454353; // 'SCEN'
+static const uint32 INDEX_VERSION = 0;
+
+
+struct IndexHeader
+{
+	uint32 magic;
+	uint32 version;
+	uint32 device_key;
+	int32 entry_count;
+};
+
+
+struct EntryHeader
+{
+	uint32 magic;
+	uint32 size;
+	uint64 id;
+};
+
+
+ShaderCache::ShaderCache(IAllocator& allocator)
+	: m_allocator(allocator)
+	, m_entries(allocator)
+	, m_mutex(false)
+	, m_device_key(0)
+	, m_max_size(DEFAULT_MAX_SIZE)
+	, m_total_size(0)
+{
+	m_directory[0] = '\0';
+}
+
+
+ShaderCache::~ShaderCache()
+{
+	close();
+}
+
+
+bool ShaderCache::open(const char* directory, uint32 device_key, uint32 max_size)
+{
+	close();
+	if (!makePath(directory))
+	{
+		g_log_warning.log("Renderer") << "Could not create shader cache " << directory;
+		return false;
+	}
+
+	MT::SpinLock lock(m_mutex);
+	copyString(m_directory, directory);
+	m_device_key = device_key;
+	m_max_size = max_size;
+
+	char path[MAX_PATH_LENGTH];
+	getIndexPath(path);
+	FS::OsFile file;
+	if (file.open(path, FS::Mode::OPEN_AND_READ, m_allocator))
+	{
+		IndexHeader header;
+		if (file.read(&header, sizeof(header)) && header.magic == INDEX_MAGIC &&
+			header.version == INDEX_VERSION && header.entry_count > 0 &&
+			file.size() == sizeof(header) + header.entry_count * sizeof(Entry))
+		{
+			m_entries.resize(header.entry_count);
+			if (!file.read(&m_entries[0], header.entry_count * sizeof(Entry))) m_entries.clear();
+			// compiled for another GPU or driver, nothing can be reused
+			if (header.device_key != device_key)
+			{
+				while (!m_entries.empty()) removeEntry(m_entries.size() - 1);
+			}
+		}
+		file.close();
+	}
+
+	m_total_size = 0;
+	for (const Entry& entry : m_entries) m_total_size += entry.size;
+	return true;
+}
+
+
+void ShaderCache::close()
+{
+	MT::SpinLock lock(m_mutex);
+	if (!isOpen()) return;
+	saveIndex();
+	m_entries.clear();
+	m_total_size = 0;
+	m_directory[0] = '\0';
+}
+
+
+uint32 ShaderCache::getEntrySize(uint64 id)
+{
+	MT::SpinLock lock(m_mutex);
+	int index = findEntry(id);
+	return index < 0 ? 0 : m_entries[index].size;
+}
+
+
+bool ShaderCache::read(uint64 id, void* data, uint32 size)
+{
+	MT::SpinLock lock(m_mutex);
+	int index = findEntry(id);
+	if (index < 0 || m_entries[index].size != size) return false;
+
+	char path[MAX_PATH_LENGTH];
+	getEntryPath(id, path);
+	FS::OsFile file;
+	if (!file.open(path, FS::Mode::OPEN_AND_READ, m_allocator))
+	{
+		removeEntry(index);
+		return false;
+	}
+	EntryHeader header;
+	bool success = file.read(&header, sizeof(header)) && header.magic == ENTRY_MAGIC &&
+				   header.id == id && header.size == size &&
+				   // a file which was not written completely has a different size
+				   file.size() == sizeof(header) + size && file.read(data, size);
+	file.close();
+
+	if (success)
+	{
+		touchEntry(index);
+	}
+	else
+	{
+		removeEntry(index);
+	}
+	return success;
+}
+
+
+void ShaderCache::write(uint64 id, const void* data, uint32 size)
+{
+	MT::SpinLock lock(m_mutex);
+	if (!isOpen() || size > m_max_size) return;
+
+	int index = findEntry(id);
+	if (index >= 0) removeEntry(index);
+
+	char path[MAX_PATH_LENGTH];
+	getEntryPath(id, path);
+	FS::OsFile file;
+	if (!file.open(path, FS::Mode::CREATE | FS::Mode::WRITE, m_allocator))
+	{
+		g_log_warning.log("Renderer") << "Could not write shader cache entry " << path;
+		return;
+	}
+	EntryHeader header;
+	header.magic = ENTRY_MAGIC;
+	header.size = size;
+	header.id = id;
+	bool success = file.write(&header, sizeof(header)) && file.write(data, size);
+	file.close();
+	if (!success)
+	{
+		deleteFile(path);
+		return;
+	}
+
+	Entry& entry = m_entries.emplace();
+	entry.id = id;
+	entry.size = size;
+	m_total_size += size;
+	while (m_total_size > m_max_size) removeEntry(0);
+	saveIndex();
+}
+
+
+int ShaderCache::findEntry(uint64 id) const
+{
+	for (int i = m_entries.size() - 1; i >= 0; --i)
+	{
+		if (m_entries[i].id == id) return i;
+	}
+	return -1;
+}
+
+
+void ShaderCache::touchEntry(int index)
+{
+	Entry entry = m_entries[index];
+	m_entries.erase(index);
+	m_entries.push(entry);
+}
+
+
+void ShaderCache::removeEntry(int index)
+{
+	char path[MAX_PATH_LENGTH];
+	getEntryPath(m_entries[index].id, path);
+	deleteFile(path);
+	m_total_size -= m_entries[index].size;
+	m_entries.erase(index);
+}
+
+
+void ShaderCache::getEntryPath(uint64 id, char (&path)[MAX_PATH_LENGTH]) const
+{
+	char tmp[30];
+	toCString(id, tmp, lengthOf(tmp));
+	copyString(path, m_directory);
+	catString(path, tmp);
+	catString(path, ".shc");
+}
+
+
+void ShaderCache::getIndexPath(char (&path)[MAX_PATH_LENGTH]) const
+{
+	copyString(path, m_directory);
+	catString(path, "index.shc");
+}
+
+
+void ShaderCache::saveIndex()
+{
+	char path[MAX_PATH_LENGTH];
+	getIndexPath(path);
+	FS::OsFile file;
+	if (!file.open(path, FS::Mode::CREATE | FS::Mode::WRITE, m_allocator)) return;
+
+	IndexHeader header;
+	header.magic = INDEX_MAGIC;
+	header.version = INDEX_VERSION;
+	header.device_key = m_device_key;
+	header.entry_count = m_entries.size();
+	file.write(&header, sizeof(header));
+	if (!m_entries.empty()) file.write(&m_entries[0], m_entries.size() * sizeof(Entry));
+	file.close();
+}
+
+
+} // namespace Lumix
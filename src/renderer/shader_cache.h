@@ -0,0 +1,66 @@
+#pragma once
+
+
+#include "lumix.h"
+#include "core/array.h"
+#include "core/mt/sync.h"
+
+
+namespace Lumix
+{
+
+
+class IAllocator;
+
+
+// Disk cache of compiled shaders and program binaries bgfx asks for through its callback. Entries
+// are files named by the id bgfx gives them, an index remembers their sizes in least recently used
+// order, so the oldest ones are deleted when the cache grows over its limit. The whole cache is
+// thrown away when it was written for a different GPU or renderer backend.
+class LUMIX_RENDERER_API ShaderCache
+{
+public:
+	static const uint32 DEFAULT_MAX_SIZE = 64 * 1024 * 1024;
+
+	explicit ShaderCache(IAllocator& allocator);
+	~ShaderCache();
+
+	// directory must end with a slash, device_key identifies the GPU, driver and backend
+	bool open(const char* directory, uint32 device_key, uint32 max_size);
+	void close();
+	bool isOpen() const { return m_directory[0] != '\0'; }
+
+	// 0 if there is no such entry
+	uint32 getEntrySize(uint64 id);
+	bool read(uint64 id, void* data, uint32 size);
+	void write(uint64 id, const void* data, uint32 size);
+	uint32 getTotalSize() const { return m_total_size; }
+	int getEntryCount() const { return m_entries.size(); }
+
+private:
+	struct Entry
+	{
+		uint64 id;
+		uint32 size;
+	};
+
+private:
+	int findEntry(uint64 id) const;
+	void touchEntry(int index);
+	void removeEntry(int index);
+	void getEntryPath(uint64 id, char (&path)[MAX_PATH_LENGTH]) const;
+	void getIndexPath(char (&path)[MAX_PATH_LENGTH]) const;
+	void saveIndex();
+
+private:
+	IAllocator& m_allocator;
+	Array<Entry> m_entries;
+	MT::SpinMutex m_mutex;
+	char m_directory[MAX_PATH_LENGTH];
+	uint32 m_device_key;
+	uint32 m_max_size;
+	uint32 m_total_size;
+};
+
+
+} // namespace Lumix
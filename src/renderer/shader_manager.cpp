@@ -11,6 +11,8 @@ namespace Lumix
 ShaderManager::ShaderManager(Renderer& renderer, IAllocator& allocator)
 	: ResourceManagerBase(allocator)
 	, m_allocator(allocator)
+	, m_programs(allocator)
+	, m_program_keys(allocator)
 	, m_renderer(renderer)
 {
 	m_buffer = nullptr;
@@ -20,10 +22,47 @@ ShaderManager::ShaderManager(Renderer& renderer, IAllocator& allocator)
 
 ShaderManager::~ShaderManager()
 {
+	ASSERT(m_programs.size() == 0);
 	LUMIX_DELETE(m_allocator, m_buffer);
 }
 
 
+bgfx::ProgramHandle ShaderManager::getProgram(bgfx::ShaderHandle vs, bgfx::ShaderHandle fs)
+{
+	uint32 key = ((uint32)vs.idx << 16) | fs.idx;
+	auto iter = m_programs.find(key);
+	if (iter.isValid())
+	{
+		++iter.value().ref_count;
+		return iter.value().handle;
+	}
+
+	CachedProgram program;
+	program.handle = bgfx::createProgram(vs, fs);
+	if (!bgfx::isValid(program.handle)) return program.handle;
+	program.ref_count = 1;
+	m_programs.insert(key, program);
+	m_program_keys.insert(program.handle.idx, key);
+	return program.handle;
+}
+
+
+void ShaderManager::releaseProgram(bgfx::ProgramHandle program)
+{
+	auto key_iter = m_program_keys.find(program.idx);
+	ASSERT(key_iter.isValid());
+	if (!key_iter.isValid()) return;
+
+	uint32 key = key_iter.value();
+	auto iter = m_programs.find(key);
+	if (--iter.value().ref_count > 0) return;
+
+	bgfx::destroyProgram(program);
+	m_programs.erase(key);
+	m_program_keys.erase(program.idx);
+}
+
+
 Resource* ShaderManager::createResource(const Path& path)
 {
 	return LUMIX_NEW(m_allocator, Shader)(path, getOwner(), m_allocator);
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "core/hash_map.h"
 #include "core/resource_manager_base.h"
+#include <bgfx/bgfx.h>
 
 namespace Lumix
 {
@@ -32,13 +34,29 @@ namespace Lumix
 
 		Renderer& getRenderer() { return m_renderer; }
 		uint8* getBuffer(int32 size);
+		// programs are shared by all instances of all shaders with the same pair of binaries,
+		// every getProgram must be matched by a releaseProgram
+		bgfx::ProgramHandle getProgram(bgfx::ShaderHandle vs, bgfx::ShaderHandle fs);
+		void releaseProgram(bgfx::ProgramHandle program);
+		int getProgramCount() const { return m_programs.size(); }
 
 	protected:
 		Resource* createResource(const Path& path) override;
 		void destroyResource(Resource& resource) override;
 
+	private:
+		struct CachedProgram
+		{
+			bgfx::ProgramHandle handle;
+			int ref_count;
+		};
+
 	private:
 		IAllocator& m_allocator;
+		// by the pair of shader handles
+		HashMap<uint32, CachedProgram> m_programs;
+		// program handle to its key in m_programs
+		HashMap<uint32, uint32> m_program_keys;
 		uint8* m_buffer;
 		int32 m_buffer_size;
 		Renderer& m_renderer;
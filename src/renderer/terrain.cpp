@@ -4,12 +4,17 @@
 #include "core/crc32.h"
 #include "core/frustum.h"
 #include "core/json_serializer.h"
-#include "core/lifo_allocator.h"
 #include "core/log.h"
 #include "core/math_utils.h"
+#include "core/mt/atomic.h"
+#include "core/mt/thread.h"
+#include "core/mtjd/generic_job.h"
+#include "core/mtjd/manager.h"
 #include "core/profiler.h"
+#include "core/radix_sort.h"
 #include "core/resource_manager.h"
 #include "core/resource_manager_base.h"
+#include "core/string.h"
 #include "engine.h"
 #include "renderer/material.h"
 #include "renderer/model.h"
@@ -20,6 +25,7 @@
 #include "universe/universe.h"
 #include <cfloat>
 #include <cmath>
+#include <emmintrin.h>
 
 
 namespace Lumix
@@ -30,6 +36,9 @@ static const int GRASS_QUAD_SIZE = 10;
 static const float GRASS_QUAD_RADIUS = GRASS_QUAD_SIZE * 0.7072f;
 static const int GRID_SIZE = 16;
 static const int COPY_COUNT = 50;
+static const int GRASS_QUAD_BLOCK_SIZE = 16;
+// cells in a side of the smallest block with a known height range
+static const int HEIGHT_RANGE_BLOCK_SIZE = 8;
 static const uint32 TERRAIN_HASH = crc32("terrain");
 static const uint32 MORPH_CONST_HASH = crc32("morph_const");
 static const uint32 QUAD_SIZE_HASH = crc32("quad_size");
@@ -60,6 +69,8 @@ struct TerrainQuad
 
 	explicit TerrainQuad(IAllocator& allocator)
 		: m_allocator(allocator)
+		, m_margin(-1)
+		, m_is_split(false)
 	{
 		for (int i = 0; i < CHILD_COUNT; ++i)
 		{
@@ -136,43 +147,98 @@ struct TerrainQuad
 		return (size > 17 ? 2.25f : 1.25f) * Math::SQRT2 * size;
 	}
 
-	bool getInfos(Array<const TerrainInfo*>& infos,
-		const Vec3& camera_pos,
-		Terrain* terrain,
+	// A node is split when the camera is closer than its outer radius. The distance changes at
+	// most as much as the camera moves, so a decision holds while the camera stays within
+	// m_margin of m_ref_point; m_margin also covers the split children, so the whole subtree is
+	// skipped until the camera gets that far.
+	void updateLOD(const Vec3& camera_pos)
+	{
+		if ((camera_pos - m_ref_point).squaredLength() < m_margin * m_margin) return;
+
+		m_ref_point = camera_pos;
+		if (m_lod <= 1)
+		{
+			m_is_split = true;
+			m_margin = FLT_MAX;
+		}
+		else
+		{
+			float dist = sqrtf(getSquaredDistance(camera_pos));
+			float r = getRadiusOuter(m_size);
+			m_is_split = dist <= r;
+			m_margin = fabsf(dist - r);
+		}
+		if (!m_is_split) return;
+
+		for (auto* child : m_children)
+		{
+			if (!child) continue;
+			child->updateLOD(camera_pos);
+			if (!child->m_is_split) continue;
+			float child_margin = child->m_margin - (child->m_ref_point - m_ref_point).length();
+			m_margin = Math::minValue(m_margin, child_margin);
+		}
+	}
+
+
+	static bool isVisible(const Frustum& frustum,
 		const Matrix& world_matrix,
-		LIFOAllocator& allocator)
+		const Vec3& scale,
+		const Vec3& min,
+		float size)
+	{
+		Vec3 half_size(size * scale.x * 0.5f, scale.y * 0.5f, size * scale.z * 0.5f);
+		Vec3 center(min.x * scale.x + half_size.x, half_size.y, min.z * scale.z + half_size.z);
+		return frustum.isSphereInside(world_matrix.multiplyPosition(center), half_size.length());
+	}
+
+
+	// patches of the nodes selected by updateLOD, the infos are owned by the nodes
+	void getInfos(Array<const TerrainInfo*>& infos,
+		const Frustum& frustum,
+		Terrain* terrain,
+		const Matrix& world_matrix)
 	{
-		float squared_dist = getSquaredDistance(camera_pos);
-		float r = getRadiusOuter(m_size);
-		if (squared_dist > r * r && m_lod > 1) return false;
+		const Vec3& scale = terrain->getScale();
+		if (!isVisible(frustum, world_matrix, scale, m_min, m_size)) return;
 
-		Vec3 morph_const(r, getRadiusInner(m_size), 0);
-		Shader& shader = *terrain->getMesh()->material->getShader();
+		Shader* shader = terrain->getMesh()->material->getShader();
 		for (int i = 0; i < CHILD_COUNT; ++i)
 		{
-			if (!m_children[i] ||
-				!m_children[i]->getInfos(infos, camera_pos, terrain, world_matrix, allocator))
+			TerrainQuad* child = m_children[i];
+			if (child && child->m_is_split)
 			{
-				TerrainInfo* data = (TerrainInfo*)allocator.allocate(sizeof(TerrainInfo));
-				data->m_morph_const = morph_const;
-				data->m_index = i;
-				data->m_terrain = terrain;
-				data->m_size = m_size;
-				data->m_min = m_min;
-				data->m_shader = &shader;
-				data->m_world_matrix = world_matrix;
-				infos.push(data);
+				child->getInfos(infos, frustum, terrain, world_matrix);
+				continue;
 			}
+
+			Vec3 patch_min = m_min;
+			if (i == TOP_RIGHT || i == BOTTOM_RIGHT) patch_min.x += m_size * 0.5f;
+			if (i == BOTTOM_LEFT || i == BOTTOM_RIGHT) patch_min.z += m_size * 0.5f;
+			if (!isVisible(frustum, world_matrix, scale, patch_min, m_size * 0.5f)) continue;
+
+			TerrainInfo& info = m_infos[i];
+			info.m_morph_const.set(getRadiusOuter(m_size), getRadiusInner(m_size), 0);
+			info.m_index = i;
+			info.m_terrain = terrain;
+			info.m_size = m_size;
+			info.m_min = m_min;
+			info.m_shader = shader;
+			info.m_world_matrix = world_matrix;
+			infos.push(&info);
 		}
-		return true;
 	}
 
 
 	IAllocator& m_allocator;
 	TerrainQuad* m_children[CHILD_COUNT];
+	TerrainInfo m_infos[CHILD_COUNT];
 	Vec3 m_min;
 	float m_size;
 	int m_lod;
+	Vec3 m_ref_point;
+	float m_margin;
+	bool m_is_split;
 };
 
 
@@ -194,16 +260,25 @@ Terrain::Terrain(Renderer& renderer, Entity entity, RenderScene& scene, IAllocat
 	, m_last_camera_position(m_allocator)
 	, m_grass_types(m_allocator)
 	, m_free_grass_quads(m_allocator)
+	, m_generating_grass_quads(m_allocator)
+	, m_grass_quad_blocks(m_allocator)
 	, m_renderer(renderer)
 	, m_vertices_handle(BGFX_INVALID_HANDLE)
 	, m_indices_handle(BGFX_INVALID_HANDLE)
 	, m_grass_distance(5)
+	, m_height_ranges(m_allocator)
+	, m_height_range_offsets(m_allocator)
+	, m_height_ranges_width(0)
+	, m_height_ranges_height(0)
+	, m_listened_heightmap(nullptr)
+	, m_listened_splatmap(nullptr)
 {
 	generateGeometry();
 }
 
 Terrain::GrassType::~GrassType()
 {
+	if (bgfx::isValid(m_gpu_instances)) bgfx::destroyVertexBuffer(m_gpu_instances);
 	if (m_grass_model)
 	{
 		m_grass_model->getResourceManager().get(ResourceManager::MODEL)->unload(*m_grass_model);
@@ -213,6 +288,7 @@ Terrain::GrassType::~GrassType()
 
 Terrain::~Terrain()
 {
+	finishGrassJobs();
 	bgfx::destroyIndexBuffer(m_indices_handle);
 	bgfx::destroyVertexBuffer(m_vertices_handle);
 
@@ -223,17 +299,13 @@ Terrain::~Terrain()
 	{
 		LUMIX_DELETE(m_allocator, m_grass_types[i]);
 	}
-	for (int j = 0; j < m_grass_quads.size(); ++j)
+	for (GrassQuad* block : m_grass_quad_blocks)
 	{
-		Array<GrassQuad*>& quads = m_grass_quads.at(j);
-		for (int i = 0; i < quads.size(); ++i)
+		for (int i = 0; i < GRASS_QUAD_BLOCK_SIZE; ++i)
 		{
-			LUMIX_DELETE(m_allocator, quads[i]);
+			block[i].~GrassQuad();
 		}
-	}
-	for (int i = 0; i < m_free_grass_quads.size(); ++i)
-	{
-		LUMIX_DELETE(m_allocator, m_free_grass_quads[i]);
+		m_allocator.deallocate(block);
 	}
 }
 
@@ -244,6 +316,8 @@ Terrain::GrassType::GrassType(Terrain& terrain)
 	m_grass_model = nullptr;
 	m_ground = 0;
 	m_density = 10;
+	m_gpu_instances = BGFX_INVALID_HANDLE;
+	m_gpu_instance_count = 0;
 }
 
 
@@ -255,6 +329,7 @@ float Terrain::getRootSize() const
 
 void Terrain::addGrassType(int index)
 {
+	finishGrassJobs();
 	if(index < 0)
 	{
 		m_grass_types.push(LUMIX_NEW(m_allocator, GrassType)(*this));
@@ -334,9 +409,36 @@ void Terrain::setGrassTypePath(int index, const Path& path)
 }
 	
 
+void Terrain::forceGrassUpdate(float from_x, float from_z, float to_x, float to_z)
+{
+	// callers change what the jobs read
+	finishGrassJobs();
+	m_force_grass_update = true;
+	for (int i = 0; i < m_grass_quads.size(); ++i)
+	{
+		Array<GrassQuad*>& quads = m_grass_quads.at(i);
+		for (int j = quads.size() - 1; j >= 0; --j)
+		{
+			const Vec3& pos = quads[j]->pos;
+			if (pos.x > to_x || pos.x + GRASS_QUAD_SIZE < from_x) continue;
+			if (pos.z > to_z || pos.z + GRASS_QUAD_SIZE < from_z) continue;
+			m_free_grass_quads.push(quads[j]);
+			quads.eraseFast(j);
+		}
+	}
+}
+
+
 void Terrain::forceGrassUpdate()
 {
+	// callers change what the jobs read
+	finishGrassJobs();
 	m_force_grass_update = true;
+	for (auto* type : m_grass_types)
+	{
+		if (bgfx::isValid(type->m_gpu_instances)) bgfx::destroyVertexBuffer(type->m_gpu_instances);
+		type->m_gpu_instances = BGFX_INVALID_HANDLE;
+	}
 	for (int i = 0; i < m_grass_quads.size(); ++i)
 	{
 		Array<GrassQuad*>& quads = m_grass_quads.at(i);
@@ -360,10 +462,19 @@ Array<Terrain::GrassQuad*>& Terrain::getQuads(ComponentIndex camera)
 }
 
 
+// the jobs can not share Math::rand, the seed keeps the grass of a quad the same each time
+static float randFloat(uint32& state, float from, float to)
+{
+	state = state * 1664525 + 1013904223;
+	return from + (to - from) * ((state >> 8) / float(1 << 24));
+}
+
+
 void Terrain::generateGrassTypeQuad(GrassPatch& patch,
 									const Matrix& terrain_matrix,
 									float quad_x,
-									float quad_z)
+									float quad_z,
+									uint32& rand_state)
 {
 	if (!patch.m_type->m_grass_model || !patch.m_type->m_grass_model->isReady())
 		return;
@@ -390,35 +501,111 @@ void Terrain::generateGrassTypeQuad(GrassPatch& patch,
 
 			Matrix& grass_mtx = patch.m_matrices.emplace();
 			grass_mtx = Matrix::IDENTITY;
-			float x = quad_x + dx + step * Math::randFloat(-0.5f, 0.5f);
-			float z = quad_z + dz + step * Math::randFloat(-0.5f, 0.5f);
+			float x = quad_x + dx + step * randFloat(rand_state, -0.5f, 0.5f);
+			float z = quad_z + dz + step * randFloat(rand_state, -0.5f, 0.5f);
 			grass_mtx.setTranslation(Vec3(x, getHeight(x, z), z));
-			Quat q(Vec3(0, 1, 0), Math::randFloat(0, Math::PI * 2));
+			Quat q(Vec3(0, 1, 0), randFloat(rand_state, 0, Math::PI * 2));
 			Matrix rotMatrix;
 			q.toMatrix(rotMatrix);
 			grass_mtx = terrain_matrix * grass_mtx * rotMatrix;
-			grass_mtx.multiply3x3(density + Math::randFloat(-0.1f, 0.1f));
+			grass_mtx.multiply3x3(density + randFloat(rand_state, -0.1f, 0.1f));
 		}
 	}
 }
 
 
-void Terrain::updateGrass(ComponentIndex camera)
+// runs on a worker, reads only the splatmap, the heightmap and the grass types, which are not
+// changed while a job runs, see finishGrassJobs
+void Terrain::generateGrassQuad(GrassQuad& quad, const Matrix& terrain_matrix)
 {
 	PROFILE_FUNCTION();
-	if (!m_splatmap)
-		return;
+	uint32 rand_state = uint32((int)quad.pos.x + (int)quad.pos.z * m_grass_distance);
+	float min_y = FLT_MAX;
+	float max_y = -FLT_MAX;
+	for (int i = 0; i < quad.m_patches.size(); ++i)
+	{
+		GrassPatch& patch = quad.m_patches[i];
+		generateGrassTypeQuad(patch, terrain_matrix, quad.pos.x, quad.pos.z, rand_state);
+		for (auto& mtx : patch.m_matrices)
+		{
+			min_y = Math::minValue(mtx.getTranslation().y, min_y);
+			max_y = Math::maxValue(mtx.getTranslation().y, max_y);
+		}
+	}
+
+	quad.pos.y = (max_y + min_y) * 0.5f;
+	quad.radius = Math::maxValue((max_y - min_y) * 0.5f, (float)GRASS_QUAD_SIZE) * 1.42f;
+	MT::memoryBarrier();
+	quad.m_is_generated = 1;
+}
+
+
+Terrain::GrassQuad* Terrain::allocGrassQuad()
+{
+	if (m_free_grass_quads.empty())
+	{
+		auto* block =
+			(GrassQuad*)m_allocator.allocate(sizeof(GrassQuad) * GRASS_QUAD_BLOCK_SIZE);
+		m_grass_quad_blocks.push(block);
+		for (int i = GRASS_QUAD_BLOCK_SIZE - 1; i >= 0; --i)
+		{
+			new (NewPlaceholder(), &block[i]) GrassQuad(m_allocator);
+			m_free_grass_quads.push(&block[i]);
+		}
+	}
+	GrassQuad* quad = m_free_grass_quads.back();
+	m_free_grass_quads.pop();
+	return quad;
+}
 
-	Array<GrassQuad*>& quads = getQuads(camera);
 
-	if (m_free_grass_quads.size() + quads.size() < m_grass_distance * m_grass_distance)
+// moves quads generated on workers to their cameras or back to the pool if the camera has
+// moved away from them in the meantime
+void Terrain::collectGeneratedGrass()
+{
+	for (int i = m_generating_grass_quads.size() - 1; i >= 0; --i)
 	{
-		int new_count = m_grass_distance * m_grass_distance - quads.size();
-		for (int i = 0; i < new_count; ++i)
+		GrassQuad* quad = m_generating_grass_quads[i];
+		if (!quad->m_is_generated) continue;
+
+		MT::memoryBarrier();
+		m_generating_grass_quads.eraseFast(i);
+		if (quad->m_camera < 0)
 		{
-			m_free_grass_quads.push(LUMIX_NEW(m_allocator, GrassQuad)(m_allocator));
+			m_free_grass_quads.push(quad);
+		}
+		else
+		{
+			getQuads(quad->m_camera).push(quad);
 		}
 	}
+}
+
+
+void Terrain::finishGrassJobs()
+{
+	if (m_generating_grass_quads.empty()) return;
+
+	MTJD::Manager& manager = m_scene.getEngine().getMTJDManager();
+	for (GrassQuad* quad : m_generating_grass_quads)
+	{
+		while (!quad->m_is_generated)
+		{
+			if (!manager.tryExecuteJob()) MT::yield();
+		}
+	}
+	collectGeneratedGrass();
+}
+
+
+void Terrain::updateGrass(ComponentIndex camera)
+{
+	PROFILE_FUNCTION();
+	collectGeneratedGrass();
+	if (!m_splatmap)
+		return;
+
+	Array<GrassQuad*>& quads = getQuads(camera);
 
 	Universe& universe = m_scene.getUniverse();
 	Entity camera_entity = m_scene.getCameraEntity(camera);
@@ -439,72 +626,98 @@ void Terrain::updateGrass(ComponentIndex camera)
 	float from_quad_z = cz - (m_grass_distance >> 1) * GRASS_QUAD_SIZE;
 	float to_quad_x = cx + (m_grass_distance >> 1) * GRASS_QUAD_SIZE;
 	float to_quad_z = cz + (m_grass_distance >> 1) * GRASS_QUAD_SIZE;
+	auto isOutside = [&](const GrassQuad* quad) {
+		return quad->pos.x < from_quad_x || quad->pos.x > to_quad_x ||
+			   quad->pos.z < from_quad_z || quad->pos.z > to_quad_z;
+	};
 
-	float old_bounds[4] = {FLT_MAX, -FLT_MAX, FLT_MAX, -FLT_MAX};
 	for (int i = quads.size() - 1; i >= 0; --i)
 	{
-		GrassQuad* quad = quads[i];
-		old_bounds[0] = Math::minValue(old_bounds[0], quad->pos.x);
-		old_bounds[1] = Math::maxValue(old_bounds[1], quad->pos.x);
-		old_bounds[2] = Math::minValue(old_bounds[2], quad->pos.z);
-		old_bounds[3] = Math::maxValue(old_bounds[3], quad->pos.z);
-		if (quad->pos.x < from_quad_x || quad->pos.x > to_quad_x || quad->pos.z < from_quad_z ||
-			quad->pos.z > to_quad_z)
+		if (isOutside(quads[i]))
 		{
 			m_free_grass_quads.push(quads[i]);
 			quads.eraseFast(i);
 		}
 	}
 
-	from_quad_x = Math::maxValue(0.0f, from_quad_x);
-	from_quad_z = Math::maxValue(0.0f, from_quad_z);
-
-	for (float quad_z = from_quad_z; quad_z <= to_quad_z; quad_z += GRASS_QUAD_SIZE)
+	// quads of the window which exist or are being generated
+	int window_size = (m_grass_distance >> 1) * 2 + 1;
+	Array<bool> is_present(m_allocator);
+	is_present.resize(window_size * window_size);
+	setMemory(&is_present[0], 0, is_present.size() * sizeof(is_present[0]));
+	auto markPresent = [&](const GrassQuad* quad) {
+		int x = int((quad->pos.x - from_quad_x) / GRASS_QUAD_SIZE + 0.5f);
+		int z = int((quad->pos.z - from_quad_z) / GRASS_QUAD_SIZE + 0.5f);
+		is_present[x + z * window_size] = true;
+	};
+	for (auto* quad : quads) markPresent(quad);
+	for (auto* quad : m_generating_grass_quads)
 	{
-		for (float quad_x = from_quad_x; quad_x <= to_quad_x; quad_x += GRASS_QUAD_SIZE)
+		if (quad->m_camera != camera) continue;
+		if (isOutside(quad))
 		{
-			if (quad_x >= old_bounds[0] && quad_x <= old_bounds[1] && quad_z >= old_bounds[2] &&
-				quad_z <= old_bounds[3])
-				continue;
+			// dropped when finished, see collectGeneratedGrass
+			quad->m_camera = -1;
+			continue;
+		}
+		markPresent(quad);
+	}
 
-			GrassQuad* quad = nullptr;
-			if (!m_free_grass_quads.empty())
-			{
-				quad = m_free_grass_quads.back();
-				m_free_grass_quads.pop();
-			}
-			else
-			{
-				quad = LUMIX_NEW(m_allocator, GrassQuad)(m_allocator);
-			}
-			quads.push(quad);
-			quad->pos.x = quad_x;
-			quad->pos.z = quad_z;
-			quad->m_patches.clear();
-			srand((int)quad_x + (int)quad_z * m_grass_distance);
-
-			float min_y = FLT_MAX;
-			float max_y = -FLT_MAX;
-			for (auto* grass_type : m_grass_types)
+	struct MissingQuad
+	{
+		float x, z;
+		uint32 squared_dist;
+	};
+	Array<MissingQuad> missing(m_allocator);
+	for (int j = 0; j < window_size; ++j)
+	{
+		for (int i = 0; i < window_size; ++i)
+		{
+			if (is_present[i + j * window_size]) continue;
+			MissingQuad& quad = missing.emplace();
+			quad.x = from_quad_x + i * GRASS_QUAD_SIZE;
+			quad.z = from_quad_z + j * GRASS_QUAD_SIZE;
+			if (quad.x < 0 || quad.z < 0)
 			{
-				Model* model = grass_type->m_grass_model;
-				if (!model || !model->isReady()) continue;
-				GrassPatch& patch = quad->m_patches.emplace(m_allocator);
-				patch.m_matrices.clear();
-				patch.m_type = grass_type;
-
-				generateGrassTypeQuad(patch, mtx, quad_x, quad_z);
-				for (auto mtx : patch.m_matrices)
-				{
-					min_y = Math::minValue(mtx.getTranslation().y, min_y);
-					max_y = Math::maxValue(mtx.getTranslation().y, max_y);
-				}
+				missing.pop();
+				continue;
 			}
+			float dx = quad.x + GRASS_QUAD_SIZE * 0.5f - local_camera_pos.x;
+			float dz = quad.z + GRASS_QUAD_SIZE * 0.5f - local_camera_pos.z;
+			quad.squared_dist = uint32(dx * dx + dz * dz);
+		}
+	}
+	if (missing.empty()) return;
 
-			quad->pos.y = (max_y + min_y) * 0.5f;
-			quad->radius = Math::maxValue((max_y - min_y) * 0.5f, (float)GRASS_QUAD_SIZE) * 1.42f;
+	// the nearest are scheduled first, so they are generated first
+	Array<MissingQuad> tmp(m_allocator);
+	tmp.resize(missing.size());
+	radixSort(&missing[0], &tmp[0], missing.size(), [](const MissingQuad& quad) {
+		return quad.squared_dist;
+	});
 
+	MTJD::Manager& manager = m_scene.getEngine().getMTJDManager();
+	for (const MissingQuad& missing_quad : missing)
+	{
+		GrassQuad* quad = allocGrassQuad();
+		quad->pos.set(missing_quad.x, 0, missing_quad.z);
+		quad->m_camera = camera;
+		quad->m_is_generated = 0;
+		quad->m_patches.clear();
+		for (auto* grass_type : m_grass_types)
+		{
+			Model* model = grass_type->m_grass_model;
+			if (!model || !model->isReady()) continue;
+			GrassPatch& patch = quad->m_patches.emplace(m_allocator);
+			patch.m_type = grass_type;
 		}
+		m_generating_grass_quads.push(quad);
+
+		auto* job = MTJD::makeJob(manager,
+			[this, quad, mtx]() { generateGrassQuad(*quad, mtx); },
+			manager.getJobAllocator(),
+			MTJD::Priority::Low);
+		manager.schedule(job);
 	}
 }
 
@@ -539,6 +752,8 @@ void Terrain::getGrassInfos(const Frustum& frustum, Array<GrassInfo>& infos, Com
 					info.m_matrices = &patch.m_matrices[0];
 					info.m_matrix_count = patch.m_matrices.size();
 					info.m_model = patch.m_type->m_grass_model;
+					info.m_terrain = this;
+					info.m_type = -1;
 				}
 			}
 		}
@@ -546,10 +761,74 @@ void Terrain::getGrassInfos(const Frustum& frustum, Array<GrassInfo>& infos, Com
 }
 
 
+// grid over the whole window with the same step as the CPU grass, the vertex shader moves it
+// with the camera, drops instances on other grounds and fades them out with the distance
+void Terrain::createGPUGrassInstances(GrassType& type)
+{
+	int window_size = (m_grass_distance >> 1) * 2 + 1;
+	float window_length = float(window_size * GRASS_QUAD_SIZE);
+	float step = GRASS_QUAD_SIZE / (float)Math::maxValue(type.m_density, 1);
+	// at most a million instances
+	int row_count = Math::clamp(int(window_length / step), 1, 1 << 10);
+	step = window_length / row_count;
+
+	const bgfx::Memory* mem = bgfx::alloc(row_count * row_count * sizeof(Vec4));
+	Vec4* instances = (Vec4*)mem->data;
+	uint32 rand_state = uint32(type.m_density + type.m_ground * 51);
+	for (int j = 0; j < row_count; ++j)
+	{
+		for (int i = 0; i < row_count; ++i)
+		{
+			Vec4& instance = instances[i + j * row_count];
+			instance.x = (i + 0.5f + randFloat(rand_state, -0.5f, 0.5f)) * step;
+			instance.z = (j + 0.5f + randFloat(rand_state, -0.5f, 0.5f)) * step;
+			instance.y = randFloat(rand_state, 0, Math::PI * 2);
+			instance.w = randFloat(rand_state, -0.1f, 0.1f);
+		}
+	}
+
+	bgfx::VertexDecl decl;
+	decl.begin().add(bgfx::Attrib::TexCoord7, 4, bgfx::AttribType::Float).end();
+	type.m_gpu_instances = bgfx::createVertexBuffer(mem, decl);
+	type.m_gpu_instance_count = row_count * row_count;
+}
+
+
+void Terrain::getGPUGrassInfos(Array<GrassInfo>& infos, ComponentIndex camera)
+{
+	if (!m_material->isReady() || !m_splatmap || !m_heightmap) return;
+
+	Universe& universe = m_scene.getUniverse();
+	Matrix inv_mtx = universe.getMatrix(m_entity);
+	inv_mtx.fastInverse();
+	Vec3 local_camera_pos = inv_mtx.multiplyPosition(
+		universe.getPosition(m_scene.getCameraEntity(camera)));
+	float half_length = float((m_grass_distance >> 1) * GRASS_QUAD_SIZE);
+	float cx = (int)(local_camera_pos.x / (GRASS_QUAD_SIZE)) * (float)GRASS_QUAD_SIZE;
+	float cz = (int)(local_camera_pos.z / (GRASS_QUAD_SIZE)) * (float)GRASS_QUAD_SIZE;
+
+	for (int i = 0; i < m_grass_types.size(); ++i)
+	{
+		GrassType& type = *m_grass_types[i];
+		if (!type.m_grass_model || !type.m_grass_model->isReady()) continue;
+		if (!bgfx::isValid(type.m_gpu_instances)) createGPUGrassInstances(type);
+
+		GrassInfo& info = infos.emplace();
+		info.m_model = type.m_grass_model;
+		info.m_matrices = nullptr;
+		info.m_matrix_count = type.m_gpu_instance_count;
+		info.m_terrain = this;
+		info.m_type = i;
+		info.m_gpu_params.set(cx - half_length, (float)type.m_ground, cz - half_length, half_length);
+	}
+}
+
+
 void Terrain::setMaterial(Material* material)
 {
 	if (material != m_material)
 	{
+		finishGrassJobs();
 		if (m_material)
 		{
 			m_material->getResourceManager().get(ResourceManager::MATERIAL)->unload(*m_material);
@@ -558,6 +837,10 @@ void Terrain::setMaterial(Material* material)
 		m_material = material;
 		m_splatmap = nullptr;
 		m_heightmap = nullptr;
+		stopListeningDataUpdates();
+		clearHeightRanges();
+		// terrain is always around the camera, its textures inherit the material's priority
+		if (m_material) m_material->setPriority(Resource::HIGH_PRIORITY);
 		if (m_mesh && m_material)
 		{
 			m_mesh->material = m_material;
@@ -622,7 +905,9 @@ void Terrain::serialize(OutputBlob& serializer)
 }
 
 
-void Terrain::getInfos(Array<const TerrainInfo*>& infos, const Vec3& camera_pos, LIFOAllocator& allocator)
+void Terrain::getInfos(const Frustum& frustum,
+	const Vec3& lod_ref_point,
+	Array<const TerrainInfo*>& infos)
 {
 	if (!m_root) return;
 	if (!m_material || !m_material->isReady()) return;
@@ -630,10 +915,11 @@ void Terrain::getInfos(Array<const TerrainInfo*>& infos, const Vec3& camera_pos,
 	Matrix matrix = m_scene.getUniverse().getMatrix(m_entity);
 	Matrix inv_matrix = matrix;
 	inv_matrix.fastInverse();
-	Vec3 local_camera_pos = inv_matrix.multiplyPosition(camera_pos);
+	Vec3 local_camera_pos = inv_matrix.multiplyPosition(lod_ref_point);
 	local_camera_pos.x /= m_scale.x;
 	local_camera_pos.z /= m_scale.z;
-	m_root->getInfos(infos, local_camera_pos, this, matrix, allocator);
+	m_root->updateLOD(local_camera_pos);
+	m_root->getInfos(infos, frustum, this, matrix);
 }
 
 
@@ -687,6 +973,127 @@ float Terrain::getHeight(float x, float z)
 }
 	
 
+namespace
+{
+
+
+// format of the heightmap is a template argument, so there is no branch per sample
+template <typename T, int STRIDE> struct HeightmapSampler
+{
+	const T* data;
+	int width;
+	int height;
+	float height_scale;
+
+	float operator()(int x, int z) const
+	{
+		int idx = Math::clamp(x, 0, width) + Math::clamp(z, 0, height) * width;
+		return height_scale * data[idx * STRIDE];
+	}
+};
+
+
+// four points at once, the interpolation matches Terrain::getHeight(float, float)
+template <typename Sampler>
+void sampleHeights(const Sampler& sampler, float scale, const Vec2* xz, float* out, int count)
+{
+	__m128 scale4 = _mm_set1_ps(scale);
+	Vec2 tail[4];
+	for (int i = 0; i < count; i += 4)
+	{
+		const Vec2* p = xz + i;
+		if (count - i < 4)
+		{
+			for (int j = 0; j < 4; ++j) tail[j] = xz[Math::minValue(i + j, count - 1)];
+			p = tail;
+		}
+		__m128 x = _mm_setr_ps(p[0].x, p[1].x, p[2].x, p[3].x);
+		__m128 z = _mm_setr_ps(p[0].y, p[1].y, p[2].y, p[3].y);
+		__m128i int_x = _mm_cvttps_epi32(_mm_div_ps(x, scale4));
+		__m128i int_z = _mm_cvttps_epi32(_mm_div_ps(z, scale4));
+		__m128 dec_x =
+			_mm_div_ps(_mm_sub_ps(x, _mm_mul_ps(_mm_cvtepi32_ps(int_x), scale4)), scale4);
+		__m128 dec_z =
+			_mm_div_ps(_mm_sub_ps(z, _mm_mul_ps(_mm_cvtepi32_ps(int_z), scale4)), scale4);
+		__m128 is_lower = _mm_cmpgt_ps(dec_x, dec_z);
+
+		int32 ix[4];
+		int32 iz[4];
+		_mm_storeu_si128((__m128i*)ix, int_x);
+		_mm_storeu_si128((__m128i*)iz, int_z);
+		int lower_mask = _mm_movemask_ps(is_lower);
+		float h0[4];
+		float h1[4];
+		float h2[4];
+		for (int j = 0; j < 4; ++j)
+		{
+			h0[j] = sampler(ix[j], iz[j]);
+			// the third corner of the triangle the point is in
+			h1[j] = lower_mask & (1 << j) ? sampler(ix[j] + 1, iz[j]) : sampler(ix[j], iz[j] + 1);
+			h2[j] = sampler(ix[j] + 1, iz[j] + 1);
+		}
+
+		__m128 u = _mm_or_ps(_mm_and_ps(is_lower, dec_x), _mm_andnot_ps(is_lower, dec_z));
+		__m128 v = _mm_or_ps(_mm_and_ps(is_lower, dec_z), _mm_andnot_ps(is_lower, dec_x));
+		__m128 a = _mm_loadu_ps(h0);
+		__m128 b = _mm_loadu_ps(h1);
+		__m128 c = _mm_loadu_ps(h2);
+		__m128 res = _mm_add_ps(
+			_mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), u)), _mm_mul_ps(_mm_sub_ps(c, b), v));
+
+		if (count - i < 4)
+		{
+			float tmp[4];
+			_mm_storeu_ps(tmp, res);
+			for (int j = 0; j < count - i; ++j) out[i + j] = tmp[j];
+		}
+		else
+		{
+			_mm_storeu_ps(out + i, res);
+		}
+	}
+}
+
+
+} // anonymous namespace
+
+
+void Terrain::getHeights(const Vec2* xz, float* out, int count)
+{
+	PROFILE_FUNCTION();
+	if (!m_heightmap)
+	{
+		setMemory(out, 0, count * sizeof(out[0]));
+		return;
+	}
+
+	const uint8* data = m_heightmap->getData();
+	switch (m_heightmap->getBytesPerPixel())
+	{
+		case 1:
+		{
+			HeightmapSampler<uint8, 1> sampler = {data, m_width, m_height, m_scale.y / 255.0f};
+			sampleHeights(sampler, m_scale.x, xz, out, count);
+			break;
+		}
+		case 2:
+		{
+			HeightmapSampler<uint16, 1> sampler = {
+				(const uint16*)data, m_width, m_height, m_scale.y / 65535.0f};
+			sampleHeights(sampler, m_scale.x, xz, out, count);
+			break;
+		}
+		case 4:
+		{
+			HeightmapSampler<uint8, 4> sampler = {data, m_width, m_height, m_scale.y / 255.0f};
+			sampleHeights(sampler, m_scale.x, xz, out, count);
+			break;
+		}
+		default: ASSERT(false); break;
+	}
+}
+
+
 float Terrain::getHeight(int x, int z)
 {
 	if (!m_heightmap) return 0;
@@ -699,6 +1106,10 @@ float Terrain::getHeight(int x, int z)
 	{
 		return m_scale.y / 65535.0f * ((uint16*)t->getData())[idx];
 	}
+	else if (t->getBytesPerPixel() == 1)
+	{
+		return (m_scale.y / 255.0f) * t->getData()[idx];
+	}
 	else if(t->getBytesPerPixel() == 4)
 	{
 		return ((m_scale.y / 255.0f) * ((uint8*)t->getData())[idx * 4]);
@@ -753,72 +1164,168 @@ bool getRayTriangleIntersection(const Vec3& local_origin, const Vec3& local_dir,
 }
 
 
+// clips [t0, t1] to the part of the ray between min and max on one axis
+static bool clipRaySlab(float origin, float dir, float min, float max, float& t0, float& t1)
+{
+	if (fabs(dir) < 0.01f) return origin >= min && origin <= max;
+	float a = (min - origin) / dir;
+	float b = (max - origin) / dir;
+	t0 = Math::maxValue(t0, Math::minValue(a, b));
+	t1 = Math::minValue(t1, Math::maxValue(a, b));
+	return t0 <= t1;
+}
+
+
+bool Terrain::getSkippedBlock(const Vec3& origin,
+	const Vec3& dir,
+	int cell_x,
+	int cell_z,
+	int* block_min,
+	int* block_max)
+{
+	// the biggest block containing the cell which the ray passes above
+	for (int level = m_height_range_offsets.size() - 1; level >= 0; --level)
+	{
+		int size = HEIGHT_RANGE_BLOCK_SIZE << level;
+		int block_x = cell_x / size;
+		int block_z = cell_z / size;
+		int width = ((m_height_ranges_width - 1) >> level) + 1;
+		const HeightRange& range =
+			m_height_ranges[m_height_range_offsets[level] + block_x + block_z * width];
+
+		float t0 = 0;
+		float t1 = FLT_MAX;
+		float min_x = block_x * size * m_scale.x;
+		float min_z = block_z * size * m_scale.x;
+		float max_x = min_x + size * m_scale.x;
+		float max_z = min_z + size * m_scale.x;
+		if (!clipRaySlab(origin.x, dir.x, min_x, max_x, t0, t1)) continue;
+		if (!clipRaySlab(origin.z, dir.z, min_z, max_z, t0, t1)) continue;
+		float y0 = origin.y + dir.y * t0;
+		float y1 = origin.y + dir.y * t1;
+		if (Math::minValue(y0, y1) <= range.max) continue;
+
+		block_min[0] = block_x * size;
+		block_min[1] = block_z * size;
+		block_max[0] = block_min[0] + size;
+		block_max[1] = block_min[1] + size;
+		return true;
+	}
+	return false;
+}
+
+
 RayCastModelHit Terrain::castRay(const Vec3& origin, const Vec3& dir)
 {
 	RayCastModelHit hit;
 	hit.m_is_hit = false;
-	if (m_root)
+	if (!m_root) return hit;
+
+	Matrix mtx = m_scene.getUniverse().getMatrix(m_entity);
+	mtx.fastInverse();
+	Vec3 rel_origin = mtx.multiplyPosition(origin);
+	Vec3 rel_dir = mtx * Vec4(dir, 0);
+	Vec3 start;
+	Vec3 size(m_root->m_size * m_scale.x, m_scale.y * 65535.0f, m_root->m_size * m_scale.x);
+	if (!Math::getRayAABBIntersection(rel_origin, rel_dir, m_root->m_min, size, start))
 	{
-		Matrix mtx = m_scene.getUniverse().getMatrix(m_entity);
-		mtx.fastInverse();
-		Vec3 rel_origin = mtx.multiplyPosition(origin);
-		Vec3 rel_dir = mtx * Vec4(dir, 0);
-		Vec3 start;
-		Vec3 size(m_root->m_size * m_scale.x, m_scale.y * 65535.0f, m_root->m_size * m_scale.x);
-		if (Math::getRayAABBIntersection(rel_origin, rel_dir, m_root->m_min, size, start))
-		{
-			int hx = (int)(start.x / m_scale.x);
-			int hz = (int)(start.z / m_scale.x);
-
-			float next_x = fabs(rel_dir.x) < 0.01f ? hx : ((hx + (rel_dir.x < 0 ? 0 : 1)) * m_scale.x - rel_origin.x) / rel_dir.x;
-			float next_z = fabs(rel_dir.z) < 0.01f ? hx : ((hz + (rel_dir.z < 0 ? 0 : 1)) * m_scale.x - rel_origin.z) / rel_dir.z;
+		return hit;
+	}
 
-			float delta_x = fabs(rel_dir.x) < 0.01f ? 0 : m_scale.x / Math::abs(rel_dir.x);
-			float delta_z = fabs(rel_dir.z) < 0.01f ? 0 : m_scale.x / Math::abs(rel_dir.z);
-			int step_x = (int)Math::signum(rel_dir.x);
-			int step_z = (int)Math::signum(rel_dir.z);
+	float cell_size = m_scale.x;
+	int hx = (int)(start.x / cell_size);
+	int hz = (int)(start.z / cell_size);
+
+	float delta_x = fabs(rel_dir.x) < 0.01f ? 0 : cell_size / Math::abs(rel_dir.x);
+	float delta_z = fabs(rel_dir.z) < 0.01f ? 0 : cell_size / Math::abs(rel_dir.z);
+	int step_x = (int)Math::signum(rel_dir.x);
+	int step_z = (int)Math::signum(rel_dir.z);
+	auto getNextX = [&]() {
+		if (delta_x == 0) return FLT_MAX;
+		return ((hx + (rel_dir.x < 0 ? 0 : 1)) * cell_size - rel_origin.x) / rel_dir.x;
+	};
+	auto getNextZ = [&]() {
+		if (delta_z == 0) return FLT_MAX;
+		return ((hz + (rel_dir.z < 0 ? 0 : 1)) * cell_size - rel_origin.z) / rel_dir.z;
+	};
+	float next_x = getNextX();
+	float next_z = getNextZ();
 
-			while (hx >= 0 && hz >= 0 && hx + 1 < m_width && hz + 1 < m_height)
+	// the level 0 block which was tested last
+	int tested_block_x = -1;
+	int tested_block_z = -1;
+	while (hx >= 0 && hz >= 0 && hx + 1 < m_width && hz + 1 < m_height)
+	{
+		int block_x = hx / HEIGHT_RANGE_BLOCK_SIZE;
+		int block_z = hz / HEIGHT_RANGE_BLOCK_SIZE;
+		if (!m_height_ranges.empty() && (block_x != tested_block_x || block_z != tested_block_z))
+		{
+			tested_block_x = block_x;
+			tested_block_z = block_z;
+			int block_min[2];
+			int block_max[2];
+			if (getSkippedBlock(rel_origin, rel_dir, hx, hz, block_min, block_max))
 			{
-				float t;
-				float x = hx * m_scale.x;
-				float z = hz * m_scale.x;
-				Vec3 p0(x, getHeight(x, z), z);
-				Vec3 p1(x + m_scale.x, getHeight(x + m_scale.x, z), z);
-				Vec3 p2(x + m_scale.x, getHeight(x + m_scale.x, z + m_scale.x), z + m_scale.x);
-				Vec3 p3(x, getHeight(x, z + m_scale.x), z + m_scale.x);
-				if (getRayTriangleIntersection(rel_origin, rel_dir, p0, p1, p2, t))
+				// continue in the first cell after the block
+				float exit_x = FLT_MAX;
+				float exit_z = FLT_MAX;
+				if (delta_x != 0)
 				{
-					hit.m_is_hit = true;
-					hit.m_origin = origin;
-					hit.m_dir = dir;
-					hit.m_t = t;
-					return hit;
+					float x = (step_x > 0 ? block_max[0] : block_min[0]) * cell_size;
+					exit_x = (x - rel_origin.x) / rel_dir.x;
 				}
-				if (getRayTriangleIntersection(rel_origin, rel_dir, p0, p2, p3, t))
+				if (delta_z != 0)
 				{
-					hit.m_is_hit = true;
-					hit.m_origin = origin;
-					hit.m_dir = dir;
-					hit.m_t = t;
-					return hit;
+					float z = (step_z > 0 ? block_max[1] : block_min[1]) * cell_size;
+					exit_z = (z - rel_origin.z) / rel_dir.z;
 				}
-				if (next_x < next_z)
+				if (exit_x == FLT_MAX && exit_z == FLT_MAX) return hit;
+
+				if (exit_x < exit_z)
 				{
-					next_x += delta_x;
-					hx += step_x;
+					hx = step_x > 0 ? block_max[0] : block_min[0] - 1;
+					hz = (int)((rel_origin.z + rel_dir.z * exit_x) / cell_size);
+					hz = Math::clamp(hz, block_min[1], block_max[1] - 1);
 				}
 				else
 				{
-					next_z += delta_z;
-					hz += step_z;
-				}
-				if (delta_x == 0 && delta_z == 0)
-				{
-					return hit;
+					hz = step_z > 0 ? block_max[1] : block_min[1] - 1;
+					hx = (int)((rel_origin.x + rel_dir.x * exit_z) / cell_size);
+					hx = Math::clamp(hx, block_min[0], block_max[0] - 1);
 				}
+				next_x = getNextX();
+				next_z = getNextZ();
+				continue;
 			}
 		}
+
+		float t;
+		float x = hx * cell_size;
+		float z = hz * cell_size;
+		Vec3 p0(x, getHeight(hx, hz), z);
+		Vec3 p1(x + cell_size, getHeight(hx + 1, hz), z);
+		Vec3 p2(x + cell_size, getHeight(hx + 1, hz + 1), z + cell_size);
+		Vec3 p3(x, getHeight(hx, hz + 1), z + cell_size);
+		if (getRayTriangleIntersection(rel_origin, rel_dir, p0, p1, p2, t) ||
+			getRayTriangleIntersection(rel_origin, rel_dir, p0, p2, p3, t))
+		{
+			hit.m_is_hit = true;
+			hit.m_origin = origin;
+			hit.m_dir = dir;
+			hit.m_t = t;
+			return hit;
+		}
+		if (delta_x == 0 && delta_z == 0) return hit;
+		if (next_x < next_z)
+		{
+			next_x += delta_x;
+			hx += step_x;
+		}
+		else
+		{
+			next_z += delta_z;
+			hz += step_z;
+		}
 	}
 	return hit;
 }
@@ -900,6 +1407,7 @@ TerrainQuad* Terrain::generateQuadTree(float size)
 void Terrain::onMaterialLoaded(Resource::State, Resource::State new_state)
 {
 	PROFILE_FUNCTION();
+	finishGrassJobs();
 	if (new_state == Resource::State::READY)
 	{
 		m_detail_texture = m_material->getTextureByUniform(TEX_COLOR_UNIFORM);
@@ -908,7 +1416,7 @@ void Terrain::onMaterialLoaded(Resource::State, Resource::State new_state)
 		bool is_data_ready = true;
 		if (m_heightmap && m_heightmap->getData() == nullptr)
 		{
-			m_heightmap->addDataReference();
+			m_heightmap->addDataReference(Texture::DataChannels::RED_ONLY);
 			is_data_ready = false;
 		}
 		m_splatmap = m_material->getTextureByUniform("u_texSplatmap");
@@ -928,11 +1436,15 @@ void Terrain::onMaterialLoaded(Resource::State, Resource::State new_state)
 		if (is_data_ready)
 		{
 			LUMIX_DELETE(m_allocator, m_root);
+			stopListeningDataUpdates();
+			clearHeightRanges();
 			if (m_heightmap && m_splatmap)
 			{
 				m_width = m_heightmap->getWidth();
 				m_height = m_heightmap->getHeight();
 				m_root = generateQuadTree((float)m_width);
+				buildHeightRanges();
+				listenDataUpdates();
 			}
 		}
 	}
@@ -940,8 +1452,153 @@ void Terrain::onMaterialLoaded(Resource::State, Resource::State new_state)
 	{
 		LUMIX_DELETE(m_allocator, m_root);
 		m_root = nullptr;
+		stopListeningDataUpdates();
+		clearHeightRanges();
+	}
+}
+
+
+void Terrain::listenDataUpdates()
+{
+	m_listened_heightmap = m_heightmap;
+	m_listened_heightmap->getDataUpdatedCb().bind<Terrain, &Terrain::onHeightmapUpdated>(this);
+	m_listened_splatmap = m_splatmap;
+	m_listened_splatmap->getDataUpdatedCb().bind<Terrain, &Terrain::onSplatmapUpdated>(this);
+}
+
+
+void Terrain::stopListeningDataUpdates()
+{
+	if (m_listened_heightmap)
+	{
+		auto& cb = m_listened_heightmap->getDataUpdatedCb();
+		cb.unbind<Terrain, &Terrain::onHeightmapUpdated>(this);
+		m_listened_heightmap = nullptr;
+	}
+	if (m_listened_splatmap)
+	{
+		auto& cb = m_listened_splatmap->getDataUpdatedCb();
+		cb.unbind<Terrain, &Terrain::onSplatmapUpdated>(this);
+		m_listened_splatmap = nullptr;
 	}
 }
 
 
+void Terrain::clearHeightRanges()
+{
+	m_height_ranges.clear();
+	m_height_range_offsets.clear();
+	m_height_ranges_width = 0;
+	m_height_ranges_height = 0;
+}
+
+
+void Terrain::buildHeightRanges()
+{
+	PROFILE_FUNCTION();
+	clearHeightRanges();
+	if (!m_heightmap || !m_heightmap->getData() || m_width < 2 || m_height < 2) return;
+
+	m_height_ranges_width = (m_width - 2) / HEIGHT_RANGE_BLOCK_SIZE + 1;
+	m_height_ranges_height = (m_height - 2) / HEIGHT_RANGE_BLOCK_SIZE + 1;
+	// every level halves the previous one, down to a single block
+	int count = 0;
+	for (int level = 0;; ++level)
+	{
+		m_height_range_offsets.push(count);
+		int width = ((m_height_ranges_width - 1) >> level) + 1;
+		int height = ((m_height_ranges_height - 1) >> level) + 1;
+		count += width * height;
+		if (width == 1 && height == 1) break;
+	}
+	m_height_ranges.resize(count);
+	updateHeightRanges(0, 0, m_height_ranges_width - 1, m_height_ranges_height - 1);
+}
+
+
+void Terrain::updateHeightRanges(int from_x, int from_z, int to_x, int to_z)
+{
+	for (int block_z = from_z; block_z <= to_z; ++block_z)
+	{
+		for (int block_x = from_x; block_x <= to_x; ++block_x)
+		{
+			int x0 = block_x * HEIGHT_RANGE_BLOCK_SIZE;
+			int z0 = block_z * HEIGHT_RANGE_BLOCK_SIZE;
+			int x1 = Math::minValue(x0 + HEIGHT_RANGE_BLOCK_SIZE, m_width - 1);
+			int z1 = Math::minValue(z0 + HEIGHT_RANGE_BLOCK_SIZE, m_height - 1);
+			HeightRange range = {FLT_MAX, -FLT_MAX};
+			for (int z = z0; z <= z1; ++z)
+			{
+				for (int x = x0; x <= x1; ++x)
+				{
+					float height = getHeight(x, z);
+					range.min = Math::minValue(range.min, height);
+					range.max = Math::maxValue(range.max, height);
+				}
+			}
+			m_height_ranges[block_x + block_z * m_height_ranges_width] = range;
+		}
+	}
+
+	for (int level = 1; level < m_height_range_offsets.size(); ++level)
+	{
+		from_x >>= 1;
+		from_z >>= 1;
+		to_x >>= 1;
+		to_z >>= 1;
+		int width = ((m_height_ranges_width - 1) >> level) + 1;
+		int child_width = ((m_height_ranges_width - 1) >> (level - 1)) + 1;
+		int child_height = ((m_height_ranges_height - 1) >> (level - 1)) + 1;
+		HeightRange* ranges = &m_height_ranges[m_height_range_offsets[level]];
+		const HeightRange* children = &m_height_ranges[m_height_range_offsets[level - 1]];
+		for (int z = from_z; z <= to_z; ++z)
+		{
+			for (int x = from_x; x <= to_x; ++x)
+			{
+				HeightRange range = {FLT_MAX, -FLT_MAX};
+				for (int j = 0; j < 2; ++j)
+				{
+					for (int i = 0; i < 2; ++i)
+					{
+						int child_x = x * 2 + i;
+						int child_z = z * 2 + j;
+						if (child_x >= child_width || child_z >= child_height) continue;
+						const HeightRange& child = children[child_x + child_z * child_width];
+						range.min = Math::minValue(range.min, child.min);
+						range.max = Math::maxValue(range.max, child.max);
+					}
+				}
+				ranges[x + z * width] = range;
+			}
+		}
+	}
+}
+
+
+void Terrain::onHeightmapUpdated(int x, int y, int w, int h)
+{
+	// a texel is a corner of the cells on both its sides
+	float cell = m_scale.x;
+	forceGrassUpdate((x - 1) * cell, (y - 1) * cell, (x + w) * cell, (y + h) * cell);
+	if (m_height_ranges.empty()) return;
+
+	int from_x = Math::maxValue(x - 1, 0) / HEIGHT_RANGE_BLOCK_SIZE;
+	int from_z = Math::maxValue(y - 1, 0) / HEIGHT_RANGE_BLOCK_SIZE;
+	int to_x = Math::minValue((x + w - 1) / HEIGHT_RANGE_BLOCK_SIZE, m_height_ranges_width - 1);
+	int to_z = Math::minValue((y + h - 1) / HEIGHT_RANGE_BLOCK_SIZE, m_height_ranges_height - 1);
+	if (from_x > to_x || from_z > to_z) return;
+	updateHeightRanges(from_x, from_z, to_x, to_z);
+}
+
+
+void Terrain::onSplatmapUpdated(int x, int y, int w, int h)
+{
+	// grass samples the nearest texel
+	float texel_x = m_width * m_scale.x / m_splatmap->getWidth();
+	float texel_z = m_height * m_scale.x / m_splatmap->getHeight();
+	forceGrassUpdate(
+		(x - 1) * texel_x, (y - 1) * texel_z, (x + w + 1) * texel_x, (y + h + 1) * texel_z);
+}
+
+
 } // namespace Lumix
\ No newline at end of file
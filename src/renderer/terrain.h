@@ -45,6 +45,9 @@ class Terrain
 				Terrain& m_terrain;
 				int32 m_ground;
 				int32 m_density;
+				// offsets, rotations and scales of GPU grass in the window around the camera
+				bgfx::VertexBufferHandle m_gpu_instances;
+				int m_gpu_instance_count;
 		};
 		
 		class GrassPatch
@@ -63,11 +66,16 @@ class Terrain
 			public:
 				explicit GrassQuad(IAllocator& allocator)
 					: m_patches(allocator)
+					, m_camera(-1)
+					, m_is_generated(0)
 				{}
 
 				Array<GrassPatch> m_patches;
 				Vec3 pos;
 				float radius;
+				ComponentIndex m_camera;
+				// set by the job which generates the patches
+				volatile int32 m_is_generated;
 		};
 
 	public:
@@ -79,11 +87,14 @@ class Terrain
 		Material* getMaterial() const { return m_material; }
 		Texture* getDetailTexture() const { return m_detail_texture; }
 		Texture* getSplatmap() const { return m_splatmap; }
+		Texture* getHeightmap() const { return m_heightmap; }
 		int64 getLayerMask() const { return m_layer_mask; }
 		Entity getEntity() const { return m_entity; }
 		float getRootSize() const;
 		Vec3 getNormal(float x, float z);
 		float getHeight(float x, float z);
+		// the same as getHeight for each point, xz are in the terrain's space
+		void getHeights(const Vec2* xz, float* out, int count);
 		float getXZScale() const { return m_scale.x; }
 		float getYScale() const { return m_scale.y; }
 		Mesh* getMesh() { return m_mesh; }
@@ -103,8 +114,17 @@ class Terrain
 		void setGrassDistance(int value) { m_grass_distance = value; forceGrassUpdate(); }
 		void setMaterial(Material* material);
 
-		void getInfos(Array<const TerrainInfo*>& infos, const Vec3& camera_pos, LIFOAllocator& allocator);
+		// LOD is selected by the distance from lod_ref_point, the main camera also for shadows
+		void getInfos(const Frustum& frustum,
+			const Vec3& lod_ref_point,
+			Array<const TerrainInfo*>& infos);
 		void getGrassInfos(const Frustum& frustum, Array<GrassInfo>& infos, ComponentIndex camera);
+		// one info per grass type, the vertex shader places the instances
+		void getGPUGrassInfos(Array<GrassInfo>& infos, ComponentIndex camera);
+		bgfx::VertexBufferHandle getGPUGrassInstances(int type) const
+		{
+			return m_grass_types[type]->m_gpu_instances;
+		}
 
 		RayCastModelHit castRay(const Vec3& origin, const Vec3& dir);
 		void serialize(OutputBlob& serializer);
@@ -113,18 +133,49 @@ class Terrain
 		void addGrassType(int index);
 		void removeGrassType(int index);
 		void forceGrassUpdate();
+		// regenerates only the quads overlapping the rectangle in the local space
+		void forceGrassUpdate(float from_x, float from_z, float to_x, float to_z);
 
 	private: 
 		Array<Terrain::GrassQuad*>& getQuads(ComponentIndex camera);
 		TerrainQuad* generateQuadTree(float size);
 		float getHeight(int x, int z);
 		void updateGrass(ComponentIndex camera);
+		GrassQuad* allocGrassQuad();
+		void generateGrassQuad(GrassQuad& quad, const Matrix& terrain_matrix);
 		void generateGrassTypeQuad(GrassPatch& patch,
 								   const Matrix& terrain_matrix,
 								   float quad_x,
-								   float quad_z);
+								   float quad_z,
+								   uint32& rand_state);
+		void collectGeneratedGrass();
+		void createGPUGrassInstances(GrassType& type);
+		void finishGrassJobs();
 		void generateGeometry();
 		void onMaterialLoaded(Resource::State, Resource::State new_state);
+		// min and max heights of blocks of cells, so castRay skips blocks which rays pass above
+		void buildHeightRanges();
+		void clearHeightRanges();
+		// in level 0 blocks, inclusive
+		void updateHeightRanges(int from_x, int from_z, int to_x, int to_z);
+		// edits of the heightmap and the splatmap update what depends on them
+		void listenDataUpdates();
+		void stopListeningDataUpdates();
+		void onHeightmapUpdated(int x, int y, int w, int h);
+		void onSplatmapUpdated(int x, int y, int w, int h);
+		bool getSkippedBlock(const Vec3& origin,
+			const Vec3& dir,
+			int cell_x,
+			int cell_z,
+			int* block_min,
+			int* block_max);
+
+	private:
+		struct HeightRange
+		{
+			float min;
+			float max;
+		};
 
 	private:
 		IAllocator& m_allocator;
@@ -145,10 +196,22 @@ class Terrain
 		RenderScene& m_scene;
 		Array<GrassType*> m_grass_types;
 		Array<GrassQuad*> m_free_grass_quads;
+		// quads whose patches are being generated on workers
+		Array<GrassQuad*> m_generating_grass_quads;
+		// GrassQuads are allocated in blocks and never freed before the terrain
+		Array<GrassQuad*> m_grass_quad_blocks;
 		AssociativeArray<ComponentIndex, Array<GrassQuad*> > m_grass_quads;
 		AssociativeArray<ComponentIndex, Vec3> m_last_camera_position;
 		bool m_force_grass_update;
 		Renderer& m_renderer;
+		// all mips of the height ranges, level 0 blocks have HEIGHT_RANGE_BLOCK_SIZE^2 cells
+		Array<HeightRange> m_height_ranges;
+		Array<int> m_height_range_offsets;
+		int m_height_ranges_width;
+		int m_height_ranges_height;
+		// textures whose data updates are followed
+		Texture* m_listened_heightmap;
+		Texture* m_listened_splatmap;
 };
 
 
@@ -2,6 +2,7 @@
 #include "core/fs/ifile.h"
 #include "core/log.h"
 #include "core/math_utils.h"
+#include "core/mt/atomic.h"
 #include "core/path_utils.h"
 #include "core/profiler.h"
 #include "core/resource_manager.h"
@@ -10,11 +11,16 @@
 #include "renderer/texture_manager.h"
 #include <bgfx/bgfx.h>
 #include <cmath>
+#include "crn_decomp.h"
 
 namespace Lumix
 {
 
 
+// streamed textures keep mips up to this size on the GPU even when they are not drawn
+static const int STREAMING_TAIL_SIZE = 64;
+
+
 #pragma pack(1)
 struct TGAHeader
 {
@@ -31,18 +37,112 @@ struct TGAHeader
 	char bitsPerPixel;
 	char imageDescriptor;
 };
+
+
+struct DDSHeader
+{
+	uint32 magic;
+	uint32 size;
+	uint32 flags;
+	uint32 height;
+	uint32 width;
+	uint32 pitch_or_linear_size;
+	uint32 depth;
+	uint32 mip_count;
+	uint32 reserved1[11];
+	uint32 pf_size;
+	uint32 pf_flags;
+	uint32 pf_fourcc;
+	uint32 pf_bit_count;
+	uint32 pf_masks[4];
+	uint32 caps;
+	uint32 caps2;
+	uint32 caps3;
+	uint32 caps4;
+	uint32 reserved2;
+};
 #pragma pack()
 
 
+static const uint32 DDS_MAGIC = 0x20534444; // "DDS "
+static const uint32 DDSD_CAPS = 0x1;
+static const uint32 DDSD_HEIGHT = 0x2;
+static const uint32 DDSD_WIDTH = 0x4;
+static const uint32 DDSD_PIXELFORMAT = 0x1000;
+static const uint32 DDSD_MIPMAPCOUNT = 0x20000;
+static const uint32 DDSD_LINEARSIZE = 0x80000;
+static const uint32 DDPF_FOURCC = 0x4;
+static const uint32 DDSCAPS_COMPLEX = 0x8;
+static const uint32 DDSCAPS_TEXTURE = 0x1000;
+static const uint32 DDSCAPS_MIPMAP = 0x400000;
+static const uint32 DDSCAPS2_CUBEMAP = 0x200;
+static const uint32 DDSCAPS2_VOLUME = 0x200000;
+
+
+static uint32 makeFourCC(char a, char b, char c, char d)
+{
+	return (uint32)a | ((uint32)b << 8) | ((uint32)c << 16) | ((uint32)d << 24);
+}
+
+
+// bytes per 4x4 block of compressed formats, 0 if the format is not known
+static int getDDSBlockSize(uint32 fourcc)
+{
+	if (fourcc == makeFourCC('D', 'X', 'T', '1')) return 8;
+	if (fourcc == makeFourCC('A', 'T', 'I', '1')) return 8;
+	if (fourcc == makeFourCC('D', 'X', 'T', '3')) return 16;
+	if (fourcc == makeFourCC('D', 'X', 'T', '5')) return 16;
+	if (fourcc == makeFourCC('A', 'T', 'I', '2')) return 16;
+	return 0;
+}
+
+
+// DDS fourcc of what crnd transcodes to, 0 if bgfx can not create such texture
+static uint32 getCRNFourCC(crn_format format)
+{
+	switch (crnd::crnd_get_fundamental_dxt_format(format))
+	{
+		case cCRNFmtDXT1: return makeFourCC('D', 'X', 'T', '1');
+		case cCRNFmtDXT3: return makeFourCC('D', 'X', 'T', '3');
+		case cCRNFmtDXT5: return makeFourCC('D', 'X', 'T', '5');
+		case cCRNFmtDXT5A: return makeFourCC('A', 'T', 'I', '1');
+		case cCRNFmtDXN_YX: return makeFourCC('A', 'T', 'I', '2');
+		default: return 0;
+	}
+}
+
+
 Texture::Texture(const Path& path,
 				 ResourceManager& resource_manager,
 				 IAllocator& allocator)
 	: Resource(path, resource_manager, allocator)
 	, m_data_reference(0)
+	, m_all_channels_data_reference(0)
 	, m_allocator(allocator)
 	, m_data(m_allocator)
+	, m_data_updated(m_allocator)
 	, m_BPP(-1)
 	, m_depth(-1)
+	, m_upload_data(m_allocator)
+	, m_upload_format(UploadFormat::NONE)
+	, m_is_upload_queued(false)
+	, m_is_data_update_queued(false)
+	, m_dirty_from_x(0)
+	, m_dirty_from_y(0)
+	, m_dirty_to_x(0)
+	, m_dirty_to_y(0)
+	, m_mip_count(1)
+	, m_is_streamable(false)
+	, m_is_streamed(false)
+	, m_has_mip_requests(false)
+	, m_is_handle_changed(false)
+	, m_is_compressed(false)
+	, m_block_size(0)
+	, m_tail_mip(0)
+	, m_resident_mip(0)
+	, m_wanted_mip(0)
+	, m_unused_frames(0)
+	, m_requested_mip(NO_MIP_REQUEST)
 {
 	m_atlas_size = -1;
 	m_flags = 0;
@@ -317,6 +417,41 @@ void Texture::save()
 
 void Texture::onDataUpdated(int x, int y, int w, int h)
 {
+	// the GPU texture has all channels
+	ASSERT(m_BPP != 1);
+	if (w <= 0 || h <= 0) return;
+
+	if (m_is_data_update_queued)
+	{
+		m_dirty_from_x = Math::minValue(m_dirty_from_x, x);
+		m_dirty_from_y = Math::minValue(m_dirty_from_y, y);
+		m_dirty_to_x = Math::maxValue(m_dirty_to_x, x + w);
+		m_dirty_to_y = Math::maxValue(m_dirty_to_y, y + h);
+	}
+	else
+	{
+		m_dirty_from_x = x;
+		m_dirty_from_y = y;
+		m_dirty_to_x = x + w;
+		m_dirty_to_y = y + h;
+		auto* manager =
+			static_cast<TextureManager*>(m_resource_manager.get(ResourceManager::TEXTURE));
+		manager->queueDataUpdate(*this);
+	}
+	m_data_updated.invoke(x, y, w, h);
+}
+
+
+void Texture::uploadDirtyData()
+{
+	PROFILE_FUNCTION();
+	// the data can be released while the update is queued
+	if (m_data.empty() || !bgfx::isValid(m_texture_handle)) return;
+
+	int x = m_dirty_from_x;
+	int y = m_dirty_from_y;
+	int w = m_dirty_to_x - m_dirty_from_x;
+	int h = m_dirty_to_y - m_dirty_from_y;
 	const bgfx::Memory* mem = nullptr;
 
 	if (m_BPP == 2)
@@ -354,7 +489,7 @@ void Texture::onDataUpdated(int x, int y, int w, int h)
 }
 
 
-bool Texture::loadRaw(FS::IFile& file)
+bool Texture::parseRaw(FS::IFile& file)
 {
 	PROFILE_FUNCTION();
 	size_t size = file.size();
@@ -369,30 +504,21 @@ bool Texture::loadRaw(FS::IFile& file)
 	}
 
 	const uint16* src_mem = (const uint16*)file.getBuffer();
-	const bgfx::Memory* mem = bgfx::alloc(m_width * m_height * sizeof(float));
-	float* dst_mem = (float*)mem->data;
+	m_upload_data.resize(m_width * m_height * sizeof(float));
+	float* dst_mem = (float*)&m_upload_data[0];
 
 	for (int i = 0; i < m_width * m_height; ++i)
 	{
 		dst_mem[i] = src_mem[i] / 65535.0f;
 	}
 
-	m_texture_handle = bgfx::createTexture2D(
-		(uint16_t)m_width, (uint16_t)m_height, 1, bgfx::TextureFormat::R32F, m_flags, nullptr);
-	bgfx::updateTexture2D(
-		m_texture_handle,
-		0,
-		0,
-		0,
-		(uint16_t)m_width,
-		(uint16_t)m_height,
-		mem);
+	m_upload_format = UploadFormat::R32F;
 	m_depth = 1;
-	return bgfx::isValid(m_texture_handle);
+	return true;
 }
 
 
-bool Texture::loadTGA(FS::IFile& file)
+bool Texture::parseTGA(FS::IFile& file)
 {
 	PROFILE_FUNCTION();
 	TGAHeader header;
@@ -414,15 +540,8 @@ bool Texture::loadTGA(FS::IFile& file)
 
 	m_width = header.width;
 	m_height = header.height;
-	TextureManager* manager = static_cast<TextureManager*>(
-		getResourceManager().get(ResourceManager::TEXTURE));
-	if (m_data_reference)
-	{
-		m_data.resize(image_size);
-	}
-	uint8* image_dest = m_data_reference
-							  ? &m_data[0]
-							  : (uint8*)manager->getBuffer(image_size);
+	m_upload_data.resize(image_size);
+	uint8* image_dest = &m_upload_data[0];
 
 	// Targa is BGR, swap to RGB, add alpha and flip Y axis
 	for (long y = 0; y < header.height; y++)
@@ -445,84 +564,298 @@ bool Texture::loadTGA(FS::IFile& file)
 	}
 	m_BPP = 4;
 
-	m_texture_handle = bgfx::createTexture2D(
-		header.width,
-		header.height,
-		1,
-		bgfx::TextureFormat::RGBA8,
-		m_flags,
-		0);
-	bgfx::updateTexture2D(
-		m_texture_handle,
-		0,
-		0,
-		0,
-		header.width,
-		header.height,
-		bgfx::copy(image_dest, header.width * header.height * 4));
+	if (m_data_reference)
+	{
+		m_data.resize(image_size);
+		copyMemory(&m_data[0], image_dest, image_size);
+		if (m_all_channels_data_reference == 0) keepRedChannel();
+	}
+
+	m_upload_format = UploadFormat::RGBA8;
 	m_depth = 1;
-	return bgfx::isValid(m_texture_handle);
+	return true;
+}
+
+
+void Texture::keepRedChannel()
+{
+	if (m_BPP != 4) return;
+
+	int pixel_count = m_data.size() / 4;
+	for (int i = 0; i < pixel_count; ++i)
+	{
+		m_data[i] = m_data[i * 4];
+	}
+	m_data.resize(pixel_count);
+	m_BPP = 1;
 }
 
 
-void Texture::addDataReference()
+void Texture::addDataReference(DataChannels channels)
 {
 	++m_data_reference;
-	if (m_data_reference == 1 && isReady())
+	if (channels == DataChannels::ALL) ++m_all_channels_data_reference;
+	if (!isReady()) return;
+
+	bool is_missing = m_data_reference == 1 ||
+					  (channels == DataChannels::ALL && m_all_channels_data_reference == 1 &&
+						  m_BPP == 1);
+	if (is_missing)
 	{
 		m_resource_manager.get(ResourceManager::TEXTURE)->reload(*this);
 	}
 }
 
 
-void Texture::removeDataReference()
+void Texture::removeDataReference(DataChannels channels)
 {
 	--m_data_reference;
+	if (channels == DataChannels::ALL) --m_all_channels_data_reference;
 	if (m_data_reference == 0)
 	{
 		m_data.clear();
 	}
+	else if (m_all_channels_data_reference == 0)
+	{
+		keepRedChannel();
+	}
 }
 
 
-bool Texture::loadDDS(FS::IFile& file)
+bool Texture::parseDDS(FS::IFile& file)
 {
-	bgfx::TextureInfo info;
-	m_texture_handle =
-		bgfx::createTexture(bgfx::copy(file.getBuffer(), (uint32)file.size()),
-							m_flags,
-							0,
-							&info);
+	if (file.size() < sizeof(DDSHeader)) return false;
+	m_upload_data.resize((int)file.size());
+	copyMemory(&m_upload_data[0], file.getBuffer(), file.size());
+	return parseDDSHeader();
+}
+
+
+bool Texture::parseCRN(FS::IFile& file)
+{
+	PROFILE_FUNCTION();
+	const void* data = file.getBuffer();
+	uint32 data_size = (uint32)file.size();
+	crnd::crn_texture_info info;
+	if (!crnd::crnd_get_texture_info(data, data_size, &info)) return false;
+	uint32 fourcc = getCRNFourCC(info.m_format);
+	if (info.m_faces != 1 || fourcc == 0)
+	{
+		g_log_error.log("Renderer") << "Unsupported CRN texture " << getPath().c_str();
+		return false;
+	}
+
+	// transcoded into a DDS in memory, so the upload and streaming do not know about CRN
+	int size = sizeof(DDSHeader);
+	uint32 top_level_size = 0;
+	for (uint32 i = 0; i < info.m_levels; ++i)
+	{
+		crnd::crn_level_info level;
+		if (!crnd::crnd_get_level_info(data, data_size, i, &level)) return false;
+		uint32 level_size = level.m_blocks_x * level.m_blocks_y * level.m_bytes_per_block;
+		if (i == 0) top_level_size = level_size;
+		size += level_size;
+	}
+	m_upload_data.resize(size);
+
+	DDSHeader header;
+	setMemory(&header, 0, sizeof(header));
+	header.magic = DDS_MAGIC;
+	header.size = sizeof(header) - sizeof(header.magic);
+	header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT |
+				   DDSD_LINEARSIZE;
+	header.height = info.m_height;
+	header.width = info.m_width;
+	header.pitch_or_linear_size = top_level_size;
+	header.mip_count = info.m_levels;
+	header.pf_size = sizeof(uint32) * 8;
+	header.pf_flags = DDPF_FOURCC;
+	header.pf_fourcc = fourcc;
+	header.caps = DDSCAPS_TEXTURE | (info.m_levels > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0);
+	copyMemory(&m_upload_data[0], &header, sizeof(header));
+
+	crnd::crnd_unpack_context context = crnd::crnd_unpack_begin(data, data_size);
+	if (!context) return false;
+	uint8* dst = &m_upload_data[sizeof(header)];
+	for (uint32 i = 0; i < info.m_levels; ++i)
+	{
+		crnd::crn_level_info level;
+		crnd::crnd_get_level_info(data, data_size, i, &level);
+		uint32 row_pitch = level.m_blocks_x * level.m_bytes_per_block;
+		uint32 level_size = row_pitch * level.m_blocks_y;
+		void* level_dst = dst;
+		if (!crnd::crnd_unpack_level(context, &level_dst, level_size, row_pitch, i))
+		{
+			crnd::crnd_unpack_end(context);
+			return false;
+		}
+		dst += level_size;
+	}
+	crnd::crnd_unpack_end(context);
+	return parseDDSHeader();
+}
+
+
+bool Texture::parseDDSHeader()
+{
+	// bgfx parses the data when the texture is created, the header is read only for streaming
+	m_upload_format = UploadFormat::DDS;
 	m_BPP = -1;
-	m_width = info.width;
-	m_height = info.height;
+
+	DDSHeader header;
+	copyMemory(&header, &m_upload_data[0], sizeof(header));
+	if (header.magic != DDS_MAGIC) return false;
+	m_width = header.width;
+	m_height = header.height;
+	m_mip_count = Math::maxValue((int)header.mip_count, 1);
+	m_is_compressed = (header.pf_flags & DDPF_FOURCC) != 0;
+	m_block_size = m_is_compressed ? getDDSBlockSize(header.pf_fourcc) : header.pf_bit_count / 8;
+
+	m_tail_mip = 0;
+	while (m_tail_mip < m_mip_count - 1 &&
+		   Math::maxValue(m_width, m_height) >> m_tail_mip > STREAMING_TAIL_SIZE)
+	{
+		++m_tail_mip;
+	}
+	m_is_streamable = m_tail_mip > 0 && m_block_size > 0 &&
+					  (header.caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)) == 0;
+	return true;
+}
+
+
+bool Texture::uploadMips(int mip)
+{
+	PROFILE_FUNCTION();
+	const bgfx::Memory* mem = bgfx::copy(&m_upload_data[0], m_upload_data.size());
+	bgfx::TextureInfo info;
+	bgfx::TextureHandle handle = bgfx::createTexture(mem, m_flags, (uint8)mip, &info);
+	if (!bgfx::isValid(handle)) return false;
+
+	if (bgfx::isValid(m_texture_handle)) bgfx::destroyTexture(m_texture_handle);
+	m_texture_handle = handle;
+	m_resident_mip = mip;
 	m_depth = info.depth;
+	m_is_handle_changed = true;
+	return true;
+}
+
+
+int Texture::getMipChainSize(int mip) const
+{
+	int block_dim = m_is_compressed ? 4 : 1;
+	int size = 0;
+	for (int i = mip; i < m_mip_count; ++i)
+	{
+		int w = (Math::maxValue(m_width >> i, 1) + block_dim - 1) / block_dim;
+		int h = (Math::maxValue(m_height >> i, 1) + block_dim - 1) / block_dim;
+		size += w * h * m_block_size;
+	}
+	return size;
+}
+
+
+void Texture::requestMips(float pixels)
+{
+	if (!m_is_streamable) return;
+
+	int mip = 0;
+	float size = (float)Math::maxValue(m_width, m_height);
+	while (mip < m_mip_count - 1 && size * 0.5f >= pixels)
+	{
+		size *= 0.5f;
+		++mip;
+	}
+	for (;;)
+	{
+		int32 requested = m_requested_mip;
+		if (requested <= mip) return;
+		if (MT::compareAndExchange(&m_requested_mip, mip, requested)) return;
+	}
+}
+
+
+bool Texture::upload()
+{
+	PROFILE_FUNCTION();
+	ASSERT(!bgfx::isValid(m_texture_handle));
+	if (m_upload_data.empty()) return false;
+
+	if (m_is_streamable)
+	{
+		// only the tail is created now, the manager streams the other mips and keeps the file
+		if (!uploadMips(m_tail_mip)) return false;
+		m_wanted_mip = m_tail_mip;
+		m_unused_frames = 0;
+		m_has_mip_requests = false;
+		m_requested_mip = NO_MIP_REQUEST;
+		auto* manager =
+			static_cast<TextureManager*>(m_resource_manager.get(ResourceManager::TEXTURE));
+		manager->addStreamed(*this);
+		return true;
+	}
+
+	const bgfx::Memory* mem = bgfx::copy(&m_upload_data[0], m_upload_data.size());
+	switch (m_upload_format)
+	{
+		case UploadFormat::DDS:
+		{
+			bgfx::TextureInfo info;
+			m_texture_handle = bgfx::createTexture(mem, m_flags, 0, &info);
+			m_width = info.width;
+			m_height = info.height;
+			m_depth = info.depth;
+			break;
+		}
+		case UploadFormat::RGBA8:
+			m_texture_handle = bgfx::createTexture2D(
+				(uint16_t)m_width, (uint16_t)m_height, 1, bgfx::TextureFormat::RGBA8, m_flags, mem);
+			break;
+		case UploadFormat::R32F:
+			m_texture_handle = bgfx::createTexture2D(
+				(uint16_t)m_width, (uint16_t)m_height, 1, bgfx::TextureFormat::R32F, m_flags, mem);
+			break;
+		default: ASSERT(false); break;
+	}
+	freeUploadData();
 	return bgfx::isValid(m_texture_handle);
 }
 
 
-bool Texture::load(FS::IFile& file)
+void Texture::freeUploadData()
+{
+	Array<uint8> empty(m_allocator);
+	m_upload_data.swap(empty);
+	m_upload_format = UploadFormat::NONE;
+}
+
+
+bool Texture::parse(FS::IFile& file)
 {
 	PROFILE_FUNCTION();
 
 	const char* path = getPath().c_str();
 	size_t len = getPath().length();
-	bool loaded = false;
+	bool parsed = false;
 	if (len > 3 && compareString(path + len - 4, ".dds") == 0)
 	{
-		loaded = loadDDS(file);
+		parsed = parseDDS(file);
+	}
+	else if (len > 3 && compareString(path + len - 4, ".crn") == 0)
+	{
+		parsed = parseCRN(file);
 	}
 	else if (len > 3 && compareString(path + len - 4, ".raw") == 0)
 	{
-		loaded = loadRaw(file);
+		parsed = parseRaw(file);
 	}
 	else
 	{
-		loaded = loadTGA(file);
+		parsed = parseTGA(file);
 	}
-	if (!loaded)
+	if (!parsed)
 	{
 		g_log_warning.log("Renderer") << "Error loading texture " << path;
+		freeUploadData();
 		return false;
 	}
 
@@ -531,8 +864,50 @@ bool Texture::load(FS::IFile& file)
 }
 
 
+bool Texture::finishParse()
+{
+	// the texture stays empty until the manager uploads it
+	++m_empty_dep_count;
+	auto* manager = static_cast<TextureManager*>(m_resource_manager.get(ResourceManager::TEXTURE));
+	manager->queueUpload(*this);
+	return true;
+}
+
+
+bool Texture::load(FS::IFile& file)
+{
+	if (!parse(file)) return false;
+	if (upload()) return true;
+
+	g_log_warning.log("Renderer") << "Error creating texture " << getPath().c_str();
+	return false;
+}
+
+
 void Texture::unload(void)
 {
+	if (m_is_upload_queued)
+	{
+		auto* manager =
+			static_cast<TextureManager*>(m_resource_manager.get(ResourceManager::TEXTURE));
+		manager->cancelUpload(*this);
+	}
+	if (m_is_data_update_queued)
+	{
+		auto* manager =
+			static_cast<TextureManager*>(m_resource_manager.get(ResourceManager::TEXTURE));
+		manager->cancelDataUpdate(*this);
+	}
+	if (m_is_streamed)
+	{
+		auto* manager =
+			static_cast<TextureManager*>(m_resource_manager.get(ResourceManager::TEXTURE));
+		manager->removeStreamed(*this);
+	}
+	freeUploadData();
+	m_is_streamable = false;
+	m_mip_count = 1;
+	m_resident_mip = 0;
 	if (bgfx::isValid(m_texture_handle))
 	{
 		bgfx::destroyTexture(m_texture_handle);
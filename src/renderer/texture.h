@@ -28,9 +28,19 @@ class LUMIX_RENDERER_API Texture : public Resource
 		int getBytesPerPixel() const { return m_BPP; }
 		const uint8* getData() const { return m_data.empty() ? nullptr : &m_data[0]; }
 		uint8* getData() { return m_data.empty() ? nullptr : &m_data[0]; }
-		void addDataReference();
-		void removeDataReference();
+		// the data is kept on the CPU while referenced, if all references are RED_ONLY, 8-bit
+		// textures keep one byte per pixel and getBytesPerPixel() is 1
+		enum class DataChannels : uint8
+		{
+			ALL,
+			RED_ONLY
+		};
+		void addDataReference(DataChannels channels = DataChannels::ALL);
+		void removeDataReference(DataChannels channels = DataChannels::ALL);
+		// notifies the listeners about the changed rectangle of the CPU data, changes are
+		// uploaded to the GPU once per frame in the bounding rectangle of all of them
 		void onDataUpdated(int x, int y, int w, int h);
+		DelegateList<void(int, int, int, int)>& getDataUpdatedCb() { return m_data_updated; }
 		void save();
 		void setFlags(uint32 flags);
 		void setFlag(uint32 flag, bool value);
@@ -38,6 +48,11 @@ class LUMIX_RENDERER_API Texture : public Resource
 		uint32 getPixelNearest(int x, int y) const;
 		uint32 getPixel(float x, float y) const;
 		bgfx::TextureHandle getTextureHandle() const { return m_texture_handle; }
+		// the handle changes when mips are streamed, it must not be kept over frames
+		int getMipCount() const { return m_mip_count; }
+		int getResidentMip() const { return m_resident_mip; }
+		// called from render jobs, asks for the mips needed to cover `pixels` on the screen
+		void requestMips(float pixels);
 
 		static bool saveTGA(IAllocator& allocator, FS::IFile* file, int width, int height, int bits_per_pixel, const uint8* data, const Path& path);
 		static unsigned int compareTGA(IAllocator& allocator, FS::IFile* file1, FS::IFile* file2, int difference);
@@ -45,14 +60,44 @@ class LUMIX_RENDERER_API Texture : public Resource
 		void setAtlasSize(int size) { m_atlas_size = size; }
 
 	private:
-		bool load3D(FS::IFile& file);
-		bool loadDDS(FS::IFile& file);
-		bool loadTGA(FS::IFile& file);
-		bool loadRaw(FS::IFile& file);
+		friend class TextureManager;
+
+		static const int32 NO_MIP_REQUEST = 0x7fffffff;
+
+		enum class UploadFormat : uint8
+		{
+			NONE,
+			DDS,
+			RGBA8,
+			R32F
+		};
+
+	private:
+		bool parseDDS(FS::IFile& file);
+		// transcodes to DXT
+		bool parseCRN(FS::IFile& file);
+		// reads the header of the DDS in m_upload_data
+		bool parseDDSHeader();
+		bool parseTGA(FS::IFile& file);
+		bool parseRaw(FS::IFile& file);
 		void saveTGA();
+		void keepRedChannel();
+		// creates the texture from what parse() prepared, on the main thread
+		bool upload();
+		int getUploadSize() const { return m_upload_data.size(); }
+		void freeUploadData();
+		// recreates a streamed texture from the kept DDS with `mip` as its first mip
+		bool uploadMips(int mip);
+		int getMipChainSize(int mip) const;
+		// uploads the dirty rectangle of the CPU data
+		void uploadDirtyData();
 
 		void unload(void) override;
 		bool load(FS::IFile& file) override;
+		// the file is decoded on a worker and the GPU upload is queued in the manager
+		bool isParsedAsync() const override { return true; }
+		bool parse(FS::IFile& file) override;
+		bool finishParse() override;
 
 	private:
 		IAllocator& m_allocator;
@@ -62,8 +107,33 @@ class LUMIX_RENDERER_API Texture : public Resource
 		int m_BPP;
 		int m_depth;
 		int m_data_reference;
+		int m_all_channels_data_reference;
 		uint32 m_flags;
 		Array<uint8> m_data;
+		DelegateList<void(int, int, int, int)> m_data_updated;
+		// filled by parse(), freed after the upload
+		Array<uint8> m_upload_data;
+		UploadFormat m_upload_format;
+		bool m_is_upload_queued;
+		bool m_is_data_update_queued;
+		int m_dirty_from_x;
+		int m_dirty_from_y;
+		int m_dirty_to_x;
+		int m_dirty_to_y;
+		int m_mip_count;
+		// streaming of 2D DDS textures, the file stays in m_upload_data and mips from m_tail_mip
+		// down are always on the GPU
+		bool m_is_streamable;
+		bool m_is_streamed;
+		bool m_has_mip_requests;
+		bool m_is_handle_changed;
+		bool m_is_compressed;
+		int m_block_size;
+		int m_tail_mip;
+		int m_resident_mip;
+		int m_wanted_mip;
+		int m_unused_frames;
+		volatile int32 m_requested_mip;
 		bgfx::TextureHandle m_texture_handle;
 };
 
@@ -1,14 +1,30 @@
 #include "lumix.h"
 #include "renderer/texture_manager.h"
 
+#include "core/log.h"
+#include "core/math_utils.h"
+#include "core/profiler.h"
 #include "core/resource.h"
+#include "core/resource_manager.h"
+#include "renderer/material.h"
 #include "renderer/texture.h"
 
 namespace Lumix
 {
+	// textures not drawn for this many frames keep only their tail mips
+	static const int STREAMING_UNUSED_FRAMES = 300;
+	static const int MAX_MIP_BIAS = 16;
+
+
 	TextureManager::TextureManager(IAllocator& allocator)
 		: ResourceManagerBase(allocator)
 		, m_allocator(allocator)
+		, m_uploads(allocator)
+		, m_data_updates(allocator)
+		, m_upload_budget(8 * 1024 * 1024)
+		, m_streamed(allocator)
+		, m_streaming_budget(256 * 1024 * 1024)
+		, m_streaming_mip_bias(0)
 	{
 		m_buffer = nullptr;
 		m_buffer_size = -1;
@@ -31,6 +47,180 @@ namespace Lumix
 		LUMIX_DELETE(m_allocator, static_cast<Texture*>(&resource));
 	}
 
+	void TextureManager::queueUpload(Texture& texture)
+	{
+		ASSERT(!texture.m_is_upload_queued);
+		texture.m_is_upload_queued = true;
+		m_uploads.push(&texture);
+	}
+
+
+	void TextureManager::cancelUpload(Texture& texture)
+	{
+		ASSERT(texture.m_is_upload_queued);
+		texture.m_is_upload_queued = false;
+		m_uploads.eraseItem(&texture);
+	}
+
+
+	void TextureManager::queueDataUpdate(Texture& texture)
+	{
+		ASSERT(!texture.m_is_data_update_queued);
+		texture.m_is_data_update_queued = true;
+		m_data_updates.push(&texture);
+	}
+
+
+	void TextureManager::cancelDataUpdate(Texture& texture)
+	{
+		ASSERT(texture.m_is_data_update_queued);
+		texture.m_is_data_update_queued = false;
+		m_data_updates.eraseItemFast(&texture);
+	}
+
+
+	void TextureManager::update()
+	{
+		processDataUpdates();
+		int uploaded_size = processUploads();
+		updateStreaming(uploaded_size);
+	}
+
+
+	void TextureManager::processDataUpdates()
+	{
+		for (Texture* texture : m_data_updates)
+		{
+			texture->m_is_data_update_queued = false;
+			texture->uploadDirtyData();
+		}
+		m_data_updates.clear();
+	}
+
+
+	int TextureManager::processUploads()
+	{
+		PROFILE_FUNCTION();
+		int uploaded_size = 0;
+		// the queue is read again after each upload, onDeferredLoad calls callbacks which can
+		// unload other queued textures
+		while (!m_uploads.empty())
+		{
+			Texture* texture = m_uploads[0];
+			int size = texture->getUploadSize();
+			if (uploaded_size > 0 && uploaded_size + size > m_upload_budget) break;
+			uploaded_size += size;
+
+			m_uploads.erase(0);
+			texture->m_is_upload_queued = false;
+			bool success = texture->upload();
+			if (!success)
+			{
+				g_log_warning.log("Renderer") << "Error creating texture "
+											  << texture->getPath().c_str();
+			}
+			texture->onDeferredLoad(success);
+		}
+		return uploaded_size;
+	}
+
+
+	void TextureManager::addStreamed(Texture& texture)
+	{
+		ASSERT(!texture.m_is_streamed);
+		texture.m_is_streamed = true;
+		m_streamed.push(&texture);
+	}
+
+
+	void TextureManager::removeStreamed(Texture& texture)
+	{
+		ASSERT(texture.m_is_streamed);
+		texture.m_is_streamed = false;
+		m_streamed.eraseItemFast(&texture);
+	}
+
+
+	void TextureManager::updateStreaming(int uploaded_size)
+	{
+		PROFILE_FUNCTION();
+		if (m_streamed.empty()) return;
+
+		for (Texture* texture : m_streamed)
+		{
+			int requested = texture->m_requested_mip;
+			texture->m_requested_mip = Texture::NO_MIP_REQUEST;
+			if (requested < texture->m_mip_count)
+			{
+				texture->m_has_mip_requests = true;
+				texture->m_unused_frames = 0;
+				texture->m_wanted_mip = requested;
+			}
+			else if (++texture->m_unused_frames > STREAMING_UNUSED_FRAMES)
+			{
+				// textures drawn only by terrains, particles or the UI never ask for mips
+				texture->m_wanted_mip = texture->m_has_mip_requests ? texture->m_tail_mip : 0;
+			}
+		}
+
+		int bias = 0;
+		for (;;)
+		{
+			int64 total_size = 0;
+			for (Texture* texture : m_streamed)
+			{
+				int mip = Math::minValue(texture->m_wanted_mip + bias, texture->m_tail_mip);
+				total_size += texture->getMipChainSize(mip);
+			}
+			if (total_size <= m_streaming_budget || bias >= MAX_MIP_BIAS) break;
+			++bias;
+		}
+		m_streaming_mip_bias = bias;
+
+		// evictions first so the memory is freed before new mips take it
+		bool is_changed = false;
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			for (Texture* texture : m_streamed)
+			{
+				int mip = Math::minValue(texture->m_wanted_mip + bias, texture->m_tail_mip);
+				bool is_eviction = mip > texture->m_resident_mip;
+				if (mip == texture->m_resident_mip || is_eviction != (pass == 0)) continue;
+
+				int size = texture->getMipChainSize(mip);
+				if (uploaded_size > 0 && uploaded_size + size > m_upload_budget) continue;
+				if (!texture->uploadMips(mip)) continue;
+				uploaded_size += size;
+				is_changed = true;
+			}
+		}
+		if (is_changed) refreshMaterials();
+	}
+
+
+	// command buffers of materials contain texture handles, which change when mips are streamed
+	void TextureManager::refreshMaterials()
+	{
+		PROFILE_FUNCTION();
+		auto& materials = getOwner().get(ResourceManager::MATERIAL)->getResourceTable();
+		for (auto iter = materials.begin(), end = materials.end(); iter != end; ++iter)
+		{
+			Material* material = static_cast<Material*>(iter.value());
+			if (!material->isReady()) continue;
+			for (int i = 0, c = material->getTextureCount(); i < c; ++i)
+			{
+				Texture* texture = material->getTexture(i);
+				if (texture && texture->m_is_handle_changed)
+				{
+					material->createCommandBuffer();
+					break;
+				}
+			}
+		}
+		for (Texture* texture : m_streamed) texture->m_is_handle_changed = false;
+	}
+
+
 	uint8* TextureManager::getBuffer(int32 size)
 	{
 		if (m_buffer_size < size)
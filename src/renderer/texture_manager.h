@@ -1,9 +1,12 @@
 #pragma once
 
+#include "core/array.h"
 #include "core/resource_manager_base.h"
 
 namespace Lumix
 {
+	class Texture;
+
 	class LUMIX_RENDERER_API TextureManager : public ResourceManagerBase
 	{
 	public:
@@ -12,6 +15,32 @@ namespace Lumix
 
 		uint8* getBuffer(int32 size);
 
+		// textures parsed on workers wait here for their GPU upload, update() uploads at least
+		// one of them each frame and more while they fit in the budget, then it streams mips
+		// with what is left of the budget
+		void queueUpload(Texture& texture);
+		void cancelUpload(Texture& texture);
+		// edited CPU data of textures is uploaded once per frame by update()
+		void queueDataUpdate(Texture& texture);
+		void cancelDataUpdate(Texture& texture);
+		void update();
+		void setUploadBudget(int bytes) { m_upload_budget = bytes; }
+		int getUploadBudget() const { return m_upload_budget; }
+
+		// streamed textures get the mips requested by the renderer, when they do not fit in the
+		// budget all of them drop the same number of mips
+		void addStreamed(Texture& texture);
+		void removeStreamed(Texture& texture);
+		void setStreamingBudget(int64 bytes) { m_streaming_budget = bytes; }
+		int64 getStreamingBudget() const { return m_streaming_budget; }
+		int getStreamingMipBias() const { return m_streaming_mip_bias; }
+
+	private:
+		int processUploads();
+		void processDataUpdates();
+		void updateStreaming(int uploaded_size);
+		void refreshMaterials();
+
 	protected:
 		Resource* createResource(const Path& path) override;
 		void destroyResource(Resource& resource) override;
@@ -20,5 +49,11 @@ namespace Lumix
 		IAllocator& m_allocator;
 		uint8* m_buffer;
 		int32 m_buffer_size;
+		Array<Texture*> m_uploads;
+		Array<Texture*> m_data_updates;
+		int m_upload_budget;
+		Array<Texture*> m_streamed;
+		int64 m_streaming_budget;
+		int m_streaming_mip_bias;
 	};
 }
\ No newline at end of file
@@ -9,30 +9,115 @@ namespace Lumix
 {
 
 
+static TransientGeometry::Stats s_frame_stats = {};
+
+
 TransientGeometry::TransientGeometry(const void* vertex_data,
 									 int num_vertices,
 									 const bgfx::VertexDecl& decl,
 									 const void* index_data,
 									 int num_indices)
 {
-	if (bgfx::checkAvailTransientBuffers(num_vertices, decl, num_indices))
+	allocate(num_vertices, decl, num_indices);
+	copyMemory(m_vertex_data, vertex_data, num_vertices * decl.getStride());
+	if (num_indices > 0) copyMemory(m_index_data, index_data, num_indices * sizeof(uint16));
+}
+
+
+TransientGeometry::TransientGeometry(int num_vertices,
+									 const bgfx::VertexDecl& decl,
+									 int num_indices)
+{
+	allocate(num_vertices, decl, num_indices);
+}
+
+
+TransientGeometry::~TransientGeometry()
+{
+	if (m_is_transient) return;
+
+	// bgfx frees the memory only when a buffer is created from it
+	createBuffers();
+	bgfx::destroyVertexBuffer(m_vertex_buffer_handle);
+	if (bgfx::isValid(m_index_buffer_handle)) bgfx::destroyIndexBuffer(m_index_buffer_handle);
+}
+
+
+void TransientGeometry::allocate(int num_vertices, const bgfx::VertexDecl& decl, int num_indices)
+{
+	m_num_vertices = num_vertices;
+	m_num_indices = num_indices;
+	m_vertex_memory = m_index_memory = nullptr;
+	m_vertex_buffer_handle = BGFX_INVALID_HANDLE;
+	m_index_buffer_handle = BGFX_INVALID_HANDLE;
+	m_index_data = nullptr;
+
+	uint32 vertex_bytes = num_vertices * decl.getStride();
+	++s_frame_stats.geometry_count;
+	s_frame_stats.vertex_bytes += vertex_bytes;
+	s_frame_stats.index_bytes += num_indices * sizeof(uint16);
+
+	m_is_transient = num_indices > 0
+						 ? bgfx::checkAvailTransientBuffers(num_vertices, decl, num_indices)
+						 : bgfx::checkAvailTransientVertexBuffer(num_vertices, decl);
+	if (m_is_transient)
 	{
 		bgfx::allocTransientVertexBuffer(&m_vertex_buffer, num_vertices, decl);
-		bgfx::allocTransientIndexBuffer(&m_index_buffer, num_indices);
+		m_vertex_data = m_vertex_buffer.data;
+		if (num_indices > 0)
+		{
+			bgfx::allocTransientIndexBuffer(&m_index_buffer, num_indices);
+			m_index_data = (uint16*)m_index_buffer.data;
+		}
+		return;
+	}
 
-		copyMemory(m_vertex_buffer.data, vertex_data, num_vertices * decl.getStride());
-		copyMemory(m_index_buffer.data, index_data, num_indices * sizeof(uint16));
-		m_num_vertices = num_vertices;
+	++s_frame_stats.fallback_count;
+	m_decl = decl;
+	m_vertex_memory = bgfx::alloc(vertex_bytes);
+	m_vertex_data = m_vertex_memory->data;
+	if (num_indices > 0)
+	{
+		m_index_memory = bgfx::alloc(num_indices * sizeof(uint16));
+		m_index_data = (uint16*)m_index_memory->data;
 	}
-	else
+}
+
+
+void TransientGeometry::setBuffers(int first_index, int num_indices)
+{
+	if (m_is_transient)
 	{
-		m_num_vertices = -1;
+		bgfx::setVertexBuffer(&m_vertex_buffer);
+		if (m_num_indices > 0) bgfx::setIndexBuffer(&m_index_buffer, first_index, num_indices);
+		return;
 	}
+
+	createBuffers();
+	bgfx::setVertexBuffer(m_vertex_buffer_handle);
+	if (m_num_indices > 0) bgfx::setIndexBuffer(m_index_buffer_handle, first_index, num_indices);
 }
 
 
-TransientGeometry::~TransientGeometry()
+void TransientGeometry::createBuffers()
+{
+	if (!m_vertex_memory) return;
+
+	m_vertex_buffer_handle = bgfx::createVertexBuffer(m_vertex_memory, m_decl);
+	if (m_index_memory) m_index_buffer_handle = bgfx::createIndexBuffer(m_index_memory);
+	m_vertex_memory = m_index_memory = nullptr;
+}
+
+
+const TransientGeometry::Stats& TransientGeometry::getFrameStats()
+{
+	return s_frame_stats;
+}
+
+
+void TransientGeometry::resetFrameStats()
 {
+	s_frame_stats = {};
 }
 
 
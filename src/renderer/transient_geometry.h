@@ -12,24 +12,59 @@ namespace Lumix
 class Material;
 
 
+// Geometry for one frame, in bgfx transient buffers while there is space in them. When the frame
+// runs out of it, the geometry goes to buffers created just for it, so it is still drawn.
 class LUMIX_RENDERER_API TransientGeometry
 {
+public:
+	struct Stats
+	{
+		int geometry_count;
+		int fallback_count;
+		int vertex_bytes;
+		int index_bytes;
+	};
+
 public:
 	TransientGeometry(const void* vertex_data,
 					  int vertex_num,
 					  const bgfx::VertexDecl& decl,
 					  const void* index_data,
 					  int index_num);
+	// getVertexData and getIndexData have to be filled before setBuffers, index_num can be 0
+	TransientGeometry(int vertex_num, const bgfx::VertexDecl& decl, int index_num);
 	~TransientGeometry();
 
-	bgfx::TransientVertexBuffer& getVertexBuffer() { return m_vertex_buffer; }
-	bgfx::TransientIndexBuffer& getIndexBuffer() { return m_index_buffer; }
+	void* getVertexData() { return m_vertex_data; }
+	uint16* getIndexData() { return m_index_data; }
 	int getNumVertices() const { return m_num_vertices; }
+	int getNumIndices() const { return m_num_indices; }
+	bool isTransient() const { return m_is_transient; }
+	// for the next bgfx::submit, num_indices is ignored without indices
+	void setBuffers(int first_index, int num_indices);
+
+	// since the last resetFrameStats, Renderer::frame resets them
+	static const Stats& getFrameStats();
+	static void resetFrameStats();
+
+private:
+	void allocate(int vertex_num, const bgfx::VertexDecl& decl, int index_num);
+	void createBuffers();
 
 private:
 	bgfx::TransientVertexBuffer m_vertex_buffer;
 	bgfx::TransientIndexBuffer m_index_buffer;
+	// used when the transient buffers are full, the buffers are created by the first setBuffers
+	bgfx::VertexDecl m_decl;
+	const bgfx::Memory* m_vertex_memory;
+	const bgfx::Memory* m_index_memory;
+	bgfx::VertexBufferHandle m_vertex_buffer_handle;
+	bgfx::IndexBufferHandle m_index_buffer_handle;
+	void* m_vertex_data;
+	uint16* m_index_data;
 	int m_num_vertices;
+	int m_num_indices;
+	bool m_is_transient;
 };
 
 
@@ -0,0 +1,231 @@
+#include "core/FS/file_system.h"
+#include "core/FS/ifile.h"
+#include "core/blob.h"
+#include "core/command_line_parser.h"
+#include "core/crc32.h"
+#include "core/log.h"
+#include "core/mt/thread.h"
+#include "core/path.h"
+#include "core/string.h"
+#include "core/system.h"
+#include "core/timer.h"
+#include "debug/debug.h"
+#include "engine/engine.h"
+#include "engine/plugin_manager.h"
+#include "universe/universe.h"
+#include <cstdio>
+
+
+// Dedicated server, runs the simulation of a universe at a fixed tick rate without a window, the
+// renderer and the editor:
+// server -universe universes/level.unv [-tick_rate 30] [-ticks 1000]
+class App
+{
+public:
+	App()
+		: m_engine(nullptr)
+		, m_universe(nullptr)
+		, m_timer(nullptr)
+		, m_tick_rate(DEFAULT_TICK_RATE)
+		, m_max_ticks(0)
+		, m_is_universe_loaded(false)
+	{
+		m_universe_path[0] = '\0';
+	}
+
+
+	~App() { ASSERT(!m_universe); }
+
+
+	bool init()
+	{
+		Lumix::g_log_info.getCallback().bind<outputToConsole>();
+		Lumix::g_log_warning.getCallback().bind<outputToConsole>();
+		Lumix::g_log_error.getCallback().bind<outputToConsole>();
+
+		Lumix::enableCrashReporting(false);
+		parseCommandLine();
+		if (m_universe_path[0] == '\0')
+		{
+			Lumix::g_log_error.log("server") << "Missing -universe";
+			return false;
+		}
+
+		m_engine = Lumix::Engine::create("", "", nullptr, m_allocator);
+		if (!m_engine) return false;
+		m_engine->setFixedTimeDelta(1.0f / m_tick_rate);
+
+		// no renderer, animables without renderables are not sampled
+		const char* plugins[] = {"animation", "lua_script", "physics"};
+		Lumix::IPlugin* loaded[sizeof(plugins) / sizeof(plugins[0])];
+		m_engine->getPluginManager().load(plugins, Lumix::lengthOf(plugins), loaded);
+
+		m_universe = &m_engine->createUniverse();
+		m_timer = Lumix::Timer::create(m_allocator);
+		return loadUniverse();
+	}
+
+
+	void shutdown()
+	{
+		if (m_timer) Lumix::Timer::destroy(m_timer);
+		if (m_universe)
+		{
+			if (m_is_universe_loaded) m_engine->stopGame(*m_universe);
+			m_engine->destroyUniverse(*m_universe);
+		}
+		if (m_engine) Lumix::Engine::destroy(m_engine, m_allocator);
+		m_timer = nullptr;
+		m_universe = nullptr;
+		m_engine = nullptr;
+	}
+
+
+	void run()
+	{
+		Lumix::FS::FileSystem& fs = m_engine->getFileSystem();
+		while (!m_is_universe_loaded)
+		{
+			if (!fs.hasWork()) return;
+			fs.updateAsyncTransactions();
+			Lumix::MT::sleep(1);
+		}
+		m_engine->startGame(*m_universe);
+
+		// ticks are scheduled from the start, a late tick does not delay the following ones
+		float tick_length = 1.0f / m_tick_rate;
+		float next_tick = m_timer->getTimeSinceStart();
+		for (int tick = 0; m_max_ticks == 0 || tick < m_max_ticks; ++tick)
+		{
+			m_engine->update(*m_universe);
+
+			next_tick += tick_length;
+			float wait = next_tick - m_timer->getTimeSinceStart();
+			if (wait > 0)
+			{
+				Lumix::MT::sleep(Lumix::uint32(wait * 1000));
+			}
+			else if (wait < -MAX_TICK_DEBT * tick_length)
+			{
+				Lumix::g_log_warning.log("server") << "Server can not keep up with the tick rate";
+				next_tick = m_timer->getTimeSinceStart();
+			}
+		}
+	}
+
+
+private:
+	static const int DEFAULT_TICK_RATE = 30;
+	// number of ticks the server can fall behind before it gives up catching up
+	static const int MAX_TICK_DEBT = 10;
+
+
+	static void outputToConsole(const char* system, const char* message)
+	{
+		printf("%s: %s\n", system, message);
+	}
+
+
+	void parseCommandLine()
+	{
+		char cmd_line[2048];
+		Lumix::getCommandLine(cmd_line, Lumix::lengthOf(cmd_line));
+
+		Lumix::CommandLineParser parser(cmd_line);
+		while (parser.next())
+		{
+			if (parser.currentEquals("-universe"))
+			{
+				if (!parser.next()) break;
+				parser.getCurrent(m_universe_path, Lumix::lengthOf(m_universe_path));
+			}
+			else if (parser.currentEquals("-tick_rate") || parser.currentEquals("-ticks"))
+			{
+				bool is_tick_rate = parser.currentEquals("-tick_rate");
+				if (!parser.next()) break;
+
+				char tmp[32];
+				parser.getCurrent(tmp, Lumix::lengthOf(tmp));
+				Lumix::int32 value = 0;
+				Lumix::fromCString(tmp, Lumix::lengthOf(tmp), &value);
+				if (is_tick_rate)
+				{
+					m_tick_rate = value > 0 ? value : DEFAULT_TICK_RATE;
+				}
+				else
+				{
+					m_max_ticks = value;
+				}
+			}
+		}
+	}
+
+
+	bool loadUniverse()
+	{
+		Lumix::g_log_info.log("server") << "Loading " << m_universe_path << "...";
+		Lumix::FS::FileSystem& fs = m_engine->getFileSystem();
+		Lumix::FS::ReadCallback file_read_cb;
+		file_read_cb.bind<App, &App::universeFileLoaded>(this);
+		return fs.openAsync(fs.getDefaultDevice(),
+			Lumix::Path(m_universe_path),
+			Lumix::FS::Mode::OPEN | Lumix::FS::Mode::READ,
+			file_read_cb);
+	}
+
+
+	void universeFileLoaded(Lumix::FS::IFile& file, bool success)
+	{
+		if (!success)
+		{
+			Lumix::g_log_error.log("server") << "Failed to open " << m_universe_path;
+			return;
+		}
+
+		Lumix::InputBlob blob(file.getBuffer(), (int)file.size());
+		#pragma pack(1)
+			struct Header
+			{
+				Lumix::uint32 magic;
+				int version;
+				Lumix::uint32 hash;
+				Lumix::uint32 engine_hash;
+			};
+		#pragma pack()
+		Header header;
+		blob.read(header);
+		if (Lumix::crc32((const Lumix::uint8*)blob.getData() + sizeof(header),
+				blob.getSize() - sizeof(header)) != header.hash)
+		{
+			Lumix::g_log_error.log("server") << "Universe corrupted";
+			return;
+		}
+		if (!m_engine->deserialize(*m_universe, blob))
+		{
+			Lumix::g_log_error.log("server") << "Failed to deserialize universe";
+			return;
+		}
+		m_is_universe_loaded = true;
+	}
+
+
+private:
+	Lumix::DefaultAllocator m_allocator;
+	Lumix::Engine* m_engine;
+	Lumix::Universe* m_universe;
+	Lumix::Timer* m_timer;
+	char m_universe_path[Lumix::MAX_PATH_LENGTH];
+	int m_tick_rate;
+	int m_max_ticks;
+	bool m_is_universe_loaded;
+};
+
+
+int main(int, char**)
+{
+	App app;
+	bool initialized = app.init();
+	if (initialized) app.run();
+	app.shutdown();
+	return initialized ? 0 : 1;
+}
@@ -2,6 +2,37 @@
 #include "core/array.h"
 
 
+struct SelfPointing
+{
+	explicit SelfPointing(int _value) : self(this), value(_value) {}
+	SelfPointing(const SelfPointing& rhs) : self(this), value(rhs.value) {}
+	SelfPointing(SelfPointing&& rhs) : self(this), value(rhs.value) { rhs.value = -1; }
+	void operator=(const SelfPointing& rhs) { value = rhs.value; }
+	bool isValid() const { return self == this; }
+
+	SelfPointing* self;
+	int value;
+};
+
+
+namespace Lumix
+{
+LUMIX_NOT_RELOCATABLE(SelfPointing);
+}
+
+
+struct CountingAllocator : public Lumix::DefaultAllocator
+{
+	CountingAllocator() : count(0) {}
+	void* allocate(size_t size) override
+	{
+		++count;
+		return Lumix::DefaultAllocator::allocate(size);
+	}
+	int count;
+};
+
+
 void UT_array(const char* params)
 {
 	Lumix::DefaultAllocator allocator;
@@ -83,5 +114,74 @@ void UT_array_erase(const char* params)
 	LUMIX_EXPECT(array1.size() == 15);
 }
 
+
+void UT_array_not_relocatable(const char* params)
+{
+	Lumix::DefaultAllocator allocator;
+	Lumix::Array<SelfPointing> array1(allocator);
+
+	for (int i = 0; i < 100; ++i)
+	{
+		array1.emplace(i);
+	}
+	array1.insert(0, SelfPointing(-10));
+	array1.emplaceAt(50, -50);
+	array1.erase(10);
+	array1.eraseFast(20);
+	LUMIX_EXPECT(array1.size() == 100);
+	LUMIX_EXPECT(array1[0].value == -10);
+	LUMIX_EXPECT(array1[49].value == -50);
+	for (int i = 0; i < array1.size(); ++i)
+	{
+		LUMIX_EXPECT(array1[i].isValid());
+	}
+}
+
+
+void UT_small_array(const char* params)
+{
+	Lumix::DefaultAllocator main_allocator;
+	CountingAllocator allocator;
+
+	{
+		Lumix::SmallArray<int, 16> array1(allocator);
+		LUMIX_EXPECT(array1.capacity() == 16);
+		for (int i = 0; i < 16; ++i)
+		{
+			array1.push(i);
+		}
+		LUMIX_EXPECT(allocator.count == 0);
+
+		// grows to the allocator and keeps the content
+		array1.push(16);
+		LUMIX_EXPECT(allocator.count == 1);
+		for (int i = 0; i < array1.size(); ++i)
+		{
+			LUMIX_EXPECT(array1[i] == i);
+		}
+
+		Lumix::SmallArray<int, 16> array2(allocator);
+		int values[] = {1, 2, 3};
+		array2.push(values, Lumix::lengthOf(values));
+		LUMIX_EXPECT(array2.size() == 3);
+		LUMIX_EXPECT(array2[2] == 3);
+		LUMIX_EXPECT(allocator.count == 1);
+	}
+
+	Lumix::Array<Lumix::SmallArray<int, 4>> nested(main_allocator);
+	for (int i = 0; i < 20; ++i)
+	{
+		nested.emplace(main_allocator).push(i);
+	}
+	nested.erase(0);
+	for (int i = 0; i < nested.size(); ++i)
+	{
+		LUMIX_EXPECT(nested[i][0] == i + 1);
+	}
+}
+
+
 REGISTER_TEST("unit_tests/core/array", UT_array, "")
-REGISTER_TEST("unit_tests/core/array/erase", UT_array_erase, "")
\ No newline at end of file
+REGISTER_TEST("unit_tests/core/array/erase", UT_array_erase, "")
+REGISTER_TEST("unit_tests/core/array/not_relocatable", UT_array_not_relocatable, "")
+REGISTER_TEST("unit_tests/core/array/small_array", UT_small_array, "")
\ No newline at end of file
@@ -0,0 +1,50 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "core/mt/sync.h"
+
+namespace
+{
+	void UT_backoff(const char* params)
+	{
+		Lumix::MT::resetWaitStats();
+		Lumix::MT::setSpinLimit(3);
+
+		{
+			Lumix::MT::Backoff backoff;
+			LUMIX_EXPECT(backoff.spin());
+			LUMIX_EXPECT(backoff.spin());
+			LUMIX_EXPECT(backoff.spin());
+			LUMIX_EXPECT(!backoff.spin());
+			LUMIX_EXPECT(!backoff.spin());
+		}
+		{
+			Lumix::MT::Backoff backoff;
+			LUMIX_EXPECT(backoff.spin());
+		}
+		{
+			// waits which did not spin are not counted
+			Lumix::MT::Backoff backoff;
+		}
+
+		Lumix::MT::WaitStats stats;
+		Lumix::MT::getWaitStats(stats);
+		LUMIX_EXPECT(stats.spin_count == 1);
+		LUMIX_EXPECT(stats.park_count == 1);
+		LUMIX_EXPECT(stats.spin_time >= 0);
+		LUMIX_EXPECT(stats.park_time >= 0);
+
+		Lumix::MT::setSpinLimit(0);
+		{
+			Lumix::MT::Backoff backoff;
+			LUMIX_EXPECT(!backoff.spin());
+		}
+
+		Lumix::MT::setSpinLimit(10);
+		Lumix::MT::resetWaitStats();
+		Lumix::MT::getWaitStats(stats);
+		LUMIX_EXPECT(stats.spin_count == 0);
+		LUMIX_EXPECT(stats.park_count == 0);
+	};
+}
+
+REGISTER_TEST("unit_tests/core/multi_thread/backoff", UT_backoff, "");
@@ -0,0 +1,164 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "core/fs/cache_file_device.h"
+#include "core/fs/ifile.h"
+#include "core/fs/ifile_device.h"
+#include "core/path.h"
+#include "core/string.h"
+
+
+namespace
+{
+	// serves a file of `size` bytes with byte i == i & 0xff and counts how many times it was opened
+	class SourceDevice : public Lumix::FS::IFileDevice
+	{
+	public:
+		SourceDevice(size_t size, Lumix::IAllocator& allocator)
+			: size(size)
+			, open_count(0)
+			, allocator(allocator)
+		{
+		}
+
+		Lumix::FS::IFile* createFile(Lumix::FS::IFile*) override;
+		void destroyFile(Lumix::FS::IFile* file) override { LUMIX_DELETE(allocator, file); }
+		const char* name() const override { return "source"; }
+
+		size_t size;
+		int open_count;
+		Lumix::IAllocator& allocator;
+	};
+
+
+	class SourceFile : public Lumix::FS::IFile
+	{
+	public:
+		explicit SourceFile(SourceDevice& device) : m_device(device), m_pos(0) {}
+
+		bool open(const Lumix::Path&, Lumix::FS::Mode) override
+		{
+			++m_device.open_count;
+			m_pos = 0;
+			return true;
+		}
+		void close() override {}
+		bool read(void* buffer, size_t size) override
+		{
+			if (m_pos + size > m_device.size) return false;
+			for (size_t i = 0; i < size; ++i) ((Lumix::uint8*)buffer)[i] = (m_pos + i) & 0xff;
+			m_pos += size;
+			return true;
+		}
+		bool write(const void*, size_t) override { return true; }
+		const void* getBuffer() const override { return nullptr; }
+		size_t size() override { return m_device.size; }
+		size_t seek(Lumix::FS::SeekMode, size_t pos) override { return m_pos = pos; }
+		size_t pos() override { return m_pos; }
+
+	protected:
+		Lumix::FS::IFileDevice& getDevice() override { return m_device; }
+
+	private:
+		SourceDevice& m_device;
+		size_t m_pos;
+	};
+
+
+	Lumix::FS::IFile* SourceDevice::createFile(Lumix::FS::IFile*)
+	{
+		return LUMIX_NEW(allocator, SourceFile)(*this);
+	}
+
+
+	Lumix::FS::IFile* openFile(Lumix::FS::CacheFileDevice& cache,
+		SourceDevice& source,
+		const char* path,
+		Lumix::FS::Mode mode)
+	{
+		Lumix::FS::IFile* file = cache.createFile(source.createFile(nullptr));
+		if (!file->open(Lumix::Path(path), mode))
+		{
+			file->release();
+			return nullptr;
+		}
+		return file;
+	}
+
+
+	bool readAndCheck(Lumix::FS::CacheFileDevice& cache, SourceDevice& source, const char* path)
+	{
+		Lumix::FS::IFile* file = openFile(cache, source, path, Lumix::FS::Mode::OPEN_AND_READ);
+		if (!file) return false;
+		bool is_valid = file->size() == source.size;
+		Lumix::uint8 byte;
+		file->seek(Lumix::FS::SeekMode::BEGIN, 300);
+		is_valid = is_valid && file->read(&byte, 1) && byte == (300 & 0xff);
+		is_valid = is_valid && file->pos() == 301;
+		file->close();
+		file->release();
+		return is_valid;
+	}
+
+
+	void UT_cache_file_device(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::PathManager path_manager(allocator);
+		SourceDevice source(1000, allocator);
+		Lumix::FS::CacheFileDevice cache(allocator);
+		cache.setBudget(4000);
+
+		LUMIX_EXPECT(readAndCheck(cache, source, "a"));
+		LUMIX_EXPECT(readAndCheck(cache, source, "a"));
+		LUMIX_EXPECT(source.open_count == 1);
+		LUMIX_EXPECT(cache.getStats().hit_count == 1);
+		LUMIX_EXPECT(cache.getStats().miss_count == 1);
+
+		// file opened before it is invalidated keeps its data
+		Lumix::FS::IFile* open_file =
+			openFile(cache, source, "a", Lumix::FS::Mode::OPEN_AND_READ);
+		cache.invalidate(Lumix::Path("a"));
+		LUMIX_EXPECT(open_file->size() == 1000);
+		open_file->close();
+		open_file->release();
+		LUMIX_EXPECT(readAndCheck(cache, source, "a"));
+		LUMIX_EXPECT(source.open_count == 2);
+
+		// writes drop the cached copy
+		Lumix::FS::IFile* written =
+			openFile(cache, source, "a", Lumix::FS::Mode::CREATE | Lumix::FS::Mode::WRITE);
+		LUMIX_EXPECT(written != nullptr);
+		written->close();
+		written->release();
+		LUMIX_EXPECT(readAndCheck(cache, source, "a"));
+		LUMIX_EXPECT(source.open_count == 4);
+
+		// the least recently opened files go first
+		LUMIX_EXPECT(readAndCheck(cache, source, "b"));
+		LUMIX_EXPECT(readAndCheck(cache, source, "c"));
+		LUMIX_EXPECT(readAndCheck(cache, source, "d"));
+		LUMIX_EXPECT(readAndCheck(cache, source, "a"));
+		LUMIX_EXPECT(cache.getStats().file_count == 4);
+		int open_count = source.open_count;
+		LUMIX_EXPECT(readAndCheck(cache, source, "e"));
+		LUMIX_EXPECT(cache.getStats().file_count == 4);
+		LUMIX_EXPECT(cache.getStats().cached_bytes == 4000);
+		LUMIX_EXPECT(readAndCheck(cache, source, "a"));
+		LUMIX_EXPECT(source.open_count == open_count + 1);
+		LUMIX_EXPECT(readAndCheck(cache, source, "b"));
+		LUMIX_EXPECT(source.open_count == open_count + 2);
+
+		// files bigger than a quarter of the budget are read from the source every time
+		cache.setBudget(3000);
+		LUMIX_EXPECT(cache.getStats().cached_bytes <= 3000);
+		open_count = source.open_count;
+		LUMIX_EXPECT(readAndCheck(cache, source, "f"));
+		LUMIX_EXPECT(readAndCheck(cache, source, "f"));
+		LUMIX_EXPECT(source.open_count == open_count + 2);
+
+		cache.clear();
+		LUMIX_EXPECT(cache.getStats().file_count == 0);
+		LUMIX_EXPECT(cache.getStats().cached_bytes == 0);
+	}
+}
+
+REGISTER_TEST("unit_tests/core/cache_file_device", UT_cache_file_device, "");
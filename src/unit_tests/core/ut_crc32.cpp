@@ -2,6 +2,22 @@
 #include "core/crc32.h"
 
 
+// bit by bit, without tables
+static Lumix::uint32 referenceCrc32(const Lumix::uint8* data, int length)
+{
+	Lumix::uint32 crc = 0xffffFFFF;
+	for (int i = 0; i < length; ++i)
+	{
+		crc ^= data[i];
+		for (int j = 0; j < 8; ++j)
+		{
+			crc = (crc >> 1) ^ (crc & 1 ? 0xEDB88320 : 0);
+		}
+	}
+	return ~crc;
+}
+
+
 void UT_crc32(const char* params)
 {
 	Lumix::DefaultAllocator allocator;
@@ -17,6 +33,27 @@ void UT_crc32(const char* params)
 	LUMIX_EXPECT(Lumix::crc32("\xff") == 0xFF000000);
 	LUMIX_EXPECT(Lumix::crc32("\xff\xff") == 0xFFFF0000);
 	LUMIX_EXPECT(Lumix::crc32("\xff\xff\x12") == 0x214461C5);
+
+	// every length and alignment around the 8 byte blocks
+	Lumix::uint8 buffer[64];
+	for (int i = 0; i < Lumix::lengthOf(buffer); ++i)
+	{
+		buffer[i] = Lumix::uint8(i * 37 + 11);
+	}
+	for (int offset = 0; offset < 8; ++offset)
+	{
+		for (int length = 0; length <= 40; ++length)
+		{
+			LUMIX_EXPECT(Lumix::crc32(buffer + offset, length) ==
+						 referenceCrc32(buffer + offset, length));
+		}
+	}
+
+	const char* path = "models/characters/hero/hero_diffuse.dds";
+	LUMIX_EXPECT(Lumix::crc32(path) == referenceCrc32((const Lumix::uint8*)path, 39));
+	Lumix::uint32 crc = Lumix::crc32("models/");
+	crc = Lumix::continueCrc32(crc, "characters/hero/hero_diffuse.dds");
+	LUMIX_EXPECT(crc == Lumix::crc32(path));
 }
 
 REGISTER_TEST("unit_tests/core/crc32", UT_crc32, "")
\ No newline at end of file
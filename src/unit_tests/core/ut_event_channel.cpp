@@ -0,0 +1,53 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "core/event_channel.h"
+
+
+namespace
+{
+
+
+void UT_event_channel(const char* params)
+{
+	Lumix::DefaultAllocator allocator;
+	Lumix::EventChannel<int> channel(allocator);
+	const Lumix::EventChannel<int>::Event* events;
+
+	// nothing is recorded without readers
+	channel.push(1, 10);
+	int reader = channel.addReader();
+	LUMIX_EXPECT(channel.read(reader, events) == 0);
+
+	channel.push(2, 20);
+	channel.push(3, 30);
+	int late_reader = channel.addReader();
+	channel.push(4, 40);
+
+	LUMIX_EXPECT(channel.read(reader, events) == 3);
+	LUMIX_EXPECT(events[0].entity == 2 && events[0].data == 20);
+	LUMIX_EXPECT(events[2].entity == 4 && events[2].data == 40);
+	LUMIX_EXPECT(channel.read(reader, events) == 0);
+
+	// events are kept until all readers read them
+	channel.compact();
+	channel.push(5, 50);
+	LUMIX_EXPECT(channel.read(late_reader, events) == 2);
+	LUMIX_EXPECT(events[0].entity == 4 && events[1].entity == 5);
+	LUMIX_EXPECT(channel.read(reader, events) == 1);
+	LUMIX_EXPECT(events[0].entity == 5);
+
+	// slots of removed readers are reused
+	channel.removeReader(late_reader);
+	channel.compact();
+	LUMIX_EXPECT(channel.addReader() == late_reader);
+	channel.push(6, 60);
+	LUMIX_EXPECT(channel.read(late_reader, events) == 1);
+	LUMIX_EXPECT(events[0].data == 60);
+	channel.removeReader(late_reader);
+	channel.removeReader(reader);
+}
+
+
+} // anonymous namespace
+
+
+REGISTER_TEST("unit_tests/core/event_channel", UT_event_channel, "")
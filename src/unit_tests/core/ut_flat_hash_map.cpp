@@ -0,0 +1,150 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "core/flat_hash_map.h"
+#include "core/hash_map.h"
+#include "core/log.h"
+#include "core/pod_hash_map.h"
+#include "core/timer.h"
+#include "debug/debug.h"
+
+namespace
+{
+	typedef Lumix::FlatHashMap<Lumix::uint32, Lumix::int32> FlatMap;
+
+
+	void UT_flat_hash_map_insert_erase(const char* params)
+	{
+		Lumix::DefaultAllocator main_allocator;
+		Lumix::Debug::Allocator allocator(main_allocator);
+		FlatMap map(allocator);
+		LUMIX_EXPECT(map.empty());
+		LUMIX_EXPECT(!map.find(1).isValid());
+
+		const Lumix::int32 COUNT = 1000;
+		for (Lumix::int32 i = 0; i < COUNT; ++i)
+		{
+			map.insert(i, i);
+		}
+		LUMIX_EXPECT(map.size() == COUNT);
+		LUMIX_EXPECT(map.loadFactor() <= map.maxLoadFactor());
+		for (Lumix::int32 i = 0; i < COUNT; ++i)
+		{
+			LUMIX_EXPECT(map[i] == i);
+		}
+
+		// existing keys are overwritten
+		map.insert(10, -10);
+		LUMIX_EXPECT(map.size() == COUNT);
+		LUMIX_EXPECT(map.find(10).value() == -10);
+
+		for (Lumix::int32 i = 0; i < COUNT; i += 2)
+		{
+			LUMIX_EXPECT(map.erase(i) == 1);
+		}
+		LUMIX_EXPECT(map.erase(0) == 0);
+		LUMIX_EXPECT(map.size() == COUNT / 2);
+		for (Lumix::int32 i = 0; i < COUNT; ++i)
+		{
+			LUMIX_EXPECT(map.find(i).isValid() == (i % 2 == 1));
+		}
+
+		map.clear();
+		LUMIX_EXPECT(map.empty());
+		LUMIX_EXPECT(!map.find(1).isValid());
+	}
+
+
+	void UT_flat_hash_map_iterators(const char* params)
+	{
+		Lumix::DefaultAllocator main_allocator;
+		Lumix::Debug::Allocator allocator(main_allocator);
+		FlatMap map(allocator);
+
+		const Lumix::int32 COUNT = 500;
+		for (Lumix::int32 i = 0; i < COUNT; ++i)
+		{
+			map.insert(i, i * 2);
+		}
+
+		// erase while iterating must visit every element exactly once
+		int visited = 0;
+		for (FlatMap::iterator it = map.begin(); it != map.end();)
+		{
+			LUMIX_EXPECT(it.value() == (Lumix::int32)it.key() * 2);
+			++visited;
+			if (it.key() % 3 == 0)
+			{
+				it = map.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+		LUMIX_EXPECT(visited == COUNT);
+		LUMIX_EXPECT(map.size() == COUNT - (COUNT + 2) / 3);
+
+		const FlatMap& const_map = map;
+		int count = 0;
+		for (FlatMap::const_iterator it = const_map.begin(); it != const_map.end(); ++it)
+		{
+			LUMIX_EXPECT(it.key() % 3 != 0);
+			++count;
+		}
+		LUMIX_EXPECT(count == (int)map.size());
+
+		FlatMap copy(map);
+		LUMIX_EXPECT(copy.size() == map.size());
+		copy.setMaxLoadFactor(0.5f);
+		LUMIX_EXPECT(copy.loadFactor() <= 0.5f);
+		for (auto value : map)
+		{
+			LUMIX_EXPECT(copy.find(value / 2).isValid());
+		}
+	}
+
+
+	template <typename Map> float benchmarkMap(Map& map, Lumix::IAllocator& allocator)
+	{
+		const Lumix::uint32 COUNT = 100000;
+		Lumix::Timer* timer = Lumix::Timer::create(allocator);
+		for (Lumix::uint32 i = 0; i < COUNT; ++i)
+		{
+			map.insert(i * 7919, (Lumix::int32)i);
+		}
+		Lumix::int32 sum = 0;
+		for (int pass = 0; pass < 10; ++pass)
+		{
+			for (Lumix::uint32 i = 0; i < COUNT; ++i)
+			{
+				auto iter = map.find(i * 7919);
+				if (iter.isValid()) sum += iter.value();
+			}
+		}
+		float time = timer->getTimeSinceStart();
+		Lumix::Timer::destroy(timer);
+		LUMIX_EXPECT(sum != 0);
+		return time;
+	}
+
+
+	void UT_flat_hash_map_benchmark(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+
+		Lumix::HashMap<Lumix::uint32, Lumix::int32> hash_map(allocator);
+		Lumix::PODHashMap<Lumix::uint32, Lumix::int32> pod_hash_map(allocator);
+		FlatMap flat_hash_map(allocator);
+		float hash_map_time = benchmarkMap(hash_map, allocator);
+		float pod_hash_map_time = benchmarkMap(pod_hash_map, allocator);
+		float flat_hash_map_time = benchmarkMap(flat_hash_map, allocator);
+
+		Lumix::g_log_info.log("unit") << "HashMap: " << hash_map_time << "s, PODHashMap: "
+									  << pod_hash_map_time << "s, FlatHashMap: " << flat_hash_map_time
+									  << "s";
+	}
+}
+
+REGISTER_TEST("unit_tests/core/flat_hash_map/insert_erase", UT_flat_hash_map_insert_erase, "")
+REGISTER_TEST("unit_tests/core/flat_hash_map/iterators", UT_flat_hash_map_iterators, "")
+REGISTER_TEST("unit_tests/core/flat_hash_map/benchmark", UT_flat_hash_map_benchmark, "")
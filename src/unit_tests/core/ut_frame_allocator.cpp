@@ -0,0 +1,89 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "core/array.h"
+#include "core/frame_allocator.h"
+#include "core/mtjd/manager.h"
+#include "core/mtjd/parallel_for.h"
+#include "debug/debug.h"
+
+
+namespace
+{
+	void UT_frame_allocator(const char* params)
+	{
+		Lumix::DefaultAllocator main_allocator;
+		Lumix::Debug::Allocator allocator(main_allocator);
+		{
+			Lumix::FrameAllocator frame_allocator(allocator, 64 * 1024);
+			LUMIX_EXPECT(frame_allocator.getStats().used == 0);
+
+			int* a = (int*)frame_allocator.allocate(sizeof(int) * 100);
+			for (int i = 0; i < 100; ++i) a[i] = i;
+			void* b = frame_allocator.allocate_aligned(100, 64);
+			LUMIX_EXPECT(((Lumix::uintptr)b & 63) == 0);
+
+			int* c = (int*)frame_allocator.reallocate(a, sizeof(int) * 200);
+			for (int i = 0; i < 100; ++i) LUMIX_EXPECT(c[i] == i);
+
+			Lumix::Array<int> array(frame_allocator);
+			for (int i = 0; i < 1000; ++i) array.push(i);
+			LUMIX_EXPECT(array[999] == 999);
+			LUMIX_EXPECT(frame_allocator.getStats().used > 0);
+			LUMIX_EXPECT(frame_allocator.getStats().overflow_count == 0);
+
+			// the other buffer is used, the previous frame is still valid
+			frame_allocator.endFrame();
+			LUMIX_EXPECT(frame_allocator.getStats().used == 0);
+			LUMIX_EXPECT(frame_allocator.getStats().peak > 0);
+			LUMIX_EXPECT(c[50] == 50);
+			void* d = frame_allocator.allocate(16);
+			LUMIX_EXPECT(d != c);
+
+			// more than fits goes to the parent and is released with the buffer
+			for (int i = 0; i < 10; ++i) frame_allocator.allocate(16 * 1024);
+			Lumix::FrameAllocator::Stats stats = frame_allocator.getStats();
+			LUMIX_EXPECT(stats.overflow_count > 0);
+			LUMIX_EXPECT(stats.used > stats.capacity);
+			frame_allocator.endFrame();
+			frame_allocator.endFrame();
+			LUMIX_EXPECT(frame_allocator.getStats().overflow_count == 0);
+		}
+		LUMIX_EXPECT(allocator.getTotalSize() == 0);
+	}
+
+
+	void UT_frame_allocator_threads(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::MTJD::Manager* manager = Lumix::MTJD::Manager::create(allocator);
+		Lumix::FrameAllocator frame_allocator(allocator, 1024 * 1024);
+
+		static const int COUNT = 4096;
+		int* values[COUNT];
+		for (int frame = 0; frame < 3; ++frame)
+		{
+			Lumix::MTJD::parallelFor(*manager,
+				0,
+				COUNT,
+				64,
+				[&](int from, int to)
+				{
+					for (int i = from; i < to; ++i)
+					{
+						values[i] = (int*)frame_allocator.allocate(sizeof(int) * 8);
+						for (int j = 0; j < 8; ++j) values[i][j] = i;
+					}
+				});
+			// nothing was overwritten by other threads
+			for (int i = 0; i < COUNT; ++i)
+			{
+				for (int j = 0; j < 8; ++j) LUMIX_EXPECT(values[i][j] == i);
+			}
+			frame_allocator.endFrame();
+		}
+
+		Lumix::MTJD::Manager::destroy(*manager);
+	}
+}
+
+REGISTER_TEST("unit_tests/core/frame_allocator", UT_frame_allocator, "")
+REGISTER_TEST("unit_tests/core/frame_allocator/threads", UT_frame_allocator_threads, "")
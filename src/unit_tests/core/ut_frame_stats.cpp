@@ -0,0 +1,48 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "core/frame_stats.h"
+
+
+namespace
+{
+	void UT_frame_stats(const char* params)
+	{
+		using namespace Lumix;
+
+		FrameStats::reset();
+		int histogram = FrameStats::addHistogram("ut_frame_stats", 100);
+		LUMIX_EXPECT(histogram > FrameStats::FRAME_TIME);
+		LUMIX_EXPECT(FrameStats::addHistogram("ut_frame_stats", 50) == histogram);
+		LUMIX_EXPECT(FrameStats::getPercentile(histogram, 50) == 0);
+
+		for (int i = 0; i < 100; ++i) FrameStats::record(histogram, i + 0.5f);
+		LUMIX_EXPECT(FrameStats::getSampleCount(histogram) == 100);
+		// within a bucket
+		const float bucket_size = 100.0f / FrameStats::BUCKETS_COUNT;
+		LUMIX_EXPECT_CLOSE_EQ(FrameStats::getPercentile(histogram, 50), 50.0f, bucket_size);
+		LUMIX_EXPECT_CLOSE_EQ(FrameStats::getPercentile(histogram, 95), 95.0f, bucket_size);
+		LUMIX_EXPECT_CLOSE_EQ(FrameStats::getPercentile(histogram, 99), 99.0f, bucket_size);
+
+		// clamped to the last bucket
+		FrameStats::record(histogram, 1000);
+		LUMIX_EXPECT(FrameStats::getPercentile(histogram, 100) <= 100);
+
+		// counters are moved to the totals and hitches counted by frame()
+		FrameStats::setHitchThreshold(50);
+		FrameStats::add(FrameStats::Counter::DRAW_CALLS, 10);
+		FrameStats::add(FrameStats::Counter::DRAW_CALLS, 5);
+		LUMIX_EXPECT(FrameStats::getCounter(FrameStats::Counter::DRAW_CALLS) == 0);
+		FrameStats::frame(0.016f);
+		LUMIX_EXPECT(FrameStats::getCounter(FrameStats::Counter::DRAW_CALLS) == 15);
+		LUMIX_EXPECT(FrameStats::getHitchCount() == 0);
+		FrameStats::frame(0.1f);
+		LUMIX_EXPECT(FrameStats::getHitchCount() == 1);
+		LUMIX_EXPECT(FrameStats::getSampleCount(FrameStats::FRAME_TIME) == 2);
+
+		FrameStats::reset();
+		LUMIX_EXPECT(FrameStats::getSampleCount(histogram) == 0);
+		LUMIX_EXPECT(FrameStats::getCounter(FrameStats::Counter::DRAW_CALLS) == 0);
+		LUMIX_EXPECT(FrameStats::getHitchCount() == 0);
+	}
+}
+
+REGISTER_TEST("unit_tests/core/frame_stats", UT_frame_stats, "")
@@ -2,7 +2,9 @@
 #include "core/fs/ifile.h"
 #include "core/FS/memory_file_device.h"
 #include "core/json_serializer.h"
+#include "core/log.h"
 #include "core/path.h"
+#include "core/timer.h"
 #include <cstdio>
 
 
@@ -91,4 +93,66 @@ void UT_json_serializer(const char* params)
 	device.destroyFile(file);
 }
 
-REGISTER_TEST("unit_tests/core/json_serializer", UT_json_serializer, "")
\ No newline at end of file
+void UT_json_serializer_benchmark(const char* params)
+{
+	Lumix::DefaultAllocator allocator;
+	Lumix::PathManager path_manager(allocator);
+
+	const int COUNT = 20000;
+	Lumix::FS::MemoryFileDevice device(allocator);
+	Lumix::FS::IFile* file = device.createFile(NULL);
+	Lumix::Timer* timer = Lumix::Timer::create(allocator);
+	{
+		Lumix::JsonSerializer serializer(*file, Lumix::JsonSerializer::WRITE, Lumix::Path(""), allocator);
+		serializer.beginObject();
+		serializer.beginArray("commands");
+		for (int i = 0; i < COUNT; ++i)
+		{
+			serializer.beginObject();
+			serializer.serialize("index", i);
+			serializer.serialize("value", i * 0.5f);
+			serializer.serialize("name", "command name");
+			serializer.endObject();
+		}
+		serializer.endArray();
+		serializer.endObject();
+		serializer.flush();
+	}
+	float write_time = timer->tick();
+
+	file->seek(Lumix::FS::SeekMode::BEGIN, 0);
+	{
+		Lumix::JsonSerializer serializer(*file, Lumix::JsonSerializer::READ, Lumix::Path(""), allocator);
+		serializer.deserializeObjectBegin();
+		serializer.deserializeArrayBegin("commands");
+		int count = 0;
+		while (!serializer.isArrayEnd())
+		{
+			serializer.nextArrayItem();
+			serializer.deserializeObjectBegin();
+			int index;
+			float value;
+			char name[32];
+			serializer.deserialize("index", index, -1);
+			serializer.deserialize("value", value, -1);
+			serializer.deserialize("name", name, sizeof(name), "");
+			serializer.deserializeObjectEnd();
+			LUMIX_EXPECT(index == count);
+			LUMIX_EXPECT(value == count * 0.5f);
+			++count;
+		}
+		serializer.deserializeArrayEnd();
+		serializer.deserializeObjectEnd();
+		LUMIX_EXPECT(count == COUNT);
+		LUMIX_EXPECT(!serializer.isError());
+	}
+	float read_time = timer->tick();
+	Lumix::Timer::destroy(timer);
+
+	Lumix::g_log_info.log("unit") << "JsonSerializer: write " << write_time << "s, read "
+								  << read_time << "s";
+	device.destroyFile(file);
+}
+
+REGISTER_TEST("unit_tests/core/json_serializer", UT_json_serializer, "")
+REGISTER_TEST("unit_tests/core/json_serializer/benchmark", UT_json_serializer_benchmark, "")
\ No newline at end of file
@@ -0,0 +1,56 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "core/log.h"
+#include "core/string.h"
+
+
+namespace
+{
+
+
+char messages[8][64];
+int message_count = 0;
+
+
+void onLog(const char* system, const char* message)
+{
+	if (message_count < Lumix::lengthOf(messages))
+	{
+		Lumix::copyString(messages[message_count], message);
+	}
+	++message_count;
+}
+
+
+void UT_log_writer(const char* params)
+{
+	Lumix::DefaultAllocator allocator;
+	Lumix::Log log;
+	log.getCallback().bind<onLog>();
+
+	message_count = 0;
+	log.log("Test") << "direct";
+	LUMIX_EXPECT(message_count == 1);
+
+	Lumix::Log::startWriter(allocator);
+	for (int i = 0; i < 5; ++i)
+	{
+		log.log("Test") << "spam " << 7;
+	}
+	log.log("Test") << "other";
+	Lumix::Log::stopWriter();
+
+	LUMIX_EXPECT(message_count == 4);
+	LUMIX_EXPECT(Lumix::compareString(messages[1], "spam 7") == 0);
+	LUMIX_EXPECT(Lumix::compareString(messages[2], "Last message repeated 4 times") == 0);
+	LUMIX_EXPECT(Lumix::compareString(messages[3], "other") == 0);
+
+	log.log("Test") << "direct again";
+	LUMIX_EXPECT(message_count == 5);
+	LUMIX_EXPECT(Lumix::compareString(messages[4], "direct again") == 0);
+}
+
+
+} // anonymous namespace
+
+
+REGISTER_TEST("unit_tests/core/log/writer", UT_log_writer, "")
@@ -0,0 +1,51 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "core/lua_allocator.h"
+#include "core/lua_compat.h"
+#include "core/string.h"
+
+
+namespace
+{
+	void UT_lua_allocator(const char* params)
+	{
+		Lumix::DefaultAllocator main_allocator;
+		Lumix::LuaAllocator allocator(main_allocator);
+
+		auto* a = (char*)allocator.reallocate(nullptr, LUA_TSTRING, 10);
+		Lumix::copyString(a, 10, "123456789");
+		LUMIX_EXPECT(allocator.getStats().small_count == 1);
+		// the same size class
+		LUMIX_EXPECT(allocator.reallocate(a, 10, 16) == a);
+		a = (char*)allocator.reallocate(a, 16, 1000);
+		LUMIX_EXPECT(Lumix::compareString(a, "123456789") == 0);
+		LUMIX_EXPECT(allocator.getStats().small_count == 0);
+		LUMIX_EXPECT(allocator.getStats().large_count == 1);
+		a = (char*)allocator.reallocate(a, 1000, 20);
+		LUMIX_EXPECT(Lumix::compareString(a, "123456789") == 0);
+		LUMIX_EXPECT(allocator.getStats().large_count == 0);
+
+		void* b = allocator.reallocate(nullptr, 0, 20);
+		allocator.reallocate(b, 20, 0);
+		// freed blocks are reused
+		LUMIX_EXPECT(allocator.reallocate(nullptr, 0, 24) == b);
+		allocator.reallocate(b, 24, 0);
+		allocator.reallocate(a, 20, 0);
+		LUMIX_EXPECT(allocator.getStats().small_count == 0);
+		LUMIX_EXPECT(allocator.getStats().small_bytes == 0);
+
+		lua_State* L = lua_newstate(&Lumix::LuaAllocator::luaAlloc, &allocator);
+		luaL_openlibs(L);
+		const char* src = "local t = {} for i = 1, 10000 do t[i] = {tostring(i)} end return #t";
+		LUMIX_EXPECT(luaL_loadbuffer(L, src, Lumix::stringLength(src), "test") == LUA_OK);
+		LUMIX_EXPECT(lua_pcall(L, 0, 1, 0) == LUA_OK);
+		LUMIX_EXPECT(lua_tointeger(L, -1) == 10000);
+		LUMIX_EXPECT(allocator.getStats().small_count > 10000);
+		lua_close(L);
+
+		LUMIX_EXPECT(allocator.getStats().small_count == 0);
+		LUMIX_EXPECT(allocator.getStats().large_count == 0);
+		LUMIX_EXPECT(allocator.getStats().page_bytes > 0);
+	}
+}
+
+REGISTER_TEST("unit_tests/core/lua_allocator", UT_lua_allocator, "")
@@ -0,0 +1,55 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "core/lua_bytecode_cache.h"
+#include "core/lua_compat.h"
+#include "core/string.h"
+
+
+namespace
+{
+	int runChunk(Lumix::LuaBytecodeCache& cache, lua_State* L, const char* source, const char* name)
+	{
+		if (cache.load(L, source, Lumix::stringLength(source), name) != LUA_OK)
+		{
+			lua_pop(L, 1);
+			return -1;
+		}
+		if (lua_pcall(L, 0, 1, 0) != LUA_OK)
+		{
+			lua_pop(L, 1);
+			return -1;
+		}
+		int result = (int)lua_tointeger(L, -1);
+		lua_pop(L, 1);
+		return result;
+	}
+
+
+	void UT_lua_bytecode_cache(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::LuaBytecodeCache cache(allocator);
+		lua_State* L = luaL_newstate();
+		luaL_openlibs(L);
+
+		const char* source = "local a = 1 + 2 return a * 2";
+		// compiled, then loaded from the cached bytecode
+		LUMIX_EXPECT(runChunk(cache, L, source, "a.lua") == 6);
+		LUMIX_EXPECT(runChunk(cache, L, source, "a.lua") == 6);
+		LUMIX_EXPECT(runChunk(cache, L, source, "b.lua") == 6);
+		LUMIX_EXPECT(runChunk(cache, L, "return 10", "a.lua") == 10);
+
+		LUMIX_EXPECT(cache.load(L, "return +", 8, "error.lua") != LUA_OK);
+		LUMIX_EXPECT(lua_isstring(L, -1) != 0);
+		lua_pop(L, 1);
+		LUMIX_EXPECT(cache.load(L, "return +", 8, "error.lua") != LUA_OK);
+		lua_pop(L, 1);
+
+		cache.clear();
+		LUMIX_EXPECT(runChunk(cache, L, source, "a.lua") == 6);
+		LUMIX_EXPECT(lua_gettop(L) == 0);
+
+		lua_close(L);
+	}
+}
+
+REGISTER_TEST("unit_tests/core/lua_bytecode_cache", UT_lua_bytecode_cache, "")
@@ -0,0 +1,94 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "core/array.h"
+#include "core/blob.h"
+#include "core/fs/compressed_file_device.h"
+#include "core/lz4.h"
+
+
+static bool roundTrip(const Lumix::uint8* data, int size, Lumix::IAllocator& allocator)
+{
+	Lumix::Array<Lumix::uint8> compressed(allocator);
+	compressed.resize(Lumix::lz4CompressBound(size));
+	int compressed_size = Lumix::lz4Compress(data, size, &compressed[0], compressed.size());
+	if (compressed_size <= 0 || compressed_size > compressed.size()) return false;
+
+	Lumix::Array<Lumix::uint8> decompressed(allocator);
+	decompressed.resize(size + 1);
+	int decompressed_size = Lumix::lz4Decompress(&compressed[0], compressed_size, &decompressed[0], size);
+	if (decompressed_size != size) return false;
+	for (int i = 0; i < size; ++i)
+	{
+		if (decompressed[i] != data[i]) return false;
+	}
+	return true;
+}
+
+
+void UT_lz4(const char* params)
+{
+	Lumix::DefaultAllocator allocator;
+
+	Lumix::uint8 empty = 0;
+	LUMIX_EXPECT(roundTrip(&empty, 0, allocator));
+	LUMIX_EXPECT(roundTrip((const Lumix::uint8*)"short", 5, allocator));
+
+	const int SIZE = 200000;
+	Lumix::Array<Lumix::uint8> data(allocator);
+	data.resize(SIZE);
+	for (int i = 0; i < SIZE; ++i)
+	{
+		data[i] = Lumix::uint8(i % 251);
+	}
+	LUMIX_EXPECT(roundTrip(&data[0], SIZE, allocator));
+
+	Lumix::uint32 seed = 0x12345678;
+	for (int i = 0; i < SIZE; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		data[i] = Lumix::uint8(seed >> 24);
+	}
+	LUMIX_EXPECT(roundTrip(&data[0], SIZE, allocator));
+
+	for (int i = 0; i < SIZE; ++i)
+	{
+		data[i] = i < SIZE / 2 ? 'a' : data[i];
+	}
+	LUMIX_EXPECT(roundTrip(&data[0], SIZE, allocator));
+
+	Lumix::uint8 malformed[] = {0xf0, 0xff, 0xff};
+	Lumix::uint8 out[16];
+	LUMIX_EXPECT(Lumix::lz4Decompress(malformed, sizeof(malformed), out, sizeof(out)) == -1);
+	Lumix::uint8 bad_offset[] = {0x10, 'a', 0x05, 0x00, 0x00};
+	LUMIX_EXPECT(Lumix::lz4Decompress(bad_offset, sizeof(bad_offset), out, sizeof(out)) == -1);
+
+	Lumix::OutputBlob blob(allocator);
+	LUMIX_EXPECT(Lumix::FS::CompressedFileDevice::compress(&data[0], SIZE, blob, allocator));
+	LUMIX_EXPECT(blob.getSize() < SIZE);
+	LUMIX_EXPECT(Lumix::FS::CompressedFileDevice::isCompressed(blob.getData(), blob.getSize()));
+	LUMIX_EXPECT(!Lumix::FS::CompressedFileDevice::isCompressed(&data[0], SIZE));
+
+	Lumix::Array<Lumix::uint8> packed(allocator);
+	for (int i = 0; i < SIZE; ++i)
+	{
+		packed.push(data[i]);
+	}
+	LUMIX_EXPECT(Lumix::lz4CompressInPlace(packed, allocator));
+	LUMIX_EXPECT(packed.size() < SIZE);
+	LUMIX_EXPECT(Lumix::lz4DecompressInPlace(packed, allocator));
+	LUMIX_EXPECT(packed.size() == SIZE);
+	bool same = true;
+	for (int i = 0; i < SIZE; ++i)
+	{
+		same = same && packed[i] == data[i];
+	}
+	LUMIX_EXPECT(same);
+
+	// incompressible data stays as it is
+	packed.clear();
+	packed.push('x');
+	LUMIX_EXPECT(!Lumix::lz4CompressInPlace(packed, allocator));
+	LUMIX_EXPECT(packed.size() == 1);
+	LUMIX_EXPECT(packed[0] == 'x');
+}
+
+REGISTER_TEST("unit_tests/core/lz4", UT_lz4, "")
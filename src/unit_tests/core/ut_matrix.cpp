@@ -1,6 +1,8 @@
 #include "unit_tests/suite/lumix_unit_tests.h"
 #include "core/matrix.h"
+#include "core/log.h"
 #include "core/quat.h"
+#include "core/timer.h"
 
 
 void expectSameMatrices(const Lumix::Matrix& mtx1, const Lumix::Matrix& mtx2)
@@ -146,4 +148,89 @@ void UT_matrix(const char* params)
 }
 
 
+// plain scalar product, the reference for the SSE version
+static void multiplyScalar(Lumix::Matrix& result,
+	const Lumix::Matrix& op1,
+	const Lumix::Matrix& op2)
+{
+	const float* a = &op1.m11;
+	const float* b = &op2.m11;
+	float* r = &result.m11;
+	for (int j = 0; j < 4; ++j)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			r[j * 4 + i] = a[i] * b[j * 4] + a[4 + i] * b[j * 4 + 1] + a[8 + i] * b[j * 4 + 2] +
+						   a[12 + i] * b[j * 4 + 3];
+		}
+	}
+}
+
+
+static void fillMatrix(Lumix::Matrix& mtx, int seed)
+{
+	for (int i = 0; i < 16; ++i)
+	{
+		(&mtx.m11)[i] = float((seed * 31 + i * 17) % 23) * 0.25f - 2.5f;
+	}
+}
+
+
+void UT_matrix_multiply(const char* params)
+{
+	for (int seed = 0; seed < 8; ++seed)
+	{
+		Lumix::Matrix a, b, expected, result;
+		fillMatrix(a, seed);
+		fillMatrix(b, seed + 100);
+		multiplyScalar(expected, a, b);
+
+		expectSameMatrices(a * b, expected);
+		Lumix::multiplicate(result, a, b);
+		expectSameMatrices(result, expected);
+
+		Lumix::Vec3 pos(1.5f, -2, 0.25f);
+		Lumix::Vec3 v = a.multiplyPosition(pos);
+		LUMIX_EXPECT_CLOSE_EQ(v.x, a.m11 * pos.x + a.m21 * pos.y + a.m31 * pos.z + a.m41, 0.001f);
+		LUMIX_EXPECT_CLOSE_EQ(v.y, a.m12 * pos.x + a.m22 * pos.y + a.m32 * pos.z + a.m42, 0.001f);
+		LUMIX_EXPECT_CLOSE_EQ(v.z, a.m13 * pos.x + a.m23 * pos.y + a.m33 * pos.z + a.m43, 0.001f);
+	}
+}
+
+
+void UT_matrix_multiply_benchmark(const char* params)
+{
+	Lumix::DefaultAllocator allocator;
+	const int COUNT = 1000000;
+	// rotations, so the long chain of products stays bounded
+	Lumix::Matrix a, b;
+	Lumix::Quat(Lumix::Vec3(0, 1, 0), 0.3f).toMatrix(a);
+	Lumix::Quat(Lumix::Vec3(1, 0, 0), -0.7f).toMatrix(b);
+
+	Lumix::Timer* timer = Lumix::Timer::create(allocator);
+	Lumix::Matrix scalar = Lumix::Matrix::IDENTITY;
+	Lumix::Matrix tmp;
+	for (int i = 0; i < COUNT; ++i)
+	{
+		multiplyScalar(tmp, scalar, (i & 1) ? a : b);
+		scalar = tmp;
+	}
+	float scalar_time = timer->tick();
+
+	Lumix::Matrix simd = Lumix::Matrix::IDENTITY;
+	for (int i = 0; i < COUNT; ++i)
+	{
+		simd = simd * ((i & 1) ? a : b);
+	}
+	float simd_time = timer->tick();
+	Lumix::Timer::destroy(timer);
+
+	expectSameMatrices(simd, scalar);
+	Lumix::g_log_info.log("unit") << "Matrix multiply, scalar: " << scalar_time
+								  << "s, SSE: " << simd_time << "s";
+}
+
+
 REGISTER_TEST("unit_tests/core/matrix", UT_matrix, "")
+REGISTER_TEST("unit_tests/core/matrix_multiply", UT_matrix_multiply, "")
+REGISTER_TEST("unit_tests/core/matrix_multiply_benchmark", UT_matrix_multiply_benchmark, "")
@@ -1,6 +1,7 @@
 #include "unit_tests/suite/lumix_unit_tests.h"
 #include "core/MTJD/job.h"
 #include "core/MTJD/manager.h"
+#include "core/MTJD/parallel_for.h"
 
 
 namespace
@@ -65,10 +66,47 @@ private:
 	int32 m_size;
 };
 
-void UT_MTJDFrameworkTest(const char* params)
+// adds the buffers in a child job and doubles the sum once the child is done
+class FiberTestJob : public Lumix::MTJD::Job
+{
+public:
+	FiberTestJob(int32 index, Lumix::MTJD::Manager& manager, Lumix::IAllocator& allocator)
+		: Job(Job::FIBER | Job::SYNC_EVENT,
+			  Lumix::MTJD::Priority::Default,
+			  manager,
+			  allocator,
+			  allocator)
+		, m_index(index)
+	{
+		setJobName("FiberTestJob");
+	}
+
+	void execute() override
+	{
+		TestJob child(IN1_BUFFER[m_index],
+			IN2_BUFFER[m_index],
+			OUT_BUFFER[m_index],
+			BUFFER_SIZE,
+			false,
+			m_manager,
+			m_allocator);
+		m_manager.schedule(&child);
+		waitFor(child);
+
+		for (int32 i = 0; i < BUFFER_SIZE; i++)
+		{
+			OUT_BUFFER[m_index][i] *= 2;
+		}
+	}
+
+private:
+	int32 m_index;
+};
+
+static void testFramework(Lumix::MTJD::SchedulerType scheduler_type, bool help_sync)
 {
 	Lumix::DefaultAllocator allocator;
-	Lumix::MTJD::Manager* manager = Lumix::MTJD::Manager::create(allocator);
+	Lumix::MTJD::Manager* manager = Lumix::MTJD::Manager::create(allocator, scheduler_type);
 
 	for (size_t x = 0; x < TEST_RUNS; x++)
 	{
@@ -107,7 +145,14 @@ void UT_MTJDFrameworkTest(const char* params)
 
 		for (int32 i = 0; i < TESTS_COUNT; i++)
 		{
-			jobs[i]->sync();
+			if (help_sync)
+			{
+				jobs[i]->sync(*manager);
+			}
+			else
+			{
+				jobs[i]->sync();
+			}
 		}
 
 		for (int32 i = 0; i < TESTS_COUNT; i++)
@@ -127,7 +172,7 @@ void UT_MTJDFrameworkTest(const char* params)
 	Lumix::MTJD::Manager::destroy(*manager);
 }
 
-void UT_MTJDFrameworkDependencyTest(const char* params)
+static void testFrameworkDependency(Lumix::MTJD::SchedulerType scheduler_type)
 {
 	Lumix::DefaultAllocator allocator;
 	for (int32 i = 0; i < TESTS_COUNT; i++)
@@ -140,7 +185,7 @@ void UT_MTJDFrameworkDependencyTest(const char* params)
 		}
 	}
 
-	Lumix::MTJD::Manager* manager = Lumix::MTJD::Manager::create(allocator);
+	Lumix::MTJD::Manager* manager = Lumix::MTJD::Manager::create(allocator, scheduler_type);
 
 	TestJob** jobs = (TestJob**)allocator.allocate(sizeof(TestJob*) * TESTS_COUNT);
 
@@ -192,5 +237,126 @@ void UT_MTJDFrameworkDependencyTest(const char* params)
 	allocator.deallocate(jobs);
 }
 
+static void testParallelFor(Lumix::MTJD::SchedulerType scheduler_type)
+{
+	Lumix::DefaultAllocator allocator;
+	Lumix::MTJD::Manager* manager = Lumix::MTJD::Manager::create(allocator, scheduler_type);
+
+	for (int32 j = 0; j < BUFFER_SIZE; j++)
+	{
+		IN1_BUFFER[0][j] = (float)j;
+		IN2_BUFFER[0][j] = (float)j;
+		OUT_BUFFER[0][j] = 0;
+	}
+
+	for (int32 grain = 1; grain <= BUFFER_SIZE * 2; grain *= 7)
+	{
+		Lumix::MTJD::parallelFor(*manager, 0, BUFFER_SIZE, grain, [](int from, int to) {
+			for (int i = from; i < to; ++i)
+			{
+				OUT_BUFFER[0][i] += IN1_BUFFER[0][i] + IN2_BUFFER[0][i];
+			}
+		});
+	}
+
+	int32 runs = 0;
+	for (int32 grain = 1; grain <= BUFFER_SIZE * 2; grain *= 7) ++runs;
+	for (int32 j = 0; j < BUFFER_SIZE; j++)
+	{
+		LUMIX_EXPECT(OUT_BUFFER[0][j] == (float)(runs * 2 * j));
+	}
+
+	Lumix::MTJD::Manager::destroy(*manager);
+}
+
+static void testFiberJobs(Lumix::MTJD::SchedulerType scheduler_type, int fiber_stack_size)
+{
+	Lumix::DefaultAllocator allocator;
+	Lumix::MTJD::Manager::Config config;
+	config.fiber_stack_size = fiber_stack_size;
+	Lumix::MTJD::Manager* manager = Lumix::MTJD::Manager::create(allocator, scheduler_type, config);
+
+	for (int32 run = 0; run < TEST_RUNS; run++)
+	{
+		for (int32 i = 0; i < TESTS_COUNT; i++)
+		{
+			for (int32 j = 0; j < BUFFER_SIZE; j++)
+			{
+				IN1_BUFFER[i][j] = (float)j;
+				IN2_BUFFER[i][j] = (float)j;
+				OUT_BUFFER[i][j] = 0;
+			}
+		}
+
+		FiberTestJob* jobs[TESTS_COUNT];
+		for (int32 i = 0; i < TESTS_COUNT; i++)
+		{
+			jobs[i] = LUMIX_NEW(allocator, FiberTestJob)(i, *manager, allocator);
+			manager->schedule(jobs[i]);
+		}
+
+		for (int32 i = 0; i < TESTS_COUNT; i++)
+		{
+			jobs[i]->sync(*manager);
+		}
+
+		for (int32 i = 0; i < TESTS_COUNT; i++)
+		{
+			for (int32 j = 0; j < BUFFER_SIZE; j++)
+			{
+				LUMIX_EXPECT(OUT_BUFFER[i][j] == (float)(4 * j));
+			}
+			LUMIX_DELETE(allocator, jobs[i]);
+		}
+	}
+
+	Lumix::MTJD::Manager::destroy(*manager);
+}
+
+void UT_MTJDFrameworkTest(const char* params)
+{
+	testFramework(Lumix::MTJD::SchedulerType::Central, false);
+}
+
+void UT_MTJDFrameworkDependencyTest(const char* params)
+{
+	testFrameworkDependency(Lumix::MTJD::SchedulerType::Central);
+}
+
+void UT_MTJDWorkStealingTest(const char* params)
+{
+	testFramework(Lumix::MTJD::SchedulerType::WorkStealing, false);
+}
+
+void UT_MTJDWorkStealingDependencyTest(const char* params)
+{
+	testFrameworkDependency(Lumix::MTJD::SchedulerType::WorkStealing);
+}
+
+void UT_MTJDHelpingSyncTest(const char* params)
+{
+	testFramework(Lumix::MTJD::SchedulerType::Central, true);
+	testFramework(Lumix::MTJD::SchedulerType::WorkStealing, true);
+}
+
+void UT_MTJDParallelForTest(const char* params)
+{
+	testParallelFor(Lumix::MTJD::SchedulerType::Central);
+	testParallelFor(Lumix::MTJD::SchedulerType::WorkStealing);
+}
+
+void UT_MTJDFiberTest(const char* params)
+{
+	testFiberJobs(Lumix::MTJD::SchedulerType::Central, 64 * 1024);
+	// without fibers, waitFor executes other jobs until the child is done
+	testFiberJobs(Lumix::MTJD::SchedulerType::Central, 0);
+	testFiberJobs(Lumix::MTJD::SchedulerType::WorkStealing, 64 * 1024);
+}
+
 REGISTER_TEST("unit_tests/core/MTJD/frameworkTest", UT_MTJDFrameworkTest, "")
-REGISTER_TEST("unit_tests/core/MTJD/frameworkDependencyTest", UT_MTJDFrameworkDependencyTest, "")
\ No newline at end of file
+REGISTER_TEST("unit_tests/core/MTJD/frameworkDependencyTest", UT_MTJDFrameworkDependencyTest, "")
+REGISTER_TEST("unit_tests/core/MTJD/workStealingTest", UT_MTJDWorkStealingTest, "")
+REGISTER_TEST("unit_tests/core/MTJD/workStealingDependencyTest", UT_MTJDWorkStealingDependencyTest, "")
+REGISTER_TEST("unit_tests/core/MTJD/helpingSyncTest", UT_MTJDHelpingSyncTest, "")
+REGISTER_TEST("unit_tests/core/MTJD/parallelForTest", UT_MTJDParallelForTest, "")
+REGISTER_TEST("unit_tests/core/MTJD/fiberTest", UT_MTJDFiberTest, "")
\ No newline at end of file
@@ -18,4 +18,49 @@ void UT_path(const char* params)
 	LUMIX_EXPECT(path.getHash() == Lumix::crc32(res_path));
 }
 
-REGISTER_TEST("unit_tests/core/path/path", UT_path, "")
\ No newline at end of file
+REGISTER_TEST("unit_tests/core/path/path", UT_path, "")
+
+
+void UT_path_interning(const char* params)
+{
+	Lumix::DefaultAllocator allocator;
+	Lumix::PathManager path_manager(allocator);
+
+	Lumix::Path path(src_path);
+	Lumix::Path same(res_path);
+	LUMIX_EXPECT(path.c_str() == same.c_str());
+	LUMIX_EXPECT(path.length() == Lumix::stringLength(res_path));
+
+	Lumix::Path by_hash(path.getHash());
+	LUMIX_EXPECT(by_hash == path);
+
+	Lumix::Path copy;
+	LUMIX_EXPECT(!copy.isValid());
+	LUMIX_EXPECT(copy.length() == 0);
+	copy = path;
+	copy = copy;
+	LUMIX_EXPECT(copy == path);
+	LUMIX_EXPECT(Lumix::compareString(copy.c_str(), res_path) == 0);
+
+	{
+		Lumix::Path tmp("unit/test/other.ext");
+		Lumix::Path tmp_copy(tmp);
+	}
+	// released paths can be interned again
+	Lumix::Path again("unit/test/other.ext");
+	LUMIX_EXPECT(Lumix::compareString(again.c_str(), "unit/test/other.ext") == 0);
+	LUMIX_EXPECT(Lumix::compareString(path.c_str(), res_path) == 0);
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		char tmp[Lumix::MAX_PATH_LENGTH];
+		Lumix::toCString(i, tmp, Lumix::lengthOf(tmp));
+		Lumix::catString(tmp, "/some/longer/path/to/a/file.ext");
+		Lumix::Path a(tmp);
+		Lumix::Path b(tmp);
+		LUMIX_EXPECT(a == b);
+		LUMIX_EXPECT(Lumix::compareString(a.c_str(), tmp) == 0);
+	}
+}
+
+REGISTER_TEST("unit_tests/core/path/interning", UT_path_interning, "")
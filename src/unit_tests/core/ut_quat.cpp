@@ -79,4 +79,31 @@ void UT_quat(const char* params)
 	}
 }
 
-REGISTER_TEST("unit_tests/core/quat", UT_quat, "")
\ No newline at end of file
+void UT_quat_multiply(const char* params)
+{
+	Lumix::Quat lhs(0.1f, 0.2f, 0.3f, 0.9f);
+	Lumix::Quat rhs(-0.4f, 0.5f, 0.2f, 0.7f);
+	lhs.normalize();
+	rhs.normalize();
+
+	Lumix::Quat q = lhs * rhs;
+	float w = rhs.w * lhs.w - rhs.x * lhs.x - rhs.y * lhs.y - rhs.z * lhs.z;
+	float x = rhs.w * lhs.x + rhs.x * lhs.w + rhs.y * lhs.z - rhs.z * lhs.y;
+	float y = rhs.w * lhs.y + rhs.y * lhs.w + rhs.z * lhs.x - rhs.x * lhs.z;
+	float z = rhs.w * lhs.z + rhs.z * lhs.w + rhs.x * lhs.y - rhs.y * lhs.x;
+	LUMIX_EXPECT_CLOSE_EQ(q.x, x, 0.001f);
+	LUMIX_EXPECT_CLOSE_EQ(q.y, y, 0.001f);
+	LUMIX_EXPECT_CLOSE_EQ(q.z, z, 0.001f);
+	LUMIX_EXPECT_CLOSE_EQ(q.w, w, 0.001f);
+
+	// rotating by the product is rotating by lhs first
+	Lumix::Vec3 v(1, -2, 3);
+	Lumix::Vec3 expected = rhs * (lhs * v);
+	Lumix::Vec3 rotated = q * v;
+	LUMIX_EXPECT_CLOSE_EQ(rotated.x, expected.x, 0.001f);
+	LUMIX_EXPECT_CLOSE_EQ(rotated.y, expected.y, 0.001f);
+	LUMIX_EXPECT_CLOSE_EQ(rotated.z, expected.z, 0.001f);
+}
+
+REGISTER_TEST("unit_tests/core/quat", UT_quat, "")
+REGISTER_TEST("unit_tests/core/quat_multiply", UT_quat_multiply, "")
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "core/radix_sort.h"
+
+
+namespace
+{
+	struct Item
+	{
+		Lumix::uint64 key;
+		int index;
+	};
+
+
+	void UT_radix_sort(const char* params)
+	{
+		static const int COUNT = 1000;
+		Item items[COUNT];
+		Item tmp[COUNT];
+		Lumix::uint64 seed = 0x12345678;
+		for (int i = 0; i < COUNT; ++i)
+		{
+			seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+			// few distinct keys so there are duplicates to check stability
+			items[i].key = (seed >> 40) % 37 | ((i & 1) ? (1ULL << 63) : 0);
+			items[i].index = i;
+		}
+
+		auto get_key = [](const Item& item) { return item.key; };
+		Lumix::radixSort(items, tmp, COUNT, get_key);
+		for (int i = 1; i < COUNT; ++i)
+		{
+			LUMIX_EXPECT(items[i - 1].key <= items[i].key);
+			if (items[i - 1].key == items[i].key)
+			{
+				LUMIX_EXPECT(items[i - 1].index < items[i].index);
+			}
+		}
+
+		// already sorted input, all passes but the last are skipped
+		for (int i = 0; i < COUNT; ++i)
+		{
+			items[i].key = (Lumix::uint64)(i / 4) << 56;
+			items[i].index = i;
+		}
+		Lumix::radixSort(items, tmp, COUNT, get_key);
+		for (int i = 0; i < COUNT; ++i)
+		{
+			LUMIX_EXPECT(items[i].index == i);
+		}
+
+		Lumix::radixSort(items, tmp, 0, get_key);
+		Lumix::radixSort(items, tmp, 1, get_key);
+		LUMIX_EXPECT(items[0].index == 0);
+	}
+}
+
+REGISTER_TEST("unit_tests/core/radix_sort", UT_radix_sort, "");
@@ -0,0 +1,108 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "core/path.h"
+#include "core/resource.h"
+#include "core/resource_manager.h"
+#include "core/resource_manager_base.h"
+
+
+namespace
+{
+
+
+const Lumix::uint32 TEST_TYPE = 0x12345678;
+
+
+// ready right away, without a file
+class TestResource : public Lumix::Resource
+{
+public:
+	TestResource(const Lumix::Path& path,
+		Lumix::ResourceManager& resource_manager,
+		Lumix::IAllocator& allocator)
+		: Resource(path, resource_manager, allocator)
+	{
+		m_size = 100;
+		onCreated(State::READY);
+	}
+
+	void unload() override {}
+	bool load(Lumix::FS::IFile&) override { return false; }
+};
+
+
+class TestManager : public Lumix::ResourceManagerBase
+{
+public:
+	explicit TestManager(Lumix::IAllocator& allocator)
+		: ResourceManagerBase(allocator)
+		, m_allocator(allocator)
+	{
+	}
+
+protected:
+	Lumix::Resource* createResource(const Lumix::Path& path) override
+	{
+		return LUMIX_NEW(m_allocator, TestResource)(path, getOwner(), m_allocator);
+	}
+
+	void destroyResource(Lumix::Resource& resource) override
+	{
+		LUMIX_DELETE(m_allocator, static_cast<TestResource*>(&resource));
+	}
+
+private:
+	Lumix::IAllocator& m_allocator;
+};
+
+
+void UT_resource_cache(const char* params)
+{
+	Lumix::DefaultAllocator allocator;
+	Lumix::PathManager path_manager(allocator);
+	Lumix::ResourceManager resource_manager(allocator);
+	TestManager manager(allocator);
+	manager.create(TEST_TYPE, resource_manager);
+	manager.setCacheBudget(250);
+
+	Lumix::Resource* a = manager.load(Lumix::Path("a"));
+	Lumix::Resource* b = manager.load(Lumix::Path("b"));
+	Lumix::Resource* c = manager.load(Lumix::Path("c"));
+	LUMIX_EXPECT(a->isReady() && b->isReady() && c->isReady());
+
+	// unreferenced resources stay loaded
+	manager.unload(*a);
+	manager.unload(*b);
+	LUMIX_EXPECT(a->isReady());
+	LUMIX_EXPECT(b->isReady());
+	LUMIX_EXPECT(manager.getCacheSize() == 200);
+
+	// and are reused
+	LUMIX_EXPECT(manager.load(Lumix::Path("a")) == a);
+	LUMIX_EXPECT(manager.getCacheSize() == 100);
+
+	// the least recently used is evicted when the cache is over the budget
+	manager.unload(*c);
+	manager.unload(*a);
+	LUMIX_EXPECT(b->isEmpty());
+	LUMIX_EXPECT(c->isReady());
+	LUMIX_EXPECT(a->isReady());
+	LUMIX_EXPECT(manager.getCachedCount() == 2);
+	LUMIX_EXPECT(manager.getCacheSize() == 200);
+
+	// cached resources are not destroyed
+	resource_manager.removeUnreferenced();
+	LUMIX_EXPECT(manager.get(Lumix::Path("a")) == a);
+	LUMIX_EXPECT(manager.get(Lumix::Path("b")) == nullptr);
+
+	resource_manager.evictCaches();
+	LUMIX_EXPECT(a->isEmpty());
+	LUMIX_EXPECT(c->isEmpty());
+	LUMIX_EXPECT(manager.getCacheSize() == 0);
+	manager.destroy();
+}
+
+
+} // anonymous namespace
+
+
+REGISTER_TEST("unit_tests/core/resource_cache", UT_resource_cache, "")
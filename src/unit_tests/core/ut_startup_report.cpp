@@ -0,0 +1,43 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "core/frame_stats.h"
+#include "core/startup_report.h"
+#include "core/string.h"
+
+
+namespace
+{
+	void UT_startup_report(const char* params)
+	{
+		using namespace Lumix;
+
+		// other tests can record some phases too
+		int count = StartupReport::getEventCount();
+		bool is_universe_recorded = StartupReport::isRecorded(StartupReport::Phase::UNIVERSE_LOAD);
+
+		uint64 start = FrameStats::getRawTime();
+		StartupReport::record(StartupReport::Phase::DLL_LOAD, "ut_plugin", start);
+		{
+			StartupReport::Scope scope(StartupReport::Phase::PLUGIN_CREATE, "ut_plugin");
+		}
+		LUMIX_EXPECT(StartupReport::getEventCount() == count + 2);
+		LUMIX_EXPECT(StartupReport::isRecorded(StartupReport::Phase::DLL_LOAD));
+
+		const StartupReport::Event& dll_load = StartupReport::getEvent(count);
+		LUMIX_EXPECT(dll_load.phase == StartupReport::Phase::DLL_LOAD);
+		LUMIX_EXPECT(compareString(dll_load.name, "ut_plugin") == 0);
+		LUMIX_EXPECT(dll_load.duration >= 0);
+		LUMIX_EXPECT_CLOSE_EQ(dll_load.start, FrameStats::toMilliseconds(start), 0.001f);
+
+		const StartupReport::Event& create = StartupReport::getEvent(count + 1);
+		LUMIX_EXPECT(create.phase == StartupReport::Phase::PLUGIN_CREATE);
+		LUMIX_EXPECT(create.start >= dll_load.start);
+
+		// only the first universe load is recorded
+		StartupReport::record(StartupReport::Phase::UNIVERSE_LOAD, "first", start);
+		StartupReport::record(StartupReport::Phase::UNIVERSE_LOAD, "second", start);
+		LUMIX_EXPECT(StartupReport::isRecorded(StartupReport::Phase::UNIVERSE_LOAD));
+		LUMIX_EXPECT(StartupReport::getEventCount() == count + (is_universe_recorded ? 2 : 3));
+	}
+}
+
+REGISTER_TEST("unit_tests/core/startup_report", UT_startup_report, "");
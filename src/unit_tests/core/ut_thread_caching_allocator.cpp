@@ -0,0 +1,110 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "core/array.h"
+#include "core/base_proxy_allocator.h"
+#include "core/mtjd/manager.h"
+#include "core/mtjd/parallel_for.h"
+#include "core/string.h"
+#include "core/thread_caching_allocator.h"
+
+
+namespace
+{
+	void UT_thread_caching_allocator(const char* params)
+	{
+		Lumix::DefaultAllocator main_allocator;
+		Lumix::ThreadCachingAllocator allocator(main_allocator);
+
+		for (size_t size = 0; size <= 20000; size += 7)
+		{
+			void* ptr = allocator.allocate(size);
+			LUMIX_EXPECT(((Lumix::uintptr)ptr & 15) == 0);
+			LUMIX_EXPECT(allocator.getAllocationSize(ptr, false) >= size);
+			Lumix::setMemory(ptr, 0xab, size);
+			allocator.deallocate(ptr);
+		}
+
+		void* aligned = allocator.allocate_aligned(100, 256);
+		LUMIX_EXPECT(((Lumix::uintptr)aligned & 255) == 0);
+		allocator.deallocate_aligned(aligned);
+
+		char* ptr = (char*)allocator.reallocate(nullptr, 10);
+		Lumix::copyString(ptr, 10, "lumix");
+		ptr = (char*)allocator.reallocate(ptr, 5000);
+		LUMIX_EXPECT(Lumix::compareString(ptr, "lumix") == 0);
+		ptr = (char*)allocator.reallocate(ptr, 100000);
+		LUMIX_EXPECT(Lumix::compareString(ptr, "lumix") == 0);
+
+		Lumix::AllocatorStats stats;
+		LUMIX_EXPECT(allocator.getStats(stats));
+		LUMIX_EXPECT(stats.live_count == 1);
+		LUMIX_EXPECT(stats.live_bytes == 100000);
+		allocator.deallocate(ptr);
+		LUMIX_EXPECT(allocator.getStats(stats));
+		LUMIX_EXPECT(stats.live_count == 0);
+		LUMIX_EXPECT(stats.live_bytes == 0);
+
+		// proxies see the sizes of their own blocks
+		Lumix::BaseProxyAllocator proxy(allocator);
+		{
+			Lumix::Array<int> array(proxy);
+			array.resize(1000);
+			LUMIX_EXPECT(proxy.getStats(stats));
+			LUMIX_EXPECT(stats.live_count == 1);
+			LUMIX_EXPECT(stats.live_bytes >= sizeof(int) * 1000);
+		}
+		LUMIX_EXPECT(proxy.getStats(stats));
+		LUMIX_EXPECT(stats.live_count == 0);
+		LUMIX_EXPECT(stats.live_bytes == 0);
+	}
+
+
+	void UT_thread_caching_allocator_threads(const char* params)
+	{
+		Lumix::DefaultAllocator main_allocator;
+		Lumix::ThreadCachingAllocator allocator(main_allocator);
+		Lumix::MTJD::Manager* manager = Lumix::MTJD::Manager::create(main_allocator);
+
+		static const int COUNT = 10000;
+		void* ptrs[COUNT];
+		// allocated and freed on different workers, blocks go back to their owners
+		for (int pass = 0; pass < 3; ++pass)
+		{
+			Lumix::MTJD::parallelFor(*manager,
+				0,
+				COUNT,
+				100,
+				[&](int from, int to)
+				{
+					for (int i = from; i < to; ++i)
+					{
+						ptrs[i] = allocator.allocate(16 + (i % 300));
+						*(int*)ptrs[i] = i;
+					}
+				});
+			Lumix::MTJD::parallelFor(*manager,
+				0,
+				COUNT,
+				70,
+				[&](int from, int to)
+				{
+					for (int i = from; i < to; ++i)
+					{
+						LUMIX_EXPECT(*(int*)ptrs[i] == i);
+						allocator.deallocate(ptrs[i]);
+					}
+				});
+		}
+
+		Lumix::AllocatorStats stats;
+		LUMIX_EXPECT(allocator.getStats(stats));
+		LUMIX_EXPECT(stats.live_count == 0);
+		LUMIX_EXPECT(stats.allocation_count == 3 * COUNT);
+
+		Lumix::MTJD::Manager::destroy(*manager);
+	}
+}
+
+REGISTER_TEST("unit_tests/core/thread_caching_allocator", UT_thread_caching_allocator, "")
+REGISTER_TEST("unit_tests/core/thread_caching_allocator/threads",
+	UT_thread_caching_allocator_threads,
+	"")
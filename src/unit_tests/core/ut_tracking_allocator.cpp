@@ -0,0 +1,51 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "core/thread_caching_allocator.h"
+#include "core/tracking_allocator.h"
+
+
+namespace
+{
+	void UT_tracking_allocator(const char* params)
+	{
+		Lumix::DefaultAllocator main_allocator;
+		// knows sizes of its blocks
+		Lumix::ThreadCachingAllocator source(main_allocator);
+		Lumix::TrackingAllocator allocator(source, "ut_tracking");
+		LUMIX_EXPECT(Lumix::TrackingAllocator::find("ut_tracking") == &allocator);
+		allocator.setBudget(1024);
+
+		void* a = allocator.allocate(1000);
+		void* b = allocator.allocate(2000);
+		Lumix::AllocatorStats stats;
+		LUMIX_EXPECT(allocator.getStats(stats));
+		LUMIX_EXPECT(stats.live_count == 2);
+		LUMIX_EXPECT(stats.live_bytes >= 3000);
+		LUMIX_EXPECT(allocator.getPeakSize() == stats.live_bytes);
+
+		Lumix::TrackingAllocator::endFrame();
+		LUMIX_EXPECT(allocator.getFrameAllocationCount() == 2);
+		allocator.deallocate(b);
+		LUMIX_EXPECT(allocator.getStats(stats));
+		LUMIX_EXPECT(stats.live_bytes < allocator.getPeakSize());
+		Lumix::TrackingAllocator::endFrame();
+		LUMIX_EXPECT(allocator.getFrameAllocationCount() == 0);
+
+		allocator.enableCallstacks(true);
+		void* c = allocator.allocate(100);
+		LUMIX_EXPECT(allocator.getAllocationInfos().size() == 1);
+		LUMIX_EXPECT(allocator.getAllocationInfos().find(c).isValid());
+		c = allocator.reallocate(c, 5000);
+		LUMIX_EXPECT(allocator.getAllocationInfos().size() == 1);
+		LUMIX_EXPECT(allocator.getAllocationInfos().find(c).value().size >= 5000);
+		allocator.deallocate(c);
+		LUMIX_EXPECT(allocator.getAllocationInfos().size() == 0);
+		allocator.enableCallstacks(false);
+
+		allocator.deallocate(a);
+		LUMIX_EXPECT(allocator.getStats(stats));
+		LUMIX_EXPECT(stats.live_count == 0);
+		LUMIX_EXPECT(stats.live_bytes == 0);
+	}
+}
+
+REGISTER_TEST("unit_tests/core/tracking_allocator", UT_tracking_allocator, "")
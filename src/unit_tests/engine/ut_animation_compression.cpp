@@ -0,0 +1,102 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "animation/animation_compression.h"
+#include "core/math_utils.h"
+
+
+namespace
+{
+	namespace Compression = Lumix::AnimationCompression;
+	using Lumix::Math::randFloat;
+
+
+	void UT_animation_compression_quat(const char* params)
+	{
+		for (int i = 0; i < 1000; ++i)
+		{
+			Lumix::Vec3 axis(randFloat(-1, 1), randFloat(-1, 1), randFloat(-1, 1));
+			if (axis.squaredLength() < 0.01f) continue;
+			Lumix::Quat rot(axis.normalized(), randFloat(-Lumix::Math::PI, Lumix::Math::PI));
+
+			float unpacked[4];
+			Compression::unpackQuat(Compression::packQuat(rot), unpacked);
+			// the same rotation, the sign can be flipped
+			float dot = rot.x * unpacked[0] + rot.y * unpacked[1] + rot.z * unpacked[2] +
+						rot.w * unpacked[3];
+			LUMIX_EXPECT_CLOSE_EQ(fabsf(dot), 1.0f, 0.0001f);
+		}
+	}
+
+
+	void UT_animation_compression_position(const char* params)
+	{
+		Lumix::Vec3 min(-3, 0, 10);
+		Lumix::Vec3 max(5, 0, 20);
+		Lumix::Vec3 scale = Compression::getPositionScale(min, max);
+		Lumix::Vec3 positions[] = {min, max, Lumix::Vec3(1, 0, 12.345f)};
+		for (const auto& pos : positions)
+		{
+			float unpacked[3];
+			auto packed = Compression::packPosition(pos, min, scale);
+			Compression::unpackPosition(packed, min, scale, unpacked);
+			LUMIX_EXPECT_CLOSE_EQ(pos.x, unpacked[0], 0.001f);
+			LUMIX_EXPECT_CLOSE_EQ(pos.y, unpacked[1], 0.001f);
+			LUMIX_EXPECT_CLOSE_EQ(pos.z, unpacked[2], 0.001f);
+		}
+	}
+
+
+	void UT_animation_compression_reduce_keys(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::Array<Lumix::uint16> frames(allocator);
+		Lumix::Vec3 keys[50];
+
+		for (auto& key : keys) key.set(1, 2, 3);
+		Compression::reduceKeys(keys, Lumix::lengthOf(keys), 0.001f, frames);
+		LUMIX_EXPECT(frames.size() == 1);
+		LUMIX_EXPECT(frames[0] == 0);
+
+		// linear up to the key 20 and then back
+		for (int i = 0; i < Lumix::lengthOf(keys); ++i)
+		{
+			float x = i <= 20 ? (float)i : (float)(40 - i);
+			keys[i].set(x, 0, 0);
+		}
+		Compression::reduceKeys(keys, Lumix::lengthOf(keys), 0.001f, frames);
+		LUMIX_EXPECT(frames.size() == 3);
+		LUMIX_EXPECT(frames[0] == 0);
+		LUMIX_EXPECT(frames[1] == 20);
+		LUMIX_EXPECT(frames[2] == Lumix::lengthOf(keys) - 1);
+
+		LUMIX_EXPECT(Compression::findKey(&frames[0], frames.size(), 0) == 0);
+		LUMIX_EXPECT(Compression::findKey(&frames[0], frames.size(), 19.5f) == 0);
+		LUMIX_EXPECT(Compression::findKey(&frames[0], frames.size(), 20) == 1);
+		LUMIX_EXPECT(Compression::findKey(&frames[0], frames.size(), 100) == 2);
+
+		Lumix::Quat rotations[30];
+		for (int i = 0; i < Lumix::lengthOf(rotations); ++i)
+		{
+			rotations[i] = Lumix::Quat(Lumix::Vec3(0, 1, 0), i * i * 0.001f);
+		}
+		Compression::reduceKeys(rotations, Lumix::lengthOf(rotations), 0.00001f, frames);
+		LUMIX_EXPECT(frames.size() > 2);
+		LUMIX_EXPECT(frames.size() < Lumix::lengthOf(rotations));
+		for (int i = 0; i < Lumix::lengthOf(rotations); ++i)
+		{
+			int key = Compression::findKey(&frames[0], frames.size(), (float)i);
+			if (key + 1 == frames.size()) continue;
+			Lumix::Quat interpolated;
+			float t = (i - frames[key]) / float(frames[key + 1] - frames[key]);
+			Lumix::nlerp(rotations[frames[key]], rotations[frames[key + 1]], &interpolated, t);
+			LUMIX_EXPECT(Compression::isClose(interpolated, rotations[i], 0.00001f));
+		}
+	}
+}
+
+REGISTER_TEST("unit_tests/engine/animation_compression/quat", UT_animation_compression_quat, "")
+REGISTER_TEST("unit_tests/engine/animation_compression/position",
+	UT_animation_compression_position,
+	"")
+REGISTER_TEST("unit_tests/engine/animation_compression/reduce_keys",
+	UT_animation_compression_reduce_keys,
+	"")
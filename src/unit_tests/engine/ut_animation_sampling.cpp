@@ -0,0 +1,162 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "animation/animation_sampling.h"
+#include "core/log.h"
+#include "core/math_utils.h"
+#include "core/quat.h"
+#include "core/string.h"
+#include "core/timer.h"
+#include "core/vec.h"
+
+
+namespace
+{
+	namespace Sampling = Lumix::AnimationSampling;
+	using Lumix::Math::randFloat;
+
+
+	const int BONE_COUNT = 61;
+	const int FRAME_COUNT = 2;
+
+
+	struct Keys
+	{
+		Lumix::Vec3 positions[FRAME_COUNT * BONE_COUNT];
+		Lumix::Quat rotations[FRAME_COUNT * BONE_COUNT];
+		float frames[FRAME_COUNT * ((BONE_COUNT + 3) & ~3) * Sampling::ROW_COUNT];
+	};
+
+
+	void initKeys(Keys& keys)
+	{
+		int stride = Sampling::getStride(BONE_COUNT);
+		int frame_size = Sampling::getFrameSize(BONE_COUNT);
+		Lumix::setMemory(keys.frames, 0, sizeof(keys.frames));
+		for (int frame = 0; frame < FRAME_COUNT; ++frame)
+		{
+			for (int i = 0; i < BONE_COUNT; ++i)
+			{
+				Lumix::Vec3& pos = keys.positions[frame * BONE_COUNT + i];
+				Lumix::Quat& rot = keys.rotations[frame * BONE_COUNT + i];
+				pos.set(randFloat(-10, 10), randFloat(-10, 10), randFloat(-10, 10));
+				Lumix::Vec3 axis(randFloat(-1, 1), randFloat(-1, 1), 1);
+				rot = Lumix::Quat(axis.normalized(), randFloat(-Lumix::Math::PI, Lumix::Math::PI));
+
+				float* rows = keys.frames + frame * frame_size;
+				rows[Sampling::POSITION_X * stride + i] = pos.x;
+				rows[Sampling::POSITION_Y * stride + i] = pos.y;
+				rows[Sampling::POSITION_Z * stride + i] = pos.z;
+				rows[Sampling::ROTATION_X * stride + i] = rot.x;
+				rows[Sampling::ROTATION_Y * stride + i] = rot.y;
+				rows[Sampling::ROTATION_Z * stride + i] = rot.z;
+				rows[Sampling::ROTATION_W * stride + i] = rot.w;
+			}
+		}
+	}
+
+
+	void UT_animation_sampling(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Keys* keys = LUMIX_NEW(allocator, Keys);
+		initKeys(*keys);
+		int stride = Sampling::getStride(BONE_COUNT);
+		const float* frame1 = keys->frames + Sampling::getFrameSize(BONE_COUNT);
+
+		float ts[] = {0, 0.25f, 0.5f, 0.9f, 1};
+		for (float t : ts)
+		{
+			for (int i = 0; i < BONE_COUNT; i += 4)
+			{
+				float sampled[Sampling::ROW_COUNT][4];
+				Sampling::sample4(keys->frames, frame1, stride, i, t, sampled);
+				for (int j = 0; j < 4; ++j)
+				{
+					if (i + j >= BONE_COUNT)
+					{
+						// padding
+						for (int row = 0; row < Sampling::ROW_COUNT; ++row)
+						{
+							LUMIX_EXPECT(sampled[row][j] == 0);
+						}
+						continue;
+					}
+					Lumix::Vec3 pos;
+					Lumix::Quat rot;
+					Lumix::lerp(keys->positions[i + j],
+						keys->positions[BONE_COUNT + i + j],
+						&pos,
+						t);
+					Lumix::nlerp(keys->rotations[i + j],
+						keys->rotations[BONE_COUNT + i + j],
+						&rot,
+						t);
+					LUMIX_EXPECT_CLOSE_EQ(pos.x, sampled[Sampling::POSITION_X][j], 0.001f);
+					LUMIX_EXPECT_CLOSE_EQ(pos.y, sampled[Sampling::POSITION_Y][j], 0.001f);
+					LUMIX_EXPECT_CLOSE_EQ(pos.z, sampled[Sampling::POSITION_Z][j], 0.001f);
+					LUMIX_EXPECT_CLOSE_EQ(rot.x, sampled[Sampling::ROTATION_X][j], 0.001f);
+					LUMIX_EXPECT_CLOSE_EQ(rot.y, sampled[Sampling::ROTATION_Y][j], 0.001f);
+					LUMIX_EXPECT_CLOSE_EQ(rot.z, sampled[Sampling::ROTATION_Z][j], 0.001f);
+					LUMIX_EXPECT_CLOSE_EQ(rot.w, sampled[Sampling::ROTATION_W][j], 0.001f);
+				}
+			}
+		}
+		LUMIX_DELETE(allocator, keys);
+	}
+
+
+	void UT_animation_sampling_benchmark(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Keys* keys = LUMIX_NEW(allocator, Keys);
+		initKeys(*keys);
+		int stride = Sampling::getStride(BONE_COUNT);
+		const float* frame1 = keys->frames + Sampling::getFrameSize(BONE_COUNT);
+		Lumix::Vec3 positions[BONE_COUNT];
+		Lumix::Quat rotations[BONE_COUNT];
+		const int PASSES = 100000;
+
+		Lumix::Timer* timer = Lumix::Timer::create(allocator);
+		for (int pass = 0; pass < PASSES; ++pass)
+		{
+			float t = (pass % 100) * 0.01f;
+			for (int i = 0; i < BONE_COUNT; ++i)
+			{
+				Lumix::lerp(keys->positions[i], keys->positions[BONE_COUNT + i], &positions[i], t);
+				Lumix::nlerp(keys->rotations[i], keys->rotations[BONE_COUNT + i], &rotations[i], t);
+			}
+		}
+		float scalar_time = timer->tick();
+
+		for (int pass = 0; pass < PASSES; ++pass)
+		{
+			float t = (pass % 100) * 0.01f;
+			for (int i = 0; i < BONE_COUNT; i += 4)
+			{
+				float sampled[Sampling::ROW_COUNT][4];
+				Sampling::sample4(keys->frames, frame1, stride, i, t, sampled);
+				for (int j = 0, c = Lumix::Math::minValue(4, BONE_COUNT - i); j < c; ++j)
+				{
+					positions[i + j].set(sampled[Sampling::POSITION_X][j],
+						sampled[Sampling::POSITION_Y][j],
+						sampled[Sampling::POSITION_Z][j]);
+					rotations[i + j].set(sampled[Sampling::ROTATION_X][j],
+						sampled[Sampling::ROTATION_Y][j],
+						sampled[Sampling::ROTATION_Z][j],
+						sampled[Sampling::ROTATION_W][j]);
+				}
+			}
+		}
+		float simd_time = timer->tick();
+		Lumix::Timer::destroy(timer);
+		LUMIX_EXPECT(positions[0].x == positions[0].x);
+
+		Lumix::g_log_info.log("unit") << "Animation sampling, AoS scalar: " << scalar_time
+									  << "s, SoA SSE: " << simd_time << "s";
+		LUMIX_DELETE(allocator, keys);
+	}
+}
+
+REGISTER_TEST("unit_tests/engine/animation_sampling", UT_animation_sampling, "")
+REGISTER_TEST("unit_tests/engine/animation_sampling/benchmark",
+	UT_animation_sampling_benchmark,
+	"")
@@ -0,0 +1,68 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "core/crc32.h"
+#include "core/MTJD/manager.h"
+#include "universe/hierarchy.h"
+#include "universe/universe.h"
+
+
+namespace
+{
+	void UT_hierarchy(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::MTJD::Manager* mtjd_manager = Lumix::MTJD::Manager::create(allocator);
+		Lumix::Universe universe(allocator);
+		Lumix::HierarchyPlugin plugin(*mtjd_manager, allocator);
+		Lumix::Hierarchy* hierarchy = Lumix::Hierarchy::create(plugin, universe, *mtjd_manager, allocator);
+		Lumix::uint32 hierarchy_hash = Lumix::crc32("hierarchy");
+
+		Lumix::Quat r(0, 0, 0, 1);
+		Lumix::Entity root = universe.createEntity(Lumix::Vec3(0, 0, 0), r);
+		Lumix::Entity child = universe.createEntity(Lumix::Vec3(1, 0, 0), r);
+		Lumix::Entity grandchild = universe.createEntity(Lumix::Vec3(2, 0, 0), r);
+		hierarchy->createComponent(hierarchy_hash, child);
+		hierarchy->createComponent(hierarchy_hash, grandchild);
+		hierarchy->setParent(child, root);
+		hierarchy->setParent(grandchild, child);
+
+		// children follow once per frame, no matter how many times the parent moved
+		universe.setPosition(root, Lumix::Vec3(5, 0, 0));
+		universe.setPosition(root, Lumix::Vec3(10, 0, 0));
+		LUMIX_EXPECT_CLOSE_EQ(universe.getPosition(grandchild).x, 2, 0.001f);
+		hierarchy->updateWorldMatrices();
+		LUMIX_EXPECT_CLOSE_EQ(universe.getPosition(child).x, 11, 0.001f);
+		LUMIX_EXPECT_CLOSE_EQ(universe.getPosition(grandchild).x, 12, 0.001f);
+
+		// moving a child changes its local matrix
+		universe.setPosition(child, Lumix::Vec3(13, 0, 0));
+		hierarchy->updateWorldMatrices();
+		LUMIX_EXPECT_CLOSE_EQ(universe.getPosition(grandchild).x, 14, 0.001f);
+		universe.setPosition(root, Lumix::Vec3(0, 0, 0));
+		hierarchy->updateWorldMatrices();
+		LUMIX_EXPECT_CLOSE_EQ(universe.getPosition(child).x, 3, 0.001f);
+		LUMIX_EXPECT_CLOSE_EQ(universe.getPosition(grandchild).x, 4, 0.001f);
+
+		// wide levels are split between jobs
+		static const int CHILD_COUNT = 1000;
+		Lumix::Entity children[CHILD_COUNT];
+		for (int i = 0; i < CHILD_COUNT; ++i)
+		{
+			children[i] = universe.createEntity(Lumix::Vec3(0, (float)i, 0), r);
+			hierarchy->createComponent(hierarchy_hash, children[i]);
+			hierarchy->setParent(children[i], root);
+		}
+		universe.setPosition(root, Lumix::Vec3(0, 0, 1));
+		hierarchy->updateWorldMatrices();
+		for (int i = 0; i < CHILD_COUNT; ++i)
+		{
+			LUMIX_EXPECT_CLOSE_EQ(universe.getPosition(children[i]).y, (float)i, 0.001f);
+			LUMIX_EXPECT_CLOSE_EQ(universe.getPosition(children[i]).z, 1, 0.001f);
+		}
+		LUMIX_EXPECT_CLOSE_EQ(universe.getPosition(grandchild).z, 1, 0.001f);
+
+		Lumix::Hierarchy::destroy(hierarchy);
+		Lumix::MTJD::Manager::destroy(*mtjd_manager);
+	}
+} // anonymous namespace
+
+REGISTER_TEST("unit_tests/engine/hierarchy", UT_hierarchy, "");
@@ -0,0 +1,192 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "core/crc32.h"
+#include "core/quat.h"
+#include "engine/iplugin.h"
+#include "engine/property_descriptor.h"
+#include "engine/replication.h"
+#include "universe/universe.h"
+
+
+namespace
+{
+
+
+const Lumix::uint32 SPEED_TYPE = Lumix::crc32("test_speed");
+
+
+class TestPlugin : public Lumix::IPlugin
+{
+public:
+	bool create() override { return true; }
+	void destroy() override {}
+	const char* getName() const override { return "test"; }
+};
+
+
+// one speed component per entity, the component index is the entity
+class TestScene : public Lumix::IScene
+{
+public:
+	TestScene(TestPlugin& plugin, Lumix::Universe& universe)
+		: m_plugin(plugin)
+		, m_universe(universe)
+	{
+		for (bool& has : m_has_speed) has = false;
+		universe.addScene(this);
+	}
+
+
+	Lumix::ComponentIndex createComponent(Lumix::uint32, Lumix::Entity entity) override
+	{
+		m_has_speed[entity] = true;
+		m_speed[entity] = 0;
+		return entity;
+	}
+
+
+	void destroyComponent(Lumix::ComponentIndex component, Lumix::uint32) override
+	{
+		m_has_speed[component] = false;
+	}
+
+
+	Lumix::ComponentIndex getComponent(Lumix::Entity entity, Lumix::uint32 type) override
+	{
+		return type == SPEED_TYPE && m_has_speed[entity] ? entity : Lumix::INVALID_COMPONENT;
+	}
+
+
+	void serialize(Lumix::OutputBlob&) override {}
+	void deserialize(Lumix::InputBlob&, int) override {}
+	Lumix::IPlugin& getPlugin() const override { return m_plugin; }
+	void update(float, bool) override {}
+	bool ownComponentType(Lumix::uint32 type) const override { return type == SPEED_TYPE; }
+	Lumix::Universe& getUniverse() override { return m_universe; }
+	float getSpeed(Lumix::ComponentIndex cmp) { return m_speed[cmp]; }
+	void setSpeed(Lumix::ComponentIndex cmp, float speed) { m_speed[cmp] = speed; }
+
+private:
+	TestPlugin& m_plugin;
+	Lumix::Universe& m_universe;
+	float m_speed[16];
+	bool m_has_speed[16];
+};
+
+
+struct LeftListener
+{
+	LeftListener()
+		: left_entity(Lumix::INVALID_ENTITY)
+	{
+	}
+
+
+	void onEntityLeft(Lumix::Entity entity) { left_entity = entity; }
+
+	Lumix::Entity left_entity;
+};
+
+
+void sendPacket(Lumix::ReplicationServer& server,
+	Lumix::ReplicationClient& client,
+	Lumix::OutputBlob& packet,
+	Lumix::OutputBlob& ack_blob,
+	bool ack)
+{
+	packet.clear();
+	server.writePacket(0, packet);
+	Lumix::InputBlob input(packet);
+	LUMIX_EXPECT(client.readPacket(input));
+	if (!ack) return;
+
+	ack_blob.clear();
+	client.writeAck(ack_blob);
+	Lumix::InputBlob ack_input(ack_blob);
+	server.readAck(0, ack_input);
+}
+
+
+void UT_replication(const char* params)
+{
+	Lumix::DefaultAllocator allocator;
+	TestPlugin plugin;
+	Lumix::Universe server_universe(allocator);
+	Lumix::Universe client_universe(allocator);
+	TestScene server_scene(plugin, server_universe);
+	TestScene client_scene(plugin, client_universe);
+
+	Lumix::DecimalPropertyDescriptor<TestScene> speed(
+		"speed", &TestScene::getSpeed, &TestScene::setSpeed, 0, 100, 1, allocator);
+	Lumix::ReplicationSchema schema(allocator);
+	LUMIX_EXPECT(schema.addProperty(SPEED_TYPE, &speed, 0, 100, 16));
+
+	Lumix::Quat rot(0, 0, 0, 1);
+	Lumix::Entity near_entity = server_universe.createEntity(Lumix::Vec3(1, 2, 3), rot);
+	Lumix::Entity far_entity = server_universe.createEntity(Lumix::Vec3(500, 0, 0), rot);
+	Lumix::Entity plain_entity = server_universe.createEntity(Lumix::Vec3(0, 0, 0), rot);
+	server_scene.createComponent(SPEED_TYPE, near_entity);
+	server_scene.createComponent(SPEED_TYPE, far_entity);
+	server_scene.setSpeed(near_entity, 25);
+	server_scene.setSpeed(far_entity, 50);
+
+	Lumix::ReplicationServer server(server_universe, schema, allocator);
+	Lumix::ReplicationClient client(client_universe, schema, allocator);
+	int client_idx = server.addClient();
+	LUMIX_EXPECT(client_idx == 0);
+	server.setClientView(client_idx, Lumix::Vec3(0, 0, 0), 100);
+
+	// the client universe is empty, replicated entities are created on it
+	Lumix::OutputBlob packet(allocator);
+	Lumix::OutputBlob ack(allocator);
+	server.update();
+	sendPacket(server, client, packet, ack, true);
+	LUMIX_EXPECT(client_universe.getEntityCount() == 1);
+	LUMIX_EXPECT(client_universe.hasEntity(0));
+	LUMIX_EXPECT(client_scene.getComponent(0, SPEED_TYPE) == 0);
+	LUMIX_EXPECT_CLOSE_EQ(client_scene.getSpeed(0), 25, 0.01f);
+	LUMIX_EXPECT_CLOSE_EQ(client_universe.getPosition(0).y, 2, 0.05f);
+	int full_size = packet.getSize();
+
+	// nothing changed, only the header is sent
+	server.update();
+	sendPacket(server, client, packet, ack, true);
+	LUMIX_EXPECT(packet.getSize() < full_size);
+	LUMIX_EXPECT(packet.getSize() <= 6);
+
+	// lost packets are resent as deltas against the last acknowledged snapshot
+	server_scene.setSpeed(near_entity, 75);
+	server_universe.setPosition(near_entity, Lumix::Vec3(10, 20, 30));
+	server.update();
+	sendPacket(server, client, packet, ack, false);
+	server.update();
+	sendPacket(server, client, packet, ack, true);
+	LUMIX_EXPECT_CLOSE_EQ(client_scene.getSpeed(0), 75, 0.01f);
+	LUMIX_EXPECT_CLOSE_EQ(client_universe.getPosition(0).z, 30, 0.05f);
+
+	// old packets are rejected
+	Lumix::InputBlob old_packet(packet);
+	LUMIX_EXPECT(!client.readPacket(old_packet));
+
+	// the far entity enters the view
+	server.setClientView(client_idx, Lumix::Vec3(0, 0, 0), 0);
+	server.update();
+	sendPacket(server, client, packet, ack, true);
+	LUMIX_EXPECT(client_universe.getEntityCount() == 2);
+	LUMIX_EXPECT_CLOSE_EQ(client_scene.getSpeed(1), 50, 0.01f);
+	LUMIX_EXPECT_CLOSE_EQ(client_universe.getPosition(1).x, 500, 0.05f);
+	LUMIX_EXPECT(server_universe.hasEntity(plain_entity));
+
+	// the near entity leaves the view
+	LeftListener listener;
+	client.entityLeft().bind<LeftListener, &LeftListener::onEntityLeft>(&listener);
+	server.setClientView(client_idx, Lumix::Vec3(500, 0, 0), 100);
+	server.update();
+	sendPacket(server, client, packet, ack, true);
+	LUMIX_EXPECT(listener.left_entity == 0);
+}
+
+
+} // anonymous namespace
+
+
+REGISTER_TEST("unit_tests/engine/replication", UT_replication, "")
@@ -0,0 +1,40 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "core/blob.h"
+#include "engine/engine.h"
+
+
+namespace
+{
+	void UT_scene_serialization_cache(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::SceneSerializationCache cache(allocator);
+		// only the pointers are used as keys
+		auto* scene_a = (Lumix::IScene*)&allocator;
+		auto* scene_b = (Lumix::IScene*)&cache;
+
+		auto& chunk_a = cache.getChunk(scene_a);
+		LUMIX_EXPECT(chunk_a.scene == scene_a);
+		LUMIX_EXPECT(chunk_a.is_dirty);
+		chunk_a.blob->write(1);
+		chunk_a.is_dirty = false;
+		cache.getChunk(scene_b).is_dirty = false;
+
+		LUMIX_EXPECT(!cache.getChunk(scene_a).is_dirty);
+		LUMIX_EXPECT(cache.getChunk(scene_a).blob->getSize() == sizeof(int));
+
+		cache.markDirty(scene_b);
+		LUMIX_EXPECT(!cache.getChunk(scene_a).is_dirty);
+		LUMIX_EXPECT(cache.getChunk(scene_b).is_dirty);
+		cache.getChunk(scene_b).is_dirty = false;
+
+		cache.markAllDirty();
+		LUMIX_EXPECT(cache.getChunk(scene_a).is_dirty);
+		LUMIX_EXPECT(cache.getChunk(scene_b).is_dirty);
+
+		cache.clear();
+		LUMIX_EXPECT(cache.getChunk(scene_a).blob->getSize() == 0);
+	}
+}
+
+REGISTER_TEST("unit_tests/engine/scene_serialization_cache", UT_scene_serialization_cache, "")
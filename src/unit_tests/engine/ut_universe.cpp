@@ -1,4 +1,5 @@
 #include "unit_tests/suite/lumix_unit_tests.h"
+#include "core/matrix.h"
 #include "universe/universe.h"
 
 
@@ -94,6 +95,200 @@ namespace
 			LUMIX_EXPECT(universe.getEntityCount() == 4 - i);
 		}
 	}
+
+	struct TransformListener
+	{
+		void onEntitiesMoved(const Lumix::Entity* entities, int count)
+		{
+			++calls;
+			for (int i = 0; i < count; ++i) moved.push(entities[i]);
+		}
+
+		explicit TransformListener(Lumix::IAllocator& allocator)
+			: moved(allocator)
+			, calls(0)
+		{
+		}
+
+		Lumix::Array<Lumix::Entity> moved;
+		int calls;
+	};
+
+
+	void UT_universe_transform_changes(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::Universe universe(allocator);
+		TransformListener listener(allocator);
+		universe.entitiesTransformed().bind<TransformListener, &TransformListener::onEntitiesMoved>(&listener);
+
+		Lumix::Vec3 p(0, 0, 0);
+		Lumix::Quat r(0, 0, 0, 1);
+		Lumix::Entity a = universe.createEntity(p, r);
+		Lumix::Entity b = universe.createEntity(p, r);
+		Lumix::Entity c = universe.createEntity(p, r);
+
+		universe.notifyTransformChanges();
+		LUMIX_EXPECT(listener.calls == 0);
+
+		universe.setPosition(a, 1, 2, 3);
+		universe.setRotation(a, r);
+		universe.setPositionAndRotation(b, p, r);
+		universe.setScale(c, 2);
+		universe.destroyEntity(c);
+		universe.notifyTransformChanges();
+		LUMIX_EXPECT(listener.calls == 1);
+		LUMIX_EXPECT(listener.moved.size() == 2);
+		LUMIX_EXPECT(listener.moved.indexOf(a) >= 0);
+		LUMIX_EXPECT(listener.moved.indexOf(b) >= 0);
+
+		listener.moved.clear();
+		universe.notifyTransformChanges();
+		LUMIX_EXPECT(listener.calls == 1);
+
+		universe.setPosition(b, 1, 1, 1);
+		universe.notifyTransformChanges();
+		LUMIX_EXPECT(listener.calls == 2);
+		LUMIX_EXPECT(listener.moved.size() == 1);
+		LUMIX_EXPECT(listener.moved[0] == b);
+
+		universe.entitiesTransformed().unbind<TransformListener, &TransformListener::onEntitiesMoved>(&listener);
+	}
+
+
+	void UT_universe_bulk_transforms(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::Universe universe(allocator);
+		TransformListener listener(allocator);
+		universe.entitiesTransformed().bind<TransformListener, &TransformListener::onEntitiesMoved>(&listener);
+
+		static const int ENTITY_COUNT = 4;
+		Lumix::Entity entities[ENTITY_COUNT];
+		Lumix::Vec3 positions[ENTITY_COUNT];
+		Lumix::Quat rotations[ENTITY_COUNT];
+		for (int i = 0; i < ENTITY_COUNT; ++i)
+		{
+			entities[i] = universe.createEntity(Lumix::Vec3(0, 0, 0), Lumix::Quat(0, 0, 0, 1));
+			positions[i].set(float(i), float(i * 2), float(i * 3));
+			rotations[i].set(0, 0, 0, 1);
+		}
+		universe.destroyEntity(entities[1]);
+		entities[1] = universe.createEntity(Lumix::Vec3(0, 0, 0), Lumix::Quat(0, 0, 0, 1));
+
+		universe.setPositionsAndRotations(entities, positions, rotations, ENTITY_COUNT);
+		Lumix::Vec3 result[ENTITY_COUNT];
+		universe.getPositions(entities, result, ENTITY_COUNT);
+		Lumix::Matrix matrices[ENTITY_COUNT];
+		universe.getMatrices(entities, matrices, ENTITY_COUNT);
+		for (int i = 0; i < ENTITY_COUNT; ++i)
+		{
+			LUMIX_EXPECT_CLOSE_EQ(result[i].y, positions[i].y, 0.00001f);
+			LUMIX_EXPECT_CLOSE_EQ(universe.getPosition(entities[i]).z, positions[i].z, 0.00001f);
+			LUMIX_EXPECT_CLOSE_EQ(matrices[i].getTranslation().x, positions[i].x, 0.00001f);
+		}
+
+		universe.setPositions(entities, positions, 2);
+		universe.notifyTransformChanges();
+		LUMIX_EXPECT(listener.calls == 1);
+		LUMIX_EXPECT(listener.moved.size() == ENTITY_COUNT);
+
+		universe.entitiesTransformed().unbind<TransformListener, &TransformListener::onEntitiesMoved>(&listener);
+	}
+
+
+	void UT_universe_entity_handles(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::Universe universe(allocator);
+		Lumix::Vec3 p(0, 0, 0);
+		Lumix::Quat r(0, 0, 0, 1);
+
+		Lumix::Entity e = universe.createEntity(p, r);
+		Lumix::EntityHandle handle = universe.getHandle(e);
+		LUMIX_EXPECT(universe.isValid(handle));
+		universe.destroyEntity(e);
+		LUMIX_EXPECT(!universe.isValid(handle));
+
+		// the slot is reused, the old handle must not match the new entity
+		Lumix::Entity reused = universe.createEntity(p, r);
+		LUMIX_EXPECT(reused == e);
+		LUMIX_EXPECT(!universe.isValid(handle));
+		LUMIX_EXPECT(universe.isValid(universe.getHandle(reused)));
+
+		Lumix::EntityMap map(allocator);
+		LUMIX_EXPECT(map.get(reused) == Lumix::INVALID_COMPONENT);
+		LUMIX_EXPECT(map.get(-1) == Lumix::INVALID_COMPONENT);
+		map.insert(100, 3);
+		map.insert(reused, 7);
+		LUMIX_EXPECT(map.get(100) == 3);
+		LUMIX_EXPECT(map.get(reused) == 7);
+		LUMIX_EXPECT(map.get(99) == Lumix::INVALID_COMPONENT);
+		LUMIX_EXPECT(map.get(101) == Lumix::INVALID_COMPONENT);
+		map.erase(100);
+		LUMIX_EXPECT(map.get(100) == Lumix::INVALID_COMPONENT);
+		LUMIX_EXPECT(map.get(reused) == 7);
+		map.clear();
+		LUMIX_EXPECT(map.get(reused) == Lumix::INVALID_COMPONENT);
+	}
+
+
+	void UT_universe_bulk_create_destroy(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::Universe universe(allocator);
+		TransformListener created(allocator);
+		TransformListener destroyed(allocator);
+		universe.entitiesCreated().bind<TransformListener, &TransformListener::onEntitiesMoved>(&created);
+		universe.entitiesDestroyed().bind<TransformListener, &TransformListener::onEntitiesMoved>(&destroyed);
+
+		static const int ENTITY_COUNT = 100;
+		Lumix::Vec3 positions[ENTITY_COUNT];
+		Lumix::Quat rotations[ENTITY_COUNT];
+		for (int i = 0; i < ENTITY_COUNT; ++i)
+		{
+			positions[i].set((float)i, 0, 0);
+			rotations[i].set(0, 0, 0, 1);
+		}
+		Lumix::Entity entities[ENTITY_COUNT];
+		universe.createEntities(entities, positions, rotations, ENTITY_COUNT);
+		LUMIX_EXPECT(universe.getEntityCount() == ENTITY_COUNT);
+		LUMIX_EXPECT(created.calls == 1);
+		LUMIX_EXPECT(created.moved.size() == ENTITY_COUNT);
+		for (int i = 0; i < ENTITY_COUNT; ++i)
+		{
+			LUMIX_EXPECT(universe.hasEntity(entities[i]));
+			LUMIX_EXPECT_CLOSE_EQ(universe.getPosition(entities[i]).x, (float)i, 0.001f);
+		}
+
+		// destroyed entities are removed from pending transform changes
+		universe.setPosition(entities[0], Lumix::Vec3(1, 1, 1));
+		universe.setPosition(entities[1], Lumix::Vec3(1, 1, 1));
+		universe.destroyEntities(entities, ENTITY_COUNT / 2);
+		LUMIX_EXPECT(universe.getEntityCount() == ENTITY_COUNT / 2);
+		LUMIX_EXPECT(destroyed.calls == 1);
+		LUMIX_EXPECT(destroyed.moved.size() == ENTITY_COUNT / 2);
+		LUMIX_EXPECT(!universe.hasEntity(entities[0]));
+		LUMIX_EXPECT(universe.hasEntity(entities[ENTITY_COUNT - 1]));
+		LUMIX_EXPECT_CLOSE_EQ(universe.getPosition(entities[ENTITY_COUNT - 1]).x, ENTITY_COUNT - 1, 0.001f);
+
+		TransformListener moved(allocator);
+		universe.entitiesTransformed().bind<TransformListener, &TransformListener::onEntitiesMoved>(&moved);
+		universe.notifyTransformChanges();
+		LUMIX_EXPECT(moved.calls == 0);
+
+		// single entity functions are reported as batches of one
+		universe.createEntity(positions[0], rotations[0]);
+		LUMIX_EXPECT(created.calls == 2);
+
+		universe.entitiesTransformed().unbind<TransformListener, &TransformListener::onEntitiesMoved>(&moved);
+		universe.entitiesCreated().unbind<TransformListener, &TransformListener::onEntitiesMoved>(&created);
+		universe.entitiesDestroyed().unbind<TransformListener, &TransformListener::onEntitiesMoved>(&destroyed);
+	}
 } // anonymous namespace
 
 REGISTER_TEST("unit_tests/engine/universe", UT_universe, "");
+REGISTER_TEST("unit_tests/engine/universe_transform_changes", UT_universe_transform_changes, "");
+REGISTER_TEST("unit_tests/engine/universe_bulk_transforms", UT_universe_bulk_transforms, "");
+REGISTER_TEST("unit_tests/engine/universe_entity_handles", UT_universe_entity_handles, "");
+REGISTER_TEST("unit_tests/engine/universe_bulk_create_destroy", UT_universe_bulk_create_destroy, "");
@@ -1,5 +1,6 @@
 #include "unit_tests/suite/lumix_unit_tests.h"
 
+#include "core/aabb.h"
 #include "core/sphere.h"
 #include "core/vec.h"
 #include "core/frustum.h"
@@ -135,7 +136,366 @@ namespace
 
 		Lumix::CullingSystem::destroy(*culling_system);
 	}
+
+	void markVisible(Lumix::CullingSystem& culling_system, Lumix::Array<bool>& visible)
+	{
+		for (int i = 0; i < visible.size(); ++i)
+		{
+			visible[i] = false;
+		}
+		const Lumix::CullingSystem::Results& result = culling_system.getResult();
+		for (int i = 0; i < result.size(); i++)
+		{
+			const Lumix::CullingSystem::Subresults& subresult = result[i];
+			for (int j = 0; j < subresult.size(); ++j)
+			{
+				LUMIX_EXPECT(!visible[subresult[j]]);
+				visible[subresult[j]] = true;
+			}
+		}
+	}
+
+	void expectSameVisibility(Lumix::CullingSystem& culling_system,
+		const Lumix::Frustum& frustum,
+		Lumix::Array<bool>& linear,
+		Lumix::Array<bool>& octree)
+	{
+		culling_system.enableOctree(false);
+		culling_system.cullToFrustum(frustum, 1);
+		markVisible(culling_system, linear);
+
+		culling_system.enableOctree(true);
+		culling_system.cullToFrustum(frustum, 1);
+		markVisible(culling_system, octree);
+
+		for (int i = 0; i < linear.size(); ++i)
+		{
+			LUMIX_EXPECT(linear[i] == octree[i]);
+		}
+	}
+
+	void UT_culling_system_octree(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::Array<Lumix::Sphere> spheres(allocator);
+		Lumix::Array<Lumix::ComponentIndex> renderables(allocator);
+		int renderable = 0;
+		for (float x = -200.f; x < 200.f; x += 7.f)
+		{
+			for (float z = -200.f; z < 200.f; z += 7.f)
+			{
+				spheres.push(Lumix::Sphere(x, 0.f, z, 0.5f + (renderable % 7)));
+				renderables.push(renderable);
+				++renderable;
+			}
+		}
+		spheres.push(Lumix::Sphere(0.f, 0.f, -50.f, 10000.f));
+		renderables.push(renderable);
+		++renderable;
+
+		Lumix::Frustum clipping_frustum;
+		clipping_frustum.computePerspective(
+			test_frustum.pos,
+			test_frustum.dir,
+			test_frustum.up,
+			Lumix::Math::degreesToRadians(test_frustum.fov),
+			test_frustum.ratio,
+			test_frustum.near,
+			test_frustum.far);
+
+		Lumix::Array<bool> linear(allocator);
+		Lumix::Array<bool> octree(allocator);
+		linear.resize(renderable);
+		octree.resize(renderable);
+
+		Lumix::MTJD::Manager* mtjd_manager = Lumix::MTJD::Manager::create(allocator);
+		Lumix::CullingSystem* culling_system = Lumix::CullingSystem::create(*mtjd_manager, allocator);
+		culling_system->enableOctree(true);
+		culling_system->insert(spheres, renderables);
+		expectSameVisibility(*culling_system, clipping_frustum, linear, octree);
+
+		for (int i = 0; i < renderable; i += 3)
+		{
+			culling_system->updateBoundingPosition(Lumix::Vec3(spheres[i].m_position.z, 0.f, -spheres[i].m_position.x), i);
+		}
+		for (int i = 1; i < renderable; i += 5)
+		{
+			culling_system->updateBoundingRadius(20.f, i);
+		}
+		for (int i = 2; i < renderable; i += 4)
+		{
+			culling_system->removeStatic(i);
+		}
+		expectSameVisibility(*culling_system, clipping_frustum, linear, octree);
+
+		Lumix::CullingSystem::destroy(*culling_system);
+		Lumix::MTJD::Manager::destroy(*mtjd_manager);
+	}
+
+	void UT_culling_system_multiple_frustums(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::Array<Lumix::Sphere> spheres(allocator);
+		Lumix::Array<Lumix::ComponentIndex> renderables(allocator);
+		int renderable = 0;
+		for (float x = -300.f; x < 300.f; x += 5.f)
+		{
+			for (float z = -300.f; z < 300.f; z += 5.f)
+			{
+				spheres.push(Lumix::Sphere(x, 0.f, z, 1.f));
+				renderables.push(renderable);
+				++renderable;
+			}
+		}
+
+		Lumix::Vec3 directions[] = { { 0.f, 0.f, -1.f }, { 1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f } };
+		Lumix::Frustum frustums[3];
+		for (int i = 0; i < Lumix::lengthOf(frustums); ++i)
+		{
+			frustums[i].computePerspective(test_frustum.pos,
+				directions[i],
+				test_frustum.up,
+				Lumix::Math::degreesToRadians(test_frustum.fov),
+				test_frustum.ratio,
+				test_frustum.near,
+				test_frustum.far);
+		}
+
+		Lumix::Array<bool> single(allocator);
+		Lumix::Array<bool> multiple(allocator);
+		single.resize(renderable);
+		multiple.resize(renderable);
+
+		Lumix::MTJD::Manager* mtjd_manager = Lumix::MTJD::Manager::create(allocator);
+		Lumix::CullingSystem* culling_system = Lumix::CullingSystem::create(*mtjd_manager, allocator);
+		culling_system->insert(spheres, renderables);
+
+		Lumix::Array<Lumix::CullingSystem::Results> results(allocator);
+		for (int i = 0; i < Lumix::lengthOf(frustums); ++i)
+		{
+			results.emplace(allocator);
+		}
+		culling_system->cullToFrustums(frustums, Lumix::lengthOf(frustums), 1, &results[0]);
+
+		for (int i = 0; i < Lumix::lengthOf(frustums); ++i)
+		{
+			culling_system->cullToFrustum(frustums[i], 1);
+			markVisible(*culling_system, single);
+
+			for (int j = 0; j < multiple.size(); ++j)
+			{
+				multiple[j] = false;
+			}
+			for (auto& subresult : results[i])
+			{
+				for (int j = 0; j < subresult.size(); ++j)
+				{
+					LUMIX_EXPECT(!multiple[subresult[j]]);
+					multiple[subresult[j]] = true;
+				}
+			}
+
+			for (int j = 0; j < single.size(); ++j)
+			{
+				LUMIX_EXPECT(single[j] == multiple[j]);
+			}
+		}
+
+		Lumix::CullingSystem::destroy(*culling_system);
+		Lumix::MTJD::Manager::destroy(*mtjd_manager);
+	}
+
+	void UT_culling_system_cached_result(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::Array<Lumix::Sphere> spheres(allocator);
+		Lumix::Array<Lumix::ComponentIndex> renderables(allocator);
+		int renderable = 0;
+		for (float x = -200.f; x < 200.f; x += 4.f)
+		{
+			spheres.push(Lumix::Sphere(x, 0.f, 50.f, 1.f));
+			renderables.push(renderable);
+			++renderable;
+		}
+
+		Lumix::Frustum clipping_frustum;
+		clipping_frustum.computePerspective(
+			test_frustum.pos,
+			test_frustum.dir,
+			test_frustum.up,
+			Lumix::Math::degreesToRadians(test_frustum.fov),
+			test_frustum.ratio,
+			test_frustum.near,
+			test_frustum.far);
+
+		Lumix::Array<bool> visible(allocator);
+		visible.resize(renderable);
+
+		Lumix::MTJD::Manager* mtjd_manager = Lumix::MTJD::Manager::create(allocator);
+		Lumix::CullingSystem* culling_system = Lumix::CullingSystem::create(*mtjd_manager, allocator);
+		culling_system->insert(spheres, renderables);
+
+		culling_system->cullToFrustum(clipping_frustum, 1);
+		markVisible(*culling_system, visible);
+		LUMIX_EXPECT(visible[renderable / 2]);
+		LUMIX_EXPECT(!visible[0]);
+
+		culling_system->updateBoundingPosition(Lumix::Vec3(0.f, 0.f, 500.f), renderable / 2);
+		culling_system->updateBoundingPosition(Lumix::Vec3(0.f, 0.f, 50.f), 0);
+		culling_system->cullToFrustum(clipping_frustum, 1);
+		markVisible(*culling_system, visible);
+		LUMIX_EXPECT(!visible[renderable / 2]);
+		LUMIX_EXPECT(visible[0]);
+
+		culling_system->setLayerMask(0, 2);
+		culling_system->cullToFrustumAsync(clipping_frustum, 1);
+		markVisible(*culling_system, visible);
+		LUMIX_EXPECT(!visible[0]);
+
+		Lumix::CullingSystem::destroy(*culling_system);
+		Lumix::MTJD::Manager::destroy(*mtjd_manager);
+	}
+
+	void UT_culling_system_sphere(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::Array<Lumix::Sphere> spheres(allocator);
+		Lumix::Array<Lumix::ComponentIndex> renderables(allocator);
+		int renderable = 0;
+		for (float x = -200.f; x < 200.f; x += 7.f)
+		{
+			for (float z = -200.f; z < 200.f; z += 7.f)
+			{
+				spheres.push(Lumix::Sphere(x, 0.f, z, 0.5f + (renderable % 7)));
+				renderables.push(renderable);
+				++renderable;
+			}
+		}
+
+		Lumix::MTJD::Manager* mtjd_manager = Lumix::MTJD::Manager::create(allocator);
+		Lumix::CullingSystem* culling_system = Lumix::CullingSystem::create(*mtjd_manager, allocator);
+		culling_system->insert(spheres, renderables);
+		culling_system->setLayerMask(0, 2);
+
+		Lumix::Sphere query(10.f, 0.f, -20.f, 30.f);
+		Lumix::Array<bool> expected(allocator);
+		expected.resize(renderable);
+		for (int i = 0; i < renderable; ++i)
+		{
+			float radius = spheres[i].m_radius + query.m_radius;
+			expected[i] = i != 0 && (spheres[i].m_position - query.m_position).squaredLength() < radius * radius;
+		}
+
+		Lumix::CullingSystem::Subresults results(allocator);
+		Lumix::Array<bool> found(allocator);
+		found.resize(renderable);
+		for (int octree = 0; octree < 2; ++octree)
+		{
+			culling_system->enableOctree(octree != 0);
+			results.clear();
+			culling_system->cullToSphere(query, 1, results);
+
+			for (int i = 0; i < renderable; ++i)
+			{
+				found[i] = false;
+			}
+			for (int i : results)
+			{
+				LUMIX_EXPECT(!found[i]);
+				found[i] = true;
+			}
+			for (int i = 0; i < renderable; ++i)
+			{
+				LUMIX_EXPECT(found[i] == expected[i]);
+			}
+		}
+
+		LUMIX_EXPECT(culling_system->isAdded(1));
+		culling_system->removeStatic(1);
+		LUMIX_EXPECT(!culling_system->isAdded(1));
+		LUMIX_EXPECT(!culling_system->isAdded(renderable));
+
+		Lumix::CullingSystem::destroy(*culling_system);
+		Lumix::MTJD::Manager::destroy(*mtjd_manager);
+	}
+
+	void UT_culling_system_layers_and_aabbs(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::Frustum clipping_frustum;
+		clipping_frustum.computePerspective(
+			test_frustum.pos,
+			test_frustum.dir,
+			test_frustum.up,
+			Lumix::Math::degreesToRadians(test_frustum.fov),
+			test_frustum.ratio,
+			test_frustum.near,
+			test_frustum.far);
+
+		Lumix::MTJD::Manager* mtjd_manager = Lumix::MTJD::Manager::create(allocator);
+		Lumix::CullingSystem* culling_system = Lumix::CullingSystem::create(*mtjd_manager, allocator);
+		// a wall below the frustum, only its loose bounding sphere reaches into it
+		culling_system->addStatic(0, Lumix::Sphere(0.f, -40.f, 50.f, 40.f));
+		culling_system->setAABB(0,
+			Lumix::AABB(Lumix::Vec3(-40.f, -41.f, 49.f), Lumix::Vec3(40.f, -39.f, 51.f)));
+		culling_system->addStatic(1, Lumix::Sphere(0.f, 0.f, 50.f, 1.f));
+		culling_system->addStatic(2, Lumix::Sphere(5.f, 0.f, 50.f, 1.f));
+		culling_system->setLayerMask(2, 2);
+
+		Lumix::Array<bool> visible(allocator);
+		visible.resize(3);
+		for (int octree = 0; octree < 2; ++octree)
+		{
+			culling_system->enableOctree(octree != 0);
+
+			culling_system->enableAABBTest(false);
+			culling_system->cullToFrustum(clipping_frustum, 1);
+			markVisible(*culling_system, visible);
+			LUMIX_EXPECT(visible[0] && visible[1] && !visible[2]);
+
+			culling_system->enableAABBTest(true);
+			culling_system->cullToFrustum(clipping_frustum, 1);
+			markVisible(*culling_system, visible);
+			LUMIX_EXPECT(!visible[0] && visible[1] && !visible[2]);
+
+			culling_system->cullToFrustum(clipping_frustum, 2);
+			markVisible(*culling_system, visible);
+			LUMIX_EXPECT(!visible[0] && !visible[1] && visible[2]);
+
+			// the AABB moves with the sphere into the frustum
+			culling_system->cullToFrustum(clipping_frustum, 1);
+			culling_system->updateBoundingPosition(Lumix::Vec3(0.f, 0.f, 50.f), 0);
+			culling_system->cullToFrustum(clipping_frustum, 1);
+			markVisible(*culling_system, visible);
+			LUMIX_EXPECT(visible[0] && visible[1] && !visible[2]);
+			culling_system->updateBoundingPosition(Lumix::Vec3(0.f, -40.f, 50.f), 0);
+
+			// cached result follows the bucket changes
+			culling_system->cullToFrustum(clipping_frustum, 1);
+			culling_system->setLayerMask(1, 2);
+			culling_system->setLayerMask(2, 1);
+			culling_system->cullToFrustum(clipping_frustum, 1);
+			markVisible(*culling_system, visible);
+			LUMIX_EXPECT(!visible[0] && !visible[1] && visible[2]);
+			LUMIX_EXPECT(culling_system->getLayerMask(1) == 2);
+			culling_system->setLayerMask(1, 1);
+			culling_system->setLayerMask(2, 2);
+		}
+
+		LUMIX_EXPECT(culling_system->getSphere(2).m_position.x == 5.f);
+		culling_system->removeStatic(1);
+		LUMIX_EXPECT(!culling_system->isAdded(1));
+		LUMIX_EXPECT(culling_system->getSphere(2).m_position.x == 5.f);
+
+		Lumix::CullingSystem::destroy(*culling_system);
+		Lumix::MTJD::Manager::destroy(*mtjd_manager);
+	}
 }
 
 REGISTER_TEST("unit_tests/graphics/culling_system", UT_culling_system, "");
 REGISTER_TEST("unit_tests/graphics/culling_system_async", UT_culling_system_async, "");
+REGISTER_TEST("unit_tests/graphics/culling_system_octree", UT_culling_system_octree, "");
+REGISTER_TEST("unit_tests/graphics/culling_system_multiple_frustums", UT_culling_system_multiple_frustums, "");
+REGISTER_TEST("unit_tests/graphics/culling_system_cached_result", UT_culling_system_cached_result, "");
+REGISTER_TEST("unit_tests/graphics/culling_system_sphere", UT_culling_system_sphere, "");
+REGISTER_TEST("unit_tests/graphics/culling_system_layers_and_aabbs", UT_culling_system_layers_and_aabbs, "");
@@ -0,0 +1,70 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "core/aabb.h"
+#include "core/matrix.h"
+#include "core/vec.h"
+
+#include "renderer/depth_pyramid.h"
+
+namespace
+{
+	const int WIDTH = 200;
+	const int HEIGHT = 100;
+
+
+	void UT_depth_pyramid(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::DepthPyramid pyramid(allocator);
+
+		Lumix::Matrix projection;
+		projection.setPerspective(Lumix::Math::degreesToRadians(60.f), 2.f, 0.1f, 1000.f);
+
+		// a wall 10 units in front of the camera covers the left half of the frame
+		static float depth[WIDTH * HEIGHT];
+		for (int y = 0; y < HEIGHT; ++y)
+		{
+			for (int x = 0; x < WIDTH; ++x)
+			{
+				depth[y * WIDTH + x] = x < WIDTH / 2 ? 1 / 10.f : 0;
+			}
+		}
+
+		Lumix::AABB box(Lumix::Vec3(-1, -1, -1), Lumix::Vec3(1, 1, 1));
+		Lumix::Matrix behind_wall = Lumix::Matrix::IDENTITY;
+		behind_wall.setTranslation(Lumix::Vec3(-20, 0, -30));
+		Lumix::Matrix in_front_of_wall = Lumix::Matrix::IDENTITY;
+		in_front_of_wall.setTranslation(Lumix::Vec3(-3, 0, -5));
+		Lumix::Matrix beside_wall = Lumix::Matrix::IDENTITY;
+		beside_wall.setTranslation(Lumix::Vec3(20, 0, -30));
+		Lumix::Matrix across_edge = Lumix::Matrix::IDENTITY;
+		across_edge.setTranslation(Lumix::Vec3(0, 0, -30));
+		Lumix::Matrix around_camera = Lumix::Matrix::IDENTITY;
+
+		LUMIX_EXPECT(!pyramid.isReady());
+		LUMIX_EXPECT(pyramid.isVisible(box, behind_wall));
+
+		pyramid.build(depth, WIDTH, HEIGHT, projection);
+		LUMIX_EXPECT(pyramid.isReady());
+		// 200x100, 100x50, 50x25, 25x13, 13x7, 7x4, 4x2, 2x1, 1x1
+		LUMIX_EXPECT(pyramid.getLevelCount() == 9);
+
+		LUMIX_EXPECT(!pyramid.isVisible(box, behind_wall));
+		LUMIX_EXPECT(pyramid.isVisible(box, in_front_of_wall));
+		LUMIX_EXPECT(pyramid.isVisible(box, beside_wall));
+		LUMIX_EXPECT(pyramid.isVisible(box, across_edge));
+		LUMIX_EXPECT(pyramid.isVisible(box, around_camera));
+
+		// big objects are tested on coarse levels, which keep the farthest depth
+		Lumix::AABB big_box(Lumix::Vec3(-15, -5, -1), Lumix::Vec3(15, 5, 1));
+		Lumix::Matrix big_behind_wall = Lumix::Matrix::IDENTITY;
+		big_behind_wall.setTranslation(Lumix::Vec3(-30, 0, -60));
+		LUMIX_EXPECT(!pyramid.isVisible(big_box, big_behind_wall));
+		LUMIX_EXPECT(pyramid.isVisible(big_box, across_edge));
+
+		pyramid.clear();
+		LUMIX_EXPECT(pyramid.isVisible(box, behind_wall));
+	}
+}
+
+REGISTER_TEST("unit_tests/graphics/depth_pyramid", UT_depth_pyramid, "");
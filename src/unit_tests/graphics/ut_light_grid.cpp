@@ -0,0 +1,74 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "core/matrix.h"
+#include "core/vec.h"
+
+#include "core/MTJD/manager.h"
+
+#include "renderer/light_grid.h"
+
+namespace
+{
+	bool hasLight(const Lumix::LightGrid& grid, int cluster_index, int light)
+	{
+		const Lumix::LightGrid::Cluster& cluster = grid.getCluster(cluster_index);
+		const Lumix::uint16* indices = grid.getLightIndices();
+		for (int i = 0; i < cluster.count; ++i)
+		{
+			if (indices[cluster.offset + i] == light) return true;
+		}
+		return false;
+	}
+
+
+	void UT_light_grid(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::MTJD::Manager* mtjd_manager = Lumix::MTJD::Manager::create(allocator);
+		Lumix::LightGrid grid(allocator);
+
+		// camera looks down -z, first light is in the center 10 units in front of it,
+		// second is on the left side 100 units further
+		Lumix::LightGrid::Light lights[] = {
+			{ { 0.f, 0.f, -10.f }, 2.f }, { { -40.f, 0.f, -100.f }, 5.f }, { { 0.f, 0.f, 10.f }, 2.f } };
+		grid.build(*mtjd_manager,
+			Lumix::Matrix::IDENTITY,
+			Lumix::Math::degreesToRadians(60.f),
+			2.f,
+			0.1f,
+			1000.f,
+			lights,
+			Lumix::lengthOf(lights));
+		LUMIX_EXPECT(grid.getLightCount() == 3);
+
+		int center = grid.getClusterIndex(Lumix::Vec3(0, 0, -10));
+		int near_center = grid.getClusterIndex(Lumix::Vec3(0.5f, 0.5f, -9));
+		int left = grid.getClusterIndex(Lumix::Vec3(-40, 0, -100));
+		int far_center = grid.getClusterIndex(Lumix::Vec3(0, 0, -500));
+		LUMIX_EXPECT(center >= 0);
+		LUMIX_EXPECT(near_center >= 0);
+		LUMIX_EXPECT(left >= 0);
+		LUMIX_EXPECT(far_center >= 0);
+		LUMIX_EXPECT(grid.getClusterIndex(Lumix::Vec3(0, 0, 10)) == -1);
+
+		LUMIX_EXPECT(hasLight(grid, center, 0));
+		LUMIX_EXPECT(hasLight(grid, near_center, 0));
+		LUMIX_EXPECT(!hasLight(grid, center, 1));
+		LUMIX_EXPECT(hasLight(grid, left, 1));
+		LUMIX_EXPECT(!hasLight(grid, left, 0));
+		LUMIX_EXPECT(!hasLight(grid, far_center, 0));
+		LUMIX_EXPECT(!hasLight(grid, far_center, 1));
+		for (int i = 0; i < Lumix::LightGrid::CLUSTER_COUNT; ++i)
+		{
+			LUMIX_EXPECT(!hasLight(grid, i, 2));
+		}
+
+		grid.build(*mtjd_manager, Lumix::Matrix::IDENTITY, 1.f, 2.f, 0.1f, 1000.f, nullptr, 0);
+		LUMIX_EXPECT(grid.getLightIndicesCount() == 0);
+		LUMIX_EXPECT(grid.getCluster(center).count == 0);
+
+		Lumix::MTJD::Manager::destroy(*mtjd_manager);
+	}
+}
+
+REGISTER_TEST("unit_tests/graphics/light_grid", UT_light_grid, "");
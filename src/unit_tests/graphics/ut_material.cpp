@@ -0,0 +1,64 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "core/blob.h"
+#include "core/path.h"
+#include "core/string.h"
+#include "renderer/material.h"
+
+namespace
+{
+
+	const char material_source[] = "{ \"shader\" : \"shaders/rigid.shd\", \"alpha_ref\" : 0.5, "
+		"\"texture\" : { \"source\" : \"albedo.tga\", \"u_clamp\" : true }, "
+		"\"texture\" : { \"source\" : \"/textures/normal.tga\", \"keep_data\" : true }, "
+		"\"defines\" : [\"ALPHA_CUTOUT\"], "
+		"\"uniforms\" : [ { \"name\" : \"u_intensity\", \"float_value\" : 2 } ] }";
+
+
+	void UT_material_compile(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::PathManager path_manager(allocator);
+
+		Lumix::OutputBlob out(allocator);
+		LUMIX_EXPECT(Lumix::Material::compile(material_source,
+			Lumix::stringLength(material_source),
+			Lumix::Path("models/test.mat"),
+			out,
+			allocator));
+
+		Lumix::InputBlob blob(out);
+		// 'LTMB', JSON sources start with '{'
+		LUMIX_EXPECT(blob.read<Lumix::uint32>() == 0x424D544C);
+		LUMIX_EXPECT(blob.read<Lumix::int32>() == 0);
+		char tmp[Lumix::MAX_PATH_LENGTH];
+		blob.readString(tmp, sizeof(tmp));
+		LUMIX_EXPECT(Lumix::compareString(tmp, "shaders/rigid.shd") == 0);
+		LUMIX_EXPECT(blob.read<Lumix::int32>() == 1);
+		LUMIX_EXPECT(blob.read<float>() == 0.5f);
+		LUMIX_EXPECT(blob.read<float>() == 4);
+		blob.skip(sizeof(float) * 3);
+
+		LUMIX_EXPECT(blob.read<Lumix::int32>() == 1);
+		blob.readString(tmp, sizeof(tmp));
+		LUMIX_EXPECT(Lumix::compareString(tmp, "ALPHA_CUTOUT") == 0);
+
+		// relative texture paths are resolved at compile time
+		LUMIX_EXPECT(blob.read<Lumix::int32>() == 2);
+		blob.readString(tmp, sizeof(tmp));
+		LUMIX_EXPECT(Lumix::compareString(tmp, "models/albedo.tga") == 0);
+		blob.skip(sizeof(Lumix::int32) + sizeof(Lumix::uint32));
+		LUMIX_EXPECT(blob.read<Lumix::uint8>() == 0);
+		blob.readString(tmp, sizeof(tmp));
+		LUMIX_EXPECT(Lumix::compareString(tmp, "/textures/normal.tga") == 0);
+		blob.skip(sizeof(Lumix::int32) + sizeof(Lumix::uint32));
+		LUMIX_EXPECT(blob.read<Lumix::uint8>() == 1);
+
+		LUMIX_EXPECT(blob.read<Lumix::int32>() == 1);
+		auto uniform = blob.read<Lumix::Material::Uniform>();
+		LUMIX_EXPECT(uniform.float_value == 2);
+	}
+
+	REGISTER_TEST("unit_tests/graphics/material/compile", UT_material_compile, "");
+
+}
@@ -0,0 +1,114 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "core/array.h"
+#include "core/vec.h"
+
+#include "renderer/mesh_simplifier.h"
+
+namespace
+{
+	struct Vertex
+	{
+		Lumix::uint32 color;
+		Lumix::Vec3 position;
+	};
+
+
+	// size x size quads in the xz plane, vertex colors are their indices
+	void createGrid(int size, Lumix::Array<Vertex>& vertices, Lumix::Array<Lumix::int32>& indices)
+	{
+		for (int z = 0; z <= size; ++z)
+		{
+			for (int x = 0; x <= size; ++x)
+			{
+				Vertex& vertex = vertices.emplace();
+				vertex.color = vertices.size() - 1;
+				vertex.position.set((float)x, 0, (float)z);
+			}
+		}
+		for (int z = 0; z < size; ++z)
+		{
+			for (int x = 0; x < size; ++x)
+			{
+				Lumix::int32 corner = z * (size + 1) + x;
+				Lumix::int32 quad[] = { corner, corner + size + 1, corner + 1,
+					corner + 1, corner + size + 1, corner + size + 2 };
+				for (Lumix::int32 index : quad) indices.push(index);
+			}
+		}
+	}
+
+
+	void UT_mesh_simplifier(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::Array<Vertex> vertices(allocator);
+		Lumix::Array<Lumix::int32> indices(allocator);
+		createGrid(8, vertices, indices);
+		Lumix::Array<Lumix::uint8> out_vertices(allocator);
+		Lumix::Array<Lumix::int32> out_indices(allocator);
+
+		// cells smaller than the distance of vertices keep the mesh as it is
+		int count = Lumix::simplifyMesh((const Lumix::uint8*)&vertices[0],
+			vertices.size(),
+			sizeof(Vertex),
+			sizeof(Lumix::uint32),
+			&indices[0],
+			indices.size(),
+			0.5f,
+			allocator,
+			out_vertices,
+			out_indices);
+		LUMIX_EXPECT(count == vertices.size());
+		LUMIX_EXPECT(out_vertices.size() == count * (int)sizeof(Vertex));
+		LUMIX_EXPECT(out_indices.size() == indices.size());
+
+		// 2x2 cells merge 4 vertices of 4 quads to one, but two triangles of each 2x2 block stay
+		count = Lumix::simplifyMesh((const Lumix::uint8*)&vertices[0],
+			vertices.size(),
+			sizeof(Vertex),
+			sizeof(Lumix::uint32),
+			&indices[0],
+			indices.size(),
+			2.0f,
+			allocator,
+			out_vertices,
+			out_indices);
+		LUMIX_EXPECT(count == 25);
+		LUMIX_EXPECT(out_indices.size() > 0);
+		LUMIX_EXPECT(out_indices.size() < indices.size());
+		const Vertex* simplified = (const Vertex*)&out_vertices[0];
+		for (Lumix::int32 index : out_indices)
+		{
+			LUMIX_EXPECT(index >= 0);
+			LUMIX_EXPECT(index < count);
+		}
+		for (int i = 0; i + 2 < out_indices.size(); i += 3)
+		{
+			LUMIX_EXPECT(out_indices[i] != out_indices[i + 1]);
+			LUMIX_EXPECT(out_indices[i + 1] != out_indices[i + 2]);
+			LUMIX_EXPECT(out_indices[i] != out_indices[i + 2]);
+		}
+		// the merged vertex of the first cell is the average of (0, 0), (1, 0), (0, 1), (1, 1)
+		// with attributes of the first of them
+		LUMIX_EXPECT(simplified[0].color == 0);
+		LUMIX_EXPECT_CLOSE_EQ(simplified[0].position.x, 0.5f, 0.001f);
+		LUMIX_EXPECT_CLOSE_EQ(simplified[0].position.z, 0.5f, 0.001f);
+
+		// everything collapses to one vertex
+		count = Lumix::simplifyMesh((const Lumix::uint8*)&vertices[0],
+			vertices.size(),
+			sizeof(Vertex),
+			sizeof(Lumix::uint32),
+			&indices[0],
+			indices.size(),
+			100.0f,
+			allocator,
+			out_vertices,
+			out_indices);
+		LUMIX_EXPECT(count == 1);
+		LUMIX_EXPECT(out_indices.empty());
+	}
+}
+
+REGISTER_TEST("unit_tests/graphics/mesh_simplifier", UT_mesh_simplifier, "");
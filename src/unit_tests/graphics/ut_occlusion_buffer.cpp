@@ -0,0 +1,52 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "core/aabb.h"
+#include "core/matrix.h"
+#include "core/vec.h"
+
+#include "core/MTJD/manager.h"
+
+#include "renderer/occlusion_buffer.h"
+
+namespace
+{
+	void UT_occlusion_buffer(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::MTJD::Manager* mtjd_manager = Lumix::MTJD::Manager::create(allocator);
+		Lumix::OcclusionBuffer buffer(allocator);
+
+		Lumix::Matrix projection;
+		projection.setPerspective(Lumix::Math::degreesToRadians(60.f), 2.f, 0.1f, 1000.f);
+		Lumix::Matrix view = Lumix::Matrix::IDENTITY;
+
+		// camera looks down -z, the wall is 10 units in front of it
+		Lumix::Vec3 wall[] = {
+			{ -50.f, -50.f, -10.f }, { 50.f, -50.f, -10.f }, { 50.f, 50.f, -10.f }, { -50.f, 50.f, -10.f } };
+		Lumix::int32 indices[] = { 0, 1, 2, 0, 2, 3 };
+
+		buffer.clear(projection * view);
+		LUMIX_EXPECT(!buffer.hasOccluders());
+		buffer.addOccluder(wall, indices, Lumix::lengthOf(indices), Lumix::Matrix::IDENTITY);
+		LUMIX_EXPECT(buffer.hasOccluders());
+		buffer.rasterize(*mtjd_manager);
+
+		Lumix::AABB box(Lumix::Vec3(-1, -1, -1), Lumix::Vec3(1, 1, 1));
+		Lumix::Matrix behind_wall = Lumix::Matrix::IDENTITY;
+		behind_wall.setTranslation(Lumix::Vec3(0, 0, -30));
+		Lumix::Matrix in_front_of_wall = Lumix::Matrix::IDENTITY;
+		in_front_of_wall.setTranslation(Lumix::Vec3(0, 0, -5));
+		Lumix::Matrix around_camera = Lumix::Matrix::IDENTITY;
+
+		LUMIX_EXPECT(!buffer.isVisible(box, behind_wall));
+		LUMIX_EXPECT(buffer.isVisible(box, in_front_of_wall));
+		LUMIX_EXPECT(buffer.isVisible(box, around_camera));
+
+		buffer.clear(projection * view);
+		LUMIX_EXPECT(buffer.isVisible(box, behind_wall));
+
+		Lumix::MTJD::Manager::destroy(*mtjd_manager);
+	}
+}
+
+REGISTER_TEST("unit_tests/graphics/occlusion_buffer", UT_occlusion_buffer, "");
@@ -0,0 +1,42 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "core/array.h"
+#include "renderer/particle_system.h"
+
+namespace
+{
+	void UT_particle_compact(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::Array<int> values(allocator);
+		for (int i = 0; i < 6; ++i) values.push(i);
+
+		// dead particles are replaced by the last alive ones
+		const Lumix::uint8 dead[] = {0, 1, 0, 1, 0, 1};
+		Lumix::ParticleEmitter::compact(values, dead);
+		LUMIX_EXPECT(values.size() == 3);
+		LUMIX_EXPECT(values[0] == 0);
+		LUMIX_EXPECT(values[1] == 4);
+		LUMIX_EXPECT(values[2] == 2);
+
+		// the same mask moves the same elements in every array
+		Lumix::Array<float> floats(allocator);
+		for (int i = 0; i < 6; ++i) floats.push(i * 10.0f);
+		Lumix::ParticleEmitter::compact(floats, dead);
+		LUMIX_EXPECT(floats.size() == 3);
+		for (int i = 0; i < 3; ++i) LUMIX_EXPECT(floats[i] == values[i] * 10.0f);
+
+		const Lumix::uint8 all_dead[] = {1, 1, 1};
+		Lumix::ParticleEmitter::compact(values, all_dead);
+		LUMIX_EXPECT(values.empty());
+
+		values.push(7);
+		values.push(8);
+		const Lumix::uint8 first_dead[] = {1, 0};
+		Lumix::ParticleEmitter::compact(values, first_dead);
+		LUMIX_EXPECT(values.size() == 1);
+		LUMIX_EXPECT(values[0] == 8);
+	}
+}
+
+REGISTER_TEST("unit_tests/graphics/particle_compact", UT_particle_compact, "")
@@ -0,0 +1,58 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "renderer/shader_cache.h"
+
+namespace
+{
+
+	const char cache_dir[] = "unit_tests/shader_cache/";
+
+
+	void UT_shader_cache(const char* params)
+	{
+		Lumix::DefaultAllocator allocator;
+		Lumix::ShaderCache cache(allocator);
+		LUMIX_EXPECT(cache.open(cache_dir, 1, 100));
+		// start from an empty cache
+		LUMIX_EXPECT(cache.open(cache_dir, 2, 100));
+		LUMIX_EXPECT(cache.open(cache_dir, 1, 100));
+		LUMIX_EXPECT(cache.getEntryCount() == 0);
+
+		char data[40];
+		for (int i = 0; i < 40; ++i) data[i] = (char)i;
+		cache.write(10, data, 40);
+		cache.write(11, data, 30);
+		LUMIX_EXPECT(cache.getEntrySize(10) == 40);
+		LUMIX_EXPECT(cache.getEntrySize(11) == 30);
+		LUMIX_EXPECT(cache.getEntrySize(12) == 0);
+		LUMIX_EXPECT(cache.getTotalSize() == 70);
+
+		char tmp[40] = {};
+		LUMIX_EXPECT(cache.read(10, tmp, 40));
+		LUMIX_EXPECT(tmp[39] == 39);
+		LUMIX_EXPECT(!cache.read(11, tmp, 40));
+
+		// entry 11 was used the longest time ago
+		cache.write(12, data, 40);
+		LUMIX_EXPECT(cache.getEntrySize(11) == 0);
+		LUMIX_EXPECT(cache.getEntrySize(10) == 40);
+		LUMIX_EXPECT(cache.getTotalSize() == 80);
+
+		cache.write(13, data, 40);
+		cache.close();
+		LUMIX_EXPECT(cache.getEntrySize(12) == 0);
+
+		LUMIX_EXPECT(cache.open(cache_dir, 1, 100));
+		LUMIX_EXPECT(cache.getEntryCount() == 2);
+		LUMIX_EXPECT(cache.read(13, tmp, 40));
+		LUMIX_EXPECT(cache.getEntrySize(12) == 40);
+
+		// another GPU
+		LUMIX_EXPECT(cache.open(cache_dir, 2, 100));
+		LUMIX_EXPECT(cache.getEntryCount() == 0);
+		LUMIX_EXPECT(!cache.read(13, tmp, 40));
+	}
+
+	REGISTER_TEST("unit_tests/graphics/shader_cache", UT_shader_cache, "");
+
+}
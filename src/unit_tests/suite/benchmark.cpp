@@ -0,0 +1,42 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+#include "unit_tests/suite/benchmark.h"
+
+#include "core/log.h"
+#include <cmath>
+#include <cstdlib>
+
+
+namespace Lumix
+{
+	namespace UnitTest
+	{
+		static int compareSamples(const void* a, const void* b)
+		{
+			double lhs = *(const double*)a;
+			double rhs = *(const double*)b;
+			return lhs < rhs ? -1 : (lhs > rhs ? 1 : 0);
+		}
+
+
+		void reportBenchmark(const char* name, double* samples, int count, int operation_count)
+		{
+			ASSERT(count > 0 && operation_count > 0);
+			qsort(samples, count, sizeof(samples[0]), compareSamples);
+
+			double mean = 0;
+			for (int i = 0; i < count; ++i) mean += samples[i];
+			mean /= count;
+			double variance = 0;
+			for (int i = 0; i < count; ++i) variance += (samples[i] - mean) * (samples[i] - mean);
+			double deviation = sqrt(variance / count);
+			double median = count & 1 ? samples[count / 2]
+									  : (samples[count / 2 - 1] + samples[count / 2]) * 0.5;
+
+			// microseconds per run, nanoseconds per operation
+			g_log_info.log("bench") << name << ": min " << float(samples[0] * 1e6) << " us, median "
+									<< float(median * 1e6) << " us, mean " << float(mean * 1e6)
+									<< " us, deviation " << float(deviation * 1e6) << " us, "
+									<< float(median * 1e9 / operation_count) << " ns/op";
+		}
+	} // ~UnitTest
+} // ~Lumix
@@ -0,0 +1,38 @@
+#pragma once
+
+
+#include "core/timer.h"
+
+
+namespace Lumix
+{
+	namespace UnitTest
+	{
+		// sorts samples, they are in seconds
+		void reportBenchmark(const char* name, double* samples, int count, int operation_count);
+
+
+		// times sample_count runs of function after one warm up run and logs min, median, mean
+		// and standard deviation of a run and of one of its operation_count operations
+		template <typename F>
+		void benchmark(const char* name, int sample_count, int operation_count, F function)
+		{
+			IAllocator& allocator = Manager::getAllocator();
+			Timer* timer = Timer::create(allocator);
+			double* samples = (double*)allocator.allocate(sizeof(double) * sample_count);
+			double frequency = (double)timer->getFrequency();
+
+			function();
+			for (int i = 0; i < sample_count; ++i)
+			{
+				uint64 start = timer->getRawTimeSinceStart();
+				function();
+				samples[i] = (timer->getRawTimeSinceStart() - start) / frequency;
+			}
+			reportBenchmark(name, samples, sample_count, operation_count);
+
+			allocator.deallocate(samples);
+			Timer::destroy(timer);
+		}
+	} // ~UnitTest
+} // ~Lumix
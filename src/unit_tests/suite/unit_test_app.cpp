@@ -42,7 +42,7 @@ namespace Lumix
 		void App::run(int argc, const char *argv[])
 		{
 			Manager::instance().dumpTests();
-			Manager::instance().runTests("*");
+			Manager::instance().runTests(argc > 1 ? argv[1] : "*");
 			Manager::instance().dumpResults();
 		}
 